@@ -34,7 +34,7 @@ GtsBBoxClass * gts_bbox_class (void)
 {
   static GtsBBoxClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo bbox_info = {
       "GtsBBox",
       sizeof (GtsBBox),
@@ -44,7 +44,8 @@ GtsBBoxClass * gts_bbox_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), &bbox_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &bbox_info));
   }
 
   return klass;
@@ -66,7 +66,7 @@ GtsSurfaceInterClass * gts_surface_inter_class (void)
 {
   static GtsSurfaceInterClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo surface_inter_info = {
       "GtsSurfaceInter",
       sizeof (GtsSurfaceInter),
@@ -76,7 +76,8 @@ GtsSurfaceInterClass * gts_surface_inter_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), &surface_inter_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &surface_inter_info));
   }
 
   return klass;
@@ -108,7 +109,7 @@ static GtsEdgeClass * edge_inter_class (void)
 {
   static GtsEdgeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo edge_inter_info = {
       "EdgeInter",
       sizeof (EdgeInter),
@@ -118,8 +119,9 @@ static GtsEdgeClass * edge_inter_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_constraint_class ()),
-				  &edge_inter_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_constraint_class ()),
+                                             &edge_inter_info));
   }
 
   return klass;
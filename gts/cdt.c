@@ -392,7 +392,7 @@ GtsConstraintClass * gts_constraint_class (void)
 {
   static GtsConstraintClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo constraint_info = {
       "GtsConstraint",
       sizeof (GtsConstraint),
@@ -402,8 +402,9 @@ GtsConstraintClass * gts_constraint_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_edge_class ()), 
-				  &constraint_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_edge_class ()),
+                                             &constraint_info));
   }
 
   return klass;
@@ -1157,7 +1158,7 @@ GtsFaceClass * gts_list_face_class (void)
 {
   static GtsFaceClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo gts_list_face_info = {
       "GtsListFace",
       sizeof (GtsListFace),
@@ -1167,8 +1168,9 @@ GtsFaceClass * gts_list_face_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_face_class ()),
-				  &gts_list_face_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_face_class ()),
+                                             &gts_list_face_info));
   }
 
   return klass;
@@ -34,7 +34,7 @@ GtsContaineeClass * gts_containee_class (void)
 {
   static GtsContaineeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo containee_info = {
       "GtsContainee",
       sizeof (GtsContainee),
@@ -44,8 +44,8 @@ GtsContaineeClass * gts_containee_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (),
-				  &containee_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &containee_info));
   }
 
   return klass;
@@ -164,7 +164,7 @@ GtsSListContaineeClass * gts_slist_containee_class (void)
 {
   static GtsSListContaineeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo slist_containee_info = {
       "GtsSListContainee",
       sizeof (GtsSListContainee),
@@ -174,8 +174,9 @@ GtsSListContaineeClass * gts_slist_containee_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_containee_class ()),
-				  &slist_containee_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_containee_class ()),
+                                             &slist_containee_info));
   }
 
   return klass;
@@ -241,7 +242,7 @@ GtsContainerClass * gts_container_class (void)
 {
   static GtsContainerClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo container_info = {
       "GtsContainer",
       sizeof (GtsContainer),
@@ -251,9 +252,9 @@ GtsContainerClass * gts_container_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = 
-      gts_object_class_new (GTS_OBJECT_CLASS (gts_slist_containee_class ()), 
-			    &container_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_slist_containee_class ()),
+                                             &container_info));
   }
 
   return klass;
@@ -385,7 +386,7 @@ GtsHashContainerClass * gts_hash_container_class (void)
 {
   static GtsHashContainerClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo hash_container_info = {
       "GtsHashContainer",
       sizeof (GtsHashContainer),
@@ -395,8 +396,9 @@ GtsHashContainerClass * gts_hash_container_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_container_class ()),
-				  &hash_container_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_container_class ()),
+                                             &hash_container_info));
   }
 
   return klass;
@@ -475,7 +477,7 @@ GtsSListContainerClass * gts_slist_container_class (void)
 {
   static GtsSListContainerClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo slist_container_info = {
       "GtsSListContainer",
       sizeof (GtsSListContainer),
@@ -485,8 +487,9 @@ GtsSListContainerClass * gts_slist_container_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_container_class ()),
-				  &slist_container_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_container_class ()),
+                                             &slist_container_info));
   }
 
   return klass;
@@ -19,8 +19,6 @@
 
 #include "gts.h"
 
-gboolean gts_allow_floating_edges = FALSE;
-
 static void edge_destroy (GtsObject * object)
 {
   GtsEdge * edge = GTS_EDGE (object);
@@ -65,7 +63,7 @@ GtsEdgeClass * gts_edge_class (void)
 {
   static GtsEdgeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo edge_info = {
       "GtsEdge",
       sizeof (GtsEdge),
@@ -75,8 +73,9 @@ GtsEdgeClass * gts_edge_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_segment_class ()), 
-				  &edge_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_segment_class ()),
+                                             &edge_info));
   }
 
   return klass;
@@ -19,8 +19,6 @@
 
 #include "gts.h"
 
-gboolean gts_allow_floating_faces = FALSE;
-
 static void face_destroy (GtsObject * object)
 {
   GtsFace * face = GTS_FACE (object);
@@ -64,7 +62,7 @@ GtsFaceClass * gts_face_class (void)
 {
   static GtsFaceClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo face_info = {
       "GtsFace",
       sizeof (GtsFace),
@@ -74,8 +72,9 @@ GtsFaceClass * gts_face_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_triangle_class ()), 
-				  &face_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_triangle_class ()),
+                                             &face_info));
   }
 
   return klass;
@@ -23,8 +23,6 @@
 
 /* GtsGNode */
 
-gboolean gts_allow_floating_gnodes = FALSE;
-
 static void gnode_remove_container (GtsContainee * i, GtsContainer * c)
 {
   (* GTS_CONTAINEE_CLASS (GTS_OBJECT_CLASS (gts_gnode_class ())->parent_class)->remove_container) (i, c);
@@ -55,7 +53,7 @@ GtsGNodeClass * gts_gnode_class (void)
 {
   static GtsGNodeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo gnode_info = {
       "GtsGNode",
       sizeof (GtsGNode),
@@ -65,9 +63,9 @@ GtsGNodeClass * gts_gnode_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = 
-      gts_object_class_new (GTS_OBJECT_CLASS (gts_slist_container_class ()),
-			    &gnode_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_slist_container_class ()),
+                                             &gnode_info));
   }
 
   return klass;
@@ -247,7 +245,7 @@ GtsNGNodeClass * gts_ngnode_class (void)
 {
   static GtsNGNodeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo ngnode_info = {
       "GtsNGNode",
       sizeof (GtsNGNode),
@@ -257,8 +255,9 @@ GtsNGNodeClass * gts_ngnode_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_gnode_class ()),
-				  &ngnode_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_gnode_class ()),
+                                             &ngnode_info));
   }
 
   return klass;
@@ -307,7 +306,7 @@ GtsWGNodeClass * gts_wgnode_class (void)
 {
   static GtsWGNodeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo wgnode_info = {
       "GtsWGNode",
       sizeof (GtsWGNode),
@@ -317,8 +316,9 @@ GtsWGNodeClass * gts_wgnode_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_gnode_class ()),
-				  &wgnode_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_gnode_class ()),
+                                             &wgnode_info));
   }
 
   return klass;
@@ -373,7 +373,7 @@ GtsPNodeClass * gts_pnode_class (void)
 {
   static GtsPNodeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo pnode_info = {
       "GtsPNode",
       sizeof (GtsPNode),
@@ -383,8 +383,9 @@ GtsPNodeClass * gts_pnode_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_gnode_class ()),
-				  &pnode_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_gnode_class ()),
+                                             &pnode_info));
   }
 
   return klass;
@@ -433,7 +434,7 @@ GtsFNodeClass * gts_fnode_class (void)
 {
   static GtsFNodeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo fnode_info = {
       "GtsFNode",
       sizeof (GtsFNode),
@@ -443,8 +444,9 @@ GtsFNodeClass * gts_fnode_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_gnode_class ()),
-				  &fnode_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_gnode_class ()),
+                                             &fnode_info));
   }
 
   return klass;
@@ -538,7 +540,7 @@ GtsGEdgeClass * gts_gedge_class (void)
 {
   static GtsGEdgeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo gedge_info = {
       "GtsGEdge",
       sizeof (GtsGEdge),
@@ -548,8 +550,9 @@ GtsGEdgeClass * gts_gedge_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_containee_class ()),
-				  &gedge_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_containee_class ()),
+                                             &gedge_info));
   }
 
   return klass;
@@ -640,7 +643,7 @@ GtsPGEdgeClass * gts_pgedge_class (void)
 {
   static GtsPGEdgeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo pgedge_info = {
       "GtsPGEdge",
       sizeof (GtsPGEdge),
@@ -650,8 +653,9 @@ GtsPGEdgeClass * gts_pgedge_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_gedge_class ()),
-				  &pgedge_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_gedge_class ()),
+                                             &pgedge_info));
   }
 
   return klass;
@@ -705,7 +709,7 @@ GtsWGEdgeClass * gts_wgedge_class (void)
 {
   static GtsWGEdgeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo wgedge_info = {
       "GtsWGEdge",
       sizeof (GtsWGEdge),
@@ -715,8 +719,9 @@ GtsWGEdgeClass * gts_wgedge_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_gedge_class ()),
-				  &wgedge_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_gedge_class ()),
+                                             &wgedge_info));
   }
 
   return klass;
@@ -817,7 +822,7 @@ GtsGraphClass * gts_graph_class (void)
 {
   static GtsGraphClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo graph_info = {
       "GtsGraph",
       sizeof (GtsGraph),
@@ -827,8 +832,9 @@ GtsGraphClass * gts_graph_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_hash_container_class ()),
-				  &graph_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_hash_container_class ()),
+                                             &graph_info));
   }
 
   return klass;
@@ -1597,7 +1603,7 @@ GtsWGraphClass * gts_wgraph_class (void)
 {
   static GtsWGraphClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo wgraph_info = {
       "GtsWGraph",
       sizeof (GtsWGraph),
@@ -1607,8 +1613,9 @@ GtsWGraphClass * gts_wgraph_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_graph_class ()),
-				  &wgraph_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_graph_class ()),
+                                             &wgraph_info));
   }
 
   return klass;
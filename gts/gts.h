@@ -52,6 +52,16 @@ GTS_C_VAR const guint gts_micro_version;
 GTS_C_VAR const guint gts_interface_age;
 GTS_C_VAR const guint gts_binary_age;
 
+/* Floating objects: misc.c */
+
+typedef struct _GtsFloating GtsFloating;
+
+struct _GtsFloating {
+  gboolean vertices, edges, faces, gnodes;
+};
+
+GtsFloating *   gts_floating                   (void);
+
 #define GTS_CHECK_VERSION(major,minor,micro)    \
     (gts_major_version > (major) || \
     (gts_major_version == (major) && gts_minor_version > (minor)) || \
@@ -450,8 +460,7 @@ struct _GtsVertexClass {
 					   GtsObject *);
 };
 
-GTS_C_VAR 
-gboolean      gts_allow_floating_vertices;
+#define gts_allow_floating_vertices (gts_floating ()->vertices)
 
 GtsVertexClass * gts_vertex_class          (void);
 GtsVertex *   gts_vertex_new               (GtsVertexClass * klass,
@@ -589,8 +598,7 @@ struct _GtsEdgeClass {
   GtsSegmentClass parent_class;
 };
 
-GTS_C_VAR 
-gboolean      gts_allow_floating_edges;
+#define gts_allow_floating_edges (gts_floating ()->edges)
 
 GtsEdgeClass * gts_edge_class                     (void);
 GtsEdge *     gts_edge_new                        (GtsEdgeClass * klass,
@@ -742,8 +750,7 @@ struct _GtsFaceClass {
   GtsTriangleClass parent_class;
 };
 
-GTS_C_VAR 
-gboolean      gts_allow_floating_faces;
+#define gts_allow_floating_faces (gts_floating ()->faces)
 
 GtsFaceClass * gts_face_class                       (void);
 GtsFace *     gts_face_new                          (GtsFaceClass * klass,
@@ -2121,8 +2128,7 @@ gfloat          gts_gnode_move_cost            (GtsGNode * n,
 						GtsGraph * dst);
 gfloat          gts_gnode_weight               (GtsGNode * n);
 
-GTS_C_VAR
-gboolean        gts_allow_floating_gnodes;
+#define gts_allow_floating_gnodes (gts_floating ()->gnodes)
 
 /* GtsNGNode: graph.c */
 
@@ -41,7 +41,7 @@ GtsHSplitClass * gts_hsplit_class (void)
 {
   static GtsHSplitClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo hsplit_info = {
       "GtsHSplit",
       sizeof (GtsHSplit),
@@ -51,8 +51,9 @@ GtsHSplitClass * gts_hsplit_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_split_class ()), 
-				  &hsplit_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_split_class ()),
+                                             &hsplit_info));
   }
 
   return klass;
@@ -189,7 +190,7 @@ GtsHSurfaceClass * gts_hsurface_class (void)
 {
   static GtsHSurfaceClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo hsurface_info = {
       "GtsHSurface",
       sizeof (GtsHSurface),
@@ -199,8 +200,8 @@ GtsHSurfaceClass * gts_hsurface_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), 
-				  &hsurface_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &hsurface_info));
   }
 
   return klass;
@@ -30,6 +30,29 @@ const guint gts_micro_version = GTS_MICRO_VERSION;
 const guint gts_interface_age = 1;
 const guint gts_binary_age = 1;
 
+static GPrivate floating = G_PRIVATE_INIT (g_free);
+
+/**
+ * gts_floating:
+ *
+ * The flags behind #gts_allow_floating_vertices,
+ * #gts_allow_floating_edges, #gts_allow_floating_faces and
+ * #gts_allow_floating_gnodes are kept for each thread, so that threads
+ * working on surfaces of their own do not see each other's.
+ *
+ * Returns: the floating object flags of the calling thread.
+ */
+GtsFloating * gts_floating (void)
+{
+  GtsFloating * f = g_private_get (&floating);
+
+  if (f == NULL) {
+    f = g_new0 (GtsFloating, 1);
+    g_private_set (&floating, f);
+  }
+  return f;
+}
+
 static gboolean char_in_string (char c, const char * s)
 {
   while (*s != '\0')
@@ -60,7 +60,7 @@ GtsNVertexClass * gts_nvertex_class (void)
 {
   static GtsNVertexClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo nvertex_info = {
       "GtsNVertex",
       sizeof (GtsNVertex),
@@ -70,8 +70,9 @@ GtsNVertexClass * gts_nvertex_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_vertex_class ()), 
-				  &nvertex_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_vertex_class ()),
+                                             &nvertex_info));
   }
 
   return klass;
@@ -115,7 +116,7 @@ GtsNEdgeClass * gts_nedge_class (void)
 {
   static GtsNEdgeClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo nedge_info = {
       "GtsNEdge",
       sizeof (GtsNEdge),
@@ -125,8 +126,9 @@ GtsNEdgeClass * gts_nedge_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_edge_class ()), 
-				  &nedge_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_edge_class ()),
+                                             &nedge_info));
   }
 
   return klass;
@@ -170,7 +172,7 @@ GtsNFaceClass * gts_nface_class (void)
 {
   static GtsNFaceClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo nface_info = {
       "GtsNFace",
       sizeof (GtsNFace),
@@ -180,8 +182,9 @@ GtsNFaceClass * gts_nface_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_face_class ()), 
-				  &nface_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_face_class ()),
+                                             &nface_info));
   }
 
   return klass;
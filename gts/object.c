@@ -22,6 +22,86 @@
 #include "gts-private.h"
 
 static GHashTable * class_table = NULL;
+G_LOCK_DEFINE_STATIC (class_table);
+
+/* Objects are allocated with a header holding the size they were
+ * allocated for, which is kept even when an object changes class.  A
+ * destroyed object goes on a free list of the thread destroying it, one
+ * list for each size up to OBJECT_CACHE_MAX bytes, from which that
+ * thread's next object of the size is taken.  The many vertices, edges
+ * and faces a triangulation makes and destroys are then reused without
+ * going back to the system allocator, and threads building surfaces of
+ * their own keep out of each other's way. */
+#define OBJECT_ALIGN          (2*sizeof (gpointer))
+#define OBJECT_CACHE_MAX      256
+#define OBJECT_CACHE_SLOTS    (OBJECT_CACHE_MAX/OBJECT_ALIGN + 1)
+#define OBJECT_CACHE_LENGTH   4096
+
+typedef union {
+  gsize slot;
+  gdouble align[2];
+} ObjectHeader;
+
+typedef struct {
+  ObjectHeader * list[OBJECT_CACHE_SLOTS];
+  guint length[OBJECT_CACHE_SLOTS];
+} ObjectCache;
+
+static void object_cache_free (gpointer data)
+{
+  ObjectCache * cache = data;
+  ObjectHeader * h;
+  guint i;
+
+  for (i = 0; i < OBJECT_CACHE_SLOTS; i++)
+    while ((h = cache->list[i]) != NULL) {
+      cache->list[i] = *((ObjectHeader **) (h + 1));
+      g_free (h);
+    }
+  g_free (cache);
+}
+
+static GPrivate object_cache = G_PRIVATE_INIT (object_cache_free);
+
+static gpointer object_alloc0 (gsize size)
+{
+  gsize slot = (size + OBJECT_ALIGN - 1)/OBJECT_ALIGN;
+  ObjectCache * cache;
+  ObjectHeader * h = NULL;
+
+  if (slot < OBJECT_CACHE_SLOTS &&
+      (cache = g_private_get (&object_cache)) != NULL &&
+      (h = cache->list[slot]) != NULL) {
+    cache->list[slot] = *((ObjectHeader **) (h + 1));
+    cache->length[slot]--;
+  }
+  if (h == NULL)
+    h = g_malloc (sizeof (ObjectHeader) + 
+		  (slot < OBJECT_CACHE_SLOTS ? slot*OBJECT_ALIGN : size));
+  h->slot = slot;
+  memset (h + 1, 0, size);
+  return h + 1;
+}
+
+static void object_free (gpointer object)
+{
+  ObjectHeader * h = ((ObjectHeader *) object) - 1;
+  ObjectCache * cache;
+
+  if (h->slot < OBJECT_CACHE_SLOTS) {
+    if ((cache = g_private_get (&object_cache)) == NULL) {
+      cache = g_new0 (ObjectCache, 1);
+      g_private_set (&object_cache, cache);
+    }
+    if (cache->length[h->slot] < OBJECT_CACHE_LENGTH) {
+      *((ObjectHeader **) object) = cache->list[h->slot];
+      cache->list[h->slot] = h;
+      cache->length[h->slot]++;
+      return;
+    }
+  }
+  g_free (h);
+}
 
 static void gts_object_class_init (GtsObjectClass * klass,
 				   GtsObjectClass * parent_class)
@@ -59,9 +139,11 @@ gpointer gts_object_class_new (GtsObjectClass * parent_class,
   klass->parent_class = parent_class;
   gts_object_class_init (klass, klass);
 
+  G_LOCK (class_table);
   if (!class_table)
     class_table = g_hash_table_new (g_str_hash, g_str_equal);
   g_hash_table_insert (class_table, klass->info.name, klass);
+  G_UNLOCK (class_table);
 
   return klass;
 }
@@ -75,11 +157,15 @@ gpointer gts_object_class_new (GtsObjectClass * parent_class,
  */
 GtsObjectClass * gts_object_class_from_name (const gchar * name)
 {
+  GtsObjectClass * klass = NULL;
+
   g_return_val_if_fail (name != NULL, NULL);
 
-  if (!class_table)
-    return NULL;
-  return g_hash_table_lookup (class_table, name);
+  G_LOCK (class_table);
+  if (class_table)
+    klass = g_hash_table_lookup (class_table, name);
+  G_UNLOCK (class_table);
+  return klass;
 }
 
 static void object_destroy (GtsObject * object)
@@ -94,7 +180,7 @@ static void object_destroy (GtsObject * object)
   id_remove (object);
 #endif
   object->klass = NULL;
-  g_free (object);
+  object_free (object);
 }
 
 static void object_clone (GtsObject * clone, GtsObject * object)
@@ -128,7 +214,7 @@ GtsObjectClass * gts_object_class (void)
 {
   static GtsObjectClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo object_info = {
       "GtsObject",
       sizeof (GtsObject),
@@ -138,7 +224,7 @@ GtsObjectClass * gts_object_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (NULL, &object_info);
+    g_once_init_leave (&klass, gts_object_class_new (NULL, &object_info));
   }
 
   return klass;
@@ -234,7 +320,7 @@ GtsObject * gts_object_new (GtsObjectClass * klass)
 
   g_return_val_if_fail (klass != NULL, NULL);
 
-  object = g_malloc0 (klass->info.object_size);
+  object = object_alloc0 (klass->info.object_size);
   object->klass = klass;
   gts_object_init (object, klass);
 
@@ -266,7 +352,7 @@ GtsObject * gts_object_clone (GtsObject * object)
   g_return_val_if_fail (object != NULL, NULL);
   g_return_val_if_fail (object->klass->clone, NULL);
 
-  clone = g_malloc0 (object->klass->info.object_size);
+  clone = object_alloc0 (object->klass->info.object_size);
   clone->klass = object->klass;
   object_init (clone);
   (* object->klass->clone) (clone, object);
@@ -85,7 +85,7 @@ GtsClusterClass * gts_cluster_class (void)
 {
   static GtsClusterClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo cluster_info = {
       "GtsCluster",
       sizeof (GtsCluster),
@@ -95,7 +95,8 @@ GtsClusterClass * gts_cluster_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), &cluster_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &cluster_info));
   }
 
   return klass;
@@ -206,7 +207,7 @@ GtsClusterGridClass * gts_cluster_grid_class (void)
 {
   static GtsClusterGridClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo cluster_grid_info = {
       "GtsClusterGrid",
       sizeof (GtsClusterGrid),
@@ -216,7 +217,8 @@ GtsClusterGridClass * gts_cluster_grid_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), &cluster_grid_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &cluster_grid_info));
   }
 
   return klass;
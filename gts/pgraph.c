@@ -60,7 +60,7 @@ GtsGNodeSplitClass * gts_gnode_split_class (void)
 {
   static GtsGNodeSplitClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo gnode_split_info = {
       "GtsGNodeSplit",
       sizeof (GtsGNodeSplit),
@@ -70,7 +70,8 @@ GtsGNodeSplitClass * gts_gnode_split_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), &gnode_split_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &gnode_split_info));
   }
 
   return klass;
@@ -304,7 +305,7 @@ GtsPGraphClass * gts_pgraph_class (void)
 {
   static GtsPGraphClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo pgraph_info = {
       "GtsPGraph",
       sizeof (GtsPGraph),
@@ -314,7 +315,8 @@ GtsPGraphClass * gts_pgraph_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), &pgraph_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &pgraph_info));
   }
 
   return klass;
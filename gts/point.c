@@ -94,7 +94,7 @@ GtsPointClass * gts_point_class (void)
 {
   static GtsPointClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo point_info = {
       "GtsPoint",
       sizeof (GtsPoint),
@@ -104,8 +104,8 @@ GtsPointClass * gts_point_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), 
-				  &point_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &point_info));
   }
 
   return klass;
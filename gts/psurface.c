@@ -65,7 +65,7 @@ GtsPSurfaceClass * gts_psurface_class (void)
 {
   static GtsPSurfaceClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo psurface_info = {
       "GtsPSurface",
       sizeof (GtsPSurface),
@@ -75,8 +75,8 @@ GtsPSurfaceClass * gts_psurface_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), 
-				  &psurface_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &psurface_info));
   }
 
   return klass;
@@ -57,7 +57,7 @@ GtsSegmentClass * gts_segment_class (void)
 {
   static GtsSegmentClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo segment_info = {
       "GtsSegment",
       sizeof (GtsSegment),
@@ -67,8 +67,8 @@ GtsSegmentClass * gts_segment_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), 
-				  &segment_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &segment_info));
   }
 
   return klass;
@@ -92,7 +92,7 @@ static GtsObjectClass * cface_class (void)
 {
   static GtsObjectClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo cface_info = {
       "GtsCFace",
       sizeof (CFace),
@@ -102,7 +102,8 @@ static GtsObjectClass * cface_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), &cface_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &cface_info));
     g_assert (sizeof (CFace) <= sizeof (GtsFace));
   }
 
@@ -464,7 +465,7 @@ GtsSplitClass * gts_split_class (void)
 {
   static GtsSplitClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo split_info = {
       "GtsSplit",
       sizeof (GtsSplit),
@@ -474,8 +475,8 @@ GtsSplitClass * gts_split_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), 
-				  &split_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &split_info));
   }
 
   return klass;
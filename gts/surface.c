@@ -98,7 +98,7 @@ GtsSurfaceClass * gts_surface_class (void)
 {
   static GtsSurfaceClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo surface_info = {
       "GtsSurface",
       sizeof (GtsSurface),
@@ -108,7 +108,8 @@ GtsSurfaceClass * gts_surface_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), &surface_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &surface_info));
   }
 
   return klass;
@@ -64,7 +64,7 @@ GtsTriangleClass * gts_triangle_class (void)
 {
   static GtsTriangleClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo triangle_info = {
       "GtsTriangle",
       sizeof (GtsTriangle),
@@ -74,8 +74,8 @@ GtsTriangleClass * gts_triangle_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (gts_object_class (), 
-				  &triangle_info);
+    g_once_init_leave (&klass, gts_object_class_new (gts_object_class (),
+                                                     &triangle_info));
   }
 
   return klass;
@@ -20,8 +20,6 @@
 #include <math.h>
 #include "gts.h"
 
-gboolean gts_allow_floating_vertices = FALSE;
-
 static void vertex_destroy (GtsObject * object)
 {
   GtsVertex * vertex = GTS_VERTEX (object);
@@ -71,7 +69,7 @@ GtsVertexClass * gts_vertex_class (void)
 {
   static GtsVertexClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo vertex_info = {
       "GtsVertex",
       sizeof (GtsVertex),
@@ -81,8 +79,9 @@ GtsVertexClass * gts_vertex_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_point_class ()), 
-				  &vertex_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_point_class ()),
+                                             &vertex_info));
   }
 
   return klass;
@@ -738,7 +737,7 @@ GtsVertexClass * gts_vertex_normal_class (void)
 {
   static GtsVertexClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo gts_vertex_normal_info = {
       "GtsVertexNormal",
       sizeof (GtsVertexNormal),
@@ -748,8 +747,9 @@ GtsVertexClass * gts_vertex_normal_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_vertex_class ()),
-				  &gts_vertex_normal_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_vertex_class ()),
+                                             &gts_vertex_normal_info));
   }
 
   return klass;
@@ -761,7 +761,7 @@ GtsVertexClass * gts_color_vertex_class (void)
 {
   static GtsVertexClass * klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo gts_color_vertex_info = {
       "GtsColorVertex",
       sizeof (GtsColorVertex),
@@ -771,8 +771,9 @@ GtsVertexClass * gts_color_vertex_class (void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = gts_object_class_new (GTS_OBJECT_CLASS (gts_vertex_class ()),
-				  &gts_color_vertex_info);
+    g_once_init_leave (&klass,
+                       gts_object_class_new (GTS_OBJECT_CLASS (gts_vertex_class ()),
+                                             &gts_color_vertex_info));
   }
 
   return klass;
@@ -54,6 +54,7 @@
 #include "flags.h"
 #include "hid.h"
 #include "insert.h"
+#include "job.h"
 #include "line.h"
 #include "mymem.h"
 #include "misc.h"
@@ -107,6 +108,7 @@ typedef enum
   F_Description,
   F_Cancel,
   F_Center,
+  F_Changed,
   F_Clear,
   F_ClearAndRedraw,
   F_ClearList,
@@ -166,6 +168,7 @@ typedef enum
   F_ResetLinesAndPolygons,
   F_ResetPinsViasAndPads,
   F_Restore,
+  F_Resume,
   F_Rotate,
   F_Save,
   F_Selected,
@@ -347,6 +350,7 @@ static FunctionType Functions[] = {
   {"Description", F_Description},
   {"Cancel", F_Cancel},
   {"Center", F_Center},
+  {"Changed", F_Changed},
   {"Clear", F_Clear},
   {"ClearAndRedraw", F_ClearAndRedraw},
   {"ClearList", F_ClearList},
@@ -405,6 +409,7 @@ static FunctionType Functions[] = {
   {"ResetLinesAndPolygons", F_ResetLinesAndPolygons},
   {"ResetPinsViasAndPads", F_ResetPinsViasAndPads},
   {"Restore", F_Restore},
+  {"Resume", F_Resume},
   {"Revert", F_Revert},
   {"Rotate", F_Rotate},
   {"Save", F_Save},
@@ -1885,6 +1890,7 @@ ActionDumpLibrary (int argc, char **argv, Coord x, Coord y)
 {
   int i, j;
 
+  LoadLibraryOnDemand ();
   printf ("**** Do not count on this format.  It will change ****\n\n");
   printf ("MenuN   = %d\n", (int) Library.MenuN);
   printf ("MenuMax = %d\n", (int) Library.MenuMax);
@@ -3275,28 +3281,52 @@ static const char renumber_help[] =
 
 %end-doc */
 
+/*!
+ * \brief An element to renumber, and where it was found on the board.
+ */
+struct renumber_entry
+{
+  ElementType *element;
+  unsigned int seq;
+};
+
+/*!
+ * \brief Order elements top to bottom, then left to right.
+ *
+ * Elements at the same place go in the reverse of the order they are on
+ * the board, as they always have.
+ */
+static int
+renumber_order (const void *va, const void *vb)
+{
+  const struct renumber_entry *a = (const struct renumber_entry *) va;
+  const struct renumber_entry *b = (const struct renumber_entry *) vb;
+
+  if (a->element->MarkY != b->element->MarkY)
+    return a->element->MarkY < b->element->MarkY ? -1 : 1;
+  if (a->element->MarkX != b->element->MarkX)
+    return a->element->MarkX < b->element->MarkX ? -1 : 1;
+  return a->seq > b->seq ? -1 : a->seq < b->seq;
+}
+
 static int
 ActionRenumber (int argc, char **argv, Coord x, Coord y)
 {
   bool changed = false;
-  ElementType **element_list;
-  ElementType **locked_element_list;
-  unsigned int i, j, k, cnt, lock_cnt;
-  unsigned int tmpi;
-  size_t sz;
+  struct renumber_entry *element_list;
+  unsigned int i, j, k, cnt;
   char *tmps;
   char *name;
   FILE *out;
   static char * default_file = NULL;
-  size_t cnt_list_sz = 100;
-  struct _cnt_list
-  {
-    char *name;
-    unsigned int cnt;
-  } *cnt_list;
-  char **was, **is, *pin;
+  /* the counter of each prefix, the names of the locked elements, and
+     the new name of each renamed one */
+  GHashTable *cnt_list, *locked, *renamed;
+  unsigned int *counter;
+  char **was, **is, *pin, *prefix, *new_ref;
   unsigned int c_cnt = 0;
-  int unique, ok;
+  int unique;
+  bool known;
   int free_name = 0;
 
   if (argc < 1)
@@ -3355,68 +3385,46 @@ ActionRenumber (int argc, char **argv, Coord x, Coord y)
 
   /*
    * Make a first pass through all of the elements and sort them out
-   * by location on the board.  While here we also collect a list of
-   * locked elements.
+   * by location on the board.  While here we also collect the names of
+   * the locked elements.
    *
    * We'll actually renumber things in the 2nd pass.
    */
-  element_list = (ElementType **)calloc (PCB->Data->ElementN, sizeof (ElementType *));
-  locked_element_list = (ElementType **)calloc (PCB->Data->ElementN, sizeof (ElementType *));
-  was = (char **)calloc (PCB->Data->ElementN, sizeof (char *));
-  is = (char **)calloc (PCB->Data->ElementN, sizeof (char *));
-  if (element_list == NULL || locked_element_list == NULL || was == NULL
-      || is == NULL)
+  element_list = (struct renumber_entry *)calloc (PCB->Data->ElementN + 1,
+						  sizeof (*element_list));
+  was = (char **)calloc (PCB->Data->ElementN + 1, sizeof (char *));
+  is = (char **)calloc (PCB->Data->ElementN + 1, sizeof (char *));
+  if (element_list == NULL || was == NULL || is == NULL)
     {
       fprintf (stderr, "calloc() failed in %s\n", __FUNCTION__);
       exit (1);
     }
-
+  locked = g_hash_table_new (g_str_hash, g_str_equal);
 
   cnt = 0;
-  lock_cnt = 0;
   ELEMENT_LOOP (PCB->Data);
   {
     if (TEST_FLAG (LOCKFLAG, element->Name) || TEST_FLAG (LOCKFLAG, element))
       {
 	/* 
-	 * add to the list of locked elements which we won't try to
+	 * add to the names of locked elements which we won't try to
 	 * renumber and whose reference designators are now reserved.
 	 */
 	pcb_fprintf (out,
 		     "*WARN* Element \"%s\" at %$md is locked and will not be renumbered.\n",
 		      UNKNOWN (NAMEONPCB_NAME (element)), element->MarkX, element->MarkY);
-	locked_element_list[lock_cnt] = element;
-	lock_cnt++;
+	g_hash_table_add (locked, UNKNOWN (NAMEONPCB_NAME (element)));
       }
 
     else
       {
-	/* count of devices which will be renumbered */
+	element_list[cnt].element = element;
+	element_list[cnt].seq = cnt;
 	cnt++;
-
-	/* search for correct position in the list */
-	i = 0;
-	while (element_list[i] && element->MarkY > element_list[i]->MarkY)
-	  i++;
-
-	/* 
-	 * We have found the position where we have the first element that
-	 * has the same Y value or a lower Y value.  Now move forward if
-	 * needed through the X values
-	 */
-	while (element_list[i]
-	       && element->MarkY == element_list[i]->MarkY
-	       && element->MarkX > element_list[i]->MarkX)
-	  i++;
-
-	for (j = cnt - 1; j > i; j--)
-	  {
-	    element_list[j] = element_list[j - 1];
-	  }
-	element_list[i] = element;
       }
   }
   END_LOOP;
+  qsort (element_list, cnt, sizeof (*element_list), renumber_order);
 
 
   /* 
@@ -3432,111 +3440,69 @@ ActionRenumber (int argc, char **argv, Coord x, Coord y)
   unique = TEST_FLAG (UNIQUENAMEFLAG, PCB);
   CLEAR_FLAG (UNIQUENAMEFLAG, PCB);
 
-  cnt_list = (struct _cnt_list *)calloc (cnt_list_sz, sizeof (struct _cnt_list));
+  cnt_list = g_hash_table_new_full (g_str_hash, g_str_equal, free, free);
+  DeferDraw ();
   for (i = 0; i < cnt; i++)
     {
+      ElementType *element = element_list[i].element;
+
       /* If there is no refdes, maybe just spit out a warning */
-      if (NAMEONPCB_NAME (element_list[i]))
+      if (NAMEONPCB_NAME (element))
 	{
 	  /* figure out the prefix */
-	  tmps = strdup (NAMEONPCB_NAME (element_list[i]));
+	  tmps = strdup (NAMEONPCB_NAME (element));
 	  j = 0;
 	  while (tmps[j] && (tmps[j] < '0' || tmps[j] > '9')
 		 && tmps[j] != '?')
 	    j++;
 	  tmps[j] = '\0';
 
-	  /* check the counter for this prefix */
-	  for (j = 0;
-	       cnt_list[j].name && (strcmp (cnt_list[j].name, tmps) != 0)
-	       && j < cnt_list_sz; j++);
-
-	  /* grow the list if needed */
-	  if (j == cnt_list_sz)
-	    {
-	      cnt_list_sz += 100;
-	      cnt_list = (struct _cnt_list *)realloc (cnt_list, cnt_list_sz);
-	      if (cnt_list == NULL)
-		{
-		  fprintf (stderr, _("realloc() failed in %s()\n"), __FUNCTION__);
-		  exit (1);
-		}
-	      /* zero out the memory that we added */
-	      for (tmpi = j; tmpi < cnt_list_sz; tmpi++)
-		{
-		  cnt_list[tmpi].name = NULL;
-		  cnt_list[tmpi].cnt = 0;
-		}
-	    }
-
 	  /* 
-	   * start a new counter if we don't have a counter for this
-	   * prefix 
+	   * check the counter for this prefix, and start a new one if
+	   * we don't have a counter for it yet
 	   */
-	  if (!cnt_list[j].name)
+	  counter = (unsigned int *) g_hash_table_lookup (cnt_list, tmps);
+	  known = counter != NULL;
+	  if (!known)
 	    {
-	      cnt_list[j].name = strdup (tmps);
-	      cnt_list[j].cnt = 0;
+	      counter = (unsigned int *) calloc (1, sizeof (*counter));
+	      g_hash_table_insert (cnt_list, tmps, counter);
 	    }
+	  prefix = tmps;
 
 	  /*
 	   * check to see if the new refdes is already used by a
 	   * locked element
 	   */
+	  new_ref = NULL;
 	  do
 	    {
-	      ok = 1;
-	      cnt_list[j].cnt++;
-	      free (tmps);
-
-	      /* space for the prefix plus 1 digit plus the '\0' */
-	      sz = strlen (cnt_list[j].name) + 2;
-
-	      /* and 1 more per extra digit needed to hold the number */
-	      tmpi = cnt_list[j].cnt;
-	      while (tmpi > 10)
-		{
-		  sz++;
-		  tmpi = tmpi / 10;
-		}
-	      tmps = (char *)malloc (sz * sizeof (char));
-	      sprintf (tmps, "%s%d", cnt_list[j].name, (int) cnt_list[j].cnt);
-
-	      /* 
-	       * now compare to the list of reserved (by locked
-	       * elements) names 
-	       */
-	      for (k = 0; k < lock_cnt; k++)
-		{
-		  if (strcmp
-		      (UNKNOWN (NAMEONPCB_NAME (locked_element_list[k])),
-		       tmps) == 0)
-		    {
-		      ok = 0;
-		      break;
-		    }
-		}
-
+	      free (new_ref);
+	      (*counter)++;
+	      /* space for the prefix, the number and the '\0' */
+	      new_ref = (char *)malloc (strlen (prefix) + 12);
+	      sprintf (new_ref, "%s%d", prefix, (int) *counter);
 	    }
-	  while (!ok);
+	  while (g_hash_table_contains (locked, new_ref));
+	  if (known)
+	    free (prefix);
+	  tmps = new_ref;
 
-	  if (strcmp (tmps, NAMEONPCB_NAME (element_list[i])) != 0)
+	  if (strcmp (tmps, NAMEONPCB_NAME (element)) != 0)
 	    {
 	      fprintf (out, "*RENAME* \"%s\" \"%s\"\n",
-		       NAMEONPCB_NAME (element_list[i]), tmps);
+		       NAMEONPCB_NAME (element), tmps);
 
 	      /* add this rename to our table of renames so we can update the netlist */
-	      was[c_cnt] = strdup (NAMEONPCB_NAME (element_list[i]));
+	      was[c_cnt] = strdup (NAMEONPCB_NAME (element));
 	      is[c_cnt] = strdup (tmps);
 	      c_cnt++;
 
 	      AddObjectToChangeNameUndoList (ELEMENT_TYPE, NULL, NULL,
-					     element_list[i],
-					     NAMEONPCB_NAME (element_list
-							     [i]));
+					     element,
+					     NAMEONPCB_NAME (element));
 
-	      ChangeObjectName (ELEMENT_TYPE, element_list[i], NULL, NULL,
-				tmps);
+	      ChangeObjectName (ELEMENT_TYPE, element, NULL, NULL, tmps);
 	      changed = true;
 
 	      /* we don't free tmps in this case because it is used */
@@ -3547,10 +3513,11 @@ ActionRenumber (int argc, char **argv, Coord x, Coord y)
       else
 	{
 	  pcb_fprintf (out, "*WARN* Element at %$md has no name.\n",
-		   element_list[i]->MarkX, element_list[i]->MarkY);
+		   element->MarkX, element->MarkY);
 	}
 
     }
+  ResumeDraw ();
 
   fclose (out);
 
@@ -3561,6 +3528,11 @@ ActionRenumber (int argc, char **argv, Coord x, Coord y)
   if (changed)
     {
 
+      /* the new name of each old one; the first rename of a name wins */
+      renamed = g_hash_table_new (g_str_hash, g_str_equal);
+      for (k = c_cnt; k > 0; k--)
+	g_hash_table_insert (renamed, was[k - 1], is[k - 1]);
+
       /* update the netlist */
       AddNetlistLibToUndoList (&(PCB->NetlistLib));
 
@@ -3578,28 +3550,21 @@ ActionRenumber (int argc, char **argv, Coord x, Coord y)
 	      tmps[k] = '\0';
 	      pin = tmps + k + 1;
 
-	      /* iterate over the list of changed reference designators */
-	      for (k = 0; k < c_cnt; k++)
+	      /* if the pin's reference designator changed, change it */
+	      new_ref = (char *) g_hash_table_lookup (renamed, tmps);
+	      if (new_ref)
 		{
-		  /*
-		   * if the pin needs to change, change it and quit
-		   * searching in the list. 
-		   */
-		  if (strcmp (tmps, was[k]) == 0)
-		    {
-		      free (PCB->NetlistLib.Menu[i].Entry[j].ListEntry);
-		      PCB->NetlistLib.Menu[i].Entry[j].ListEntry =
-			(char *)malloc ((strlen (is[k]) + strlen (pin) +
-				 2) * sizeof (char));
-		      sprintf (PCB->NetlistLib.Menu[i].Entry[j].ListEntry,
-			       "%s-%s", is[k], pin);
-		      k = c_cnt;
-		    }
-
+		  free (PCB->NetlistLib.Menu[i].Entry[j].ListEntry);
+		  PCB->NetlistLib.Menu[i].Entry[j].ListEntry =
+		    (char *)malloc ((strlen (new_ref) + strlen (pin) +
+			     2) * sizeof (char));
+		  sprintf (PCB->NetlistLib.Menu[i].Entry[j].ListEntry,
+			   "%s-%s", new_ref, pin);
 		}
 	      free (tmps);
 	    }
 	}
+      g_hash_table_destroy (renamed);
       for (k = 0; k < c_cnt; k++)
 	{
 	  free (was[k]);
@@ -3611,9 +3576,9 @@ ActionRenumber (int argc, char **argv, Coord x, Coord y)
       SetChangedFlag (true);
     }
 
-  free (locked_element_list);
+  g_hash_table_destroy (locked);
+  g_hash_table_destroy (cnt_list);
   free (element_list);
-  free (cnt_list);
   free (is);
   free (was);
   return 0;
@@ -3751,7 +3716,7 @@ ActionRipUp (int argc, char **argv, Coord x, Coord y)
 
 /* --------------------------------------------------------------------------- */
 
-static const char addrats_syntax[] = N_("AddRats(AllRats|SelectedRats|Close)");
+static const char addrats_syntax[] = N_("AddRats(AllRats|SelectedRats|Changed|Close)");
 
 static const char addrats_help[] =
   N_("Add one or more rat lines to the board.");
@@ -3768,6 +3733,11 @@ with copper.
 Similarly, but only add rat lines for nets connected to selected pins
 and pads.
 
+@item Changed
+Remove and add again the rat lines of the nets touched by the changes
+since the last @code{AddRats(Changed)}.  The first time, and after a
+new netlist, this is done for all nets.
+
 @item Close
 Selects the shortest unselected rat on the board.
 
@@ -3775,12 +3745,23 @@ Selects the shortest unselected rat on the board.
 
 %end-doc */
 
+/*!
+ * \brief Add the rats of all, or with *data the selected, connections,
+ * as a job of ActionAddRats().
+ */
+static int
+addrats_job (void *data)
+{
+  return AddAllRats (*(bool *) data, NULL);
+}
+
 static int
 ActionAddRats (int argc, char **argv, Coord x, Coord y)
 {
   char *function = ARG (0);
   RatType *shorty;
   float len, small;
+  bool selected;
 
   if (function)
     {
@@ -3789,14 +3770,19 @@ ActionAddRats (int argc, char **argv, Coord x, Coord y)
       switch (GetFunctionID (function))
 	{
 	case F_AllRats:
-	  if (AddAllRats (false, NULL))
-	    SetChangedFlag (true);
-	  break;
 	case F_SelectedRats:
 	case F_Selected:
-	  if (AddAllRats (true, NULL))
+	  selected = GetFunctionID (function) != F_AllRats;
+	  if (pcb_job_run (_("Adding rats"), addrats_job, &selected))
 	    SetChangedFlag (true);
 	  break;
+	case F_Changed:
+	  if (AddChangedRats ())
+	    {
+	      SetChangedFlag (true);
+	      IncrementUndoSerialNumber ();
+	    }
+	  break;
 	case F_Close:
 	  small = SQUARE (MAX_COORD);
 	  shorty = NULL;
@@ -3943,7 +3929,7 @@ ActionAutoPlaceSelected (int argc, char **argv, Coord x, Coord y)
 
 /* --------------------------------------------------------------------------- */
 
-static const char autoroute_syntax[] = N_("AutoRoute(AllRats|SelectedRats)");
+static const char autoroute_syntax[] = N_("AutoRoute(AllRats|SelectedRats[,Resume])");
 
 static const char autoroute_help[] = N_("Auto-route some or all rat lines.");
 
@@ -3957,6 +3943,12 @@ Attempt to autoroute all rats.
 @item SelectedRats
 Attempt to autoroute the selected rats.
 
+@item Resume
+Given as the second argument, pick the routing up again from the file
+of @code{--autoroute-checkpoint}, which the autorouter writes at the end
+of every pass.  The board and the rats to route have to be the same as
+when it was written.
+
 @end table
 
 Before autorouting, it's important to set up a few things.  First,
@@ -3970,25 +3962,53 @@ responsive.
 
 %end-doc */
 
+typedef struct
+{
+  bool selected;
+  bool resume;
+} AutoRouteArgs;
+
+/*!
+ * \brief Run the autorouter, as a job of ActionAutoRoute().
+ */
+static int
+autoroute_job (void *data)
+{
+  AutoRouteArgs *args = (AutoRouteArgs *) data;
+
+  return AutoRoute (args->selected, args->resume);
+}
+
 static int
 ActionAutoRoute (int argc, char **argv, Coord x, Coord y)
 {
   char *function = ARG (0);
+  AutoRouteArgs args;
+  bool changed;
+
+  args.resume = ARG (1) && GetFunctionID (ARG (1)) == F_Resume;
   hid_action("Busy");
   if (function)			/* one parameter */
     {
       switch (GetFunctionID (function))
 	{
 	case F_AllRats:
-	  if (AutoRoute (false))
-	    SetChangedFlag (true);
+	  args.selected = false;
 	  break;
 	case F_SelectedRats:
 	case F_Selected:
-	  if (AutoRoute (true))
-	    SetChangedFlag (true);
+	  args.selected = true;
 	  break;
+	default:
+	  return 0;
 	}
+      /* live routing is drawn as it goes, so it stays on this thread */
+      if (TEST_FLAG (LIVEROUTEFLAG, PCB))
+	changed = autoroute_job (&args);
+      else
+	changed = pcb_job_run (_("Autorouting"), autoroute_job, &args);
+      if (changed)
+	SetChangedFlag (true);
     }
   return 0;
 }
@@ -5341,9 +5361,9 @@ static const char select_syntax[] =
   N_("Select(Object|ToggleObject)\n"
   "Select(All|Block|Connection|BuriedVias)\n"
   "Select(ElementByName|ObjectByName|PadByName|PinByName)\n"
-  "Select(ElementByName|ObjectByName|PadByName|PinByName, Name)\n"
+  "Select(ElementByName|ObjectByName|PadByName|PinByName, Name[, Name...])\n"
   "Select(TextByName|ViaByName|NetByName)\n"
-  "Select(TextByName|ViaByName|NetByName, Name)\n"
+  "Select(TextByName|ViaByName|NetByName, Name[, Name...])\n"
   "Select(Convert)");
 
 static const char select_help[] = N_("Toggles or sets the selection.");
@@ -5363,7 +5383,10 @@ static const char select_help[] = N_("Toggles or sets the selection.");
 These all rely on having a regular expression parser built into
 @code{pcb}.  If the name is not specified then the user is prompted
 for a pattern, and all objects that match the pattern and are of the
-type specified are selected.
+type specified are selected.  Any number of patterns may be given, and
+the objects that match any of them are selected together, as one
+undoable operation.  This is a lot quicker than selecting each pattern
+in turn when a script selects many names.
 
 @item Object
 @item ToggleObject
@@ -5429,9 +5452,14 @@ ActionSelect (int argc, char **argv, Coord x, Coord y)
 	  {
 	    char *pattern = ARG (1);
 
-	    if (pattern
-		|| (pattern =
-		    gui->prompt_for (_("Enter pattern:"), "")) != NULL)
+	    if (argc > 2)
+	      {
+		if (SelectObjectsByName (type, argv + 1, argc - 1, true))
+		  SetChangedFlag (true);
+	      }
+	    else if (pattern
+		     || (pattern =
+			 gui->prompt_for (_("Enter pattern:"), "")) != NULL)
 	      {
 		if (SelectObjectByName (type, pattern, true))
 		  SetChangedFlag (true);
@@ -5560,9 +5588,9 @@ FlagHaveRegex (int parm)
 static const char unselect_syntax[] =
   N_("Unselect(All|Block|Connection)\n"
   "Unselect(ElementByName|ObjectByName|PadByName|PinByName)\n"
-  "Unselect(ElementByName|ObjectByName|PadByName|PinByName, Name)\n"
-  "Unselect(TextByName|ViaByName)\n"
-  "Unselect(TextByName|ViaByName, Name)\n");
+  "Unselect(ElementByName|ObjectByName|PadByName|PinByName, Name[, Name...])\n"
+  "Unselect(TextByName|ViaByName|NetByName)\n"
+  "Unselect(TextByName|ViaByName|NetByName, Name[, Name...])\n");
 
 static const char unselect_help[] =
   N_("Unselects the object at the pointer location or the specified objects.");
@@ -5586,11 +5614,13 @@ Unselect all connections with the ``found'' flag set.
 @item PinByName
 @item TextByName
 @item ViaByName
+@item NetByName
 
 These all rely on having a regular expression parser built into
 @code{pcb}.  If the name is not specified then the user is prompted
 for a pattern, and all objects that match the pattern and are of the
-type specified are unselected.
+type specified are unselected.  As with @code{Select}, any number of
+patterns may be given.
 
 
 @end table
@@ -5634,9 +5664,14 @@ ActionUnselect (int argc, char **argv, Coord x, Coord y)
 	  {
 	    char *pattern = ARG (1);
 
-	    if (pattern
-		|| (pattern =
-		    gui->prompt_for (_("Enter pattern:"), "")) != NULL)
+	    if (argc > 2)
+	      {
+		if (SelectObjectsByName (type, argv + 1, argc - 1, false))
+		  SetChangedFlag (true);
+	      }
+	    else if (pattern
+		     || (pattern =
+			 gui->prompt_for (_("Enter pattern:"), "")) != NULL)
 	      {
 		if (SelectObjectByName (type, pattern, false))
 		  SetChangedFlag (true);
@@ -6904,6 +6939,9 @@ static const char executefile_help[] = N_("Run actions from the given file.");
 
 Lines starting with @code{#} are ignored.
 
+The whole file is read and parsed before the first action runs.  A
+failing action skips the rest of its line.
+
 %end-doc */
 
 static int
@@ -6914,6 +6952,7 @@ ActionExecuteFile (int argc, char **argv, Coord x, Coord y)
   char line[256];
   int n = 0;
   char *sp;
+  HID_ActionScript *script = NULL;
 
   if (argc != 1)
     AFAIL (executefile);
@@ -6926,8 +6965,7 @@ ActionExecuteFile (int argc, char **argv, Coord x, Coord y)
       return 1;
     }
 
-  defer_updates = 1;
-  defer_needs_update = 0;
+  /* parse the whole file first, then run it */
   while (fgets (line, sizeof (line), fp) != NULL)
     {
       n++;
@@ -6951,9 +6989,18 @@ ActionExecuteFile (int argc, char **argv, Coord x, Coord y)
       if (*sp && *sp != '#')
 	{
 	  /*Message ("%s : line %-3d : \"%s\"\n", fname, n, sp);*/
-	  hid_parse_actions (sp);
+	  script = hid_compile_actions (script, sp);
 	}
     }
+  fclose (fp);
+
+  defer_updates = 1;
+  defer_needs_update = 0;
+  if (script)
+    {
+      hid_run_actions (script);
+      hid_free_actions (script);
+    }
 
   defer_updates = 0;
   if (defer_needs_update)
@@ -6961,7 +7008,6 @@ ActionExecuteFile (int argc, char **argv, Coord x, Coord y)
       IncrementUndoSerialNumber ();
       gui->invalidate_all ();
     }
-  fclose (fp);
   return 0;
 }
 
@@ -7229,11 +7275,9 @@ ActionElementList (int argc, char **argv, Coord x, Coord y)
   e = find_element_by_refdes (refdes);
 
   old = ChangeElementText (PCB, PCB->Data, e, NAMEONPCB_INDEX, strdup (refdes));
-  if (old)
-    free(old);
+  ReleaseString (old);
   old = ChangeElementText (PCB, PCB->Data, e, VALUE_INDEX, strdup (value));
-  if (old)
-    free(old);
+  ReleaseString (old);
 
   SET_FLAG (FOUNDFLAG, e);
 
@@ -7295,8 +7339,8 @@ ActionElementSetAttr (int argc, char **argv, Coord x, Coord y)
 
   if (attr && value)
     {
-      free (attr->value);
-      attr->value = strdup (value);
+      ReleaseString (attr->value);
+      attr->value = ShareString (value);
     }
   if (attr && ! value)
     {
@@ -7367,8 +7411,8 @@ pcb_spawnvp (char **argv)
   else
     {
       int rv;
-      /* Parent */
-      wait (&rv);
+      /* Parent.  Wait for this child only, not for an autosave one. */
+      waitpid (pid, &rv, 0);
     }
   return 0;
 #endif
@@ -54,6 +54,7 @@
 #include "draw.h"
 #include "error.h"
 #include "intersect.h"
+#include "job.h"
 #include "rtree.h"
 #include "macro.h"
 #include "mirror.h"
@@ -150,6 +151,33 @@ PerturbationType;
  * some local identifiers
  */
 
+/*!
+ * \brief Update the X, Y and group position information of a connection
+ * after its element has possibly been moved, rotated, flipped, etc.
+ */
+static void
+UpdateConnectionXY (ConnectionType *c, Cardinal top_group,
+		    Cardinal bottom_group)
+{
+  switch (c->type)
+    {
+    case PAD_TYPE:
+      c->group = TEST_FLAG (ONSOLDERFLAG, (ElementType *) c->ptr1)
+		  ? bottom_group : top_group;
+      c->X = ((PadType *) c->ptr2)->Point1.X;
+      c->Y = ((PadType *) c->ptr2)->Point1.Y;
+      break;
+    case PIN_TYPE:
+      c->group = bottom_group;  /* any layer will do */
+      c->X = ((PinType *) c->ptr2)->X;
+      c->Y = ((PinType *) c->ptr2)->Y;
+      break;
+    default:
+      Message ("Odd connection type encountered in " "UpdateXY");
+      break;
+    }
+}
+
 /*!
  * \brief Update the X, Y and group position information stored in the
  * NetList after elements have possibly been moved, rotated, flipped,
@@ -165,29 +193,9 @@ UpdateXY (NetListType *Nets)
   bottom_group = GetLayerGroupNumberBySide (BOTTOM_SIDE);
   /* update all nets */
   for (i = 0; i < Nets->NetN; i++)
-    {
-      for (j = 0; j < Nets->Net[i].ConnectionN; j++)
-	{
-	  ConnectionType *c = &(Nets->Net[i].Connection[j]);
-	  switch (c->type)
-	    {
-	    case PAD_TYPE:
-	      c->group = TEST_FLAG (ONSOLDERFLAG, (ElementType *) c->ptr1)
-	                  ? bottom_group : top_group;
-	      c->X = ((PadType *) c->ptr2)->Point1.X;
-	      c->Y = ((PadType *) c->ptr2)->Point1.Y;
-	      break;
-	    case PIN_TYPE:
-	      c->group = bottom_group;  /* any layer will do */
-	      c->X = ((PinType *) c->ptr2)->X;
-	      c->Y = ((PinType *) c->ptr2)->Y;
-	      break;
-	    default:
-	      Message ("Odd connection type encountered in " "UpdateXY");
-	      break;
-	    }
-	}
-    }
+    for (j = 0; j < Nets->Net[i].ConnectionN; j++)
+      UpdateConnectionXY (&(Nets->Net[i].Connection[j]), top_group,
+			  bottom_group);
 }
 
 /*!
@@ -340,6 +348,211 @@ r_find_neighbor (rtree_t * rtree, const BoxType * box,
   return ni.neighbor;
 }
 
+/*!
+ * \brief Work out the bounds of the connections of a net and their wire
+ * cost.
+ *
+ * The wire length is approximated by the half-perimeter of the minimum
+ * rectangle enclosing the net.  Note that we penalize vias in all-SMD
+ * nets by making the rectangle a cube and weighting the "layer height"
+ * of the net.
+ *
+ * \return false for a net of less than two connections, which costs
+ * nothing.
+ */
+static bool
+NetBounds (NetType *n, BoxType *box, double *cost)
+{
+  Coord minx, maxx, miny, maxy;
+  bool allpads, allsameside;
+  Cardinal thegroup;
+  Cardinal j;
+
+  if (n->ConnectionN < 2)
+    return false;		/* no cost to go nowhere */
+  minx = maxx = n->Connection[0].X;
+  miny = maxy = n->Connection[0].Y;
+  thegroup = n->Connection[0].group;
+  allpads = (n->Connection[0].type == PAD_TYPE);
+  allsameside = true;
+  for (j = 1; j < n->ConnectionN; j++)
+    {
+      ConnectionType *c = &(n->Connection[j]);
+      MAKEMIN (minx, c->X);
+      MAKEMAX (maxx, c->X);
+      MAKEMIN (miny, c->Y);
+      MAKEMAX (maxy, c->Y);
+      if (c->type != PAD_TYPE)
+	allpads = false;
+      if (c->group != thegroup)
+	allsameside = false;
+    }
+  box->X1 = minx;
+  box->Y1 = miny;
+  box->X2 = maxx;
+  box->Y2 = maxy;
+  *cost = COORD_TO_MIL(maxx - minx) + COORD_TO_MIL(maxy - miny) +
+    ((allpads && !allsameside) ? CostParameter.via_cost : 0);
+  return true;
+}
+
+/*!
+ * \brief Work out the module area of an element: the bounding rect of
+ * its pins/pads.
+ *
+ * A box for each pin is added to \p pins for the opposite side: surface
+ * mount components can't sit on top of pins.
+ *
+ * \return false for an element with no pins/pads.
+ */
+static bool
+ModuleBoxes (ElementType *element, BoxType *box, BoxListType *pins)
+{
+  BoxType *lastbox;
+  Cardinal last = 0;
+  Coord thickness;
+  Coord clearance;
+
+  /* protect against elements with no pins/pads */
+  if (element->PinN == 0 && element->PadN == 0)
+    return false;
+  /* initialize box so that it will take the dimensions of
+   * the first pin/pad */
+  box->X1 = MAX_COORD;
+  box->Y1 = MAX_COORD;
+  box->X2 = -MAX_COORD;
+  box->Y2 = -MAX_COORD;
+  PIN_LOOP (element);
+  {
+    thickness = pin->Thickness / 2;
+    clearance = pin->Clearance * 2;
+    EXPANDRECTXY (box,
+		  pin->X - (thickness + clearance),
+		  pin->Y - (thickness + clearance),
+		  pin->X + (thickness + clearance),
+		  pin->Y + (thickness + clearance));
+  }
+  END_LOOP;
+  PAD_LOOP (element);
+  {
+    thickness = pad->Thickness / 2;
+    clearance = pad->Clearance * 2;
+    EXPANDRECTXY (box,
+		  MIN (pad->Point1.X, pad->Point2.X) - (thickness + clearance),
+		  MIN (pad->Point1.Y, pad->Point2.Y) - (thickness + clearance),
+		  MAX (pad->Point1.X, pad->Point2.X) + (thickness + clearance),
+		  MAX (pad->Point1.Y, pad->Point2.Y) + (thickness + clearance));
+  }
+  END_LOOP;
+  if (CostParameter.fast)
+    return true;
+  PIN_LOOP (element);
+  {
+    BoxType *pinbox = GetBoxMemory (pins);
+    thickness = pin->Thickness / 2;
+    clearance = pin->Clearance * 2;
+    /* we ignore clearance here */
+    /* (otherwise pins don't fit next to each other) */
+    pinbox->X1 = pin->X - thickness;
+    pinbox->Y1 = pin->Y - thickness;
+    pinbox->X2 = pin->X + thickness;
+    pinbox->Y2 = pin->Y + thickness;
+    /* speed hack! coalesce with last box if we can.  (The last box is
+     * kept by index, as GetBoxMemory() may move the list.) */
+    lastbox = last ? &pins->Box[last - 1] : NULL;
+    if (lastbox != NULL &&
+	((lastbox->X1 == pinbox->X1 &&
+	  lastbox->X2 == pinbox->X2 &&
+	  MIN (abs (lastbox->Y1 - pinbox->Y2),
+	       abs (pinbox->Y1 - lastbox->Y2)) < clearance) ||
+	 (lastbox->Y1 == pinbox->Y1 &&
+	  lastbox->Y2 == pinbox->Y2 &&
+	  MIN (abs (lastbox->X1 - pinbox->X2),
+	       abs (pinbox->X1 - lastbox->X2)) < clearance)))
+      {
+	EXPANDRECT (lastbox, pinbox);
+	pins->BoxN--;
+      }
+    else
+      last = pins->BoxN;
+  }
+  END_LOOP;
+  return true;
+}
+
+static bool
+OutOfBounds (ElementType *element)
+{
+  return element->VBox.X1 < 0 ||
+    element->VBox.Y1 < 0 ||
+    element->VBox.X2 > PCB->MaxWidth || element->VBox.Y2 > PCB->MaxHeight;
+}
+
+/*!
+ * \brief Bonus for the neighbor of an element: score higher if it
+ * belongs to the same *type* of component, is aligned with it or has the
+ * same rotation.
+ */
+static double
+NeighborBonus (ElementType *element, ElementType *neighbor)
+{
+  double bonus = 0;
+  int factor = 1;
+
+  if (element->Name[0].TextString &&
+      neighbor->Name[0].TextString &&
+      0 == NSTRCMP (element->Name[0].TextString,
+		    neighbor->Name[0].TextString))
+    {
+      bonus += CostParameter.matching_neighbor_bonus;
+      factor++;
+    }
+  if (element->Name[0].Direction == neighbor->Name[0].Direction)
+    bonus += factor * CostParameter.oriented_neighbor_bonus;
+  if (element->VBox.X1 == neighbor->VBox.X1 ||
+      element->VBox.X1 == neighbor->VBox.X2 ||
+      element->VBox.X2 == neighbor->VBox.X1 ||
+      element->VBox.X2 == neighbor->VBox.X2 ||
+      element->VBox.Y1 == neighbor->VBox.Y1 ||
+      element->VBox.Y1 == neighbor->VBox.Y2 ||
+      element->VBox.Y2 == neighbor->VBox.Y1 ||
+      element->VBox.Y2 == neighbor->VBox.Y2)
+    bonus += factor * CostParameter.aligned_neighbor_bonus;
+  return bonus;
+}
+
+/*!
+ * \brief Penalize total area used by this layout.
+ */
+static double
+AreaPenalty (void)
+{
+  Coord minX = MAX_COORD, minY = MAX_COORD;
+  Coord maxX = -MAX_COORD, maxY = -MAX_COORD;
+  ELEMENT_LOOP (PCB->Data);
+  {
+    MAKEMIN (minX, element->VBox.X1);
+    MAKEMIN (minY, element->VBox.Y1);
+    MAKEMAX (maxX, element->VBox.X2);
+    MAKEMAX (maxY, element->VBox.Y2);
+  }
+  END_LOOP;
+  if (minX < maxX && minY < maxY)
+    return CostParameter.overall_area_penalty *
+      sqrt (COORD_TO_MIL (maxX - minX) * COORD_TO_MIL (maxY - minY));
+  return 0;
+}
+
+/*!
+ * \brief Weight of the module overlap area at temperature \p T.
+ */
+static double
+OverlapPenalty (double T0, double T)
+{
+  return CostParameter.overlap_penalty_min +
+    (1 - (T / T0)) * CostParameter.overlap_penalty_max;
+}
+
 /*!
  * \brief Compute cost function.
  *
@@ -359,52 +572,23 @@ ComputeCost (NetListType *Nets, double T0, double T)
   double delta3 = 0;		/* out of bounds penalty */
   double delta4 = 0;		/* alignment bonus */
   double delta5 = 0;		/* total area penalty */
-  Cardinal i, j;
-  Coord minx, maxx, miny, maxy;
-  bool allpads, allsameside;
-  Cardinal thegroup;
+  Cardinal i;
   BoxListType bounds = { 0, 0, NULL };	/* save bounding rectangles here */
   BoxListType solderside = { 0, 0, NULL };	/* solder side component bounds */
   BoxListType componentside = { 0, 0, NULL };	/* component side bounds */
   /* make sure the NetList have the proper updated X and Y coords */
   UpdateXY (Nets);
-  /* wire length term.  approximated by half-perimeter of minimum
-   * rectangle enclosing the net.  Note that we penalize vias in
-   * all-SMD nets by making the rectangle a cube and weighting
-   * the "layer height" of the net. */
+  /* wire length term. */
   for (i = 0; i < Nets->NetN; i++)
     {
-      NetType *n = &Nets->Net[i];
-      if (n->ConnectionN < 2)
-	continue;		/* no cost to go nowhere */
-      minx = maxx = n->Connection[0].X;
-      miny = maxy = n->Connection[0].Y;
-      thegroup = n->Connection[0].group;
-      allpads = (n->Connection[0].type == PAD_TYPE);
-      allsameside = true;
-      for (j = 1; j < n->ConnectionN; j++)
-	{
-	  ConnectionType *c = &(n->Connection[j]);
-	  MAKEMIN (minx, c->X);
-	  MAKEMAX (maxx, c->X);
-	  MAKEMIN (miny, c->Y);
-	  MAKEMAX (maxy, c->Y);
-	  if (c->type != PAD_TYPE)
-	    allpads = false;
-	  if (c->group != thegroup)
-	    allsameside = false;
-	}
+      BoxType box;
+      double cost;
+      if (!NetBounds (&Nets->Net[i], &box, &cost))
+	continue;
       /* save bounding rectangle */
-      {
-	BoxType *box = GetBoxMemory (&bounds);
-	box->X1 = minx;
-	box->Y1 = miny;
-	box->X2 = maxx;
-	box->Y2 = maxy;
-      }
+      *GetBoxMemory (&bounds) = box;
       /* okay, add half-perimeter to cost! */
-      W += COORD_TO_MIL(maxx - minx) + COORD_TO_MIL(maxy - miny) +
-	((allpads && !allsameside) ? CostParameter.via_cost : 0);
+      W += cost;
     }
   /* now compute penalty function Wc which is proportional to
    * amount of overlap and congestion. */
@@ -424,9 +608,6 @@ ComputeCost (NetListType *Nets, double T0, double T)
     BoxListType *thisside;
     BoxListType *otherside;
     BoxType *box;
-    BoxType *lastbox = NULL;
-    Coord thickness;
-    Coord clearance;
     if (TEST_FLAG (ONSOLDERFLAG, element))
       {
 	thisside = &solderside;
@@ -438,89 +619,20 @@ ComputeCost (NetListType *Nets, double T0, double T)
 	otherside = &solderside;
       }
     box = GetBoxMemory (thisside);
-    /* protect against elements with no pins/pads */
-    if (element->PinN == 0 && element->PadN == 0)
-      continue;
-    /* initialize box so that it will take the dimensions of
-     * the first pin/pad */
-    box->X1 = MAX_COORD;
-    box->Y1 = MAX_COORD;
-    box->X2 = -MAX_COORD;
-    box->Y2 = -MAX_COORD;
-    PIN_LOOP (element);
-    {
-      thickness = pin->Thickness / 2;
-      clearance = pin->Clearance * 2;
-    EXPANDRECTXY (box,
-		    pin->X - (thickness + clearance),
-		    pin->Y - (thickness + clearance),
-		    pin->X + (thickness + clearance),
-		    pin->Y + (thickness + clearance))}
-    END_LOOP;
-    PAD_LOOP (element);
-    {
-      thickness = pad->Thickness / 2;
-      clearance = pad->Clearance * 2;
-    EXPANDRECTXY (box,
-		    MIN (pad->Point1.X,
-			   pad->Point2.X) - (thickness +
-					       clearance),
-		    MIN (pad->Point1.Y,
-			   pad->Point2.Y) - (thickness +
-					       clearance),
-		    MAX (pad->Point1.X,
-			   pad->Point2.X) + (thickness +
-					       clearance),
-		    MAX (pad->Point1.Y,
-			   pad->Point2.Y) + (thickness + clearance))}
-    END_LOOP;
-    /* add a box for each pin to the "opposite side":
-     * surface mount components can't sit on top of pins */
-    if (!CostParameter.fast)
-      PIN_LOOP (element);
-    {
-      box = GetBoxMemory (otherside);
-      thickness = pin->Thickness / 2;
-      clearance = pin->Clearance * 2;
-      /* we ignore clearance here */
-      /* (otherwise pins don't fit next to each other) */
-      box->X1 = pin->X - thickness;
-      box->Y1 = pin->Y - thickness;
-      box->X2 = pin->X + thickness;
-      box->Y2 = pin->Y + thickness;
-      /* speed hack! coalesce with last box if we can */
-      if (lastbox != NULL &&
-	  ((lastbox->X1 == box->X1 &&
-	    lastbox->X2 == box->X2 &&
-	    MIN (abs (lastbox->Y1 - box->Y2),
-		 abs (box->Y1 - lastbox->Y2)) <
-	    clearance) || (lastbox->Y1 == box->Y1
-			   && lastbox->Y2 == box->Y2
-			   &&
-			   MIN (abs
-				(lastbox->X1 -
-				 box->X2),
-				abs (box->X1 - lastbox->X2)) < clearance)))
-	{
-	  EXPANDRECT (lastbox, box);
-	  otherside->BoxN--;
-	}
-      else
-	lastbox = box;
-    }
-    END_LOOP;
+    if (!ModuleBoxes (element, box, otherside))
+      {
+	thisside->BoxN--;
+	continue;
+      }
     /* assess out of bounds penalty */
-    if (element->VBox.X1 < 0 ||
-	element->VBox.Y1 < 0 ||
-	element->VBox.X2 > PCB->MaxWidth || element->VBox.Y2 > PCB->MaxHeight)
+    if (OutOfBounds (element))
       delta3 += CostParameter.out_of_bounds_penalty;
   }
   END_LOOP;
   /* compute intersection area of module areas box list */
   delta2 = sqrt (fabs (ComputeIntersectionArea (&solderside) +
 		       ComputeIntersectionArea (&componentside))) *
-    (CostParameter.overlap_penalty_min +
-     (1 - (T / T0)) * CostParameter.overlap_penalty_max);
+    OverlapPenalty (T0, T);
 #if 0
   printf ("Module Overlap Area (solder): %f\n",
 	  ComputeIntersectionArea (&solderside));
@@ -530,7 +642,6 @@ ComputeCost (NetListType *Nets, double T0, double T)
   FreeBoxListMemory (&solderside);
   FreeBoxListMemory (&componentside);
   /* reward pin/pad x/y alignment */
-  /* score higher if pins/pads belong to same *type* of component */
   /* XXX: subkey should be *distance* from thing aligned with, so that
    * aligning to something far away isn't profitable */
   {
@@ -547,7 +658,6 @@ ComputeCost (NetListType *Nets, double T0, double T)
     direction_t dir[4] = { NORTH, EAST, SOUTH, WEST };
     struct ebox **boxpp, *boxp;
     rtree_t *rt_s, *rt_c;
-    int factor;
     ELEMENT_LOOP (PCB->Data);
     {
       boxpp = (struct ebox **)
@@ -577,50 +687,15 @@ ComputeCost (NetListType *Nets, double T0, double T)
 	r_find_neighbor (TEST_FLAG (ONSOLDERFLAG, element) ?
 			 rt_s : rt_c, &element->VBox, dir[i]);
       /* score bounding box alignments */
-      if (!boxp)
-	continue;
-      factor = 1;
-      if (element->Name[0].TextString &&
-	  boxp->element->Name[0].TextString &&
-	  0 == NSTRCMP (element->Name[0].TextString,
-			boxp->element->Name[0].TextString))
-	{
-	  delta4 += CostParameter.matching_neighbor_bonus;
-	  factor++;
-	}
-      if (element->Name[0].Direction == boxp->element->Name[0].Direction)
-	delta4 += factor * CostParameter.oriented_neighbor_bonus;
-      if (element->VBox.X1 == boxp->element->VBox.X1 ||
-	  element->VBox.X1 == boxp->element->VBox.X2 ||
-	  element->VBox.X2 == boxp->element->VBox.X1 ||
-	  element->VBox.X2 == boxp->element->VBox.X2 ||
-	  element->VBox.Y1 == boxp->element->VBox.Y1 ||
-	  element->VBox.Y1 == boxp->element->VBox.Y2 ||
-	  element->VBox.Y2 == boxp->element->VBox.Y1 ||
-	  element->VBox.Y2 == boxp->element->VBox.Y2)
-	delta4 += factor * CostParameter.aligned_neighbor_bonus;
+      if (boxp)
+	delta4 += NeighborBonus (element, boxp->element);
     }
     END_LOOP;
     /* free k-d tree memory */
     r_destroy_tree (&rt_s);
     r_destroy_tree (&rt_c);
   }
-  /* penalize total area used by this layout */
-  {
-    Coord minX = MAX_COORD, minY = MAX_COORD;
-    Coord maxX = -MAX_COORD, maxY = -MAX_COORD;
-    ELEMENT_LOOP (PCB->Data);
-    {
-      MAKEMIN (minX, element->VBox.X1);
-      MAKEMIN (minY, element->VBox.Y1);
-      MAKEMAX (maxX, element->VBox.X2);
-      MAKEMAX (maxY, element->VBox.Y2);
-    }
-    END_LOOP;
-    if (minX < maxX && minY < maxY)
-      delta5 = CostParameter.overall_area_penalty *
-	sqrt (COORD_TO_MIL (maxX - minX) * COORD_TO_MIL (maxY - minY));
-  }
+  delta5 = AreaPenalty ();
   if (T == 5)
     {
       T = W + delta1 + delta2 + delta3 - delta4 + delta5;
@@ -772,6 +847,569 @@ doPerturb (PerturbationType * pt, bool undo)
     }
 }
 
+/* ---------------------------------------------------------------------------
+ * Incremental cost.
+ *
+ * ComputeCost() works the cost of a placement out from scratch, which
+ * takes a long while on a board of a few hundred elements.  While
+ * annealing, the terms of the cost are kept in a PlaceState instead, and
+ * a move only works out again those of the nets, module areas and
+ * neighbors of the elements it moves.
+ *
+ * The overlap areas are kept up to date box by box: the overlap of a set
+ * of boxes grows by the part of a new box that the others already cover,
+ * and shrinks by as much when a box is taken out.
+ */
+typedef struct place_element
+{
+  BoxType vbox;			/* copy of VBox in the neighbor tree, first */
+  ElementType *element;
+  int side;			/* 1 on the solder side */
+  GArray *nets;			/* indexes of the nets it is on */
+  bool has_module;
+  BoxType module;		/* module area, on the side of the element */
+  BoxListType pins;		/* pin boxes on the other side */
+  bool oob;
+  struct place_element *neighbor[4];
+  double bonus[4];
+  unsigned mark;
+}
+PlaceElement;
+
+typedef struct
+{
+  BoxType box;			/* bounds of the connections */
+  double cost;
+  bool used;			/* two connections or more */
+  unsigned mark;
+}
+PlaceNet;
+
+typedef struct
+{
+  NetListType *Nets;
+  PlaceNet *net;
+  PlaceElement *element;
+  Cardinal elementN;
+  GHashTable *index;		/* ElementType * to PlaceElement * */
+  rtree_t *nettree;
+  rtree_t *moduletree[2];	/* component side, solder side */
+  rtree_t *neighbortree[2];
+  GArray *touched;		/* nets of the elements being moved */
+  Cardinal top_group, bottom_group;
+  unsigned mark;
+  /* the terms of ComputeCost() */
+  double wire, congestion, overlap, oob, align;
+}
+PlaceState;
+
+static const direction_t place_dir[4] = { NORTH, EAST, SOUTH, WEST };
+
+struct covered_info
+{
+  const BoxType *box;
+  BoxListType clipped;
+};
+
+static int
+covered_cb (const BoxType * b, void *cl)
+{
+  struct covered_info *ci = (struct covered_info *) cl;
+  BoxType *c;
+
+  if (b->X2 <= ci->box->X1 || b->X1 >= ci->box->X2 ||
+      b->Y2 <= ci->box->Y1 || b->Y1 >= ci->box->Y2)
+    return 0;
+  c = GetBoxMemory (&ci->clipped);
+  c->X1 = MAX (b->X1, ci->box->X1);
+  c->Y1 = MAX (b->Y1, ci->box->Y1);
+  c->X2 = MIN (b->X2, ci->box->X2);
+  c->Y2 = MIN (b->Y2, ci->box->Y2);
+  return 1;
+}
+
+/*!
+ * \brief Area of \p box covered by the boxes in \p tree, in the units of
+ * ComputeIntersectionArea().
+ */
+static double
+CoveredArea (rtree_t * tree, const BoxType * box)
+{
+  struct covered_info ci;
+  double area;
+
+  /* the bounds of a net can be a line, or a point */
+  if (box->X1 >= box->X2 || box->Y1 >= box->Y2)
+    return 0;
+  ci.box = box;
+  ci.clipped.BoxN = ci.clipped.BoxMax = 0;
+  ci.clipped.Box = NULL;
+  r_search (tree, box, NULL, covered_cb, &ci);
+  area = ComputeUnionArea (&ci.clipped);
+  FreeBoxListMemory (&ci.clipped);
+  return area;
+}
+
+/*!
+ * \brief Add a box to a tree.
+ *
+ * \return the overlap area it adds.
+ */
+static double
+TreeAdd (rtree_t * tree, const BoxType * box)
+{
+  double area = CoveredArea (tree, box);
+  r_insert_entry (tree, box, 0);
+  return area;
+}
+
+/*!
+ * \brief Take a box out of a tree.
+ *
+ * \return the overlap area it takes away.
+ */
+static double
+TreeRemove (rtree_t * tree, const BoxType * box)
+{
+  r_delete_entry (tree, box);
+  return CoveredArea (tree, box);
+}
+
+/*!
+ * \brief Whether r_find_neighbor() looks at \p other when it finds the
+ * neighbor of \p box in direction \p dir, that is whether it lies in its
+ * trapezoid.
+ */
+static bool
+InNeighborTrap (const BoxType * box, const BoxType * other,
+		direction_t dir)
+{
+  BoxType bbox, trap = *box, query = *other;
+
+  bbox.X1 = bbox.Y1 = 0;
+  bbox.X2 = PCB->MaxWidth;
+  bbox.Y2 = PCB->MaxHeight;
+  ROTATEBOX_TO_NORTH (bbox, dir);
+  ROTATEBOX_TO_NORTH (trap, dir);
+  ROTATEBOX_TO_NORTH (query, dir);
+  trap.Y2 = trap.Y1;
+  trap.Y1 = bbox.Y1;
+  return (query.Y2 > trap.Y1) && (query.Y1 < trap.Y2) &&
+    (query.X2 + trap.Y2 > trap.X1 + query.Y1) &&
+    (query.X1 + query.Y1 < trap.X2 + trap.Y2) && (query.Y2 <= trap.Y2);
+}
+
+static void
+FindNeighbor (PlaceState * s, PlaceElement * pe, int d)
+{
+  PlaceElement *n = (PlaceElement *)
+    r_find_neighbor (s->neighbortree[pe->side], &pe->vbox, place_dir[d]);
+
+  s->align -= pe->bonus[d];
+  pe->neighbor[d] = n;
+  pe->bonus[d] = n ? NeighborBonus (pe->element, n->element) : 0;
+  s->align += pe->bonus[d];
+}
+
+static void
+NetAdd (PlaceState * s, Cardinal i)
+{
+  NetType *n = &s->Nets->Net[i];
+  PlaceNet *pn = &s->net[i];
+  Cardinal j;
+
+  for (j = 0; j < n->ConnectionN; j++)
+    UpdateConnectionXY (&n->Connection[j], s->top_group, s->bottom_group);
+  pn->used = NetBounds (n, &pn->box, &pn->cost);
+  if (!pn->used)
+    return;
+  s->wire += pn->cost;
+  s->congestion += TreeAdd (s->nettree, &pn->box);
+}
+
+static void
+NetRemove (PlaceState * s, Cardinal i)
+{
+  PlaceNet *pn = &s->net[i];
+
+  if (!pn->used)
+    return;
+  s->wire -= pn->cost;
+  s->congestion -= TreeRemove (s->nettree, &pn->box);
+}
+
+static void
+ElementAdd (PlaceState * s, PlaceElement * pe)
+{
+  Cardinal k;
+
+  pe->side = TEST_FLAG (ONSOLDERFLAG, pe->element) ? 1 : 0;
+  pe->vbox = pe->element->VBox;
+  r_insert_entry (s->neighbortree[pe->side], &pe->vbox, 0);
+  pe->pins.BoxN = 0;
+  pe->has_module = ModuleBoxes (pe->element, &pe->module, &pe->pins);
+  pe->oob = pe->has_module && OutOfBounds (pe->element);
+  if (!pe->has_module)
+    return;
+  s->overlap += TreeAdd (s->moduletree[pe->side], &pe->module);
+  for (k = 0; k < pe->pins.BoxN; k++)
+    s->overlap += TreeAdd (s->moduletree[!pe->side], &pe->pins.Box[k]);
+  if (pe->oob)
+    s->oob += CostParameter.out_of_bounds_penalty;
+}
+
+static void
+ElementRemove (PlaceState * s, PlaceElement * pe)
+{
+  Cardinal k;
+
+  r_delete_entry (s->neighbortree[pe->side], &pe->vbox);
+  if (!pe->has_module)
+    return;
+  s->overlap -= TreeRemove (s->moduletree[pe->side], &pe->module);
+  for (k = 0; k < pe->pins.BoxN; k++)
+    s->overlap -= TreeRemove (s->moduletree[!pe->side], &pe->pins.Box[k]);
+  if (pe->oob)
+    s->oob -= CostParameter.out_of_bounds_penalty;
+}
+
+/*!
+ * \brief Work out all the terms of the cost from scratch.
+ */
+static void
+PlaceStateInit (PlaceState * s, NetListType *Nets)
+{
+  Cardinal i, j;
+  int d;
+
+  memset (s, 0, sizeof (*s));
+  s->Nets = Nets;
+  s->top_group = GetLayerGroupNumberBySide (TOP_SIDE);
+  s->bottom_group = GetLayerGroupNumberBySide (BOTTOM_SIDE);
+  s->nettree = r_create_tree (NULL, 0, 0);
+  for (d = 0; d < 2; d++)
+    {
+      s->moduletree[d] = r_create_tree (NULL, 0, 0);
+      s->neighbortree[d] = r_create_tree (NULL, 0, 0);
+    }
+  s->touched = g_array_new (FALSE, FALSE, sizeof (Cardinal));
+  s->index = g_hash_table_new (NULL, NULL);
+  s->elementN = PCB->Data->ElementN;
+  s->element = g_new0 (PlaceElement, s->elementN);
+  i = 0;
+  ELEMENT_LOOP (PCB->Data);
+  {
+    PlaceElement *pe = &s->element[i++];
+    pe->element = element;
+    pe->nets = g_array_new (FALSE, FALSE, sizeof (Cardinal));
+    g_hash_table_insert (s->index, element, pe);
+    ElementAdd (s, pe);
+  }
+  END_LOOP;
+  s->net = g_new0 (PlaceNet, Nets->NetN);
+  for (i = 0; i < Nets->NetN; i++)
+    {
+      NetType *n = &Nets->Net[i];
+      for (j = 0; j < n->ConnectionN; j++)
+	{
+	  PlaceElement *pe = (PlaceElement *)
+	    g_hash_table_lookup (s->index, n->Connection[j].ptr1);
+	  if (pe && (pe->nets->len == 0 ||
+		     g_array_index (pe->nets, Cardinal,
+				    pe->nets->len - 1) != i))
+	    g_array_append_val (pe->nets, i);
+	}
+      NetAdd (s, i);
+    }
+  for (i = 0; i < s->elementN; i++)
+    for (d = 0; d < 4; d++)
+      FindNeighbor (s, &s->element[i], d);
+}
+
+static void
+PlaceStateFree (PlaceState * s)
+{
+  Cardinal i;
+  int d;
+
+  for (i = 0; i < s->elementN; i++)
+    {
+      g_array_free (s->element[i].nets, TRUE);
+      FreeBoxListMemory (&s->element[i].pins);
+    }
+  g_free (s->element);
+  g_free (s->net);
+  g_hash_table_destroy (s->index);
+  g_array_free (s->touched, TRUE);
+  r_destroy_tree (&s->nettree);
+  for (d = 0; d < 2; d++)
+    {
+      r_destroy_tree (&s->moduletree[d]);
+      r_destroy_tree (&s->neighbortree[d]);
+    }
+}
+
+/*!
+ * \brief The cost of the placement, as ComputeCost() would have it.
+ */
+static double
+PlaceStateCost (PlaceState * s, double T0, double T)
+{
+  return s->wire + (CostParameter.congestion_penalty *
+		    sqrt (fabs (s->congestion)) +
+		    sqrt (fabs (s->overlap)) * OverlapPenalty (T0, T) +
+		    s->oob - s->align + AreaPenalty ());
+}
+
+/*!
+ * \brief Do or undo a perturbation, and bring the cost up to date.
+ *
+ * The neighbors found again are those of the moved elements, of the
+ * elements they were neighbors of, and of those whose trapezoid they
+ * move into.
+ */
+static void
+PlaceMove (PlaceState * s, PerturbationType * pt, bool undo)
+{
+  PlaceElement *moved[2];
+  Cardinal i, j;
+  int n = 0, k, d;
+  bool again;
+
+  moved[n++] = (PlaceElement *) g_hash_table_lookup (s->index, pt->element);
+  if (pt->which == EXCHANGE)
+    moved[n++] = (PlaceElement *) g_hash_table_lookup (s->index, pt->other);
+  s->mark++;
+  g_array_set_size (s->touched, 0);
+  for (k = 0; k < n; k++)
+    {
+      moved[k]->mark = s->mark;
+      for (i = 0; i < moved[k]->nets->len; i++)
+	{
+	  Cardinal net = g_array_index (moved[k]->nets, Cardinal, i);
+	  if (s->net[net].mark != s->mark)
+	    {
+	      s->net[net].mark = s->mark;
+	      g_array_append_val (s->touched, net);
+	    }
+	}
+      ElementRemove (s, moved[k]);
+    }
+  for (i = 0; i < s->touched->len; i++)
+    NetRemove (s, g_array_index (s->touched, Cardinal, i));
+
+  doPerturb (pt, undo);
+
+  for (i = 0; i < s->touched->len; i++)
+    NetAdd (s, g_array_index (s->touched, Cardinal, i));
+  for (k = 0; k < n; k++)
+    ElementAdd (s, moved[k]);
+
+  for (i = 0; i < s->elementN; i++)
+    {
+      PlaceElement *pe = &s->element[i];
+      for (d = 0; d < 4; d++)
+	{
+	  again = pe->mark == s->mark ||
+	    (pe->neighbor[d] && pe->neighbor[d]->mark == s->mark);
+	  for (j = 0; !again && j < n; j++)
+	    again = moved[j]->side == pe->side &&
+	      InNeighborTrap (&pe->vbox, &moved[j]->vbox, place_dir[d]);
+	  if (again)
+	    FindNeighbor (s, pe, d);
+	}
+    }
+}
+
+/*!
+ * \brief Anneal the placement of the selected elements, starting at
+ * temperature \p T0.
+ *
+ * The moves kept are added to \p kept, if there is one.
+ *
+ * \return the number of moves kept.
+ */
+static long
+Anneal (NetListType *Nets, PointerListType *Selected, double T0,
+	double *cost, GArray *kept)
+{
+  PlaceState s;
+  PerturbationType pt;
+  double T = T0, C0;
+  long steps = 0;
+  int good_moves = 0, moves = 0;
+  const int good_move_cutoff = CostParameter.m * Selected->PtrN;
+  const int move_cutoff = 2 * good_move_cutoff;
+
+  PlaceStateInit (&s, Nets);
+  C0 = PlaceStateCost (&s, T0, T);
+  while (1)
+    {
+      double Cprime;
+      pt = createPerturbation (Selected, T);
+      PlaceMove (&s, &pt, false);
+      Cprime = PlaceStateCost (&s, T0, T);
+      if (Cprime < C0)
+	{			/* good move! */
+	  C0 = Cprime;
+	  good_moves++;
+	  steps++;
+	  if (kept)
+	    g_array_append_val (kept, pt);
+	}
+      else if ((random () / (double) RAND_MAX) <
+	       exp (MIN (MAX (-20, (C0 - Cprime) / T), 20)))
+	{
+	  /* not good but keep it anyway */
+	  C0 = Cprime;
+	  steps++;
+	  if (kept)
+	    g_array_append_val (kept, pt);
+	}
+      else
+	PlaceMove (&s, &pt, true);	/* undo last change */
+      moves++;
+      /* are we at the end of a stage? */
+      if (good_moves >= good_move_cutoff || moves >= move_cutoff)
+	{
+	  printf ("END OF STAGE: COST %.0f\t"
+		  "GOOD_MOVES %d\tMOVES %d\t"
+		  "T: %.1f\n", C0, good_moves, moves, T);
+	  /* is this the end? */
+	  if (T < 5 || good_moves < moves / CostParameter.good_ratio)
+	    break;
+	  /* nope, adjust T and continue */
+	  moves = good_moves = 0;
+	  T *= CostParameter.gamma;
+	  /* cost is T dependent, so recompute.  Start from scratch, so
+	   * that rounding doesn't add up over the stages. */
+	  PlaceStateFree (&s);
+	  PlaceStateInit (&s, Nets);
+	  C0 = PlaceStateCost (&s, T0, T);
+	}
+    }
+  PlaceStateFree (&s);
+  *cost = C0;
+  return steps;
+}
+
+/* what an annealing worker writes, ahead of the moves it kept */
+struct anneal_result
+{
+  double cost;
+  long steps;
+  guint kept;
+};
+
+/*!
+ * \brief The chains annealed by AnnealChains(), and the best so far.
+ */
+typedef struct
+{
+  NetListType *Nets;
+  PointerListType *Selected;
+  double T0;
+  unsigned *seeds;		/*!< Of the random numbers of each chain. */
+  GArray *kept, *best;		/*!< Of PerturbationType. */
+  double best_cost;
+  long steps;			/*!< Of the best chain, -1 if none yet. */
+} anneal_chains;
+
+/*!
+ * \brief Anneal chain \p part in a worker process, and write the moves
+ * kept to \p fp.
+ *
+ * \return the exit status of the worker.
+ */
+static int
+AnnealWorker (int part, FILE *fp, void *data)
+{
+  anneal_chains *c = (anneal_chains *) data;
+  GArray *kept = g_array_new (FALSE, FALSE, sizeof (PerturbationType));
+  struct anneal_result r;
+
+  srandom (c->seeds[part]);
+  r.steps = Anneal (c->Nets, c->Selected, c->T0, &r.cost, kept);
+  r.kept = kept->len;
+  if (fwrite (&r, sizeof (r), 1, fp) != 1
+      || fwrite (kept->data, sizeof (PerturbationType), kept->len,
+		 fp) != kept->len)
+    return 1;
+  return 0;
+}
+
+/*!
+ * \brief Keep the moves of a chain if it ended up the cheapest so far.
+ *
+ * A chain whose worker failed is just left out.
+ */
+static bool
+ReadAnnealWorker (int part, FILE *fp, void *data)
+{
+  anneal_chains *c = (anneal_chains *) data;
+  struct anneal_result r;
+  GArray *t;
+
+  if (fp == NULL)
+    return true;
+  if (fread (&r, sizeof (r), 1, fp) != 1)
+    return false;
+  g_array_set_size (c->kept, r.kept);
+  if (fread (c->kept->data, sizeof (PerturbationType), r.kept, fp) != r.kept)
+    return false;
+  if (c->steps < 0 || r.cost < c->best_cost)
+    {
+      t = c->best;
+      c->best = c->kept;
+      c->kept = t;
+      c->best_cost = r.cost;
+      c->steps = r.steps;
+    }
+  return true;
+}
+
+/*!
+ * \brief Anneal in \p n worker processes at once, and keep the best.
+ *
+ * Each worker anneals its copy of the board from the same start, with
+ * random numbers of its own.  The moves kept by the one that ends up
+ * cheapest are then done again here.  The elements they move are the
+ * same in the workers and in pcb.
+ *
+ * \return the number of moves kept, or -1 if no worker came through.
+ */
+static long
+AnnealChains (NetListType *Nets, PointerListType *Selected, double T0,
+	      int n)
+{
+  anneal_chains c;
+  guint j;
+  int i;
+
+  c.Nets = Nets;
+  c.Selected = Selected;
+  c.T0 = T0;
+  c.seeds = g_new (unsigned, n);
+  for (i = 0; i < n; i++)
+    c.seeds[i] = random ();
+  c.kept = g_array_new (FALSE, FALSE, sizeof (PerturbationType));
+  c.best = g_array_new (FALSE, FALSE, sizeof (PerturbationType));
+  c.best_cost = 0;
+  c.steps = -1;
+
+  pcb_fork_workers (n, n, -1, true, AnnealWorker, ReadAnnealWorker, &c);
+
+  for (j = 0; j < c.best->len; j++)
+    doPerturb (&g_array_index (c.best, PerturbationType, j), false);
+  if (c.steps >= 0)
+    printf ("Best of %d chains: COST %.0f\n", n, c.best_cost);
+
+  g_array_free (c.kept, TRUE);
+  g_array_free (c.best, TRUE);
+  g_free (c.seeds);
+  return c.steps;
+}
+
 /*!
  * \brief Auto-place selected components.
  */
@@ -823,51 +1461,12 @@ AutoPlaceSelected (void)
   }
   /* now anneal in earnest */
   {
-    double T = T0;
-    long steps = 0;
-    int good_moves = 0, moves = 0;
-    const int good_move_cutoff = CostParameter.m * Selected.PtrN;
-    const int move_cutoff = 2 * good_move_cutoff;
+    long steps = -1;
     printf ("Starting cost is %.0f\n", ComputeCost (Nets, T0, 5));
-    C0 = ComputeCost (Nets, T0, T);
-    while (1)
-      {
-	double Cprime;
-	pt = createPerturbation (&Selected, T);
-	doPerturb (&pt, false);
-	Cprime = ComputeCost (Nets, T0, T);
-	if (Cprime < C0)
-	  {			/* good move! */
-	    C0 = Cprime;
-	    good_moves++;
-	    steps++;
-	  }
-	else if ((random () / (double) RAND_MAX) <
-		 exp (MIN (MAX (-20, (C0 - Cprime) / T), 20)))
-	  {
-	    /* not good but keep it anyway */
-	    C0 = Cprime;
-	    steps++;
-	  }
-	else
-	  doPerturb (&pt, true);	/* undo last change */
-	moves++;
-	/* are we at the end of a stage? */
-	if (good_moves >= good_move_cutoff || moves >= move_cutoff)
-	  {
-	    printf ("END OF STAGE: COST %.0f\t"
-		    "GOOD_MOVES %d\tMOVES %d\t"
-		    "T: %.1f\n", C0, good_moves, moves, T);
-	    /* is this the end? */
-	    if (T < 5 || good_moves < moves / CostParameter.good_ratio)
-	      break;
-	    /* nope, adjust T and continue */
-	    moves = good_moves = 0;
-	    T *= CostParameter.gamma;
-	    /* cost is T dependent, so recompute */
-	    C0 = ComputeCost (Nets, T0, T);
-	  }
-      }
+    if (Settings.PlaceJobs > 1)
+      steps = AnnealChains (Nets, &Selected, T0, Settings.PlaceJobs);
+    if (steps < 0)
+      steps = Anneal (Nets, &Selected, T0, &C0, NULL);
     changed = (steps > 0);
   }
 done:
@@ -66,6 +66,9 @@
 
 #include <assert.h>
 #include <setjmp.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include "data.h"
 #include "macro.h"
@@ -77,6 +80,7 @@
 #include "find.h"
 #include "flags.h"
 #include "heap.h"
+#include "job.h"
 #include "rtree.h"
 #include "misc.h"
 #include "mtspace.h"
@@ -427,6 +431,7 @@ RD_DrawThermal (routedata_t * rd, Coord X, Coord Y,
 		Cardinal group, Cardinal layer, routebox_t * subnet,
 		bool is_bad);
 static void ResetSubnet (routebox_t * net);
+static void FreeRouteBlocks (void);
 #ifdef ROUTE_DEBUG
 static int showboxen = -2;
 static int aabort = 0;
@@ -442,6 +447,12 @@ static bool usedGroup[MAX_GROUP];
 static int x_cost[MAX_GROUP], y_cost[MAX_GROUP];
 static bool is_layer_group_active[MAX_GROUP];
 static int ro = 0;
+/* work done by the searches, for the statistics of RouteAll() */
+static struct
+{
+  long pushes, pops, areas;
+}
+route_counts;
 static int smoothes = 1;
 static int passes = 12;
 static int routing_layers = 0;
@@ -1293,10 +1304,144 @@ DestroyRouteData (routedata_t ** rd)
     r_destroy_tree (&(*rd)->layergrouptree[i]);
   if (AutoRouteParameters.use_vias)
     mtspace_destroy (&(*rd)->mtspace);
+  FreeRouteBlocks ();
   free (*rd);
   *rd = NULL;
 }
 
+/*-----------------------------------------------------------------
+ * Allocation of expansion areas and edges.
+ *
+ * The expansion areas of a RouteOne() search are taken from blocks and
+ * all go at once when the search is over.  Edges come and go all
+ * through a search, so freed ones are kept on a list for the next.
+ * The blocks are kept from one search to the next, and given back by
+ * DestroyRouteData().
+ */
+#define ROUTE_BLOCK_SIZE 1024
+
+typedef struct area_block
+{
+  struct area_block *next;
+  int used;
+  routebox_t area[ROUTE_BLOCK_SIZE];
+}
+area_block;
+
+typedef union edge_slot
+{
+  edge_t edge;
+  union edge_slot *next;
+}
+edge_slot;
+
+typedef struct edge_block
+{
+  struct edge_block *next;
+  edge_slot slot[ROUTE_BLOCK_SIZE];
+}
+edge_block;
+
+/* the blocks, and the block expansion areas are taken from */
+static area_block *area_blocks = NULL, *area_current = NULL;
+static edge_block *edge_blocks = NULL;
+static edge_slot *free_edges = NULL;
+
+/*!
+ * \brief Get a cleared routebox for an expansion area.
+ */
+static routebox_t *
+AllocExpansionArea (void)
+{
+  area_block *b;
+  routebox_t *rb;
+
+  if (area_current == NULL || area_current->used == ROUTE_BLOCK_SIZE)
+    {
+      b = area_current ? area_current->next : area_blocks;
+      if (b == NULL)
+	{
+	  b = (area_block *) malloc (sizeof (*b));
+	  b->next = NULL;
+	  if (area_current)
+	    area_current->next = b;
+	  else
+	    area_blocks = b;
+	}
+      b->used = 0;
+      area_current = b;
+    }
+  rb = &area_current->area[area_current->used++];
+  memset ((void *) rb, 0, sizeof (*rb));
+  route_counts.areas++;
+  return rb;
+}
+
+/*!
+ * \brief Let go of all expansion areas, once a search is over.
+ */
+static void
+ReleaseExpansionAreas (void)
+{
+  area_current = NULL;
+}
+
+/*!
+ * \brief Get a cleared edge.
+ */
+static edge_t *
+AllocEdge (void)
+{
+  edge_block *b;
+  edge_slot *slot;
+  int i;
+
+  if (free_edges == NULL)
+    {
+      b = (edge_block *) malloc (sizeof (*b));
+      b->next = edge_blocks;
+      edge_blocks = b;
+      for (i = ROUTE_BLOCK_SIZE - 1; i >= 0; i--)
+	{
+	  b->slot[i].next = free_edges;
+	  free_edges = &b->slot[i];
+	}
+    }
+  slot = free_edges;
+  free_edges = slot->next;
+  memset ((void *) &slot->edge, 0, sizeof (slot->edge));
+  return &slot->edge;
+}
+
+static void
+FreeEdge (edge_t * e)
+{
+  edge_slot *slot = (edge_slot *) e;
+
+  slot->next = free_edges;
+  free_edges = slot;
+}
+
+static void
+FreeRouteBlocks (void)
+{
+  area_block *a;
+  edge_block *e;
+
+  while ((a = area_blocks) != NULL)
+    {
+      area_blocks = a->next;
+      free (a);
+    }
+  while ((e = edge_blocks) != NULL)
+    {
+      edge_blocks = e->next;
+      free (e);
+    }
+  area_current = NULL;
+  free_edges = NULL;
+}
+
 /*-----------------------------------------------------------------
  * routebox reference counting.
  */
@@ -1312,8 +1457,10 @@ RB_up_count (routebox_t * rb)
 }
 
 /*!
- * \brief Decrement the reference count on a routebox, freeing if this
- * box becomes unused.
+ * \brief Decrement the reference count on a routebox.
+ *
+ * A box that becomes unused lets go of its parent.  Its memory goes with
+ * the other expansion areas at the end of the search.
  */
 static void
 RB_down_count (routebox_t * rb)
@@ -1325,7 +1472,6 @@ RB_down_count (routebox_t * rb)
     {
       if (rb->parent.expansion_area->flags.homeless)
 	RB_down_count (rb->parent.expansion_area);
-      free (rb);
     }
 }
 
@@ -1675,48 +1821,32 @@ struct mincost_target_closure
 {
   const CheapPointType *CostPoint;
   Cardinal CostPointLayer;
-  routebox_t *nearest;
-  cost_t nearest_cost;
 };
-static int
-__region_within_guess (const BoxType * region, void *cl)
-{
-  struct mincost_target_closure *mtc = (struct mincost_target_closure *) cl;
-  cost_t cost_to_region;
-  if (mtc->nearest == NULL)
-    return 1;
-  cost_to_region =
-    cost_to_layerless_box (mtc->CostPoint, mtc->CostPointLayer, region);
-  assert (cost_to_region >= 0);
-  /* if no guess yet, all regions are "close enough" */
-  /* note that cost is *strictly more* than minimum distance, so we'll
-   * always search a region large enough. */
-  return (cost_to_region < mtc->nearest_cost);
-}
-static int
-__found_new_guess (const BoxType * box, void *cl)
+
+/*!
+ * \brief Distance callback of r_search_nearest() giving the cost to a
+ * target.
+ *
+ * The cost is at least the manhattan distance to the unbloated box, so
+ * never less than the distance to the box in the tree.
+ */
+static double
+__cost_to_target (const BoxType * box, const PointType * pt, void *cl)
 {
   struct mincost_target_closure *mtc = (struct mincost_target_closure *) cl;
-  routebox_t *guess = (routebox_t *) box;
-  cost_t cost_to_guess =
-    cost_to_routebox (mtc->CostPoint, mtc->CostPointLayer, guess);
-  assert (cost_to_guess >= 0);
-  /* if this is cheaper than previous guess... */
-  if (cost_to_guess < mtc->nearest_cost)
-    {
-      mtc->nearest = guess;
-      mtc->nearest_cost = cost_to_guess;	/* this is our new guess! */
-      return 1;
-    }
-  else
-    return 0;			/* not less expensive than our last guess */
+  cost_t cost_to_target =
+    cost_to_routebox (mtc->CostPoint, mtc->CostPointLayer,
+		      (routebox_t *) box);
+  assert (cost_to_target >= 0);
+  return cost_to_target;
 }
 
 /*!
- * \brief .
+ * \brief Find the target that is cheapest to reach from a cost point.
  *
  * \c target_guess is our guess at what the nearest target is, or
- * \c NULL if we just plum don't have a clue.
+ * \c NULL if we just plum don't have a clue.  It is kept when no other
+ * target is cheaper.
  */
 static routebox_t *
 mincost_target_to_point (const CheapPointType * CostPoint,
@@ -1724,19 +1854,24 @@ mincost_target_to_point (const CheapPointType * CostPoint,
 			 rtree_t * targets, routebox_t * target_guess)
 {
   struct mincost_target_closure mtc;
+  const BoxType *nearest;
+  double nearest_cost;
+  PointType pt;
   assert (target_guess == NULL || target_guess->flags.target);	/* this is a target, right? */
   mtc.CostPoint = CostPoint;
   mtc.CostPointLayer = CostPointLayer;
-  mtc.nearest = target_guess;
-  if (mtc.nearest)
-    mtc.nearest_cost =
-      cost_to_routebox (mtc.CostPoint, mtc.CostPointLayer, mtc.nearest);
-  else
-    mtc.nearest_cost = EXPENSIVE;
-  r_search (targets, NULL, __region_within_guess, __found_new_guess, &mtc);
-  assert (mtc.nearest != NULL && mtc.nearest_cost >= 0);
-  assert (mtc.nearest->flags.target);	/* this is a target, right? */
-  return mtc.nearest;
+  pt.X = CostPoint->X;
+  pt.Y = CostPoint->Y;
+  if (r_search_nearest (targets, &pt, 1, EXPENSIVE, __cost_to_target, &mtc,
+			&nearest, &nearest_cost) == 0)
+    nearest = (const BoxType *) target_guess;
+  else if (target_guess
+	   && cost_to_routebox (CostPoint, CostPointLayer,
+				target_guess) <= nearest_cost)
+    nearest = (const BoxType *) target_guess;
+  assert (nearest != NULL);
+  assert (((routebox_t *) nearest)->flags.target);	/* this is a target, right? */
+  return (routebox_t *) nearest;
 }
 
 /*!
@@ -1753,9 +1888,7 @@ CreateEdge (routebox_t * rb,
 {
   edge_t *e;
   assert (__routebox_is_good (rb));
-  e = (edge_t *)malloc (sizeof (*e));
-  memset ((void *) e, 0, sizeof (*e));
-  assert (e);
+  e = AllocEdge ();
   e->rb = rb;
   if (rb->flags.homeless)
     RB_up_count (rb);
@@ -1952,7 +2085,7 @@ KillEdge (void *edge)
     RB_down_count (e->rb);
   if (e->flags.via_search)
     mtsFreeWork (&e->work);
-  free (e);
+  FreeEdge (e);
 }
 
 static void
@@ -2089,8 +2222,7 @@ CreateExpansionArea (const BoxType * area, Cardinal group,
 		     routebox_t * parent,
 		     bool relax_edge_requirements, edge_t * src_edge)
 {
-  routebox_t *rb = (routebox_t *) malloc (sizeof (*rb));
-  memset ((void *) rb, 0, sizeof (*rb));
+  routebox_t *rb = AllocExpansionArea ();
   assert (area && parent);
   init_const_box (rb, area->X1, area->Y1, area->X2, area->Y2, 0);
   rb->group = group;
@@ -2498,8 +2630,7 @@ blocker_to_heap (heap_t * heap, routebox_t * rb,
 static routebox_t *
 CreateBridge (const BoxType * area, routebox_t * parent, direction_t dir)
 {
-  routebox_t *rb = (routebox_t *) malloc (sizeof (*rb));
-  memset ((void *) rb, 0, sizeof (*rb));
+  routebox_t *rb = AllocExpansionArea ();
   assert (area && parent);
   init_const_box (rb, area->X1, area->Y1, area->X2, area->Y2, 0);
   rb->group = parent->group;
@@ -2656,7 +2787,7 @@ moveable_edge (vector_t * result, const BoxType * box, direction_t dir,
       if (!box_is_good (&b))
 	return;			/* how did this happen ? */
       nrb = CreateBridge (&b, rb, dir);
-      r_insert_entry (tree, &nrb->box, 1);
+      r_insert_entry (tree, &nrb->box, 0);
       vector_append (area_vec, nrb);
       nrb->flags.homeless = 0;	/* not homeless any more */
       /* mark this one as conflicted */
@@ -2720,7 +2851,7 @@ moveable_edge (vector_t * result, const BoxType * box, direction_t dir,
       assert (box_intersect (&b, &blocker->sbox));
       b = shrink_box (&b, 1);
       nrb = CreateBridge (&b, rb, dir);
-      r_insert_entry (tree, &nrb->box, 1);
+      r_insert_entry (tree, &nrb->box, 0);
       vector_append (area_vec, nrb);
       nrb->flags.homeless = 0;	/* not homeless any more */
       ne = CreateEdge (nrb, nrb->cost_point.X, nrb->cost_point.Y,
@@ -3231,6 +3362,97 @@ FindThermable (rtree_t * rtree, routebox_t * rb)
   return info.plane;
 }
 
+/* ---------------------------------------------------------------------------
+ * Speculative routing: with --route-jobs a worker process routes a net
+ * against its copy of the route data and records what it draws, and
+ * RouteAll() draws the same in the route data of pcb.
+ */
+typedef enum
+  { SPEC_LINE, SPEC_VIA, SPEC_THERMAL, SPEC_MERGE, SPEC_BAD }
+  spec_kind;
+
+/*!
+ * \brief A routebox a recorded step refers to.
+ *
+ * A box that was there before the net was routed is kept as a pointer,
+ * which is the same in the worker and in pcb.  A box drawn for the net
+ * is kept as the index of its drawing.
+ */
+typedef struct spec_ref
+{
+  routebox_t *box;
+  int index;
+}
+spec_ref;
+
+typedef struct spec_step
+{
+  spec_kind kind;
+  Coord X1, Y1, X2, Y2;
+  Coord size;			/* half thickness of a line, radius of a via */
+  Cardinal group, layer;
+  bool is_bad, is_45;
+  spec_ref a, b;
+}
+spec_step;
+
+/* steps drawn for the net routed by a worker; NULL if not recording */
+static GArray *spec_steps = NULL;
+/* boxes drawn for the net being routed or replayed; NULL if not kept */
+static GPtrArray *spec_drawn = NULL;
+
+static spec_ref
+spec_ref_of (routebox_t * rb)
+{
+  spec_ref r;
+  guint i;
+
+  r.box = rb;
+  r.index = -1;
+  if (spec_drawn)
+    for (i = 0; i < spec_drawn->len; i++)
+      if (g_ptr_array_index (spec_drawn, i) == rb)
+	{
+	  r.box = NULL;
+	  r.index = i;
+	  break;
+	}
+  return r;
+}
+
+static routebox_t *
+spec_box_of (spec_ref r)
+{
+  if (r.index < 0)
+    return r.box;
+  return (routebox_t *) g_ptr_array_index (spec_drawn, r.index);
+}
+
+/*!
+ * \brief Add a step of the given kind to spec_steps.
+ *
+ * \return the step to fill in, or NULL if nothing is being recorded.
+ */
+static spec_step *
+spec_record (spec_kind kind)
+{
+  spec_step step;
+
+  if (spec_steps == NULL)
+    return NULL;
+  memset (&step, 0, sizeof (step));
+  step.kind = kind;
+  g_array_append_val (spec_steps, step);
+  return &g_array_index (spec_steps, spec_step, spec_steps->len - 1);
+}
+
+static void
+spec_note_drawn (routebox_t * rb)
+{
+  if (spec_drawn)
+    g_ptr_array_add (spec_drawn, rb);
+}
+
 /*!
  * \brief Route-tracing code: once we've got a path of expansion boxes,
  * trace a line through them to actually create the connection.
@@ -3241,6 +3463,17 @@ RD_DrawThermal (routedata_t * rd, Coord X, Coord Y,
 		bool is_bad)
 {
   routebox_t *rb;
+  spec_step *step = spec_record (SPEC_THERMAL);
+
+  if (step)
+    {
+      step->X1 = X;
+      step->Y1 = Y;
+      step->group = group;
+      step->layer = layer;
+      step->is_bad = is_bad;
+      step->a = spec_ref_of (subnet);
+    }
   rb = (routebox_t *) malloc (sizeof (*rb));
   memset ((void *) rb, 0, sizeof (*rb));
   init_const_box (rb, X, Y, X + 1, Y + 1, 0);
@@ -3258,6 +3491,7 @@ RD_DrawThermal (routedata_t * rd, Coord X, Coord Y,
   /* add it to the r-tree, this may be the whole route! */
   r_insert_entry (rd->layergrouptree[rb->group], &rb->box, 1);
   rb->flags.homeless = 0;
+  spec_note_drawn (rb);
 }
 
 static void
@@ -3268,6 +3502,16 @@ RD_DrawVia (routedata_t * rd, Coord X, Coord Y,
   int i;
   int ka = AutoRouteParameters.style->Keepaway;
   PinType *live_via = NULL;
+  spec_step *step = spec_record (SPEC_VIA);
+
+  if (step)
+    {
+      step->X1 = X;
+      step->Y1 = Y;
+      step->size = radius;
+      step->is_bad = is_bad;
+      step->a = spec_ref_of (subnet);
+    }
 
   if (TEST_FLAG (LIVEROUTEFLAG, PCB))
     {
@@ -3320,6 +3564,7 @@ RD_DrawVia (routedata_t * rd, Coord X, Coord Y,
       r_insert_entry (rd->layergrouptree[rb->group], &rb->box, 1);
       rb->flags.homeless = 0;	/* not homeless anymore */
       rb->livedraw_obj.via = live_via;
+      spec_note_drawn (rb);
     }
 }
 static void
@@ -3341,10 +3586,23 @@ RD_DrawLine (routedata_t * rd,
 
   routebox_t *rb;
   Coord ka = AutoRouteParameters.style->Keepaway;
+  spec_step *step;
 
   /* don't draw zero-length segments. */
   if (X1 == X2 && Y1 == Y2)
     return;
+  if ((step = spec_record (SPEC_LINE)) != NULL)
+    {
+      step->X1 = X1;
+      step->Y1 = Y1;
+      step->X2 = X2;
+      step->Y2 = Y2;
+      step->size = halfthick;
+      step->group = group;
+      step->is_bad = is_bad;
+      step->is_45 = is_45;
+      step->a = spec_ref_of (subnet);
+    }
   if (qX1 == -1)		/* first ever */
     {
       qX1 = X1;
@@ -3406,6 +3664,7 @@ RD_DrawLine (routedata_t * rd,
   assert (__routebox_is_good (rb));
   /* and add it to the r-tree! */
   r_insert_entry (rd->layergrouptree[rb->group], &rb->box, 1);
+  spec_note_drawn (rb);
 
   if (TEST_FLAG (LIVEROUTEFLAG, PCB))
     {
@@ -3772,9 +4031,7 @@ CreateSearchEdge (struct routeone_state *s, vetting_t * work, edge_t * parent,
   if (cost < s->best_cost)
     {
       edge_t *ne;
-      ne = (edge_t *)malloc (sizeof (*ne));
-      memset ((void *) ne, 0, sizeof (*ne));
-      assert (ne);
+      ne = AllocEdge ();
       ne->flags.via_search = 1;
       ne->flags.in_plane = in_plane;
       ne->rb = rb;
@@ -3787,6 +4044,7 @@ CreateSearchEdge (struct routeone_state *s, vetting_t * work, edge_t * parent,
       ne->cost_point = parent->cost_point;
       ne->cost = cost;
       heap_insert (s->workheap, ne->cost, ne);
+      route_counts.pushes++;
     }
   else
     {
@@ -3801,7 +4059,10 @@ add_or_destroy_edge (struct routeone_state *s, edge_t * e)
   assert (__edge_is_good (e));
   assert (is_layer_group_active[e->rb->group]);
   if (e->cost < s->best_cost)
-    heap_insert (s->workheap, e->cost, e);
+    {
+      heap_insert (s->workheap, e->cost, e);
+      route_counts.pushes++;
+    }
   else
     DestroyEdge (&e);
 }
@@ -4220,6 +4481,7 @@ RouteOne (routedata_t * rd, routebox_t * from, routebox_t * to, int max_edges)
       assert (is_layer_group_active[e->rb->group]);
       e->cost = edge_cost (e, EXPENSIVE);
       heap_insert (s.workheap, e->cost, e);
+      route_counts.pushes++;
     }
   vector_destroy (&source_vec);
   /* okay, process items from heap until it is empty! */
@@ -4233,6 +4495,7 @@ RouteOne (routedata_t * rd, routebox_t * from, routebox_t * to, int max_edges)
   while (!heap_is_empty (s.workheap))
     {
       edge_t *e = (edge_t *)heap_remove_smallest (s.workheap);
+      route_counts.pops++;
 #ifdef ROUTE_DEBUG
       if (aabort)
 	goto dontexpand;
@@ -4345,7 +4608,7 @@ RouteOne (routedata_t * rd, routebox_t * from, routebox_t * to, int max_edges)
 	         &e->rb->box, NULL, no_planes,0));
 	       */
 	      r_insert_entry (rd->layergrouptree[e->rb->group], &e->rb->box,
-			      1);
+			      0);
 	      e->rb->flags.homeless = 0;	/* not homeless any more */
 	      /* add to vector of all expansion areas in r-tree */
 	      vector_append (area_vec, e->rb);
@@ -4500,7 +4763,7 @@ RouteOne (routedata_t * rd, routebox_t * from, routebox_t * to, int max_edges)
 	    goto dontexpand;
 	  nrb = CreateExpansionArea (&ans->inflated, e->rb->group, e->rb,
 				     true, e);
-	  r_insert_entry (rd->layergrouptree[nrb->group], &nrb->box, 1);
+	  r_insert_entry (rd->layergrouptree[nrb->group], &nrb->box, 0);
 	  vector_append (area_vec, nrb);
 	  nrb->flags.homeless = 0;	/* not homeless any more */
 	  broken =
@@ -4545,8 +4808,12 @@ RouteOne (routedata_t * rd, routebox_t * from, routebox_t * to, int max_edges)
 	{
 	  while (!vector_is_empty (s.best_path->conflicts_with))
 	    {
+	      spec_step *step;
+
 	      rb = (routebox_t *)vector_remove_last (s.best_path->conflicts_with);
 	      rb->flags.is_bad = 1;
+	      if ((step = spec_record (SPEC_BAD)) != NULL)
+		step->a = spec_ref_of (rb);
 	      result.route_had_conflicts++;
 	    }
 	}
@@ -4557,8 +4824,15 @@ RouteOne (routedata_t * rd, routebox_t * from, routebox_t * to, int max_edges)
       if (result.route_had_conflicts < AutoRouteParameters.hi_conflict)
 	{
 	  /* back-trace the path and add lines/vias to r-tree */
+	  spec_step *step;
+
 	  TracePath (rd, s.best_path, s.best_target, from,
 		     result.route_had_conflicts);
+	  if ((step = spec_record (SPEC_MERGE)) != NULL)
+	    {
+	      step->a = spec_ref_of (from);
+	      step->b = spec_ref_of (s.best_target);
+	    }
 	  MergeNets (from, s.best_target, SUBNET);
 	}
       else
@@ -4591,6 +4865,7 @@ RouteOne (routedata_t * rd, routebox_t * from, routebox_t * to, int max_edges)
       r_delete_entry (rd->layergrouptree[rb->group], &rb->box);
     }
   vector_destroy (&area_vec);
+  ReleaseExpansionAreas ();
   /* clean up; remove all 'source', 'target', and 'nobloat' flags */
   LIST_LOOP (from, same_net, p);
   if (p->flags.source && p->conflicts_with)
@@ -4731,264 +5006,1294 @@ calculate_progress (double this_heap_item, double this_heap_size,
   return process_fraction;
 }
 
-struct routeall_status
-RouteAll (routedata_t * rd)
+struct routenet_status
 {
-  struct routeall_status ras;
-  struct routeone_status ros;
-  bool rip;
-  int request_cancel;
-#ifdef NET_HEAP
-  heap_t *net_heap;
-#endif
-  heap_t *this_pass, *next_pass, *tmp;
-  routebox_t *net, *p, *pp;
-  cost_t total_net_cost, last_cost = 0, this_cost = 0;
-  int i;
-  int this_heap_size;
-  int this_heap_item;
+  /* cost of the routes of the net */
+  cost_t cost;
+  bool net_completely_routed;
+  /* the user cancelled the autorouter */
+  bool cancelled;
+  /* edges put on and taken off the search heaps, expansion areas made */
+  long pushes, pops, areas;
+  /* time spent routing the net, in microseconds */
+  gint64 usec;
+};
 
-  /* initialize heap for first pass; 
-   * do smallest area first; that makes
-   * the subsequent costs more representative */
-  this_pass = heap_create ();
-  next_pass = heap_create ();
-#ifdef NET_HEAP
-  net_heap = heap_create ();
+/*!
+ * \brief Statistics of a pass of RouteAll(), for --autoroute-stats and
+ * --autoroute-trace.
+ */
+struct routepass_stats
+{
+  /* nets routed on the pass, and those of them left unfinished */
+  int nets, unfinished;
+  long pushes, pops, areas;
+  gint64 usec, worst_usec;
+};
+
+static struct routepass_stats pass_stats;
+/* the --autoroute-trace file, or NULL */
+static FILE *route_trace = NULL;
+
+static void
+InitNetParameters (int pass, routebox_t * net)
+{
+  InitAutoRouteParameters (pass, net->style, pass < passes, pass > passes,
+			   pass == passes + smoothes);
+}
+
+/*!
+ * \brief Take the unfixed traces of a net out of the route data, and
+ * reset the net to its original connectivity.
+ */
+static void
+RipUpNet (routedata_t * rd, routebox_t * net)
+{
+  routebox_t *p;
+
+  LIST_LOOP (net, same_net, p);
+  p->flags.is_bad = 0;
+  if (!p->flags.fixed)
+    {
+#ifndef NDEBUG
+      bool del;
+#endif
+      assert (!p->flags.homeless);
+      RemoveFromNet (p, NET);
+      RemoveFromNet (p, SUBNET);
+      if (AutoRouteParameters.use_vias && p->type != VIA_SHADOW
+	  && p->type != PLANE)
+	mtspace_remove (rd->mtspace, &p->box,
+			p->flags.is_odd ? ODD : EVEN, p->style->Keepaway);
+      if (TEST_FLAG (LIVEROUTEFLAG, PCB))
+	ripout_livedraw_obj (p);
+#ifndef NDEBUG
+      del =
 #endif
+	r_delete_entry (rd->layergrouptree[p->group], &p->box);
+#ifndef NDEBUG
+      assert (del);
+#endif
+    }
+  END_LOOP;
+  ResetSubnet (net);
+}
+
+/*!
+ * \brief Rip up every net that still has a bad trace, so that what is
+ * left can be ironed down.
+ */
+static void
+RipUpBadNets (routedata_t * rd)
+{
+  routebox_t *net, *p;
+  bool bad;
+
   LIST_LOOP (rd->first_net, different_net, net);
   {
-    double area;
-    BoxType bb = shrink_routebox (net);
+    bad = false;
     LIST_LOOP (net, same_net, p);
-    {
-      MAKEMIN (bb.X1, p->sbox.X1);
-      MAKEMIN (bb.Y1, p->sbox.Y1);
-      MAKEMAX (bb.X2, p->sbox.X2);
-      MAKEMAX (bb.Y2, p->sbox.Y2);
-    }
+    if (!p->flags.fixed && p->flags.is_bad)
+      {
+	bad = true;
+	break;
+      }
     END_LOOP;
-    area = (double) (bb.X2 - bb.X1) * (bb.Y2 - bb.Y1);
-    heap_insert (this_pass, area, net);
+    if (bad)
+      RipUpNet (rd, net);
   }
   END_LOOP;
+  if (TEST_FLAG (LIVEROUTEFLAG, PCB))
+    Draw ();
+}
 
-  ras.total_nets_routed = 0;
-  /* refinement/finishing passes */
-  for (i = 0; i <= passes + smoothes; i++)
+/*!
+ * \brief Get a net ready to be routed on a pass.
+ *
+ * Past the first pass the unfixed traces of the net are ripped up if
+ * any of them are bad.
+ *
+ * \return false if the net is to be left as it is.
+ */
+static bool
+PrepareNet (routedata_t * rd, routebox_t * net, int pass,
+	    struct routeall_status *ras)
+{
+  routebox_t *p;
+  bool rip;
+
+  if (pass > 0)
     {
-#ifdef ROUTE_VERBOSE
-      if (i > 0 && i <= passes)
-	printf ("--------- STARTING REFINEMENT PASS %d ------------\n", i);
-      else if (i > passes)
-	printf ("--------- STARTING SMOOTHING PASS %d -------------\n",
-		i - passes);
-#endif
-      ras.total_subnets = ras.routed_subnets = ras.conflict_subnets =
-	ras.failed = ras.ripped = 0;
-      assert (heap_is_empty (next_pass));
+      /* rip up all unfixed traces in this net ? */
+      if (AutoRouteParameters.rip_always)
+	rip = true;
+      else
+	{
+	  rip = false;
+	  LIST_LOOP (net, same_net, p);
+	  if (p->flags.is_bad)
+	    {
+	      rip = true;
+	      break;
+	    }
+	  END_LOOP;
+	}
 
-      this_heap_size = heap_size (this_pass);
-      for (this_heap_item = 0; !heap_is_empty (this_pass); this_heap_item++)
+      if (rip)
 	{
-#ifdef ROUTE_DEBUG
-	  if (aabort)
-	    break;
-#endif
-	  net = (routebox_t *) heap_remove_smallest (this_pass);
-	  InitAutoRouteParameters (i, net->style, i < passes, i > passes,
-				   i == passes + smoothes);
-	  if (i > 0)
+	  RipUpNet (rd, net);
+	  ras->ripped++;
+	}
+      else
+	{
+	  LIST_LOOP (net, same_net, p);
+	  p->flags.is_bad = 0;
+	  if (!p->flags.fixed)
 	    {
-	      /* rip up all unfixed traces in this net ? */
-	      if (AutoRouteParameters.rip_always)
-		rip = true;
-	      else
+	      assert (!p->flags.homeless);
+	      if (AutoRouteParameters.use_vias && p->type != VIA_SHADOW
+		  && p->type != PLANE)
 		{
-		  rip = false;
-		  LIST_LOOP (net, same_net, p);
-		  if (p->flags.is_bad)
-		    {
-		      rip = true;
-		      break;
-		    }
-		  END_LOOP;
+		  mtspace_remove (rd->mtspace, &p->box,
+				  p->flags.is_odd ? ODD : EVEN,
+				  p->style->Keepaway);
+		  mtspace_add (rd->mtspace, &p->box,
+			       p->flags.is_odd ? EVEN : ODD,
+			       p->style->Keepaway);
 		}
+	      p->flags.is_odd = AutoRouteParameters.is_odd;
+	    }
+	  END_LOOP;
+	}
+      if (TEST_FLAG (LIVEROUTEFLAG, PCB))
+	Draw ();
+      if (!rip)
+	return false;
+    }
+  /* count number of subnets */
+  FOREACH_SUBNET (net, p);
+  ras->total_subnets++;
+  END_FOREACH (net, p);
+  /* the first subnet doesn't require routing. */
+  ras->total_subnets--;
+  /* only route that which isn't fully routed */
+#ifdef ROUTE_DEBUG
+  if (ras->total_subnets == 0 || aabort)
+#else
+  if (ras->total_subnets == 0)
+#endif
+    return false;
+  return true;
+}
 
-	      LIST_LOOP (net, same_net, p);
-	      p->flags.is_bad = 0;
-	      if (!p->flags.fixed)
-		{
-#ifndef NDEBUG
-		  bool del;
+/*!
+ * \brief Route the subnets of a net that PrepareNet() got ready.
+ *
+ * \param this_heap_item position of the net in its pass.
+ *
+ * \param this_heap_size number of nets in the pass, or 0 to show no
+ * progress.
+ */
+static struct routenet_status
+RouteNet (routedata_t * rd, routebox_t * net, int pass,
+	  struct routeall_status *ras, int this_heap_item,
+	  int this_heap_size)
+{
+  struct routenet_status rns;
+  struct routeone_status ros;
+  routebox_t *p, *pp;
+  int request_cancel;
+#ifdef NET_HEAP
+  heap_t *net_heap = heap_create ();
 #endif
-		  assert (!p->flags.homeless);
-		  if (rip)
-		    {
-		      RemoveFromNet (p, NET);
-		      RemoveFromNet (p, SUBNET);
-		    }
-		  if (AutoRouteParameters.use_vias && p->type != VIA_SHADOW
-		      && p->type != PLANE)
-		    {
-		      mtspace_remove (rd->mtspace, &p->box,
-				      p->flags.is_odd ? ODD : EVEN,
-				      p->style->Keepaway);
-		      if (!rip)
-			mtspace_add (rd->mtspace, &p->box,
-				     p->flags.is_odd ? EVEN : ODD,
-				     p->style->Keepaway);
-		    }
-		  if (rip)
-		    {
-		      if (TEST_FLAG (LIVEROUTEFLAG, PCB))
-			ripout_livedraw_obj (p);
-#ifndef NDEBUG
-		      del =
+  gint64 start = g_get_monotonic_time ();
+  long pushes = route_counts.pushes, pops = route_counts.pops;
+  long areas = route_counts.areas;
+
+  rns.cost = 0;
+  rns.cancelled = false;
+  ros.net_completely_routed = 0;
+
+  /* the loop here ensures that we get to all subnets even if
+   * some of them are unreachable from the first subnet. */
+  LIST_LOOP (net, same_net, p);
+  {
+#ifdef NET_HEAP
+    BoxType b = shrink_routebox (p);
+    /* using a heap allows us to start from smaller objects and
+     * end at bigger ones. also prefer to start at planes, then pads */
+    heap_insert (net_heap, (float) (b.X2 - b.X1) *
+#if defined(ROUTE_RANDOMIZED)
+		 (0.3 + rand () / (RAND_MAX + 1.0)) *
 #endif
-			r_delete_entry (rd->layergrouptree[p->group],
-					&p->box);
-#ifndef NDEBUG
-		      assert (del);
+		 (b.Y2 - b.Y1) * (p->type == PLANE ?
+				  -1 : (p->type ==
+					PAD ? 1 : 10)), p);
+  }
+  END_LOOP;
+  while (!heap_is_empty (net_heap))
+    {
+      p = (routebox_t *) heap_remove_smallest (net_heap);
 #endif
-		    }
-		  else
-		    {
-		      p->flags.is_odd = AutoRouteParameters.is_odd;
-		    }
-		}
-	      END_LOOP;
-	      if (TEST_FLAG (LIVEROUTEFLAG, PCB))
-		Draw ();
-	      /* reset to original connectivity */
-	      if (rip)
-		{
-		  ras.ripped++;
-		  ResetSubnet (net);
-		}
+      if (!p->flags.fixed || p->flags.subnet_processed ||
+	  p->type == OTHER)
+	continue;
+
+      while (!ros.net_completely_routed)
+	{
+	  double percent;
+
+	  assert (no_expansion_boxes (rd));
+	  /* FIX ME: the number of edges to examine should be in autoroute parameters
+	   * i.e. the 2000 and 800 hard-coded below should be controllable by the user
+	   */
+	  ros =
+	    RouteOne (rd, p, NULL,
+		      ((AutoRouteParameters.
+			is_smoothing ? 2000 : 800) * (pass +
+						      1)) *
+		      routing_layers);
+	  rns.cost += ros.best_route_cost;
+	  if (ros.found_route)
+	    {
+	      if (ros.route_had_conflicts)
+		ras->conflict_subnets++;
 	      else
 		{
-		  heap_insert (next_pass, 0, net);
-		  continue;
+		  ras->routed_subnets++;
+		  ras->total_nets_routed++;
 		}
 	    }
-	  /* count number of subnets */
-	  FOREACH_SUBNET (net, p);
-	  ras.total_subnets++;
-	  END_FOREACH (net, p);
-	  /* the first subnet doesn't require routing. */
-	  ras.total_subnets--;
-	  /* and re-route! */
-	  total_net_cost = 0;
-	  /* only route that which isn't fully routed */
-#ifdef ROUTE_DEBUG
-	  if (ras.total_subnets == 0 || aabort)
-#else
-	  if (ras.total_subnets == 0)
-#endif
+	  else
 	    {
-	      heap_insert (next_pass, 0, net);
-	      continue;
+	      if (!ros.net_completely_routed)
+		ras->failed++;
+	      /* don't bother trying any other source in this subnet */
+	      LIST_LOOP (p, same_subnet, pp);
+	      pp->flags.subnet_processed = 1;
+	      END_LOOP;
+	      break;
 	    }
+	  /* note that we can infer nothing about ras.total_subnets based
+	   * on the number of calls to RouteOne, because we may be unable
+	   * to route a net from a particular starting point, but perfectly
+	   * able to route it from some other. */
+	  if (this_heap_size == 0)
+	    continue;
+	  percent = calculate_progress (this_heap_item, this_heap_size, ras);
+	  request_cancel = pcb_job_progress (percent * 100., 100,
+					     _("Autorouting tracks"));
+	  if (request_cancel)
+	    {
+	      ras->total_nets_routed = 0;
+	      ras->conflict_subnets = 0;
+	      Message ("Autorouting cancelled\n");
+	      rns.cancelled = true;
+	      goto out;
+	    }
+	}
+    }
+#ifndef NET_HEAP
+  END_LOOP;
+#endif
 
-	  /* the loop here ensures that we get to all subnets even if
-	   * some of them are unreachable from the first subnet. */
-	  LIST_LOOP (net, same_net, p);
-	  {
+out:
 #ifdef NET_HEAP
-	    BoxType b = shrink_routebox (p);
-	    /* using a heap allows us to start from smaller objects and
-	     * end at bigger ones. also prefer to start at planes, then pads */
-	    heap_insert (net_heap, (float) (b.X2 - b.X1) *
-#if defined(ROUTE_RANDOMIZED)
-			 (0.3 + rand () / (RAND_MAX + 1.0)) *
+  heap_destroy (&net_heap);
 #endif
-			 (b.Y2 - b.Y1) * (p->type == PLANE ?
-					  -1 : (p->type ==
-						PAD ? 1 : 10)), p);
-	  }
-	  END_LOOP;
-	  ros.net_completely_routed = 0;
-	  while (!heap_is_empty (net_heap))
+  rns.net_completely_routed = ros.net_completely_routed;
+  rns.pushes = route_counts.pushes - pushes;
+  rns.pops = route_counts.pops - pops;
+  rns.areas = route_counts.areas - areas;
+  rns.usec = g_get_monotonic_time () - start;
+  return rns;
+}
+
+/*!
+ * \brief Write a name for a net to the trace.
+ *
+ * That is the first terminal of the net on an element, or else where the
+ * net starts.
+ */
+static void
+TraceNetName (routebox_t * net)
+{
+  routebox_t *p;
+  ElementType *element = NULL;
+  char *number = NULL;
+
+  LIST_LOOP (net, same_net, p);
+  {
+    if (p->type == PIN && p->parent.pin->Element)
+      {
+	element = (ElementType *) p->parent.pin->Element;
+	number = p->parent.pin->Number;
+	break;
+      }
+    if (p->type == PAD && p->parent.pad->Element)
+      {
+	element = (ElementType *) p->parent.pad->Element;
+	number = p->parent.pad->Number;
+	break;
+      }
+  }
+  END_LOOP;
+
+  if (element)
+    fprintf (route_trace, "%s-%s",
+	     NAMEONPCB_NAME (element) ? NAMEONPCB_NAME (element) : "?",
+	     number ? number : "?");
+  else
+    pcb_fprintf (route_trace, "%mD", net->sbox.X1, net->sbox.Y1);
+}
+
+/*!
+ * \brief Count a routed net in the statistics of its pass, and trace it.
+ */
+static void
+NoteNetStats (routebox_t * net, struct routenet_status *rns)
+{
+  pass_stats.nets++;
+  if (!rns->net_completely_routed)
+    pass_stats.unfinished++;
+  pass_stats.pushes += rns->pushes;
+  pass_stats.pops += rns->pops;
+  pass_stats.areas += rns->areas;
+  pass_stats.usec += rns->usec;
+  MAKEMAX (pass_stats.worst_usec, rns->usec);
+
+  if (route_trace == NULL)
+    return;
+  fprintf (route_trace, "net pass %d ", AutoRouteParameters.pass - 1);
+  TraceNetName (net);
+  fprintf (route_trace, " %s cost %.0f pushes %ld pops %ld areas %ld"
+	   " time %.3f ms\n",
+	   rns->net_completely_routed ? "routed" : "unfinished",
+	   rns->cost < EXPENSIVE ? rns->cost : -1.0, rns->pushes, rns->pops,
+	   rns->areas, rns->usec / 1000.0);
+}
+
+/*!
+ * \brief Report the statistics of a pass.
+ */
+static void
+ReportPass (int pass, cost_t this_cost, struct routeall_status *ras)
+{
+  char *text =
+    pcb_g_strdup_printf ("pass %d: %d nets routed, %d unfinished; "
+		       "%d of %d subnets routed, %d with conflicts, "
+		       "%d failed, %d nets ripped up; cost %.0f; "
+		       "%ld heap pushes, %ld pops, %ld expansion areas; "
+		       "%.3f s, slowest net %.3f s\n",
+		       pass, pass_stats.nets, pass_stats.unfinished,
+		       ras->routed_subnets, ras->total_subnets,
+		       ras->conflict_subnets, ras->failed, ras->ripped,
+		       this_cost, pass_stats.pushes, pass_stats.pops,
+		       pass_stats.areas, pass_stats.usec / 1e6,
+		       pass_stats.worst_usec / 1e6);
+
+  if (Settings.AutorouteStats)
+    Message ("%s", text);
+  if (route_trace)
+    {
+      fputs (text, route_trace);
+      fflush (route_trace);
+    }
+  g_free (text);
+}
+
+/*!
+ * \brief Put a routed net on the heap of the next pass.
+ */
+static void
+FinishNet (routebox_t * net, struct routenet_status *rns,
+	   heap_t * next_pass, cost_t * this_cost)
+{
+  routebox_t *p;
+
+  NoteNetStats (net, rns);
+  if (!rns->net_completely_routed)
+    net->flags.is_bad = 1;	/* don't skip this the next round */
+
+  /* Route easiest nets from this pass first on next pass.
+   * This works best because it's likely that the hardest
+   * is the last one routed (since it has the most obstacles)
+   * but it will do no good to rip it up and try it again
+   * without first changing any of the other routes
+   */
+  heap_insert (next_pass, rns->cost, net);
+  if (rns->cost < EXPENSIVE)
+    *this_cost += rns->cost;
+  /* reset subnet_processed flags */
+  LIST_LOOP (net, same_net, p);
+  {
+    p->flags.subnet_processed = 0;
+  }
+  END_LOOP;
+}
+
+static BoxType
+net_bounds (routebox_t * net)
+{
+  routebox_t *p;
+  BoxType bb = shrink_routebox (net);
+
+  LIST_LOOP (net, same_net, p);
+  {
+    MAKEMIN (bb.X1, p->sbox.X1);
+    MAKEMIN (bb.Y1, p->sbox.Y1);
+    MAKEMAX (bb.X2, p->sbox.X2);
+    MAKEMAX (bb.Y2, p->sbox.Y2);
+  }
+  END_LOOP;
+  return bb;
+}
+
+/*!
+ * \brief What a worker writes before the steps and boxes it drew.
+ */
+struct spec_result
+{
+  struct routenet_status rns;
+  struct routeall_status ras;
+  guint steps, drawn;
+};
+
+/*!
+ * \brief Take up to jobs nets, whose bounds don't come near each other,
+ * from the front of a heap.
+ *
+ * Nets that are passed over go back on the heap.  At most 4 * jobs nets
+ * are looked at.
+ *
+ * \return the number of nets in batch.
+ */
+static int
+TakeBatch (heap_t * heap, routebox_t ** batch, int jobs, Coord bloat)
+{
+  BoxType *bounds = (BoxType *) malloc (jobs * sizeof (BoxType));
+  routebox_t **skipped = (routebox_t **) malloc (4 * jobs * sizeof (*skipped));
+  cost_t *costs = (cost_t *) malloc (4 * jobs * sizeof (cost_t));
+  routebox_t *net;
+  BoxType b;
+  cost_t cost;
+  int n = 0, k = 0, looked, j;
+
+  for (looked = 0; n < jobs && looked < 4 * jobs && !heap_is_empty (heap);
+       looked++)
+    {
+      cost = heap_min_cost (heap);
+      net = (routebox_t *) heap_remove_smallest (heap);
+      b = net_bounds (net);
+      b = bloat_box (&b, bloat);
+      for (j = 0; j < n; j++)
+	if (box_intersect (&b, &bounds[j]))
+	  break;
+      if (j < n)
+	{
+	  skipped[k] = net;
+	  costs[k++] = cost;
+	  continue;
+	}
+      bounds[n] = b;
+      batch[n++] = net;
+    }
+  while (k-- > 0)
+    heap_insert (heap, costs[k], skipped[k]);
+
+  free (bounds);
+  free (skipped);
+  free (costs);
+  return n;
+}
+
+/*!
+ * \brief A batch of nets routed by RouteBatch(), and what it routes them
+ * with.
+ */
+typedef struct
+{
+  routedata_t *rd;
+  routebox_t **batch;
+  int pass;
+  struct routeall_status *ras;
+  heap_t *next_pass;
+  cost_t *this_cost;
+  rtree_t *drawn[MAX_GROUP];	/*!< What the nets merged so far drew. */
+  GArray *steps, *boxes, *groups;
+} route_batch;
+
+/*!
+ * \brief Route net \p part of a batch in a worker process and write what
+ * was drawn to fp.
+ */
+static int
+RouteNetWorker (int part, FILE * fp, void *data)
+{
+  route_batch *b = (route_batch *) data;
+  struct spec_result r;
+  routebox_t *rb;
+  guint i;
+  bool ok;
+
+  memset (&r, 0, sizeof (r));
+  spec_steps = g_array_new (FALSE, FALSE, sizeof (spec_step));
+  spec_drawn = g_ptr_array_new ();
+  InitNetParameters (b->pass, b->batch[part]);
+  r.rns = RouteNet (b->rd, b->batch[part], b->pass, &r.ras, 0, 0);
+  r.steps = spec_steps->len;
+  r.drawn = spec_drawn->len;
+
+  ok = fwrite (&r, sizeof (r), 1, fp) == 1
+       && fwrite (spec_steps->data, sizeof (spec_step), r.steps, fp)
+          == r.steps;
+  for (i = 0; ok && i < r.drawn; i++)
+    {
+      rb = (routebox_t *) g_ptr_array_index (spec_drawn, i);
+      ok = fwrite (&rb->box, sizeof (BoxType), 1, fp) == 1
+	   && fwrite (&rb->group, sizeof (rb->group), 1, fp) == 1;
+    }
+  return ok ? 0 : 1;
+}
+
+/*!
+ * \brief Read what a worker drew.
+ *
+ * \param boxes set to the boxes drawn, with their layer groups in
+ * groups.
+ */
+static bool
+ReadRouteNetWorker (FILE * fp, struct spec_result *r, GArray * steps,
+		    GArray * boxes, GArray * groups)
+{
+  guint i;
+
+  if (fread (r, sizeof (*r), 1, fp) != 1)
+    return false;
+  g_array_set_size (steps, r->steps);
+  if (fread (steps->data, sizeof (spec_step), r->steps, fp) != r->steps)
+    return false;
+  g_array_set_size (boxes, r->drawn);
+  g_array_set_size (groups, r->drawn);
+  for (i = 0; i < r->drawn; i++)
+    if (fread (&g_array_index (boxes, BoxType, i), sizeof (BoxType), 1,
+	       fp) != 1
+	|| fread (&g_array_index (groups, unsigned short, i),
+		  sizeof (unsigned short), 1, fp) != 1)
+      return false;
+  return true;
+}
+
+/*!
+ * \brief Draw the steps a worker recorded in the route data.
+ */
+static void
+ReplaySteps (routedata_t * rd, GArray * steps)
+{
+  spec_step *step;
+  guint i;
+
+  for (i = 0; i < steps->len; i++)
+    {
+      step = &g_array_index (steps, spec_step, i);
+      switch (step->kind)
+	{
+	case SPEC_LINE:
+	  RD_DrawLine (rd, step->X1, step->Y1, step->X2, step->Y2,
+		       step->size, step->group, spec_box_of (step->a),
+		       step->is_bad, step->is_45);
+	  break;
+	case SPEC_VIA:
+	  RD_DrawVia (rd, step->X1, step->Y1, step->size,
+		      spec_box_of (step->a), step->is_bad);
+	  break;
+	case SPEC_THERMAL:
+	  RD_DrawThermal (rd, step->X1, step->Y1, step->group, step->layer,
+			  spec_box_of (step->a), step->is_bad);
+	  break;
+	case SPEC_MERGE:
+	  MergeNets (spec_box_of (step->a), spec_box_of (step->b), SUBNET);
+	  break;
+	case SPEC_BAD:
+	  spec_box_of (step->a)->flags.is_bad = 1;
+	  break;
+	}
+    }
+}
+
+/*!
+ * \brief Draw the route a worker found for net \p part of a batch, or
+ * route the net here.
+ *
+ * \return false if the worker's route comes near one drawn for an
+ * earlier net of the batch.
+ */
+static bool
+MergeRouteNetWorker (int part, FILE * fp, void *data)
+{
+  route_batch *b = (route_batch *) data;
+  routebox_t *net = b->batch[part];
+  struct spec_result r;
+  struct routenet_status rns;
+  routebox_t *rb;
+  guint j;
+  bool ok = true;
+
+  if (fp)
+    {
+      ok = ReadRouteNetWorker (fp, &r, b->steps, b->boxes, b->groups);
+      for (j = 0; ok && j < b->boxes->len; j++)
+	ok = r_region_is_empty (b->drawn[g_array_index (b->groups,
+							unsigned short, j)],
+				&g_array_index (b->boxes, BoxType, j));
+      if (!ok)
+	return false;
+    }
+
+  InitNetParameters (b->pass, net);
+  spec_drawn = g_ptr_array_new ();
+  if (fp)
+    {
+      ReplaySteps (b->rd, b->steps);
+      rns = r.rns;
+      b->ras->routed_subnets += r.ras.routed_subnets;
+      b->ras->conflict_subnets += r.ras.conflict_subnets;
+      b->ras->failed += r.ras.failed;
+      b->ras->total_nets_routed += r.ras.total_nets_routed;
+    }
+  else
+    rns = RouteNet (b->rd, net, b->pass, b->ras, 0, 0);
+  for (j = 0; j < spec_drawn->len; j++)
+    {
+      rb = (routebox_t *) g_ptr_array_index (spec_drawn, j);
+      r_insert_entry (b->drawn[rb->group], &rb->box, 0);
+    }
+  g_ptr_array_free (spec_drawn, TRUE);
+  spec_drawn = NULL;
+  FinishNet (net, &rns, b->next_pass, b->this_cost);
+  return true;
+}
+
+/*!
+ * \brief Route a batch of nets speculatively, one worker process each.
+ *
+ * Every worker routes its net against the route data as it is before
+ * any of the batch is routed.  The routes are then drawn here in batch
+ * order.  A route that comes near one drawn for an earlier net of the
+ * batch is thrown away and its net is routed again here, as is the net
+ * of a worker that fails.
+ *
+ * \return false if the user cancelled.
+ */
+static bool
+RouteBatch (routedata_t * rd, routebox_t ** batch, int n, int pass,
+	    struct routeall_status *ras, heap_t * next_pass,
+	    cost_t * this_cost, int this_heap_item, int this_heap_size)
+{
+  route_batch b;
+  double percent;
+  int i;
+
+  b.rd = rd;
+  b.batch = batch;
+  b.pass = pass;
+  b.ras = ras;
+  b.next_pass = next_pass;
+  b.this_cost = this_cost;
+  for (i = 0; i < max_group; i++)
+    b.drawn[i] = r_create_tree (NULL, 0, 0);
+  b.steps = g_array_new (FALSE, FALSE, sizeof (spec_step));
+  b.boxes = g_array_new (FALSE, FALSE, sizeof (BoxType));
+  b.groups = g_array_new (FALSE, FALSE, sizeof (unsigned short));
+
+  /* a single net is routed here */
+  pcb_fork_workers (n, n > 1 ? n : 0, -1, true, RouteNetWorker,
+		    MergeRouteNetWorker, &b);
+
+  for (i = 0; i < max_group; i++)
+    r_destroy_tree (&b.drawn[i]);
+  g_array_free (b.steps, TRUE);
+  g_array_free (b.boxes, TRUE);
+  g_array_free (b.groups, TRUE);
+
+  percent = calculate_progress (this_heap_item, this_heap_size, ras);
+  if (pcb_job_progress (percent * 100., 100, _("Autorouting tracks")))
+    {
+      ras->total_nets_routed = 0;
+      ras->conflict_subnets = 0;
+      Message ("Autorouting cancelled\n");
+      return false;
+    }
+  return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * Checkpoints of RouteAll(), written at the end of every pass with
+ * --autoroute-checkpoint and read back by AutoRoute(..., Resume).
+ *
+ * A checkpoint holds the nets in the order of the next pass, with their
+ * costs.  For every subnet it holds the fixed boxes, which are found on
+ * the board again by their type, layer group and extent, and the
+ * unfixed ones, which are made again as the route tracer made them.  The
+ * bad marks, the pass parity and the pass of every box go with it, those
+ * being what the passes to come rip up and route by.
+ */
+#define CHECKPOINT_MAGIC "pcb-autoroute-checkpoint 1"
+
+typedef enum
+  { CP_NET, CP_SUBNET, CP_FIXED, CP_LINE, CP_VIA, CP_THERMAL }
+  checkpoint_kind;
+
+typedef struct checkpoint_rec
+{
+  checkpoint_kind kind;
+  cost_t cost;
+  int type, group, layer, style;
+  int is_bad, is_odd, nonstraight, bl_to_ur, pass;
+  long X1, Y1, X2, Y2;
+  /* the fixed box found on the board, or the net of a CP_NET */
+  routebox_t *box;
+}
+checkpoint_rec;
+
+static int
+CheckpointStyle (routedata_t * rd, RouteStyleType * style)
+{
+  int i;
+
+  for (i = 0; i < NUM_STYLES; i++)
+    if (rd->styles[i] == style)
+      return i;
+  return NUM_STYLES;
+}
+
+static void
+WriteCheckpointBox (FILE * fp, routedata_t * rd, routebox_t * rb)
+{
+  routebox_t *p;
+  bool is_bad;
+  Coord r;
+
+  if (rb->flags.fixed)
+    {
+      fprintf (fp, "fixed %d %d %ld %ld %ld %ld %d\n", rb->type,
+	       (int) rb->group, (long) rb->sbox.X1, (long) rb->sbox.Y1,
+	       (long) rb->sbox.X2, (long) rb->sbox.Y2, rb->flags.is_bad);
+      return;
+    }
+  switch (rb->type)
+    {
+    case LINE:
+      fprintf (fp, "line %d %ld %ld %ld %ld %d %d %d %d %d %d\n",
+	       (int) rb->group, (long) rb->sbox.X1, (long) rb->sbox.Y1,
+	       (long) rb->sbox.X2, (long) rb->sbox.Y2,
+	       CheckpointStyle (rd, rb->style), rb->flags.is_bad,
+	       rb->flags.is_odd, rb->flags.nonstraight, rb->flags.bl_to_ur,
+	       rb->pass);
+      break;
+    case VIA:
+      /* the shadows are made again with the via, bad as any of them is */
+      is_bad = rb->flags.is_bad;
+      LIST_LOOP (rb, same_net, p);
+      if (p->type == VIA_SHADOW && p->parent.via_shadow == rb
+	  && p->flags.is_bad)
+	is_bad = true;
+      END_LOOP;
+      r = (rb->sbox.X2 - rb->sbox.X1 - 1) / 2;
+      fprintf (fp, "via %ld %ld %ld %d %d %d %d\n",
+	       (long) (rb->sbox.X1 + r), (long) (rb->sbox.Y1 + r), (long) r,
+	       CheckpointStyle (rd, rb->style), is_bad, rb->flags.is_odd,
+	       rb->pass);
+      break;
+    case THERMAL:
+      fprintf (fp, "thermal %d %d %ld %ld %d %d %d\n", (int) rb->group,
+	       (int) rb->layer, (long) rb->sbox.X1, (long) rb->sbox.Y1,
+	       CheckpointStyle (rd, rb->style), rb->flags.is_bad,
+	       rb->flags.is_odd);
+      break;
+    default:
+      break;
+    }
+}
+
+static void
+WriteCheckpointNet (FILE * fp, routedata_t * rd, routebox_t * net,
+		    cost_t cost)
+{
+  routebox_t *p, *q;
+  bool fixed;
+
+  fprintf (fp, "net %.17g\n", cost);
+  FOREACH_SUBNET (net, p);
+  {
+    /* a subnet of nothing but traces goes with the rip-up of its net */
+    fixed = false;
+    LIST_LOOP (p, same_subnet, q);
+    if (q->flags.fixed)
+      {
+	fixed = true;
+	break;
+      }
+    END_LOOP;
+    if (fixed)
+      {
+	fputs ("subnet\n", fp);
+	LIST_LOOP (p, same_subnet, q);
+	if (q->flags.fixed)
+	  WriteCheckpointBox (fp, rd, q);
+	END_LOOP;
+	LIST_LOOP (p, same_subnet, q);
+	if (!q->flags.fixed)
+	  WriteCheckpointBox (fp, rd, q);
+	END_LOOP;
+      }
+  }
+  END_FOREACH (net, p);
+}
+
+/*!
+ * \brief Write the checkpoint of the pass that has just ended.
+ *
+ * The file is written under another name first, so that a checkpoint
+ * that could not be finished does not replace the one before.
+ */
+static void
+SaveCheckpoint (routedata_t * rd, heap_t * next, int next_pass,
+		cost_t last_cost, int total_nets_routed)
+{
+  char *filename = Settings.AutorouteCheckpoint;
+  int n = heap_size (next), k;
+  routebox_t **nets = (routebox_t **) malloc (MAX (n, 1) * sizeof (*nets));
+  cost_t *costs = (cost_t *) malloc (MAX (n, 1) * sizeof (*costs));
+  char *tmpname;
+  FILE *fp;
+  bool ok;
+
+  /* take the nets off in order and put them back the same way, which
+   * is what resuming does too */
+  for (k = 0; k < n; k++)
+    {
+      costs[k] = heap_min_cost (next);
+      nets[k] = (routebox_t *) heap_remove_smallest (next);
+    }
+  for (k = 0; k < n; k++)
+    heap_insert (next, costs[k], nets[k]);
+
+  tmpname = g_strconcat (filename, ".tmp", NULL);
+  if ((fp = fopen (tmpname, "w")) == NULL)
+    OpenErrorMessage (tmpname);
+  else
+    {
+      fprintf (fp, "%s\npass %d %.17g %d\n", CHECKPOINT_MAGIC, next_pass,
+	       last_cost, total_nets_routed);
+      for (k = 0; k < n; k++)
+	WriteCheckpointNet (fp, rd, nets[k], costs[k]);
+      fputs ("end\n", fp);
+      ok = !ferror (fp);
+      if (fclose (fp) != 0 || !ok || rename (tmpname, filename) != 0)
+	{
+	  Message (_("Can't write autoroute checkpoint %s\n"), filename);
+	  unlink (tmpname);
+	}
+    }
+  g_free (tmpname);
+  free (costs);
+  free (nets);
+}
+
+static bool
+ParseCheckpointLine (const char *line, checkpoint_rec * rec)
+{
+  memset (rec, 0, sizeof (*rec));
+  if (sscanf (line, "net %lf", &rec->cost) == 1)
+    rec->kind = CP_NET;
+  else if (strncmp (line, "subnet", 6) == 0)
+    rec->kind = CP_SUBNET;
+  else if (sscanf (line, "fixed %d %d %ld %ld %ld %ld %d", &rec->type,
+		   &rec->group, &rec->X1, &rec->Y1, &rec->X2, &rec->Y2,
+		   &rec->is_bad) == 7)
+    rec->kind = CP_FIXED;
+  else if (sscanf (line, "line %d %ld %ld %ld %ld %d %d %d %d %d %d",
+		   &rec->group, &rec->X1, &rec->Y1, &rec->X2, &rec->Y2,
+		   &rec->style, &rec->is_bad, &rec->is_odd,
+		   &rec->nonstraight, &rec->bl_to_ur, &rec->pass) == 11)
+    rec->kind = CP_LINE;
+  else if (sscanf (line, "via %ld %ld %ld %d %d %d %d", &rec->X1,
+		   &rec->Y1, &rec->X2, &rec->style, &rec->is_bad,
+		   &rec->is_odd, &rec->pass) == 7)
+    rec->kind = CP_VIA;		/* X2 is the radius */
+  else if (sscanf (line, "thermal %d %d %ld %ld %d %d %d", &rec->group,
+		   &rec->layer, &rec->X1, &rec->Y1, &rec->style,
+		   &rec->is_bad, &rec->is_odd) == 7)
+    rec->kind = CP_THERMAL;
+  else
+    return false;
+  if (rec->group < 0 || rec->group >= max_group
+      || !is_layer_group_active[rec->group]
+      || rec->style < 0 || rec->style > NUM_STYLES)
+    return false;
+  switch (rec->kind)
+    {
+    case CP_FIXED:
+    case CP_LINE:
+      return rec->X1 <= rec->X2 && rec->Y1 <= rec->Y2;
+    case CP_VIA:
+      return AutoRouteParameters.use_vias && rec->X2 >= 0;
+    default:
+      return true;
+    }
+}
+
+struct checkpoint_find_info
+{
+  checkpoint_rec *rec;
+  routebox_t *found;
+};
+
+static int
+checkpoint_find_cb (const BoxType * b, void *cl)
+{
+  struct checkpoint_find_info *info = (struct checkpoint_find_info *) cl;
+  routebox_t *rb = (routebox_t *) b;
+
+  if (info->found == NULL && rb->flags.fixed
+      && rb->type == info->rec->type && rb->sbox.X1 == info->rec->X1
+      && rb->sbox.Y1 == info->rec->Y1 && rb->sbox.X2 == info->rec->X2
+      && rb->sbox.Y2 == info->rec->Y2)
+    info->found = rb;
+  return 0;
+}
+
+static routebox_t *
+FindCheckpointBox (routedata_t * rd, checkpoint_rec * rec)
+{
+  struct checkpoint_find_info info;
+  BoxType region;
+
+  region.X1 = rec->X1;
+  region.Y1 = rec->Y1;
+  region.X2 = rec->X2;
+  region.Y2 = rec->Y2;
+  info.rec = rec;
+  info.found = NULL;
+  r_search (rd->layergrouptree[rec->group], &region, NULL,
+	    checkpoint_find_cb, &info);
+  return info.found;
+}
+
+static bool
+InSubnet (routebox_t * subnet, routebox_t * rb)
+{
+  routebox_t *p;
+
+  LIST_LOOP (subnet, same_subnet, p);
+  if (p == rb)
+    return true;
+  END_LOOP;
+  return false;
+}
+
+/*!
+ * \brief Make a trace line of a checkpoint again, as RD_DrawLine() made
+ * it.
+ */
+static void
+RestoreLine (routedata_t * rd, checkpoint_rec * rec, routebox_t * subnet)
+{
+  routebox_t *rb = (routebox_t *) malloc (sizeof (*rb));
+
+  memset ((void *) rb, 0, sizeof (*rb));
+  rb->style = rd->styles[rec->style];
+  init_const_box (rb, rec->X1, rec->Y1, rec->X2, rec->Y2,
+		  rb->style->Keepaway);
+  rb->group = rec->group;
+  rb->type = LINE;
+  rb->parent.line = NULL;
+  rb->flags.fixed = 0;
+  rb->flags.is_odd = rec->is_odd;
+  rb->flags.is_bad = rec->is_bad;
+  rb->came_from = ALL;
+  rb->flags.homeless = 0;
+  rb->flags.nonstraight = rec->nonstraight;
+  rb->flags.bl_to_ur = rec->bl_to_ur;
+  rb->pass = rec->pass;
+  InitLists (rb);
+  MergeNets (rb, subnet, NET);
+  MergeNets (rb, subnet, SUBNET);
+  assert (__routebox_is_good (rb));
+  r_insert_entry (rd->layergrouptree[rb->group], &rb->box, 1);
+  if (AutoRouteParameters.use_vias)
+    mtspace_add (rd->mtspace, &rb->box, rb->flags.is_odd ? ODD : EVEN,
+		 rb->style->Keepaway);
+  usedGroup[rb->group] = true;
+}
+
+/*!
+ * \brief Read a checkpoint back into freshly made route data.
+ *
+ * The whole file is checked against the board before anything is
+ * changed: every net of the route data has to be in it once, and every
+ * fixed box has to be found in its net.
+ *
+ * \return false if the checkpoint does not fit the board, with the
+ * route data left as it was.
+ */
+static bool
+LoadCheckpoint (routedata_t * rd, heap_t * this_pass, int *pass,
+		cost_t * last_cost, int *total_nets_routed)
+{
+  char *filename = Settings.AutorouteCheckpoint;
+  GHashTable *net_of, *seen;
+  GArray *recs;
+  checkpoint_rec rec, *r, *netrec = NULL;
+  routebox_t *net, *p, *subnet = NULL;
+  char line[256];
+  int nets = 0, rd_nets = 0;
+  bool ok, in_subnet = false, has_fixed = false;
+  guint i;
+  FILE *fp;
+
+  if ((fp = fopen (filename, "r")) == NULL)
+    {
+      OpenErrorMessage (filename);
+      return false;
+    }
+  recs = g_array_new (FALSE, FALSE, sizeof (checkpoint_rec));
+  ok = fgets (line, sizeof (line), fp) != NULL
+    && strncmp (line, CHECKPOINT_MAGIC, strlen (CHECKPOINT_MAGIC)) == 0
+    && fgets (line, sizeof (line), fp) != NULL
+    && sscanf (line, "pass %d %lf %d", pass, last_cost,
+	       total_nets_routed) == 3;
+  while (ok && fgets (line, sizeof (line), fp) != NULL
+	 && strncmp (line, "end", 3) != 0)
+    {
+      ok = ParseCheckpointLine (line, &rec);
+      if (ok)
+	g_array_append_val (recs, rec);
+    }
+  ok = ok && !ferror (fp) && strncmp (line, "end", 3) == 0;
+  fclose (fp);
+
+  /* check it against the board */
+  net_of = g_hash_table_new (NULL, NULL);
+  seen = g_hash_table_new (NULL, NULL);
+  LIST_LOOP (rd->first_net, different_net, net);
+  {
+    rd_nets++;
+    LIST_LOOP (net, same_net, p);
+    g_hash_table_insert (net_of, p, net);
+    END_LOOP;
+  }
+  END_LOOP;
+  for (i = 0; ok && i < recs->len; i++)
+    {
+      r = &g_array_index (recs, checkpoint_rec, i);
+      switch (r->kind)
+	{
+	case CP_NET:
+	  ok = netrec == NULL || netrec->box != NULL;
+	  netrec = r;
+	  in_subnet = false;
+	  nets++;
+	  break;
+	case CP_SUBNET:
+	  ok = netrec != NULL;
+	  in_subnet = true;
+	  has_fixed = false;
+	  break;
+	case CP_FIXED:
+	  ok = in_subnet && (r->box = FindCheckpointBox (rd, r)) != NULL;
+	  if (!ok)
+	    break;
+	  net = (routebox_t *) g_hash_table_lookup (net_of, r->box);
+	  if (netrec->box == NULL)
 	    {
-	      p = (routebox_t *) heap_remove_smallest (net_heap);
+	      ok = net != NULL && !g_hash_table_lookup (seen, net);
+	      netrec->box = net;
+	      g_hash_table_insert (seen, net, net);
+	    }
+	  else
+	    ok = net == netrec->box;
+	  has_fixed = true;
+	  break;
+	default:
+	  ok = has_fixed;
+	  break;
+	}
+    }
+  ok = ok && nets == rd_nets && (netrec == NULL || netrec->box != NULL);
+  g_hash_table_destroy (seen);
+  g_hash_table_destroy (net_of);
+  if (!ok)
+    {
+      g_array_free (recs, TRUE);
+      return false;
+    }
+
+  /* and make it so */
+  for (i = 0; i < recs->len; i++)
+    {
+      r = &g_array_index (recs, checkpoint_rec, i);
+      switch (r->kind)
+	{
+	case CP_NET:
+	  heap_insert (this_pass, r->cost, r->box);
+	  break;
+	case CP_SUBNET:
+	  subnet = NULL;
+	  break;
+	case CP_FIXED:
+	  r->box->flags.is_bad = r->is_bad;
+	  if (subnet == NULL)
+	    subnet = r->box;
+	  else if (!InSubnet (subnet, r->box))
+	    MergeNets (subnet, r->box, SUBNET);
+	  break;
+	case CP_LINE:
+	  RestoreLine (rd, r, subnet);
+	  break;
+	case CP_VIA:
+	  AutoRouteParameters.style = rd->styles[r->style];
+	  AutoRouteParameters.is_odd = r->is_odd;
+	  AutoRouteParameters.pass = r->pass;
+	  RD_DrawVia (rd, r->X1, r->Y1, r->X2, subnet, r->is_bad);
+	  break;
+	case CP_THERMAL:
+	  AutoRouteParameters.style = rd->styles[r->style];
+	  AutoRouteParameters.is_odd = r->is_odd;
+	  RD_DrawThermal (rd, r->X1, r->Y1, r->group, r->layer, subnet,
+			  r->is_bad);
+	  break;
+	}
+    }
+  g_array_free (recs, TRUE);
+  return true;
+}
+
+/*!
+ * \brief Route all nets, over a number of passes.
+ *
+ * With --route-jobs above 1, batches of nets that lie apart from each
+ * other are routed at once by worker processes, see RouteBatch().
+ *
+ * With --autoroute-budget the routing stops when the time is up, and
+ * keeps what it has that is free of conflicts.  With
+ * --autoroute-checkpoint the state is written out at the end of every
+ * pass, and with \p resume routing starts again from that.
+ */
+struct routeall_status
+RouteAll (routedata_t * rd, bool resume)
+{
+  struct routeall_status ras;
+  struct routenet_status rns;
+  heap_t *this_pass, *next_pass, *tmp;
+  routebox_t *net;
+  cost_t last_cost = 0, this_cost = 0;
+  int i, first_pass = 0;
+  int this_heap_size;
+  int this_heap_item;
+  gint64 deadline = 0;
+  int jobs = TEST_FLAG (LIVEROUTEFLAG, PCB) ? 1 : Settings.RouteJobs;
+  routebox_t **batch = (routebox_t **) malloc (MAX (jobs, 1) * sizeof (*batch));
+  int n, m, k;
+
+  memset (&ras, 0, sizeof (ras));
+  this_pass = heap_create ();
+  next_pass = heap_create ();
+  if (resume)
+    {
+      if (!LoadCheckpoint (rd, this_pass, &first_pass, &last_cost,
+			   &ras.total_nets_routed))
+	{
+	  Message (_("Autoroute checkpoint %s does not fit this board\n"),
+		   Settings.AutorouteCheckpoint);
+	  goto out;
+	}
+    }
+  else
+    {
+      /* initialize heap for first pass;
+       * do smallest area first; that makes
+       * the subsequent costs more representative */
+      LIST_LOOP (rd->first_net, different_net, net);
+      {
+	double area;
+	BoxType bb = net_bounds (net);
+	area = (double) (bb.X2 - bb.X1) * (bb.Y2 - bb.Y1);
+	heap_insert (this_pass, area, net);
+      }
+      END_LOOP;
+    }
+  if (Settings.AutorouteBudget > 0)
+    deadline = g_get_monotonic_time ()
+      + (gint64) Settings.AutorouteBudget * 1000000;
+
+  if (Settings.AutorouteTrace && *Settings.AutorouteTrace)
+    {
+      route_trace = fopen (Settings.AutorouteTrace, "w");
+      if (route_trace == NULL)
+	OpenErrorMessage (Settings.AutorouteTrace);
+    }
+
+  /* refinement/finishing passes */
+  for (i = first_pass; i <= passes + smoothes; i++)
+    {
+#ifdef ROUTE_VERBOSE
+      if (i > 0 && i <= passes)
+	printf ("--------- STARTING REFINEMENT PASS %d ------------\n", i);
+      else if (i > passes)
+	printf ("--------- STARTING SMOOTHING PASS %d -------------\n",
+		i - passes);
 #endif
-	      if (!p->flags.fixed || p->flags.subnet_processed ||
-		  p->type == OTHER)
-		continue;
+      ras.total_subnets = ras.routed_subnets = ras.conflict_subnets =
+	ras.failed = ras.ripped = 0;
+      memset (&pass_stats, 0, sizeof (pass_stats));
+      assert (heap_is_empty (next_pass));
 
-	      while (!ros.net_completely_routed)
+      this_heap_size = heap_size (this_pass);
+      for (this_heap_item = 0; !heap_is_empty (this_pass); this_heap_item++)
+	{
+#ifdef ROUTE_DEBUG
+	  if (aabort)
+	    break;
+#endif
+	  if (deadline && g_get_monotonic_time () >= deadline)
+	    {
+	      Message (_("Autorouting stopped after %d seconds, "
+			 "nets still in conflict are left unrouted\n"),
+		       Settings.AutorouteBudget);
+	      RipUpBadNets (rd);
+	      ras.conflict_subnets = 0;
+	      goto out;
+	    }
+	  if (jobs > 1)
+	    {
+	      n = TakeBatch (this_pass, batch, jobs, rd->max_bloat);
+	      for (k = m = 0; k < n; k++)
 		{
-		  double percent;
-
-		  assert (no_expansion_boxes (rd));
-		  /* FIX ME: the number of edges to examine should be in autoroute parameters
-		   * i.e. the 2000 and 800 hard-coded below should be controllable by the user
-		   */
-		  ros =
-		    RouteOne (rd, p, NULL,
-			      ((AutoRouteParameters.
-				is_smoothing ? 2000 : 800) * (i +
-							      1)) *
-			      routing_layers);
-		  total_net_cost += ros.best_route_cost;
-		  if (ros.found_route)
-		    {
-		      if (ros.route_had_conflicts)
-			ras.conflict_subnets++;
-		      else
-			{
-			  ras.routed_subnets++;
-			  ras.total_nets_routed++;
-			}
-		    }
+		  InitNetParameters (i, batch[k]);
+		  if (PrepareNet (rd, batch[k], i, &ras))
+		    batch[m++] = batch[k];
 		  else
-		    {
-		      if (!ros.net_completely_routed)
-			ras.failed++;
-		      /* don't bother trying any other source in this subnet */
-		      LIST_LOOP (p, same_subnet, pp);
-		      pp->flags.subnet_processed = 1;
-		      END_LOOP;
-		      break;
-		    }
-		  /* note that we can infer nothing about ras.total_subnets based
-		   * on the number of calls to RouteOne, because we may be unable
-		   * to route a net from a particular starting point, but perfectly
-		   * able to route it from some other. */
-		  percent = calculate_progress (this_heap_item, this_heap_size, &ras);
-		  request_cancel = gui->progress (percent * 100., 100,
-						  _("Autorouting tracks"));
-		  if (request_cancel)
-		    {
-		      ras.total_nets_routed = 0;
-		      ras.conflict_subnets = 0;
-		      Message ("Autorouting cancelled\n");
-		      goto out;
-		    }
+		    heap_insert (next_pass, 0, batch[k]);
 		}
+	      this_heap_item += n - 1;
+	      if (!RouteBatch (rd, batch, m, i, &ras, next_pass, &this_cost,
+			       this_heap_item, this_heap_size))
+		goto out;
+	      continue;
 	    }
-#ifndef NET_HEAP
-	  END_LOOP;
-#endif
-	  if (!ros.net_completely_routed)
-	    net->flags.is_bad = 1;	/* don't skip this the next round */
-
-	  /* Route easiest nets from this pass first on next pass.
-	   * This works best because it's likely that the hardest
-	   * is the last one routed (since it has the most obstacles)
-	   * but it will do no good to rip it up and try it again
-	   * without first changing any of the other routes
-	   */
-	  heap_insert (next_pass, total_net_cost, net);
-	  if (total_net_cost < EXPENSIVE)
-	    this_cost += total_net_cost;
-	  /* reset subnet_processed flags */
-	  LIST_LOOP (net, same_net, p);
-	  {
-	    p->flags.subnet_processed = 0;
-	  }
-	  END_LOOP;
+	  net = (routebox_t *) heap_remove_smallest (this_pass);
+	  InitNetParameters (i, net);
+	  if (!PrepareNet (rd, net, i, &ras))
+	    {
+	      heap_insert (next_pass, 0, net);
+	      continue;
+	    }
+	  rns = RouteNet (rd, net, i, &ras, this_heap_item, this_heap_size);
+	  if (rns.cancelled)
+	    goto out;
+	  FinishNet (net, &rns, next_pass, &this_cost);
 	}
       /* swap this_pass and next_pass and do it all over again! */
       ro = 0;
@@ -5002,6 +6307,7 @@ RouteAll (routedata_t * rd)
 	 i, ras.routed_subnets, ras.total_subnets, this_cost,
 	 ras.conflict_subnets, ras.failed, ras.ripped);
 #endif
+      ReportPass (i, this_cost, &ras);
 #ifdef ROUTE_DEBUG
       if (aabort)
 	break;
@@ -5015,6 +6321,9 @@ RouteAll (routedata_t * rd)
 	i = passes + smoothes - 1;
       last_cost = this_cost;
       this_cost = 0;
+      if (Settings.AutorouteCheckpoint && *Settings.AutorouteCheckpoint)
+	SaveCheckpoint (rd, this_pass, i + 1, last_cost,
+			ras.total_nets_routed);
     }
 
   Message ("%d of %d nets successfully routed.\n",
@@ -5023,9 +6332,12 @@ RouteAll (routedata_t * rd)
 out:
   heap_destroy (&this_pass);
   heap_destroy (&next_pass);
-#ifdef NET_HEAP
-  heap_destroy (&net_heap);
-#endif
+  free (batch);
+  if (route_trace)
+    {
+      fclose (route_trace);
+      route_trace = NULL;
+    }
 
   /* no conflicts should be left at the end of the process. */
   assert (ras.conflict_subnets == 0);
@@ -5226,17 +6538,23 @@ IronDownAllUnfixedPaths (routedata_t * rd)
 }
 
 bool
-AutoRoute (bool selected)
+AutoRoute (bool selected, bool resume)
 {
   bool changed = false;
   routedata_t *rd;
   int i;
 
+  if (resume && !(Settings.AutorouteCheckpoint && *Settings.AutorouteCheckpoint))
+    {
+      Message (_("No --autoroute-checkpoint to resume from\n"));
+      return false;
+    }
   total_wire_length = 0;
   total_via_count = 0;
 
 #ifdef ROUTE_DEBUG
-  ddraw = gui->request_debug_draw ();
+  /* no drawing from the worker of a job */
+  ddraw = pcb_job_in_worker () ? NULL : gui->request_debug_draw ();
   if (ddraw != NULL)
     {
       ar_gc = ddraw->make_gc ();
@@ -5391,9 +6709,9 @@ AutoRoute (bool selected)
     }
   /* okay, rd's idea of netlist now corresponds to what we want routed */
   /* auto-route all nets */
-  changed = (RouteAll (rd).total_nets_routed > 0) || changed;
+  changed = (RouteAll (rd, resume).total_nets_routed > 0) || changed;
 donerouting:
-  gui->progress (0, 0, NULL);
+  pcb_job_progress (0, 0, NULL);
   if (TEST_FLAG (LIVEROUTEFLAG, PCB))
     {
       int i;
@@ -0,0 +1,545 @@
+/*!
+ * \file src/boardcache.c
+ *
+ * \brief Binary cache of the clipped polygons of a board file.
+ *
+ * Clipping the polygons of a board, InitClipAll(), is usually the bulk
+ * of the time it takes to load a board with copper pours.  With
+ * --board-cache the clipped contours are saved next to the board file,
+ * in "<file>.cache", and the next load of the same board installs them
+ * instead of clipping again.
+ *
+ * The cache is keyed by a SHA-256 hash of the board file, of the
+ * default layer groups (used if the file has none) and of the name and
+ * modification time of the default font file (used if the file has no
+ * font, and which the clearances of text are drawn with), so any edit of
+ * the file or change of font invalidates it.  It is written in the
+ * native byte order and Coord size, a cache written by another build is
+ * ignored and rewritten.
+ *
+ * Objects are still parsed from the text file: the grammar in parse_y.y
+ * is the one definition of the file format, including the conversions of
+ * old file versions, and the object constructors build the rtrees as they
+ * go.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "global.h"
+#include "boardcache.h"
+#include "data.h"
+#include "polygon.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+#define BOARD_CACHE_MAGIC "PCBCACHE"
+#define BOARD_CACHE_SUFFIX ".cache"
+
+/*!
+ * \brief Version of the cache format.
+ *
+ * Bump it whenever the format or the results of the clipping code
+ * change, so that caches of older builds are not used.
+ */
+#define BOARD_CACHE_VERSION 1
+
+/*!
+ * \brief Written in native byte order to recognise foreign caches.
+ */
+#define BOARD_CACHE_BYTE_ORDER 0x01020304
+
+#define BOARD_CACHE_KEY_SIZE 32
+
+/*!
+ * \brief Contour flags in the cache.
+ */
+#define BOARD_CACHE_ORIENT 1
+#define BOARD_CACHE_ROUND 2
+
+/*!
+ * \brief The cache of the board being loaded.
+ */
+static struct
+{
+  char *path; /*!< Cache file name, NULL if no load is in progress. */
+  guint8 key[BOARD_CACHE_KEY_SIZE]; /*!< Hash of the board file. */
+  GMappedFile *map; /*!< The cache file, if it matches the board. */
+  const char *pos, *end; /*!< Unread part of map. */
+  guint32 polygons; /*!< Polygons in the cache. */
+  bool restored; /*!< The clipped polygons came from the cache. */
+} cache;
+
+static bool
+read_bytes (void *dst, size_t n)
+{
+  if (cache.end - cache.pos < n)
+    return false;
+  memcpy (dst, cache.pos, n);
+  cache.pos += n;
+  return true;
+}
+
+static bool
+read_u32 (guint32 *v)
+{
+  return read_bytes (v, sizeof (*v));
+}
+
+static bool
+read_coord (Coord *c)
+{
+  return read_bytes (c, sizeof (*c));
+}
+
+/*!
+ * \brief Check the header of the mapped cache file against the board.
+ */
+static bool
+read_header (void)
+{
+  char magic[sizeof (BOARD_CACHE_MAGIC) - 1];
+  guint8 key[BOARD_CACHE_KEY_SIZE];
+  guint32 version, order, coord_size;
+
+  cache.pos = g_mapped_file_get_contents (cache.map);
+  cache.end = cache.pos + g_mapped_file_get_length (cache.map);
+
+  return cache.pos != NULL
+    && read_bytes (magic, sizeof (magic))
+    && memcmp (magic, BOARD_CACHE_MAGIC, sizeof (magic)) == 0
+    && read_u32 (&version) && version == BOARD_CACHE_VERSION
+    && read_u32 (&order) && order == BOARD_CACHE_BYTE_ORDER
+    && read_u32 (&coord_size) && coord_size == sizeof (Coord)
+    && read_bytes (key, sizeof (key))
+    && memcmp (key, cache.key, sizeof (key)) == 0
+    && read_u32 (&cache.polygons);
+}
+
+static PLINE *
+read_contour (void)
+{
+  guint32 count, flags, i;
+  Coord cx, cy, radius;
+  double area;
+  Vector v;
+  PLINE *contour;
+
+  if (!read_u32 (&count) || count == 0 || !read_u32 (&flags)
+      || !read_coord (&cx) || !read_coord (&cy) || !read_coord (&radius)
+      || !read_bytes (&area, sizeof (area))
+      || count > (cache.end - cache.pos) / (2 * sizeof (Coord)))
+    return NULL;
+
+  read_coord (&v[0]);
+  read_coord (&v[1]);
+  contour = poly_NewContour (v);
+  for (i = 1; i < count; i++)
+    {
+      read_coord (&v[0]);
+      read_coord (&v[1]);
+      poly_InclVertex (contour->head.prev, poly_CreateNode (v));
+    }
+  poly_PreContour (contour, FALSE);
+
+  /* Keep what the clipping code had, not what is recomputed */
+  contour->Flags.orient = (flags & BOARD_CACHE_ORIENT) ? PLF_DIR : PLF_INV;
+  contour->is_round = (flags & BOARD_CACHE_ROUND) != 0;
+  contour->cx = cx;
+  contour->cy = cy;
+  contour->radius = radius;
+  contour->area = area;
+  return contour;
+}
+
+/*!
+ * \brief Read the pieces of one polygon, in the order they were written.
+ */
+static bool
+read_piece (POLYAREA *piece)
+{
+  PLINE **contours;
+  guint32 n, i;
+  bool ok = true;
+
+  if (!read_u32 (&n) || n == 0 || n > cache.end - cache.pos)
+    return false;
+
+  contours = g_new0 (PLINE *, n);
+  for (i = 0; ok && i < n; i++)
+    ok = (contours[i] = read_contour ()) != NULL
+      && (contours[i]->Flags.orient == PLF_DIR) == (i == 0);
+
+  if (ok)
+    {
+      /* Holes are linked in front of each other, include them backwards */
+      poly_InclContour (piece, contours[0]);
+      for (i = n - 1; i > 0; i--)
+        poly_InclContour (piece, contours[i]);
+    }
+  else
+    for (i = 0; i < n; i++)
+      poly_DelContour (&contours[i]);
+  g_free (contours);
+  return ok;
+}
+
+static bool
+read_polygon (PolygonType *polygon, POLYAREA **clipped)
+{
+  guint32 points, holes, pieces, i;
+  BoxType box;
+  POLYAREA *piece;
+
+  *clipped = NULL;
+  if (!read_u32 (&points) || points != polygon->PointN
+      || !read_u32 (&holes) || holes != polygon->HoleIndexN
+      || !read_coord (&box.X1) || !read_coord (&box.Y1)
+      || !read_coord (&box.X2) || !read_coord (&box.Y2)
+      || memcmp (&box, &polygon->BoundingBox, sizeof (box)) != 0
+      || !read_u32 (&pieces))
+    return false;
+
+  for (i = 0; i < pieces; i++)
+    {
+      piece = poly_Create ();
+      if (!read_piece (piece))
+        {
+          poly_Free (&piece);
+          poly_Free (clipped);
+          return false;
+        }
+      poly_M_Incl (clipped, piece);
+    }
+  return true;
+}
+
+static void
+write_bytes (FILE *fp, const void *src, size_t n, bool *ok)
+{
+  if (fwrite (src, 1, n, fp) != n)
+    *ok = false;
+}
+
+static void
+write_u32 (FILE *fp, guint32 v, bool *ok)
+{
+  write_bytes (fp, &v, sizeof (v), ok);
+}
+
+static void
+write_coord (FILE *fp, Coord c, bool *ok)
+{
+  write_bytes (fp, &c, sizeof (c), ok);
+}
+
+static void
+write_contour (FILE *fp, PLINE *contour, bool *ok)
+{
+  guint32 count = 0, flags = 0;
+  VNODE *v;
+
+  v = &contour->head;
+  do
+    count++;
+  while ((v = v->next) != &contour->head);
+
+  if (contour->Flags.orient == PLF_DIR)
+    flags |= BOARD_CACHE_ORIENT;
+  if (contour->is_round)
+    flags |= BOARD_CACHE_ROUND;
+
+  write_u32 (fp, count, ok);
+  write_u32 (fp, flags, ok);
+  write_coord (fp, contour->cx, ok);
+  write_coord (fp, contour->cy, ok);
+  write_coord (fp, contour->radius, ok);
+  write_bytes (fp, &contour->area, sizeof (contour->area), ok);
+  do
+    {
+      write_coord (fp, v->point[0], ok);
+      write_coord (fp, v->point[1], ok);
+    }
+  while ((v = v->next) != &contour->head);
+}
+
+static void
+write_polygon (FILE *fp, PolygonType *polygon, bool *ok)
+{
+  POLYAREA *piece;
+  PLINE *contour;
+  guint32 n;
+
+  write_u32 (fp, polygon->PointN, ok);
+  write_u32 (fp, polygon->HoleIndexN, ok);
+  write_coord (fp, polygon->BoundingBox.X1, ok);
+  write_coord (fp, polygon->BoundingBox.Y1, ok);
+  write_coord (fp, polygon->BoundingBox.X2, ok);
+  write_coord (fp, polygon->BoundingBox.Y2, ok);
+
+  n = 0;
+  if ((piece = polygon->Clipped) != NULL)
+    do
+      n++;
+    while ((piece = piece->f) != polygon->Clipped);
+  write_u32 (fp, n, ok);
+
+  if ((piece = polygon->Clipped) == NULL)
+    return;
+  do
+    {
+      n = 0;
+      for (contour = piece->contours; contour; contour = contour->next)
+        n++;
+      write_u32 (fp, n, ok);
+      for (contour = piece->contours; contour; contour = contour->next)
+        write_contour (fp, contour, ok);
+    }
+  while ((piece = piece->f) != polygon->Clipped);
+}
+
+/*!
+ * \brief Save the clipped polygons of a freshly loaded board.
+ *
+ * The cache is written under a temporary name and renamed into place,
+ * so an interrupted write never leaves a truncated cache behind.
+ */
+static void
+write_cache (DataType *Data)
+{
+  char *tmp = g_strconcat (cache.path, ".new", NULL);
+  guint32 polygons = 0;
+  bool ok = true;
+  FILE *fp;
+
+  ALLPOLYGON_LOOP (Data);
+  {
+    polygons++;
+  }
+  ENDALL_LOOP;
+
+  if ((fp = fopen (tmp, "wb")) == NULL)
+    {
+      g_free (tmp);
+      return;
+    }
+
+  write_bytes (fp, BOARD_CACHE_MAGIC, sizeof (BOARD_CACHE_MAGIC) - 1, &ok);
+  write_u32 (fp, BOARD_CACHE_VERSION, &ok);
+  write_u32 (fp, BOARD_CACHE_BYTE_ORDER, &ok);
+  write_u32 (fp, sizeof (Coord), &ok);
+  write_bytes (fp, cache.key, sizeof (cache.key), &ok);
+  write_u32 (fp, polygons, &ok);
+  ALLPOLYGON_LOOP (Data);
+  {
+    write_polygon (fp, polygon, &ok);
+  }
+  ENDALL_LOOP;
+
+  if (fclose (fp) != 0)
+    ok = false;
+  if (!ok || rename (tmp, cache.path) != 0)
+    remove (tmp);
+  g_free (tmp);
+}
+
+/*!
+ * \brief Add the default font file, as ParseFont() finds it on the font
+ * path, to the key.
+ */
+static void
+hash_font (GChecksum *sum)
+{
+  struct stat st;
+  gint64 mtime;
+  char **dirs, *path;
+  int i;
+
+  if (EMPTY_STRING_P (Settings.FontFile) || Settings.FontPath == NULL)
+    return;
+  dirs = g_strsplit (Settings.FontPath, PCB_PATH_DELIMETER, 0);
+  for (i = 0; dirs[i]; i++)
+    {
+      if (!*dirs[i])
+        continue;
+      path = g_strconcat (dirs[i], PCB_DIR_SEPARATOR_S, Settings.FontFile,
+                          NULL);
+      if (stat (path, &st) == 0)
+        {
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+          mtime = (gint64) st.st_mtime * 1000000000 + st.st_mtim.tv_nsec;
+#else
+          mtime = (gint64) st.st_mtime * 1000000000;
+#endif
+          g_checksum_update (sum, (const guchar *) path, strlen (path) + 1);
+          g_checksum_update (sum, (const guchar *) &mtime, sizeof (mtime));
+          g_free (path);
+          break;
+        }
+      g_free (path);
+    }
+  g_strfreev (dirs);
+}
+
+/*!
+ * \brief Look for a cache of a board about to be loaded.
+ *
+ * Does nothing unless --board-cache is set and the board is read without
+ * a --file-command filter.
+ */
+void
+BoardCacheBegin (const char *filename)
+{
+  GMappedFile *board;
+  GChecksum *sum;
+  gsize len = sizeof (cache.key);
+  char *path;
+
+  BoardCacheEnd (NULL);
+  if (!Settings.BoardCache || !EMPTY_STRING_P (Settings.FileCommand))
+    return;
+
+  /* The name Parse() opens */
+  if (!EMPTY_STRING_P (Settings.FilePath))
+    path = g_strconcat (Settings.FilePath, PCB_DIR_SEPARATOR_S, filename,
+                        NULL);
+  else
+    path = g_strdup (filename);
+
+  board = g_mapped_file_new (path, FALSE, NULL);
+  if (board == NULL)
+    {
+      g_free (path);
+      return;
+    }
+
+  sum = g_checksum_new (G_CHECKSUM_SHA256);
+  if (g_mapped_file_get_length (board) > 0)
+    g_checksum_update (sum,
+                       (const guchar *) g_mapped_file_get_contents (board),
+                       g_mapped_file_get_length (board));
+  g_checksum_update (sum, (const guchar *) "", 1);
+  if (Settings.Groups)
+    g_checksum_update (sum, (const guchar *) Settings.Groups, -1);
+  g_checksum_update (sum, (const guchar *) "", 1);
+  hash_font (sum);
+  g_checksum_get_digest (sum, cache.key, &len);
+  g_checksum_free (sum);
+  g_mapped_file_unref (board);
+
+  cache.path = g_strconcat (path, BOARD_CACHE_SUFFIX, NULL);
+  g_free (path);
+
+  cache.map = g_mapped_file_new (cache.path, FALSE, NULL);
+  if (cache.map && !read_header ())
+    {
+      g_mapped_file_unref (cache.map);
+      cache.map = NULL;
+    }
+}
+
+/*!
+ * \brief Install the cached clipped polygons of the board being loaded.
+ *
+ * Called by the parser in place of InitClipAll().
+ *
+ * \return false if there is no matching cache, the caller has to clip
+ * the polygons itself then.
+ */
+bool
+BoardCacheRestore (DataType *Data)
+{
+  POLYAREA **clipped;
+  guint32 polygons = 0, i;
+  bool ok = true;
+
+  if (cache.map == NULL)
+    return false;
+
+  ALLPOLYGON_LOOP (Data);
+  {
+    polygons++;
+  }
+  ENDALL_LOOP;
+  if (polygons != cache.polygons)
+    return false;
+
+  /* Read everything before touching the board, a damaged cache is
+   * simply not used */
+  clipped = g_new0 (POLYAREA *, MAX (polygons, 1));
+  i = 0;
+  ALLPOLYGON_LOOP (Data);
+  {
+    if (ok)
+      ok = read_polygon (polygon, &clipped[i]);
+    i++;
+  }
+  ENDALL_LOOP;
+
+  if (!ok)
+    {
+      for (i = 0; i < polygons; i++)
+        poly_Free (&clipped[i]);
+      g_free (clipped);
+      return false;
+    }
+
+  i = 0;
+  ALLPOLYGON_LOOP (Data);
+  {
+    SetClip (polygon, clipped[i++]);
+  }
+  ENDALL_LOOP;
+  g_free (clipped);
+
+  cache.restored = true;
+  return true;
+}
+
+/*!
+ * \brief Finish the load started by BoardCacheBegin().
+ *
+ * \param Data the data of the loaded board, or NULL if loading failed.
+ * A board whose polygons were clipped from scratch updates the cache.
+ */
+void
+BoardCacheEnd (DataType *Data)
+{
+  if (cache.path && Data && !cache.restored)
+    write_cache (Data);
+
+  if (cache.map)
+    g_mapped_file_unref (cache.map);
+  g_free (cache.path);
+  memset (&cache, 0, sizeof (cache));
+}
@@ -0,0 +1,38 @@
+/*!
+ * \file src/boardcache.h
+ *
+ * \brief Binary cache of the clipped polygons of a board file.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef	PCB_BOARDCACHE_H
+#define	PCB_BOARDCACHE_H
+
+#include "global.h"
+
+void BoardCacheBegin (const char *);
+bool BoardCacheRestore (DataType *);
+void BoardCacheEnd (DataType *);
+
+#endif
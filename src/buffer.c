@@ -38,6 +38,7 @@
 #include <stdlib.h>
 #include <memory.h>
 #include <math.h>
+#include <sys/stat.h>
 
 #include "global.h"
 
@@ -47,6 +48,7 @@
 #include "crosshair.h"
 #include "data.h"
 #include "error.h"
+#include "file.h"
 #include "flags.h"
 #include "mymem.h"
 #include "mirror.h"
@@ -201,7 +203,7 @@ AddPolygonToBuffer (LayerType *Layer, PolygonType *Polygon)
    * skeleton polygon object, which won't have correct bounds.
    */
   if (!layer->polygon_tree)
-    layer->polygon_tree = r_create_tree (NULL, 0, 0);
+    layer->polygon_tree = r_create_data_tree ();
   r_insert_entry (layer->polygon_tree, (BoxType *)polygon, 0);
 
   CLEAR_FLAG (NOCOPY_FLAGS | ExtraFlag, polygon);
@@ -224,20 +226,25 @@ AddElementToBuffer (ElementType *Element)
 static void *
 MoveViaToBuffer (PinType *via)
 {
+  unsigned long held = IDIndexHold ();
+
+  IDIndexRemove (Source, held, VIA_TYPE, via);
   RestoreToPolygon (Source, VIA_TYPE, via, via);
 
   r_delete_entry (Source->via_tree, (BoxType *) via);
-  Source->Via = g_list_remove (Source->Via, via);
+  Source->Via = RemoveFromObjectList (Source->Via, &Source->ViaTail, via);
   Source->ViaN --;
-  Dest->Via = g_list_append (Dest->Via, via);
+  Dest->Via = AppendToObjectList (Dest->Via, &Dest->ViaTail, via);
   Dest->ViaN ++;
 
   CLEAR_FLAG (WARNFLAG | NOCOPY_FLAGS, via);
 
   if (!Dest->via_tree)
-    Dest->via_tree = r_create_tree (NULL, 0, 0);
+    Dest->via_tree = r_create_data_tree ();
   r_insert_entry (Dest->via_tree, (BoxType *)via, 0);
   ClearFromPolygon (Dest, VIA_TYPE, via, via);
+  IDIndexAdd (Dest, held, VIA_TYPE, via, via);
+  IDIndexRelease (held, Source, Dest);
   return via;
 }
 
@@ -247,18 +254,23 @@ MoveViaToBuffer (PinType *via)
 static void *
 MoveRatToBuffer (RatType *rat)
 {
+  unsigned long held = IDIndexHold ();
+
+  IDIndexRemove (Source, held, RATLINE_TYPE, rat);
   r_delete_entry (Source->rat_tree, (BoxType *)rat);
 
-  Source->Rat = g_list_remove (Source->Rat, rat);
+  Source->Rat = RemoveFromObjectList (Source->Rat, &Source->RatTail, rat);
   Source->RatN --;
-  Dest->Rat = g_list_append (Dest->Rat, rat);
+  Dest->Rat = AppendToObjectList (Dest->Rat, &Dest->RatTail, rat);
   Dest->RatN ++;
 
   CLEAR_FLAG (NOCOPY_FLAGS, rat);
 
   if (!Dest->rat_tree)
-    Dest->rat_tree = r_create_tree (NULL, 0, 0);
+    Dest->rat_tree = r_create_data_tree ();
   r_insert_entry (Dest->rat_tree, (BoxType *)rat, 0);
+  IDIndexAdd (Dest, held, RATLINE_TYPE, rat, rat);
+  IDIndexRelease (held, Source, Dest);
   return rat;
 }
 
@@ -269,21 +281,25 @@ static void *
 MoveLineToBuffer (LayerType *layer, LineType *line)
 {
   LayerType *lay = &Dest->Layer[GetLayerNumber (Source, layer)];
+  unsigned long held = IDIndexHold ();
 
+  IDIndexRemove (Source, held, LINE_TYPE, line);
   RestoreToPolygon (Source, LINE_TYPE, layer, line);
   r_delete_entry (layer->line_tree, (BoxType *)line);
 
-  layer->Line = g_list_remove (layer->Line, line);
+  layer->Line = RemoveFromObjectList (layer->Line, &layer->LineTail, line);
   layer->LineN --;
-  lay->Line = g_list_append (lay->Line, line);
+  lay->Line = AppendToObjectList (lay->Line, &lay->LineTail, line);
   lay->LineN ++;
 
   CLEAR_FLAG (NOCOPY_FLAGS, line);
 
   if (!lay->line_tree)
-    lay->line_tree = r_create_tree (NULL, 0, 0);
+    lay->line_tree = r_create_data_tree ();
   r_insert_entry (lay->line_tree, (BoxType *)line, 0);
   ClearFromPolygon (Dest, LINE_TYPE, lay, line);
+  IDIndexAdd (Dest, held, LINE_TYPE, lay, line);
+  IDIndexRelease (held, Source, Dest);
   return (line);
 }
 
@@ -294,21 +310,25 @@ static void *
 MoveArcToBuffer (LayerType *layer, ArcType *arc)
 {
   LayerType *lay = &Dest->Layer[GetLayerNumber (Source, layer)];
+  unsigned long held = IDIndexHold ();
 
+  IDIndexRemove (Source, held, ARC_TYPE, arc);
   RestoreToPolygon (Source, ARC_TYPE, layer, arc);
   r_delete_entry (layer->arc_tree, (BoxType *)arc);
 
-  layer->Arc = g_list_remove (layer->Arc, arc);
+  layer->Arc = RemoveFromObjectList (layer->Arc, &layer->ArcTail, arc);
   layer->ArcN --;
-  lay->Arc = g_list_append (lay->Arc, arc);
+  lay->Arc = AppendToObjectList (lay->Arc, &lay->ArcTail, arc);
   lay->ArcN ++;
 
   CLEAR_FLAG (NOCOPY_FLAGS, arc);
 
   if (!lay->arc_tree)
-    lay->arc_tree = r_create_tree (NULL, 0, 0);
+    lay->arc_tree = r_create_data_tree ();
   r_insert_entry (lay->arc_tree, (BoxType *)arc, 0);
   ClearFromPolygon (Dest, ARC_TYPE, lay, arc);
+  IDIndexAdd (Dest, held, ARC_TYPE, lay, arc);
+  IDIndexRelease (held, Source, Dest);
   return (arc);
 }
 
@@ -319,19 +339,23 @@ static void *
 MoveTextToBuffer (LayerType *layer, TextType *text)
 {
   LayerType *lay = &Dest->Layer[GetLayerNumber (Source, layer)];
+  unsigned long held = IDIndexHold ();
 
+  IDIndexRemove (Source, held, TEXT_TYPE, text);
   r_delete_entry (layer->text_tree, (BoxType *)text);
   RestoreToPolygon (Source, TEXT_TYPE, layer, text);
 
-  layer->Text = g_list_remove (layer->Text, text);
+  layer->Text = RemoveFromObjectList (layer->Text, &layer->TextTail, text);
   layer->TextN --;
-  lay->Text = g_list_append (lay->Text, text);
+  lay->Text = AppendToObjectList (lay->Text, &lay->TextTail, text);
   lay->TextN ++;
 
   if (!lay->text_tree)
-    lay->text_tree = r_create_tree (NULL, 0, 0);
+    lay->text_tree = r_create_data_tree ();
   r_insert_entry (lay->text_tree, (BoxType *)text, 0);
   ClearFromPolygon (Dest, TEXT_TYPE, lay, text);
+  IDIndexAdd (Dest, held, TEXT_TYPE, lay, text);
+  IDIndexRelease (held, Source, Dest);
   return (text);
 }
 
@@ -344,19 +368,24 @@ static void *
 MovePolygonToBuffer (LayerType *layer, PolygonType *polygon)
 {
   LayerType *lay = &Dest->Layer[GetLayerNumber (Source, layer)];
+  unsigned long held = IDIndexHold ();
 
+  IDIndexRemove (Source, held, POLYGON_TYPE, polygon);
   r_delete_entry (layer->polygon_tree, (BoxType *)polygon);
 
-  layer->Polygon = g_list_remove (layer->Polygon, polygon);
+  layer->Polygon = RemoveFromObjectList (layer->Polygon,
+                                         &layer->PolygonTail, polygon);
   layer->PolygonN --;
-  lay->Polygon = g_list_append (lay->Polygon, polygon);
+  lay->Polygon = AppendToObjectList (lay->Polygon, &lay->PolygonTail, polygon);
   lay->PolygonN ++;
 
   CLEAR_FLAG (NOCOPY_FLAGS, polygon);
 
   if (!lay->polygon_tree)
-    lay->polygon_tree = r_create_tree (NULL, 0, 0);
+    lay->polygon_tree = r_create_data_tree ();
   r_insert_entry (lay->polygon_tree, (BoxType *)polygon, 0);
+  IDIndexAdd (Dest, held, POLYGON_TYPE, lay, polygon);
+  IDIndexRelease (held, Source, Dest);
   return (polygon);
 }
 
@@ -367,15 +396,20 @@ MovePolygonToBuffer (LayerType *layer, PolygonType *polygon)
 static void *
 MoveElementToBuffer (ElementType *element)
 {
+  unsigned long held = IDIndexHold ();
+
+  IDIndexRemove (Source, held, ELEMENT_TYPE, element);
   /*
    * Delete the element from the source (remove it from trees,
    * restore to polygons)
    */
   r_delete_element (Source, element);
 
-  Source->Element = g_list_remove (Source->Element, element);
+  Source->Element = RemoveFromObjectList (Source->Element,
+                                          &Source->ElementTail, element);
   Source->ElementN --;
-  Dest->Element = g_list_append (Dest->Element, element);
+  Dest->Element = AppendToObjectList (Dest->Element,
+                                      &Dest->ElementTail, element);
   Dest->ElementN ++;
 
   PIN_LOOP (element);
@@ -404,6 +438,8 @@ MoveElementToBuffer (ElementType *element)
     ClearFromPolygon (Dest, PAD_TYPE, element, pad);
   }
   END_LOOP;
+  IDIndexAdd (Dest, held, ELEMENT_TYPE, element, element);
+  IDIndexRelease (held, Source, Dest);
 
   return element;
 }
@@ -449,7 +485,9 @@ AddSelectedToBuffer (BufferType *Buffer, Coord X, Coord Y, bool LeaveSelected)
   notify_crosshair_change (false);
   Source = PCB->Data;
   Dest = Buffer->Data;
+  r_defer_inserts ();
   SelectedOperation (&AddBufferFunctions, false, ALL_TYPES);
+  r_resume_inserts ();
 
   /* set origin to passed or current position */
   if (X || Y)
@@ -466,6 +504,132 @@ AddSelectedToBuffer (BufferType *Buffer, Coord X, Coord Y, bool LeaveSelected)
   ExtraFlag = 0;
 }
 
+/*!
+ * \brief A footprint as parsed by LoadElementToBuffer().
+ *
+ * Placing many copies of a footprint, or importing a netlist, loads the
+ * same few footprints again and again.  Each load used to run the parser,
+ * and for m4 footprints the m4 command as well; it now copies the
+ * elements parsed the first time.  A footprint file is parsed again when
+ * its modification time or size changes.  The m4 footprints are kept
+ * until the library is scanned again.
+ */
+typedef struct
+{
+  DataType *Data; /*!< The elements, as parsed, on the top side. */
+  time_t mtime; /*!< Modification time of the footprint file. */
+  off_t size; /*!< Size of the footprint file. */
+} FootprintCacheEntry;
+
+/*!
+ * \brief The parsed footprints, by file name or by m4 arguments, with
+ * a leading 'f' or 'm' for which.
+ */
+static GHashTable *footprint_cache = NULL;
+
+static void
+free_footprint_cache_entry (gpointer data)
+{
+  FootprintCacheEntry *fce = (FootprintCacheEntry *) data;
+
+  FreeDataMemory (fce->Data);
+  free (fce->Data);
+  free (fce);
+}
+
+static gboolean
+is_m4_footprint (gpointer key, gpointer value, gpointer userdata)
+{
+  return *(char *) key == 'm';
+}
+
+/*!
+ * \brief Forgets the parsed m4 footprints.
+ */
+static void
+clear_footprint_cache (void)
+{
+  if (footprint_cache != NULL)
+    g_hash_table_foreach_remove (footprint_cache, is_m4_footprint, NULL);
+}
+
+/*!
+ * \brief Copies the elements of \p From into \p Data.
+ */
+static void
+copy_footprint_elements (DataType *Data, DataType *From)
+{
+  ELEMENT_LOOP (From);
+  {
+    CopyElementLowLevel (Data, element, false, 0, 0, 0);
+  }
+  END_LOOP;
+}
+
+/*!
+ * \brief Keeps a copy of a footprint just parsed into \p Data.
+ *
+ * Only footprints made of elements alone are kept.
+ */
+static void
+cache_footprint (const char *key, DataType *Data, struct stat *st)
+{
+  FootprintCacheEntry *fce;
+  Cardinal i;
+
+  if (Data->ElementN == 0 || Data->ViaN != 0 || Data->RatN != 0)
+    return;
+  for (i = 0; i < max_copper_layer + SILK_LAYER; i++)
+    if (!IsLayerEmpty (&Data->Layer[i]))
+      return;
+
+  if (footprint_cache == NULL)
+    footprint_cache = g_hash_table_new_full (g_str_hash, g_str_equal, free,
+					     free_footprint_cache_entry);
+  fce = (FootprintCacheEntry *) malloc (sizeof (*fce));
+  fce->Data = CreateNewBuffer ();
+  fce->mtime = st ? st->st_mtime : 0;
+  fce->size = st ? st->st_size : 0;
+  copy_footprint_elements (fce->Data, Data);
+  g_hash_table_replace (footprint_cache, strdup (key), fce);
+}
+
+/*!
+ * \brief Loads a footprint into \p Data, from the cache if it holds a
+ * current copy, and else by parsing it, keeping a copy.
+ *
+ * \return the result of the parser, zero on success.
+ */
+static int
+load_footprint (DataType *Data, char *Name, bool FromFile)
+{
+  FootprintCacheEntry *fce = NULL;
+  struct stat st;
+  char *key;
+  int result;
+
+  if (FromFile && stat (Name, &st) != 0)
+    return ParseElementFile (Data, Name);
+
+  key = Concat (FromFile ? "f" : "m", Name, NULL);
+  if (footprint_cache != NULL)
+    fce = (FootprintCacheEntry *) g_hash_table_lookup (footprint_cache, key);
+  if (fce != NULL && (!FromFile || (fce->mtime == st.st_mtime
+				    && fce->size == st.st_size)))
+    {
+      copy_footprint_elements (Data, fce->Data);
+      free (key);
+      return 0;
+    }
+
+  result = FromFile ? ParseElementFile (Data, Name)
+		    : ParseLibraryEntry (Data, Name);
+  if (result == 0)
+    cache_footprint (key, Data, FromFile ? &st : NULL);
+  free (key);
+  return result;
+}
+
 /*!
  * \brief Loads element data from file/library into buffer.
  *
@@ -482,7 +646,7 @@ LoadElementToBuffer (BufferType *Buffer, char *Name, bool FromFile)
   ClearBuffer (Buffer);
   if (FromFile)
     {
-      if (!ParseElementFile (Buffer->Data, Name))
+      if (!load_footprint (Buffer->Data, Name, true))
 	{
 	  if (Settings.ShowBottomSide)
 	    SwapBuffer (Buffer);
@@ -503,7 +667,7 @@ LoadElementToBuffer (BufferType *Buffer, char *Name, bool FromFile)
     }
   else
     {
-      if (!ParseLibraryEntry (Buffer->Data, Name)
+      if (!load_footprint (Buffer->Data, Name, false)
 	  && Buffer->Data->ElementN != 0)
 	{
 	  element = Buffer->Data->Element->data;
@@ -540,6 +704,8 @@ void
 clear_footprint_hash ()
 {
   int i;
+
+  clear_footprint_cache ();
   if (!footprint_hash)
     return;
   for (i=0; i<footprint_hash_size; i++)
@@ -717,6 +883,7 @@ LoadFootprintByName (BufferType *Buffer, char *Footprint)
   LibraryEntryType *entry;
   char *with_fp = NULL;
 
+  LoadLibraryOnDemand ();
   if (!footprint_hash)
     make_footprint_hash ();
 
@@ -835,17 +1002,14 @@ LoadFootprint (int argc, char **argv, Coord x, Coord y)
 
   e = PASTEBUFFER->Data->Element->data;
 
-  if (e->Name[0].TextString)
-    free (e->Name[0].TextString);
-  e->Name[0].TextString = strdup (name);
+  ReleaseString (e->Name[0].TextString);
+  e->Name[0].TextString = ShareString (name);
 
-  if (e->Name[1].TextString)
-    free (e->Name[1].TextString);
-  e->Name[1].TextString = refdes ? strdup (refdes) : 0;
+  ReleaseString (e->Name[1].TextString);
+  e->Name[1].TextString = ShareString (refdes);
 
-  if (e->Name[2].TextString)
-    free (e->Name[2].TextString);
-  e->Name[2].TextString = value ? strdup (value) : 0;
+  ReleaseString (e->Name[2].TextString);
+  e->Name[2].TextString = ShareString (value);
 
   return 0;
 }
@@ -876,6 +1040,7 @@ SmashBufferElement (BufferType *Buffer)
    */
   element = Buffer->Data->Element->data;
   Buffer->Data->Element = NULL;
+  Buffer->Data->ElementTail = NULL;
   Buffer->Data->ElementN = 0;
   ClearBuffer (Buffer);
   ELEMENTLINE_LOOP (element);
@@ -923,7 +1088,7 @@ SmashBufferElement (BufferType *Buffer)
   }
   END_LOOP;
   FreeElementMemory (element);
-  g_slice_free (ElementType, element);
+  POOL_FREE (ElementType, element);
   return (true);
 }
 
@@ -957,6 +1122,7 @@ polygon_is_rectangle (PolygonType *poly)
       poly->Points[2] = temp[2];
       poly->Points[3] = temp[1];
     }
+  IDIndexInvalidate ();
   if (poly->Points[0].X == poly->Points[1].X
       && poly->Points[1].Y == poly->Points[2].Y
       && poly->Points[2].X == poly->Points[3].X
@@ -1169,6 +1335,9 @@ LoadLayoutToBuffer (BufferType *Buffer, char *Filename)
 void
 RotateBuffer (BufferType *Buffer, BYTE Number)
 {
+  /* the objects go back into the search trees in bulk */
+  r_defer_inserts ();
+
   /* rotate vias */
   VIA_LOOP (Buffer->Data);
   {
@@ -1216,6 +1385,7 @@ RotateBuffer (BufferType *Buffer, BYTE Number)
     r_insert_entry (layer->polygon_tree, (BoxType *)polygon, 0);
   }
   ENDALL_LOOP;
+  r_resume_inserts ();
 
   /* finally the origin and the bounding box */
   ROTATE (Buffer->X, Buffer->Y, Buffer->X, Buffer->Y, Number);
@@ -1303,6 +1473,7 @@ FreeRotateBuffer (BufferType *Buffer, Angle angle)
 
   cosa = cos(angle * M_PI/180.0);
   sina = sin(angle * M_PI/180.0);
+  r_defer_inserts ();
 
   /* rotate vias */
   VIA_LOOP (Buffer->Data);
@@ -1353,6 +1524,7 @@ FreeRotateBuffer (BufferType *Buffer, Angle angle)
     r_insert_entry (layer->polygon_tree, (BoxType *)polygon, 0);
   }
   ENDALL_LOOP;
+  r_resume_inserts ();
 
   SetBufferBoundingBox (Buffer);
   crosshair_update_range();
@@ -1501,6 +1673,7 @@ SwapBuffer (BufferType *Buffer)
   Cardinal top_group, bottom_group;
   LayerType swap;
 
+  r_defer_inserts ();
   ELEMENT_LOOP (Buffer->Data);
   {
     r_delete_element (Buffer->Data, element);
@@ -1565,7 +1738,9 @@ SwapBuffer (BufferType *Buffer)
     r_insert_entry (layer->text_tree, (BoxType *)text, 0);
   }
   ENDALL_LOOP;
+  r_resume_inserts ();
   /* swap silkscreen layers */
+  IDIndexInvalidate ();
   swap = Buffer->Data->Layer[bottom_silk_layer];
   Buffer->Data->Layer[bottom_silk_layer] =
     Buffer->Data->Layer[top_silk_layer];
@@ -1628,6 +1803,9 @@ MoveObjectToBuffer (DataType *Destination, DataType *Src,
   /* setup local identifiers used by move operations */
   Dest = Destination;
   Source = Src;
+  /* the object brings its flags onto the board */
+  if (Destination == PCB->Data)
+    NOTE_FLAGS (TRACKED_FLAGS);
   return (ObjectOperation (&MoveBufferFunctions, Type, Ptr1, Ptr2, Ptr3));
 }
 
@@ -1677,6 +1677,10 @@ ChangeSelectedElementSide (void)
 {
   bool change = false;
 
+  /* the polygons are cleared again, and the pins, pads and names put
+   * back into the search trees, once for all the elements */
+  DeferPolygonClipping ();
+  r_defer_inserts ();
   /* setup identifiers */
   if (PCB->PinOn && PCB->ElementOn)
     ELEMENT_LOOP (PCB->Data);
@@ -1687,6 +1691,8 @@ ChangeSelectedElementSide (void)
       }
   }
   END_LOOP;
+  r_resume_inserts ();
+  ResumePolygonClipping ();
   if (change)
     {
       Draw ();
@@ -40,6 +40,7 @@
 #include <assert.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "global.h"
 #include "data.h"
@@ -146,3 +147,45 @@ ClipLine (double minx, double miny, double maxx, double maxy,
     }
   return true;
 }
+
+/*!
+ * \brief Clip a batch of lines to the clipBox.
+ *
+ * The N lines are given as X1, Y1, X2, Y2 in turn in XY, which are
+ * clipped like ClipLine() does.  The lines left to draw are moved to the
+ * front of XY, in the order they came.
+ *
+ * Most of the lines of a view lie wholly inside it, and those are only
+ * compared with the box.
+ *
+ * \return the number of lines left to draw.
+ */
+int
+ClipLines (double minx, double miny, double maxx, double maxy,
+	   double *xy, int n, double margin)
+{
+  int i, kept = 0;
+
+  minx -= margin;
+  miny -= margin;
+  maxx += margin;
+  maxy += margin;
+
+  for (i = 0; i < n; i++)
+    {
+      double *l = xy + 4 * i;
+      /* non short-circuit, as the comparisons are cheaper than branches */
+      bool inside = (l[0] >= minx) & (l[2] >= minx)
+		  & (l[0] <= maxx) & (l[2] <= maxx)
+		  & (l[1] >= miny) & (l[3] >= miny)
+		  & (l[1] <= maxy) & (l[3] <= maxy);
+
+      if (!inside
+	  && !ClipLine (minx, miny, maxx, maxy, l, l + 1, l + 2, l + 3, 0))
+	continue;
+      if (kept != i)
+	memcpy (xy + 4 * kept, l, 4 * sizeof (double));
+      kept++;
+    }
+  return kept;
+}
@@ -45,5 +45,7 @@ bool ClipLine (double minx, double miny, double maxx, double maxy,
 		  double *x1, double *y1,
 		  double *x2, double *y2,
 		  double margin);
+int ClipLines (double minx, double miny, double maxx, double maxy,
+	       double *xy, int n, double margin);
 
 #endif
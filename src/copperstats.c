@@ -0,0 +1,917 @@
+/*!
+ * \file src/copperstats.c
+ *
+ * \brief Copper area and density of the layer groups, for CopperStats()
+ * and --copper-stats.
+ *
+ * The copper of a layer group is its lines and pads, the clipped
+ * contours of its polygons, the arcs as ArcPoly() outlines them and the
+ * rings of the pins and vias through it, less their drill holes.  It is
+ * measured along horizontal scanlines: each scanline is crossed with the
+ * outlines of the copper, and the lengths it runs inside are summed for
+ * the group, for the net of the copper and for the grid cell they are
+ * in.  A scanline stands for a strip of COPPER_STATS_PITCH, so the areas
+ * are exact but for curves inside a strip.
+ *
+ * Overlapping copper is only counted once, for the group and for each net,
+ * so a line over a polygon of its net adds nothing.  The copper is
+ * gathered into one array for a group, then the strips of cell rows are
+ * scanned on worker threads, which only read the array.  Text on copper
+ * layers isn't counted.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "copperstats.h"
+#include "data.h"
+#include "error.h"
+#include "find.h"
+#include "macro.h"
+#include "misc.h"
+#include "pcb-printf.h"
+#include "polygon.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+/*!
+ * \brief Distance between the scanlines, at most.
+ */
+#define COPPER_STATS_PITCH MM_TO_COORD (0.01)
+
+typedef enum
+{
+  CS_EDGE,			/*!< An edge of an outline. */
+  CS_LINE,			/*!< A line with round ends. */
+  CS_DISC,			/*!< A round pin or via. */
+  CS_HOLE			/*!< A drill hole, which takes copper away. */
+} CopperShapeKind;
+
+/*!
+ * \brief A piece of the copper of a group.
+ *
+ * Edges run from (x1, y1) to (x2, y2) and wind adds to the winding
+ * number of the copper to their right, running up, so that the inside of
+ * every outline is at 1.  Lines have their half thickness in half and
+ * their direction and length in ux, uy and len.  Discs and holes are at
+ * (x1, y1) with a radius of half.
+ */
+typedef struct
+{
+  double Y1, Y2;		/*!< The scanlines it reaches. */
+  double x1, y1, x2, y2;
+  double half, ux, uy, len;
+  int kind, net, wind;
+} CopperShape;
+
+/*!
+ * \brief Where a scanline goes into or out of a piece of copper.
+ */
+typedef struct
+{
+  double x;
+  int net;			/*!< -1 for a hole. */
+  int delta;
+} CopperEvent;
+
+typedef struct
+{
+  int group;
+  GArray *shapes;		/*!< CopperShape, by Y1. */
+  double area;
+  double *net_area;
+  double *cells;		/*!< rows * cols, top row first. */
+} CopperGroup;
+
+typedef struct
+{
+  Coord cell;
+  double dy;
+  int rows_per_cell, rows, cols, nets;
+} CopperGrid;
+
+/*!
+ * \brief The scanlines row1 up to row2 of a group, for a worker.
+ */
+typedef struct
+{
+  const CopperGrid *grid;
+  CopperGroup *g;
+  int row1, row2;
+  double area;
+  double *net_area;
+} CopperTask;
+
+static int
+compare_shapes (const void *a, const void *b)
+{
+  double ya = ((const CopperShape *) a)->Y1, yb = ((const CopperShape *) b)->Y1;
+
+  return (ya > yb) - (ya < yb);
+}
+
+static int
+compare_events (const void *a, const void *b)
+{
+  double xa = ((const CopperEvent *) a)->x, xb = ((const CopperEvent *) b)->x;
+
+  return (xa > xb) - (xa < xb);
+}
+
+/* ---------------------------------------------------------------------------
+ * Gathering the copper of a group.
+ */
+
+static void
+add_edge (GArray *shapes, double x1, double y1, double x2, double y2,
+	  int wind, int net)
+{
+  CopperShape s;
+
+  /* a scanline never crosses a level edge */
+  if (y1 == y2)
+    return;
+  memset (&s, 0, sizeof (s));
+  s.kind = CS_EDGE;
+  s.x1 = x1;
+  s.y1 = y1;
+  s.x2 = x2;
+  s.y2 = y2;
+  s.Y1 = MIN (y1, y2);
+  s.Y2 = MAX (y1, y2);
+  s.wind = y2 < y1 ? wind : -wind;
+  s.net = net;
+  g_array_append_val (shapes, s);
+}
+
+/*!
+ * \brief Add the edges of a closed outline of n corners.
+ *
+ * The winding is worked out from the way the outline turns, so that its
+ * inside counts as copper, or as a hole in the copper if hole is set.
+ */
+static void
+add_outline (GArray *shapes, const double *x, const double *y, int n,
+	     bool hole, int net)
+{
+  double twice_area = 0;
+  int i, j, wind;
+
+  for (i = 0, j = n - 1; i < n; j = i++)
+    twice_area += x[j] * y[i] - x[i] * y[j];
+  wind = (twice_area > 0) == !hole ? 1 : -1;
+  for (i = 0, j = n - 1; i < n; j = i++)
+    add_edge (shapes, x[j], y[j], x[i], y[i], wind, net);
+}
+
+static void
+add_contour (GArray *shapes, PLINE *pl, bool hole, int net)
+{
+  double *x = (double *) malloc (2 * pl->Count * sizeof (double));
+  double *y = x + pl->Count;
+  VNODE *v = &pl->head;
+  int n = 0;
+
+  do
+    {
+      x[n] = v->point[0];
+      y[n] = v->point[1];
+      n++;
+    }
+  while ((v = v->next) != &pl->head && n < pl->Count);
+  add_outline (shapes, x, y, n, hole, net);
+  free (x);
+}
+
+/*!
+ * \brief Add every island of a polygon area, with its holes.
+ */
+static void
+add_polyarea (GArray *shapes, POLYAREA *pa, int net)
+{
+  POLYAREA *island = pa;
+  PLINE *pl;
+
+  if (pa == NULL)
+    return;
+  do
+    {
+      for (pl = island->contours; pl != NULL; pl = pl->next)
+	add_contour (shapes, pl, pl != island->contours, net);
+    }
+  while ((island = island->f) != pa);
+}
+
+static void
+add_line (GArray *shapes, double x1, double y1, double x2, double y2,
+	  double half, int net)
+{
+  CopperShape s;
+
+  if (half <= 0)
+    return;
+  memset (&s, 0, sizeof (s));
+  s.kind = CS_LINE;
+  s.x1 = x1;
+  s.y1 = y1;
+  s.x2 = x2;
+  s.y2 = y2;
+  s.half = half;
+  s.len = hypot (x2 - x1, y2 - y1);
+  if (s.len > 0)
+    {
+      s.ux = (x2 - x1) / s.len;
+      s.uy = (y2 - y1) / s.len;
+    }
+  s.Y1 = MIN (y1, y2) - half;
+  s.Y2 = MAX (y1, y2) + half;
+  s.net = net;
+  g_array_append_val (shapes, s);
+}
+
+static void
+add_disc (GArray *shapes, int kind, double x, double y, double radius,
+	  int net)
+{
+  CopperShape s;
+
+  if (radius <= 0)
+    return;
+  memset (&s, 0, sizeof (s));
+  s.kind = kind;
+  s.x1 = x;
+  s.y1 = y;
+  s.half = radius;
+  s.Y1 = y - radius;
+  s.Y2 = y + radius;
+  s.net = net;
+  g_array_append_val (shapes, s);
+}
+
+/*!
+ * \brief Add a rectangle of half width half around the line from
+ * (x1, y1) to (x2, y2), reaching half past its ends.
+ */
+static void
+add_square (GArray *shapes, double x1, double y1, double x2, double y2,
+	    double half, int net)
+{
+  double len = hypot (x2 - x1, y2 - y1), ux = 1, uy = 0, x[4], y[4];
+
+  if (half <= 0)
+    return;
+  if (len > 0)
+    {
+      ux = (x2 - x1) / len;
+      uy = (y2 - y1) / len;
+    }
+  /* along is (ux, uy) * half, across is (-uy, ux) * half */
+  x[0] = x1 - (ux - uy) * half;
+  y[0] = y1 - (uy + ux) * half;
+  x[1] = x2 + (ux + uy) * half;
+  y[1] = y2 + (uy - ux) * half;
+  x[2] = x2 + (ux - uy) * half;
+  y[2] = y2 + (uy + ux) * half;
+  x[3] = x1 - (ux + uy) * half;
+  y[3] = y1 - (uy - ux) * half;
+  add_outline (shapes, x, y, 4, false, net);
+}
+
+static void
+add_pin (GArray *shapes, PinType *pin, int net)
+{
+  if (!TEST_FLAG (HOLEFLAG, pin))
+    {
+      if (TEST_FLAG (SQUAREFLAG, pin))
+	add_square (shapes, pin->X, pin->Y, pin->X, pin->Y,
+		    pin->Thickness / 2., net);
+      else if (TEST_FLAG (OCTAGONFLAG, pin))
+	{
+	  POLYAREA *pa = OctagonPoly (pin->X, pin->Y, pin->Thickness);
+
+	  add_polyarea (shapes, pa, net);
+	  poly_Free (&pa);
+	}
+      else
+	add_disc (shapes, CS_DISC, pin->X, pin->Y, pin->Thickness / 2., net);
+    }
+  add_disc (shapes, CS_HOLE, pin->X, pin->Y, pin->DrillingHole / 2., -1);
+}
+
+static void
+add_pad (GArray *shapes, PadType *pad, int net)
+{
+  if (TEST_FLAG (SQUAREFLAG, pad))
+    add_square (shapes, pad->Point1.X, pad->Point1.Y,
+		pad->Point2.X, pad->Point2.Y, pad->Thickness / 2., net);
+  else
+    add_line (shapes, pad->Point1.X, pad->Point1.Y,
+	      pad->Point2.X, pad->Point2.Y, pad->Thickness / 2., net);
+}
+
+/*!
+ * \brief Gather the copper of a layer group, with the net of each piece.
+ *
+ * \return false if the group has no copper layer.
+ */
+static bool
+gather_group (CopperGroup *g, int nets)
+{
+  GArray *shapes = g->shapes;
+  int side = -1, label;
+  bool copper = false;
+
+  GROUP_LOOP (PCB->Data, g->group);
+  {
+    if (layer->Type != LT_COPPER)
+      continue;
+    copper = true;
+    LINE_LOOP (layer);
+    {
+      label = ConnectionIndexNetLabel (line);
+      add_line (shapes, line->Point1.X, line->Point1.Y,
+		line->Point2.X, line->Point2.Y, line->Thickness / 2.,
+		label < 0 ? nets - 1 : label);
+    }
+    END_LOOP;
+    ARC_LOOP (layer);
+    {
+      POLYAREA *pa = arc->Thickness > 0 ? ArcPoly (arc, arc->Thickness) : NULL;
+
+      label = ConnectionIndexNetLabel (arc);
+      add_polyarea (shapes, pa, label < 0 ? nets - 1 : label);
+      if (pa)
+	poly_Free (&pa);
+    }
+    END_LOOP;
+    POLYGON_LOOP (layer);
+    {
+      label = ConnectionIndexNetLabel (polygon);
+      add_polyarea (shapes, polygon->Clipped, label < 0 ? nets - 1 : label);
+    }
+    END_LOOP;
+  }
+  END_LOOP;
+  if (!copper)
+    return false;
+
+  if (g->group == GetLayerGroupNumberBySide (TOP_SIDE))
+    side = TOP_SIDE;
+  else if (g->group == GetLayerGroupNumberBySide (BOTTOM_SIDE))
+    side = BOTTOM_SIDE;
+  ALLPIN_LOOP (PCB->Data);
+  {
+    label = ConnectionIndexNetLabel (pin);
+    add_pin (shapes, pin, label < 0 ? nets - 1 : label);
+  }
+  ENDALL_LOOP;
+  VIA_LOOP (PCB->Data);
+  {
+    if (!ViaIsOnLayerGroup (via, g->group))
+      continue;
+    label = ConnectionIndexNetLabel (via);
+    add_pin (shapes, via, label < 0 ? nets - 1 : label);
+  }
+  END_LOOP;
+  if (side >= 0)
+    {
+      ALLPAD_LOOP (PCB->Data);
+      {
+	if ((TEST_FLAG (ONSOLDERFLAG, pad) != 0) != (side == BOTTOM_SIDE))
+	  continue;
+	label = ConnectionIndexNetLabel (pad);
+	add_pad (shapes, pad, label < 0 ? nets - 1 : label);
+      }
+      ENDALL_LOOP;
+    }
+
+  qsort (shapes->data, shapes->len, sizeof (CopperShape), compare_shapes);
+  return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * Scanning.
+ */
+
+/*!
+ * \brief Narrow [*lo, *hi] to the x for which a * x + b lies from min to
+ * max.
+ *
+ * \return false if no x is left.
+ */
+static bool
+clip_linear (double a, double b, double min, double max,
+	     double *lo, double *hi)
+{
+  double xa, xb;
+
+  if (a == 0)
+    return b >= min && b <= max;
+  xa = (min - b) / a;
+  xb = (max - b) / a;
+  *lo = MAX (*lo, MIN (xa, xb));
+  *hi = MIN (*hi, MAX (xa, xb));
+  return *lo <= *hi;
+}
+
+static void
+add_event (GArray *events, double x, int net, int delta)
+{
+  CopperEvent e;
+
+  e.x = x;
+  e.net = net;
+  e.delta = delta;
+  g_array_append_val (events, e);
+}
+
+/*!
+ * \brief Add where the scanline at y goes into and out of a piece of
+ * copper.
+ *
+ * A line is the union of the discs at its ends and the band between
+ * them, which all overlap, so the scanline is inside it from the least
+ * to the greatest of the three.
+ */
+static void
+shape_events (const CopperShape *s, double y, GArray *events)
+{
+  double lo = HUGE_VAL, hi = -HUGE_VAL, blo = -HUGE_VAL, bhi = HUGE_VAL;
+  double d, dx;
+
+  switch (s->kind)
+    {
+    case CS_EDGE:
+      if ((s->y1 <= y && y < s->y2) || (s->y2 <= y && y < s->y1))
+	add_event (events,
+		   s->x1 + (y - s->y1) * (s->x2 - s->x1) / (s->y2 - s->y1),
+		   s->net, s->wind);
+      return;
+    case CS_LINE:
+      d = y - s->y1;
+      if (fabs (d) <= s->half)
+	{
+	  dx = sqrt (s->half * s->half - d * d);
+	  lo = s->x1 - dx;
+	  hi = s->x1 + dx;
+	}
+      d = y - s->y2;
+      if (fabs (d) <= s->half)
+	{
+	  dx = sqrt (s->half * s->half - d * d);
+	  lo = MIN (lo, s->x2 - dx);
+	  hi = MAX (hi, s->x2 + dx);
+	}
+      /* along: 0 <= (p - p1) . u <= len, across: |(p - p1) . n| <= half */
+      if (s->len > 0
+	  && clip_linear (s->ux, (y - s->y1) * s->uy - s->x1 * s->ux,
+			  0, s->len, &blo, &bhi)
+	  && clip_linear (-s->uy, (y - s->y1) * s->ux + s->x1 * s->uy,
+			  -s->half, s->half, &blo, &bhi))
+	{
+	  lo = MIN (lo, blo);
+	  hi = MAX (hi, bhi);
+	}
+      break;
+    default:
+      d = y - s->y1;
+      if (fabs (d) > s->half)
+	return;
+      dx = sqrt (s->half * s->half - d * d);
+      lo = s->x1 - dx;
+      hi = s->x1 + dx;
+      break;
+    }
+  if (lo < hi)
+    {
+      add_event (events, lo, s->kind == CS_HOLE ? -1 : s->net, 1);
+      add_event (events, hi, s->kind == CS_HOLE ? -1 : s->net, -1);
+    }
+}
+
+/*!
+ * \brief Count the copper of scanline row from x1 to x2 for the nets in
+ * on.
+ */
+static void
+add_covered (CopperTask *t, int row, double x1, double x2,
+	     const int *on, int non)
+{
+  const CopperGrid *grid = t->grid;
+  double area = (x2 - x1) * grid->dy, *cells, end;
+  int i, col;
+
+  t->area += area;
+  for (i = 0; i < non; i++)
+    t->net_area[on[i]] += area;
+
+  cells = t->g->cells + (row / grid->rows_per_cell) * grid->cols;
+  col = MAX (0, MIN (grid->cols - 1, (int) floor (x1 / grid->cell)));
+  while (x1 < x2)
+    {
+      end = col + 1 < grid->cols ? MIN (x2, (col + 1) * (double) grid->cell)
+	: x2;
+      cells[col] += (end - x1) * grid->dy;
+      x1 = end;
+      col++;
+    }
+}
+
+/*!
+ * \brief Sweep a scanline from left to right through its sorted events.
+ *
+ * The winding number of each net is kept in wind, and the nets it is
+ * above zero for in on, so that the length between two events goes to
+ * the nets the scanline is inside of there.  Nothing counts inside a
+ * hole.
+ */
+static void
+sweep_row (CopperTask *t, int row, GArray *events, int *wind, int *on)
+{
+  CopperEvent *e = (CopperEvent *) events->data;
+  double px = 0;
+  int i, j, holes = 0, non = 0, w;
+
+  for (i = 0; i < events->len; i++)
+    {
+      if (e[i].x > px && non > 0 && holes == 0)
+	add_covered (t, row, px, e[i].x, on, non);
+      px = e[i].x;
+      if (e[i].net < 0)
+	{
+	  holes += e[i].delta;
+	  continue;
+	}
+      w = wind[e[i].net];
+      wind[e[i].net] += e[i].delta;
+      if (w <= 0 && wind[e[i].net] > 0)
+	on[non++] = e[i].net;
+      else if (w > 0 && wind[e[i].net] <= 0)
+	for (j = 0; j < non; j++)
+	  if (on[j] == e[i].net)
+	    {
+	      on[j] = on[--non];
+	      break;
+	    }
+    }
+  for (i = 0; i < events->len; i++)
+    if (e[i].net >= 0)
+      wind[e[i].net] = 0;
+}
+
+/*!
+ * \brief Scan the rows of a task.
+ *
+ * The shapes are sorted by the first scanline they reach, so the ones
+ * the current scanline may cross are kept in a list that takes the next
+ * ones in, and lets out those the scanline has gone past.
+ */
+static void
+scan_task (CopperTask *t)
+{
+  const CopperShape *s = (const CopperShape *) t->g->shapes->data;
+  int n = t->g->shapes->len, next = 0, nactive = 0, i, row;
+  int *active = (int *) malloc (MAX (n, 1) * sizeof (int));
+  int *wind = (int *) calloc (t->grid->nets, sizeof (int));
+  int *on = (int *) malloc (t->grid->nets * sizeof (int));
+  GArray *events = g_array_new (FALSE, FALSE, sizeof (CopperEvent));
+  double y;
+
+  for (row = t->row1; row < t->row2; row++)
+    {
+      y = (row + 0.5) * t->grid->dy;
+      while (next < n && s[next].Y1 <= y)
+	active[nactive++] = next++;
+      g_array_set_size (events, 0);
+      for (i = 0; i < nactive;)
+	if (s[active[i]].Y2 < y)
+	  active[i] = active[--nactive];
+	else
+	  shape_events (&s[active[i++]], y, events);
+      if (events->len == 0)
+	continue;
+      qsort (events->data, events->len, sizeof (CopperEvent),
+	     compare_events);
+      sweep_row (t, row, events, wind, on);
+    }
+
+  g_array_free (events, TRUE);
+  free (on);
+  free (wind);
+  free (active);
+}
+
+static void
+scan_worker (gpointer data, gpointer user_data)
+{
+  scan_task ((CopperTask *) data);
+}
+
+/* ---------------------------------------------------------------------------
+ * The report.
+ */
+
+/*!
+ * \brief The netlist name of every net label, or NULL.
+ *
+ * A label is named after the net of the first node of a netlist net.
+ */
+static char **
+net_names (int labels)
+{
+  GHashTable *terminals;
+  char **names = (char **) calloc (MAX (labels, 1), sizeof (char *));
+  void *terminal;
+  int ni, label;
+
+  terminals = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  ELEMENT_LOOP (PCB->Data);
+  {
+    char *es = element->Name[NAMEONPCB_INDEX].TextString;
+
+    if (es == NULL)
+      continue;
+    PIN_LOOP (element);
+    {
+      if (pin->Number)
+	g_hash_table_replace (terminals,
+			      g_strdup_printf ("%s-%s", es, pin->Number), pin);
+    }
+    END_LOOP;
+    PAD_LOOP (element);
+    {
+      if (pad->Number)
+	g_hash_table_replace (terminals,
+			      g_strdup_printf ("%s-%s", es, pad->Number), pad);
+    }
+    END_LOOP;
+  }
+  END_LOOP;
+
+  for (ni = 0; ni < PCB->NetlistLib.MenuN; ni++)
+    {
+      if (PCB->NetlistLib.Menu[ni].EntryN == 0)
+	continue;
+      terminal = g_hash_table_lookup (terminals,
+				      PCB->NetlistLib.Menu[ni].Entry[0].ListEntry);
+      if (terminal == NULL)
+	continue;
+      label = ConnectionIndexNetLabel (terminal);
+      if (label >= 0 && label < labels && names[label] == NULL)
+	names[label] = PCB->NetlistLib.Menu[ni].Name + 2;
+    }
+
+  g_hash_table_destroy (terminals);
+  return names;
+}
+
+static void
+stats_print (FILE *fp, const char *fmt, ...)
+{
+  va_list args;
+  gchar *s;
+
+  va_start (args, fmt);
+  s = pcb_vprintf (fmt, args);
+  va_end (args);
+  if (fp)
+    fputs (s, fp);
+  else
+    Message ("%s", s);
+  g_free (s);
+}
+
+#define MM2(area) ((area) / 1e12)
+
+static void
+report_group (FILE *fp, const CopperGrid *grid, CopperGroup *g,
+	      char **names)
+{
+  double board = (double) PCB->MaxWidth * PCB->MaxHeight;
+  double unnamed = 0;
+  char *name =
+    PCB->Data->Layer[PCB->LayerGroups.Entries[g->group][0]].Name;
+  int i, r, c;
+
+  stats_print (fp, _("Group %d \"%s\": %.4f mm^2, %.2f %% of the board\n"),
+	       g->group + 1, name ? name : "", MM2 (g->area),
+	       board > 0 ? 100 * g->area / board : 0.0);
+  for (i = 0; i < grid->nets; i++)
+    {
+      if (g->net_area[i] <= 0)
+	continue;
+      if (i < grid->nets - 1 && names[i])
+	stats_print (fp, _("  net \"%s\": %.4f mm^2\n"), names[i],
+		     MM2 (g->net_area[i]));
+      else
+	unnamed += g->net_area[i];
+    }
+  if (unnamed > 0)
+    stats_print (fp, _("  copper of no netlist net: %.4f mm^2\n"),
+		 MM2 (unnamed));
+
+  stats_print (fp, _("  density in %% of cells of %$mS, top row first:\n"),
+	       grid->cell);
+  for (r = 0; r < grid->rows / grid->rows_per_cell; r++)
+    {
+      stats_print (fp, " ");
+      for (c = 0; c < grid->cols; c++)
+	stats_print (fp, " %5.1f",
+		     100 * g->cells[r * grid->cols + c]
+		     / ((double) grid->cell * grid->cell));
+      stats_print (fp, "\n");
+    }
+}
+
+/*!
+ * \brief Report the copper area of each layer group, of each of its nets
+ * and of each cell of a grid over the board.
+ *
+ * \param filename file to write the report to, or NULL for the log.
+ *
+ * \return 0 on success, 1 if the file can't be written.
+ */
+int
+CopperStats (const char *filename, Coord cell)
+{
+  CopperGrid grid;
+  CopperGroup *groups;
+  CopperTask *tasks;
+  GThreadPool *pool = NULL;
+  FILE *fp = NULL;
+  char **names;
+  int ngroups = 0, ntasks = 0, threads, chunk, cell_rows, g, i, r;
+
+  if (filename && (fp = fopen (filename, "w")) == NULL)
+    {
+      OpenErrorMessage ((char *) filename);
+      return 1;
+    }
+  if (cell <= 0)
+    cell = COPPER_STATS_CELL;
+
+  grid.cell = cell;
+  grid.rows_per_cell = MAX (1, (int) (cell / COPPER_STATS_PITCH + 0.5));
+  grid.dy = (double) cell / grid.rows_per_cell;
+  grid.cols = MAX (1, (PCB->MaxWidth + cell - 1) / cell);
+  cell_rows = MAX (1, (PCB->MaxHeight + cell - 1) / cell);
+  grid.rows = cell_rows * grid.rows_per_cell;
+  /* the last one is for copper of no net */
+  grid.nets = ConnectionIndexNetCount () + 1;
+  names = net_names (grid.nets - 1);
+
+  groups = (CopperGroup *) calloc (max_group, sizeof (CopperGroup));
+  for (g = 0; g < max_group; g++)
+    {
+      CopperGroup *cg = &groups[ngroups];
+
+      cg->group = g;
+      cg->shapes = g_array_new (FALSE, FALSE, sizeof (CopperShape));
+      if (!gather_group (cg, grid.nets))
+	{
+	  g_array_free (cg->shapes, TRUE);
+	  continue;
+	}
+      cg->net_area = (double *) calloc (grid.nets, sizeof (double));
+      cg->cells = (double *) calloc (cell_rows * grid.cols, sizeof (double));
+      ngroups++;
+    }
+
+  /* a few strips of cell rows for each thread, so that they even out */
+  threads = g_get_num_processors ();
+  chunk = MAX (1, cell_rows / (2 * threads));
+  tasks = (CopperTask *) calloc (ngroups * ((cell_rows + chunk - 1) / chunk),
+				 sizeof (CopperTask));
+  for (g = 0; g < ngroups; g++)
+    for (r = 0; r < cell_rows; r += chunk)
+      {
+	CopperTask *t = &tasks[ntasks++];
+
+	t->grid = &grid;
+	t->g = &groups[g];
+	t->row1 = r * grid.rows_per_cell;
+	t->row2 = MIN (r + chunk, cell_rows) * grid.rows_per_cell;
+	t->net_area = (double *) calloc (grid.nets, sizeof (double));
+      }
+
+  if (ntasks > 1 && threads > 1)
+    pool = g_thread_pool_new (scan_worker, NULL, MIN (ntasks, threads),
+			      FALSE, NULL);
+  for (i = 0; i < ntasks; i++)
+    if (pool)
+      g_thread_pool_push (pool, &tasks[i], NULL);
+    else
+      scan_task (&tasks[i]);
+  if (pool)
+    /* wait for all of them */
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  /* sum up in the order of the tasks, so that every run gives the same */
+  for (i = 0; i < ntasks; i++)
+    {
+      tasks[i].g->area += tasks[i].area;
+      for (r = 0; r < grid.nets; r++)
+	tasks[i].g->net_area[r] += tasks[i].net_area[r];
+      free (tasks[i].net_area);
+    }
+  free (tasks);
+
+  stats_print (fp, _("Copper of %$mS x %$mS:\n"), PCB->MaxWidth,
+	       PCB->MaxHeight);
+  for (g = 0; g < ngroups; g++)
+    {
+      report_group (fp, &grid, &groups[g], names);
+      g_array_free (groups[g].shapes, TRUE);
+      free (groups[g].net_area);
+      free (groups[g].cells);
+    }
+  free (groups);
+  free (names);
+  if (fp)
+    fclose (fp);
+  return 0;
+}
+
+static const char copperstats_syntax[] = "CopperStats([file[, cell]])";
+
+static const char copperstats_help[] =
+  "Report the copper area and density of the layer groups.";
+
+/* %start-doc actions CopperStats
+
+Writes to the log, or to the file given, the area of the copper of each
+copper layer group, and the share of the board it covers, the area of
+each net on it, and the density of the copper in the cells of a grid
+over the board, 5 mm on a side unless another size is given:
+
+@example
+pcb -x gerber --action-string "CopperStats(copper.txt, 2mm)" board.pcb
+@end example
+
+The copper is that of the lines, arcs, pads and clipped polygons of the
+layers of a group, and the rings of the pins and vias through it, less
+their drill holes.  Copper overlapping other copper is counted once.
+Nets are named after the netlist, the copper of no netlist net is summed
+together.  Text on copper layers isn't counted.
+
+@code{--copper-stats} writes the same report, with cells of 5 mm, when
+pcb exits from an export.
+
+%end-doc */
+
+static int
+ActionCopperStats (int argc, char **argv, Coord x, Coord y)
+{
+  Coord cell = COPPER_STATS_CELL;
+
+  if (argc > 2)
+    AFAIL (copperstats);
+  if (argc > 1)
+    {
+      bool absolute;
+
+      cell = GetValue (argv[1], NULL, &absolute);
+      if (cell <= 0)
+	AFAIL (copperstats);
+    }
+  return CopperStats (argc > 0 && *argv[0] ? argv[0] : NULL, cell);
+}
+
+HID_Action copperstats_action_list[] = {
+  {"CopperStats", 0, ActionCopperStats,
+   copperstats_help, copperstats_syntax}
+};
+
+REGISTER_ACTIONS (copperstats_action_list)
@@ -0,0 +1,43 @@
+/*!
+ * \file src/copperstats.h
+ *
+ * \brief Copper area and density of the layer groups, for CopperStats()
+ * and --copper-stats.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef	PCB_COPPERSTATS_H
+#define	PCB_COPPERSTATS_H
+
+#include "global.h"
+
+/*!
+ * \brief Side of the cells the density is given for, unless asked
+ * otherwise.
+ */
+#define COPPER_STATS_CELL MM_TO_COORD (5)
+
+int CopperStats (const char *filename, Coord cell);
+
+#endif
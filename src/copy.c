@@ -111,6 +111,7 @@ CopyPolygonLowLevel (PolygonType *Dest, PolygonType *Src)
     }
   SetPolygonBoundingBox (Dest);
   Dest->Flags = Src->Flags;
+  NOTE_FLAGS (Dest->Flags.f);
   CLEAR_FLAG (NOCOPY_FLAGS, Dest);
   return (Dest);
 }
@@ -273,7 +274,7 @@ CopyPolygon (LayerType *Layer, PolygonType *Polygon)
   CopyPolygonLowLevel (polygon, Polygon);
   MovePolygonLowLevel (polygon, DeltaX, DeltaY);
   if (!Layer->polygon_tree)
-    Layer->polygon_tree = r_create_tree (NULL, 0, 0);
+    Layer->polygon_tree = r_create_data_tree ();
   r_insert_entry (Layer->polygon_tree, (BoxType *) polygon, 0);
   InitClip (PCB->Data, Layer, polygon);
   DrawPolygon (Layer, polygon);
@@ -332,6 +333,11 @@ CopyPastebufferToLayout (Coord X, Coord Y)
   /* set movement vector */
   DeltaX = X - PASTEBUFFER->X, DeltaY = Y - PASTEBUFFER->Y;
 
+  DeferDraw ();
+  DeferPolygonClipping ();
+  /* the new objects go into the search trees in bulk at the end */
+  r_defer_inserts ();
+
   /* paste all layers */
   for (i = 0; i < max_copper_layer + SILK_LAYER; i++)
     {
@@ -396,6 +402,10 @@ CopyPastebufferToLayout (Coord X, Coord Y)
       END_LOOP;
     }
 
+  r_resume_inserts ();
+  ResumePolygonClipping ();
+  ResumeDraw ();
+
   if (changed)
     {
       Draw ();
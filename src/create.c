@@ -45,6 +45,7 @@
 #include "data.h"
 #include "draw.h"
 #include "error.h"
+#include "find.h"
 #include "hid.h" /* REGISTER_ACTIONS */
 #include "mymem.h"
 #include "misc.h"
@@ -194,6 +195,7 @@ CreateNewPCB (void)
     SET_FLAG (AUTOBURIEDVIASFLAG, ptr);
   ptr->Grid = Settings.Grid;
   ptr->LayerGroups = Settings.LayerGroups;
+  LayerStackChanged ();
   STYLE_LOOP (ptr);
   {
     *style = Settings.RouteStyle[n];
@@ -258,6 +260,7 @@ CreateNewVia (DataType *Data,
 	      Coord DrillingHole, char *Name, FlagType Flags)
 {
   PinType *Via;
+  unsigned long generation;
 
   if (!be_lenient)
     {
@@ -293,6 +296,7 @@ CreateNewVia (DataType *Data,
 
   Via->Name = STRDUP (Name);
   Via->Flags = Flags;
+  NOTE_FLAGS (Flags.f);
   Via->BuriedFrom = 0;
   Via->BuriedTo = 0;
   CLEAR_FLAG (WARNFLAG, Via);
@@ -313,9 +317,12 @@ CreateNewVia (DataType *Data,
     }
 
   SetPinBoundingBox (Via);
+  generation = r_generation ();
   if (!Data->via_tree)
-    Data->via_tree = r_create_tree (NULL, 0, 0);
+    Data->via_tree = r_create_data_tree ();
   r_insert_entry (Data->via_tree, (BoxType *) Via, 0);
+  if (PCB && Data == PCB->Data)
+    ConnectionIndexNoteAdded (VIA_TYPE, Via, Via, generation);
   return (Via);
 }
 
@@ -520,12 +527,14 @@ CreateNewLineOnLayer (LayerType *Layer,
 		      FlagType Flags)
 {
   LineType *Line;
+  unsigned long generation;
 
   Line = GetLineMemory (Layer);
   if (!Line)
     return (Line);
   Line->ID = ID++;
   Line->Flags = Flags;
+  NOTE_FLAGS (Flags.f);
   CLEAR_FLAG (RATFLAG, Line);
   Line->Thickness = Thickness;
   Line->Clearance = Clearance;
@@ -536,9 +545,12 @@ CreateNewLineOnLayer (LayerType *Layer,
   Line->Point2.Y = Y2;
   Line->Point2.ID = ID++;
   SetLineBoundingBox (Line);
+  generation = r_generation ();
   if (!Layer->line_tree)
-    Layer->line_tree = r_create_tree (NULL, 0, 0);
+    Layer->line_tree = r_create_data_tree ();
   r_insert_entry (Layer->line_tree, (BoxType *) Line, 0);
+  if (PCB && GetLayerNumber (PCB->Data, Layer) < MAX_ALL_LAYER)
+    ConnectionIndexNoteAdded (LINE_TYPE, Layer, Line, generation);
   return (Line);
 }
 
@@ -551,12 +563,14 @@ CreateNewRat (DataType *Data, Coord X1, Coord Y1,
 	      Cardinal group2, Coord Thickness, FlagType Flags)
 {
   RatType *Line = GetRatMemory (Data);
+  unsigned long generation;
 
   if (!Line)
     return (Line);
 
   Line->ID = ID++;
   Line->Flags = Flags;
+  NOTE_FLAGS (Flags.f);
   SET_FLAG (RATFLAG, Line);
   Line->Thickness = Thickness;
   Line->Point1.X = X1;
@@ -568,12 +582,35 @@ CreateNewRat (DataType *Data, Coord X1, Coord Y1,
   Line->group1 = group1;
   Line->group2 = group2;
   SetLineBoundingBox ((LineType *) Line);
+  generation = r_generation ();
   if (!Data->rat_tree)
-    Data->rat_tree = r_create_tree (NULL, 0, 0);
+    Data->rat_tree = r_create_data_tree ();
   r_insert_entry (Data->rat_tree, &Line->BoundingBox, 0);
+  if (PCB && Data == PCB->Data)
+    ConnectionIndexNoteAdded (RATLINE_TYPE, Line, Line, generation);
   return (Line);
 }
 
+struct arc_info
+{
+  Coord X, Y, Width;
+  Angle StartAngle, Delta;
+  jmp_buf env;
+};
+
+static int
+arc_callback (const BoxType * b, void *cl)
+{
+  ArcType *arc = (ArcType *) b;
+  struct arc_info *i = (struct arc_info *) cl;
+
+  if (arc->X == i->X && arc->Y == i->Y && arc->Width == i->Width &&
+      NormalizeAngle (arc->StartAngle) == i->StartAngle &&
+      arc->Delta == i->Delta)
+    longjmp (i->env, 1);
+  return 0;
+}
+
 /*!
  * \brief Creates a new arc on a layer.
  */
@@ -587,21 +624,44 @@ CreateNewArcOnLayer (LayerType *Layer,
 		     Coord Clearance, FlagType Flags)
 {
   ArcType *Arc;
-
-  ARC_LOOP (Layer);
-  {
-    if (arc->X == X1 && arc->Y == Y1 && arc->Width == width &&
-	NormalizeAngle (arc->StartAngle) == NormalizeAngle (sa) &&
-	arc->Delta == dir)
-      return (NULL);		/* prevent stacked arcs */
-  }
-  END_LOOP;
+  struct arc_info info;
+  unsigned long generation;
+
+  /* prevent stacked arcs; any such arc overlaps the new one's box */
+  info.X = X1;
+  info.Y = Y1;
+  info.Width = width;
+  info.StartAngle = NormalizeAngle (sa);
+  info.Delta = dir;
+  if (Layer->arc_tree)
+    {
+      ArcType probe;
+
+      memset (&probe, 0, sizeof (probe));
+      probe.X = X1;
+      probe.Y = Y1;
+      probe.Width = width;
+      probe.Height = height;
+      probe.StartAngle = sa;
+      probe.Delta = dir;
+      probe.Thickness = Thickness;
+      SetArcBoundingBox (&probe);
+      probe.BoundingBox.X1--;
+      probe.BoundingBox.Y1--;
+      probe.BoundingBox.X2++;
+      probe.BoundingBox.Y2++;
+      if (setjmp (info.env) != 0)
+	return (NULL);
+      r_search (Layer->arc_tree, &probe.BoundingBox, NULL, arc_callback,
+		&info);
+    }
   Arc = GetArcMemory (Layer);
   if (!Arc)
     return (Arc);
 
   Arc->ID = ID++;
   Arc->Flags = Flags;
+  NOTE_FLAGS (Flags.f);
   Arc->Thickness = Thickness;
   Arc->Clearance = Clearance;
   Arc->X = X1;
@@ -611,9 +671,12 @@ CreateNewArcOnLayer (LayerType *Layer,
   Arc->StartAngle = sa;
   Arc->Delta = dir;
   SetArcBoundingBox (Arc);
+  generation = r_generation ();
   if (!Layer->arc_tree)
-    Layer->arc_tree = r_create_tree (NULL, 0, 0);
+    Layer->arc_tree = r_create_data_tree ();
   r_insert_entry (Layer->arc_tree, (BoxType *) Arc, 0);
+  if (PCB && GetLayerNumber (PCB->Data, Layer) < MAX_ALL_LAYER)
+    ConnectionIndexNoteAdded (ARC_TYPE, Layer, Arc, generation);
   return (Arc);
 }
 
@@ -637,7 +700,7 @@ CreateNewPolygonFromRectangle (LayerType *Layer,
   CreateNewPointInPolygon (polygon, X1, Y2);
   SetPolygonBoundingBox (polygon);
   if (!Layer->polygon_tree)
-    Layer->polygon_tree = r_create_tree (NULL, 0, 0);
+    Layer->polygon_tree = r_create_data_tree ();
   r_insert_entry (Layer->polygon_tree, (BoxType *) polygon, 0);
   return (polygon);
 }
@@ -666,6 +729,7 @@ CreateNewText (LayerType *Layer, FontType *PCBFont,
   text->Y = Y;
   text->Direction = Direction;
   text->Flags = Flags;
+  NOTE_FLAGS (Flags.f);
   text->Scale = Scale;
   text->TextString = strdup (TextString);
 
@@ -673,7 +737,7 @@ CreateNewText (LayerType *Layer, FontType *PCBFont,
   SetTextBoundingBox (PCBFont, text);
   text->ID = ID++;
   if (!Layer->text_tree)
-    Layer->text_tree = r_create_tree (NULL, 0, 0);
+    Layer->text_tree = r_create_data_tree ();
   r_insert_entry (Layer->text_tree, (BoxType *) text, 0);
   return (text);
 }
@@ -688,10 +752,14 @@ CreateNewPolygon (LayerType *Layer, FlagType Flags)
 
   /* copy values */
   polygon->Flags = Flags;
+  NOTE_FLAGS (Flags.f);
   polygon->ID = ID++;
   polygon->Clipped = NULL;
   polygon->NoHoles = NULL;
-  polygon->NoHolesValid = 0;
+  polygon->ClippedGen = 0;
+  polygon->NoHolesGen = 0;
+  polygon->DicedGen = 0;
+  polygon->Tiles = NULL;
   return (polygon);
 }
 
@@ -754,6 +822,7 @@ CreateNewElement (DataType *Data, FontType *PCBFont, FlagType Flags,
   NAMEONPCB_TEXT (Element).Element = Element;
   VALUE_TEXT (Element).Element = Element;
   Element->Flags = Flags;
+  NOTE_FLAGS (Flags.f);
   Element->ID = ID++;
 
 #ifdef DEBUG_CREATE_C
@@ -774,8 +843,8 @@ CreateNewArcInElement (ElementType *Element,
 {
   ArcType *arc;
 
-  arc = g_slice_new0 (ArcType);
-  Element->Arc = g_list_append (Element->Arc, arc);
+  arc = POOL_NEW0 (ArcType);
+  Element->Arc = AppendToObjectList (Element->Arc, &Element->ArcTail, arc);
   Element->ArcN ++;
 
   /* set Delta (0,360], StartAngle in [0,360) */
@@ -815,8 +884,8 @@ CreateNewLineInElement (ElementType *Element,
   if (Thickness == 0)
     return NULL;
 
-  line = g_slice_new0 (LineType);
-  Element->Line = g_list_append (Element->Line, line);
+  line = POOL_NEW0 (LineType);
+  Element->Line = AppendToObjectList (Element->Line, &Element->LineTail, line);
   Element->LineN ++;
 
   /* copy values */
@@ -848,9 +917,10 @@ CreateNewPin (ElementType *Element,
   pin->Thickness = Thickness;
   pin->Clearance = Clearance;
   pin->Mask = Mask;
-  pin->Name = STRDUP (Name);
-  pin->Number = STRDUP (Number);
+  pin->Name = ShareString (Name);
+  pin->Number = ShareString (Number);
   pin->Flags = Flags;
+  NOTE_FLAGS (Flags.f);
   CLEAR_FLAG (WARNFLAG, pin);
   SET_FLAG (PINFLAG, pin);
   pin->ID = ID++;
@@ -928,9 +998,10 @@ CreateNewPad (ElementType *Element,
   pad->Thickness = Thickness;
   pad->Clearance = Clearance;
   pad->Mask = Mask;
-  pad->Name = STRDUP (Name);
-  pad->Number = STRDUP (Number);
+  pad->Name = ShareString (Name);
+  pad->Number = ShareString (Number);
   pad->Flags = Flags;
+  NOTE_FLAGS (Flags.f);
   CLEAR_FLAG (WARNFLAG, pad);
   pad->ID = ID++;
   pad->Element = Element;
@@ -947,12 +1018,13 @@ AddTextToElement (TextType *Text, FontType *PCBFont,
 		  Coord X, Coord Y,
 		  unsigned Direction, char *TextString, int Scale, FlagType Flags)
 {
-  free (Text->TextString);
-  Text->TextString = (TextString && *TextString) ? strdup (TextString) : NULL;
+  ReleaseString (Text->TextString);
+  Text->TextString = (TextString && *TextString) ? ShareString (TextString) : NULL;
   Text->X = X;
   Text->Y = Y;
   Text->Direction = Direction;
   Text->Flags = Flags;
+  NOTE_FLAGS (Flags.f);
   Text->Scale = Scale;
 
   /* calculate size of the bounding box */
@@ -1031,11 +1103,9 @@ LibraryMenuType *
 CreateNewNet (LibraryType *lib, char *name, char *style)
 {
   LibraryMenuType *menu;
-  char temp[64];
 
-  sprintf (temp, "  %s", name);
   menu = GetLibraryMenuMemory (lib);
-  menu->Name = strdup (temp);
+  menu->Name = Concat ("  ", name, NULL);
   menu->flag = 1;		/* net is enabled by default */
   if (style == NULL || NSTRCMP ("(unknown)", style) == 0)
     menu->Style = NULL;
@@ -1067,8 +1137,8 @@ CreateNewAttribute (AttributeListType *list, char *name, char *value)
       list->Max += 10;
       list->List = (AttributeType *)realloc (list->List, list->Max * sizeof (AttributeType));
     }
-  list->List[list->Number].name = STRDUP (name);
-  list->List[list->Number].value = STRDUP (value);
+  list->List[list->Number].name = ShareString (name);
+  list->List[list->Number].value = ShareString (value);
   list->Number++;
   return &list->List[list->Number - 1];
 }
@@ -42,6 +42,7 @@
 
 #include "crosshair.h"
 
+#include "box.h"
 #include "buffer.h"
 #include "data.h"
 #include "draw.h"
@@ -51,6 +52,7 @@
 #include "mymem.h"
 #include "search.h"
 #include "polygon.h"
+#include "rtree.h"
 
 #ifdef HAVE_LIBDMALLOC
 #include <dmalloc.h>
@@ -334,8 +336,321 @@ XORDrawElement (hidGC gc, ElementType *Element, Coord DX, Coord DY)
                             Element->MarkY + DY + EMARK_SIZE);
 }
 
+/*!
+ * \brief Above this many visible objects the pastebuffer is drawn as the
+ * outline of the area its objects cover, instead of object by object.
+ */
+#define XOR_BUFFER_DETAIL_MAX	1000
+
+/*!
+ * \brief Number of cells across the longer side of the pastebuffer, for
+ * its outline.
+ */
+#define XOR_BUFFER_CELLS	128
+
+/*!
+ * \brief Which layers and object classes of the pastebuffer are drawn.
+ */
+typedef struct
+{
+  bool layer[MAX_ALL_LAYER];
+  bool elements, vias, invisible, bottom;
+} BufferVisibility;
+
+/*!
+ * \brief The outline of a large pastebuffer, made once for each change of
+ * the buffer and drawn, moved, while it follows the crosshair.
+ */
+static struct
+{
+  /* what the outline was made from */
+  BufferType *buffer;
+  DataType *data;
+  unsigned long generation;
+  BoxType box;
+  Coord x, y;
+  BufferVisibility visible;
+  Cardinal objects;
+
+  /* the outline segments, in buffer coordinates */
+  BoxType *segments;
+  Cardinal n, max;
+} xor_outline;
+
+/*!
+ * \brief Fills in which layers and object classes of the pastebuffer are
+ * drawn now.
+ */
+static void
+buffer_visibility (BufferVisibility *visible)
+{
+  Cardinal i;
+
+  memset (visible, 0, sizeof (*visible));
+  for (i = 0; i < max_copper_layer + SILK_LAYER; i++)
+    visible->layer[i] = PCB->Data->Layer[i].On;
+  visible->elements = PCB->PinOn && PCB->ElementOn;
+  visible->vias = PCB->ViaOn;
+  visible->invisible = PCB->InvisibleObjectsOn;
+  visible->bottom = Settings.ShowBottomSide;
+}
+
+/*!
+ * \brief Returns the number of objects of the pastebuffer that are
+ * drawn.
+ */
+static Cardinal
+buffer_objects (BufferType *Buffer, BufferVisibility *visible)
+{
+  Cardinal i, n = 0;
+
+  for (i = 0; i < max_copper_layer + SILK_LAYER; i++)
+    if (visible->layer[i])
+      {
+	LayerType *layer = &Buffer->Data->Layer[i];
+
+	n += layer->LineN + layer->ArcN + layer->TextN + layer->PolygonN;
+      }
+  if (visible->elements)
+    n += Buffer->Data->ElementN;
+  if (visible->vias)
+    n += Buffer->Data->ViaN;
+  return n;
+}
+
+struct outline_grid
+{
+  BoxType box;
+  Coord cell;
+  int cols, rows;
+  guint8 *used;
+};
+
+/*!
+ * \brief Marks the cells a box covers.
+ */
+static void
+outline_mark_box (struct outline_grid *g, const BoxType *b)
+{
+  int c1, c2, r1, r2, c, r;
+
+  c1 = MAX (0, (b->X1 - g->box.X1) / g->cell);
+  c2 = MIN (g->cols - 1, (b->X2 - g->box.X1) / g->cell);
+  r1 = MAX (0, (b->Y1 - g->box.Y1) / g->cell);
+  r2 = MIN (g->rows - 1, (b->Y2 - g->box.Y1) / g->cell);
+  for (r = r1; r <= r2; r++)
+    for (c = c1; c <= c2; c++)
+      g->used[r * g->cols + c] = 1;
+}
+
+/*!
+ * \brief Marks the cells along a line, so that a long diagonal line does
+ * not fill its whole bounding box.
+ */
+static void
+outline_mark_line (struct outline_grid *g, LineType *line)
+{
+  Coord dx = line->Point2.X - line->Point1.X;
+  Coord dy = line->Point2.Y - line->Point1.Y;
+  int steps = MAX (abs (dx), abs (dy)) / g->cell + 1;
+  Coord half = line->Thickness / 2;
+  int i;
+
+  for (i = 0; i <= steps; i++)
+    {
+      Coord x = line->Point1.X + (double) dx * i / steps;
+      Coord y = line->Point1.Y + (double) dy * i / steps;
+      BoxType b;
+
+      b.X1 = x - half;
+      b.Y1 = y - half;
+      b.X2 = x + half;
+      b.Y2 = y + half;
+      outline_mark_box (g, &b);
+    }
+}
+
+static void
+outline_add_segment (Coord x1, Coord y1, Coord x2, Coord y2)
+{
+  BoxType *seg;
+
+  if (xor_outline.n >= xor_outline.max)
+    {
+      xor_outline.max = MAX (256, 2 * xor_outline.max);
+      xor_outline.segments = (BoxType *)
+	realloc (xor_outline.segments,
+		 xor_outline.max * sizeof (*xor_outline.segments));
+    }
+  seg = &xor_outline.segments[xor_outline.n++];
+  seg->X1 = x1;
+  seg->Y1 = y1;
+  seg->X2 = x2;
+  seg->Y2 = y2;
+}
+
+static bool
+outline_used (struct outline_grid *g, int c, int r)
+{
+  return c >= 0 && c < g->cols && r >= 0 && r < g->rows
+    && g->used[r * g->cols + c];
+}
+
+/*!
+ * \brief Makes the outline of the cells the drawn objects of the
+ * pastebuffer cover, joining the cell edges on a row or column into one
+ * segment.
+ */
+static void
+make_buffer_outline (BufferType *Buffer, BufferVisibility *visible)
+{
+  struct outline_grid g;
+  Coord width, height;
+  Cardinal i;
+  int c, r, start;
+
+  g.box = Buffer->BoundingBox;
+  width = g.box.X2 - g.box.X1;
+  height = g.box.Y2 - g.box.Y1;
+  g.cell = MAX (1, (MAX (width, height) + XOR_BUFFER_CELLS - 1)
+		   / XOR_BUFFER_CELLS);
+  g.cols = width / g.cell + 1;
+  g.rows = height / g.cell + 1;
+  g.used = (guint8 *) calloc (g.cols * g.rows, 1);
+
+  for (i = 0; i < max_copper_layer + SILK_LAYER; i++)
+    if (visible->layer[i])
+      {
+	LayerType *layer = &Buffer->Data->Layer[i];
+
+	LINE_LOOP (layer);
+	{
+	  outline_mark_line (&g, line);
+	}
+	END_LOOP;
+	ARC_LOOP (layer);
+	{
+	  outline_mark_box (&g, &arc->BoundingBox);
+	}
+	END_LOOP;
+	TEXT_LOOP (layer);
+	{
+	  outline_mark_box (&g, &text->BoundingBox);
+	}
+	END_LOOP;
+	POLYGON_LOOP (layer);
+	{
+	  outline_mark_box (&g, &polygon->BoundingBox);
+	}
+	END_LOOP;
+      }
+  if (visible->elements)
+    ELEMENT_LOOP (Buffer->Data);
+  {
+    if (FRONT (element) || visible->invisible)
+      outline_mark_box (&g, &element->BoundingBox);
+  }
+  END_LOOP;
+  if (visible->vias)
+    VIA_LOOP (Buffer->Data);
+  {
+    outline_mark_box (&g, &via->BoundingBox);
+  }
+  END_LOOP;
+
+  xor_outline.n = 0;
+
+  /* horizontal edges, above each row of cells */
+  for (r = 0; r <= g.rows; r++)
+    for (c = 0; c < g.cols; c = start)
+      {
+	for (start = c; start < g.cols
+	     && outline_used (&g, start, r) == outline_used (&g, start, r - 1);
+	     start++)
+	  ;
+	c = start;
+	for (; start < g.cols
+	     && outline_used (&g, start, r) != outline_used (&g, start, r - 1);
+	     start++)
+	  ;
+	if (start > c)
+	  outline_add_segment (g.box.X1 + c * g.cell, g.box.Y1 + r * g.cell,
+			       g.box.X1 + start * g.cell,
+			       g.box.Y1 + r * g.cell);
+      }
+
+  /* vertical edges, left of each column of cells */
+  for (c = 0; c <= g.cols; c++)
+    for (r = 0; r < g.rows; r = start)
+      {
+	for (start = r; start < g.rows
+	     && outline_used (&g, c, start) == outline_used (&g, c - 1, start);
+	     start++)
+	  ;
+	r = start;
+	for (; start < g.rows
+	     && outline_used (&g, c, start) != outline_used (&g, c - 1, start);
+	     start++)
+	  ;
+	if (start > r)
+	  outline_add_segment (g.box.X1 + c * g.cell, g.box.Y1 + r * g.cell,
+			       g.box.X1 + c * g.cell,
+			       g.box.Y1 + start * g.cell);
+      }
+
+  free (g.used);
+}
+
+/*!
+ * \brief Draws the outline of a large pastebuffer, making it again if
+ * the buffer changed since it was made.
+ *
+ * \return false if the buffer is small enough to be drawn in full.
+ */
+static bool
+XORDrawBufferOutline (hidGC gc, BufferType *Buffer, Coord x, Coord y)
+{
+  BufferVisibility visible;
+  Cardinal objects;
+  Cardinal i;
+
+  buffer_visibility (&visible);
+  objects = buffer_objects (Buffer, &visible);
+
+  if (objects <= XOR_BUFFER_DETAIL_MAX)
+    return false;
+
+  if (xor_outline.buffer != Buffer || xor_outline.data != Buffer->Data
+      || xor_outline.generation != r_generation ()
+      || memcmp (&xor_outline.box, &Buffer->BoundingBox, sizeof (BoxType))
+      || xor_outline.x != Buffer->X || xor_outline.y != Buffer->Y
+      || memcmp (&xor_outline.visible, &visible, sizeof (visible))
+      || xor_outline.objects != objects)
+    {
+      make_buffer_outline (Buffer, &visible);
+      xor_outline.buffer = Buffer;
+      xor_outline.data = Buffer->Data;
+      xor_outline.generation = r_generation ();
+      xor_outline.box = Buffer->BoundingBox;
+      xor_outline.x = Buffer->X;
+      xor_outline.y = Buffer->Y;
+      xor_outline.visible = visible;
+      xor_outline.objects = objects;
+    }
+
+  for (i = 0; i < xor_outline.n; i++)
+    gui->graphics->draw_line (gc,
+			      x + xor_outline.segments[i].X1,
+			      y + xor_outline.segments[i].Y1,
+			      x + xor_outline.segments[i].X2,
+			      y + xor_outline.segments[i].Y2);
+  return true;
+}
+
 /*!
  * \brief Draws all visible and attached objects of the pastebuffer.
+ *
+ * A large buffer is drawn as the outline of the area its objects cover.
  */
 static void
 XORDrawBuffer (hidGC gc, BufferType *Buffer)
@@ -347,6 +662,9 @@ XORDrawBuffer (hidGC gc, BufferType *Buffer)
   x = Crosshair.X - Buffer->X;
   y = Crosshair.Y - Buffer->Y;
 
+  if (XORDrawBufferOutline (gc, Buffer, x, y))
+    return;
+
   /* draw all visible layers */
   for (i = 0; i < max_copper_layer + SILK_LAYER; i++)
     if (PCB->Data->Layer[i].On)
@@ -864,6 +1182,214 @@ crosshair_sq_dist (CrosshairType *crosshair, Coord x, Coord y)
   return square (x - crosshair->X) + square (y - crosshair->Y);
 }
 
+/* ---------------------------------------------------------------------------
+ * Snap points
+ *
+ * The end points of lines and arcs and the points of polygons are kept
+ * in one r-tree, so that the crosshair finds the point to snap to with a
+ * single search instead of searching each layer, and every point of
+ * every polygon on it.  The index is built on the first search after the
+ * board settles, that is when r_generation() did not change since the
+ * previous search, and kept until it changes again.  While the board is
+ * being changed the searches go through SearchObjectByLocation().
+ */
+typedef struct
+{
+  BoxType box; /*!< The point, as a box for the r-tree. */
+  int type; /*!< LINEPOINT_TYPE, ARCPOINT_TYPE or POLYGONPOINT_TYPE. */
+  int layer; /*!< Layer number. */
+  AnyObjectType *object; /*!< The line, arc or polygon. */
+  PointType *point;
+} SnapPointType;
+
+static struct
+{
+  rtree_t *tree;
+  SnapPointType *points;
+  PCBType *pcb;
+  unsigned long generation; /*!< r_generation() the index was built at. */
+  unsigned long seen; /*!< r_generation() at the previous search. */
+} snap_index;
+
+static void
+add_snap_point (SnapPointType **p, int type, int layer, void *object,
+		PointType *point)
+{
+  (*p)->box = point_box (point->X, point->Y);
+  (*p)->type = type;
+  (*p)->layer = layer;
+  (*p)->object = (AnyObjectType *) object;
+  (*p)->point = point;
+  (*p)++;
+}
+
+/*!
+ * \brief Makes sure the snap point index describes the board.
+ *
+ * \return false if the board changed since the previous search, and the
+ * index isn't worth building yet.
+ */
+static bool
+SnapIndexUpdate (void)
+{
+  const BoxType **boxes;
+  SnapPointType *p;
+  size_t n_points = 0, i;	/* POLYGON_LOOP has an n of its own */
+  int l;
+
+  if (snap_index.tree && snap_index.pcb == PCB
+      && snap_index.generation == r_generation ())
+    return true;
+  if (snap_index.seen != r_generation ())
+    {
+      snap_index.seen = r_generation ();
+      return false;
+    }
+
+  if (snap_index.tree)
+    r_destroy_tree (&snap_index.tree);
+  free (snap_index.points);
+
+  for (l = 0; l < max_copper_layer + SILK_LAYER; l++)
+    {
+      LayerType *layer = &PCB->Data->Layer[l];
+
+      n_points += 2 * (layer->LineN + layer->ArcN);
+      POLYGON_LOOP (layer);
+      {
+	n_points += polygon->PointN;
+      }
+      END_LOOP;
+    }
+
+  snap_index.points = p = (SnapPointType *) malloc (MAX (n_points, 1) * sizeof (*p));
+  for (l = 0; l < max_copper_layer + SILK_LAYER; l++)
+    {
+      LayerType *layer = &PCB->Data->Layer[l];
+
+      LINE_LOOP (layer);
+      {
+	add_snap_point (&p, LINEPOINT_TYPE, l, line, &line->Point1);
+	add_snap_point (&p, LINEPOINT_TYPE, l, line, &line->Point2);
+      }
+      END_LOOP;
+      ARC_LOOP (layer);
+      {
+	add_snap_point (&p, ARCPOINT_TYPE, l, arc, &arc->Point1);
+	add_snap_point (&p, ARCPOINT_TYPE, l, arc, &arc->Point2);
+      }
+      END_LOOP;
+      POLYGON_LOOP (layer);
+      {
+	POLYGONPOINT_LOOP (polygon);
+	{
+	  add_snap_point (&p, POLYGONPOINT_TYPE, l, polygon, point);
+	}
+	END_LOOP;
+      }
+      END_LOOP;
+    }
+
+  boxes = (const BoxType **) malloc (MAX (n_points, 1) * sizeof (*boxes));
+  for (i = 0; i < n_points; i++)
+    boxes[i] = &snap_index.points[i].box;
+  snap_index.tree = r_create_tree (boxes, n_points, 0);
+  free (boxes);
+
+  snap_index.pcb = PCB;
+  snap_index.generation = snap_index.seen = r_generation ();
+  return true;
+}
+
+struct snap_search
+{
+  unsigned type;
+  Coord x, y, radius;
+  int rank[MAX_ALL_LAYER]; /*!< Search order of the layers, -1 if off. */
+  const SnapPointType *best;
+  int best_rank;
+  double best_distance;
+};
+
+static int
+snap_point_callback (const BoxType *b, void *cl)
+{
+  const SnapPointType *sp = (const SnapPointType *) b;
+  struct snap_search *ss = (struct snap_search *) cl;
+  int rank;
+  double d;
+
+  if (!(sp->type & ss->type) || ss->rank[sp->layer] < 0)
+    return 0;
+  if (sp->type != POLYGONPOINT_TYPE && TEST_FLAG (LOCKFLAG, sp->object))
+    return 0;
+  d = Distance (ss->x, ss->y, sp->point->X, sp->point->Y);
+  if (d >= ss->radius)
+    return 0;
+
+  /* in a layer, polygon points come first, then line and arc points */
+  rank = 4 * ss->rank[sp->layer] + (sp->type == POLYGONPOINT_TYPE ? 0 :
+				    sp->type == LINEPOINT_TYPE ? 1 : 2);
+  if (ss->best == NULL || rank < ss->best_rank
+      || (rank == ss->best_rank && d < ss->best_distance))
+    {
+      ss->best = sp;
+      ss->best_rank = rank;
+      ss->best_distance = d;
+    }
+  return 1;
+}
+
+/*!
+ * \brief Searches a line, arc or polygon point to snap to.
+ *
+ * Finds what SearchObjectByLocation() does for these types: the nearest
+ * point closer than Radius on the first layer, in its search order, that
+ * has one.
+ */
+static int
+SearchSnapPoint (unsigned Type, void **Result1, void **Result2,
+		 void **Result3, Coord X, Coord Y, Coord Radius)
+{
+  struct snap_search ss;
+  BoxType region;
+  int i, rank = 0;
+
+  if (!SnapIndexUpdate ())
+    return SearchObjectByLocation (Type, Result1, Result2, Result3,
+				   X, Y, Radius);
+  if (TEST_FLAG (ONLYNAMESFLAG, PCB))
+    return NO_TYPE;
+
+  for (i = 0; i < MAX_ALL_LAYER; i++)
+    ss.rank[i] = -1;
+  if (PCB->Data->SILKLAYER.On)
+    ss.rank[GetLayerNumber (PCB->Data, &PCB->Data->SILKLAYER)] = rank++;
+  for (i = 0; i < max_copper_layer; i++)
+    if (LAYER_ON_STACK (i)->On)
+      ss.rank[GetLayerNumber (PCB->Data, LAYER_ON_STACK (i))] = rank++;
+  if (PCB->InvisibleObjectsOn && PCB->Data->BACKSILKLAYER.On)
+    ss.rank[GetLayerNumber (PCB->Data, &PCB->Data->BACKSILKLAYER)] = rank++;
+
+  ss.type = Type;
+  ss.x = X;
+  ss.y = Y;
+  ss.radius = Radius;
+  ss.best = NULL;
+  region.X1 = X - Radius;
+  region.Y1 = Y - Radius;
+  region.X2 = X + Radius;
+  region.Y2 = Y + Radius;
+  r_search (snap_index.tree, &region, NULL, snap_point_callback, &ss);
+  if (ss.best == NULL)
+    return NO_TYPE;
+
+  *Result1 = &PCB->Data->Layer[ss.best->layer];
+  *Result2 = ss.best->object;
+  *Result3 = ss.best->point;
+  return ss.best->type;
+}
+
 struct snap_data {
   CrosshairType *crosshair;
   double nearest_sq_dist;
@@ -1176,9 +1702,9 @@ FitCrosshairIntoGrid (Coord X, Coord Y)
   /* try snapping to the end points of lines and arcs */
   ans = NO_TYPE;
   if (TEST_FLAG (SNAPPINFLAG, PCB))
-    ans = SearchObjectByLocation (LINEPOINT_TYPE | ARCPOINT_TYPE,
-                                  &ptr1, &ptr2, &ptr3,
-                                  Crosshair.X, Crosshair.Y, PCB->Grid / 2);
+    ans = SearchSnapPoint (LINEPOINT_TYPE | ARCPOINT_TYPE,
+                           &ptr1, &ptr2, &ptr3,
+                           Crosshair.X, Crosshair.Y, PCB->Grid / 2);
 
   if (ans != NO_TYPE)
     {
@@ -1193,8 +1719,8 @@ FitCrosshairIntoGrid (Coord X, Coord Y)
   /* try snapping to a point defining a polygon */
   ans = NO_TYPE;
   if (TEST_FLAG (SNAPPINFLAG, PCB))
-    ans = SearchObjectByLocation (POLYGONPOINT_TYPE, &ptr1, &ptr2, &ptr3,
-                                  Crosshair.X, Crosshair.Y, PCB->Grid / 2);
+    ans = SearchSnapPoint (POLYGONPOINT_TYPE, &ptr1, &ptr2, &ptr3,
+                           Crosshair.X, Crosshair.Y, PCB->Grid / 2);
 
   if (ans != NO_TYPE)
     {
@@ -1216,9 +1742,9 @@ FitCrosshairIntoGrid (Coord X, Coord Y)
    * grab the line endpoint */
   if (Settings.Mode == ARROW_MODE)
     {
-      ans = SearchObjectByLocation (LINEPOINT_TYPE | ARCPOINT_TYPE,
-                                    &ptr1, &ptr2, &ptr3,
-                                    Crosshair.X, Crosshair.Y, PCB->Grid / 2);
+      ans = SearchSnapPoint (LINEPOINT_TYPE | ARCPOINT_TYPE,
+                             &ptr1, &ptr2, &ptr3,
+                             Crosshair.X, Crosshair.Y, PCB->Grid / 2);
       if (ans == NO_TYPE)
         hid_action("PointCursor");
       else if (!TEST_FLAG(SELECTEDFLAG, (LineType *)ptr2))
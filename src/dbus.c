@@ -27,6 +27,7 @@
 
 #define DBUS_API_SUBJECT_TO_CHANGE
 #include <dbus/dbus.h>
+#include <stdarg.h>
 #include <string.h>
 
 #include "dbus.h"
@@ -34,6 +35,8 @@
 #include "dbus-introspect.h"
 #include "global.h"
 #include "data.h"
+#include "hid.h"
+#include "job.h"
 
 /* For lrealpath */
 #include "lrealpath.h"
@@ -46,6 +49,27 @@
 
 static DBusConnection *pcb_dbus_conn;
 
+/*!
+ * \brief A list of action strings queued by StartJob, run one string
+ * per main loop iteration.
+ */
+typedef struct dbus_job
+{
+  struct dbus_job *next;
+  dbus_uint32_t id;
+  char **actions;		/* belongs to us, free with dbus_free_string_array */
+  int n_actions;
+  int done;
+  dbus_int32_t result;
+}
+dbus_job;
+
+/* the jobs waiting, the first of them the one running */
+static dbus_job *jobs = NULL;
+static dbus_uint32_t last_job_id = 0;
+static hidval job_timer;
+static bool job_timer_set = false;
+
 
 static DBusHandlerResult
 handle_get_filename (DBusConnection * connection, DBusMessage * message,
@@ -188,6 +212,266 @@ out:
 }
 
 
+/*!
+ * \brief Send a reply carrying the arguments given, a list of type and
+ * value pointer pairs ending with DBUS_TYPE_INVALID.
+ */
+static DBusHandlerResult
+send_reply (DBusConnection * connection, DBusMessage * message,
+	    int first_type, ...)
+{
+  DBusMessage *reply;
+  DBusHandlerResult result;
+  va_list ap;
+  dbus_bool_t ok;
+
+  result = DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+  reply = dbus_message_new_method_return (message);
+  if (reply == NULL)
+    {
+      fprintf (stderr, "pcb_dbus: Couldn't create reply message\n");
+      return result;
+    }
+  va_start (ap, first_type);
+  ok = dbus_message_append_args_valist (reply, first_type, ap);
+  va_end (ap);
+  if (!ok)
+    {
+      fprintf (stderr, "pcb_dbus: Couldn't sent message, Out Of Memory!\n");
+      goto out;
+    }
+  if (!dbus_connection_send (connection, reply, NULL))
+    {
+      fprintf (stderr, "pcb_dbus: Couldn't send message, Out Of Memory!\n");
+      goto out;
+    }
+  result = DBUS_HANDLER_RESULT_HANDLED;
+out:
+  dbus_message_unref (reply);
+  return result;
+}
+
+
+/*!
+ * \brief Run a list of action strings and return the results of all of
+ * them in one reply.
+ *
+ * Each string is run as hid_parse_actions() would, and its result is
+ * nonzero if one of its actions failed.  A failing string doesn't stop
+ * the ones after it.
+ */
+static DBusHandlerResult
+handle_exec_actions (DBusConnection * connection, DBusMessage * message,
+		     void *data)
+{
+  DBusHandlerResult result;
+  DBusError err;
+  dbus_int32_t *results;
+  char **actions;
+  int n, i;
+
+  dbus_error_init (&err);
+  actions = NULL;
+  if (!dbus_message_get_args (message,
+			      &err,
+			      DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &actions, &n,
+			      DBUS_TYPE_INVALID))
+    {
+      fprintf (stderr, "Failed to read method arguments\n");
+      dbus_error_free (&err);
+      if (actions)
+	dbus_free_string_array (actions);
+      return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+  results = (dbus_int32_t *) malloc ((n ? n : 1) * sizeof (dbus_int32_t));
+  for (i = 0; i < n; i++)
+    results[i] = hid_parse_actions (actions[i]);
+  dbus_free_string_array (actions);
+
+  result = send_reply (connection, message,
+		       DBUS_TYPE_ARRAY, DBUS_TYPE_INT32, &results, n,
+		       DBUS_TYPE_INVALID);
+  free (results);
+  return result;
+}
+
+
+/*!
+ * \brief Emit a signal of the actions interface about a job.
+ */
+static void
+job_signal (const char *name, int first_type, ...)
+{
+  DBusMessage *signal;
+  va_list ap;
+  dbus_bool_t ok;
+
+  signal = dbus_message_new_signal (PCB_DBUS_OBJECT_PATH,
+				    PCB_DBUS_ACTIONS_INTERFACE, name);
+  if (signal == NULL)
+    {
+      fprintf (stderr, "pcb_dbus: Couldn't create signal message\n");
+      return;
+    }
+  va_start (ap, first_type);
+  ok = dbus_message_append_args_valist (signal, first_type, ap);
+  va_end (ap);
+  if (!ok || !dbus_connection_send (pcb_dbus_conn, signal, NULL))
+    fprintf (stderr, "pcb_dbus: Couldn't send signal, Out Of Memory!\n");
+  dbus_message_unref (signal);
+}
+
+static void
+free_job (dbus_job * job)
+{
+  dbus_free_string_array (job->actions);
+  free (job);
+}
+
+static void job_cb (hidval data);
+
+static void
+schedule_jobs (void)
+{
+  hidval x;
+
+  if (job_timer_set || jobs == NULL || !gui->add_timer)
+    return;
+  x.ptr = NULL;
+  job_timer = gui->add_timer (job_cb, 0, x);
+  job_timer_set = true;
+}
+
+/*!
+ * \brief Run the next action string of the first job.
+ *
+ * Only one string runs per call, so the main loop, and with it the
+ * D-Bus connection, gets to run again between them.  A JobProgress
+ * signal follows each string, and JobFinished the last one.
+ */
+static void
+job_cb (hidval data)
+{
+  dbus_job *job = jobs;
+  dbus_uint32_t done, total;
+
+  job_timer_set = false;
+  if (job == NULL)
+    return;
+
+  /* the board belongs to a background job until it ends */
+  if (pcb_job_busy ())
+    {
+      job_timer = gui->add_timer (job_cb, 100, data);
+      job_timer_set = true;
+      return;
+    }
+
+  if (job->done < job->n_actions)
+    {
+      if (hid_parse_actions (job->actions[job->done]))
+	job->result = 1;
+      job->done++;
+      done = job->done;
+      total = job->n_actions;
+      job_signal ("JobProgress", DBUS_TYPE_UINT32, &job->id,
+		  DBUS_TYPE_UINT32, &done, DBUS_TYPE_UINT32, &total,
+		  DBUS_TYPE_INVALID);
+    }
+  if (job->done == job->n_actions)
+    {
+      jobs = job->next;
+      job_signal ("JobFinished", DBUS_TYPE_UINT32, &job->id,
+		  DBUS_TYPE_INT32, &job->result, DBUS_TYPE_INVALID);
+      free_job (job);
+    }
+  schedule_jobs ();
+}
+
+
+/*!
+ * \brief Queue a list of action strings to run from the main loop, and
+ * reply at once with the id of the job.
+ *
+ * The jobs run one after another, in the order they were started.
+ */
+static DBusHandlerResult
+handle_start_job (DBusConnection * connection, DBusMessage * message,
+		  void *data)
+{
+  DBusError err;
+  dbus_job *job, **tail;
+  char **actions;
+  int n;
+
+  dbus_error_init (&err);
+  actions = NULL;
+  if (!dbus_message_get_args (message,
+			      &err,
+			      DBUS_TYPE_ARRAY, DBUS_TYPE_STRING, &actions, &n,
+			      DBUS_TYPE_INVALID))
+    {
+      fprintf (stderr, "Failed to read method arguments\n");
+      dbus_error_free (&err);
+      if (actions)
+	dbus_free_string_array (actions);
+      return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+  job = (dbus_job *) calloc (1, sizeof (dbus_job));
+  job->id = ++last_job_id;
+  job->actions = actions;
+  job->n_actions = n;
+  for (tail = &jobs; *tail; tail = &(*tail)->next)
+    ;
+  *tail = job;
+  schedule_jobs ();
+
+  return send_reply (connection, message, DBUS_TYPE_UINT32, &job->id,
+		     DBUS_TYPE_INVALID);
+}
+
+
+/*!
+ * \brief Drop the action strings of a job that haven't run yet.
+ *
+ * The job finishes with a result of -1, unless it had already finished.
+ * The reply is whether the job was found.
+ */
+static DBusHandlerResult
+handle_cancel_job (DBusConnection * connection, DBusMessage * message,
+		   void *data)
+{
+  DBusError err;
+  dbus_uint32_t id;
+  dbus_bool_t found = FALSE;
+  dbus_job *job;
+
+  dbus_error_init (&err);
+  if (!dbus_message_get_args (message, &err, DBUS_TYPE_UINT32, &id,
+			      DBUS_TYPE_INVALID))
+    {
+      fprintf (stderr, "Failed to read method arguments\n");
+      dbus_error_free (&err);
+      return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+    }
+
+  for (job = jobs; job; job = job->next)
+    if (job->id == id)
+      {
+	/* job_cb() finishes it */
+	job->n_actions = job->done;
+	job->result = -1;
+	found = TRUE;
+	break;
+      }
+
+  return send_reply (connection, message, DBUS_TYPE_BOOLEAN, &found,
+		     DBUS_TYPE_INVALID);
+}
+
+
 static DBusHandlerResult
 handle_introspect (DBusConnection * connection, DBusMessage * message,
 		   void *data)
@@ -273,6 +557,18 @@ handle_dbus_message (DBusConnection * connection, DBusMessage * message,
 	      {
 		return handle_exec_action (connection, message, data);
 	      }
+	    if (strcmp (method_name, "ExecActions") == 0)
+	      {
+		return handle_exec_actions (connection, message, data);
+	      }
+	    if (strcmp (method_name, "StartJob") == 0)
+	      {
+		return handle_start_job (connection, message, data);
+	      }
+	    if (strcmp (method_name, "CancelJob") == 0)
+	      {
+		return handle_cancel_job (connection, message, data);
+	      }
 	    fprintf (stderr, "pcb_dbus: Interface '%s' has no method '%s'\n",
 		     interface_name, method_name);
 	    break;
@@ -395,6 +691,17 @@ pcb_dbus_finish (void)
 
   // TODO: Could emit a "goodbye" signal here?
 
+  if (job_timer_set && gui->stop_timer)
+    gui->stop_timer (job_timer);
+  job_timer_set = false;
+  while (jobs)
+    {
+      dbus_job *job = jobs;
+
+      jobs = job->next;
+      free_job (job);
+    }
+
   dbus_connection_flush (pcb_dbus_conn);
 
   dbus_connection_unregister_object_path (pcb_dbus_conn,
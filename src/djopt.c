@@ -48,6 +48,7 @@
 #include "undo.h"
 #include "strflags.h"
 #include "find.h"
+#include "job.h"
 #include "pcb-printf.h"
 
 #ifdef HAVE_LIBDMALLOC
@@ -87,6 +88,10 @@ typedef struct corner_s
 {
   int layer;
   struct corner_s *next;
+  struct corner_s *prev;
+  struct corner_s *hash_next; /*!< Next corner in the same hash bucket. */
+  unsigned long seq; /*!< Creation order, the corners list is newest first. */
+  int round; /*!< djopt_round of the last change here or next door. */
   int x, y;
   int net;
   PinType *via;
@@ -117,6 +122,21 @@ typedef struct rect_s
 static corner_s *corners, *next_corner = 0;
 static line_s *lines;
 
+/* The corners are hashed by location, so that finding the corner at a
+   line end doesn't walk the list of all of them.  */
+static corner_s **corner_hash = 0;
+static unsigned int corner_hash_size = 0, corner_hash_count = 0;
+static unsigned long corner_seq = 0;
+
+/* Every change stamps the corners it touches, and those at the other
+   ends of their lines, with the current round.  The passes skip the
+   corners, and the lines between corners, that haven't changed since
+   djopt_from_round, so that repeating a pass only looks again at what
+   the previous one changed.  */
+static int djopt_round = 0, djopt_from_round = 0;
+#define UNCHANGED(c) ((c)->round < djopt_from_round)
+#define LINE_UNCHANGED(l) (UNCHANGED ((l)->s) && UNCHANGED ((l)->e))
+
 static int layer_groupings[MAX_LAYER];
 static char layer_type[MAX_LAYER];
 #define LT_TOP 1
@@ -465,42 +485,108 @@ other_corner (line_s * l, corner_s * c)
   return NULL;
 }
 
+static unsigned int
+corner_hash_index (int x, int y)
+{
+  unsigned int h = (unsigned int) x * 2654435761u ^ (unsigned int) y * 40503u;
+  return (h ^ (h >> 15)) & (corner_hash_size - 1);
+}
+
+static void
+hash_corner (corner_s * c)
+{
+  unsigned int i;
+
+  if (corner_hash_count >= corner_hash_size)
+    {
+      corner_s **old = corner_hash, *c2, *n;
+      unsigned int old_size = corner_hash_size;
+
+      corner_hash_size = old_size ? old_size * 2 : 1024;
+      corner_hash = (corner_s **) calloc (corner_hash_size, sizeof (corner_s *));
+      for (i = 0; i < old_size; i++)
+	for (c2 = old[i]; c2; c2 = n)
+	  {
+	    unsigned int j = corner_hash_index (c2->x, c2->y);
+	    n = c2->hash_next;
+	    c2->hash_next = corner_hash[j];
+	    corner_hash[j] = c2;
+	  }
+      free (old);
+    }
+  i = corner_hash_index (c->x, c->y);
+  c->hash_next = corner_hash[i];
+  corner_hash[i] = c;
+  corner_hash_count++;
+}
+
+static void
+unhash_corner (corner_s * c)
+{
+  corner_s **p;
+
+  for (p = &corner_hash[corner_hash_index (c->x, c->y)]; *p;
+       p = &(*p)->hash_next)
+    if (*p == c)
+      {
+	*p = c->hash_next;
+	corner_hash_count--;
+	return;
+      }
+  dj_abort ("unhash_corner: corner not in hash\n");
+}
+
+static void
+clear_corner_hash ()
+{
+  free (corner_hash);
+  corner_hash = 0;
+  corner_hash_size = corner_hash_count = 0;
+}
+
+/*!
+ * \brief Find the corner at x,y on a layer intersecting l.
+ *
+ * Of several, the newest wins, as it comes first in the corners list.
+ */
 static corner_s *
 find_corner_if (int x, int y, int l)
 {
-  corner_s *c;
-  for (c = corners; c; c = c->next)
+  corner_s *c, *best = 0;
+
+  if (corner_hash_size == 0)
+    return 0;
+  for (c = corner_hash[corner_hash_index (x, y)]; c; c = c->hash_next)
     {
-      if (DELETED (c))
-	continue;
       if (c->x != x || c->y != y)
 	continue;
       if (!(c->layer == -1 || intersecting_layers (c->layer, l)))
 	continue;
-      return c;
+      if (!best || c->seq > best->seq)
+	best = c;
     }
-  return 0;
+  return best;
 }
 
 static corner_s *
 find_corner (int x, int y, int l)
 {
   corner_s *c;
-  for (c = corners; c; c = c->next)
-    {
-      if (DELETED (c))
-	continue;
-      if (c->x != x || c->y != y)
-	continue;
-      if (!(c->layer == -1 || intersecting_layers (c->layer, l)))
-	continue;
-      return c;
-    }
+
+  c = find_corner_if (x, y, l);
+  if (c)
+    return c;
   c = (corner_s *) malloc (sizeof (corner_s));
   c->next = corners;
+  c->prev = 0;
+  if (corners)
+    corners->prev = c;
   corners = c;
+  c->seq = corner_seq++;
+  c->round = djopt_round;
   c->x = x;
   c->y = y;
+  hash_corner (c);
   c->net = 0;
   c->via = 0;
   c->pad = 0;
@@ -511,6 +597,24 @@ find_corner (int x, int y, int l)
   return c;
 }
 
+static void plan_note (corner_s * c);
+
+static void
+touch_corner (corner_s * c)
+{
+  int i;
+
+  c->round = djopt_round;
+  plan_note (c);
+  for (i = 0; i < c->n_lines; i++)
+    {
+      c->lines[i]->s->round = djopt_round;
+      c->lines[i]->e->round = djopt_round;
+      plan_note (c->lines[i]->s);
+      plan_note (c->lines[i]->e);
+    }
+}
+
 static void
 add_line_to_corner (line_s * l, corner_s * c)
 {
@@ -519,6 +623,7 @@ add_line_to_corner (line_s * l, corner_s * c)
   c->lines = (line_s **) realloc (c->lines, n * sizeof (line_s *));
   c->lines[c->n_lines] = l;
   c->n_lines++;
+  touch_corner (c);
   dprintf ("add_line_to_corner %#mD\n", c->x, c->y);
 }
 
@@ -752,6 +857,238 @@ add_corner_to_rect_if (rect_s * rect, corner_s * c, rect_s * e)
   add_point_to_rect (rect, c->x, c->y, diam);
 }
 
+/* ---------------------------------------------------------------------------
+ * Clearance scans, planned in parallel.
+ *
+ * For each candidate, debumpify() and unjaggy_once() look for the
+ * corners of other nets in the area the change would sweep, which is a
+ * scan of all the corners.  On a large board these scans are made up
+ * front, for all the candidates of a pass at once, by a thread pool:
+ * nothing changes while they run, and each only reads the corners.  The
+ * changes are then made one at a time, as before.  touch_corner() logs
+ * every corner a change touches, and a planned result is only used if
+ * the candidate still sweeps the same area and no corner of another net
+ * in the log comes near it; else the scan is made again.
+ */
+#define PLAN_MIN_CORNERS 2000	/*!< Smaller boards are scanned as they go. */
+#define PLAN_MIN_JOBS 32
+#define PLAN_LOG_MAX 4096	/*!< Plan again when the log grows this long. */
+
+typedef struct
+{
+  int x, y, radius, layer, net;
+} plan_log_s;
+
+typedef struct
+{
+  GMutex lock;
+  GCond done;
+  int pending;
+} plan_wave_s;
+
+typedef struct
+{
+  plan_wave_s *wave;
+  rect_s rr;
+  int net, layer;
+  rect_s rp; /*!< The other nets' corners in rr. */
+  int used;
+} plan_job_s;
+
+static GThreadPool *plan_pool = NULL;
+static plan_job_s *plan_jobs = 0;
+static int plan_n = 0, plan_max = 0;
+/* which job is a candidate's, by the corner or line */
+static GHashTable *plans = NULL;
+static plan_log_s *plan_log = 0;
+static int plan_log_n = 0, plan_log_max = 0;
+static int planning = 0;
+
+static void
+other_nets_scan (rect_s * rp, rect_s * rr, int net, int layer)
+{
+  corner_s *c;
+
+  empty_rect (rp);
+  for (c = corners; c; c = c->next)
+    {
+      if (DELETED (c))
+	continue;
+      if (c->net != net && intersecting_layers (c->layer, layer))
+	add_corner_to_rect_if (rp, c, rr);
+    }
+}
+
+static void
+plan_worker (gpointer data, gpointer user_data)
+{
+  plan_job_s *job = (plan_job_s *) data;
+  plan_wave_s *wave = job->wave;
+
+  other_nets_scan (&job->rp, &job->rr, job->net, job->layer);
+
+  g_mutex_lock (&wave->lock);
+  if (--wave->pending == 0)
+    g_cond_signal (&wave->done);
+  g_mutex_unlock (&wave->lock);
+}
+
+/*!
+ * \brief Scan for the jobs not used yet, and start a new log.
+ */
+static void
+plan_run ()
+{
+  plan_wave_s wave;
+  int i;
+
+  wave.pending = 1;
+  g_mutex_init (&wave.lock);
+  g_cond_init (&wave.done);
+  for (i = 0; i < plan_n; i++)
+    if (!plan_jobs[i].used)
+      {
+	plan_jobs[i].wave = &wave;
+	g_mutex_lock (&wave.lock);
+	wave.pending++;
+	g_mutex_unlock (&wave.lock);
+	g_thread_pool_push (plan_pool, &plan_jobs[i], NULL);
+      }
+
+  g_mutex_lock (&wave.lock);
+  wave.pending--;
+  while (wave.pending > 0)
+    g_cond_wait (&wave.done, &wave.lock);
+  g_mutex_unlock (&wave.lock);
+  g_mutex_clear (&wave.lock);
+  g_cond_clear (&wave.done);
+  plan_log_n = 0;
+}
+
+/*!
+ * \brief Whether this board is worth planning the scans of a pass for.
+ */
+static int
+plan_begin ()
+{
+  if (corner_hash_count < PLAN_MIN_CORNERS)
+    return 0;
+  if (plan_pool == NULL)
+    {
+      if (g_get_num_processors () < 2)
+	return 0;
+      plan_pool = g_thread_pool_new (plan_worker, NULL,
+				     g_get_num_processors (), TRUE, NULL);
+    }
+  plan_n = 0;
+  return 1;
+}
+
+static void
+plan_add (void *key, rect_s * rr, int net, int layer)
+{
+  if (plan_n == plan_max)
+    {
+      plan_max = plan_max ? plan_max * 2 : 256;
+      plan_jobs = (plan_job_s *) realloc (plan_jobs,
+					  plan_max * sizeof (plan_job_s));
+    }
+  plan_jobs[plan_n].rr = *rr;
+  plan_jobs[plan_n].net = net;
+  plan_jobs[plan_n].layer = layer;
+  plan_jobs[plan_n].used = 0;
+  if (plans == NULL)
+    plans = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_hash_table_insert (plans, key, GINT_TO_POINTER (plan_n + 1));
+  plan_n++;
+}
+
+static void
+plan_start ()
+{
+  if (plan_n < PLAN_MIN_JOBS)
+    {
+      g_hash_table_remove_all (plans);
+      plan_n = 0;
+      return;
+    }
+  plan_run ();
+  planning = 1;
+}
+
+static void
+plan_end ()
+{
+  if (plans)
+    g_hash_table_remove_all (plans);
+  plan_n = 0;
+  plan_log_n = 0;
+  planning = 0;
+}
+
+/*!
+ * \brief Log a corner a change touched, while a plan is in use.
+ */
+static void
+plan_note (corner_s * c)
+{
+  if (!planning)
+    return;
+  if (plan_log_n == plan_log_max)
+    {
+      plan_log_max = plan_log_max ? plan_log_max * 2 : 256;
+      plan_log = (plan_log_s *) realloc (plan_log,
+					 plan_log_max * sizeof (plan_log_s));
+    }
+  plan_log[plan_log_n].x = c->x;
+  plan_log[plan_log_n].y = c->y;
+  plan_log[plan_log_n].radius = corner_radius (c);
+  plan_log[plan_log_n].layer = c->layer;
+  plan_log[plan_log_n].net = c->net;
+  plan_log_n++;
+}
+
+/*!
+ * \brief Find the corners of other nets than net, on layers intersecting
+ * layer, in rr.
+ *
+ * key is the candidate, the corner or line, as given to plan_add().
+ */
+static void
+other_nets_in_rect (void *key, rect_s * rp, rect_s * rr, int net, int layer)
+{
+  plan_job_s *job = 0;
+  int i;
+
+  if (planning && plan_log_n > PLAN_LOG_MAX)
+    plan_run ();
+  if (planning)
+    {
+      i = GPOINTER_TO_INT (g_hash_table_lookup (plans, key));
+      if (i)
+	job = &plan_jobs[i - 1];
+    }
+  if (job && !job->used && job->net == net && job->layer == layer
+      && !memcmp (&job->rr, rr, sizeof (rect_s)))
+    {
+      job->used = 1;
+      for (i = 0; i < plan_log_n; i++)
+	if (plan_log[i].net != net
+	    && intersecting_layers (plan_log[i].layer, layer)
+	    && pin_in_rect (rr, plan_log[i].x, plan_log[i].y,
+			    plan_log[i].radius))
+	  break;
+      if (i == plan_log_n)
+	{
+	  *rp = job->rp;
+	  return;
+	}
+    }
+  else if (job)
+    job->used = 1;
+  other_nets_scan (rp, rr, net, layer);
+}
+
 static void
 remove_line (line_s * l)
 {
@@ -763,6 +1100,8 @@ remove_line (line_s * l)
   if (l->line)
     RemoveLine (layer, l->line);
 
+  touch_corner (l->s);
+  touch_corner (l->e);
   DELETE (l);
 
   for (i = 0, j = 0; i < l->s->n_lines; i++)
@@ -787,29 +1126,32 @@ move_line_to_layer (line_s * l, int layer)
 
   MoveObjectToLayer (LINE_TYPE, ls, l->line, 0, ld, 0);
   l->layer = layer;
+  touch_corner (l->s);
+  touch_corner (l->e);
 }
 
 static void
 remove_via_at (corner_s * c)
 {
+  touch_corner (c);
   RemoveObject (VIA_TYPE, c->via, 0, 0);
   c->via = 0;
+  touch_corner (c);
 }
 
 static void
 remove_corner (corner_s * c2)
 {
-  corner_s *c;
+  if (DELETED (c2))
+    return;
   dprintf ("remove corner %s\n", corner_name (c2));
-  if (corners == c2)
+  if (c2->prev)
+    c2->prev->next = c2->next;
+  else
     corners = c2->next;
-  for (c = corners; c; c = c->next)
-    {
-      if (DELETED (c))
-	continue;
-      if (c->next == c2)
-	c->next = c2->next;
-    }
+  if (c2->next)
+    c2->next->prev = c2->prev;
+  unhash_corner (c2);
   if (next_corner == c2)
     next_corner = c2->next;
   free (c2->lines);
@@ -844,6 +1186,7 @@ merge_corners (corner_s * c1, corner_s * c2)
     c1->layer = -1;
 
   remove_corner (c2);
+  touch_corner (c1);
 }
 
 static void
@@ -858,8 +1201,11 @@ move_corner (corner_s * c, int x, int y)
     dj_abort ("move_corner: has pin or pad\n");
   dprintf ("move_corner %p from %#mD to %#mD\n", (void *) c, c->x, c->y, x, y);
   pad = find_corner_if (x, y, c->layer);
+  touch_corner (c);
+  unhash_corner (c);
   c->x = x;
   c->y = y;
+  hash_corner (c);
   via = c->via;
   if (via)
     {
@@ -907,7 +1253,9 @@ move_corner (corner_s * c, int x, int y)
 	    break;
 	  }
       }
-  gui->progress (0, 0, 0);
+  if (!DELETED (c))
+    touch_corner (c);
+  pcb_job_progress (0, 0, 0);
   check (c, 0);
 }
 
@@ -1230,7 +1578,7 @@ simple_optimizations ()
     {
       if (DELETED (c))
 	continue;
-      if (c->pad || c->pin)
+      if (c->pad || c->pin || UNCHANGED (c))
 	continue;
       rv += simple_optimize_corner (c);
     }
@@ -1649,7 +1997,7 @@ orthopull ()
     {
       if (DELETED (c))
 	continue;
-      if (c->pin || c->pad)
+      if (c->pin || c->pad || UNCHANGED (c))
 	{
 	  c = c->next;
 	  continue;
@@ -1677,68 +2025,90 @@ orthopull ()
 /*!
  * \brief Look for "U" shaped traces we can shorten (or eliminate).
  */
+/*!
+ * \brief Whether l is the bottom of a "U" debumpify() could move.
+ *
+ * \return the area the move would sweep in rr, and the ends of the arms
+ * of the "U" in c1 and c2.
+ */
+static int
+debumpify_area (line_s * l, int any_selected, rect_s * rr, int *o1,
+		corner_s ** c1, corner_s ** c2)
+{
+  line_s *l1, *l2;
+  int o, o2, w;
+
+  if (!l->line || LINE_UNCHANGED (l))
+    return 0;
+  if (any_selected && !selected (l->line))
+    return 0;
+  if (!any_selected && autorouted_only && !autorouted (l->line))
+    return 0;
+  if (l->s->pin || l->s->pad || l->e->pin || l->e->pad)
+    return 0;
+  o = line_orient (l, 0);
+  if (o == DIAGONAL)
+    return 0;
+  l1 = other_line (l->s, l);
+  if (!l1)
+    return 0;
+  *o1 = line_orient (l1, l->s);
+  l2 = other_line (l->e, l);
+  if (!l2)
+    return 0;
+  o2 = line_orient (l2, l->e);
+  if (ORIENT (o) == ORIENT (*o1) || *o1 != o2 || *o1 == DIAGONAL)
+    return 0;
+
+  w = l->line->Thickness / 2 + SB + 1;
+  empty_rect (rr);
+  add_line_to_rect (rr, l1);
+  add_line_to_rect (rr, l2);
+  if (rr->x1 != l->s->x && rr->x1 != l->e->x)
+    rr->x1 -= w;
+  if (rr->x2 != l->s->x && rr->x2 != l->e->x)
+    rr->x2 += w;
+  if (rr->y1 != l->s->y && rr->y1 != l->e->y)
+    rr->y1 -= w;
+  if (rr->y2 != l->s->y && rr->y2 != l->e->y)
+    rr->y2 += w;
+
+  *c1 = other_corner (l1, l->s);
+  *c2 = other_corner (l2, l->e);
+  return 1;
+}
+
 static int
 debumpify ()
 {
   int rv = 0;
   int any_selected = any_line_selected ();
-  line_s *l, *l1, *l2;
-  corner_s *c, *c1, *c2;
+  line_s *l;
+  corner_s *c1, *c2;
   rect_s rr, rp;
-  int o, o1, o2, step, w;
+  int o1, step, w;
+
+  if (plan_begin ())
+    {
+      for (l = lines; l; l = l->next)
+	if (!DELETED (l)
+	    && debumpify_area (l, any_selected, &rr, &o1, &c1, &c2))
+	  plan_add (l, &rr, l->s->net, l->s->layer);
+      plan_start ();
+    }
+
   for (l = lines; l; l = l->next)
     {
       if (DELETED (l))
 	continue;
-      if (!l->line)
-	continue;
-      if (any_selected && !selected (l->line))
-	continue;
-      if (!any_selected && autorouted_only && !autorouted (l->line))
-	continue;
-      if (l->s->pin || l->s->pad || l->e->pin || l->e->pad)
-	continue;
-      o = line_orient (l, 0);
-      if (o == DIAGONAL)
-	continue;
-      l1 = other_line (l->s, l);
-      if (!l1)
-	continue;
-      o1 = line_orient (l1, l->s);
-      l2 = other_line (l->e, l);
-      if (!l2)
-	continue;
-      o2 = line_orient (l2, l->e);
-      if (ORIENT (o) == ORIENT (o1) || o1 != o2 || o1 == DIAGONAL)
+      if (!debumpify_area (l, any_selected, &rr, &o1, &c1, &c2))
 	continue;
 
       dprintf ("\nline: %#mD to %#mD\n", l->s->x, l->s->y, l->e->x, l->e->y);
-      w = l->line->Thickness / 2 + SB + 1;
-      empty_rect (&rr);
-      add_line_to_rect (&rr, l1);
-      add_line_to_rect (&rr, l2);
-      if (rr.x1 != l->s->x && rr.x1 != l->e->x)
-	rr.x1 -= w;
-      if (rr.x2 != l->s->x && rr.x2 != l->e->x)
-	rr.x2 += w;
-      if (rr.y1 != l->s->y && rr.y1 != l->e->y)
-	rr.y1 -= w;
-      if (rr.y2 != l->s->y && rr.y2 != l->e->y)
-	rr.y2 += w;
       dprintf ("range: x %#mS..%#mS y %#mS..%#mS\n", rr.x1, rr.x2, rr.y1, rr.y2);
+      w = l->line->Thickness / 2 + SB + 1;
 
-      c1 = other_corner (l1, l->s);
-      c2 = other_corner (l2, l->e);
-
-      empty_rect (&rp);
-      for (c = corners; c; c = c->next)
-	{
-	  if (DELETED (c))
-	    continue;
-	  if (c->net != l->s->net
-	      && intersecting_layers (c->layer, l->s->layer))
-	    add_corner_to_rect_if (&rp, c, &rr);
-	}
+      other_nets_in_rect (l, &rp, &rr, l->s->net, l->s->layer);
       if (rp.x1 == INT_MAX)
 	{
 	  rp.x1 = rr.x2;
@@ -1811,6 +2181,7 @@ debumpify ()
 	}
       check (0, l);
     }
+  plan_end ();
 
   rv += simple_optimizations ();
   if (rv)
@@ -1838,85 +2209,93 @@ simple_corner (corner_s * c)
 /*!
  * \brief Look for sequences of simple corners we can reduce.
  */
+/*!
+ * \brief Whether c is a jag unjaggy_once() could take out.
+ *
+ * \return the area the move would sweep in rr, and the corners at the
+ * other ends of the lines of c in c0 and c1.
+ */
+static int
+unjaggy_area (corner_s * c, int sel, rect_s * rr, corner_s ** c0,
+	      corner_s ** c1)
+{
+  int l, w;
+  int o0, o1, s0, s1;
+
+  if (UNCHANGED (c) || !simple_corner (c))
+    return 0;
+  if (!c->lines[0]->line || !c->lines[1]->line)
+    return 0;
+  if (sel && !(selected (c->lines[0]->line)
+	       || selected (c->lines[1]->line)))
+    return 0;
+  if (!sel && autorouted_only
+      && !(autorouted (c->lines[0]->line)
+	   || autorouted (c->lines[1]->line)))
+    return 0;
+
+  *c0 = other_corner (c->lines[0], c);
+  o0 = line_orient (c->lines[0], c);
+  s0 = simple_corner (*c0);
+
+  *c1 = other_corner (c->lines[1], c);
+  o1 = line_orient (c->lines[1], c);
+  s1 = simple_corner (*c1);
+
+  if (!s0 && !s1)
+    return 0;
+
+  for (l = 0; l < (*c0)->n_lines; l++)
+    if ((*c0)->lines[l] != c->lines[0]
+	&& (*c0)->lines[l]->layer == c->lines[0]->layer
+	&& line_orient ((*c0)->lines[l], *c0) == o1)
+      return 0;
+  for (l = 0; l < (*c1)->n_lines; l++)
+    if ((*c1)->lines[l] != c->lines[0]
+	&& (*c1)->lines[l]->layer == c->lines[0]->layer
+	&& line_orient ((*c1)->lines[l], *c1) == o0)
+      return 0;
+
+  w = c->lines[0]->line->Thickness / 2 + SB + 1;
+  empty_rect (rr);
+  add_line_to_rect (rr, c->lines[0]);
+  add_line_to_rect (rr, c->lines[1]);
+  if (c->x != rr->x1)
+    rr->x1 -= w;
+  else
+    rr->x2 += w;
+  if (c->y != rr->y1)
+    rr->y1 -= w;
+  else
+    rr->y2 += w;
+  return 1;
+}
+
 static int
 unjaggy_once ()
 {
   int rv = 0;
-  corner_s *c, *c0, *c1, *cc;
-  int l, w, sel = any_line_selected ();
-  int o0, o1, s0, s1;
+  corner_s *c, *c0, *c1;
+  int sel = any_line_selected ();
   rect_s rr, rp;
+
+  if (plan_begin ())
+    {
+      for (c = corners; c; c = c->next)
+	if (!DELETED (c) && unjaggy_area (c, sel, &rr, &c0, &c1))
+	  plan_add (c, &rr, c->net, c->layer);
+      plan_start ();
+    }
+
   for (c = corners; c; c = c->next)
     {
       if (DELETED (c))
 	continue;
-      if (!simple_corner (c))
-	continue;
-      if (!c->lines[0]->line || !c->lines[1]->line)
-	continue;
-      if (sel && !(selected (c->lines[0]->line)
-		   || selected (c->lines[1]->line)))
+      if (!unjaggy_area (c, sel, &rr, &c0, &c1))
 	continue;
-      if (!sel && autorouted_only
-	  && !(autorouted (c->lines[0]->line)
-	       || autorouted (c->lines[1]->line)))
-	continue;
-      dprintf ("simple at %#mD\n", c->x, c->y);
-
-      c0 = other_corner (c->lines[0], c);
-      o0 = line_orient (c->lines[0], c);
-      s0 = simple_corner (c0);
+      dprintf ("unjaggy candidate at %#mD\n", c->x, c->y);
 
-      c1 = other_corner (c->lines[1], c);
-      o1 = line_orient (c->lines[1], c);
-      s1 = simple_corner (c1);
-
-      if (!s0 && !s1)
-	continue;
-      dprintf ("simples at %#mD\n", c->x, c->y);
-
-      w = 1;
-      for (l = 0; l < c0->n_lines; l++)
-	if (c0->lines[l] != c->lines[0]
-	    && c0->lines[l]->layer == c->lines[0]->layer)
-	  {
-	    int o = line_orient (c0->lines[l], c0);
-	    if (o == o1)
-	      w = 0;
-	  }
-      for (l = 0; l < c1->n_lines; l++)
-	if (c1->lines[l] != c->lines[0]
-	    && c1->lines[l]->layer == c->lines[0]->layer)
-	  {
-	    int o = line_orient (c1->lines[l], c1);
-	    if (o == o0)
-	      w = 0;
-	  }
-      if (!w)
-	continue;
-      dprintf ("orient ok\n");
-
-      w = c->lines[0]->line->Thickness / 2 + SB + 1;
-      empty_rect (&rr);
-      add_line_to_rect (&rr, c->lines[0]);
-      add_line_to_rect (&rr, c->lines[1]);
-      if (c->x != rr.x1)
-	rr.x1 -= w;
-      else
-	rr.x2 += w;
-      if (c->y != rr.y1)
-	rr.y1 -= w;
-      else
-	rr.y2 += w;
-
-      empty_rect (&rp);
-      for (cc = corners; cc; cc = cc->next)
-	{
-	  if (DELETED (cc))
-	    continue;
-	  if (cc->net != c->net && intersecting_layers (cc->layer, c->layer))
-	    add_corner_to_rect_if (&rp, cc, &rr);
-	}
+      other_nets_in_rect (c, &rp, &rr, c->net, c->layer);
       dprintf ("rp x %#mS..%#mS  y %#mS..%#mS\n", rp.x1, rp.x2, rp.y1, rp.y2);
       if (rp.x1 <= rp.x2)	/* something triggered */
 	continue;
@@ -1929,6 +2308,7 @@ unjaggy_once ()
       rv++;
       check (c, 0);
     }
+  plan_end ();
   rv += simple_optimizations ();
   check (c, 0);
   return rv;
@@ -1937,14 +2317,19 @@ unjaggy_once ()
 static int
 unjaggy ()
 {
-  int i, r = 0, j;
+  int i, r = 0, j, start;
+  int from = djopt_from_round;
   for (i = 0; i < 100; i++)
     {
+      start = ++djopt_round;
       j = unjaggy_once ();
       if (j == 0)
 	break;
       r += j;
+      /* only what this one changed needs another look */
+      djopt_from_round = start;
     }
+  djopt_from_round = from;
   if (r)
     printf ("%d unjagg%s    \n", r, r == 1 ? "y" : "ies");
   return r;
@@ -1974,7 +2359,7 @@ vianudge ()
       if (DELETED (c))
 	continue;
 
-      if (!c->via)
+      if (!c->via || UNCHANGED (c))
 	continue;
 
       memset (directions, 0, sizeof (directions));
@@ -2095,6 +2480,8 @@ viatrim ()
 	continue;
       if (!l->e->via)
 	continue;
+      if (LINE_UNCHANGED (l))
+	continue;
       if (any_sel && !selected (l->line))
 	continue;
       if (!any_sel && autorouted_only && !autorouted (l->line))
@@ -2179,20 +2566,38 @@ viatrim ()
   return rv + vrm;
 }
 
+/*!
+ * \brief Run the passes until they find nothing more to do.
+ *
+ * After a round that changed something, the next only looks at the
+ * corners the changes touched.  Once such a round finds nothing, a round
+ * over the whole board makes sure a change didn't make room for one
+ * further away.
+ */
 static int
 automagic ()
 {
   int more = 1, oldmore = 0;
   int toomany = 100;
-  while (more != oldmore && --toomany)
+  int from = djopt_from_round, start = djopt_from_round, all = 1;
+  while (--toomany)
     {
       oldmore = more;
+      djopt_from_round = all ? from : start;
+      start = ++djopt_round;
       more += debumpify ();
       more += unjaggy ();
       more += orthopull ();
       more += vianudge ();
       more += viatrim ();
+      if (more != oldmore)
+	all = 0;
+      else if (all)
+	break;
+      else
+	all = 1;
     }
+  djopt_from_round = from;
   return more - 1;
 }
 
@@ -2994,17 +3399,20 @@ After miter:
 
 %end-doc */
 
+/*!
+ * \brief Run the optimization arg, as a job of ActionDJopt().
+ */
 static int
-ActionDJopt (int argc, char **argv, Coord x, Coord y)
+djopt_run (void *data)
 {
-  char *arg = argc > 0 ? argv[0] : 0;
+  char *arg = (char *) data;
   int layn, saved = 0;
   corner_s *c;
 
-  hid_action("Busy");
-
   lines = 0;
   corners = 0;
+  clear_corner_hash ();
+  djopt_round = djopt_from_round = 0;
 
   grok_layer_groups ();
 
@@ -3126,6 +3534,15 @@ ActionDJopt (int argc, char **argv, Coord x, Coord y)
   return 0;
 }
 
+static int
+ActionDJopt (int argc, char **argv, Coord x, Coord y)
+{
+  char *arg = argc > 0 ? argv[0] : 0;
+
+  hid_action("Busy");
+  return pcb_job_run (_("Optimizing traces"), djopt_run, arg);
+}
+
 HID_Action djopt_action_list[] = {
   {"djopt", 0, ActionDJopt,
    djopt_help, djopt_syntax}
@@ -45,11 +45,13 @@
 #include "error.h"
 #include "mymem.h"
 #include "misc.h"
+#include "polygon.h"
 #include "rotate.h"
 #include "rtree.h"
 #include "search.h"
 #include "select.h"
 #include "print.h"
+#include "profile.h"
 
 #ifdef HAVE_LIBDMALLOC
 #include <dmalloc.h>
@@ -73,6 +75,8 @@
  * some local identifiers
  */
 static BoxType Block = {MAXINT, MAXINT, -MAXINT, -MAXINT};
+static int defer_draw_depth = 0; /*!< Nesting depth of DeferDraw(). */
+static bool redraw_all = false;  /*!< Redraw() was called while deferred. */
 
 static int doing_pinout = 0;
 static bool doing_assy = false;
@@ -88,7 +92,170 @@ static void AddPart (void *);
 static void DrawEMark (ElementType *, Coord, Coord, bool);
 static void DrawRats (const BoxType *);
 
+/* ---------------------------------------------------------------------------
+ * Level of detail.  When a GUI draws a view zoomed out so far that
+ * objects are only a pixel or two across, an object smaller than
+ * LOD_DOT_PX pixels is drawn as a dot of one pixel instead, and only
+ * once for each pixel and colour of a drawing stage.  Text lower than
+ * LOD_TEXT_PX pixels is drawn as a box.  This bounds the drawing of a
+ * zoomed out view by its pixels rather than by the objects of the board.
+ */
+#define LOD_DOT_PX 2
+#define LOD_TEXT_PX 4
+#define LOD_BUNDLE_PX 4
+#define LOD_CELLS 65536			/* a power of two */
+#define LOD_BUNDLES 16384		/* a power of two */
+#define LOD_PROBES 8
+
+/* the size of a pixel, or 0 if all detail is drawn */
+static Coord lod_pixel = 0;
+/* the drawing stage, only the dots of which count */
+static unsigned int lod_stamp = 0;
+static struct lod_cell
+{
+  Coord x, y;
+  const char *color;
+  unsigned int stamp;
+} lod_cells[LOD_CELLS];
+static struct lod_bundle
+{
+  Coord x1, y1, x2, y2;
+  const char *color;
+  unsigned int stamp;
+} lod_bundles[LOD_BUNDLES];
+
+/*!
+ * \brief Start a drawing stage, over which dots are drawn again.
+ */
 static void
+lod_begin (void)
+{
+  lod_stamp++;
+}
+
+static bool
+lod_small (const BoxType *box, int pixels)
+{
+  return (lod_pixel > 0 &&
+	  box->X2 - box->X1 < pixels * lod_pixel &&
+	  box->Y2 - box->Y1 < pixels * lod_pixel);
+}
+
+/*!
+ * \brief Draw an object as a dot if it is small enough, in the colour it
+ * was set to.
+ *
+ * \return true if the object is done with.
+ */
+static bool
+lod_dot (const BoxType *box, const char *color)
+{
+  struct lod_cell *cell;
+  Coord x, y;
+  unsigned int hash;
+  int i;
+
+  if (!lod_small (box, LOD_DOT_PX))
+    return false;
+
+  x = (box->X1 / 2 + box->X2 / 2) / lod_pixel;
+  y = (box->Y1 / 2 + box->Y2 / 2) / lod_pixel;
+  hash = ((unsigned int) x * 73856093u) ^ ((unsigned int) y * 19349663u) ^
+    ((unsigned int) (size_t) color * 83492791u);
+  for (i = 0; i < LOD_PROBES; i++)
+    {
+      cell = &lod_cells[(hash + i) & (LOD_CELLS - 1)];
+      if (cell->stamp != lod_stamp)
+	{
+	  cell->x = x;
+	  cell->y = y;
+	  cell->color = color;
+	  cell->stamp = lod_stamp;
+	  break;
+	}
+      if (cell->x == x && cell->y == y && cell->color == color)
+	return true;
+    }
+  /* when the cells to look in are all taken, the dot is drawn anyway */
+  gui->graphics->fill_rect (Output.fgGC, x * lod_pixel, y * lod_pixel,
+			    (x + 1) * lod_pixel, (y + 1) * lod_pixel);
+  return true;
+}
+
+/*!
+ * \brief Tell if a line repeats one drawn before in the drawing stage.
+ *
+ * Lines whose ends fall in the same two cells of LOD_BUNDLE_PX pixels,
+ * in the same colour, are drawn as one.  A zoomed out view of thousands
+ * of rats between two groups of parts then draws one bundle of them.
+ *
+ * \return true if the line need not be drawn.
+ */
+static bool
+lod_bundle (Coord x1, Coord y1, Coord x2, Coord y2, const char *color)
+{
+  struct lod_bundle *cell;
+  Coord cell_size = LOD_BUNDLE_PX * lod_pixel, t;
+  unsigned int hash;
+  int i;
+
+  if (lod_pixel <= 0)
+    return false;
+
+  x1 /= cell_size, y1 /= cell_size;
+  x2 /= cell_size, y2 /= cell_size;
+  /* the same bundle whichever way round its lines go */
+  if (x1 > x2 || (x1 == x2 && y1 > y2))
+    {
+      t = x1, x1 = x2, x2 = t;
+      t = y1, y1 = y2, y2 = t;
+    }
+  hash = ((unsigned int) x1 * 73856093u) ^ ((unsigned int) y1 * 19349663u) ^
+    ((unsigned int) x2 * 83492791u) ^ ((unsigned int) y2 * 2654435761u) ^
+    ((unsigned int) (size_t) color * 40503u);
+  for (i = 0; i < LOD_PROBES; i++)
+    {
+      cell = &lod_bundles[(hash + i) & (LOD_BUNDLES - 1)];
+      if (cell->stamp != lod_stamp)
+	{
+	  cell->x1 = x1;
+	  cell->y1 = y1;
+	  cell->x2 = x2;
+	  cell->y2 = y2;
+	  cell->color = color;
+	  cell->stamp = lod_stamp;
+	  return false;
+	}
+      if (cell->x1 == x1 && cell->y1 == y1 && cell->x2 == x2 &&
+	  cell->y2 == y2 && cell->color == color)
+	return true;
+    }
+  return false;
+}
+
+/*!
+ * \brief Draw text as a box if it is low enough, in the colour it was set
+ * to.
+ *
+ * \return true if the text is done with.
+ */
+static bool
+lod_text (const BoxType *box, const char *color)
+{
+  if (lod_pixel <= 0 ||
+      MIN (box->X2 - box->X1, box->Y2 - box->Y1) >= LOD_TEXT_PX * lod_pixel)
+    return false;
+  if (!lod_dot (box, color))
+    gui->graphics->fill_rect (Output.fgGC, box->X1, box->Y1, box->X2, box->Y2);
+  return true;
+}
+
+/*!
+ * \brief Set the colour of an object from its flags.
+ *
+ * \return the colour set.
+ */
+static char *
 set_object_color (AnyObjectType *obj, char *warn_color, char *selected_color,
                   char *connected_color, char *found_color, char *normal_color)
 {
@@ -101,12 +268,13 @@ set_object_color (AnyObjectType *obj, char *warn_color, char *selected_color,
   else                                                                color = normal_color;
 
   gui->graphics->set_color (Output.fgGC, color);
+  return color;
 }
 
-static void
+static char *
 set_layer_object_color (LayerType *layer, AnyObjectType *obj)
 {
-  set_object_color (obj, NULL, layer->SelectedColor, PCB->ConnectedColor, PCB->FoundColor, layer->Color);
+  return set_object_color (obj, NULL, layer->SelectedColor, PCB->ConnectedColor, PCB->FoundColor, layer->Color);
 }
 
 /*!
@@ -129,7 +297,15 @@ AddPart (void *b)
 void
 Draw (void)
 {
-  if (Block.X1 <= Block.X2 && Block.Y1 <= Block.Y2)
+  if (defer_draw_depth > 0)
+    return;
+
+  if (redraw_all)
+    {
+      redraw_all = false;
+      gui->invalidate_all ();
+    }
+  else if (Block.X1 <= Block.X2 && Block.Y1 <= Block.Y2)
     gui->invalidate_lr (Block.X1, Block.X2, Block.Y1, Block.Y2);
 
   /* shrink the update block */
@@ -137,12 +313,44 @@ Draw (void)
   Block.X2 = Block.Y2 = -MAXINT;
 }
 
+/*!
+ * \brief Start a section in which Draw() only adds to the update region.
+ *
+ * Operations on many objects, such as undoing a large change, then have
+ * the union of what they changed redrawn once, at the matching
+ * ResumeDraw(), instead of one area for each object.  Calls nest.
+ */
+void
+DeferDraw (void)
+{
+  defer_draw_depth++;
+}
+
+/*!
+ * \brief End a DeferDraw() section, redrawing the update region once the
+ * outermost section ends.
+ */
+void
+ResumeDraw (void)
+{
+  assert (defer_draw_depth > 0);
+  if (--defer_draw_depth == 0)
+    Draw ();
+}
+
 /*!
  * \brief Redraws all the data by the event handlers.
+ *
+ * Inside a DeferDraw() section the redraw waits for ResumeDraw().
  */
 void
 Redraw (void)
 {
+  if (defer_draw_depth > 0)
+    {
+      redraw_all = true;
+      return;
+    }
   gui->invalidate_all ();
 }
 
@@ -153,6 +361,10 @@ _draw_pv_name (PinType *pv)
   bool vert;
   TextType text;
 
+  /* a name too low to read would only hide the pin under a box */
+  if (lod_pixel > 0 && pv->Thickness < LOD_TEXT_PX * lod_pixel)
+    return;
+
   if (!pv->Name || !pv->Name[0])
     text.TextString = EMPTY (pv->Number);
   else
@@ -222,12 +434,19 @@ _draw_pv (PinType *pv, bool draw_hole)
 static void
 draw_pin (PinType *pin, bool draw_hole)
 {
+  char *color;
+
   if (doing_pinout)
     gui->graphics->set_color (Output.fgGC, PCB->PinColor);
   else
-    set_object_color ((AnyObjectType *)pin,
-                      PCB->WarnColor, PCB->PinSelectedColor,
-                      PCB->ConnectedColor, PCB->FoundColor, PCB->PinColor);
+    {
+      color = set_object_color ((AnyObjectType *)pin,
+                                PCB->WarnColor, PCB->PinSelectedColor,
+                                PCB->ConnectedColor, PCB->FoundColor,
+                                PCB->PinColor);
+      if (lod_dot (&pin->BoundingBox, color))
+        return;
+    }
 
   _draw_pv (pin, draw_hole);
 }
@@ -242,12 +461,19 @@ pin_callback (const BoxType * b, void *cl)
 static void
 draw_via (PinType *via, bool draw_hole)
 {
+  char *color;
+
   if (doing_pinout)
     gui->graphics->set_color (Output.fgGC, PCB->ViaColor);
   else
-    set_object_color ((AnyObjectType *)via,
-                      PCB->WarnColor, PCB->ViaSelectedColor,
-                      PCB->ConnectedColor, PCB->FoundColor, PCB->ViaColor);
+    {
+      color = set_object_color ((AnyObjectType *)via,
+                                PCB->WarnColor, PCB->ViaSelectedColor,
+                                PCB->ConnectedColor, PCB->FoundColor,
+                                PCB->ViaColor);
+      if (lod_dot (&via->BoundingBox, color))
+        return;
+    }
 
   _draw_pv (via, draw_hole);
 }
@@ -279,6 +505,10 @@ draw_pad_name (PadType *pad)
   bool vert;
   TextType text;
 
+  /* a name too low to read would only hide the pad under a box */
+  if (lod_pixel > 0 && pad->Thickness < LOD_TEXT_PX * lod_pixel)
+    return;
+
   if (!pad->Name || !pad->Name[0])
     text.TextString = EMPTY (pad->Number);
   else
@@ -330,12 +560,20 @@ _draw_pad (hidGC gc, PadType *pad, bool clear, bool mask)
 static void
 draw_pad (PadType *pad)
 {
+  char *color;
+
   if (doing_pinout)
     gui->graphics->set_color (Output.fgGC, PCB->PinColor);
   else
-    set_object_color ((AnyObjectType *)pad, PCB->WarnColor,
-                      PCB->PinSelectedColor, PCB->ConnectedColor, PCB->FoundColor,
-                      FRONT (pad) ? PCB->PinColor : PCB->InvisibleObjectsColor);
+    {
+      color = set_object_color ((AnyObjectType *)pad, PCB->WarnColor,
+                                PCB->PinSelectedColor, PCB->ConnectedColor,
+                                PCB->FoundColor,
+                                FRONT (pad) ? PCB->PinColor
+                                            : PCB->InvisibleObjectsColor);
+      if (lod_dot (&pad->BoundingBox, color))
+        return;
+    }
 
   _draw_pad (Output.fgGC, pad, false, false);
 
@@ -357,17 +595,22 @@ pad_callback (const BoxType * b, void *cl)
 static void
 draw_element_name (ElementType *element)
 {
+  char *color;
+
   if ((TEST_FLAG (HIDENAMESFLAG, PCB) && gui->gui) ||
       TEST_FLAG (HIDENAMEFLAG, element))
     return;
   if (doing_pinout || doing_assy)
-    gui->graphics->set_color (Output.fgGC, PCB->ElementColor);
+    color = PCB->ElementColor;
   else if (TEST_FLAG (SELECTEDFLAG, &ELEMENT_TEXT (PCB, element)))
-    gui->graphics->set_color (Output.fgGC, PCB->ElementSelectedColor);
+    color = PCB->ElementSelectedColor;
   else if (FRONT (element))
-    gui->graphics->set_color (Output.fgGC, PCB->ElementColor);
+    color = PCB->ElementColor;
   else
-    gui->graphics->set_color (Output.fgGC, PCB->InvisibleObjectsColor);
+    color = PCB->InvisibleObjectsColor;
+  gui->graphics->set_color (Output.fgGC, color);
+  if (lod_text (&ELEMENT_TEXT (PCB, element).BoundingBox, color))
+    return;
   gui->graphics->draw_pcb_text (Output.fgGC, &ELEMENT_TEXT (PCB, element), PCB->minSlk);
 }
 
@@ -449,6 +692,10 @@ hole_callback (const BoxType * b, void *cl)
     }
 
 via_ok:
+  /* a pin or via drawn as a dot has no hole to show */
+  if (lod_small (&pv->BoundingBox, LOD_DOT_PX))
+    return 1;
+
   if ((hi->plated == 0 && !TEST_FLAG (HOLEFLAG, pv)) ||
       (hi->plated == 1 &&  TEST_FLAG (HOLEFLAG, pv)))
     return 1;
@@ -513,38 +760,72 @@ line_callback (const BoxType * b, void *cl)
 {
   LayerType *layer = (LayerType *) cl;
   LineType *line = (LineType *) b;
+  char *color;
 
-  set_layer_object_color (layer, (AnyObjectType *) line);
-  gui->graphics->draw_pcb_line (Output.fgGC, line);
+  color = set_layer_object_color (layer, (AnyObjectType *) line);
+  if (!lod_dot (b, color))
+    gui->graphics->draw_pcb_line (Output.fgGC, line);
 
   return 1;
 }
 
+/*!
+ * \brief The rats of a view by the colour they are drawn in: normal,
+ * selected, connected and found.
+ */
+#define RAT_COLORS 4
+static GPtrArray *rat_batch[RAT_COLORS];
+
 static int
 rat_callback (const BoxType * b, void *cl)
 {
   RatType *rat = (RatType *)b;
+  int i;
+
+  /* the precedence of set_object_color() */
+  if      (TEST_FLAG (SELECTEDFLAG,  rat)) i = 1;
+  else if (TEST_FLAG (CONNECTEDFLAG, rat)) i = 2;
+  else if (TEST_FLAG (FOUNDFLAG,     rat)) i = 3;
+  else                                     i = 0;
+  g_ptr_array_add (rat_batch[i], rat);
+  return 1;
+}
 
-  set_object_color ((AnyObjectType *) rat, NULL, PCB->RatSelectedColor,
-                    PCB->ConnectedColor, PCB->FoundColor, PCB->RatColor);
+/*!
+ * \brief Draw the rats of one colour, after setting the colour, cap and
+ * width only once for all of them.
+ */
+static void
+draw_rat_batch (GPtrArray *rats, char *color)
+{
+  Coord width = -1, w;
+  RatType *rat;
+  guint i;
 
-  if (Settings.RatThickness < 100)
-    rat->Thickness = pixel_slop * Settings.RatThickness;
-  /* rats.c set VIAFLAG if this rat goes to a containing poly: draw a donut */
-  if (TEST_FLAG(VIAFLAG, rat))
+  if (rats->len == 0)
+    return;
+  gui->graphics->set_color (Output.fgGC, color);
+  gui->graphics->set_line_cap (Output.fgGC, Trace_Cap);
+  for (i = 0; i < rats->len; i++)
     {
-      int w = rat->Thickness;
-
-      if (TEST_FLAG (THINDRAWFLAG, PCB))
-        gui->graphics->set_line_width (Output.fgGC, 0);
-      else
-        gui->graphics->set_line_width (Output.fgGC, w);
-      gui->graphics->draw_arc (Output.fgGC, rat->Point1.X, rat->Point1.Y,
-                               w * 2, w * 2, 0, 360);
+      rat = (RatType *) g_ptr_array_index (rats, i);
+      if (Settings.RatThickness < 100)
+        rat->Thickness = pixel_slop * Settings.RatThickness;
+      w = TEST_FLAG (THINDRAWFLAG, PCB) ? 0 : rat->Thickness;
+      if (w != width)
+        gui->graphics->set_line_width (Output.fgGC, width = w);
+      /* rats.c set VIAFLAG if this rat goes to a containing poly: draw a donut */
+      if (TEST_FLAG(VIAFLAG, rat))
+        gui->graphics->draw_arc (Output.fgGC, rat->Point1.X, rat->Point1.Y,
+                                 rat->Thickness * 2, rat->Thickness * 2,
+                                 0, 360);
+      else if (!lod_dot (&rat->BoundingBox, color) &&
+               !lod_bundle (rat->Point1.X, rat->Point1.Y,
+                            rat->Point2.X, rat->Point2.Y, color))
+        gui->graphics->draw_line (Output.fgGC,
+                                  rat->Point1.X, rat->Point1.Y,
+                                  rat->Point2.X, rat->Point2.Y);
     }
-  else
-    gui->graphics->draw_pcb_line (Output.fgGC, (LineType *) rat);
-  return 1;
 }
 
 static int
@@ -552,9 +833,11 @@ arc_callback (const BoxType * b, void *cl)
 {
   LayerType *layer = (LayerType *) cl;
   ArcType *arc =  (ArcType *) b;
+  char *color;
 
-  set_layer_object_color (layer, (AnyObjectType *) arc);
-  gui->graphics->draw_pcb_arc (Output.fgGC, arc);
+  color = set_layer_object_color (layer, (AnyObjectType *) arc);
+  if (!lod_dot (b, color))
+    gui->graphics->draw_pcb_arc (Output.fgGC, arc);
 
   return 1;
 }
@@ -562,15 +845,20 @@ arc_callback (const BoxType * b, void *cl)
 static void
 draw_element_package (ElementType *element)
 {
+  char *color;
+
   /* set color and draw lines, arcs, text and pins */
   if (doing_pinout || doing_assy)
-    gui->graphics->set_color (Output.fgGC, PCB->ElementColor);
+    color = PCB->ElementColor;
   else if (TEST_FLAG (SELECTEDFLAG, element))
-    gui->graphics->set_color (Output.fgGC, PCB->ElementSelectedColor);
+    color = PCB->ElementSelectedColor;
   else if (FRONT (element))
-    gui->graphics->set_color (Output.fgGC, PCB->ElementColor);
+    color = PCB->ElementColor;
   else
-    gui->graphics->set_color (Output.fgGC, PCB->InvisibleObjectsColor);
+    color = PCB->InvisibleObjectsColor;
+  gui->graphics->set_color (Output.fgGC, color);
+  if (lod_dot (&element->BoundingBox, color))
+    return;
 
   /* draw lines, arcs, text and pins */
   ELEMENTLINE_LOOP (element);
@@ -656,6 +944,7 @@ DrawEverything (const BoxType *drawn_area)
   if (!TEST_FLAG (CHECKPLANESFLAG, PCB)
       && gui->set_layer ("invisible", SL (INVISIBLE, 0), 0))
     {
+      lod_begin ();
       side = SWAP_IDENT ? TOP_SIDE : BOTTOM_SIDE;
       if (PCB->ElementOn)
 	{
@@ -849,6 +1138,7 @@ DrawPPV (int group, const BoxType *drawn_area)
   int bottom_group = GetLayerGroupNumberBySide (BOTTOM_SIDE);
   int side;
 
+  lod_begin ();
   if (PCB->PinOn || !gui->gui)
     {
       /* draw element pins */
@@ -954,6 +1244,7 @@ DrawSilk (int side, const BoxType * drawn_area)
 #endif
       DrawLayer (LAYER_PTR (max_copper_layer + side), drawn_area);
       /* draw package */
+      lod_begin ();
       r_search (PCB->Data->element_tree, drawn_area, NULL, element_callback, &side);
       r_search (PCB->Data->name_tree[NAME_INDEX (PCB)], drawn_area, NULL, name_callback, &side);
 #if 0
@@ -1070,10 +1361,22 @@ DrawRats (const BoxType *drawn_area)
    * XXX using the mask here is to get rat transparency
    */
   int can_mask = strcmp(gui->name, "lesstif") == 0;
+  int i;
+
+  for (i = 0; i < RAT_COLORS; i++)
+    if (rat_batch[i] == NULL)
+      rat_batch[i] = g_ptr_array_new ();
+    else
+      g_ptr_array_set_size (rat_batch[i], 0);
+  r_search (PCB->Data->rat_tree, drawn_area, NULL, rat_callback, NULL);
 
+  lod_begin ();
   if (can_mask)
     gui->graphics->use_mask (HID_MASK_CLEAR);
-  r_search (PCB->Data->rat_tree, drawn_area, NULL, rat_callback, NULL);
+  draw_rat_batch (rat_batch[0], PCB->RatColor);
+  draw_rat_batch (rat_batch[1], PCB->RatSelectedColor);
+  draw_rat_batch (rat_batch[2], PCB->ConnectedColor);
+  draw_rat_batch (rat_batch[3], PCB->FoundColor);
   if (can_mask)
     gui->graphics->use_mask (HID_MASK_OFF);
 }
@@ -1084,11 +1387,12 @@ text_callback (const BoxType * b, void *cl)
   LayerType *layer = cl;
   TextType *text = (TextType *)b;
   int min_silk_line;
+  char *color;
 
-  if (TEST_FLAG (SELECTEDFLAG, text))
-    gui->graphics->set_color (Output.fgGC, layer->SelectedColor);
-  else
-    gui->graphics->set_color (Output.fgGC, layer->Color);
+  color = TEST_FLAG (SELECTEDFLAG, text) ? layer->SelectedColor : layer->Color;
+  gui->graphics->set_color (Output.fgGC, color);
+  if (lod_text (b, color))
+    return 1;
   if (layer == &PCB->Data->SILKLAYER ||
       layer == &PCB->Data->BACKSILKLAYER)
     min_silk_line = PCB->minSlk;
@@ -1098,10 +1402,19 @@ text_callback (const BoxType * b, void *cl)
   return 1;
 }
 
+/*!
+ * \brief Objects drawn by DrawLayer () on each layer of the board since
+ * the counts were last cleared, for the frame statistics of the GUIs.
+ */
+unsigned long DrawLayerObjects[MAX_LAYER + 2];
+
 void
 DrawLayer (LayerType *Layer, const BoxType *screen)
 {
   struct poly_info info = {screen, Layer, 0};
+  unsigned long n = 0;
+
+  lod_begin ();
 
   /* draw the poly outlines */
   r_search (Layer->polygon_tree, screen, NULL, poly_callback, &info);
@@ -1109,13 +1422,13 @@ DrawLayer (LayerType *Layer, const BoxType *screen)
   if (!TEST_FLAG (CHECKPLANESFLAG, PCB))
   {
     /* draw all visible lines this layer */
-    r_search (Layer->line_tree, screen, NULL, line_callback, Layer);
+    n += r_search (Layer->line_tree, screen, NULL, line_callback, Layer);
 
     /* draw the layer arcs on screen */
-    r_search (Layer->arc_tree, screen, NULL, arc_callback, Layer);
+    n += r_search (Layer->arc_tree, screen, NULL, arc_callback, Layer);
 
     /* draw the layer text on screen */
-    r_search (Layer->text_tree, screen, NULL, text_callback, Layer);
+    n += r_search (Layer->text_tree, screen, NULL, text_callback, Layer);
 
     /* We should check for gui->gui here, but it's kinda cool seeing the
       auto-outline magically disappear when you first add something to
@@ -1134,8 +1447,10 @@ DrawLayer (LayerType *Layer, const BoxType *screen)
   info.fill = 1;
 
   /* fill the polys */
-  r_search (Layer->polygon_tree, screen, NULL, poly_callback, &info);
+  n += r_search (Layer->polygon_tree, screen, NULL, poly_callback, &info);
 
+  if (Layer >= PCB->Data->Layer && Layer < PCB->Data->Layer + MAX_LAYER + 2)
+    DrawLayerObjects[Layer - PCB->Data->Layer] += n;
 }
 
 /*!
@@ -1698,7 +2013,12 @@ hid_expose_callback (HID * hid, BoxType * region, void *item)
 {
   HID *old_gui = gui;
 
+  UpdatePolygonClipping ();
+
+  PROFILE_BEGIN (PROFILE_DRAW);
   gui = hid;
+  /* pinouts and exports are drawn in full */
+  lod_pixel = (hid->gui && item == NULL) ? pixel_slop : 0;
   Output.fgGC = gui->graphics->make_gc ();
   Output.bgGC = gui->graphics->make_gc ();
   Output.pmGC = gui->graphics->make_gc ();
@@ -1719,4 +2039,6 @@ hid_expose_callback (HID * hid, BoxType * region, void *item)
   gui->graphics->destroy_gc (Output.bgGC);
   gui->graphics->destroy_gc (Output.pmGC);
   gui = old_gui;
+  lod_pixel = 0;
+  PROFILE_END (PROFILE_DRAW);
 }
@@ -36,6 +36,8 @@
 #include "global.h"
 
 void Draw (void);
+void DeferDraw (void);
+void ResumeDraw (void);
 void Redraw (void);
 void DrawVia (PinType *);
 void DrawRat (RatType *);
@@ -70,6 +72,8 @@ void EraseElementPinsAndPads (ElementType *);
 void EraseElementName (ElementType *);
 void EraseObject (int, void *, void *);
 
+extern unsigned long DrawLayerObjects[MAX_LAYER + 2];
+
 void DrawLayerGroup (int side, const BoxType *drawn_area);
 void DrawPaste (int side, const BoxType *drawn_area);
 void DrawSilk (int side, const BoxType *drawn_area);
@@ -27,6 +27,8 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #ifdef HAVE_CONFIG_H
   #include "config.h"
@@ -38,13 +40,17 @@
 #include "drc_object.h"
 
 #include "data.h" /* Settings and PCB structures */
+#include "draw.h" /* Redraw */
 #include "error.h" /* Message */
 #include "find.h" /* Connection lookup functions */
+#include "job.h" /* pcb_job_run */
 #include "misc.h" /* SaveStackAndVisibility */
 #include "object_list.h"
 #include "pcb-printf.h" /* Units */
 /* PlowsPolygon, original_polygon, LinePoly, ArcPoly, Touching */
 #include "polygon.h" 
+#include "rtree.h"
+#include "set.h" /* SetChangedFlag */
 #include "undo.h" /* Lock/Unlock Undo*/
 
 object_list * drc_violation_list = 0;
@@ -82,6 +88,40 @@ static Cardinal drcerr_count;   /*!< Count of drc errors */
 /*!< Count of duplicate errors. This is purely for development purposes. */
 static Cardinal drcdup_count;   
 
+/*!< Where DRCStream() sends the violations as they are found. */
+static FILE *drc_stream = NULL;
+/*!< The GUI is given the violations as they are found. */
+static bool drc_gui_stream = false;
+static bool drc_stream_is_stdout;
+
+/*!
+ * \brief Hand a violation to the DRC GUI, through pcb_job_call().
+ */
+static void
+drc_gui_append (void *violation)
+{
+  gui->drc_gui->append_drc_violation ((DrcViolationType *) violation);
+}
+
+static void
+drc_gui_reset (void *data)
+{
+  gui->drc_gui->reset_drc_dialog_message ();
+}
+
+static void
+drc_layers_changed (void *data)
+{
+  hid_action ("LayersChanged");
+}
+
+/*!
+ * \brief Add a violation to drc_violation_list, unless it is there
+ * already.
+ *
+ * The list takes the violation over, objects and all, instead of copying
+ * it, so the violation is gone after the call.
+ */
 static void
 append_drc_violation (DrcViolationType *violation)
 {
@@ -92,10 +132,81 @@ append_drc_violation (DrcViolationType *violation)
   {
     /* already in the list */
     drcdup_count++;
+    pcb_drc_violation_free (violation);
     return;
   }
 
-  object_list_append(drc_violation_list, violation);
+  object_list_append_move(drc_violation_list, violation);
+  free (violation);
+  violation = object_list_get_item (drc_violation_list,
+                                    drc_violation_list->count - 1);
+
+  if (drc_stream)
+  {
+    pcb_drc_violation_print_json (drc_stream, violation);
+    fflush (drc_stream);
+  }
+  if (drc_gui_stream)
+    pcb_job_call (drc_gui_append, violation);
+}
+
+/* ----------------------------------------------------------------------- *
+ * Changes since the last DRC
+ * ----------------------------------------------------------------------- */
+
+/*!< IDs of the objects changed since the last DRC. */
+static GHashTable *drc_changed_ids = NULL;
+/*!< The last DRC result can't be patched, DRCChanged() checks all. */
+static bool drc_changed_all = true;
+/*!< Set while the DRC runs, the flags it sets and clears aren't edits. */
+static bool drc_running = false;
+/*!< Board and rules of the last DRC. */
+static PCBType *drc_pcb = NULL;
+static Coord drc_rules[6];
+
+static void
+get_drc_rules (Coord *rules)
+{
+  rules[0] = PCB->Bloat;
+  rules[1] = PCB->Shrink;
+  rules[2] = PCB->minWid;
+  rules[3] = PCB->minSlk;
+  rules[4] = PCB->minDrill;
+  rules[5] = PCB->minRing;
+}
+
+/*!
+ * \brief Note that the object with this ID changed.
+ *
+ * Called by the undo system for every operation it records, undoes or
+ * redoes.
+ */
+void
+DRCNoteChange (long int id)
+{
+  if (drc_running || drc_changed_all)
+    return;
+  if (drc_changed_ids == NULL)
+    drc_changed_ids = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_hash_table_add (drc_changed_ids, GINT_TO_POINTER (id));
+}
+
+/*!
+ * \brief Note a change that the next DRCChanged() can't limit to some
+ * objects, such as swapped layers.
+ */
+void
+DRCNoteChangeAll (void)
+{
+  if (!drc_running)
+    drc_changed_all = true;
+}
+
+static bool
+drc_id_changed (long int id)
+{
+  return drc_changed_ids != NULL
+         && g_hash_table_contains (drc_changed_ids, GINT_TO_POINTER (id));
 }
 
 /*!
@@ -120,6 +231,94 @@ struct drc_info
   int flag;
 };
 
+/*!
+ * \brief Report that the objects a and b of two nets are too close.
+ */
+static void
+append_close_violation (DRCObject *a, DRCObject *b, object_list *vobjs)
+{
+  DrcViolationType *violation;
+
+  drcerr_count++;
+  object_list_clear(vobjs);
+  object_list_append(vobjs, a);
+  object_list_append(vobjs, b);
+  violation = pcb_drc_violation_new (
+    _("Copper areas too close"),
+    _("Circuits that are too close may bridge during imaging, etching,"
+      "\nplating, or soldering processes resulting in a direct short."),
+    -1, -1, /* x, y, compute automatically */
+    0,     /* ANGLE OF ERROR UNKNOWN */
+    FALSE, /* MEASUREMENT OF ERROR UNKNOWN */
+    0,     /* MAGNITUDE OF ERROR UNKNOWN */
+    PCB->Bloat,
+    vobjs);
+  append_drc_violation (violation);
+}
+
+/*!
+ * \brief Two objects of different nets that are too close.
+ */
+typedef struct
+{
+  DRCObject a, b;
+} drc_close_pair;
+
+/*!
+ * \brief What the single pass lookup of close_nets_single_pass() found.
+ */
+static GArray *drc_close_pairs = NULL;
+
+static void
+note_close_object (int type, void *ptr1, void *ptr2, void *ptr3)
+{
+  drc_close_pair pair;
+
+  pair.a = thing1;
+  SetThing (2, type, ptr1, ptr2, ptr3);
+  pair.b = thing2;
+  g_array_append_val (drc_close_pairs, pair);
+}
+
+/*!
+ * \brief Report the nets too close to the one with SELECTEDFLAG set,
+ * with a single bloated lookup.
+ *
+ * The lookup does not stop at the objects of other nets but goes on
+ * through them, like the lookup DRCFind() starts over with after each
+ * violation does.  Each of those objects is noted with the one it was
+ * found from.  The first object noted of a net is reported, and the
+ * rest of its net is then given SELECTEDFLAG, so the other objects of
+ * that net are passed over.
+ */
+static void
+close_nets_single_pass (int What, void *ptr1, void *ptr2, void *ptr3,
+                        object_list *vobjs)
+{
+  guint i;
+
+  drc_close_pairs = g_array_new (FALSE, FALSE, sizeof (drc_close_pair));
+  ListStart (What, ptr1, ptr2, ptr3, FOUNDFLAG);
+  SetDRCCollect (note_close_object);
+  DoIt (FOUNDFLAG, PCB->Bloat, true, false, true);
+  SetDRCCollect (NULL);
+  DumpList ();
+
+  for (i = 0; i < drc_close_pairs->len; i++)
+    {
+      drc_close_pair *pair = &g_array_index (drc_close_pairs, drc_close_pair, i);
+
+      if (TEST_FLAG (SELECTEDFLAG, (AnyObjectType *) pair->b.ptr2))
+        continue;
+      append_close_violation (&pair->a, &pair->b, vobjs);
+      /* highlight the rest of the encroaching net so it's not reported again */
+      start_do_it_and_dump (pair->b.type, pair->b.ptr1, pair->b.ptr2,
+                            pair->b.ptr3, SELECTEDFLAG, true, 0, false);
+    }
+  g_array_free (drc_close_pairs, TRUE);
+  drc_close_pairs = NULL;
+}
+
 /*!
  * \brief Check for DRC violations on a single net starting from the pad
  * or pin.
@@ -204,7 +403,6 @@ DRCFind (int What, void *ptr1, void *ptr2, void *ptr3)
         PCB->Shrink,
         vobjs);
       append_drc_violation (violation);
-      pcb_drc_violation_free (violation);
     }
     DumpList ();
   }
@@ -225,6 +423,13 @@ DRCFind (int What, void *ptr1, void *ptr2, void *ptr3)
   
   /* Set the selected flag on anything connected to the pin */
   start_do_it_and_dump (What, ptr1, ptr2, ptr3, SELECTEDFLAG, false, 0, false);
+  if (Settings.DrcSinglePass)
+  {
+    close_nets_single_pass (What, ptr1, ptr2, ptr3, vobjs);
+    ClearFlagOnAllObjects (FOUNDFLAG | SELECTEDFLAG, false);
+    object_list_delete(vobjs);
+    return (false);
+  }
   /* Now bloat everything, and find things are connected now that weren't
    * before */
   flag = FOUNDFLAG;
@@ -233,22 +438,7 @@ DRCFind (int What, void *ptr1, void *ptr2, void *ptr3)
   while (DoIt (flag, PCB->Bloat, true, false, true))
   {
     DumpList ();
-    drcerr_count++;
-    object_list_clear(vobjs);
-    object_list_append(vobjs, &thing1);
-    object_list_append(vobjs, &thing2);
-    violation = pcb_drc_violation_new (
-      _("Copper areas too close"),
-      _("Circuits that are too close may bridge during imaging, etching,"
-        "\nplating, or soldering processes resulting in a direct short."),
-      -1, -1, /* x, y, compute automatically */
-      0,     /* ANGLE OF ERROR UNKNOWN */
-      FALSE, /* MEASUREMENT OF ERROR UNKNOWN */
-      0,     /* MAGNITUDE OF ERROR UNKNOWN */
-      PCB->Bloat,
-      vobjs);
-    append_drc_violation (violation);
-    pcb_drc_violation_free (violation);
+    append_close_violation (&thing1, &thing2, vobjs);
     /* highlight the rest of the encroaching net so it's not reported again */
     flag = SELECTEDFLAG;
     DumpList ();
@@ -274,6 +464,252 @@ DRCFind (int What, void *ptr1, void *ptr2, void *ptr3)
   return (false);
 }
 
+/*!
+ * \brief Fewest seeds worth a DRC worker process of their own.
+ */
+#define DRC_SEEDS_PER_JOB 64
+
+/*!
+ * \brief A pin, pad or via to start a DRCFind from.
+ */
+typedef struct
+{
+  int type;
+  void *ptr1, *ptr2, *ptr3;
+  Coord key; /*!< Position of the object along the board's long side. */
+} DrcSeedType;
+
+static void
+add_drc_seed (GArray *seeds, int type, void *ptr1, void *ptr2, void *ptr3)
+{
+  BoxType *box = &((AnyObjectType *) ptr2)->BoundingBox;
+  DrcSeedType seed;
+
+  seed.type = type;
+  seed.ptr1 = ptr1;
+  seed.ptr2 = ptr2;
+  seed.ptr3 = ptr3;
+  if (PCB->MaxWidth >= PCB->MaxHeight)
+    seed.key = (box->X1 + box->X2) / 2;
+  else
+    seed.key = (box->Y1 + box->Y2) / 2;
+  g_array_append_val (seeds, seed);
+}
+
+/*!
+ * \brief Run DRCFind from the seeds first .. last - 1.
+ *
+ * A seed already reached from an earlier seed of its net is skipped.
+ */
+static gint
+drc_seed_compare (gconstpointer a, gconstpointer b)
+{
+  Coord ka = ((const DrcSeedType *) a)->key;
+  Coord kb = ((const DrcSeedType *) b)->key;
+
+  return ka < kb ? -1 : ka > kb;
+}
+
+static void
+find_from_seeds (GArray *seeds, int first, int last)
+{
+  DrcSeedType *seed;
+  int i;
+
+  for (i = first; i < last; i++)
+  {
+    /* Only a job shows progress; a forked worker is none. */
+    if ((i - first) % 64 == 0 && pcb_job_in_worker ()
+        && pcb_job_progress (i - first, last - first,
+                             _("Checking design rules")))
+      break;
+    seed = &g_array_index (seeds, DrcSeedType, i);
+    if (!TEST_FLAG (DRCFLAG, (AnyObjectType *) seed->ptr2))
+      DRCFind (seed->type, seed->ptr1, seed->ptr2, seed->ptr3);
+  }
+}
+
+/*!
+ * \brief Fixed size part of a violation passed back by a DRC worker.
+ */
+typedef struct
+{
+  Coord x, y;
+  Angle angle;
+  int have_measured;
+  Coord measured_value, required_value;
+  int title_len, explanation_len, object_count;
+} DrcRecordType;
+
+static bool
+write_drc_violation (FILE *fp, DrcViolationType *v)
+{
+  DrcRecordType rec;
+  int i;
+
+  memset (&rec, 0, sizeof (rec));
+  rec.x = v->x;
+  rec.y = v->y;
+  rec.angle = v->angle;
+  rec.have_measured = v->have_measured;
+  rec.measured_value = v->measured_value;
+  rec.required_value = v->required_value;
+  rec.title_len = strlen (v->title);
+  rec.explanation_len = strlen (v->explanation);
+  rec.object_count = v->objects->count;
+
+  if (fwrite (&rec, sizeof (rec), 1, fp) != 1
+      || fwrite (v->title, 1, rec.title_len, fp) != rec.title_len
+      || fwrite (v->explanation, 1, rec.explanation_len, fp)
+         != rec.explanation_len)
+    return false;
+  /* The objects are pointers into the board, which the worker shares
+   * with the parent at the same addresses. */
+  for (i = 0; i < rec.object_count; i++)
+    if (fwrite (object_list_get_item (v->objects, i),
+                sizeof (DRCObject), 1, fp) != 1)
+      return false;
+  return true;
+}
+
+/*!
+ * \brief Read a violation written by write_drc_violation().
+ *
+ * \return the violation, NULL at the end of the file.
+ */
+static DrcViolationType *
+read_drc_violation (FILE *fp)
+{
+  DrcRecordType rec;
+  DrcViolationType *v;
+  object_list *objs;
+  DRCObject obj;
+  char *title, *explanation;
+  int i;
+
+  if (fread (&rec, sizeof (rec), 1, fp) != 1)
+    return NULL;
+
+  title = (char *)malloc (rec.title_len + 1);
+  explanation = (char *)malloc (rec.explanation_len + 1);
+  objs = object_list_new (2, sizeof (DRCObject));
+  if (fread (title, 1, rec.title_len, fp) != rec.title_len
+      || fread (explanation, 1, rec.explanation_len, fp)
+         != rec.explanation_len)
+    rec.object_count = -1;
+  title[rec.title_len] = '\0';
+  explanation[rec.explanation_len] = '\0';
+  for (i = 0; i < rec.object_count; i++)
+  {
+    if (fread (&obj, sizeof (obj), 1, fp) != 1)
+    {
+      rec.object_count = -1;
+      break;
+    }
+    object_list_append (objs, &obj);
+  }
+
+  v = NULL;
+  if (rec.object_count >= 0)
+    v = pcb_drc_violation_new (title, explanation, rec.x, rec.y, rec.angle,
+                               rec.have_measured, rec.measured_value,
+                               rec.required_value, objs);
+  free (title);
+  free (explanation);
+  object_list_delete (objs);
+  return v;
+}
+
+/*!
+ * \brief The seeds of the DRC workers and the number of strips they are
+ * cut into.
+ */
+typedef struct
+{
+  GArray *seeds;
+  int jobs;
+} DrcStripsType;
+
+#define STRIP_FIRST(strips, i) ((strips)->seeds->len * (i) / (strips)->jobs)
+
+/*!
+ * \brief Body of a DRC worker process.
+ *
+ * Checks the seeds of strip \p part and writes the error count and the
+ * violations found to fp.
+ */
+static int
+drc_worker (int part, FILE *fp, void *data)
+{
+  DrcStripsType *strips = (DrcStripsType *) data;
+  int start = drc_violation_list->count;
+  int i, ok;
+
+  /* The parent streams the violations when it merges them */
+  drc_stream = NULL;
+  drc_gui_stream = false;
+
+  find_from_seeds (strips->seeds, STRIP_FIRST (strips, part),
+                   STRIP_FIRST (strips, part + 1));
+
+  ok = fwrite (&drcerr_count, sizeof (drcerr_count), 1, fp) == 1;
+  for (i = start; ok && i < drc_violation_list->count; i++)
+    ok = write_drc_violation (fp, object_list_get_item (drc_violation_list,
+                                                        i));
+  return ok ? 0 : 1;
+}
+
+/*!
+ * \brief Merge the results of a worker into drc_violation_list, or check
+ * its strip here.
+ *
+ * \return false if the worker left no complete error count.
+ */
+static bool
+merge_drc_worker (int part, FILE *fp, void *data)
+{
+  DrcStripsType *strips = (DrcStripsType *) data;
+  DrcViolationType *violation;
+  Cardinal count;
+
+  if (fp == NULL)
+  {
+    find_from_seeds (strips->seeds, STRIP_FIRST (strips, part),
+                     STRIP_FIRST (strips, part + 1));
+    return true;
+  }
+  if (fread (&count, sizeof (count), 1, fp) != 1)
+    return false;
+  drcerr_count += count;
+  while ((violation = read_drc_violation (fp)) != NULL)
+  {
+    append_drc_violation (violation);
+  }
+  return true;
+}
+
+/*!
+ * \brief Run the DRCFind pass of DRCAll in jobs worker processes.
+ *
+ * The seeds are sorted along the long side of the board and cut into
+ * strips with the same number of seeds, one per worker.  Every worker
+ * searches the whole board from its own seeds, so the strips don't need
+ * to overlap.  A net reaching into several strips is checked once per
+ * strip, and the violations found more than once are merged by
+ * append_drc_violation().  A strip whose worker fails is checked here.
+ */
+static void
+find_from_seeds_parallel (GArray *seeds, int jobs)
+{
+  DrcStripsType strips;
+
+  g_array_sort (seeds, drc_seed_compare);
+  strips.seeds = seeds;
+  strips.jobs = jobs;
+  pcb_fork_workers (jobs, jobs, -1, true, drc_worker, merge_drc_worker,
+                    &strips);
+}
+
 /* Create a new object not connected violation */
 static void
 new_polygon_not_connected_violation ( LayerType *l, PolygonType *poly )
@@ -321,7 +757,6 @@ new_polygon_not_connected_violation ( LayerType *l, PolygonType *poly )
       0,
       vobjs);
   append_drc_violation (violation);
-  pcb_drc_violation_free (violation);
   
   object_list_delete(vobjs);
 
@@ -385,7 +820,6 @@ new_polygon_clearance_violation ( LayerType *l, PolygonType *poly )
       PCB->Bloat,
       vobjs);
   append_drc_violation (violation);
-  pcb_drc_violation_free (violation);
   
   object_list_delete(vobjs);
 
@@ -486,19 +920,112 @@ obj_touches_poly (DRCObject * obj, PolygonType * poly, Cardinal layer)
   return 0;
 }
 
-/* Determine if an object is inside the perimeter of a polygon. This is not
- * very efficient. */
+/*!< Uncleared outlines of the polygons, built once per DRC run. */
+static GHashTable *drc_original_polys = NULL;
+
+/*!
+ * \brief Get the POLYAREA of a polygon without any of the clearances cut
+ * out by parts.
+ *
+ * Every object near a pour is compared with its outline, so the outline
+ * and the segment trees of its contours are kept until the end of the run.
+ */
+static POLYAREA *
+drc_original_poly (PolygonType *poly)
+{
+  POLYAREA *orig;
+
+  if (drc_original_polys == NULL)
+    drc_original_polys = g_hash_table_new (g_direct_hash, g_direct_equal);
+  orig = (POLYAREA *) g_hash_table_lookup (drc_original_polys, poly);
+  if (orig == NULL && (orig = original_poly (poly)) != NULL)
+    g_hash_table_insert (drc_original_polys, poly, orig);
+  return orig;
+}
+
+static void
+free_drc_original_polys (void)
+{
+  GHashTableIter iter;
+  gpointer orig;
+
+  if (drc_original_polys == NULL)
+    return;
+  g_hash_table_iter_init (&iter, drc_original_polys);
+  while (g_hash_table_iter_next (&iter, NULL, &orig))
+  {
+    POLYAREA *pa = (POLYAREA *) orig;
+    poly_Free (&pa);
+  }
+  g_hash_table_destroy (drc_original_polys);
+  drc_original_polys = NULL;
+}
+
+/*!
+ * \brief Get the centre line and the radius of an object whose shape is
+ * a round ended line: a line, a pad without square ends, or a round pin.
+ *
+ * \return false for the other shapes.
+ */
+static bool
+round_obj_segment (DRCObject * obj, Vector a, Vector b, double * radius)
+{
+  LineType *line = (LineType *) obj->ptr2;
+  PinType *pin = (PinType *) obj->ptr2;
+
+  switch (obj->type)
+  {
+  case LINE_TYPE:
+  case PAD_TYPE:
+    if (TEST_FLAG (SQUAREFLAG, line))
+      return false;
+    a[0] = line->Point1.X;
+    a[1] = line->Point1.Y;
+    b[0] = line->Point2.X;
+    b[1] = line->Point2.Y;
+    *radius = line->Thickness / 2.0;
+    return true;
+  case PIN_TYPE:
+  case VIA_TYPE:
+    if (TEST_FLAG (SQUAREFLAG, pin) || TEST_FLAG (OCTAGONFLAG, pin))
+      return false;
+    a[0] = b[0] = pin->X;
+    a[1] = b[1] = pin->Y;
+    *radius = pin->Thickness / 2.0;
+    return true;
+  default:
+    return false;
+  }
+}
+
+/*!
+ * \brief Determine if an object is inside the perimeter of a polygon.
+ *
+ * Round ended objects are measured against the contour edges of the
+ * outline.  The other shapes are built and touched with the outline.
+ */
 static int
 is_obj_in_polygon(DRCObject * obj, PolygonType * poly, Cardinal layer)
 {
-  /* original_poly gives us a POLYAREA the shape of the polygon, but without
+  /* The outline gives us a POLYAREA the shape of the polygon, but without
    * any of the clearances cut out by parts. */
-  POLYAREA * orig = original_poly(poly);
+  POLYAREA * orig = drc_original_poly(poly);
   POLYAREA * pa_obj;
   int touches = 0;
   LineType *line = (LineType *) obj->ptr2;
   ArcType *arc = (ArcType *) obj->ptr2;
   PinType *pin = (PinType *) obj->ptr2;
+  Vector a, b;
+  double radius;
+
+  if (orig == NULL)
+    return 0;
+  if ((obj->type == PIN_TYPE || obj->type == VIA_TYPE)
+      && (!ViaIsOnLayerGroup (pin, GetLayerGroupNumberByNumber (layer))
+          || TEST_FLAG (HOLEFLAG, pin)))
+    return 0;
+  if (round_obj_segment (obj, a, b, &radius))
+    return poly_M_SegmentTouches (orig, a, b, radius + PCB->Bloat);
 
   /* Generate a POLYAREA in the shape of the object we're testing. */
   switch (obj->type)
@@ -511,9 +1038,6 @@ is_obj_in_polygon(DRCObject * obj, PolygonType * poly, Cardinal layer)
     break;
   case PIN_TYPE:
   case VIA_TYPE:
-    if (!ViaIsOnLayerGroup (pin, GetLayerGroupNumberByNumber (layer)) 
-             || TEST_FLAG (HOLEFLAG, pin))
-      return 0;
     pa_obj = PinPoly(pin, pin->Thickness + 2*PCB->Bloat, 0);
     break;
   case PAD_TYPE:
@@ -528,7 +1052,6 @@ is_obj_in_polygon(DRCObject * obj, PolygonType * poly, Cardinal layer)
   touches = Touching(orig, pa_obj);
 
   poly_Free(&pa_obj);
-  poly_Free(&orig);
   return touches;
 
 }
@@ -694,38 +1217,442 @@ new_line_width_violation(DRCObject * obj)
   object_list_append(violation->objects, obj);
   pcb_drc_violation_update_location(violation);
   append_drc_violation (violation);
-  pcb_drc_violation_free (violation);
   
 }
 
+/*!< Regions around the changed objects, NULL to check everything. */
+static rtree_t *drc_regions = NULL;
+
+static const char min_copper_title[] = "Warning: DRC minimum copper overlap";
+
+static bool
+drc_in_region (const BoxType *box)
+{
+  return drc_regions == NULL || !r_region_is_empty (drc_regions, box);
+}
+
+static void
+add_drc_region (GArray *boxes, const BoxType *box)
+{
+  Coord grow = 2 * MAX (PCB->Bloat, PCB->Shrink);
+  BoxType region;
+
+  region.X1 = box->X1 - grow;
+  region.Y1 = box->Y1 - grow;
+  region.X2 = box->X2 + grow;
+  region.Y2 = box->Y2 + grow;
+  g_array_append_val (boxes, region);
+}
+
+/*!
+ * \brief Collect the regions around the objects changed since the last
+ * DRC, as they are now.
+ *
+ * An element stands for its pins and pads, a line or polygon point for
+ * its line or polygon.  Removed objects are not on the board any more,
+ * only the violations they were in go.
+ */
+static GArray *
+collect_drc_regions (void)
+{
+  GArray *boxes = g_array_new (FALSE, FALSE, sizeof (BoxType));
+  bool moved;
+
+  ELEMENT_LOOP (PCB->Data);
+  {
+    moved = drc_id_changed (element->ID);
+    if (moved)
+      add_drc_region (boxes, &element->BoundingBox);
+    PIN_LOOP (element);
+    {
+      if (moved || drc_id_changed (pin->ID))
+        add_drc_region (boxes, &pin->BoundingBox);
+    }
+    END_LOOP;
+    PAD_LOOP (element);
+    {
+      if (moved || drc_id_changed (pad->ID))
+        add_drc_region (boxes, &pad->BoundingBox);
+    }
+    END_LOOP;
+  }
+  END_LOOP;
+
+  VIA_LOOP (PCB->Data);
+  {
+    if (drc_id_changed (via->ID))
+      add_drc_region (boxes, &via->BoundingBox);
+  }
+  END_LOOP;
+
+  ALLLINE_LOOP (PCB->Data);
+  {
+    if (drc_id_changed (line->ID) || drc_id_changed (line->Point1.ID)
+        || drc_id_changed (line->Point2.ID))
+      add_drc_region (boxes, &line->BoundingBox);
+  }
+  ENDALL_LOOP;
+
+  ALLARC_LOOP (PCB->Data);
+  {
+    if (drc_id_changed (arc->ID))
+      add_drc_region (boxes, &arc->BoundingBox);
+  }
+  ENDALL_LOOP;
+
+  ALLPOLYGON_LOOP (PCB->Data);
+  {
+    moved = drc_id_changed (polygon->ID);
+    POLYGONPOINT_LOOP (polygon);
+    {
+      moved = moved || drc_id_changed (point->ID);
+    }
+    END_LOOP;
+    if (moved)
+      add_drc_region (boxes, &polygon->BoundingBox);
+  }
+  ENDALL_LOOP;
+
+  return boxes;
+}
+
+/*!
+ * \brief Remove the violations the changes may have fixed or moved.
+ *
+ * Every violation with a changed object, or with an object in one of
+ * the regions, is checked again.  The objects of the minimum copper
+ * warning outside the regions are kept in min_copper_warning.
+ *
+ * \return the number of violations kept, as DRCAll() would count them.
+ */
+static int
+remove_changed_violations (DrcViolationType *min_copper_warning)
+{
+  DrcViolationType *v;
+  DRCObject *obj;
+  int i, j, kept = 0;
+  bool drop;
+
+  /* The first violation is the note about what the DRC doesn't catch */
+  for (i = drc_violation_list->count - 1; i > 0; i--)
+  {
+    v = object_list_get_item (drc_violation_list, i);
+    if (strcmp (v->title, min_copper_title) == 0)
+    {
+      for (j = 0; j < v->objects->count; j++)
+      {
+        obj = object_list_get_item (v->objects, j);
+        if (!drc_id_changed (obj->id)
+            && !drc_in_region (&((AnyObjectType *) obj->ptr2)->BoundingBox))
+          object_list_append (min_copper_warning->objects, obj);
+      }
+      object_list_remove (drc_violation_list, i);
+      continue;
+    }
+
+    drop = false;
+    for (j = 0; !drop && j < v->objects->count; j++)
+    {
+      obj = object_list_get_item (v->objects, j);
+      drop = drc_id_changed (obj->id)
+             || drc_in_region (&((AnyObjectType *) obj->ptr2)->BoundingBox);
+    }
+    if (drop)
+      object_list_remove (drc_violation_list, i);
+    else
+      kept++;
+  }
+  return kept;
+}
+
+/*!
+ * \brief Set FOUNDFLAG on everything connected to copper in the regions.
+ *
+ * The nets found are the ones DRCFind is run on again.
+ */
+static void
+mark_region_nets (void)
+{
+  COPPERLINE_LOOP (PCB->Data);
+  {
+    if (!TEST_FLAG (FOUNDFLAG, line) && drc_in_region (&line->BoundingBox))
+      start_do_it_and_dump (LINE_TYPE, layer, line, line, FOUNDFLAG,
+                            false, 0, false);
+  }
+  ENDALL_LOOP;
+
+  COPPERARC_LOOP (PCB->Data);
+  {
+    if (!TEST_FLAG (FOUNDFLAG, arc) && drc_in_region (&arc->BoundingBox))
+      start_do_it_and_dump (ARC_TYPE, layer, arc, arc, FOUNDFLAG,
+                            false, 0, false);
+  }
+  ENDALL_LOOP;
+
+  COPPERPOLYGON_LOOP (PCB->Data);
+  {
+    if (!TEST_FLAG (FOUNDFLAG, polygon)
+        && drc_in_region (&polygon->BoundingBox))
+      start_do_it_and_dump (POLYGON_TYPE, layer, polygon, polygon, FOUNDFLAG,
+                            false, 0, false);
+  }
+  ENDALL_LOOP;
+
+  ALLPIN_LOOP (PCB->Data);
+  {
+    if (!TEST_FLAG (FOUNDFLAG, pin) && drc_in_region (&pin->BoundingBox))
+      start_do_it_and_dump (PIN_TYPE, element, pin, pin, FOUNDFLAG,
+                            false, 0, false);
+  }
+  ENDALL_LOOP;
+
+  ALLPAD_LOOP (PCB->Data);
+  {
+    if (!TEST_FLAG (FOUNDFLAG, pad) && drc_in_region (&pad->BoundingBox))
+      start_do_it_and_dump (PAD_TYPE, element, pad, pad, FOUNDFLAG,
+                            false, 0, false);
+  }
+  ENDALL_LOOP;
+
+  VIA_LOOP (PCB->Data);
+  {
+    if (!TEST_FLAG (FOUNDFLAG, via) && drc_in_region (&via->BoundingBox))
+      start_do_it_and_dump (VIA_TYPE, via, via, via, FOUNDFLAG,
+                            false, 0, false);
+  }
+  END_LOOP;
+}
+
+/*!
+ * \brief The flags the DRC sets and clears on the board's objects.
+ */
+#define DRC_USED_FLAGS (FOUNDFLAG | DRCFLAG | SELECTEDFLAG)
+
+/*!
+ * \brief Save or restore the DRC_USED_FLAGS of one object.
+ */
+static void
+drc_flags_slot (GArray *saved, bool restore, guint *i, AnyObjectType *obj)
+{
+  unsigned long f;
+
+  if (restore)
+  {
+    f = g_array_index (saved, unsigned long, *i);
+    obj->Flags.f = (obj->Flags.f & ~DRC_USED_FLAGS) | f;
+    NOTE_FLAGS (f);
+  }
+  else
+  {
+    f = obj->Flags.f & DRC_USED_FLAGS;
+    g_array_append_val (saved, f);
+  }
+  (*i)++;
+}
+
+/*!
+ * \brief Visit the objects ClearFlagOnAllObjects() clears, in a fixed
+ * order, saving their flags into saved or restoring them from it.
+ */
+static void
+drc_flags_walk (GArray *saved, bool restore)
+{
+  guint i = 0;
+
+  RAT_LOOP (PCB->Data);
+  {
+    drc_flags_slot (saved, restore, &i, (AnyObjectType *) line);
+  }
+  END_LOOP;
+  COPPERLINE_LOOP (PCB->Data);
+  {
+    drc_flags_slot (saved, restore, &i, (AnyObjectType *) line);
+  }
+  ENDALL_LOOP;
+  COPPERARC_LOOP (PCB->Data);
+  {
+    drc_flags_slot (saved, restore, &i, (AnyObjectType *) arc);
+  }
+  ENDALL_LOOP;
+  COPPERPOLYGON_LOOP (PCB->Data);
+  {
+    drc_flags_slot (saved, restore, &i, (AnyObjectType *) polygon);
+  }
+  ENDALL_LOOP;
+  VIA_LOOP (PCB->Data);
+  {
+    drc_flags_slot (saved, restore, &i, (AnyObjectType *) via);
+  }
+  END_LOOP;
+  ALLPIN_LOOP (PCB->Data);
+  {
+    drc_flags_slot (saved, restore, &i, (AnyObjectType *) pin);
+  }
+  ENDALL_LOOP;
+  ALLPAD_LOOP (PCB->Data);
+  {
+    drc_flags_slot (saved, restore, &i, (AnyObjectType *) pad);
+  }
+  ENDALL_LOOP;
+}
+
+/*!
+ * \brief Save the DRC_USED_FLAGS of the board.
+ *
+ * Together with restore_drc_flags() this leaves the board as the DRC
+ * found it, without recording the flag changes for undo.
+ */
+static GArray *
+save_drc_flags (void)
+{
+  GArray *saved = g_array_new (FALSE, FALSE, sizeof (unsigned long));
+
+  drc_flags_walk (saved, false);
+  return saved;
+}
+
+static void
+restore_drc_flags (GArray *saved)
+{
+  drc_flags_walk (saved, true);
+  g_array_free (saved, TRUE);
+}
+
+/*!
+ * \brief Time taken and objects checked by each class of rules.
+ */
+typedef struct
+{
+  const char *name;
+  gint64 usec;
+  int checked; /*!< Objects checked, seeds for the connections. */
+  int errors;
+} DrcRuleStats;
+
+enum
+{
+  DRC_RULE_CONNECTIONS,
+  DRC_RULE_LINES,
+  DRC_RULE_ARCS,
+  DRC_RULE_PINS,
+  DRC_RULE_PADS,
+  DRC_RULE_VIAS,
+  DRC_RULE_SILK,
+  DRC_RULE_ELEMENT_SILK,
+  DRC_RULES
+};
+
+static DrcRuleStats drc_stats[DRC_RULES];
+static gint64 drc_rule_start_time;
+static Cardinal drc_rule_start_errors;
+
+static void
+drc_rule_begin (void)
+{
+  drc_rule_start_time = g_get_monotonic_time ();
+  drc_rule_start_errors = drcerr_count;
+}
+
+static void
+drc_rule_end (int rule)
+{
+  drc_stats[rule].usec += g_get_monotonic_time () - drc_rule_start_time;
+  drc_stats[rule].errors += drcerr_count - drc_rule_start_errors;
+}
+
+static void
+reset_drc_stats (void)
+{
+  static const char *names[DRC_RULES] = {
+    "connections", "lines", "arcs", "pins", "pads", "vias", "silk",
+    "element-silk"
+  };
+  int i;
+
+  for (i = 0; i < DRC_RULES; i++)
+  {
+    drc_stats[i].name = names[i];
+    drc_stats[i].usec = 0;
+    drc_stats[i].checked = 0;
+    drc_stats[i].errors = 0;
+  }
+}
+
+/*!
+ * \brief Finish a DRC run on the stream with the statistics of the rules
+ * and a summary.
+ */
+static void
+print_drc_stats (FILE *fp, gint64 usec, bool incremental)
+{
+  int i;
+
+  for (i = 0; i < DRC_RULES; i++)
+    fprintf (fp, "{\"type\": \"rule\", \"rule\": \"%s\", \"usec\": %"
+             G_GINT64_FORMAT ", \"checked\": %d, \"errors\": %d}\n",
+             drc_stats[i].name, drc_stats[i].usec, drc_stats[i].checked,
+             drc_stats[i].errors);
+  fprintf (fp, "{\"type\": \"summary\", \"incremental\": %s, \"usec\": %"
+           G_GINT64_FORMAT ", \"errors\": %d, \"violations\": %d}\n",
+           incremental ? "true" : "false", usec, drcerr_count,
+           /* not counting the note about what the DRC doesn't catch */
+           drc_violation_list->count - 1);
+  fflush (fp);
+}
+
 /*!
  * \brief Check for DRC violations.
  *
  * See if the connectivity changes when everything is bloated, or shrunk.
+ *
+ * \param incremental only check again around the objects changed since
+ * the last check, and keep the other violations.  The whole board is
+ * checked if the last result can't be patched.
  */
-int
-DRCAll (void)
+static int
+drc_check (bool incremental)
 {
   /* violating object list */
   object_list * vobjs = object_list_new(2, sizeof(DRCObject));
   DrcViolationType *violation;
   DrcViolationType * min_copper_warning;
   int i;
-  int undo_flags = 0;
+  GArray *saved_flags;
+  bool saved_changed;
   int tmpcnt;
   int nopastecnt = 0;
   struct drc_info info;
-  
+  GArray *seeds = g_array_new (FALSE, FALSE, sizeof (DrcSeedType));
+  int jobs;
+  GArray *region_boxes = NULL;
+  const BoxType **region_list = NULL;
+  Coord rules[6];
+  gint64 start_time = g_get_monotonic_time ();
+
+  UpdatePolygonClipping ();
+  reset_drc_stats ();
+
+  get_drc_rules (rules);
+  if (drc_violation_list == NULL || drc_changed_all || drc_pcb != PCB
+      || memcmp (rules, drc_rules, sizeof (rules)) != 0)
+    incremental = false;
+  drc_running = true;
+
   if (!drc_violation_list)
   {
     drc_violation_list = object_list_new(10, sizeof(DrcViolationType));
     drc_violation_list->ops = &drc_violation_ops;
   } else {
-    object_list_clear(drc_violation_list);
-    if (gui->drc_gui != NULL) gui->drc_gui->reset_drc_dialog_message();
+    if (!incremental) object_list_clear(drc_violation_list);
+    if (gui->drc_gui != NULL) pcb_job_call (drc_gui_reset, NULL);
   }
+  /* A whole check fills the GUI as it goes, a patched result only
+   * makes sense to it once it is done. */
+  drc_gui_stream = !incremental && gui->drc_gui != NULL;
   
   /* This phony violation informs user about what DRC does NOT catch.  */
+  if (!incremental)
+  {
   violation = pcb_drc_violation_new (
       _("WARNING: DRC doesn't catch everything"),
       _("Detection of outright shorts, missing connections, etc.\n"
@@ -735,7 +1662,7 @@ DRCAll (void)
       /* All remaining arguments are not relevant to this application.  */
         0, 0, 0, TRUE, 0, 0, 0);
   append_drc_violation (violation);
-  pcb_drc_violation_free (violation);
+  }
 
   /* Create this violation now, but don't add it yet. We'll add it at the
    * end if we detect any objects of concern. 
@@ -743,13 +1670,23 @@ DRCAll (void)
    *       can use to keep track of objects of concern. 
    * */
   min_copper_warning = pcb_drc_violation_new(
-        "Warning: DRC minimum copper overlap",
+        min_copper_title,
         "DRC does not catch all minimum copper overlap violations for\n"
         "objects with thickness &lt; 2 x (min overlap).",
         0, 0, 0, TRUE, 0, 0, 0); 
 
   drcerr_count = 0;
   drcdup_count = 0;
+
+  if (incremental)
+  {
+    region_boxes = collect_drc_regions ();
+    region_list = g_new (const BoxType *, region_boxes->len);
+    for (i = 0; i < region_boxes->len; i++)
+      region_list[i] = &g_array_index (region_boxes, BoxType, i);
+    drc_regions = r_create_tree (region_list, region_boxes->len, 0);
+    drcerr_count = remove_changed_violations (min_copper_warning);
+  }
   
   /* Since the searching functions only operate on visible layers, we need
    * to make sure that everything is turned on in order to check the entire
@@ -764,23 +1701,27 @@ DRCAll (void)
   SaveStackAndVisibility ();
   /* Turn on everything */
   ResetStackAndVisibility ();
-  hid_action ("LayersChanged");
+  if (gui->gui)
+    pcb_job_call (drc_layers_changed, NULL);
   InitConnectionLookup ();
   
-  /* We'll do this again when we're done, and use undo to restore state. */
-  if (ClearFlagOnAllObjects (FOUNDFLAG | DRCFLAG | SELECTEDFLAG, true)){
-    undo_flags = 1;
-    IncrementUndoSerialNumber ();
-  }
-  
   LockUndo(); /* Don't need to add all of these things */
+
+  /* The flags are put back from here when we're done. */
+  saved_flags = save_drc_flags ();
+  saved_changed = PCB->Changed;
+  ClearFlagOnAllObjects (DRC_USED_FLAGS, false);
+
+  /* Only the nets near the changes are searched again */
+  if (drc_regions)
+    mark_region_nets ();
   
   ELEMENT_LOOP (PCB->Data);
   {
     PIN_LOOP (element);
     {
-      if (!TEST_FLAG (DRCFLAG, pin))
-        DRCFind (PIN_TYPE, (void *) element, (void *) pin, (void *) pin);
+      if (drc_regions == NULL || TEST_FLAG (FOUNDFLAG, pin))
+        add_drc_seed (seeds, PIN_TYPE, element, pin, pin);
     }
     END_LOOP;
 
@@ -791,8 +1732,8 @@ DRCAll (void)
       if (TEST_FLAG (NOPASTEFLAG, pad))
         nopastecnt++;
       
-      if (!TEST_FLAG (DRCFLAG, pad))
-        DRCFind (PAD_TYPE, (void *) element, (void *) pad, (void *) pad);
+      if (drc_regions == NULL || TEST_FLAG (FOUNDFLAG, pad))
+        add_drc_seed (seeds, PAD_TYPE, element, pad, pad);
     }
     END_LOOP;
   }
@@ -800,10 +1741,23 @@ DRCAll (void)
   
   VIA_LOOP (PCB->Data);
   {
-    if (!TEST_FLAG (DRCFLAG, via))
-      DRCFind (VIA_TYPE, (void *) via, (void *) via, (void *) via);
+    if (drc_regions == NULL || TEST_FLAG (FOUNDFLAG, via))
+      add_drc_seed (seeds, VIA_TYPE, via, via, via);
   }
   END_LOOP;
+
+  if (drc_regions)
+    ClearFlagOnAllObjects (FOUNDFLAG, false);
+
+  drc_rule_begin ();
+  drc_stats[DRC_RULE_CONNECTIONS].checked = seeds->len;
+  jobs = MIN (Settings.DrcJobs, (int) seeds->len / DRC_SEEDS_PER_JOB);
+  if (jobs > 1)
+    find_from_seeds_parallel (seeds, jobs);
+  else
+    find_from_seeds (seeds, 0, seeds->len);
+  drc_rule_end (DRC_RULE_CONNECTIONS);
+  g_array_free (seeds, TRUE);
   
   /*
    * In the following, PlowsPolygon checks for the overlapping of bounding
@@ -818,8 +1772,12 @@ DRCAll (void)
 
   info.flag = SELECTEDFLAG;
   /* check minimum widths and polygon clearances */
+  drc_rule_begin ();
   COPPERLINE_LOOP (PCB->Data);
   {
+    if (!drc_in_region (&line->BoundingBox))
+      continue;
+    drc_stats[DRC_RULE_LINES].checked++;
     SetThing (1, LINE_TYPE, layer, line, line);
     /* check line clearances in polygons */
     expand_obj_bbox(&thing1, 2*PCB->Bloat);
@@ -836,9 +1794,14 @@ DRCAll (void)
       object_list_append(min_copper_warning->objects, &thing1);
   }
   ENDALL_LOOP;
+  drc_rule_end (DRC_RULE_LINES);
   
+  drc_rule_begin ();
   COPPERARC_LOOP (PCB->Data);
   {
+    if (!drc_in_region (&arc->BoundingBox))
+      continue;
+    drc_stats[DRC_RULE_ARCS].checked++;
     SetThing (1, ARC_TYPE, layer, arc, arc);
     expand_obj_bbox(&thing1, 2*PCB->Bloat);
     PlowsPolygon (PCB->Data, ARC_TYPE, layer, arc, drc_callback, &info);
@@ -853,9 +1816,14 @@ DRCAll (void)
       object_list_append(min_copper_warning->objects, &thing1);
   }
   ENDALL_LOOP;
+  drc_rule_end (DRC_RULE_ARCS);
 
+  drc_rule_begin ();
   ALLPIN_LOOP (PCB->Data);
   {
+    if (!drc_in_region (&pin->BoundingBox))
+      continue;
+    drc_stats[DRC_RULE_PINS].checked++;
     SetThing (1, PIN_TYPE, element, pin, pin);
     expand_obj_bbox(&thing1, 2*PCB->Bloat);
     PlowsPolygon (PCB->Data, PIN_TYPE, element, pin, drc_callback, &info);
@@ -877,7 +1845,6 @@ DRCAll (void)
         PCB->minRing,
         vobjs);
       append_drc_violation (violation);
-      pcb_drc_violation_free (violation);
     }
     if (pin->DrillingHole < PCB->minDrill)
     {
@@ -895,15 +1862,19 @@ DRCAll (void)
        PCB->minDrill,
        vobjs);
       append_drc_violation (violation);
-      pcb_drc_violation_free (violation);
     }
     if (pin->Thickness < 2 * PCB->Shrink)
       object_list_append(min_copper_warning->objects, &thing1);
   }
   ENDALL_LOOP;
+  drc_rule_end (DRC_RULE_PINS);
 
+  drc_rule_begin ();
   ALLPAD_LOOP (PCB->Data);
   {
+    if (!drc_in_region (&pad->BoundingBox))
+      continue;
+    drc_stats[DRC_RULE_PADS].checked++;
     SetThing (1, PAD_TYPE, element, pad, pad);
     expand_obj_bbox(&thing1, 2*PCB->Bloat);
     PlowsPolygon (PCB->Data, PAD_TYPE, element, pad, drc_callback, &info);
@@ -924,15 +1895,19 @@ DRCAll (void)
         PCB->minWid,
         vobjs);
       append_drc_violation (violation);
-      pcb_drc_violation_free (violation);
     }
     if (pad->Thickness < 2 * PCB->Shrink)
       object_list_append(min_copper_warning->objects, &thing1);
   }
   ENDALL_LOOP;
+  drc_rule_end (DRC_RULE_PADS);
 
+  drc_rule_begin ();
   VIA_LOOP (PCB->Data);
   {
+    if (!drc_in_region (&via->BoundingBox))
+      continue;
+    drc_stats[DRC_RULE_VIAS].checked++;
     SetThing (1, VIA_TYPE, via, via, via);
     expand_obj_bbox(&thing1, 2*PCB->Bloat);
     PlowsPolygon (PCB->Data, VIA_TYPE, via, via, drc_callback, &info);
@@ -954,7 +1929,6 @@ DRCAll (void)
         PCB->minRing,
         vobjs);
       append_drc_violation (violation);
-      pcb_drc_violation_free (violation);
     }
     if (via->DrillingHole < PCB->minDrill)
     {
@@ -972,19 +1946,23 @@ DRCAll (void)
           PCB->minDrill,
           vobjs);
       append_drc_violation (violation);
-      pcb_drc_violation_free (violation);
     }
     if (via->Thickness < 2 * PCB->Shrink)
       object_list_append(min_copper_warning->objects, &thing1);
   }
   END_LOOP;
+  drc_rule_end (DRC_RULE_VIAS);
   
   FreeConnectionLookupMemory ();
   
   /* check silkscreen minimum widths outside of elements */
   /* XXX - need to check text and polygons too! */
+  drc_rule_begin ();
   SILKLINE_LOOP (PCB->Data);
   {
+    if (!drc_in_region (&line->BoundingBox))
+      continue;
+    drc_stats[DRC_RULE_SILK].checked++;
     SetThing (1, LINE_TYPE, layer, line, line);
     if (line->Thickness < PCB->minSlk)
     {
@@ -1002,15 +1980,19 @@ DRCAll (void)
         PCB->minSlk,
         vobjs);
       append_drc_violation (violation);
-      pcb_drc_violation_free (violation);
     }
   }
   ENDALL_LOOP;
+  drc_rule_end (DRC_RULE_SILK);
   
   /* check silkscreen minimum widths inside of elements */
   /* XXX - need to check text and polygons too! */
+  drc_rule_begin ();
   ELEMENT_LOOP (PCB->Data);
   {
+    if (!drc_in_region (&element->BoundingBox))
+      continue;
+    drc_stats[DRC_RULE_ELEMENT_SILK].checked++;
     SetThing (1, ELEMENT_TYPE, element, element, element);
     tmpcnt = 0;
     ELEMENTLINE_LOOP (element);
@@ -1048,39 +2030,59 @@ DRCAll (void)
         vobjs);
       free (buffer);
       append_drc_violation (violation);
-      pcb_drc_violation_free (violation);
     }
   }
   END_LOOP;
+  drc_rule_end (DRC_RULE_ELEMENT_SILK);
    
   if (PCB->Shrink > 0)
   {
     /* If we found any objects that are too thin, add the warning to the
      * violation list.
      * */
-    if (min_copper_warning->objects->count > 0)
-      object_list_insert(drc_violation_list, 1, min_copper_warning);
+    if (min_copper_warning->objects->count > 0
+        && object_list_insert_move(drc_violation_list, 1,
+                                   min_copper_warning) == 0)
+    {
+      free (min_copper_warning);
+      min_copper_warning = NULL;
+      /* Streamed, the GUI gets it last rather than second. */
+      if (drc_gui_stream)
+        pcb_job_call (drc_gui_append,
+                      object_list_get_item (drc_violation_list, 1));
+    }
   }
 
-  pcb_drc_violation_free(min_copper_warning);
+  if (min_copper_warning)
+    pcb_drc_violation_free(min_copper_warning);
+
+  if (drc_regions)
+  {
+    r_destroy_tree (&drc_regions);
+    g_free (region_list);
+    g_array_free (region_boxes, TRUE);
+  }
 
-  /* If there's a GUI, tell it all about what we've found. */
-  if (gui->drc_gui != NULL)
+  /* If there's a GUI, tell it all about what we've found, unless it
+   * has been told already. */
+  if (gui->drc_gui != NULL && !drc_gui_stream)
   {
     for (i = 0; i < drc_violation_list->count; i++){
       violation = object_list_get_item(drc_violation_list, i);
-      gui->drc_gui->append_drc_violation (violation);
+      pcb_job_call (drc_gui_append, violation);
     }
   }
 
-  ClearFlagOnAllObjects ((FOUNDFLAG | DRCFLAG | SELECTEDFLAG), false);
+  restore_drc_flags (saved_flags);
+  SetChangedFlag (saved_changed);
   UnlockUndo ();
   
-  if (undo_flags)  Undo(false);
-  
   RestoreStackAndVisibility ();
-  hid_action ("LayersChanged");
-  gui->invalidate_all ();
+  if (gui->gui)
+  {
+    pcb_job_call (drc_layers_changed, NULL);
+    Redraw ();
+  }
   
   if (nopastecnt > 0)
   {
@@ -1089,15 +2091,54 @@ DRCAll (void)
                        nopastecnt), nopastecnt);
   }
   object_list_delete(vobjs);
+
+  /* The next DRCChanged() patches this result */
+  if (drc_changed_ids)
+    g_hash_table_remove_all (drc_changed_ids);
+  drc_changed_all = false;
+  drc_pcb = PCB;
+  memcpy (drc_rules, rules, sizeof (rules));
+  drc_running = false;
+  drc_gui_stream = false;
+  free_drc_original_polys ();
+
+  if (drc_stream)
+    print_drc_stats (drc_stream, g_get_monotonic_time () - start_time,
+                     incremental);
   return drcerr_count;
 }
 
+int
+DRCAll (void)
+{
+  return drc_check (false);
+}
+
+/*!
+ * \brief Check for DRC violations near the objects changed since the
+ * last DRC.
+ *
+ * The changes are the operations the undo system has recorded, undone
+ * or redone since then.  The violations with a changed object, or with
+ * an object near one, are checked again; the others are kept.  The
+ * whole board is checked the first time, after the rules changed, and
+ * after changes that can't be located, such as swapped layers.
+ *
+ * \return the number of design rule errors, as DRCAll() counts them.
+ */
+int
+DRCChanged (void)
+{
+  return drc_check (true);
+}
+
 
 /* ----------------------------------------------------------------------- *
  * Actions
  * ----------------------------------------------------------------------- */
 
-static const char drc_syntax[] = N_("DRC()");
+static const char drc_syntax[] = N_("DRC()\n"
+                                    "DRC(Changed)");
 
 static const char drc_help[] = N_("Invoke the DRC check.");
 
@@ -1105,12 +2146,27 @@ static const char drc_help[] = N_("Invoke the DRC check.");
  
  Note that the design rule check uses the current board rule settings,
  not the current style settings.
+
+ With @code{Changed}, only the objects changed since the last check, and
+ the objects near them, are checked again.  The violations found
+ elsewhere the last time are kept.
  
  %end-doc */
 
+/*!
+ * \brief Run the DRC, only near the changes with *data, as a job of
+ * ActionDRCheck().
+ */
+static int
+drc_job (void *data)
+{
+  return drc_check (*(bool *) data);
+}
+
 static int
 ActionDRCheck (int argc, char **argv, Coord x, Coord y)
 {
+  bool changed;
   int count;
   
   if (gui->drc_gui == NULL || gui->drc_gui->log_drc_overview)
@@ -1123,7 +2179,8 @@ ActionDRCheck (int argc, char **argv, Coord x, Coord y)
              PCB->minWid, PCB->minSlk,
              PCB->minDrill, PCB->minRing);
   }
-  count = DRCAll ();
+  changed = argc > 0 && strcasecmp (argv[0], "Changed") == 0;
+  count = pcb_job_run (_("Design rule check"), drc_job, &changed);
   if (gui->drc_gui == NULL || gui->drc_gui->log_drc_overview)
   {
     if (count == 0)
@@ -1170,6 +2227,44 @@ ActionDRCReport (int argc, char **argv, Coord x, Coord y)
   return 0;
 }
 
+static const char drc_stream_syntax[] = N_("DRCStream([Output file|-])");
+static const char drc_stream_help[] =
+N_("Write the DRC violations to a file as they are found.");
+
+/* %start-doc actions DRCStream
+
+Every later DRC writes each violation to the file as one line of JSON
+as soon as it is found, and finishes with one line per class of rules
+(time taken in microseconds, objects checked, errors found) and a
+summary line.  @code{-} writes to the standard output.  Without an
+argument the stream is closed.
+
+%end-doc */
+
+static int
+ActionDRCStream (int argc, char **argv, Coord x, Coord y)
+{
+  FILE *fp;
+
+  if (drc_stream && !drc_stream_is_stdout)
+    fclose (drc_stream);
+  drc_stream = NULL;
+
+  if (argc == 0)
+    return 0;
+
+  if (strcmp (argv[0], "-") == 0)
+    fp = stdout;
+  else if ((fp = fopen (argv[0], "w")) == NULL)
+  {
+    Message (_("DRCStream: Can't open %s\n"), argv[0]);
+    return 1;
+  }
+  drc_stream = fp;
+  drc_stream_is_stdout = fp == stdout;
+  return 0;
+}
+
 static const char drc_review_syntax[] = N_("DRCReview()");
 static const char drc_review_help[] =
 N_("Iterate through the list of DRC violations and present them.");
@@ -1198,6 +2293,7 @@ HID_Action drc_action_list[] = {
   {"DRC", 0, ActionDRCheck, drc_help, drc_syntax},
   {"DRCReport", 0, ActionDRCReport, drc_report_help, drc_report_syntax},
   {"DRCReview", 0, ActionDRCReview, drc_review_help, drc_review_syntax},
+  {"DRCStream", 0, ActionDRCStream, drc_stream_help, drc_stream_syntax},
 };
 
 REGISTER_ACTIONS (drc_action_list)
@@ -42,4 +42,11 @@ extern object_list * drc_violation_list;
  */
 bool SetThing(int n, int type, void *p1, void *p2, void *p3);
 
+int DRCAll (void);
+int DRCChanged (void);
+
+/* The undo system tells the DRC what changes, for DRCChanged(). */
+void DRCNoteChange (long int id);
+void DRCNoteChangeAll (void);
+
 #endif /* PCB_DRC_H */
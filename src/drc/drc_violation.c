@@ -204,6 +204,68 @@ pcb_drc_violation_print(FILE* fp, DrcViolationType * violation)
   fprintf(fp, "\n");
 }
 
+static void
+print_json_string (FILE *fp, const char *str)
+{
+  fputc ('"', fp);
+  for (; *str; str++)
+  {
+    switch (*str)
+    {
+    case '"':
+    case '\\':
+      fprintf (fp, "\\%c", *str);
+      break;
+    case '\n':
+      fputs ("\\n", fp);
+      break;
+    case '\t':
+      fputs ("\\t", fp);
+      break;
+    default:
+      if ((unsigned char) *str < 0x20)
+        fprintf (fp, "\\u%04x", (unsigned char) *str);
+      else
+        fputc (*str, fp);
+    }
+  }
+  fputc ('"', fp);
+}
+
+/*!
+ * \brief Print a violation as one line of JSON.
+ *
+ * Coordinates are in nanometers, objects are given by ID and type.
+ */
+void
+pcb_drc_violation_print_json (FILE *fp, DrcViolationType *violation)
+{
+  DRCObject *obj;
+  int i;
+
+  fputs ("{\"type\": \"violation\", \"title\": ", fp);
+  print_json_string (fp, violation->title);
+  fputs (", \"explanation\": ", fp);
+  print_json_string (fp, violation->explanation);
+  fprintf (fp, ", \"x\": %lld, \"y\": %lld, \"angle\": %g",
+           (long long int) violation->x, (long long int) violation->y,
+           (double) violation->angle);
+  if (violation->have_measured)
+    fprintf (fp, ", \"measured\": %lld",
+             (long long int) violation->measured_value);
+  else
+    fputs (", \"measured\": null", fp);
+  fprintf (fp, ", \"required\": %lld, \"objects\": [",
+           (long long int) violation->required_value);
+  for (i = 0; violation->objects && i < violation->objects->count; i++)
+  {
+    obj = object_list_get_item (violation->objects, i);
+    fprintf (fp, "%s{\"id\": %ld, \"type\": %d}", i ? ", " : "",
+             obj->id, obj->type);
+  }
+  fputs ("]}\n", fp);
+}
+
 void
 set_flag_on_violating_objects (DrcViolationType * v, int f)
 {
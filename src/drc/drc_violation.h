@@ -54,6 +54,7 @@ DrcViolationType * pcb_drc_violation_new (
 
 void pcb_drc_violation_free (DrcViolationType *violation);
 void pcb_drc_violation_print (FILE*, DrcViolationType*);
+void pcb_drc_violation_print_json (FILE*, DrcViolationType*);
 int pcb_drc_violation_prompt(DrcViolationType *violation);
 void pcb_drc_violation_update_location(DrcViolationType*);
 
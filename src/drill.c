@@ -44,32 +44,61 @@
 #include <dmalloc.h>
 #endif
 
-/*
- * some local prototypes
+/*!
+ * \brief The drills of GetDrillInfo() while they are gathered.
+ *
+ * Each drill size is numbered in the order it is first met, through a
+ * hash of the sizes.  The last element of each drill is kept so that an
+ * element, whose pins all come one after the other, is listed once.
  */
-static void FillDrill (DrillType *, ElementType *, PinType *);
-static void InitializeDrill (DrillType *, PinType *, ElementType *);
+typedef struct
+{
+  GHashTable *index; /*!< The number of each drill size, plus one. */
+  GArray *drills; /*!< The DrillType of each number. */
+  GPtrArray *last; /*!< The last element of each drill. */
+} DrillGatherType;
 
+static DrillType *
+FindDrill (DrillGatherType *g, Coord size, Cardinal *n)
+{
+  gint64 key = size;
+  gint64 *new_key;
+  DrillType drill;
+  gpointer found = g_hash_table_lookup (g->index, &key);
 
+  if (found)
+    *n = GPOINTER_TO_UINT (found) - 1;
+  else
+    {
+      *n = g->drills->len;
+      new_key = g_new (gint64, 1);
+      *new_key = size;
+      g_hash_table_insert (g->index, new_key, GUINT_TO_POINTER (*n + 1));
+      memset (&drill, 0, sizeof (drill));
+      drill.DrillSize = size;
+      g_array_append_val (g->drills, drill);
+      g_ptr_array_add (g->last, NULL);
+    }
+  return &g_array_index (g->drills, DrillType, *n);
+}
+
+/*!
+ * \brief Count a hole in its drill, to know the size of its arrays.
+ */
 static void
-FillDrill (DrillType *Drill, ElementType *Element, PinType *Pin)
+CountDrill (DrillGatherType *g, ElementType *Element, PinType *Pin)
 {
   Cardinal n;
-  ElementType **ptr;
-  PinType **pin;
+  DrillType *Drill = FindDrill (g, Pin->DrillingHole, &n);
 
-  pin = GetDrillPinMemory (Drill);
-  *pin = Pin;
+  Drill->PinMax++;
   if (Element)
     {
       Drill->PinCount++;
-      for (n = Drill->ElementN - 1; n != -1; n--)
-	if (Drill->Element[n] == Element)
-	  break;
-      if (n == -1)
+      if (g_ptr_array_index (g->last, n) != Element)
 	{
-	  ptr = GetDrillElementMemory (Drill);
-	  *ptr = Element;
+	  Drill->ElementMax++;
+	  g_ptr_array_index (g->last, n) = Element;
 	}
     }
   else
@@ -78,33 +107,21 @@ FillDrill (DrillType *Drill, ElementType *Element, PinType *Pin)
     Drill->UnplatedCount++;
 }
 
+/*!
+ * \brief Put a hole in the arrays of its drill.
+ */
 static void
-InitializeDrill (DrillType *drill, PinType *pin, ElementType *element)
+FillDrill (DrillGatherType *g, ElementType *Element, PinType *Pin)
 {
-  void *ptr;
-
-  drill->DrillSize = pin->DrillingHole;
-  drill->ElementN = 0;
-  drill->ViaCount = 0;
-  drill->PinCount = 0;
-  drill->UnplatedCount = 0;
-  drill->ElementMax = 0;
-  drill->Element = NULL;
-  drill->PinN = 0;
-  drill->Pin = NULL;
-  drill->PinMax = 0;
-  ptr = (void *) GetDrillPinMemory (drill);
-  *((PinType **) ptr) = pin;
-  if (element)
+  Cardinal n;
+  DrillType *Drill = FindDrill (g, Pin->DrillingHole, &n);
+
+  Drill->Pin[Drill->PinN++] = Pin;
+  if (Element && g_ptr_array_index (g->last, n) != Element)
     {
-      ptr = (void *) GetDrillElementMemory (drill);
-      *((ElementType **) ptr) = element;
-      drill->PinCount = 1;
+      Drill->Element[Drill->ElementN++] = Element;
+      g_ptr_array_index (g->last, n) = Element;
     }
-  else
-    drill->ViaCount = 1;
-  if (TEST_FLAG (HOLEFLAG, pin))
-    drill->UnplatedCount = 1;
 }
 
 static int
@@ -115,100 +132,71 @@ DrillQSort (const void *va, const void *vb)
   return a->DrillSize - b->DrillSize;
 }
 
+/*!
+ * \brief Gather the holes of the pins and vias of \p top by drill size.
+ *
+ * The holes are counted first, so that each drill gets its arrays once,
+ * at the size they need, and then put in them.  The drills are sorted
+ * by size; the holes of a drill are in the order of the board, the pins
+ * of the elements before the vias.
+ */
 DrillInfoType *
 GetDrillInfo (DataType *top)
 {
   DrillInfoType *AllDrills;
-  DrillType *Drill = NULL;
-  DrillType savedrill, swapdrill;
-  bool DrillFound = false;
-  bool NewDrill;
+  DrillGatherType g;
+  DrillType *drill;
+  Cardinal n;
+
+  g.index = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, NULL);
+  g.drills = g_array_new (FALSE, FALSE, sizeof (DrillType));
+  g.last = g_ptr_array_new ();
 
-  AllDrills = (DrillInfoType *)calloc (1, sizeof (DrillInfoType));
   ALLPIN_LOOP (top);
   {
-    if (!DrillFound)
-      {
-	DrillFound = true;
-	Drill = GetDrillInfoDrillMemory (AllDrills);
-	InitializeDrill (Drill, pin, element);
-      }
-    else
-      {
-	if (Drill->DrillSize == pin->DrillingHole)
-	  FillDrill (Drill, element, pin);
-	else
-	  {
-	    NewDrill = false;
-	    DRILL_LOOP (AllDrills);
-	    {
-	      if (drill->DrillSize == pin->DrillingHole)
-		{
-		  Drill = drill;
-		  FillDrill (Drill, element, pin);
-		  break;
-		}
-	      else if (drill->DrillSize > pin->DrillingHole)
-		{
-		  if (!NewDrill)
-		    {
-		      NewDrill = true;
-		      InitializeDrill (&swapdrill, pin, element);
-		      Drill = GetDrillInfoDrillMemory (AllDrills);
-		      Drill->DrillSize = pin->DrillingHole + 1;
-		      Drill = drill;
-		    }
-		  savedrill = *drill;
-		  *drill = swapdrill;
-		  swapdrill = savedrill;
-		}
-	    }
-	    END_LOOP;
-	    if (AllDrills->Drill[AllDrills->DrillN - 1].DrillSize <
-		pin->DrillingHole)
-	      {
-		Drill = GetDrillInfoDrillMemory (AllDrills);
-		InitializeDrill (Drill, pin, element);
-	      }
-	  }
-      }
+    CountDrill (&g, element, pin);
   }
   ENDALL_LOOP;
   VIA_LOOP (top);
   {
-    if (!DrillFound)
-      {
-	DrillFound = true;
-	Drill = GetDrillInfoDrillMemory (AllDrills);
-	Drill->DrillSize = via->DrillingHole;
-	FillDrill (Drill, NULL, via);
-      }
-    else
-      {
-	if (Drill->DrillSize != via->DrillingHole)
-	  {
-	    DRILL_LOOP (AllDrills);
-	    {
-	      if (drill->DrillSize == via->DrillingHole)
-		{
-		  Drill = drill;
-		  FillDrill (Drill, NULL, via);
-		  break;
-		}
-	    }
-	    END_LOOP;
-	    if (Drill->DrillSize != via->DrillingHole)
-	      {
-		Drill = GetDrillInfoDrillMemory (AllDrills);
-		Drill->DrillSize = via->DrillingHole;
-		FillDrill (Drill, NULL, via);
-	      }
-	  }
-	else
-	  FillDrill (Drill, NULL, via);
-      }
+    CountDrill (&g, NULL, via);
   }
   END_LOOP;
+
+  for (n = 0; n < g.drills->len; n++)
+    {
+      drill = &g_array_index (g.drills, DrillType, n);
+      drill->Pin = (PinType **) malloc (drill->PinMax * sizeof (PinType *));
+      drill->Element = drill->ElementMax ?
+	(ElementType **) malloc (drill->ElementMax * sizeof (ElementType *))
+	: NULL;
+      g_ptr_array_index (g.last, n) = NULL;
+    }
+
+  ALLPIN_LOOP (top);
+  {
+    FillDrill (&g, element, pin);
+  }
+  ENDALL_LOOP;
+  VIA_LOOP (top);
+  {
+    FillDrill (&g, NULL, via);
+  }
+  END_LOOP;
+
+  AllDrills = (DrillInfoType *)calloc (1, sizeof (DrillInfoType));
+  AllDrills->DrillN = AllDrills->DrillMax = g.drills->len;
+  if (g.drills->len)
+    {
+      AllDrills->Drill = (DrillType *) malloc (g.drills->len *
+					       sizeof (DrillType));
+      memcpy (AllDrills->Drill, g.drills->data,
+	      g.drills->len * sizeof (DrillType));
+    }
+  g_hash_table_destroy (g.index);
+  g_array_free (g.drills, TRUE);
+  g_ptr_array_free (g.last, TRUE);
+
   qsort (AllDrills->Drill, AllDrills->DrillN, sizeof (DrillType), DrillQSort);
   return (AllDrills);
 }
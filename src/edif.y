@@ -27,6 +27,7 @@
 #include <ctype.h>
 
 #include "global.h"
+#include "create.h"
 #include "data.h"
 /* from mymem.h, not include because of the malloc junk */
 LibraryMenuType * GetLibraryMenuMemory (LibraryType *);
@@ -99,7 +100,7 @@ LibraryEntryType * GetLibraryEntryMemory (LibraryMenuType *);
      char* buf;
      char* p;
      LibraryEntryType *entry;
-     LibraryMenuType *menu = GetLibraryMenuMemory (&PCB->NetlistLib);
+     LibraryMenuType *menu;
 
      if ( !name->str1 )
      {
@@ -110,7 +111,7 @@ LibraryEntryType * GetLibraryEntryMemory (LibraryMenuType *);
 	 pair_list_free(nodes);
 	 return;
      }
-     menu->Name = strdup (name->str1);
+     menu = CreateNewNet (&PCB->NetlistLib, name->str1, NULL);
      free(name->str1);
      /* if renamed str2 also exists and must be freed */
      if ( name->str2 )  free(name->str2);
@@ -0,0 +1,453 @@
+/*!
+ * \file src/edif_nets.c
+ *
+ * \brief Streaming reader for the nets of an EDIF netlist.
+ *
+ * The EDIF grammar in edif.y checks the whole file against the EDIF
+ * 2 0 0 syntax, and keeps every identifier string of the file on the way
+ * even though only net names and their port references are used.  The
+ * memory it takes grows with the file.
+ *
+ * This reader walks the s-expressions of the file with getc () and
+ * looks only at the lists it needs:
+ * - (net NameDef ... (joined (portRef ...) ...) ... (net ...)),
+ *   wherever it is;
+ * - (portRef Port (instanceRef Instance ...)) and portRefs nested in
+ *   portRefs.
+ *
+ * Everything else is skipped without being stored, so the memory held
+ * at any point is the nesting of the current list plus the nodes of the
+ * nets being read.  The nets go into PCB->NetlistLib just as the
+ * grammar puts them: named after the net identifier, one entry
+ * "INSTANCE-port" per port reference, in the same order.
+ *
+ * The --no-edif-stream option reads EDIF files with the grammar.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "create.h"
+#include "data.h"
+#include "edif_nets.h"
+#include "error.h"
+#include "mymem.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+enum
+{
+  EDIF_EOF,
+  EDIF_OPEN, /*!< '(' and the keyword after it, in the token text. */
+  EDIF_CLOSE,
+  EDIF_IDENT,
+  EDIF_OTHER /*!< Integers, strings and stray characters. */
+};
+
+typedef struct
+{
+  FILE *fp;
+  GString *text; /*!< Text of the last EDIF_OPEN or EDIF_IDENT. */
+  bool ended; /*!< The file ended inside a list. */
+} EdifReader;
+
+static bool
+is_ident_start (int c)
+{
+  return isalpha (c) || c == '&';
+}
+
+static bool
+is_ident_char (int c)
+{
+  return isalpha (c) || isdigit (c) || c == '_';
+}
+
+/*!
+ * \brief Read an identifier starting with c into r->text.
+ */
+static void
+read_ident (EdifReader *r, int c)
+{
+  g_string_truncate (r->text, 0);
+  do
+    {
+      g_string_append_c (r->text, c);
+      c = getc (r->fp);
+    }
+  while (c != EOF && is_ident_char (c));
+  if (c != EOF)
+    ungetc (c, r->fp);
+}
+
+static int
+next_token (EdifReader *r)
+{
+  int c;
+
+  for (;;)
+    {
+      c = getc (r->fp);
+      if (c == EOF)
+        return EDIF_EOF;
+      if (isspace (c))
+        continue;
+
+      if (c == '(')
+        {
+          do
+            c = getc (r->fp);
+          while (c != EOF && isspace (c));
+          g_string_truncate (r->text, 0);
+          if (c != EOF && is_ident_start (c))
+            read_ident (r, c);
+          else if (c != EOF)
+            ungetc (c, r->fp);
+          return EDIF_OPEN;
+        }
+      if (c == ')')
+        return EDIF_CLOSE;
+      if (is_ident_start (c))
+        {
+          read_ident (r, c);
+          return EDIF_IDENT;
+        }
+      if (c == '"')
+        {
+          /* Skip the string, the names used here are identifiers */
+          while ((c = getc (r->fp)) != EOF && c != '"')
+            ;
+          return EDIF_OTHER;
+        }
+      if (isdigit (c) || c == '-' || c == '+')
+        {
+          while ((c = getc (r->fp)) != EOF && isdigit (c))
+            ;
+          if (c != EOF)
+            ungetc (c, r->fp);
+          return EDIF_OTHER;
+        }
+      return EDIF_OTHER;
+    }
+}
+
+static bool
+is_keyword (EdifReader *r, const char *keyword)
+{
+  return g_ascii_strcasecmp (r->text->str, keyword) == 0;
+}
+
+/*!
+ * \brief Skip the rest of a list whose '(' has been read.
+ */
+static void
+skip_list (EdifReader *r)
+{
+  int depth = 1, token;
+
+  while (depth > 0)
+    {
+      token = next_token (r);
+      if (token == EDIF_EOF)
+        {
+          r->ended = true;
+          return;
+        }
+      if (token == EDIF_OPEN)
+        depth++;
+      else if (token == EDIF_CLOSE)
+        depth--;
+    }
+}
+
+/*!
+ * \brief Read a NameRef, an identifier or (name Ident ...).
+ *
+ * \param token the first token of it.
+ *
+ * \return the identifier, NULL for anything else.  A list is read to
+ * its end.
+ */
+static char *
+read_name_ref (EdifReader *r, int token)
+{
+  char *name = NULL;
+
+  if (token == EDIF_IDENT)
+    return g_strdup (r->text->str);
+  if (token != EDIF_OPEN)
+    return NULL;
+
+  if (is_keyword (r, "name") && next_token (r) == EDIF_IDENT)
+    name = g_strdup (r->text->str);
+  skip_list (r);
+  return name;
+}
+
+/*!
+ * \brief Read a NameDef, which also may be (rename NameRef "string").
+ */
+static char *
+read_name_def (EdifReader *r, int token)
+{
+  char *name;
+
+  if (token == EDIF_OPEN && is_keyword (r, "rename"))
+    {
+      name = read_name_ref (r, next_token (r));
+      skip_list (r);
+      return name;
+    }
+  return read_name_ref (r, token);
+}
+
+/*!
+ * \brief Read the rest of (instanceRef NameRef ...).
+ */
+static char *
+read_instance_ref (EdifReader *r)
+{
+  char *instance = read_name_ref (r, next_token (r));
+
+  skip_list (r);
+  return instance;
+}
+
+/*!
+ * \brief Read the rest of (portRef NameRef [portRef | instanceRef]).
+ *
+ * \param instance set to the instance name, NULL if there is none.
+ *
+ * \return the port name.
+ */
+static char *
+read_port_ref (EdifReader *r, char **instance)
+{
+  char *port, *inner_port;
+  int token;
+
+  *instance = NULL;
+  port = read_name_ref (r, next_token (r));
+
+  while ((token = next_token (r)) != EDIF_CLOSE)
+    {
+      if (token == EDIF_EOF)
+        {
+          r->ended = true;
+          break;
+        }
+      if (token != EDIF_OPEN)
+        continue;
+      if (*instance == NULL && is_keyword (r, "portRef"))
+        {
+          inner_port = read_port_ref (r, instance);
+          g_free (inner_port);
+        }
+      else if (*instance == NULL && is_keyword (r, "instanceRef"))
+        *instance = read_instance_ref (r);
+      else
+        skip_list (r);
+    }
+  return port;
+}
+
+/*!
+ * \brief Add a net to the netlist, as define_pcb_net() in edif.y does.
+ *
+ * \param nodes instance and port names, in pairs, in file order.
+ */
+static void
+define_net (const char *name, GPtrArray *nodes)
+{
+  LibraryMenuType *menu = CreateNewNet (&PCB->NetlistLib, (char *) name, NULL);
+  LibraryEntryType *entry;
+  const char *instance, *port;
+  GString *buf = g_string_new ("");
+  int i;
+
+  /* The grammar builds the list of a net back to front */
+  for (i = (int) nodes->len - 2; i >= 0; i -= 2)
+    {
+      instance = g_ptr_array_index (nodes, i);
+      port = g_ptr_array_index (nodes, i + 1);
+
+      /* make all upper case, because of PCB funky behaviour */
+      g_string_truncate (buf, 0);
+      for (; *instance; instance++)
+        g_string_append_c (buf, toupper ((int) *instance));
+      g_string_append_c (buf, '-');
+      /* skip the edif number prefix */
+      g_string_append (buf, port[0] == '&' ? port + 1 : port);
+
+      entry = GetLibraryEntryMemory (menu);
+      entry->ListEntry = strdup (buf->str);
+    }
+  g_string_free (buf, TRUE);
+}
+
+/*!
+ * \brief Read the rest of (joined ...), adding its ports to nodes.
+ */
+static void
+read_joined (EdifReader *r, GPtrArray *nodes)
+{
+  char *instance, *port;
+  int token;
+
+  while ((token = next_token (r)) != EDIF_CLOSE)
+    {
+      if (token == EDIF_EOF)
+        {
+          r->ended = true;
+          return;
+        }
+      if (token != EDIF_OPEN)
+        continue;
+      if (!is_keyword (r, "portRef"))
+        {
+          skip_list (r);
+          continue;
+        }
+
+      port = read_port_ref (r, &instance);
+      if (instance && port)
+        {
+          g_ptr_array_add (nodes, instance);
+          g_ptr_array_add (nodes, port);
+        }
+      else
+        {
+          /* a port with no instance is tossed */
+          g_free (instance);
+          g_free (port);
+        }
+    }
+}
+
+static void read_list (EdifReader *);
+
+/*!
+ * \brief Read the rest of (net NameDef ...).
+ *
+ * Nets nested in the net are defined before it, as in the grammar.
+ */
+static void
+read_net (EdifReader *r)
+{
+  GPtrArray *nodes = g_ptr_array_new_with_free_func (g_free);
+  char *name;
+  int token;
+
+  name = read_name_def (r, next_token (r));
+
+  while ((token = next_token (r)) != EDIF_CLOSE)
+    {
+      if (token == EDIF_EOF)
+        {
+          r->ended = true;
+          break;
+        }
+      if (token != EDIF_OPEN)
+        continue;
+      if (is_keyword (r, "joined"))
+        read_joined (r, nodes);
+      else if (is_keyword (r, "net"))
+        read_net (r);
+      else
+        read_list (r);
+    }
+
+  /* an array of nets has no name */
+  if (name && !r->ended)
+    define_net (name, nodes);
+  g_free (name);
+  g_ptr_array_free (nodes, TRUE);
+}
+
+/*!
+ * \brief Read the rest of a list, looking for nets in it.
+ */
+static void
+read_list (EdifReader *r)
+{
+  int token;
+
+  if (is_keyword (r, "net"))
+    {
+      read_net (r);
+      return;
+    }
+
+  while ((token = next_token (r)) != EDIF_CLOSE)
+    {
+      if (token == EDIF_EOF)
+        {
+          r->ended = true;
+          return;
+        }
+      if (token == EDIF_OPEN)
+        read_list (r);
+    }
+}
+
+/*!
+ * \brief Read the nets of an EDIF file into PCB->NetlistLib.
+ *
+ * \return 0 on success, 1 if the file can't be read.
+ */
+int
+ReadEdifNets (char *filename)
+{
+  EdifReader r;
+  int token;
+
+  if ((r.fp = fopen (filename, "r")) == NULL)
+    {
+      OpenErrorMessage (filename);
+      return 1;
+    }
+  r.text = g_string_new ("");
+  r.ended = false;
+
+  while (!r.ended && (token = next_token (&r)) != EDIF_EOF)
+    if (token == EDIF_OPEN)
+      read_list (&r);
+
+  if (r.ended)
+    Message (_("EDIF netlist %s ends inside a list\n"), filename);
+
+  g_string_free (r.text, TRUE);
+  fclose (r.fp);
+  return 0;
+}
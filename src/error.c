@@ -58,6 +58,7 @@
 #include "data.h"
 #include "error.h"
 #include "file.h"
+#include "job.h"
 
 #include "misc.h"
 
@@ -92,7 +93,8 @@ Message (const char *Format, ...)
 {
   va_list args;
   va_start (args, Format);
-  gui->logv (Format, args);
+  if (!pcb_job_logv (Format, args))
+    gui->logv (Format, args);
   va_end (args);
 }
 
@@ -77,17 +77,25 @@
 #include <unistd.h>
 #endif
 
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+
 
+#include "boardcache.h"
 #include "buffer.h"
 #include "change.h"
 #include "create.h"
 #include "crosshair.h"
 #include "data.h"
+#include "edif_nets.h"
 #include "edif_parse.h"
 #include "error.h"
 #include "file.h"
+#include "job.h"
 #include "hid.h"
 #include "layerflags.h"
+#include "libtree.h"
 #include "misc.h"
 #include "mymem.h"
 #include "parse_l.h"
@@ -97,11 +105,20 @@
 #include "remove.h"
 #include "set.h"
 #include "strflags.h"
+#include "timing.h"
 
 #ifdef HAVE_LIBDMALLOC
 #include <dmalloc.h>
 #endif
 
+/*!
+ * \brief stdio buffer for writing .pcb files.
+ *
+ * Saving writes many short pieces, a larger buffer than the default
+ * means fewer write () calls for a large board.
+ */
+#define WRITE_BUFFER_SIZE (256 * 1024)
+
 #if !defined(HAS_ATEXIT) && !defined(HAS_ON_EXIT)
 /* ---------------------------------------------------------------------------
  * some local identifiers for OS without an atexit() or on_exit()
@@ -125,7 +142,6 @@ static int WritePCB (FILE *);
 static int WritePCBFile (char *);
 static int WritePipe (char *, bool);
 static int ParseLibraryTree (void);
-static int LoadNewlibFootprintsFromDir(char *path, char *toppath, bool recursive);
 
 /* ---------------------------------------------------------------------------
  * Flag helper functions
@@ -407,14 +423,21 @@ set_some_route_style ()
  *
  * If revert is true, we pass "revert" as a parameter to the HID's
  * PCBChanged action.
+ *
+ * Parse reads the file into the new board, ParsePCB() for our own
+ * format.  A board imported from another format is named like the file
+ * with a .pcb suffix, so saving it doesn't overwrite the original, and
+ * is marked changed.
  */
 static int
-real_load_pcb (char *Filename, bool revert)
+real_load_pcb (char *Filename, bool revert, int (*parse) (PCBType *, char *))
 {
+  bool import = parse != ParsePCB;
   const char *unit_suffix, *grid_size;
   char *new_filename;
   PCBType *newPCB = CreateNewPCB ();
   PCBType *oldPCB;
+  int failed;
 #ifdef DEBUG
   double elapsed;
   clock_t start, end;
@@ -431,8 +454,14 @@ real_load_pcb (char *Filename, bool revert)
   newPCB->Font.Valid = false;
 
   /* new data isn't added to the undo list */
-  if (!ParsePCB (PCB, new_filename))
+  TIMING_BEGIN (TIMING_PARSE);
+  BoardCacheBegin (new_filename);
+  failed = parse (PCB, new_filename);
+  TIMING_END (TIMING_PARSE);
+  if (!failed)
     {
+      TIMING_BEGIN (TIMING_SETUP);
+      BoardCacheEnd (PCB->Data);
       RemovePCB (oldPCB);
 
       CreateNewPCBPost (PCB, 0);
@@ -456,8 +485,20 @@ real_load_pcb (char *Filename, bool revert)
 	}
 
       /* clear 'changed flag' */
-      SetChangedFlag (false);
-      PCB->Filename = new_filename;
+      SetChangedFlag (import);
+      if (import)
+        {
+          char *dot = strrchr (new_filename, '.');
+          char *sep = strrchr (new_filename, PCB_DIR_SEPARATOR_C);
+
+          if (dot && (!sep || dot > sep))
+            *dot = '\0';
+          PCB->Filename = Concat (new_filename, ".pcb", NULL);
+          free (new_filename);
+          new_filename = PCB->Filename;
+        }
+      else
+        PCB->Filename = new_filename;
       /* just in case a bad file saved file is loaded */
 
       /* Use attribute PCB::grid::unit as unit, if we can */
@@ -486,6 +527,7 @@ real_load_pcb (char *Filename, bool revert)
         hid_actionl ("PCBChanged", "revert", NULL);
       else
         hid_action ("PCBChanged");
+      TIMING_END (TIMING_SETUP);
 
 #ifdef DEBUG
       end = clock ();
@@ -496,6 +538,7 @@ real_load_pcb (char *Filename, bool revert)
 
       return (0);
     }
+  BoardCacheEnd (NULL);
   PCB = oldPCB;
   hid_action ("PCBChanged");
 
@@ -510,7 +553,19 @@ real_load_pcb (char *Filename, bool revert)
 int
 LoadPCB (char *file)
 {
-  return real_load_pcb (file, false);
+  return real_load_pcb (file, false, ParsePCB);
+}
+
+/*!
+ * \brief Load a board from a file in another format.
+ *
+ * \param parse reads the file into the board it is given, returning 0
+ * on success, like ParsePCB().
+ */
+int
+ImportPCB (char *file, int (*parse) (PCBType *, char *))
+{
+  return real_load_pcb (file, false, parse);
 }
 
 /*!
@@ -519,7 +574,7 @@ LoadPCB (char *file)
 int
 RevertPCB (void)
 {
-  return real_load_pcb (PCB->Filename, true);
+  return real_load_pcb (PCB->Filename, true, ParsePCB);
 }
 
 /*!
@@ -887,10 +942,10 @@ WriteBuffer (FILE * FP)
 }
 
 /*!
- * \brief Writes PCB to file.
+ * \brief Writes the PCB data, without any message.
  */
-static int
-WritePCB (FILE * FP)
+static void
+WritePCBData (FILE * FP)
 {
   Cardinal i;
   if (Settings.SaveMetricOnly)
@@ -908,6 +963,15 @@ WritePCB (FILE * FP)
   for (i = 0; i < max_copper_layer + SILK_LAYER; i++)
     WriteLayerData (FP, i, &(PCB->Data->Layer[i]));
   WritePCBNetlistData (FP);
+}
+
+/*!
+ * \brief Writes PCB to file.
+ */
+static int
+WritePCB (FILE * FP)
+{
+  WritePCBData (FP);
 
   if (ferror (FP))
     Message (_("Error writing PCB file\n"));
@@ -931,6 +995,7 @@ WritePCBFile (char *Filename)
       OpenErrorMessage (Filename);
       return (STATUS_ERROR);
     }
+  setvbuf (fp, NULL, _IOFBF, WRITE_BUFFER_SIZE);
   result = WritePCB (fp);
 
   if (ferror (fp))
@@ -962,6 +1027,7 @@ WritePipe (char *Filename, bool thePcb)
 	  Message ("Unable to write to file %s\n", Filename);
 	  return STATUS_ERROR;
 	}
+      setvbuf (fp, NULL, _IOFBF, WRITE_BUFFER_SIZE);
     }
   else
     {
@@ -1064,7 +1130,9 @@ static void
 backup_cb (hidval data)
 {
   backup_timer.ptr = NULL;
-  Backup ();
+  /* a background job may be changing the board, try again later */
+  if (!pcb_job_busy ())
+    Backup ();
   if (Settings.BackupInterval > 0 && gui->add_timer)
     backup_timer = gui->add_timer (backup_cb, 
 				   1000 * Settings.BackupInterval, data);
@@ -1089,12 +1157,81 @@ EnableAutosave (void)
 				   x);
 }
 
+#if defined(HAVE_SYS_WAIT_H) && !defined(HAVE__SPAWNVP)
+static pid_t backup_pid = 0;
+
+/*!
+ * \brief Writes the backup file from a child process.
+ *
+ * The forked child has a copy-on-write snapshot of the board, so it
+ * can take its time writing it while editing goes on.  It writes a
+ * temporary file and renames it over the backup once complete, uses
+ * none of the GUI and leaves with _exit (), so no atexit () handler
+ * runs in it.
+ *
+ * If the previous backup is still being written, this one is skipped.
+ *
+ * \return false if no child could be started and the caller has to
+ * write the backup itself.
+ */
+static bool
+BackupInBackground (char *filename)
+{
+  char *tmp;
+  FILE *fp;
+  pid_t pid;
+  int status, failed;
+
+  if (backup_pid > 0)
+    {
+      pid = waitpid (backup_pid, &status, WNOHANG);
+      if (pid == 0)
+        return true;
+      if (pid == backup_pid
+          && (!WIFEXITED (status) || WEXITSTATUS (status) != 0))
+        Message (_("Error writing PCB backup file %s\n"), filename);
+      backup_pid = 0;
+    }
+
+  tmp = Concat (filename, ".new", NULL);
+
+  /* Don't let the child inherit and flush our pending output. */
+  fflush (stdout);
+  fflush (stderr);
+
+  pid = fork ();
+  if (pid == 0)
+    {
+      if ((fp = fopen (tmp, "w")) == NULL)
+        _exit (1);
+      setvbuf (fp, NULL, _IOFBF, WRITE_BUFFER_SIZE);
+      WritePCBData (fp);
+      failed = ferror (fp);
+      if (fclose (fp) != 0 || failed || rename (tmp, filename) != 0)
+        {
+          unlink (tmp);
+          _exit (1);
+        }
+      _exit (0);
+    }
+  free (tmp);
+
+  if (pid < 0)
+    return false;
+  backup_pid = pid;
+  return true;
+}
+#endif
+
 /*!
  * \brief Creates a backup file.
  *
  * The default is to use the pcb file name with a "~" appended (like
  * "foo.pcb~") and if we don't have a pcb file name then use the
  * template in BACKUP_NAME.
+ *
+ * Where fork () is available the file is written by a child process, see
+ * BackupInBackground().
  */
 void
 Backup (void)
@@ -1123,6 +1260,13 @@ Backup (void)
       sprintf (filename, BACKUP_NAME, (int) getpid ());
     }
 
+#if defined(HAVE_SYS_WAIT_H) && !defined(HAVE__SPAWNVP)
+  if (BackupInBackground (filename))
+    {
+      free (filename);
+      return;
+    }
+#endif
   WritePCBFile (filename);
   free (filename);
 }
@@ -1153,194 +1297,12 @@ RemoveTMPData (void)
 }
 #endif
 
-/*!
- * \brief Parse the directory tree where newlib footprints are found.
- *
- * This is a helper function for ParseLibrary Tree.\n
- * Given a char *path, it finds all newlib footprints in that dir,
- * sticks them into the library menu structure named entry, and recurses
- * into subdirectories.
- */
-static int
-LoadNewlibFootprintsFromDir(char *libpath, char *toppath, bool recursive)
-{
-  char olddir[MAXPATHLEN + 1];    /* The directory we start out in (cwd) */
-  char subdir[MAXPATHLEN + 1];    /* The directory holding footprints to load */
-  DIR *subdirobj;                 /* Interable object holding all subdir entries */
-  struct dirent *subdirentry;     /* Individual subdir entry */
-  struct stat buffer;             /* Buffer used in stat */
-  LibraryMenuType *menu = NULL; /* Pointer to PCB's library menu structure */
-  LibraryEntryType *entry;      /* Pointer to individual menu entry */
-  size_t l;
-  size_t len;
-  int n_footprints = 0;           /* Running count of footprints found in this subdir */
-
-  /* Cache old dir, then cd into subdir because stat is given relative file names. */
-  memset (subdir, 0, sizeof subdir);
-  memset (olddir, 0, sizeof olddir);
-  if (GetWorkingDirectory (olddir) == NULL)
-    {
-      Message (_("LoadNewlibFootprintsFromDir: Could not determine initial working directory\n"));
-      return 0;
-    }
-
-  if (strcmp (libpath, "(local)") == 0)
-    strcpy (subdir, ".");
-  else
-    strcpy (subdir, libpath);
-
-  if (chdir (subdir))
-    {
-      ChdirErrorMessage (subdir);
-      return 0;
-    }
-
-  /* Determine subdir is abs path */
-  if (GetWorkingDirectory (subdir) == NULL)
-    {
-      Message (_("LoadNewlibFootprintsFromDir: Could not determine new working directory\n"));
-      if (chdir (olddir))
-        ChdirErrorMessage (olddir);
-      return 0;
-    }
-
-  /* First try opening the directory specified by path */
-  if ( (subdirobj = opendir (subdir)) == NULL )
-    {
-      OpendirErrorMessage (subdir);
-      if (chdir (olddir))
-        ChdirErrorMessage (olddir);
-      return 0;
-    }
-
-  /* Get pointer to memory holding menu */
-  menu = GetLibraryMenuMemory (&Library);
-  /* Populate menuname and path vars */
-  menu->Name = strdup (subdir);
-  menu->directory = strdup (toppath);
-
-  /* Now loop over files in this directory looking for files.
-   * We ignore certain files which are not footprints.
-   */
-  while ((subdirentry = readdir (subdirobj)) != NULL)
-  {
-#ifdef DEBUG_FILE_C
-/*    printf("...  Examining file %s ... \n", subdirentry->d_name); */
-#endif
-
-    /* Ignore non-footprint files found in this directory
-     * We're skipping .png and .html because those
-     * may exist in a library tree to provide an html browsable
-     * index of the library.
-     */
-    l = strlen (subdirentry->d_name);
-    if (!stat (subdirentry->d_name, &buffer) && S_ISREG (buffer.st_mode)
-      && subdirentry->d_name[0] != '.'
-      && NSTRCMP (subdirentry->d_name, "CVS") != 0
-      && NSTRCMP (subdirentry->d_name, "Makefile") != 0
-      && NSTRCMP (subdirentry->d_name, "Makefile.am") != 0
-      && NSTRCMP (subdirentry->d_name, "Makefile.in") != 0
-      && (l < 4 || NSTRCMP(subdirentry->d_name + (l - 4), ".png") != 0) 
-      && (l < 5 || NSTRCMP(subdirentry->d_name + (l - 5), ".html") != 0)
-      && (l < 4 || NSTRCMP(subdirentry->d_name + (l - 4), ".pcb") != 0) )
-      {
-#ifdef DEBUG_FILE_C
-/*	printf("...  Found a footprint %s ... \n", subdirentry->d_name); */
-#endif
-	n_footprints++;
-	entry = GetLibraryEntryMemory (menu);
-
-	/* 
-	 * entry->AllocatedMemory points to abs path to the footprint.
-	 * entry->ListEntry points to fp name itself.
-	 */
-	len = strlen(subdir) + strlen("/") + strlen(subdirentry->d_name) + 1;
-	entry->AllocatedMemory = (char *)calloc (1, len);
-	strcat (entry->AllocatedMemory, subdir);
-	strcat (entry->AllocatedMemory, PCB_DIR_SEPARATOR_S);
-
-	/* store pointer to start of footprint name */
-	entry->ListEntry = entry->AllocatedMemory
-	    + strlen (entry->AllocatedMemory);
-
-	/* Now place footprint name into AllocatedMemory */
-	strcat (entry->AllocatedMemory, subdirentry->d_name);
-
-	/* mark as directory tree (newlib) library */
-	entry->Template = (char *) -1;
-      }
-  }
-  closedir (subdirobj);
-
-  /* Don't recurse into relatively-specified directories--we might be
-     in the user's working directory, and the path might be "." */
-  if (!recursive) {
-    if (chdir (olddir))
-      ChdirErrorMessage (olddir);
-    return n_footprints;
-  }
-
-  /* Then open this dir so we can loop over its contents. */
-  if ((subdirobj = opendir (subdir)) == NULL)
-    {
-      OpendirErrorMessage (subdir);
-      if (chdir (olddir))
-        ChdirErrorMessage (olddir);
-      return 0;
-    }
-
-  /* Now loop over files in this directory looking for subdirs.
-   * For each direntry which is a valid subdirectory,
-   * try to load newlib footprints inside it.
-   */
-  while ((subdirentry = readdir (subdirobj)) != NULL)
-    {
-#ifdef DEBUG_FILE_C
-      printf("In ParseLibraryTree loop examining 2nd level direntry %s ... \n", subdirentry->d_name);
-#endif
-      /* Find subdirectories.  Ignore entries beginning with "." and CVS
-       * directories.
-       */
-      if (!stat (subdirentry->d_name, &buffer)
-	  && S_ISDIR (buffer.st_mode)
-	  && subdirentry->d_name[0] != '.'
-	  && NSTRCMP (subdirentry->d_name, "CVS") != 0)
-	{
-	  /* Found a valid subdirectory.  Try to load footprints from it.
-	   */
-	  char *subdir_path = (char *)calloc (
-	    1, strlen(subdir) + strlen("/") + strlen(subdirentry->d_name) + 1);
-	  if (subdir_path == NULL)
-	    {
-	      fprintf (stderr, "LoadNewlibFootprintsFromDir():  "
-			       "malloc failed\n");
-	      closedir (subdirobj);
-	      if (chdir (olddir))
-		ChdirErrorMessage (olddir);
-	      return n_footprints;
-	    }
-	  strcat (subdir_path, subdir);
-	  strcat (subdir_path, PCB_DIR_SEPARATOR_S);
-	  strcat (subdir_path, subdirentry->d_name);
-
-	  n_footprints += LoadNewlibFootprintsFromDir(subdir_path, toppath, true);
-	  free(subdir_path);
-	}
-    }
-  /* Done.  Clean up, cd back into old dir, and return */
-  closedir (subdirobj);
-  if (chdir (olddir))
-    ChdirErrorMessage (olddir);
-  return n_footprints;
-}
-
-
 /*!
  * \brief This function loads the newlib footprints into the Library.
  *
  * It examines all directories pointed to by Settings.LibraryTree.
- * It calls the subfunction LoadNewlibFootprintsFromDir to put the
- * footprints into PCB's internal datastructures.
+ * It calls LoadNewlibTree to put the footprints into PCB's internal
+ * datastructures.
  */
 static int
 ParseLibraryTree (void)
@@ -1381,6 +1343,7 @@ ParseLibraryTree (void)
         {
           ChdirErrorMessage (working);
           free (libpaths);
+          SaveNewlibIndex ();
           return 0;
         }
 
@@ -1416,7 +1379,7 @@ ParseLibraryTree (void)
 #endif
 
       /* Next read in any footprints in the top level dir and below */
-      n_footprints += LoadNewlibFootprintsFromDir("(local)", toppath, is_abs);
+      n_footprints += LoadNewlibTree (toppath, is_abs);
     }
 
   /* restore the original working directory */
@@ -1427,6 +1390,7 @@ ParseLibraryTree (void)
   printf("Leaving ParseLibraryTree, found %d footprints.\n", n_footprints);
 #endif
 
+  SaveNewlibIndex ();
   free (libpaths);
   return n_footprints;
 }
@@ -1544,6 +1508,29 @@ ReadLibraryContents (void)
   return (1);
 }
 
+/*!
+ * \brief Read the library the first time it is needed.
+ *
+ * Export runs don't read the library at startup, only the code which
+ * looks up footprints calls this.  The library is read once, and the
+ * GUI, if any, told about it.
+ */
+void
+LoadLibraryOnDemand (void)
+{
+  static bool loaded = false;
+  int failed;
+
+  if (loaded)
+    return;
+  loaded = true;
+  TIMING_BEGIN (TIMING_LIBRARY);
+  failed = ReadLibraryContents ();
+  TIMING_END (TIMING_LIBRARY);
+  if (!failed && Library.MenuN)
+    hid_action ("LibraryChanged");
+}
+
 #define BLANK(x) ((x) == ' ' || (x) == '\t' || (x) == '\n' \
 		|| (x) == '\0')
 
@@ -1700,6 +1687,8 @@ int ImportNetlist (char *filename)
 static int ReadEdifNetlist (char *filename)
 {
     Message (_("Importing edif netlist %s\n"), filename);
+    if (Settings.EdifStream)
+      return ReadEdifNets (filename);
     ParseEDIF(filename, NULL);
     
     return 0;
@@ -40,6 +40,7 @@ FILE *CheckAndOpenFile (char *, bool, bool, bool *, bool *);
 FILE *OpenConnectionDataFile (void);
 int SavePCB (char *);
 int LoadPCB (char *);
+int ImportPCB (char *, int (*) (PCBType *, char *));
 int RevertPCB (void);
 void EnableAutosave (void);
 void Backup (void);
@@ -47,6 +48,7 @@ void SaveInTMP (void);
 void EmergencySave (void);
 void DisableEmergencySave (void);
 int ReadLibraryContents (void);
+void LoadLibraryOnDemand (void);
 int ImportNetlist (char *);
 int SaveBufferElements (char *);
 void sort_netlist (void);
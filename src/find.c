@@ -92,6 +92,7 @@
 #include "rtree.h"
 #include "polygon.h"
 #include "pcb-printf.h"
+#include "profile.h"
 #include "search.h"
 #include "set.h"
 #include "undo.h"
@@ -134,6 +135,43 @@ static Coord Bloat = 0;
  */
 static bool drc = false; 
 
+/*!
+ * \brief When set, a DRC lookup goes on past the objects it did not find
+ * before, passing each of them to this instead of stopping at the first.
+ */
+static void (*drc_new_object) (int type, void *ptr1, void *ptr2, void *ptr3) = NULL;
+
+/*!
+ * \brief Whether the frontier of a lookup may be expanded on several
+ * threads, see LookupLOConnectionsParallel().
+ *
+ * This changes the order in which objects are added to the lists, so it
+ * is only enabled by callers that don't depend on it.
+ */
+static bool parallel_lookup = false;
+
+/*!
+ * \brief Whether lookups mark the objects they find with the current
+ * visit epoch instead of their flag, see NewVisitEpoch().
+ */
+static bool use_visit_epoch = false;
+
+/*!
+ * \brief The current visit epoch.
+ *
+ * In epoch mode an object counts as found if its Visit field equals the
+ * epoch, so forgetting all marks is a counter increment instead of a
+ * walk over every object of the board.
+ */
+static unsigned int visit_epoch = 0;
+
+/*!
+ * \brief Whether a lookup found an object, either by the lookup flag F
+ * or by the visit epoch.
+ */
+#define TEST_FOUND(F,P) \
+  (use_visit_epoch ? (P)->Visit == visit_epoch : TEST_FLAG ((F), (P)))
+
 /* ---------------------------------------------------------------------------
  * some local prototypes
  */
@@ -178,6 +216,51 @@ static Cardinal TotalP, TotalV;
 static ListType LineList[MAX_LAYER],    /*!< List of objects to. */
   PolygonList[MAX_LAYER], ArcList[MAX_LAYER], PadList[2], RatList, PVList;
 
+/*!
+ * \brief The pins and vias an rtree query returned for a line or pad,
+ * gathered to test them against it in one pass, see pv_batch_lookup().
+ *
+ * The candidates are kept as separate coordinate arrays, so the test in
+ * PointsInPad() runs over plain numbers.  Each array has room for
+ * TotalP + TotalV entries.
+ */
+static struct
+{
+  Cardinal group;               /*!< Layer group of the line or pad. */
+  Cardinal n;                   /*!< Number of candidates. */
+  PinType **pv;
+  Coord *x, *y, *radius;
+  bool *hit;
+} PVBatch;
+
+/*!
+ * \brief An object found by a worker thread of a parallel lookup, to be
+ * added to its list by the merge step.
+ */
+typedef struct
+{
+  ListType *list;
+  int type;
+  void *ptr1, *ptr2, *ptr3;
+} FoundObjectType;
+
+/*!
+ * \brief The GArray of FoundObjectType collecting the objects found by
+ * the current worker thread, NULL outside of the workers.
+ */
+static GPrivate found_objects = G_PRIVATE_INIT (NULL);
+
+/*!
+ * \brief Objects of a connectivity index that a lookup meets but does not
+ * follow, see ConnectionIndexAddObjects(), or NULL.
+ */
+static GHashTable *known_objects = NULL;
+
+/*!
+ * \brief The labels in known_objects of the objects the lookup met.
+ */
+static GArray *known_met = NULL;
+
 /*
  * Add an object to the specified list.
  *
@@ -189,12 +272,41 @@ static bool
 add_object_to_list (ListType *list, int type, void *ptr1, void *ptr2, void *ptr3, int flag)
 {
   AnyObjectType *object = (AnyObjectType *)ptr2;
+  GArray *found = g_private_get (&found_objects);
+
+  /* Worker threads only record what they find, the main thread adds it
+   * to the lists once they are done.
+   */
+  if (found)
+    {
+      FoundObjectType f = { list, type, ptr1, ptr2, ptr3 };
+      g_array_append_val (found, f);
+      return false;
+    }
 
   /* Set the appropriate flag to indicate the object appears in one of the
    * lists. This is how we later compare runs.
    */
-  AddObjectToFlagUndoList (type, ptr1, ptr2, ptr3);
-  SET_FLAG (flag, object);
+  if (use_visit_epoch)
+    object->Visit = visit_epoch;
+  else
+    {
+      AddObjectToFlagUndoList (type, ptr1, ptr2, ptr3);
+      SET_FLAG (flag, object);
+    }
+
+  /* Whatever a labelled object connects to is labelled already. */
+  if (known_objects != NULL)
+    {
+      int label = GPOINTER_TO_INT (g_hash_table_lookup (known_objects,
+                                                        object)) - 1;
+
+      if (label >= 0)
+        {
+          g_array_append_val (known_met, label);
+          return false;
+        }
+    }
 
   /* Add the object to the list. */  
   LIST_ENTRY (list, list->Number) = object;
@@ -214,10 +326,25 @@ add_object_to_list (ListType *list, int type, void *ptr1, void *ptr2, void *ptr3
    * how to use the SELECTEDFLAG.
    */
   if (drc && !TEST_FLAG (SELECTEDFLAG, object))
-    return (SetThing (2, type, ptr1, ptr2, ptr3));
+    {
+      if (drc_new_object == NULL)
+        return (SetThing (2, type, ptr1, ptr2, ptr3));
+      drc_new_object (type, ptr1, ptr2, ptr3);
+    }
   return false;
 }
 
+/*!
+ * \brief Have the DRC lookups pass every object they did not find
+ * before to the given function and go on, or, with NULL, stop at the
+ * first one again.
+ */
+void
+SetDRCCollect (void (*new_object) (int type, void *ptr1, void *ptr2, void *ptr3))
+{
+  drc_new_object = new_object;
+}
+
 static bool
 ADD_PV_TO_LIST (PinType *Pin, int flag)
 {
@@ -472,6 +599,11 @@ InitLayoutLookup (void)
   /* allocate memory for 'new PV to check' list and clear struct */
   PVList.Data = (void **)calloc (TotalP + TotalV, sizeof (PinType *));
   PVList.Size = TotalP + TotalV;
+  PVBatch.pv = (PinType **)calloc (TotalP + TotalV, sizeof (PinType *));
+  PVBatch.x = (Coord *)calloc (TotalP + TotalV, sizeof (Coord));
+  PVBatch.y = (Coord *)calloc (TotalP + TotalV, sizeof (Coord));
+  PVBatch.radius = (Coord *)calloc (TotalP + TotalV, sizeof (Coord));
+  PVBatch.hit = (bool *)calloc (TotalP + TotalV, sizeof (bool));
   PVList.Location = 0;
   PVList.DrawLocation = 0;
   PVList.Number = 0;
@@ -509,6 +641,12 @@ FreeLayoutLookupMemory (void)
     }
   free (PVList.Data);
   PVList.Data = NULL;
+  free (PVBatch.pv);
+  free (PVBatch.x);
+  free (PVBatch.y);
+  free (PVBatch.radius);
+  free (PVBatch.hit);
+  memset (&PVBatch, 0, sizeof (PVBatch));
   free (RatList.Data);
   RatList.Data = NULL;
 }
@@ -679,13 +817,15 @@ radius_crosses_arc (double x, double y, ArcType *arc)
   return (sa + d - 360) >= alpha;
 }
 
+/* The end points are kept with the arc by SetArcBoundingBox() and the
+   moves and rotations, so they need no trig here.  */
 static void
 get_arc_ends (Coord *box, ArcType *arc)
 {
-  box[0] = arc->X - arc->Width  * cos (M180 * arc->StartAngle);
-  box[1] = arc->Y + arc->Height * sin (M180 * arc->StartAngle);
-  box[2] = arc->X - arc->Width  * cos (M180 * (arc->StartAngle + arc->Delta));
-  box[3] = arc->Y + arc->Height * sin (M180 * (arc->StartAngle + arc->Delta));
+  box[0] = arc->Point1.X;
+  box[1] = arc->Point1.Y;
+  box[2] = arc->Point2.X;
+  box[3] = arc->Point2.Y;
 }
 
 /*!
@@ -867,6 +1007,31 @@ form_slanted_rectangle (PointType p[4], LineType *l)
     p[3].X = l->Point2.X + dwx + dwy; p[3].Y = l->Point2.Y + dwy - dwx;
 }
 
+/*!
+ * \brief Geometry of a line or pad used by the line intersection tests.
+ *
+ * A lookup computes it once for the object it searches from, rather
+ * than once for every candidate found by the rtree search.  It depends
+ * on Bloat, so it is only valid during one lookup.
+ */
+typedef struct
+{
+  LineType *line;
+  bool square;          /*!< Square ends, quad holds the outline. */
+  PointType quad[4];
+  Coord radius;         /*!< Bloated half thickness of the end caps. */
+} LineGeometryType;
+
+static void
+line_geometry (LineGeometryType *g, LineType *l)
+{
+  g->line = l;
+  g->square = TEST_FLAG (SQUAREFLAG, l);
+  if (g->square)
+    form_slanted_rectangle (g->quad, l);
+  g->radius = MAX (l->Thickness / 2 + Bloat, 0);
+}
+
 /*!
  * \brief Checks if two lines intersect.
  *
@@ -930,43 +1095,33 @@ form_slanted_rectangle (PointType p[4], LineType *l)
  * Also note that the denominators of eqn 1 & 2 are identical.
  * </pre>
  */
-bool
-LineLineIntersect (LineType *Line1, LineType *Line2)
+static bool
+line_geometry_intersect (const LineGeometryType *g1,
+                         const LineGeometryType *g2)
 {
+  LineType *Line1 = g1->line, *Line2 = g2->line;
   double s, r;
   double line1_dx, line1_dy, line2_dx, line2_dy,
          point1_dx, point1_dy;
-  if (TEST_FLAG (SQUAREFLAG, Line1))/* pretty reckless recursion */
-    {
-      PointType p[4];
-      form_slanted_rectangle (p, Line1);
-      return IsLineInQuadrangle (p, Line2);
-    }
+  if (g1->square)/* pretty reckless recursion */
+    return IsLineInQuadrangle ((PointType *) g1->quad, Line2);
   /* here come only round Line1 because IsLineInQuadrangle()
      calls LineLineIntersect() with first argument rounded*/
-  if (TEST_FLAG (SQUAREFLAG, Line2))
-    {
-      PointType p[4];
-      form_slanted_rectangle (p, Line2);
-      return IsLineInQuadrangle (p, Line1);
-    }
+  if (g2->square)
+    return IsLineInQuadrangle ((PointType *) g2->quad, Line1);
   /* now all lines are round */
 
   /* Check endpoints: this provides a quick exit, catches
    *  cases where the "real" lines don't intersect but the
    *  thick lines touch, and ensures that the dx/dy business
    *  below does not cause a divide-by-zero. */
-  if (IsPointInPad (Line2->Point1.X, Line2->Point1.Y,
-                    MAX (Line2->Thickness / 2 + Bloat, 0),
+  if (IsPointInPad (Line2->Point1.X, Line2->Point1.Y, g2->radius,
                     (PadType *) Line1)
-       || IsPointInPad (Line2->Point2.X, Line2->Point2.Y,
-                        MAX (Line2->Thickness / 2 + Bloat, 0),
+       || IsPointInPad (Line2->Point2.X, Line2->Point2.Y, g2->radius,
                         (PadType *) Line1)
-       || IsPointInPad (Line1->Point1.X, Line1->Point1.Y,
-                        MAX (Line1->Thickness / 2 + Bloat, 0),
+       || IsPointInPad (Line1->Point1.X, Line1->Point1.Y, g1->radius,
                         (PadType *) Line2)
-       || IsPointInPad (Line1->Point2.X, Line1->Point2.Y,
-                        MAX (Line1->Thickness / 2 + Bloat, 0),
+       || IsPointInPad (Line1->Point2.X, Line1->Point2.Y, g1->radius,
                         (PadType *) Line2))
     return true;
 
@@ -1010,6 +1165,46 @@ LineLineIntersect (LineType *Line1, LineType *Line2)
   return false;
 }
 
+/*!
+ * \brief LineLineIntersect() with the geometry of Line1 precomputed.
+ */
+static bool
+intersect_geometry_line (const LineGeometryType *g1, LineType *Line2)
+{
+  LineGeometryType g2;
+
+  /* The outline of Line2 isn't needed in this case. */
+  if (g1->square)
+    return IsLineInQuadrangle ((PointType *) g1->quad, Line2);
+  line_geometry (&g2, Line2);
+  return line_geometry_intersect (g1, &g2);
+}
+
+/*!
+ * \brief LineLineIntersect() with the geometry of Line2 precomputed.
+ */
+static bool
+intersect_line_geometry (LineType *Line1, const LineGeometryType *g2)
+{
+  LineGeometryType g1;
+
+  line_geometry (&g1, Line1);
+  return line_geometry_intersect (&g1, g2);
+}
+
+/*!
+ * \brief Checks if two lines intersect, see line_geometry_intersect().
+ */
+bool
+LineLineIntersect (LineType *Line1, LineType *Line2)
+{
+  LineGeometryType g1, g2;
+
+  line_geometry (&g1, Line1);
+  line_geometry (&g2, Line2);
+  return line_geometry_intersect (&g1, &g2);
+}
+
 /*!
  * \brief Check for line intersection with an arc.
  *
@@ -1070,7 +1265,6 @@ bool
 LineArcIntersect (LineType *Line, ArcType *Arc)
 {
   double dx, dy, dx1, dy1, l, d, r, r2, Radius;
-  BoxType *box;
 
   dx = Line->Point2.X - Line->Point1.X;
   dy = Line->Point2.Y - Line->Point1.Y;
@@ -1144,10 +1338,9 @@ LineArcIntersect (LineType *Line, ArcType *Arc)
     return (true);
 
   /* check arc end points */
-  box = GetArcEnds (Arc);
-  if (IsPointInPad (box->X1, box->Y1, Arc->Thickness * 0.5 + Bloat, (PadType *)Line))
+  if (IsPointInPad (Arc->Point1.X, Arc->Point1.Y, Arc->Thickness * 0.5 + Bloat, (PadType *)Line))
     return true;
-  if (IsPointInPad (box->X2, box->Y2, Arc->Thickness * 0.5 + Bloat, (PadType *)Line))
+  if (IsPointInPad (Arc->Point2.X, Arc->Point2.Y, Arc->Thickness * 0.5 + Bloat, (PadType *)Line))
     return true;
   return false;
 }
@@ -1197,6 +1390,7 @@ IsLineInPolygon (LineType *Line, PolygonType *Polygon)
 {
   BoxType *Box = (BoxType *) Line;
   POLYAREA *lp;
+  Vector p1, p2;
 
   /* lines with clearance never touch polygons */
   if (TEST_FLAG (CLEARPOLYFLAG, Polygon) && TEST_FLAG (CLEARLINEFLAG, Line))
@@ -1223,6 +1417,20 @@ IsLineInPolygon (LineType *Line, PolygonType *Polygon)
       && Box->Y1 <= Polygon->Clipped->contours->ymax + Bloat
       && Box->Y2 >= Polygon->Clipped->contours->ymin - Bloat)
     {
+      if (Line->Thickness + Bloat <= 0)
+        return false;
+      if (!TEST_FLAG (SQUAREFLAG, Line))
+        {
+          /* A round ended line is a distance test against the edges
+           * near it, found with the segment trees of the contours.
+           */
+          p1[0] = Line->Point1.X;
+          p1[1] = Line->Point1.Y;
+          p2[0] = Line->Point2.X;
+          p2[1] = Line->Point2.Y;
+          return poly_M_SegmentTouches (Polygon->Clipped, p1, p2,
+                                        (Line->Thickness + Bloat + 1) / 2);
+        }
       if (!(lp = LinePoly (Line, Line->Thickness + Bloat)))
         return FALSE;           /* error */
       return isects (lp, Polygon, true);
@@ -1366,7 +1574,7 @@ LOCtoPVline_callback (const BoxType * b, void *cl)
   if (!ViaIsOnLayerGroup (i->pv, GetLayerGroupNumberByNumber (i->layer)))
     return 0;
 
-  if (!TEST_FLAG (i->flag, line) && PinLineIntersect (i->pv, line) &&
+  if (!TEST_FOUND (i->flag, line) && PinLineIntersect (i->pv, line) &&
       !TEST_FLAG (HOLEFLAG, i->pv))
     {
       if (ADD_LINE_TO_LIST (i->layer, line, i->flag))
@@ -1384,7 +1592,7 @@ LOCtoPVarc_callback (const BoxType * b, void *cl)
   if (!ViaIsOnLayerGroup (i->pv, GetLayerGroupNumberByNumber (i->layer)))
     return 0;
 
-  if (!TEST_FLAG (i->flag, arc) && IS_PV_ON_ARC (i->pv, arc) &&
+  if (!TEST_FOUND (i->flag, arc) && IS_PV_ON_ARC (i->pv, arc) &&
       !TEST_FLAG (HOLEFLAG, i->pv))
     {
       if (ADD_ARC_TO_LIST (i->layer, arc, i->flag))
@@ -1402,7 +1610,7 @@ LOCtoPVpad_callback (const BoxType * b, void *cl)
   if (!ViaIsOnLayerGroup (i->pv, GetLayerGroupNumberBySide (TEST_FLAG (ONSOLDERFLAG, pad) ? BOTTOM_SIDE : TOP_SIDE)))
     return 0;
 
-  if (!TEST_FLAG (i->flag, pad) && IS_PV_ON_PAD (i->pv, pad) &&
+  if (!TEST_FOUND (i->flag, pad) && IS_PV_ON_PAD (i->pv, pad) &&
       !TEST_FLAG (HOLEFLAG, i->pv) &&
       ADD_PAD_TO_LIST (TEST_FLAG (ONSOLDERFLAG, pad) ? BOTTOM_SIDE :
                        TOP_SIDE, pad, i->flag))
@@ -1416,7 +1624,7 @@ LOCtoPVrat_callback (const BoxType * b, void *cl)
   RatType *rat = (RatType *) b;
   struct pv_info *i = (struct pv_info *) cl;
 
-  if (!TEST_FLAG (i->flag, rat) && IS_PV_ON_RAT (i->pv, rat) &&
+  if (!TEST_FOUND (i->flag, rat) && IS_PV_ON_RAT (i->pv, rat) &&
       ADD_RAT_TO_LIST (rat, i->flag))
     longjmp (i->env, 1);
   return 0;
@@ -1437,7 +1645,7 @@ LOCtoPVpoly_callback (const BoxType * b, void *cl)
    * because it might not be inside the polygon, or it could
    * be on an edge such that it doesn't actually touch.
    */
-  if (!TEST_FLAG (i->flag, polygon) && !TEST_FLAG (HOLEFLAG, i->pv) 
+  if (!TEST_FOUND (i->flag, polygon) && !TEST_FLAG (HOLEFLAG, i->pv) 
        && (TEST_THERM (i->layer, i->pv) 
            || !TEST_FLAG (CLEARPOLYFLAG, polygon)
            || !i->pv->Clearance)
@@ -1525,6 +1733,198 @@ LookupLOConnectionsToPVList (int flag, bool AndRats)
   return false;
 }
 
+/*!
+ * \brief The frontier wave of a parallel lookup, see
+ * LookupLOConnectionsParallel().
+ */
+typedef struct
+{
+  int flag;
+  bool AndRats;
+  Cardinal start_line[MAX_LAYER], start_arc[MAX_LAYER],
+    start_poly[MAX_LAYER], start_pad[2];
+  Cardinal end_line[MAX_LAYER], end_arc[MAX_LAYER],
+    end_poly[MAX_LAYER], end_pad[2];
+  gint pending;                 /*!< Groups not done yet. */
+  GMutex lock;
+  GCond done;
+} LookupWaveType;
+
+/*!
+ * \brief The part of a wave in one layer group.
+ */
+typedef struct
+{
+  LookupWaveType *wave;
+  Cardinal group;
+  GArray *found;                /*!< FoundObjectType. */
+} LookupWaveJobType;
+
+/*!
+ * \brief Minimum number of frontier objects worth distributing over
+ * threads.
+ */
+#define PARALLEL_LOOKUP_MIN 64
+
+static GThreadPool *lookup_pool = NULL;
+
+/*!
+ * \brief Look up the connections of the frontier objects of one layer
+ * group, on a worker thread.
+ *
+ * The objects found are only recorded, so the workers just read the
+ * board, its rtrees and the lists.  The one exception is the contour
+ * labelling that Touching() does on the polygons it tests; as every
+ * object is only tested against objects of its own layer group, no
+ * polygon is ever tested by two workers at once.
+ */
+static void
+LookupWaveWorker (gpointer data, gpointer user_data)
+{
+  LookupWaveJobType *job = (LookupWaveJobType *) data;
+  LookupWaveType *wave = job->wave;
+  Cardinal entry, group = job->group, i;
+
+  g_private_set (&found_objects, job->found);
+  for (entry = 0; entry < PCB->LayerGroups.Number[group]; entry++)
+    {
+      Cardinal layer = PCB->LayerGroups.Entries[group][entry];
+
+      if (layer < max_copper_layer)
+        {
+          for (i = wave->start_line[layer]; i < wave->end_line[layer]; i++)
+            LookupLOConnectionsToLine (LINELIST_ENTRY (layer, i), group,
+                                       wave->flag, true, wave->AndRats);
+          for (i = wave->start_arc[layer]; i < wave->end_arc[layer]; i++)
+            LookupLOConnectionsToArc (ARCLIST_ENTRY (layer, i), group,
+                                      wave->flag, wave->AndRats);
+          for (i = wave->start_poly[layer]; i < wave->end_poly[layer]; i++)
+            LookupLOConnectionsToPolygon (POLYGONLIST_ENTRY (layer, i), group,
+                                          wave->flag, wave->AndRats);
+        }
+      else if ((layer -= max_copper_layer) < 2)
+        {
+          for (i = wave->start_pad[layer]; i < wave->end_pad[layer]; i++)
+            LookupLOConnectionsToPad (PADLIST_ENTRY (layer, i), group,
+                                      wave->flag, wave->AndRats);
+        }
+    }
+  g_private_set (&found_objects, NULL);
+
+  g_mutex_lock (&wave->lock);
+  if (--wave->pending == 0)
+    g_cond_signal (&wave->done);
+  g_mutex_unlock (&wave->lock);
+}
+
+/*!
+ * \brief Expand the current frontier of the LO lists on all layer groups
+ * concurrently.
+ *
+ * The layer groups of a wave are independent: every worker searches the
+ * rtrees for the objects touching the frontier of its group and collects
+ * them privately.  The merge step then adds the objects not found before
+ * to the lists, in layer group order.  Objects that the serial loop
+ * would have found later in the same wave show up in the next one, so
+ * the lists end up with the same contents in a different order.
+ *
+ * \return false, without doing anything, if the frontier is too small to
+ * be worth it, threads are not available or a DRC is running.
+ */
+static bool
+LookupLOConnectionsParallel (int flag, bool AndRats,
+                             Cardinal *lineposition, Cardinal *arcposition,
+                             Cardinal *polyposition, Cardinal *padposition)
+{
+  LookupWaveType wave;
+  LookupWaveJobType jobs[MAX_GROUP];
+  Cardinal i, group, frontier = 0;
+
+  if (!parallel_lookup || drc || max_group < 2)
+    return false;
+
+  for (i = 0; i < max_copper_layer; i++)
+    frontier += LineList[i].Number - lineposition[i]
+                + ArcList[i].Number - arcposition[i]
+                + PolygonList[i].Number - polyposition[i];
+  for (i = 0; i < 2; i++)
+    frontier += PadList[i].Number - padposition[i];
+  if (frontier < PARALLEL_LOOKUP_MIN)
+    return false;
+
+  if (lookup_pool == NULL)
+    {
+      if (g_get_num_processors () < 2)
+        return false;
+      lookup_pool = g_thread_pool_new (LookupWaveWorker, NULL,
+                                       g_get_num_processors (), TRUE, NULL);
+    }
+
+  wave.flag = flag;
+  wave.AndRats = AndRats;
+  for (i = 0; i < max_copper_layer; i++)
+    {
+      wave.start_line[i] = lineposition[i];
+      wave.start_arc[i] = arcposition[i];
+      wave.start_poly[i] = polyposition[i];
+      wave.end_line[i] = LineList[i].Number;
+      wave.end_arc[i] = ArcList[i].Number;
+      wave.end_poly[i] = PolygonList[i].Number;
+    }
+  for (i = 0; i < 2; i++)
+    {
+      wave.start_pad[i] = padposition[i];
+      wave.end_pad[i] = PadList[i].Number;
+    }
+  wave.pending = max_group;
+  g_mutex_init (&wave.lock);
+  g_cond_init (&wave.done);
+
+  r_begin_shared_read ();
+  for (group = 0; group < max_group; group++)
+    {
+      jobs[group].wave = &wave;
+      jobs[group].group = group;
+      jobs[group].found = g_array_new (FALSE, FALSE, sizeof (FoundObjectType));
+      g_thread_pool_push (lookup_pool, &jobs[group], NULL);
+    }
+
+  g_mutex_lock (&wave.lock);
+  while (wave.pending > 0)
+    g_cond_wait (&wave.done, &wave.lock);
+  g_mutex_unlock (&wave.lock);
+  r_end_shared_read ();
+  g_mutex_clear (&wave.lock);
+  g_cond_clear (&wave.done);
+
+  /* The whole wave has been looked at. */
+  for (i = 0; i < max_copper_layer; i++)
+    {
+      lineposition[i] = wave.end_line[i];
+      arcposition[i] = wave.end_arc[i];
+      polyposition[i] = wave.end_poly[i];
+    }
+  for (i = 0; i < 2; i++)
+    padposition[i] = wave.end_pad[i];
+
+  /* Merge, skipping what several workers (or frontier objects) found. */
+  for (group = 0; group < max_group; group++)
+    {
+      GArray *found = jobs[group].found;
+
+      for (i = 0; i < found->len; i++)
+        {
+          FoundObjectType *f = &g_array_index (found, FoundObjectType, i);
+
+          if (!TEST_FOUND (flag, (AnyObjectType *) f->ptr2))
+            add_object_to_list (f->list, f->type, f->ptr1, f->ptr2, f->ptr3,
+                                flag);
+        }
+      g_array_free (found, TRUE);
+    }
+  return true;
+}
+
 /*!
  * \brief Find all connections between LO at the current list position
  * and new LOs.
@@ -1572,7 +1972,9 @@ LookupLOConnectionsToLOList (int flag, bool AndRats)
           return (true);
        }
      }
-     /* loop over all layergroups */
+     /* loop over all layergroups, on several threads if worthwhile */
+     if (!LookupLOConnectionsParallel (flag, AndRats, lineposition,
+                                       arcposition, polyposition, padposition))
      for (group = 0; group < max_group; group++)
      {
        Cardinal entry;
@@ -1670,31 +2072,19 @@ pv_pv_callback (const BoxType * b, void *cl)
   /* Cast the object found by the r_search, it's known to be a pin */
   PinType *pin = (PinType *) b;
   struct pv_info *i = (struct pv_info *) cl;
-  bool pv_overlap = false;
-  Cardinal l;
 
-  /* If both vias are buried, check if the layers of the found via (pin)
-   * overlap with the layers of the original via (i->pv).
+  /* If both vias are buried, check if the layer groups of the found via
+   * (pin) overlap with those of the original via (i->pv).
    *
    * TODO: Why isn't PinPinIntersect called here?
    * TODO: Why aren't we checking the other flags, like we do below?
    */
-  if (VIA_IS_BURIED (pin) && VIA_IS_BURIED (i->pv))
-    {
-      for (l = pin->BuriedFrom ; l <= pin->BuriedTo; l++)
-        {
-	   if (ViaIsOnLayerGroup (i->pv, GetLayerGroupNumberByNumber (l)))
-	     {
-	       pv_overlap = true;
-	       break;
-	     }
-	}
-      if (!pv_overlap)
-	return 0;
-    }
+  if (VIA_IS_BURIED (pin) && VIA_IS_BURIED (i->pv)
+      && !(ViaLayerGroupMask (pin) & ViaLayerGroupMask (i->pv)))
+    return 0;
 
   /* If either of the vias is a thru via, there is potential overlap. */
-  if (!TEST_FLAG (i->flag, pin) && PV_TOUCH_PV (i->pv, pin))
+  if (!TEST_FOUND (i->flag, pin) && PV_TOUCH_PV (i->pv, pin))
     {
 	  /* If it's only a hole (no copper) then just issue a warning to the
 	   * log, and highlight the pin. It doesn't affect the netlist.
@@ -1762,6 +2152,7 @@ struct lo_info
   Cardinal layer;
   LineType *line;
   PadType *pad;
+  LineGeometryType geom;        /*!< Of line or pad. */
   ArcType *arc;
   PolygonType *polygon;
   RatType *rat;
@@ -1769,50 +2160,79 @@ struct lo_info
   jmp_buf env;
 };
 
+/*!
+ * \brief Gather the pins and vias an rtree query returns into PVBatch.
+ */
 static int
-pv_line_callback (const BoxType * b, void *cl)
+pv_gather_callback (const BoxType * b, void *cl)
 {
   PinType *pv = (PinType *) b;
   struct lo_info *i = (struct lo_info *) cl;
 
-  if (!ViaIsOnLayerGroup (pv, GetLayerGroupNumberByNumber (i->layer)))
+  if (!ViaIsOnLayerGroup (pv, PVBatch.group) || TEST_FOUND (i->flag, pv))
     return 0;
 
-  if (!TEST_FLAG (i->flag, pv) && PinLineIntersect (pv, i->line))
-    {
-      if (TEST_FLAG (HOLEFLAG, pv))
-        {
-          SET_FLAG (WARNFLAG, pv);
-          Settings.RatWarn = true;
-          Message (_("WARNING: Hole too close to line.\n"));
-        }
-      else if (ADD_PV_TO_LIST (pv, i->flag))
-        longjmp (i->env, 1);
-    }
+  PVBatch.pv[PVBatch.n] = pv;
+  PVBatch.x[PVBatch.n] = pv->X;
+  PVBatch.y[PVBatch.n] = pv->Y;
+  PVBatch.n++;
   return 0;
 }
 
-static int
-pv_pad_callback (const BoxType * b, void *cl)
+/*!
+ * \brief Look up the pins and vias of tree touching Pad, which is a line
+ * when Line is true.
+ *
+ * The candidates are gathered first and then tested against the line
+ * or pad in one pass, which computes its transformation only once.
+ * They are added to the list in the order the search returned them.
+ *
+ * \return true if the DRC found a violation.
+ */
+static bool
+pv_batch_lookup (rtree_t *tree, BoxType *search_box, PadType *Pad, bool Line,
+                 struct lo_info *i)
 {
-  PinType *pv = (PinType *) b;
-  struct lo_info *i = (struct lo_info *) cl;
+  Cardinal k;
 
-  if (!ViaIsOnLayerGroup (pv, GetLayerGroupNumberBySide (i->layer)))
-    return 0;
+  PVBatch.n = 0;
+  r_search (tree, search_box, NULL, pv_gather_callback, i);
+  if (PVBatch.n == 0)
+    return false;
 
-  if (!TEST_FLAG (i->flag, pv) && IS_PV_ON_PAD (pv, i->pad))
+  for (k = 0; k < PVBatch.n; k++)
     {
+      PinType *pv = PVBatch.pv[k];
+
+      if (Line)
+        PVBatch.radius[k] = MAX (PIN_SIZE (pv) / 2.0 + Bloat, 0.0);
+      else
+        PVBatch.radius[k] = MAX (pv->Thickness / 2 + Bloat, 0);
+    }
+  PointsInPad (PVBatch.x, PVBatch.y, PVBatch.radius, PVBatch.hit,
+               PVBatch.n, Pad);
+
+  for (k = 0; k < PVBatch.n; k++)
+    {
+      PinType *pv = PVBatch.pv[k];
+
+      /* square pins are checked against their outline at lines */
+      if (Line && TEST_FLAG (SQUAREFLAG, pv))
+        PVBatch.hit[k] = PinLineIntersect (pv, (LineType *) Pad);
+      if (!PVBatch.hit[k])
+        continue;
+
       if (TEST_FLAG (HOLEFLAG, pv))
         {
           SET_FLAG (WARNFLAG, pv);
           Settings.RatWarn = true;
-          Message (_("WARNING: Hole too close to pad.\n"));
+          Message (Line ? _("WARNING: Hole too close to line.\n")
+                      : _("WARNING: Hole too close to pad.\n"));
         }
       else if (ADD_PV_TO_LIST (pv, i->flag))
-        longjmp (i->env, 1);
+        return true;
     }
-  return 0;
+  return false;
 }
 
 static int
@@ -1824,7 +2244,7 @@ pv_arc_callback (const BoxType * b, void *cl)
   if (!ViaIsOnLayerGroup (pv, GetLayerGroupNumberByNumber (i->layer)))
     return 0;
 
-  if (!TEST_FLAG (i->flag, pv) && IS_PV_ON_ARC (pv, i->arc))
+  if (!TEST_FOUND (i->flag, pv) && IS_PV_ON_ARC (pv, i->arc))
     {
       if (TEST_FLAG (HOLEFLAG, pv))
         {
@@ -1848,7 +2268,7 @@ pv_poly_callback (const BoxType * b, void *cl)
     return 0;
 
   /* note that holes in polygons are ok, so they don't generate warnings. */
-  if (!TEST_FLAG (i->flag, pv) && !TEST_FLAG (HOLEFLAG, pv) &&
+  if (!TEST_FOUND (i->flag, pv) && !TEST_FLAG (HOLEFLAG, pv) &&
                                   (TEST_THERM (i->layer, pv) ||
                                    !TEST_FLAG (CLEARPOLYFLAG, i->polygon) ||
                                    !pv->Clearance))
@@ -1888,7 +2308,7 @@ pv_rat_callback (const BoxType * b, void *cl)
   struct lo_info *i = (struct lo_info *) cl;
 
   /* rats can't cause DRC so there is no early exit */
-  if (!TEST_FLAG (i->flag, pv) && IS_PV_ON_RAT (pv, i->rat))
+  if (!TEST_FOUND (i->flag, pv) && IS_PV_ON_RAT (pv, i->rat))
     ADD_PV_TO_LIST (pv, i->flag);
   return 0;
 }
@@ -1935,15 +2355,11 @@ LookupPVConnectionsToLOList (int flag, bool AndRats)
           
           search_box = expand_bounds ((BoxType *)info.line);
 
-          if (setjmp (info.env) == 0)
-            r_search (PCB->Data->via_tree, &search_box, NULL,
-                      pv_line_callback, &info);
-          else
-            return true;
-          if (setjmp (info.env) == 0)
-            r_search (PCB->Data->pin_tree, &search_box, NULL,
-                      pv_line_callback, &info);
-          else
+          PVBatch.group = GetLayerGroupNumberByNumber (layer_no);
+          if (pv_batch_lookup (PCB->Data->via_tree, &search_box,
+                               (PadType *) info.line, true, &info)
+              || pv_batch_lookup (PCB->Data->pin_tree, &search_box,
+                                  (PadType *) info.line, true, &info))
             return true;
           LineList[layer_no].Location++;
         }
@@ -2025,15 +2441,11 @@ LookupPVConnectionsToLOList (int flag, bool AndRats)
           
           search_box = expand_bounds ((BoxType *)info.pad);
 
-          if (setjmp (info.env) == 0)
-            r_search (PCB->Data->via_tree, &search_box, NULL,
-                      pv_pad_callback, &info);
-          else
-            return true;
-          if (setjmp (info.env) == 0)
-            r_search (PCB->Data->pin_tree, &search_box, NULL,
-                      pv_pad_callback, &info);
-          else
+          PVBatch.group = GetLayerGroupNumberBySide (layer_no);
+          if (pv_batch_lookup (PCB->Data->via_tree, &search_box,
+                               info.pad, false, &info)
+              || pv_batch_lookup (PCB->Data->pin_tree, &search_box,
+                                  info.pad, false, &info))
             return true;
           PadList[layer_no].Location++;
         }
@@ -2071,7 +2483,7 @@ LOCtoArcLine_callback (const BoxType * b, void *cl)
   LineType *line = (LineType *) b;
   struct lo_info *i = (struct lo_info *) cl;
 
-  if (!TEST_FLAG (i->flag, line) && LineArcIntersect (line, i->arc))
+  if (!TEST_FOUND (i->flag, line) && LineArcIntersect (line, i->arc))
     {
       if (ADD_LINE_TO_LIST (i->layer, line, i->flag))
         longjmp (i->env, 1);
@@ -2087,7 +2499,7 @@ LOCtoArcArc_callback (const BoxType * b, void *cl)
 
   if (!arc->Thickness)
     return 0;
-  if (!TEST_FLAG (i->flag, arc) && ArcArcIntersect (i->arc, arc))
+  if (!TEST_FOUND (i->flag, arc) && ArcArcIntersect (i->arc, arc))
     {
       if (ADD_ARC_TO_LIST (i->layer, arc, i->flag))
         longjmp (i->env, 1);
@@ -2101,7 +2513,7 @@ LOCtoArcPad_callback (const BoxType * b, void *cl)
   PadType *pad = (PadType *) b;
   struct lo_info *i = (struct lo_info *) cl;
 
-  if (!TEST_FLAG (i->flag, pad) && i->layer ==
+  if (!TEST_FOUND (i->flag, pad) && i->layer ==
       (TEST_FLAG (ONSOLDERFLAG, pad) ? BOTTOM_SIDE : TOP_SIDE)
       && ArcPadIntersect (i->arc, pad) && ADD_PAD_TO_LIST (i->layer, pad, i->flag))
     longjmp (i->env, 1);
@@ -2161,7 +2573,7 @@ LookupLOConnectionsToArc (ArcType *Arc, Cardinal LayerGroup, int flag, bool AndR
           for (i = layer->Polygon; i != NULL; i = g_list_next (i))
             {
               PolygonType *polygon = i->data;
-              if (!TEST_FLAG (flag, polygon) && IsArcInPolygon (Arc, polygon)
+              if (!TEST_FOUND (flag, polygon) && IsArcInPolygon (Arc, polygon)
                   && ADD_POLYGON_TO_LIST (layer_no, polygon, flag))
                 return true;
             }
@@ -2185,7 +2597,7 @@ LOCtoLineLine_callback (const BoxType * b, void *cl)
   LineType *line = (LineType *) b;
   struct lo_info *i = (struct lo_info *) cl;
 
-  if (!TEST_FLAG (i->flag, line) && LineLineIntersect (i->line, line))
+  if (!TEST_FOUND (i->flag, line) && intersect_geometry_line (&i->geom, line))
     {
       if (ADD_LINE_TO_LIST (i->layer, line, i->flag))
         longjmp (i->env, 1);
@@ -2201,7 +2613,7 @@ LOCtoLineArc_callback (const BoxType * b, void *cl)
 
   if (!arc->Thickness)
     return 0;
-  if (!TEST_FLAG (i->flag, arc) && LineArcIntersect (i->line, arc))
+  if (!TEST_FOUND (i->flag, arc) && LineArcIntersect (i->line, arc))
     {
       if (ADD_ARC_TO_LIST (i->layer, arc, i->flag))
         longjmp (i->env, 1);
@@ -2215,7 +2627,7 @@ LOCtoLineRat_callback (const BoxType * b, void *cl)
   RatType *rat = (RatType *) b;
   struct lo_info *i = (struct lo_info *) cl;
 
-  if (!TEST_FLAG (i->flag, rat))
+  if (!TEST_FOUND (i->flag, rat))
     {
       if ((rat->group1 == i->layer)
           && IsRatPointOnLineEnd (&rat->Point1, i->line))
@@ -2239,9 +2651,10 @@ LOCtoLinePad_callback (const BoxType * b, void *cl)
   PadType *pad = (PadType *) b;
   struct lo_info *i = (struct lo_info *) cl;
 
-  if (!TEST_FLAG (i->flag, pad) && i->layer ==
+  if (!TEST_FOUND (i->flag, pad) && i->layer ==
       (TEST_FLAG (ONSOLDERFLAG, pad) ? BOTTOM_SIDE : TOP_SIDE)
-      && LinePadIntersect (i->line, pad) && ADD_PAD_TO_LIST (i->layer, pad, i->flag))
+      && intersect_geometry_line (&i->geom, (LineType *) pad)
+      && ADD_PAD_TO_LIST (i->layer, pad, i->flag))
     longjmp (i->env, 1);
   return 0;
 }
@@ -2266,6 +2679,7 @@ LookupLOConnectionsToLine (LineType *Line, Cardinal LayerGroup,
   info.flag = flag;
   info.layer = LayerGroup;
   info.line = Line;
+  line_geometry (&info.geom, Line);
   search_box = expand_bounds ((BoxType *)info.line);
 
   if (AndRats)
@@ -2314,7 +2728,7 @@ LookupLOConnectionsToLine (LineType *Line, Cardinal LayerGroup,
               for (i = layer->Polygon; i != NULL; i = g_list_next (i))
                 {
                   PolygonType *polygon = i->data;
-                  if (!TEST_FLAG (flag, polygon) && IsLineInPolygon (Line, polygon)
+                  if (!TEST_FOUND (flag, polygon) && IsLineInPolygon (Line, polygon)
                       && ADD_POLYGON_TO_LIST (layer_no, polygon, flag))
                     return true;
                 }
@@ -2348,7 +2762,7 @@ LOCtoRat_callback (const BoxType * b, void *cl)
   LineType *line = (LineType *) b;
   struct rat_info *i = (struct rat_info *) cl;
 
-  if (!TEST_FLAG (i->flag, line) &&
+  if (!TEST_FOUND (i->flag, line) &&
       ((line->Point1.X == i->Point->X &&
         line->Point1.Y == i->Point->Y) ||
        (line->Point2.X == i->Point->X && line->Point2.Y == i->Point->Y)))
@@ -2364,7 +2778,7 @@ PolygonToRat_callback (const BoxType * b, void *cl)
   PolygonType *polygon = (PolygonType *) b;
   struct rat_info *i = (struct rat_info *) cl;
 
-  if (!TEST_FLAG (i->flag, polygon) && polygon->Clipped &&
+  if (!TEST_FOUND (i->flag, polygon) && polygon->Clipped &&
       (i->Point->X == polygon->Clipped->contours->head.point[0]) &&
       (i->Point->Y == polygon->Clipped->contours->head.point[1]))
     {
@@ -2380,7 +2794,7 @@ LOCtoPad_callback (const BoxType * b, void *cl)
   PadType *pad = (PadType *) b;
   struct rat_info *i = (struct rat_info *) cl;
 
-  if (!TEST_FLAG (i->flag, pad) && i->layer ==
+  if (!TEST_FOUND (i->flag, pad) && i->layer ==
 	(TEST_FLAG (ONSOLDERFLAG, pad) ? BOTTOM_SIDE : TOP_SIDE) &&
       ((pad->Point1.X == i->Point->X && pad->Point1.Y == i->Point->Y) ||
        (pad->Point2.X == i->Point->X && pad->Point2.Y == i->Point->Y) ||
@@ -2453,7 +2867,7 @@ LOCtoPadLine_callback (const BoxType * b, void *cl)
   LineType *line = (LineType *) b;
   struct lo_info *i = (struct lo_info *) cl;
 
-  if (!TEST_FLAG (i->flag, line) && LinePadIntersect (line, i->pad))
+  if (!TEST_FOUND (i->flag, line) && intersect_line_geometry (line, &i->geom))
     {
       if (ADD_LINE_TO_LIST (i->layer, line, i->flag))
         longjmp (i->env, 1);
@@ -2469,7 +2883,7 @@ LOCtoPadArc_callback (const BoxType * b, void *cl)
 
   if (!arc->Thickness)
     return 0;
-  if (!TEST_FLAG (i->flag, arc) && ArcPadIntersect (arc, i->pad))
+  if (!TEST_FOUND (i->flag, arc) && ArcPadIntersect (arc, i->pad))
     {
       if (ADD_ARC_TO_LIST (i->layer, arc, i->flag))
         longjmp (i->env, 1);
@@ -2484,7 +2898,7 @@ LOCtoPadPoly_callback (const BoxType * b, void *cl)
   struct lo_info *i = (struct lo_info *) cl;
 
 
-  if (!TEST_FLAG (i->flag, polygon) &&
+  if (!TEST_FOUND (i->flag, polygon) &&
       (!TEST_FLAG (CLEARPOLYFLAG, polygon) || !i->pad->Clearance))
     {
       if (IsPadInPolygon (i->pad, polygon) &&
@@ -2500,7 +2914,7 @@ LOCtoPadRat_callback (const BoxType * b, void *cl)
   RatType *rat = (RatType *) b;
   struct lo_info *i = (struct lo_info *) cl;
 
-  if (!TEST_FLAG (i->flag, rat))
+  if (!TEST_FOUND (i->flag, rat))
     {
       if (rat->group1 == i->layer &&
 	  ((rat->Point1.X == i->pad->Point1.X && rat->Point1.Y == i->pad->Point1.Y) ||
@@ -2530,9 +2944,10 @@ LOCtoPadPad_callback (const BoxType * b, void *cl)
   PadType *pad = (PadType *) b;
   struct lo_info *i = (struct lo_info *) cl;
 
-  if (!TEST_FLAG (i->flag, pad) && i->layer ==
+  if (!TEST_FOUND (i->flag, pad) && i->layer ==
       (TEST_FLAG (ONSOLDERFLAG, pad) ? BOTTOM_SIDE : TOP_SIDE)
-      && PadPadIntersect (pad, i->pad) && ADD_PAD_TO_LIST (i->layer, pad, i->flag))
+      && intersect_line_geometry ((LineType *) pad, &i->geom)
+      && ADD_PAD_TO_LIST (i->layer, pad, i->flag))
     longjmp (i->env, 1);
   return 0;
 }
@@ -2552,6 +2967,7 @@ LookupLOConnectionsToPad (PadType *Pad, Cardinal LayerGroup, int flag, bool AndR
 
   info.flag = flag;
   info.pad = Pad;
+  line_geometry (&info.geom, (LineType *) Pad);
 
 
   if (!TEST_FLAG (SQUAREFLAG, Pad))
@@ -2623,7 +3039,7 @@ LOCtoPolyLine_callback (const BoxType * b, void *cl)
   LineType *line = (LineType *) b;
   struct lo_info *i = (struct lo_info *) cl;
 
-  if (!TEST_FLAG (i->flag, line) && IsLineInPolygon (line, i->polygon))
+  if (!TEST_FOUND (i->flag, line) && IsLineInPolygon (line, i->polygon))
     {
       if (ADD_LINE_TO_LIST (i->layer, line, i->flag))
         longjmp (i->env, 1);
@@ -2639,7 +3055,7 @@ LOCtoPolyArc_callback (const BoxType * b, void *cl)
 
   if (!arc->Thickness)
     return 0;
-  if (!TEST_FLAG (i->flag, arc) && IsArcInPolygon (arc, i->polygon))
+  if (!TEST_FOUND (i->flag, arc) && IsArcInPolygon (arc, i->polygon))
     {
       if (ADD_ARC_TO_LIST (i->layer, arc, i->flag))
         longjmp (i->env, 1);
@@ -2653,7 +3069,7 @@ LOCtoPolyPad_callback (const BoxType * b, void *cl)
   PadType *pad = (PadType *) b;
   struct lo_info *i = (struct lo_info *) cl;
 
-  if (!TEST_FLAG (i->flag, pad) && i->layer ==
+  if (!TEST_FOUND (i->flag, pad) && i->layer ==
       (TEST_FLAG (ONSOLDERFLAG, pad) ? BOTTOM_SIDE : TOP_SIDE)
       && IsPadInPolygon (pad, i->polygon))
     {
@@ -2669,7 +3085,7 @@ LOCtoPolyRat_callback (const BoxType * b, void *cl)
   RatType *rat = (RatType *) b;
   struct lo_info *i = (struct lo_info *) cl;
 
-  if (!TEST_FLAG (i->flag, rat))
+  if (!TEST_FOUND (i->flag, rat))
     {
       if ((rat->Point1.X == (i->polygon->Clipped->contours->head.point[0]) &&
            rat->Point1.Y == (i->polygon->Clipped->contours->head.point[1]) &&
@@ -2734,7 +3150,7 @@ LookupLOConnectionsToPolygon (PolygonType *Polygon, Cardinal LayerGroup, int fla
           for (i = layer->Polygon; i != NULL; i = g_list_next (i))
             {
               PolygonType *polygon = i->data;
-              if (!TEST_FLAG (flag, polygon)
+              if (!TEST_FOUND (flag, polygon)
                   && IsPolygonInPolygon (polygon, Polygon)
                   && ADD_POLYGON_TO_LIST (layer_no, polygon, flag))
                 return true;
@@ -2787,6 +3203,8 @@ reassign_no_drc_flags (void)
 DoIt (int flag, Coord bloat, bool AndRats, bool AndDraw, bool is_drc)
 {
   bool newone = false;
+
+  PROFILE_BEGIN (PROFILE_FIND);
   Bloat = bloat;
   drc = is_drc;
   reassign_no_drc_flags ();
@@ -2813,6 +3231,7 @@ DoIt (int flag, Coord bloat, bool AndRats, bool AndDraw, bool is_drc)
     Draw ();
   /* We should leave global state variables in a consistent state... */
   Bloat = 0;
+  PROFILE_END (PROFILE_FIND);
   return (newone);
 }
 
@@ -2991,7 +3410,7 @@ PrintElementConnections (ElementType *Element, FILE * FP, int flag, bool AndDraw
   PIN_LOOP (Element);
   {
     /* pin might have been checked before, add to list if not */
-    if (TEST_FLAG (flag, pin))
+    if (TEST_FOUND (flag, pin))
       {
         PrintConnectionListEntry ((char *)EMPTY (pin->Name), NULL, true, FP);
         fputs ("\t\t__CHECKED_BEFORE__\n\t}\n", FP);
@@ -3015,7 +3434,7 @@ PrintElementConnections (ElementType *Element, FILE * FP, int flag, bool AndDraw
   {
     Cardinal layer;
     /* pad might have been checked before, add to list if not */
-    if (TEST_FLAG (flag, pad))
+    if (TEST_FOUND (flag, pad))
       {
         PrintConnectionListEntry ((char *)EMPTY (pad->Name), NULL, true, FP);
         fputs ("\t\t__CHECKED_BEFORE__\n\t}\n", FP);
@@ -3233,7 +3652,7 @@ PrintAndSelectUnusedPinsAndPadsOfElement (ElementType *Element, FILE * FP, int f
     if (!TEST_FLAG (HOLEFLAG, pin))
       {
         /* pin might have bee checked before, add to list if not */
-        if (!TEST_FLAG (flag, pin) && FP)
+        if (!TEST_FOUND (flag, pin) && FP)
           {
             int i;
             if (ADD_PV_TO_LIST (pin, flag))
@@ -3276,7 +3695,7 @@ PrintAndSelectUnusedPinsAndPadsOfElement (ElementType *Element, FILE * FP, int f
   {
     /* lookup pad in list */
     /* pad might has bee checked before, add to list if not */
-    if (!TEST_FLAG (flag, pad) && FP)
+    if (!TEST_FOUND (flag, pad) && FP)
       {
         int i;
         if (ADD_PAD_TO_LIST (TEST_FLAG (ONSOLDERFLAG, pad)
@@ -3407,3 +3826,620 @@ LookupConnectionsToAllElements (FILE * FP)
   Redraw ();
 }
 
+
+/*!
+ * \brief Start a new visit epoch, forgetting all visit marks.
+ *
+ * When the counter wraps around, the marks of all objects are reset so
+ * that stale marks can't match again.
+ */
+static void
+NewVisitEpoch (void)
+{
+  if (++visit_epoch != 0)
+    return;
+
+  ALLPIN_LOOP (PCB->Data);
+  {
+    pin->Visit = 0;
+  }
+  ENDALL_LOOP;
+  VIA_LOOP (PCB->Data);
+  {
+    via->Visit = 0;
+  }
+  END_LOOP;
+  ALLPAD_LOOP (PCB->Data);
+  {
+    pad->Visit = 0;
+  }
+  ENDALL_LOOP;
+  ALLLINE_LOOP (PCB->Data);
+  {
+    line->Visit = 0;
+  }
+  ENDALL_LOOP;
+  ALLARC_LOOP (PCB->Data);
+  {
+    arc->Visit = 0;
+  }
+  ENDALL_LOOP;
+  ALLPOLYGON_LOOP (PCB->Data);
+  {
+    polygon->Visit = 0;
+  }
+  ENDALL_LOOP;
+  RAT_LOOP (PCB->Data);
+  {
+    line->Visit = 0;
+  }
+  END_LOOP;
+  visit_epoch = 1;
+}
+
+/*!
+ * \brief Report every object found by the last DoIt() with the given
+ * label.
+ *
+ * The lookup lists hold exactly the objects marked by the lookup, so
+ * they can be harvested without walking the board.
+ */
+static void
+HarvestConnectionLists (int label, ConnectionLabelFunc func, void *user_data)
+{
+  Cardinal i, layer;
+
+  for (i = 0; i < PVList.Number; i++)
+    {
+      PinType *pv = PVLIST_ENTRY (i);
+
+      if (pv->Element)
+        func (PIN_TYPE, pv->Element, pv, label, user_data);
+      else
+        func (VIA_TYPE, pv, pv, label, user_data);
+    }
+  for (layer = 0; layer < 2; layer++)
+    for (i = 0; i < PadList[layer].Number; i++)
+      {
+        PadType *pad = PADLIST_ENTRY (layer, i);
+        func (PAD_TYPE, pad->Element, pad, label, user_data);
+      }
+  for (layer = 0; layer < max_copper_layer; layer++)
+    {
+      LayerType *l = LAYER_PTR (layer);
+
+      for (i = 0; i < LineList[layer].Number; i++)
+        func (LINE_TYPE, l, LINELIST_ENTRY (layer, i), label, user_data);
+      for (i = 0; i < ArcList[layer].Number; i++)
+        func (ARC_TYPE, l, ARCLIST_ENTRY (layer, i), label, user_data);
+      for (i = 0; i < PolygonList[layer].Number; i++)
+        func (POLYGON_TYPE, l, POLYGONLIST_ENTRY (layer, i), label, user_data);
+    }
+  for (i = 0; i < RatList.Number; i++)
+    func (RATLINE_TYPE, RATLIST_ENTRY (i), RATLIST_ENTRY (i), label, user_data);
+}
+
+/*!
+ * \brief Flood one connected component from an unlabelled seed object.
+ */
+static void
+LabelComponent (int type, void *ptr1, void *ptr2, int label, bool AndRats,
+                ConnectionLabelFunc func, void *user_data)
+{
+  ListStart (type, ptr1, ptr2, ptr2, FOUNDFLAG);
+  DoIt (FOUNDFLAG, 0, AndRats, false, false);
+  HarvestConnectionLists (label, func, user_data);
+  DumpList ();
+}
+
+/*!
+ * \brief Assign a connected component label to every copper object.
+ *
+ * This is a connected-components pass over the normal connection
+ * lookup: the marks are reset once, then every object that has not been
+ * found yet seeds a new flood, and all the objects reached by it are
+ * reported to func with the same label.  Seeds are taken in the order
+ * pins and pads (element by element), vias, then lines, arcs and
+ * polygons of each copper layer, so labels are numbered from 0 in that
+ * order.
+ *
+ * Compared to one ClearFlagOnAllObjects() plus lookup per net this visits
+ * every object a constant number of times.  Found objects are marked
+ * with a fresh visit epoch rather than FOUNDFLAG, so the object flags
+ * are left alone and nothing is added to the undo list.
+ *
+ * \return the number of labels assigned.
+ */
+int
+LabelAllConnections (bool AndRats, ConnectionLabelFunc func, void *user_data)
+{
+  int label = 0;
+
+  LockUndo ();
+  NewVisitEpoch ();
+  use_visit_epoch = true;
+  InitConnectionLookup ();
+  reassign_no_drc_flags ();
+  parallel_lookup = true;
+
+  ELEMENT_LOOP (PCB->Data);
+  {
+    PIN_LOOP (element);
+    {
+      if (!TEST_FOUND (FOUNDFLAG, pin))
+        LabelComponent (PIN_TYPE, element, pin, label++, AndRats,
+                        func, user_data);
+    }
+    END_LOOP;
+    PAD_LOOP (element);
+    {
+      if (!TEST_FOUND (FOUNDFLAG, pad))
+        LabelComponent (PAD_TYPE, element, pad, label++, AndRats,
+                        func, user_data);
+    }
+    END_LOOP;
+  }
+  END_LOOP;
+
+  VIA_LOOP (PCB->Data);
+  {
+    if (!TEST_FOUND (FOUNDFLAG, via))
+      LabelComponent (VIA_TYPE, via, via, label++, AndRats,
+                      func, user_data);
+  }
+  END_LOOP;
+
+  LAYER_LOOP (PCB->Data, max_copper_layer);
+  {
+    if (layer->no_drc)
+      continue;
+    LINE_LOOP (layer);
+    {
+      if (!TEST_FOUND (FOUNDFLAG, line))
+        LabelComponent (LINE_TYPE, layer, line, label++, AndRats,
+                        func, user_data);
+    }
+    END_LOOP;
+    ARC_LOOP (layer);
+    {
+      if (!TEST_FOUND (FOUNDFLAG, arc))
+        LabelComponent (ARC_TYPE, layer, arc, label++, AndRats,
+                        func, user_data);
+    }
+    END_LOOP;
+    POLYGON_LOOP (layer);
+    {
+      if (!TEST_FOUND (FOUNDFLAG, polygon))
+        LabelComponent (POLYGON_TYPE, layer, polygon, label++, AndRats,
+                        func, user_data);
+    }
+    END_LOOP;
+  }
+  END_LOOP;
+
+  parallel_lookup = false;
+  FreeConnectionLookupMemory ();
+  use_visit_epoch = false;
+  UnlockUndo ();
+  return label;
+}
+
+/* ---------------------------------------------------------------------------
+ * persistent connectivity index
+ *
+ * The index maps every copper object to the label of its connected
+ * component, as assigned by LabelAllConnections() without rats.  A
+ * second index, of the nets, does the same with components joined by
+ * rat lines too, which is what the exporters label their nets with.
+ * Each is built on its first query and kept until the board changes, so
+ * repeated connectivity queries between edits are hash lookups, and an
+ * export of several files labels the board once.
+ *
+ * Staleness is detected two ways: any insertion into or deletion from a
+ * tree of the board's objects (which every create, remove, move or resize
+ * goes through) changes r_generation(), and edits that only change
+ * polygon clipping or flags call ConnectionIndexInvalidate() through the
+ * polygon code, the flag undo list and SetChangedFlag().
+ *
+ * The vias, lines, arcs and rats create.c adds to the board are noted by
+ * ConnectionIndexNoteAdded().  If nothing but those changed the trees
+ * since the index was built, the next query floods from the new objects
+ * only, stopping at the objects that have a label, and joins the labels
+ * they met in a union-find.  Removing an object can split a component,
+ * which a union-find can't undo, so any other edit makes the next query
+ * relabel the board in one pass.
+ */
+typedef struct
+{
+  bool AndRats;
+  GHashTable *table;	/*!< The label of each object, plus one. */
+  int labels;
+  unsigned long generation;
+  PCBType *pcb;
+  GArray *stats;	/*!< ConnectionNetStats by label, or NULL. */
+  GArray *parent;	/*!< The label each label was joined into. */
+} ConnectionIndexType;
+
+static ConnectionIndexType CopperIndex = { false };
+static ConnectionIndexType NetIndex = { true };
+
+/*!
+ * \brief An object added to the board, see ConnectionIndexNoteAdded().
+ */
+typedef struct
+{
+  int type;
+  void *ptr1, *ptr2;
+  unsigned long generation;	/*!< r_generation() before it was added. */
+} ConnectionAddedType;
+
+/*!
+ * \brief Objects added one after the other, with no other change to the
+ * trees of the board between them.
+ */
+static GArray *ConnectionAdded = NULL;
+
+/*!
+ * \brief r_generation() after the last of ConnectionAdded.
+ */
+static unsigned long ConnectionAddedTo;
+
+/*!
+ * \brief Number of objects added since the last ConnectionIndexEdited().
+ */
+static int ConnectionAddedEdit = 0;
+
+/*!
+ * \brief Past this many added objects the indices are relabelled instead.
+ */
+#define CONNECTION_ADDED_MAX 4096
+
+/*!
+ * \brief Mark the connectivity indices as stale.
+ *
+ * Called by InitClip(), which may run on several threads at once.
+ */
+void
+ConnectionIndexInvalidate (void)
+{
+  g_atomic_pointer_set (&CopperIndex.pcb, NULL);
+  g_atomic_pointer_set (&NetIndex.pcb, NULL);
+}
+
+/*!
+ * \brief Note an object create.c added to the board.
+ *
+ * \param generation r_generation() before the object was put in its
+ * tree.
+ */
+void
+ConnectionIndexNoteAdded (int type, void *ptr1, void *ptr2,
+                          unsigned long generation)
+{
+  ConnectionAddedType added = { type, ptr1, ptr2, generation };
+
+  if (ConnectionAdded == NULL)
+    ConnectionAdded = g_array_new (FALSE, FALSE, sizeof (ConnectionAddedType));
+  if (generation != ConnectionAddedTo
+      || ConnectionAdded->len >= CONNECTION_ADDED_MAX)
+    g_array_set_size (ConnectionAdded, 0);
+  g_array_append_val (ConnectionAdded, added);
+  ConnectionAddedTo = r_generation ();
+  ConnectionAddedEdit++;
+}
+
+/*!
+ * \brief Note the end of an edit of the board, see SetChangedFlag().
+ *
+ * An edit that only added objects through create.c leaves the indices
+ * to take them in on the next query.  Any other may have changed what
+ * no tree tells, like the layer groups, so it marks them stale.
+ */
+void
+ConnectionIndexEdited (void)
+{
+  if (ConnectionAddedEdit == 0 || ConnectionAddedTo != r_generation ())
+    ConnectionIndexInvalidate ();
+  ConnectionAddedEdit = 0;
+}
+
+static void
+ConnectionIndexAdd (int type, void *ptr1, void *ptr2, int label,
+                    void *user_data)
+{
+  g_hash_table_insert ((GHashTable *) user_data, ptr2,
+                       GINT_TO_POINTER (label + 1));
+}
+
+/*!
+ * \brief Return the label a label of an index was joined into.
+ */
+static int
+ConnectionIndexRoot (ConnectionIndexType *index, int label)
+{
+  while (g_array_index (index->parent, int, label) != label)
+    label = g_array_index (index->parent, int, label);
+  return label;
+}
+
+/*!
+ * \brief Label the objects added from ConnectionAdded[first] on.
+ *
+ * Each added object that is not labelled yet seeds a lookup, which
+ * follows the new objects and only meets the labelled ones.  The new
+ * objects it found take the label of the first component met, which
+ * all the others met are joined into, or a new label if none was.
+ */
+static void
+ConnectionIndexAddObjects (ConnectionIndexType *index, guint first)
+{
+  guint i, j;
+  int label;
+
+  LockUndo ();
+  NewVisitEpoch ();
+  use_visit_epoch = true;
+  InitConnectionLookup ();
+  reassign_no_drc_flags ();
+  known_objects = index->table;
+  known_met = g_array_new (FALSE, FALSE, sizeof (int));
+
+  for (i = first; i < ConnectionAdded->len; i++)
+    {
+      ConnectionAddedType *added = &g_array_index (ConnectionAdded,
+                                                   ConnectionAddedType, i);
+
+      if (added->type == RATLINE_TYPE && !index->AndRats)
+        continue;
+      if ((added->type == LINE_TYPE || added->type == ARC_TYPE)
+          && (GetLayerNumber (PCB->Data, (LayerType *) added->ptr1)
+              >= max_copper_layer
+              || ((LayerType *) added->ptr1)->no_drc))
+        continue;
+      if (TEST_FOUND (FOUNDFLAG, (AnyObjectType *) added->ptr2)
+          || g_hash_table_contains (index->table, added->ptr2))
+        continue;
+
+      g_array_set_size (known_met, 0);
+      ListStart (added->type, added->ptr1, added->ptr2, added->ptr2,
+                 FOUNDFLAG);
+      DoIt (FOUNDFLAG, 0, index->AndRats, false, false);
+
+      if (known_met->len == 0)
+        {
+          label = index->labels++;
+          g_array_append_val (index->parent, label);
+        }
+      else
+        {
+          label = ConnectionIndexRoot (index,
+                                       g_array_index (known_met, int, 0));
+          for (j = 1; j < known_met->len; j++)
+            g_array_index (index->parent, int,
+                           ConnectionIndexRoot (index,
+                                                g_array_index (known_met,
+                                                               int, j)))
+              = label;
+        }
+      HarvestConnectionLists (label, ConnectionIndexAdd, index->table);
+      DumpList ();
+    }
+
+  /* Point every label at its root, for lookups to only read the index. */
+  for (label = 0; label < index->labels; label++)
+    g_array_index (index->parent, int, label) =
+      ConnectionIndexRoot (index, label);
+
+  g_array_free (known_met, TRUE);
+  known_met = NULL;
+  known_objects = NULL;
+  FreeConnectionLookupMemory ();
+  use_visit_epoch = false;
+  UnlockUndo ();
+}
+
+/*!
+ * \brief Make sure a connectivity index describes the current board.
+ *
+ * Must not be called while a connection lookup is in progress, as
+ * rebuilding the index runs its own lookups.
+ */
+static void
+ConnectionIndexUpdate (ConnectionIndexType *index)
+{
+  unsigned long generation = r_generation ();
+  guint i;
+  int label;
+
+  if (index->table && index->pcb == PCB && index->generation == generation)
+    return;
+
+  /* Nothing but additions since the index was built? */
+  if (index->table && index->pcb == PCB && ConnectionAdded != NULL
+      && ConnectionAddedTo == generation)
+    for (i = 0; i < ConnectionAdded->len; i++)
+      if (g_array_index (ConnectionAdded, ConnectionAddedType,
+                         i).generation == index->generation)
+        {
+          ConnectionIndexAddObjects (index, i);
+          if (index->stats)
+            g_array_free (index->stats, TRUE);
+          index->stats = NULL;
+          index->generation = generation;
+          return;
+        }
+
+  if (index->table)
+    g_hash_table_remove_all (index->table);
+  else
+    index->table = g_hash_table_new (g_direct_hash, g_direct_equal);
+  if (index->stats)
+    g_array_free (index->stats, TRUE);
+  index->stats = NULL;
+
+  index->labels = LabelAllConnections (index->AndRats, ConnectionIndexAdd,
+                                       index->table);
+  if (index->parent == NULL)
+    index->parent = g_array_new (FALSE, FALSE, sizeof (int));
+  g_array_set_size (index->parent, index->labels);
+  for (label = 0; label < index->labels; label++)
+    g_array_index (index->parent, int, label) = label;
+  index->generation = generation;
+  index->pcb = PCB;
+}
+
+/*!
+ * \brief Return the label of an object in an index that is up to date.
+ */
+static int
+ConnectionIndexFind (ConnectionIndexType *index, void *ptr)
+{
+  int label = GPOINTER_TO_INT (g_hash_table_lookup (index->table, ptr)) - 1;
+
+  if (label < 0)
+    return -1;
+  return g_array_index (index->parent, int, label);
+}
+
+static int
+ConnectionIndexLookup (ConnectionIndexType *index, void *ptr)
+{
+  ConnectionIndexUpdate (index);
+  return ConnectionIndexFind (index, ptr);
+}
+
+/*!
+ * \brief Return the connected component of a copper object.
+ *
+ * \return the component label, or -1 if ptr is not a copper object of
+ * the board.  Labels are only comparable until the board changes.
+ */
+int
+ConnectionIndexLabel (void *ptr)
+{
+  return ConnectionIndexLookup (&CopperIndex, ptr);
+}
+
+/*!
+ * \brief Tell whether two copper objects are connected through copper.
+ */
+bool
+ConnectionIndexConnected (void *ptr1, void *ptr2)
+{
+  int label = ConnectionIndexLabel (ptr1);
+
+  return label >= 0 && label == ConnectionIndexLabel (ptr2);
+}
+
+/*!
+ * \brief Return the number of connected component labels of the board.
+ *
+ * Labels are below this.  After objects were added, some labels may be
+ * joined into others and not be used any more.
+ */
+int
+ConnectionIndexCount (void)
+{
+  ConnectionIndexUpdate (&CopperIndex);
+  return CopperIndex.labels;
+}
+
+/*!
+ * \brief Return the net of a copper object: its connected component
+ * through copper and rat lines.
+ *
+ * The objects a LookupConnectionByPin() from a pin, pad or via finds are
+ * the ones with its net label.
+ *
+ * \return the net label, from 0 to ConnectionIndexNetCount() - 1, or -1
+ * if ptr is not a copper object of the board.  Labels are numbered in
+ * the order of LabelAllConnections() when the board is relabelled, and
+ * are only comparable until the board changes.
+ */
+int
+ConnectionIndexNetLabel (void *ptr)
+{
+  return ConnectionIndexLookup (&NetIndex, ptr);
+}
+
+/*!
+ * \brief Return the number of net labels of the board.
+ *
+ * Like ConnectionIndexCount(), some labels may not be used.
+ */
+int
+ConnectionIndexNetCount (void)
+{
+  ConnectionIndexUpdate (&NetIndex);
+  return NetIndex.labels;
+}
+
+static ConnectionNetStats *
+NetStatsOf (void *ptr)
+{
+  int label = ConnectionIndexFind (&NetIndex, ptr);
+
+  if (label < 0)
+    return NULL;
+  return &g_array_index (NetIndex.stats, ConnectionNetStats, label);
+}
+
+/*!
+ * \brief Return the length and via count of a net.
+ *
+ * The statistics of all nets are gathered in one pass over the board on
+ * the first query, and kept with the net index until the board changes.
+ *
+ * \param label a label of ConnectionIndexNetLabel().
+ *
+ * \return the statistics, valid until the board changes, or NULL if
+ * label is no net.
+ */
+const ConnectionNetStats *
+ConnectionIndexNetStats (int label)
+{
+  ConnectionNetStats *stats;
+
+  ConnectionIndexUpdate (&NetIndex);
+  if (label < 0 || label >= NetIndex.labels)
+    return NULL;
+
+  if (NetIndex.stats == NULL)
+    {
+      NetIndex.stats = g_array_sized_new (FALSE, TRUE,
+                                          sizeof (ConnectionNetStats),
+                                          NetIndex.labels);
+      g_array_set_size (NetIndex.stats, NetIndex.labels);
+
+      ALLLINE_LOOP (PCB->Data);
+      {
+        if ((stats = NetStatsOf (line)) != NULL)
+          {
+            stats->length += hypot (line->Point1.X - line->Point2.X,
+                                    line->Point1.Y - line->Point2.Y);
+            stats->segments++;
+          }
+      }
+      ENDALL_LOOP;
+
+      ALLARC_LOOP (PCB->Data);
+      {
+        if ((stats = NetStatsOf (arc)) != NULL)
+          {
+            /* FIXME: we assume width==height here */
+            stats->length += M_PI * 2 * arc->Width * abs (arc->Delta) / 360.0;
+            stats->segments++;
+          }
+      }
+      ENDALL_LOOP;
+
+      VIA_LOOP (PCB->Data);
+      {
+        if ((stats = NetStatsOf (via)) != NULL)
+          stats->vias++;
+      }
+      END_LOOP;
+    }
+
+  return &g_array_index (NetIndex.stats, ConnectionNetStats, label);
+}
@@ -44,6 +44,23 @@
 #define SILK_TYPE	\
 	(LINE_TYPE | ARC_TYPE | POLYGON_TYPE)
 
+/*!
+ * \brief Callback of LabelAllConnections(), called once for every
+ * labelled object.
+ */
+typedef void (*ConnectionLabelFunc) (int type, void *ptr1, void *ptr2,
+                                     int label, void *user_data);
+
+/*!
+ * \brief Statistics of a net, see ConnectionIndexNetStats().
+ */
+typedef struct
+{
+  double length;	/*!< Of the lines and arcs of the net. */
+  int segments;		/*!< Lines and arcs. */
+  int vias;
+} ConnectionNetStats;
+
 bool LineLineIntersect (LineType *, LineType *);
 bool LineArcIntersect (LineType *, ArcType *);
 bool PinLineIntersect (PinType *, LineType *);
@@ -57,12 +74,23 @@ void InitConnectionLookup (void);
 void FreeConnectionLookupMemory (void);
 void RatFindHook (int, void *, void *, void *, bool, int flag, bool);
 void LookupConnectionByPin (int , void *);
+int LabelAllConnections (bool AndRats, ConnectionLabelFunc, void *);
+int ConnectionIndexLabel (void *);
+bool ConnectionIndexConnected (void *, void *);
+int ConnectionIndexCount (void);
+int ConnectionIndexNetLabel (void *);
+int ConnectionIndexNetCount (void);
+const ConnectionNetStats *ConnectionIndexNetStats (int);
+void ConnectionIndexInvalidate (void);
+void ConnectionIndexNoteAdded (int, void *, void *, unsigned long);
+void ConnectionIndexEdited (void);
 
 /* remove these prototypes later */
 bool ListStart(int, void*, void*, void*, int);
 bool DoIt(int, Coord, bool, bool, bool);
 void DumpList(void);
 void start_do_it_and_dump(int, void*, void*, void*, int, bool, Coord, bool);
+void SetDRCCollect (void (*) (int, void *, void *, void *));
 
 bool IsArcInPolygon (ArcType *, PolygonType *);
 bool IsLineInPolygon (LineType *, PolygonType *);
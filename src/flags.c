@@ -271,6 +271,39 @@ MaskFlags (FlagType flag, unsigned int flags)
   return flag;
 }
 
+/*!
+ * \brief The TRACKED_FLAGS that may have been set since the last look.
+ *
+ * Everything that hands flags to an object on the board notes them:
+ * SET_FLAG() and friends, the object creation functions, undo, and the
+ * moves of objects onto the board from a buffer or another layer.
+ */
+unsigned long pcb_flags_noted = TRACKED_FLAGS;
+
+/* The TRACKED_FLAGS known not to be set on any pin, via or pad of the
+ * board, and on any copper line, arc, polygon or rat line. */
+static unsigned long pvp_clear = 0, lop_clear = 0;
+static PCBType *flags_clear_pcb = NULL;
+
+/*!
+ * \brief Whether flag is known not to be set anywhere in the part of
+ * the board *clear describes.
+ */
+static bool
+FlagKnownClear (int flag, unsigned long *clear)
+{
+  if (flags_clear_pcb != PCB)
+    {
+      pvp_clear = lop_clear = 0;
+      flags_clear_pcb = PCB;
+    }
+  pvp_clear &= ~pcb_flags_noted;
+  lop_clear &= ~pcb_flags_noted;
+  pcb_flags_noted = 0;
+  return flag != 0 && (flag & ~TRACKED_FLAGS) == 0
+    && (flag & ~*clear) == 0;
+}
+
 /*!
  * \brief Resets all used flags of pins and vias.
  */
@@ -279,6 +312,9 @@ ClearFlagOnPinsViasAndPads (int flag, bool undoable)
 {
   bool change = false;
   
+  if (FlagKnownClear (flag, &pvp_clear))
+    return false;
+
   VIA_LOOP (PCB->Data);
   {
     if (TEST_FLAG (flag, via))
@@ -316,6 +352,7 @@ ClearFlagOnPinsViasAndPads (int flag, bool undoable)
     END_LOOP;
   }
   END_LOOP;
+  pvp_clear |= flag & TRACKED_FLAGS;
   if (change)
     SetChangedFlag (true);
   return change;
@@ -329,6 +366,9 @@ ClearFlagOnLinesAndPolygons (int flag, bool undoable)
 {
   bool change = false;
   
+  if (FlagKnownClear (flag, &lop_clear))
+    return false;
+
   RAT_LOOP (PCB->Data);
   {
     if (TEST_FLAG (flag, line))
@@ -373,6 +413,7 @@ ClearFlagOnLinesAndPolygons (int flag, bool undoable)
     }
   }
   ENDALL_LOOP;
+  lop_clear |= flag & TRACKED_FLAGS;
   if (change)
     SetChangedFlag (true);
   return change;
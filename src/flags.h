@@ -52,14 +52,27 @@ typedef struct
 int pcb_flag_eq (FlagType *f1, FlagType *f2);
 
 
+/* ---------------------------------------------------------------------------
+ * Flags that whole board passes look for or clear.  Whenever one of them
+ * may have been set on an object, it is noted in pcb_flags_noted, so that
+ * ClearFlagOnAllObjects() can tell when there is nothing to clear.
+ */
+#define TRACKED_FLAGS (FOUNDFLAG | SELECTEDFLAG | WARNFLAG | DRCFLAG \
+		       | CONNECTEDFLAG)
+
+extern unsigned long pcb_flags_noted;
+#define NOTE_FLAGS(F) \
+  ((F) & TRACKED_FLAGS ? (void) (pcb_flags_noted |= (F) & TRACKED_FLAGS) \
+   : (void) 0)
+
 /* ---------------------------------------------------------------------------
  * some routines for flag setting, clearing, changing and testing
  */
-#define	SET_FLAG(F,P)		((P)->Flags.f |= (F))
+#define	SET_FLAG(F,P)		(NOTE_FLAGS (F), (P)->Flags.f |= (F))
 #define	CLEAR_FLAG(F,P)		((P)->Flags.f &= (~(F)))
 #define	TEST_FLAG(F,P)		((P)->Flags.f & (F) ? 1 : 0)
-#define	TOGGLE_FLAG(F,P)	((P)->Flags.f ^= (F))
-#define	ASSIGN_FLAG(F,V,P)	((P)->Flags.f = ((P)->Flags.f & (~(F))) | ((V) ? (F) : 0))
+#define	TOGGLE_FLAG(F,P)	(NOTE_FLAGS (F), (P)->Flags.f ^= (F))
+#define	ASSIGN_FLAG(F,V,P)	(NOTE_FLAGS (F), (P)->Flags.f = ((P)->Flags.f & (~(F))) | ((V) ? (F) : 0))
 #define TEST_FLAGS(F,P)         (((P)->Flags.f & (F)) == (F) ? 1 : 0)
 
 #define FLAGS_EQUAL(F1,F2)	pcb_flag_eq(&(F1), &(F2))
@@ -169,6 +169,7 @@ typedef unsigned char BYTE;
 	BoxType		BoundingBox;	\
 	long int	ID;		\
 	FlagType	Flags;		\
+	unsigned int	Visit;	/* find.c visit epoch */ \
 	//	struct LibraryEntryType *net
 
 /* Lines, pads, and rats all use this so they can be cross-cast.  */
@@ -291,7 +292,10 @@ struct polygon_st
   Cardinal PointMax; /*!< Max number from malloc(). */
   POLYAREA *Clipped; /*!< The clipped region of this polygon. */
   PLINE *NoHoles; /*!< The polygon broken into hole-less regions */
-  int NoHolesValid; /*!< Is the NoHoles polygon up to date? */
+  unsigned int ClippedGen; /*!< Bumped whenever Clipped changes. */
+  unsigned int NoHolesGen; /*!< The ClippedGen NoHoles was computed for. */
+  unsigned int DicedGen; /*!< The ClippedGen last diced for a partial draw. */
+  struct polygon_tiles *Tiles; /*!< Tile grid owning NoHoles, see polygon.c. */
   PointType *Points; /*!< Data. */
   Cardinal *HoleIndex; /*!< Index of hole data within the Points array. */
   Cardinal HoleIndexN; /*!< Number of holes in polygon. */
@@ -320,6 +324,11 @@ struct rtree
 {
   struct rtree_node *root;
   int size; /*!< Number of entries in tree */
+  struct rtree_arena *arena; /*!< Node storage, see rtree.c. */
+  int shared_section; /*!< Shared read section it was made in, if any. */
+  int defer_section; /*!< Deferred insert section it was made in, if any. */
+  struct rtree_pending *pending; /*!< Deferred inserts, see rtree.c. */
+  bool tracked; /*!< Holds objects of a DataType, see r_generation(). */
 };
 
 /*!
@@ -336,6 +345,8 @@ typedef struct
   GList *Text;
   GList *Polygon;
   GList *Arc;
+  GList *LineTail, *TextTail, *PolygonTail, *ArcTail;
+    /*!< Last links of the lists, see AppendToObjectList(). */
   rtree_t *line_tree, *text_tree, *polygon_tree, *arc_tree;
   bool On; /*!< Visible flag. */
   char *Color, /*!< Color. */
@@ -417,6 +428,8 @@ typedef struct
   GList *Pad;
   GList *Line;
   GList *Arc;
+  GList *PinTail, *PadTail, *LineTail, *ArcTail;
+    /*!< Last links of the lists, see AppendToObjectList(). */
   BoxType VBox;
   AttributeListType Attributes;
 } ElementType;
@@ -448,6 +461,7 @@ typedef struct
   BoxType DefaultSymbol; /*!< The default symbol is a filled box. */
   SymbolType Symbol[MAX_FONTPOSITION + 1];
   bool Valid;
+  unsigned int Generation; /*!< New for each SetFontInfo (). */
 } FontType;
 
 /*!
@@ -462,11 +476,15 @@ typedef struct
   GList *Via;
   GList *Element;
   GList *Rat;
+  GList *ViaTail, *ElementTail, *RatTail;
+    /*!< Last links of the lists, see AppendToObjectList(). */
   rtree_t *via_tree, *element_tree, *pin_tree, *pad_tree, *name_tree[3],	/* for element names */
    *rat_tree;
   struct PCBType *pcb;
   LayerType Layer[MAX_ALL_LAYER];
   int polyClip;
+  GHashTable *IDIndex; /*!< IDs of the objects, see SearchObjectByID(). */
+  unsigned long IDIndexGeneration;
 } DataType;
 
 /*!
@@ -781,6 +799,13 @@ typedef struct
     Mode, /*!< Currently active mode. */
     BufferNumber; /*!< Number of the current buffer. */
   int BackupInterval; /*!< Time between two backups in seconds. */
+  int DrcJobs; /*!< Number of worker processes for the DRC. */
+  int RatJobs; /*!< Number of worker processes for the rats nest. */
+  int RouteJobs; /*!< Number of worker processes for the autorouter. */
+  int AutorouteBudget; /*!< Seconds the autorouter may take, 0 for no limit. */
+  int PlaceJobs; /*!< Number of annealing worker processes of the autoplacer. */
+  int ExportJobs; /*!< Number of exporters of a -x list run at once. */
+  int UndoBudget; /*!< Memory the undo list may take in kB, 0 for no limit. */
   char *DefaultLayerName[MAX_LAYER],
    *FontCommand, /*!< Command for font file loading. */
    *FileCommand, /*!< Command for file loading. */
@@ -809,7 +834,10 @@ typedef struct
    *FabAuthor, /*!< Full name of author for FAB drawings. */
    *GnetlistProgram, /*!< gnetlist program name. */
    *MakeProgram, /*!< make program name. */
-   *InitialLayerStack; /*!< If set, the initial layer stack is set to this. */
+   *InitialLayerStack, /*!< If set, the initial layer stack is set to this. */
+   *AutorouteTrace, /*!< File the autorouter traces its nets to. */
+   *AutorouteCheckpoint, /*!< File the autorouter checkpoints its passes to. */
+   *CopperStatsFile; /*!< File an export run reports the copper to. */
   Coord PinoutOffsetX; /*!< Offset of origin (X value). */
   Coord PinoutOffsetY; /*!< Offset of origin (Y value). */
   Coord PinoutTextOffsetX; /*!< Offset of text from pin center (X value). */
@@ -824,8 +852,13 @@ typedef struct
     SaveLastCommand, /*!< Save the last command entered by user. */
     SaveInTMP, /*!< Always save data in /tmp. */
     SaveMetricOnly, /*!< Save with mm suffix only, not mil/mm hybrid. */
+    FastParser, /*!< Scan plain files with the mapped file scanner. */
+    BoardCache, /*!< Cache the clipped polygons of loaded boards. */
+    LibraryIndex, /*!< Keep an index of the newlib library tree. */
+    EdifStream, /*!< Read EDIF netlists with the streaming reader. */
     DrawGrid, /*!< Draw grid points. */
     RatWarn, /*!< Rats nest has set warnings. */
+    LiveRats, /*!< Keep the rats of edited nets up to date. */
     StipplePolygons, /*!< Draw polygons with stipple. */
     AllDirectionLines, /*!< Enable lines to all directions. */
     RubberBandMode, /*!< Move, rotate use rubberband connections. */
@@ -836,6 +869,11 @@ typedef struct
     OrthogonalMoves, /*!< . */
     ResetAfterElement, /*!< Reset connections after each element. */
     liveRouting, /*!< Autorouter shows tracks in progress. */
+    AutorouteStats, /*!< Autorouter reports statistics of its passes. */
+    DrcSinglePass, /*!< Find all the clearance violations of a net at once. */
+    MemStats, /*!< Report the memory use at exit, see MemoryReport(). */
+    Timing, /*!< Report the phases of startup, see TimingReport(). */
+    CompactPolygons, /*!< Drop the edge trees of idle polygon contours. */
     AutoBuriedVias,
     RingBellWhenFinished,
       /*!< flag if a signal should be produced when searching of
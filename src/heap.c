@@ -76,6 +76,17 @@ struct heap_struct
  */
 static cost_t MIN_COST = 0;
 
+/*!
+ * \brief Number of children of a node.
+ *
+ * The heap is 4-ary: it is half as deep as a binary heap, and the
+ * children of a node, which are compared on the way down, lie next to
+ * each other in memory.  The root is element[0].
+ */
+#define HEAP_ARITY 4
+#define HEAP_PARENT(k) (((k) - 1) / HEAP_ARITY)
+#define HEAP_FIRST_CHILD(k) (HEAP_ARITY * (k) + 1)
+
 /* ---------------------------------------------------------------------------
  * functions.
  */
@@ -89,9 +100,8 @@ __heap_is_good_slow (heap_t * heap)
   /* heap condition: key in each node should be smaller than in its children */
   /* alternatively (and this is what we check): key in each node should be
    * larger than (or equal to) key of its parent. */
-  /* note that array element[0] is not used (except as a sentinel) */
-  for (i = 2; i < heap->size; i++)
-    if (heap->element[i].cost < heap->element[i / 2].cost)
+  for (i = 1; i < heap->size; i++)
+    if (heap->element[i].cost < heap->element[HEAP_PARENT (i)].cost)
       return 0;
   return 1;
 }
@@ -101,7 +111,7 @@ __heap_is_good (heap_t * heap)
 {
   return heap && (heap->max == 0 || heap->element) &&
     (heap->max >= 0) && (heap->size >= 0) &&
-    (heap->max == 0 || heap->size < heap->max) &&
+    (heap->size <= heap->max) &&
 #ifdef SLOW_ASSERTIONS
     __heap_is_good_slow (heap) &&
 #endif
@@ -148,26 +158,33 @@ void heap_free (heap_t *heap, void (*freefunc) (void *))
 {
   assert (heap);
   assert (__heap_is_good (heap));
-  for ( ; heap->size; heap->size--)  
+  for ( ; heap->size; heap->size--)
    {
-     if (heap->element[heap->size].data)
-       freefunc (heap->element[heap->size].data);
+     if (heap->element[heap->size - 1].data)
+       freefunc (heap->element[heap->size - 1].data);
    }
 }
 
 /* -- mutation -- */
 
+/*!
+ * \brief Move the node at position k up the heap until its parent is no
+ * larger.
+ */
 static void
 __upheap (heap_t * heap, int k)
 {
   struct heap_element v;
+  int parent;
 
-  assert (heap && heap->size < heap->max);
-  assert (k <= heap->size);
+  assert (heap && k < heap->size);
 
-  heap->element[0].cost = MIN_COST;
-  for (v = heap->element[k]; heap->element[k / 2].cost > v.cost; k = k / 2)
-    heap->element[k] = heap->element[k / 2];
+  v = heap->element[k];
+  while (k > 0 && heap->element[parent = HEAP_PARENT (k)].cost > v.cost)
+    {
+      heap->element[k] = heap->element[parent];
+      k = parent;
+    }
   heap->element[k] = v;
 }
 
@@ -178,7 +195,7 @@ heap_insert (heap_t * heap, cost_t cost, void *data)
   assert (cost >= MIN_COST);
 
   /* determine whether we need to grow the heap */
-  if (heap->size + 1 >= heap->max)
+  if (heap->size >= heap->max)
     {
       heap->max *= 2;
       if (heap->max == 0)
@@ -186,37 +203,37 @@ heap_insert (heap_t * heap, cost_t cost, void *data)
       heap->element =
 	(struct heap_element *)realloc (heap->element, heap->max * sizeof (*heap->element));
     }
-  heap->size++;
-  assert (heap->size < heap->max);
   heap->element[heap->size].cost = cost;
   heap->element[heap->size].data = data;
-  __upheap (heap, heap->size);	/* fix heap condition violation */
+  heap->size++;
+  __upheap (heap, heap->size - 1);	/* fix heap condition violation */
   assert (__heap_is_good (heap));
   return;
 }
 
 /*!
  * \brief This procedure moves down the heap.
- * 
- * Exchanging the node at position k with the smaller of its two
- * children as necessary and stopping when the node at k is smaller than
- * both children or the bottom is reached.
+ *
+ * Exchanging the node at position k with the smallest of its children
+ * as necessary and stopping when the node at k is no larger than all
+ * its children or the bottom is reached.
  */
 static void
 __downheap (heap_t * heap, int k)
 {
   struct heap_element v;
+  int first, last, i, j;
 
-  assert (heap && heap->size < heap->max);
-  assert (k <= heap->size);
+  assert (heap && k < heap->size);
 
   v = heap->element[k];
-  while (k <= heap->size / 2)
+  while ((first = HEAP_FIRST_CHILD (k)) < heap->size)
     {
-      int j = k + k;
-      if (j < heap->size && heap->element[j].cost > heap->element[j + 1].cost)
-	j++;
-      if (v.cost < heap->element[j].cost)
+      last = MIN (first + HEAP_ARITY, heap->size);
+      for (j = first, i = first + 1; i < last; i++)
+	if (heap->element[i].cost < heap->element[j].cost)
+	  j = i;
+      if (v.cost <= heap->element[j].cost)
 	break;
       heap->element[k] = heap->element[j];
       k = j;
@@ -233,12 +250,11 @@ heap_remove_smallest (heap_t * heap)
   struct heap_element v;
   assert (heap && __heap_is_good (heap));
   assert (heap->size > 0);
-  assert (heap->max > 1);
 
-  v = heap->element[1];
-  heap->element[1] = heap->element[heap->size--];
+  v = heap->element[0];
+  heap->element[0] = heap->element[--heap->size];
   if (heap->size > 0)
-    __downheap (heap, 1);
+    __downheap (heap, 0);
 
   assert (__heap_is_good (heap));
   return v.data;
@@ -253,20 +269,19 @@ heap_remove_smallest (heap_t * heap)
 void *
 heap_replace (heap_t * heap, cost_t cost, void *data)
 {
+  struct heap_element v;
   assert (heap && __heap_is_good (heap));
 
-  if (heap_is_empty (heap))
+  if (heap_is_empty (heap) || cost <= heap->element[0].cost)
     return data;
 
-  assert (heap->size > 0);
-  assert (heap->max > 1);
-
+  v = heap->element[0];
   heap->element[0].cost = cost;
   heap->element[0].data = data;
-  __downheap (heap, 0);		/* ooh, tricky! */
+  __downheap (heap, 0);
 
   assert (__heap_is_good (heap));
-  return heap->element[0].data;
+  return v.data;
 }
 
 /* -- interrogation -- */
@@ -281,6 +296,17 @@ heap_is_empty (heap_t * heap)
   return heap->size == 0;
 }
 
+/*!
+ * \brief Return the cost of the smallest item of a non-empty heap.
+ */
+cost_t
+heap_min_cost (heap_t * heap)
+{
+  assert (__heap_is_good (heap));
+  assert (heap->size > 0);
+  return heap->element[0].cost;
+}
+
 /* -- size -- */
 
 /*!
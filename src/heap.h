@@ -61,6 +61,7 @@ void *heap_replace (heap_t * heap, cost_t cost, void *data);
 
 /* -- interrogation -- */
 int heap_is_empty (heap_t * heap);
+cost_t heap_min_cost (heap_t * heap);
 int heap_size (heap_t * heap);
 
 #endif /* PCB_HEAP_H */
@@ -194,6 +194,29 @@ extern "C"
    */
   int hid_parse_actions (const char *str_);
 
+  typedef struct HID_ActionScript HID_ActionScript;
+
+  /*!
+   * \brief Parse the given string into action calls like
+   * hid_parse_actions, and add them to a script to run later.
+   *
+   * \return Returns the script, a new one if \p script is NULL.
+   */
+  HID_ActionScript *hid_compile_actions (HID_ActionScript *script,
+                                         const char *str_);
+
+  /*!
+   * \brief Run the action calls of a script.
+   *
+   * The calls of each string go as hid_parse_actions would make them: a
+   * call that returns nonzero skips the rest of the calls of its string.
+   *
+   * \return Returns nonzero if an action handler returns nonzero.
+   */
+  int hid_run_actions (HID_ActionScript *script);
+
+  void hid_free_actions (HID_ActionScript *script);
+
   typedef struct
   {
     char *name; /*!< Name of the flag */
@@ -771,6 +794,14 @@ typedef enum
    */
   void hid_init (void);
 
+  /*!
+   * \brief Load the plugin HIDs and other plugins, if not done yet.
+   *
+   * Looking up a HID, action or option that is not built in does this
+   * too, so only the GUI needs to call it.
+   */
+  void hid_load_plugins (void);
+
   /*!
    * \brief Call this at exit.
    */
@@ -838,6 +869,11 @@ typedef enum
      * The gui HIDs set and unset this var.
      */
 
+  extern int export_failures;
+    /*!< The exporters count what they failed to export here, and pcb
+     * exits with an error once all exporters asked for have run.
+     */
+
   extern HID_Action *current_action;
     /*!< This is either NULL or points to the current HID_Action that is
      * being called.
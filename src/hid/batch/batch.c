@@ -42,12 +42,28 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H) && defined(HAVE_POLL_H)
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <poll.h>
+#define BATCH_SERVER 1
+#endif
 
 #include "global.h"
 #include "crosshair.h"
 #include "hid.h"
+#include "create.h"
 #include "data.h"
+#include "error.h"
+#include "file.h"
 #include "misc.h"
+#include "remove.h"
+#include "undo.h"
 #include "hid.h"
 #include "hid_draw.h"
 #include "../hidint.h"
@@ -67,6 +83,29 @@ typedef struct hid_gc_struct
   int nothing_interesting_here;
 } hid_gc_struct;
 
+static char *listen_path = NULL;
+
+HID_Attribute batch_attribute_list[] = {
+
+/* %start-doc options "23 Batch Options"
+@ftable @code
+@item --listen <string>
+Instead of reading actions from stdin, serve them on the Unix domain
+socket of this name.  Each line a client sends is a command, as it would
+be typed at the batch prompt.  What the command prints goes back to the
+client, followed by a line @code{=> @var{n}} with the value it returned.
+Many clients can be connected at once; their commands run one at a time.
+The @code{Board} action keeps several boards loaded for them.
+@end ftable
+%end-doc
+*/
+  {"listen", "Serve actions on this socket",
+   HID_String, 0, 0, {0, 0, 0}, 0, &listen_path},
+#define HA_listen 0
+};
+
+REGISTER_ATTRIBUTES (batch_attribute_list)
+
 static HID_Attribute *
 batch_get_export_options (int *n_ret)
 {
@@ -136,6 +175,188 @@ info (int argc, char **argv, Coord x, Coord y)
 }
 
 
+/* ----------------------------------------------------------------------------- */
+
+/*!
+ * \brief A board kept loaded, but not the current one.
+ */
+typedef struct
+{
+  char *name;
+  PCBType *pcb;
+  int stack[MAX_LAYER];
+} BatchBoard;
+
+/* the loaded boards other than PCB, and the name of PCB */
+static GPtrArray *boards = NULL;
+static char *board_name = NULL;
+
+static BatchBoard *
+find_board (const char *name)
+{
+  guint i;
+
+  for (i = 0; boards && i < boards->len; i++)
+    {
+      BatchBoard *b = (BatchBoard *) g_ptr_array_index (boards, i);
+      if (strcmp (b->name, name) == 0)
+	return b;
+    }
+  return NULL;
+}
+
+/*!
+ * \brief Put the current board away under its name, and make another
+ * one current.
+ *
+ * The undo list refers to the objects of the current board, so it is
+ * cleared.
+ */
+static void
+switch_board (PCBType *pcb, const int *stack, const char *name)
+{
+  BatchBoard *b = (BatchBoard *) calloc (1, sizeof (BatchBoard));
+
+  b->name = board_name;
+  b->pcb = PCB;
+  memcpy (b->stack, LayerStack, sizeof (b->stack));
+  g_ptr_array_add (boards, b);
+
+  ClearUndoList (true);
+  PCB = pcb;
+  if (stack)
+    memcpy (LayerStack, stack, sizeof (LayerStack));
+  board_name = strdup (name);
+  hid_action ("PCBChanged");
+}
+
+static const char board_syntax[] =
+  "Board(List)\n"
+  "Board(Load, name, file)\n"
+  "Board(Use, name)\n"
+  "Board(Close, name)";
+
+static const char board_help[] = "Keep several boards loaded.";
+
+/* %start-doc actions Board
+
+This action is only in the batch GUI, for the clients of a
+@code{--listen} server that query several boards in turn.
+
+@table @code
+
+@item List
+Lists the loaded boards, the current one marked with a @code{*}.  The
+board pcb started with is called @code{main}.
+
+@item Load
+Loads a board under a name, and makes it the current board.
+
+@item Use
+Makes a loaded board the current board.  The other ones stay loaded.
+
+@item Close
+Unloads a board that is not the current one.
+
+@end table
+
+Changing the current board clears the undo list.
+
+%end-doc */
+
+static int
+board (int argc, char **argv, Coord x, Coord y)
+{
+  BatchBoard *b;
+  PCBType *old, *loaded;
+  int old_stack[MAX_LAYER], stack[MAX_LAYER];
+  guint i;
+
+  if (boards == NULL)
+    boards = g_ptr_array_new ();
+  if (board_name == NULL)
+    board_name = strdup ("main");
+
+  if (argc == 1 && strcasecmp (argv[0], "List") == 0)
+    {
+      printf ("* %s %s\n", board_name,
+	      PCB && PCB->Filename ? PCB->Filename : "");
+      for (i = 0; i < boards->len; i++)
+	{
+	  b = (BatchBoard *) g_ptr_array_index (boards, i);
+	  printf ("  %s %s\n", b->name,
+		  b->pcb->Filename ? b->pcb->Filename : "");
+	}
+      return 0;
+    }
+
+  if (argc == 3 && strcasecmp (argv[0], "Load") == 0)
+    {
+      if (strcmp (argv[1], board_name) == 0 || find_board (argv[1]))
+	{
+	  Message ("Board %s is already loaded.\n", argv[1]);
+	  return 1;
+	}
+      /* LoadPCB replaces the current board, so give it a spare one */
+      old = PCB;
+      memcpy (old_stack, LayerStack, sizeof (old_stack));
+      PCB = CreateNewPCB ();
+      if (LoadPCB (argv[2]))
+	{
+	  RemovePCB (PCB);
+	  PCB = old;
+	  memcpy (LayerStack, old_stack, sizeof (LayerStack));
+	  hid_action ("PCBChanged");
+	  return 1;
+	}
+      loaded = PCB;
+      memcpy (stack, LayerStack, sizeof (stack));
+      PCB = old;
+      memcpy (LayerStack, old_stack, sizeof (LayerStack));
+      switch_board (loaded, stack, argv[1]);
+      return 0;
+    }
+
+  if (argc == 2 && strcasecmp (argv[0], "Use") == 0)
+    {
+      if (strcmp (argv[1], board_name) == 0)
+	return 0;
+      b = find_board (argv[1]);
+      if (b == NULL)
+	{
+	  Message ("No board %s.\n", argv[1]);
+	  return 1;
+	}
+      g_ptr_array_remove (boards, b);
+      switch_board (b->pcb, b->stack, b->name);
+      free (b->name);
+      free (b);
+      return 0;
+    }
+
+  if (argc == 2 && strcasecmp (argv[0], "Close") == 0)
+    {
+      if (strcmp (argv[1], board_name) == 0)
+	{
+	  Message ("Board %s is the current board.\n", argv[1]);
+	  return 1;
+	}
+      b = find_board (argv[1]);
+      if (b == NULL)
+	{
+	  Message ("No board %s.\n", argv[1]);
+	  return 1;
+	}
+      g_ptr_array_remove (boards, b);
+      RemovePCB (b->pcb);
+      free (b->name);
+      free (b);
+      return 0;
+    }
+
+  AFAIL (board);
+}
+
 HID_Action batch_action_list[] = {
   {"PCBChanged", 0, PCBChanged },
   {"RouteStylesChanged", 0, nop },
@@ -144,7 +365,8 @@ HID_Action batch_action_list[] = {
   {"LibraryChanged", 0, nop },
   {"Busy", 0, nop },
   {"Help", 0, help },
-  {"Info", 0, info }
+  {"Info", 0, info },
+  {"Board", 0, board, board_help, board_syntax }
 };
 
 REGISTER_ACTIONS (batch_action_list)
@@ -152,12 +374,245 @@ REGISTER_ACTIONS (batch_action_list)
 
 /* ----------------------------------------------------------------------------- */
 
+/* ----------------------------------------------------------------------------- */
+
+#ifdef BATCH_SERVER
+
+/*!
+ * \brief A client of the --listen server, what it sent that is not a
+ * whole line yet, and what is still to be sent to it.
+ */
+typedef struct
+{
+  int fd;
+  GString *input;
+  GString *output;
+} BatchClient;
+
+/* what the commands print goes here, and from here to the client */
+static FILE *serve_capture = NULL;
+
+/*!
+ * \brief Run a command for a client, with what it prints going to the
+ * output of the client.
+ *
+ * The output is collected in a file first and sent when the client can
+ * take it, so a client that does not read cannot hold up the others.
+ */
+static void
+serve_command (BatchClient *c, char *line)
+{
+  char buf[4096];
+  int saved, ret;
+  size_t n;
+
+  fflush (stdout);
+  rewind (serve_capture);
+  if (ftruncate (fileno (serve_capture), 0) < 0)
+    return;
+  saved = dup (1);
+  dup2 (fileno (serve_capture), 1);
+  ret = hid_parse_command (line);
+  fflush (stdout);
+  dup2 (saved, 1);
+  close (saved);
+
+  rewind (serve_capture);
+  while ((n = fread (buf, 1, sizeof (buf), serve_capture)) > 0)
+    g_string_append_len (c->output, buf, n);
+  g_string_append_printf (c->output, "=> %d\n", ret);
+}
+
+/*!
+ * \brief Read what a client sent, and run the whole lines.
+ *
+ * \return false once the client has gone.
+ */
+static bool
+serve_client (BatchClient *c)
+{
+  char buf[4096], *nl;
+  ssize_t n;
+
+  n = read (c->fd, buf, sizeof (buf));
+  if (n <= 0)
+    return n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK);
+  g_string_append_len (c->input, buf, n);
+  while ((nl = memchr (c->input->str, '\n', c->input->len)) != NULL)
+    {
+      gsize len = nl - c->input->str + 1;
+      char *line = g_strndup (c->input->str, len);
+
+      g_string_erase (c->input, 0, len);
+      serve_command (c, line);
+      g_free (line);
+    }
+  return true;
+}
+
+/*!
+ * \brief Send a client as much of its output as it takes without
+ * waiting.
+ *
+ * \return false if the client has gone.
+ */
+static bool
+serve_output (BatchClient *c)
+{
+  while (c->output->len > 0)
+    {
+      ssize_t n = write (c->fd, c->output->str, c->output->len);
+
+      if (n < 0)
+	return errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK;
+      g_string_erase (c->output, 0, n);
+    }
+  return true;
+}
+
+static void
+serve_close (BatchClient *c)
+{
+  close (c->fd);
+  g_string_free (c->input, TRUE);
+  g_string_free (c->output, TRUE);
+  free (c);
+}
+
+/*!
+ * \brief Serve commands on a Unix domain socket until pcb quits.
+ *
+ * The commands of all the clients run one at a time, in the process
+ * that has the boards loaded, as the core is not made to be entered
+ * from more than one thread.  The sockets do not block: a client is
+ * sent its output as it reads it, and is not read from while it has
+ * output waiting, so a slow client only waits for itself.
+ */
+static void
+batch_serve (const char *path)
+{
+  struct sockaddr_un addr;
+  GPtrArray *clients = g_ptr_array_new ();
+  GArray *fds = g_array_new (FALSE, FALSE, sizeof (struct pollfd));
+  int sock;
+  guint i;
+
+  if (strlen (path) >= sizeof (addr.sun_path))
+    {
+      fprintf (stderr, "Socket name %s is too long.\n", path);
+      return;
+    }
+  serve_capture = tmpfile ();
+  if (serve_capture == NULL)
+    {
+      perror ("tmpfile");
+      return;
+    }
+  sock = socket (AF_UNIX, SOCK_STREAM, 0);
+  if (sock < 0)
+    {
+      perror ("socket");
+      return;
+    }
+  memset (&addr, 0, sizeof (addr));
+  addr.sun_family = AF_UNIX;
+  strcpy (addr.sun_path, path);
+  unlink (path);
+  if (bind (sock, (struct sockaddr *) &addr, sizeof (addr)) < 0
+      || listen (sock, 16) < 0)
+    {
+      perror (path);
+      close (sock);
+      return;
+    }
+  fcntl (sock, F_SETFL, fcntl (sock, F_GETFL) | O_NONBLOCK);
+  /* a client that goes away must not take the server with it */
+  signal (SIGPIPE, SIG_IGN);
+
+  while (1)
+    {
+      struct pollfd *pfd;
+
+      /* the socket is first, then the clients in their order */
+      g_array_set_size (fds, clients->len + 1);
+      pfd = &g_array_index (fds, struct pollfd, 0);
+      pfd[0].fd = sock;
+      pfd[0].events = POLLIN;
+      for (i = 0; i < clients->len; i++)
+	{
+	  BatchClient *c = (BatchClient *) g_ptr_array_index (clients, i);
+	  pfd[i + 1].fd = c->fd;
+	  pfd[i + 1].events = c->output->len > 0 ? POLLOUT : POLLIN;
+	}
+      if (poll (pfd, fds->len, -1) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  perror ("poll");
+	  break;
+	}
+
+      /* the clients accepted below are polled from the next round on */
+      for (i = clients->len; i-- > 0;)
+	{
+	  BatchClient *c = (BatchClient *) g_ptr_array_index (clients, i);
+	  short revents = pfd[i + 1].revents;
+	  bool alive = true;
+
+	  if (revents & POLLOUT)
+	    alive = serve_output (c);
+	  else if (revents & (POLLIN | POLLHUP | POLLERR))
+	    alive = serve_client (c) && serve_output (c);
+	  if (!alive)
+	    {
+	      serve_close (c);
+	      g_ptr_array_remove_index (clients, i);
+	    }
+	}
+
+      if (pfd[0].revents & POLLIN)
+	{
+	  int fd;
+
+	  while ((fd = accept (sock, NULL, NULL)) >= 0)
+	    {
+	      BatchClient *c = (BatchClient *) calloc (1, sizeof (BatchClient));
+	      fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+	      c->fd = fd;
+	      c->input = g_string_new (NULL);
+	      c->output = g_string_new (NULL);
+	      g_ptr_array_add (clients, c);
+	    }
+	}
+    }
+
+  for (i = 0; i < clients->len; i++)
+    serve_close ((BatchClient *) g_ptr_array_index (clients, i));
+  g_ptr_array_free (clients, TRUE);
+  g_array_free (fds, TRUE);
+  fclose (serve_capture);
+  close (sock);
+  unlink (path);
+}
+
+#endif
+
 static void
 batch_do_export (HID_Attr_Val * options)
 {
   int interactive;
   char line[1000];
 
+  if (listen_path && *listen_path)
+    {
+#ifdef BATCH_SERVER
+      batch_serve (listen_path);
+#else
+      fprintf (stderr, "This pcb cannot serve actions on a socket.\n");
+#endif
+      return;
+    }
+
   if (isatty (0))
     interactive = 1;
   else
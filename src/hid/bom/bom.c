@@ -57,6 +57,7 @@
 
 #include "hid.h"
 #include "hid/common/hidnogui.h"
+#include "hid/common/placement.h"
 #include "../hidint.h"
 
 #ifdef HAVE_LIBDMALLOC
@@ -152,10 +153,24 @@ typedef struct _BomList
   char *value;
   int num;
   StringList *refdes;
+  StringList *last_refdes; /*!< Where the next refdes is appended. */
   char **attrs;
   struct _BomList *next;
 } BomList;
 
+/*!
+ * \brief The groups of a bill of materials.
+ *
+ * The groups are listed in the order their first part was found in, and
+ * are also kept in a hash table keyed by description, value and
+ * attributes, so that each part finds its group at once.
+ */
+typedef struct
+{
+  BomList *first, *last;
+  GHashTable *groups;
+} BomTable;
+
 static HID_Attribute *
 bom_get_export_options (int *n)
 {
@@ -188,9 +203,9 @@ static char *
 CleanBOMString (char *in)
 {
   char *out;
-  int i;
+  size_t i, len = strlen (in);
 
-  if ((out = (char *)malloc ((strlen (in) + 1) * sizeof (char))) == NULL)
+  if ((out = (char *)malloc ((len + 1) * sizeof (char))) == NULL)
     {
       fprintf (stderr, (_("Error:  CleanBOMString() malloc() failed\n")));
       exit (1);
@@ -200,7 +215,7 @@ CleanBOMString (char *in)
    * copy over in to out with some character conversions.
    * Go all the way to then end to get the terminating \0
    */
-  for (i = 0; i <= strlen (in); i++)
+  for (i = 0; i <= len; i++)
     {
       switch (in[i])
 	{
@@ -216,112 +231,89 @@ CleanBOMString (char *in)
 }
 
 
-static double
-xyToAngle (double x, double y, bool morethan2pins)
-{
-  double d = atan2 (-y, x) * 180.0 / M_PI;
-
-  /* IPC 7351 defines different rules for 2 pin elements */
-  if (morethan2pins)
-    {
-      /* Multi pin case:
-       * Output 0 degrees if pin1 in is top left or top, i.e. between angles of
-       * 80 to 170 degrees.
-       * Pin #1 can be at dead top (e.g. certain PLCCs) or anywhere in the top
-       * left.
-       */	    
-      if (d < -100)
-        return 90; /* -180 to -100 */
-      else if (d < -10)
-        return 180; /* -100 to -10 */
-      else if (d < 80)
-        return 270; /* -10 to 80 */
-      else if (d < 170)
-        return 0; /* 80 to 170 */
-      else
-        return 90; /* 170 to 180 */
-    }
-  else
-    {
-      /* 2 pin element:
-       * Output 0 degrees if pin #1 is in top left or left, i.e. in sector
-       * between angles of 95 and 185 degrees.
-       */
-      if (d < -175)
-        return 0; /* -180 to -175 */
-      else if (d < -85)
-        return 90; /* -175 to -85 */
-      else if (d < 5)
-        return 180; /* -85 to 5 */
-      else if (d < 95)
-        return 270; /* 5 to 95 */
-      else
-        return 0; /* 95 to 180 */
-    }
-}
-
-static StringList *
-string_insert (char *str, StringList * list)
+/*!
+ * \brief Append a copy of \c str to the refdes list of a group.
+ */
+static void
+string_append (char *str, BomList * bom)
 {
-  StringList *newlist, *cur;
+  StringList *newlist;
 
   if ((newlist = (StringList *) malloc (sizeof (StringList))) == NULL)
     {
-      fprintf (stderr, (_("malloc() failed in string_insert()\n")));
+      fprintf (stderr, (_("malloc() failed in string_append()\n")));
       exit (1);
     }
 
   newlist->next = NULL;
   newlist->str = strdup (str);
 
-  if (list == NULL)
-    return (newlist);
+  if (bom->last_refdes)
+    bom->last_refdes->next = newlist;
+  else
+    bom->refdes = newlist;
+  bom->last_refdes = newlist;
+}
+
+static guint
+bom_hash (gconstpointer key)
+{
+  const BomList *b = (const BomList *) key;
+  guint h = g_str_hash (b->descr) * 31 + g_str_hash (b->value);
+  int i;
 
-  cur = list;
-  while (cur->next != NULL)
-    cur = cur->next;
+  for (i = 0; i < attr_count; i++)
+    h = h * 31 + g_str_hash (b->attrs[i]);
+  return h;
+}
 
-  cur->next = newlist;
+static gboolean
+bom_equal (gconstpointer va, gconstpointer vb)
+{
+  const BomList *a = (const BomList *) va, *b = (const BomList *) vb;
+  int i;
 
-  return (list);
+  if (strcmp (a->descr, b->descr) != 0 || strcmp (a->value, b->value) != 0)
+    return FALSE;
+  for (i = 0; i < attr_count; i++)
+    if (strcmp (a->attrs[i], b->attrs[i]) != 0)
+      return FALSE;
+  return TRUE;
 }
 
-static BomList *
-bom_insert (char *refdes, char *descr, char *value, ElementType *e, BomList * bom)
+/*!
+ * \brief Count a part in the group of its description, value and
+ * attributes, making the group if it is the first part of it.
+ */
+static void
+bom_insert (char *refdes, char *descr, char *value, ElementType *e, BomTable * bom)
 {
-  BomList *newlist = NULL, *cur = NULL, *prev = NULL;
+  BomList key, *newlist;
   int i;
   char *val;
 
-
-  if (bom != NULL)
+  if ((key.attrs = (char **) malloc ((attr_count + 1) * sizeof (char *))) == NULL)
     {
-      /* search and see if we already have used one of these
-	 components */
-      cur = bom;
-      while (cur != NULL)
-	{
-	  int attr_mismatch = 0;
+      fprintf (stderr, (_("malloc() failed in bom_insert()\n")));
+      exit (1);
+    }
 
-	  for (i=0; i<attr_count; i++)
-	    {
-	      val = AttributeGet (e, attr_list[i]);
-	      val = val ? val : "";
-	      if (strcmp (val, cur->attrs[i]) != 0)
-		attr_mismatch = 1;
-	    }
+  for (i=0; i<attr_count; i++)
+    {
+      val = AttributeGet (e, attr_list[i]);
+      key.attrs[i] = val ? val : "";
+    }
+  key.descr = descr;
+  key.value = value;
 
-	  if ((NSTRCMP (descr, cur->descr) == 0) &&
-	      (NSTRCMP (value, cur->value) == 0) &&
-	      ! attr_mismatch)
-	    {
-	      cur->num++;
-	      cur->refdes = string_insert (refdes, cur->refdes);
-	      return (bom);
-	    }
-	  prev = cur;
-	  cur = cur->next;
-	}
+  /* see if we already have used one of these components */
+  newlist = (BomList *) g_hash_table_lookup (bom->groups, &key);
+  if (newlist != NULL)
+    {
+      free (key.attrs);
+      newlist->num++;
+      string_append (refdes, newlist);
+      return;
     }
 
   if ((newlist = (BomList *) malloc (sizeof (BomList))) == NULL)
@@ -330,32 +322,20 @@ bom_insert (char *refdes, char *descr, char *value, ElementType *e, BomList * bo
       exit (1);
     }
 
-  if (prev)
-    prev->next = newlist;
-
   newlist->next = NULL;
   newlist->descr = strdup (descr);
   newlist->value = strdup (value);
   newlist->num = 1;
-  newlist->refdes = string_insert (refdes, NULL);
-
-  if ((newlist->attrs = (char **) malloc (attr_count * sizeof (char *))) == NULL)
-    {
-      fprintf (stderr, (_("malloc() failed in bom_insert()\n")));
-      exit (1);
-    }
-
-  for (i=0; i<attr_count; i++)
-    {
-      val = AttributeGet (e, attr_list[i]);
-      newlist->attrs[i] = val ? val : "";
-    }
-
-  if (bom == NULL)
-    bom = newlist;
-
-  return (bom);
+  newlist->attrs = key.attrs;
+  newlist->refdes = newlist->last_refdes = NULL;
+  string_append (refdes, newlist);
 
+  if (bom->last)
+    bom->last->next = newlist;
+  else
+    bom->first = newlist;
+  bom->last = newlist;
+  g_hash_table_insert (bom->groups, newlist, newlist);
 }
 
 /*!
@@ -452,41 +432,15 @@ fetch_attr_list ()
   fclose (f);
 }
 
-/*!
- * Maximum length of following list.
- */
-#define MAXREFPINS 32
-
-/*!
- * \brief Includes numbered and BGA pins.
- *
- * In order of preference.
- * Possibly BGA pins can be missing, so we add a few to try.
- */
-static char *reference_pin_names[] = {"1", "2", "A1", "A2", "B1", "B2", 0};
-
 static int
 PrintBOM (void)
 {
   char utcTime[64];
-  Coord x, y;
-  double theta = 0.0;
-  double sumx, sumy;
-  int pinfound[MAXREFPINS];
-  double pinx[MAXREFPINS];
-  double piny[MAXREFPINS];
-  double pinangle[MAXREFPINS];
-  double padcentrex, padcentrey;
-  double centroidx, centroidy;
-  double pin1x, pin1y;
-  int pin_cnt;
-  int found_any_not_at_centroid;
-  int found_any;
+  ElementPlacementType place;
   time_t currenttime;
   FILE *fp;
-  BomList *bom = NULL;
-  char *name, *descr, *value,*fixed_rotation;
-  int rpindex;
+  BomTable bom;
+  char *name, *descr, *value;
   int i;
   char fmt[256];
 
@@ -501,6 +455,8 @@ PrintBOM (void)
     }
 
   fetch_attr_list ();
+  bom.first = bom.last = NULL;
+  bom.groups = g_hash_table_new (bom_hash, bom_equal);
 
   /* Create a portable timestamp. */
   currenttime = time (NULL);
@@ -527,162 +483,40 @@ PrintBOM (void)
 
   ELEMENT_LOOP (PCB->Data);
   {
-
-    /* Initialize our pin count and our totals for finding the centroid. */
-    pin_cnt = 0;
-    sumx = 0.0;
-    sumy = 0.0;
-    for (rpindex = 0; rpindex < MAXREFPINS; rpindex++)
-      pinfound[rpindex] = 0;
-
     /* Insert this component into the bill of materials list. */
-    bom = bom_insert ((char *)UNKNOWN (NAMEONPCB_NAME (element)),
+    bom_insert ((char *)UNKNOWN (NAMEONPCB_NAME (element)),
                       (char *)UNKNOWN (DESCRIPTION_NAME (element)),
                       (char *)UNKNOWN (VALUE_NAME (element)),
 		      element,
-		      bom);
+		      &bom);
 
-
-    /*
-     * Iterate over the pins and pads keeping a running count of how
-     * many pins/pads total and the sum of x and y coordinates
-     *
-     * While we're at it, store the location of pin/pad #1 and #2 if
-     * we can find them.
-     */
-
-    PIN_LOOP (element);
-    {
-      sumx += (double) pin->X;
-      sumy += (double) pin->Y;
-      pin_cnt++;
-
-      for (rpindex = 0; reference_pin_names[rpindex]; rpindex++)
-        {
-          if (NSTRCMP (pin->Number, reference_pin_names[rpindex]) == 0)
-            {
-                pinx[rpindex] = (double) pin->X;
-                piny[rpindex] = (double) pin->Y;
-                pinangle[rpindex] = 0.0; /* pins have no notion of angle */
-                pinfound[rpindex] = 1;
-            }
-        }
-    }
-    END_LOOP;
-
-    PAD_LOOP (element);
-    {
-      sumx += (pad->Point1.X + pad->Point2.X) / 2.0;
-      sumy += (pad->Point1.Y + pad->Point2.Y) / 2.0;
-      pin_cnt++;
-
-      for (rpindex = 0; reference_pin_names[rpindex]; rpindex++)
-        {
-          if (NSTRCMP (pad->Number, reference_pin_names[rpindex]) == 0)
-            {
-              padcentrex = (double) (pad->Point1.X + pad->Point2.X) / 2.0;
-              padcentrey = (double) (pad->Point1.Y + pad->Point2.Y) / 2.0;
-              pinx[rpindex] = padcentrex;
-              piny[rpindex] = padcentrey;
-              /*
-               * NOTE: We swap the Y points because in PCB, the Y-axis
-               * is inverted.  Increasing Y moves down.  We want to deal
-               * in the usual increasing Y moves up coordinates though.
-               */
-              pinangle[rpindex] = (180.0 / M_PI) * atan2 (pad->Point1.Y - pad->Point2.Y,
-                pad->Point2.X - pad->Point1.X);
-              pinfound[rpindex]=1;
-            }
-        }
-    }
-    END_LOOP;
-
-    if (pin_cnt > 0)
+    ElementGetPlacement (element, false, &place);
+    if (place.pins > 0)
       {
-	centroidx = sumx / (double) pin_cnt;
-	centroidy = sumy / (double) pin_cnt;
-	      
-	if (NSTRCMP( AttributeGetFromList (&element->Attributes,"xy-centre"), "origin") == 0 )
+	if (place.status == PLACEMENT_NO_REFPIN)
 	  {
-            x = element->MarkX;
-            y = element->MarkY;
+	    Message
+	      ("PrintBOM(): unable to figure out angle because I could\n"
+	       "     not find a suitable reference pin of element %s\n"
+	       "     Setting to %g degrees\n",
+	       UNKNOWN (NAMEONPCB_NAME (element)), place.rotation);
 	  }
-	else
+	else if (place.status == PLACEMENT_REFPIN_AT_CENTRE)
 	  {
-            x = centroidx;
-            y = centroidy;
+	    Message
+	      ("PrintBOM(): unable to figure out angle of element\n"
+	       "     %s because the reference pin(s) are at the centroid of the part.\n"
+	       "     Setting to %g degrees\n",
+	       UNKNOWN (NAMEONPCB_NAME (element)), place.rotation);
 	  }
-	
-	fixed_rotation = AttributeGetFromList (&element->Attributes, "xy-fixed-rotation");
-	if (fixed_rotation)
-	  {	
-            /* The user specified a fixed rotation */
-            theta = atof (fixed_rotation);
-            found_any_not_at_centroid = 1;
-            found_any = 1;
-	  } 
-	else
-	  {
-            /* Find first reference pin not at the  centroid  */
-            found_any_not_at_centroid = 0;
-            found_any = 0;
-            theta = 0.0;
-            for (rpindex = 0;
-                 reference_pin_names[rpindex] && !found_any_not_at_centroid;
-                 rpindex++)
-              {
-		if (pinfound[rpindex])
-		  {
-                    found_any = 1;
-
-                    /* Recenter pin "#1" onto the axis which cross at the part
-                       centroid */
-                    pin1x = pinx[rpindex] - x;
-                    pin1y = piny[rpindex] - y;
-
-                    /* flip x, to reverse rotation for elements on back */
-                    if (FRONT (element) != 1)
-                        pin1x = -pin1x;
-
-                    /* if only 1 pin, use pin 1's angle */
-                    if (pin_cnt == 1)
-                      {
-                        theta = pinangle[rpindex];
-                        found_any_not_at_centroid = 1;
-                      }
-                    else if ((pin1x != 0.0) || (pin1y != 0.0))
-                      {
-                        theta = xyToAngle (pin1x, pin1y, pin_cnt > 2);
-                        found_any_not_at_centroid = 1;
-                      }
-                  }
-              }
-
-            if (!found_any)
-              {
-                Message
-                  ("PrintBOM(): unable to figure out angle because I could\n"
-                   "     not find a suitable reference pin of element %s\n"
-                   "     Setting to %g degrees\n",
-                   UNKNOWN (NAMEONPCB_NAME (element)), theta);
-              }
-            else if (!found_any_not_at_centroid)
-              {
-                Message
-                      ("PrintBOM(): unable to figure out angle of element\n"
-                       "     %s because the reference pin(s) are at the centroid of the part.\n"
-                       "     Setting to %g degrees\n",
-                       UNKNOWN (NAMEONPCB_NAME (element)), theta);
-	      }
-          }
 	name = CleanBOMString ((char *)UNKNOWN (NAMEONPCB_NAME (element)));
 	descr = CleanBOMString ((char *)UNKNOWN (DESCRIPTION_NAME (element)));
 	value = CleanBOMString ((char *)UNKNOWN (VALUE_NAME (element)));
 
- 	y = PCB->MaxHeight - y;
 	//pcb_fprintf (fp, "%m+%s,\"%s\",\"%s\",%.2`mS,%.2`mS,%g,%s\n",
-	pcb_fprintf (fp, fmt, name, descr, value, x, y, theta, 
-                          FRONT (element) == 1 ? "top" : "bottom");
+	pcb_fprintf (fp, fmt, name, descr, value, place.x,
+		     PCB->MaxHeight - place.y, place.rotation,
+		     place.front ? "top" : "bottom");
 	free (name);
 	free (descr);
 	free (value);
@@ -691,6 +525,7 @@ PrintBOM (void)
   END_LOOP;
 
   fclose (fp);
+  g_hash_table_destroy (bom.groups);
 
   /* Now print out a Bill of Materials file */
 
@@ -698,7 +533,7 @@ PrintBOM (void)
   if (!fp)
     {
       gui->log ((_("Cannot open file %s for writing\n")), bom_filename);
-      print_and_free (NULL, bom);
+      print_and_free (NULL, bom.first);
       return 1;
     }
 
@@ -712,7 +547,7 @@ PrintBOM (void)
   fprintf (fp, "\n");
   fprintf (fp, "# --------------------------------------------\n");
 
-  print_and_free (fp, bom);
+  print_and_free (fp, bom.first);
 
   fclose (fp);
 
@@ -21,6 +21,13 @@
 static HID_Action **all_actions = 0;
 static int all_actions_sorted = 0;
 static int n_actions = 0;
+/* hid_find_action() has had the plugins loaded for a miss */
+static int all_plugins_loaded = 0;
+
+/* The actions by name, and by name regardless of case, built along
+   with the sorted list.  */
+static GHashTable *action_table = NULL;
+static GHashTable *action_table_nocase = NULL;
 
 HID_Action *current_action = NULL;
 
@@ -68,26 +75,60 @@ action_sort_compar (const void *va, const void *vb)
   return strcmp (a->name, b->name);
 }
 
+static guint
+action_nocase_hash (gconstpointer key)
+{
+  const char *p = (const char *) key;
+  guint h = 5381;
+
+  while (*p)
+    h = h * 33 + tolower ((int) (unsigned char) *p++);
+  return h;
+}
+
+static gboolean
+action_nocase_equal (gconstpointer a, gconstpointer b)
+{
+  return strcasecmp ((const char *) a, (const char *) b) == 0;
+}
+
+/*!
+ * \brief Sort the actions, and index them by name.
+ *
+ * Of the actions whose names differ only in case, the first in sorted
+ * order is the one found regardless of case.
+ */
 static void
 sort_actions ()
 {
+  int i;
+
   qsort (all_actions, n_actions, sizeof (HID_Action*), action_sort_compar);
   all_actions_sorted = 1;
-}
 
-static int
-action_search_compar (const void *va, const void *vb)
-{
-  char *name = (char*)va;
-  HID_Action *action = *(HID_Action**)vb;
-  return strcmp (name, action->name);
+  if (action_table)
+    {
+      g_hash_table_destroy (action_table);
+      g_hash_table_destroy (action_table_nocase);
+    }
+  action_table = g_hash_table_new (g_str_hash, g_str_equal);
+  action_table_nocase = g_hash_table_new (action_nocase_hash,
+                                          action_nocase_equal);
+  for (i = 0; i < n_actions; i++)
+    {
+      if (!g_hash_table_lookup (action_table, all_actions[i]->name))
+        g_hash_table_insert (action_table, (gpointer) all_actions[i]->name,
+                             all_actions[i]);
+      if (!g_hash_table_lookup (action_table_nocase, all_actions[i]->name))
+        g_hash_table_insert (action_table_nocase,
+                             (gpointer) all_actions[i]->name, all_actions[i]);
+    }
 }
 
 HID_Action *
 hid_find_action (const char *name)
 {
-  HID_Action **action;
-  int i;
+  HID_Action *action;
   
   if (name == NULL)
     return 0;
@@ -95,14 +136,21 @@ hid_find_action (const char *name)
   if (!all_actions_sorted)
     sort_actions ();
 
-  action = (HID_Action **)bsearch (name, all_actions, n_actions, sizeof (HID_Action*),
-                    action_search_compar);
+  action = (HID_Action *) g_hash_table_lookup (action_table, name);
   if (action)
-    return *action;
+    return action;
 
-  for (i = 0; i < n_actions; i++)
-    if (strcasecmp (all_actions[i]->name, name) == 0)
-      return all_actions[i];
+  action = (HID_Action *) g_hash_table_lookup (action_table_nocase, name);
+  if (action)
+    return action;
+
+  /* export runs only load the plugins when they need one of theirs */
+  if (!all_plugins_loaded)
+    {
+      all_plugins_loaded = 1;
+      hid_load_plugins ();
+      return hid_find_action (name);
+    }
 
   printf ("unknown action `%s'\n", name);
   return 0;
@@ -113,6 +161,7 @@ print_actions ()
 {
   int i;
 
+  hid_load_plugins ();
   if (!all_actions_sorted)
     sort_actions ();
   
@@ -168,6 +217,7 @@ dump_actions ()
 {
   int i;
 
+  hid_load_plugins ();
   if (!all_actions_sorted)
     sort_actions ();
 
@@ -246,8 +296,125 @@ hid_actionv (const char *name, int argc, char **argv)
   return ret;
 }
 
-static int
-hid_parse_actionstring (const char *rstr, char require_parens)
+/*!
+ * \brief One action call of an action script.
+ */
+typedef struct
+{
+  enum { ACTION_CALL, ACTION_SYNTAX_ERROR } kind;
+  /*! The string the call came from.  A failed call skips the rest. */
+  int group;
+  /*! Where in the text the action name is, or the whole string of a
+      syntax error.  */
+  size_t name;
+  int argc;
+  /*! The first argument in args. */
+  int first_arg;
+} ActionStep;
+
+/*!
+ * \brief Action strings parsed into the calls they make.
+ *
+ * The names and arguments are kept in one block of text, with the
+ * arguments as offsets into it, so a run only has to copy the text to
+ * give the actions strings of their own.
+ */
+struct HID_ActionScript
+{
+  int refs;
+  int groups;
+  ActionStep *steps;
+  int n_steps, max_steps;
+  size_t *args;
+  int n_args, max_args;
+  char *text;
+  size_t text_len, text_max;
+};
+
+/*!
+ * \brief Parsed action strings, for hid_parse_command() and
+ * hid_parse_actions(), by the string.
+ */
+static GHashTable *script_cache[2] = { NULL, NULL };
+#define SCRIPT_CACHE_MAX 256
+
+static size_t
+script_add_text (HID_ActionScript *script, const char *text, size_t len)
+{
+  size_t at = script->text_len;
+
+  if (script->text_len + len > script->text_max)
+    {
+      script->text_max = MAX (2 * script->text_max, script->text_len + len);
+      script->text = (char *) realloc (script->text, script->text_max);
+    }
+  memcpy (script->text + at, text, len);
+  script->text_len += len;
+  return at;
+}
+
+static ActionStep *
+script_add_step (HID_ActionScript *script)
+{
+  ActionStep *step;
+
+  if (script->n_steps == script->max_steps)
+    {
+      script->max_steps = script->max_steps ? 2 * script->max_steps : 4;
+      script->steps = (ActionStep *)
+        realloc (script->steps, script->max_steps * sizeof (ActionStep));
+    }
+  step = &script->steps[script->n_steps++];
+  memset (step, 0, sizeof (*step));
+  step->group = script->groups;
+  return step;
+}
+
+/*!
+ * \brief Add a call to a script.
+ *
+ * The name and arguments are in str, up to end.
+ */
+static void
+script_add_call (HID_ActionScript *script, char *str, char *end,
+                 char *aname, int argc, char **argv)
+{
+  ActionStep *step = script_add_step (script);
+  size_t base = script_add_text (script, str, end - str);
+  int i;
+
+  step->kind = ACTION_CALL;
+  step->name = base + (aname - str);
+  step->argc = argc;
+  step->first_arg = script->n_args;
+  if (script->n_args + argc > script->max_args)
+    {
+      script->max_args = MAX (2 * script->max_args, script->n_args + argc);
+      script->args = (size_t *)
+        realloc (script->args, script->max_args * sizeof (size_t));
+    }
+  for (i = 0; i < argc; i++)
+    script->args[script->n_args++] = base + (argv[i] - str);
+}
+
+static void
+script_add_syntax_error (HID_ActionScript *script, const char *rstr)
+{
+  ActionStep *step = script_add_step (script);
+
+  step->kind = ACTION_SYNTAX_ERROR;
+  step->name = script_add_text (script, rstr, strlen (rstr) + 1);
+}
+
+/*!
+ * \brief Parse an action string onto the end of a script.
+ *
+ * The calls are recorded in the order hid_actionv would be called for
+ * them, with a syntax error where parsing stops at one.
+ */
+static void
+hid_compile_actionstring (HID_ActionScript *script, const char *rstr,
+                          char require_parens)
 {
   char **list = NULL;
   int max = 0;
@@ -258,10 +425,10 @@ hid_parse_actionstring (const char *rstr, char require_parens)
   int maybe_empty = 0;
   char in_quotes = 0;
   char parens = 0;
-  int retcode = 0;
 
   /*fprintf(stderr, "invoke: `%s'\n", rstr);*/
 
+  script->groups++;
   sp = rstr;
   str = (char *)malloc(strlen(rstr)+1);
 
@@ -274,10 +441,7 @@ another:
     sp++;
   
   if (!*sp)
-    {
-      retcode = 0;
-      goto cleanup;
-    }
+    goto cleanup;
   
   aname = cp;
 
@@ -297,7 +461,7 @@ another:
    */
   if (!*sp)
     {
-      retcode = hid_actionv (aname, 0, 0);
+      script_add_call (script, str, cp, aname, 0, NULL);
       goto cleanup;
     }
 
@@ -309,9 +473,7 @@ another:
     }
   else if (require_parens)
     {
-      Message (_("Syntax error: %s\n"), rstr);
-      Message (_("    expected: Action(arg1, arg2)"));
-      retcode = 1;
+      script_add_syntax_error (script, rstr);
       goto cleanup;
     }
   
@@ -324,9 +486,7 @@ another:
        */
       if (!maybe_empty && ((parens && *sp == ')') || (!parens && !*sp)))
 	{
-          retcode = hid_actionv (aname, num, list);
-          if (retcode)
-            goto cleanup;
+          script_add_call (script, str, cp, aname, num, list);
 
           /* strip any white space or ';' following the action */
           if (parens)
@@ -401,8 +561,106 @@ another:
   
   if (str != NULL)
     free (str);
-  
-  return retcode;
+}
+
+HID_ActionScript *
+hid_compile_actions (HID_ActionScript *script, const char *str_)
+{
+  if (script == NULL)
+    {
+      script = (HID_ActionScript *) calloc (1, sizeof (HID_ActionScript));
+      script->refs = 1;
+    }
+  hid_compile_actionstring (script, str_, TRUE);
+  return script;
+}
+
+void
+hid_free_actions (HID_ActionScript *script)
+{
+  if (script == NULL || --script->refs > 0)
+    return;
+  free (script->steps);
+  free (script->args);
+  free (script->text);
+  free (script);
+}
+
+int
+hid_run_actions (HID_ActionScript *script)
+{
+  char *text, **args;
+  int i, ret = 0, r, skip = 0;
+
+  /* an action may parse actions itself, and so drop this from the cache */
+  script->refs++;
+
+  /* the actions get strings of their own, as they did when each run
+     parsed its string again */
+  text = (char *) malloc (script->text_len + 1);
+  memcpy (text, script->text, script->text_len);
+  args = (char **) malloc ((script->n_args + 1) * sizeof (char *));
+  for (i = 0; i < script->n_args; i++)
+    args[i] = text + script->args[i];
+
+  for (i = 0; i < script->n_steps; i++)
+    {
+      ActionStep *step = &script->steps[i];
+
+      if (step->group == skip)
+        continue;
+      if (step->kind == ACTION_SYNTAX_ERROR)
+        {
+          Message (_("Syntax error: %s\n"), text + step->name);
+          Message (_("    expected: Action(arg1, arg2)"));
+          r = 1;
+        }
+      else
+        r = hid_actionv (text + step->name, step->argc,
+                         step->argc ? args + step->first_arg : NULL);
+      if (r)
+        {
+          ret = r;
+          skip = step->group;
+        }
+    }
+
+  free (args);
+  free (text);
+  hid_free_actions (script);
+  return ret;
+}
+
+static void
+script_cache_free (gpointer data)
+{
+  hid_free_actions ((HID_ActionScript *) data);
+}
+
+/*!
+ * \brief Run an action string, parsing it only the first time it is
+ * seen.
+ */
+static int
+hid_parse_actionstring (const char *rstr, char require_parens)
+{
+  GHashTable **cache = &script_cache[require_parens ? 1 : 0];
+  HID_ActionScript *script;
+
+  if (*cache == NULL)
+    *cache = g_hash_table_new_full (g_str_hash, g_str_equal, free,
+                                    script_cache_free);
+  script = (HID_ActionScript *) g_hash_table_lookup (*cache, rstr);
+  if (script == NULL)
+    {
+      script = (HID_ActionScript *) calloc (1, sizeof (HID_ActionScript));
+      script->refs = 1;
+      hid_compile_actionstring (script, rstr, require_parens);
+      if (g_hash_table_size (*cache) >= SCRIPT_CACHE_MAX)
+        g_hash_table_remove_all (*cache);
+      g_hash_table_insert (*cache, strdup (rstr), script);
+    }
+  return hid_run_actions (script);
 }
 
 int hid_parse_command (const char *str_)
@@ -38,53 +38,111 @@ common_draw_pcb_arc (hidGC gc, ArcType *arc)
 
 /* ---------------------------------------------------------------------------
  * drawing routine for text objects
+ *
+ * The strokes of a text object, scaled, rotated, mirrored and moved into
+ * place, are kept from one redraw to the next.  Text objects are only
+ * known by address, which a new one may get after an old one is freed,
+ * so kept strokes are checked against everything they were made from.
  */
+#define TEXT_CACHE_MAX 8192	/* text objects kept */
+
+typedef struct
+{
+  LineType line;
+  bool box;			/* a default symbol, filled from Point1 to Point2 */
+} text_stroke;
+
+typedef struct
+{
+  /* what the text was like */
+  char *string;
+  Coord X, Y;
+  int Scale;
+  BYTE Direction;
+  bool on_solder;
+  Coord min_line_width;
+  FontType *font;
+  unsigned int font_gen;
+  /* its strokes */
+  GArray *strokes;
+} text_strokes;
+
+/* TextType * -> text_strokes * */
+static GHashTable *text_cache = NULL;
+
 static void
-common_draw_pcb_text (hidGC gc, TextType *Text, Coord min_line_width)
+free_text_strokes (gpointer data)
+{
+  text_strokes *ts = data;
+
+  g_free (ts->string);
+  g_array_free (ts->strokes, TRUE);
+  g_free (ts);
+}
+
+static bool
+text_strokes_match (text_strokes *ts, TextType *Text, Coord min_line_width)
+{
+  return ts->X == Text->X && ts->Y == Text->Y &&
+    ts->Scale == Text->Scale && ts->Direction == Text->Direction &&
+    ts->on_solder == (TEST_FLAG (ONSOLDERFLAG, Text) != 0) &&
+    ts->min_line_width == min_line_width &&
+    ts->font == &PCB->Font && ts->font_gen == PCB->Font.Generation &&
+    strcmp (ts->string, Text->TextString ? Text->TextString : "") == 0;
+}
+
+/*!
+ * \brief Make the strokes of a text object.
+ */
+static void
+make_text_strokes (text_strokes *ts, TextType *Text, Coord min_line_width)
 {
   Coord x = 0;
   unsigned char *string = (unsigned char *) Text->TextString;
   Cardinal n;
   FontType *font = &PCB->Font;
+  text_stroke stroke;
 
+  g_array_set_size (ts->strokes, 0);
   while (string && *string)
     {
       /* draw lines if symbol is valid and data is present */
       if (*string <= MAX_FONTPOSITION && font->Symbol[*string].Valid)
         {
           LineType *line = font->Symbol[*string].Line;
-          LineType newline;
+          LineType *newline = &stroke.line;
 
+          stroke.box = false;
           for (n = font->Symbol[*string].LineN; n; n--, line++)
             {
               /* create one line, scale, move, rotate and swap it */
-              newline = *line;
-              newline.Point1.X = SCALE_TEXT (newline.Point1.X + x, Text->Scale);
-              newline.Point1.Y = SCALE_TEXT (newline.Point1.Y, Text->Scale);
-              newline.Point2.X = SCALE_TEXT (newline.Point2.X + x, Text->Scale);
-              newline.Point2.Y = SCALE_TEXT (newline.Point2.Y, Text->Scale);
-              newline.Thickness = SCALE_TEXT (newline.Thickness, Text->Scale / 2);
-              if (newline.Thickness < min_line_width)
-                newline.Thickness = min_line_width;
+              *newline = *line;
+              newline->Point1.X = SCALE_TEXT (newline->Point1.X + x, Text->Scale);
+              newline->Point1.Y = SCALE_TEXT (newline->Point1.Y, Text->Scale);
+              newline->Point2.X = SCALE_TEXT (newline->Point2.X + x, Text->Scale);
+              newline->Point2.Y = SCALE_TEXT (newline->Point2.Y, Text->Scale);
+              newline->Thickness = SCALE_TEXT (newline->Thickness, Text->Scale / 2);
+              if (newline->Thickness < min_line_width)
+                newline->Thickness = min_line_width;
 
-              RotateLineLowLevel (&newline, 0, 0, Text->Direction);
+              RotateLineLowLevel (newline, 0, 0, Text->Direction);
 
               /* the labels of SMD objects on the bottom
                * side haven't been swapped yet, only their offset
                */
               if (TEST_FLAG (ONSOLDERFLAG, Text))
                 {
-                  newline.Point1.X = SWAP_SIGN_X (newline.Point1.X);
-                  newline.Point1.Y = SWAP_SIGN_Y (newline.Point1.Y);
-                  newline.Point2.X = SWAP_SIGN_X (newline.Point2.X);
-                  newline.Point2.Y = SWAP_SIGN_Y (newline.Point2.Y);
+                  newline->Point1.X = SWAP_SIGN_X (newline->Point1.X);
+                  newline->Point1.Y = SWAP_SIGN_Y (newline->Point1.Y);
+                  newline->Point2.X = SWAP_SIGN_X (newline->Point2.X);
+                  newline->Point2.Y = SWAP_SIGN_Y (newline->Point2.Y);
                 }
-              /* add offset and draw line */
-              newline.Point1.X += Text->X;
-              newline.Point1.Y += Text->Y;
-              newline.Point2.X += Text->X;
-              newline.Point2.Y += Text->Y;
-              gui->graphics->draw_pcb_line (gc, &newline);
+              /* add offset */
+              newline->Point1.X += Text->X;
+              newline->Point1.Y += Text->Y;
+              newline->Point2.X += Text->X;
+              newline->Point2.Y += Text->Y;
+              g_array_append_val (ts->strokes, stroke);
             }
 
           /* move on to next cursor position */
@@ -103,20 +161,79 @@ common_draw_pcb_text (hidGC gc, TextType *Text, Coord min_line_width)
 
           RotateBoxLowLevel (&defaultsymbol, 0, 0, Text->Direction);
 
-          /* add offset and draw box */
-          defaultsymbol.X1 += Text->X;
-          defaultsymbol.Y1 += Text->Y;
-          defaultsymbol.X2 += Text->X;
-          defaultsymbol.Y2 += Text->Y;
-          gui->graphics->fill_rect (gc,
-                                    defaultsymbol.X1, defaultsymbol.Y1,
-                                    defaultsymbol.X2, defaultsymbol.Y2);
+          /* add offset */
+          memset (&stroke, 0, sizeof (stroke));
+          stroke.box = true;
+          stroke.line.Point1.X = defaultsymbol.X1 + Text->X;
+          stroke.line.Point1.Y = defaultsymbol.Y1 + Text->Y;
+          stroke.line.Point2.X = defaultsymbol.X2 + Text->X;
+          stroke.line.Point2.Y = defaultsymbol.Y2 + Text->Y;
+          g_array_append_val (ts->strokes, stroke);
 
           /* move on to next cursor position */
           x += size;
         }
       string++;
     }
+
+  g_free (ts->string);
+  ts->string = g_strdup (Text->TextString ? Text->TextString : "");
+  ts->X = Text->X;
+  ts->Y = Text->Y;
+  ts->Scale = Text->Scale;
+  ts->Direction = Text->Direction;
+  ts->on_solder = TEST_FLAG (ONSOLDERFLAG, Text) != 0;
+  ts->min_line_width = min_line_width;
+  ts->font = &PCB->Font;
+  ts->font_gen = PCB->Font.Generation;
+}
+
+/*!
+ * \brief Find the strokes of a text object, making them again if the
+ * text changed since they were made.
+ */
+static text_strokes *
+lookup_text_strokes (TextType *Text, Coord min_line_width)
+{
+  text_strokes *ts;
+
+  if (text_cache == NULL)
+    text_cache = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                        free_text_strokes);
+
+  ts = g_hash_table_lookup (text_cache, Text);
+  if (ts != NULL && text_strokes_match (ts, Text, min_line_width))
+    return ts;
+
+  if (ts == NULL)
+    {
+      if (g_hash_table_size (text_cache) >= TEXT_CACHE_MAX)
+        g_hash_table_remove_all (text_cache);
+      ts = g_new0 (text_strokes, 1);
+      ts->strokes = g_array_new (FALSE, FALSE, sizeof (text_stroke));
+      g_hash_table_insert (text_cache, Text, ts);
+    }
+  make_text_strokes (ts, Text, min_line_width);
+  return ts;
+}
+
+static void
+common_draw_pcb_text (hidGC gc, TextType *Text, Coord min_line_width)
+{
+  text_strokes *ts = lookup_text_strokes (Text, min_line_width);
+  guint i;
+
+  for (i = 0; i < ts->strokes->len; i++)
+    {
+      text_stroke *stroke = &g_array_index (ts->strokes, text_stroke, i);
+
+      if (stroke->box)
+        gui->graphics->fill_rect (gc,
+                                  stroke->line.Point1.X, stroke->line.Point1.Y,
+                                  stroke->line.Point2.X, stroke->line.Point2.Y);
+      else
+        gui->graphics->draw_pcb_line (gc, &stroke->line);
+    }
 }
 
 static void
@@ -285,18 +402,25 @@ common_fill_pcb_polygon (hidGC gc, PolygonType *poly, const BoxType *clip_box)
   if (poly->Clipped == NULL)
     return;
 
-  if (!poly->NoHolesValid)
+  if (!NOHOLES_VALID (poly))
     {
       /* If enough of the polygon is on-screen, compute the entire
        * NoHoles version and cache it for later rendering, otherwise
-       * just compute what we need to render now.
+       * just compute what we need to render now.  A tiled cache only
+       * re-dices the tiles an edit touched, so always bring it up to date.
+       * Drawing the same Clipped area a second time means the view is
+       * being panned or zoomed rather than edited, so cache it then too.
        */
-      if (should_compute_no_holes (poly, clip_box))
+      if (poly->Tiles != NULL || poly->DicedGen == poly->ClippedGen ||
+          should_compute_no_holes (poly, clip_box))
         ComputeNoHoles (poly);
       else
-        NoHolesPolygonDicer (poly, clip_box, fill_contour_cb, gc);
+        {
+          NoHolesPolygonDicer (poly, clip_box, fill_contour_cb, gc);
+          poly->DicedGen = poly->ClippedGen;
+        }
     }
-  if (poly->NoHolesValid && poly->NoHoles)
+  if (NOHOLES_VALID (poly) && poly->NoHoles)
     {
       PLINE *pl;
 
@@ -0,0 +1,717 @@
+/*!
+ * \file src/hid/common/drawlist.c
+ *
+ * \brief Recording of the drawing of a board, to replay it to HIDs.
+ *
+ * An exporter that draws the board more than once, like the gerber
+ * exporter with its pass to find the apertures and its pass to write
+ * the files, walks the r-trees of the board and works out the colours
+ * and the clearances of the objects each time.  drawlist_record() does
+ * that walk once, and keeps the calls the drawing code makes to the HID
+ * in a compact list of ops: an op code, the id of the graphics context
+ * and the arguments, packed one after the other.  drawlist_replay()
+ * makes the same calls to any HID, as though hid_expose_callback() had
+ * drawn to it.
+ *
+ * The objects of the board are kept by pointer, so a list is only good
+ * for as long as the board does not change.  Texts are copied, since
+ * the names of pins and pads and the text of the fab drawing are made
+ * on the stack as they are drawn.  The layers are all
+ * recorded, and are skipped on replay when the set_layer() of the HID
+ * turns them down.  The drawing code asks the HID whether it is a GUI,
+ * and whether it wants the polygons drawn before or after the masks, so
+ * a list is recorded like a HID and can be replayed to HIDs that answer
+ * the same.
+ *
+ * A list is not changed by a replay, so the worker processes of an
+ * exporter can replay the list they inherit at the same time.  The HIDs
+ * keep their state in globals, so it cannot be replayed on threads.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "data.h"
+#include "profile.h"
+
+#include "hid.h"
+#include "hid_draw.h"
+#include "../hidint.h"
+#include "hid/common/drawlist.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+enum
+{
+  OP_MAKE_GC,
+  OP_DESTROY_GC,
+  OP_USE_MASK,
+  OP_SET_COLOR,
+  OP_SET_LINE_CAP,
+  OP_SET_LINE_WIDTH,
+  OP_SET_DRAW_XOR,
+  OP_SET_DRAW_FADED,
+  OP_DRAW_LINE,
+  OP_DRAW_ARC,
+  OP_DRAW_RECT,
+  OP_FILL_CIRCLE,
+  OP_FILL_POLYGON,
+  OP_FILL_RECT,
+  OP_DRAW_GRID,
+  OP_DRAW_PCB_LINE,
+  OP_DRAW_PCB_ARC,
+  OP_DRAW_PCB_TEXT,
+  OP_DRAW_PCB_POLYGON,
+  OP_FILL_PCB_POLYGON,
+  OP_THINDRAW_PCB_POLYGON,
+  OP_FILL_PCB_PAD,
+  OP_THINDRAW_PCB_PAD,
+  OP_FILL_PCB_PV,
+  OP_THINDRAW_PCB_PV,
+  OP_SET_LAYER,
+  OP_END_LAYER
+};
+
+struct draw_list
+{
+  GByteArray *ops;
+  /* the layer names and colours, and the strings of the texts */
+  GStringChunk *strings;
+  /* the copies of the texts drawn */
+  GPtrArray *texts;
+  /* graphics contexts made, the next id */
+  int n_gcs;
+};
+
+typedef struct hid_gc_struct
+{
+  int id;
+} hid_gc_struct;
+
+/* the list being recorded */
+static DrawList *rec = NULL;
+/* where the end of the layer being recorded goes into its OP_SET_LAYER */
+static guint open_layer;
+
+static void
+put (const void *data, size_t size)
+{
+  g_byte_array_append (rec->ops, (const guint8 *) data, size);
+}
+
+#define PUT(v) put (&(v), sizeof (v))
+#define GET(v) (memcpy (&(v), p, sizeof (v)), p += sizeof (v))
+
+static void
+put_op (int op, hidGC gc)
+{
+  guint8 code = op;
+
+  PUT (code);
+  if (gc)
+    PUT (gc->id);
+}
+
+static void
+put_string (const char *s)
+{
+  const char *kept = s ? g_string_chunk_insert_const (rec->strings, s) : NULL;
+
+  PUT (kept);
+}
+
+static void
+put_clip_box (const BoxType *clip_box)
+{
+  guint8 has_box = clip_box != NULL;
+
+  PUT (has_box);
+  if (has_box)
+    PUT (*clip_box);
+}
+
+static int
+rec_set_layer (const char *name, int group, int empty)
+{
+  guint end = 0;
+
+  put_op (OP_SET_LAYER, NULL);
+  put_string (name);
+  PUT (group);
+  PUT (empty);
+  open_layer = rec->ops->len;
+  PUT (end);
+  return 1;
+}
+
+static void
+rec_end_layer (void)
+{
+  guint end;
+
+  put_op (OP_END_LAYER, NULL);
+  end = rec->ops->len;
+  memcpy (rec->ops->data + open_layer, &end, sizeof (end));
+}
+
+static hidGC
+rec_make_gc (void)
+{
+  hidGC gc = (hidGC) malloc (sizeof (hid_gc_struct));
+
+  gc->id = rec->n_gcs++;
+  put_op (OP_MAKE_GC, gc);
+  return gc;
+}
+
+static void
+rec_destroy_gc (hidGC gc)
+{
+  put_op (OP_DESTROY_GC, gc);
+  free (gc);
+}
+
+static void
+rec_use_mask (enum mask_mode mode)
+{
+  put_op (OP_USE_MASK, NULL);
+  PUT (mode);
+}
+
+static void
+rec_set_color (hidGC gc, const char *name)
+{
+  put_op (OP_SET_COLOR, gc);
+  put_string (name);
+}
+
+static void
+rec_set_line_cap (hidGC gc, EndCapStyle style)
+{
+  put_op (OP_SET_LINE_CAP, gc);
+  PUT (style);
+}
+
+static void
+rec_set_line_width (hidGC gc, Coord width)
+{
+  put_op (OP_SET_LINE_WIDTH, gc);
+  PUT (width);
+}
+
+static void
+rec_set_draw_xor (hidGC gc, int xor_)
+{
+  put_op (OP_SET_DRAW_XOR, gc);
+  PUT (xor_);
+}
+
+static void
+rec_set_draw_faded (hidGC gc, int faded)
+{
+  put_op (OP_SET_DRAW_FADED, gc);
+  PUT (faded);
+}
+
+static void
+rec_draw_line (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
+{
+  put_op (OP_DRAW_LINE, gc);
+  PUT (x1);
+  PUT (y1);
+  PUT (x2);
+  PUT (y2);
+}
+
+static void
+rec_draw_arc (hidGC gc, Coord cx, Coord cy, Coord xradius, Coord yradius,
+	      Angle start_angle, Angle delta_angle)
+{
+  put_op (OP_DRAW_ARC, gc);
+  PUT (cx);
+  PUT (cy);
+  PUT (xradius);
+  PUT (yradius);
+  PUT (start_angle);
+  PUT (delta_angle);
+}
+
+static void
+rec_draw_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
+{
+  put_op (OP_DRAW_RECT, gc);
+  PUT (x1);
+  PUT (y1);
+  PUT (x2);
+  PUT (y2);
+}
+
+static void
+rec_fill_circle (hidGC gc, Coord cx, Coord cy, Coord radius)
+{
+  put_op (OP_FILL_CIRCLE, gc);
+  PUT (cx);
+  PUT (cy);
+  PUT (radius);
+}
+
+static void
+rec_fill_polygon (hidGC gc, int n_coords, Coord *x, Coord *y)
+{
+  put_op (OP_FILL_POLYGON, gc);
+  PUT (n_coords);
+  put (x, n_coords * sizeof (Coord));
+  put (y, n_coords * sizeof (Coord));
+}
+
+static void
+rec_fill_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
+{
+  put_op (OP_FILL_RECT, gc);
+  PUT (x1);
+  PUT (y1);
+  PUT (x2);
+  PUT (y2);
+}
+
+static void
+rec_draw_grid (BoxType *box)
+{
+  put_op (OP_DRAW_GRID, NULL);
+  PUT (*box);
+}
+
+static void
+rec_draw_pcb_line (hidGC gc, LineType *line)
+{
+  put_op (OP_DRAW_PCB_LINE, gc);
+  PUT (line);
+}
+
+static void
+rec_draw_pcb_arc (hidGC gc, ArcType *arc)
+{
+  put_op (OP_DRAW_PCB_ARC, gc);
+  PUT (arc);
+}
+
+static void
+rec_draw_pcb_text (hidGC gc, TextType *text, Coord min_line_width)
+{
+  TextType *copy = g_new (TextType, 1);
+
+  *copy = *text;
+  if (text->TextString)
+    copy->TextString = g_string_chunk_insert (rec->strings, text->TextString);
+  g_ptr_array_add (rec->texts, copy);
+
+  put_op (OP_DRAW_PCB_TEXT, gc);
+  PUT (copy);
+  PUT (min_line_width);
+}
+
+static void
+rec_draw_pcb_polygon (hidGC gc, PolygonType *poly, const BoxType *clip_box)
+{
+  put_op (OP_DRAW_PCB_POLYGON, gc);
+  PUT (poly);
+  put_clip_box (clip_box);
+}
+
+static void
+rec_fill_pcb_polygon (hidGC gc, PolygonType *poly, const BoxType *clip_box)
+{
+  put_op (OP_FILL_PCB_POLYGON, gc);
+  PUT (poly);
+  put_clip_box (clip_box);
+}
+
+static void
+rec_thindraw_pcb_polygon (hidGC gc, PolygonType *poly,
+			  const BoxType *clip_box)
+{
+  put_op (OP_THINDRAW_PCB_POLYGON, gc);
+  PUT (poly);
+  put_clip_box (clip_box);
+}
+
+static void
+put_pad (int op, hidGC gc, PadType *pad, bool clip, bool mask)
+{
+  guint8 flags = (clip ? 1 : 0) | (mask ? 2 : 0);
+
+  put_op (op, gc);
+  PUT (pad);
+  PUT (flags);
+}
+
+static void
+rec_fill_pcb_pad (hidGC gc, PadType *pad, bool clip, bool mask)
+{
+  put_pad (OP_FILL_PCB_PAD, gc, pad, clip, mask);
+}
+
+static void
+rec_thindraw_pcb_pad (hidGC gc, PadType *pad, bool clip, bool mask)
+{
+  put_pad (OP_THINDRAW_PCB_PAD, gc, pad, clip, mask);
+}
+
+static void
+put_pv (int op, hidGC fg_gc, hidGC bg_gc, PinType *pv, bool drawHole,
+	bool mask)
+{
+  guint8 flags = (drawHole ? 1 : 0) | (mask ? 2 : 0);
+
+  put_op (op, fg_gc);
+  PUT (bg_gc->id);
+  PUT (pv);
+  PUT (flags);
+}
+
+static void
+rec_fill_pcb_pv (hidGC fg_gc, hidGC bg_gc, PinType *pv, bool drawHole,
+		 bool mask)
+{
+  put_pv (OP_FILL_PCB_PV, fg_gc, bg_gc, pv, drawHole, mask);
+}
+
+static void
+rec_thindraw_pcb_pv (hidGC fg_gc, hidGC bg_gc, PinType *pv, bool drawHole,
+		     bool mask)
+{
+  put_pv (OP_THINDRAW_PCB_PV, fg_gc, bg_gc, pv, drawHole, mask);
+}
+
+static HID rec_hid;
+static HID_DRAW rec_graphics;
+
+static void
+drawlist_init (void)
+{
+  static bool initialised = false;
+
+  if (initialised)
+    return;
+
+  memset (&rec_hid, 0, sizeof (HID));
+  memset (&rec_graphics, 0, sizeof (HID_DRAW));
+
+  rec_hid.struct_size                = sizeof (HID);
+  rec_hid.description                = "used to record a draw list";
+  rec_hid.set_layer                  = rec_set_layer;
+  rec_hid.end_layer                  = rec_end_layer;
+  rec_hid.graphics                   = &rec_graphics;
+
+  rec_graphics.make_gc               = rec_make_gc;
+  rec_graphics.destroy_gc            = rec_destroy_gc;
+  rec_graphics.use_mask              = rec_use_mask;
+  rec_graphics.set_color             = rec_set_color;
+  rec_graphics.set_line_cap          = rec_set_line_cap;
+  rec_graphics.set_line_width        = rec_set_line_width;
+  rec_graphics.set_draw_xor          = rec_set_draw_xor;
+  rec_graphics.set_draw_faded        = rec_set_draw_faded;
+  rec_graphics.draw_line             = rec_draw_line;
+  rec_graphics.draw_arc              = rec_draw_arc;
+  rec_graphics.draw_rect             = rec_draw_rect;
+  rec_graphics.fill_circle           = rec_fill_circle;
+  rec_graphics.fill_polygon          = rec_fill_polygon;
+  rec_graphics.fill_rect             = rec_fill_rect;
+  rec_graphics.draw_grid             = rec_draw_grid;
+  rec_graphics.draw_pcb_line         = rec_draw_pcb_line;
+  rec_graphics.draw_pcb_arc          = rec_draw_pcb_arc;
+  rec_graphics.draw_pcb_text         = rec_draw_pcb_text;
+  rec_graphics.draw_pcb_polygon      = rec_draw_pcb_polygon;
+  rec_graphics.fill_pcb_polygon      = rec_fill_pcb_polygon;
+  rec_graphics.thindraw_pcb_polygon  = rec_thindraw_pcb_polygon;
+  rec_graphics.fill_pcb_pad          = rec_fill_pcb_pad;
+  rec_graphics.thindraw_pcb_pad      = rec_thindraw_pcb_pad;
+  rec_graphics.fill_pcb_pv           = rec_fill_pcb_pv;
+  rec_graphics.thindraw_pcb_pv       = rec_thindraw_pcb_pv;
+
+  initialised = true;
+}
+
+/*!
+ * \brief Record the drawing of a region of the board.
+ *
+ * The list is drawn as it would be to \p like, which only needs to say
+ * whether it is a GUI and how it draws the polygons and masks.
+ */
+DrawList *
+drawlist_record (HID *like, BoxType *region)
+{
+  DrawList *list = g_new0 (DrawList, 1);
+
+  drawlist_init ();
+  rec_hid.name        = like->name;
+  rec_hid.gui         = like->gui;
+  rec_hid.poly_before = like->poly_before;
+  rec_hid.poly_after  = like->poly_after;
+
+  list->ops = g_byte_array_new ();
+  list->strings = g_string_chunk_new (256);
+  list->texts = g_ptr_array_new_with_free_func (g_free);
+
+  rec = list;
+  hid_expose_callback (&rec_hid, region, NULL);
+  rec = NULL;
+
+  return list;
+}
+
+/*!
+ * \brief Draw a list to a HID.
+ */
+void
+drawlist_replay (DrawList *list, HID *hid)
+{
+  HID *old_gui = gui;
+  HID_DRAW *g = hid->graphics;
+  hidGC *gcs = g_new0 (hidGC, list->n_gcs + 1);
+  const guint8 *p = list->ops->data;
+  const guint8 *end = p + list->ops->len;
+  Coord *xs = NULL, *ys = NULL;
+  int n_xy = 0;
+  int id, id2, i;
+  const char *s;
+  guint8 flags;
+  BoxType box;
+  Coord c[4];
+  Angle a[2];
+  void *ptr;
+
+  PROFILE_BEGIN (PROFILE_DRAW);
+  gui = hid;
+
+  while (p < end)
+    switch (*p++)
+      {
+      case OP_MAKE_GC:
+	GET (id);
+	gcs[id] = g->make_gc ();
+	break;
+      case OP_DESTROY_GC:
+	GET (id);
+	if (gcs[id])
+	  g->destroy_gc (gcs[id]);
+	gcs[id] = NULL;
+	break;
+      case OP_USE_MASK:
+	{
+	  enum mask_mode mode;
+
+	  GET (mode);
+	  g->use_mask (mode);
+	}
+	break;
+      case OP_SET_COLOR:
+	GET (id);
+	GET (s);
+	g->set_color (gcs[id], s);
+	break;
+      case OP_SET_LINE_CAP:
+	{
+	  EndCapStyle style;
+
+	  GET (id);
+	  GET (style);
+	  g->set_line_cap (gcs[id], style);
+	}
+	break;
+      case OP_SET_LINE_WIDTH:
+	GET (id);
+	GET (c[0]);
+	g->set_line_width (gcs[id], c[0]);
+	break;
+      case OP_SET_DRAW_XOR:
+	GET (id);
+	GET (i);
+	g->set_draw_xor (gcs[id], i);
+	break;
+      case OP_SET_DRAW_FADED:
+	GET (id);
+	GET (i);
+	g->set_draw_faded (gcs[id], i);
+	break;
+      case OP_DRAW_LINE:
+	GET (id);
+	GET (c);
+	g->draw_line (gcs[id], c[0], c[1], c[2], c[3]);
+	break;
+      case OP_DRAW_ARC:
+	GET (id);
+	GET (c);
+	GET (a);
+	g->draw_arc (gcs[id], c[0], c[1], c[2], c[3], a[0], a[1]);
+	break;
+      case OP_DRAW_RECT:
+	GET (id);
+	GET (c);
+	g->draw_rect (gcs[id], c[0], c[1], c[2], c[3]);
+	break;
+      case OP_FILL_CIRCLE:
+	GET (id);
+	memcpy (c, p, 3 * sizeof (Coord));
+	p += 3 * sizeof (Coord);
+	g->fill_circle (gcs[id], c[0], c[1], c[2]);
+	break;
+      case OP_FILL_POLYGON:
+	GET (id);
+	GET (i);
+	if (i > n_xy)
+	  {
+	    n_xy = i;
+	    xs = (Coord *) realloc (xs, n_xy * sizeof (Coord));
+	    ys = (Coord *) realloc (ys, n_xy * sizeof (Coord));
+	  }
+	/* the coordinates are not aligned in the list */
+	memcpy (xs, p, i * sizeof (Coord));
+	p += i * sizeof (Coord);
+	memcpy (ys, p, i * sizeof (Coord));
+	p += i * sizeof (Coord);
+	g->fill_polygon (gcs[id], i, xs, ys);
+	break;
+      case OP_FILL_RECT:
+	GET (id);
+	GET (c);
+	g->fill_rect (gcs[id], c[0], c[1], c[2], c[3]);
+	break;
+      case OP_DRAW_GRID:
+	GET (box);
+	g->draw_grid (&box);
+	break;
+      case OP_DRAW_PCB_LINE:
+	GET (id);
+	GET (ptr);
+	g->draw_pcb_line (gcs[id], (LineType *) ptr);
+	break;
+      case OP_DRAW_PCB_ARC:
+	GET (id);
+	GET (ptr);
+	g->draw_pcb_arc (gcs[id], (ArcType *) ptr);
+	break;
+      case OP_DRAW_PCB_TEXT:
+	GET (id);
+	GET (ptr);
+	GET (c[0]);
+	g->draw_pcb_text (gcs[id], (TextType *) ptr, c[0]);
+	break;
+      case OP_DRAW_PCB_POLYGON:
+      case OP_FILL_PCB_POLYGON:
+      case OP_THINDRAW_PCB_POLYGON:
+	{
+	  int op = p[-1];
+
+	  GET (id);
+	  GET (ptr);
+	  GET (flags);
+	  if (flags)
+	    GET (box);
+	  (op == OP_DRAW_PCB_POLYGON ? g->draw_pcb_polygon
+	   : op == OP_FILL_PCB_POLYGON ? g->fill_pcb_polygon
+	   : g->thindraw_pcb_polygon) (gcs[id], (PolygonType *) ptr,
+				       flags ? &box : NULL);
+	}
+	break;
+      case OP_FILL_PCB_PAD:
+      case OP_THINDRAW_PCB_PAD:
+	{
+	  int op = p[-1];
+
+	  GET (id);
+	  GET (ptr);
+	  GET (flags);
+	  (op == OP_FILL_PCB_PAD ? g->fill_pcb_pad : g->thindraw_pcb_pad)
+	    (gcs[id], (PadType *) ptr, flags & 1, (flags & 2) != 0);
+	}
+	break;
+      case OP_FILL_PCB_PV:
+      case OP_THINDRAW_PCB_PV:
+	{
+	  int op = p[-1];
+
+	  GET (id);
+	  GET (id2);
+	  GET (ptr);
+	  GET (flags);
+	  (op == OP_FILL_PCB_PV ? g->fill_pcb_pv : g->thindraw_pcb_pv)
+	    (gcs[id], gcs[id2], (PinType *) ptr, flags & 1, (flags & 2) != 0);
+	}
+	break;
+      case OP_SET_LAYER:
+	{
+	  int group, empty;
+	  guint layer_end;
+
+	  GET (s);
+	  GET (group);
+	  GET (empty);
+	  GET (layer_end);
+	  /* a layer turned down was not drawn at all */
+	  if (!hid->set_layer (s, group, empty))
+	    p = list->ops->data + layer_end;
+	}
+	break;
+      case OP_END_LAYER:
+	hid->end_layer ();
+	break;
+      }
+
+  for (i = 0; i < list->n_gcs; i++)
+    if (gcs[i])
+      g->destroy_gc (gcs[i]);
+  g_free (gcs);
+  free (xs);
+  free (ys);
+  gui = old_gui;
+  PROFILE_END (PROFILE_DRAW);
+}
+
+/*!
+ * \brief The memory the ops of a list take, in bytes.
+ */
+size_t
+drawlist_size (DrawList *list)
+{
+  return list->ops->len;
+}
+
+void
+drawlist_free (DrawList *list)
+{
+  if (list == NULL)
+    return;
+  g_byte_array_free (list->ops, TRUE);
+  g_string_chunk_free (list->strings);
+  g_ptr_array_free (list->texts, TRUE);
+  g_free (list);
+}
@@ -0,0 +1,37 @@
+/*!
+ * \file src/hid/common/drawlist.h
+ *
+ * \brief Recording of the drawing of a board, to replay it to HIDs.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef PCB_HID_COMMON_DRAWLIST_H
+#define PCB_HID_COMMON_DRAWLIST_H
+
+typedef struct draw_list DrawList;
+
+DrawList *drawlist_record (HID *like, BoxType *region);
+void drawlist_replay (DrawList *list, HID *hid);
+size_t drawlist_size (DrawList *list);
+void drawlist_free (DrawList *list);
+
+#endif
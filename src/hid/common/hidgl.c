@@ -81,41 +81,472 @@
 
 triangle_buffer buffer;
 float global_depth = 0;
+hidgl_stats_type hidgl_stats;
+
+static bool
+hidgl_has_version (int need_major, int need_minor)
+{
+  const char *version = (const char *) glGetString (GL_VERSION);
+  int major, minor;
+
+  return (version != NULL &&
+          sscanf (version, "%d.%d", &major, &minor) == 2 &&
+          (major > need_major || (major == need_major && minor >= need_minor)));
+}
+
+/* Whether the GL of the render has vertex buffer objects.  Without the
+ * headers of version 1.5 all is drawn from client memory. */
+static bool have_vbo = false;
 
 static void
 hidgl_init_triangle_array (triangle_buffer *buffer)
 {
   buffer->triangle_count = 0;
   buffer->coord_comp_count = 0;
+  if (buffer->triangle_array == NULL)
+    {
+      buffer->triangle_size = TRIANGLE_ARRAY_SIZE;
+      buffer->triangle_array =
+        malloc (3 * 3 * sizeof (GLfloat) * buffer->triangle_size);
+    }
+
+  /* The buffer object only lives as long as the render, as the renders
+   * are not all made in the same GL context. */
+  buffer->vbo = 0;
+  buffer->vbo_size = 0;
+#ifdef GL_VERSION_1_5
+  if (have_vbo)
+    glGenBuffers (1, &buffer->vbo);
+#endif
 }
 
+static void
+hidgl_free_vbo (GLuint *vbo, size_t *vbo_size)
+{
+#ifdef GL_VERSION_1_5
+  if (*vbo != 0)
+    glDeleteBuffers (1, vbo);
+#endif
+  *vbo = 0;
+  *vbo_size = 0;
+}
+
+/*!
+ * \brief Get the first used bytes of data to the GL for drawing.
+ *
+ * With a buffer object, that is given a new data store of size bytes
+ * rather than waiting on the draws still reading the old one.
+ *
+ * \return the address to give the GL for data.
+ */
+static const GLfloat *
+hidgl_upload (GLuint vbo, size_t *vbo_size, size_t size, size_t used,
+              const GLfloat *data)
+{
+  if (vbo == 0)
+    return data;
+#ifdef GL_VERSION_1_5
+  glBindBuffer (GL_ARRAY_BUFFER, vbo);
+  if (used > *vbo_size)
+    *vbo_size = size;
+  glBufferData (GL_ARRAY_BUFFER, *vbo_size, NULL, GL_STREAM_DRAW);
+  glBufferSubData (GL_ARRAY_BUFFER, 0, used, data);
+#endif
+  return NULL;
+}
+
+static void
+hidgl_end_upload (GLuint vbo)
+{
+#ifdef GL_VERSION_1_5
+  if (vbo != 0)
+    glBindBuffer (GL_ARRAY_BUFFER, 0);
+#endif
+}
+
+static void hidgl_flush_shapes (void);
+
 void
 hidgl_flush_triangles (triangle_buffer *buffer)
 {
-  if (buffer->triangle_count == 0)
+  const GLfloat *data;
+
+  if (buffer->triangle_count != 0)
+    {
+      data = hidgl_upload (buffer->vbo, &buffer->vbo_size,
+                           3 * 3 * sizeof (GLfloat) * buffer->triangle_size,
+                           3 * 3 * sizeof (GLfloat) * buffer->triangle_count,
+                           buffer->triangle_array);
+      glEnableClientState (GL_VERTEX_ARRAY);
+      glVertexPointer (3, GL_FLOAT, 0, data);
+      glDrawArrays (GL_TRIANGLES, 0, buffer->triangle_count * 3);
+      glDisableClientState (GL_VERTEX_ARRAY);
+      hidgl_end_upload (buffer->vbo);
+
+      hidgl_stats.flushes++;
+      hidgl_stats.triangles += buffer->triangle_count;
+      buffer->triangle_count = 0;
+      buffer->coord_comp_count = 0;
+    }
+  hidgl_flush_shapes ();
+}
+
+/*!
+ * \brief Make room for count more triangles, growing the buffer or, once
+ * it is as large as it gets, drawing what it holds.
+ */
+void
+hidgl_grow_triangle_space (triangle_buffer *buffer, int count)
+{
+  unsigned int size = buffer->triangle_size;
+
+  while (size < buffer->triangle_count + count && size < TRIANGLE_ARRAY_MAX)
+    size *= 2;
+  if (size < buffer->triangle_count + count)
+    {
+      hidgl_flush_triangles (buffer);
+      while (size < count)
+        size *= 2;
+    }
+  if (size == buffer->triangle_size)
     return;
 
+  buffer->triangle_array =
+    realloc (buffer->triangle_array, 3 * 3 * sizeof (GLfloat) * size);
+  if (buffer->triangle_array == NULL)
+    {
+      fprintf (stderr, "Not enough memory for %u triangles\n", size);
+      exit (1);
+    }
+  buffer->triangle_size = size;
+}
+
+/* ---------------------------------------------------------------------------
+ * Round shapes.  With GL 2.0, a round-capped line, an arc or a circle is
+ * drawn as one quad around it, and a fragment shader keeps the pixels
+ * within reach of its centre line.  Each vertex of a quad carries the
+ * shape:
+ *
+ *   line:  shape_a = x1, y1, x2, y2       shape_b = half width, 0, -, -
+ *   arc:   shape_a = x, y, radius, -      shape_b = half width, 1,
+ *                                                   start angle, sweep
+ *
+ * Arc angles are in radians and go from the negative x axis towards
+ * the positive y axis, as those of hidgl_draw_arc().
+ */
+#define SHAPE_FLOATS 11                 /* x, y, z, shape_a, shape_b */
+#define SHAPE_ARRAY_SIZE 1024
+#define SHAPE_ARRAY_MAX (64 * SHAPE_ARRAY_SIZE)
+#define SHAPE_ATTRIB_A 6
+#define SHAPE_ATTRIB_B 7
+#define SHAPE_LINE 0.
+#define SHAPE_ARC 1.
+
+static struct
+{
+  GLfloat *array;
+  unsigned int count;                   /* shapes in array */
+  unsigned int size;                    /* room in array, in shapes */
+  GLuint vbo;
+  size_t vbo_size;
+} shapes;
+
+/* Whether this render draws round shapes with the shader */
+static bool use_shapes = false;
+static GLuint shape_program = 0;
+/* the shader did not build, so don't try again */
+static bool shapes_broken = false;
+
+static const char *shape_vertex_source =
+  "attribute vec4 shape_a;\n"
+  "attribute vec4 shape_b;\n"
+  "varying vec2 pos;\n"
+  "varying vec4 a;\n"
+  "varying vec4 b;\n"
+  "void main (void)\n"
+  "{\n"
+  "  pos = gl_Vertex.xy;\n"
+  "  a = shape_a;\n"
+  "  b = shape_b;\n"
+  "  gl_FrontColor = gl_Color;\n"
+  "  gl_ClipVertex = gl_ModelViewMatrix * gl_Vertex;\n"
+  "  gl_Position = ftransform ();\n"
+  "}\n";
+
+static const char *shape_fragment_source =
+  "varying vec2 pos;\n"
+  "varying vec4 a;\n"
+  "varying vec4 b;\n"
+  "void main (void)\n"
+  "{\n"
+  "  float d;\n"
+  "  if (b.y < 0.5)\n"
+  "    {\n"
+  "      vec2 pa = pos - a.xy, ba = a.zw - a.xy;\n"
+  "      float h = clamp (dot (pa, ba) / max (dot (ba, ba), 1.0), 0.0, 1.0);\n"
+  "      d = length (pa - ba * h);\n"
+  "    }\n"
+  "  else\n"
+  "    {\n"
+  "      vec2 p = pos - a.xy;\n"
+  "      float t = mod (atan (p.y, -p.x) - b.z, 6.2831853);\n"
+  "      if (t <= b.w)\n"
+  "        d = abs (length (p) - a.z);\n"
+  "      else\n"
+  "        d = min (distance (p, a.z * vec2 (-cos (b.z), sin (b.z))),\n"
+  "                 distance (p, a.z * vec2 (-cos (b.z + b.w),\n"
+  "                                          sin (b.z + b.w))));\n"
+  "    }\n"
+  "  if (d > b.x)\n"
+  "    discard;\n"
+  "  gl_FragColor = gl_Color;\n"
+  "}\n";
+
+#ifdef GL_VERSION_2_0
+static GLuint
+hidgl_compile_shader (GLenum type, const char *source)
+{
+  GLuint shader = glCreateShader (type);
+  GLint ok;
+  char log[1024];
+
+  glShaderSource (shader, 1, &source, NULL);
+  glCompileShader (shader);
+  glGetShaderiv (shader, GL_COMPILE_STATUS, &ok);
+  if (!ok)
+    {
+      glGetShaderInfoLog (shader, sizeof (log), NULL, log);
+      fprintf (stderr, "Cannot compile the shader of round shapes:\n%s\n",
+               log);
+      glDeleteShader (shader);
+      return 0;
+    }
+  return shader;
+}
+
+/*!
+ * \brief Build the shader program of round shapes in the current context.
+ *
+ * \return the program, or 0 if it does not build.
+ */
+static GLuint
+hidgl_build_shape_program (void)
+{
+  GLuint vertex, fragment, program;
+  GLint ok;
+  char log[1024];
+
+  vertex = hidgl_compile_shader (GL_VERTEX_SHADER, shape_vertex_source);
+  fragment = hidgl_compile_shader (GL_FRAGMENT_SHADER, shape_fragment_source);
+  if (vertex == 0 || fragment == 0)
+    {
+      glDeleteShader (vertex);
+      glDeleteShader (fragment);
+      return 0;
+    }
+
+  program = glCreateProgram ();
+  glAttachShader (program, vertex);
+  glAttachShader (program, fragment);
+  glBindAttribLocation (program, SHAPE_ATTRIB_A, "shape_a");
+  glBindAttribLocation (program, SHAPE_ATTRIB_B, "shape_b");
+  glLinkProgram (program);
+  glDeleteShader (vertex);
+  glDeleteShader (fragment);
+  glGetProgramiv (program, GL_LINK_STATUS, &ok);
+  if (!ok)
+    {
+      glGetProgramInfoLog (program, sizeof (log), NULL, log);
+      fprintf (stderr, "Cannot link the shader of round shapes:\n%s\n", log);
+      glDeleteProgram (program);
+      return 0;
+    }
+  return program;
+}
+#endif
+
+/*!
+ * \brief Decide whether the render draws round shapes with the shader,
+ * building it if the current context does not have it yet.
+ *
+ * Each context builds the program the same way from the same start,
+ * so it gets the same name in all of them, and the test for it only
+ * builds it once in each.
+ */
+static void
+hidgl_init_shapes (void)
+{
+  shapes.count = 0;
+  use_shapes = false;
+#ifdef GL_VERSION_2_0
+  if (shapes_broken || !hidgl_has_version (2, 0))
+    return;
+  if (shape_program == 0 || !glIsProgram (shape_program))
+    {
+      shape_program = hidgl_build_shape_program ();
+      shapes_broken = (shape_program == 0);
+      if (shapes_broken)
+        return;
+    }
+  if (shapes.array == NULL)
+    {
+      shapes.size = SHAPE_ARRAY_SIZE;
+      shapes.array = malloc (6 * SHAPE_FLOATS * sizeof (GLfloat) * shapes.size);
+    }
+  shapes.vbo = 0;
+  shapes.vbo_size = 0;
+  if (have_vbo)
+    glGenBuffers (1, &shapes.vbo);
+  use_shapes = true;
+#endif
+}
+
+static void
+hidgl_flush_shapes (void)
+{
+#ifdef GL_VERSION_2_0
+  const GLfloat *data;
+  GLsizei stride = SHAPE_FLOATS * sizeof (GLfloat);
+
+  if (shapes.count == 0)
+    return;
+
+  data = hidgl_upload (shapes.vbo, &shapes.vbo_size,
+                       6 * stride * shapes.size, 6 * stride * shapes.count,
+                       shapes.array);
+  glUseProgram (shape_program);
   glEnableClientState (GL_VERTEX_ARRAY);
-  glVertexPointer (3, GL_FLOAT, 0, buffer->triangle_array);
-  glDrawArrays (GL_TRIANGLES, 0, buffer->triangle_count * 3);
+  glEnableVertexAttribArray (SHAPE_ATTRIB_A);
+  glEnableVertexAttribArray (SHAPE_ATTRIB_B);
+  glVertexPointer (3, GL_FLOAT, stride, data);
+  glVertexAttribPointer (SHAPE_ATTRIB_A, 4, GL_FLOAT, GL_FALSE, stride,
+                         data + 3);
+  glVertexAttribPointer (SHAPE_ATTRIB_B, 4, GL_FLOAT, GL_FALSE, stride,
+                         data + 7);
+  glDrawArrays (GL_TRIANGLES, 0, shapes.count * 6);
+  glDisableVertexAttribArray (SHAPE_ATTRIB_A);
+  glDisableVertexAttribArray (SHAPE_ATTRIB_B);
   glDisableClientState (GL_VERTEX_ARRAY);
+  glUseProgram (0);
+  hidgl_end_upload (shapes.vbo);
 
-  buffer->triangle_count = 0;
-  buffer->coord_comp_count = 0;
+  hidgl_stats.shapes += shapes.count;
+  shapes.count = 0;
+#endif
 }
 
-void
-hidgl_ensure_triangle_space (triangle_buffer *buffer, int count)
+/*!
+ * \brief Add a shape drawn on the quad with the given corners, in order
+ * around it.
+ */
+static void
+hidgl_add_shape (const GLfloat quad[8], const GLfloat shape[8])
 {
-  if (count > TRIANGLE_ARRAY_SIZE)
+  static const int corner[6] = {0, 1, 2, 0, 2, 3};
+  GLfloat *v;
+  int i;
+
+  if (shapes.count == shapes.size)
     {
-      fprintf (stderr, "Not enough space in vertex buffer\n");
-      fprintf (stderr, "Requested %i triangles, %i available\n",
-                       count, TRIANGLE_ARRAY_SIZE);
-      exit (1);
+      if (shapes.size < SHAPE_ARRAY_MAX)
+        {
+          shapes.size *= 2;
+          shapes.array = realloc (shapes.array, 6 * SHAPE_FLOATS *
+                                  sizeof (GLfloat) * shapes.size);
+          if (shapes.array == NULL)
+            {
+              fprintf (stderr, "Not enough memory for %u shapes\n",
+                       shapes.size);
+              exit (1);
+            }
+        }
+      else
+        hidgl_flush_triangles (&buffer);
+    }
+
+  v = shapes.array + 6 * SHAPE_FLOATS * shapes.count;
+  for (i = 0; i < 6; i++, v += SHAPE_FLOATS)
+    {
+      v[0] = quad[2 * corner[i]];
+      v[1] = quad[2 * corner[i] + 1];
+      v[2] = global_depth;
+      memcpy (v + 3, shape, 8 * sizeof (GLfloat));
+    }
+  shapes.count++;
+}
+
+/*!
+ * \brief Add a line with round caps, or a circle if the ends are the
+ * same.
+ */
+static void
+hidgl_add_round_line (Coord x1, Coord y1, Coord x2, Coord y2, double r)
+{
+  double length = hypot (x2 - x1, y2 - y1);
+  double ux = r, uy = 0.;
+  GLfloat quad[8];
+  GLfloat shape[8] = {x1, y1, x2, y2, r, SHAPE_LINE, 0., 0.};
+
+  if (length > 0)
+    {
+      ux = (x2 - x1) * r / length;
+      uy = (y2 - y1) * r / length;
     }
-  if (count > TRIANGLE_ARRAY_SIZE - buffer->triangle_count)
-    hidgl_flush_triangles (buffer);
+  quad[0] = x1 - ux - uy;  quad[1] = y1 - uy + ux;
+  quad[2] = x2 + ux - uy;  quad[3] = y2 + uy + ux;
+  quad[4] = x2 + ux + uy;  quad[5] = y2 + uy - ux;
+  quad[6] = x1 - ux + uy;  quad[7] = y1 - uy - ux;
+  hidgl_add_shape (quad, shape);
+}
+
+/*!
+ * \brief Add an arc of the given half width, drawn on the box around the
+ * ends and the points of the sweep furthest along the axes.
+ */
+static void
+hidgl_add_round_arc (Coord x, Coord y, Coord r, double halfwidth,
+                     double start, double sweep)
+{
+  double x1, y1, x2, y2, px, py, a;
+  GLfloat quad[8];
+  GLfloat shape[8];
+  int k;
+
+  start = fmod (start, 2 * M_PI);
+  if (start < 0)
+    start += 2 * M_PI;
+  x1 = x2 = x - r * cos (start);
+  y1 = y2 = y + r * sin (start);
+  px = x - r * cos (start + sweep);
+  py = y + r * sin (start + sweep);
+  x1 = MIN (x1, px);  x2 = MAX (x2, px);
+  y1 = MIN (y1, py);  y2 = MAX (y2, py);
+  for (k = 1; k <= 8; k++)
+    {
+      a = k * M_PI / 2;
+      if (a <= start || a >= start + sweep)
+        continue;
+      px = x - r * cos (a);
+      py = y + r * sin (a);
+      x1 = MIN (x1, px);  x2 = MAX (x2, px);
+      y1 = MIN (y1, py);  y2 = MAX (y2, py);
+    }
+  x1 -= halfwidth;  y1 -= halfwidth;
+  x2 += halfwidth;  y2 += halfwidth;
+
+  quad[0] = x1;  quad[1] = y1;
+  quad[2] = x2;  quad[3] = y1;
+  quad[4] = x2;  quad[5] = y2;
+  quad[6] = x1;  quad[7] = y2;
+  shape[0] = x;
+  shape[1] = y;
+  shape[2] = r;
+  shape[3] = 0.;
+  shape[4] = halfwidth;
+  shape[5] = SHAPE_ARC;
+  shape[6] = start;
+  shape[7] = MIN (sweep, 2 * M_PI);
+  hidgl_add_shape (quad, shape);
 }
 
 void
@@ -280,6 +711,12 @@ hidgl_draw_line (int cap, Coord width, Coord x1, Coord y1, Coord x2, Coord y2, d
     wdx = -deltay * width / 2. / length;
   }
 
+  if (use_shapes && !hairline && (cap == Trace_Cap || cap == Round_Cap))
+    {
+      hidgl_add_round_line (x1, y1, x2, y2, width / 2.);
+      return;
+    }
+
   angle = -180. / M_PI * atan2 (deltay, deltax);
 
   switch (cap) {
@@ -350,6 +787,13 @@ hidgl_draw_arc (Coord width, Coord x, Coord y, Coord rx, Coord ry,
   start_angle_rad = start_angle * M_PI / 180.;
   delta_angle_rad = delta_angle * M_PI / 180.;
 
+  if (use_shapes && !hairline)
+    {
+      hidgl_add_round_arc (x, y, rx, width / 2., start_angle_rad,
+                           delta_angle_rad);
+      return;
+    }
+
   slices = calc_slices ((rx + width / 2.) / scale, delta_angle_rad);
 
   if (slices < MIN_SLICES_PER_ARC)
@@ -415,6 +859,12 @@ hidgl_fill_circle (Coord vx, Coord vy, Coord vr, double scale)
   int slices;
   int i;
 
+  if (use_shapes)
+    {
+      hidgl_add_round_line (vx, vy, vx, vy, vr);
+      return;
+    }
+
   slices = calc_slices (vr / scale, 2 * M_PI);
 
   if (slices < MIN_TRIANGLES_PER_CIRCLE)
@@ -445,6 +895,23 @@ static int combined_num_to_free = 0;
 static GLenum tessVertexType;
 static int stashed_vertices;
 static int triangle_comp_idx;
+/* the triangles of a contour being kept, see fill_contour(), or NULL */
+static GArray *tess_record = NULL;
+
+static void
+tess_add_triangle (GLfloat x1, GLfloat y1, GLfloat x2, GLfloat y2,
+                   GLfloat x3, GLfloat y3)
+{
+  GLfloat xy[6] = {x1, y1, x2, y2, x3, y3};
+
+  if (tess_record != NULL)
+    {
+      g_array_append_vals (tess_record, xy, 6);
+      return;
+    }
+  hidgl_ensure_triangle_space (&buffer, 1);
+  hidgl_add_triangle (&buffer, x1, y1, x2, y2, x3, y3);
+}
 
 #ifndef CALLBACK
 #define CALLBACK
@@ -514,11 +981,9 @@ myVertex (GLdouble *vertex_data)
         }
       else
         {
-          hidgl_ensure_triangle_space (&buffer, 1);
-          hidgl_add_triangle (&buffer,
-                              triangle_vertices [0], triangle_vertices [1],
-                              triangle_vertices [2], triangle_vertices [3],
-                              vertex_data [0], vertex_data [1]);
+          tess_add_triangle (triangle_vertices [0], triangle_vertices [1],
+                             triangle_vertices [2], triangle_vertices [3],
+                             vertex_data [0], vertex_data [1]);
 
           if (tessVertexType == GL_TRIANGLE_STRIP)
             {
@@ -538,11 +1003,9 @@ myVertex (GLdouble *vertex_data)
       stashed_vertices ++;
       if (stashed_vertices == 3)
         {
-          hidgl_ensure_triangle_space (&buffer, 1);
-          hidgl_add_triangle (&buffer,
-                              triangle_vertices [0], triangle_vertices [1],
-                              triangle_vertices [2], triangle_vertices [3],
-                              triangle_vertices [4], triangle_vertices [5]);
+          tess_add_triangle (triangle_vertices [0], triangle_vertices [1],
+                             triangle_vertices [2], triangle_vertices [3],
+                             triangle_vertices [4], triangle_vertices [5]);
           triangle_comp_idx = 0;
           stashed_vertices = 0;
         }
@@ -594,6 +1057,26 @@ hidgl_fill_polygon (int n_coords, Coord *x, Coord *y)
   free (vertices);
 }
 
+/*!
+ * \brief Draw a contour as a circle if it is round, and hidgl_fill_circle
+ * would use less slices than it has vertices.
+ *
+ * \return whether the contour was drawn.
+ */
+static bool
+fill_round_contour (PLINE *contour, double scale)
+{
+  double slices;
+
+  if (!contour->is_round)
+    return false;
+  slices = calc_slices (contour->radius / scale, 2 * M_PI);
+  if (slices >= contour->Count)
+    return false;
+  hidgl_fill_circle (contour->cx, contour->cy, contour->radius, scale);
+  return true;
+}
+
 void
 tesselate_contour (GLUtesselator *tobj, PLINE *contour, GLdouble *vertices,
                    double scale)
@@ -601,17 +1084,8 @@ tesselate_contour (GLUtesselator *tobj, PLINE *contour, GLdouble *vertices,
   VNODE *vn = &contour->head;
   int offset = 0;
 
-  /* If the contour is round, and hidgl_fill_circle would use
-   * less slices than we have vertices to draw it, then call
-   * hidgl_fill_circle to draw this contour.
-   */
-  if (contour->is_round) {
-    double slices = calc_slices (contour->radius / scale, 2 * M_PI);
-    if (slices < contour->Count) {
-      hidgl_fill_circle (contour->cx, contour->cy, contour->radius, scale);
-      return;
-    }
-  }
+  if (fill_round_contour (contour, scale))
+    return;
 
   gluTessBeginPolygon (tobj, NULL);
   gluTessBeginContour (tobj);
@@ -626,12 +1100,194 @@ tesselate_contour (GLUtesselator *tobj, PLINE *contour, GLdouble *vertices,
   gluTessEndPolygon (tobj);
 }
 
+/* ---------------------------------------------------------------------------
+ * Tessellations of polygon contours, kept from one redraw to the next
+ * for each polygon until its Clipped area changes.  Polygons and their
+ * contours are only known by address, which a new one may get after an
+ * old one is freed, so a kept contour is also checked against the
+ * contour it was made for.
+ */
+#define TESS_CACHE_MAX (4 * 1024 * 1024)        /* triangles kept in all */
+
+typedef struct
+{
+  /* what the contour was like */
+  Coord xmin, ymin, xmax, ymax;
+  unsigned int Count;
+  double area;
+  /* its triangles, as three x, y pairs each */
+  unsigned int count;
+  GLfloat *xy;
+} contour_tess;
+
+typedef struct
+{
+  POLYAREA *clipped;
+  unsigned int gen;
+  GHashTable *contours;                 /* PLINE * -> contour_tess * */
+} polygon_tess;
+
+/* PolygonType * -> polygon_tess * */
+static GHashTable *tess_cache = NULL;
+static unsigned int tess_cache_triangles = 0;
+
+static void
+free_contour_tess (gpointer data)
+{
+  contour_tess *tess = data;
+
+  g_free (tess->xy);
+  g_free (tess);
+}
+
+static void
+free_polygon_tess (gpointer data)
+{
+  polygon_tess *ptess = data;
+
+  g_hash_table_destroy (ptess->contours);
+  g_free (ptess);
+}
+
+static void
+forget_polygon_tess (polygon_tess *ptess)
+{
+  GHashTableIter iter;
+  contour_tess *tess;
+
+  g_hash_table_iter_init (&iter, ptess->contours);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tess))
+    tess_cache_triangles -= tess->count;
+  g_hash_table_remove_all (ptess->contours);
+}
+
+/*!
+ * \brief Find the kept tessellations of a polygon, forgetting them if its
+ * Clipped area changed since they were made.
+ */
+static polygon_tess *
+lookup_polygon_tess (PolygonType *poly)
+{
+  polygon_tess *ptess;
+
+  if (tess_cache == NULL)
+    tess_cache = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+                                        free_polygon_tess);
+  if (tess_cache_triangles > TESS_CACHE_MAX)
+    {
+      g_hash_table_remove_all (tess_cache);
+      tess_cache_triangles = 0;
+    }
+
+  ptess = g_hash_table_lookup (tess_cache, poly);
+  if (ptess == NULL)
+    {
+      ptess = g_new (polygon_tess, 1);
+      ptess->contours = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                               NULL, free_contour_tess);
+      g_hash_table_insert (tess_cache, poly, ptess);
+    }
+  else if (ptess->clipped == poly->Clipped && ptess->gen == poly->ClippedGen)
+    return ptess;
+  else
+    forget_polygon_tess (ptess);
+  ptess->clipped = poly->Clipped;
+  ptess->gen = poly->ClippedGen;
+  return ptess;
+}
+
+static bool
+contour_tess_matches (contour_tess *tess, PLINE *contour)
+{
+  return (tess->xmin == contour->xmin && tess->ymin == contour->ymin &&
+          tess->xmax == contour->xmax && tess->ymax == contour->ymax &&
+          tess->Count == contour->Count && tess->area == contour->area);
+}
+
 struct do_hole_info {
   GLUtesselator *tobj;
   GLdouble *vertices;
   double scale;
+  POLYAREA *pa;
+  polygon_tess *ptess;
 };
 
+/*!
+ * \brief Get the tessellator of a polygon piece, made the first time a
+ * contour of it is not kept.
+ */
+static GLUtesselator *
+piece_tesselator (struct do_hole_info *info)
+{
+  int vertex_count = 0;
+  PLINE *contour;
+
+  if (info->tobj != NULL)
+    return info->tobj;
+
+  /* Walk the polygon structure, counting vertices */
+  /* This gives an upper bound on the amount of storage required */
+  for (contour = info->pa->contours; contour != NULL; contour = contour->next)
+    vertex_count = MAX (vertex_count, contour->Count);
+
+  info->vertices = malloc (sizeof(GLdouble) * vertex_count * 3);
+  info->tobj = gluNewTess ();
+  gluTessCallback(info->tobj, GLU_TESS_BEGIN,   (_GLUfuncptr)myBegin);
+  gluTessCallback(info->tobj, GLU_TESS_VERTEX,  (_GLUfuncptr)myVertex);
+  gluTessCallback(info->tobj, GLU_TESS_COMBINE, (_GLUfuncptr)myCombine);
+  gluTessCallback(info->tobj, GLU_TESS_ERROR,   (_GLUfuncptr)myError);
+  return info->tobj;
+}
+
+/*!
+ * \brief Draw a contour of a polygon piece from its kept tessellation,
+ * tessellating and keeping it if there is none.
+ */
+static void
+fill_contour (struct do_hole_info *info, PLINE *contour)
+{
+  contour_tess *tess;
+  GLfloat *xy;
+  unsigned int i;
+
+  if (fill_round_contour (contour, info->scale))
+    return;
+
+  tess = g_hash_table_lookup (info->ptess->contours, contour);
+  if (tess != NULL && !contour_tess_matches (tess, contour))
+    {
+      tess_cache_triangles -= tess->count;
+      g_hash_table_remove (info->ptess->contours, contour);
+      tess = NULL;
+    }
+  if (tess != NULL)
+    hidgl_stats.tess_hits++;
+  else
+    {
+      GLUtesselator *tobj = piece_tesselator (info);
+
+      hidgl_stats.tess_misses++;
+      tess_record = g_array_new (FALSE, FALSE, sizeof (GLfloat));
+      tesselate_contour (tobj, contour, info->vertices, info->scale);
+      tess = g_new (contour_tess, 1);
+      tess->xmin = contour->xmin;
+      tess->ymin = contour->ymin;
+      tess->xmax = contour->xmax;
+      tess->ymax = contour->ymax;
+      tess->Count = contour->Count;
+      tess->area = contour->area;
+      tess->count = tess_record->len / 6;
+      tess->xy = (GLfloat *) g_array_free (tess_record, FALSE);
+      tess_record = NULL;
+      g_hash_table_insert (info->ptess->contours, contour, tess);
+      tess_cache_triangles += tess->count;
+    }
+
+  hidgl_ensure_triangle_space (&buffer, tess->count);
+  for (i = 0, xy = tess->xy; i < tess->count; i++, xy += 6)
+    hidgl_add_triangle (&buffer, xy[0], xy[1], xy[2], xy[3], xy[4], xy[5]);
+}
+
 static int
 do_hole (const BoxType *b, void *cl)
 {
@@ -643,7 +1299,7 @@ do_hole (const BoxType *b, void *cl)
     return 0;
   }
 
-  tesselate_contour (info->tobj, curc, info->vertices, info->scale);
+  fill_contour (info, curc);
   return 1;
 }
 
@@ -652,14 +1308,17 @@ static int dirty_bits = 0;
 static int assigned_bits = 0;
 
 static void
-fill_polyarea (POLYAREA *pa, const BoxType *clip_box, double scale)
+fill_polyarea (POLYAREA *pa, polygon_tess *ptess, const BoxType *clip_box,
+               double scale)
 {
-  int vertex_count = 0;
-  PLINE *contour;
   struct do_hole_info info;
   int stencil_bit;
 
+  info.tobj = NULL;
+  info.vertices = NULL;
   info.scale = scale;
+  info.pa = pa;
+  info.ptess = ptess;
   global_scale = scale;
 
   stencil_bit = hidgl_assign_clear_stencil_bit ();
@@ -672,18 +1331,6 @@ fill_polyarea (POLYAREA *pa, const BoxType *clip_box, double scale)
   /* Flush out any existing geoemtry to be rendered */
   hidgl_flush_triangles (&buffer);
 
-  /* Walk the polygon structure, counting vertices */
-  /* This gives an upper bound on the amount of storage required */
-  for (contour = pa->contours; contour != NULL; contour = contour->next)
-    vertex_count = MAX (vertex_count, contour->Count);
-
-  info.vertices = malloc (sizeof(GLdouble) * vertex_count * 3);
-  info.tobj = gluNewTess ();
-  gluTessCallback(info.tobj, GLU_TESS_BEGIN,   (_GLUfuncptr)myBegin);
-  gluTessCallback(info.tobj, GLU_TESS_VERTEX,  (_GLUfuncptr)myVertex);
-  gluTessCallback(info.tobj, GLU_TESS_COMBINE, (_GLUfuncptr)myCombine);
-  gluTessCallback(info.tobj, GLU_TESS_ERROR,   (_GLUfuncptr)myError);
-
   glPushAttrib (GL_STENCIL_BUFFER_BIT);                 /* Save the write mask etc.. for final restore */
   glEnable (GL_STENCIL_TEST);
   glPushAttrib (GL_STENCIL_BUFFER_BIT |                 /* Resave the stencil write-mask etc.., and */
@@ -712,7 +1359,7 @@ fill_polyarea (POLYAREA *pa, const BoxType *clip_box, double scale)
   /* Drawing operations as masked to areas where the stencil buffer is '0' */
 
   /* Draw the polygon outer */
-  tesselate_contour (info.tobj, pa->contours, info.vertices, scale);
+  fill_contour (&info, pa->contours);
 
   hidgl_flush_triangles (&buffer);
 
@@ -721,7 +1368,8 @@ fill_polyarea (POLYAREA *pa, const BoxType *clip_box, double scale)
 
   glPopAttrib ();                               /* Restore the stencil buffer write-mask etc.. */
 
-  gluDeleteTess (info.tobj);
+  if (info.tobj != NULL)
+    gluDeleteTess (info.tobj);
   myFreeCombined ();
   free (info.vertices);
 }
@@ -729,17 +1377,20 @@ fill_polyarea (POLYAREA *pa, const BoxType *clip_box, double scale)
 void
 hidgl_fill_pcb_polygon (PolygonType *poly, const BoxType *clip_box, double scale)
 {
+  polygon_tess *ptess;
+
   if (poly->Clipped == NULL)
     return;
 
-  fill_polyarea (poly->Clipped, clip_box, scale);
+  ptess = lookup_polygon_tess (poly);
+  fill_polyarea (poly->Clipped, ptess, clip_box, scale);
 
   if (TEST_FLAG (FULLPOLYFLAG, poly))
     {
       POLYAREA *pa;
 
       for (pa = poly->Clipped->f; pa != poly->Clipped; pa = pa->f)
-        fill_polyarea (pa, clip_box, scale);
+        fill_polyarea (pa, ptess, clip_box, scale);
     }
 }
 
@@ -774,12 +1425,18 @@ void
 hidgl_start_render (void)
 {
   hidgl_init ();
+#ifdef GL_VERSION_1_5
+  have_vbo = hidgl_has_version (1, 5);
+#endif
   hidgl_init_triangle_array (&buffer);
+  hidgl_init_shapes ();
 }
 
 void
 hidgl_finish_render (void)
 {
+  hidgl_free_vbo (&buffer.vbo, &buffer.vbo_size);
+  hidgl_free_vbo (&shapes.vbo, &shapes.vbo_size);
 }
 
 int
@@ -27,18 +27,43 @@
 #define _GLUfuncptr void *
 #endif
 
+/* The triangle buffer starts with room for TRIANGLE_ARRAY_SIZE triangles
+ * and grows until it holds TRIANGLE_ARRAY_MAX, so that a batch is only
+ * drawn when the GL state changes. */
 #define TRIANGLE_ARRAY_SIZE 5461
+#define TRIANGLE_ARRAY_MAX (64 * TRIANGLE_ARRAY_SIZE)
 typedef struct {
-  GLfloat triangle_array [3 * 3 * TRIANGLE_ARRAY_SIZE];
+  GLfloat *triangle_array;
   unsigned int triangle_count;
   unsigned int coord_comp_count;
+  unsigned int triangle_size;   /* room in triangle_array, in triangles */
+  GLuint vbo;                   /* vertex buffer of the render, or 0 */
+  size_t vbo_size;              /* size of the data store of vbo, in bytes */
 } triangle_buffer;
 
+/* Work done by the GL HID since the counts were last cleared, for the
+ * frame statistics of the GUI. */
+typedef struct {
+  unsigned long triangles;      /* triangles handed to GL */
+  unsigned long flushes;        /* batches drawn by hidgl_flush_triangles */
+  unsigned long shapes;         /* round lines, arcs and circles of the shader */
+  unsigned long tess_hits;      /* contours found in the tessellation cache */
+  unsigned long tess_misses;    /* contours tessellated */
+} hidgl_stats_type;
+
 extern triangle_buffer buffer;
 extern float global_depth;
+extern hidgl_stats_type hidgl_stats;
 
 void hidgl_flush_triangles (triangle_buffer *buffer);
-void hidgl_ensure_triangle_space (triangle_buffer *buffer, int count);
+void hidgl_grow_triangle_space (triangle_buffer *buffer, int count);
+
+static inline void
+hidgl_ensure_triangle_space (triangle_buffer *buffer, int count)
+{
+  if (count > buffer->triangle_size - buffer->triangle_count)
+    hidgl_grow_triangle_space (buffer, count);
+}
 
 static inline void
 hidgl_add_triangle_3D (triangle_buffer *buffer,
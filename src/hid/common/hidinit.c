@@ -80,9 +80,19 @@ int hid_num_hids = 0;
 
 HID *gui = NULL;
 HID *exporter = NULL;
+int export_failures = 0;
 
 int pixel_slop = 1;
 
+/* hid_load_plugins() has run, hid_load_settings() has run, and
+ * hid_parse_command_line() has set the attributes to their defaults */
+static bool plugins_loaded = false;
+static bool settings_loaded = false;
+static bool defaults_set = false;
+
+static void load_settings (HID_AttrNode *stop);
+static void set_defaults (HID_AttrNode *stop);
+
 /*!
  * \brief Search a directory for plugins and load them if found
  *
@@ -163,11 +173,13 @@ hid_load_dir (char *dirname)
 }
 
 /*!
- * \brief Initialize the available hids and load plugins
+ * \brief Initialize the available hids
  *
  * The file hid/common/hidlist.h contains a list of HID_DEF statements, compiled
  * by the build system. The HID_DEF macro is redefined here to call the init
  * function for each of those hids.
+ *
+ * The plugins are left to hid_load_plugins().
  */
 void
 hid_init ()
@@ -179,6 +191,25 @@ hid_init ()
 #define HID_DEF(x) hid_ ## x ## _init();
 #include "hid/common/hidlist.h"
 #undef HID_DEF
+}
+
+/*!
+ * \brief Load the plugins, once.
+ *
+ * The GUI loads them right away.  Export runs, which are over in a
+ * moment, only load them when they ask for an exporter, action or option
+ * that is not built in, as the directory scans and dlopen() calls could
+ * take longer than the export.  The settings and defaults already given
+ * to the built in attributes are then given to those of the plugins.
+ */
+void
+hid_load_plugins (void)
+{
+  HID_AttrNode *old = hid_attr_nodes;
+
+  if (plugins_loaded)
+    return;
+  plugins_loaded = true;
 
   /* Search the exec_prefix for plugins and load them */
   hid_load_dir (Concat (exec_prefix, PCB_DIR_SEPARATOR_S, "lib",
@@ -201,6 +232,11 @@ hid_init ()
     }
   hid_load_dir (Concat ("plugins", PCB_DIR_SEPARATOR_S, HOST, NULL));
   hid_load_dir (Concat ("plugins", NULL));
+
+  if (settings_loaded)
+    load_settings (old);
+  if (defaults_set)
+    set_defaults (old);
 }
 
 void
@@ -245,6 +281,7 @@ hid_find_gui ()
 {
   int i;
 
+  hid_load_plugins ();
   for (i = 0; i < hid_num_hids; i++)
     if (!hid_list[i]->printer && !hid_list[i]->exporter)
       return hid_list[i];
@@ -262,6 +299,11 @@ hid_find_printer ()
     if (hid_list[i]->printer)
       return hid_list[i];
 
+  if (!plugins_loaded)
+    {
+      hid_load_plugins ();
+      return hid_find_printer ();
+    }
   return 0;
 }
 
@@ -274,6 +316,12 @@ hid_find_exporter (const char *which)
     if (hid_list[i]->exporter && strcmp (which, hid_list[i]->name) == 0)
       return hid_list[i];
 
+  if (!plugins_loaded)
+    {
+      hid_load_plugins ();
+      return hid_find_exporter (which);
+    }
+
   fprintf (stderr, "Invalid exporter %s, available ones:", which);
   for (i = 0; i < hid_num_hids; i++)
     if (hid_list[i]->exporter)
@@ -286,6 +334,7 @@ hid_find_exporter (const char *which)
 HID **
 hid_enumerate ()
 {
+  hid_load_plugins ();
   return hid_list;
 }
 
@@ -304,16 +353,18 @@ hid_register_attributes (HID_Attribute * a, int n)
   ha->n = n;
 }
 
-void
-hid_parse_command_line (int *argc, char ***argv)
+/*!
+ * \brief Set the values of the attributes registered after \p stop, or
+ * of all of them, to their defaults.
+ */
+static void
+set_defaults (HID_AttrNode *stop)
 {
   HID_AttrNode *ha;
-  int i, e, ok;
-
-  (*argc)--;
-  (*argv)++;
+  int i;
 
-  for (ha = hid_attr_nodes; ha; ha = ha->next)
+  defaults_set = true;
+  for (ha = hid_attr_nodes; ha != stop; ha = ha->next)
     for (i = 0; i < ha->n; i++)
       {
 	HID_Attribute *a = ha->attributes + i;
@@ -358,6 +409,18 @@ hid_parse_command_line (int *argc, char ***argv)
 	    abort ();
 	  }
       }
+}
+
+void
+hid_parse_command_line (int *argc, char ***argv)
+{
+  HID_AttrNode *ha;
+  int i, e, ok;
+
+  (*argc)--;
+  (*argv)++;
+
+  set_defaults (NULL);
 
   while (*argc && (*argv)[0][0] == '-' && (*argv)[0][1] == '-')
     {
@@ -473,6 +536,14 @@ hid_parse_command_line (int *argc, char ***argv)
 	  arg_ofs = 5;
 	  goto try_no_arg;
 	}
+      if (!plugins_loaded)
+	{
+	  /* it may be an option of a plugin */
+	  hid_load_plugins ();
+	  bool_val = 1;
+	  arg_ofs = 2;
+	  goto try_no_arg;
+	}
       fprintf (stderr, "unrecognized option: %s\n", (*argv)[0]);
       exit (1);
     got_match:;
@@ -597,14 +668,18 @@ hid_save_settings (int locally)
   free (fname);
 }
 
+/*!
+ * \brief Set the default of the attribute called \p name, among those
+ * registered after \p stop.
+ */
 static void
-hid_set_attribute (char *name, char *value)
+hid_set_attribute (char *name, char *value, HID_AttrNode *stop)
 {
   const Unit *unit;
   HID_AttrNode *ha;
   int i, e, ok;
 
-  for (ha = hid_attr_nodes; ha; ha = ha->next)
+  for (ha = hid_attr_nodes; ha != stop; ha = ha->next)
     for (i = 0; i < ha->n; i++)
       if (strcmp (name, ha->attributes[i].name) == 0)
 	{
@@ -669,7 +744,7 @@ hid_set_attribute (char *name, char *value)
 }
 
 static void
-hid_load_settings_1 (char *fname)
+hid_load_settings_1 (char *fname, HID_AttrNode *stop)
 {
   char line[1024], *namep, *valp, *cp;
   FILE *f;
@@ -700,27 +775,39 @@ hid_load_settings_1 (char *fname)
       cp = valp + strlen(valp) - 1;
       while (cp >= valp && isspace ((int) *cp))
 	*cp-- = 0;
-      hid_set_attribute (namep, valp);
+      hid_set_attribute (namep, valp, stop);
     }
 
   fclose (f);
 }
 
-void
-hid_load_settings ()
+/*!
+ * \brief Give the settings files to the attributes registered after
+ * \p stop, or to all of them.
+ */
+static void
+load_settings (HID_AttrNode *stop)
 {
   HID_AttrNode *ha;
   int i;
 
-  for (ha = hid_attr_nodes; ha; ha = ha->next)
+  settings_loaded = true;
+  for (ha = hid_attr_nodes; ha != stop; ha = ha->next)
     for (i = 0; i < ha->n; i++)
       ha->attributes[i].hash = attr_hash (ha->attributes+i);
 
-  hid_load_settings_1 (Concat (pcblibdir, PCB_DIR_SEPARATOR_S, "settings", NULL));
+  hid_load_settings_1 (Concat (pcblibdir, PCB_DIR_SEPARATOR_S, "settings", NULL),
+		       stop);
   if (homedir != NULL)
     hid_load_settings_1 (Concat (homedir, PCB_DIR_SEPARATOR_S, ".pcb",
-               PCB_DIR_SEPARATOR_S, "settings", NULL));
-  hid_load_settings_1 (Concat ("pcb.settings", NULL));
+               PCB_DIR_SEPARATOR_S, "settings", NULL), stop);
+  hid_load_settings_1 (Concat ("pcb.settings", NULL), stop);
+}
+
+void
+hid_load_settings ()
+{
+  load_settings (NULL);
 }
 
 #define HASH_SIZE 31
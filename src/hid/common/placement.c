@@ -0,0 +1,390 @@
+/*!
+ * \file src/hid/common/placement.c
+ *
+ * \brief Placement of elements for the centroid and footprint exporters.
+ *
+ * The BOM, gsvit and KiCad exporters give each element a centroid, a
+ * rotation found from the position of pin #1 as IPC 7351 defines it, and
+ * a side.  What that takes from the pins and pads of the elements is
+ * gathered for the whole board at once, on worker threads, and kept
+ * until the board changes, the same way as the connectivity index of
+ * find.c: any insertion into or deletion from the r-trees of the objects
+ * changes r_generation(), and other edits go through SetChangedFlag().  The
+ * xy-centre and xy-fixed-rotation attributes are read on each lookup.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "data.h"
+#include "misc.h"
+#include "rtree.h"
+
+#include "placement.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+#define PLACEMENT_CHUNK 64      /*!< Elements gathered by one job. */
+
+/*!
+ * \brief Includes numbered and BGA pins.
+ *
+ * In order of preference.
+ * Possibly BGA pins can be missing, so we add a few to try.
+ */
+static const char *reference_pin_names[] =
+  { "1", "2", "A1", "A2", "B1", "B2" };
+
+#define REFPINS \
+  ((int) (sizeof (reference_pin_names) / sizeof (reference_pin_names[0])))
+
+/*!
+ * \brief What the placement of an element takes from its pins and pads.
+ */
+typedef struct
+{
+  int pins;                     /*!< Pins and pads. */
+  double sumx, sumy;            /*!< Sums of their centres. */
+  bool found[REFPINS];          /*!< Reference pins present. */
+  double refx[REFPINS], refy[REFPINS]; /*!< Their centres. */
+  double refangle[REFPINS];     /*!< The angle of a reference pad. */
+} ElementGeometryType;
+
+/*!
+ * \brief The geometry of every element of a board.
+ */
+static struct
+{
+  GHashTable *table;            /*!< Element to its geometry. */
+  ElementGeometryType *geometry;
+  unsigned long generation;
+  PCBType *pcb;
+} Cache;
+
+typedef struct
+{
+  ElementType **elements;
+  ElementGeometryType *geometry;
+  int n;
+  gint *pending;
+  GMutex *lock;
+  GCond *done;
+} PlacementJobType;
+
+/*!
+ * \brief Mark the geometry of the elements as stale.
+ */
+void
+ElementPlacementInvalidate (void)
+{
+  Cache.pcb = NULL;
+}
+
+static void
+GatherGeometry (ElementType *element, ElementGeometryType *g)
+{
+  int i;
+
+  memset (g, 0, sizeof (*g));
+
+  /*
+   * Count the pins and pads and sum their centres, and store the
+   * location of the reference pins if we can find them.
+   */
+  PIN_LOOP (element);
+  {
+    g->sumx += (double) pin->X;
+    g->sumy += (double) pin->Y;
+    g->pins++;
+
+    for (i = 0; i < REFPINS; i++)
+      if (NSTRCMP (pin->Number, reference_pin_names[i]) == 0)
+        {
+          g->refx[i] = (double) pin->X;
+          g->refy[i] = (double) pin->Y;
+          g->refangle[i] = 0.0; /* pins have no notion of angle */
+          g->found[i] = true;
+        }
+  }
+  END_LOOP;
+
+  PAD_LOOP (element);
+  {
+    g->sumx += (pad->Point1.X + pad->Point2.X) / 2.0;
+    g->sumy += (pad->Point1.Y + pad->Point2.Y) / 2.0;
+    g->pins++;
+
+    for (i = 0; i < REFPINS; i++)
+      if (NSTRCMP (pad->Number, reference_pin_names[i]) == 0)
+        {
+          g->refx[i] = (double) (pad->Point1.X + pad->Point2.X) / 2.0;
+          g->refy[i] = (double) (pad->Point1.Y + pad->Point2.Y) / 2.0;
+          /*
+           * NOTE: We swap the Y points because in PCB, the Y-axis
+           * is inverted.  Increasing Y moves down.  We want to deal
+           * in the usual increasing Y moves up coordinates though.
+           */
+          g->refangle[i] = (180.0 / M_PI) *
+            atan2 (pad->Point1.Y - pad->Point2.Y,
+                   pad->Point2.X - pad->Point1.X);
+          g->found[i] = true;
+        }
+  }
+  END_LOOP;
+}
+
+static void
+PlacementWorker (gpointer data, gpointer user_data)
+{
+  PlacementJobType *job = (PlacementJobType *) data;
+  int i;
+
+  for (i = 0; i < job->n; i++)
+    GatherGeometry (job->elements[i], &job->geometry[i]);
+
+  g_mutex_lock (job->lock);
+  if (--*job->pending == 0)
+    g_cond_signal (job->done);
+  g_mutex_unlock (job->lock);
+}
+
+/*!
+ * \brief Gather the geometry of every element of the board.
+ *
+ * Gathering only reads the pins and pads of its elements, so with
+ * several processors the elements are shared out in chunks to worker
+ * threads.
+ */
+static void
+PlacementUpdate (void)
+{
+  static GThreadPool *pool = NULL;
+  ElementType **elements;
+  PlacementJobType *jobs;
+  GMutex lock;
+  GCond done;
+  gint pending;
+  int n_elements = 0, njobs, i;
+
+  if (Cache.table && Cache.pcb == PCB && Cache.generation == r_generation ())
+    return;
+
+  if (Cache.table)
+    g_hash_table_remove_all (Cache.table);
+  else
+    Cache.table = g_hash_table_new (g_direct_hash, g_direct_equal);
+  free (Cache.geometry);
+
+  elements = (ElementType **) malloc (MAX (PCB->Data->ElementN, 1) *
+                                      sizeof (ElementType *));
+  ELEMENT_LOOP (PCB->Data);
+  {
+    elements[n_elements++] = element;
+  }
+  END_LOOP;
+  Cache.geometry = (ElementGeometryType *)
+    malloc (MAX (n_elements, 1) * sizeof (ElementGeometryType));
+
+  njobs = (n_elements + PLACEMENT_CHUNK - 1) / PLACEMENT_CHUNK;
+  if (njobs < 2 || g_get_num_processors () < 2)
+    {
+      for (i = 0; i < n_elements; i++)
+        GatherGeometry (elements[i], &Cache.geometry[i]);
+    }
+  else
+    {
+      jobs = (PlacementJobType *) malloc (njobs * sizeof (PlacementJobType));
+      pending = njobs;
+      g_mutex_init (&lock);
+      g_cond_init (&done);
+      if (pool == NULL)
+        pool = g_thread_pool_new (PlacementWorker, NULL,
+                                  g_get_num_processors (), TRUE, NULL);
+
+      for (i = 0; i < njobs; i++)
+        {
+          jobs[i].elements = elements + i * PLACEMENT_CHUNK;
+          jobs[i].geometry = Cache.geometry + i * PLACEMENT_CHUNK;
+          jobs[i].n = MIN (PLACEMENT_CHUNK, n_elements - i * PLACEMENT_CHUNK);
+          jobs[i].pending = &pending;
+          jobs[i].lock = &lock;
+          jobs[i].done = &done;
+          g_thread_pool_push (pool, &jobs[i], NULL);
+        }
+
+      g_mutex_lock (&lock);
+      while (pending > 0)
+        g_cond_wait (&done, &lock);
+      g_mutex_unlock (&lock);
+
+      g_mutex_clear (&lock);
+      g_cond_clear (&done);
+      free (jobs);
+    }
+
+  for (i = 0; i < n_elements; i++)
+    g_hash_table_insert (Cache.table, elements[i], &Cache.geometry[i]);
+  free (elements);
+  Cache.generation = r_generation ();
+  Cache.pcb = PCB;
+}
+
+static double
+xyToAngle (double x, double y, bool morethan2pins)
+{
+  double d = atan2 (-y, x) * 180.0 / M_PI;
+
+  /* IPC 7351 defines different rules for 2 pin elements */
+  if (morethan2pins)
+    {
+      /* Multi pin case:
+       * Output 0 degrees if pin1 in is top left or top, i.e. between angles of
+       * 80 to 170 degrees.
+       * Pin #1 can be at dead top (e.g. certain PLCCs) or anywhere in the top
+       * left.
+       */
+      if (d < -100)
+        return 90; /* -180 to -100 */
+      else if (d < -10)
+        return 180; /* -100 to -10 */
+      else if (d < 80)
+        return 270; /* -10 to 80 */
+      else if (d < 170)
+        return 0; /* 80 to 170 */
+      else
+        return 90; /* 170 to 180 */
+    }
+  else
+    {
+      /* 2 pin element:
+       * Output 0 degrees if pin #1 is in top left or left, i.e. in sector
+       * between angles of 95 and 185 degrees.
+       */
+      if (d < -175)
+        return 0; /* -180 to -175 */
+      else if (d < -85)
+        return 90; /* -175 to -85 */
+      else if (d < 5)
+        return 180; /* -85 to 5 */
+      else if (d < 95)
+        return 270; /* 5 to 95 */
+      else
+        return 0; /* 95 to 180 */
+    }
+}
+
+/*!
+ * \brief Find where an element is placed.
+ *
+ * The placement point is the centroid of the pins and pads, or the mark
+ * of the element if \p at_mark is set or its xy-centre attribute is
+ * "origin".  The rotation is that of the xy-fixed-rotation attribute, or
+ * else is found from the first reference pin away from that point.
+ *
+ * An element with no pins and pads gets its mark and no rotation.
+ */
+void
+ElementGetPlacement (ElementType *element, bool at_mark,
+                     ElementPlacementType *place)
+{
+  ElementGeometryType local, *g;
+  char *fixed_rotation;
+  double pin1x, pin1y;
+  int i;
+
+  PlacementUpdate ();
+  g = (ElementGeometryType *) g_hash_table_lookup (Cache.table, element);
+  if (g == NULL)
+    {
+      /* not on the board, e.g. in a paste buffer */
+      GatherGeometry (element, &local);
+      g = &local;
+    }
+
+  place->pins = g->pins;
+  place->front = FRONT (element) == 1;
+  place->rotation = 0.0;
+  place->status = PLACEMENT_OK;
+  if (g->pins > 0 && !at_mark
+      && NSTRCMP (AttributeGetFromList (&element->Attributes, "xy-centre"),
+                  "origin") != 0)
+    {
+      place->x = g->sumx / (double) g->pins;
+      place->y = g->sumy / (double) g->pins;
+    }
+  else
+    {
+      place->x = element->MarkX;
+      place->y = element->MarkY;
+    }
+
+  fixed_rotation = AttributeGetFromList (&element->Attributes,
+                                         "xy-fixed-rotation");
+  if (fixed_rotation)
+    {
+      /* The user specified a fixed rotation */
+      place->rotation = atof (fixed_rotation);
+      return;
+    }
+  if (g->pins == 0)
+    return;
+
+  /* Find first reference pin not at the centroid */
+  place->status = PLACEMENT_NO_REFPIN;
+  for (i = 0; i < REFPINS; i++)
+    {
+      if (!g->found[i])
+        continue;
+      place->status = PLACEMENT_REFPIN_AT_CENTRE;
+
+      /* Recenter pin "#1" onto the axis which cross at the part centroid */
+      pin1x = g->refx[i] - place->x;
+      pin1y = g->refy[i] - place->y;
+
+      /* flip x, to reverse rotation for elements on back */
+      if (!place->front)
+        pin1x = -pin1x;
+
+      /* if only 1 pin, use pin 1's angle */
+      if (g->pins == 1)
+        {
+          place->rotation = g->refangle[i];
+          place->status = PLACEMENT_OK;
+          return;
+        }
+      else if ((pin1x != 0.0) || (pin1y != 0.0))
+        {
+          place->rotation = xyToAngle (pin1x, pin1y, g->pins > 2);
+          place->status = PLACEMENT_OK;
+          return;
+        }
+    }
+}
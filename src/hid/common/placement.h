@@ -0,0 +1,58 @@
+/*!
+ * \file src/hid/common/placement.h
+ *
+ * \brief Placement of elements for the centroid and footprint exporters.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef PCB_HID_COMMON_PLACEMENT_H
+#define PCB_HID_COMMON_PLACEMENT_H
+
+#include "global.h"
+
+/*!
+ * \brief Outcome of finding the rotation of an element.
+ */
+typedef enum
+{
+  PLACEMENT_OK,                 /*!< Found from a reference pin or given. */
+  PLACEMENT_NO_REFPIN,          /*!< No pin has a reference pin number. */
+  PLACEMENT_REFPIN_AT_CENTRE    /*!< The reference pins are at the centre. */
+} PlacementStatusType;
+
+/*!
+ * \brief Where an element is placed, as the centroid files give it.
+ */
+typedef struct
+{
+  int pins;                     /*!< Pins and pads of the element. */
+  Coord x, y;                   /*!< The centroid, or the mark. */
+  double rotation;              /*!< In degrees, IPC 7351 style. */
+  bool front;                   /*!< On the component side. */
+  PlacementStatusType status;
+} ElementPlacementType;
+
+void ElementGetPlacement (ElementType *element, bool at_mark,
+                          ElementPlacementType *place);
+void ElementPlacementInvalidate (void);
+
+#endif /* PCB_HID_COMMON_PLACEMENT_H */
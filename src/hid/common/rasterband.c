@@ -0,0 +1,286 @@
+/*!
+ * \file src/hid/common/rasterband.c
+ *
+ * \brief Helpers of the exporters that rasterise layers with gd.
+ *
+ * A layer mask of a large board at the resolution of a field solver does
+ * not fit in memory as one gd image.  A raster band stream writes a
+ * palette PNG a band of rows at a time instead, so that only the band
+ * being drawn is held.  The PNG data is deflated with zlib as the rows
+ * come in.
+ *
+ * raster_run_layers() draws the layers of an export in worker processes,
+ * as the drawing code cannot be run on several threads.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "job.h"
+#include "hid/common/rasterband.h"
+
+#ifdef HAVE_RASTER_BANDS
+#include <zlib.h>
+#endif
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+#ifdef HAVE_RASTER_BANDS
+
+#define RASTER_BAND_CHUNK 65536	/* most bytes of an IDAT chunk */
+
+struct raster_band_stream
+{
+  FILE *f;
+  int width, height;
+  int rows;			/* rows written so far */
+  gdImagePtr palette;		/* the colours of every band */
+  z_stream z;
+  unsigned char *row;		/* filter byte and pixels of a row */
+  unsigned char out[RASTER_BAND_CHUNK];
+  bool ok;
+};
+
+static void
+put32 (unsigned char *p, unsigned long v)
+{
+  p[0] = (v >> 24) & 0xff;
+  p[1] = (v >> 16) & 0xff;
+  p[2] = (v >> 8) & 0xff;
+  p[3] = v & 0xff;
+}
+
+static void
+write_chunk (RasterBandStream *s, const char *type,
+	     const unsigned char *data, unsigned long len)
+{
+  unsigned char buf[4];
+  uLong crc;
+
+  put32 (buf, len);
+  fwrite (buf, 1, 4, s->f);
+  fwrite (type, 1, 4, s->f);
+  if (len)
+    fwrite (data, 1, len, s->f);
+  crc = crc32 (crc32 (0L, Z_NULL, 0), (const Bytef *) type, 4);
+  if (len)
+    crc = crc32 (crc, data, len);
+  put32 (buf, crc);
+  fwrite (buf, 1, 4, s->f);
+}
+
+/*!
+ * \brief Deflate what is in the stream, writing IDAT chunks as the
+ * output buffer fills.
+ */
+static void
+deflate_rows (RasterBandStream *s, int flush)
+{
+  int ret;
+
+  do
+    {
+      s->z.next_out = s->out;
+      s->z.avail_out = RASTER_BAND_CHUNK;
+      ret = deflate (&s->z, flush);
+      if (ret == Z_STREAM_ERROR)
+	{
+	  s->ok = false;
+	  return;
+	}
+      if (s->z.avail_out < RASTER_BAND_CHUNK)
+	write_chunk (s, "IDAT", s->out, RASTER_BAND_CHUNK - s->z.avail_out);
+    }
+  while (s->z.avail_out == 0 || (flush == Z_FINISH && ret != Z_STREAM_END));
+}
+
+/*!
+ * \brief Start a palette PNG of width by height pixels on \p f.
+ *
+ * The colours are those of \p palette, which the bands get a copy of from
+ * raster_band_image().  It has to stay until the stream is closed.
+ */
+RasterBandStream *
+raster_band_open (FILE *f, int width, int height, gdImagePtr palette)
+{
+  static const unsigned char signature[8] =
+    { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+  RasterBandStream *s;
+  unsigned char ihdr[13], plte[3 * 256];
+  int i, n = gdImageColorsTotal (palette);
+
+  s = (RasterBandStream *) calloc (1, sizeof (RasterBandStream));
+  s->f = f;
+  s->width = width;
+  s->height = height;
+  s->palette = palette;
+  s->row = (unsigned char *) malloc (width + 1);
+  s->ok = deflateInit (&s->z, Z_DEFAULT_COMPRESSION) == Z_OK;
+
+  fwrite (signature, 1, sizeof (signature), f);
+  put32 (ihdr, width);
+  put32 (ihdr + 4, height);
+  ihdr[8] = 8;			/* bits a pixel */
+  ihdr[9] = 3;			/* palette colour */
+  ihdr[10] = ihdr[11] = ihdr[12] = 0;
+  write_chunk (s, "IHDR", ihdr, sizeof (ihdr));
+  for (i = 0; i < n; i++)
+    {
+      plte[3 * i] = gdImageRed (palette, i);
+      plte[3 * i + 1] = gdImageGreen (palette, i);
+      plte[3 * i + 2] = gdImageBlue (palette, i);
+    }
+  write_chunk (s, "PLTE", plte, 3 * MAX (n, 1));
+  return s;
+}
+
+/*!
+ * \brief Make an image for the band of rows from \p top, with the colours
+ * of the stream in the same order.
+ */
+gdImagePtr
+raster_band_image (RasterBandStream *s, int top, int rows)
+{
+  gdImagePtr im;
+  int i;
+
+  rows = MIN (rows, s->height - top);
+  im = gdImageCreate (s->width, MAX (rows, 1));
+  for (i = 0; i < gdImageColorsTotal (s->palette); i++)
+    gdImageColorAllocate (im, gdImageRed (s->palette, i),
+			  gdImageGreen (s->palette, i),
+			  gdImageBlue (s->palette, i));
+  return im;
+}
+
+/*!
+ * \brief Write the rows of the next band.
+ */
+bool
+raster_band_write (RasterBandStream *s, gdImagePtr band)
+{
+  int y;
+
+  for (y = 0; y < gdImageSY (band) && s->rows < s->height && s->ok; y++)
+    {
+      s->row[0] = 0;		/* no filter */
+      memcpy (s->row + 1, band->pixels[y], s->width);
+      s->z.next_in = s->row;
+      s->z.avail_in = s->width + 1;
+      deflate_rows (s, Z_NO_FLUSH);
+      s->rows++;
+    }
+  return s->ok;
+}
+
+/*!
+ * \brief Finish the PNG and free the stream.  The file is left open.
+ *
+ * \return false if the PNG could not be written whole.
+ */
+bool
+raster_band_close (RasterBandStream *s)
+{
+  bool ok = s->ok && s->rows == s->height;
+
+  if (s->ok)
+    deflate_rows (s, Z_FINISH);
+  deflateEnd (&s->z);
+  write_chunk (s, "IEND", NULL, 0);
+  ok = ok && s->ok && !ferror (s->f);
+  free (s->row);
+  free (s);
+  return ok;
+}
+
+#endif /* HAVE_RASTER_BANDS */
+
+/*!
+ * \brief The layer groups raster_run_layers() writes.
+ */
+typedef struct
+{
+  int group[MAX_GROUP];
+  void (*write_layer) (int group);
+} raster_layers;
+
+static int
+raster_layer_worker (int part, FILE *fp, void *data)
+{
+  raster_layers *l = (raster_layers *) data;
+
+  l->write_layer (l->group[part]);
+  fflush (NULL);
+  return 0;
+}
+
+static bool
+raster_layer_here (int part, FILE *fp, void *data)
+{
+  raster_layers *l = (raster_layers *) data;
+
+  l->write_layer (l->group[part]);
+  return true;
+}
+
+/*!
+ * \brief Call \p write_layer for each group marked in \p export_group.
+ *
+ * With \p jobs above 1, up to that many layers are written at once by
+ * worker processes, each with a copy of the board.  A layer a worker
+ * fails on is written again by pcb itself, and so is \p parent_group,
+ * which is for a layer that leaves behind what the exporter needs
+ * afterwards.
+ */
+void
+raster_run_layers (const int *export_group, int jobs, int parent_group,
+		   void (*write_layer) (int group))
+{
+  raster_layers l;
+  int i, n = 0, local = -1;
+
+  for (i = 0; i < MAX_GROUP; i++)
+    if (export_group[i])
+      {
+	if (i == parent_group)
+	  local = n;
+	l.group[n++] = i;
+      }
+  l.write_layer = write_layer;
+  /* without workers the layers are written in order */
+  if (jobs < 2)
+    {
+      jobs = 0;
+      local = -1;
+    }
+  pcb_fork_workers (n, jobs, local, false, raster_layer_worker,
+		    raster_layer_here, &l);
+}
@@ -0,0 +1,47 @@
+/*!
+ * \file src/hid/common/rasterband.h
+ *
+ * \brief Helpers of the exporters that rasterise layers with gd.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef PCB_HID_COMMON_RASTERBAND_H
+#define PCB_HID_COMMON_RASTERBAND_H
+
+#if defined(HAVE_ZLIB_H) && defined(HAVE_LIBZ)
+#define HAVE_RASTER_BANDS 1
+
+#include <gd.h>
+
+typedef struct raster_band_stream RasterBandStream;
+
+RasterBandStream *raster_band_open (FILE *f, int width, int height,
+				    gdImagePtr palette);
+gdImagePtr raster_band_image (RasterBandStream *s, int top, int rows);
+bool raster_band_write (RasterBandStream *s, gdImagePtr band);
+bool raster_band_close (RasterBandStream *s);
+#endif
+
+void raster_run_layers (const int *export_group, int jobs, int parent_group,
+			void (*write_layer) (int group));
+
+#endif
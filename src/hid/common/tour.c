@@ -0,0 +1,335 @@
+/*!
+ * \file src/hid/common/tour.c
+ *
+ * \brief Ordering of tool moves for the exporters of machine files.
+ *
+ * The drills of a G-code or Excellon file and the isolation paths of a
+ * G-code layer are visited in an order that keeps the moves between them
+ * short: a nearest neighbour tour from the start, found through a grid of
+ * the points, and then improved by 2-opt moves between each point and its
+ * nearest neighbours.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "tour.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+#define TOUR_NEIGHBOURS 8       /*!< 2-opt candidates of each point. */
+#define TOUR_PASSES 32          /*!< Most 2-opt passes over the tour. */
+
+/*!
+ * \brief A grid of square cells over the points.
+ *
+ * The points of a cell are kept in a doubly linked list, so that the
+ * nearest neighbour tour can take them out as they are visited.
+ */
+struct tour_grid
+{
+  int w, h;                     /*!< Cells across and down. */
+  double x0, y0;                /*!< Corner of the first cell. */
+  double cell;                  /*!< Size of a cell. */
+  int *head;                    /*!< First point of each cell, or -1. */
+  int *next, *prev;             /*!< Neighbours of a point in its cell. */
+  int *cell_of;                 /*!< Cell of each point. */
+};
+
+static void
+grid_cell (const struct tour_grid *g, double x, double y, int *cx, int *cy)
+{
+  *cx = (int) floor ((x - g->x0) / g->cell);
+  *cy = (int) floor ((y - g->y0) / g->cell);
+  *cx = *cx < 0 ? 0 : *cx >= g->w ? g->w - 1 : *cx;
+  *cy = *cy < 0 ? 0 : *cy >= g->h ? g->h - 1 : *cy;
+}
+
+static void
+grid_insert (struct tour_grid *g, const double *x, const double *y, int i)
+{
+  int cx, cy, c;
+
+  grid_cell (g, x[i], y[i], &cx, &cy);
+  c = cy * g->w + cx;
+  g->cell_of[i] = c;
+  g->prev[i] = -1;
+  g->next[i] = g->head[c];
+  if (g->head[c] >= 0)
+    g->prev[g->head[c]] = i;
+  g->head[c] = i;
+}
+
+static void
+grid_remove (struct tour_grid *g, int i)
+{
+  if (g->prev[i] >= 0)
+    g->next[g->prev[i]] = g->next[i];
+  else
+    g->head[g->cell_of[i]] = g->next[i];
+  if (g->next[i] >= 0)
+    g->prev[g->next[i]] = g->prev[i];
+}
+
+/*!
+ * \brief Make a grid of about one point a cell, and put the points in.
+ */
+static void
+grid_init (struct tour_grid *g, const double *x, const double *y, int n)
+{
+  double x1 = x[0], y1 = y[0], x2 = x[0], y2 = y[0];
+  int i, side;
+
+  for (i = 1; i < n; i++)
+    {
+      x1 = fmin (x1, x[i]);
+      x2 = fmax (x2, x[i]);
+      y1 = fmin (y1, y[i]);
+      y2 = fmax (y2, y[i]);
+    }
+  side = (int) ceil (sqrt ((double) n));
+  g->x0 = x1;
+  g->y0 = y1;
+  g->cell = fmax (x2 - x1, y2 - y1) / side;
+  if (g->cell <= 0)
+    g->cell = 1;
+  g->w = (int) ((x2 - x1) / g->cell) + 1;
+  g->h = (int) ((y2 - y1) / g->cell) + 1;
+  g->head = (int *) malloc (g->w * g->h * sizeof (int));
+  g->next = (int *) malloc (n * sizeof (int));
+  g->prev = (int *) malloc (n * sizeof (int));
+  g->cell_of = (int *) malloc (n * sizeof (int));
+  for (i = 0; i < g->w * g->h; i++)
+    g->head[i] = -1;
+  for (i = n - 1; i >= 0; i--)
+    grid_insert (g, x, y, i);
+}
+
+static void
+grid_free (struct tour_grid *g)
+{
+  free (g->head);
+  free (g->next);
+  free (g->prev);
+  free (g->cell_of);
+}
+
+/*!
+ * \brief Find the points of the grid nearest to (qx, qy).
+ *
+ * The cells are searched in rings around the cell of the query, until no
+ * ring further out can hold a point nearer than the k-th found.
+ *
+ * \return the number of points put in \p best, nearest first, with their
+ * distances in \p dist: k, or less if the grid holds fewer points.
+ */
+static int
+grid_nearest (const struct tour_grid *g, const double *x, const double *y,
+              double qx, double qy, int self, int k, int *best, double *dist)
+{
+  int found = 0, cx, cy, r, xx, yy, i, j;
+
+  grid_cell (g, qx, qy, &cx, &cy);
+  for (r = 0; r <= g->w || r <= g->h; r++)
+    {
+      for (yy = cy - r; yy <= cy + r; yy++)
+        {
+          if (yy < 0 || yy >= g->h)
+            continue;
+          for (xx = cx - r; xx <= cx + r;
+               xx += (yy == cy - r || yy == cy + r) ? 1 : 2 * r)
+            {
+              if (xx < 0 || xx >= g->w)
+                continue;
+              for (i = g->head[yy * g->w + xx]; i >= 0; i = g->next[i])
+                {
+                  double d = hypot (x[i] - qx, y[i] - qy);
+
+                  if (i == self || (found == k && d >= dist[k - 1]))
+                    continue;
+                  if (found < k)
+                    found++;
+                  for (j = found - 1; j > 0 && dist[j - 1] > d; j--)
+                    {
+                      best[j] = best[j - 1];
+                      dist[j] = dist[j - 1];
+                    }
+                  best[j] = i;
+                  dist[j] = d;
+                }
+            }
+        }
+      /* the cells of the rings further out are at least r cells away */
+      if (found == k && dist[k - 1] <= r * g->cell)
+        break;
+    }
+  return found;
+}
+
+static void
+reverse (int *t, int *pos, int lo, int hi)
+{
+  for (; lo < hi; lo++, hi--)
+    {
+      int tmp = t[lo];
+
+      t[lo] = t[hi];
+      t[hi] = tmp;
+      pos[t[lo]] = lo;
+      pos[t[hi]] = hi;
+    }
+}
+
+/*!
+ * \brief Try a 2-opt move that replaces the edge of the tour ending at
+ * position i, with its first point joined to one of its neighbours.
+ *
+ * \return true if the tour was made shorter.
+ */
+static int
+improve_edge (const double *x, const double *y, int n, int *t, int *pos,
+              const int *nb, const int *n_nb, int i)
+{
+  int a = t[i - 1], b = t[i];
+  double dab = hypot (x[a] - x[b], y[a] - y[b]);
+  int k;
+
+  for (k = 0; k < n_nb[a]; k++)
+    {
+      int c = nb[a * TOUR_NEIGHBOURS + k];
+      int j = pos[c];
+      double dac = hypot (x[a] - x[c], y[a] - y[c]);
+      double gain;
+
+      if (dac >= dab)
+        break;
+      if (j > i)
+        {
+          /* a-b ... c-e becomes a-c ... b-e; the tour may end at c */
+          gain = dab - dac;
+          if (j < n)
+            gain += hypot (x[c] - x[t[j + 1]], y[c] - y[t[j + 1]])
+              - hypot (x[b] - x[t[j + 1]], y[b] - y[t[j + 1]]);
+          if (gain > 1e-9)
+            {
+              reverse (t, pos, i, j);
+              return 1;
+            }
+        }
+      else if (j < i - 1)
+        {
+          /* c-f ... a-b becomes c-a ... f-b */
+          int f = t[j + 1];
+
+          gain = dab - dac + hypot (x[c] - x[f], y[c] - y[f])
+            - hypot (x[f] - x[b], y[f] - y[b]);
+          if (gain > 1e-9)
+            {
+              reverse (t, pos, j + 1, i - 1);
+              return 1;
+            }
+        }
+    }
+  return 0;
+}
+
+/*!
+ * \brief Order points for a short tool path starting at (x0, y0).
+ *
+ * The path goes to the nearest point left each time, and is then
+ * shortened by 2-opt moves until none is found or TOUR_PASSES are done.
+ * Both steps look up near points in a grid, so a board of many points
+ * takes about N log N rather than N^2.
+ *
+ * \param order gets the indices of the n points in the order to visit.
+ */
+void
+tour_order (const double *x, const double *y, int n,
+            double x0, double y0, int *order)
+{
+  struct tour_grid g;
+  double *px, *py, dist[TOUR_NEIGHBOURS];
+  int *t, *pos, *nb, *n_nb;
+  int i, pass, improved;
+
+  if (n <= 0)
+    return;
+
+  /* the start is point n; it stays first in the tour */
+  px = (double *) malloc ((n + 1) * sizeof (double));
+  py = (double *) malloc ((n + 1) * sizeof (double));
+  for (i = 0; i < n; i++)
+    {
+      px[i] = x[i];
+      py[i] = y[i];
+    }
+  px[n] = x0;
+  py[n] = y0;
+
+  t = (int *) malloc ((n + 1) * sizeof (int));
+  pos = (int *) malloc ((n + 1) * sizeof (int));
+  t[0] = n;
+  pos[n] = 0;
+
+  grid_init (&g, px, py, n);
+  for (i = 1; i <= n; i++)
+    {
+      int prev = t[i - 1];
+
+      grid_nearest (&g, px, py, px[prev], py[prev], -1, 1, &t[i], dist);
+      pos[t[i]] = i;
+      grid_remove (&g, t[i]);
+    }
+  grid_free (&g);
+
+  if (n >= 3)
+    {
+      nb = (int *) malloc ((n + 1) * TOUR_NEIGHBOURS * sizeof (int));
+      n_nb = (int *) malloc ((n + 1) * sizeof (int));
+      grid_init (&g, px, py, n + 1);
+      for (i = 0; i <= n; i++)
+        n_nb[i] = grid_nearest (&g, px, py, px[i], py[i], i, TOUR_NEIGHBOURS,
+                                &nb[i * TOUR_NEIGHBOURS], dist);
+      grid_free (&g);
+
+      for (pass = 0, improved = 1; improved && pass < TOUR_PASSES; pass++)
+        for (improved = 0, i = 1; i <= n; i++)
+          while (improve_edge (px, py, n, t, pos, nb, n_nb, i))
+            improved = 1;
+      free (nb);
+      free (n_nb);
+    }
+
+  for (i = 0; i < n; i++)
+    order[i] = t[i + 1];
+  free (px);
+  free (py);
+  free (t);
+  free (pos);
+}
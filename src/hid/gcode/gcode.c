@@ -70,7 +70,9 @@
 #include "curve.h"
 #include "potracelib.h"
 #include "trace.h"
+#include "hid/common/tour.h"
 #include "decompose.h"
+#include "raster.h"
 #include "pcb-printf.h"
 
 #include "hid/common/hidinit.h"
@@ -108,6 +110,8 @@ static int linewidth = -1;
 static gdImagePtr lastbrush = (gdImagePtr)((void *) -1);
 
 static gdImagePtr gcode_im = NULL; /*!< gd image and file for PNG export */
+static raster_t gcode_raster = {NULL, 0};
+        /*!< The bitmap drawn into instead with --direct-bitmap. */
 static FILE *gcode_f = NULL;
 
 static int is_mask;
@@ -139,6 +143,7 @@ static double gcode_milltoolradius = 0; /*!< Outline-mill tool radius (mm or in)
 static double gcode_millplunge = 0;     /*!< Outline-milling plunge feedrate. */
 static double gcode_millfeedrate = 0;   /*!< Outline-milling feedrate. */
 static char gcode_advanced = 0;
+static char gcode_direct = 0;
 static int save_drill = 0;
 
 /*!
@@ -385,6 +390,23 @@ hand-editing of the resulting files.
                      "better hand-editing of the resulting files.",
    HID_Boolean, 0, 0, {-1, 0, 0}, 0, 0},
 #define HA_advanced 16
+
+/* %start-doc options "85 G-code Options"
+@ftable @code
+@item --direct-bitmap
+Whether to draw the layers straight into the bitmap the mill paths are
+traced from.
+This needs an eighth of the memory and is faster at a high dpi, but no
+PNG layer masks are written, and the edges of round shapes can come out
+a pixel different.
+@end ftable
+%end-doc
+*/
+  {"direct-bitmap", "Whether to draw the layers straight into the bitmap\n"
+                    "the mill paths are traced from. This needs an eighth\n"
+                    "of the memory, but no PNG layer masks are written.",
+   HID_Boolean, 0, 0, {0, 0, 0}, 0, 0},
+#define HA_direct 17
 };
 
 #define NUM_OPTIONS (sizeof(gcode_attribute_list)/sizeof(gcode_attribute_list[0]))
@@ -402,6 +424,14 @@ static int pcb_to_gcode (int pcb)
   return round(COORD_TO_INCH(pcb) * gcode_dpi);
 }
 
+/*!
+ * \brief Convert from default PCB units to pixels of the direct bitmap.
+ */
+static double pcb_to_pixel (Coord pcb)
+{
+  return COORD_TO_INCH(pcb) * gcode_dpi;
+}
+
 /*!
  * \brief Fits the given layer name into basename, just before the
  * suffix.
@@ -432,53 +462,34 @@ gcode_get_filename (char *filename, const char *layername)
 /*!
  * \brief Sorts drills to produce a short tool path.
  *
- * I start with the hole nearest (0,0) and for each subsequent one, find
- * the hole nearest to the previous.
- *
- * This isn't guaranteed to find the shortest path, but should be good
- * enough.
- *
- * \note This is O(N^2).
- * We can't use the O(N logN) sort, since our shortest-distance origin
- * changes with every point.
+ * The path starts at (0,0); see tour_order() for how it is found.
  */
 static void
 sort_drill (struct drill_hole *drill, int n_drill)
 {
-  /* I start out by looking for points closest to (0,0) */
-  struct drill_hole nearest_target = { 0, 0 };
-
-  /* I sort my list by finding the correct point to fill each slot. I don't need
-     to look at the last one, since it'll be in the right place automatically */
-  for (int j = 0; j < n_drill-1; j++)
+  double *x, *y;
+  int *order, i;
+  struct drill_hole *sorted;
+
+  if (n_drill < 2)
+    return;
+  x = (double *) malloc (n_drill * sizeof (double));
+  y = (double *) malloc (n_drill * sizeof (double));
+  order = (int *) malloc (n_drill * sizeof (int));
+  sorted = (struct drill_hole *) malloc (n_drill * sizeof (*sorted));
+  for (i = 0; i < n_drill; i++)
     {
-      double dmin = 1e20;
-      int    imin = 0;
-      /* look through remaining elements to find the next drill point. This is
-         the one nearest to nearest_target */
-      for (int i = j; i < n_drill; i++)
-        {
-          double d =
-            (drill[i].x - nearest_target.x) * (drill[i].x - nearest_target.x) +
-            (drill[i].y - nearest_target.y) * (drill[i].y - nearest_target.y);
-          if (d < dmin)
-            {
-              imin = i;
-              dmin = d;
-            }
-        }
-      /* printf("j=%d imin=%d dmin=%f nearest_target=(%f,%f)\n",j,imin,dmin,
-                nearest_target.x,nearest_target.y); */
-      if (j != imin)
-        {
-          struct drill_hole tmp;
-          tmp         = drill[j];
-          drill[j]    = drill[imin];
-          drill[imin] = tmp;
-        }
-
-      nearest_target = drill[j];
+      x[i] = drill[i].x;
+      y[i] = drill[i].y;
     }
+  tour_order (x, y, n_drill, 0, 0, order);
+  for (i = 0; i < n_drill; i++)
+    sorted[i] = drill[order[i]];
+  memcpy (drill, sorted, n_drill * sizeof (*drill));
+  free (x);
+  free (y);
+  free (order);
+  free (sorted);
 }
 
 /* *** Main export callback ************************************************ */
@@ -656,6 +667,230 @@ gcode_start_gcode (const char *layername, bool metric)
   return file;
 }
 
+/*!
+ * \brief Make the potrace bitmap of a layer image.
+ *
+ * A bit is set for each black pixel.  The image is flipped vertically,
+ * and for the bottom side horizontally too.  The rows of the palette
+ * image are read straight, a word of the bitmap at a time.
+ */
+static potrace_bitmap_t *
+gcode_image_to_bitmap (gdImagePtr im, int flip)
+{
+  int w = gdImageSX (im), h = gdImageSY (im);
+  bool dark[256];
+  potrace_bitmap_t *bm;
+  int x, y, i;
+
+  bm = bm_new (w, h);
+  if (bm == NULL)
+    return NULL;
+  for (i = 0; i < 256; i++)
+    dark[i] = i < gdImageColorsTotal (im)
+              && !(im->red[i] || im->green[i] || im->blue[i]);
+
+  for (y = 0; y < h; y++)
+    {
+      unsigned char *row = im->pixels[h - 1 - y];
+      potrace_word *line = bm_scanline (bm, y);
+
+      for (i = 0; i < bm->dy; i++)
+        {
+          potrace_word word = 0;
+
+          for (x = i * BM_WORDBITS; x < w && x < (i + 1) * BM_WORDBITS; x++)
+            if (dark[row[flip ? w - 1 - x : x]])
+              word |= bm_mask (x);
+          line[i] = word;
+        }
+    }
+  return bm;
+}
+
+/*!
+ * \brief Flip an image horizontally, in place.
+ */
+static void
+gcode_flip_image (gdImagePtr im)
+{
+  int w = gdImageSX (im), x, y;
+
+  for (y = 0; y < gdImageSY (im); y++)
+    {
+      unsigned char *row = im->pixels[y];
+
+      for (x = 0; x < w / 2; x++)
+        {
+          unsigned char t = row[x];
+
+          row[x] = row[w - 1 - x];
+          row[w - 1 - x] = t;
+        }
+    }
+}
+
+/*!
+ * \brief Collect the drills to predrill into one list, sorted for the
+ * shortest path.
+ */
+static struct drill_hole *
+gcode_predrills (int metric, int *n)
+{
+  struct drill_hole *all_drills;
+  int i_drill_sets;
+
+  *n = 0;
+  /* count all drills to be predrilled */
+  for (i_drill_sets = 0; i_drill_sets < n_drills; i_drill_sets++)
+    {
+      struct single_size_drills* drill_set = &drills[i_drill_sets];
+
+      /* don't predrill drillmill holes */
+      if (gcode_drillmill) {
+        double radius = metric ?
+                        drill_set->diameter_inches * 25.4 / 2:
+                        drill_set->diameter_inches / 2;
+
+        if (gcode_milltoolradius < radius)
+          continue;
+      }
+
+      *n += drill_set->n_holes;
+    }
+  /* for sorting regardless of size, copy all drills to be
+     predrilled into one new structure */
+  all_drills = (struct drill_hole *)
+               malloc (MAX (1, *n) * sizeof (struct drill_hole));
+  *n = 0;
+  for (i_drill_sets = 0; i_drill_sets < n_drills; i_drill_sets++)
+    {
+      struct single_size_drills* drill_set = &drills[i_drill_sets];
+
+      /* don't predrill drillmill holes */
+      if (gcode_drillmill) {
+        double radius = metric ?
+                        drill_set->diameter_inches * 25.4 / 2:
+                        drill_set->diameter_inches / 2;
+
+        if (gcode_milltoolradius < radius)
+          continue;
+      }
+
+      memcpy(&all_drills[*n], drill_set->holes,
+             drill_set->n_holes * sizeof(struct drill_hole));
+      *n += drill_set->n_holes;
+    }
+  sort_drill(all_drills, *n);
+  return all_drills;
+}
+
+/*!
+ * \brief What the layers of an export have in common, for the tracing.
+ */
+struct gcode_trace_vars
+{
+  potrace_param_t param;
+  int metric;
+  const char *cutdepth, *safeZ, *isoplunge, *isofeedrate;
+};
+
+/*!
+ * \brief A layer to trace, once the header of its file is written.
+ */
+struct gcode_trace_job
+{
+  potrace_bitmap_t *bm;
+  FILE *f;
+  struct drill_hole *predrills; /*!< NULL for no predrilling. */
+  int n_predrills;
+};
+
+/*!
+ * \brief Trace the bitmap of a layer and finish its file.
+ *
+ * This runs on a thread of the pool of gcode_do_export(), while the next
+ * layers are drawn.  It only uses what the job and the variables hand it
+ * and the options, which do not change during the export.
+ */
+static void
+gcode_trace_layer (gpointer data, gpointer user_data)
+{
+  struct gcode_trace_job *job = (struct gcode_trace_job *) data;
+  const struct gcode_trace_vars *vars =
+    (const struct gcode_trace_vars *) user_data;
+  FILE *f = job->f;
+  path_t *plist = NULL;
+  double d;
+  int r;
+
+  /* extract contour points from image */
+  r = bm_to_pathlist (job->bm, &plist, &vars->param);
+  if (r)
+    {
+      fprintf (stderr, "ERROR: pathlist function failed\n");
+      goto out;
+    }
+  /* generate best polygon and write vertices in g-code format */
+  d = process_path (plist, &vars->param, job->bm, f,
+                    vars->metric ? 25.4 / gcode_dpi : 1.0 / gcode_dpi,
+                    vars->cutdepth, vars->safeZ,
+                    vars->isoplunge, vars->isofeedrate);
+  if (d < 0)
+    {
+      fprintf (stderr, "ERROR: path process function failed\n");
+      goto out;
+    }
+  if (job->predrills)
+    {
+      /* write that (almost the same code as writing the drill file) */
+      fprintf (f, "(predrilling)\n");
+      fprintf (f, "F%s\n", vars->isoplunge);
+
+      for (r = 0; r < job->n_predrills; r++)
+        {
+          double drillX, drillY;
+
+          if (vars->metric)
+            {
+              drillX = job->predrills[r].x * 25.4;
+              drillY = job->predrills[r].y * 25.4;
+            }
+          else
+            {
+              drillX = job->predrills[r].x;
+              drillY = job->predrills[r].y;
+            }
+          if (gcode_advanced)
+            pcb_fprintf (f, "G81 X%`f Y%`f Z%s R%s\n",
+                         drillX, drillY, vars->cutdepth, vars->safeZ);
+          else
+            {
+              pcb_fprintf (f, "G0 X%`f Y%`f\n", drillX, drillY);
+              pcb_fprintf (f, "G1 Z%s\n", vars->cutdepth);
+              pcb_fprintf (f, "G0 Z%s\n", vars->safeZ);
+            }
+        }
+      fprintf (f, "(%d predrills)\n", job->n_predrills);
+    }
+  if (vars->metric)
+    pcb_fprintf (f, "(milling distance %`.2fmm = %`.2fin)\n", d,
+                 d * 1 / 25.4);
+  else
+    pcb_fprintf (f, "(milling distance %`.2fmm = %`.2fin)\n",
+                 25.4 * d, d);
+  if (gcode_advanced)
+    fprintf (f, "M5 M9 M2\n");
+  else
+    fprintf (f, "M5\nM9\nM2\n");
+
+out:
+  pathlist_free (plist);
+  bm_free (job->bm);
+  fclose (f);
+  free (job->predrills);
+  free (job);
+}
+
 static void
 gcode_do_export (HID_Attr_Val * options)
 {
@@ -663,9 +898,10 @@ gcode_do_export (HID_Attr_Val * options)
   int i, idx;
   const Unit *unit;
   double scale = 0, d = 0;
-  int r, c, v, p, metric;
-  path_t *plist = NULL;
+  int r, metric;
   potrace_bitmap_t *bm = NULL;
+  struct gcode_trace_vars vars;
+  GThreadPool *pool;
   potrace_param_t param_default = {
     2,                           /* turnsize */
     POTRACE_TURNPOLICY_MINORITY, /* turnpolicy */
@@ -725,6 +961,7 @@ gcode_do_export (HID_Attr_Val * options)
   gcode_millplunge = options[HA_millplunge].real_value * scale;
   gcode_millfeedrate = options[HA_millfeedrate].real_value * scale;
   gcode_advanced = options[HA_advanced].int_value;
+  gcode_direct = options[HA_direct].int_value;
   gcode_choose_groups ();
   if (gcode_advanced)
     {
@@ -751,10 +988,23 @@ gcode_do_export (HID_Attr_Val * options)
       snprintf (variable_millfeedrate, 20, "%f", gcode_millfeedrate);
     }
 
+  /* The layers are drawn one after the other, since the drawing code
+     is not reentrant, but a layer is traced while the next are drawn.  */
+  vars.param = param_default;
+  vars.metric = metric;
+  vars.cutdepth = variable_cutdepth;
+  vars.safeZ = variable_safeZ;
+  vars.isoplunge = variable_isoplunge;
+  vars.isofeedrate = variable_isofeedrate;
+  pool = g_thread_pool_new (gcode_trace_layer, &vars,
+                            MAX (1, g_get_num_processors ()), FALSE, NULL);
+
   for (i = 0; i < MAX_GROUP; i++)
     {
       if (gcode_export_group[i])
         {
+          struct gcode_trace_job *job;
+
           gcode_cur_group = i;
 
           /* magic */
@@ -764,60 +1014,49 @@ gcode_do_export (HID_Attr_Val * options)
             (GetLayerGroupNumberByNumber (idx) ==
              GetLayerGroupNumberBySide (BOTTOM_SIDE)) ? 1 : 0;
           save_drill = is_bottom; /* save drills for one layer only */
-          gcode_start_png ();
-          hid_save_and_show_layer_ons (save_ons);
-          gcode_start_png_export ();
-          hid_restore_layer_ons (save_ons);
+          if (gcode_direct)
+            {
+              /* draw straight into the bitmap potrace reads, flipped
+                 as it goes */
+              bm = bm_new (pcb_to_gcode (PCB->MaxWidth),
+                           pcb_to_gcode (PCB->MaxHeight));
+              if (bm)
+                {
+                  bm_clear (bm, 0);
+                  gcode_raster.bm = bm;
+                  gcode_raster.flip = is_bottom;
+                  hid_save_and_show_layer_ons (save_ons);
+                  gcode_start_png_export ();
+                  hid_restore_layer_ons (save_ons);
+                  gcode_raster.bm = NULL;
+                }
+            }
+          else
+            {
+              gcode_start_png ();
+              hid_save_and_show_layer_ons (save_ons);
+              gcode_start_png_export ();
+              hid_restore_layer_ons (save_ons);
 
 /* ***************** gcode conversion *************************** */
 /* potrace uses a different kind of bitmap; for simplicity gcode_im is
    copied to this format and flipped as needed along the way */
-          bm = bm_new (gdImageSX (gcode_im), gdImageSY (gcode_im));
-          for (r = 0; r < gdImageSX (gcode_im); r++)
-            {
-              for (c = 0; c < gdImageSY (gcode_im); c++)
-                {
-                  if (is_bottom)
-                    v =  /* flip vertically and horizontally */
-                      gdImageGetPixel (gcode_im, gdImageSX (gcode_im) - 1 - r,
-                                       gdImageSY (gcode_im) - 1 - c);
-                  else
-                    v =  /* flip only vertically */
-                      gdImageGetPixel (gcode_im, r,
-                                       gdImageSY (gcode_im) - 1 - c);
-                  p = (gcode_im->red[v] || gcode_im->green[v]
-                       || gcode_im->blue[v]) ? 0 : 0xFFFFFF;
-                  BM_PUT (bm, r, c, p);
-                }
+              bm = gcode_image_to_bitmap (gcode_im, is_bottom);
+              if (is_bottom) /* flip back layer, used only for PNG output */
+                gcode_flip_image (gcode_im);
+              gcode_finish_png (layer_type_to_file_name (idx, FNS_fixed));
             }
-          if (is_bottom)
-            { /* flip back layer, used only for PNG output */
-              gdImagePtr temp_im =
-                gdImageCreate (gdImageSX (gcode_im), gdImageSY (gcode_im));
-              gdImageColorAllocate (temp_im, white->r, white->g, white->b);
-              gdImageColorAllocate (temp_im, black->r, black->g, black->b);
-              gdImageCopy (temp_im, gcode_im, 0, 0, 0, 0,
-                           gdImageSX (gcode_im), gdImageSY (gcode_im));
-              for (r = 0; r < gdImageSX (gcode_im); r++)
-                {
-                  for (c = 0; c < gdImageSY (gcode_im); c++)
-                    {
-                      gdImageSetPixel (gcode_im, r, c,
-                                       gdImageGetPixel (temp_im,
-                                                        gdImageSX (gcode_im) -
-                                                        1 - r, c));
-                    }
-                }
-              gdImageDestroy (temp_im);
+          if (!bm)
+            {
+              Message ("GCODE: out of memory for the bitmap of a layer\n");
+              goto done;
             }
-          gcode_finish_png (layer_type_to_file_name (idx, FNS_fixed));
-          plist = NULL;
           gcode_f = gcode_start_gcode (layer_type_to_file_name (idx, FNS_fixed),
                                        metric);
           if (!gcode_f)
             {
               bm_free (bm);
-              return;
+              goto done;
             }
           fprintf (gcode_f, "(Accuracy %d dpi)\n", gcode_dpi);
           pcb_fprintf (gcode_f, "(Tool diameter: %`f %s)\n",
@@ -846,111 +1085,16 @@ gcode_do_export (HID_Attr_Val * options)
               fprintf (gcode_f, "G17\nG%d\nG90\nG64 P0.003\nM3 S3000\nM7\n",
                        metric ? 21 : 20);
           fprintf (gcode_f, "G0 Z%s\n", variable_safeZ);
-          /* extract contour points from image */
-          r = bm_to_pathlist (bm, &plist, &param_default);
-          if (r)
-            {
-              fprintf (stderr, "ERROR: pathlist function failed\n");
-              return;
-            }
-          /* generate best polygon and write vertices in g-code format */
-          d = process_path (plist, &param_default, bm, gcode_f,
-                            metric ? 25.4 / gcode_dpi : 1.0 / gcode_dpi,
-                            variable_cutdepth, variable_safeZ,
-                            variable_isoplunge, variable_isofeedrate);
-          if (d < 0)
-            {
-              fprintf (stderr, "ERROR: path process function failed\n");
-              return;
-            }
-          if (gcode_predrill && save_drill)
-            {
-              int n_all_drills = 0;
-              struct drill_hole* all_drills = NULL;
-              /* count all drills to be predrilled */
-              for (int i_drill_sets = 0; i_drill_sets < n_drills; i_drill_sets++)
-                {
-                  struct single_size_drills* drill_set = &drills[i_drill_sets];
-
-                  /* don't predrill drillmill holes */
-                  if (gcode_drillmill) {
-                    double radius = metric ?
-                                    drill_set->diameter_inches * 25.4 / 2:
-                                    drill_set->diameter_inches / 2;
-
-                    if (gcode_milltoolradius < radius)
-                      continue;
-                  }
-
-                  n_all_drills += drill_set->n_holes;
-                }
-              /* for sorting regardless of size, copy all drills to be
-                 predrilled into one new structure */
-              all_drills = (struct drill_hole *)
-                           malloc (n_all_drills * sizeof (struct drill_hole));
-              for (int i_drill_sets = 0; i_drill_sets < n_drills; i_drill_sets++)
-                {
-                  struct single_size_drills* drill_set = &drills[i_drill_sets];
-
-                  /* don't predrill drillmill holes */
-                  if (gcode_drillmill) {
-                    double radius = metric ?
-                                    drill_set->diameter_inches * 25.4 / 2:
-                                    drill_set->diameter_inches / 2;
-
-                    if (gcode_milltoolradius < radius)
-                      continue;
-                  }
-
-                  memcpy(&all_drills[r], drill_set->holes,
-                         drill_set->n_holes * sizeof(struct drill_hole));
-                }
-              sort_drill(all_drills, n_all_drills);
-              /* write that (almost the same code as writing the drill file) */
-              fprintf (gcode_f, "(predrilling)\n");
-              fprintf (gcode_f, "F%s\n", variable_isoplunge);
-
-              for (r = 0; r < n_all_drills; r++)
-                {
-                  double drillX, drillY;
 
-                  if (metric)
-                    {
-                      drillX = all_drills[r].x * 25.4;
-                      drillY = all_drills[r].y * 25.4;
-                    }
-                  else
-                    {
-                      drillX = all_drills[r].x;
-                      drillY = all_drills[r].y;
-                    }
-                  if (gcode_advanced)
-                    pcb_fprintf (gcode_f, "G81 X%`f Y%`f Z%s R%s\n",
-                                 drillX, drillY, variable_cutdepth,
-                                 variable_safeZ);
-                  else
-                    {
-                      pcb_fprintf (gcode_f, "G0 X%`f Y%`f\n", drillX, drillY);
-                      pcb_fprintf (gcode_f, "G1 Z%s\n", variable_cutdepth);
-                      pcb_fprintf (gcode_f, "G0 Z%s\n", variable_safeZ);
-                    }
-                }
-              fprintf (gcode_f, "(%d predrills)\n", n_all_drills);
-              free(all_drills);
-            }
-          if (metric)
-            pcb_fprintf (gcode_f, "(milling distance %`.2fmm = %`.2fin)\n", d,
-                         d * 1 / 25.4);
-          else
-            pcb_fprintf (gcode_f, "(milling distance %`.2fmm = %`.2fin)\n",
-                         25.4 * d, d);
-          if (gcode_advanced)
-            fprintf (gcode_f, "M5 M9 M2\n");
+          job = (struct gcode_trace_job *) calloc (1, sizeof (*job));
+          job->bm = bm;
+          job->f = gcode_f;
+          if (gcode_predrill && save_drill)
+            job->predrills = gcode_predrills (metric, &job->n_predrills);
+          if (pool)
+            g_thread_pool_push (pool, job, NULL);
           else
-            fprintf (gcode_f, "M5\nM9\nM2\n");
-          pathlist_free (plist);
-          bm_free (bm);
-          fclose (gcode_f);
+            gcode_trace_layer (job, &vars);
           gcode_f = NULL;
           if (save_drill)
             {
@@ -982,7 +1126,7 @@ gcode_do_export (HID_Attr_Val * options)
                     gcode_f = gcode_start_gcode(layername, metric);
                   }
                   if (!gcode_f)
-                    return;
+                    goto done;
                   fprintf (gcode_f, "(Drill file: %d drills)\n", drill->n_holes);
                   if (metric)
                     pcb_fprintf (gcode_f, "(Drill diameter: %`f mm)\n",
@@ -1096,7 +1240,7 @@ gcode_do_export (HID_Attr_Val * options)
 
                     gcode_f = gcode_start_gcode("drillmill", metric);
                     if (!gcode_f)
-                      return;
+                      goto done;
                     fprintf (gcode_f, "(Drillmill file)\n");
                     pcb_fprintf (gcode_f, "(Tool diameter: %`f %s)\n",
                                  gcode_milltoolradius * 2,
@@ -1217,7 +1361,7 @@ gcode_do_export (HID_Attr_Val * options)
 
       gcode_f = gcode_start_gcode("outline", metric);
       if (!gcode_f)
-        return;
+        goto done;
       fprintf (gcode_f, "(Outline mill file)\n");
       pcb_fprintf (gcode_f, "(Tool diameter: %`f %s)\n",
                      gcode_milltoolradius * 2, metric ? "mm" : "inch");
@@ -1286,6 +1430,11 @@ gcode_do_export (HID_Attr_Val * options)
                    mill_distance * 25.4, mill_distance);
       fclose (gcode_f);
     }
+
+done:
+  /* wait for the layers still being traced */
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
 }
 
 /* *** PNG export (slightly modified code from PNG export HID) ************* */
@@ -1355,7 +1504,7 @@ gcode_use_mask (enum mask_mode mode)
 static void
 gcode_set_color (hidGC gc, const char *name)
 {
-  if (gcode_im == NULL)
+  if (gcode_im == NULL && gcode_raster.bm == NULL)
     {
       return;
     }
@@ -1492,9 +1641,40 @@ use_gc (hidGC gc)
     }
 }
 
+/*!
+ * \brief Half the width of what the tool mills for a line of gc, in
+ * pixels of the direct bitmap.
+ *
+ * As with the brushes of the gd image, a line is never thinner than a
+ * pixel.
+ */
+static double
+raster_half_width (hidGC gc)
+{
+  return MAX (pcb_to_pixel (gc->width / 2 + gcode_toolradius), 0.5);
+}
+
 static void
 gcode_draw_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 {
+  if (gcode_raster.bm)
+    {
+      double h = raster_half_width (gc);
+      double X1 = pcb_to_pixel (x1 - gcode_toolradius);
+      double Y1 = pcb_to_pixel (y1 - gcode_toolradius);
+      double X2 = pcb_to_pixel (x2 + gcode_toolradius);
+      double Y2 = pcb_to_pixel (y2 + gcode_toolradius);
+
+      raster_fill_rect (&gcode_raster, X1 - h, Y1 - h, X2 + h, Y1 + h,
+                        !gc->erase);
+      raster_fill_rect (&gcode_raster, X1 - h, Y2 - h, X2 + h, Y2 + h,
+                        !gc->erase);
+      raster_fill_rect (&gcode_raster, X1 - h, Y1 - h, X1 + h, Y2 + h,
+                        !gc->erase);
+      raster_fill_rect (&gcode_raster, X2 - h, Y1 - h, X2 + h, Y2 + h,
+                        !gc->erase);
+      return;
+    }
   use_gc (gc);
   gdImageRectangle (gcode_im,
                     pcb_to_gcode (x1 - gcode_toolradius),
@@ -1508,6 +1688,16 @@ gcode_draw_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 static void
 gcode_fill_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 {
+  if (gcode_raster.bm)
+    {
+      raster_fill_rect (&gcode_raster,
+                        pcb_to_pixel (x1 - gcode_toolradius),
+                        pcb_to_pixel (y1 - gcode_toolradius),
+                        pcb_to_pixel (x2 + gcode_toolradius),
+                        pcb_to_pixel (y2 + gcode_toolradius),
+                        !gc->erase);
+      return;
+    }
   use_gc (gc);
   gdImageSetThickness (gcode_im, 0);
   linewidth = 0;
@@ -1531,6 +1721,15 @@ gcode_draw_line (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
                        x1 + w, y1 + w);
       return;
     }
+  if (gcode_raster.bm)
+    {
+      raster_fill_line (&gcode_raster,
+                        pcb_to_pixel (x1), pcb_to_pixel (y1),
+                        pcb_to_pixel (x2), pcb_to_pixel (y2),
+                        raster_half_width (gc), gc->cap == Square_Cap,
+                        !gc->erase);
+      return;
+    }
   use_gc (gc);
 
   gdImageSetThickness (gcode_im, 0);
@@ -1580,6 +1779,15 @@ gcode_draw_arc (hidGC gc, Coord cx, Coord cy, Coord width, Coord height,
           im, SCALE_X (cx), SCALE_Y (cy),
           SCALE (width), SCALE (height), sa, ea, gc->color->c);
 #endif
+  if (gcode_raster.bm)
+    {
+      raster_fill_arc (&gcode_raster, pcb_to_pixel (cx), pcb_to_pixel (cy),
+                       pcb_to_pixel (2 * width + gcode_toolradius * 2) / 2,
+                       pcb_to_pixel (2 * height + gcode_toolradius * 2) / 2,
+                       sa, ea, raster_half_width (gc),
+                       gc->cap == Square_Cap, !gc->erase);
+      return;
+    }
   use_gc (gc);
   gdImageSetThickness (gcode_im, 0);
   linewidth = 0;
@@ -1676,16 +1884,23 @@ add_hole (struct single_size_drills* drill,
 static void
 gcode_fill_circle (hidGC gc, Coord cx, Coord cy, Coord radius)
 {
-  use_gc (gc);
-
-  gdImageSetThickness (gcode_im, 0);
-  linewidth = 0;
-  gdImageFilledEllipse (gcode_im,
-                        pcb_to_gcode (cx),
-                        pcb_to_gcode (cy),
-                        pcb_to_gcode (2 * radius + gcode_toolradius * 2),
-                        pcb_to_gcode (2 * radius + gcode_toolradius * 2),
-                        gc->color->c);
+  if (gcode_raster.bm)
+    raster_fill_circle (&gcode_raster, pcb_to_pixel (cx), pcb_to_pixel (cy),
+                        pcb_to_pixel (radius + gcode_toolradius),
+                        !gc->erase);
+  else
+    {
+      use_gc (gc);
+
+      gdImageSetThickness (gcode_im, 0);
+      linewidth = 0;
+      gdImageFilledEllipse (gcode_im,
+                            pcb_to_gcode (cx),
+                            pcb_to_gcode (cy),
+                            pcb_to_gcode (2 * radius + gcode_toolradius * 2),
+                            pcb_to_gcode (2 * radius + gcode_toolradius * 2),
+                            gc->color->c);
+    }
   if (save_drill && is_drill)
     {
       double diameter_inches = COORD_TO_INCH(radius*2);
@@ -1705,6 +1920,26 @@ gcode_fill_polygon (hidGC gc, int n_coords, Coord *x, Coord *y)
   int i;
   gdPoint *points;
 
+  if (gcode_raster.bm)
+    {
+      int *px = (int *) malloc (2 * n_coords * sizeof (int));
+      int *py = px + n_coords;
+
+      if (px == NULL)
+        {
+          fprintf (stderr, "ERROR:  gcode_fill_polygon():  malloc failed\n");
+          exit (1);
+        }
+      for (i = 0; i < n_coords; i++)
+        {
+          px[i] = pcb_to_gcode (x[i]);
+          py[i] = pcb_to_gcode (y[i]);
+        }
+      raster_fill_polygon (&gcode_raster, n_coords, px, py,
+                           pcb_to_gcode (2 * gcode_toolradius), !gc->erase);
+      free (px);
+      return;
+    }
   points = (gdPoint *) malloc (n_coords * sizeof (gdPoint));
   if (points == NULL)
     {
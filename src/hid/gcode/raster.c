@@ -0,0 +1,405 @@
+/*!
+ * \file src/hid/gcode/raster.c
+ *
+ * \brief Drawing straight into a potrace bitmap.
+ *
+ * Every shape is filled a row at a time: the span of a row inside the
+ * shape is worked out and then set a word of the bitmap at a time.  Pads,
+ * pins and lines are all convex, so their spans are found directly, only
+ * polygons need their edges crossed.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "bitmap.h"
+#include "raster.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#ifndef MIN
+#define MIN(a,b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#endif
+
+/*!
+ * \brief Largest distance, in pixels, of an arc from the chords it is
+ * drawn with.
+ */
+#define ARC_TOLERANCE 0.25
+
+/*!
+ * \brief Set or clear the pixels x1 to x2 of row y.
+ */
+static void
+raster_span (raster_t *r, int y, int x1, int x2, int set)
+{
+  potrace_bitmap_t *bm = r->bm;
+  potrace_word *line, m1, m2;
+  int i, i1, i2, t;
+
+  if (y < 0 || y >= bm->h)
+    return;
+  if (x1 < 0)
+    x1 = 0;
+  if (x2 > bm->w - 1)
+    x2 = bm->w - 1;
+  if (x1 > x2)
+    return;
+  if (r->flip)
+    {
+      t = x1;
+      x1 = bm->w - 1 - x2;
+      x2 = bm->w - 1 - t;
+    }
+
+  line = bm_scanline (bm, bm->h - 1 - y);
+  i1 = x1 / BM_WORDBITS;
+  i2 = x2 / BM_WORDBITS;
+  m1 = BM_ALLBITS >> (x1 & (BM_WORDBITS - 1));
+  m2 = BM_ALLBITS << (BM_WORDBITS - 1 - (x2 & (BM_WORDBITS - 1)));
+  if (i1 == i2)
+    m1 = m2 = m1 & m2;
+  if (set)
+    {
+      line[i1] |= m1;
+      for (i = i1 + 1; i < i2; i++)
+        line[i] = BM_ALLBITS;
+      line[i2] |= m2;
+    }
+  else
+    {
+      line[i1] &= ~m1;
+      for (i = i1 + 1; i < i2; i++)
+        line[i] = 0;
+      line[i2] &= ~m2;
+    }
+}
+
+/*!
+ * \brief Set or clear the pixels of row y whose centres lie from xa to
+ * xb.
+ */
+static void
+raster_span_d (raster_t *r, int y, double xa, double xb, int set)
+{
+  double a = ceil (xa), b = floor (xb);
+
+  if (a > b || b < 0 || a > r->bm->w - 1)
+    return;
+  raster_span (r, y, (int) MAX (a, -1), (int) MIN (b, r->bm->w), set);
+}
+
+/*!
+ * \brief The rows whose centres lie from ya to yb, clipped to the bitmap.
+ */
+static void
+raster_rows (raster_t *r, double ya, double yb, int *y1, int *y2)
+{
+  *y1 = (int) MAX (ceil (ya), 0);
+  *y2 = (int) MIN (floor (yb), r->bm->h - 1);
+}
+
+void
+raster_fill_rect (raster_t *r, double x1, double y1,
+                  double x2, double y2, int set)
+{
+  int y, ya, yb;
+
+  raster_rows (r, MIN (y1, y2), MAX (y1, y2), &ya, &yb);
+  for (y = ya; y <= yb; y++)
+    raster_span_d (r, y, MIN (x1, x2), MAX (x1, x2), set);
+}
+
+void
+raster_fill_circle (raster_t *r, double cx, double cy,
+                    double radius, int set)
+{
+  double dy, dx;
+  int y, ya, yb;
+
+  raster_rows (r, cy - radius, cy + radius, &ya, &yb);
+  for (y = ya; y <= yb; y++)
+    {
+      dy = y - cy;
+      dx = sqrt (MAX (radius * radius - dy * dy, 0));
+      raster_span_d (r, y, cx - dx, cx + dx, set);
+    }
+}
+
+/*!
+ * \brief Narrow [*lo, *hi] to the x for which a * x + b lies from min to
+ * max.
+ *
+ * \return false if no x is left.
+ */
+static bool
+clip_linear (double a, double b, double min, double max,
+             double *lo, double *hi)
+{
+  double xa, xb;
+
+  if (a == 0)
+    return b >= min && b <= max;
+  xa = (min - b) / a;
+  xb = (max - b) / a;
+  if (xa > xb)
+    {
+      double t = xa;
+
+      xa = xb;
+      xb = t;
+    }
+  *lo = MAX (*lo, xa);
+  *hi = MIN (*hi, xb);
+  return *lo <= *hi;
+}
+
+/*!
+ * \brief Fill the span of row y covered by a line with round ends.
+ *
+ * The row meets the discs at both ends and the band between them in
+ * three intervals that overlap, so the span runs from the least to the
+ * greatest of them.
+ */
+static void
+round_line_span (raster_t *r, int y, double x1, double y1,
+                 double ux, double uy, double len, double half, int set)
+{
+  double lo = HUGE_VAL, hi = -HUGE_VAL;
+  double blo = -HUGE_VAL, bhi = HUGE_VAL;
+  double d[2] = {y - y1, y - (y1 + uy * len)};
+  double c[2] = {x1, x1 + ux * len};
+  double dx;
+  int i;
+
+  for (i = 0; i < 2; i++)
+    if (fabs (d[i]) <= half)
+      {
+        dx = sqrt (half * half - d[i] * d[i]);
+        lo = MIN (lo, c[i] - dx);
+        hi = MAX (hi, c[i] + dx);
+      }
+  /* along the line: 0 <= (p - p1) . u <= len, across: |(p - p1) . n| <= half */
+  if (len > 0
+      && clip_linear (ux, (y - y1) * uy - x1 * ux, 0, len, &blo, &bhi)
+      && clip_linear (-uy, (y - y1) * ux + x1 * uy, -half, half, &blo, &bhi))
+    {
+      lo = MIN (lo, blo);
+      hi = MAX (hi, bhi);
+    }
+  if (lo <= hi)
+    raster_span_d (r, y, lo, hi, set);
+}
+
+/*!
+ * \brief Fill the span of row y covered by a square swept along a line.
+ *
+ * The row is in the square over a range of positions along the line,
+ * and the span is the x range over those positions, widened by half.
+ */
+static void
+square_line_span (raster_t *r, int y, double x1, double y1,
+                  double dx, double dy, double half, int set)
+{
+  double t0 = 0, t1 = 1, ta, tb;
+
+  if (dy == 0)
+    {
+      if (fabs (y - y1) > half)
+        return;
+    }
+  else
+    {
+      ta = (y - y1 - half) / dy;
+      tb = (y - y1 + half) / dy;
+      t0 = MAX (t0, MIN (ta, tb));
+      t1 = MIN (t1, MAX (ta, tb));
+      if (t0 > t1)
+        return;
+    }
+  raster_span_d (r, y, x1 + MIN (dx * t0, dx * t1) - half,
+                 x1 + MAX (dx * t0, dx * t1) + half, set);
+}
+
+/*!
+ * \brief Fill the shape a disc, or a square when square is set, of half
+ * width half covers when moved from (x1, y1) to (x2, y2).
+ */
+void
+raster_fill_line (raster_t *r, double x1, double y1,
+                  double x2, double y2, double half, int square,
+                  int set)
+{
+  double dx = x2 - x1, dy = y2 - y1, len = hypot (dx, dy);
+  int y, ya, yb;
+
+  raster_rows (r, MIN (y1, y2) - half, MAX (y1, y2) + half, &ya, &yb);
+  for (y = ya; y <= yb; y++)
+    if (square)
+      square_line_span (r, y, x1, y1, dx, dy, half, set);
+    else if (len > 0)
+      round_line_span (r, y, x1, y1, dx / len, dy / len, len, half, set);
+    else
+      round_line_span (r, y, x1, y1, 1, 0, 0, half, set);
+}
+
+/*!
+ * \brief Fill the shape a disc or square of half width half covers when
+ * moved along an elliptic arc.
+ *
+ * The angles are in degrees, 0 pointing to +x and 90 to +y, and the arc
+ * runs from start up to end.  Equal angles draw the whole ellipse.  The
+ * arc is drawn as chords that stay within ARC_TOLERANCE of it.
+ */
+void
+raster_fill_arc (raster_t *r, double cx, double cy,
+                 double rx, double ry, double start, double end,
+                 double half, int square, int set)
+{
+  double radius = MAX (rx, ry), step, a, x, y, px, py;
+  int i, n;
+
+  if (end == start)
+    end = start + 360;
+  while (end < start)
+    end += 360;
+  if (radius > ARC_TOLERANCE)
+    step = 2 * acos (1 - ARC_TOLERANCE / radius) * 180 / M_PI;
+  else
+    step = 360;
+  n = MAX (1, (int) ceil ((end - start) / step));
+
+  px = cx + rx * cos (start * M_PI / 180);
+  py = cy + ry * sin (start * M_PI / 180);
+  for (i = 1; i <= n; i++)
+    {
+      a = (start + (end - start) * i / n) * M_PI / 180;
+      x = cx + rx * cos (a);
+      y = cy + ry * sin (a);
+      raster_fill_line (r, px, py, x, y, half, square, set);
+      px = x;
+      py = y;
+    }
+}
+
+static int
+cmp_int (const void *a, const void *b)
+{
+  return *(const int *) a - *(const int *) b;
+}
+
+/*!
+ * \brief Draw the pixels x1 to x2 of row y as a line thick pixels wide,
+ * the way gdImageLine draws a horizontal line.
+ */
+static void
+raster_thick_span (raster_t *r, int y, int x1, int x2, int thick, int set)
+{
+  int half = thick / 2, row;
+
+  if (thick <= 1)
+    raster_span (r, y, x1, x2, set);
+  else if (x1 == x2)
+    raster_span (r, y, x1 - half, x1 + thick - half - 1, set);
+  else
+    for (row = y - half; row <= y + thick - half - 1; row++)
+      raster_span (r, row, x1, x2, set);
+}
+
+/*!
+ * \brief Fill a polygon with whole pixel vertices, the way
+ * gdImageFilledPolygon does with a line thickness of thick.
+ *
+ * gd draws every span of the polygon as a line of that thickness, which
+ * grows the polygon vertically.  The G-code exporter relies on this to
+ * widen its pours by the tool radius, so the direct bitmap follows the
+ * same rules to trace the same paths.
+ */
+void
+raster_fill_polygon (raster_t *r, int n, const int *x, const int *y,
+                     int thick, int set)
+{
+  int miny, maxy, minx, maxx, *cross;
+  int i, j, k, row, x1, x2, y1, y2;
+
+  if (n < 1)
+    return;
+  miny = maxy = y[0];
+  minx = maxx = x[0];
+  for (i = 1; i < n; i++)
+    {
+      miny = MIN (miny, y[i]);
+      maxy = MAX (maxy, y[i]);
+      minx = MIN (minx, x[i]);
+      maxx = MAX (maxx, x[i]);
+    }
+  if (miny == maxy)
+    {
+      raster_thick_span (r, miny, minx, maxx, thick, set);
+      return;
+    }
+  cross = (int *) malloc (n * sizeof (int));
+  if (cross == NULL)
+    return;
+
+  for (row = miny; row <= maxy; row++)
+    {
+      k = 0;
+      for (i = 0; i < n; i++)
+        {
+          j = i ? i - 1 : n - 1;
+          if (y[j] < y[i])
+            {
+              x1 = x[j]; y1 = y[j];
+              x2 = x[i]; y2 = y[i];
+            }
+          else if (y[j] > y[i])
+            {
+              x1 = x[i]; y1 = y[i];
+              x2 = x[j]; y2 = y[j];
+            }
+          else
+            continue;
+          if (row >= y1 && row < y2)
+            cross[k++] = (int) ((float) ((row - y1) * (x2 - x1))
+                                / (float) (y2 - y1) + 0.5 + x1);
+          else if (row == maxy && row == y2)
+            cross[k++] = x2;
+        }
+      qsort (cross, k, sizeof (int), cmp_int);
+      for (i = 0; i + 1 < k; i += 2)
+        raster_thick_span (r, row, cross[i], cross[i + 1], thick, set);
+    }
+  free (cross);
+}
@@ -0,0 +1,62 @@
+/*!
+ * \file src/hid/gcode/raster.h
+ *
+ * \brief Drawing straight into a potrace bitmap.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef PCB_HID_GCODE_RASTER_H
+#define PCB_HID_GCODE_RASTER_H
+
+#include "potracelib.h"
+
+/*!
+ * \brief A bitmap to draw into.
+ *
+ * Coordinates are in pixels, with y going down as in the board, and a
+ * pixel is drawn when its centre is inside the shape, except that
+ * polygons are filled the way gd fills them.  The rows are
+ * stored bottom up, the way potrace reads them, and the columns are
+ * mirrored when flip is set.
+ */
+typedef struct
+{
+  potrace_bitmap_t *bm;
+  int flip; /*!< Mirror the columns, for the bottom side. */
+} raster_t;
+
+void raster_fill_rect (raster_t *r, double x1, double y1,
+                       double x2, double y2, int set);
+void raster_fill_circle (raster_t *r, double cx, double cy,
+                         double radius, int set);
+void raster_fill_line (raster_t *r, double x1, double y1,
+                       double x2, double y2, double half, int square,
+                       int set);
+void raster_fill_arc (raster_t *r, double cx, double cy,
+                      double rx, double ry, double start, double end,
+                      double half, int square, int set);
+void raster_fill_polygon (raster_t *r, int n, const int *x, const int *y,
+                          int thick, int set);
+
+#endif
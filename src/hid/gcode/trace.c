@@ -31,6 +31,7 @@
 #include "lists.h"
 #include "auxiliary.h"
 #include "trace.h"
+#include "hid/common/tour.h"
 #include "pcb-printf.h"
 //#include "progress.h"
 
@@ -1517,6 +1518,9 @@ plotpolygon (privpath_t * pp, FILE * f, double scale,
 /*!
  * \brief Process path.
  *
+ * The polygons of all paths are found first, and then plotted in the
+ * order tour_order() gives their start points, from (0,0).
+ *
  * \return distance on success, -1 on error with errno set.
  */
 double
@@ -1526,8 +1530,11 @@ process_path (path_t * plist, const potrace_param_t * param,
 	      const char *var_plunge, const char *var_feedrate)
 {
   path_t *p;
+  path_t **paths = NULL;
+  double *x = NULL, *y = NULL;
+  int *order = NULL;
   double dm = 0;
-  int n = 0;
+  int n = 0, i;
   /* call downstream function with each path */
   list_forall (p, plist)
   {
@@ -1535,9 +1542,7 @@ process_path (path_t * plist, const potrace_param_t * param,
     TRY (calc_lon (p->priv));
     TRY (bestpolygon (p->priv));
     TRY (adjust_vertices (p->priv));
-    fprintf (f, "(polygon %d)\n", ++n);
-    dm += plotpolygon (p->priv, f, scale, var_cutdepth, var_safeZ, var_plunge,
-                       var_feedrate);
+    n++;
 /*  No need to extract curves
 	TRY(smooth(&p->priv->curve, p->sign, param->alphamax));
     if (param->opticurve) {
@@ -1548,9 +1553,43 @@ process_path (path_t * plist, const potrace_param_t * param,
     }
     privcurve_to_curve(p->priv->fcurve, &p->curve);*/
   }
+
+  if (n == 0)
+    return 0;
+  SAFE_MALLOC (paths, n, path_t *);
+  SAFE_MALLOC (x, n, double);
+  SAFE_MALLOC (y, n, double);
+  SAFE_MALLOC (order, n, int);
+  i = 0;
+  list_forall (p, plist)
+  {
+    privpath_t *pp = p->priv;
+
+    paths[i] = p;
+    x[i] = pp->m ? pp->pt[pp->po[0]].x : 0;
+    y[i] = pp->m ? pp->pt[pp->po[0]].y : 0;
+    i++;
+  }
+  tour_order (x, y, n, 0, 0, order);
+
+  for (i = 0; i < n; i++)
+    {
+      fprintf (f, "(polygon %d)\n", i + 1);
+      dm += plotpolygon (paths[order[i]]->priv, f, scale, var_cutdepth,
+			 var_safeZ, var_plunge, var_feedrate);
+    }
 /*      fprintf(f,"(end, total distance %.2fmm = %.2fin)\n",25.4*dm,dm); */
+  free (paths);
+  free (x);
+  free (y);
+  free (order);
   return dm;
 
+malloc_error:
 try_error:
+  free (paths);
+  free (x);
+  free (y);
+  free (order);
   return -1;
 }
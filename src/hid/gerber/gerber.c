@@ -24,14 +24,18 @@
 #include "misc.h"
 #include "error.h"
 #include "draw.h"
+#include "job.h"
 #include "pcb-printf.h"
+#include "polyarea.h"
 
 #include "hid.h"
 #include "hid_draw.h"
 #include "../hidint.h"
 #include "hid/common/hidnogui.h"
 #include "hid/common/draw_helpers.h"
+#include "hid/common/drawlist.h"
 #include "hid/common/hidinit.h"
+#include "hid/common/tour.h"
 
 #ifdef HAVE_LIBDMALLOC
 #include <dmalloc.h>
@@ -62,6 +66,7 @@ static void gerber_fill_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2);
 static void gerber_calibrate (double xval, double yval);
 static void gerber_set_crosshair (int x, int y, int action);
 static void gerber_fill_polygon (hidGC gc, int n_coords, Coord *x, Coord *y);
+static void gerber_fill_pcb_polygon (hidGC gc, PolygonType *poly, const BoxType *clip_box);
 
 /*----------------------------------------------------------------------------*/
 /* Utility routines                                                           */
@@ -84,20 +89,47 @@ static void gerber_fill_polygon (hidGC gc, int n_coords, Coord *x, Coord *y);
 static int verbose;
 static int all_layers;
 static int metric;
-static char *x_convspec, *y_convspec;
+static const Unit *coord_unit;	/* the unit of the coordinates */
 static int is_mask, was_drill;
 static int is_drill;
 static enum mask_mode current_mask;
 static int flash_drills;
+static int optimize_drills;
 static int copy_outline_mode;
 static int name_style;
+static int polygon_regions;
+/* the copies of the board in a panel, and the steps between them */
+static int panel_columns, panel_rows;
+static Coord panel_step_x, panel_step_y;
 static LayerType *outline_layer;
 
 #define print_xcoord(file, pcb, val)\
-	pcb_fprintf(file, x_convspec, gerberX(pcb, val))
+	print_coord(file, 'X', gerberX(pcb, val))
 
 #define print_ycoord(file, pcb, val)\
-	pcb_fprintf(file, y_convspec, gerberY(pcb, val))
+	print_coord(file, 'Y', gerberY(pcb, val))
+
+/* Size of the buffer of an output file.  */
+#define GERBER_BUFFER_SIZE (256 * 1024)
+
+/* Write an X or Y word.  This is what pcb_fprintf makes of "X%.0mc"
+   or "X%.0mu", without going through a format string for each of
+   the many coordinates of a file.  */
+static void
+print_coord (FILE *file, char axis, Coord val)
+{
+  char buf[32], *p = buf + sizeof buf;
+  double v = rint (coord_to_unit (coord_unit, val));
+  unsigned long long u = v < 0 ? -v : v;
+
+  do
+    *--p = '0' + u % 10;
+  while ((u /= 10) != 0);
+  if (v < 0)
+    *--p = '-';
+  *--p = axis;
+  fwrite (p, 1, buf + sizeof buf - p, file);
+}
 
 enum ApertureShape
 {
@@ -127,6 +159,7 @@ typedef struct
 {
   Aperture *data;
   int count;
+  GHashTable *table;		/* the apertures by width and shape */
 } ApertureList;
 
 static ApertureList *layer_aptr_list;
@@ -152,12 +185,30 @@ int n_pending_drills = 0, max_pending_drills = 0;
 /* Aperture Routines                                                          */
 /*----------------------------------------------------------------------------*/
 
+static guint
+aperture_hash (gconstpointer v)
+{
+  const Aperture *a = (const Aperture *) v;
+
+  return (guint) a->width * 8 + (guint) (a->width >> 29) + a->shape;
+}
+
+static gboolean
+aperture_equal (gconstpointer va, gconstpointer vb)
+{
+  const Aperture *a = (const Aperture *) va;
+  const Aperture *b = (const Aperture *) vb;
+
+  return a->width == b->width && a->shape == b->shape;
+}
+
 /* Initialize aperture list */
 static void
 initApertureList (ApertureList *list)
 {
   list->data = NULL;
   list->count = 0;
+  list->table = NULL;
 }
 
 static void
@@ -171,6 +222,8 @@ deinitApertureList (ApertureList *list)
       free(search);
       search = next;
     }
+  if (list->table)
+    g_hash_table_destroy (list->table);
   initApertureList (list);
 }
 
@@ -206,6 +259,10 @@ addAperture (ApertureList *list, Coord width, ApertureShape shape)
   list->data = app;
   ++list->count;
 
+  if (list->table == NULL)
+    list->table = g_hash_table_new (aperture_hash, aperture_equal);
+  g_hash_table_insert (list->table, app, app);
+
   return app;
 }
 
@@ -214,16 +271,18 @@ addAperture (ApertureList *list, Coord width, ApertureShape shape)
 static Aperture *
 findAperture (ApertureList *list, Coord width, ApertureShape shape)
 {
-  Aperture *search;
+  Aperture key, *search;
 
   /* we never draw zero-width lines */
   if (width == 0)
     return NULL;
 
   /* Search for an appropriate aperture. */
-  for (search = list->data; search; search = search->next)
-    if (search->width == width && search->shape == shape)
-      return search;
+  key.width = width;
+  key.shape = shape;
+  if (list->table
+      && (search = (Aperture *) g_hash_table_lookup (list->table, &key)))
+    return search;
 
   /* Failing that, create a new one */
   return addAperture (list, width, shape);
@@ -309,6 +368,8 @@ static char *layername = NULL;
 static int lncount = 0;
 
 static int finding_apertures = 0;
+/* the board drawn once, for the pass finding the apertures and the files */
+static DrawList *board_drawing = NULL;
 static int pagecount = 0;
 static int linewidth = -1;
 static int lastgroup = -1;
@@ -317,6 +378,17 @@ static int print_group[MAX_GROUP];
 static int print_layer[MAX_ALL_LAYER];
 static int lastX, lastY;	/* the last X and Y coordinate */
 
+/* The D01 of the last line drawn is held back so that a line going on
+   in the same direction can make it longer instead of adding one.  */
+static int line_pending = 0;
+static Coord lineStartX, lineStartY, lineEndX, lineEndY;
+
+/* With --jobs, the files are shared out among processes: this one
+   writes the files whose page number modulo jobs is share.  */
+static int jobs = 1;
+static int share = 0;
+static int skip_group = 0;	/* the current group goes to another job */
+
 static const char *copy_outline_names[] = {
 #define COPY_OUTLINE_NONE 0
   "none",
@@ -416,6 +488,81 @@ Parameter @code{<string>} can be @samp{fixed}, @samp{single},
   {"name-style", "Naming style for individual gerber files",
    HID_Enum, 0, 0, {0, 0, 0}, name_style_names, 0},
 #define HA_name_style 5
+
+/* %start-doc options "90 Gerber Export"
+@ftable @code
+@item --jobs <int>
+Number of processes writing the files at the same time.
+The files are shared out among the processes, each of which draws only
+the layer groups of its own files.
+@end ftable
+%end-doc
+*/
+  {"jobs", "Number of processes writing the files at the same time",
+   HID_Integer, 1, 64, {1, 0, 0}, 0, 0},
+#define HA_jobs 6
+
+/* %start-doc options "90 Gerber Export"
+@ftable @code
+@item --polygon-regions
+Write each piece of a polygon as one region, its holes joined to the
+outline by cut-ins, instead of cutting it into pieces without holes.
+The files of plane layers get much smaller.
+@end ftable
+%end-doc
+*/
+  {"polygon-regions", "Write polygons as regions with cut-in holes",
+   HID_Boolean, 0, 0, {0, 0, 0}, 0, 0},
+#define HA_polygon_regions 7
+
+/* %start-doc options "90 Gerber Export"
+@ftable @code
+@item --optimize-drills
+Drill the holes of each tool of the drill files in an order that keeps
+the moves between them short, each tool starting where the last one
+ended, instead of sorted by position.  The travel of the drill head is
+printed for both orders.
+@end ftable
+%end-doc
+*/
+  {"optimize-drills", "Order the holes of each drill for a short path",
+   HID_Boolean, 0, 0, {0, 0, 0}, 0, 0},
+#define HA_optimize_drills 8
+
+/* %start-doc options "90 Gerber Export"
+@ftable @code
+@item --panel-columns <int>
+Number of copies of the board side by side in a panel.  The board is
+written once to each Gerber file, with a step and repeat to make the
+copies, and the holes of the drill files are repeated for each copy.
+@end ftable
+%end-doc
+*/
+  {"panel-columns", "Copies of the board side by side in a panel",
+   HID_Integer, 1, 100, {1, 0, 0}, 0, 0},
+#define HA_panel_columns 9
+
+/* %start-doc options "90 Gerber Export"
+@ftable @code
+@item --panel-rows <int>
+Number of rows of copies of the board in a panel.
+@end ftable
+%end-doc
+*/
+  {"panel-rows", "Rows of copies of the board in a panel",
+   HID_Integer, 1, 100, {1, 0, 0}, 0, 0},
+#define HA_panel_rows 10
+
+/* %start-doc options "90 Gerber Export"
+@ftable @code
+@item --panel-spacing <measure>
+Gap between the copies of the board in a panel.
+@end ftable
+%end-doc
+*/
+  {"panel-spacing", "Gap between the copies of the board in a panel",
+   HID_Coord, 0, 0, {0, 0, 0, 0}, 0, 0},
+#define HA_panel_spacing 11
 };
 
 #define NUM_OPTIONS (sizeof(gerber_options)/sizeof(gerber_options[0]))
@@ -447,15 +594,40 @@ layer_stack_sort (const void *va, const void *vb)
   return b_layer - a_layer;
 }
 
+/* Write the D01 held back for the last line.  */
+static void
+flush_line (void)
+{
+  if (!line_pending)
+    return;
+  line_pending = 0;
+  if (lineEndX != lastX)
+    {
+      lastX = lineEndX;
+      print_xcoord (f, PCB, lastX);
+    }
+  if (lineEndY != lastY)
+    {
+      lastY = lineEndY;
+      print_ycoord (f, PCB, lastY);
+    }
+  fprintf (f, "D01*\r\n");
+}
+
 static void
 maybe_close_f (FILE *f)
 {
+  flush_line ();
   if (f)
     {
       if (was_drill)
 	fprintf (f, "M30\r\n");
       else
-	fprintf (f, "M02*\r\n");
+	{
+	  if (panel_columns > 1 || panel_rows > 1)
+	    fprintf (f, "%%SR*%%\r\n");
+	  fprintf (f, "M02*\r\n");
+	}
       fclose (f);
     }
 }
@@ -669,6 +841,58 @@ assign_file_suffix (char *dest, int idx, const char *layer_name)
   strcat (dest, sext);
 }
 
+/*!
+ * \brief Write the files of a share of the output.
+ *
+ * The apertures must have been found.
+ */
+static void
+gerber_write_share (int this_share)
+{
+  share = this_share;
+  skip_group = 0;
+  pagecount = 1;
+  linewidth = -1;
+  lastcap = -1;
+  lastgroup = -1;
+  is_drill = was_drill = 0;
+  line_pending = 0;
+  layer_list_idx = 0;
+  finding_apertures = 0;
+  drawlist_replay (board_drawing, &gerber_hid);
+
+  maybe_close_f (f);
+  f = NULL;
+}
+
+static int
+gerber_share_worker (int part, FILE *fp, void *data)
+{
+  gerber_write_share (part);
+  return 0;
+}
+
+static bool
+gerber_share_here (int part, FILE *fp, void *data)
+{
+  gerber_write_share (part);
+  return true;
+}
+
+/*!
+ * \brief Write the files, with the help of worker processes for --jobs.
+ *
+ * A worker writes its share of the files and exits.  Share 0, and the
+ * share of a worker that could not be started or failed, is written
+ * here.
+ */
+static void
+gerber_write_files (void)
+{
+  pcb_fork_workers (jobs, jobs - 1, 0, false, gerber_share_worker,
+		    gerber_share_here, NULL);
+}
+
 static void
 gerber_do_export (HID_Attr_Val * options)
 {
@@ -697,17 +921,18 @@ gerber_do_export (HID_Attr_Val * options)
 
   verbose = options[HA_verbose].int_value;
   metric = options[HA_metric].int_value;
-  if (metric) {
-	  x_convspec = "X%.0mu";
-	  y_convspec = "Y%.0mu";
-  } else {
-	  x_convspec = "X%.0mc";
-	  y_convspec = "Y%.0mc";
-  }
+  coord_unit = get_unit_struct (metric ? "um" : "cmil");
   all_layers = options[HA_all_layers].int_value;
 
   copy_outline_mode = options[HA_copy_outline].int_value;
   name_style = options[HA_name_style].int_value;
+  jobs = MAX (1, MIN (64, options[HA_jobs].int_value));
+  polygon_regions = options[HA_polygon_regions].int_value;
+  optimize_drills = options[HA_optimize_drills].int_value;
+  panel_columns = MAX (1, options[HA_panel_columns].int_value);
+  panel_rows = MAX (1, options[HA_panel_rows].int_value);
+  panel_step_x = PCB->MaxWidth + options[HA_panel_spacing].coord_value;
+  panel_step_y = PCB->MaxHeight + options[HA_panel_spacing].coord_value;
 
   outline_layer = NULL;
 
@@ -768,16 +993,17 @@ gerber_do_export (HID_Attr_Val * options)
   lastgroup = -1;
   layer_list_idx = 0;
   finding_apertures = 1;
-  hid_expose_callback (&gerber_hid, &region, 0);
+  share = 0;
+  skip_group = 0;
+  board_drawing = drawlist_record (&gerber_hid, &region);
+  drawlist_replay (board_drawing, &gerber_hid);
 
-  layer_list_idx = 0;
-  finding_apertures = 0;
-  hid_expose_callback (&gerber_hid, &region, 0);
+  gerber_write_files ();
+  drawlist_free (board_drawing);
+  board_drawing = NULL;
 
   memcpy (LayerStack, saved_layer_stack, sizeof (LayerStack));
 
-  maybe_close_f (f);
-  f = NULL;
   hid_restore_layer_ons (save_ons);
   PCB->Flags = save_thindraw;
 }
@@ -801,6 +1027,65 @@ drill_sort (const void *va, const void *vb)
   return a->y - b->y;
 }
 
+/*!
+ * \brief The length of the path of the drill head through the pending
+ * drills, from the origin.
+ */
+static double
+pending_drills_travel (void)
+{
+  double travel = 0;
+  Coord x = 0, y = 0;
+  int i;
+
+  for (i = 0; i < n_pending_drills; i++)
+    {
+      travel += hypot (pending_drills[i].x - x, pending_drills[i].y - y);
+      x = pending_drills[i].x;
+      y = pending_drills[i].y;
+    }
+  return travel;
+}
+
+/*!
+ * \brief Order the holes of each tool of the sorted pending drills for a
+ * short path, see tour_order(); each tool starts where the last ended.
+ */
+static void
+order_pending_drills (void)
+{
+  PendingDrills *run = (PendingDrills *) malloc (n_pending_drills *
+						 sizeof (PendingDrills));
+  double *x = (double *) malloc (n_pending_drills * sizeof (double));
+  double *y = (double *) malloc (n_pending_drills * sizeof (double));
+  int *order = (int *) malloc (n_pending_drills * sizeof (int));
+  double x0 = 0, y0 = 0, before = pending_drills_travel ();
+  int i, j, k;
+
+  for (i = 0; i < n_pending_drills; i = j)
+    {
+      for (j = i; j < n_pending_drills
+	   && pending_drills[j].diam == pending_drills[i].diam; j++)
+	{
+	  x[j - i] = pending_drills[j].x;
+	  y[j - i] = pending_drills[j].y;
+	}
+      tour_order (x, y, j - i, x0, y0, order);
+      for (k = 0; k < j - i; k++)
+	run[k] = pending_drills[i + order[k]];
+      memcpy (pending_drills + i, run, (j - i) * sizeof (PendingDrills));
+      x0 = pending_drills[j - 1].x;
+      y0 = pending_drills[j - 1].y;
+    }
+
+  pcb_printf ("%s: drill travel %.2$mS sorted, %.2$mS ordered\n",
+	      filename, (Coord) before, (Coord) pending_drills_travel ());
+  free (run);
+  free (x);
+  free (y);
+  free (order);
+}
+
 static int
 gerber_set_layer (const char *name, int group, int empty)
 {
@@ -820,6 +1105,10 @@ gerber_set_layer (const char *name, int group, int empty)
     return 0;
   if (SL_TYPE (idx) == SL_ASSY)
     return 0;
+  if (skip_group && group >= 0 && group == lastgroup)
+    return 0;
+
+  flush_line ();
 
   flash_drills = 0;
   if (strcmp (name, "outline") == 0 ||
@@ -828,20 +1117,29 @@ gerber_set_layer (const char *name, int group, int empty)
 
   if (is_drill && n_pending_drills)
     {
-      int i;
+      int i, j;
       /* dump pending drills in sequence */
       qsort (pending_drills, n_pending_drills, sizeof (pending_drills[0]),
 	     drill_sort);
-      for (i = 0; i < n_pending_drills; i++)
+      if (optimize_drills)
+	order_pending_drills ();
+      for (i = 0; i < n_pending_drills; i = j)
 	{
-	  if (i == 0 || pending_drills[i].diam != pending_drills[i - 1].diam)
-	    {
-	      Aperture *ap = findAperture (curr_aptr_list, pending_drills[i].diam, ROUND);
-	      fprintf (f, "T%02d\r\n", ap->dCode);
-	    }
-	  pcb_fprintf (f, metric ? "X%06.0muY%06.0mu\r\n" : "X%06.0mtY%06.0mt\r\n",
-		   gerberDrX (PCB, pending_drills[i].x),
-		   gerberDrY (PCB, pending_drills[i].y));
+	  Aperture *ap = findAperture (curr_aptr_list, pending_drills[i].diam, ROUND);
+	  int row, column, k;
+
+	  fprintf (f, "T%02d\r\n", ap->dCode);
+	  for (j = i; j < n_pending_drills
+	       && pending_drills[j].diam == pending_drills[i].diam; j++)
+	    ;
+	  /* Excellon has no step and repeat we can count on, so each copy
+	     in a panel gets the holes of the tool, in turn per row.  */
+	  for (row = 0; row < panel_rows; row++)
+	    for (column = 0; column < panel_columns; column++)
+	      for (k = i; k < j; k++)
+		pcb_fprintf (f, metric ? "X%06.0muY%06.0mu\r\n" : "X%06.0mtY%06.0mt\r\n",
+			     gerberDrX (PCB, pending_drills[k].x) + column * panel_step_x,
+			     gerberDrY (PCB, pending_drills[k].y) + row * panel_step_y);
 	}
       free (pending_drills);
       n_pending_drills = max_pending_drills = 0;
@@ -871,6 +1169,7 @@ gerber_set_layer (const char *name, int group, int empty)
       lastY = -1;
       linewidth = -1;
       lastcap = -1;
+      skip_group = 0;
 
       aptr_list = setLayerApertureList (layer_list_idx++);
 
@@ -884,6 +1183,11 @@ gerber_set_layer (const char *name, int group, int empty)
       f = NULL;
 
       pagecount++;
+      if (pagecount % jobs != share)
+	{
+	  skip_group = 1;
+	  return 0;
+	}
       assign_file_suffix (filesuff, idx, name);
       f = fopen (filename, "wb");   /* Binary needed to force CR-LF */
       if (f == NULL) 
@@ -891,6 +1195,7 @@ gerber_set_layer (const char *name, int group, int empty)
 	  Message ( "Error:  Could not open %s for writing.\n", filename);
 	  return 1;
 	}
+      setvbuf (f, NULL, _IOFBF, GERBER_BUFFER_SIZE);
 
       was_drill = is_drill;
 
@@ -971,6 +1276,12 @@ gerber_set_layer (const char *name, int group, int empty)
 	/* We need to put *something* in the file to make it be parsed
 	   as RS-274X instead of RS-274D. */
 	fprintf (f, "%%ADD11C,0.0100*%%\r\n");
+
+      /* The board is written once, and repeated for the panel.  */
+      if (panel_columns > 1 || panel_rows > 1)
+	pcb_fprintf (f, metric ? "%%SRX%dY%dI%.4`mmJ%.4`mm*%%\r\n"
+		     : "%%SRX%dY%dI%.5`miJ%.5`mi*%%\r\n",
+		     panel_columns, panel_rows, panel_step_x, panel_step_y);
     }
 
  emit_outline:
@@ -1093,7 +1404,10 @@ use_gc (hidGC gc, int radius)
 	  if (aptr == NULL)
 	    pcb_fprintf (stderr, "error: aperture for radius %$mS type ROUND is null\n", radius);
 	  else if (f && !is_drill)
-	    fprintf (f, "G54D%d*", aptr->dCode);
+	    {
+	      flush_line ();
+	      fprintf (f, "G54D%d*", aptr->dCode);
+	    }
 	  linewidth = radius;
 	  lastcap = Round_Cap;
 	}
@@ -1121,7 +1435,10 @@ use_gc (hidGC gc, int radius)
         pcb_fprintf (stderr, "error: aperture for width %$mS type %s is null\n",
                  linewidth, shape == ROUND ? "ROUND" : "SQUARE");
       else if (f)
-	fprintf (f, "G54D%d*", aptr->dCode);
+	{
+	  flush_line ();
+	  fprintf (f, "G54D%d*", aptr->dCode);
+	}
     }
 }
 
@@ -1165,6 +1482,23 @@ gerber_draw_line (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
   if (!f)
     return;
 
+  /* A line carrying on from the end of the last one in the same
+     direction, with the same aperture, just makes that one longer.  */
+  if (line_pending && x1 == lineEndX && y1 == lineEndY
+      && (x1 != x2 || y1 != y2))
+    {
+      long long dx1 = lineEndX - lineStartX, dy1 = lineEndY - lineStartY;
+      long long dx2 = x2 - x1, dy2 = y2 - y1;
+
+      if (dx1 * dy2 == dy1 * dx2 && dx1 * dx2 + dy1 * dy2 > 0)
+	{
+	  lineEndX = x2;
+	  lineEndY = y2;
+	  return;
+	}
+    }
+  flush_line ();
+
   if (x1 != lastX)
     {
       m = true;
@@ -1183,17 +1517,11 @@ gerber_draw_line (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
     {
       if (m)
 	fprintf (f, "D02*");
-      if (x2 != lastX)
-	{
-	  lastX = x2;
-	  print_xcoord (f, PCB, lastX);
-	}
-      if (y2 != lastY)
-	{
-	  lastY = y2;
-	  print_ycoord (f, PCB, lastY);
-	}
-      fprintf (f, "D01*\r\n");
+      line_pending = 1;
+      lineStartX = x1;
+      lineStartY = y1;
+      lineEndX = x2;
+      lineEndY = y2;
     }
 
 }
@@ -1212,6 +1540,7 @@ gerber_draw_arc (hidGC gc, Coord cx, Coord cy, Coord width, Coord height,
   use_gc (gc, 0);
   if (!f)
     return;
+  flush_line ();
 
   arcStartX = cx - width * cos (TO_RADIANS (start_angle));
   arcStartY = cy + height * sin (TO_RADIANS (start_angle));
@@ -1307,6 +1636,7 @@ gerber_fill_circle (hidGC gc, Coord cx, Coord cy, Coord radius)
     }
   else if (gc->drill && !flash_drills)
     return;
+  flush_line ();
   if (cx != lastX)
     {
       lastX = cx;
@@ -1334,6 +1664,7 @@ gerber_fill_polygon (hidGC gc, int n_coords, Coord *x, Coord *y)
   use_gc (gc, 10 * 100);
   if (!f)
     return;
+  flush_line ();
   fprintf (f, "G36*\r\n");
   for (i = 0; i < n_coords; i++)
     {
@@ -1378,6 +1709,127 @@ gerber_fill_polygon (hidGC gc, int n_coords, Coord *x, Coord *y)
   fprintf (f, "G37*\r\n");
 }
 
+/* Insert the points of a contour into xs and ys at index at, going
+   round from the point start back to it.  */
+static void
+insert_contour (GArray *xs, GArray *ys, guint at, VNODE *start)
+{
+  VNODE *v = start;
+
+  do
+    {
+      g_array_insert_vals (xs, at, &v->point[0], 1);
+      g_array_insert_vals (ys, at, &v->point[1], 1);
+      at++;
+    }
+  while ((v = v->next) != start);
+  g_array_insert_vals (xs, at, &start->point[0], 1);
+  g_array_insert_vals (ys, at, &start->point[1], 1);
+}
+
+/*!
+ * \brief Write a piece of a polygon as one region.
+ *
+ * The holes are taken from the right, each joined by a cut-in going
+ * right from its rightmost point to the nearest edge of the outline or
+ * of a hole already joined.  The holes still to join are all to the
+ * left of that point, so the cut-in crosses nothing.
+ */
+static void
+fill_polyarea_region (hidGC gc, POLYAREA *pa)
+{
+  GArray *xs = g_array_new (FALSE, FALSE, sizeof (Coord));
+  GArray *ys = g_array_new (FALSE, FALSE, sizeof (Coord));
+  GPtrArray *holes = g_ptr_array_new ();
+  PLINE *pl;
+  guint i;
+
+  insert_contour (xs, ys, 0, &pa->contours->head);
+  for (pl = pa->contours->next; pl != NULL; pl = pl->next)
+    g_ptr_array_add (holes, pl);
+
+  while (holes->len > 0)
+    {
+      PLINE *hole = NULL;
+      VNODE *v, *right = NULL;
+      Coord px = 0;
+      guint at = 0, h = 0;
+      bool hit = false;
+
+      /* the hole reaching furthest right, and its rightmost point */
+      for (i = 0; i < holes->len; i++)
+	{
+	  pl = (PLINE *) g_ptr_array_index (holes, i);
+	  if (hole == NULL || pl->xmax > hole->xmax)
+	    {
+	      hole = pl;
+	      h = i;
+	    }
+	}
+      g_ptr_array_remove_index_fast (holes, h);
+      v = &hole->head;
+      do
+	if (right == NULL || v->point[0] > right->point[0])
+	  right = v;
+      while ((v = v->next) != &hole->head);
+
+      /* the nearest edge to the right of it */
+      for (i = 0; i + 1 < xs->len; i++)
+	{
+	  Coord ax = g_array_index (xs, Coord, i);
+	  Coord ay = g_array_index (ys, Coord, i);
+	  Coord bx = g_array_index (xs, Coord, i + 1);
+	  Coord by = g_array_index (ys, Coord, i + 1);
+	  Coord x;
+
+	  if ((ay > right->point[1]) == (by > right->point[1]))
+	    continue;
+	  x = ax + (double) (right->point[1] - ay) * (bx - ax) / (by - ay);
+	  if (x >= right->point[0] && (!hit || x < px))
+	    {
+	      hit = true;
+	      px = x;
+	      at = i + 1;
+	    }
+	}
+      if (!hit)
+	continue;
+
+      /* the cut-in, round the hole from its rightmost point, and back */
+      g_array_insert_vals (xs, at, &px, 1);
+      g_array_insert_vals (ys, at, &right->point[1], 1);
+      insert_contour (xs, ys, at + 1, right);
+      at += hole->Count + 2;
+      g_array_insert_vals (xs, at, &px, 1);
+      g_array_insert_vals (ys, at, &right->point[1], 1);
+    }
+
+  gerber_fill_polygon (gc, xs->len, (Coord *) xs->data, (Coord *) ys->data);
+  g_ptr_array_free (holes, TRUE);
+  g_array_free (xs, TRUE);
+  g_array_free (ys, TRUE);
+}
+
+/*!
+ * \brief Draw a polygon, as regions with holes for --polygon-regions.
+ */
+static void
+gerber_fill_pcb_polygon (hidGC gc, PolygonType *poly, const BoxType *clip_box)
+{
+  POLYAREA *pa;
+
+  if (!polygon_regions)
+    {
+      common_fill_pcb_polygon (gc, poly, clip_box);
+      return;
+    }
+  if ((pa = poly->Clipped) == NULL)
+    return;
+  do
+    fill_polyarea_region (gc, pa);
+  while (TEST_FLAG (FULLPOLYFLAG, poly) && (pa = pa->f) != poly->Clipped);
+}
+
 static void
 gerber_fill_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 {
@@ -1442,5 +1894,8 @@ hid_gerber_init ()
   gerber_graphics.fill_polygon   = gerber_fill_polygon;
   gerber_graphics.fill_rect      = gerber_fill_rect;
 
+  gerber_graphics.draw_pcb_polygon = gerber_fill_pcb_polygon;
+  gerber_graphics.fill_pcb_polygon = gerber_fill_pcb_polygon;
+
   hid_register_hid (&gerber_hid);
 }
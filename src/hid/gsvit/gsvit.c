@@ -73,9 +73,11 @@
 #include "../hidint.h"
 #include "hid/common/hidnogui.h"
 #include "hid/common/draw_helpers.h"
+#include "hid/common/placement.h"
 
 #include <gd.h>
 #include "xmlout.h"
+#include "hid/common/rasterband.h"
 
 #include "hid/common/hidinit.h"
 #include "pcb-printf.h"
@@ -85,8 +87,6 @@
 #endif
 
 #define CRASH fprintf(stderr, "HID error: pcb called unimplemented PNG function %s.\n", __FUNCTION__); abort()
-#define MAXREFPINS 32 /* max length of following list */
-static char *reference_pin_names[] = {"1", "2", "A1", "A2", "B1", "B2", 0};
 
 /* Needed for PNG export */
 
@@ -196,6 +196,22 @@ static gdImagePtr gsvit_im = NULL;
  */
 static FILE *gsvit_f = NULL;
 
+/*!
+ * \brief Rows of the layer masks drawn at a time, 0 for the whole mask.
+ *
+ * In a band, gsvit_im holds the rows from gsvit_band_top on.
+ */
+static int gsvit_band_rows = 0;
+static int gsvit_band_top = 0;
+#ifdef HAVE_RASTER_BANDS
+static RasterBandStream *gsvit_band = NULL;
+#endif
+
+/*!
+ * \brief Number of layer masks drawn at once by worker processes.
+ */
+static int gsvit_jobs = 1;
+
 static int is_mask;
 
 static int is_drill;
@@ -247,6 +263,34 @@ Horizontal scale factor (grid points/inch).
    HID_Integer, 0, 1000, {1000, 0, 0}, 0, 0}, /* 1000 --> 1 mil (25.4 um) resolution */
 #define HA_dpi 1
 
+/* %start-doc options "96 gsvit Options"
+@ftable @code
+@item --band-rows <num>
+Rows of a layer mask drawn at a time.  Only one band of rows is held in
+memory, and written to the PNG file before the next is drawn, so that
+the masks of large boards fit in memory.  The default value is
+@code{0}, which draws each mask whole.
+@end ftable
+%end-doc
+*/
+  {"band-rows", "Rows of a layer mask drawn at a time, 0 for all",
+   HID_Integer, 0, 100000, {0, 0, 0}, 0, 0},
+#define HA_bandrows 2
+
+/* %start-doc options "96 gsvit Options"
+@ftable @code
+@item --jobs <num>
+Number of layer masks drawn at once, each by a worker process with a
+copy of the board.  The bottom layer, which the drills are taken from,
+is always drawn by pcb itself.  The default value is @code{1}, which
+draws them one after the other in pcb itself.
+@end ftable
+%end-doc
+*/
+  {"jobs", "Number of layer masks drawn at once",
+   HID_Integer, 1, 64, {1, 0, 0}, 0, 0},
+#define HA_jobs 3
+
 };
 
 #define NUM_OPTIONS (sizeof (gsvit_attribute_list) / sizeof (gsvit_attribute_list[0]))
@@ -257,7 +301,7 @@ REGISTER_ATTRIBUTES(gsvit_attribute_list)
 void gsvit_create_netlist (void);
 void gsvit_destroy_netlist (void);
 static void gsvit_xml_out (char* gsvit_basename);
-static void gsvit_build_net_from_selected (struct gsvit_netlist* currNet);
+static void gsvit_build_nets_from_labels (GSList **label_nets);
 static void gsvit_fill_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2);
 static void gsvit_write_xnets (void);
 
@@ -348,70 +392,84 @@ hslToRgb (int h, uint8_t s, uint8_t l)
 }
 
 
+/*!
+ * \brief Add a copper object to the nets of its connected component.
+ */
+#define GSVIT_ADD_TO_NETS(obj, list) \
+  do { \
+    int label = ConnectionIndexLabel (obj); \
+    GSList *n; \
+    if (label >= 0) \
+      for (n = label_nets[label]; n; n = n->next) \
+      { \
+        struct gsvit_netlist* currNet = \
+          &gsvit_netlist[GPOINTER_TO_INT (n->data)]; \
+        list = g_list_prepend (list, obj); \
+      } \
+  } while (0)
+
+/*!
+ * \brief Put every copper object in the nets its connected component
+ * belongs to.
+ *
+ * \param label_nets the nets of each label of ConnectionIndexLabel().
+ */
 void
-gsvit_build_net_from_selected (struct gsvit_netlist* currNet)
+gsvit_build_nets_from_labels (GSList **label_nets)
 {
   COPPERLINE_LOOP (PCB->Data);
   {
-    if (TEST_FLAG (SELECTEDFLAG, line))
-    {
-      currNet->layer[l].Line = g_list_prepend(currNet->layer[l].Line, line);
-    }
+    GSVIT_ADD_TO_NETS (line, currNet->layer[l].Line);
   }
   ENDALL_LOOP;
 
   COPPERARC_LOOP (PCB->Data);
   {
-    if (TEST_FLAG (SELECTEDFLAG, arc))
-    {
-      currNet->layer[l].Arc = g_list_prepend (currNet->layer[l].Arc, arc);
-    }
+    GSVIT_ADD_TO_NETS (arc, currNet->layer[l].Arc);
   }
   ENDALL_LOOP;
 
   COPPERPOLYGON_LOOP (PCB->Data);
   {
-    if (TEST_FLAG (SELECTEDFLAG, polygon))
-    {
-      currNet->layer[l].Polygon = g_list_prepend (currNet->layer[l].Polygon, polygon);
-    }
+    GSVIT_ADD_TO_NETS (polygon, currNet->layer[l].Polygon);
   }
   ENDALL_LOOP;
 
   ALLPAD_LOOP (PCB->Data);
   {
-    if (TEST_FLAG (SELECTEDFLAG, pad))
-    {
-      currNet->Pad = g_list_prepend (currNet->Pad, pad);
-    }
+    GSVIT_ADD_TO_NETS (pad, currNet->Pad);
   }
   ENDALL_LOOP;
 
   ALLPIN_LOOP (PCB->Data);
   {
-    if (TEST_FLAG (SELECTEDFLAG, pin))
-    {
-      currNet->Pin = g_list_prepend (currNet->Pin, pin);
-    }
+    GSVIT_ADD_TO_NETS (pin, currNet->Pin);
   }
   ENDALL_LOOP;
 
   VIA_LOOP (PCB->Data);
   {
-    if (TEST_FLAG (SELECTEDFLAG, via))
-    {
-      currNet->Via = g_list_prepend(currNet->Via, via);
-    }
+    GSVIT_ADD_TO_NETS (via, currNet->Via);
   }
   END_LOOP;
 }
 
 
+/*!
+ * \brief Build the nets of the netlist from the connectivity index.
+ *
+ * A net holds every copper object connected through copper to one of
+ * its pins or pads.  The connected components of the board are found
+ * once, instead of a flag reset and a lookup per net.
+ */
 void
 gsvit_create_netlist (void)
 {
   int i;
   int numNets = PCB->NetlistLib.MenuN;
+  int numLabels = ConnectionIndexCount ();
+  GSList **label_nets = (GSList **) calloc (MAX (numLabels, 1), sizeof (GSList *));
+
   gsvit_netlist = (struct gsvit_netlist*) malloc (sizeof (struct gsvit_netlist) * numNets);
   memset (gsvit_netlist, 0, sizeof (struct gsvit_netlist) * numNets);
 
@@ -425,25 +483,25 @@ gsvit_create_netlist (void)
     currNet->name = PCB->NetlistLib.Menu[i].Name + 2;
     /*! \todo Add fancy color attachment here. */
 
-    InitConnectionLookup ();
-    ClearFlagOnAllObjects (FOUNDFLAG | SELECTEDFLAG, false);
     for (j = PCB->NetlistLib.Menu[i].EntryN, entry = PCB->NetlistLib.Menu[i].Entry; j; j--, entry++)
     { /* For each component (pin/pad) in the net. */
       if (SeekPad(entry, &conn, false))
       {
-        RatFindHook(conn.type, conn.ptr1, conn.ptr2, conn.ptr2, false, SELECTEDFLAG, false);
+        int label = ConnectionIndexLabel (conn.ptr2);
+
+        /* The net joins the component, once. */
+        if (label >= 0 && (label_nets[label] == NULL
+                           || GPOINTER_TO_INT (label_nets[label]->data) != i))
+          label_nets[label] = g_slist_prepend (label_nets[label], GINT_TO_POINTER (i));
       }
     }
-    /* The conn should now contain a list of all elements that are part
-     * of the net.
-     * Now build a database of all things selected as part of this net.
-     */
-    gsvit_build_net_from_selected (currNet);
-
-    ClearFlagOnAllObjects (FOUNDFLAG | SELECTEDFLAG, false);
-    FreeConnectionLookupMemory ();
   }
 
+  gsvit_build_nets_from_labels (label_nets);
+  for (i = 0; i < numLabels; i++)
+    g_slist_free (label_nets[i]);
+  free (label_nets);
+
   /* Assign colors to nets. */
   for (i = 0; i < numNets; i++)
   {
@@ -508,6 +566,24 @@ pcb_to_gsvit (Coord pcb)
   return COORD_TO_INCH (pcb) * gsvit_dpi;
 }
 
+/*!
+ * \brief Row of gsvit_im, in the band being drawn.
+ */
+#define GSVIT_Y(y) (pcb_to_gsvit (y) - gsvit_band_top)
+
+/*!
+ * \brief Is the row in the band being drawn?  Rows off the mask belong
+ * to the first or the last band.
+ */
+static int
+gsvit_band_owns (int y)
+{
+  int h = pcb_to_gsvit (PCB->MaxHeight);
+
+  y = MAX (0, MIN (y, h - 1));
+  return y >= gsvit_band_top && y < gsvit_band_top + gsvit_band_rows;
+}
+
 
 static char *
 gsvit_get_png_name (const char *basename, const char *suffix)
@@ -724,50 +800,6 @@ bom_insert (char *refdes, char *descr, char *value, BomList * bom)
 }
 
 
-static double
-xyToAngle (double x, double y, bool morethan2pins)
-{
-  double d = atan2 (-y, x) * 180.0 / M_PI;
-
-  /* IPC 7351 defines different rules for 2 pin elements */
-  if (morethan2pins)
-  {
-    /* Multi pin case:
-    * Output 0 degrees if pin1 in is top left or top, i.e. between angles of
-    * 80 to 170 degrees.
-    * Pin #1 can be at dead top (e.g. certain PLCCs) or anywhere in the top
-    * left.
-    */
-    if (d < -100)
-      return 90; /* -180 to -100 */
-    else if (d < -10)
-      return 180; /* -100 to -10 */
-    else if (d < 80)
-      return 270; /* -10 to 80 */
-    else if (d < 170)
-      return 0; /* 80 to 170 */
-    else
-      return 90; /* 170 to 180 */
-  }
-  else
-  {
-    /* 2 pin element:
-    * Output 0 degrees if pin #1 is in top left or left, i.e. in sector
-    * between angles of 95 and 185 degrees.
-    */
-    if (d < -175)
-      return 0; /* -180 to -175 */
-    else if (d < -85)
-      return 90; /* -175 to -85 */
-    else if (d < 5)
-      return 180; /* -85 to 5 */
-    else if (d < 95)
-      return 270; /* 5 to 95 */
-    else
-      return 0; /* 95 to 180 */
-  }
-}
-
 
 /*!
  * \brief Main export callback.
@@ -897,22 +929,9 @@ static void gsvit_write_xcentroids (void)
 {
   char buff[0x100];
 
-  Coord x, y;
-  double theta = 0.0;
-  double sumx, sumy;
-  int pinfound[MAXREFPINS];
-  double pinx[MAXREFPINS];
-  double piny[MAXREFPINS];
-  double pinangle[MAXREFPINS];
-  double padcentrex, padcentrey;
-  double centroidx, centroidy;
-  double pin1x, pin1y;
-  int pin_cnt;
-  int found_any_not_at_centroid;
-  int found_any;
+  ElementPlacementType place;
   BomList *bom = NULL;
-  char *name, *descr, *value,*fixed_rotation;
-  int rpindex;
+  char *name, *descr, *value;
 
   XOUT_INDENT ();
   XOUT_NEWLINE ();
@@ -929,142 +948,31 @@ static void gsvit_write_xcentroids (void)
   */
   ELEMENT_LOOP (PCB->Data);
   {
-
-    /* Initialize our pin count and our totals for finding the centroid. */
-    pin_cnt = 0;
-    sumx = 0.0;
-    sumy = 0.0;
-    for (rpindex = 0; rpindex < MAXREFPINS; rpindex++)
-      pinfound[rpindex] = 0;
-
     /* Insert this component into the bill of materials list. */
     bom = bom_insert ((char *)UNKNOWN (NAMEONPCB_NAME (element)),
                       (char *)UNKNOWN (DESCRIPTION_NAME (element)),
                       (char *)UNKNOWN (VALUE_NAME (element)), bom);
 
-
-    /*
-     * Iterate over the pins and pads keeping a running count of how
-     * many pins/pads total and the sum of x and y coordinates
-     *
-     * While we're at it, store the location of pin/pad #1 and #2 if
-     * we can find them.
-     */
-
-    PIN_LOOP (element);
-    {
-      sumx += (double) pin->X;
-      sumy += (double) pin->Y;
-      pin_cnt++;
-
-      for (rpindex = 0; reference_pin_names[rpindex]; rpindex++) {
-        if (NSTRCMP (pin->Number, reference_pin_names[rpindex]) == 0){
-          pinx[rpindex] = (double) pin->X;
-          piny[rpindex] = (double) pin->Y;
-          pinangle[rpindex] = 0.0; /* pins have no notion of angle */
-          pinfound[rpindex] = 1;
-        }
-      }
-    }
-    END_LOOP;
-
-    PAD_LOOP (element);
-    {
-      sumx += (pad->Point1.X + pad->Point2.X) / 2.0;
-      sumy += (pad->Point1.Y + pad->Point2.Y) / 2.0;
-      pin_cnt++;
-
-      for (rpindex = 0; reference_pin_names[rpindex]; rpindex++) {
-        if (NSTRCMP (pad->Number, reference_pin_names[rpindex]) == 0) {
-          padcentrex = (double) (pad->Point1.X + pad->Point2.X) / 2.0;
-          padcentrey = (double) (pad->Point1.Y + pad->Point2.Y) / 2.0;
-          pinx[rpindex] = padcentrex;
-          piny[rpindex] = padcentrey;
-          /*
-           * NOTE: We swap the Y points because in PCB, the Y-axis
-           * is inverted.  Increasing Y moves down.  We want to deal
-           * in the usual increasing Y moves up coordinates though.
-           */
-          pinangle[rpindex] = (180.0 / M_PI) * atan2 (pad->Point1.Y - pad->Point2.Y,
-          pad->Point2.X - pad->Point1.X);
-          pinfound[rpindex]=1;
-        }
-      }
-    }
-    END_LOOP;
-
-    if (pin_cnt > 0) {
-      centroidx = sumx / (double) pin_cnt;
-      centroidy = sumy / (double) pin_cnt;
-
-      if (NSTRCMP (AttributeGetFromList (&element->Attributes,"xy-centre"), "origin") == 0 ) {
-        x = element->MarkX;
-        y = element->MarkY;
-      }
-      else {
-        x = centroidx;
-        y = centroidy;
+    ElementGetPlacement (element, false, &place);
+    if (place.pins > 0) {
+      if (place.status == PLACEMENT_NO_REFPIN) {
+        Message
+          ("PrintBOM(): unable to figure out angle because I could\n"
+           "     not find a suitable reference pin of element %s\n"
+           "     Setting to %g degrees\n",
+           UNKNOWN (NAMEONPCB_NAME (element)), place.rotation);
       }
-
-      fixed_rotation = AttributeGetFromList (&element->Attributes, "xy-fixed-rotation");
-      if (fixed_rotation) {
-        /* The user specified a fixed rotation */
-        theta = atof (fixed_rotation);
-        found_any_not_at_centroid = 1;
-        found_any = 1;
-      }
-      else {
-        /* Find first reference pin not at the  centroid  */
-        found_any_not_at_centroid = 0;
-        found_any = 0;
-        theta = 0.0;
-        for (rpindex = 0;
-             reference_pin_names[rpindex] && !found_any_not_at_centroid;
-             rpindex++) {
-          if (pinfound[rpindex]) {
-            found_any = 1;
-
-            /* Recenter pin "#1" onto the axis which cross at the part
-             * centroid. */
-            pin1x = pinx[rpindex] - x;
-            pin1y = piny[rpindex] - y;
-
-            /* flip x, to reverse rotation for elements on back. */
-            if (FRONT (element) != 1)
-              pin1x = -pin1x;
-
-            /* if only 1 pin, use pin 1's angle */
-            if (pin_cnt == 1) {
-              theta = pinangle[rpindex];
-              found_any_not_at_centroid = 1;
-            }
-            else if ((pin1x != 0.0) || (pin1y != 0.0)) {
-              theta = xyToAngle (pin1x, pin1y, pin_cnt > 2);
-              found_any_not_at_centroid = 1;
-            }
-          }
-        }
-
-        if (!found_any) {
-          Message
-            ("PrintBOM(): unable to figure out angle because I could\n"
-             "     not find a suitable reference pin of element %s\n"
-             "     Setting to %g degrees\n",
-             UNKNOWN (NAMEONPCB_NAME (element)), theta);
-        }
-        else if (!found_any_not_at_centroid) {
-          Message
-            ("PrintBOM(): unable to figure out angle of element\n"
-             "     %s because the reference pin(s) are at the centroid of the part.\n"
-             "     Setting to %g degrees\n",
-             UNKNOWN (NAMEONPCB_NAME (element)), theta);
-        }
+      else if (place.status == PLACEMENT_REFPIN_AT_CENTRE) {
+        Message
+          ("PrintBOM(): unable to figure out angle of element\n"
+           "     %s because the reference pin(s) are at the centroid of the part.\n"
+           "     Setting to %g degrees\n",
+           UNKNOWN (NAMEONPCB_NAME (element)), place.rotation);
       }
       name = CleanXBOMString ((char *)UNKNOWN (NAMEONPCB_NAME (element)));
       descr = CleanXBOMString ((char *)UNKNOWN (DESCRIPTION_NAME (element)));
       value = CleanXBOMString ((char *)UNKNOWN (VALUE_NAME (element)));
 
-      y = PCB->MaxHeight - y;
       XOUT_NEWLINE ();
       XOUT_ELEMENT_ATTR_START ("xy", "name", name);
       XOUT_INDENT ();
@@ -1073,13 +981,14 @@ static void gsvit_write_xcentroids (void)
       XOUT_NEWLINE ();
       XOUT_ELEMENT ("value", value);
       XOUT_NEWLINE ();
-      snprintf (buff, 0x100,  "%d,%d", pcb_to_gsvit(x), pcb_to_gsvit(y));
+      snprintf (buff, 0x100,  "%d,%d", pcb_to_gsvit (place.x),
+                pcb_to_gsvit (PCB->MaxHeight - place.y));
       XOUT_ELEMENT ("pos", buff);
       XOUT_NEWLINE ();
-      pcb_snprintf (buff, 0x100, "%g", theta);
+      pcb_snprintf (buff, 0x100, "%g", place.rotation);
       XOUT_ELEMENT ("rotation", buff);
       XOUT_NEWLINE ();
-      XOUT_ELEMENT ("side", FRONT (element) == 1 ? "top" : "bottom");
+      XOUT_ELEMENT ("side", place.front ? "top" : "bottom");
       XOUT_DETENT ();
       XOUT_NEWLINE ();
       XOUT_ELEMENT_END ("xy");
@@ -1185,8 +1094,18 @@ gsvit_start_png (const char *basename, const char *suffix)
   w = pcb_to_gsvit (PCB->MaxWidth);
 
   /* gsvit only works with true color images. */
-  gsvit_im = gdImageCreate (w, h);
   gsvit_f = fopen (buf, "wb");
+#ifdef HAVE_RASTER_BANDS
+  if (gsvit_band_rows > 0 && gsvit_f) {
+    /* The colors of the bands come from a one pixel image. */
+    gsvit_im = gdImageCreate (1, 1);
+    gsvit_alloc_colors ();
+    gsvit_band = raster_band_open (gsvit_f, w, h, gsvit_im);
+    free (buf);
+    return;
+  }
+#endif
+  gsvit_im = gdImageCreate (w, h);
 
   gsvit_alloc_colors ();
 
@@ -1198,13 +1117,22 @@ static void
 gsvit_finish_png ()
 {
   int i;
+#ifdef HAVE_RASTER_BANDS
+  if (gsvit_band) {
+    if (!raster_band_close (gsvit_band))
+      Message ("gsvit: Can't write layer mask.\n");
+    gsvit_band = NULL;
+  } else
+#endif
 #ifdef HAVE_GDIMAGEPNG
-  gdImagePng (gsvit_im, gsvit_f);
+  if (gsvit_f)
+    gdImagePng (gsvit_im, gsvit_f);
 #else
   Message ("gsvit: PNG not supported by gd. Can't write layer mask.\n");
 #endif
   gdImageDestroy (gsvit_im);
-  fclose (gsvit_f);
+  if (gsvit_f)
+    fclose (gsvit_f);
 
   for (i = 0; i < 0x100; i++) {
     free (color_array[i]);
@@ -1228,15 +1156,58 @@ gsvit_start_png_export ()
   linewidth = -1;
   lastbrush = (gdImagePtr)((void *) -1);
 
+#ifdef HAVE_RASTER_BANDS
+  if (gsvit_band) {
+    gdImagePtr palette = gsvit_im;
+    int h = pcb_to_gsvit (PCB->MaxHeight);
+    Coord pixel = INCH_TO_COORD (1.0) / gsvit_dpi;
+
+    /* Draw what reaches into each band, a pixel around it. */
+    for (gsvit_band_top = 0; gsvit_band_top < h; gsvit_band_top += gsvit_band_rows) {
+      gsvit_im = raster_band_image (gsvit_band, gsvit_band_top, gsvit_band_rows);
+      region.Y1 = gsvit_band_top * pixel - pixel;
+      region.Y2 = (gsvit_band_top + gsvit_band_rows) * pixel + pixel;
+      linewidth = -1;
+      lastbrush = (gdImagePtr)((void *) -1);
+      hid_expose_callback (&gsvit_hid, &region, 0);
+      raster_band_write (gsvit_band, gsvit_im);
+      gdImageDestroy (gsvit_im);
+    }
+    gsvit_band_top = 0;
+    gsvit_im = palette;
+    return;
+  }
+#endif
   hid_expose_callback (&gsvit_hid, &region, 0);
 }
 
 
+/*!
+ * \brief Write the PNG layer mask of a group.
+ */
+static void
+gsvit_write_group (int i)
+{
+  int save_ons[MAX_ALL_LAYER];
+  int idx;
+
+  gsvit_cur_group = i;
+  /* Magic. */
+  idx = (i >= 0 && i < max_group) ? PCB->LayerGroups.Entries[i][0] : i;
+  save_drill = (GetLayerGroupNumberByNumber (idx) == GetLayerGroupNumberBySide (BOTTOM_SIDE)) ? 1 : 0;
+  /* save drills for one layer only */
+  gsvit_start_png (gsvit_basename, layer_type_to_file_name (idx, FNS_fixed));
+  hid_save_and_show_layer_ons (save_ons);
+  gsvit_start_png_export ();
+  hid_restore_layer_ons (save_ons);
+  gsvit_finish_png ();
+}
+
+
 static void 
 gsvit_do_export (HID_Attr_Val *options)
 {
-  int save_ons[MAX_ALL_LAYER];
-  int i, idx;
+  int i;
   char *buf;
   int len;
 
@@ -1264,23 +1235,19 @@ gsvit_do_export (HID_Attr_Val *options)
     return;
   }
 
+  gsvit_band_rows = options[HA_bandrows].int_value;
+  gsvit_jobs = options[HA_jobs].int_value;
+#ifndef HAVE_RASTER_BANDS
+  if (gsvit_band_rows > 0)
+    Message ("gsvit: pcb was built without zlib, drawing the layer masks whole.\n");
+#endif
+
   gsvit_create_netlist ();
   gsvit_choose_groups ();
 
-  for (i = 0; i < MAX_GROUP; i++) {
-    if (gsvit_export_group[i]) {
-      gsvit_cur_group = i;
-      /* Magic. */
-      idx = (i >= 0 && i < max_group) ? PCB->LayerGroups.Entries[i][0] : i;
-      save_drill = (GetLayerGroupNumberByNumber (idx) == GetLayerGroupNumberBySide (BOTTOM_SIDE)) ? 1 : 0;
-      /* save drills for one layer only */
-      gsvit_start_png (gsvit_basename, layer_type_to_file_name (idx, FNS_fixed));
-      hid_save_and_show_layer_ons (save_ons);
-      gsvit_start_png_export ();
-      hid_restore_layer_ons (save_ons);
-      gsvit_finish_png ();
-    }
-  }
+  /* The drills are kept from the bottom layer, so it is drawn here. */
+  raster_run_layers (gsvit_export_group, gsvit_jobs,
+                     GetLayerGroupNumberBySide (BOTTOM_SIDE), gsvit_write_group);
 
   len = strlen (gsvit_basename) + 4;
   buf = (char *) malloc (sizeof (*buf) * len);
@@ -1563,8 +1530,8 @@ gsvit_draw_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 {
   use_gc (gc);
 
-  gdImageRectangle (gsvit_im, pcb_to_gsvit (x1), pcb_to_gsvit (y1),
-    pcb_to_gsvit (x2), pcb_to_gsvit (y2), gc->color->c);
+  gdImageRectangle (gsvit_im, pcb_to_gsvit (x1), GSVIT_Y (y1),
+    pcb_to_gsvit (x2), GSVIT_Y (y2), gc->color->c);
 }
 
 
@@ -1575,8 +1542,8 @@ gsvit_fill_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
   gdImageSetThickness (gsvit_im, 0);
   linewidth = 0;
 
-  gdImageFilledRectangle (gsvit_im, pcb_to_gsvit (x1), pcb_to_gsvit (y1),
-    pcb_to_gsvit (x2), pcb_to_gsvit (y2), gc->color->c);
+  gdImageFilledRectangle (gsvit_im, pcb_to_gsvit (x1), GSVIT_Y (y1),
+    pcb_to_gsvit (x2), GSVIT_Y (y2), gc->color->c);
 }
 
 
@@ -1805,8 +1772,8 @@ gsvit_draw_line (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 
   gdImageSetThickness (gsvit_im, 0);
   linewidth = 0;
-  gdImageLine (gsvit_im, pcb_to_gsvit (x1), pcb_to_gsvit (y1),
-    pcb_to_gsvit (x2), pcb_to_gsvit (y2), gdBrushed);
+  gdImageLine (gsvit_im, pcb_to_gsvit (x1), GSVIT_Y (y1),
+    pcb_to_gsvit (x2), GSVIT_Y (y2), gdBrushed);
 }
 
 
@@ -1845,7 +1812,7 @@ gsvit_draw_arc (hidGC gc, Coord cx, Coord cy, Coord width, Coord height, Angle s
   use_gc (gc);
   gdImageSetThickness (gsvit_im, 0);
   linewidth = 0;
-  gdImageArc (gsvit_im, pcb_to_gsvit (cx), pcb_to_gsvit (cy),
+  gdImageArc (gsvit_im, pcb_to_gsvit (cx), GSVIT_Y (cy),
     pcb_to_gsvit (2 * width), pcb_to_gsvit (2 * height), sa, ea, gdBrushed);
 }
 
@@ -1857,10 +1824,12 @@ gsvit_fill_circle (hidGC gc, Coord cx, Coord cy, Coord radius)
 
   gdImageSetThickness (gsvit_im, 0);
   linewidth = 0;
-  gdImageFilledEllipse (gsvit_im, pcb_to_gsvit (cx), pcb_to_gsvit (cy),
+  gdImageFilledEllipse (gsvit_im, pcb_to_gsvit (cx), GSVIT_Y (cy),
     pcb_to_gsvit (2 * radius), pcb_to_gsvit (2 * radius), color_array[hashColor]->c);
 
-  if (save_drill && is_drill)
+  /* A hole drawn in several bands is kept from the band of its centre. */
+  if (save_drill && is_drill
+      && (gsvit_band_rows <= 0 || gsvit_band_owns (pcb_to_gsvit (cy))))
   {
     double diameter_inches = COORD_TO_INCH(radius*2);
     struct single_size_drills* drill = get_drill (diameter_inches, radius);
@@ -1890,7 +1859,7 @@ gsvit_fill_polygon (hidGC gc, int n_coords, Coord *x, Coord *y)
 
   for (i = 0; i < n_coords; i++) {
     points[i].x = pcb_to_gsvit (x[i]);
-    points[i].y = pcb_to_gsvit (y[i]);
+    points[i].y = GSVIT_Y (y[i]);
   }
 
   gdImageSetThickness (gsvit_im, 0);
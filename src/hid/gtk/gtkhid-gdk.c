@@ -41,6 +41,7 @@
 #include "clip.h"
 #include "../hidint.h"
 #include "gui.h"
+#include "job.h"
 #include "hid/common/draw_helpers.h"
 
 #ifdef HAVE_LIBDMALLOC
@@ -68,6 +69,10 @@ typedef struct render_priv {
   int attached_invalidate_depth;
   int mark_invalidate_depth;
 
+  /* Parts of the pixmap to draw again, in window pixels, or NULL */
+  GdkRegion *dirty;
+  guint redraw_idle;
+
   /* Feature for leading the user to a particular location */
   guint lead_user_timeout;
   GTimer *lead_user_timer;
@@ -96,6 +101,50 @@ hid_gc_struct;
 
 static void draw_lead_user (render_priv *priv);
 
+/* Lines are drawn this many at a time, with one gdk_draw_segments () */
+#define LINE_BATCH 256
+
+/*!
+ * \brief The lines drawn with one GC and not yet sent to the drawable.
+ *
+ * They are kept in window pixels, unclipped.  Anything that draws
+ * otherwise, or changes the GC or the drawable, sends them first.
+ */
+static struct
+{
+  GdkDrawable *drawable;
+  GdkGC *gc;
+  hidGC hid_gc;
+  double margin;
+  int n;
+  double xy[4 * LINE_BATCH];
+} lines;
+
+/*!
+ * \brief Clip and draw the batched lines.
+ */
+static void
+flush_lines (void)
+{
+  GdkSegment segs[LINE_BATCH];
+  int n, i;
+
+  if (lines.n == 0)
+    return;
+  n = ClipLines (0, 0, gport->width, gport->height,
+		 lines.xy, lines.n, lines.margin);
+  for (i = 0; i < n; i++)
+    {
+      segs[i].x1 = lines.xy[4 * i];
+      segs[i].y1 = lines.xy[4 * i + 1];
+      segs[i].x2 = lines.xy[4 * i + 2];
+      segs[i].y2 = lines.xy[4 * i + 3];
+    }
+  if (n > 0)
+    gdk_draw_segments (lines.drawable, lines.gc, segs, n);
+  lines.n = 0;
+}
+
 
 int
 ghid_set_layer (const char *name, int group, int empty)
@@ -145,6 +194,8 @@ ghid_set_layer (const char *name, int group, int empty)
 void
 ghid_destroy_gc (hidGC gc)
 {
+  if (lines.hid_gc == gc)
+    flush_lines ();
   if (gc->gc)
     g_object_unref (gc->gc);
   g_free (gc);
@@ -311,6 +362,7 @@ ghid_use_mask (enum mask_mode mode)
     return;
   if (mode == cur_mask)
     return;
+  flush_lines ();
   switch (mode)
     {
     case HID_MASK_OFF:
@@ -423,6 +475,8 @@ ghid_set_color (hidGC gc, const char *name)
   gc->colorname = (char *) name;
   if (!gc->gc)
     return;
+  if (lines.hid_gc == gc)
+    flush_lines ();
   if (gport->colormap == 0)
     gport->colormap = gtk_widget_get_colormap (gport->top_window);
 
@@ -492,6 +546,8 @@ ghid_set_line_cap (hidGC gc, EndCapStyle style)
       gc->join = GDK_JOIN_MITER;
       break;
     }
+  if (lines.hid_gc == gc)
+    flush_lines ();
   if (gc->gc)
     gdk_gc_set_line_attributes (WHICH_GC (gc),
 				Vz (gc->width), GDK_LINE_SOLID,
@@ -503,6 +559,8 @@ ghid_set_line_width (hidGC gc, Coord width)
 {
   render_priv *priv = gport->render_priv;
 
+  if (lines.hid_gc == gc)
+    flush_lines ();
   gc->width = width;
   if (gc->gc)
     gdk_gc_set_line_attributes (WHICH_GC (gc),
@@ -513,6 +571,8 @@ ghid_set_line_width (hidGC gc, Coord width)
 void
 ghid_set_draw_xor (hidGC gc, int xor_mask)
 {
+  if (lines.hid_gc == gc)
+    flush_lines ();
   gc->xor_mask = xor_mask;
   if (!gc->gc)
     return;
@@ -532,6 +592,7 @@ use_gc (hidGC gc)
       abort ();
     }
 
+  flush_lines ();
   if (!gport->pixmap)
     return 0;
   if (!gc->gc)
@@ -566,12 +627,24 @@ ghid_draw_line (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
   dx2 = Vx ((double) x2);
   dy2 = Vy ((double) y2);
 
-  if (!ClipLine (0, 0, gport->width, gport->height,
-		 &dx1, &dy1, &dx2, &dy2, gc->width / gport->view.coord_per_px))
-    return;
-
-  USE_GC (gc);
-  gdk_draw_line (gport->drawable, priv->u_gc, dx1, dy1, dx2, dy2);
+  /* The lines are clipped and drawn in batches, see flush_lines () */
+  if (lines.n > 0
+      && (lines.hid_gc != gc || lines.drawable != gport->drawable
+	  || lines.n == LINE_BATCH))
+    flush_lines ();
+  if (lines.n == 0)
+    {
+      USE_GC (gc);
+      lines.drawable = gport->drawable;
+      lines.gc = priv->u_gc;
+      lines.hid_gc = gc;
+      lines.margin = gc->width / gport->view.coord_per_px;
+    }
+  lines.xy[4 * lines.n] = dx1;
+  lines.xy[4 * lines.n + 1] = dy1;
+  lines.xy[4 * lines.n + 2] = dx2;
+  lines.xy[4 * lines.n + 3] = dy2;
+  lines.n++;
 }
 
 void
@@ -840,6 +913,7 @@ redraw_region (GdkRectangle *rect)
 
   /* Draw all of the PCB stuff, elements, traces, etc. */
   hid_expose_callback (&ghid_hid, &region, 0);
+  flush_lines ();
   
   ghid_graphics.draw_grid (&region);
 
@@ -850,6 +924,7 @@ redraw_region (GdkRectangle *rect)
   /* In some cases we are called with the mark still off */
   if (priv->mark_invalidate_depth == 0)
     DrawMark (priv->crosshair_gc);
+  flush_lines ();
 
   draw_lead_user (priv);
 
@@ -860,6 +935,98 @@ redraw_region (GdkRectangle *rect)
   gdk_gc_set_clip_mask (priv->bg_gc, NULL);
 }
 
+/* With more dirty rectangles than this, their bounding box is redrawn */
+#define DIRTY_MAX_RECTS 16
+
+/*!
+ * \brief Redraw the dirty parts of the pixmap, and have the window show
+ * them.
+ *
+ * The dirty rectangles are redrawn one by one, unless there are many of
+ * them or they cover most of their bounding box, which is then redrawn
+ * at once.
+ */
+static void
+redraw_dirty (void)
+{
+  render_priv *priv = gport->render_priv;
+  GdkWindow *window;
+  GdkRectangle *rects, box;
+  gint n, i;
+  gint64 area = 0, start;
+
+  if (priv->redraw_idle)
+    {
+      g_source_remove (priv->redraw_idle);
+      priv->redraw_idle = 0;
+    }
+  /* A background job owns the board; the whole view is redrawn when it
+     ends, so the dirty region can wait. */
+  if (priv->dirty == NULL || pcb_job_busy ())
+    return;
+
+  start = g_get_monotonic_time ();
+  gdk_region_get_clipbox (priv->dirty, &box);
+  gdk_region_get_rectangles (priv->dirty, &rects, &n);
+  for (i = 0; i < n; i++)
+    area += (gint64) rects[i].width * rects[i].height;
+
+  if (box.x <= 0 && box.y <= 0 &&
+      box.x + box.width >= gport->width && box.y + box.height >= gport->height)
+    redraw_region (NULL);
+  else if (n > DIRTY_MAX_RECTS || 2 * area > (gint64) box.width * box.height)
+    redraw_region (&box);
+  else
+    for (i = 0; i < n; i++)
+      redraw_region (&rects[i]);
+  g_free (rects);
+  ghid_note_frame (g_get_monotonic_time () - start);
+
+  window = gtk_widget_get_window (gport->drawing_area);
+  if (window != NULL)
+    gdk_window_invalidate_region (window, priv->dirty, FALSE);
+  gdk_region_destroy (priv->dirty);
+  priv->dirty = NULL;
+}
+
+static gboolean
+redraw_dirty_cb (gpointer data)
+{
+  render_priv *priv = data;
+
+  priv->redraw_idle = 0;
+  redraw_dirty ();
+  return FALSE;
+}
+
+/*!
+ * \brief Add a rectangle of the window to what is redrawn before the
+ * next expose.
+ *
+ * The pixmap is brought up to date when the main loop is next idle, so
+ * the changes of an action are drawn together, and only the window
+ * areas they touch are sent to the X server.
+ */
+static void
+add_dirty (GdkRectangle *rect)
+{
+  render_priv *priv = gport->render_priv;
+  GdkRectangle view = {0, 0, gport->width, gport->height};
+  GdkRectangle clipped;
+
+  if (!gdk_rectangle_intersect (rect, &view, &clipped))
+    return;
+  if (priv->dirty == NULL)
+    priv->dirty = gdk_region_rectangle (&clipped);
+  else
+    gdk_region_union_with_rect (priv->dirty, &clipped);
+
+  /* Before GTK handles the exposes at GDK_PRIORITY_REDRAW */
+  if (priv->redraw_idle == 0)
+    priv->redraw_idle = g_idle_add_full (G_PRIORITY_HIGH_IDLE,
+                                         redraw_dirty_cb, priv, NULL);
+}
+
 void
 ghid_invalidate_lr (Coord left, Coord right, Coord top, Coord bottom)
 {
@@ -877,21 +1044,41 @@ ghid_invalidate_lr (Coord left, Coord right, Coord top, Coord bottom)
   miny = MIN (dtop, dbottom);
   maxy = MAX (dtop, dbottom);
 
-  rect.x = minx;
-  rect.y = miny;
-  rect.width = maxx - minx;
-  rect.height = maxy - miny;
+  /* Keep to the window, as a close zoom overflows the rectangle */
+  minx = MAX (minx, -1);
+  miny = MAX (miny, -1);
+  maxx = MIN (maxx, gport->width + 1);
+  maxy = MIN (maxy, gport->height + 1);
+  if (minx > maxx || miny > maxy)
+    return;
 
-  redraw_region (&rect);
-  ghid_screen_update ();
+  /* One pixel more all round, for what rounds outside the box */
+  rect.x = minx - 1;
+  rect.y = miny - 1;
+  rect.width = maxx - minx + 3;
+  rect.height = maxy - miny + 3;
+
+  add_dirty (&rect);
 }
 
 
 void
 ghid_invalidate_all ()
 {
-  redraw_region (NULL);
-  ghid_screen_update ();
+  GdkRectangle rect = {0, 0, gport->width, gport->height};
+
+  add_dirty (&rect);
+}
+
+/*!
+ * \brief Redraw after a change of the view alone.
+ *
+ * The pixmap is of the view, so that is all of it.
+ */
+void
+ghid_invalidate_view ()
+{
+  ghid_invalidate_all ();
 }
 
 void
@@ -919,7 +1106,10 @@ ghid_notify_crosshair_change (bool changes_complete)
     }
 
   if (priv->attached_invalidate_depth == 0)
-    DrawAttached (priv->crosshair_gc);
+    {
+      DrawAttached (priv->crosshair_gc);
+      flush_lines ();
+    }
 
   if (!changes_complete)
     {
@@ -957,7 +1147,10 @@ ghid_notify_mark_change (bool changes_complete)
     }
 
   if (priv->mark_invalidate_depth == 0)
-    DrawMark (priv->crosshair_gc);
+    {
+      DrawMark (priv->crosshair_gc);
+      flush_lines ();
+    }
 
   if (!changes_complete)
     {
@@ -1089,6 +1282,15 @@ draw_crosshair (render_priv *priv)
     draw_dozen_cross (xor_gc, x, y);
 }
 
+/*!
+ * \brief Add what the renderer counts to the frame statistics, and clear
+ * the counts.  The GDK renderer counts nothing of its own.
+ */
+void
+ghid_renderer_stats (GString *text)
+{
+}
+
 void
 ghid_init_renderer (int *argc, char ***argv, GHidPort *port)
 {
@@ -1104,6 +1306,10 @@ ghid_shutdown_renderer (GHidPort *port)
 
   gui->graphics->destroy_gc (priv->crosshair_gc);
   ghid_cancel_lead_user ();
+  if (priv->redraw_idle)
+    g_source_remove (priv->redraw_idle);
+  if (priv->dirty)
+    gdk_region_destroy (priv->dirty);
   g_free (port->render_priv);
   port->render_priv = NULL;
 }
@@ -1220,6 +1426,7 @@ ghid_pinout_preview_expose (GtkWidget *widget,
 
   /* call the drawing routine */
   hid_expose_callback (&ghid_hid, NULL, pinout->element);
+  flush_lines ();
 
   gport->drawable = save_drawable;
   gport->view = save_view;
@@ -1277,6 +1484,7 @@ ghid_render_pixmap (int cx, int cy, double zoom, int width, int height, int dept
   region.Y2 = MAX (0, MIN (PCB->MaxHeight, region.Y2));
 
   hid_expose_callback (&ghid_hid, &region, NULL);
+  flush_lines ();
 
   gport->drawable = save_drawable;
   gport->view = save_view;
@@ -1297,6 +1505,8 @@ ghid_request_debug_draw (void)
 void
 ghid_flush_debug_draw (void)
 {
+  flush_lines ();
+  redraw_dirty ();
   ghid_screen_update ();
   gdk_flush ();
 }
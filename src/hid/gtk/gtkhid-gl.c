@@ -3,11 +3,13 @@
 #endif
 
 #include <stdio.h>
+#include <math.h>
 
 #include "crosshair.h"
 #include "clip.h"
 #include "../hidint.h"
 #include "gui.h"
+#include "job.h"
 #include "gui-pinout-preview.h"
 
 /* The Linux OpenGL ABI 1.0 spec requires that we define
@@ -78,6 +80,13 @@ typedef struct render_priv {
   Coord lead_user_y;
 
   hidGC crosshair_gc;
+
+  /* Scene cache: the tiles drawn at the zoom level scene_zoom */
+  GHashTable *scene_tiles;
+  int scene_zoom;
+  bool scene_flush;
+  guint scene_frame;
+  guint scene_more_idle;       /* queues the frame to record more tiles */
 } render_priv;
 
 
@@ -624,15 +633,248 @@ ghid_fill_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
   hidgl_fill_rect (x1, y1, x2, y2);
 }
 
+/* ---------------------------------------------------------------------------
+ * Scene cache.
+ *
+ * The board is drawn into display lists, one for each tile of a grid,
+ * and a frame calls the lists of the tiles it shows.  A tile is drawn
+ * again only once a change touches it, so panning, zooming and rotating
+ * the view just change the transform.
+ *
+ * Arcs and circles are cut into as many segments as their size on the
+ * screen needs, so the tiles are only kept while coord_per_px stays
+ * within a power of two.  A tile is SCENE_TILE_PX pixels wide at the
+ * coarsest zoom of that range.
+ */
+#define SCENE_TILE_PX 256
+/* tiles kept at most, besides those the last frame showed */
+#define SCENE_MAX_TILES 1024
+/* Time a frame may spend recording tiles, in microseconds.  The tiles
+ * left over keep what they showed before, or nothing if they are new,
+ * and are recorded by the frames that follow, so that input is handled
+ * in between. */
+#define SCENE_FRAME_USEC 15000
+
+typedef struct
+{
+  gint64 key;                  /* x and y of the tile in the grid */
+  GLuint list;
+  bool dirty;
+  guint frame;                 /* the last frame that showed it */
+} scene_tile;
+
+static gint64
+scene_key (int x, int y)
+{
+  return ((gint64) x << 32) | (guint32) y;
+}
+
+static Coord
+scene_tile_size (int zoom)
+{
+  return MAX (1, ldexp (SCENE_TILE_PX, zoom));
+}
+
+/* Forget the GL colour and GC set, as a display list may have
+ * left another colour set than they say.
+ */
+static void
+scene_forget_color (render_priv *priv)
+{
+  free (priv->current_colorname);
+  priv->current_colorname = NULL;
+  ghid_invalidate_current_gc ();
+}
+
+static gboolean
+scene_delete_tile (gpointer key, gpointer value, gpointer data)
+{
+  scene_tile *tile = value;
+  guint *frame = data;
+
+  if (frame != NULL && tile->frame == *frame)
+    return FALSE;
+  glDeleteLists (tile->list, 1);
+  return TRUE;
+}
+
+/* Mark the tiles touching a region to be drawn again.
+ *
+ * Called outside the GL context, so nothing is deleted here.
+ */
+static void
+scene_invalidate (Coord left, Coord right, Coord top, Coord bottom)
+{
+  render_priv *priv = gport->render_priv;
+  Coord size = scene_tile_size (priv->scene_zoom);
+  GHashTableIter iter;
+  scene_tile *tile;
+  Coord x, y;
+
+  if (priv->scene_tiles == NULL || priv->scene_flush)
+    return;
+  g_hash_table_iter_init (&iter, priv->scene_tiles);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tile))
+    {
+      x = (Coord) (tile->key >> 32) * size;
+      y = (Coord) (gint32) tile->key * size;
+      if (x <= MAX (left, right) && x + size >= MIN (left, right) &&
+          y <= MAX (top, bottom) && y + size >= MIN (top, bottom))
+        tile->dirty = true;
+    }
+}
+
+/* Draw a tile of the board into its display list.
+ *
+ * Clip planes keep the objects it shares with other tiles from being
+ * drawn twice over.  Each tile starts with a clean stencil buffer, as the
+ * tiles drawn before it may be others than when it was recorded.
+ */
+static void
+scene_record (render_priv *priv, scene_tile *tile, int x, int y, Coord size)
+{
+  GLdouble planes[4][4] = {
+    { 1.,  0., 0., 0.},
+    {-1.,  0., 0., 0.},
+    { 0.,  1., 0., 0.},
+    { 0., -1., 0., 0.}};
+  BoxType box;
+  int i;
+
+  box.X1 = x * size;
+  box.Y1 = y * size;
+  box.X2 = MIN (box.X1 + size, PCB->MaxWidth);
+  box.Y2 = MIN (box.Y1 + size, PCB->MaxHeight);
+  planes[0][3] = -box.X1;
+  planes[1][3] =  box.X2;
+  planes[2][3] = -box.Y1;
+  planes[3][3] =  box.Y2;
+
+  scene_forget_color (priv);
+  hidgl_reset_stencil_usage ();
+  priv->subcomposite_stencil_bit = 0;
+
+  glNewList (tile->list, GL_COMPILE);
+  glStencilMask (~0);
+  glClear (GL_STENCIL_BUFFER_BIT);
+  glStencilMask (0);
+  for (i = 0; i < 4; i++)
+    {
+      glClipPlane (GL_CLIP_PLANE0 + i, planes[i]);
+      glEnable (GL_CLIP_PLANE0 + i);
+    }
+  hid_expose_callback (&ghid_hid, &box, 0);
+  hidgl_flush_triangles (&buffer);
+  for (i = 0; i < 4; i++)
+    glDisable (GL_CLIP_PLANE0 + i);
+  glEndList ();
+
+  tile->dirty = false;
+}
+
+static gboolean
+scene_more_cb (gpointer data)
+{
+  render_priv *priv = data;
+
+  priv->scene_more_idle = 0;
+  ghid_draw_area_update (gport, NULL);
+  return FALSE;
+}
+
+/* Draw the board in a region from the scene cache, recording the
+ * tiles that are missing or were touched by a change, for as long as
+ * SCENE_FRAME_USEC allows.
+ */
+static void
+scene_draw (GHidPort *port, const BoxType *region)
+{
+  render_priv *priv = port->render_priv;
+  int zoom = (int) ceil (log2 (port->view.coord_per_px));
+  gint64 deadline = g_get_monotonic_time () + SCENE_FRAME_USEC;
+  bool more = false;
+  GHashTableIter iter;
+  Coord size;
+  scene_tile *tile;
+  gint64 key;
+  int x, y;
+
+  if (priv->scene_tiles == NULL)
+    priv->scene_tiles = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+                                               NULL, g_free);
+  if (zoom != priv->scene_zoom)
+    {
+      g_hash_table_foreach_remove (priv->scene_tiles, scene_delete_tile,
+                                   NULL);
+      priv->scene_zoom = zoom;
+    }
+  else if (priv->scene_flush)
+    {
+      /* the tiles show what they did until they are recorded again */
+      g_hash_table_iter_init (&iter, priv->scene_tiles);
+      while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tile))
+        tile->dirty = true;
+    }
+  priv->scene_flush = false;
+  if (region->X1 >= region->X2 || region->Y1 >= region->Y2)
+    return;
+
+  size = scene_tile_size (zoom);
+  priv->scene_frame++;
+  for (y = region->Y1 / size; y <= (region->Y2 - 1) / size; y++)
+    for (x = region->X1 / size; x <= (region->X2 - 1) / size; x++)
+      {
+        key = scene_key (x, y);
+        tile = g_hash_table_lookup (priv->scene_tiles, &key);
+        if (tile == NULL)
+          {
+            tile = g_new0 (scene_tile, 1);
+            tile->key = key;
+            tile->list = glGenLists (1);
+            tile->dirty = true;
+            g_hash_table_insert (priv->scene_tiles, &tile->key, tile);
+          }
+        if (tile->dirty && g_get_monotonic_time () < deadline)
+          scene_record (priv, tile, x, y, size);
+        else if (tile->dirty)
+          more = true;
+        tile->frame = priv->scene_frame;
+        glCallList (tile->list);
+      }
+  scene_forget_color (priv);
+
+  if (g_hash_table_size (priv->scene_tiles) > SCENE_MAX_TILES)
+    g_hash_table_foreach_remove (priv->scene_tiles, scene_delete_tile,
+                                 &priv->scene_frame);
+
+  /* Queued once the events that came in meanwhile are handled */
+  if (more && priv->scene_more_idle == 0)
+    priv->scene_more_idle = g_idle_add (scene_more_cb, priv);
+}
+
 void
 ghid_invalidate_lr (Coord left, Coord right, Coord top, Coord bottom)
 {
-  ghid_invalidate_all ();
+  scene_invalidate (left, right, top, bottom);
+  ghid_invalidate_view ();
 }
 
-#define MAX_ELAPSED (50. / 1000.) /* 50ms */
+/* Redraw after a change that may touch any of the board.
+ */
 void
 ghid_invalidate_all ()
+{
+  render_priv *priv = gport->render_priv;
+
+  priv->scene_flush = true;
+  ghid_invalidate_view ();
+}
+
+#define MAX_ELAPSED (50. / 1000.) /* 50ms */
+/* Redraw after a change of the view alone, from the scene cache.
+ */
+void
+ghid_invalidate_view ()
 {
   render_priv *priv = gport->render_priv;
   double elapsed = g_timer_elapsed (priv->time_since_expose, NULL);
@@ -651,7 +893,7 @@ ghid_notify_crosshair_change (bool changes_complete)
     return;
 
   /* FIXME: We could just invalidate the bounds of the crosshair attached objects? */
-  if (changes_complete) ghid_invalidate_all ();
+  if (changes_complete) ghid_invalidate_view ();
 }
 
 void
@@ -826,6 +1068,11 @@ ghid_shutdown_renderer (GHidPort *port)
 
   gui->graphics->destroy_gc (priv->crosshair_gc);
   ghid_cancel_lead_user ();
+  /* the display lists go with the GL context */
+  if (priv->scene_tiles != NULL)
+    g_hash_table_destroy (priv->scene_tiles);
+  if (priv->scene_more_idle)
+    g_source_remove (priv->scene_more_idle);
   g_free (port->render_priv);
   port->render_priv = NULL;
 }
@@ -883,6 +1130,23 @@ ghid_screen_update (void)
 {
 }
 
+/* Add the work counted by hidgl to the frame statistics, and clear it.
+ * Triangles and shapes recorded into the display lists of the scene
+ * cache are counted when they are recorded, not when they are replayed.
+ */
+void
+ghid_renderer_stats (GString *text)
+{
+  if (text != NULL)
+    g_string_append_printf (text,
+                            _("; %lu triangles in %lu batches, %lu shapes, "
+                              "%lu tessellations kept, %lu made"),
+                            hidgl_stats.triangles, hidgl_stats.flushes,
+                            hidgl_stats.shapes, hidgl_stats.tess_hits,
+                            hidgl_stats.tess_misses);
+  memset (&hidgl_stats, 0, sizeof (hidgl_stats));
+}
+
 #define Z_NEAR 3.0
 gboolean
 ghid_drawing_area_expose_cb (GtkWidget *widget,
@@ -897,6 +1161,12 @@ ghid_drawing_area_expose_cb (GtkWidget *widget,
   Coord new_x, new_y;
   Coord min_depth;
   Coord max_depth;
+  gint64 start = g_get_monotonic_time ();
+
+  /* A background job owns the board; the whole view is redrawn when it
+     ends. */
+  if (pcb_job_busy ())
+    return FALSE;
 
   gtk_widget_get_allocation (widget, &allocation);
 
@@ -1029,8 +1299,7 @@ ghid_drawing_area_expose_cb (GtkWidget *widget,
   ghid_draw_bg_image ();
 
   ghid_invalidate_current_gc ();
-  hid_expose_callback (&ghid_hid, &region, 0);
-  hidgl_flush_triangles (&buffer);
+  scene_draw (port, &region);
 
   ghid_graphics.draw_grid (&region);
 
@@ -1049,6 +1318,7 @@ ghid_drawing_area_expose_cb (GtkWidget *widget,
   ghid_end_drawing (port, widget);
 
   g_timer_start (priv->time_since_expose);
+  ghid_note_frame (g_get_monotonic_time () - start);
 
   return FALSE;
 }
@@ -1068,6 +1338,10 @@ ghid_port_drawing_realize_cb (GtkWidget *widget, gpointer data)
     return;
 
   gdk_gl_drawable_gl_end (gldrawable);
+
+  /* A new GL context has none of the display lists of the scene cache */
+  if (gport->render_priv->scene_tiles != NULL)
+    g_hash_table_remove_all (gport->render_priv->scene_tiles);
   return;
 }
 
@@ -1580,7 +1854,7 @@ void
 ghid_view_2d (void *ball, gboolean view_2d, gpointer userdata)
 {
   global_view_2d = view_2d;
-  ghid_invalidate_all ();
+  ghid_invalidate_view ();
 }
 
 void
@@ -1603,7 +1877,7 @@ ghid_port_rotate (void *ball, float *quarternion, gpointer userdata)
   printf ("\n");
 #endif
 
-  ghid_invalidate_all ();
+  ghid_invalidate_view ();
 }
 
 
@@ -1658,7 +1932,7 @@ lead_user_cb (gpointer data)
   double elapsed_time;
 
   /* Queue a redraw */
-  ghid_invalidate_all ();
+  ghid_invalidate_view ();
 
   /* Update radius */
   elapsed_time = g_timer_elapsed (priv->lead_user_timer, NULL);
@@ -1700,7 +1974,7 @@ ghid_cancel_lead_user (void)
     g_timer_destroy (priv->lead_user_timer);
 
   if (priv->lead_user)
-    ghid_invalidate_all ();
+    ghid_invalidate_view ();
 
   priv->lead_user_timeout = 0;
   priv->lead_user_timer = NULL;
@@ -13,9 +13,11 @@
 
 #include "action.h"
 #include "crosshair.h"
+#include "draw.h"
 #include "error.h"
 #include "../hidint.h"
 #include "gui.h"
+#include "mymem.h"
 #include "hid/common/hidnogui.h"
 #include "hid/common/draw_helpers.h"
 #include "pcb-printf.h"
@@ -130,7 +132,7 @@ ghid_flip_view (Coord center_x, Coord center_y, bool flip_x, bool flip_y)
   /* Pan the board so the center location remains in the same place */
   ghid_pan_view_abs (center_x, center_y, widget_x, widget_y);
 
-  ghid_invalidate_all ();
+  ghid_invalidate_view ();
 }
 
 /* ------------------------------------------------------------ */
@@ -1037,10 +1039,8 @@ ghid_attributes (char *owner, AttributeListType *attrs)
 	  /* Copy the values back */
 	  for (i=0; i<attributes_list->Number; i++)
 	    {
-	      if (attributes_list->List[i].name)
-		free (attributes_list->List[i].name);
-	      if (attributes_list->List[i].value)
-		free (attributes_list->List[i].value);
+	      ReleaseString (attributes_list->List[i].name);
+	      ReleaseString (attributes_list->List[i].value);
 	    }
 	  if (attributes_list->Max < attr_num_rows)
 	    {
@@ -1692,7 +1692,8 @@ Export (int argc, char **argv, Coord x, Coord y)
 /* ------------------------------------------------------------ */
 
 static const char benchmark_syntax[] =
-"Benchmark()\n";
+"Benchmark()\n"
+"Benchmark(PanZoom)\n";
 
 static const char benchmark_help[] =
 N_("Report the amount of redraws per second.");
@@ -1705,8 +1706,73 @@ entry dialog.
 @noindent This action reports the number of redraws per second on the command
 line interface.
 
+@noindent With @code{PanZoom}, the board is instead drawn over a fixed
+sequence of views: the whole board, zooming in on its center, panning
+around there and zooming out again.  The time of the slowest and of the
+average view is reported, and the view is put back as it was.
+
 %end-doc */
 
+/* redraw the whole window and wait until it is drawn */
+static void
+benchmark_redraw (void)
+{
+  ghid_invalidate_all ();
+  gdk_window_process_updates (gtk_widget_get_window (gport->drawing_area),
+                              FALSE);
+  gdk_display_sync (gdk_drawable_get_display (gport->drawable));
+}
+
+static int
+benchmark_pan_zoom (void)
+{
+  /* panning steps, in quarters of the width and height of the view */
+  static const int pan[][2] = {
+    {1, 0}, {1, 0}, {0, 1}, {-1, 0}, {-1, 0}, {-1, 0}, {-1, 0},
+    {0, -1}, {0, -1}, {1, 0}, {1, 0}, {1, 0}, {1, 0}, {-1, 0}, {-1, 0},
+    {0, 1}
+  };
+  Coord x0 = gport->view.x0, y0 = gport->view.y0;
+  double zoom = gport->view.coord_per_px;
+  gint64 start, usec, total = 0, worst = 0;
+  int n_pan = G_N_ELEMENTS (pan);
+  int views = 0, step, i;
+
+  if (PCB->MaxWidth <= 0 || PCB->MaxHeight <= 0)
+    return 1;
+
+  /* zoom in, pan, then zoom out again */
+  for (step = 0; step < 5 + n_pan + 4; step++)
+    {
+      if (step == 0)
+        ghid_zoom_view_fit ();
+      else if (step < 5)
+        ghid_zoom_view_rel (PCB->MaxWidth / 2, PCB->MaxHeight / 2, 0.5);
+      else if ((i = step - 5) < n_pan)
+        ghid_pan_view_rel (pan[i][0] * gport->view.width / 4,
+                           pan[i][1] * gport->view.height / 4);
+      else
+        ghid_zoom_view_rel (PCB->MaxWidth / 2, PCB->MaxHeight / 2, 2.0);
+
+      start = g_get_monotonic_time ();
+      benchmark_redraw ();
+      usec = g_get_monotonic_time () - start;
+      total += usec;
+      worst = MAX (worst, usec);
+      views++;
+    }
+
+  printf (_("%d views, %.1f ms average, %.1f ms slowest\n"),
+          views, total / 1000.0 / views, worst / 1000.0);
+
+  ghid_zoom_view_abs (SIDE_X (0), SIDE_Y (0), zoom);
+  gport->view.x0 = x0;
+  gport->view.y0 = y0;
+  pan_common (gport);
+
+  return 0;
+}
+
 static int
 Benchmark (int argc, char **argv, Coord x, Coord y)
 {
@@ -1714,6 +1780,11 @@ Benchmark (int argc, char **argv, Coord x, Coord y)
   time_t start, end;
   GdkDisplay *display;
 
+  if (argc == 1 && strcasecmp (argv[0], "PanZoom") == 0)
+    return benchmark_pan_zoom ();
+  if (argc != 0)
+    AFAIL (benchmark);
+
   display = gdk_drawable_get_display (gport->drawable);
 
   gdk_display_sync (display);
@@ -1735,6 +1806,101 @@ Benchmark (int argc, char **argv, Coord x, Coord y)
 
 /* ------------------------------------------------------------ */
 
+/* the frame statistics of FrameStats () */
+static struct
+{
+  gboolean on;
+  int frames;
+  gint64 usec, worst_usec;
+  gint64 since;                 /* when they were last reported */
+} frame_stats;
+
+static void
+clear_frame_stats (void)
+{
+  memset (DrawLayerObjects, 0, sizeof (DrawLayerObjects));
+  ghid_renderer_stats (NULL);
+  frame_stats.frames = 0;
+  frame_stats.usec = frame_stats.worst_usec = 0;
+  frame_stats.since = g_get_monotonic_time ();
+}
+
+/*!
+ * \brief Count a frame drawn by the renderer in usec microseconds, and
+ * report the frames of the last second to the log if FrameStats () is on.
+ */
+void
+ghid_note_frame (gint64 usec)
+{
+  gint64 now;
+  GString *text;
+  int i;
+
+  if (!frame_stats.on)
+    return;
+
+  frame_stats.frames++;
+  frame_stats.usec += usec;
+  frame_stats.worst_usec = MAX (frame_stats.worst_usec, usec);
+  now = g_get_monotonic_time ();
+  if (now - frame_stats.since < G_USEC_PER_SEC)
+    return;
+
+  text = g_string_new ("");
+  g_string_printf (text, _("%d frames in %.1f s, %.1f ms average, "
+                           "%.1f ms slowest"),
+                   frame_stats.frames, (now - frame_stats.since) / 1e6,
+                   frame_stats.usec / 1000.0 / frame_stats.frames,
+                   frame_stats.worst_usec / 1000.0);
+  ghid_renderer_stats (text);
+  for (i = 0; i < max_copper_layer + 2; i++)
+    if (DrawLayerObjects[i] != 0)
+      g_string_append_printf (text, _("; %lu objects on %s"),
+                              DrawLayerObjects[i],
+                              PCB->Data->Layer[i].Name ?
+                              PCB->Data->Layer[i].Name : "?");
+  Message ("%s\n", text->str);
+  g_string_free (text, TRUE);
+
+  clear_frame_stats ();
+}
+
+static const char framestats_syntax[] =
+"FrameStats([On|Off])\n";
+
+static const char framestats_help[] =
+N_("Report the time and work of the redraws of the board to the log.");
+
+/* %start-doc actions FrameStats
+
+Turns the frame statistics on or off, or toggles them without an
+argument.  While they are on, a line a second goes to the log with the
+number of redraws, their average and slowest time, and the number of
+objects drawn on each layer.  The OpenGL renderer also reports the
+triangles and batches it handed to OpenGL, the round lines, arcs and
+circles it drew with its shader, and how many polygon tessellations it
+found kept from before and how many it had to make.
+
+%end-doc */
+
+static int
+FrameStats (int argc, char **argv, Coord x, Coord y)
+{
+  if (argc == 0)
+    frame_stats.on = !frame_stats.on;
+  else if (argc == 1 && strcasecmp (argv[0], "On") == 0)
+    frame_stats.on = TRUE;
+  else if (argc == 1 && strcasecmp (argv[0], "Off") == 0)
+    frame_stats.on = FALSE;
+  else
+    AFAIL (framestats);
+
+  clear_frame_stats ();
+  return 0;
+}
+
+/* ------------------------------------------------------------ */
+
 static const char center_syntax[] =
 "Center()\n";
 
@@ -2222,6 +2388,7 @@ HID_Action ghid_main_action_list[] = {
   {"Cursor", 0, CursorAction, cursor_help, cursor_syntax},
   {"DoWindows", 0, DoWindows, dowindows_help, dowindows_syntax},
   {"Export", 0, Export, export_help, export_syntax},
+  {"FrameStats", 0, FrameStats, framestats_help, framestats_syntax},
   {"GetXY", 0, GetXY, getxy_help, getxy_syntax},
   {"ImportGUI", 0, ImportGUI, importgui_help, importgui_syntax},
   {"LayerGroupsChanged", 0, LayerGroupsChanged},
@@ -1488,6 +1488,7 @@ config_layers_apply (void)
 	  return;
 	}
       PCB->LayerGroups = layer_groups;
+      LayerStackChanged ();
       ghid_invalidate_all();
       groups_modified = FALSE;
     }
@@ -40,6 +40,7 @@
 #include "undo.h"
 #include "set.h"
 #include "gui.h"
+#include "job.h"
 #include "gui-drc-window.h"
 
 #ifdef HAVE_LIBDMALLOC
@@ -50,9 +51,16 @@
 #define VIOLATION_PIXMAP_PIXEL_BORDER 5
 #define VIOLATION_PIXMAP_PCB_SIZE     MIL_TO_COORD (100)
 
+/* Previews kept for rows that scrolled out of view */
+#define DRC_PREVIEW_CACHE_SIZE 64
+
 static GtkWidget *drc_window, *drc_list;
 static GtkListStore *drc_list_model = NULL;
 static int num_violations = 0;
+/* The GhidDrcViolation rows of drc_list_model */
+static GPtrArray *drc_rows = NULL;
+/* The rows with a preview, oldest first */
+static GQueue drc_previews = G_QUEUE_INIT;
 
 /* Remember user window resizes. */
 static gint
@@ -123,11 +131,11 @@ selection_changed_cb (GtkTreeSelection *selection, gpointer user_data)
   if (gviolation == NULL)
     return;
 
-  set_flag_on_violating_objects(gviolation->v, FOUNDFLAG);
+  set_flag_on_violating_objects(&gviolation->v, FOUNDFLAG);
   IncrementUndoSerialNumber ();
   Draw ();
 
-  CenterDisplay (gviolation->v->x, gviolation->v->y, false);
+  CenterDisplay (gviolation->v.x, gviolation->v.y, false);
 }
 
 static void
@@ -145,304 +153,143 @@ row_activated_cb (GtkTreeView *view, GtkTreePath *path,
   if (gviolation == NULL)
     return;
 
-  CenterDisplay (gviolation->v->x, gviolation->v->y, true);
+  CenterDisplay (gviolation->v.x, gviolation->v.y, true);
   gtk_window_present (GTK_WINDOW (gport->top_window));
 }
 
-enum
-{
-  PROP_TITLE = 1,
-  PROP_EXPLANATION,
-  PROP_X_COORD,
-  PROP_Y_COORD,
-  PROP_ANGLE,
-  PROP_HAVE_MEASURED,
-  PROP_MEASURED_VALUE,
-  PROP_REQUIRED_VALUE,
-  PROP_OBJECT_LIST,
-  PROP_PIXMAP
-};
-
-
-static GObjectClass *ghid_drc_violation_parent_class = NULL;
-
-
-/*! \brief GObject finalise handler
+/*! \brief Makes a row of the DRC window for a violation.
  *
  *  \par Function Description
- *  Just before the GhidDrcViolation GObject is finalized, free our
- *  allocated data, and then chain up to the parent's finalize handler.
+ *  The row copies the violation, and shares its object list, which the
+ *  DRC doesn't change.  The markup and the preview are made when the
+ *  row is first drawn.
  *
- *  \param [in] widget  The GObject being finalized.
+ *  \param [in] violation  The violation.
+ *  \return  The new row.
  */
-static void
-ghid_drc_violation_finalize (GObject * object)
+static GhidDrcViolation *
+ghid_drc_violation_new (DrcViolationType *violation)
 {
-  GhidDrcViolation *gviolation = GHID_DRC_VIOLATION (object);
-
-  pcb_drc_violation_free(gviolation->v);
-  
-  if (gviolation->pixmap != NULL)
-    g_object_unref (gviolation->pixmap);
+  GhidDrcViolation *gv = g_slice_new0 (GhidDrcViolation);
 
-  G_OBJECT_CLASS (ghid_drc_violation_parent_class)->finalize (object);
+  gv->v = *violation;
+  gv->v.title = g_strdup (violation->title);
+  gv->v.explanation = g_strdup (violation->explanation);
+  gv->v.objects = violation->objects ? object_list_ref (violation->objects)
+				     : NULL;
+  return gv;
 }
 
-typedef struct ghid_drc_object_list
-{
-  int count;
-  long int *id_list;
-  int *type_list;
-} ghid_drc_object_list;
-
-/*! \brief GObject property setter function
- *
- *  \par Function Description
- *  Setter function for GhidDrcViolation's GObject properties,
- *  "settings-name" and "toplevel"
- *
- *  \param [in]  object       The GObject whose properties we are setting
- *  \param [in]  property_id  The numeric id. under which the property was
- *                            registered with g_object_class_install_property()
- *  \param [in]  value        The GValue the property is being set from
- *  \param [in]  pspec        A GParamSpec describing the property being set
- */
 static void
-ghid_drc_violation_set_property (GObject * object, guint property_id,
-				  const GValue * value, GParamSpec * pspec)
+ghid_drc_violation_free (gpointer data)
 {
-  GhidDrcViolation *gviolation = GHID_DRC_VIOLATION (object);
-  object_list *obj_list;
-
-  switch (property_id)
-    {
-    case PROP_TITLE:
-      if (gviolation->v->title) g_free (gviolation->v->title);
-      gviolation->v->title = g_value_dup_string (value);
-      break;
-
-    case PROP_EXPLANATION:
-      if (gviolation->v->explanation) g_free (gviolation->v->explanation);
-      gviolation->v->explanation = g_value_dup_string (value);
-      break;
-
-    case PROP_X_COORD:
-      gviolation->v->x = g_value_get_int (value);
-      break;
-
-    case PROP_Y_COORD:
-      gviolation->v->y = g_value_get_int (value);
-      break;
-
-    case PROP_ANGLE:
-      gviolation->v->angle = g_value_get_double (value);
-      break;
-
-    case PROP_HAVE_MEASURED:
-      gviolation->v->have_measured = g_value_get_boolean (value);
-      break;
-
-    case PROP_MEASURED_VALUE:
-      gviolation->v->measured_value = g_value_get_int (value);
-      break;
-
-    case PROP_REQUIRED_VALUE:
-      gviolation->v->required_value = g_value_get_int (value);
-      break;
-
-    case PROP_OBJECT_LIST:
-      if (gviolation->v->objects) object_list_delete(gviolation->v->objects);
-      obj_list = (object_list *)g_value_get_pointer (value);
-      gviolation->v->objects = object_list_duplicate(obj_list);
-      break;
-
-    case PROP_PIXMAP:
-      if (gviolation->pixmap)
-	    g_object_unref (gviolation->pixmap); /* Frees our old reference */
-      gviolation->pixmap = (GdkDrawable *)g_value_dup_object (value); /* Takes a new reference */
-      break;
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
-      return;
-    }
+  GhidDrcViolation *gv = (GhidDrcViolation *) data;
+
+  g_free (gv->v.title);
+  g_free (gv->v.explanation);
+  if (gv->v.objects)
+    object_list_delete (gv->v.objects);
+  g_free (gv->markup);
+  if (gv->pixmap != NULL)
+    g_object_unref (gv->pixmap);
+  g_slice_free (GhidDrcViolation, gv);
 }
 
-
-/*! \brief GObject property getter function
+/*! \brief Lets go of all rows of the DRC window.
  *
  *  \par Function Description
- *  Getter function for GhidDrcViolation's GObject properties,
- *  "settings-name" and "toplevel".
- *
- *  \param [in]  object       The GObject whose properties we are getting
- *  \param [in]  property_id  The numeric id. under which the property was
- *                            registered with g_object_class_install_property()
- *  \param [out] value        The GValue in which to return the value of the property
- *  \param [in]  pspec        A GParamSpec describing the property being got
+ *  The rows live as long as the list model shows them, so this is only
+ *  called once the model has been cleared or is gone.
  */
 static void
-ghid_drc_violation_get_property (GObject * object, guint property_id,
-				 GValue * value, GParamSpec * pspec)
+drc_rows_clear (void)
 {
-  switch (property_id)
-    {
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
-    }
-
+  g_queue_clear (&drc_previews);
+  if (drc_rows != NULL)
+    g_ptr_array_set_size (drc_rows, 0);
 }
 
-
-/*! \brief GType class initialiser for GhidDrcViolation
+/*! \brief Gets the markup of the text of a row.
  *
  *  \par Function Description
- *  GType class initialiser for GhidDrcViolation. We override our parent
- *  virtual class methods as needed and register our GObject properties.
- *
- *  \param [in]  klass       The GhidDrcViolationClass we are initialising
+ *  The markup is made the first time, and again when the grid unit
+ *  it shows the values in has changed.
  */
-static void
-ghid_drc_violation_class_init (GhidViolationRendererClass * klass)
+static const char *
+ghid_drc_violation_markup (GhidDrcViolation *gv)
 {
-  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
-
-  gobject_class->finalize = ghid_drc_violation_finalize;
-  gobject_class->set_property = ghid_drc_violation_set_property;
-  gobject_class->get_property = ghid_drc_violation_get_property;
-
-  ghid_drc_violation_parent_class = (GObjectClass *)g_type_class_peek_parent (klass);
-
-  g_object_class_install_property (gobject_class, PROP_TITLE,
-				   g_param_spec_string ("title",
-							"",
-							"",
-							"",
-							G_PARAM_WRITABLE));
-  g_object_class_install_property (gobject_class, PROP_EXPLANATION,
-				   g_param_spec_string ("explanation",
-							"",
-							"",
-							"",
-							G_PARAM_WRITABLE));
-  g_object_class_install_property (gobject_class, PROP_X_COORD,
-				   g_param_spec_int ("x-coord",
-						     "",
-						     "",
-						     G_MININT,
-						     G_MAXINT,
-						     0,
-						     G_PARAM_WRITABLE));
-  g_object_class_install_property (gobject_class, PROP_Y_COORD,
-				   g_param_spec_int ("y-coord",
-						     "",
-						     "",
-						     G_MININT,
-						     G_MAXINT,
-						     0,
-						     G_PARAM_WRITABLE));
-  g_object_class_install_property (gobject_class, PROP_ANGLE,
-				   g_param_spec_double ("angle",
-						     "",
-						     "",
-						     G_MININT,
-						     G_MAXINT,
-						     0,
-						     G_PARAM_WRITABLE));
-  g_object_class_install_property (gobject_class, PROP_HAVE_MEASURED,
-				   g_param_spec_boolean ("have-measured",
-						     "",
-						     "",
-						     0,
-						     G_PARAM_WRITABLE));
-  g_object_class_install_property (gobject_class, PROP_MEASURED_VALUE,
-				   g_param_spec_int ("measured-value",
-						     "",
-						     "",
-						     G_MININT,
-						     G_MAXINT,
-						     0.,
-						     G_PARAM_WRITABLE));
-  g_object_class_install_property (gobject_class, PROP_REQUIRED_VALUE,
-				   g_param_spec_int ("required-value",
-						     "",
-						     "",
-						     G_MININT,
-						     G_MAXINT,
-						     0.,
-						     G_PARAM_WRITABLE));
-  g_object_class_install_property (gobject_class, PROP_OBJECT_LIST,
-				   g_param_spec_pointer ("object-list",
-							 "",
-							 "",
-							 G_PARAM_WRITABLE));
-  g_object_class_install_property (gobject_class, PROP_PIXMAP,
-				   g_param_spec_object ("pixmap",
-							"",
-							"",
-							GDK_TYPE_DRAWABLE,
-							G_PARAM_WRITABLE));
-}
+  if (gv->markup != NULL && gv->markup_unit == Settings.grid_unit)
+    return gv->markup;
 
+  g_free (gv->markup);
+  gv->markup_unit = Settings.grid_unit;
 
+  if (gv->v.have_measured)
+    {
+      gv->markup = pcb_g_strdup_printf (_("%m+<b>%s (%$mS)</b>\n"
+				"<span size='1024'> </span>\n"
+				"<small>"
+				  "<i>%s</i>\n"
+				  "<span size='5120'> </span>\n"
+				  "Required: %$mS"
+				"</small>"),
+                                Settings.grid_unit->allow,
+				gv->v.title,
+				gv->v.measured_value,
+				gv->v.explanation,
+				gv->v.required_value);
+    }
+  else
+    {
+      gv->markup = pcb_g_strdup_printf (_("%m+<b>%s</b>\n"
+				"<span size='1024'> </span>\n"
+				"<small>"
+				  "<i>%s</i>\n"
+				  "<span size='5120'> </span>\n"
+				  "Required: %$mS"
+				"</small>"),
+                                Settings.grid_unit->allow,
+				gv->v.title,
+				gv->v.explanation,
+				gv->v.required_value);
+    }
+  return gv->markup;
+}
 
-/*! \brief Function to retrieve GhidViolationRenderer's GType identifier.
+/*! \brief Gets the preview of a row, rendering it when it has none.
  *
  *  \par Function Description
- *  Function to retrieve GhidViolationRenderer's GType identifier.
- *  Upon first call, this registers the GhidViolationRenderer in the GType system.
- *  Subsequently it returns the saved value from its first execution.
- *
- *  \return the GType identifier associated with GhidViolationRenderer.
+ *  Only rows that are drawn get a preview, and only the last
+ *  DRC_PREVIEW_CACHE_SIZE ones rendered keep theirs; a row scrolled
+ *  back into view renders its preview again.
  */
-GType
-ghid_drc_violation_get_type ()
+static GdkDrawable *
+ghid_drc_violation_preview (GhidDrcViolation *gv, GdkDrawable *window)
 {
-  static GType ghid_drc_violation_type = 0;
-
-  if (!ghid_drc_violation_type)
+  int pixmap_size = VIOLATION_PIXMAP_PIXEL_SIZE - 2 * VIOLATION_PIXMAP_PIXEL_BORDER;
+  GhidDrcViolation *oldest;
+
+  if (gv->pixmap != NULL)
+    return gv->pixmap;
+  /* the board is a background job's until it ends */
+  if (pcb_job_busy ())
+    return NULL;
+
+  gv->pixmap = (GdkDrawable *) ghid_render_pixmap (gv->v.x, gv->v.y,
+				VIOLATION_PIXMAP_PCB_SIZE / pixmap_size,
+				pixmap_size, pixmap_size,
+				gdk_drawable_get_depth (window));
+  if (gv->pixmap == NULL)
+    return NULL;
+
+  g_queue_push_tail (&drc_previews, gv);
+  if (g_queue_get_length (&drc_previews) > DRC_PREVIEW_CACHE_SIZE)
     {
-      static const GTypeInfo ghid_drc_violation_info = {
-	sizeof (GhidDrcViolationClass),
-	NULL,			/* base_init */
-	NULL,			/* base_finalize */
-	(GClassInitFunc) ghid_drc_violation_class_init,
-	NULL,			/* class_finalize */
-	NULL,			/* class_data */
-	sizeof (GhidDrcViolation),
-	0,			/* n_preallocs */
-	NULL,			/* instance_init */
-      };
-
-      ghid_drc_violation_type =
-	g_type_register_static (G_TYPE_OBJECT, "GhidDrcViolation",
-				&ghid_drc_violation_info, (GTypeFlags)0);
+      oldest = (GhidDrcViolation *) g_queue_pop_head (&drc_previews);
+      g_object_unref (oldest->pixmap);
+      oldest->pixmap = NULL;
     }
-
-  return ghid_drc_violation_type;
-}
-
-
-GhidDrcViolation *ghid_drc_violation_new (DrcViolationType *violation,
-					  GdkDrawable *pixmap)
-{
-
-  GhidDrcViolation * gv = 
-      (GhidDrcViolation *)g_object_new (GHID_TYPE_DRC_VIOLATION, NULL);
-
-  gv->v = (DrcViolationType*) malloc(sizeof(DrcViolationType));
-  g_object_set (gv,
-               "title",            violation->title,
-               "explanation",      violation->explanation,
-               "x-coord",          violation->x,
-               "y-coord",          violation->y,
-               "angle",            violation->angle,
-               "have-measured",    violation->have_measured,
-               "measured-value",   violation->measured_value,
-               "required-value",   violation->required_value,
-               "object-list",      violation->objects,
-               "pixmap",           pixmap,
-               NULL);
-  return gv;
+  return gv->pixmap;
 }
 
 enum
@@ -465,11 +312,6 @@ static GObjectClass *ghid_violation_renderer_parent_class = NULL;
 static void
 ghid_violation_renderer_finalize (GObject * object)
 {
-  GhidViolationRenderer *renderer = GHID_VIOLATION_RENDERER (object);
-
-  if (renderer->violation != NULL)
-    g_object_unref (renderer->violation);
-
   G_OBJECT_CLASS (ghid_violation_renderer_parent_class)->finalize (object);
 }
 
@@ -491,14 +333,12 @@ ghid_violation_renderer_set_property (GObject * object, guint property_id,
 				  const GValue * value, GParamSpec * pspec)
 {
   GhidViolationRenderer *renderer = GHID_VIOLATION_RENDERER (object);
-  char *markup;
 
   switch (property_id)
     {
     case PROP_VIOLATION:
-      if (renderer->violation != NULL)
-	g_object_unref (renderer->violation);
-      renderer->violation = (GhidDrcViolation *)g_value_dup_object (value);
+      /* The row belongs to the window, not to the renderer */
+      renderer->violation = (GhidDrcViolation *)g_value_get_pointer (value);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -508,38 +348,9 @@ ghid_violation_renderer_set_property (GObject * object, guint property_id,
   if (renderer->violation == NULL)
     return;
 
-  if (renderer->violation->v->have_measured)
-    {
-      markup = pcb_g_strdup_printf (_("%m+<b>%s (%$mS)</b>\n"
-				"<span size='1024'> </span>\n"
-				"<small>"
-				  "<i>%s</i>\n"
-				  "<span size='5120'> </span>\n"
-				  "Required: %$mS"
-				"</small>"),
-                                Settings.grid_unit->allow,
-				renderer->violation->v->title,
-				renderer->violation->v->measured_value,
-				renderer->violation->v->explanation,
-				renderer->violation->v->required_value);
-    }
-  else
-    {
-      markup = pcb_g_strdup_printf (_("%m+<b>%s</b>\n"
-				"<span size='1024'> </span>\n"
-				"<small>"
-				  "<i>%s</i>\n"
-				  "<span size='5120'> </span>\n"
-				  "Required: %$mS"
-				"</small>"),
-                                Settings.grid_unit->allow,
-				renderer->violation->v->title,
-				renderer->violation->v->explanation,
-				renderer->violation->v->required_value);
-    }
-
-  g_object_set (object, "markup", markup, NULL);
-  g_free (markup);
+  g_object_set (object,
+		"markup", ghid_drc_violation_markup (renderer->violation),
+		NULL);
 }
 
 
@@ -602,7 +413,6 @@ ghid_violation_renderer_render (GtkCellRenderer      *cell,
   GtkStyle *style = gtk_widget_get_style (widget);
   GhidViolationRenderer *renderer = GHID_VIOLATION_RENDERER (cell);
   GhidDrcViolation *gviolation = renderer->violation;
-  int pixmap_size = VIOLATION_PIXMAP_PIXEL_SIZE - 2 * VIOLATION_PIXMAP_PIXEL_BORDER;
 
   cell_area->width -= VIOLATION_PIXMAP_PIXEL_SIZE;
   GTK_CELL_RENDERER_CLASS (ghid_violation_renderer_parent_class)->render (cell,
@@ -616,22 +426,10 @@ ghid_violation_renderer_render (GtkCellRenderer      *cell,
   if (gviolation == NULL)
     return;
 
-  if (gviolation->pixmap == NULL)
-    {
-      GdkPixmap *pixmap = ghid_render_pixmap (gviolation->v->x,
-					      gviolation->v->y,
-					      VIOLATION_PIXMAP_PCB_SIZE / pixmap_size,
-					      pixmap_size, pixmap_size,
-					      gdk_drawable_get_depth (window));
-      g_object_set (gviolation, "pixmap", pixmap, NULL);
-      g_object_unref (pixmap);
-    }
-
-  if (gviolation->pixmap == NULL)
+  mydrawable = ghid_drc_violation_preview (gviolation, window);
+  if (mydrawable == NULL)
     return;
 
-  mydrawable = GDK_DRAWABLE (gviolation->pixmap);
-
   gdk_draw_drawable (window, style->fg_gc[gtk_widget_get_state (widget)],
 		     mydrawable, 0, 0,
 		     cell_area->x + cell_area->width + VIOLATION_PIXMAP_PIXEL_BORDER,
@@ -663,11 +461,10 @@ ghid_violation_renderer_class_init (GhidViolationRendererClass * klass)
   ghid_violation_renderer_parent_class = (GObjectClass *)g_type_class_peek_parent (klass);
 
   g_object_class_install_property (gobject_class, PROP_VIOLATION,
-				   g_param_spec_object ("violation",
-							"",
-							"",
-							GHID_TYPE_DRC_VIOLATION,
-							G_PARAM_WRITABLE));
+				   g_param_spec_pointer ("violation",
+							 "",
+							 "",
+							 G_PARAM_WRITABLE));
 }
 
 
@@ -756,9 +553,17 @@ ghid_drc_window_show (gboolean raise)
   gtk_container_set_border_width (GTK_CONTAINER (vbox), 6);
   gtk_box_set_spacing (GTK_BOX (vbox), 6);
 
+  /* The rows of a window closed before are gone with its model */
+  if (drc_list_model != NULL)
+    g_object_unref (drc_list_model);
+  drc_rows_clear ();
+  if (drc_rows == NULL)
+    drc_rows = g_ptr_array_new_with_free_func (ghid_drc_violation_free);
+  num_violations = 0;
+
   drc_list_model = gtk_list_store_new (NUM_DRC_COLUMNS,
 				       G_TYPE_INT,      /* DRC_VIOLATION_NUM_COL */
-				       G_TYPE_OBJECT);  /* DRC_VIOLATION_OBJ_COL */
+				       G_TYPE_POINTER); /* DRC_VIOLATION_OBJ_COL */
 
   scrolled_window = gtk_scrolled_window_new (NULL, NULL);
   gtk_box_pack_start (GTK_BOX (vbox), scrolled_window,
@@ -819,9 +624,15 @@ ghid_drc_window_show (gboolean raise)
   gtk_widget_show_all (drc_window);
 }
 
+/*! \brief Adds a violation to the DRC window.
+ *
+ *  \par Function Description
+ *  The DRC calls this for each violation as it finds it, so the row
+ *  is kept cheap; its text and preview wait until it is drawn.
+ */
 void ghid_drc_window_append_violation (DrcViolationType *violation)
 {
-  GhidDrcViolation *violation_obj;
+  GhidDrcViolation *gviolation;
   GtkTreeIter iter;
 
   /* Ensure the required structures are setup */
@@ -829,21 +640,20 @@ void ghid_drc_window_append_violation (DrcViolationType *violation)
 
   num_violations++;
 
-  violation_obj = ghid_drc_violation_new (violation, /* pixmap */ NULL);
-
-  gtk_list_store_append (drc_list_model, &iter);
-  gtk_list_store_set (drc_list_model, &iter,
-		      DRC_VIOLATION_NUM_COL, num_violations,
-		      DRC_VIOLATION_OBJ_COL, violation_obj,
-		      -1);
+  gviolation = ghid_drc_violation_new (violation);
+  g_ptr_array_add (drc_rows, gviolation);
 
-  g_object_unref (violation_obj); /* The list store takes its own reference */
+  gtk_list_store_insert_with_values (drc_list_model, &iter, -1,
+				     DRC_VIOLATION_NUM_COL, num_violations,
+				     DRC_VIOLATION_OBJ_COL, gviolation,
+				     -1);
 }
 
 void ghid_drc_window_reset_message (void)
 {
   if (drc_list_model != NULL)
     gtk_list_store_clear (drc_list_model);
+  drc_rows_clear ();
   num_violations = 0;
 }
 
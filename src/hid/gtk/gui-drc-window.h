@@ -30,41 +30,25 @@
 #include "drc/drc_violation.h"
 
 /*
- * GhidDrcViolationClass
- * A GObject based class used for keeping track and displaying DRC violations.
+ * GhidDrcViolation
+ * A plain structure for the rows of the DRC window, kept light as a DRC
+ * may find thousands of violations.
  *
- * This is basically just a copy of the structure from find.c/drc.c with an
- * extra pointer for the image.
+ * This is basically just a copy of the structure from find.c/drc.c with
+ * the markup and the image, which are only made when the row is drawn.
+ * The rows belong to the window.
  */
-#define GHID_TYPE_DRC_VIOLATION           (ghid_drc_violation_get_type())
-#define GHID_DRC_VIOLATION(obj)           (G_TYPE_CHECK_INSTANCE_CAST ((obj), GHID_TYPE_DRC_VIOLATION, GhidDrcViolation))
-#define GHID_DRC_VIOLATION_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST ((klass),  GHID_TYPE_DRC_VIOLATION, GhidDrcViolationClass))
-#define GHID_IS_DRC_VIOLATION(obj)        (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GHID_TYPE_DRC_VIOLATION))
-#define GHID_DRC_VIOLATION_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS ((obj),  GHID_TYPE_DRC_VIOLATION, GhidDrcViolationClass))
-
-typedef struct _GhidDrcViolationClass GhidDrcViolationClass;
 typedef struct _GhidDrcViolation GhidDrcViolation;
 
-
-struct _GhidDrcViolationClass
-{
-  GObjectClass parent_class;
-};
-
 struct _GhidDrcViolation
 {
-  GObject parent_instance;
-  DrcViolationType * v;
+  DrcViolationType v;
+  char *markup;
+  const Unit *markup_unit;
   GdkDrawable *pixmap;
 };
 
 
-GType ghid_drc_violation_get_type (void);
-
-GhidDrcViolation *ghid_drc_violation_new (DrcViolationType *violation,
-					  GdkDrawable *pixmap);
-
-
 /*
  * GhidViolationRenderer
  * A GObject based class for rendering an image of the objects in a DRC
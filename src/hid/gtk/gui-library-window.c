@@ -107,10 +107,44 @@ enum
   MENU_NAME_COLUMN,		/* Text to display in the tree     */
   MENU_LIBRARY_COLUMN,		/* Pointer to the LibraryMenuType  */
   MENU_ENTRY_COLUMN,		/* Pointer to the LibraryEntryType */
+  MENU_INDEX_COLUMN,		/* Row of the filter index         */
   N_MENU_COLUMNS
 };
 
 
+/*! \brief The index the footprint filter searches.
+ *  \par Function Description
+ *  The index has a row for each row of the library tree, numbered in
+ *  the order they were added, so a folder comes before anything in
+ *  it.  A row keeps the upper case name shown in the tree, and for a
+ *  footprint its upper case description, and every trigram of those
+ *  of the rows without children lists the rows it appears in.
+ *
+ *  The index does not change once built, and is shared with the filter
+ *  jobs by reference counting, so a job may go on with it while the
+ *  model is rebuilt.
+ */
+struct lib_filter_index
+{
+  gint refs;
+  GPtrArray *names;		/* gchar *, for each row                 */
+  GPtrArray *descriptions;	/* gchar *, or NULL, for each row        */
+  GArray *parents;		/* gint, the row of the folder, or -1    */
+  GArray *has_children;		/* gboolean, for each row                */
+  GHashTable *trigrams;		/* trigram -> GArray of gint rows        */
+};
+
+/*! \brief A search of the filter index by a filter thread. */
+typedef struct
+{
+  GhidLibraryWindow *library_window;
+  struct lib_filter_index *index;
+  gchar *text;
+  gint generation;
+  guint8 *visible;		/* the result, one flag for each row */
+} LibFilterJob;
+
+
 /*! \brief Process the response returned by the library dialog.
  *  \par Function Description
  *  This function handles the response <B>arg1</B> of the library
@@ -213,11 +247,200 @@ ghid_library_window_show (GHidPort * out, gboolean raise)
 static GObjectClass *library_window_parent_class = NULL;
 
 
+/*! \brief Creates an empty filter index. */
+static struct lib_filter_index *
+lib_filter_index_new (void)
+{
+  struct lib_filter_index *index = g_new0 (struct lib_filter_index, 1);
+
+  index->refs = 1;
+  index->names = g_ptr_array_new_with_free_func (g_free);
+  index->descriptions = g_ptr_array_new_with_free_func (g_free);
+  index->parents = g_array_new (FALSE, FALSE, sizeof (gint));
+  index->has_children = g_array_new (FALSE, FALSE, sizeof (gboolean));
+  index->trigrams = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					   NULL, (GDestroyNotify) g_array_unref);
+  return index;
+}
+
+static struct lib_filter_index *
+lib_filter_index_ref (struct lib_filter_index *index)
+{
+  g_atomic_int_inc (&index->refs);
+  return index;
+}
+
+static void
+lib_filter_index_unref (struct lib_filter_index *index)
+{
+  if (index == NULL || !g_atomic_int_dec_and_test (&index->refs))
+    return;
+  g_ptr_array_unref (index->names);
+  g_ptr_array_unref (index->descriptions);
+  g_array_unref (index->parents);
+  g_array_unref (index->has_children);
+  g_hash_table_destroy (index->trigrams);
+  g_free (index);
+}
+
+/*! \brief Adds a row of the library tree to the filter index.
+ *
+ *  \param [in] index       The index being built.
+ *  \param [in] parent      The row of the folder of the row, or -1.
+ *  \param [in] name        The text shown in the tree for the row.
+ *  \param [in] description The description of a footprint, or NULL.
+ *  \returns the number of the new row.
+ */
+static gint
+lib_filter_index_add (struct lib_filter_index *index, gint parent,
+		      const gchar *name, const gchar *description)
+{
+  gboolean no = FALSE;
+  gint row = index->names->len;
+
+  g_ptr_array_add (index->names, g_ascii_strup (name, -1));
+  g_ptr_array_add (index->descriptions,
+		   description ? g_ascii_strup (description, -1) : NULL);
+  g_array_append_val (index->parents, parent);
+  g_array_append_val (index->has_children, no);
+  if (parent >= 0)
+    g_array_index (index->has_children, gboolean, parent) = TRUE;
+  return row;
+}
+
+#define TRIGRAM(s) GUINT_TO_POINTER (((guint) (guchar) (s)[0] << 16) \
+				     | ((guint) (guchar) (s)[1] << 8) \
+				     | (guint) (guchar) (s)[2])
+
+/*! \brief Lists a row under each trigram of a text. */
+static void
+lib_filter_index_text (struct lib_filter_index *index, gint row,
+		       const gchar *text)
+{
+  GArray *rows;
+  gsize i, len;
+
+  if (text == NULL)
+    return;
+  len = strlen (text);
+  for (i = 0; i + 3 <= len; i++)
+    {
+      rows = (GArray *) g_hash_table_lookup (index->trigrams,
+					     TRIGRAM (text + i));
+      if (rows == NULL)
+	{
+	  rows = g_array_new (FALSE, FALSE, sizeof (gint));
+	  g_hash_table_insert (index->trigrams, TRIGRAM (text + i), rows);
+	}
+      /* rows are indexed in order, so a repeat is always the last one */
+      if (rows->len == 0 || g_array_index (rows, gint, rows->len - 1) != row)
+	g_array_append_val (rows, row);
+    }
+}
+
+/*! \brief Indexes the trigrams of the rows once all rows are in.
+ *  \par Function Description
+ *  Only rows without children are ever matched against the filter
+ *  text, so only those are listed.
+ */
+static void
+lib_filter_index_finish (struct lib_filter_index *index)
+{
+  gint row;
+
+  for (row = 0; row < (gint) index->names->len; row++)
+    {
+      if (g_array_index (index->has_children, gboolean, row))
+	continue;
+      lib_filter_index_text (index, row,
+			     (gchar *) g_ptr_array_index (index->names, row));
+      lib_filter_index_text (index, row, (gchar *)
+			     g_ptr_array_index (index->descriptions, row));
+    }
+}
+
+/*! \brief Searches the filter index for a filter text.
+ *  \par Function Description
+ *  A footprint matches if the text is found in its name or its
+ *  description, ignoring case, with the '*' and '?' of the text being
+ *  wildcards.  A folder is visible when anything in it matches.
+ *
+ *  Every run of three characters that are not wildcards must be in a
+ *  match, so only the rows listed under the rarest of those trigrams
+ *  are tried, and all of them when the text has none.
+ *
+ *  This runs in the filter thread, and uses nothing but the index.
+ *
+ *  \param [in] index The filter index.
+ *  \param [in] text  The filter text.
+ *  \returns a newly allocated flag for each row of the index, TRUE
+ *  for the visible ones.
+ */
+static guint8 *
+lib_filter_index_search (struct lib_filter_index *index, const gchar *text)
+{
+  guint8 *visible = g_new0 (guint8, MAX (1, index->names->len));
+  gchar *text_upper, *pattern;
+  GPatternSpec *spec;
+  GArray *rows, *best = NULL;
+  const gchar *p, *name, *description;
+  gint i, n, row, run;
+
+  text_upper = g_ascii_strup (text, -1);
+  for (p = text_upper, run = 0; *p; p++)
+    {
+      if (*p == '*' || *p == '?')
+	{
+	  run = 0;
+	  continue;
+	}
+      if (++run < 3)
+	continue;
+      rows = (GArray *) g_hash_table_lookup (index->trigrams, TRIGRAM (p - 2));
+      if (rows == NULL)
+	{
+	  /* nothing has this trigram, so nothing matches */
+	  g_free (text_upper);
+	  return visible;
+	}
+      if (best == NULL || rows->len < best->len)
+	best = rows;
+    }
+
+  pattern = g_strconcat ("*", text_upper, "*", NULL);
+  spec = g_pattern_spec_new (pattern);
+  n = best ? (gint) best->len : (gint) index->names->len;
+  for (i = 0; i < n; i++)
+    {
+      row = best ? g_array_index (best, gint, i) : i;
+      if (g_array_index (index->has_children, gboolean, row))
+	continue;
+      name = (gchar *) g_ptr_array_index (index->names, row);
+      description = (gchar *) g_ptr_array_index (index->descriptions, row);
+      if (!g_pattern_match_string (spec, name)
+	  && (description == NULL
+	      || !g_pattern_match_string (spec, description)))
+	continue;
+      /* show the footprint, and the folders it is in */
+      for (; row >= 0 && !visible[row];
+	   row = g_array_index (index->parents, gint, row))
+	visible[row] = TRUE;
+    }
+
+  g_pattern_spec_free (spec);
+  g_free (pattern);
+  g_free (text_upper);
+  return visible;
+}
+
 /*! \brief Determines visibility of items of the library treeview.
  *  \par Function Description
  *  This is the function used to filter entries of the footprint
  *  selection tree.
  *
+ *  Everything is visible until a filter thread hands a visible set
+ *  over for the filter text; the rows are looked up in that.
+ *
  *  \param [in] model The current selection in the treeview.
  *  \param [in] iter  An iterator on a footprint or folder in the tree.
  *  \param [in] data  The library dialog.
@@ -228,52 +451,15 @@ lib_model_filter_visible_func (GtkTreeModel * model,
 			       GtkTreeIter * iter, gpointer data)
 {
   GhidLibraryWindow *library_window = (GhidLibraryWindow *) data;
-  const gchar *compname;
-  gchar *compname_upper, *text_upper, *pattern;
-  const gchar *text;
-  gboolean ret;
+  gint row;
 
   g_assert (GHID_IS_LIBRARY_WINDOW (data));
 
-  text = gtk_entry_get_text (library_window->entry_filter);
-  if (g_ascii_strcasecmp (text, "") == 0)
-    {
-      return TRUE;
-    }
-
-  /* If this is a source, only display it if it has children that
-   * match */
-  if (gtk_tree_model_iter_has_child (model, iter))
-    {
-      GtkTreeIter iter2;
-
-      gtk_tree_model_iter_children (model, &iter2, iter);
-      ret = FALSE;
-      do
-	{
-	  if (lib_model_filter_visible_func (model, &iter2, data))
-	    {
-	      ret = TRUE;
-	      break;
-	    }
-	}
-      while (gtk_tree_model_iter_next (model, &iter2));
-    }
-  else
-    {
-      gtk_tree_model_get (model, iter, MENU_NAME_COLUMN, &compname, -1);
-      /* Do a case insensitive comparison, converting the strings
-         to uppercase */
-      compname_upper = g_ascii_strup (compname, -1);
-      text_upper = g_ascii_strup (text, -1);
-      pattern = g_strconcat ("*", text_upper, "*", NULL);
-      ret = g_pattern_match_simple (pattern, compname_upper);
-      g_free (compname_upper);
-      g_free (text_upper);
-      g_free (pattern);
-    }
+  if (library_window->filter_visible == NULL)
+    return TRUE;
 
-  return ret;
+  gtk_tree_model_get (model, iter, MENU_INDEX_COLUMN, &row, -1);
+  return library_window->filter_visible[row];
 }
 
 
@@ -434,11 +620,70 @@ maybe_expand_toplevel_node (GtkTreeView *tree_view)
     }
 }
 
+/*! \brief Shows the visible set of a finished filter job.
+ *  \par Function Description
+ *  This is the idle function through which a filter thread hands the
+ *  result of its search over to the main loop.  A result for a filter
+ *  text or a library index that has since changed is thrown away.
+ *
+ *  \param [in] data The filter job.
+ *  \returns FALSE to remove the idle source.
+ */
+static gboolean
+library_window_filter_done (gpointer data)
+{
+  LibFilterJob *job = (LibFilterJob *) data;
+  GhidLibraryWindow *library_window = job->library_window;
+  GtkTreeModel *model;
+
+  if (job->visible != NULL
+      && job->generation == g_atomic_int_get (&library_window->filter_generation))
+    {
+      g_free (library_window->filter_visible);
+      library_window->filter_visible = job->visible;
+      job->visible = NULL;
+
+      model = gtk_tree_view_get_model (library_window->libtreeview);
+      if (model != NULL)
+	{
+	  gtk_tree_model_filter_refilter ((GtkTreeModelFilter *) model);
+	  gtk_tree_view_expand_all (library_window->libtreeview);
+	}
+    }
+
+  g_free (job->visible);
+  g_free (job->text);
+  lib_filter_index_unref (job->index);
+  g_object_unref (library_window);
+  g_free (job);
+  return FALSE;
+}
+
+/*! \brief Runs a filter job in a filter thread.
+ *  \par Function Description
+ *  A job that has been overtaken by a later filter text before it
+ *  starts skips the search.
+ */
+static void
+library_window_filter_job (gpointer data, gpointer user_data)
+{
+  LibFilterJob *job = (LibFilterJob *) data;
+
+  if (job->generation
+      == g_atomic_int_get (&job->library_window->filter_generation))
+    job->visible = lib_filter_index_search (job->index, job->text);
+  g_idle_add (library_window_filter_done, job);
+}
+
 /*! \brief Requests re-evaluation of the filter.
  *  \par Function Description
  *  This is the timeout function for the filtering of footprint
  *  in the tree of the dialog.
  *
+ *  An empty filter text shows the whole tree at once.  Otherwise the
+ *  filter index is searched for the text in a filter thread, and the
+ *  tree is updated when the search is done.
+ *
  *  The timeout this callback is attached to is removed after the
  *  function.
  *
@@ -450,15 +695,45 @@ library_window_filter_timeout (gpointer data)
 {
   GhidLibraryWindow *library_window = GHID_LIBRARY_WINDOW (data);
   GtkTreeModel *model;
+  LibFilterJob *job;
+  const gchar *text;
 
   /* resets the source id in library_window */
   library_window->filter_timeout = 0;
 
+  /* any search still going on is for an old filter text */
+  g_atomic_int_inc (&library_window->filter_generation);
+
+  text = gtk_entry_get_text (library_window->entry_filter);
+  if (strcmp (text, "") != 0 && library_window->filter_index != NULL)
+    {
+      if (library_window->filter_pool == NULL)
+	library_window->filter_pool =
+	  g_thread_pool_new (library_window_filter_job, NULL, 1, FALSE, NULL);
+      if (library_window->filter_pool != NULL)
+	{
+	  job = g_new0 (LibFilterJob, 1);
+	  job->library_window = GHID_LIBRARY_WINDOW (g_object_ref (library_window));
+	  job->index = lib_filter_index_ref (library_window->filter_index);
+	  job->text = g_strdup (text);
+	  job->generation =
+	    g_atomic_int_get (&library_window->filter_generation);
+	  g_thread_pool_push (library_window->filter_pool, job, NULL);
+	  return FALSE;
+	}
+    }
+
+  g_free (library_window->filter_visible);
+  library_window->filter_visible = NULL;
+  if (strcmp (text, "") != 0 && library_window->filter_index != NULL)
+    /* no thread to be had, so search right here */
+    library_window->filter_visible =
+      lib_filter_index_search (library_window->filter_index, text);
+
   model = gtk_tree_view_get_model (library_window->libtreeview);
 
   if (model != NULL)
     {
-      const gchar *text = gtk_entry_get_text (library_window->entry_filter);
       gtk_tree_model_filter_refilter ((GtkTreeModelFilter *) model);
       if (strcmp (text, "") != 0)
         {
@@ -540,6 +815,8 @@ library_window_callback_filter_button_clicked (GtkButton * button,
  * \par Function Description
  * Creates a tree where the branches are the available library
  * sources and the leaves are the footprints.
+ *
+ * The filter index of the library window is rebuilt along with it.
  */
 static GtkTreeModel *
 create_lib_tree_model (GhidLibraryWindow * library_window)
@@ -548,12 +825,16 @@ create_lib_tree_model (GhidLibraryWindow * library_window)
   char *rel_path, empty_string[] = ""; /* writable */
   GtkTreeIter *iter, p_iter, e_iter, c_iter;
   char *tok_start, *tok_end;
-  gchar *name;
+  gchar *name, *basename;
   gboolean exists;
+  struct lib_filter_index *index;
+  gint parent_row, row;
 
   tree = gtk_tree_store_new (N_MENU_COLUMNS,
 			     G_TYPE_STRING, G_TYPE_STRING,
-			     G_TYPE_STRING, G_TYPE_POINTER, G_TYPE_POINTER);
+			     G_TYPE_STRING, G_TYPE_POINTER, G_TYPE_POINTER,
+			     G_TYPE_INT);
+  index = lib_filter_index_new ();
 
   MENU_LOOP (&Library);
   {
@@ -574,6 +855,7 @@ create_lib_tree_model (GhidLibraryWindow * library_window)
       }
 
     iter = NULL;
+    parent_row = -1;
     tok_start = tok_end = rel_path;
 
     do
@@ -601,19 +883,30 @@ create_lib_tree_model (GhidLibraryWindow * library_window)
 	  while (gtk_tree_model_iter_next (GTK_TREE_MODEL (tree), &e_iter));
 
 	if (exists)
-	  p_iter = e_iter;
+	  {
+	    p_iter = e_iter;
+	    gtk_tree_model_get (GTK_TREE_MODEL (tree), &p_iter,
+				MENU_INDEX_COLUMN, &parent_row, -1);
+	  }
 	else
 	  {
+	    basename = tok_end == rel_path
+	      ? g_path_get_basename (menu->directory) : NULL;
+	    row = lib_filter_index_add (index, parent_row,
+					basename ? basename : tok_start,
+					NULL);
 	    gtk_tree_store_append (tree, &p_iter, iter);
 	    gtk_tree_store_set (tree, &p_iter,
 				MENU_TOPPATH_COLUMN, menu->directory,
 				MENU_SUBPATH_COLUMN, rel_path,
 				MENU_NAME_COLUMN,
-				  tok_end == rel_path ?
-				    g_path_get_basename(menu->directory) : tok_start,
+				  basename ? basename : tok_start,
 				MENU_LIBRARY_COLUMN,
 				  saved_ch == '\0' ? menu : NULL,
-				MENU_ENTRY_COLUMN, NULL, -1);
+				MENU_ENTRY_COLUMN, NULL,
+				MENU_INDEX_COLUMN, row, -1);
+	    g_free (basename);
+	    parent_row = row;
 	  }
 	iter = &p_iter;
 
@@ -629,19 +922,32 @@ create_lib_tree_model (GhidLibraryWindow * library_window)
 
     ENTRY_LOOP (menu);
     {
+      row = lib_filter_index_add (index, parent_row, entry->ListEntry,
+				  entry->Description);
       gtk_tree_store_append (tree, &c_iter, iter);
       gtk_tree_store_set (tree, &c_iter,
 			  MENU_TOPPATH_COLUMN, menu->directory,
 			  MENU_SUBPATH_COLUMN, rel_path,
 			  MENU_NAME_COLUMN, entry->ListEntry,
 			  MENU_LIBRARY_COLUMN, menu,
-			  MENU_ENTRY_COLUMN, entry, -1);
+			  MENU_ENTRY_COLUMN, entry,
+			  MENU_INDEX_COLUMN, row, -1);
     }
     END_LOOP;
 
   }
   END_LOOP;
 
+  lib_filter_index_finish (index);
+
+  /* the rows of a visible set, or of a search going on, are of the
+   * old index */
+  g_atomic_int_inc (&library_window->filter_generation);
+  g_free (library_window->filter_visible);
+  library_window->filter_visible = NULL;
+  lib_filter_index_unref (library_window->filter_index);
+  library_window->filter_index = index;
+
   return (GtkTreeModel *) tree;
 }
 
@@ -943,6 +1249,12 @@ library_window_finalize (GObject * object)
       library_window->filter_timeout = 0;
     }
 
+  /* the filter jobs hold a reference, so none are left */
+  if (library_window->filter_pool != NULL)
+    g_thread_pool_free (library_window->filter_pool, FALSE, TRUE);
+  g_free (library_window->filter_visible);
+  lib_filter_index_unref (library_window->filter_index);
+
   G_OBJECT_CLASS (library_window_parent_class)->finalize (object);
 }
 
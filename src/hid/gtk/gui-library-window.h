@@ -52,6 +52,11 @@ struct _GhidLibraryWindow
   GtkEntry *entry_filter;
   GtkButton *button_clear;
   guint filter_timeout;
+
+  struct lib_filter_index *filter_index;	/* of the tree model       */
+  GThreadPool *filter_pool;	/* the filter thread                       */
+  guint8 *filter_visible;	/* a flag for each row, or NULL for all    */
+  gint filter_generation;	/* bumped when filter text or index change */
 };
 
 
@@ -91,10 +91,10 @@ static LibraryMenuType *node_selected_net;
    |  code can control the net and node treeviews:
    |
    |	ghid_get_net_from_node_name gchar *node_name, gboolean enabled_only)
-   |		Given a node name (eg C101-1), walk through the nets in the net
-   |		data model and search each net for the given node_name.  If found
-   |		and enabled_only is true, make the net treeview scroll to and
-   |		highlight (select) the found net.  Return the found net.
+   |		Given a node name (eg C101-1), look up the net it is on in
+   |		the node name hash.  If found and enabled_only is true, make
+   |		the net treeview scroll to and highlight (select) the found
+   |		net.  Return the found net.
    |
    |	ghid_netlist_highlight_node()
    |		Given some PCB internal pointers (not really a good gui api here)
@@ -106,10 +106,101 @@ static LibraryMenuType *node_selected_net;
    |	ghid_netlist_window_update(gboolean init_nodes)
    |		PCB calls this to tell the gui netlist code the layout net has
    |		changed and the gui data structures (net and optionally node data
-   |		models) should be rebuilt.
+   |		models) should be rebuilt.  If the netlist still has the same
+   |		nets, the rows of the net model are updated in place instead.
 */
 
 
+/* -------- Lookups of nodes by name ----------
+   |  The nodes of the netlist are kept in a hash by name, so finding the
+   |  net of a node doesn't mean searching every net.  The hash is made
+   |  when it is first needed and dropped whenever the netlist changes.
+   |  A node name on several nets has a location for each of them.
+*/
+typedef struct node_location
+{
+  LibraryMenuType *net;
+  LibraryEntryType *node;
+  struct node_location *next;
+} node_location;
+
+static GHashTable *node_hash = NULL;
+/* What node_hash was made from, to catch a netlist replaced behind our
+   |  back.
+*/
+static PCBType *node_hash_pcb;
+static LibraryMenuType *node_hash_menu;
+static Cardinal node_hash_menu_n;
+
+static void
+node_locations_free (gpointer data)
+{
+  node_location *loc = (node_location *) data, *next;
+
+  for (; loc; loc = next)
+    {
+      next = loc->next;
+      g_free (loc);
+    }
+}
+
+static void
+node_hash_invalidate (void)
+{
+  if (node_hash)
+    g_hash_table_destroy (node_hash);
+  node_hash = NULL;
+}
+
+static GHashTable *
+node_hash_get (void)
+{
+  node_location *loc, *first;
+
+  if (node_hash != NULL && node_hash_pcb == PCB
+      && node_hash_menu == PCB->NetlistLib.Menu
+      && node_hash_menu_n == PCB->NetlistLib.MenuN)
+    return node_hash;
+
+  node_hash_invalidate ();
+  node_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                     node_locations_free);
+  node_hash_pcb = PCB;
+  node_hash_menu = PCB->NetlistLib.Menu;
+  node_hash_menu_n = PCB->NetlistLib.MenuN;
+
+  MENU_LOOP (&PCB->NetlistLib);
+  {
+    /* Nets without a name aren't in the net model either */
+    if (!menu->Name)
+      continue;
+    ENTRY_LOOP (menu);
+    {
+      if (!entry->ListEntry)
+        continue;
+      loc = g_new (node_location, 1);
+      loc->net = menu;
+      loc->node = entry;
+      loc->next = NULL;
+      first = (node_location *) g_hash_table_lookup (node_hash,
+                                                     entry->ListEntry);
+      if (first == NULL)
+        g_hash_table_insert (node_hash, g_strdup (entry->ListEntry), loc);
+      else
+        {
+          while (first->next)
+            first = first->next;
+          first->next = loc;
+        }
+    }
+    END_LOOP;
+  }
+  END_LOOP;
+
+  return node_hash;
+}
+
+
 /* -------- The netlist nodes (LibraryEntryType) data model ----------
    |  Each time a net is selected in the left treeview, this node model
    |  is recreated containing all the nodes (pins/pads) that are connected
@@ -323,6 +414,20 @@ static GtkTreeView *net_treeview;
 
 static gboolean		loading_new_netlist;
 
+/* Net name -> GtkTreeIter of the net's row in net_model.  The rows of a
+   |  GtkTreeStore keep their iters for as long as they are there.
+*/
+static GHashTable *net_rows = NULL;
+
+static GtkTreeIter *
+iter_copy (GtkTreeIter *iter)
+{
+  GtkTreeIter *copy = g_new (GtkTreeIter, 1);
+
+  *copy = *iter;
+  return copy;
+}
+
 static GtkTreeModel *
 net_model_create (void)
 {
@@ -331,14 +436,15 @@ net_model_create (void)
   GtkTreeIter new_iter;
   GtkTreeIter parent_iter;
   GtkTreeIter *parent_ptr;
-  GtkTreePath *path;
-  GtkTreeRowReference *row_ref;
+  GtkTreeIter *prefix_iter;
   GHashTable *prefix_hash;
+  const char *sep = NET_HIERARCHY_SEPARATOR;
+  size_t sep_len = strlen (sep);
+  const char **seps = NULL;
+  const char *p, *start;
   char *display_name;
   char *hash_string;
-  char **join_array;
-  char **path_segments;
-  int path_depth;
+  int n_seps, max_seps = 0;
   int try_depth;
 
   store = gtk_tree_store_new (N_NET_COLUMNS,
@@ -346,10 +452,16 @@ net_model_create (void)
 
   model = GTK_TREE_MODEL (store);
 
-  /* Hash table stores GtkTreeRowReference for given path prefixes */
+  /* Hash table stores the GtkTreeIter for given path prefixes.  Tree
+     |  row references would do too, but every one of them is updated as
+     |  each row goes in, which doesn't scale to thousands of nets.
+   */
   prefix_hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
-                                       (GDestroyNotify)
-                                         gtk_tree_row_reference_free);
+                                       g_free);
+
+  if (net_rows)
+    g_hash_table_destroy (net_rows);
+  net_rows = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 
   MENU_LOOP (&PCB->NetlistLib);
   {
@@ -361,27 +473,31 @@ net_model_create (void)
 
     parent_ptr = NULL;
 
-    path_segments = g_strsplit (menu->Name, NET_HIERARCHY_SEPARATOR, 0);
-    path_depth = g_strv_length (path_segments);
-
-    for (try_depth = path_depth - 1; try_depth > 0; try_depth--)
+    /* Find where the path segments of the name end */
+    n_seps = 0;
+    for (p = strstr (menu->Name, sep); p; p = strstr (p + sep_len, sep))
       {
-        join_array = g_new0 (char *, try_depth + 1);
-        memcpy (join_array, path_segments, sizeof (char *) * try_depth);
+        if (n_seps == max_seps)
+          {
+            max_seps = MAX (16, 2 * max_seps);
+            seps = (const char **) g_realloc (seps, max_seps * sizeof (*seps));
+          }
+        seps[n_seps++] = p;
+      }
 
+    for (try_depth = n_seps; try_depth > 0; try_depth--)
+      {
         /* See if this net's parent node is in the hash table */
-        hash_string = g_strjoinv (NET_HIERARCHY_SEPARATOR, join_array);
-        g_free (join_array);
-
-        row_ref = (GtkTreeRowReference *)g_hash_table_lookup (prefix_hash, hash_string);
+        hash_string = g_strndup (menu->Name, seps[try_depth - 1] - menu->Name);
+        prefix_iter = (GtkTreeIter *) g_hash_table_lookup (prefix_hash,
+                                                           hash_string);
         g_free (hash_string);
 
         /* If we didn't find the path at this level, keep looping */
-        if (row_ref == NULL)
+        if (prefix_iter == NULL)
           continue;
 
-        path = gtk_tree_row_reference_get_path (row_ref);
-        gtk_tree_model_get_iter (model, &parent_iter, path);
+        parent_iter = *prefix_iter;
         parent_ptr = &parent_iter;
         break;
       }
@@ -390,10 +506,12 @@ net_model_create (void)
 
     /* Now walk up the desired path, adding the nodes */
 
-    for (; try_depth < path_depth - 1; try_depth++)
+    for (; try_depth < n_seps; try_depth++)
       {
-        display_name = g_strconcat (path_segments[try_depth],
-                                    NET_HIERARCHY_SEPARATOR, NULL);
+        start = try_depth == 0 ? menu->Name : seps[try_depth - 1] + sep_len;
+        display_name = g_strdup_printf ("%.*s%s",
+                                        (int) (seps[try_depth] - start),
+                                        start, sep);
         gtk_tree_store_append (store, &new_iter, parent_ptr);
         gtk_tree_store_set (store, &new_iter,
                             NET_ENABLED_COLUMN, "",
@@ -401,36 +519,77 @@ net_model_create (void)
                             NET_LIBRARY_COLUMN, NULL, -1);
         g_free (display_name);
 
-        path = gtk_tree_model_get_path (model, &new_iter);
-        row_ref = gtk_tree_row_reference_new (model, path);
         parent_iter = new_iter;
         parent_ptr = &parent_iter;
 
-        join_array = g_new0 (char *, try_depth + 2);
-        memcpy (join_array, path_segments, sizeof (char *) * (try_depth + 1));
-
-        hash_string = g_strjoinv (NET_HIERARCHY_SEPARATOR, join_array);
-        g_free (join_array);
-
         /* Insert those node in the hash table */
-        g_hash_table_insert (prefix_hash, hash_string, row_ref);
+        hash_string = g_strndup (menu->Name, seps[try_depth] - menu->Name);
+        g_hash_table_insert (prefix_hash, hash_string, iter_copy (&new_iter));
         /* Don't free hash_string, it is now oened by the hash table */
       }
 
+    start = n_seps > 0 ? seps[n_seps - 1] + sep_len : menu->Name;
     gtk_tree_store_append (store, &new_iter, parent_ptr);
     gtk_tree_store_set (store, &new_iter,
 			NET_ENABLED_COLUMN, menu->flag ? "" : "*",
-			NET_NAME_COLUMN, path_segments[path_depth - 1],
+			NET_NAME_COLUMN, start,
 			NET_LIBRARY_COLUMN, menu, -1);
-    g_strfreev (path_segments);
+    g_hash_table_insert (net_rows, g_strdup (menu->Name),
+                         iter_copy (&new_iter));
   }
   END_LOOP;
 
+  g_free (seps);
   g_hash_table_destroy (prefix_hash);
 
   return model;
 }
 
+/* If the netlist has the same nets the net model was made from, point
+   |  their rows at the nets and update the enabled column, and keep the
+   |  rows as they are otherwise, expanded or not.
+   |
+   |  Returns FALSE if the model has to be made again instead.
+*/
+static gboolean
+net_model_update_in_place (void)
+{
+  GtkTreeIter *iter;
+  guint n = 0;
+
+  if (net_model == NULL || net_rows == NULL)
+    return FALSE;
+
+  MENU_LOOP (&PCB->NetlistLib);
+  {
+    if (!menu->Name)
+      continue;
+    if (g_hash_table_lookup (net_rows, menu->Name) == NULL)
+      return FALSE;
+    n++;
+  }
+  END_LOOP;
+  if (n != g_hash_table_size (net_rows))
+    return FALSE;
+
+  MENU_LOOP (&PCB->NetlistLib);
+  {
+    if (!menu->Name)
+      continue;
+
+    if (loading_new_netlist)
+      menu->flag = TRUE;
+
+    iter = (GtkTreeIter *) g_hash_table_lookup (net_rows, menu->Name);
+    gtk_tree_store_set (GTK_TREE_STORE (net_model), iter,
+			NET_ENABLED_COLUMN, menu->flag ? "" : "*",
+			NET_LIBRARY_COLUMN, menu, -1);
+  }
+  END_LOOP;
+
+  return TRUE;
+}
+
 
 /* Called when the user double clicks on a net in the left treeview.
  */
@@ -595,68 +754,21 @@ netlist_rip_up_cb (GtkWidget * widget, gpointer data)
 
 }
 
-/**/
-typedef struct {
-  LibraryEntryType *ret_val;
-  LibraryMenuType *node_net;
-  const gchar *node_name;
-  bool found;
-} node_get_node_from_name_state;
-
-static gboolean
-node_get_node_from_name_helper (GtkTreeModel *model, GtkTreePath *path,
-                                GtkTreeIter *iter, gpointer data)
-{
-  LibraryMenuType *net;
-  LibraryEntryType *node;
-  node_get_node_from_name_state *state = data;
-
-  gtk_tree_model_get (net_model, iter, NET_LIBRARY_COLUMN, &net, -1);
-  /* Ignore non-nets (category headers) */
-  if (net == NULL)
-    return FALSE;
-
-  /* Look for the node name in this net. */
-  for (node = net->Entry; node - net->Entry < net->EntryN; node++)
-    if (node->ListEntry && !strcmp (state->node_name, node->ListEntry))
-      {
-        state->node_net = net;
-        state->ret_val = node;
-        /* stop iterating */
-        state->found = TRUE;
-	return TRUE;
-      }
-  return FALSE;
-}
-
 LibraryEntryType *
 node_get_node_from_name (gchar * node_name, LibraryMenuType ** node_net)
 {
-  node_get_node_from_name_state state;
+  node_location *loc;
 
   if (!node_name)
     return NULL;
 
-  /* Have to force the netlist window created because we need the treeview
-     |  models constructed to do the search.
-   */
-  ghid_netlist_window_create (gport);
-
-  /* Now walk through node entries of each net in the net model looking for
-     |  the node_name.
-   */
-  state.found = 0;
-  state.node_name = node_name;
-  gtk_tree_model_foreach (net_model, node_get_node_from_name_helper, &state);
-  if (state.found)
-    {
-      if (node_net)
-        *node_net = state.node_net;
-      return state.ret_val;
-    }
-  return NULL;
+  loc = (node_location *) g_hash_table_lookup (node_hash_get (), node_name);
+  if (loc == NULL)
+    return NULL;
+  if (node_net)
+    *node_net = loc->net;
+  return loc->node;
 }
-/**/
 
 /* ---------- Manage the GUI treeview of the data models -----------
  */
@@ -843,61 +955,18 @@ ghid_netlist_window_show (GHidPort * out, gboolean raise)
     gtk_window_present(GTK_WINDOW(netlist_window));
 }
 
-struct ggnfnn_task {
-  gboolean enabled_only;
-  gchar *node_name;
-  LibraryMenuType *found_net;
-  GtkTreeIter iter;
-};
-
-static gboolean
-hunt_named_node (GtkTreeModel *model, GtkTreePath *path,
-                 GtkTreeIter *iter, gpointer data)
-{
-  struct ggnfnn_task *task = (struct ggnfnn_task *)data;
-  LibraryMenuType *net;
-  LibraryEntryType *node;
-  gchar *str;
-  gint j;
-  gboolean is_disabled;
-
-  /* We only want to inspect leaf nodes in the tree */
-  if (gtk_tree_model_iter_has_child (model, iter))
-    return FALSE;
-
-  gtk_tree_model_get (model, iter, NET_LIBRARY_COLUMN, &net, -1);
-  gtk_tree_model_get (model, iter, NET_ENABLED_COLUMN, &str, -1);
-  is_disabled = !strcmp (str, "*");
-  g_free (str);
-
-  /* Don't check net nodes of disabled nets. */
-  if (task->enabled_only && is_disabled)
-    return FALSE;
-
-  /* Look for the node name in this net. */
-  for (j = net->EntryN, node = net->Entry; j; j--, node++)
-    if (node->ListEntry && !strcmp (task->node_name, node->ListEntry))
-      {
-        task->found_net = net;
-        task->iter = *iter;
-        return TRUE;
-      }
-
-  return FALSE;
-}
-
 LibraryMenuType *
 ghid_get_net_from_node_name (gchar * node_name, gboolean enabled_only)
 {
   GtkTreePath *path;
-  struct ggnfnn_task task;
+  GtkTreeIter *iter;
+  node_location *loc;
 
   if (!node_name)
     return NULL;
 
   /* Have to force the netlist window created because we need the treeview
-     |  models constructed so we can find the LibraryMenuType pointer the
-     |  caller wants.
+     |  models constructed so we can highlight the net the caller wants.
    */
   ghid_netlist_window_create (gport);
 
@@ -905,30 +974,34 @@ ghid_get_net_from_node_name (gchar * node_name, gboolean enabled_only)
   if (netlist_window == NULL)
     return NULL;
 
-  task.enabled_only = enabled_only;
-  task.node_name = node_name;
-  task.found_net = NULL;
-
-  /* Now walk through node entries of each net in the net model looking for
-     |  the node_name.
+  /* Look the node up, skipping the nets disabled for adding rats if
+     |  asked to.
    */
-  gtk_tree_model_foreach (net_model, hunt_named_node, &task);
+  for (loc = (node_location *) g_hash_table_lookup (node_hash_get (),
+                                                    node_name);
+       loc; loc = loc->next)
+    if (!enabled_only || loc->net->flag)
+      break;
+  if (loc == NULL)
+    return NULL;
 
   /* We are asked to highlight the found net if enabled_only is TRUE.
      |  Set holdoff TRUE since this is just a highlight and user is not
      |  expecting normal select action to happen?  Or should the node
      |  treeview also get updated?  Original PCB code just tries to highlight.
    */
-  if (task.found_net && enabled_only)
+  iter = (GtkTreeIter *) g_hash_table_lookup (net_rows, loc->net->Name);
+  if (iter && enabled_only)
     {
       selection_holdoff = TRUE;
-      path = gtk_tree_model_get_path (net_model, &task.iter);
+      path = gtk_tree_model_get_path (net_model, iter);
       gtk_tree_view_scroll_to_cell (net_treeview, path, NULL, TRUE, 0.5, 0.5);
       gtk_tree_selection_select_path (gtk_tree_view_get_selection
 				      (net_treeview), path);
+      gtk_tree_path_free (path);
       selection_holdoff = FALSE;
     }
-  return task.found_net;
+  return loc->net;
 }
 
 /* PCB LookupConnection code in find.c calls this if it wants a node
@@ -986,15 +1059,21 @@ ghid_netlist_window_update (gboolean init_nodes)
   /* Make sure there is something to update */
   ghid_netlist_window_create (gport);
 
-  model = net_model;
-  net_model = net_model_create ();
-  gtk_tree_view_set_model (net_treeview, net_model);
-  gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (net_model),
-					NET_NAME_COLUMN, GTK_SORT_ASCENDING);
-  if (model)
+  node_hash_invalidate ();
+  gtk_tree_selection_unselect_all (gtk_tree_view_get_selection (net_treeview));
+
+  if (!net_model_update_in_place ())
     {
-      gtk_tree_store_clear (GTK_TREE_STORE (model));
-      g_object_unref (model);
+      model = net_model;
+      net_model = net_model_create ();
+      gtk_tree_view_set_model (net_treeview, net_model);
+      gtk_tree_sortable_set_sort_column_id (GTK_TREE_SORTABLE (net_model),
+					    NET_NAME_COLUMN, GTK_SORT_ASCENDING);
+      if (model)
+	{
+	  gtk_tree_store_clear (GTK_TREE_STORE (model));
+	  g_object_unref (model);
+	}
     }
 
   selected_net = NULL;
@@ -1007,6 +1086,9 @@ ghid_netlist_window_update (gboolean init_nodes)
 static gint
 GhidNetlistChanged (int argc, char **argv, Coord x, Coord y)
 {
+  /* The nodes may have changed even if the window isn't there */
+  node_hash_invalidate ();
+
   /* XXX: We get called before the GUI is up when
    *         exporting from the command-line. */
   if (ghidgui == NULL || !ghidgui->is_up)
@@ -69,7 +69,7 @@ pinout_set_data (GhidPinoutPreview * pinout, ElementType * element)
   if (pinout->element != NULL)
     {
       FreeElementMemory (pinout->element);
-      g_slice_free (ElementType, pinout->element);
+      POOL_FREE (ElementType, pinout->element);
       pinout->element = NULL;
     }
 
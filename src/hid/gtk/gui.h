@@ -496,6 +496,7 @@ void ghid_fill_polygon (hidGC gc, int n_coords, Coord *x, Coord *y);
 void ghid_fill_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2);
 void ghid_invalidate_lr (Coord left, Coord right, Coord top, Coord bottom);
 void ghid_invalidate_all ();
+void ghid_invalidate_view ();
 void ghid_notify_crosshair_change (bool changes_complete);
 void ghid_notify_mark_change (bool changes_complete);
 void ghid_init_renderer (int *, char ***, GHidPort *);
@@ -503,6 +504,7 @@ void ghid_shutdown_renderer (GHidPort *);
 void ghid_init_drawing_widget (GtkWidget *widget, GHidPort *);
 void ghid_drawing_area_configure_hook (GHidPort *port);
 void ghid_screen_update (void);
+void ghid_renderer_stats (GString *text);
 gboolean ghid_drawing_area_expose_cb (GtkWidget *, GdkEventExpose *,
                                       GHidPort *);
 void ghid_port_drawing_realize_cb (GtkWidget *, gpointer);
@@ -522,6 +524,7 @@ void ghid_cancel_lead_user (void);
 
 /* gtkhid-main.c */
 void ghid_pan_view_rel (Coord dx, Coord dy);
+void ghid_note_frame (gint64 usec);
 void ghid_get_coords (const char *msg, Coord *x, Coord *y);
 gint PCBChanged (int argc, char **argv, Coord x, Coord y);
 
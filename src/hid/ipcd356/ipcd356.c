@@ -95,14 +95,16 @@ typedef struct
 {
   int AliasN; /*!< Number of entries. */
   IPCD356_Alias *Alias;
+  GHashTable *Names; /*!< The NName of each aliased NetName. */
 } IPCD356_AliasList;
 
-void IPCD356_WriteNet (FILE *, char *);
+typedef struct IPCD356_NodeList IPCD356_NodeList;
+
+void IPCD356_WriteNet (FILE *, char *, IPCD356_NodeList *, int);
 void IPCD356_WriteHeader (FILE *);
 void IPCD356_End (FILE *);
 int IPCD356_Netlist (void);
 int IPCD356_WriteAliases (FILE *, IPCD356_AliasList *);
-void ResetVisitPinsViasAndPads (void);
 void CheckNetLength (char *, IPCD356_AliasList *);
 IPCD356_AliasList *CreateAliasList (void);
 IPCD356_AliasList *AddAliasToList (IPCD356_AliasList *);
@@ -169,273 +171,394 @@ IPCD356_WriteHeader (FILE * fd)
 
 
 /*!
- * \brief Writes a net to the file provided.
- *
- * The net name is passed through the "net" and should be 14 characters
- * max.\n
- * The function scans through pads, pins and vias  and looks for the
- * \c FOUNDFLAG.\n
- * Once the object has been added to the net list the \c VISITFLAG is
- * set on that object.
- *
- * \todo 1) The bottom layer is always written as layer #2 (A02).\n
- *          It could output the actual layer number (example: A06 on a
- *          6 layer board).\n
- *          But I could not find an easy way to do this...
+ * \brief A pad, pin or via of a net.
+ */
+typedef struct
+{
+  int type; /*!< PAD_TYPE, PIN_TYPE or VIA_TYPE. */
+  ElementType *element; /*!< Element of a pad or pin. */
+  void *ptr;
+} IPCD356_Node;
+
+/*!
+ * \brief The pads, pins and vias of the board in the order they are
+ * written, grouped by net.
  *
- * \todo 2) Objects with mutiple connections could have the "M"
- *          (column 32) field written to indicate a Mid Net Point.
+ * The nodes of the net labelled n are Node[First[n]] up to, but not
+ * including, Node[First[n + 1]].
  */
-void
-IPCD356_WriteNet (FILE * fd, char *net)
+struct IPCD356_NodeList
 {
-  int padx, pady, tmp;
+  IPCD356_Node *Node;
+  int *First;
+  int NetN; /*!< Number of nets. */
+};
 
-  ELEMENT_LOOP (PCB->Data);
-  PAD_LOOP (element);
-  if (TEST_FLAG (FOUNDFLAG, pad))
+static void
+IPCD356_WritePad (FILE * fd, char *net, ElementType *element, PadType *pad)
+{
+  int padx, pady;
+
+  fprintf (fd, "327%-17.14s", net); /* Net Name. */
+  fprintf (fd, "%-6.6s", element->Name[1].TextString); /* Refdes. */
+  fprintf (fd, "-%-4.4s", pad->Number); /* pin number. */
+  fprintf (fd, " "); /*! \todo Midpoint indicator (M). */
+  fprintf (fd, "      "); /* Drilled hole Id (blank for pads). */
+  if (TEST_FLAG (ONSOLDERFLAG, pad) == true)
     {
-      fprintf (fd, "327%-17.14s", net); /* Net Name. */
-      fprintf (fd, "%-6.6s", element->Name[1].TextString); /* Refdes. */
-      fprintf (fd, "-%-4.4s", pad->Number); /* pin number. */
-      fprintf (fd, " "); /*! \todo Midpoint indicator (M). */
-      fprintf (fd, "      "); /* Drilled hole Id (blank for pads). */
-      if (TEST_FLAG (ONSOLDERFLAG, pad) == true)
-        {
-          fprintf (fd, "A02"); /*! \todo Put actual layer # for bottom side. */
-        }
-      else
-        {
-          fprintf (fd, "A01"); /* Top side. */
-        }
-      padx = (pad->Point1.X + pad->Point2.X) / 2; /* X location in PCB units. */
-      pady = (PCB->MaxHeight - ((pad->Point1.Y + pad->Point2.Y) / 2)); /* Y location in PCB units. */
+      fprintf (fd, "A02"); /*! \todo Put actual layer # for bottom side. */
+    }
+  else
+    {
+      fprintf (fd, "A01"); /* Top side. */
+    }
+  padx = (pad->Point1.X + pad->Point2.X) / 2; /* X location in PCB units. */
+  pady = (PCB->MaxHeight - ((pad->Point1.Y + pad->Point2.Y) / 2)); /* Y location in PCB units. */
 
-      if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
-        {
-          padx = padx / 2540; /* X location in 0.0001". */
-          pady = pady / 2540; /* Y location in 0.0001". */
-        }
-      else
-        {
-          padx = padx / 1000; /* X location in 0.001 mm. */
-          pady = pady / 1000; /* Y location in 0.001 mm. */
-        }
-      fprintf (fd, "X%+6.6d", padx); /* X Pad center. */
-      fprintf (fd, "Y%+6.6d", pady); /* Y pad center. */
+  if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
+    {
+      padx = padx / 2540; /* X location in 0.0001". */
+      pady = pady / 2540; /* Y location in 0.0001". */
+    }
+  else
+    {
+      padx = padx / 1000; /* X location in 0.001 mm. */
+      pady = pady / 1000; /* Y location in 0.001 mm. */
+    }
+  fprintf (fd, "X%+6.6d", padx); /* X Pad center. */
+  fprintf (fd, "Y%+6.6d", pady); /* Y pad center. */
 
-      padx = (pad->Thickness + (pad->Point2.X - pad->Point1.X)); /* Pad dimension X in PCB units. */
-      pady = (pad->Thickness + (pad->Point2.Y - pad->Point1.Y)); /* Pad dimension Y in PCB units. */
+  padx = (pad->Thickness + (pad->Point2.X - pad->Point1.X)); /* Pad dimension X in PCB units. */
+  pady = (pad->Thickness + (pad->Point2.Y - pad->Point1.Y)); /* Pad dimension Y in PCB units. */
 
-      if (strcmp(Settings.grid_unit->suffix, "mil") == 0)
-        {
-          padx = padx / 2540; /* X location in 0.0001". */
-          pady = pady / 2540; /* Y location in 0.0001". */
-        }
-      else
-        {
-          padx = padx / 1000;	// X location in 0.001mm
-          pady = pady / 1000;	// Y location in 0.001mm
-        }
+  if (strcmp(Settings.grid_unit->suffix, "mil") == 0)
+    {
+      padx = padx / 2540; /* X location in 0.0001". */
+      pady = pady / 2540; /* Y location in 0.0001". */
+    }
+  else
+    {
+      padx = padx / 1000;	// X location in 0.001mm
+      pady = pady / 1000;	// Y location in 0.001mm
+    }
 
-      fprintf (fd, "X%4.4d", padx);
-      fprintf (fd, "Y%4.4d", pady);
-      fprintf (fd, "R000"); /* Rotation (0 degrees). */
-      fprintf (fd, " "); /* Column 72 should be left blank. */
-      if (pad->Mask > 0)    
+  fprintf (fd, "X%4.4d", padx);
+  fprintf (fd, "Y%4.4d", pady);
+  fprintf (fd, "R000"); /* Rotation (0 degrees). */
+  fprintf (fd, " "); /* Column 72 should be left blank. */
+  if (pad->Mask > 0)    
+    {
+      if (TEST_FLAG (ONSOLDERFLAG, pad) == true)
         {
-          if (TEST_FLAG (ONSOLDERFLAG, pad) == true)
-            {
-              fprintf(fd, "S2"); /* Soldermask on bottom side. */
-            }
-          else
-            {
-              fprintf(fd, "S1"); /* SolderMask on top side. */
-            }
+          fprintf(fd, "S2"); /* Soldermask on bottom side. */
         }
       else
         {
-          fprintf(fd, "S3"); /* No soldermask. */
+          fprintf(fd, "S1"); /* SolderMask on top side. */
         }
-      fprintf (fd, "      "); /* Padding. */
-      fprintf (fd, "\n");
-      SET_FLAG (VISITFLAG, pad);
     }
+  else
+    {
+      fprintf(fd, "S3"); /* No soldermask. */
+    }
+  fprintf (fd, "      "); /* Padding. */
+  fprintf (fd, "\n");
+}
 
-  END_LOOP; /* Pad. */
-  PIN_LOOP (element);
-  if (TEST_FLAG (FOUNDFLAG, pin))
+static void
+IPCD356_WritePin (FILE * fd, char *net, ElementType *element, PinType *pin)
+{
+  int padx, pady, tmp;
+
+  if (TEST_FLAG (HOLEFLAG, pin)) /* Non plated? */
     {
-      if (TEST_FLAG (HOLEFLAG, pin)) /* Non plated? */
-        {
-          fprintf (fd, "367%-17.14s", net); /* Net Name. */
-        }
-      else
-        {
-          fprintf (fd, "317%-17.14s", net); /* Net Name. */
-        }
-      fprintf (fd, "%-6.6s", element->Name[1].TextString); /* Refdes. */
-      fprintf (fd, "-%-4.4s", pin->Number); /* Pin number. */
-      fprintf (fd, " "); /*! \todo Midpoint indicator (M). */
-      tmp = pin->DrillingHole;
-      if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
-        {
-          tmp = tmp / 2540; /* 0.0001". */
-        }
-      else
-        {
-          tmp = tmp / 1000; /* 0.001 mm. */
-        }
+      fprintf (fd, "367%-17.14s", net); /* Net Name. */
+    }
+  else
+    {
+      fprintf (fd, "317%-17.14s", net); /* Net Name. */
+    }
+  fprintf (fd, "%-6.6s", element->Name[1].TextString); /* Refdes. */
+  fprintf (fd, "-%-4.4s", pin->Number); /* Pin number. */
+  fprintf (fd, " "); /*! \todo Midpoint indicator (M). */
+  tmp = pin->DrillingHole;
+  if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
+    {
+      tmp = tmp / 2540; /* 0.0001". */
+    }
+  else
+    {
+      tmp = tmp / 1000; /* 0.001 mm. */
+    }
 
-      if (TEST_FLAG (HOLEFLAG, pin))
-        {
-          fprintf (fd, "D%-4.4dU", tmp); /* Unplated Drilled hole Id. */
-        }
-      else
-        {
-          fprintf (fd, "D%-4.4dP", tmp); /* Plated drill hole. */
-        }
-      fprintf (fd, "A00"); /* Accessible from both sides. */
-      padx = pin->X; /* X location in PCB units. */
-      pady = (PCB->MaxHeight - pin->Y); /* Y location in PCB units.*/
+  if (TEST_FLAG (HOLEFLAG, pin))
+    {
+      fprintf (fd, "D%-4.4dU", tmp); /* Unplated Drilled hole Id. */
+    }
+  else
+    {
+      fprintf (fd, "D%-4.4dP", tmp); /* Plated drill hole. */
+    }
+  fprintf (fd, "A00"); /* Accessible from both sides. */
+  padx = pin->X; /* X location in PCB units. */
+  pady = (PCB->MaxHeight - pin->Y); /* Y location in PCB units.*/
 
-      if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
-        {
-          padx = padx / 2540; /* X location in 0.0001". */
-          pady = pady / 2540; /* Y location in 0.0001". */
-        }
-      else
-        {
-          padx = padx / 1000; /* X location in 0.001 mm. */
-          pady = pady / 1000; /* Y location in 0.001 mm. */
-        }
+  if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
+    {
+      padx = padx / 2540; /* X location in 0.0001". */
+      pady = pady / 2540; /* Y location in 0.0001". */
+    }
+  else
+    {
+      padx = padx / 1000; /* X location in 0.001 mm. */
+      pady = pady / 1000; /* Y location in 0.001 mm. */
+    }
 
-      fprintf (fd, "X%+6.6d", padx); /* X Pad center. */
-      fprintf (fd, "Y%+6.6d", pady); /* Y pad center. */
+  fprintf (fd, "X%+6.6d", padx); /* X Pad center. */
+  fprintf (fd, "Y%+6.6d", pady); /* Y pad center. */
 
-      padx = pin->Thickness;
+  padx = pin->Thickness;
 
-      if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
-        {
-          padx = padx / 2540; /* X location in 0.0001". */
-        }
-      else
-        {
-          padx = padx / 1000; /* X location in 0.001 mm. */
-        }
+  if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
+    {
+      padx = padx / 2540; /* X location in 0.0001". */
+    }
+  else
+    {
+      padx = padx / 1000; /* X location in 0.001 mm. */
+    }
 
-      fprintf (fd, "X%4.4d", padx); /* Pad dimension X. */
-      if (TEST_FLAG (SQUAREFLAG, pin))
-        {
-          fprintf (fd, "Y%4.4d", padx); /* Pad dimension Y. */
-        }
-      else
-        {
-          fprintf (fd, "Y0000"); /*  Y is 0 for round pins. */
-        }
-      fprintf (fd, "R000"); /* Rotation (0 degrees). */
-      fprintf (fd, " "); /* Column 72 should be left blank.*/
-      if (pin->Mask > 0)    
-        {
-          fprintf(fd, "S0"); /* No Soldermask. */
-        }
-      else
-        {
-          fprintf(fd, "S3"); /* Soldermask on both sides. */
-        }
-      fprintf (fd, "      "); /* Padding. */
+  fprintf (fd, "X%4.4d", padx); /* Pad dimension X. */
+  if (TEST_FLAG (SQUAREFLAG, pin))
+    {
+      fprintf (fd, "Y%4.4d", padx); /* Pad dimension Y. */
+    }
+  else
+    {
+      fprintf (fd, "Y0000"); /*  Y is 0 for round pins. */
+    }
+  fprintf (fd, "R000"); /* Rotation (0 degrees). */
+  fprintf (fd, " "); /* Column 72 should be left blank.*/
+  if (pin->Mask > 0)    
+    {
+      fprintf(fd, "S0"); /* No Soldermask. */
+    }
+  else
+    {
+      fprintf(fd, "S3"); /* Soldermask on both sides. */
+    }
+  fprintf (fd, "      "); /* Padding. */
 
-      fprintf (fd, "\n");
+  fprintf (fd, "\n");
+}
 
-      SET_FLAG (VISITFLAG, pin);
+static void
+IPCD356_WriteVia (FILE * fd, char *net, PinType *via)
+{
+  int padx, pady, tmp;
 
+  if (TEST_FLAG (HOLEFLAG, via)) /* Non plated ? */
+    {
+      fprintf (fd, "367%-17.14s", net); /* Net Name. */
+    }
+  else
+    {
+      fprintf (fd, "317%-17.14s", net); /* Net Name. */
+    }
+  fprintf (fd, "VIA   "); /* Refdes. */
+  fprintf (fd, "-    "); /* Pin number. */
+  fprintf (fd, " "); /*! \todo Midpoint indicator (M). */
+  tmp = via->DrillingHole;	
+  if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
+    {
+      tmp = tmp / 2540; /* 0.0001". */
+    }
+  else
+    {
+      tmp = tmp / 1000; /* 0.001 mm. */
     }
 
-  END_LOOP; /* Pin. */
-  END_LOOP; /* Element */
+  if (TEST_FLAG (HOLEFLAG, via))
+    {
+      fprintf (fd, "D%-4.4dU", tmp); /* Unplated Drilled hole Id. */
+    }
+  else
+    {
+      fprintf (fd, "D%-4.4dP", tmp); /* Plated drill hole. */
+    }
+  fprintf (fd, "A00"); /* Accessible from both sides. */
+  padx = via->X; /* X location in PCB units. */
+  pady = (PCB->MaxHeight - via->Y); /* Y location in PCB units. */
 
-  VIA_LOOP (PCB->Data);
-  if (TEST_FLAG (FOUNDFLAG, via))
+  if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
     {
-      if (TEST_FLAG (HOLEFLAG, via)) /* Non plated ? */
-        {
-          fprintf (fd, "367%-17.14s", net); /* Net Name. */
-        }
-      else
-        {
-          fprintf (fd, "317%-17.14s", net); /* Net Name. */
-        }
-      fprintf (fd, "VIA   "); /* Refdes. */
-      fprintf (fd, "-    "); /* Pin number. */
-      fprintf (fd, " "); /*! \todo Midpoint indicator (M). */
-      tmp = via->DrillingHole;	
-      if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
-        {
-          tmp = tmp / 2540; /* 0.0001". */
-        }
-      else
-        {
-          tmp = tmp / 1000; /* 0.001 mm. */
-        }
+      padx = padx / 2540; /* X location in 0.0001". */
+      pady = pady / 2540; /* Y location in 0.0001". */
+    }
+  else
+    {
+      padx = padx / 1000; /* X location in 0.001 mm. */
+      pady = pady / 1000; /* Y location in 0.001 mm. */
+    }
 
-      if (TEST_FLAG (HOLEFLAG, via))
-        {
-          fprintf (fd, "D%-4.4dU", tmp); /* Unplated Drilled hole Id. */
-        }
-      else
-        {
-          fprintf (fd, "D%-4.4dP", tmp); /* Plated drill hole. */
-        }
-      fprintf (fd, "A00"); /* Accessible from both sides. */
-      padx = via->X; /* X location in PCB units. */
-      pady = (PCB->MaxHeight - via->Y); /* Y location in PCB units. */
+  fprintf (fd, "X%+6.6d", padx); /* X Pad center. */
+  fprintf (fd, "Y%+6.6d", pady); /* Y pad center. */
 
-      if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
-        {
-          padx = padx / 2540; /* X location in 0.0001". */
-          pady = pady / 2540; /* Y location in 0.0001". */
-        }
-      else
-        {
-          padx = padx / 1000; /* X location in 0.001 mm. */
-          pady = pady / 1000; /* Y location in 0.001 mm. */
-        }
+  padx = via->Thickness;
+  
+  if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
+    {
+      padx = padx / 2540; /* X location in 0.0001". */
+    }
+  else
+    {
+      padx = padx / 1000; /* X location in 0.001 mm. */
+    }
 
-      fprintf (fd, "X%+6.6d", padx); /* X Pad center. */
-      fprintf (fd, "Y%+6.6d", pady); /* Y pad center. */
+  fprintf (fd, "X%4.4d", padx); /* Pad dimension X. */
+  fprintf (fd, "Y0000"); /* Y is 0 for round pins (vias always round?). */
+  fprintf (fd, "R000"); /* Rotation (0 degrees). */
+  fprintf (fd, " "); /* Column 72 should be left blank. */
+  if (via->Mask > 0)    
+    {
+      fprintf(fd, "S0"); /* No Soldermask. */
+    }
+  else
+    {
+      fprintf(fd, "S3"); /* Soldermask on both sides. */
+    }
+  fprintf (fd, "      "); /* Padding. */
+  fprintf (fd, "\n");
+}
 
-      padx = via->Thickness;
-      
-      if (strcmp (Settings.grid_unit->suffix, "mil") == 0)
-        {
-          padx = padx / 2540; /* X location in 0.0001". */
-        }
-      else
-        {
-          padx = padx / 1000; /* X location in 0.001 mm. */
-        }
+/*!
+ * \brief Group the pads, pins and vias of the board by net.
+ *
+ * The nets are the net labels of the connectivity index, so the board is
+ * labelled once rather than looked up from every pin.  Within a net the
+ * nodes keep the order of the board: the pads and then the pins of each
+ * element, then the vias.
+ */
+static void
+IPCD356_BuildNodeList (IPCD356_NodeList *list)
+{
+  int n_nodes = 0, i;		/* ELEMENT_LOOP declares an n */
+  int *next;
 
-      fprintf (fd, "X%4.4d", padx); /* Pad dimension X. */
-      fprintf (fd, "Y0000"); /* Y is 0 for round pins (vias always round?). */
-      fprintf (fd, "R000"); /* Rotation (0 degrees). */
-      fprintf (fd, " "); /* Column 72 should be left blank. */
-      if (via->Mask > 0)    
-        {
-          fprintf(fd, "S0"); /* No Soldermask. */
-        }
+  list->NetN = ConnectionIndexNetCount ();
+  list->First = (int *) calloc (list->NetN + 1, sizeof (int));
+
+  ELEMENT_LOOP (PCB->Data);
+  {
+    n_nodes += element->PadN + element->PinN;
+  }
+  END_LOOP;
+  n_nodes += PCB->Data->ViaN;
+  list->Node = (IPCD356_Node *) malloc (MAX (n_nodes, 1) * sizeof (IPCD356_Node));
+
+  /* Count the nodes of each net, then place them. */
+#define IPCD356_COUNT(ptr) list->First[ConnectionIndexNetLabel (ptr) + 1]++
+  ELEMENT_LOOP (PCB->Data);
+  {
+    PAD_LOOP (element);
+    IPCD356_COUNT (pad);
+    END_LOOP;
+    PIN_LOOP (element);
+    IPCD356_COUNT (pin);
+    END_LOOP;
+  }
+  END_LOOP;
+  VIA_LOOP (PCB->Data);
+  IPCD356_COUNT (via);
+  END_LOOP;
+#undef IPCD356_COUNT
+
+  for (i = 0; i < list->NetN; i++)
+    list->First[i + 1] += list->First[i];
+  next = (int *) malloc ((list->NetN + 1) * sizeof (int));
+  memcpy (next, list->First, (list->NetN + 1) * sizeof (int));
+
+#define IPCD356_PLACE(t, e, p)                                  \
+  do {                                                          \
+    IPCD356_Node *node = &list->Node[next[ConnectionIndexNetLabel (p)]++]; \
+    node->type = t;                                             \
+    node->element = e;                                          \
+    node->ptr = p;                                              \
+  } while (0)
+  ELEMENT_LOOP (PCB->Data);
+  {
+    PAD_LOOP (element);
+    IPCD356_PLACE (PAD_TYPE, element, pad);
+    END_LOOP;
+    PIN_LOOP (element);
+    IPCD356_PLACE (PIN_TYPE, element, pin);
+    END_LOOP;
+  }
+  END_LOOP;
+  VIA_LOOP (PCB->Data);
+  IPCD356_PLACE (VIA_TYPE, NULL, via);
+  END_LOOP;
+#undef IPCD356_PLACE
+
+  free (next);
+}
+
+/*!
+ * \brief Writes a net to the file provided.
+ *
+ * The net name is passed through the "net" and should be 14 characters
+ * max.\n
+ * The function writes the pads, pins and vias with the net label
+ * "label".
+ *
+ * \todo 1) The bottom layer is always written as layer #2 (A02).\n
+ *          It could output the actual layer number (example: A06 on a
+ *          6 layer board).\n
+ *          But I could not find an easy way to do this...
+ *
+ * \todo 2) Objects with mutiple connections could have the "M"
+ *          (column 32) field written to indicate a Mid Net Point.
+ */
+void
+IPCD356_WriteNet (FILE * fd, char *net, IPCD356_NodeList *list, int label)
+{
+  int i;
+
+  for (i = list->First[label]; i < list->First[label + 1]; i++)
+    {
+      IPCD356_Node *node = &list->Node[i];
+
+      if (node->type == PAD_TYPE)
+        IPCD356_WritePad (fd, net, node->element, (PadType *) node->ptr);
+      else if (node->type == PIN_TYPE)
+        IPCD356_WritePin (fd, net, node->element, (PinType *) node->ptr);
       else
-        {
-          fprintf(fd, "S3"); /* Soldermask on both sides. */
-        }
-      fprintf (fd, "      "); /* Padding. */
-      fprintf (fd, "\n");
-      SET_FLAG (VISITFLAG, via);
+        IPCD356_WriteVia (fd, net, (PinType *) node->ptr);
     }
-
-  END_LOOP; /* Via. */
 }
 
 
+/*!
+ * \brief Index the nodes of the netlist by "refdes-pin", to name the
+ * nets without a search of the netlist for each.
+ *
+ * A node listed in more than one net goes to the first of them, as with
+ * netnode_to_netname().
+ */
+static GHashTable *
+IPCD356_NetnodeIndex (void)
+{
+  GHashTable *index = g_hash_table_new (g_str_hash, g_str_equal);
+  LibraryMenuType *menu;
+  int i, j;
+
+  for (i = 0; i < PCB->NetlistLib.MenuN; i++)
+    for (menu = &PCB->NetlistLib.Menu[i], j = 0; j < menu->EntryN; j++)
+      if (g_hash_table_lookup (index, menu->Entry[j].ListEntry) == NULL)
+        g_hash_table_insert (index, menu->Entry[j].ListEntry, menu);
+  return index;
+}
+
 /*!
  * \brief The main IPC-D-356 function.
  *
@@ -449,6 +572,9 @@ IPCD356_Netlist (void)
   char net[256];
   LibraryMenuType *netname;
   IPCD356_AliasList * aliaslist;
+  IPCD356_NodeList nodes;
+  GHashTable *netnodes;
+  bool *written;
 
   if (IPCD356_SanityCheck()) /* Check for invalid names + numbers. */
     {
@@ -484,15 +610,18 @@ IPCD356_Netlist (void)
       return 1;
     }
 
+  /* Each net is written when its first pin, pad or via is met. */
+  IPCD356_BuildNodeList (&nodes);
+  written = (bool *) calloc (nodes.NetN + 1, sizeof (bool));
+  netnodes = IPCD356_NetnodeIndex ();
 
   ELEMENT_LOOP (PCB->Data);
   PIN_LOOP (element);
-  if (!TEST_FLAG (VISITFLAG, pin))
+  if (!written[ConnectionIndexNetLabel (pin) + 1])
     {
-      ClearFlagOnAllObjects(FOUNDFLAG, true);
-      LookupConnectionByPin (PIN_TYPE, pin);
+      written[ConnectionIndexNetLabel (pin) + 1] = true;
       sprintf (nodename, "%s-%s", element->Name[1].TextString, pin->Number);
-      netname = netnode_to_netname (nodename);
+      netname = (LibraryMenuType *) g_hash_table_lookup (netnodes, nodename);
 /*      Message("Netname: %s\n", netname->Name +2); */
       if (netname)
         {
@@ -503,16 +632,15 @@ IPCD356_Netlist (void)
         {
           strcpy (net, "N/C");
         }
-      IPCD356_WriteNet (fp, net);
+      IPCD356_WriteNet (fp, net, &nodes, ConnectionIndexNetLabel (pin));
     }
   END_LOOP; /* Pin. */
   PAD_LOOP (element);
-  if (!TEST_FLAG (VISITFLAG, pad))
+  if (!written[ConnectionIndexNetLabel (pad) + 1])
     {
-      ClearFlagOnAllObjects(FOUNDFLAG, true);
-      LookupConnectionByPin (PAD_TYPE, pad);
+      written[ConnectionIndexNetLabel (pad) + 1] = true;
       sprintf (nodename, "%s-%s", element->Name[1].TextString, pad->Number);
-      netname = netnode_to_netname (nodename);
+      netname = (LibraryMenuType *) g_hash_table_lookup (netnodes, nodename);
 /*      Message("Netname: %s\n", netname->Name +2); */
       if (netname)
         {
@@ -523,27 +651,30 @@ IPCD356_Netlist (void)
         {
           strcpy (net, "N/C");
         }
-      IPCD356_WriteNet (fp, net);
+      IPCD356_WriteNet (fp, net, &nodes, ConnectionIndexNetLabel (pad));
     }
   END_LOOP; /* Pad. */
 
   END_LOOP; /* Element. */
 
   VIA_LOOP (PCB->Data);
-  if (!TEST_FLAG (VISITFLAG, via))
+  if (!written[ConnectionIndexNetLabel (via) + 1])
     {
-      ClearFlagOnAllObjects(FOUNDFLAG, true);
-      LookupConnectionByPin (PIN_TYPE, via);
+      written[ConnectionIndexNetLabel (via) + 1] = true;
       strcpy (net, "N/C");
-      IPCD356_WriteNet (fp, net);
+      IPCD356_WriteNet (fp, net, &nodes, ConnectionIndexNetLabel (via));
     }
   END_LOOP; /* Via. */
 
   IPCD356_End (fp);
   fclose (fp);
+  g_hash_table_destroy (netnodes);
+  g_hash_table_destroy (aliaslist->Names);
+  free (aliaslist->Alias);
   free (aliaslist);
-  ResetVisitPinsViasAndPads ();
-  ClearFlagOnAllObjects(FOUNDFLAG, true);
+  free (written);
+  free (nodes.Node);
+  free (nodes.First);
   return 0;
 }
 
@@ -553,22 +684,6 @@ IPCD356_End (FILE * fd)
   fprintf (fd, "999\n");
 }
 
-void
-ResetVisitPinsViasAndPads ()
-{
-  VIA_LOOP (PCB->Data);
-    CLEAR_FLAG (VISITFLAG, via);
-  END_LOOP; /* Via. */
-  ELEMENT_LOOP (PCB->Data);
-    PIN_LOOP (element);
-      CLEAR_FLAG (VISITFLAG, pin);
-    END_LOOP; /* Pin. */
-    PAD_LOOP (element);
-      CLEAR_FLAG (VISITFLAG, pad);
-    END_LOOP; /* Pad. */
-  END_LOOP; /* Element. */
-}
-
 int
 IPCD356_WriteAliases (FILE * fd, IPCD356_AliasList * aliaslist)
 {
@@ -602,6 +717,11 @@ IPCD356_WriteAliases (FILE * fd, IPCD356_AliasList * aliaslist)
     {
       fprintf (fd, "C  End Netname Aliases Section\nC  \n");
     }
+
+  /* The aliases stay where they are from here on, so they can be keyed. */
+  for (i = 1; i <= aliaslist->AliasN; i++)
+    g_hash_table_insert (aliaslist->Names, aliaslist->Alias[i].NetName,
+                         aliaslist->Alias[i].NName);
   return 0;
 }
 
@@ -612,6 +732,8 @@ CreateAliasList ()
 
   aliaslist = malloc (sizeof (IPCD356_AliasList)); /* Create an alias list. */
   aliaslist->AliasN = 0; /* Initialize Number of Alias. */
+  aliaslist->Alias = NULL;
+  aliaslist->Names = g_hash_table_new (g_str_hash, g_str_equal);
   return aliaslist;
 }
 
@@ -631,16 +753,14 @@ AddAliasToList (IPCD356_AliasList * aliaslist)
 void
 CheckNetLength (char *net, IPCD356_AliasList * aliaslist)
 {
-  int i;
+  char *nname;
 
   if (strlen (net) > 14)
     {
-      for (i = 1; i <= aliaslist->AliasN; i++)
+      nname = (char *) g_hash_table_lookup (aliaslist->Names, net);
+      if (nname)
         {
-          if (strcmp (net, aliaslist->Alias[i].NetName) == 0)
-            {
-              strcpy (net, aliaslist->Alias[i].NName);
-            }
+          strcpy (net, nname);
         }
     }
 }
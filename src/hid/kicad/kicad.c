@@ -39,39 +39,180 @@
 #endif
 
 #include <stdio.h>
+#include <errno.h>
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include "global.h"
 #include "data.h"
 #include "error.h"
 #include "misc.h"
 #include "rats.h"
+#include "file.h"
 #include "find.h"
+#include "job.h"
 #include "pcb-printf.h"
+#include "polygon.h"
 
 #include "hid.h"
+#include "sexpr.h"
 #include "hid/common/hidnogui.h"
+#include "hid/common/placement.h"
 #include "../hidint.h"
 
 #ifdef HAVE_LIBDMALLOC
 #include <dmalloc.h>
 #endif
 
+static const char *kicad_compress_names[] = {
+#define KICAD_COMPRESS_NONE 0
+  "none",
+#define KICAD_COMPRESS_GZIP 1
+  "gzip",
+#define KICAD_COMPRESS_ZSTD 2
+  "zstd",
+  NULL
+};
+
+static const char *kicad_zone_hole_names[] = {
+#define KICAD_HOLES_KEEPOUTS 0
+  "keepouts",
+#define KICAD_HOLES_CONTOURS 1
+  "contours",
+  NULL
+};
+
+/*!
+ * \brief Compressor commands, writing the compressed data to stdout.
+ */
+static const char *kicad_compress_commands[] = {
+  NULL,
+  "gzip -c",
+  "zstd -q -c",
+};
+
 static HID_Attribute kicad_options[] = {
 /* %start-doc options "82 KiCad Creation"
 @ftable @code
 @item --kicad_file <string>
 Name of the KiCad output file.
 Parameter @code{<string>} can include a path.
+@samp{-} writes the board to the standard output, and a name starting
+with @samp{|} pipes it into the command following the bar.
 @end ftable
 %end-doc
 */
   {"kicadfile", "Name of the KiCad output file",
    HID_String, 0, 0, {0, 0, 0}, 0, 0},
 #define HA_kicad_file 0
+
+/* %start-doc options "82 KiCad Creation"
+@ftable @code
+@item --kicad-cache <string>
+Name of a footprint cache file.  When given, the text of each footprint
+is stored in this file, keyed by a hash of the element, and reused by
+the next export for the elements that did not change.
+@end ftable
+%end-doc
+*/
+  {"kicad-cache", "Name of the footprint cache file",
+   HID_String, 0, 0, {0, 0, 0}, 0, 0},
+#define HA_kicad_cache 1
+
+/* %start-doc options "82 KiCad Creation"
+@ftable @code
+@item --kicad-compress <none|gzip|zstd>
+Compress the output on the fly with the given program.
+@end ftable
+%end-doc
+*/
+  {"kicad-compress", "Compress the output",
+   HID_Enum, 0, 0, {KICAD_COMPRESS_NONE, 0, 0}, kicad_compress_names, 0},
+#define HA_kicad_compress 2
+
+/* %start-doc options "82 KiCad Creation"
+@ftable @code
+@item --kicad-batch <string>
+Convert all the boards listed in this file instead of the loaded one.
+Each line holds an input board, optionally followed by a tab and the
+name of the output file; by default the output is named after the input
+with the @code{.pcb} suffix replaced by @code{.kicad_pcb}.  The footprint
+cache is not used in batch mode, and pcb exits with an error if any
+board failed to convert.
+@item --kicad-jobs <int>
+Number of worker processes converting the boards of a batch.  A board
+whose worker process dies is converted by pcb itself.
+@end ftable
+%end-doc
+*/
+  {"kicad-batch", "File listing the boards to convert",
+   HID_String, 0, 0, {0, 0, 0}, 0, 0},
+#define HA_kicad_batch 3
+  {"kicad-jobs", "Number of worker processes for a batch",
+   HID_Integer, 1, 256, {1, 0, 0}, 0, 0},
+#define HA_kicad_jobs 4
+
+/* %start-doc options "82 KiCad Creation"
+@ftable @code
+@item --kicad-stats
+Report the time spent, the number of objects written and the bytes
+produced by each phase of the export.
+@end ftable
+%end-doc
+*/
+  {"kicad-stats", "Report export statistics",
+   HID_Boolean, 0, 0, {0, 0, 0}, 0, 0},
+#define HA_kicad_stats 5
+
+/* %start-doc options "82 KiCad Creation"
+@ftable @code
+@item --kicad-zone-holes <keepouts|contours>
+How the holes of the polygons are written.  @samp{keepouts} writes a
+keepout zone for each hole next to the zone of the polygon, and
+@samp{contours} writes each polygon as a single zone whose outline has
+the holes as further contours, which makes for much smaller files when
+pours have many holes.
+@end ftable
+%end-doc
+*/
+  {"kicad-zone-holes", "How the holes of the polygons are written",
+   HID_Enum, 0, 0, {KICAD_HOLES_KEEPOUTS, 0, 0}, kicad_zone_hole_names, 0},
+#define HA_kicad_zone_holes 6
+
+/* %start-doc options "82 KiCad Creation"
+@ftable @code
+@item --kicad-zone-fill
+Write the copper of each polygon, as cleared around the other objects
+by PCB, as the fill of its zone, so that KiCad need not fill the zones
+again when it opens the board.
+@end ftable
+%end-doc
+*/
+  {"kicad-zone-fill", "Write the zone fills",
+   HID_Boolean, 0, 0, {0, 0, 0}, 0, 0},
+#define HA_kicad_zone_fill 7
+
+/* %start-doc options "82 KiCad Creation"
+@ftable @code
+@item --kicad-library <string>
+Name of a directory, usually ending in @code{.pretty}, to also write a
+KiCad footprint library to.  It gets one @code{.kicad_mod} file for each
+distinct footprint geometry of the board, however many elements share
+it, and the footprints of the board name their library entry.  The
+library is not written in batch mode.
+@end ftable
+%end-doc
+*/
+  {"kicad-library", "Directory to write a footprint library to",
+   HID_String, 0, 0, {0, 0, 0}, 0, 0},
+#define HA_kicad_library 8
 };
 
 #define NUM_OPTIONS (sizeof(kicad_options)/sizeof(kicad_options[0]))
@@ -79,6 +220,103 @@ Parameter @code{<string>} can include a path.
 static HID_Attr_Val kicad_values[NUM_OPTIONS];
 
 static const char *kicad_filename;
+static const char *kicad_cachename;
+static int kicad_compress;
+static int kicad_zone_holes;
+static bool kicad_zone_fill;
+static const char *kicad_libraryname;
+
+/*!
+ * \brief The board is written to stdout, so messages must go elsewhere.
+ */
+static bool kicad_to_stdout;
+
+/*!
+ * \brief Log a message, to stderr while the board goes to stdout.
+ */
+static void
+kicad_log(const char* fmt, ...)
+{
+	va_list ap;
+
+	va_start (ap, fmt);
+	if (kicad_to_stdout)
+		vfprintf (stderr, fmt, ap);
+	else
+		gui->logv (fmt, ap);
+	va_end (ap);
+}
+
+/*!
+ * \brief Open the output stream for filename.
+ *
+ * Besides plain files this handles "-" (stdout), "|command" and the
+ * compressors, which are run through popen() like the save command of
+ * the core is.
+ *
+ * \return the stream, or NULL; *is_pipe tells to close it with pclose().
+ */
+static FILE*
+kicad_open_output(const char* filename, int compress, bool* is_pipe)
+{
+	const char* compressor = kicad_compress_commands[compress];
+	char* command = NULL;
+	FILE* fp;
+
+	*is_pipe = false;
+	kicad_to_stdout = strcmp(filename, "-") == 0;
+
+	if (filename[0] == '|')
+	{
+		if (compressor)
+			command = g_strdup_printf("%s | %s", compressor, filename + 1);
+		else
+			command = g_strdup(filename + 1);
+	}
+	else if (compressor)
+	{
+		if (kicad_to_stdout)
+			command = g_strdup(compressor);
+		else
+		{
+			char* quoted = g_shell_quote(filename);
+			command = g_strdup_printf("%s > %s", compressor, quoted);
+			g_free(quoted);
+		}
+	}
+	else if (kicad_to_stdout)
+	{
+		return stdout;
+	}
+	else
+	{
+		return fopen(filename, "wb");
+	}
+
+	/* The child shares our stdout, so get pending output out first. */
+	fflush(stdout);
+	fp = popen(command, "w");
+	if (!fp)
+		PopenErrorMessage(command);
+	g_free(command);
+	*is_pipe = true;
+	return fp;
+}
+
+/*!
+ * \brief Close a stream opened by kicad_open_output().
+ *
+ * \return false if the stream or the command it feeds failed.
+ */
+static bool
+kicad_close_output(FILE* fp, bool is_pipe)
+{
+	if (is_pipe)
+		return pclose(fp) == 0;
+	if (fp == stdout)
+		return fflush(fp) == 0 && !ferror(fp);
+	return fclose(fp) == 0;
+}
 
 /*!
  * \brief Get export options.
@@ -101,25 +339,77 @@ kicad_get_export_options (int *n)
 }
 
 
+/*!
+ * \brief Hash of the board name, the namespace of the exported uuids.
+ */
+static uint64_t kicad_uuid_ns;
+
+/*!
+ * \brief Scramble the bits of a 64 bit value (the splitmix64 finaliser).
+ */
+static uint64_t
+kicad_mix64(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/*!
+ * \brief Derive the uuid namespace from the name of the current board.
+ */
+static void
+kicad_uuid_init(void)
+{
+	const char* name = PCB->Name ? PCB->Name : (PCB->Filename ? PCB->Filename : "");
+	uint64_t h = 0xcbf29ce484222325ULL;
+
+	for(; *name; name++)
+	{
+		h ^= (unsigned char) *name;
+		h *= 0x100000001b3ULL;
+	}
+	kicad_uuid_ns = h;
+}
+
+/*!
+ * \brief Make the uuid of an exported object.
+ *
+ * The uuid is a hash of the board name, the object type, the object ID
+ * and a sub index for the items one object expands into (the texts of a
+ * footprint, the keepouts of the holes of a polygon).  IDs are handed out
+ * in file order on load, so exporting an unchanged board again gives an
+ * identical file.  The version and variant fields mark the result as a
+ * version 8 (custom) uuid.
+ *
+ * This only reads kicad_uuid_ns and is safe to call from the layer
+ * workers.
+ */
 static char*
-kicad_uuid(char* uuid)
+kicad_uuid(char* uuid, int type, long id, int sub)
 {
-	const char* uuidchars = "0123456789abcdef";
-	for(int i=0; i<8; i++)
-		uuid[i] = uuidchars[rand()%16];
-	uuid[8] = '-';
-	for(int i=9; i<13; i++)
-		uuid[i] = uuidchars[rand()%16];
-	uuid[13] = '-';
-	for(int i=14; i<18; i++)
-		uuid[i] = uuidchars[rand()%16];
-	uuid[18] = '-';
-	for(int i=19; i<23; i++)
-		uuid[i] = uuidchars[rand()%16];
-	uuid[23] = '-';
-	for(int i=24; i<36; i++)
-		uuid[i] = uuidchars[rand()%16];
-	uuid[36] = '\0';
+	static const char hexchars[] = "0123456789abcdef";
+	uint64_t hi, lo;
+	char* p = uuid;
+
+	lo = kicad_mix64(kicad_uuid_ns ^ ((uint64_t) id * 0x9e3779b97f4a7c15ULL));
+	hi = kicad_mix64(lo ^ ((uint64_t) type << 32 | (uint32_t) sub));
+	lo = kicad_mix64(lo + hi);
+
+	hi = (hi & ~0xf000ULL) | 0x8000ULL;
+	lo = (lo & 0x3fffffffffffffffULL) | 0x8000000000000000ULL;
+
+	for(int i = 0; i < 32; i++)
+	{
+		uint64_t w = i < 16 ? hi : lo;
+		*p++ = hexchars[(w >> (60 - 4 * (i & 15))) & 0xf];
+		if(i == 7 || i == 11 || i == 15 || i == 19)
+			*p++ = '-';
+	}
+	*p = '\0';
 	return uuid;
 }
 
@@ -129,308 +419,1664 @@ typedef struct
 	char net_name[16];
 } net_descriptor;
 
-typedef struct
+/*!
+ * \brief Net of each copper object that has one, see kicad_assign_nets().
+ *
+ * The layer threads of kicad_print() look nets up here rather than in
+ * the connectivity index: a query there may relabel the board, which
+ * only the main thread may do.  This table is built before they start
+ * and is only read while they run.
+ */
+static GHashTable* kicad_object_net;
+
+/*!
+ * \brief Netlist node name ("ElementName-PinNumber") to net index + 1.
+ */
+static GHashTable* kicad_node_net;
+
+/*!
+ * \brief Build the node name index of the netlist.
+ *
+ * If a node is listed in more than one net, the last one wins, as it
+ * did with the nested netlist scan.
+ */
+static void
+kicad_build_node_index(void)
 {
-	void* item;
-	net_descriptor* net;
-} net_assignment;
+	int i, j;
 
-net_assignment* kicad_net_assign;
-int kicad_num_net_assign;
-int kicad_max_net_assign;
+	kicad_node_net = g_hash_table_new(g_str_hash, g_str_equal);
+	for (i=0; i<PCB->NetlistLib.MenuN; i++)
+	{
+		for (j=0; j<PCB->NetlistLib.Menu[i].EntryN; j++)
+		{
+			g_hash_table_insert(kicad_node_net,
+			                    PCB->NetlistLib.Menu[i].Entry[j].ListEntry,
+			                    GINT_TO_POINTER(i + 1));
+		}
+	}
+}
 
-void kicad_add_net_assign(void* item, net_descriptor* net)
+/*!
+ * \brief Look up the netlist net of an element pin or pad by node name.
+ */
+static net_descriptor*
+kicad_find_node_net(ElementType* element, char* number, net_descriptor* net_descs)
 {
-	if(kicad_num_net_assign >= kicad_max_net_assign)
-	{
-		const int grow = 1000;
-		net_assignment* tmp = kicad_net_assign;
-		kicad_net_assign = calloc(kicad_max_net_assign + grow, sizeof(net_assignment));
-		memcpy(kicad_net_assign, tmp, kicad_max_net_assign * sizeof(net_assignment));
-		kicad_max_net_assign += grow;
-		free(tmp);
-	}
-	kicad_net_assign[kicad_num_net_assign].item = item;
-	kicad_net_assign[kicad_num_net_assign].net  = net;
-	kicad_num_net_assign++;
+	int i;
+	char nodename[256];
+	snprintf(nodename, sizeof(nodename), "%s-%s", element->Name[1].TextString, number);
+	i = GPOINTER_TO_INT(g_hash_table_lookup(kicad_node_net, nodename));
+	return i ? &net_descs[i] : 0;
 }
 
+/*!
+ * \brief Note the net of label of a copper object in kicad_object_net.
+ */
+static void
+kicad_note_net(net_descriptor** label_net, void* item)
+{
+	int label = ConnectionIndexNetLabel(item);
+
+	if (label >= 0 && label_net[label])
+		g_hash_table_insert(kicad_object_net, item, label_net[label]);
+}
 
-void kicad_add_net(int type, void* ptr, net_descriptor* net)
+/*!
+ * \brief Assign a net to every copper object of the board.
+ *
+ * The net labels of the connectivity index group the copper objects.
+ * Each group then takes the net of its first pin or pad in export order,
+ * which is the pin the per-net lookup used to start from.  Runs on the
+ * main thread, and is the last use of the index by the export.
+ */
+static void
+kicad_assign_nets(net_descriptor* net_descs)
 {
-	ClearFlagOnAllObjects(FOUNDFLAG, true);
-	LookupConnectionByPin(type, ptr);
+	int num_labels;
+	bool* decided;
+	net_descriptor** label_net;
+
+	kicad_build_node_index();
+	num_labels = ConnectionIndexNetCount();
+	label_net = calloc(num_labels + 1, sizeof(net_descriptor*));
+	decided = calloc(num_labels + 1, sizeof(bool));
 
 	ELEMENT_LOOP (PCB->Data);
 	{
-		PAD_LOOP (element);
+		PIN_LOOP (element);
 		{
-			if (!TEST_FLAG (VISITFLAG, pad))
+			int label = ConnectionIndexNetLabel(pin);
+			if (label >= 0 && !decided[label])
 			{
-				if (TEST_FLAG (FOUNDFLAG, pad))
-				{
-					kicad_add_net_assign(pad, net);
-					SET_FLAG (VISITFLAG, pad);
-				}
+				label_net[label] = kicad_find_node_net(element, pin->Number, net_descs);
+				decided[label] = true;
 			}
 		}
-		END_LOOP; /* Pad. */
-		PIN_LOOP (element);
+		END_LOOP; /* Pin. */
+		PAD_LOOP (element);
 		{
-			if (!TEST_FLAG (VISITFLAG, pin))
+			int label = ConnectionIndexNetLabel(pad);
+			if (pad->Thickness > 0 && label >= 0 && !decided[label])
 			{
-				if (TEST_FLAG (FOUNDFLAG, pin))
-				{
-					kicad_add_net_assign(pin, net);
-					SET_FLAG (VISITFLAG, pin);
-				}
+				label_net[label] = kicad_find_node_net(element, pad->Number, net_descs);
+				decided[label] = true;
 			}
 		}
-		END_LOOP; /* Pin. */
+		END_LOOP; /* Pad. */
 	}
 	END_LOOP; /* Element */
 
-	VIA_LOOP (PCB->Data);
+	kicad_object_net = g_hash_table_new(g_direct_hash, g_direct_equal);
+	ALLPIN_LOOP (PCB->Data);
 	{
-		if (!TEST_FLAG (VISITFLAG, via))
-		{
-			if (TEST_FLAG (FOUNDFLAG, via))
-			{
-				kicad_add_net_assign(via, net);
-				SET_FLAG (VISITFLAG, via);
-			}
-		}
+		kicad_note_net(label_net, pin);
 	}
-  END_LOOP; /* Via. */
-
-
-	LAYER_LOOP(PCB->Data, max_copper_layer)
+	ENDALL_LOOP;
+	ALLPAD_LOOP (PCB->Data);
 	{
-		LINE_LOOP(layer)
-		{
-			if (!TEST_FLAG (VISITFLAG, line))
-			{
-				if (TEST_FLAG (FOUNDFLAG, line))
-				{
-					kicad_add_net_assign(line, net);
-					SET_FLAG (VISITFLAG, line);
-				}
-			}
-		}
-		END_LOOP;
-
-		ARC_LOOP(layer)
-		{
-			if (!TEST_FLAG (VISITFLAG, arc))
-			{
-				if (TEST_FLAG (FOUNDFLAG, arc))
-				{
-					kicad_add_net_assign(arc, net);
-					SET_FLAG (VISITFLAG, arc);
-				}
-			}
-		}
-		END_LOOP;
-
-		POLYGON_LOOP(layer)
-		{
-			if (!TEST_FLAG (VISITFLAG, polygon))
-			{
-				if (TEST_FLAG (FOUNDFLAG, polygon))
-				{
-					kicad_add_net_assign(polygon, net);
-					SET_FLAG (VISITFLAG, polygon);
-				}
-			}
-		}
-		END_LOOP;
+		kicad_note_net(label_net, pad);
+	}
+	ENDALL_LOOP;
+	VIA_LOOP (PCB->Data);
+	{
+		kicad_note_net(label_net, via);
 	}
 	END_LOOP;
+	COPPERLINE_LOOP (PCB->Data);
+	{
+		kicad_note_net(label_net, line);
+	}
+	ENDALL_LOOP;
+	COPPERARC_LOOP (PCB->Data);
+	{
+		kicad_note_net(label_net, arc);
+	}
+	ENDALL_LOOP;
+	COPPERPOLYGON_LOOP (PCB->Data);
+	{
+		kicad_note_net(label_net, polygon);
+	}
+	ENDALL_LOOP;
 
+	free(label_net);
+	free(decided);
+	g_hash_table_destroy(kicad_node_net);
+	kicad_node_net = 0;
 }
 
+static void
+kicad_free_nets(void)
+{
+	g_hash_table_destroy(kicad_object_net);
+	kicad_object_net = 0;
+}
+
+/*!
+ * \brief Return the net of a copper object, or NULL.
+ *
+ * Only reads kicad_object_net, so the layer threads may call it.
+ */
 net_descriptor* kicad_get_net_assign(void* item)
 {
-	int i;
-	for(i=0; i<kicad_num_net_assign; i++)
-	{
-		if(item == kicad_net_assign[i].item)
-		{
-			return kicad_net_assign[i].net;
-		}
-	}
-	return 0;
+	return (net_descriptor*) g_hash_table_lookup(kicad_object_net, item);
 }
 
-/* Adopted from bom.c */
-static double
-xyToAngle (double x, double y, bool morethan2pins)
+/*!
+ * \brief The rotation of a footprint about its mark.
+ */
+double kicad_get_rotation(ElementType *element)
 {
-  double d = atan2 (-y, x) * 180.0 / M_PI;
+	ElementPlacementType place;
 
-  /* IPC 7351 defines different rules for 2 pin elements */
-  if (morethan2pins)
-    {
-      /* Multi pin case:
-       * Output 0 degrees if pin1 in is top left or top, i.e. between angles of
-       * 80 to 170 degrees.
-       * Pin #1 can be at dead top (e.g. certain PLCCs) or anywhere in the top
-       * left.
-       */
-      if (d < -100)
-        return 90; /* -180 to -100 */
-      else if (d < -10)
-        return 180; /* -100 to -10 */
-      else if (d < 80)
-        return 270; /* -10 to 80 */
-      else if (d < 170)
-        return 0; /* 80 to 170 */
-      else
-        return 90; /* 170 to 180 */
-    }
-  else
-    {
-      /* 2 pin element:
-       * Output 0 degrees if pin #1 is in top left or left, i.e. in sector
-       * between angles of 95 and 185 degrees.
-       */
-      if (d < -175)
-        return 0; /* -180 to -175 */
-      else if (d < -85)
-        return 90; /* -175 to -85 */
-      else if (d < 5)
-        return 180; /* -85 to 5 */
-      else if (d < 95)
-        return 270; /* 5 to 95 */
-      else
-        return 0; /* 95 to 180 */
-    }
+	ElementGetPlacement(element, true, &place);
+	return place.rotation;
 }
 
-/* Adopted from bom.c */
-#define MAXREFPINS 32
-static char *reference_pin_names[] = {"1", "2", "A1", "A2", "B1", "B2", 0};
+#pragma GCC diagnostic ignored "-Wdeclaration-after-statement"
 
-double kicad_get_rotation(ElementType *element)
+/*!
+ * \brief Phases of an export, as reported by --kicad-stats.
+ */
+enum
 {
-	double theta = 0.0;
+	KICAD_PHASE_NETS,
+	KICAD_PHASE_FOOTPRINTS,
+	KICAD_PHASE_VIAS,
+	KICAD_PHASE_SEGMENTS,
+	KICAD_PHASE_ZONES,
+	KICAD_PHASE_TEXT,
+	KICAD_PHASE_N
+};
 
-	char* fixed_rotation;
-	fixed_rotation = AttributeGetFromList (&element->Attributes, "xy-fixed-rotation");
+static const char *kicad_phase_names[KICAD_PHASE_N] = {
+	"nets",
+	"footprints",
+	"vias",
+	"segments",
+	"zones",
+	"text",
+};
 
-	if(fixed_rotation)
-	{
-		/* The user specified a fixed rotation */
-		theta = atof(fixed_rotation);
-	}
-	else
-	{
-		Coord x, y;
-		int pin_cnt;
-		int pinfound[MAXREFPINS];
-		double pinx[MAXREFPINS];
-		double piny[MAXREFPINS];
-		double pinangle[MAXREFPINS];
-		int rpindex;
+/*!
+ * \brief Time, output objects and bytes of one phase.
+ */
+typedef struct
+{
+	gint64 usec;
+	long count;
+	size_t bytes;
+} kicad_phase_stats;
 
-		double pin1x, pin1y;
-		/* Initialize our pin count and our totals for finding the centroid. */
+/*!
+ * \brief Start of a phase, see kicad_phase_begin().
+ */
+typedef struct
+{
+	gint64 start;
+	size_t written;
+} kicad_phase_mark;
 
-		pin_cnt = 0;
-		for (rpindex = 0; rpindex < MAXREFPINS; rpindex++)
-			pinfound[rpindex] = 0;
+static bool kicad_stats;
 
-		/*
-		 * Iterate over the pins and pads keeping a running count of how
-		 * many pins/pads total and the sum of x and y coordinates
-		 *
-		 * While we're at it, store the location of pin/pad #1 and #2 if
-		 * we can find them.
-		 */
+static void
+kicad_phase_begin(kicad_phase_mark* mark, SexprWriter* out)
+{
+	if (!kicad_stats)
+		return;
+	mark->start = g_get_monotonic_time();
+	mark->written = out->written;
+}
 
-		PIN_LOOP (element);
-		{
-			pin_cnt++;
+static void
+kicad_phase_end(kicad_phase_stats* stats, kicad_phase_mark* mark, SexprWriter* out, long count)
+{
+	if (!kicad_stats)
+		return;
+	stats->usec += g_get_monotonic_time() - mark->start;
+	stats->bytes += out->written - mark->written;
+	stats->count += count;
+}
 
-			for (rpindex = 0; reference_pin_names[rpindex]; rpindex++)
+/*!
+ * \brief Log the statistics of an export.
+ *
+ * The segment, zone and text times are summed over the layer workers.
+ */
+static void
+kicad_report_stats(kicad_phase_stats* stats, gint64 usec, size_t bytes)
+{
+	int i;
+
+	kicad_log ((_("KiCad export statistics for %s:\n")), kicad_filename);
+	for (i = 0; i < KICAD_PHASE_N; i++)
+	{
+		kicad_log ("  %-12s %10.3f ms %10ld objects %12lu bytes\n",
+		           kicad_phase_names[i], stats[i].usec / 1000.0,
+		           stats[i].count, (unsigned long) stats[i].bytes);
+	}
+	kicad_log ("  %-12s %10.3f ms %10s         %12lu bytes\n",
+	           "total", usec / 1000.0, "", (unsigned long) bytes);
+}
+
+/*!
+ * \brief A layer to export, see kicad_print_layer().
+ */
+typedef struct
+{
+	LayerType* layer;
+	char layername[32];
+	int is_copper;
+	net_descriptor* net_descs;
+	SexprWriter out;   /*!< Memory writer collecting the layer's text. */
+	kicad_phase_stats stats[KICAD_PHASE_N];
+} kicad_layer_job;
+
+/*!
+ * \brief Write the points FROM up to TO of a polygon, seven to a line.
+ *
+ * NP counts the points on the current line and goes on from one call to
+ * the next.
+ */
+static void
+kicad_print_points(SexprWriter* out, PointType* points, int from, int to, int* np)
+{
+	for (int n = from; n < to; n++)
+	{
+		sexpr_puts (out, *np == 0 ? "\t\t\t\t(xy " : " (xy ");
+		sexpr_coord_mm (out, points[n].X);
+		sexpr_putc (out, ' ');
+		sexpr_coord_mm (out, points[n].Y);
+		sexpr_putc (out, ')');
+		if (++*np > 6)
+		{
+			*np = 0;
+			sexpr_putc (out, '\n');
+		}
+	}
+
+	if (*np != 0)
+	{
+		sexpr_putc (out, '\n');
+	}
+}
+
+/*!
+ * \brief Where the filled_polygon pieces of a zone go.
+ */
+typedef struct
+{
+	SexprWriter* out;
+	const char* layername;
+} kicad_fill_target;
+
+/*!
+ * \brief Write one hole free piece of a polygon's copper as a
+ * filled_polygon, and free it.
+ */
+static void
+kicad_print_fill_piece(PLINE* pl, void* user_data)
+{
+	kicad_fill_target* target = user_data;
+	SexprWriter* out = target->out;
+	PLINE* local_pl = pl;
+	VNODE* v = &pl->head;
+	int np = 0;
+
+	sexpr_printf (out, "\t\t(filled_polygon\n\t\t\t(layer \"%s\")\n\t\t\t(pts\n", target->layername);
+	do
+	{
+		sexpr_puts (out, np == 0 ? "\t\t\t\t(xy " : " (xy ");
+		sexpr_coord_mm (out, v->point[0]);
+		sexpr_putc (out, ' ');
+		sexpr_coord_mm (out, v->point[1]);
+		sexpr_putc (out, ')');
+		if (++np > 6)
+		{
+			np = 0;
+			sexpr_putc (out, '\n');
+		}
+	}
+	while ((v = v->next) != &pl->head);
+	if (np != 0)
+	{
+		sexpr_putc (out, '\n');
+	}
+	sexpr_puts (out, "\t\t\t)\n\t\t)\n");
+
+	poly_FreeContours (&local_pl);
+}
+
+/*!
+ * \brief Write the copper of a polygon as filled_polygon pieces.
+ *
+ * KiCad wants the fill without holes, so the clipped area is diced
+ * like for the GUIs that can't draw holes.
+ */
+static void
+kicad_print_fill(SexprWriter* out, PolygonType* polygon, const char* layername)
+{
+	kicad_fill_target target = { out, layername };
+	PolygonType p;
+
+	if (polygon->Clipped == NULL)
+		return;
+
+	NoHolesPolygonDicer (polygon, NULL, kicad_print_fill_piece, &target);
+
+	/* the other pieces of a full polygon */
+	if (TEST_FLAG (FULLPOLYFLAG, polygon))
+	{
+		p = *polygon;
+		for (p.Clipped = polygon->Clipped->f;
+		     p.Clipped != polygon->Clipped;
+		     p.Clipped = p.Clipped->f)
+			NoHolesPolygonDicer (&p, NULL, kicad_print_fill_piece, &target);
+	}
+}
+
+/*!
+ * \brief Write the segments, arcs, zones and texts of one layer.
+ *
+ * This only reads the board and the net assignment, so the layers can
+ * be generated concurrently.
+ */
+static void
+kicad_print_layer(kicad_layer_job* job)
+{
+	LayerType* layer = job->layer;
+	const char* layername = job->layername;
+	int is_copper = job->is_copper;
+	net_descriptor* net_descs = job->net_descs;
+	SexprWriter* out = &job->out;
+	kicad_phase_mark mark;
+	long zones = 0;
+	char uuid[37];
+
+	if(is_copper)
+	{
+		kicad_phase_begin(&mark, out);
+		LINE_LOOP(layer)
+		{
+			const char* kicad_segment =
+			"\t(segment\n"
+			"\t\t(start %M %M)\n"
+			"\t\t(end %M %M)\n"
+			"\t\t(width %M)\n"
+			"\t\t(layer \"%s\")\n"
+			"\t\t(net %d)\n"
+			"\t\t(uuid \"%s\")\n"
+			"\t)\n";
+
+			net_descriptor* net = kicad_get_net_assign(line);
+
+			if(net == 0)
+			{
+				net = &net_descs[0];
+			}
+
+			sexpr_printf (out, kicad_segment,
+			              line->Point1.X, line->Point1.Y,
+			              line->Point2.X, line->Point2.Y,
+			              line->Thickness,
+			              layername, net->net_id, kicad_uuid(uuid, LINE_TYPE, line->ID, 0));
+		}
+		END_LOOP;
+
+		ARC_LOOP(layer)
+		{
+			const char* kicad_arc =
+			"\t(arc\n"
+			"\t\t(start %f %f)\n"
+//				"\t\t(mid %f %f)\n"
+			"\t\t(end %f %f)\n"
+			"\t\t(angle %f)\n"
+			"\t\t(width %f)\n"
+			"\t\t(layer \"%s\")\n"
+			"\t\t(net %d)\n"
+			"\t\t(uuid \"%s\")\n"
+			"\t)\n";
+
+			double x, y, width, height, startangle, delta, thick;
+			x = COORD_TO_MM(arc->X);
+			y = COORD_TO_MM(arc->Y);
+			width  = COORD_TO_MM(arc->Width);
+			height = COORD_TO_MM(arc->Height);
+			startangle = arc->StartAngle * M_PI / 180.0;
+			delta      = arc->Delta * M_PI / 180.0;
+			thick      = COORD_TO_MM(arc->Thickness);
+
+			//double radius, xstart, ystart,xend, yend;
+			double radius, xend, yend;
+			radius = (width + height) / 2.0;
+			//xstart = x - radius * cos(startangle);
+			//ystart = y + radius * sin(startangle);
+			xend   = x - radius * cos(startangle + delta);
+			yend   = y + radius * sin(startangle + delta);
+
+			net_descriptor* net = kicad_get_net_assign(arc);
+
+			if(net == 0)
+			{
+				net = &net_descs[0];
+			}
+
+			//sexpr_printf (out, kicad_arc, xstart, ystart, x, y, xend, yend, thick, layername, net->net_id, kicad_uuid(uuid, ARC_TYPE, arc->ID, 0));
+			sexpr_printf (out, kicad_arc, x, y, xend, yend, arc->Delta, thick, layername, net->net_id, kicad_uuid(uuid, ARC_TYPE, arc->ID, 0));
+		}
+		END_LOOP;
+		kicad_phase_end(&job->stats[KICAD_PHASE_SEGMENTS], &mark, out, layer->LineN + layer->ArcN);
+
+		kicad_phase_begin(&mark, out);
+		POLYGON_LOOP(layer)
+		{
+			const char* kicad_zone_header =
+			"\t(zone\n"
+			"\t\t(net %d)\n"
+			"\t\t(net_name \"%s\")\n"
+			"\t\t(layer \"%s\")\n"
+			"\t\t(uuid \"%s\")\n"
+			"\t\t(hatch edge 0.508)\n"
+			"\t\t(connect_pads no (clearance 0.25))\n"
+			"\t\t(min_thickness 0.1)\n"
+			"\t\t(fill yes\n"
+			"\t\t\t(island_removal_mode %d)\n"
+			"\t\t\t(island_area_min %f)\n"
+			"\t\t)\n"
+			"\t\t(polygon\n\t\t\t(pts\n";
+
+			const char* kicad_contour_header =
+			"\t\t(polygon\n\t\t\t(pts\n";
+
+			const char* kicad_contour_footer =
+			"\t\t\t)\n"
+			"\t\t)\n";
+
+			int np = 0;
+
+			net_descriptor* net = kicad_get_net_assign(polygon);
+			if(net == 0)
+			{
+				net = &net_descs[0];
+			}
+
+			int full = 0;
+			if(TEST_FLAG(FULLPOLYFLAG, polygon))
+			{
+				full = 2;
+			}
+
+			double min_poly_area = COORD_TO_MM(COORD_TO_MM(PCB->IsleArea));
+
+			sexpr_printf (out, kicad_zone_header, net->net_id, net->net_name, layername, kicad_uuid(uuid, POLYGON_TYPE, polygon->ID, 0), full, min_poly_area);
+
+			int PointN = polygon->HoleIndexN > 0 ? polygon->HoleIndex[0] : polygon->PointN;
+			kicad_print_points (out, polygon->Points, 0, PointN, &np);
+
+			if(kicad_zone_holes == KICAD_HOLES_CONTOURS)
+			{
+				/* KiCad takes the further contours of a zone for its holes. */
+				for(int h = 0; h < polygon->HoleIndexN; h++)
+				{
+					int EndPointN = (h+1) < polygon->HoleIndexN ? polygon->HoleIndex[h+1] : polygon->PointN;
+					np = 0;
+					sexpr_puts (out, kicad_contour_footer);
+					sexpr_puts (out, kicad_contour_header);
+					kicad_print_points (out, polygon->Points, polygon->HoleIndex[h], EndPointN, &np);
+				}
+			}
+			sexpr_puts (out, kicad_contour_footer);
+			if(kicad_zone_fill)
+			{
+				kicad_print_fill (out, polygon, layername);
+			}
+			sexpr_puts (out, "\t)\n");
+
+			if(kicad_zone_holes == KICAD_HOLES_CONTOURS)
+			{
+				zones++;
+				continue;
+			}
+
+			for(int h = 0; h < polygon->HoleIndexN; h++)
+			{
+				const char* kicad_keepout_header =
+				"\t(zone\n"
+				"\t\t(net %d)\n"
+				"\t\t(net_name \"\")\n"
+				"\t\t(layer \"%s\")\n"
+				"\t\t(uuid \"%s\")\n"
+				"\t\t(hatch edge 0.508)\n"
+				"\t\t(connect_pads no (clearance 0.25))\n"
+				"\t\t(min_thickness 0.1)\n"
+				"\t\t(keepout\n"
+				"\t\t\t(tracks allowed)\n"
+				"\t\t\t(vias allowed)\n"
+				"\t\t\t(pads allowed)\n"
+				"\t\t\t(copperpour not_allowed)\n"
+				"\t\t\t(footprints allowed)\n"
+				"\t\t)\n"
+				"\t\t(fill yes\n"
+//					"\t\t\t(island_removal_mode 2)\n"
+//					"\t\t\t(island_area_min %f)\n"
+				"\t\t)\n"
+				"\t\t(polygon\n\t\t\t(pts\n";
+
+				const char* kicad_keepout_footer =
+				"\t\t\t)\n"
+				"\t\t)\n"
+				"\t)\n";
+
+				sexpr_printf (out, kicad_keepout_header, net->net_id, layername, kicad_uuid(uuid, POLYGON_TYPE, polygon->ID, h + 1));
+
+				int EndPointN = (h+1) < polygon->HoleIndexN ? polygon->HoleIndex[h+1] : polygon->PointN;
+				kicad_print_points (out, polygon->Points, polygon->HoleIndex[h], EndPointN, &np);
+				sexpr_printf (out, kicad_keepout_footer);
+			}
+			zones += 1 + polygon->HoleIndexN;
+		}
+		END_LOOP;
+		kicad_phase_end(&job->stats[KICAD_PHASE_ZONES], &mark, out, zones);
+	}
+	else
+	{
+		kicad_phase_begin(&mark, out);
+		LINE_LOOP(layer)
+		{
+			const char* kicad_gr_line =
+			"\t(gr_line\n"
+			"\t\t(start %f %f)\n"
+			"\t\t(end %f %f)\n"
+			"\t\t(stroke\n\t\t\t(width %f)\n\t\t\t(type solid)\n\t\t)\n"
+			"\t\t(layer \"%s\")\n"
+			"\t\t(uuid \"%s\")\n"
+			"\t)\n";
+
+			double x1, y1, x2, y2, thick;
+			x1 = COORD_TO_MM(line->Point1.X);
+			x2 = COORD_TO_MM(line->Point2.X);
+			y1 = COORD_TO_MM(line->Point1.Y);
+			y2 = COORD_TO_MM(line->Point2.Y);
+			thick = COORD_TO_MM(line->Thickness);
+
+			sexpr_printf (out, kicad_gr_line, x1, y1, x2, y2, thick, layername, kicad_uuid(uuid, LINE_TYPE, line->ID, 0));
+		}
+		END_LOOP;
+
+		ARC_LOOP(layer)
+		{
+			const char* kicad_gr_arc =
+			"\t(gr_arc\n"
+			"\t\t(start %f %f)\n"
+			//"\t\t(mid %f %f)\n"
+			"\t\t(end %f %f)\n"
+			"\t\t(angle %f)\n"
+			"\t\t(stroke\n\t\t\t(width %f)\n\t\t\t(type solid)\n\t\t)\n"
+			"\t\t(layer \"%s\")\n"
+			"\t\t(uuid \"%s\")\n"
+			"\t)\n";
+
+			double x, y, width, height, startangle, delta, thick;
+			x = COORD_TO_MM(arc->X);
+			y = COORD_TO_MM(arc->Y);
+			width  = COORD_TO_MM(arc->Width);
+			height = COORD_TO_MM(arc->Height);
+			startangle = arc->StartAngle * M_PI / 180.0;
+			delta      = arc->Delta * M_PI / 180.0;
+			thick      = COORD_TO_MM(arc->Thickness);
+
+			//double radius, xstart, ystart, xmid, ymid, xend, yend;
+			double radius, xend, yend;
+			radius = (width + height) / 2.0;
+//				xstart = x - radius * cos(startangle);
+//				ystart = y + radius * sin(startangle);
+//				xmid   = x - radius * cos(startangle + 0.5 * delta);
+//				ymid   = y + radius * sin(startangle + 0.5 * delta);
+			xend   = x - radius * cos(startangle + delta);
+			yend   = y + radius * sin(startangle + delta);
+
+			//sexpr_printf (out, kicad_gr_arc, xstart, ystart, xmid, ymid, xend, yend, thick, layername, kicad_uuid(uuid, ARC_TYPE, arc->ID, 0));
+			sexpr_printf (out, kicad_gr_arc, x, y, xend, yend, arc->Delta, thick, layername, kicad_uuid(uuid, ARC_TYPE, arc->ID, 0));
+		}
+		END_LOOP;
+		kicad_phase_end(&job->stats[KICAD_PHASE_SEGMENTS], &mark, out, layer->LineN + layer->ArcN);
+
+		kicad_phase_begin(&mark, out);
+		TEXT_LOOP(layer)
+		{
+			const char* kicad_gr_text =
+			"\t(gr_text \"%s\"\n"
+			"\t\t(at %f %f %d)\n"
+			"\t\t(layer \"%s\")\n"
+			"\t\t(uuid \"%s\")\n"
+			"\t\t(effects\n"
+			"\t\t\t(font\n"
+			"\t\t\t\t(size %f %f)\n"
+			"\t\t\t\t(thickness 0.18)\n"
+			"\t\t\t)\n"
+			"\t\t\t(justify left top %s)\n"
+			"\t\t)\n"
+			"\t)\n";
+
+			double x, y, theight, twidth;
+			int angle;
+			x = COORD_TO_MM(text->X);
+			y = COORD_TO_MM(text->Y);
+			theight = 1.0 * text->Scale / 100.0;
+			twidth  = 0.8 * text->Scale / 100.0;
+			angle   = text->Direction * 90;
+
+			char* mirror = "";
+			if(TEST_FLAG(ONSOLDERFLAG, text))
+			{
+				mirror = "mirror";
+				angle = 180 - angle;
+			}
+
+			sexpr_printf (out, kicad_gr_text, text->TextString,
+								x,
+								y,
+								angle,
+								layername,
+								kicad_uuid(uuid, TEXT_TYPE, text->ID, 0), theight, twidth, mirror);
+		}
+		END_LOOP;
+		kicad_phase_end(&job->stats[KICAD_PHASE_TEXT], &mark, out, layer->TextN);
+	}
+}
+
+/*!
+ * \brief Job queue shared by the layer worker threads.
+ */
+typedef struct
+{
+	kicad_layer_job* jobs;
+	gint n;
+	gint next;
+} kicad_layer_queue;
+
+static gpointer
+kicad_layer_worker(gpointer data)
+{
+	kicad_layer_queue* q = data;
+	gint i;
+
+	while ((i = g_atomic_int_add(&q->next, 1)) < q->n)
+	{
+		kicad_print_layer(&q->jobs[i]);
+	}
+	return NULL;
+}
+
+
+/*!
+ * \brief Library entry names of the elements, while a library is written.
+ */
+static GHashTable* kicad_library_elements;
+
+/*!
+ * \brief The library entry names, owning them.
+ */
+static GHashTable* kicad_library_names;
+
+/*!
+ * \brief The footprint of a library entry is being written.
+ */
+static bool kicad_library_mode;
+
+/*!
+ * \brief The name of the footprint of an element.
+ */
+static const char*
+kicad_footprint_name(ElementType* element)
+{
+	const char* name = NULL;
+
+	if (kicad_library_elements)
+		name = g_hash_table_lookup(kicad_library_elements, element);
+	return name ? name : element->Name[0].TextString;
+}
+
+/*!
+ * \brief Write the footprint of one element.
+ *
+ * In kicad_library_mode the footprint is written at the origin, its
+ * pads have no nets and its texts are REF** and the entry name, for a
+ * library entry.
+ */
+static void
+kicad_print_element(SexprWriter* out, ElementType* element, net_descriptor* net_descs)
+{
+	char uuid[37];
+
+	const char* kicad_footprint_header =
+	"\t(footprint \"geda:%s\"\n"
+	"\t\t(layer \"%s\")\n"
+	"\t\t(uuid \"%s\")\n"
+	"\t\t(at %f %f %f)\n";
+
+	char* clayer = "F.Cu";
+	char* slayer = "F.SilkS";
+	char* flayer = "F.Fab";
+	char* hidename = "no";
+	char* mirror = "";
+
+	int onsolder = TEST_FLAG (ONSOLDERFLAG, element);
+	if (onsolder)
+	{
+		clayer = "B.Cu";
+		slayer = "B.SilkS";
+		flayer = "B.Fab";
+		mirror = "mirror";
+	}
+
+	if(TEST_FLAG(HIDENAMEFLAG, element))
+	{
+		hidename = "yes";
+	}
+
+	float ex, ey, rot, sinphi, cosphi;
+	ex = COORD_TO_MM(element->MarkX);
+	ey = COORD_TO_MM(element->MarkY);
+
+	sinphi = 0.0;
+	cosphi = 1.0;
+	rot = kicad_get_rotation(element);
+	if(rot == 0.0)
+	{
+		sinphi =  0.0;
+		cosphi =  1.0;
+	}
+	else if(rot == 90.0)
+	{
+		sinphi =  1.0;
+		cosphi =  0.0;
+	}
+	else if(rot == 180.0)
+	{
+		sinphi =  0.0;
+		cosphi = -1.0;
+
+	}
+	else if(rot == 270.0)
+	{
+		sinphi = -1.0;
+		cosphi =  0.0;
+	}
+	else
+	{
+		float phi = rot * M_PI / 180.0;
+		sinphi = sin(phi);
+		cosphi = cos(phi);
+	}
+
+	float x, y, xr, yr;
+	int trot;
+
+	sexpr_printf (out, kicad_footprint_header, kicad_footprint_name(element), clayer, kicad_uuid(uuid, ELEMENT_TYPE, element->ID, 0),
+	              kicad_library_mode ? 0.0 : ex, kicad_library_mode ? 0.0 : ey, rot);
+
+	const char* kicad_element_reftext =
+	"\t\t(property \"Reference\" \"%s\"\n"
+	"\t\t\t(at %f %f %d)\n"
+	"\t\t\t(unlocked yes)\n"
+	"\t\t\t(layer \"%s\")\n"
+	"\t\t\t(hide %s)\n"
+	"\t\t\t(uuid \"%s\")\n"
+	"\t\t\t(effects\n"
+	"\t\t\t\t(font\n"
+	"\t\t\t\t\t(size 1 0.8)\n"
+	"\t\t\t\t\t(thickness 0.18)\n"
+	"\t\t\t\t)\n"
+	"\t\t\t\t(justify left top %s)\n"
+	"\t\t\t)\n"
+	"\t\t)\n";
+
+	xr = COORD_TO_MM(element->Name[1].X) - ex;
+	yr = COORD_TO_MM(element->Name[1].Y) - ey;
+	x =  xr * cosphi - yr * sinphi;
+	y =  xr * sinphi + yr * cosphi;
+	trot = element->Name[1].Direction * 90;
+	if(onsolder)
+		trot = 180 - trot;
+
+	sexpr_printf (out, kicad_element_reftext,
+	              kicad_library_mode ? "REF**" : element->Name[1].TextString,
+																			x, y,
+																			trot,
+																			slayer,
+																			hidename,
+																			kicad_uuid(uuid, ELEMENTNAME_TYPE, element->ID, NAMEONPCB_INDEX), mirror);
+
+	const char* kicad_element_valuetext =
+	"\t\t(property \"Value\" \"%s\"\n"
+	"\t\t\t(at %f %f %d)\n"
+	"\t\t\t(layer \"%s\")\n"
+	"\t\t\t(hide yes)\n"
+	"\t\t\t(uuid \"%s\")\n"
+	"\t\t\t(effects\n"
+	"\t\t\t\t(font\n"
+	"\t\t\t\t\t(size 1 1)\n"
+	"\t\t\t\t\t(thickness 0.1)\n"
+	"\t\t\t\t)\n"
+	"\t\t\t)\n"
+	"\t\t)\n";
+
+	xr = COORD_TO_MM(element->Name[2].X) - ex;
+	yr = COORD_TO_MM(element->Name[2].Y) - ey;
+	x =  xr * cosphi - yr * sinphi;
+	y =  xr * sinphi + yr * cosphi;
+	sexpr_printf (out, kicad_element_valuetext,
+	              kicad_library_mode ? kicad_footprint_name(element) : element->Name[2].TextString,
+																			x, y,
+																			element->Name[2].Direction * 90,
+																			flayer,
+																			kicad_uuid(uuid, ELEMENTNAME_TYPE, element->ID, VALUE_INDEX));
+
+	const char* kicad_element_footprinttext =
+	"\t\t(property \"Footprint\" \"geda:%s\"\n"
+	"\t\t\t(at %f %f %d)\n"
+	"\t\t\t(layer \"%s\")\n"
+	"\t\t\t(hide yes)\n"
+	"\t\t\t(uuid \"%s\")\n"
+	"\t\t\t(effects\n"
+	"\t\t\t\t(font\n"
+	"\t\t\t\t\t(size 1 1)\n"
+	"\t\t\t\t\t(thickness 0.1)\n"
+	"\t\t\t\t)\n"
+	"\t\t\t)\n"
+	"\t\t)\n";
+	xr = COORD_TO_MM(element->Name[2].X) - ex;
+	yr = COORD_TO_MM(element->Name[2].Y) - ey;
+	x =  xr * cosphi - yr * sinphi;
+	y =  xr * sinphi + yr * cosphi;
+	sexpr_printf (out, kicad_element_footprinttext, kicad_footprint_name(element),
+																			x, y,
+																			element->Name[2].Direction * 90,
+																			flayer,
+																			kicad_uuid(uuid, ELEMENTNAME_TYPE, element->ID, DESCRIPTION_INDEX));
+
+	PIN_LOOP (element)
+	{
+		char* kind = "thru_hole";
+
+		net_descriptor* net = kicad_library_mode ? 0 : kicad_get_net_assign(pin);
+		if(net == 0)
+		{
+			net = &net_descs[0];
+		}
+
+		if (TEST_FLAG (HOLEFLAG, pin))
+		{
+			kind = "np_thru_hole";
+		}
+		char* shape = "circle";
+		char* chamfer = 0;
+		if (TEST_FLAG (SQUAREFLAG, pin))
+		{
+			shape = "rect";
+		}
+		else if (TEST_FLAG (OCTAGONFLAG, pin))
+		{
+			shape = "rect";
+			chamfer = "(chamfer_ratio 0.29365) (chamfer top_left top_right bottom_left bottom_right)";
+		}
+
+		double xr, yr, x, y, thick, mask, clear, drill;
+		xr  = COORD_TO_MM(pin->X) - ex;
+		yr  = COORD_TO_MM(pin->Y) - ey;
+		x =  xr * cosphi - yr * sinphi;
+		y =  xr * sinphi + yr * cosphi;
+		thick = COORD_TO_MM(pin->Thickness);
+		mask  = COORD_TO_MM(pin->Mask);
+		clear = COORD_TO_MM(pin->Clearance);
+		drill = COORD_TO_MM(pin->DrillingHole);
+
+		sexpr_printf (out, "\t\t(pad \"%s\" %s %s\n", pin->Number, kind, shape);
+		if(chamfer)
+		{
+			sexpr_printf (out, "\t\t\t%s\n", chamfer);
+		}
+		sexpr_printf (out, "\t\t\t(at %f %f)\n", x, y);
+		sexpr_printf (out, "\t\t\t(size %f %f)\n", thick, thick);
+		sexpr_printf (out, "\t\t\t(drill %f)\n", drill);
+		sexpr_printf (out, "\t\t\t(layers \"*.Cu\" \"*.Mask\")\n");
+		sexpr_printf (out, "\t\t\t(solder_mask_margin %f)\n", (mask - thick)/2.0);
+		sexpr_printf (out, "\t\t\t(clearance %f)\n", clear/2);
+		if (TEST_ANY_THERMS(pin))
+		{
+			int l;
+			int thermal = 1;
+			kicad_log ((_("Pin with thermal\n")));
+			for(l = 0; l<max_copper_layer; l++)
+			{
+				int tstyle = GET_THERM (l, pin);
+				kicad_log ((_("Thermal on layer %d - Type: %d\n")), l, tstyle);
+				switch(tstyle)
+				{
+					case 0:
+						continue;
+					case 3:
+						thermal = 2;
+						break;
+					default:
+						break;
+				}
+				break;
+			}
+			sexpr_printf (out, "\t\t\t(zone_connect %d)\n", thermal);
+			sexpr_printf (out, "\t\t\t(thermal_gap %f)\n", clear/2);
+		}
+		if (!kicad_library_mode)
+			sexpr_printf (out, "\t\t\t(net %d \"%s\")\n", net->net_id, net->net_name);
+		sexpr_printf (out, "\t\t\t(uuid %s)\n", kicad_uuid(uuid, PIN_TYPE, pin->ID, 0));
+		sexpr_printf (out, "\t\t)\n");
+    }
+    END_LOOP;
+
+	PAD_LOOP (element)
+    {
+		if(pad->Thickness > 0)
+		{
+			net_descriptor* net = kicad_library_mode ? 0 : kicad_get_net_assign(pad);
+			if(net == 0)
+			{
+				net = &net_descs[0];
+			}
+
+
+			char* shape = "oval";
+			char* chamfer = 0;
+			if (TEST_FLAG (SQUAREFLAG, pad))
+			{
+				shape = "rect";
+			}
+			else if (TEST_FLAG (OCTAGONFLAG, pad))
+			{
+				shape = "rect";
+				chamfer = "(chamfer_ratio 0.29365) (chamfer top_left top_right bottom_left bottom_right)";
+			}
+
+			char* layer = "\"F.Cu\"";
+			char* paste = "\"F.Paste\"";
+			char* maskl = "\"F.Mask\"";
+
+			if (TEST_FLAG (ONSOLDERFLAG, pad))
+			{
+				layer = "\"B.Cu\"";
+				paste = "\"B.Paste\"";
+				maskl = "\"B.Mask\"";
+			}
+			if (TEST_FLAG (NOPASTEFLAG, pad))
+			{
+				paste = "";
+			}
+
+			double x1, x2, y1, y2, xr1, xr2, yr1, yr2, dx, dy, thick, mask, clear;
+			xr1 = COORD_TO_MM(pad->Point1.X) - ex;
+			xr2 = COORD_TO_MM(pad->Point2.X) - ex;
+			yr1 = COORD_TO_MM(pad->Point1.Y) - ey;
+			yr2 = COORD_TO_MM(pad->Point2.Y) - ey;
+			x1 =  xr1 * cosphi - yr1 * sinphi;
+			y1 =  xr1 * sinphi + yr1 * cosphi;
+			x2 =  xr2 * cosphi - yr2 * sinphi;
+			y2 =  xr2 * sinphi + yr2 * cosphi;
+			dx = x2 - x1;
+			dy = y2 - y1;
+			thick = COORD_TO_MM(pad->Thickness);
+			mask  = COORD_TO_MM(pad->Mask);
+			clear = COORD_TO_MM(pad->Clearance);
+
+			double x, y, angle, w, h;
+			x = (x1 + x2)/2.0;
+			y = (y1 + y2)/2.0;
+			angle = rot;
+			if(fabs(dx) <= 0.0001 && fabs(dy) <= 0.0001)
+			{
+				w = thick;
+				h = thick;
+			}
+			else if(fabs(dx) <= 0.0001)
+			{
+				w = fabs(dy) + thick;
+				h = thick;
+				angle += 90.0;
+			}
+			else if(fabs(dy) <= 0.0001)
+			{
+				w = fabs(dx) + thick;
+				h = thick;
+			}
+			else
+			{
+				angle += atan(dx / dy) * 180.0 / M_PI;
+				h = sqrt(dx * dx + dy * dy) + thick;
+				w = thick;
+			}
+
+			sexpr_printf (out, "\t\t(pad \"%s\" smd %s\n", pad->Number, shape);
+			if(chamfer)
+			{
+				sexpr_printf (out, "\t\t\t%s\n", chamfer);
+			}
+			sexpr_printf (out, "\t\t\t(at %f %f %f)\n", x, y, angle);
+			sexpr_printf (out, "\t\t\t(size %f %f)\n", w, h);
+			sexpr_printf (out, "\t\t\t(layers %s %s %s)\n", layer, paste, maskl);
+			sexpr_printf (out, "\t\t\t(solder_mask_margin %f)\n", (mask - thick)/2.0);
+			sexpr_printf (out, "\t\t\t(clearance %f)\n", clear/2.0);
+			if (!kicad_library_mode)
+				sexpr_printf (out, "\t\t\t(net %d \"%s\")\n", net->net_id, net->net_name);
+			sexpr_printf (out, "\t\t\t(uuid %s)\n", kicad_uuid(uuid, PAD_TYPE, pad->ID, 0));
+			sexpr_printf (out, "\t\t)\n");
+		}
+		/*
+		else if(pad->Mask > 0)
+		{
+
+		}
+		*/
+	}
+	END_LOOP;
+
+	ELEMENTLINE_LOOP(element)
+	{
+		double xr1, yr1, xr2, yr2, x1, y1, x2, y2, thick;
+		xr1 = COORD_TO_MM(line->Point1.X) - ex;
+		xr2 = COORD_TO_MM(line->Point2.X) - ex;
+		yr1 = COORD_TO_MM(line->Point1.Y) - ey;
+		yr2 = COORD_TO_MM(line->Point2.Y) - ey;
+		x1 =  xr1 * cosphi - yr1 * sinphi;
+		y1 =  xr1 * sinphi + yr1 * cosphi;
+		x2 =  xr2 * cosphi - yr2 * sinphi;
+		y2 =  xr2 * sinphi + yr2 * cosphi;
+		thick = COORD_TO_MM(line->Thickness);
+		sexpr_printf (out, "\t\t(fp_line\n");
+		sexpr_printf (out, "\t\t\t(start %f %f)\n", x1, y1);
+		sexpr_printf (out, "\t\t\t(end %f %f)\n", x2, y2);
+		sexpr_printf (out, "\t\t\t(stroke\n\t\t\t\t(width %f)\n\t\t\t\t(type default)\n\t\t\t)\n", thick);
+		sexpr_printf (out, "\t\t\t(layer \"%s\")\n", slayer);
+		sexpr_printf (out, "\t\t\t(uuid %s)\n", kicad_uuid(uuid, ELEMENTLINE_TYPE, line->ID, 0));
+		sexpr_printf (out, "\t\t)\n");
+	}
+	END_LOOP;
+
+	sexpr_printf (out, (_("\t)\n")));
+}
+
+/*!
+ * \brief Magic line at the start of a footprint cache file.
+ */
+#define KICAD_CACHE_MAGIC "pcb-kicad-footprint-cache 1\n"
+
+/*!
+ * \brief A rendered footprint, see kicad_print_cached_element().
+ */
+typedef struct
+{
+	uint64_t key;  /*!< kicad_hash_element() of the element. */
+	size_t len;
+	char* text;
+} kicad_cache_entry;
+
+/*!
+ * \brief Footprints read from the cache file.
+ */
+static GHashTable* kicad_cache_old;
+
+/*!
+ * \brief Footprints of the current export, written back to the cache file.
+ */
+static GHashTable* kicad_cache_new;
+
+static void
+kicad_cache_entry_free(gpointer data)
+{
+	kicad_cache_entry* entry = data;
+	free(entry->text);
+	free(entry);
+}
+
+static GHashTable*
+kicad_cache_table_new(void)
+{
+	return g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, kicad_cache_entry_free);
+}
+
+static uint64_t
+kicad_hash_add(uint64_t h, uint64_t v)
+{
+	return kicad_mix64(h + 0x9e3779b97f4a7c15ULL + v);
+}
+
+static uint64_t
+kicad_hash_str(uint64_t h, const char* s)
+{
+	if (!s)
+		return kicad_hash_add(h, 0);
+	for(; *s; s++)
+		h = kicad_hash_add(h, (unsigned char) *s);
+	return kicad_hash_add(h, 0x100);
+}
+
+static uint64_t
+kicad_hash_flags(uint64_t h, FlagType* flags)
+{
+	h = kicad_hash_add(h, flags->f);
+	for(int i = 0; i < (int) sizeof(flags->t); i++)
+		h = kicad_hash_add(h, flags->t[i]);
+	return h;
+}
+
+static uint64_t
+kicad_hash_net(uint64_t h, net_descriptor* net)
+{
+	if (!net)
+		return kicad_hash_add(h, -1);
+	h = kicad_hash_add(h, net->net_id);
+	return kicad_hash_str(h, net->net_name);
+}
+
+/*!
+ * \brief Hash everything the footprint text of an element depends on.
+ *
+ * This covers the geometry, flags, IDs (through the uuids) and net
+ * assignment of the element and its parts, as well as the uuid namespace
+ * and the number of copper layers (thermals).
+ */
+static uint64_t
+kicad_hash_element(ElementType* element)
+{
+	uint64_t h = kicad_hash_add(kicad_uuid_ns, max_copper_layer);
+	int i;
+
+	h = kicad_hash_add(h, element->ID);
+	h = kicad_hash_flags(h, &element->Flags);
+	h = kicad_hash_str(h, kicad_footprint_name(element));
+	h = kicad_hash_add(h, element->MarkX);
+	h = kicad_hash_add(h, element->MarkY);
+	for(i = 0; i < MAX_ELEMENTNAMES; i++)
+	{
+		h = kicad_hash_str(h, element->Name[i].TextString);
+		h = kicad_hash_add(h, element->Name[i].X);
+		h = kicad_hash_add(h, element->Name[i].Y);
+		h = kicad_hash_add(h, element->Name[i].Direction);
+	}
+
+	PIN_LOOP (element);
+	{
+		h = kicad_hash_add(h, pin->ID);
+		h = kicad_hash_flags(h, &pin->Flags);
+		h = kicad_hash_str(h, pin->Number);
+		h = kicad_hash_add(h, pin->X);
+		h = kicad_hash_add(h, pin->Y);
+		h = kicad_hash_add(h, pin->Thickness);
+		h = kicad_hash_add(h, pin->Mask);
+		h = kicad_hash_add(h, pin->Clearance);
+		h = kicad_hash_add(h, pin->DrillingHole);
+		h = kicad_hash_net(h, kicad_get_net_assign(pin));
+	}
+	END_LOOP;
+
+	PAD_LOOP (element);
+	{
+		h = kicad_hash_add(h, pad->ID);
+		h = kicad_hash_flags(h, &pad->Flags);
+		h = kicad_hash_str(h, pad->Number);
+		h = kicad_hash_add(h, pad->Point1.X);
+		h = kicad_hash_add(h, pad->Point1.Y);
+		h = kicad_hash_add(h, pad->Point2.X);
+		h = kicad_hash_add(h, pad->Point2.Y);
+		h = kicad_hash_add(h, pad->Thickness);
+		h = kicad_hash_add(h, pad->Mask);
+		h = kicad_hash_add(h, pad->Clearance);
+		h = kicad_hash_net(h, kicad_get_net_assign(pad));
+	}
+	END_LOOP;
+
+	ELEMENTLINE_LOOP (element);
+	{
+		h = kicad_hash_add(h, line->ID);
+		h = kicad_hash_add(h, line->Point1.X);
+		h = kicad_hash_add(h, line->Point1.Y);
+		h = kicad_hash_add(h, line->Point2.X);
+		h = kicad_hash_add(h, line->Point2.Y);
+		h = kicad_hash_add(h, line->Thickness);
+	}
+	END_LOOP;
+
+	return h;
+}
+
+/*!
+ * \brief Read the footprint cache file, if there is one.
+ *
+ * A missing, foreign or truncated file just leaves the cache (partly)
+ * empty.
+ */
+static void
+kicad_cache_load(const char* filename)
+{
+	FILE* fp;
+	char magic[sizeof(KICAD_CACHE_MAGIC) - 1];
+	uint64_t key;
+	uint32_t len;
+
+	kicad_cache_old = kicad_cache_table_new();
+	kicad_cache_new = kicad_cache_table_new();
+
+	fp = fopen(filename, "rb");
+	if (!fp)
+		return;
+
+	if (fread(magic, 1, sizeof(magic), fp) != sizeof(magic)
+	    || memcmp(magic, KICAD_CACHE_MAGIC, sizeof(magic)) != 0)
+	{
+		kicad_log ((_("Ignoring footprint cache %s of unknown format\n")), filename);
+		fclose(fp);
+		return;
+	}
+
+	while (fread(&key, sizeof(key), 1, fp) == 1 && fread(&len, sizeof(len), 1, fp) == 1)
+	{
+		kicad_cache_entry* entry = malloc(sizeof(kicad_cache_entry));
+		entry->key = key;
+		entry->len = len;
+		entry->text = malloc(len ? len : 1);
+		if (fread(entry->text, 1, len, fp) != len)
+		{
+			kicad_cache_entry_free(entry);
+			break;
+		}
+		g_hash_table_replace(kicad_cache_old, &entry->key, entry);
+	}
+	fclose(fp);
+}
+
+/*!
+ * \brief Write the footprints of this export to the cache file and drop
+ * the cache.
+ */
+static void
+kicad_cache_save(const char* filename)
+{
+	FILE* fp;
+	GHashTableIter iter;
+	gpointer value;
+	bool ok;
+
+	fp = fopen(filename, "wb");
+	if (!fp)
+	{
+		kicad_log ((_("Cannot open file %s for writing\n")), filename);
+	}
+	else
+	{
+		ok = fwrite(KICAD_CACHE_MAGIC, 1, sizeof(KICAD_CACHE_MAGIC) - 1, fp) == sizeof(KICAD_CACHE_MAGIC) - 1;
+		g_hash_table_iter_init(&iter, kicad_cache_new);
+		while (ok && g_hash_table_iter_next(&iter, NULL, &value))
+		{
+			kicad_cache_entry* entry = value;
+			uint32_t len = entry->len;
+			ok = fwrite(&entry->key, sizeof(entry->key), 1, fp) == 1
+			     && fwrite(&len, sizeof(len), 1, fp) == 1
+			     && fwrite(entry->text, 1, len, fp) == len;
+		}
+		if (fclose(fp) != 0 || !ok)
+		{
+			kicad_log ((_("Error writing file %s\n")), filename);
+			remove(filename);
+		}
+	}
+
+	g_hash_table_destroy(kicad_cache_old);
+	g_hash_table_destroy(kicad_cache_new);
+	kicad_cache_old = kicad_cache_new = NULL;
+}
+
+/*!
+ * \brief Write the footprint of an element, reusing its text from the
+ * cache when the element did not change since the last export.
+ */
+static void
+kicad_print_cached_element(SexprWriter* out, ElementType* element, net_descriptor* net_descs)
+{
+	uint64_t key = kicad_hash_element(element);
+	kicad_cache_entry* entry;
+	SexprWriter text;
+
+	entry = g_hash_table_lookup(kicad_cache_old, &key);
+	if (entry)
+	{
+		g_hash_table_steal(kicad_cache_old, &key);
+	}
+	else
+	{
+		sexpr_open_memory(&text);
+		kicad_print_element(&text, element, net_descs);
+		entry = malloc(sizeof(kicad_cache_entry));
+		entry->key = key;
+		entry->len = text.len;
+		entry->text = text.buf;
+	}
+
+	sexpr_write(out, entry->text, entry->len);
+	g_hash_table_replace(kicad_cache_new, &entry->key, entry);
+}
+
+/*!
+ * \brief Flags an element's footprint text depends on.
+ */
+#define KICAD_FOOTPRINT_FLAGS \
+	(SQUAREFLAG | OCTAGONFLAG | HOLEFLAG | ONSOLDERFLAG | NOPASTEFLAG | HIDENAMEFLAG)
+
+static uint64_t
+kicad_hash_footprint_flags(uint64_t h, FlagType* flags)
+{
+	h = kicad_hash_add(h, flags->f & KICAD_FOOTPRINT_FLAGS);
+	for(int i = 0; i < (int) sizeof(flags->t); i++)
+		h = kicad_hash_add(h, flags->t[i]);
+	return h;
+}
+
+/*!
+ * \brief Hash the geometry of an element relative to its mark.
+ *
+ * Unlike kicad_hash_element() this leaves out the position, the IDs,
+ * the nets and the reference and value texts, along with where they
+ * were moved to, so all the elements placed from one footprint in the
+ * same orientation hash alike.  The library entry takes its text
+ * positions from the first of them.
+ */
+static uint64_t
+kicad_hash_footprint(ElementType* element)
+{
+	uint64_t h = kicad_hash_add(0, max_copper_layer);
+	Coord mx = element->MarkX, my = element->MarkY;
+
+	h = kicad_hash_footprint_flags(h, &element->Flags);
+	h = kicad_hash_add(h, (uint64_t) (kicad_get_rotation(element) * 1000.0));
+	h = kicad_hash_str(h, element->Name[DESCRIPTION_INDEX].TextString);
+
+	PIN_LOOP (element);
+	{
+		h = kicad_hash_footprint_flags(h, &pin->Flags);
+		h = kicad_hash_str(h, pin->Number);
+		h = kicad_hash_add(h, pin->X - mx);
+		h = kicad_hash_add(h, pin->Y - my);
+		h = kicad_hash_add(h, pin->Thickness);
+		h = kicad_hash_add(h, pin->Mask);
+		h = kicad_hash_add(h, pin->Clearance);
+		h = kicad_hash_add(h, pin->DrillingHole);
+	}
+	END_LOOP;
+
+	PAD_LOOP (element);
+	{
+		h = kicad_hash_footprint_flags(h, &pad->Flags);
+		h = kicad_hash_str(h, pad->Number);
+		h = kicad_hash_add(h, pad->Point1.X - mx);
+		h = kicad_hash_add(h, pad->Point1.Y - my);
+		h = kicad_hash_add(h, pad->Point2.X - mx);
+		h = kicad_hash_add(h, pad->Point2.Y - my);
+		h = kicad_hash_add(h, pad->Thickness);
+		h = kicad_hash_add(h, pad->Mask);
+		h = kicad_hash_add(h, pad->Clearance);
+	}
+	END_LOOP;
+
+	ELEMENTLINE_LOOP (element);
+	{
+		h = kicad_hash_add(h, line->Point1.X - mx);
+		h = kicad_hash_add(h, line->Point1.Y - my);
+		h = kicad_hash_add(h, line->Point2.X - mx);
+		h = kicad_hash_add(h, line->Point2.Y - my);
+		h = kicad_hash_add(h, line->Thickness);
+	}
+	END_LOOP;
+
+	return h;
+}
+
+/*!
+ * \brief Make a library entry name from a footprint description that
+ * is unique among kicad_library_names, and add it there.
+ */
+static char*
+kicad_library_entry_name(const char* description)
+{
+	GHashTable* names = kicad_library_names;
+	char* base = g_strdup(description && *description ? description : "footprint");
+	char* name;
+	int n;
+
+	for(char* p = base; *p; p++)
+	{
+		if (!g_ascii_isalnum(*p) && !strchr("-_.+", *p))
+			*p = '_';
+	}
+
+	name = g_strdup(base);
+	for(n = 2; g_hash_table_contains(names, name); n++)
+	{
+		g_free(name);
+		name = g_strdup_printf("%s_%d", base, n);
+	}
+	g_free(base);
+	g_hash_table_add(names, name);
+	return name;
+}
+
+/*!
+ * \brief Write a footprint library with one entry per distinct footprint
+ * geometry, and remember the entry of each element.
+ *
+ * The names stay in kicad_library_elements until kicad_library_free().
+ * The footprints of the board are written as usual if the library
+ * can't be.
+ */
+static void
+kicad_library_write(const char* dirname, net_descriptor* net_descs)
+{
+	GHashTable* entries;
+
+	if (MKDIR(dirname, 0777) != 0 && errno != EEXIST)
+	{
+		kicad_log ((_("Cannot create the footprint library %s\n")), dirname);
+		return;
+	}
+
+	/* geometry hash -> entry name */
+	entries = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+	kicad_library_names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	kicad_library_elements = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	ELEMENT_LOOP (PCB->Data);
+	{
+		uint64_t key = kicad_hash_footprint(element);
+		char* name = g_hash_table_lookup(entries, &key);
+
+		if (name == NULL)
+		{
+			uint64_t* k = g_new(uint64_t, 1);
+			char* filename;
+			FILE* fp;
+			SexprWriter w;
+
+			*k = key;
+			name = kicad_library_entry_name(element->Name[DESCRIPTION_INDEX].TextString);
+			g_hash_table_insert(entries, k, name);
+			g_hash_table_insert(kicad_library_elements, element, name);
+
+			filename = g_strdup_printf("%s/%s.kicad_mod", dirname, name);
+			fp = fopen(filename, "w");
+			if (fp)
 			{
-				if (NSTRCMP (pin->Number, reference_pin_names[rpindex]) == 0)
-				{
-					pinx[rpindex] = (double) pin->X;
-					piny[rpindex] = (double) pin->Y;
-					pinangle[rpindex] = 0.0; /* pins have no notion of angle */
-					pinfound[rpindex] = 1;
-				}
+				sexpr_open(&w, fp);
+				kicad_library_mode = true;
+				kicad_print_element(&w, element, net_descs);
+				kicad_library_mode = false;
+				if (!sexpr_close(&w) | (fclose(fp) != 0))
+					fp = NULL;
+			}
+			if (!fp)
+			{
+				kicad_log ((_("Error writing file %s\n")), filename);
 			}
+			g_free(filename);
 		}
-		END_LOOP;
+		g_hash_table_insert(kicad_library_elements, element, name);
+	}
+	END_LOOP;
 
-		PAD_LOOP (element);
-		{
-			pin_cnt++;
+	g_hash_table_destroy(entries);
+}
 
-			for (rpindex = 0; reference_pin_names[rpindex]; rpindex++)
-			{
-				if (NSTRCMP (pad->Number, reference_pin_names[rpindex]) == 0)
-				{
-					double padcentrex, padcentrey;
-					padcentrex = (double) (pad->Point1.X + pad->Point2.X) / 2.0;
-					padcentrey = (double) (pad->Point1.Y + pad->Point2.Y) / 2.0;
-					pinx[rpindex] = padcentrex;
-					piny[rpindex] = padcentrey;
-					/*
-					 * NOTE: We swap the Y points because in PCB, the Y-axis
-					 * is inverted.  Increasing Y moves down.  We want to deal
-					 * in the usual increasing Y moves up coordinates though.
-					 */
-					pinangle[rpindex] = (180.0 / M_PI) * atan2 (pad->Point1.Y - pad->Point2.Y, pad->Point2.X - pad->Point1.X);
-					pinfound[rpindex]=1;
-				}
-			}
+/*!
+ * \brief Forget the library entries of the elements.
+ */
+static void
+kicad_library_free(void)
+{
+	if (!kicad_library_elements)
+		return;
+	g_hash_table_destroy(kicad_library_elements);
+	g_hash_table_destroy(kicad_library_names);
+	kicad_library_elements = kicad_library_names = NULL;
+}
+
+/*!
+ * \brief The KiCad copper layer of each layer group, "" for the groups
+ * without copper, see kicad_map_groups().
+ */
+static char kicad_group_layer[MAX_GROUP][8];
+
+/*!
+ * \brief The KiCad number of the copper layer of each layer group, -1
+ * for the groups without copper.
+ */
+static int kicad_group_number[MAX_GROUP];
+
+/*!
+ * \brief Number of inner copper layers.
+ */
+static int kicad_inner_layers;
+
+/*!
+ * \brief Map the copper layer groups to KiCad copper layers.
+ *
+ * The top and bottom groups become F.Cu and B.Cu, and the other groups
+ * holding copper become In1.Cu, In2.Cu, ... in their stacking order.
+ * Layers named "outline" go to Edge.Cuts and make no copper of their
+ * own.
+ */
+static void
+kicad_map_groups(void)
+{
+	int top = GetLayerGroupNumberBySide(TOP_SIDE);
+	int bottom = GetLayerGroupNumberBySide(BOTTOM_SIDE);
+	int group;
+
+	kicad_inner_layers = 0;
+	for(group = 0; group < MAX_GROUP; group++)
+	{
+		bool copper = false;
+
+		kicad_group_layer[group][0] = '\0';
+		kicad_group_number[group] = -1;
+		if (group >= max_group)
+			continue;
+		GROUP_LOOP(PCB->Data, group);
+		{
+			if (layer->Type == LT_COPPER && strcmp(layer->Name, "outline") != 0)
+				copper = true;
 		}
 		END_LOOP;
 
-		if (pin_cnt > 0)
+		if (group == top)
+		{
+			strcpy(kicad_group_layer[group], "F.Cu");
+			kicad_group_number[group] = 0;
+		}
+		else if (group == bottom)
+		{
+			strcpy(kicad_group_layer[group], "B.Cu");
+			kicad_group_number[group] = 31;
+		}
+		else if (copper)
 		{
-			x = element->MarkX;
-			y = element->MarkY;
+			sprintf(kicad_group_layer[group], "In%d.Cu", ++kicad_inner_layers);
+			kicad_group_number[group] = kicad_inner_layers;
+		}
+	}
+}
 
+/*!
+ * \brief Write the copper layers a buried via connects, the outermost
+ * of the groups its layers are in, to layers.
+ *
+ * Returns false when these are the top and bottom, or a single layer,
+ * for the via to be written through the board.
+ */
+static bool
+kicad_via_layers(PinType* via, char* layers)
+{
+	int from = -1, to = -1, l;
 
-			/* Find first reference pin not at the  centroid  */
-			for (rpindex = 0;
-					 reference_pin_names[rpindex];
-					 rpindex++)
-			{
-				if (pinfound[rpindex])
-				{
-					/* Recenter pin "#1" onto the axis which cross at the part
-						 centroid */
-					pin1x = pinx[rpindex] - x;
-					pin1y = piny[rpindex] - y;
-
-					/* flip x, to reverse rotation for elements on back */
-					if (FRONT (element) != 1)
-							pin1x = -pin1x;
-
-					/* if only 1 pin, use pin 1's angle */
-					if (pin_cnt == 1)
-					{
-						theta = pinangle[rpindex];
-						break;
-					}
-					else if ((pin1x != 0.0) || (pin1y != 0.0))
-					{
-						theta = xyToAngle (pin1x, pin1y, pin_cnt > 2);
-						break;
-					}
-				}
-			}
-		}
+	for(l = via->BuriedFrom; l <= (int) via->BuriedTo && l < max_copper_layer; l++)
+	{
+		int group = GetLayerGroupNumberByNumber(l);
+
+		if (kicad_group_number[group] < 0)
+			continue;
+		if (from < 0 || kicad_group_number[group] < kicad_group_number[from])
+			from = group;
+		if (to < 0 || kicad_group_number[group] > kicad_group_number[to])
+			to = group;
 	}
-	return theta;
+	if (from < 0 || from == to
+	    || (kicad_group_number[from] == 0 && kicad_group_number[to] == 31))
+		return false;
+	sprintf(layers, "\"%s\" \"%s\"", kicad_group_layer[from], kicad_group_layer[to]);
+	return true;
 }
 
-#pragma GCC diagnostic ignored "-Wdeclaration-after-statement"
+/*!
+ * \brief Write the copper layers of the layer table.
+ *
+ * KiCad numbers its copper layers F.Cu 0, In<n>.Cu n and B.Cu 31.
+ */
+static void
+kicad_print_copper_layers(SexprWriter* out)
+{
+	int i;
+
+	sexpr_printf (out, "\t\t(0 \"F.Cu\" signal)\n");
+	for(i = 1; i <= kicad_inner_layers; i++)
+	{
+		sexpr_printf (out, "\t\t(%d \"In%d.Cu\" signal)\n", i, i);
+	}
+	sexpr_printf (out, "\t\t(31 \"B.Cu\" signal)\n");
+}
 
 /*!
  * \brief Print the file.
@@ -440,23 +2086,27 @@ kicad_print (void)
 {
 	int i;
 	FILE *fp;
+	bool is_pipe, ok;
+	SexprWriter out;
 	char uuid[37];
+	kicad_phase_stats stats[KICAD_PHASE_N];
+	kicad_phase_mark mark;
+	gint64 start = g_get_monotonic_time();
 
 	net_descriptor* net_descs = calloc(100, sizeof(net_descriptor));
 	int num_net_descs = 0;
 	int max_net_descs = 100;
 
-	kicad_net_assign = calloc(1000, sizeof(net_assignment));
-	kicad_num_net_assign = 0;
-	kicad_max_net_assign = 1000;
-
-	fp = fopen (kicad_filename, "wb");
+	fp = kicad_open_output (kicad_filename, kicad_compress, &is_pipe);
 
 	if (!fp)
 	{
-		gui->log ((_("Cannot open file %s for writing\n")), kicad_filename);
+		kicad_log ((_("Cannot open file %s for writing\n")), kicad_filename);
 		return 1;
 	}
+	sexpr_open (&out, fp);
+	kicad_uuid_init();
+	memset(stats, 0, sizeof(stats));
 
 	const char* kicad_header =
 	"(kicad_pcb\n"
@@ -468,12 +2118,7 @@ kicad_print (void)
 	const char* kicad_pagesettings =
 	"\t(paper \"User\" %f %f)\n";
 
-	const char* kicad_layers =
-	"\t(layers\n"
-	"\t\t(0 \"F.Cu\" signal)\n"
-	"\t\t(1 \"In1.Cu\" signal)\n"
-	"\t\t(2 \"In2.Cu\" signal)\n"
-	"\t\t(31 \"B.Cu\" signal)\n"
+	const char* kicad_user_layers =
 	"\t\t(32 \"B.Adhes\" user)\n"
 	"\t\t(33 \"F.Adhes\" user)\n"
 	"\t\t(34 \"B.Paste\" user)\n"
@@ -485,458 +2130,86 @@ kicad_print (void)
 	"\t\t(40 \"Dwgs.User\" user)\n"
 	"\t\t(41 \"Cmts.User\" user)\n"
 	"\t\t(42 \"Eco1.User\" user)\n"
-	"\t\t(43 \"Eco2.User\" user)\n"
-	"\t\t(44 \"Edge.Cuts\" user)\n"
-	"\t\t(45 \"Margin\" user)\n"
-	"\t\t(46 \"B.CrtYd\" user \"B.Courtyard\")\n"
-	"\t\t(47 \"F.CrtYd\" user \"F.Courtyard\")\n"
-	"\t\t(48 \"B.Fab\" user)\n"
-	"\t\t(49 \"F.Fab\" user)\n"
-	"\t\t(50 \"User.1\" user)\n"
-	"\t\t(51 \"User.2\" user)\n"
-	"\t\t(52 \"User.3\" user)\n"
-	"\t\t(53 \"User.4\" user)\n"
-	"\t\t(54 \"User.5\" user)\n"
-	"\t\t(55 \"User.6\" user)\n"
-	"\t\t(56 \"User.7\" user)\n"
-	"\t\t(57 \"User.8\" user)\n"
-	"\t\t(58 \"User.9\" user)\n"
-  "\t)\n";
-
-
-	fprintf (fp, kicad_header);
-	fprintf (fp, kicad_pagesettings, COORD_TO_MM(PCB->MaxWidth), COORD_TO_MM(PCB->MaxHeight));
-	fprintf (fp, kicad_layers);
-
-	int netnum = 0;
-	strcpy(net_descs[num_net_descs].net_name, "0");
-	fprintf (fp, "\t(net %d \"%s\")\n", netnum, net_descs[num_net_descs].net_name);
-	num_net_descs++;
-	netnum++;
-
-
-	for (i=0; i<PCB->NetlistLib.MenuN; i++)
-	{
-		char* netname = PCB->NetlistLib.Menu[i].Name;
-		while(*netname == ' ') netname++;
-
-		if(num_net_descs >= max_net_descs)
-		{
-			const int grow = 100;
-			net_descriptor* tmp = net_descs;
-			net_descs = calloc(max_net_descs + grow, sizeof(net_descriptor));
-			memcpy(net_descs, tmp, max_net_descs * sizeof(net_descriptor));
-			max_net_descs += grow;
-			free(tmp);
-		}
-
-		net_descs[num_net_descs].net_id = netnum;
-		strncpy(net_descs[num_net_descs].net_name, netname, 16);
-		fprintf (fp, "\t(net %d \"%s\")\n", netnum, net_descs[num_net_descs].net_name);
-		num_net_descs++;
-		netnum++;
-	}
-
-	ELEMENT_LOOP (PCB->Data);
-	{
-		const char* kicad_footprint_header =
-		"\t(footprint \"geda:%s\"\n"
-		"\t\t(layer \"%s\")\n"
-		"\t\t(uuid \"%s\")\n"
-		"\t\t(at %f %f %f)\n";
-
-		char* clayer = "F.Cu";
-		char* slayer = "F.SilkS";
-		char* flayer = "F.Fab";
-		char* hidename = "no";
-		char* mirror = "";
-
-		int onsolder = TEST_FLAG (ONSOLDERFLAG, element);
-		if (onsolder)
-		{
-			clayer = "B.Cu";
-			slayer = "B.SilkS";
-			flayer = "B.Fab";
-			mirror = "mirror";
-		}
-
-		if(TEST_FLAG(HIDENAMEFLAG, element))
-		{
-			hidename = "yes";
-		}
-
-		float ex, ey, rot, sinphi, cosphi;
-		ex = COORD_TO_MM(element->MarkX);
-		ey = COORD_TO_MM(element->MarkY);
-
-		sinphi = 0.0;
-		cosphi = 1.0;
-		rot = kicad_get_rotation(element);
-		if(rot == 0.0)
-		{
-			sinphi =  0.0;
-			cosphi =  1.0;
-		}
-		else if(rot == 90.0)
-		{
-			sinphi =  1.0;
-			cosphi =  0.0;
-		}
-		else if(rot == 180.0)
-		{
-			sinphi =  0.0;
-			cosphi = -1.0;
-
-		}
-		else if(rot == 270.0)
-		{
-			sinphi = -1.0;
-			cosphi =  0.0;
-		}
-		else
-		{
-			float phi = rot * M_PI / 180.0;
-			sinphi = sin(phi);
-			cosphi = cos(phi);
-		}
-
-		float x, y, xr, yr;
-		int trot;
-
-		fprintf (fp, kicad_footprint_header, element->Name[0].TextString, clayer, kicad_uuid(uuid), ex, ey, rot);
-
-		const char* kicad_element_reftext =
-		"\t\t(property \"Reference\" \"%s\"\n"
-		"\t\t\t(at %f %f %d)\n"
-		"\t\t\t(unlocked yes)\n"
-		"\t\t\t(layer \"%s\")\n"
-		"\t\t\t(hide %s)\n"
-		"\t\t\t(uuid \"%s\")\n"
-		"\t\t\t(effects\n"
-		"\t\t\t\t(font\n"
-		"\t\t\t\t\t(size 1 0.8)\n"
-		"\t\t\t\t\t(thickness 0.18)\n"
-		"\t\t\t\t)\n"
-		"\t\t\t\t(justify left top %s)\n"
-		"\t\t\t)\n"
-		"\t\t)\n";
-
-		xr = COORD_TO_MM(element->Name[1].X) - ex;
-		yr = COORD_TO_MM(element->Name[1].Y) - ey;
-		x =  xr * cosphi - yr * sinphi;
-		y =  xr * sinphi + yr * cosphi;
-		trot = element->Name[1].Direction * 90;
-		if(onsolder)
-			trot = 180 - trot;
-
-		fprintf (fp, kicad_element_reftext, element->Name[1].TextString,
-																				x, y,
-																				trot,
-																				slayer,
-																				hidename,
-																				kicad_uuid(uuid), mirror);
-
-		const char* kicad_element_valuetext =
-		"\t\t(property \"Value\" \"%s\"\n"
-		"\t\t\t(at %f %f %d)\n"
-		"\t\t\t(layer \"%s\")\n"
-		"\t\t\t(hide yes)\n"
-		"\t\t\t(uuid \"%s\")\n"
-		"\t\t\t(effects\n"
-		"\t\t\t\t(font\n"
-		"\t\t\t\t\t(size 1 1)\n"
-		"\t\t\t\t\t(thickness 0.1)\n"
-		"\t\t\t\t)\n"
-		"\t\t\t)\n"
-		"\t\t)\n";
-
-		xr = COORD_TO_MM(element->Name[2].X) - ex;
-		yr = COORD_TO_MM(element->Name[2].Y) - ey;
-		x =  xr * cosphi - yr * sinphi;
-		y =  xr * sinphi + yr * cosphi;
-		fprintf (fp, kicad_element_valuetext, element->Name[2].TextString,
-																				x, y,
-																				element->Name[2].Direction * 90,
-																				flayer,
-																				kicad_uuid(uuid));
-
-		const char* kicad_element_footprinttext =
-		"\t\t(property \"Footprint\" \"geda:%s\"\n"
-		"\t\t\t(at %f %f %d)\n"
-		"\t\t\t(layer \"%s\")\n"
-		"\t\t\t(hide yes)\n"
-		"\t\t\t(uuid \"%s\")\n"
-		"\t\t\t(effects\n"
-		"\t\t\t\t(font\n"
-		"\t\t\t\t\t(size 1 1)\n"
-		"\t\t\t\t\t(thickness 0.1)\n"
-		"\t\t\t\t)\n"
-		"\t\t\t)\n"
-		"\t\t)\n";
-		xr = COORD_TO_MM(element->Name[2].X) - ex;
-		yr = COORD_TO_MM(element->Name[2].Y) - ey;
-		x =  xr * cosphi - yr * sinphi;
-		y =  xr * sinphi + yr * cosphi;
-		fprintf (fp, kicad_element_footprinttext, element->Name[0].TextString,
-																				x, y,
-																				element->Name[2].Direction * 90,
-																				flayer,
-																				kicad_uuid(uuid));
-
-		PIN_LOOP (element)
-		{
-			char* kind = "thru_hole";
-
-			net_descriptor* net = 0;
-			if(!TEST_FLAG (VISITFLAG, pin))
-			{
-				int i, j;
-				char nodename[256];
-				sprintf(nodename, "%s-%s", element->Name[1].TextString, pin->Number);
-				for (i=0; i<PCB->NetlistLib.MenuN; i++)
-				{
-					for (j=0; j<PCB->NetlistLib.Menu[i].EntryN; j++)
-					{
-						if (strcmp (PCB->NetlistLib.Menu[i].Entry[j].ListEntry, nodename) == 0)
-						{
-								/*printf(" in [%s]\n", PCB->NetlistLib.Menu[i].Name);*/
-								net = &net_descs[i+1];
-								break;
-						}
-					}
-				}
-				kicad_add_net(PIN_TYPE, pin, net);
-			}
-			else
-			{
-				net = kicad_get_net_assign(pin);
-			}
-
-			if(net == 0)
-			{
-				net = &net_descs[0];
-			}
-
-			if (TEST_FLAG (HOLEFLAG, pin))
-			{
-				kind = "np_thru_hole";
-			}
-			char* shape = "circle";
-			char* chamfer = 0;
-			if (TEST_FLAG (SQUAREFLAG, pin))
-			{
-				shape = "rect";
-			}
-			else if (TEST_FLAG (OCTAGONFLAG, pin))
-			{
-				shape = "rect";
-				chamfer = "(chamfer_ratio 0.29365) (chamfer top_left top_right bottom_left bottom_right)";
-			}
-
-			double xr, yr, x, y, thick, mask, clear, drill;
-			xr  = COORD_TO_MM(pin->X) - ex;
-			yr  = COORD_TO_MM(pin->Y) - ey;
-			x =  xr * cosphi - yr * sinphi;
-			y =  xr * sinphi + yr * cosphi;
-			thick = COORD_TO_MM(pin->Thickness);
-			mask  = COORD_TO_MM(pin->Mask);
-			clear = COORD_TO_MM(pin->Clearance);
-			drill = COORD_TO_MM(pin->DrillingHole);
-
-			fprintf (fp, "\t\t(pad \"%s\" %s %s\n", pin->Number, kind, shape);
-			if(chamfer)
-			{
-				fprintf (fp, "\t\t\t%s\n", chamfer);
-			}
-			fprintf (fp, "\t\t\t(at %f %f)\n", x, y);
-			fprintf (fp, "\t\t\t(size %f %f)\n", thick, thick);
-			fprintf (fp, "\t\t\t(drill %f)\n", drill);
-			fprintf (fp, "\t\t\t(layers \"*.Cu\" \"*.Mask\")\n");
-			fprintf (fp, "\t\t\t(solder_mask_margin %f)\n", (mask - thick)/2.0);
-			fprintf (fp, "\t\t\t(clearance %f)\n", clear/2);
-			if (TEST_ANY_THERMS(pin))
-			{
-				int l;
-				int thermal = 1;
-				gui->log ((_("Pin with thermal\n")));
-				for(l = 0; l<max_copper_layer; l++)
-				{
-					int tstyle = GET_THERM (l, pin);
-					gui->log ((_("Thermal on layer %d - Type: %d\n")), l, tstyle);
-					switch(tstyle)
-					{
-						case 0:
-							continue;
-						case 3:
-							thermal = 2;
-							break;
-						default:
-							break;
-					}
-					break;
-				}
-				fprintf (fp, "\t\t\t(zone_connect %d)\n", thermal);
-				fprintf (fp, "\t\t\t(thermal_gap %f)\n", clear/2);
-			}
-			fprintf (fp, "\t\t\t(net %d \"%s\")\n", net->net_id, net->net_name);
-			fprintf (fp, "\t\t\t(uuid %s)\n", kicad_uuid(uuid));
-			fprintf (fp, "\t\t)\n");
-    }
-    END_LOOP;
-
-		PAD_LOOP (element)
-    {
-			if(pad->Thickness > 0)
-			{
-				net_descriptor* net = 0;
-				if(!TEST_FLAG (VISITFLAG, pad))
-				{
-					int i, j;
-					char nodename[256];
-					sprintf(nodename, "%s-%s", element->Name[1].TextString, pad->Number);
-					for (i=0; i<PCB->NetlistLib.MenuN; i++)
-					{
-						for (j=0; j<PCB->NetlistLib.Menu[i].EntryN; j++)
-						{
-							if (strcmp (PCB->NetlistLib.Menu[i].Entry[j].ListEntry, nodename) == 0)
-							{
-									/*printf(" in [%s]\n", PCB->NetlistLib.Menu[i].Name);*/
-									net = &net_descs[i+1];
-									break;
-							}
-						}
-					}
-					kicad_add_net(PAD_TYPE, pad, net);
-				}
-				else
-				{
-					net = kicad_get_net_assign(pad);
-				}
+	"\t\t(43 \"Eco2.User\" user)\n"
+	"\t\t(44 \"Edge.Cuts\" user)\n"
+	"\t\t(45 \"Margin\" user)\n"
+	"\t\t(46 \"B.CrtYd\" user \"B.Courtyard\")\n"
+	"\t\t(47 \"F.CrtYd\" user \"F.Courtyard\")\n"
+	"\t\t(48 \"B.Fab\" user)\n"
+	"\t\t(49 \"F.Fab\" user)\n"
+	"\t\t(50 \"User.1\" user)\n"
+	"\t\t(51 \"User.2\" user)\n"
+	"\t\t(52 \"User.3\" user)\n"
+	"\t\t(53 \"User.4\" user)\n"
+	"\t\t(54 \"User.5\" user)\n"
+	"\t\t(55 \"User.6\" user)\n"
+	"\t\t(56 \"User.7\" user)\n"
+	"\t\t(57 \"User.8\" user)\n"
+	"\t\t(58 \"User.9\" user)\n"
+  "\t)\n";
 
-				if(net == 0)
-				{
-					net = &net_descs[0];
-				}
 
+	sexpr_printf (&out, kicad_header);
+	sexpr_printf (&out, kicad_pagesettings, COORD_TO_MM(PCB->MaxWidth), COORD_TO_MM(PCB->MaxHeight));
+	kicad_map_groups();
+	sexpr_printf (&out, "\t(layers\n");
+	kicad_print_copper_layers(&out);
+	sexpr_printf (&out, kicad_user_layers);
 
-				char* shape = "oval";
-				char* chamfer = 0;
-				if (TEST_FLAG (SQUAREFLAG, pad))
-				{
-					shape = "rect";
-				}
-				else if (TEST_FLAG (OCTAGONFLAG, pad))
-				{
-					shape = "rect";
-					chamfer = "(chamfer_ratio 0.29365) (chamfer top_left top_right bottom_left bottom_right)";
-				}
+	kicad_phase_begin(&mark, &out);
+	int netnum = 0;
+	strcpy(net_descs[num_net_descs].net_name, "0");
+	sexpr_printf (&out, "\t(net %d \"%s\")\n", netnum, net_descs[num_net_descs].net_name);
+	num_net_descs++;
+	netnum++;
 
-				char* layer = "\"F.Cu\"";
-				char* paste = "\"F.Paste\"";
-				char* maskl = "\"F.Mask\"";
 
-				if (TEST_FLAG (ONSOLDERFLAG, pad))
-				{
-					layer = "\"B.Cu\"";
-					paste = "\"B.Paste\"";
-					maskl = "\"B.Mask\"";
-				}
-				if (TEST_FLAG (NOPASTEFLAG, pad))
-				{
-					paste = "";
-				}
+	for (i=0; i<PCB->NetlistLib.MenuN; i++)
+	{
+		char* netname = PCB->NetlistLib.Menu[i].Name;
+		while(*netname == ' ') netname++;
 
-				double x1, x2, y1, y2, xr1, xr2, yr1, yr2, dx, dy, thick, mask, clear;
-				xr1 = COORD_TO_MM(pad->Point1.X) - ex;
-				xr2 = COORD_TO_MM(pad->Point2.X) - ex;
-				yr1 = COORD_TO_MM(pad->Point1.Y) - ey;
-				yr2 = COORD_TO_MM(pad->Point2.Y) - ey;
-				x1 =  xr1 * cosphi - yr1 * sinphi;
-				y1 =  xr1 * sinphi + yr1 * cosphi;
-				x2 =  xr2 * cosphi - yr2 * sinphi;
-				y2 =  xr2 * sinphi + yr2 * cosphi;
-				dx = x2 - x1;
-				dy = y2 - y1;
-				thick = COORD_TO_MM(pad->Thickness);
-				mask  = COORD_TO_MM(pad->Mask);
-				clear = COORD_TO_MM(pad->Clearance);
-
-				double x, y, angle, w, h;
-				x = (x1 + x2)/2.0;
-				y = (y1 + y2)/2.0;
-				angle = rot;
-				if(fabs(dx) <= 0.0001 && fabs(dy) <= 0.0001)
-				{
-					w = thick;
-					h = thick;
-				}
-				else if(fabs(dx) <= 0.0001)
-				{
-					w = fabs(dy) + thick;
-					h = thick;
-					angle += 90.0;
-				}
-				else if(fabs(dy) <= 0.0001)
-				{
-					w = fabs(dx) + thick;
-					h = thick;
-				}
-				else
-				{
-					angle += atan(dx / dy) * 180.0 / M_PI;
-					h = sqrt(dx * dx + dy * dy) + thick;
-					w = thick;
-				}
+		if(num_net_descs >= max_net_descs)
+		{
+			const int grow = 100;
+			net_descriptor* tmp = net_descs;
+			net_descs = calloc(max_net_descs + grow, sizeof(net_descriptor));
+			memcpy(net_descs, tmp, max_net_descs * sizeof(net_descriptor));
+			max_net_descs += grow;
+			free(tmp);
+		}
 
-				fprintf (fp, "\t\t(pad \"%s\" smd %s\n", pad->Number, shape);
-				if(chamfer)
-				{
-					fprintf (fp, "\t\t\t%s\n", chamfer);
-				}
-				fprintf (fp, "\t\t\t(at %f %f %f)\n", x, y, angle);
-				fprintf (fp, "\t\t\t(size %f %f)\n", w, h);
-				fprintf (fp, "\t\t\t(layers %s %s %s)\n", layer, paste, maskl);
-				fprintf (fp, "\t\t\t(solder_mask_margin %f)\n", (mask - thick)/2.0);
-				fprintf (fp, "\t\t\t(clearance %f)\n", clear/2.0);
-				fprintf (fp, "\t\t\t(net %d \"%s\")\n", net->net_id, net->net_name);
-				fprintf (fp, "\t\t\t(uuid %s)\n", kicad_uuid(uuid));
-				fprintf (fp, "\t\t)\n");
-			}
-			/*
-			else if(pad->Mask > 0)
-			{
+		net_descs[num_net_descs].net_id = netnum;
+		strncpy(net_descs[num_net_descs].net_name, netname, 16);
+		sexpr_printf (&out, "\t(net %d \"%s\")\n", netnum, net_descs[num_net_descs].net_name);
+		num_net_descs++;
+		netnum++;
+	}
 
-			}
-			*/
-		}
-		END_LOOP;
+	kicad_assign_nets(net_descs);
+	kicad_phase_end(&stats[KICAD_PHASE_NETS], &mark, &out, num_net_descs);
 
-		ELEMENTLINE_LOOP(element)
-		{
-			double xr1, yr1, xr2, yr2, x1, y1, x2, y2, thick;
-			xr1 = COORD_TO_MM(line->Point1.X) - ex;
-			xr2 = COORD_TO_MM(line->Point2.X) - ex;
-			yr1 = COORD_TO_MM(line->Point1.Y) - ey;
-			yr2 = COORD_TO_MM(line->Point2.Y) - ey;
-			x1 =  xr1 * cosphi - yr1 * sinphi;
-			y1 =  xr1 * sinphi + yr1 * cosphi;
-			x2 =  xr2 * cosphi - yr2 * sinphi;
-			y2 =  xr2 * sinphi + yr2 * cosphi;
-			thick = COORD_TO_MM(line->Thickness);
-			fprintf (fp, "\t\t(fp_line\n");
-			fprintf (fp, "\t\t\t(start %f %f)\n", x1, y1);
-			fprintf (fp, "\t\t\t(end %f %f)\n", x2, y2);
-			fprintf (fp, "\t\t\t(stroke\n\t\t\t\t(width %f)\n\t\t\t\t(type default)\n\t\t\t)\n", thick);
-			fprintf (fp, "\t\t\t(layer \"%s\")\n", slayer);
-			fprintf (fp, "\t\t\t(uuid %s)\n", kicad_uuid(uuid));
-			fprintf (fp, "\t\t)\n");
-		}
-		END_LOOP;
+	kicad_phase_begin(&mark, &out);
+	if (kicad_libraryname)
+		kicad_library_write(kicad_libraryname, net_descs);
+	if (kicad_cachename)
+		kicad_cache_load(kicad_cachename);
 
-		fprintf (fp, (_("\t)\n")));
+	ELEMENT_LOOP (PCB->Data);
+	{
+		if (kicad_cachename)
+			kicad_print_cached_element(&out, element, net_descs);
+		else
+			kicad_print_element(&out, element, net_descs);
 	}
 	END_LOOP;
 
+	if (kicad_cachename)
+		kicad_cache_save(kicad_cachename);
+	kicad_library_free();
+	kicad_phase_end(&stats[KICAD_PHASE_FOOTPRINTS], &mark, &out, PCB->Data->ElementN);
+
+	kicad_phase_begin(&mark, &out);
 	VIA_LOOP(PCB->Data)
 	{
 		const char* kicad_via =
@@ -956,6 +2229,12 @@ kicad_print (void)
 		drill = COORD_TO_MM(via->DrillingHole);
 
 		char* type = "";
+		char layers[24];
+
+		if (VIA_IS_BURIED(via) && kicad_via_layers(via, layers))
+			type = "blind";
+		else
+			strcpy(layers, "\"F.Cu\" \"B.Cu\"");
 
 		net_descriptor* net = kicad_get_net_assign(via);
 		if(net == 0)
@@ -963,9 +2242,18 @@ kicad_print (void)
 			net = &net_descs[0];
 		}
 
-		fprintf (fp, kicad_via, type, x, y, size, drill, "\"F.Cu\" \"B.Cu\"", net->net_id, kicad_uuid(uuid));
+		sexpr_printf (&out, kicad_via, type, x, y, size, drill, layers, net->net_id, kicad_uuid(uuid, VIA_TYPE, via->ID, 0));
 	}
 	END_LOOP;
+	kicad_phase_end(&stats[KICAD_PHASE_VIAS], &mark, &out, PCB->Data->ViaN);
+
+	/* Resolve the layers here, then generate their contents into separate
+	 * buffers on worker threads and concatenate them in layer order.
+	 */
+	kicad_layer_job jobs[MAX_LAYER + 2];
+	kicad_layer_queue queue;
+	GThread* threads[MAX_LAYER + 2];
+	int njobs = 0, nthreads = 0;
 
 	LAYER_LOOP(PCB->Data, max_copper_layer + SILK_LAYER)
 	{
@@ -973,10 +2261,9 @@ kicad_print (void)
 		int group = GetLayerGroupNumberByNumber(layeridx);
 		int is_copper = 0;
 
-		gui->log ((_("Processing layer %s - Type: %d\n")), layer->Name, layer->Type);
+		kicad_log ((_("Processing layer %s - Type: %d\n")), layer->Name, layer->Type);
 
-		char  namebuf[32];
-		char* layername = "F.Cu";
+		const char* layername = "F.Cu";
 
 		switch(layer->Type)
 		{
@@ -994,356 +2281,258 @@ kicad_print (void)
 				layername = "Edge.Cuts";
 				break;
 			case LT_COPPER:
-				if(group == GetLayerGroupNumberBySide(TOP_SIDE))
-				{
-					layername = "F.Cu";
-					is_copper = 1;
-				}
-				else if (group == GetLayerGroupNumberBySide(BOTTOM_SIDE))
-				{
-					layername = "B.Cu";
-					is_copper = 1;
-				}
-				else if(strcmp(layer->Name, "outline") == 0)
+				if(strcmp(layer->Name, "outline") == 0
+				   && group != GetLayerGroupNumberBySide(TOP_SIDE)
+				   && group != GetLayerGroupNumberBySide(BOTTOM_SIDE))
 				{
 					layername = "Edge.Cuts";
 				}
 				else
 				{
-					sprintf(namebuf, "In%d.Cu", group);
-					layername = namebuf;
+					layername = kicad_group_layer[group];
 					is_copper = 1;
 				}
 				break;
 			case LT_NOTES:
 				layername = "Cmts.User";
 			default:
-				gui->log ((_("Unsupported layer type %d, skipping\n")), layer->Type);
+				kicad_log ((_("Unsupported layer type %d, skipping\n")), layer->Type);
 				continue;
 		}
 
-		if(is_copper)
-		{
-			LINE_LOOP(layer)
-			{
-				const char* kicad_segment =
-				"\t(segment\n"
-				"\t\t(start %f %f)\n"
-				"\t\t(end %f %f)\n"
-				"\t\t(width %f)\n"
-				"\t\t(layer \"%s\")\n"
-				"\t\t(net %d)\n"
-				"\t\t(uuid \"%s\")\n"
-				"\t)\n";
-
-				double x1, y1, x2, y2, thick;
-				x1 = COORD_TO_MM(line->Point1.X);
-				x2 = COORD_TO_MM(line->Point2.X);
-				y1 = COORD_TO_MM(line->Point1.Y);
-				y2 = COORD_TO_MM(line->Point2.Y);
-				thick = COORD_TO_MM(line->Thickness);
-
-				net_descriptor* net = kicad_get_net_assign(line);
-
-				if(net == 0)
-				{
-					net = &net_descs[0];
-				}
-
-				fprintf (fp, kicad_segment, x1, y1, x2, y2, thick, layername, net->net_id, kicad_uuid(uuid));
-			}
-			END_LOOP;
-
-			ARC_LOOP(layer)
-			{
-				const char* kicad_arc =
-				"\t(arc\n"
-				"\t\t(start %f %f)\n"
-//				"\t\t(mid %f %f)\n"
-				"\t\t(end %f %f)\n"
-				"\t\t(angle %f)\n"
-				"\t\t(width %f)\n"
-				"\t\t(layer \"%s\")\n"
-				"\t\t(net %d)\n"
-				"\t\t(uuid \"%s\")\n"
-				"\t)\n";
-
-				double x, y, width, height, startangle, delta, thick;
-				x = COORD_TO_MM(arc->X);
-				y = COORD_TO_MM(arc->Y);
-				width  = COORD_TO_MM(arc->Width);
-				height = COORD_TO_MM(arc->Height);
-				startangle = arc->StartAngle * M_PI / 180.0;
-				delta      = arc->Delta * M_PI / 180.0;
-				thick      = COORD_TO_MM(arc->Thickness);
-
-				//double radius, xstart, ystart,xend, yend;
-				double radius, xend, yend;
-				radius = (width + height) / 2.0;
-				//xstart = x - radius * cos(startangle);
-				//ystart = y + radius * sin(startangle);
-				xend   = x - radius * cos(startangle + delta);
-				yend   = y + radius * sin(startangle + delta);
-
-				net_descriptor* net = kicad_get_net_assign(arc);
-
-				if(net == 0)
-				{
-					net = &net_descs[0];
-				}
+		kicad_layer_job* job = &jobs[njobs++];
+		job->layer = layer;
+		strncpy(job->layername, layername, sizeof(job->layername) - 1);
+		job->layername[sizeof(job->layername) - 1] = '\0';
+		job->is_copper = is_copper;
+		job->net_descs = net_descs;
+		memset(job->stats, 0, sizeof(job->stats));
+		sexpr_open_memory(&job->out);
+	}
+	END_LOOP;
 
-				//fprintf (fp, kicad_arc, xstart, ystart, x, y, xend, yend, thick, layername, net->net_id, kicad_uuid(uuid));
-				fprintf (fp, kicad_arc, x, y, xend, yend, arc->Delta, thick, layername, net->net_id, kicad_uuid(uuid));
-			}
-			END_LOOP;
+	queue.jobs = jobs;
+	queue.n = njobs;
+	queue.next = 0;
+	for (i = 1; i < MIN(njobs, (int) g_get_num_processors()); i++)
+	{
+		threads[nthreads++] = g_thread_new("kicad-layer", kicad_layer_worker, &queue);
+	}
+	kicad_layer_worker(&queue);
+	for (i = 0; i < nthreads; i++)
+	{
+		g_thread_join(threads[i]);
+	}
 
-			POLYGON_LOOP(layer)
-			{
-				const char* kicad_zone_header =
-				"\t(zone\n"
-				"\t\t(net %d)\n"
-				"\t\t(net_name \"%s\")\n"
-				"\t\t(layer \"%s\")\n"
-				"\t\t(uuid \"%s\")\n"
-				"\t\t(hatch edge 0.508)\n"
-				"\t\t(connect_pads no (clearance 0.25))\n"
-				"\t\t(min_thickness 0.1)\n"
-				"\t\t(fill yes\n"
-				"\t\t\t(island_removal_mode %d)\n"
-				"\t\t\t(island_area_min %f)\n"
-				"\t\t)\n"
-				"\t\t(polygon\n\t\t\t(pts\n";
+	for (i = 0; i < njobs; i++)
+	{
+		sexpr_write(&out, jobs[i].out.buf, jobs[i].out.len);
+		sexpr_close(&jobs[i].out);
+		for (int p = KICAD_PHASE_SEGMENTS; p < KICAD_PHASE_N; p++)
+		{
+			stats[p].usec += jobs[i].stats[p].usec;
+			stats[p].count += jobs[i].stats[p].count;
+			stats[p].bytes += jobs[i].stats[p].bytes;
+		}
+	}
 
-				const char* kicad_zone_footer =
-				"\t\t\t)\n"
-				"\t\t)\n"
-				"\t)\n";
+	sexpr_printf (&out, ")\n");
 
-				int np = 0;
+	kicad_free_nets();
+	free(net_descs);
 
-				net_descriptor* net = kicad_get_net_assign(polygon);
-				if(net == 0)
-				{
-					net = &net_descs[0];
-				}
+	size_t written = out.written;
+	ok = sexpr_close (&out);
+	if (!kicad_close_output (fp, is_pipe) || !ok)
+	{
+		kicad_log ((_("Error writing file %s\n")), kicad_filename);
+		return 1;
+	}
 
-				int full = 0;
-				if(TEST_FLAG(FULLPOLYFLAG, polygon))
-				{
-					full = 2;
-				}
+	if (kicad_stats)
+		kicad_report_stats(stats, g_get_monotonic_time() - start, written);
 
-				double min_poly_area = COORD_TO_MM(COORD_TO_MM(PCB->IsleArea));
+	return (0);
+}
 
-				fprintf (fp, kicad_zone_header, net->net_id, net->net_name, layername, kicad_uuid(uuid), full, min_poly_area);
+/*!
+ * \brief A board of a batch conversion.
+ */
+typedef struct
+{
+	char* input;
+	char* output;
+} kicad_batch_entry;
 
-				int PointN = polygon->HoleIndexN > 0 ? polygon->HoleIndex[0] : polygon->PointN;
-				for (int n = 0; n < PointN; n++)
-				{
-					PointType* point = &(polygon)->Points[n];
-					double x, y;
-					x = COORD_TO_MM(point->X);
-					y = COORD_TO_MM(point->Y);
-					if(np == 0)
-					{
-						fprintf (fp, "\t\t\t\t(xy %f %f)", x, y);
-					}
-					else
-					{
-						fprintf (fp, " (xy %f %f)", x, y);
-					}
-					np++;
-					if(np > 6)
-					{
-						np = 0;
-						fprintf (fp, "\n");
-					}
-				}
+/*!
+ * \brief Read the list of boards of a batch conversion.
+ *
+ * Each line holds an input board, optionally followed by a tab and the
+ * output file.  Without one, the output is named after the input with
+ * its ".pcb" suffix replaced by ".kicad_pcb".  Empty lines and lines
+ * starting with '#' are skipped.
+ *
+ * \return the number of boards, or -1 if the list can't be read.
+ */
+static int
+kicad_batch_read(const char* listname, kicad_batch_entry** entries)
+{
+	FILE* fp;
+	char line[4096];
+	int n = 0, max = 0;
 
-				if(np != 0)
-				{
-					fprintf (fp, "\n");
-				}
-				fprintf (fp, kicad_zone_footer);
+	*entries = NULL;
+	fp = fopen(listname, "r");
+	if (!fp)
+	{
+		kicad_log ((_("Cannot open batch list %s\n")), listname);
+		return -1;
+	}
 
-				for(int h = 0; h < polygon->HoleIndexN; h++)
-				{
-					const char* kicad_keepout_header =
-					"\t(zone\n"
-					"\t\t(net %d)\n"
-					"\t\t(net_name \"\")\n"
-					"\t\t(layer \"%s\")\n"
-					"\t\t(uuid \"%s\")\n"
-					"\t\t(hatch edge 0.508)\n"
-					"\t\t(connect_pads no (clearance 0.25))\n"
-					"\t\t(min_thickness 0.1)\n"
-					"\t\t(keepout\n"
-					"\t\t\t(tracks allowed)\n"
-					"\t\t\t(vias allowed)\n"
-					"\t\t\t(pads allowed)\n"
-					"\t\t\t(copperpour not_allowed)\n"
-					"\t\t\t(footprints allowed)\n"
-					"\t\t)\n"
-					"\t\t(fill yes\n"
-//					"\t\t\t(island_removal_mode 2)\n"
-//					"\t\t\t(island_area_min %f)\n"
-					"\t\t)\n"
-					"\t\t(polygon\n\t\t\t(pts\n";
+	while (fgets(line, sizeof(line), fp))
+	{
+		char* tab;
+		size_t len = strcspn(line, "\r\n");
 
-					const char* kicad_keepout_footer =
-					"\t\t\t)\n"
-					"\t\t)\n"
-					"\t)\n";
+		line[len] = '\0';
+		if (len == 0 || line[0] == '#')
+			continue;
 
-					fprintf (fp, kicad_keepout_header, net->net_id, layername, kicad_uuid(uuid));
+		if (n >= max)
+		{
+			max = max ? 2 * max : 64;
+			*entries = realloc(*entries, max * sizeof(kicad_batch_entry));
+		}
 
-					int EndPointN = (h+1) < polygon->HoleIndexN ? polygon->HoleIndex[h+1] : polygon->PointN;
-					for (int n = polygon->HoleIndex[h]; n < EndPointN; n++)
-					{
-						PointType* point = &(polygon)->Points[n];
-						double x, y;
-						x = COORD_TO_MM(point->X);
-						y = COORD_TO_MM(point->Y);
-						if(np == 0)
-						{
-							fprintf (fp, "\t\t\t\t(xy %f %f)", x, y);
-						}
-						else
-						{
-							fprintf (fp, " (xy %f %f)", x, y);
-						}
-						np++;
-						if(np > 6)
-						{
-							np = 0;
-							fprintf (fp, "\n");
-						}
-					}
-
-					if(np != 0)
-					{
-						fprintf (fp, "\n");
-					}
-					fprintf (fp, kicad_keepout_footer);
-				}
-			}
-			END_LOOP;
+		tab = strchr(line, '\t');
+		if (tab)
+		{
+			*tab = '\0';
+			(*entries)[n].output = g_strdup(tab + 1);
 		}
 		else
 		{
-			LINE_LOOP(layer)
-			{
-				const char* kicad_gr_line =
-				"\t(gr_line\n"
-				"\t\t(start %f %f)\n"
-				"\t\t(end %f %f)\n"
-				"\t\t(stroke\n\t\t\t(width %f)\n\t\t\t(type solid)\n\t\t)\n"
-				"\t\t(layer \"%s\")\n"
-				"\t\t(uuid \"%s\")\n"
-				"\t)\n";
-
-				double x1, y1, x2, y2, thick;
-				x1 = COORD_TO_MM(line->Point1.X);
-				x2 = COORD_TO_MM(line->Point2.X);
-				y1 = COORD_TO_MM(line->Point1.Y);
-				y2 = COORD_TO_MM(line->Point2.Y);
-				thick = COORD_TO_MM(line->Thickness);
+			len = strlen(line);
+			if (len > 4 && strcmp(line + len - 4, ".pcb") == 0)
+				len -= 4;
+			(*entries)[n].output = g_strdup_printf("%.*s.kicad_pcb", (int) len, line);
+		}
+		(*entries)[n].input = strdup(line);
+		n++;
+	}
+	fclose(fp);
+	return n;
+}
 
-				fprintf (fp, kicad_gr_line, x1, y1, x2, y2, thick, layername, kicad_uuid(uuid));
-			}
-			END_LOOP;
+/*!
+ * \brief The boards of a batch conversion, for its workers.
+ */
+typedef struct
+{
+	kicad_batch_entry* entries;
+	int failed;
+} kicad_batch_state;
 
-			ARC_LOOP(layer)
-			{
-				const char* kicad_gr_arc =
-				"\t(gr_arc\n"
-				"\t\t(start %f %f)\n"
-				//"\t\t(mid %f %f)\n"
-				"\t\t(end %f %f)\n"
-				"\t\t(angle %f)\n"
-				"\t\t(stroke\n\t\t\t(width %f)\n\t\t\t(type solid)\n\t\t)\n"
-				"\t\t(layer \"%s\")\n"
-				"\t\t(uuid \"%s\")\n"
-				"\t)\n";
+/*!
+ * \brief Load and export a board of a batch.
+ *
+ * \return 0 if the board was converted.
+ */
+static int
+kicad_batch_board(kicad_batch_entry* entry)
+{
+	int save_ons[MAX_ALL_LAYER];
+	int failed;
 
-				double x, y, width, height, startangle, delta, thick;
-				x = COORD_TO_MM(arc->X);
-				y = COORD_TO_MM(arc->Y);
-				width  = COORD_TO_MM(arc->Width);
-				height = COORD_TO_MM(arc->Height);
-				startangle = arc->StartAngle * M_PI / 180.0;
-				delta      = arc->Delta * M_PI / 180.0;
-				thick      = COORD_TO_MM(arc->Thickness);
-
-				//double radius, xstart, ystart, xmid, ymid, xend, yend;
-				double radius, xend, yend;
-				radius = (width + height) / 2.0;
-//				xstart = x - radius * cos(startangle);
-//				ystart = y + radius * sin(startangle);
-//				xmid   = x - radius * cos(startangle + 0.5 * delta);
-//				ymid   = y + radius * sin(startangle + 0.5 * delta);
-				xend   = x - radius * cos(startangle + delta);
-				yend   = y + radius * sin(startangle + delta);
+	if (LoadPCB(entry->input))
+	{
+		kicad_log ((_("Cannot load %s, skipping\n")), entry->input);
+		return 1;
+	}
 
-				//fprintf (fp, kicad_gr_arc, xstart, ystart, xmid, ymid, xend, yend, thick, layername, kicad_uuid(uuid));
-				fprintf (fp, kicad_gr_arc, x, y, xend, yend, arc->Delta, thick, layername, kicad_uuid(uuid));
-			}
-			END_LOOP;
+	kicad_filename = entry->output;
+	hid_save_and_show_layer_ons (save_ons);
+	failed = kicad_print ();
+	hid_restore_layer_ons (save_ons);
+	return failed;
+}
 
-			TEXT_LOOP(layer)
-			{
-				const char* kicad_gr_text =
-				"\t(gr_text \"%s\"\n"
-				"\t\t(at %f %f %d)\n"
-				"\t\t(layer \"%s\")\n"
-				"\t\t(uuid \"%s\")\n"
-				"\t\t(effects\n"
-				"\t\t\t(font\n"
-				"\t\t\t\t(size %f %f)\n"
-				"\t\t\t\t(thickness 0.18)\n"
-				"\t\t\t)\n"
-				"\t\t\t(justify left top %s)\n"
-				"\t\t)\n"
-				"\t)\n";
+/*!
+ * \brief Convert board part of a batch in a worker process, and write
+ * whether it made it to fp.
+ *
+ * The exit status only tells whether the worker ran to the end.  A board
+ * that can't be converted is reported as "failed", as doing it again
+ * here would fail all the same.
+ */
+static int
+kicad_batch_worker(int part, FILE* fp, void* data)
+{
+	kicad_batch_state* batch = (kicad_batch_state*) data;
 
-				double x, y, theight, twidth;
-				int angle;
-				x = COORD_TO_MM(text->X);
-				y = COORD_TO_MM(text->Y);
-				theight = 1.0 * text->Scale / 100.0;
-				twidth  = 0.8 * text->Scale / 100.0;
-				angle   = text->Direction * 90;
+	fprintf (fp, "%s\n", kicad_batch_board (&batch->entries[part]) ? "failed" : "ok");
+	return 0;
+}
 
-				char* mirror = "";
-				if(TEST_FLAG(ONSOLDERFLAG, text))
-				{
-					mirror = "mirror";
-					angle = 180 - angle;
-				}
+/*!
+ * \brief Count board part of a batch as a worker reported it, or convert
+ * it here if fp is NULL.
+ */
+static bool
+kicad_batch_merge(int part, FILE* fp, void* data)
+{
+	kicad_batch_state* batch = (kicad_batch_state*) data;
+	char line[16];
 
-				fprintf (fp, kicad_gr_text, text->TextString,
-									x,
-									y,
-									angle,
-									layername,
-									kicad_uuid(uuid), theight, twidth, mirror);
-			}
-			END_LOOP;
-		}
+	if (!fp)
+	{
+		if (kicad_batch_board (&batch->entries[part]))
+			batch->failed++;
+		return true;
 	}
-	END_LOOP;
 
-	fprintf (fp, ")\n");
+	if (!fgets (line, sizeof (line), fp))
+		return false;
+	if (strcmp (line, "failed\n") == 0)
+		batch->failed++;
+	else if (strcmp (line, "ok\n") != 0)
+		return false;
+	return true;
+}
+
+/*!
+ * \brief Convert all the boards of a batch list.
+ *
+ * The process has been set up once (fonts, library, settings), and each
+ * board is loaded in turn.  With more than one job, worker processes
+ * forked by pcb_fork_workers() convert a board each, up to njobs at a
+ * time, and a board whose worker did not report back is converted here.
+ *
+ * \return the number of boards that failed.
+ */
+static int
+kicad_batch(const char* listname, int njobs)
+{
+	kicad_batch_state batch;
+	int i, n;
 
-	ClearFlagOnAllObjects(VISITFLAG, true);
-	free(kicad_net_assign);
-	kicad_net_assign = 0;
-	kicad_max_net_assign = 0;
-	free(net_descs);
+	n = kicad_batch_read(listname, &batch.entries);
+	if (n < 0)
+		return 1;
 
-	fclose (fp);
+	batch.failed = 0;
+	pcb_fork_workers (n, njobs > 1 ? njobs : 0, -1, true,
+	                  kicad_batch_worker, kicad_batch_merge, &batch);
 
-	return (0);
+	for (i = 0; i < n; i++)
+	{
+		free(batch.entries[i].input);
+		g_free(batch.entries[i].output);
+	}
+	free(batch.entries);
+
+	kicad_log ((_("Converted %d boards, %d failed\n")), n - batch.failed, batch.failed);
+	return batch.failed;
 }
 
 /*!
@@ -1353,6 +2542,7 @@ static void
 kicad_do_export (HID_Attr_Val * options)
 {
 	int i;
+	const char* batchname;
 	int save_ons[MAX_ALL_LAYER];
 
 	if (!options)
@@ -1365,13 +2555,44 @@ kicad_do_export (HID_Attr_Val * options)
 		options = kicad_values;
 	}
 
+	UpdatePolygonClipping ();
+
 	kicad_filename = options[HA_kicad_file].str_value;
 
 	if (!kicad_filename)
 		kicad_filename = "pcb-out.kicad_pcb";
 
+	kicad_compress = options[HA_kicad_compress].int_value;
+	kicad_stats = options[HA_kicad_stats].int_value;
+	kicad_zone_holes = options[HA_kicad_zone_holes].int_value;
+	kicad_zone_fill = options[HA_kicad_zone_fill].int_value;
+
+	kicad_cachename = options[HA_kicad_cache].str_value;
+	if (kicad_cachename && !*kicad_cachename)
+		kicad_cachename = NULL;
+
+	kicad_libraryname = options[HA_kicad_library].str_value;
+	if (kicad_libraryname && !*kicad_libraryname)
+		kicad_libraryname = NULL;
+
+	batchname = options[HA_kicad_batch].str_value;
+	if (batchname && *batchname)
+	{
+		/* One cache file or library can't serve many boards. */
+		kicad_cachename = NULL;
+		kicad_libraryname = NULL;
+
+		/* A batch runs from the command line, let the exit status tell
+		 * whether all boards made it, once all exporters have run.
+		 */
+		if (kicad_batch (batchname, options[HA_kicad_jobs].int_value))
+			export_failures++;
+		return;
+	}
+
 	hid_save_and_show_layer_ons (save_ons);
-	kicad_print ();
+	if (kicad_print ())
+		export_failures++;
 	hid_restore_layer_ons (save_ons);
 }
 
@@ -1389,8 +2610,10 @@ kicad_parse_arguments (int *argc, char ***argv)
 
 HID kicad_hid;
 
+#include "dolists.h"
+
 /*!
- * \brief Initialise the exporter HID.
+ * \brief Initialise the exporter HID, and the import action.
  */
 void
 hid_kicad_init ()
@@ -1409,6 +2632,8 @@ hid_kicad_init ()
 	kicad_hid.parse_arguments     = kicad_parse_arguments;
 
 	hid_register_hid (&kicad_hid);
+
+#include "kicad_lists.h"
 }
 
 /* EOF */
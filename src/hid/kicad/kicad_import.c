@@ -0,0 +1,1532 @@
+/*!
+ * \file src/hid/kicad/kicad_import.c
+ *
+ * \brief Imports a KiCad pcb file.
+ *
+ * The board is read in a single pass over the mapped file by the
+ * S-expression reader of sexpr.c, and every object is created as soon
+ * as its list is closed.  The search trees of the new board are made
+ * with the layers and filled in bulk once the file is read, see
+ * r_defer_inserts().
+ *
+ * What becomes of the KiCad objects:
+ * - every copper layer gets a layer group, F.Cu is the top and B.Cu the
+ *   bottom side, Edge.Cuts becomes the outline layer;
+ * - segment, arc and via become lines, arcs and vias, blind and buried
+ *   vias keep their layer span;
+ * - gr_line, gr_arc, gr_circle, gr_rect and gr_poly on copper, silk and
+ *   Edge.Cuts become lines and arcs there, a gr_poly on copper becomes
+ *   a polygon, as does the outline of a zone on each of its layers;
+ * - a footprint becomes an element: its pads become pads and pins of
+ *   the nearest shape PCB has, its silk graphics element lines and arcs;
+ * - the nets of the pads become the netlist.
+ *
+ * Texts, dimensions, keepout zones, zone fills and the objects on any
+ * other layer are left out.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "boardcache.h"
+#include "create.h"
+#include "data.h"
+#include "error.h"
+#include "file.h"
+#include "misc.h"
+#include "polygon.h"
+#include "rtree.h"
+
+#include "hid.h"
+#include "sexpr.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+/*!
+ * \brief Clearance of KiCad's default net class, for the objects that
+ * have none of their own.
+ */
+#define KICAD_CLEARANCE MM_TO_COORD (0.2)
+
+/*!
+ * \brief Width of the graphics given none, like filled shapes.
+ */
+#define KICAD_LINE_WIDTH MM_TO_COORD (0.1)
+
+#define KICAD_COORD(mm) ((Coord) floor (MM_TO_COORD (mm) + 0.5))
+
+/* What a KiCad layer name refers to; the copper layers are numbered
+ * from 0 for F.Cu to kicad_copper_n - 1 for B.Cu. */
+#define KICAD_NO_LAYER     -1
+#define KICAD_OUTLINE      -2
+#define KICAD_TOP_SILK     -3
+#define KICAD_BOTTOM_SILK  -4
+
+/* The shapes of the graphics. */
+#define KICAD_LINE    0
+#define KICAD_ARC     1
+#define KICAD_CIRCLE  2
+#define KICAD_RECT    3
+#define KICAD_POLY    4
+
+/* The fields of a kicad_item that were given. */
+#define KICAD_HAS_START      0x01
+#define KICAD_HAS_END        0x02
+#define KICAD_HAS_MID        0x04
+#define KICAD_HAS_CENTER     0x08
+#define KICAD_HAS_ANGLE      0x10
+#define KICAD_HAS_CLEARANCE  0x20
+#define KICAD_HAS_MASK       0x40
+
+/*!
+ * \brief Leading atoms and strings of a list that are kept.
+ */
+#define KICAD_ATOMS 3
+
+typedef struct
+{
+	const char* text;  /*!< In the mapped file. */
+	size_t len;
+} kicad_atom;
+
+typedef struct
+{
+	Coord x, y;
+} kicad_xy;
+
+/*!
+ * \brief What the lists of a KiCad object say, as far as an import
+ * uses it.
+ */
+typedef struct
+{
+	int kind;                       /*!< KICAD_LINE ... of graphics. */
+	kicad_atom atom[KICAD_ATOMS];   /*!< Leading atoms and strings. */
+	int atoms;                      /*!< Number of atoms and strings. */
+	unsigned has;                   /*!< KICAD_HAS_* */
+	Coord x1, y1;                   /*!< (start) */
+	Coord x2, y2;                   /*!< (end) */
+	Coord mx, my;                   /*!< (mid) */
+	Coord cx, cy;                   /*!< (center) */
+	Coord at_x, at_y;               /*!< (at) */
+	double at_angle;
+	double angle;                   /*!< (angle) of old style arcs. */
+	Coord width;
+	Coord size_x, size_y;
+	Coord drill;
+	Coord clearance;
+	Coord mask_margin;
+	int layer;                      /*!< Of (layer). */
+	guint32 copper;                 /*!< Copper layers of (layer) and (layers). */
+	bool paste;                     /*!< (layers) has a paste layer. */
+	bool hide;
+	bool keepout;
+	int net;                        /*!< Number of (net), -1 if none. */
+	kicad_atom net_name;            /*!< Name of (net), if given there. */
+	GArray* pts;                    /*!< Of kicad_xy, from (pts). */
+} kicad_item;
+
+static SexprReader kicad_in;
+static const char* kicad_in_name;
+static bool kicad_failed;
+static PCBType* kicad_pcb;
+/* copper layers of the board, 0 until the layers are set up */
+static int kicad_copper_n;
+/* net names by KiCad net number */
+static GPtrArray* kicad_net_names;
+/* index + 1 in the netlist of the nets by name */
+static GHashTable* kicad_net_menus;
+
+/*!
+ * \brief Report an error at the current line, once.
+ */
+static void
+kicad_fail (const char* what)
+{
+	if (!kicad_failed)
+		Message (_("%s:%d: %s\n"), kicad_in_name, kicad_in.line, what);
+	kicad_failed = true;
+}
+
+static bool
+kicad_atom_is (const kicad_atom* a, const char* s)
+{
+	return a->len == strlen (s) && memcmp (a->text, s, a->len) == 0;
+}
+
+static bool
+kicad_name_ends (const char* s, size_t len, const char* suffix)
+{
+	size_t n = strlen (suffix);
+
+	return len >= n && memcmp (s + len - n, suffix, n) == 0;
+}
+
+/*!
+ * \brief What the layer name s refers to.
+ */
+static int
+kicad_layer (const char* s, size_t len)
+{
+	kicad_atom a = { s, len };
+
+	if (kicad_atom_is (&a, "F.Cu"))
+		return 0;
+	if (kicad_atom_is (&a, "B.Cu"))
+		return kicad_copper_n - 1;
+	if (len > 5 && memcmp (s, "In", 2) == 0 && kicad_name_ends (s, len, ".Cu"))
+	{
+		if (kicad_copper_n <= 2)
+			return KICAD_NO_LAYER;
+		/* The inner layers beyond the ones we have go to the last one. */
+		return CLAMP (atoi (s + 2), 1, kicad_copper_n - 2);
+	}
+	if (kicad_atom_is (&a, "Edge.Cuts"))
+		return KICAD_OUTLINE;
+	if (kicad_atom_is (&a, "F.SilkS") || kicad_atom_is (&a, "F.Silkscreen"))
+		return KICAD_TOP_SILK;
+	if (kicad_atom_is (&a, "B.SilkS") || kicad_atom_is (&a, "B.Silkscreen"))
+		return KICAD_BOTTOM_SILK;
+	return KICAD_NO_LAYER;
+}
+
+/*!
+ * \brief The copper layers the layer name s refers to, as a bit per
+ * layer.
+ */
+static guint32
+kicad_copper_mask (const char* s, size_t len)
+{
+	kicad_atom a = { s, len };
+	int layer;
+
+	if (kicad_atom_is (&a, "*.Cu"))
+		return (1u << kicad_copper_n) - 1;
+	if (kicad_atom_is (&a, "F&B.Cu"))
+		return 1u | (1u << (kicad_copper_n - 1));
+	layer = kicad_layer (s, len);
+	return layer >= 0 ? 1u << layer : 0;
+}
+
+/*!
+ * \brief The PCB layer of what kicad_layer() returned, NULL if the
+ * layer isn't imported.
+ */
+static LayerType*
+kicad_pcb_layer (int layer)
+{
+	DataType* data = kicad_pcb->Data;
+
+	if (layer >= 0)
+		return &data->Layer[layer];
+	switch (layer)
+	{
+		case KICAD_OUTLINE:
+			return &data->Layer[kicad_copper_n];
+		case KICAD_TOP_SILK:
+			return &data->Layer[data->LayerN + TOP_SILK_LAYER];
+		case KICAD_BOTTOM_SILK:
+			return &data->Layer[data->LayerN + BOTTOM_SILK_LAYER];
+		default:
+			return NULL;
+	}
+}
+
+/*!
+ * \brief Set up the layers of the board for the given number of copper
+ * layers.
+ *
+ * Every copper layer gets a group of its own and is followed by the
+ * outline layer.  The search trees of the board are made here, so the
+ * objects inserted from now on only get noted and go into the trees in
+ * bulk at the end.
+ */
+static void
+kicad_setup_layers (int copper)
+{
+	DataType* data = kicad_pcb->Data;
+	GString* groups;
+	int i, n;
+
+	if (copper < 2)
+		copper = 2;
+	if (copper > MAX_LAYER - 1)
+	{
+		Message (_("%s: only %d of the %d copper layers are kept, the other inner layers go to the last one\n"),
+		         kicad_in_name, MAX_LAYER - 1, copper);
+		copper = MAX_LAYER - 1;
+	}
+	kicad_copper_n = copper;
+
+	groups = g_string_new ("1,c");
+	for (i = 2; i < copper; i++)
+		g_string_append_printf (groups, ":%d", i);
+	g_string_append_printf (groups, ":%d,s:%d", copper, copper + 1);
+	if (ParseGroupString (groups->str, &kicad_pcb->LayerGroups, &data->LayerN))
+		kicad_fail (_("can't set up the layer groups"));
+	g_string_free (groups, TRUE);
+
+	for (i = 0; i <= copper; i++)
+	{
+		LayerType* layer = &data->Layer[i];
+
+		free (layer->Name);
+		if (i == 0)
+			layer->Name = strdup ("top");
+		else if (i == copper - 1)
+			layer->Name = strdup ("bottom");
+		else if (i == copper)
+			layer->Name = strdup ("outline");
+		else
+			layer->Name = g_strdup_printf ("inner%d", i);
+		layer->Type = i == copper ? LT_OUTLINE : LT_COPPER;
+	}
+
+	for (i = 0; i < data->LayerN + SILK_LAYER; i++)
+	{
+		if (!data->Layer[i].line_tree)
+			data->Layer[i].line_tree = r_create_data_tree ();
+		if (!data->Layer[i].polygon_tree)
+			data->Layer[i].polygon_tree = r_create_data_tree ();
+	}
+	if (!data->via_tree)
+		data->via_tree = r_create_data_tree ();
+	if (!data->element_tree)
+		data->element_tree = r_create_data_tree ();
+	if (!data->pin_tree)
+		data->pin_tree = r_create_data_tree ();
+	if (!data->pad_tree)
+		data->pad_tree = r_create_data_tree ();
+	for (n = 0; n < MAX_ELEMENTNAMES; n++)
+		if (!data->name_tree[n])
+			data->name_tree[n] = r_create_data_tree ();
+
+	r_defer_inserts ();
+}
+
+/*!
+ * \brief Read up to n numbers of the list just opened, up to its end.
+ *
+ * Other atoms, strings and lists in it are skipped.
+ *
+ * \return the number of numbers read.
+ */
+static int
+kicad_numbers (double* v, int n)
+{
+	int i = 0;
+
+	for (;;)
+	{
+		switch (sexpr_next (&kicad_in))
+		{
+			case SEXPR_CLOSE:
+				return i;
+			case SEXPR_OPEN:
+				sexpr_skip (&kicad_in);
+				break;
+			case SEXPR_ATOM:
+				if (i < n && sexpr_number (&kicad_in, &v[i]))
+					i++;
+				break;
+			case SEXPR_STRING:
+				break;
+			default:
+				kicad_fail (_("unexpected end of file"));
+				return i;
+		}
+	}
+}
+
+static bool
+kicad_point (Coord* x, Coord* y)
+{
+	double v[2];
+
+	if (kicad_numbers (v, 2) < 2)
+	{
+		kicad_fail (_("point expected"));
+		return false;
+	}
+	*x = KICAD_COORD (v[0]);
+	*y = KICAD_COORD (v[1]);
+	return true;
+}
+
+static Coord
+kicad_length (void)
+{
+	double v;
+
+	return kicad_numbers (&v, 1) ? KICAD_COORD (v) : 0;
+}
+
+/*!
+ * \brief Read the flag of a list like (hide yes), alone it means yes.
+ */
+static bool
+kicad_yes (void)
+{
+	bool yes;
+
+	if (sexpr_next (&kicad_in) == SEXPR_CLOSE)
+		return true;
+	yes = sexpr_is (&kicad_in, "yes") || sexpr_is (&kicad_in, "solid");
+	sexpr_skip (&kicad_in);
+	return yes;
+}
+
+static void
+kicad_item_init (kicad_item* it)
+{
+	memset (it, 0, sizeof (kicad_item));
+	it->layer = KICAD_NO_LAYER;
+	it->net = -1;
+}
+
+static void
+kicad_item_free (kicad_item* it)
+{
+	if (it->pts)
+		g_array_free (it->pts, TRUE);
+	it->pts = NULL;
+}
+
+static void
+kicad_add_xy (kicad_item* it, Coord x, Coord y)
+{
+	kicad_xy p;
+
+	if (!it->pts)
+		it->pts = g_array_new (FALSE, FALSE, sizeof (kicad_xy));
+	p.x = x;
+	p.y = y;
+	g_array_append_val (it->pts, p);
+}
+
+static void kicad_read_item (kicad_item* it);
+
+/*!
+ * \brief Read a (pts) list, the arcs in it become their three points.
+ */
+static void
+kicad_read_pts (kicad_item* it)
+{
+	Coord x, y;
+
+	for (;;)
+	{
+		switch (sexpr_next (&kicad_in))
+		{
+			case SEXPR_CLOSE:
+				return;
+			case SEXPR_OPEN:
+				sexpr_next (&kicad_in);
+				if (sexpr_is (&kicad_in, "xy"))
+				{
+					if (kicad_point (&x, &y))
+						kicad_add_xy (it, x, y);
+				}
+				else if (sexpr_is (&kicad_in, "arc"))
+				{
+					kicad_item arc;
+
+					kicad_item_init (&arc);
+					kicad_read_item (&arc);
+					if (arc.has & KICAD_HAS_START)
+						kicad_add_xy (it, arc.x1, arc.y1);
+					if (arc.has & KICAD_HAS_MID)
+						kicad_add_xy (it, arc.mx, arc.my);
+					if (arc.has & KICAD_HAS_END)
+						kicad_add_xy (it, arc.x2, arc.y2);
+					kicad_item_free (&arc);
+				}
+				else
+					sexpr_skip (&kicad_in);
+				break;
+			case SEXPR_ATOM:
+			case SEXPR_STRING:
+				break;
+			default:
+				kicad_fail (_("unexpected end of file"));
+				return;
+		}
+		if (kicad_failed)
+			return;
+	}
+}
+
+/*!
+ * \brief Read a (net) list: (net number), (net number name) or
+ * (net name).
+ */
+static void
+kicad_read_net (kicad_item* it)
+{
+	double v;
+
+	for (;;)
+	{
+		switch (sexpr_next (&kicad_in))
+		{
+			case SEXPR_CLOSE:
+				return;
+			case SEXPR_ATOM:
+				if (sexpr_number (&kicad_in, &v))
+					it->net = (int) v;
+				break;
+			case SEXPR_STRING:
+				it->net_name.text = kicad_in.text;
+				it->net_name.len = kicad_in.len;
+				break;
+			case SEXPR_OPEN:
+				sexpr_skip (&kicad_in);
+				break;
+			default:
+				kicad_fail (_("unexpected end of file"));
+				return;
+		}
+	}
+}
+
+/*!
+ * \brief Read a list of an object whose keyword was read last.
+ */
+static void
+kicad_read_field (kicad_item* it)
+{
+	SexprReader* r = &kicad_in;
+	double v[3];
+	int n;
+
+	if (sexpr_is (r, "start"))
+	{
+		if (kicad_point (&it->x1, &it->y1))
+			it->has |= KICAD_HAS_START;
+	}
+	else if (sexpr_is (r, "end"))
+	{
+		if (kicad_point (&it->x2, &it->y2))
+			it->has |= KICAD_HAS_END;
+	}
+	else if (sexpr_is (r, "mid"))
+	{
+		if (kicad_point (&it->mx, &it->my))
+			it->has |= KICAD_HAS_MID;
+	}
+	else if (sexpr_is (r, "center"))
+	{
+		if (kicad_point (&it->cx, &it->cy))
+			it->has |= KICAD_HAS_CENTER;
+	}
+	else if (sexpr_is (r, "at"))
+	{
+		v[2] = 0.0;
+		n = kicad_numbers (v, 3);
+		if (n < 2)
+			kicad_fail (_("point expected"));
+		else
+		{
+			it->at_x = KICAD_COORD (v[0]);
+			it->at_y = KICAD_COORD (v[1]);
+			it->at_angle = v[2];
+		}
+	}
+	else if (sexpr_is (r, "width"))
+		it->width = kicad_length ();
+	else if (sexpr_is (r, "stroke") || sexpr_is (r, "effects") || sexpr_is (r, "polygon"))
+		kicad_read_item (it);
+	else if (sexpr_is (r, "layer"))
+	{
+		if (sexpr_next (r) == SEXPR_ATOM || r->token == SEXPR_STRING)
+		{
+			it->layer = kicad_layer (r->text, r->len);
+			it->copper |= kicad_copper_mask (r->text, r->len);
+		}
+		if (r->token != SEXPR_CLOSE)
+			sexpr_skip (r);
+	}
+	else if (sexpr_is (r, "layers"))
+	{
+		while (sexpr_next (r) != SEXPR_CLOSE)
+		{
+			if (r->token == SEXPR_ATOM || r->token == SEXPR_STRING)
+			{
+				it->copper |= kicad_copper_mask (r->text, r->len);
+				if (kicad_name_ends (r->text, r->len, ".Paste"))
+					it->paste = true;
+			}
+			else if (r->token == SEXPR_OPEN)
+				sexpr_skip (r);
+			else
+			{
+				kicad_fail (_("unexpected end of file"));
+				break;
+			}
+		}
+	}
+	else if (sexpr_is (r, "size"))
+	{
+		n = kicad_numbers (v, 2);
+		if (n > 0)
+			it->size_x = it->size_y = KICAD_COORD (v[0]);
+		if (n > 1)
+			it->size_y = KICAD_COORD (v[1]);
+	}
+	else if (sexpr_is (r, "drill"))
+	{
+		/* (drill d), or (drill oval w h) for a slot, of which the
+		 * narrow side is kept */
+		n = kicad_numbers (v, 2);
+		if (n > 0)
+			it->drill = KICAD_COORD (n > 1 ? MIN (v[0], v[1]) : v[0]);
+	}
+	else if (sexpr_is (r, "clearance"))
+	{
+		it->clearance = kicad_length ();
+		it->has |= KICAD_HAS_CLEARANCE;
+	}
+	else if (sexpr_is (r, "solder_mask_margin"))
+	{
+		it->mask_margin = kicad_length ();
+		it->has |= KICAD_HAS_MASK;
+	}
+	else if (sexpr_is (r, "angle"))
+	{
+		if (kicad_numbers (v, 1))
+		{
+			it->angle = v[0];
+			it->has |= KICAD_HAS_ANGLE;
+		}
+	}
+	else if (sexpr_is (r, "net"))
+		kicad_read_net (it);
+	else if (sexpr_is (r, "pts"))
+		kicad_read_pts (it);
+	else if (sexpr_is (r, "hide"))
+		it->hide = kicad_yes ();
+	else if (sexpr_is (r, "keepout"))
+	{
+		it->keepout = true;
+		sexpr_skip (r);
+	}
+	else
+		sexpr_skip (r);
+}
+
+/*!
+ * \brief Read the rest of the list of an object.
+ *
+ * The lists we don't know, like (uuid) or (filled_polygon), are
+ * skipped; those holding fields of the object itself, like (stroke),
+ * are read into it.
+ */
+static void
+kicad_read_item (kicad_item* it)
+{
+	for (;;)
+	{
+		switch (sexpr_next (&kicad_in))
+		{
+			case SEXPR_CLOSE:
+				return;
+			case SEXPR_ATOM:
+			case SEXPR_STRING:
+				/* a bare hide after the name of a text, or in its effects */
+				if (it->atoms >= 2 && sexpr_is (&kicad_in, "hide"))
+					it->hide = true;
+				if (it->atoms < KICAD_ATOMS)
+				{
+					it->atom[it->atoms].text = kicad_in.text;
+					it->atom[it->atoms].len = kicad_in.len;
+				}
+				it->atoms++;
+				break;
+			case SEXPR_OPEN:
+				if (sexpr_next (&kicad_in) != SEXPR_ATOM)
+				{
+					kicad_fail (_("keyword expected"));
+					return;
+				}
+				kicad_read_field (it);
+				break;
+			default:
+				kicad_fail (_("unexpected end of file"));
+				return;
+		}
+		if (kicad_failed)
+			return;
+	}
+}
+
+/*!
+ * \brief The shape of the graphic whose keyword was read last.
+ */
+static int
+kicad_shape (void)
+{
+	const char* s = kicad_in.text;
+	kicad_atom a = { s, kicad_in.len };
+
+	if (a.len > 3 && (memcmp (s, "gr_", 3) == 0 || memcmp (s, "fp_", 3) == 0))
+	{
+		a.text += 3;
+		a.len -= 3;
+	}
+	if (kicad_atom_is (&a, "arc"))
+		return KICAD_ARC;
+	if (kicad_atom_is (&a, "circle"))
+		return KICAD_CIRCLE;
+	if (kicad_atom_is (&a, "rect"))
+		return KICAD_RECT;
+	if (kicad_atom_is (&a, "poly"))
+		return KICAD_POLY;
+	return KICAD_LINE;
+}
+
+/*!
+ * \brief Angle of the point (x, y) seen from (cx, cy), as PCB counts
+ * the angles of arcs.
+ */
+static Angle
+kicad_angle (double cx, double cy, double x, double y)
+{
+	return atan2 (y - cy, cx - x) * RAD_TO_DEG;
+}
+
+/*!
+ * \brief Find the circle through the start, mid and end points of an
+ * arc.
+ *
+ * \return false if the points are on a line.
+ */
+static bool
+kicad_arc_through (kicad_item* it, Coord* cx, Coord* cy, Coord* r,
+                   Angle* start, Angle* delta)
+{
+	double bx = it->mx - it->x1, by = it->my - it->y1;
+	double ex = it->x2 - it->x1, ey = it->y2 - it->y1;
+	double b2 = bx * bx + by * by, e2 = ex * ex + ey * ey;
+	double d = 2.0 * (bx * ey - by * ex);
+	double ux, uy, span, to_mid;
+
+	if (fabs (d) <= 2e-6 * sqrt (b2 * e2))
+		return false;
+	ux = (ey * b2 - by * e2) / d;
+	uy = (bx * e2 - ex * b2) / d;
+	*cx = it->x1 + floor (ux + 0.5);
+	*cy = it->y1 + floor (uy + 0.5);
+	*r = floor (sqrt (ux * ux + uy * uy) + 0.5);
+
+	*start = kicad_angle (ux, uy, 0, 0);
+	span = fmod (kicad_angle (ux, uy, ex, ey) - *start + 720.0, 360.0);
+	to_mid = fmod (kicad_angle (ux, uy, bx, by) - *start + 720.0, 360.0);
+	*delta = to_mid <= span ? span : span - 360.0;
+	return true;
+}
+
+static void
+kicad_add_line (LayerType* layer, ElementType* element, Coord x1, Coord y1,
+                Coord x2, Coord y2, Coord width, FlagType flags)
+{
+	if (element)
+		CreateNewLineInElement (element, x1, y1, x2, y2, width);
+	else
+		CreateNewLineOnLayer (layer, x1, y1, x2, y2, width, 2 * KICAD_CLEARANCE, flags);
+}
+
+static void
+kicad_add_arc (LayerType* layer, ElementType* element, Coord cx, Coord cy,
+               Coord r, Angle start, Angle delta, Coord width, FlagType flags)
+{
+	if (element)
+		CreateNewArcInElement (element, cx, cy, r, r, start, delta, width);
+	else
+		CreateNewArcOnLayer (layer, cx, cy, r, r, fmod (start + 360.0, 360.0),
+		                     delta, width, 2 * KICAD_CLEARANCE, flags);
+}
+
+/*!
+ * \brief Add a graphic or track to a layer, or to an element if one is
+ * given.
+ *
+ * Rectangles have been turned into polygons by now.
+ */
+static void
+kicad_add_shape (kicad_item* it, LayerType* layer, ElementType* element,
+                 FlagType flags)
+{
+	Coord width = it->width > 0 ? it->width : KICAD_LINE_WIDTH;
+	Coord cx, cy, r;
+	Angle start, delta;
+	guint i;
+
+	switch (it->kind)
+	{
+		case KICAD_ARC:
+			if ((it->has & (KICAD_HAS_START | KICAD_HAS_MID | KICAD_HAS_END))
+			    == (KICAD_HAS_START | KICAD_HAS_MID | KICAD_HAS_END))
+			{
+				if (kicad_arc_through (it, &cx, &cy, &r, &start, &delta))
+					kicad_add_arc (layer, element, cx, cy, r, start, delta, width, flags);
+				else
+					kicad_add_line (layer, element, it->x1, it->y1, it->x2, it->y2,
+					                width, flags);
+			}
+			else if ((it->has & (KICAD_HAS_START | KICAD_HAS_END | KICAD_HAS_ANGLE))
+			         == (KICAD_HAS_START | KICAD_HAS_END | KICAD_HAS_ANGLE))
+			{
+				/* The old form: the center, the point the arc starts at
+				 * and its angle, clockwise on the screen. */
+				r = floor (Distance (it->x1, it->y1, it->x2, it->y2) + 0.5);
+				start = kicad_angle (it->x1, it->y1, it->x2, it->y2);
+				kicad_add_arc (layer, element, it->x1, it->y1, r, start, -it->angle,
+				               width, flags);
+			}
+			break;
+
+		case KICAD_CIRCLE:
+			if ((it->has & (KICAD_HAS_CENTER | KICAD_HAS_END))
+			    == (KICAD_HAS_CENTER | KICAD_HAS_END))
+			{
+				r = floor (Distance (it->cx, it->cy, it->x2, it->y2) + 0.5);
+				kicad_add_arc (layer, element, it->cx, it->cy, r, 0, 360, width, flags);
+			}
+			break;
+
+		case KICAD_RECT:
+		case KICAD_POLY:
+			if (!it->pts || it->pts->len < 2)
+				break;
+			for (i = 0; i < it->pts->len; i++)
+			{
+				kicad_xy* p = &g_array_index (it->pts, kicad_xy, i);
+				kicad_xy* q = &g_array_index (it->pts, kicad_xy, (i + 1) % it->pts->len);
+
+				kicad_add_line (layer, element, p->x, p->y, q->x, q->y, width, flags);
+			}
+			break;
+
+		default:
+			if ((it->has & (KICAD_HAS_START | KICAD_HAS_END))
+			    == (KICAD_HAS_START | KICAD_HAS_END))
+				kicad_add_line (layer, element, it->x1, it->y1, it->x2, it->y2,
+				                width, flags);
+			break;
+	}
+}
+
+/*!
+ * \brief Turn the two corners of a rectangle into its outline.
+ */
+static void
+kicad_rect_to_poly (kicad_item* it)
+{
+	if ((it->has & (KICAD_HAS_START | KICAD_HAS_END))
+	    != (KICAD_HAS_START | KICAD_HAS_END))
+		return;
+	kicad_add_xy (it, it->x1, it->y1);
+	kicad_add_xy (it, it->x2, it->y1);
+	kicad_add_xy (it, it->x2, it->y2);
+	kicad_add_xy (it, it->x1, it->y2);
+}
+
+/*!
+ * \brief Add a polygon with the points of an item to a copper layer.
+ */
+static void
+kicad_add_polygon (kicad_item* it, LayerType* layer)
+{
+	PolygonType* polygon;
+	guint i;
+
+	if (!it->pts || it->pts->len < 3)
+		return;
+	polygon = CreateNewPolygon (layer, MakeFlags (CLEARPOLYFLAG));
+	for (i = 0; i < it->pts->len; i++)
+	{
+		kicad_xy* p = &g_array_index (it->pts, kicad_xy, i);
+
+		CreateNewPointInPolygon (polygon, p->x, p->y);
+	}
+	SetPolygonBoundingBox (polygon);
+	r_insert_entry (layer->polygon_tree, (BoxType*) polygon, 0);
+}
+
+/*!
+ * \brief Read a segment or arc track.
+ */
+static void
+kicad_read_track (int kind)
+{
+	kicad_item it;
+
+	kicad_item_init (&it);
+	it.kind = kind;
+	kicad_read_item (&it);
+	if (!kicad_failed && it.layer >= 0)
+		kicad_add_shape (&it, kicad_pcb_layer (it.layer), NULL,
+		                 MakeFlags (CLEARLINEFLAG));
+	kicad_item_free (&it);
+}
+
+/*!
+ * \brief Read a gr_line, gr_arc, gr_circle, gr_rect or gr_poly.
+ */
+static void
+kicad_read_graphic (int kind)
+{
+	LayerType* layer;
+	kicad_item it;
+
+	kicad_item_init (&it);
+	it.kind = kind;
+	kicad_read_item (&it);
+	layer = kicad_pcb_layer (it.layer);
+	if (!kicad_failed && layer)
+	{
+		if (kind == KICAD_RECT)
+			kicad_rect_to_poly (&it);
+		if (kind == KICAD_POLY && it.layer >= 0)
+			kicad_add_polygon (&it, layer);
+		else
+			kicad_add_shape (&it, layer, NULL,
+			                 it.layer >= 0 ? MakeFlags (CLEARLINEFLAG) : NoFlags ());
+	}
+	kicad_item_free (&it);
+}
+
+/*!
+ * \brief Read a via, one not going through all layers becomes a
+ * buried via.
+ */
+static void
+kicad_read_via (void)
+{
+	kicad_item it;
+	int from = 0, to = kicad_copper_n - 1;
+
+	kicad_item_init (&it);
+	kicad_read_item (&it);
+	if (kicad_failed)
+		return;
+
+	if (it.copper)
+	{
+		while (!(it.copper & (1u << from)))
+			from++;
+		while (!(it.copper & (1u << to)))
+			to--;
+	}
+	if (from == 0 && to == kicad_copper_n - 1)
+		CreateNewVia (kicad_pcb->Data, it.at_x, it.at_y, it.size_x,
+		              2 * KICAD_CLEARANCE, 0, it.drill, NULL, NoFlags ());
+	else
+		CreateNewViaEx (kicad_pcb->Data, it.at_x, it.at_y, it.size_x,
+		                2 * KICAD_CLEARANCE, 0, it.drill, NULL, NoFlags (), from, to);
+	kicad_item_free (&it);
+}
+
+/*!
+ * \brief Read a zone, its outline becomes a polygon on each of its
+ * copper layers.
+ */
+static void
+kicad_read_zone (void)
+{
+	kicad_item it;
+	int i;
+
+	kicad_item_init (&it);
+	kicad_read_item (&it);
+	if (!kicad_failed && !it.keepout)
+		for (i = 0; i < kicad_copper_n; i++)
+			if (it.copper & (1u << i))
+				kicad_add_polygon (&it, kicad_pcb_layer (i));
+	kicad_item_free (&it);
+}
+
+/*!
+ * \brief Read an entry (net number name) of the net table.
+ */
+static void
+kicad_read_net_name (void)
+{
+	kicad_item it;
+	double v;
+
+	kicad_item_init (&it);
+	kicad_read_item (&it);
+	if (kicad_failed || it.atoms < 2)
+		return;
+	if (!sexpr_text_number (it.atom[0].text, it.atom[0].len, &v)
+	    || v < 0 || v > G_MAXINT / 2)
+		return;
+	if ((guint) v >= kicad_net_names->len)
+		g_ptr_array_set_size (kicad_net_names, (guint) v + 1);
+	free (g_ptr_array_index (kicad_net_names, (guint) v));
+	g_ptr_array_index (kicad_net_names, (guint) v)
+		= sexpr_strdup (it.atom[1].text, it.atom[1].len);
+}
+
+/*!
+ * \brief The name of the net of an item, NULL if it has none.
+ *
+ * \return a malloc()ed string.
+ */
+static char*
+kicad_net_of (kicad_item* it)
+{
+	const char* name = NULL;
+
+	if (it->net_name.len)
+		return sexpr_strdup (it->net_name.text, it->net_name.len);
+	if (it->net > 0 && (guint) it->net < kicad_net_names->len)
+		name = g_ptr_array_index (kicad_net_names, it->net);
+	return name && *name ? strdup (name) : NULL;
+}
+
+/*!
+ * \brief Add the pin or pad number of element ref to a net of the
+ * netlist.
+ */
+static void
+kicad_connect (const char* net, const char* ref, const char* number)
+{
+	LibraryType* lib = &kicad_pcb->NetlistLib;
+	gpointer index = g_hash_table_lookup (kicad_net_menus, net);
+	char* conn;
+
+	if (!index)
+	{
+		CreateNewNet (lib, (char*) net, NULL);
+		index = GINT_TO_POINTER (lib->MenuN);
+		g_hash_table_insert (kicad_net_menus, strdup (net), index);
+	}
+	conn = Concat (ref, "-", number, NULL);
+	CreateNewConnection (&lib->Menu[GPOINTER_TO_INT (index) - 1], conn);
+	free (conn);
+}
+
+/*!
+ * \brief Position and rotation of a footprint.
+ */
+typedef struct
+{
+	Coord x, y;
+	double cosphi, sinphi;
+} kicad_place;
+
+static void
+kicad_place_init (kicad_place* place, Coord x, Coord y, double angle)
+{
+	double a = fmod (fmod (angle, 360.0) + 360.0, 360.0);
+
+	place->x = x;
+	place->y = y;
+	/* Keep the common rotations exact. */
+	if (a == 0.0 || a == 90.0 || a == 180.0 || a == 270.0)
+	{
+		int quarter = (int) (a / 90.0);
+		static const double c[4] = { 1.0, 0.0, -1.0, 0.0 };
+		static const double s[4] = { 0.0, 1.0, 0.0, -1.0 };
+
+		place->cosphi = c[quarter];
+		place->sinphi = s[quarter];
+	}
+	else
+	{
+		place->cosphi = cos (a * M_PI / 180.0);
+		place->sinphi = sin (a * M_PI / 180.0);
+	}
+}
+
+/*!
+ * \brief Move a point of a footprint to its place on the board.
+ *
+ * KiCad turns footprints counterclockwise on the screen.
+ */
+static void
+kicad_place_point (kicad_place* place, Coord* x, Coord* y)
+{
+	double lx = *x, ly = *y;
+
+	*x = place->x + floor (lx * place->cosphi + ly * place->sinphi + 0.5);
+	*y = place->y + floor (ly * place->cosphi - lx * place->sinphi + 0.5);
+}
+
+static void
+kicad_place_item (kicad_place* place, kicad_item* it)
+{
+	guint i;
+
+	kicad_place_point (place, &it->x1, &it->y1);
+	kicad_place_point (place, &it->x2, &it->y2);
+	kicad_place_point (place, &it->mx, &it->my);
+	kicad_place_point (place, &it->cx, &it->cy);
+	kicad_place_point (place, &it->at_x, &it->at_y);
+	if (it->pts)
+		for (i = 0; i < it->pts->len; i++)
+		{
+			kicad_xy* p = &g_array_index (it->pts, kicad_xy, i);
+
+			kicad_place_point (place, &p->x, &p->y);
+		}
+}
+
+/*!
+ * \brief Add a pad of a footprint to its element.
+ *
+ * SMD pads become PCB pads as long as the longer side of the KiCad pad,
+ * rectangles and the like with square ends.  Through hole pads become
+ * pins with the diameter of the narrower side, so oval pads don't make
+ * shorts.  The angles of KiCad pads are those on the board.
+ */
+static void
+kicad_add_pad (ElementType* element, kicad_item* pad, const char* ref)
+{
+	kicad_atom none = { "", 0 };
+	kicad_atom* type = pad->atoms > 1 ? &pad->atom[1] : &none;
+	kicad_atom* shape = pad->atoms > 2 ? &pad->atom[2] : &none;
+	Coord thick = MIN (pad->size_x, pad->size_y);
+	Coord clearance = 2 * (pad->has & KICAD_HAS_CLEARANCE ? pad->clearance : KICAD_CLEARANCE);
+	Coord margin = pad->has & KICAD_HAS_MASK ? pad->mask_margin : 0;
+	FlagType flags = NoFlags ();
+	char* number;
+	char* net;
+
+	if (pad->atoms < 1)
+		return;
+	number = sexpr_strdup (pad->atom[0].text, pad->atom[0].len);
+
+	if (kicad_atom_is (shape, "rect") || kicad_atom_is (shape, "roundrect")
+	    || kicad_atom_is (shape, "trapezoid"))
+		flags = AddFlags (flags, SQUAREFLAG);
+
+	if (kicad_atom_is (type, "np_thru_hole"))
+	{
+		Coord drill = pad->drill > 0 ? pad->drill : thick;
+
+		flags = MakeFlags (HOLEFLAG);
+		CreateNewPin (element, pad->at_x, pad->at_y, drill, clearance,
+		              MAX (drill + 2 * margin, 0), drill, number, number, flags);
+	}
+	else if (kicad_atom_is (type, "thru_hole"))
+		CreateNewPin (element, pad->at_x, pad->at_y, thick, clearance,
+		              MAX (thick + 2 * margin, 0), pad->drill, number, number, flags);
+	else
+	{
+		Coord half = (MAX (pad->size_x, pad->size_y) - thick) / 2;
+		double ux = pad->size_x >= pad->size_y ? 1.0 : 0.0, uy = 1.0 - ux;
+		double a = pad->at_angle * M_PI / 180.0;
+		double dx = ux * cos (a) + uy * sin (a);
+		double dy = uy * cos (a) - ux * sin (a);
+		Coord hx = floor (half * dx + 0.5), hy = floor (half * dy + 0.5);
+
+		if (!(pad->copper & 1u) && (pad->copper & (1u << (kicad_copper_n - 1))))
+			flags = AddFlags (flags, ONSOLDERFLAG);
+		if (!pad->paste)
+			flags = AddFlags (flags, NOPASTEFLAG);
+		CreateNewPad (element, pad->at_x - hx, pad->at_y - hy,
+		              pad->at_x + hx, pad->at_y + hy, thick, clearance,
+		              MAX (thick + 2 * margin, 0), number, number, flags);
+	}
+
+	net = kicad_net_of (pad);
+	if (net && ref)
+		kicad_connect (net, ref, number);
+	free (net);
+	free (number);
+}
+
+/*!
+ * \brief Read a footprint and make it an element.
+ *
+ * Its pads and graphics are collected first, as the names the element
+ * is made with may come after them.
+ */
+static void
+kicad_read_footprint (void)
+{
+	SexprReader* r = &kicad_in;
+	GArray* pads = g_array_new (FALSE, FALSE, sizeof (kicad_item));
+	GArray* shapes = g_array_new (FALSE, FALSE, sizeof (kicad_item));
+	kicad_item ref, value, it;
+	kicad_place place;
+	ElementType* element;
+	FlagType flags = NoFlags (), text_flags = NoFlags ();
+	char* description = NULL;
+	char* name = NULL;
+	char* value_text = NULL;
+	double v[3] = { 0.0, 0.0, 0.0 };
+	bool back = false;
+	int direction;
+	guint i;
+
+	kicad_item_init (&ref);
+	kicad_item_init (&value);
+	while (!kicad_failed)
+	{
+		sexpr_next (r);
+		if (r->token == SEXPR_CLOSE)
+			break;
+		if (r->token == SEXPR_ATOM || r->token == SEXPR_STRING)
+		{
+			/* the library name, then flags like locked */
+			if (!description)
+				description = sexpr_strdup (r->text, r->len);
+			continue;
+		}
+		if (r->token != SEXPR_OPEN || sexpr_next (r) != SEXPR_ATOM)
+		{
+			kicad_fail (_("keyword expected"));
+			break;
+		}
+
+		if (sexpr_is (r, "at"))
+			kicad_numbers (v, 3);
+		else if (sexpr_is (r, "layer"))
+		{
+			sexpr_next (r);
+			back = sexpr_is (r, "B.Cu");
+			if (r->token != SEXPR_CLOSE)
+				sexpr_skip (r);
+		}
+		else if (sexpr_is (r, "property") || sexpr_is (r, "fp_text"))
+		{
+			kicad_item_init (&it);
+			kicad_read_item (&it);
+			if (it.atoms >= 2 && (kicad_atom_is (&it.atom[0], "Reference")
+			                      || kicad_atom_is (&it.atom[0], "reference")))
+				ref = it;
+			else if (it.atoms >= 2 && (kicad_atom_is (&it.atom[0], "Value")
+			                           || kicad_atom_is (&it.atom[0], "value")))
+				value = it;
+			else
+				kicad_item_free (&it);
+		}
+		else if (sexpr_is (r, "pad"))
+		{
+			kicad_item_init (&it);
+			kicad_read_item (&it);
+			g_array_append_val (pads, it);
+		}
+		else if (r->len > 3 && memcmp (r->text, "fp_", 3) == 0
+		         && !sexpr_is (r, "fp_text"))
+		{
+			kicad_item_init (&it);
+			it.kind = kicad_shape ();
+			kicad_read_item (&it);
+			if (it.layer == KICAD_TOP_SILK || it.layer == KICAD_BOTTOM_SILK)
+				g_array_append_val (shapes, it);
+			else
+				kicad_item_free (&it);
+		}
+		else
+			sexpr_skip (r);
+	}
+
+	if (!kicad_failed)
+	{
+		kicad_place_init (&place, KICAD_COORD (v[0]), KICAD_COORD (v[1]), v[2]);
+		kicad_place_point (&place, &ref.at_x, &ref.at_y);
+
+		if (ref.atoms >= 2)
+			name = sexpr_strdup (ref.atom[1].text, ref.atom[1].len);
+		if (value.atoms >= 2)
+			value_text = sexpr_strdup (value.atom[1].text, value.atom[1].len);
+		if (back)
+		{
+			flags = AddFlags (flags, ONSOLDERFLAG);
+			text_flags = AddFlags (text_flags, ONSOLDERFLAG);
+		}
+		if (ref.hide)
+			flags = AddFlags (flags, HIDENAMEFLAG);
+		/* as the exporter writes the direction of the name */
+		direction = (int) floor ((back ? 180.0 - ref.at_angle : ref.at_angle) / 90.0 + 0.5);
+
+		element = CreateNewElement (kicad_pcb->Data, &kicad_pcb->Font, flags,
+		                            description, name, value_text,
+		                            ref.at_x, ref.at_y, direction & 3, 100,
+		                            text_flags, false);
+		element->MarkX = place.x;
+		element->MarkY = place.y;
+
+		for (i = 0; i < pads->len; i++)
+		{
+			kicad_item* pad = &g_array_index (pads, kicad_item, i);
+
+			kicad_place_item (&place, pad);
+			kicad_add_pad (element, pad, name);
+		}
+		for (i = 0; i < shapes->len; i++)
+		{
+			kicad_item* shape = &g_array_index (shapes, kicad_item, i);
+
+			if (shape->kind == KICAD_RECT)
+				kicad_rect_to_poly (shape);
+			kicad_place_item (&place, shape);
+			kicad_add_shape (shape, NULL, element, NoFlags ());
+		}
+		SetElementBoundingBox (kicad_pcb->Data, element, &kicad_pcb->Font);
+	}
+
+	for (i = 0; i < pads->len; i++)
+		kicad_item_free (&g_array_index (pads, kicad_item, i));
+	for (i = 0; i < shapes->len; i++)
+		kicad_item_free (&g_array_index (shapes, kicad_item, i));
+	g_array_free (pads, TRUE);
+	g_array_free (shapes, TRUE);
+	kicad_item_free (&ref);
+	kicad_item_free (&value);
+	free (description);
+	free (name);
+	free (value_text);
+}
+
+/*!
+ * \brief Read the layer table and set up the layers for its copper
+ * layers.
+ */
+static void
+kicad_read_layers (void)
+{
+	kicad_item it;
+	int copper = 0;
+
+	while (!kicad_failed && sexpr_next (&kicad_in) != SEXPR_CLOSE)
+	{
+		if (kicad_in.token != SEXPR_OPEN)
+		{
+			if (kicad_in.token == SEXPR_EOF || kicad_in.token == SEXPR_ERROR)
+				kicad_fail (_("unexpected end of file"));
+			continue;
+		}
+		/* (number name type [user name]) */
+		kicad_item_init (&it);
+		kicad_read_item (&it);
+		if (it.atoms >= 2 && kicad_name_ends (it.atom[1].text, it.atom[1].len, ".Cu"))
+			copper++;
+		kicad_item_free (&it);
+	}
+	if (!kicad_copper_n)
+		kicad_setup_layers (copper);
+}
+
+/*!
+ * \brief Read the title of the title block as the name of the board.
+ */
+static void
+kicad_read_title_block (void)
+{
+	SexprReader* r = &kicad_in;
+
+	while (!kicad_failed && sexpr_next (r) != SEXPR_CLOSE)
+	{
+		if (r->token != SEXPR_OPEN)
+		{
+			if (r->token == SEXPR_EOF || r->token == SEXPR_ERROR)
+				kicad_fail (_("unexpected end of file"));
+			continue;
+		}
+		sexpr_next (r);
+		if (sexpr_is (r, "title") && sexpr_next (r) == SEXPR_STRING)
+		{
+			free (kicad_pcb->Name);
+			kicad_pcb->Name = sexpr_strdup (r->text, r->len);
+		}
+		if (r->token != SEXPR_CLOSE)
+			sexpr_skip (r);
+	}
+}
+
+/*!
+ * \brief Read the lists of the kicad_pcb list.
+ */
+static void
+kicad_read_board (void)
+{
+	SexprReader* r = &kicad_in;
+
+	while (!kicad_failed)
+	{
+		sexpr_next (r);
+		if (r->token == SEXPR_CLOSE)
+			return;
+		if (r->token == SEXPR_ATOM || r->token == SEXPR_STRING)
+			continue;
+		if (r->token != SEXPR_OPEN || sexpr_next (r) != SEXPR_ATOM)
+		{
+			kicad_fail (r->token == SEXPR_EOF ? _("unexpected end of file")
+			                                  : _("keyword expected"));
+			return;
+		}
+
+		if (sexpr_is (r, "layers"))
+		{
+			kicad_read_layers ();
+			continue;
+		}
+		if (sexpr_is (r, "net"))
+		{
+			kicad_read_net_name ();
+			continue;
+		}
+		if (sexpr_is (r, "title_block"))
+		{
+			kicad_read_title_block ();
+			continue;
+		}
+
+		/* a board without a layer table has two copper layers */
+		if (!kicad_copper_n)
+			kicad_setup_layers (2);
+
+		if (sexpr_is (r, "segment"))
+			kicad_read_track (KICAD_LINE);
+		else if (sexpr_is (r, "arc"))
+			kicad_read_track (KICAD_ARC);
+		else if (sexpr_is (r, "via"))
+			kicad_read_via ();
+		else if (sexpr_is (r, "zone"))
+			kicad_read_zone ();
+		else if (sexpr_is (r, "footprint") || sexpr_is (r, "module"))
+			kicad_read_footprint ();
+		else if (r->len > 3 && memcmp (r->text, "gr_", 3) == 0
+		         && !sexpr_is (r, "gr_text"))
+			kicad_read_graphic (kicad_shape ());
+		else
+			sexpr_skip (r);
+	}
+}
+
+/*!
+ * \brief Read a KiCad board into pcb, for ImportPCB().
+ *
+ * \return 0 on success.
+ */
+static int
+kicad_parse_board (PCBType* pcb, char* filename)
+{
+	PCBType* pcb_save = PCB;
+	BoxType* box;
+
+	if (!sexpr_reader_open (&kicad_in, filename))
+	{
+		Message (_("Can't open %s for reading\n"), filename);
+		return 1;
+	}
+	kicad_in_name = filename;
+	kicad_failed = false;
+	kicad_pcb = pcb;
+	kicad_copper_n = 0;
+	kicad_net_names = g_ptr_array_new_with_free_func (free);
+	kicad_net_menus = g_hash_table_new_full (g_str_hash, g_str_equal, free, NULL);
+
+	PCB = pcb;
+	CreateBeLenient (true);
+	if (sexpr_next (&kicad_in) != SEXPR_OPEN || sexpr_next (&kicad_in) != SEXPR_ATOM
+	    || !sexpr_is (&kicad_in, "kicad_pcb"))
+		kicad_fail (_("not a KiCad board"));
+	else
+		kicad_read_board ();
+	if (!kicad_copper_n)
+		kicad_setup_layers (2);
+	r_resume_inserts ();
+	CreateBeLenient (false);
+
+	if (!kicad_failed)
+	{
+		/* the same margin right and below as left and above */
+		box = GetDataBoundingBox (pcb->Data);
+		if (box)
+		{
+			if (box->X1 < 0 || box->Y1 < 0)
+				Message (_("%s: some objects are left or above the board\n"), filename);
+			pcb->MaxWidth = box->X2 + MAX (box->X1, 0);
+			pcb->MaxHeight = box->Y2 + MAX (box->Y1, 0);
+		}
+		pcb->Font.Valid = true;
+		if (!BoardCacheRestore (pcb->Data))
+			InitClipAll (pcb->Data);
+	}
+	PCB = pcb_save;
+
+	g_ptr_array_free (kicad_net_names, TRUE);
+	g_hash_table_destroy (kicad_net_menus);
+	sexpr_reader_close (&kicad_in);
+	return kicad_failed ? 1 : 0;
+}
+
+/* --------------------------------------------------------------------------- */
+
+static const char loadkicadfrom_syntax[] = N_("LoadKicadFrom([filename])");
+
+static const char loadkicadfrom_help[] =
+	N_("Import a KiCad board, replacing the current layout.");
+
+/* %start-doc actions LoadKicadFrom
+
+Reads a @file{.kicad_pcb} file as a new layout.  The layout is named
+like the file with a @file{.pcb} suffix, saving it doesn't touch the
+KiCad file.  If no filename is given, one is prompted for.
+
+Copper layers, tracks, vias, zone outlines, footprints with their pads
+and silk, the board outline and the nets of the pads are imported.
+Texts, dimensions and zone fills are not.
+
+%end-doc */
+
+static int
+ActionLoadKicadFrom (int argc, char **argv, Coord x, Coord y)
+{
+	char* name = ARG (0);
+
+	if (!name)
+		name = gui->fileselect (_("Import KiCad board"),
+		                        _("Choose a KiCad board to import"),
+		                        NULL, ".kicad_pcb", "kicad", HID_FILESELECT_READ);
+	if (!name)
+		return 1;
+
+	if (!PCB->Changed || gui->confirm_dialog (_("OK to override layout data?"), 0))
+		ImportPCB (name, kicad_parse_board);
+	return 0;
+}
+
+HID_Action kicad_import_action_list[] = {
+	{"LoadKicadFrom", 0, ActionLoadKicadFrom, loadkicadfrom_help, loadkicadfrom_syntax}
+};
+
+REGISTER_ACTIONS (kicad_import_action_list)
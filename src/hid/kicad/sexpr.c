@@ -0,0 +1,514 @@
+/*!
+ * \file src/hid/kicad/sexpr.c
+ *
+ * \brief Buffered S-expression output and input for the KiCad exporter
+ * and importer.
+ *
+ * The exporter writes hundreds of small tokens per object.  Going
+ * through stdio formatting for each of them dominates the export time of
+ * large boards, so this layer keeps the output in a large user-space
+ * buffer and formats numbers itself.
+ *
+ * Numbers are written exactly as printf ("%f") would write them, so the
+ * output is byte-identical to the plain fprintf based exporter:
+ * - Coord values are nanometres, so converted to millimetres they have at
+ *   most 6 decimals and are written from integer arithmetic.
+ * - doubles are scaled and rounded; values too close to a rounding tie
+ *   for the scaled product to be trusted fall back to snprintf.
+ *
+ * The reader maps the file into memory and returns its tokens as slices
+ * of the mapping, nothing is copied unless the caller asks for a string.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "global.h"
+#include "sexpr.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+/*!
+ * \brief Open a writer flushing to fp.
+ */
+void
+sexpr_open (SexprWriter* w, FILE* fp)
+{
+	w->fp = fp;
+	w->size = SEXPR_BUFFER_SIZE;
+	w->buf = malloc (w->size);
+	w->len = 0;
+	w->written = 0;
+	w->error = false;
+}
+
+/*!
+ * \brief Open a writer collecting its output in memory.
+ */
+void
+sexpr_open_memory (SexprWriter* w)
+{
+	w->fp = NULL;
+	w->size = 4096;
+	w->buf = malloc (w->size);
+	w->len = 0;
+	w->written = 0;
+	w->error = false;
+}
+
+/*!
+ * \brief Write the pending output of a file backed writer.
+ *
+ * \return false if any write failed so far.
+ */
+bool
+sexpr_flush (SexprWriter* w)
+{
+	if (w->fp && w->len)
+	{
+		if (fwrite (w->buf, 1, w->len, w->fp) != w->len)
+			w->error = true;
+		w->len = 0;
+	}
+	return !w->error;
+}
+
+/*!
+ * \brief Flush and release the buffer of a writer.
+ *
+ * The FILE of a file backed writer is left open.
+ */
+bool
+sexpr_close (SexprWriter* w)
+{
+	bool ok = sexpr_flush (w);
+
+	free (w->buf);
+	w->buf = NULL;
+	w->len = w->size = 0;
+	return ok;
+}
+
+/*!
+ * \brief Make room for n more bytes.
+ */
+static void
+sexpr_reserve (SexprWriter* w, size_t n)
+{
+	if (w->len + n <= w->size)
+		return;
+
+	if (w->fp)
+	{
+		sexpr_flush (w);
+		if (n <= w->size)
+			return;
+	}
+
+	while (w->len + n > w->size)
+		w->size *= 2;
+	w->buf = realloc (w->buf, w->size);
+}
+
+void
+sexpr_write (SexprWriter* w, const char* s, size_t n)
+{
+	if (w->fp && n > w->size)
+	{
+		/* Too big to be worth buffering. */
+		sexpr_flush (w);
+		if (fwrite (s, 1, n, w->fp) != n)
+			w->error = true;
+	}
+	else
+	{
+		sexpr_reserve (w, n);
+		memcpy (w->buf + w->len, s, n);
+		w->len += n;
+	}
+	w->written += n;
+}
+
+void
+sexpr_puts (SexprWriter* w, const char* s)
+{
+	sexpr_write (w, s, strlen (s));
+}
+
+void
+sexpr_putc (SexprWriter* w, char c)
+{
+	sexpr_reserve (w, 1);
+	w->buf[w->len++] = c;
+	w->written++;
+}
+
+/*!
+ * \brief Write u as a decimal number, optionally with a fixed number of
+ * decimals taken from its lowest digits.
+ */
+static void
+sexpr_unsigned (SexprWriter* w, bool negative, unsigned long long u, int decimals)
+{
+	char tmp[32];
+	char* p = tmp + sizeof (tmp);
+	int i;
+
+	for (i = 0; i < decimals; i++)
+	{
+		*--p = '0' + (u % 10);
+		u /= 10;
+	}
+	if (decimals)
+		*--p = '.';
+	do
+	{
+		*--p = '0' + (u % 10);
+		u /= 10;
+	}
+	while (u);
+	if (negative)
+		*--p = '-';
+
+	sexpr_write (w, p, tmp + sizeof (tmp) - p);
+}
+
+void
+sexpr_int (SexprWriter* w, long v)
+{
+	if (v < 0)
+		sexpr_unsigned (w, true, -(unsigned long long) v, 0);
+	else
+		sexpr_unsigned (w, false, v, 0);
+}
+
+/*!
+ * \brief Write v like printf ("%f") does.
+ *
+ * For |v| < 1e6 the scaled product v * 1e6 is off from the exact value
+ * by less than 2.5e-4, so unless its fraction is within 1e-3 of .5 it
+ * rounds to the same integer as the exact binary value does.
+ */
+void
+sexpr_double (SexprWriter* w, double v)
+{
+	double a = fabs (v);
+	double s, r, frac;
+
+	if (a < 1.0e6)
+	{
+		s = a * 1.0e6;
+		r = floor (s);
+		frac = s - r;
+		if (fabs (frac - 0.5) > 1.0e-3)
+		{
+			if (frac > 0.5)
+				r += 1.0;
+			sexpr_unsigned (w, signbit (v) != 0, (unsigned long long) r, 6);
+			return;
+		}
+	}
+
+	{
+		char tmp[512];
+		int n = snprintf (tmp, sizeof (tmp), "%f", v);
+		sexpr_write (w, tmp, MIN (n, (int) sizeof (tmp) - 1));
+	}
+}
+
+/*!
+ * \brief Write COORD_TO_MM (c) like printf ("%f") does, using only
+ * integer arithmetic.
+ */
+void
+sexpr_coord_mm (SexprWriter* w, Coord c)
+{
+	if (c < 0)
+		sexpr_unsigned (w, true, -(unsigned long long) c, 6);
+	else
+		sexpr_unsigned (w, false, c, 6);
+}
+
+/*!
+ * \brief Minimal printf for the output templates.
+ *
+ * Understands %s, %d, %f (double), %M (Coord, written in mm) and %%.
+ * No flags, widths or precisions are supported.
+ */
+void
+sexpr_printf (SexprWriter* w, const char* fmt, ...)
+{
+	va_list ap;
+	const char* run = fmt;
+	const char* p;
+
+	va_start (ap, fmt);
+	for (p = fmt; *p; p++)
+	{
+		if (*p != '%')
+			continue;
+
+		sexpr_write (w, run, p - run);
+		p++;
+		switch (*p)
+		{
+			case 's':
+				{
+					const char* s = va_arg (ap, const char*);
+					sexpr_puts (w, s ? s : "(null)");
+				}
+				break;
+			case 'd':
+				sexpr_int (w, va_arg (ap, int));
+				break;
+			case 'f':
+				sexpr_double (w, va_arg (ap, double));
+				break;
+			case 'M':
+				sexpr_coord_mm (w, va_arg (ap, Coord));
+				break;
+			case '%':
+				sexpr_putc (w, '%');
+				break;
+			default:
+				/* Unknown conversion, copy it through. */
+				sexpr_putc (w, '%');
+				if (!*p)
+					p--;
+				else
+					sexpr_putc (w, *p);
+				break;
+		}
+		run = p + 1;
+	}
+	sexpr_write (w, run, p - run);
+	va_end (ap);
+}
+
+/*!
+ * \brief Open a reader on a file.
+ *
+ * \return false if the file can't be mapped.
+ */
+bool
+sexpr_reader_open (SexprReader* r, const char* filename)
+{
+	memset (r, 0, sizeof (SexprReader));
+	r->map = g_mapped_file_new (filename, FALSE, NULL);
+	if (r->map == NULL)
+		return false;
+
+	r->pos = g_mapped_file_get_contents (r->map);
+	r->end = r->pos + g_mapped_file_get_length (r->map);
+	if (r->pos == NULL)
+		r->pos = r->end = "";
+	r->line = 1;
+	return true;
+}
+
+void
+sexpr_reader_close (SexprReader* r)
+{
+	if (r->map)
+		g_mapped_file_unref (r->map);
+	r->map = NULL;
+	r->pos = r->end = NULL;
+}
+
+/*!
+ * \brief Read the next token.
+ *
+ * Atoms and strings are left in text and len, strings without their
+ * quotes and with their escapes still in place.  A string without its
+ * closing quote is an error.
+ */
+SexprToken
+sexpr_next (SexprReader* r)
+{
+	const char* p = r->pos;
+
+	while (p < r->end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+	{
+		if (*p == '\n')
+			r->line++;
+		p++;
+	}
+
+	r->text = p;
+	r->len = 0;
+	if (p >= r->end)
+		r->token = SEXPR_EOF;
+	else if (*p == '(')
+	{
+		r->token = SEXPR_OPEN;
+		p++;
+	}
+	else if (*p == ')')
+	{
+		r->token = SEXPR_CLOSE;
+		p++;
+	}
+	else if (*p == '"')
+	{
+		r->text = ++p;
+		while (p < r->end && *p != '"')
+		{
+			if (*p == '\\' && p + 1 < r->end)
+				p++;
+			else if (*p == '\n')
+				r->line++;
+			p++;
+		}
+		if (p >= r->end)
+			r->token = SEXPR_ERROR;
+		else
+		{
+			r->token = SEXPR_STRING;
+			r->len = p++ - r->text;
+		}
+	}
+	else
+	{
+		while (p < r->end && *p != ' ' && *p != '\t' && *p != '\r'
+		       && *p != '\n' && *p != '(' && *p != ')' && *p != '"')
+			p++;
+		r->token = SEXPR_ATOM;
+		r->len = p - r->text;
+	}
+	r->pos = p;
+	return r->token;
+}
+
+/*!
+ * \brief Skip the rest of the list whose opening parenthesis was read
+ * last, up to and including its closing one.
+ */
+void
+sexpr_skip (SexprReader* r)
+{
+	int depth = 1;
+
+	while (depth > 0)
+	{
+		switch (sexpr_next (r))
+		{
+			case SEXPR_OPEN:
+				depth++;
+				break;
+			case SEXPR_CLOSE:
+				depth--;
+				break;
+			case SEXPR_EOF:
+			case SEXPR_ERROR:
+				return;
+			default:
+				break;
+		}
+	}
+}
+
+/*!
+ * \brief Whether the last token is the atom or string s.
+ */
+bool
+sexpr_is (SexprReader* r, const char* s)
+{
+	return (r->token == SEXPR_ATOM || r->token == SEXPR_STRING)
+	       && strlen (s) == r->len && memcmp (r->text, s, r->len) == 0;
+}
+
+/*!
+ * \brief Convert the text of a token to a number.
+ *
+ * \return false if it isn't one.
+ */
+bool
+sexpr_text_number (const char* text, size_t len, double* v)
+{
+	char buf[SEXPR_NUMBER_MAX];
+	char* end;
+
+	if (len == 0 || len >= sizeof (buf))
+		return false;
+	memcpy (buf, text, len);
+	buf[len] = '\0';
+	*v = g_ascii_strtod (buf, &end);
+	return *end == '\0';
+}
+
+/*!
+ * \brief Convert the last token to a number.
+ *
+ * \return false if it isn't one.
+ */
+bool
+sexpr_number (SexprReader* r, double* v)
+{
+	return r->token == SEXPR_ATOM && sexpr_text_number (r->text, r->len, v);
+}
+
+/*!
+ * \brief A malloc()ed copy of the text of a token, with the escapes of a
+ * string resolved.
+ */
+char*
+sexpr_strdup (const char* text, size_t len)
+{
+	char* s = malloc (len + 1);
+	char* q = s;
+	const char* p;
+
+	for (p = text; p < text + len; p++)
+	{
+		if (*p == '\\' && p + 1 < text + len)
+		{
+			switch (*++p)
+			{
+				case 'n':
+					*q++ = '\n';
+					break;
+				case 't':
+					*q++ = '\t';
+					break;
+				default:
+					*q++ = *p;
+					break;
+			}
+		}
+		else
+			*q++ = *p;
+	}
+	*q = '\0';
+	return s;
+}
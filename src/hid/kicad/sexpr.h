@@ -0,0 +1,107 @@
+/*!
+ * \file src/hid/kicad/sexpr.h
+ *
+ * \brief Buffered S-expression output for the KiCad exporter.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef PCB_HID_KICAD_SEXPR_H
+#define PCB_HID_KICAD_SEXPR_H
+
+#include <stdio.h>
+#include "global.h"
+
+/*!
+ * \brief Size of the user-space buffer of a file backed writer.
+ */
+#define SEXPR_BUFFER_SIZE (256 * 1024)
+
+/*!
+ * \brief An output stream for S-expression text.
+ *
+ * A writer either collects the text in a growing memory buffer
+ * (fp == NULL) or flushes a fixed size buffer to fp whenever it fills up.
+ */
+typedef struct
+{
+	FILE* fp;       /*!< Destination, NULL for a memory writer. */
+	char* buf;      /*!< Pending (or, for memory writers, all) output. */
+	size_t len;     /*!< Bytes used in buf. */
+	size_t size;    /*!< Bytes allocated for buf. */
+	size_t written; /*!< Total bytes produced so far. */
+	bool error;     /*!< A write to fp failed. */
+} SexprWriter;
+
+void sexpr_open (SexprWriter* w, FILE* fp);
+void sexpr_open_memory (SexprWriter* w);
+bool sexpr_flush (SexprWriter* w);
+bool sexpr_close (SexprWriter* w);
+
+void sexpr_write (SexprWriter* w, const char* s, size_t n);
+void sexpr_puts (SexprWriter* w, const char* s);
+void sexpr_putc (SexprWriter* w, char c);
+void sexpr_int (SexprWriter* w, long v);
+void sexpr_double (SexprWriter* w, double v);
+void sexpr_coord_mm (SexprWriter* w, Coord c);
+void sexpr_printf (SexprWriter* w, const char* fmt, ...);
+
+/*!
+ * \brief Longest number token sexpr_number() converts.
+ */
+#define SEXPR_NUMBER_MAX 64
+
+typedef enum
+{
+	SEXPR_EOF,
+	SEXPR_OPEN,
+	SEXPR_CLOSE,
+	SEXPR_ATOM,
+	SEXPR_STRING,
+	SEXPR_ERROR
+} SexprToken;
+
+/*!
+ * \brief An input stream of S-expression tokens from a mapped file.
+ */
+typedef struct
+{
+	GMappedFile* map;  /*!< The file. */
+	const char* pos;   /*!< Next character to read. */
+	const char* end;   /*!< End of the file. */
+	int line;          /*!< Line of pos, for messages. */
+	SexprToken token;  /*!< Type of the last token. */
+	const char* text;  /*!< Its text, in the mapping, not terminated. */
+	size_t len;        /*!< Length of text. */
+} SexprReader;
+
+bool sexpr_reader_open (SexprReader* r, const char* filename);
+void sexpr_reader_close (SexprReader* r);
+SexprToken sexpr_next (SexprReader* r);
+void sexpr_skip (SexprReader* r);
+bool sexpr_is (SexprReader* r, const char* s);
+bool sexpr_text_number (const char* text, size_t len, double* v);
+bool sexpr_number (SexprReader* r, double* v);
+char* sexpr_strdup (const char* text, size_t len);
+
+#endif
@@ -14,6 +14,7 @@
 #include "data.h"
 #include "crosshair.h"
 #include "misc.h"
+#include "mymem.h"
 #include "pcb-printf.h"
 
 #include "hid.h"
@@ -1993,10 +1994,8 @@ lesstif_attributes_dialog (char *owner, AttributeListType *attrs_list)
       /* Copy the values back */
       for (i=0; i<attributes_list->Number; i++)
 	{
-	  if (attributes_list->List[i].name)
-	    free (attributes_list->List[i].name);
-	  if (attributes_list->List[i].value)
-	    free (attributes_list->List[i].value);
+	  ReleaseString (attributes_list->List[i].name);
+	  ReleaseString (attributes_list->List[i].value);
 	}
       if (attributes_list->Max < attr_num_rows)
 	{
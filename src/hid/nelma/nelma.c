@@ -77,6 +77,8 @@
 
 #include <gd.h>
 
+#include "hid/common/rasterband.h"
+
 #include "hid/common/hidinit.h"
 
 #ifdef HAVE_LIBDMALLOC
@@ -116,6 +118,19 @@ static gdImagePtr lastbrush = (gdImagePtr)((void *) -1);
 static gdImagePtr nelma_im = NULL;
 static FILE    *nelma_f = NULL;
 
+/*
+ * Rows of the layer masks drawn at a time, 0 for the whole mask.  In a
+ * band, nelma_im holds the rows from nelma_band_top on.
+ */
+static int      nelma_band_rows = 0;
+static int      nelma_band_top = 0;
+#ifdef HAVE_RASTER_BANDS
+static RasterBandStream *nelma_band = NULL;
+#endif
+
+/* Number of layer masks drawn at once by worker processes. */
+static int      nelma_jobs = 1;
+
 static int      is_mask;
 static int      is_drill;
 
@@ -206,6 +221,33 @@ Substrate relative epsilon.
 	{"substrate-epsilon", "Substrate relative epsilon",
 	HID_Real, 0, 100, {0, 0, 4.0}, 0, 0},
 #define HA_substratee 4
+
+/* %start-doc options "94 Nelma Options"
+@ftable @code
+@item --band-rows <num>
+Rows of a layer mask drawn at a time.  Only one band of rows is held in
+memory, and written to the PNG file before the next is drawn, so that
+the masks of large boards fit in memory.  The default value is
+@code{0}, which draws each mask whole.
+@end ftable
+%end-doc
+*/
+	{"band-rows", "Rows of a layer mask drawn at a time, 0 for all",
+	HID_Integer, 0, 100000, {0, 0, 0}, 0, 0},
+#define HA_bandrows 5
+
+/* %start-doc options "94 Nelma Options"
+@ftable @code
+@item --jobs <num>
+Number of layer masks drawn at once, each by a worker process with a
+copy of the board.  The default value is @code{1}, which draws them one
+after the other in pcb itself.
+@end ftable
+%end-doc
+*/
+	{"jobs", "Number of layer masks drawn at once",
+	HID_Integer, 1, 64, {1, 0, 0}, 0, 0},
+#define HA_jobs 6
 };
 
 #define NUM_OPTIONS (sizeof(nelma_attribute_list)/sizeof(nelma_attribute_list[0]))
@@ -221,6 +263,9 @@ static int pcb_to_nelma (Coord pcb)
   return COORD_TO_INCH(pcb) * nelma_dpi;
 }
 
+/* row of nelma_im, in the band being drawn */
+#define NELMA_Y(y) (pcb_to_nelma(y) - nelma_band_top)
+
 static char    *
 nelma_get_png_name(const char *basename, const char *suffix)
 {
@@ -608,8 +653,18 @@ nelma_start_png(const char *basename, const char *suffix)
 	/* nelma_im = gdImageCreate (w, h); */
 
 	/* Nelma only works with true color images */
-	nelma_im = gdImageCreate(w, h);
 	nelma_f = fopen(buf, "wb");
+#ifdef HAVE_RASTER_BANDS
+	if (nelma_band_rows > 0 && nelma_f) {
+		/* the colours of the bands come from a one pixel image */
+		nelma_im = gdImageCreate(1, 1);
+		nelma_alloc_colors();
+		nelma_band = raster_band_open(nelma_f, w, h, nelma_im);
+		free(buf);
+		return;
+	}
+#endif
+	nelma_im = gdImageCreate(w, h);
 
 	nelma_alloc_colors();
 
@@ -619,13 +674,22 @@ nelma_start_png(const char *basename, const char *suffix)
 static void 
 nelma_finish_png()
 {
+#ifdef HAVE_RASTER_BANDS
+	if (nelma_band) {
+		if (!raster_band_close(nelma_band))
+			Message("NELMA: Can't write layer mask.\n");
+		nelma_band = NULL;
+	} else
+#endif
 #ifdef HAVE_GDIMAGEPNG
-	gdImagePng(nelma_im, nelma_f);
+	if (nelma_f)
+		gdImagePng(nelma_im, nelma_f);
 #else
 	Message("NELMA: PNG not supported by gd. Can't write layer mask.\n");
 #endif
 	gdImageDestroy(nelma_im);
-	fclose(nelma_f);
+	if (nelma_f)
+		fclose(nelma_f);
 
 	free(white);
 	free(black);
@@ -647,14 +711,61 @@ nelma_start_png_export()
 	linewidth = -1;
 	lastbrush = (gdImagePtr)((void *) -1);
 
+#ifdef HAVE_RASTER_BANDS
+	if (nelma_band) {
+		gdImagePtr      palette = nelma_im;
+		int             h = pcb_to_nelma(PCB->MaxHeight);
+		Coord           pixel = INCH_TO_COORD(1.0) / nelma_dpi;
+
+		/* draw what reaches into each band, a pixel around it */
+		for (nelma_band_top = 0; nelma_band_top < h;
+		     nelma_band_top += nelma_band_rows) {
+			nelma_im = raster_band_image(nelma_band, nelma_band_top,
+						     nelma_band_rows);
+			region.Y1 = nelma_band_top * pixel - pixel;
+			region.Y2 = (nelma_band_top + nelma_band_rows) * pixel
+				+ pixel;
+			linewidth = -1;
+			lastbrush = (gdImagePtr)((void *) -1);
+			hid_expose_callback(&nelma_hid, &region, 0);
+			raster_band_write(nelma_band, nelma_im);
+			gdImageDestroy(nelma_im);
+		}
+		nelma_band_top = 0;
+		nelma_im = palette;
+		return;
+	}
+#endif
 	hid_expose_callback(&nelma_hid, &region, 0);
 }
 
+/* Write the PNG layer mask of a group. */
+static void
+nelma_write_group(int i)
+{
+	int             save_ons[MAX_ALL_LAYER];
+	int             idx;
+
+	nelma_cur_group = i;
+
+	/* magic */
+	idx = (i >= 0 && i < max_group) ?
+		PCB->LayerGroups.Entries[i][0] : i;
+
+	nelma_start_png(nelma_basename,
+			layer_type_to_file_name(idx, FNS_fixed));
+
+	hid_save_and_show_layer_ons(save_ons);
+	nelma_start_png_export();
+	hid_restore_layer_ons(save_ons);
+
+	nelma_finish_png();
+}
+
 static void 
 nelma_do_export(HID_Attr_Val * options)
 {
-	int             save_ons[MAX_ALL_LAYER];
-	int             i, idx;
+	int             i;
 	FILE           *nelma_config;
 	char           *buf;
 	int             len;
@@ -680,28 +791,18 @@ nelma_do_export(HID_Attr_Val * options)
 	nelma_copperh = options[HA_copperh].int_value;
 	nelma_substrateh = options[HA_substrateh].int_value;
 	nelma_substratee = options[HA_substratee].real_value;
+	nelma_band_rows = options[HA_bandrows].int_value;
+	nelma_jobs = options[HA_jobs].int_value;
+#ifndef HAVE_RASTER_BANDS
+	if (nelma_band_rows > 0)
+		Message("NELMA: pcb was built without zlib, drawing the layer "
+			"masks whole.\n");
+#endif
 
 	nelma_choose_groups();
 
-	for (i = 0; i < MAX_GROUP; i++) {
-		if (nelma_export_group[i]) {
-
-			nelma_cur_group = i;
-
-			/* magic */
-			idx = (i >= 0 && i < max_group) ?
-				PCB->LayerGroups.Entries[i][0] : i;
-
-			nelma_start_png(nelma_basename,
-					layer_type_to_file_name(idx, FNS_fixed));
-
-			hid_save_and_show_layer_ons(save_ons);
-			nelma_start_png_export();
-			hid_restore_layer_ons(save_ons);
-
-			nelma_finish_png();
-		}
-	}
+	raster_run_layers(nelma_export_group, nelma_jobs, -1,
+			  nelma_write_group);
 
 	len = strlen(nelma_basename) + 4;
 	buf = (char *)malloc(sizeof(*buf) * len);
@@ -914,8 +1015,8 @@ nelma_draw_rect(hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 {
 	use_gc(gc);
 	gdImageRectangle(nelma_im,
-			 pcb_to_nelma(x1), pcb_to_nelma(y1),
-			 pcb_to_nelma(x2), pcb_to_nelma(y2), gc->color->c);
+			 pcb_to_nelma(x1), NELMA_Y(y1),
+			 pcb_to_nelma(x2), NELMA_Y(y2), gc->color->c);
 }
 
 static void
@@ -924,8 +1025,8 @@ nelma_fill_rect(hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 	use_gc(gc);
 	gdImageSetThickness(nelma_im, 0);
 	linewidth = 0;
-	gdImageFilledRectangle(nelma_im, pcb_to_nelma(x1), pcb_to_nelma(y1),
-			  pcb_to_nelma(x2), pcb_to_nelma(y2), gc->color->c);
+	gdImageFilledRectangle(nelma_im, pcb_to_nelma(x1), NELMA_Y(y1),
+			  pcb_to_nelma(x2), NELMA_Y(y2), gc->color->c);
 }
 
 static void
@@ -940,8 +1041,8 @@ nelma_draw_line(hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 
 	gdImageSetThickness(nelma_im, 0);
 	linewidth = 0;
-	gdImageLine(nelma_im, pcb_to_nelma(x1), pcb_to_nelma(y1),
-		    pcb_to_nelma(x2), pcb_to_nelma(y2), gdBrushed);
+	gdImageLine(nelma_im, pcb_to_nelma(x1), NELMA_Y(y1),
+		    pcb_to_nelma(x2), NELMA_Y(y2), gdBrushed);
 }
 
 static void
@@ -981,7 +1082,7 @@ nelma_draw_arc(hidGC gc, Coord cx, Coord cy, Coord width, Coord height,
 	use_gc(gc);
 	gdImageSetThickness(nelma_im, 0);
 	linewidth = 0;
-	gdImageArc(nelma_im, pcb_to_nelma(cx), pcb_to_nelma(cy),
+	gdImageArc(nelma_im, pcb_to_nelma(cx), NELMA_Y(cy),
 		   pcb_to_nelma(2 * width), pcb_to_nelma(2 * height), sa, ea, gdBrushed);
 }
 
@@ -992,7 +1093,7 @@ nelma_fill_circle(hidGC gc, Coord cx, Coord cy, Coord radius)
 
 	gdImageSetThickness(nelma_im, 0);
 	linewidth = 0;
-	gdImageFilledEllipse(nelma_im, pcb_to_nelma(cx), pcb_to_nelma(cy),
+	gdImageFilledEllipse(nelma_im, pcb_to_nelma(cx), NELMA_Y(cy),
 	  pcb_to_nelma(2 * radius), pcb_to_nelma(2 * radius), gc->color->c);
 
 }
@@ -1011,7 +1112,7 @@ nelma_fill_polygon(hidGC gc, int n_coords, Coord *x, Coord *y)
 	use_gc(gc);
 	for (i = 0; i < n_coords; i++) {
 		points[i].x = pcb_to_nelma(x[i]);
-		points[i].y = pcb_to_nelma(y[i]);
+		points[i].y = NELMA_Y(y[i]);
 	}
 	gdImageSetThickness(nelma_im, 0);
 	linewidth = 0;
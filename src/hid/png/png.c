@@ -53,6 +53,19 @@
 /* the gd library which makes this all so easy */
 #include <gd.h>
 
+#ifdef ENABLE_PNG_GL
+/* The Linux OpenGL ABI 1.0 spec requires that we define
+ * GL_GLEXT_PROTOTYPES before including gl.h or glx.h for extensions
+ * in order to get prototypes:
+ *   http://www.opengl.org/registry/ABI/
+ */
+#define GL_GLEXT_PROTOTYPES 1
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GL/gl.h>
+#include "hid/common/hidgl.h"
+#endif
+
 #include "hid/common/hidinit.h"
 
 #ifdef HAVE_LIBDMALLOC
@@ -66,6 +79,7 @@ static HID_DRAW png_graphics;
 
 static void *color_cache = NULL;
 static void *brush_cache = NULL;
+static GHashTable *circle_stamps = NULL;
 
 static double bloat = 0;
 static double scale = 1;
@@ -138,6 +152,11 @@ static int photo_has_inners;
 
 static int doing_outline, have_outline;
 
+#ifdef ENABLE_PNG_GL
+/* set while the image is drawn with OpenGL, see png_gl_begin () */
+static int gl_mode;
+#endif
+
 #define FMT_gif "GIF"
 #define FMT_jpg "JPEG"
 #define FMT_png "PNG"
@@ -458,6 +477,20 @@ In photo-realistic mode, export the silk screen as this colour. Parameter
   {"ben-flip-y", ATTR_UNDOCUMENTED,
    HID_Boolean, 0, 0, {0, 0, 0}, 0, 0},
 #define HA_ben_flip_y 14
+
+/* %start-doc options "93 PNG Options"
+@ftable @code
+@item --png-gl
+Draw the image with OpenGL in an offscreen buffer instead of with the gd
+library.  This needs pcb to be built with @code{--enable-png-gl}, and
+is not used in photo mode.  If OpenGL cannot be had, the image is drawn
+as without this option.
+@end ftable
+%end-doc
+*/
+  {"png-gl", "Draw the image with OpenGL (not in photo mode)",
+   HID_Boolean, 0, 0, {0, 0, 0}, 0, 0},
+#define HA_gl 21
 };
 
 #define NUM_OPTIONS (sizeof(png_attribute_list)/sizeof(png_attribute_list[0]))
@@ -545,6 +578,287 @@ parse_bloat (const char *str)
   bloat = GetValueEx (str, NULL, NULL, extra_units, "");
 }
 
+#ifdef ENABLE_PNG_GL
+/* ---------------------------------------------------------------------------
+ * Drawing with OpenGL.
+ *
+ * With --png-gl the image is drawn by the hidgl primitives of the GTK
+ * HID into an offscreen EGL pbuffer, a tile of at most PNG_GL_TILE
+ * pixels square at a time, and each tile is read back into a true
+ * colour gd image that is written instead of the palette image.
+ */
+#define PNG_GL_TILE 2048
+
+static EGLDisplay gl_display = EGL_NO_DISPLAY;
+static EGLSurface gl_surface = EGL_NO_SURFACE;
+static EGLContext gl_context = EGL_NO_CONTEXT;
+static int gl_tile_w, gl_tile_h;
+/* the image drawn, and its pixels as read back from a tile */
+static gdImagePtr gl_im = NULL;
+static GLubyte *gl_pixels = NULL;
+/* the colour set in OpenGL */
+static color_struct *gl_color;
+/* the mask drawn into the stencil buffer, see png_gl_use_mask () */
+static int gl_mask_bit, gl_mask_drawing;
+static color_struct *gl_mask_color;
+static BoxType gl_tile_region;
+
+static EGLDisplay
+png_gl_display (void)
+{
+  EGLDisplay display = eglGetDisplay (EGL_DEFAULT_DISPLAY);
+
+  if (display != EGL_NO_DISPLAY && eglInitialize (display, NULL, NULL))
+    return display;
+
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+  {
+    /* without a window system, Mesa can still draw without one */
+    const char *extensions = eglQueryString (EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display;
+
+    if (extensions == NULL
+	|| strstr (extensions, "EGL_MESA_platform_surfaceless") == NULL)
+      return EGL_NO_DISPLAY;
+    get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+      eglGetProcAddress ("eglGetPlatformDisplayEXT");
+    if (get_platform_display == NULL)
+      return EGL_NO_DISPLAY;
+    display = get_platform_display (EGL_PLATFORM_SURFACELESS_MESA,
+				    EGL_DEFAULT_DISPLAY, NULL);
+    if (display != EGL_NO_DISPLAY && eglInitialize (display, NULL, NULL))
+      return display;
+  }
+#endif
+  return EGL_NO_DISPLAY;
+}
+
+static void png_gl_end (void);
+
+/*!
+ * \brief Make the OpenGL context and pbuffer to draw an image of the
+ * given size with.
+ *
+ * \return false, with a message, if OpenGL cannot be had.
+ */
+static bool
+png_gl_begin (int w, int h, int use_alpha)
+{
+  static const EGLint config_attribs[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+    EGL_STENCIL_SIZE, 8,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_NONE
+  };
+  EGLint pbuffer_attribs[] = { EGL_WIDTH, 0, EGL_HEIGHT, 0, EGL_NONE };
+  EGLConfig config;
+  EGLint n;
+  const char *failed = NULL;
+
+  gl_tile_w = MIN (w, PNG_GL_TILE);
+  gl_tile_h = MIN (h, PNG_GL_TILE);
+  pbuffer_attribs[1] = gl_tile_w;
+  pbuffer_attribs[3] = gl_tile_h;
+
+  gl_display = png_gl_display ();
+  if (gl_display == EGL_NO_DISPLAY)
+    failed = "no EGL display";
+  else if (!eglBindAPI (EGL_OPENGL_API)
+	   || !eglChooseConfig (gl_display, config_attribs, &config, 1, &n)
+	   || n == 0)
+    failed = "no EGL configuration with a pbuffer and a stencil buffer";
+  else if ((gl_surface = eglCreatePbufferSurface (gl_display, config,
+						  pbuffer_attribs))
+	   == EGL_NO_SURFACE)
+    failed = "cannot make the pbuffer";
+  else if ((gl_context = eglCreateContext (gl_display, config,
+					   EGL_NO_CONTEXT, NULL))
+	   == EGL_NO_CONTEXT
+	   || !eglMakeCurrent (gl_display, gl_surface, gl_surface,
+			       gl_context))
+    failed = "cannot make the OpenGL context";
+  else if ((gl_im = gdImageCreateTrueColor (w, h)) == NULL)
+    failed = "cannot make the image";
+
+  if (failed)
+    {
+      Message (_("png: cannot draw with OpenGL (%s), "
+		 "drawing without it.\n"), failed);
+      png_gl_end ();
+      return false;
+    }
+
+  gdImageAlphaBlending (gl_im, 0);
+  gdImageSaveAlpha (gl_im, use_alpha);
+  gl_pixels = (GLubyte *) malloc (4 * gl_tile_w * gl_tile_h);
+  hidgl_start_render ();
+  gl_mode = 1;
+  return true;
+}
+
+static void
+png_gl_end (void)
+{
+  if (gl_mode)
+    hidgl_finish_render ();
+  gl_mode = 0;
+  free (gl_pixels);
+  gl_pixels = NULL;
+  if (gl_display != EGL_NO_DISPLAY)
+    {
+      eglMakeCurrent (gl_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+		      EGL_NO_CONTEXT);
+      if (gl_context != EGL_NO_CONTEXT)
+	eglDestroyContext (gl_display, gl_context);
+      if (gl_surface != EGL_NO_SURFACE)
+	eglDestroySurface (gl_display, gl_surface);
+      eglTerminate (gl_display);
+    }
+  gl_display = EGL_NO_DISPLAY;
+  gl_surface = EGL_NO_SURFACE;
+  gl_context = EGL_NO_CONTEXT;
+}
+
+/*!
+ * \brief Draw the board one tile at a time, and read each into gl_im.
+ *
+ * A pixel is where SCALE_X () and SCALE_Y () put its centre, as in the
+ * image drawn with gd.  The board is moved by a little less than half a
+ * pixel for that, so that a box from (x1, y1) to (x2, y2) covers the
+ * same pixels as png_fill_rect () with gd.
+ */
+static void
+png_gl_expose (void)
+{
+  int w = gdImageSX (gl_im), h = gdImageSY (gl_im);
+  int tx, ty, x, y;
+  Coord y1, y2, margin = scale + MAX (bloat, 0);
+  GLubyte *p;
+
+  glPixelStorei (GL_PACK_ALIGNMENT, 1);
+  glViewport (0, 0, gl_tile_w, gl_tile_h);
+  glDisable (GL_BLEND);
+
+  for (ty = 0; ty < h; ty += gl_tile_h)
+    for (tx = 0; tx < w; tx += gl_tile_w)
+      {
+	glMatrixMode (GL_PROJECTION);
+	glLoadIdentity ();
+	glOrtho (tx, tx + gl_tile_w, ty + gl_tile_h, ty, -100000, 100000);
+	glMatrixMode (GL_MODELVIEW);
+	glLoadIdentity ();
+	glTranslatef (0.5 - 1. / 64, 0.5 - 1. / 64, 0);
+	glScaled (1. / scale, (show_bottom_side ? -1. : 1.) / scale, 1.);
+	glTranslated (-x_shift,
+		      show_bottom_side ? y_shift - PCB->MaxHeight : -y_shift,
+		      0);
+
+	/* the background, as transparent as the white of the gd image */
+	glClearColor (1., 1., 1., white->a ? 0. : 1.);
+	glClearStencil (0);
+	glStencilMask (~0);
+	glClear (GL_COLOR_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+	glStencilMask (0);
+	hidgl_reset_stencil_usage ();
+	gl_color = NULL;
+
+	gl_tile_region.X1 = x_shift + tx * scale - margin;
+	gl_tile_region.X2 = x_shift + (tx + gl_tile_w) * scale + margin;
+	y1 = y_shift + ty * scale - margin;
+	y2 = y_shift + (ty + gl_tile_h) * scale + margin;
+	gl_tile_region.Y1 = show_bottom_side ? PCB->MaxHeight - y2 : y1;
+	gl_tile_region.Y2 = show_bottom_side ? PCB->MaxHeight - y1 : y2;
+
+	hid_expose_callback (&png_hid, &gl_tile_region, 0);
+	hidgl_flush_triangles (&buffer);
+
+	glReadPixels (0, 0, gl_tile_w, gl_tile_h, GL_RGBA, GL_UNSIGNED_BYTE,
+		      gl_pixels);
+	for (y = 0; y < gl_tile_h && ty + y < h; y++)
+	  {
+	    /* the rows are read from the bottom up */
+	    p = gl_pixels + 4 * (gl_tile_h - 1 - y) * gl_tile_w;
+	    for (x = 0; x < gl_tile_w && tx + x < w; x++, p += 4)
+	      gdImageSetPixel (gl_im, tx + x, ty + y,
+			       gdTrueColorAlpha (p[0], p[1], p[2],
+						 (255 - p[3]) / 2));
+	  }
+      }
+}
+
+static void
+png_gl_use_gc (hidGC gc)
+{
+  if (gl_mask_drawing)
+    gl_mask_color = gc->color;
+  if (gc->color == gl_color)
+    return;
+  hidgl_flush_triangles (&buffer);
+  gl_color = gc->color;
+  glColor4ub (gc->color->r, gc->color->g, gc->color->b,
+	      gc->color == white && white->a ? 0 : 255);
+}
+
+/*!
+ * \brief Draw a mask in the stencil buffer.
+ *
+ * What is drawn before HID_MASK_CLEAR sets the bit of the mask, what is
+ * drawn after clears it, and at HID_MASK_OFF the mask is filled in with
+ * the last colour drawn in it.  That is all draw.c needs for the solder
+ * mask, which is the only mask drawn.
+ */
+static void
+png_gl_use_mask (enum mask_mode mode)
+{
+  hidgl_flush_triangles (&buffer);
+
+  switch (mode)
+    {
+    case HID_MASK_BEFORE:
+    case HID_MASK_AFTER:
+      if (gl_mask_bit == 0)
+	gl_mask_bit = hidgl_assign_clear_stencil_bit ();
+      glColorMask (0, 0, 0, 0);
+      glEnable (GL_STENCIL_TEST);
+      glStencilMask (gl_mask_bit);
+      glStencilFunc (GL_ALWAYS, gl_mask_bit, gl_mask_bit);
+      glStencilOp (GL_KEEP, GL_KEEP, GL_REPLACE);
+      gl_mask_drawing = 1;
+      break;
+
+    case HID_MASK_CLEAR:
+      if (gl_mask_bit == 0)
+	return;
+      glStencilFunc (GL_ALWAYS, 0, gl_mask_bit);
+      gl_mask_drawing = 0;
+      break;
+
+    case HID_MASK_OFF:
+      if (gl_mask_bit == 0)
+	return;
+      gl_mask_drawing = 0;
+      glColorMask (1, 1, 1, 1);
+      glStencilMask (0);
+      glStencilFunc (GL_EQUAL, gl_mask_bit, gl_mask_bit);
+      glStencilOp (GL_KEEP, GL_KEEP, GL_KEEP);
+      if (gl_mask_color)
+	{
+	  gl_color = NULL;
+	  glColor3ub (gl_mask_color->r, gl_mask_color->g, gl_mask_color->b);
+	  hidgl_fill_rect (gl_tile_region.X1, gl_tile_region.Y1,
+			   gl_tile_region.X2, gl_tile_region.Y2);
+	  hidgl_flush_triangles (&buffer);
+	}
+      glDisable (GL_STENCIL_TEST);
+      hidgl_return_stencil_bit (gl_mask_bit);
+      gl_mask_bit = 0;
+      gl_mask_color = NULL;
+      break;
+    }
+}
+#endif
+
 void
 png_hid_export_to_file (FILE * the_file, HID_Attr_Val * options)
 {
@@ -658,6 +972,11 @@ png_hid_export_to_file (FILE * the_file, HID_Attr_Val * options)
 	}
     }
 
+#ifdef ENABLE_PNG_GL
+  if (gl_mode)
+    png_gl_expose ();
+  else
+#endif
   hid_expose_callback (&png_hid, bounds, 0);
 
   memcpy (LayerStack, saved_layer_stack, sizeof (LayerStack));
@@ -787,48 +1106,275 @@ static int shadows[5][5] = {
 #define TOP_SHADOW 2
 #define BOTTOM_SHADOW 3
 
+/*!
+ * \brief Rows of a photo mode image, for a job of photo_in_bands().
+ */
+typedef struct photo_band
+{
+  int y1, y2;
+} photo_band;
+
+#define PHOTO_BAND_ROWS 32
+
+/* held while a band looks up a colour of the image */
+static GMutex photo_palette_lock;
+
+/*!
+ * \brief Run a job on each band of rows of the image, on as many threads
+ * as there are processors.
+ *
+ * The job gets the band and the data.  The jobs must only write the
+ * pixels of their own band.
+ */
 static void
-ts_bs (gdImagePtr im)
+photo_in_bands (GFunc job, gpointer data)
 {
-  int x, y, sx, sy, si;
-  for (x=0; x<gdImageSX(im); x++)
-    for (y=0; y<gdImageSY(im); y++)
-      {
-	si = 0;
-	for (sx=-2; sx<3; sx++)
-	  for (sy=-2; sy<3; sy++)
-	    if (!gdImageGetPixel (im, x+sx, y+sy))
-	      si += shadows[sx+2][sy+2];
-	if (gdImageGetPixel (im, x, y))
-	  {
-	    if (si > 1)
-	      gdImageSetPixel (im, x, y, TOP_SHADOW);
-	    else if (si < -1)
-	      gdImageSetPixel (im, x, y, BOTTOM_SHADOW);
-	  }
-      }
+  int n = (gdImageSY (im) + PHOTO_BAND_ROWS - 1) / PHOTO_BAND_ROWS;
+  photo_band *bands = (photo_band *) malloc (n * sizeof (*bands));
+  GThreadPool *pool =
+    g_thread_pool_new (job, data, MAX (1, g_get_num_processors ()), FALSE,
+		       NULL);
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      bands[i].y1 = i * PHOTO_BAND_ROWS;
+      bands[i].y2 = MIN (gdImageSY (im), bands[i].y1 + PHOTO_BAND_ROWS);
+      if (pool)
+	g_thread_pool_push (pool, &bands[i], NULL);
+      else
+	job (&bands[i], data);
+    }
+  if (pool)
+    g_thread_pool_free (pool, FALSE, TRUE);
+  free (bands);
 }
 
+/*!
+ * \brief Shade the edges of the objects in a band of a photo mode layer.
+ *
+ * A set pixel becomes a top or bottom shadow by the weights of the clear
+ * pixels within r of it, pixels off the image counting as clear.  Only
+ * set pixels are changed, to other set values, so which pixels are clear
+ * does not depend on the order of the bands.
+ *
+ * The layers are palette images, read and written straight through
+ * their rows.
+ */
 static void
-ts_bs_sm (gdImagePtr im)
+shade_band (gdImagePtr im, photo_band *b, int r, const int *weights)
 {
+  int n = 2 * r + 1;
+  int w = gdImageSX (im), h = gdImageSY (im);
   int x, y, sx, sy, si;
-  for (x=0; x<gdImageSX(im); x++)
-    for (y=0; y<gdImageSY(im); y++)
-      {
-	si = 0;
-	for (sx=-1; sx<2; sx++)
-	  for (sy=-1; sy<2; sy++)
-	    if (!gdImageGetPixel (im, x+sx, y+sy))
-	      si += smshadows[sx+1][sy+1];
-	if (gdImageGetPixel (im, x, y))
-	  {
-	    if (si > 1)
-	      gdImageSetPixel (im, x, y, TOP_SHADOW);
-	    else if (si < -1)
-	      gdImageSetPixel (im, x, y, BOTTOM_SHADOW);
+
+  for (y = b->y1; y < b->y2; y++)
+    {
+      unsigned char *row = im->pixels[y];
+
+      for (x = 0; x < w; x++)
+	{
+	  if (!row[x])
+	    continue;
+	  si = 0;
+	  if (x >= r && x < w - r && y >= r && y < h - r)
+	    {
+	      for (sy = -r; sy <= r; sy++)
+		{
+		  unsigned char *p = im->pixels[y + sy] + x;
+
+		  for (sx = -r; sx <= r; sx++)
+		    if (!p[sx])
+		      si += weights[(sx + r) * n + sy + r];
+		}
+	    }
+	  else
+	    for (sy = -r; sy <= r; sy++)
+	      for (sx = -r; sx <= r; sx++)
+		if (x + sx < 0 || x + sx >= w || y + sy < 0 || y + sy >= h
+		    || !gdImagePalettePixel (im, x + sx, y + sy))
+		  si += weights[(sx + r) * n + sy + r];
+	  if (si > 1)
+	    row[x] = TOP_SHADOW;
+	  else if (si < -1)
+	    row[x] = BOTTOM_SHADOW;
+	}
+    }
+}
+
+static void
+ts_bs (gpointer band, gpointer image)
+{
+  shade_band ((gdImagePtr) image, (photo_band *) band, 2, &shadows[0][0]);
+}
+
+static void
+ts_bs_sm (gpointer band, gpointer image)
+{
+  shade_band ((gdImagePtr) image, (photo_band *) band, 1, &smshadows[0][0]);
+}
+
+/*!
+ * \brief Put together the photo mode layers of a band into the image.
+ *
+ * The layers and the image are all palette images of the same size.
+ */
+static void
+photo_composite (gpointer band, gpointer data)
+{
+  HID_Attr_Val *options = (HID_Attr_Val *) data;
+  photo_band *b = (photo_band *) band;
+  color_struct white, black, fr4, last;
+  int x, y, last_transparent = 0, last_cc = 0;
+  bool have_last = false;
+
+  rgb (&white, 255, 255, 255);
+  rgb (&black, 0, 0, 0);
+  rgb (&fr4, 70, 70, 70);
+
+  for (y = b->y1; y < b->y2; y++)
+    {
+      for (x = 0; x < gdImageSX (im); x++)
+	{
+	  color_struct p, cop;
+	  color_struct mask_colour, silk_colour;
+	  int cc, mask, silk;
+	  int transparent;
+	     
+	  if (photo_outline && have_outline) {
+	    transparent=gdImagePalettePixel(photo_outline, x, y);             
+	  } else {
+	    transparent=0;
 	  }
-      }
+
+	  mask = photo_mask ? gdImagePalettePixel (photo_mask, x, y) : 0;
+	  silk = photo_silk ? gdImagePalettePixel (photo_silk, x, y) : 0;
+
+	  if (photo_copper[photo_groups[1]]
+	      && gdImagePalettePixel (photo_copper[photo_groups[1]], x, y))
+	    rgb (&cop, 40, 40, 40);
+	  else
+	    rgb (&cop, 100, 100, 110);
+
+	  if (photo_ngroups == 2)
+	    blend (&cop, 0.3, &cop, &fr4);
+	      
+	  if (photo_copper[photo_groups[0]])
+	    cc = gdImagePalettePixel (photo_copper[photo_groups[0]], x, y);
+	  else
+	    cc = 0;
+
+	  if (cc)
+	    {
+	      int r;
+		  
+	      if (mask)
+		rgb (&cop, 220, 145, 230);
+	      else
+		{
+		  if (options[HA_photo_plating].int_value == PLATING_GOLD)
+		    {
+		      // ENIG
+		      rgb (&cop, 185, 146, 52);
+
+		      // increase top shadow to increase shininess
+		      if (cc == TOP_SHADOW)
+			blend (&cop, 0.7, &cop, &white);
+		    }
+		  else if (options[HA_photo_plating].int_value == PLATING_TIN)
+		    {
+		      // tinned
+		      rgb (&cop, 140, 150, 160);
+
+		      // add some variation to make it look more matte
+		      r = (rand() % 5 - 2) * 2;
+		      cop.r += r;
+		      cop.g += r;
+		      cop.b += r;
+		    }
+		  else if (options[HA_photo_plating].int_value == PLATING_SILVER)
+		    {
+		      // silver
+		      rgb (&cop, 192, 192, 185);
+
+		      // increase top shadow to increase shininess
+		      if (cc == TOP_SHADOW)
+			blend (&cop, 0.7, &cop, &white);
+		    }
+		  else if (options[HA_photo_plating].int_value == PLATING_COPPER)
+		    {
+		      // copper
+		      rgb (&cop, 184, 115, 51);
+
+		      // increase top shadow to increase shininess
+		      if (cc == TOP_SHADOW)
+			blend (&cop, 0.7, &cop, &white);
+		    }
+		}
+		  
+	      if (cc == TOP_SHADOW)
+		blend (&cop, 0.7, &cop, &white);
+	      if (cc == BOTTOM_SHADOW)
+		blend (&cop, 0.7, &cop, &black);
+	    }
+
+	  if (photo_drill && !gdImagePalettePixel (photo_drill, x, y)) 
+	    {               
+	      rgb (&p, 0, 0, 0);
+	      transparent=1;
+	    }
+	  else if (silk)
+	    {
+	      silk_colour = silk_colours[options[HA_photo_silk_colour].int_value];
+	      blend (&p, 1.0, &silk_colour, &silk_colour);
+	      if (silk == TOP_SHADOW)
+		add (&p, 1.0, &p, 1.0, &silk_top_shadow);
+	      else if (silk == BOTTOM_SHADOW)
+		subtract (&p, 1.0, &p, 1.0, &silk_bottom_shadow);
+	    }
+	  else if (mask)
+	    {
+	      p = cop;
+	      mask_colour = mask_colours[options[HA_photo_mask_colour].int_value];
+	      multiply (&p, &p, &mask_colour);
+	      add (&p, 1, &p, 0.2, &mask_colour);
+	      if (mask == TOP_SHADOW)
+		blend (&p, 0.7, &p, &white);
+	      if (mask == BOTTOM_SHADOW)
+		blend (&p, 0.7, &p, &black);
+	    }
+	  else
+	    p = cop;
+	      
+	  if (transparent)
+	    rgb (&p, 0, 0, 0);
+	  /* the palette of the image is shared by the bands */
+	  if (!have_last || transparent != last_transparent
+	      || p.r != last.r || p.g != last.g || p.b != last.b)
+	    {
+	      g_mutex_lock (&photo_palette_lock);
+	      if (options[HA_use_alpha].int_value)
+		cc = gdImageColorResolveAlpha (im, p.r, p.g, p.b,
+					       transparent ? 127 : 0);
+	      else
+		cc = gdImageColorResolve (im, p.r, p.g, p.b);
+	      g_mutex_unlock (&photo_palette_lock);
+	      have_last = true;
+	      last = p;
+	      last_transparent = transparent;
+	      last_cc = cc;
+	    }
+	  else
+	    cc = last_cc;
+
+	  if (photo_flip == PHOTO_FLIP_X)
+	    gdImagePalettePixel (im, gdImageSX (im) - x - 1, y) = cc;
+	  else if (photo_flip == PHOTO_FLIP_Y)
+	    gdImagePalettePixel (im, x, gdImageSY (im) - y - 1) = cc;
+	  else
+	    gdImagePalettePixel (im, x, y) = cc;
+	}
+    }
 }
 
 static void
@@ -855,6 +1401,12 @@ png_do_export (HID_Attr_Val * options)
       brush_cache = NULL;
     }
 
+  if (circle_stamps)
+    {
+      g_hash_table_destroy (circle_stamps);
+      circle_stamps = NULL;
+    }
+
   if (!options)
     {
       png_get_export_options (0);
@@ -1037,28 +1589,42 @@ png_do_export (HID_Attr_Val * options)
   if (!options[HA_as_shown].int_value)
     hid_save_and_show_layer_ons (save_ons);
 
+#ifdef ENABLE_PNG_GL
+  if (options[HA_gl].int_value && !photo_mode)
+    png_gl_begin (w, h, options[HA_use_alpha].int_value);
+#else
+  if (options[HA_gl].int_value)
+    Message (_("png: pcb was built without --enable-png-gl, "
+	       "drawing without OpenGL.\n"));
+#endif
+
   png_hid_export_to_file (f, options);
 
+#ifdef ENABLE_PNG_GL
+  if (gl_mode)
+    {
+      png_gl_end ();
+      gdImageDestroy (im);
+      im = master_im = gl_im;
+      gl_im = NULL;
+    }
+#endif
+
   if (!options[HA_as_shown].int_value)
     hid_restore_layer_ons (save_ons);
 
   if (photo_mode)
     {
       int x, y;
-      color_struct white, black, fr4;
-
-      rgb (&white, 255, 255, 255);
-      rgb (&black, 0, 0, 0);
-      rgb (&fr4, 70, 70, 70);
 
       im = master_im;
 
       if (photo_copper[photo_groups[0]])
-        ts_bs (photo_copper[photo_groups[0]]);
+        photo_in_bands (ts_bs, photo_copper[photo_groups[0]]);
       if (photo_silk)
-        ts_bs (photo_silk);
+        photo_in_bands (ts_bs, photo_silk);
       if (photo_mask)
-        ts_bs_sm (photo_mask);
+        photo_in_bands (ts_bs_sm, photo_mask);
 
       if (photo_outline && have_outline) {
 	int black=gdImageColorResolve(photo_outline, 0x00, 0x00, 0x00);
@@ -1076,140 +1642,7 @@ png_do_export (HID_Attr_Val * options)
       }
 
 
-      for (x=0; x<gdImageSX (im); x++) 
-	{
-	  for (y=0; y<gdImageSY (im); y++)
-	    {
-	      color_struct p, cop;
-	      color_struct mask_colour, silk_colour;
-	      int cc, mask, silk;
-	      int transparent;
-	     
-	      if (photo_outline && have_outline) {
-		transparent=gdImageGetPixel(photo_outline, x, y);	      
-	      } else {
-		transparent=0;
-	      }
-
-	      mask = photo_mask ? gdImageGetPixel (photo_mask, x, y) : 0;
-	      silk = photo_silk ? gdImageGetPixel (photo_silk, x, y) : 0;
-
-	      if (photo_copper[photo_groups[1]]
-		  && gdImageGetPixel (photo_copper[photo_groups[1]], x, y))
-		rgb (&cop, 40, 40, 40);
-	      else
-		rgb (&cop, 100, 100, 110);
-
-	      if (photo_ngroups == 2)
-		blend (&cop, 0.3, &cop, &fr4);
-	      
-              if (photo_copper[photo_groups[0]])
-                cc = gdImageGetPixel (photo_copper[photo_groups[0]], x, y);
-              else
-                cc = 0;
-
-	      if (cc)
-		{
-		  int r;
-		  
-		  if (mask)
-		    rgb (&cop, 220, 145, 230);
-		  else
-		    {
-		      if (options[HA_photo_plating].int_value == PLATING_GOLD)
-			{
-			  // ENIG
-			  rgb (&cop, 185, 146, 52);
-
-			  // increase top shadow to increase shininess
-			  if (cc == TOP_SHADOW)
-			    blend (&cop, 0.7, &cop, &white);
-			}
-		      else if (options[HA_photo_plating].int_value == PLATING_TIN)
-			{
-			  // tinned
-			  rgb (&cop, 140, 150, 160);
-
-			  // add some variation to make it look more matte
-			  r = (rand() % 5 - 2) * 2;
-			  cop.r += r;
-			  cop.g += r;
-			  cop.b += r;
-			}
-		      else if (options[HA_photo_plating].int_value == PLATING_SILVER)
-			{
-			  // silver
-			  rgb (&cop, 192, 192, 185);
-
-			  // increase top shadow to increase shininess
-			  if (cc == TOP_SHADOW)
-			    blend (&cop, 0.7, &cop, &white);
-			}
-		      else if (options[HA_photo_plating].int_value == PLATING_COPPER)
-			{
-			  // copper
-			  rgb (&cop, 184, 115, 51);
-
-			  // increase top shadow to increase shininess
-			  if (cc == TOP_SHADOW)
-			    blend (&cop, 0.7, &cop, &white);
-			}
-		    }
-		  
-		  if (cc == TOP_SHADOW)
-		    blend (&cop, 0.7, &cop, &white);
-		  if (cc == BOTTOM_SHADOW)
-		    blend (&cop, 0.7, &cop, &black);
-		}
-
-	      if (photo_drill && !gdImageGetPixel (photo_drill, x, y)) 
-		{		
-		  rgb (&p, 0, 0, 0);
-		  transparent=1;
-		}
-	      else if (silk)
-		{
-		  silk_colour = silk_colours[options[HA_photo_silk_colour].int_value];
-		  blend (&p, 1.0, &silk_colour, &silk_colour);
-		  if (silk == TOP_SHADOW)
-		    add (&p, 1.0, &p, 1.0, &silk_top_shadow);
-		  else if (silk == BOTTOM_SHADOW)
-		    subtract (&p, 1.0, &p, 1.0, &silk_bottom_shadow);
-		}
-	      else if (mask)
-		{
-		  p = cop;
-		  mask_colour = mask_colours[options[HA_photo_mask_colour].int_value];
-		  multiply (&p, &p, &mask_colour);
-		  add (&p, 1, &p, 0.2, &mask_colour);
-		  if (mask == TOP_SHADOW)
-		    blend (&p, 0.7, &p, &white);
-		  if (mask == BOTTOM_SHADOW)
-		    blend (&p, 0.7, &p, &black);
-		}
-	      else
-		p = cop;
-	      
-	      if (options[HA_use_alpha].int_value) {
-
-		cc = (transparent)?\
-		  gdImageColorResolveAlpha(im, 0, 0, 0, 127):\
-		  gdImageColorResolveAlpha(im, p.r, p.g, p.b, 0);
-
-	      } else {
-		cc = (transparent)?\
-		  gdImageColorResolve(im, 0, 0, 0):\
-		  gdImageColorResolve(im, p.r, p.g, p.b);
-	      }		  
-
-	      if (photo_flip == PHOTO_FLIP_X)
-		gdImageSetPixel (im, gdImageSX (im) - x - 1, y, cc);
-	      else if (photo_flip == PHOTO_FLIP_Y)
-		gdImageSetPixel (im, x, gdImageSY (im) - y - 1, cc);
-	      else
-		gdImageSetPixel (im, x, y, cc);
-	    }
-	}
+      photo_in_bands (photo_composite, options);
     }
 
   /* actually write out the image */
@@ -1444,6 +1877,14 @@ png_use_mask (enum mask_mode mode)
   if (photo_mode)
     return;
 
+#ifdef ENABLE_PNG_GL
+  if (gl_mode)
+    {
+      png_gl_use_mask (mode);
+      return;
+    }
+#endif
+
   if (mode == HID_MASK_CLEAR)
     {
       return;
@@ -1667,6 +2108,15 @@ use_gc (hidGC gc)
 static void
 png_draw_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 {
+#ifdef ENABLE_PNG_GL
+  if (gl_mode)
+    {
+      png_gl_use_gc (gc);
+      hidgl_flush_triangles (&buffer);
+      hidgl_draw_rect (x1, y1, x2, y2);
+      return;
+    }
+#endif
   use_gc (gc);
   gdImageRectangle (im,
 		    SCALE_X (x1), SCALE_Y (y1),
@@ -1676,6 +2126,14 @@ png_draw_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 static void
 png_fill_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 {
+#ifdef ENABLE_PNG_GL
+  if (gl_mode)
+    {
+      png_gl_use_gc (gc);
+      hidgl_fill_rect (x1 - bloat, y1 - bloat, x2 + bloat, y2 + bloat);
+      return;
+    }
+#endif
   use_gc (gc);
   gdImageSetThickness (im, 0);
   linewidth = 0;
@@ -1722,6 +2180,15 @@ png_draw_line (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 	}
     }
 
+#ifdef ENABLE_PNG_GL
+  if (gl_mode)
+    {
+      png_gl_use_gc (gc);
+      hidgl_draw_line (gc->cap, gc->width + 2 * bloat, x1, y1, x2, y2, scale);
+      return;
+    }
+#endif
+
   gdImageSetThickness (im, 0);
   linewidth = 0;
   if(gc->cap != Square_Cap || x1 == x2 || y1 == y2 )
@@ -1773,6 +2240,16 @@ png_draw_arc (hidGC gc, Coord cx, Coord cy, Coord width, Coord height,
     return;
   }
 
+#ifdef ENABLE_PNG_GL
+  if (gl_mode)
+    {
+      png_gl_use_gc (gc);
+      hidgl_draw_arc (gc->width + 2 * bloat, cx, cy, width, height,
+		      start_angle, delta_angle, scale);
+      return;
+    }
+#endif
+
   /* 
    * in gdImageArc, 0 degrees is to the right and +90 degrees is down
    * in pcb, 0 degrees is to the left and +90 degrees is down
@@ -1818,6 +2295,110 @@ png_draw_arc (hidGC gc, Coord cx, Coord cy, Coord width, Coord height,
 	      SCALE (2 * width), SCALE (2 * height), sa, ea, gdBrushed);
 }
 
+/*!
+ * \brief The pixels gdImageFilledEllipse() sets for a circle of a given
+ * diameter, as a span of each row relative to the centre.
+ */
+typedef struct circle_stamp
+{
+  int top, rows;
+  int *x1, *x2;			/* x2 < x1 for a row with nothing */
+} circle_stamp;
+
+static void
+free_circle_stamp (gpointer data)
+{
+  circle_stamp *stamp = (circle_stamp *) data;
+
+  free (stamp->x1);
+  free (stamp->x2);
+  free (stamp);
+}
+
+/*!
+ * \brief Get the stamp for circles of diameter d, drawing one the first
+ * time.
+ *
+ * \return the stamp, or NULL if it could not be made.
+ */
+static circle_stamp *
+get_circle_stamp (int d)
+{
+  circle_stamp *stamp;
+  gdImagePtr scratch;
+  int c = d / 2 + 2, x, y;
+
+  if (circle_stamps == NULL)
+    circle_stamps = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					   NULL, free_circle_stamp);
+  stamp = (circle_stamp *) g_hash_table_lookup (circle_stamps,
+						GINT_TO_POINTER (d));
+  if (stamp)
+    return stamp;
+
+  scratch = gdImageCreate (d + 4, d + 4);
+  if (scratch == NULL)
+    return NULL;
+  gdImageColorAllocate (scratch, 0, 0, 0);
+  gdImageFilledEllipse (scratch, c, c, d, d,
+			gdImageColorAllocate (scratch, 255, 255, 255));
+
+  stamp = (circle_stamp *) malloc (sizeof (*stamp));
+  stamp->top = -c;
+  stamp->rows = d + 4;
+  stamp->x1 = (int *) malloc (stamp->rows * sizeof (int));
+  stamp->x2 = (int *) malloc (stamp->rows * sizeof (int));
+  for (y = 0; y < stamp->rows; y++)
+    {
+      stamp->x1[y] = 0;
+      stamp->x2[y] = -1;
+      for (x = 0; x < d + 4; x++)
+	if (gdImagePalettePixel (scratch, x, y))
+	  {
+	    if (stamp->x2[y] < stamp->x1[y])
+	      stamp->x1[y] = x - c;
+	    stamp->x2[y] = x - c;
+	  }
+    }
+  gdImageDestroy (scratch);
+
+  g_hash_table_insert (circle_stamps, GINT_TO_POINTER (d), stamp);
+  return stamp;
+}
+
+/*!
+ * \brief Fill a circle as gdImageFilledEllipse() would.
+ *
+ * Pins and vias draw the same few circles over and over, so in palette
+ * images the rows of a stamp of each size are filled instead of working
+ * out the ellipse again.
+ */
+static void
+fill_circle_pixels (int cx, int cy, int d, int color)
+{
+  circle_stamp *stamp = NULL;
+  int i, y, x1, x2;
+
+  if (d > 0 && color >= 0 && !gdImageTrueColor (im))
+    stamp = get_circle_stamp (d);
+  if (stamp == NULL)
+    {
+      gdImageFilledEllipse (im, cx, cy, d, d, color);
+      return;
+    }
+
+  for (i = 0; i < stamp->rows; i++)
+    {
+      y = cy + stamp->top + i;
+      if (y < 0 || y >= gdImageSY (im))
+	continue;
+      x1 = MAX (0, cx + stamp->x1[i]);
+      x2 = MIN (gdImageSX (im) - 1, cx + stamp->x2[i]);
+      if (x1 <= x2)
+	memset (&gdImagePalettePixel (im, x1, y), color, x2 - x1 + 1);
+    }
+}
+
 static void
 png_fill_circle (hidGC gc, Coord cx, Coord cy, Coord radius)
 {
@@ -1836,10 +2417,19 @@ png_fill_circle (hidGC gc, Coord cx, Coord cy, Coord radius)
 
   have_outline |= doing_outline;
 
+#ifdef ENABLE_PNG_GL
+  if (gl_mode)
+    {
+      png_gl_use_gc (gc);
+      hidgl_fill_circle (cx, cy, radius + my_bloat / 2, scale);
+      return;
+    }
+#endif
+
   gdImageSetThickness (im, 0);
   linewidth = 0;
-  gdImageFilledEllipse (im, SCALE_X (cx), SCALE_Y (cy),
-			SCALE (2 * radius + my_bloat), SCALE (2 * radius + my_bloat), gc->color->c);
+  fill_circle_pixels (SCALE_X (cx), SCALE_Y (cy),
+		      SCALE (2 * radius + my_bloat), gc->color->c);
 
 }
 
@@ -1849,6 +2439,15 @@ png_fill_polygon (hidGC gc, int n_coords, Coord *x, Coord *y)
   int i;
   gdPoint *points;
 
+#ifdef ENABLE_PNG_GL
+  if (gl_mode)
+    {
+      png_gl_use_gc (gc);
+      hidgl_fill_polygon (n_coords, x, y);
+      return;
+    }
+#endif
+
   points = (gdPoint *) malloc (n_coords * sizeof (gdPoint));
   if (points == NULL)
     {
@@ -1870,6 +2469,20 @@ png_fill_polygon (hidGC gc, int n_coords, Coord *x, Coord *y)
   free (points);
 }
 
+static void
+png_fill_pcb_polygon (hidGC gc, PolygonType *poly, const BoxType *clip_box)
+{
+#ifdef ENABLE_PNG_GL
+  if (gl_mode)
+    {
+      png_gl_use_gc (gc);
+      hidgl_fill_pcb_polygon (poly, clip_box, scale);
+      return;
+    }
+#endif
+  common_fill_pcb_polygon (gc, poly, clip_box);
+}
+
 static void
 png_calibrate (double xval, double yval)
 {
@@ -1920,6 +2533,7 @@ hid_png_init ()
   png_graphics.fill_circle    = png_fill_circle;
   png_graphics.fill_polygon   = png_fill_polygon;
   png_graphics.fill_rect      = png_fill_rect;
+  png_graphics.fill_pcb_polygon = png_fill_pcb_polygon;
 
 #ifdef HAVE_SOME_FORMAT
   hid_register_hid (&png_hid);
@@ -27,6 +27,9 @@
 
 #define CRASH fprintf(stderr, "HID error: pcb called unimplemented EPS function %s.\n", __FUNCTION__); abort()
 
+/* Size of the buffer of the output file.  */
+#define EPS_BUFFER_SIZE (256 * 1024)
+
 /*----------------------------------------------------------------------------*/
 /* Function prototypes                                                        */
 /*----------------------------------------------------------------------------*/
@@ -47,6 +50,8 @@ static void eps_draw_arc (hidGC gc, Coord cx, Coord cy, Coord width, Coord heigh
 static void eps_fill_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2);
 static void eps_fill_circle (hidGC gc, Coord cx, Coord cy, Coord radius);
 static void eps_fill_polygon (hidGC gc, int n_coords, Coord *x, Coord *y);
+static void eps_fill_pcb_pad (hidGC gc, PadType *pad, bool clear, bool mask);
+static void eps_fill_pcb_pv (hidGC fg_gc, hidGC bg_gc, PinType *pv, bool drawHole, bool mask);
 static void eps_calibrate (double xval, double yval);
 static void eps_set_crosshair (int x, int y, int action);
 /*----------------------------------------------------------------------------*/
@@ -299,6 +304,15 @@ eps_hid_export_to_file (FILE * the_file, HID_Attr_Val * options)
   fprintf (f, "/cc { 0 360 arc nclip } bind def\n");
   fprintf (f,
 	   "/a { gsave setlinewidth translate scale 0 0 1 5 3 roll arc stroke grestore} bind def\n");
+  fprintf (f,
+	   "/sp { gsave setlinewidth 2 setlinecap moveto lineto stroke grestore } bind def\n");
+  fprintf (f,
+	   "/o { matrix currentmatrix 4 1 roll 3 1 roll translate dup scale\n"
+	   "     0.5 %g neg moveto %g 0.5 neg lineto %g neg 0.5 neg lineto 0.5 neg %g neg lineto\n"
+	   "     0.5 neg %g lineto %g neg 0.5 lineto %g 0.5 lineto 0.5 %g lineto\n"
+	   "     closepath setmatrix fill } bind def\n",
+	   TAN_22_5_DEGREE_2, TAN_22_5_DEGREE_2, TAN_22_5_DEGREE_2, TAN_22_5_DEGREE_2,
+	   TAN_22_5_DEGREE_2, TAN_22_5_DEGREE_2, TAN_22_5_DEGREE_2, TAN_22_5_DEGREE_2);
 
   hid_expose_callback (&eps_hid, bounds, 0);
 
@@ -337,6 +351,7 @@ eps_do_export (HID_Attr_Val * options)
       perror (filename);
       return;
     }
+  setvbuf (f, NULL, _IOFBF, EPS_BUFFER_SIZE);
 
   if (!options[HA_as_shown].int_value)
     hid_save_and_show_layer_ons (save_ons);
@@ -635,6 +650,49 @@ eps_fill_polygon (hidGC gc, int n_coords, Coord *x, Coord *y)
   fprintf (f, "fill\n");
 }
 
+/*!
+ * \brief Fill a pad, with the sp procedure for a square one that is not a
+ * single point.
+ */
+static void
+eps_fill_pcb_pad (hidGC gc, PadType *pad, bool clear, bool mask)
+{
+  Coord w = clear ? (mask ? pad->Mask
+                          : pad->Thickness + pad->Clearance)
+                  : pad->Thickness;
+
+  if (!TEST_FLAG (SQUAREFLAG, pad)
+      || (pad->Point1.X == pad->Point2.X && pad->Point1.Y == pad->Point2.Y))
+    {
+      common_fill_pcb_pad (gc, pad, clear, mask);
+      return;
+    }
+  eps_set_line_cap (gc, Square_Cap);
+  eps_set_line_width (gc, w);
+  use_gc (gc);
+  pcb_fprintf (f, "%mi %mi %mi %mi %mi sp\n", pad->Point1.X, pad->Point1.Y,
+	       pad->Point2.X, pad->Point2.Y, w);
+}
+
+/*!
+ * \brief Fill a pin or via, with the o procedure for an octagonal one.
+ */
+static void
+eps_fill_pcb_pv (hidGC fg_gc, hidGC bg_gc, PinType *pv, bool drawHole, bool mask)
+{
+  if (TEST_FLAG (HOLEFLAG, pv) || TEST_FLAG (SQUAREFLAG, pv)
+      || !TEST_FLAG (OCTAGONFLAG, pv))
+    {
+      common_fill_pcb_pv (fg_gc, bg_gc, pv, drawHole, mask);
+      return;
+    }
+  use_gc (fg_gc);
+  pcb_fprintf (f, "%mi %mi %mi o\n",
+	       pv->X, pv->Y, mask ? pv->Mask : pv->Thickness);
+  if (drawHole)
+    eps_fill_circle (bg_gc, pv->X, pv->Y, pv->DrillingHole / 2);
+}
+
 static void
 eps_fill_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 {
@@ -690,6 +748,8 @@ hid_eps_init ()
   eps_graphics.fill_circle    = eps_fill_circle;
   eps_graphics.fill_polygon   = eps_fill_polygon;
   eps_graphics.fill_rect      = eps_fill_rect;
+  eps_graphics.fill_pcb_pad   = eps_fill_pcb_pad;
+  eps_graphics.fill_pcb_pv    = eps_fill_pcb_pv;
 
   hid_register_hid (&eps_hid);
 }
@@ -14,6 +14,7 @@
 #include "misc.h"
 #include "error.h"
 #include "draw.h"
+#include "job.h"
 #include "pcb-printf.h"
 
 #include "hid.h"
@@ -100,6 +101,9 @@ typedef struct
 #define MARGINX MIL_TO_COORD(500)
 #define MARGINY MIL_TO_COORD(500)
 
+/* Size of the buffer of an output file.  */
+#define PS_BUFFER_SIZE (256 * 1024)
+
 static MediaType media_data[] = {
   {"A0", MM_TO_COORD(841), MM_TO_COORD(1189), MARGINX, MARGINY},
   {"A1", MM_TO_COORD(594), MM_TO_COORD(841), MARGINX, MARGINY},
@@ -355,6 +359,19 @@ Print file name and scale on printout.
   {N_("show-legend"), N_("Print file name and scale on printout"),
    HID_Boolean, 0, 0, {1, 0, 0}, 0, 0},
 #define HA_legend 17
+
+/* %start-doc options "91 Postscript Export"
+@ftable @code
+@item --jobs <int>
+Number of processes drawing the pages at the same time.
+The pages are shared out among the processes, each of which draws only
+its own pages.  The pages are put back in order at the end.
+@end ftable
+%end-doc
+*/
+  {N_("jobs"), N_("Number of processes drawing the pages at the same time"),
+   HID_Integer, 1, 64, {1, 0, 0}, 0, 0},
+#define HA_jobs 18
 };
 
 #define NUM_OPTIONS (sizeof(ps_attribute_list)/sizeof(ps_attribute_list[0]))
@@ -389,6 +406,12 @@ static struct {
   bool drillcopper;
   bool legend;
 
+  /* With --jobs the pages are shared out among processes: this one
+     draws the pages whose number less two modulo jobs is share.  */
+  int jobs;
+  int share;
+  bool skip_page;
+
   LayerType *outline_layer;
 
   double scale_factor;
@@ -563,7 +586,12 @@ psopen (const char *base, const char *which)
   char *buf, *suff, *buf2;
 
   if (!global.multi_file)
-    return fopen (base, "w");
+    {
+      ps_open_file = fopen (base, "w");
+      if (ps_open_file)
+        setvbuf (ps_open_file, NULL, _IOFBF, PS_BUFFER_SIZE);
+      return ps_open_file;
+    }
 
   buf = (char *)malloc (strlen (base) + strlen (which) + 5);
 
@@ -580,10 +608,167 @@ psopen (const char *base, const char *which)
     }
   printf("PS: open %s\n", buf);
   ps_open_file = fopen(buf, "w");
+  if (ps_open_file)
+    setvbuf (ps_open_file, NULL, _IOFBF, PS_BUFFER_SIZE);
   free (buf);
   return ps_open_file;
 }
 
+/*!
+ * \brief Draw the pages of a share, after the table of contents.
+ *
+ * Without --jobs the one share has all the pages, and ends the table of
+ * contents.  With --jobs that is left to ps_write_pages(), so that the
+ * file of each share starts with a page.
+ */
+static void
+ps_write_share (int share)
+{
+  global.share = share;
+  global.skip_page = global.jobs > 1;
+  global.pagecount = 1; /* Reset 'pagecount' if single file */
+  global.doing_toc = 0;
+  ps_set_layer (NULL, 0, -1);  /* reset static vars */
+  hid_expose_callback (&ps_hid, &global.region, 0);
+
+  if (!global.multi_file && !global.skip_page)
+    fprintf (global.f, "showpage\n");
+}
+
+/*!
+ * \brief Copy the page at the position of a share file to the output.
+ *
+ * A page runs from its %%Page comment up to the next page's.
+ */
+static void
+ps_copy_page (FILE *from, FILE *to)
+{
+  char buf[1024];
+  bool line_start = true, first = true;
+  long pos;
+
+  for (;;)
+    {
+      pos = ftell (from);
+      if (!fgets (buf, sizeof (buf), from))
+        break;
+      if (line_start && !first && strncmp (buf, "%%Page:", 7) == 0)
+        {
+          fseek (from, pos, SEEK_SET);
+          break;
+        }
+      first = false;
+      fputs (buf, to);
+      line_start = buf[strlen (buf) - 1] == '\n';
+    }
+}
+
+/*!
+ * \brief Start a share in a new file: a temporary one for a single file,
+ * none for --multi-file, which opens a file per page.
+ */
+static FILE *
+ps_share_file (void)
+{
+  FILE *sf;
+
+  if (global.multi_file)
+    return NULL;
+  sf = tmpfile ();
+  if (sf)
+    setvbuf (sf, NULL, _IOFBF, PS_BUFFER_SIZE);
+  return sf;
+}
+
+static int
+ps_share_worker (int part, FILE *fp, void *data)
+{
+  FILE **share_f = (FILE **) data;
+
+  global.f = share_f[part];
+  ps_write_share (part);
+  if (global.f)
+    fclose (global.f);
+  return 0;
+}
+
+/*!
+ * \brief Draw a share here: share 0 while the workers run, or that of a
+ * worker that failed, which starts again on a new file.
+ */
+static bool
+ps_share_here (int part, FILE *fp, void *data)
+{
+  FILE **share_f = (FILE **) data;
+
+  if (part != 0)
+    {
+      if (share_f[part])
+        fclose (share_f[part]);
+      share_f[part] = ps_share_file ();
+    }
+  global.f = share_f[part];
+  ps_write_share (part);
+  if (global.multi_file && global.f)
+    fclose (global.f);
+  return true;
+}
+
+/*!
+ * \brief Draw the pages after the table of contents, with the help of
+ * worker processes for --jobs.
+ *
+ * A worker draws its share of the pages into a temporary file, or into
+ * the files of its pages with --multi-file, and exits.  The share of a
+ * worker that could not be started or failed is drawn here.  The
+ * temporary files are then copied to the_file a page at a time.
+ */
+static void
+ps_write_pages (FILE *the_file)
+{
+  FILE *share_f[64];
+  int i;
+
+  for (i = 0; i < global.jobs; i++)
+    {
+      share_f[i] = ps_share_file ();
+      if (!global.multi_file && !share_f[i])
+        {
+          while (i > 0)
+            fclose (share_f[--i]);
+          global.jobs = 1;
+          break;
+        }
+    }
+
+  if (global.jobs > 1)
+    {
+      /* Don't let the workers inherit and flush our pending output. */
+      if (the_file)
+        fflush (the_file);
+      pcb_fork_workers (global.jobs, global.jobs - 1, 0, false,
+                        ps_share_worker, ps_share_here, share_f);
+
+      if (!global.multi_file)
+        {
+          fprintf (the_file, "showpage\n");
+          for (i = 0; i < global.jobs; i++)
+            {
+              fflush (share_f[i]);
+              rewind (share_f[i]);
+            }
+          for (i = 2; i <= global.pagecount; i++)
+            ps_copy_page (share_f[(i - 2) % global.jobs], the_file);
+          for (i = 0; i < global.jobs; i++)
+            fclose (share_f[i]);
+        }
+      global.f = the_file;
+      return;
+    }
+  global.jobs = 1;
+  ps_write_share (0);
+}
+
 /* This is used by other HIDs that use a postscript format, like lpr
    or eps.  */
 void
@@ -621,6 +806,7 @@ ps_hid_export_to_file (FILE * the_file, HID_Attr_Val * options)
   global.calibration_y = options[HA_ycalib].real_value;
   global.drillcopper  = options[HA_drillcopper].int_value;
   global.legend       = options[HA_legend].int_value;
+  global.jobs         = MAX (1, MIN (64, options[HA_jobs].int_value));
 
   if (the_file)
     ps_start_file (the_file);
@@ -691,13 +877,7 @@ ps_hid_export_to_file (FILE * the_file, HID_Attr_Val * options)
       hid_expose_callback (&ps_hid, &global.region, 0);
     }
 
-  global.pagecount = 1; /* Reset 'pagecount' if single file */
-  global.doing_toc = 0;
-  ps_set_layer (NULL, 0, -1);  /* reset static vars */
-  hid_expose_callback (&ps_hid, &global.region, 0);
-
-  if (the_file)
-    fprintf (the_file, "showpage\n");
+  ps_write_pages (the_file);
 
   memcpy (LayerStack, saved_layer_stack, sizeof (LayerStack));
   PCB->Flags = save_thindraw;
@@ -841,11 +1021,15 @@ ps_set_layer (const char *name, int group, int empty)
       int mirror_this = 0;
       lastgroup = group;
 
-      if (global.pagecount != 0)
+      if (global.pagecount != 0 && !global.skip_page)
 	{
 	  pcb_fprintf (global.f, "showpage\n");
 	}
       global.pagecount++;
+      global.skip_page = global.jobs > 1
+                         && (global.pagecount - 2) % global.jobs != global.share;
+      if (global.skip_page)
+        return 0;
       if (global.multi_file)
 	{
 	  if (global.f)
@@ -974,12 +1158,22 @@ ps_set_layer (const char *name, int group, int empty)
               "/r { /y2 exch def /x2 exch def /y1 exch def /x1 exch def\n"
               "     x1 y1 moveto x1 y2 lineto x2 y2 lineto x2 y1 lineto closepath fill } bind def\n"
               "/c { 0 360 arc fill } bind def\n"
-              "/a { gsave setlinewidth translate scale 0 0 1 5 3 roll arc stroke grestore} bind def\n");
+              "/a { gsave setlinewidth translate scale 0 0 1 5 3 roll arc stroke grestore} bind def\n"
+              "/sp { gsave setlinewidth 2 setlinecap moveto lineto stroke grestore } bind def\n");
+      fprintf (global.f,
+              "/o { matrix currentmatrix 4 1 roll 3 1 roll translate dup scale\n"
+              "     0.5 %g neg moveto %g 0.5 neg lineto %g neg 0.5 neg lineto 0.5 neg %g neg lineto\n"
+              "     0.5 neg %g lineto %g neg 0.5 lineto %g 0.5 lineto 0.5 %g lineto\n"
+              "     closepath setmatrix fill } bind def\n",
+              TAN_22_5_DEGREE_2, TAN_22_5_DEGREE_2, TAN_22_5_DEGREE_2, TAN_22_5_DEGREE_2,
+              TAN_22_5_DEGREE_2, TAN_22_5_DEGREE_2, TAN_22_5_DEGREE_2, TAN_22_5_DEGREE_2);
       if (global.drill_helper)
 	pcb_fprintf (global.f,
                     "/dh { gsave %mi setlinewidth 0 gray %mi 0 360 arc stroke grestore} bind def\n",
                     (Coord) MIN_PINORVIAHOLE, (Coord) (MIN_PINORVIAHOLE * 3 / 2));
     }
+  else if (global.skip_page)
+    return 0;
 #if 0
   /* Try to outsmart ps2pdf's heuristics for page rotation, by putting
    * text on all pages -- even if that text is blank */
@@ -1306,6 +1500,49 @@ ps_draw_pcb_polygon (hidGC gc, PolygonType * poly, const BoxType * clip_box)
     }
 }
 
+/*!
+ * \brief Fill a pad, with the sp procedure for a square one that is not a
+ * single point.
+ */
+static void
+ps_fill_pcb_pad (hidGC gc, PadType *pad, bool clear, bool mask)
+{
+  Coord w = clear ? (mask ? pad->Mask
+                          : pad->Thickness + pad->Clearance)
+                  : pad->Thickness;
+
+  if (!TEST_FLAG (SQUAREFLAG, pad)
+      || (pad->Point1.X == pad->Point2.X && pad->Point1.Y == pad->Point2.Y))
+    {
+      common_fill_pcb_pad (gc, pad, clear, mask);
+      return;
+    }
+  ps_set_line_cap (gc, Square_Cap);
+  ps_set_line_width (gc, w);
+  use_gc (gc);
+  pcb_fprintf (global.f, "%mi %mi %mi %mi %mi sp\n", pad->Point1.X,
+               pad->Point1.Y, pad->Point2.X, pad->Point2.Y, w);
+}
+
+/*!
+ * \brief Fill a pin or via, with the o procedure for an octagonal one.
+ */
+static void
+ps_fill_pcb_pv (hidGC fg_gc, hidGC bg_gc, PinType *pv, bool drawHole, bool mask)
+{
+  if (TEST_FLAG (HOLEFLAG, pv) || TEST_FLAG (SQUAREFLAG, pv)
+      || !TEST_FLAG (OCTAGONFLAG, pv))
+    {
+      common_fill_pcb_pv (fg_gc, bg_gc, pv, drawHole, mask);
+      return;
+    }
+  use_gc (fg_gc);
+  pcb_fprintf (global.f, "%mi %mi %mi o\n",
+               pv->X, pv->Y, mask ? pv->Mask : pv->Thickness);
+  if (drawHole)
+    ps_fill_circle (bg_gc, pv->X, pv->Y, pv->DrillingHole / 2);
+}
+
 static void
 ps_fill_rect (hidGC gc, Coord x1, Coord y1, Coord x2, Coord y2)
 {
@@ -1554,6 +1791,8 @@ void ps_ps_graphics_init (HID_DRAW *graphics)
   graphics->fill_rect          = ps_fill_rect;
 
   graphics->draw_pcb_polygon   = ps_draw_pcb_polygon;
+  graphics->fill_pcb_pad       = ps_fill_pcb_pad;
+  graphics->fill_pcb_pv        = ps_fill_pcb_pv;
 }
 
 void
@@ -193,6 +193,7 @@ InsertPointIntoPolygon (LayerType *Layer, PolygonType *Polygon)
       Polygon->HoleIndex[n]++;
 
   Polygon->Points[InsertAt] = save;
+  IDIndexInvalidate ();
   SetChangedFlag (true);
   AddObjectToInsertPointUndoList (POLYGONPOINT_TYPE, Layer, Polygon,
 				  &Polygon->Points[InsertAt]);
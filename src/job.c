@@ -0,0 +1,511 @@
+/*!
+ * \file src/job.c
+ *
+ * \brief Long operations run on a worker thread.
+ *
+ * The autorouters, the trace optimizer, the rats nest and the DRC can
+ * take long enough on a big board for a GUI to stop answering.
+ * pcb_job_run() runs such an operation on a worker thread, while the
+ * main thread shows its progress in the HID's progress dialog, through
+ * which it can also be cancelled, and keeps the GUI going.
+ *
+ * The worker has the board to itself until the job is done.  The
+ * progress dialog is modal, so nothing is edited in the meantime, the
+ * GUIs don't paint the board while pcb_job_busy(), and what the job
+ * draws is deferred until it ends, as by DeferDraw().  Anything else the
+ * job has for the GUI goes through the main thread: Message() is queued
+ * for it, and pcb_job_call() runs a function there while the worker
+ * waits.  Once pcb_job_run() returns, the main thread commits the result,
+ * just as when the operation ran there.
+ *
+ * Without a GUI, or within another job, the work is simply done in
+ * place.
+ *
+ * pcb_fork_workers() shares work that does not fit in one thread out to
+ * worker processes with a copy of the board each, like the DRC, the rats
+ * nest, the autorouter and the exporters do for --*-jobs.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_SYS_WAIT_H
+#include <sys/wait.h>
+#endif
+
+#include "global.h"
+#include "draw.h"
+#include "error.h"
+#include "hid.h"
+#include "pcb-printf.h"
+#include "job.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+/* How long the main thread waits on the worker between progress
+ * updates, in milliseconds */
+#define JOB_POLL_MSEC 50
+
+typedef struct
+{
+  GMutex lock;
+  GCond cond;			/*!< Signalled for the fields below. */
+  JobFunc work;
+  void *data;
+  int result;
+  bool done;
+  bool cancelled;
+  int so_far, total;
+  char *message;		/*!< Of the last progress, or NULL. */
+  GQueue log;			/*!< Messages of the worker, to be logged. */
+  void (*call) (void *);	/*!< To be run on the main thread. */
+  void *call_data;
+} JobType;
+
+/*!< The job running, only set and read by the main thread. */
+static JobType *job = NULL;
+/*!< The job of the worker thread it is read on. */
+static GPrivate job_worker;
+/*!< Where the messages of the pool thread it is read on are kept. */
+static GPrivate job_collect;
+
+static gpointer
+job_thread (gpointer data)
+{
+  JobType *j = (JobType *) data;
+  int result;
+
+  g_private_set (&job_worker, j);
+  result = j->work (j->data);
+  g_private_set (&job_worker, NULL);
+
+  g_mutex_lock (&j->lock);
+  j->result = result;
+  j->done = true;
+  g_cond_broadcast (&j->cond);
+  g_mutex_unlock (&j->lock);
+  return NULL;
+}
+
+/*!
+ * \brief Log the messages of the worker, called with the lock held.
+ */
+static void
+job_flush_log (JobType *j)
+{
+  char *text;
+
+  while ((text = (char *) g_queue_pop_head (&j->log)) != NULL)
+    {
+      g_mutex_unlock (&j->lock);
+      gui->log ("%s", text);
+      g_free (text);
+      g_mutex_lock (&j->lock);
+    }
+}
+
+/*!
+ * \brief Run work (data) as a job.
+ *
+ * Returns when the work is done, with what it returned.  A cancelled job
+ * still runs to its end; the work sees pcb_job_progress() return
+ * non-zero from then on, and stops as it would on a cancel from the
+ * progress dialog.
+ *
+ * \param title the operation, shown until the work reports progress.
+ */
+int
+pcb_job_run (const char *title, JobFunc work, void *data)
+{
+  JobType j;
+  GThread *thread;
+  void (*call) (void *);
+  char *message;
+  int so_far, total, cancel;
+
+  if (pcb_job_in_worker () || job != NULL || !gui->gui
+      || gui->progress == NULL)
+    return work (data);
+
+  memset (&j, 0, sizeof (j));
+  g_mutex_init (&j.lock);
+  g_cond_init (&j.cond);
+  g_queue_init (&j.log);
+  j.work = work;
+  j.data = data;
+  j.total = 1;
+
+  job = &j;
+  DeferDraw ();
+  thread = g_thread_try_new ("pcb-job", job_thread, &j, NULL);
+  if (thread == NULL)
+    {
+      job = NULL;
+      ResumeDraw ();
+      g_mutex_clear (&j.lock);
+      g_cond_clear (&j.cond);
+      return work (data);
+    }
+
+  g_mutex_lock (&j.lock);
+  while (!j.done)
+    {
+      if (j.call != NULL)
+	{
+	  call = j.call;
+	  g_mutex_unlock (&j.lock);
+	  call (j.call_data);
+	  g_mutex_lock (&j.lock);
+	  j.call = NULL;
+	  g_cond_broadcast (&j.cond);
+	  continue;
+	}
+      job_flush_log (&j);
+
+      so_far = j.so_far;
+      total = j.total;
+      message = g_strdup (j.message ? j.message : title);
+      g_mutex_unlock (&j.lock);
+      /* this is where the GUI gets its events */
+      cancel = gui->progress (so_far, total, message);
+      g_free (message);
+      g_mutex_lock (&j.lock);
+      if (cancel)
+	j.cancelled = true;
+
+      if (!j.done && j.call == NULL && g_queue_is_empty (&j.log))
+	g_cond_wait_until (&j.cond, &j.lock, g_get_monotonic_time ()
+			   + JOB_POLL_MSEC * G_TIME_SPAN_MILLISECOND);
+    }
+  job_flush_log (&j);
+  g_mutex_unlock (&j.lock);
+  g_thread_join (thread);
+
+  gui->progress (0, 0, NULL);
+  job = NULL;
+  ResumeDraw ();
+  /* Nothing the GUI was asked to paint meanwhile has been */
+  gui->invalidate_all ();
+
+  g_free (j.message);
+  g_mutex_clear (&j.lock);
+  g_cond_clear (&j.cond);
+  return j.result;
+}
+
+/*!
+ * \brief Report the progress of an operation.
+ *
+ * Used by the operations that may run as jobs instead of the HID's
+ * progress(), which it is outside of a job.  On the worker the progress
+ * is only noted, for the main thread to show.
+ *
+ * \return non-zero if the operation is to be cancelled.
+ */
+int
+pcb_job_progress (int so_far, int total, const char *message)
+{
+  JobType *j = (JobType *) g_private_get (&job_worker);
+  int cancelled;
+
+  if (j == NULL)
+    return gui->progress (so_far, total, message);
+
+  g_mutex_lock (&j->lock);
+  /* the dialog is closed by pcb_job_run() */
+  if (total > 0)
+    {
+      j->so_far = so_far;
+      j->total = total;
+      if (message != NULL
+	  && (j->message == NULL || strcmp (j->message, message) != 0))
+	{
+	  g_free (j->message);
+	  j->message = g_strdup (message);
+	}
+    }
+  cancelled = j->cancelled;
+  g_mutex_unlock (&j->lock);
+  return cancelled;
+}
+
+/*!
+ * \brief Whether the job of this worker thread has been cancelled.
+ */
+bool
+pcb_job_cancelled (void)
+{
+  JobType *j = (JobType *) g_private_get (&job_worker);
+  bool cancelled;
+
+  if (j == NULL)
+    return false;
+  g_mutex_lock (&j->lock);
+  cancelled = j->cancelled;
+  g_mutex_unlock (&j->lock);
+  return cancelled;
+}
+
+/*!
+ * \brief Run func (data) on the main thread.
+ *
+ * From a worker, this waits until the main thread has run it, which it
+ * does with the worker stopped, so func may use the GUI and the board.
+ * Anywhere else func is just called.
+ */
+void
+pcb_job_call (void (*func) (void *data), void *data)
+{
+  JobType *j = (JobType *) g_private_get (&job_worker);
+
+  if (j == NULL)
+    {
+      func (data);
+      return;
+    }
+
+  g_mutex_lock (&j->lock);
+  j->call = func;
+  j->call_data = data;
+  g_cond_broadcast (&j->cond);
+  while (j->call != NULL)
+    g_cond_wait (&j->cond, &j->lock);
+  g_mutex_unlock (&j->lock);
+}
+
+/*!
+ * \brief Whether a job has the board, for the main thread.
+ *
+ * The GUIs don't paint the board meanwhile, and the timers that would
+ * use it wait.
+ */
+bool
+pcb_job_busy (void)
+{
+  return job != NULL;
+}
+
+/*!
+ * \brief Whether this is the worker thread of a job.
+ */
+bool
+pcb_job_in_worker (void)
+{
+  return g_private_get (&job_worker) != NULL;
+}
+
+/*!
+ * \brief Queue a message of a worker for the main thread to log.
+ *
+ * \return false, with args untouched, if not called on a worker.
+ */
+bool
+pcb_job_logv (const char *fmt, va_list args)
+{
+  JobType *j = (JobType *) g_private_get (&job_worker);
+  GQueue *collect = (GQueue *) g_private_get (&job_collect);
+  char *text;
+
+  if (collect != NULL)
+    {
+      g_queue_push_tail (collect, pcb_vprintf (fmt, args));
+      return true;
+    }
+  if (j == NULL)
+    return false;
+
+  text = pcb_vprintf (fmt, args);
+  g_mutex_lock (&j->lock);
+  g_queue_push_tail (&j->log, text);
+  g_cond_broadcast (&j->cond);
+  g_mutex_unlock (&j->lock);
+  return true;
+}
+
+/*!
+ * \brief Keep the messages of this thread in log, or stop with NULL.
+ *
+ * The threads of a GThreadPool are neither the main thread nor the
+ * worker of a job, so a Message() there would call the GUI from a
+ * thread it does not expect.  A pool thread keeps the messages of each
+ * task in a queue of that task instead, for the thread that waits for
+ * the tasks to give to pcb_job_replay_log() once they are done.
+ */
+void
+pcb_job_collect_log (GQueue *log)
+{
+  g_private_set (&job_collect, log);
+}
+
+/*!
+ * \brief Log the messages kept by pcb_job_collect_log(), and empty log.
+ */
+void
+pcb_job_replay_log (GQueue *log)
+{
+  char *text;
+
+  while ((text = (char *) g_queue_pop_head (log)) != NULL)
+    {
+      Message ("%s", text);
+      g_free (text);
+    }
+}
+
+/*!
+ * \brief Note that this is a process forked from a worker.
+ *
+ * The child has no main thread to hand anything to, and does what it
+ * has to do by itself.
+ */
+void
+pcb_job_forked (void)
+{
+  g_private_set (&job_worker, NULL);
+}
+
+/*!
+ * \brief Share work cut into \p n parts out to worker processes.
+ *
+ * Each part but \p local is done by work() in a process forked for it,
+ * with up to \p jobs of them running at once, and work() returns the
+ * exit status of its worker.  With \p results, every worker writes its
+ * results to a temporary file of its own.  Once all workers are started,
+ * merge() is called for each part in order: with the rewound results of
+ * a worker that exited with 0, or with a NULL file for the part to be
+ * done here.  A merge() that finds the results unusable returns false,
+ * and is called again with NULL.  Without \p results, merge() is only
+ * called for the parts to be done here.
+ *
+ * Part \p local, if not -1, is done here while the workers run, and so
+ * are the parts of workers that could not be started or failed.  With
+ * \p jobs below 1, or where pcb can't fork, as on Windows, all parts
+ * are done here.
+ *
+ * \return the number of workers that failed.
+ */
+int
+pcb_fork_workers (int n, int jobs, int local, bool results,
+                  ForkWorkFunc work, ForkMergeFunc merge, void *data)
+{
+#if defined(HAVE_SYS_WAIT_H) && !defined(HAVE__SPAWNVP)
+  pid_t *pids = g_new (pid_t, n);
+  FILE **files = g_new0 (FILE *, n);
+  bool *ok = g_new0 (bool, n);
+  int running = 0, failed = 0, status, i, j;
+  pid_t pid;
+
+  /* Don't let the workers inherit and flush our pending output. */
+  fflush (stdout);
+  fflush (stderr);
+
+  /* pids[i] is -1 for a part done here, and 0 once its worker is reaped */
+  for (i = 0; i < n; i++)
+    pids[i] = -1;
+  for (i = 0; i < n && jobs > 0; i++)
+    {
+      if (i == local)
+        continue;
+      while (running == jobs && (pid = wait (&status)) > 0)
+        for (j = 0; j < n; j++)
+          if (pids[j] == pid)
+            {
+              ok[j] = WIFEXITED (status) && WEXITSTATUS (status) == 0;
+              pids[j] = 0;
+              running--;
+            }
+      if (running == jobs)
+        break;
+      if (results && (files[i] = tmpfile ()) == NULL)
+        continue;
+      pids[i] = fork ();
+      if (pids[i] == 0)
+        {
+          pcb_job_forked ();
+          status = work (i, files[i], data);
+          if (files[i] && fflush (files[i]) != 0)
+            status = 1;
+          fflush (stdout);
+          fflush (stderr);
+          _exit (status);
+        }
+      if (pids[i] > 0)
+        running++;
+    }
+
+  if (local >= 0 && local < n)
+    merge (local, NULL, data);
+
+  for (i = 0; i < n; i++)
+    {
+      if (i == local)
+        continue;
+      if (pids[i] > 0 && waitpid (pids[i], &status, 0) == pids[i])
+        {
+          ok[i] = WIFEXITED (status) && WEXITSTATUS (status) == 0;
+          pids[i] = 0;
+        }
+      if (pids[i] == 0 && !ok[i])
+        {
+          failed++;
+          Message (_("Worker process %d of %d failed, doing its part "
+                     "here\n"), i + 1, n);
+        }
+      if (ok[i] && results)
+        {
+          rewind (files[i]);
+          ok[i] = merge (i, files[i], data);
+        }
+      if (!ok[i])
+        merge (i, NULL, data);
+      if (files[i])
+        fclose (files[i]);
+    }
+
+  g_free (pids);
+  g_free (files);
+  g_free (ok);
+  return failed;
+#else
+  int i;
+
+  if (local >= 0 && local < n)
+    merge (local, NULL, data);
+  for (i = 0; i < n; i++)
+    if (i != local)
+      merge (i, NULL, data);
+  return 0;
+#endif
+}
@@ -0,0 +1,77 @@
+/*!
+ * \file src/job.h
+ *
+ * \brief Long operations run on a worker thread.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef	PCB_JOB_H
+#define	PCB_JOB_H
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <glib.h>
+
+/*!
+ * \brief The work of a job, run on the worker thread.
+ *
+ * \return the result of the job, handed back by pcb_job_run().
+ */
+typedef int (*JobFunc) (void *data);
+
+int pcb_job_run (const char *title, JobFunc work, void *data);
+int pcb_job_progress (int so_far, int total, const char *message);
+bool pcb_job_cancelled (void);
+void pcb_job_call (void (*func) (void *data), void *data);
+bool pcb_job_busy (void);
+bool pcb_job_in_worker (void);
+bool pcb_job_logv (const char *fmt, va_list args);
+void pcb_job_collect_log (GQueue *log);
+void pcb_job_replay_log (GQueue *log);
+void pcb_job_forked (void);
+
+/*!
+ * \brief The work of part \p part of pcb_fork_workers(), run in a worker
+ * process.
+ *
+ * \param fp the file for the results of the part, or NULL if none.
+ *
+ * \return the exit status of the worker: 0 if the part is done.
+ */
+typedef int (*ForkWorkFunc) (int part, FILE *fp, void *data);
+
+/*!
+ * \brief Take in the results of part \p part of pcb_fork_workers(), or do
+ * the part here if \p fp is NULL.
+ *
+ * \return false if the results in \p fp were unusable.
+ */
+typedef bool (*ForkMergeFunc) (int part, FILE *fp, void *data);
+
+int pcb_fork_workers (int n, int jobs, int local, bool results,
+                      ForkWorkFunc work, ForkMergeFunc merge, void *data);
+
+#endif
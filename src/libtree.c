@@ -0,0 +1,667 @@
+/*!
+ * \file src/libtree.c
+ *
+ * \brief Indexed, parallel scan of newlib footprint directories.
+ *
+ * The newlib library is a tree of directories holding one footprint per
+ * file.  Scanning it means a readdir() of every directory and a stat()
+ * of every entry, which on a network mounted library of tens of
+ * thousands of footprints takes seconds.
+ *
+ * Two things make it cheaper:
+ * - The directories are scanned by a pool of threads.  Nothing here
+ *   changes the working directory, the paths are all absolute.
+ * - The result is kept in an index, ~/.pcb/newlib.index, together with
+ *   the modification time of each directory.  A directory whose mtime is
+ *   unchanged is taken from the index with a single stat(), only changed
+ *   ones are read again.  --no-lib-index disables the index.
+ *
+ * The library menus are built from the scan in the main thread, the same
+ * as the plain recursive walk did: one menu per directory, named by its
+ * resolved absolute path.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "global.h"
+#include "data.h"
+#include "error.h"
+#include "libtree.h"
+#include "lrealpath.h"
+#include "misc.h"
+#include "mymem.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+/*!
+ * \brief Threads scanning directories.
+ *
+ * Scanning waits on the file system far more than it computes, so this
+ * is not limited to the number of processors.
+ */
+#define LIBTREE_THREADS 16
+
+#define LIBTREE_INDEX_NAME "newlib.index"
+#define LIBTREE_INDEX_HEADER "# pcb newlib index 1"
+
+typedef struct LibDirType LibDirType;
+
+/*!
+ * \brief One directory of a newlib tree.
+ */
+struct LibDirType
+{
+  char *path; /*!< Resolved absolute path. */
+  gint64 mtime; /*!< Modification time in ns when scanned, -1 to rescan. */
+  GPtrArray *footprints; /*!< File names of the footprints. */
+  GPtrArray *subdirs; /*!< LibDirType of the subdirectories. */
+  LibDirType *parent;
+  int error; /*!< errno of the failed scan, or 0. */
+  bool changed; /*!< Rescanned since the index was read. */
+};
+
+/*!
+ * \brief A top level directory of Settings.LibraryTree.
+ */
+typedef struct
+{
+  char *toppath;
+  bool recursive;
+  LibDirType *root;
+} LibTopType;
+
+/*!
+ * \brief The index, the scanned trees.
+ */
+static GPtrArray *tops = NULL;
+static bool index_dirty = false;
+
+/*!
+ * \brief One parallel scan of a tree.
+ */
+typedef struct
+{
+  GMutex lock;
+  GCond done;
+  int pending; /*!< Directories queued or being scanned. */
+  bool recursive;
+  GThreadPool *pool;
+} LibScanType;
+
+static LibDirType *
+new_dir (const char *path, LibDirType *parent)
+{
+  LibDirType *dir = g_new0 (LibDirType, 1);
+
+  dir->path = g_strdup (path);
+  dir->mtime = -1;
+  dir->footprints = g_ptr_array_new_with_free_func (g_free);
+  dir->subdirs = g_ptr_array_new ();
+  dir->parent = parent;
+  return dir;
+}
+
+static void
+free_dir (LibDirType *dir)
+{
+  guint i;
+
+  if (dir == NULL)
+    return;
+  for (i = 0; i < dir->subdirs->len; i++)
+    free_dir (g_ptr_array_index (dir->subdirs, i));
+  g_ptr_array_free (dir->subdirs, TRUE);
+  g_ptr_array_free (dir->footprints, TRUE);
+  g_free (dir->path);
+  g_free (dir);
+}
+
+static void
+free_top (gpointer data)
+{
+  LibTopType *top = data;
+
+  free_dir (top->root);
+  g_free (top->toppath);
+  g_free (top);
+}
+
+/*!
+ * \brief Whether a regular file is a footprint.
+ *
+ * Files which may exist in a library tree to provide an html browsable
+ * index of the library, and build files, are ignored.
+ */
+static bool
+is_footprint_name (const char *name)
+{
+  size_t l = strlen (name);
+
+  return name[0] != '.'
+    && NSTRCMP (name, "CVS") != 0
+    && NSTRCMP (name, "Makefile") != 0
+    && NSTRCMP (name, "Makefile.am") != 0
+    && NSTRCMP (name, "Makefile.in") != 0
+    && (l < 4 || NSTRCMP (name + (l - 4), ".png") != 0)
+    && (l < 5 || NSTRCMP (name + (l - 5), ".html") != 0)
+    && (l < 4 || NSTRCMP (name + (l - 4), ".pcb") != 0);
+}
+
+/*!
+ * \brief Whether path is dir or one of its parents, a symbolic link
+ * loop.
+ */
+static bool
+is_ancestor (LibDirType *dir, const char *path)
+{
+  for (; dir; dir = dir->parent)
+    if (strcmp (dir->path, path) == 0)
+      return true;
+  return false;
+}
+
+static void
+scan_failed (LibDirType *dir, int error)
+{
+  guint i;
+
+  dir->error = error ? error : EIO;
+  dir->mtime = -1;
+  dir->changed = true;
+  g_ptr_array_set_size (dir->footprints, 0);
+  for (i = 0; i < dir->subdirs->len; i++)
+    free_dir (g_ptr_array_index (dir->subdirs, i));
+  g_ptr_array_set_size (dir->subdirs, 0);
+}
+
+/*!
+ * \brief Bring the entries of one directory up to date.
+ *
+ * The subdirectories are not scanned, but those still present keep
+ * their own entries.  Runs on the scanning threads.
+ */
+/*!
+ * \brief Modification time of a stat() result in nanoseconds, as finely
+ * as the platform records it.
+ */
+static gint64
+stat_mtime (const struct stat *st)
+{
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  return (gint64) st->st_mtime * 1000000000 + st->st_mtim.tv_nsec;
+#else
+  return (gint64) st->st_mtime * 1000000000;
+#endif
+}
+
+static void
+scan_dir (LibDirType *dir, bool recursive)
+{
+  GHashTable *old_subdirs = NULL;
+  GPtrArray *subdirs;
+  struct dirent *entry;
+  struct stat st, dir_st;
+  LibDirType *child;
+  char *full, *real;
+  gint64 started = g_get_real_time (), mtime;
+  DIR *d;
+  guint i;
+
+  if (stat (dir->path, &dir_st) != 0)
+    {
+      scan_failed (dir, errno);
+      return;
+    }
+  if (!S_ISDIR (dir_st.st_mode))
+    {
+      scan_failed (dir, ENOTDIR);
+      return;
+    }
+  mtime = stat_mtime (&dir_st);
+  if (dir->mtime == mtime && dir->error == 0)
+    return;
+
+  if ((d = opendir (dir->path)) == NULL)
+    {
+      scan_failed (dir, errno);
+      return;
+    }
+
+  if (dir->subdirs->len > 0)
+    {
+      old_subdirs = g_hash_table_new (g_str_hash, g_str_equal);
+      for (i = 0; i < dir->subdirs->len; i++)
+        {
+          child = g_ptr_array_index (dir->subdirs, i);
+          g_hash_table_insert (old_subdirs, child->path, child);
+        }
+    }
+
+  g_ptr_array_set_size (dir->footprints, 0);
+  subdirs = g_ptr_array_new ();
+  while ((entry = readdir (d)) != NULL)
+    {
+      full = g_build_filename (dir->path, entry->d_name, NULL);
+      if (stat (full, &st) == 0 && S_ISREG (st.st_mode))
+        {
+          if (is_footprint_name (entry->d_name))
+            g_ptr_array_add (dir->footprints, g_strdup (entry->d_name));
+        }
+      else if (recursive && stat (full, &st) == 0 && S_ISDIR (st.st_mode)
+               && entry->d_name[0] != '.'
+               && NSTRCMP (entry->d_name, "CVS") != 0)
+        {
+          real = lrealpath (full);
+          if (!is_ancestor (dir, real))
+            {
+              child = old_subdirs ? g_hash_table_lookup (old_subdirs, real)
+                : NULL;
+              if (child)
+                g_hash_table_remove (old_subdirs, real);
+              else
+                child = new_dir (real, dir);
+              g_ptr_array_add (subdirs, child);
+            }
+          free (real);
+        }
+      g_free (full);
+    }
+  closedir (d);
+
+  /* Subdirectories which went away */
+  if (old_subdirs)
+    {
+      GHashTableIter iter;
+      gpointer value;
+
+      g_hash_table_iter_init (&iter, old_subdirs);
+      while (g_hash_table_iter_next (&iter, NULL, &value))
+        free_dir (value);
+      g_hash_table_destroy (old_subdirs);
+    }
+  g_ptr_array_free (dir->subdirs, TRUE);
+  dir->subdirs = subdirs;
+
+  /* A change made in the same tick of the file system clock as the scan
+   * may leave the mtime as it is, so a directory changed within a second
+   * of the scan is read again the next time. */
+  dir->mtime = mtime / 1000 + G_USEC_PER_SEC > started ? -1 : mtime;
+  dir->error = 0;
+  dir->changed = true;
+}
+
+static void
+scan_job (gpointer data, gpointer user_data)
+{
+  LibDirType *dir = data;
+  LibScanType *scan = user_data;
+  guint i;
+
+  scan_dir (dir, scan->recursive);
+
+  g_mutex_lock (&scan->lock);
+  scan->pending += dir->subdirs->len;
+  g_mutex_unlock (&scan->lock);
+  for (i = 0; i < dir->subdirs->len; i++)
+    g_thread_pool_push (scan->pool, g_ptr_array_index (dir->subdirs, i), NULL);
+
+  g_mutex_lock (&scan->lock);
+  if (--scan->pending == 0)
+    g_cond_signal (&scan->done);
+  g_mutex_unlock (&scan->lock);
+}
+
+static void
+scan_serial (LibDirType *dir, bool recursive)
+{
+  guint i;
+
+  scan_dir (dir, recursive);
+  for (i = 0; i < dir->subdirs->len; i++)
+    scan_serial (g_ptr_array_index (dir->subdirs, i), recursive);
+}
+
+/*!
+ * \brief Bring a whole tree up to date.
+ */
+static void
+scan_tree (LibDirType *root, bool recursive)
+{
+  LibScanType scan;
+
+  scan.pending = 1;
+  scan.recursive = recursive;
+  scan.pool = recursive
+    ? g_thread_pool_new (scan_job, &scan, LIBTREE_THREADS, FALSE, NULL)
+    : NULL;
+  if (scan.pool == NULL)
+    {
+      scan_serial (root, recursive);
+      return;
+    }
+
+  g_mutex_init (&scan.lock);
+  g_cond_init (&scan.done);
+  g_thread_pool_push (scan.pool, root, NULL);
+
+  g_mutex_lock (&scan.lock);
+  while (scan.pending > 0)
+    g_cond_wait (&scan.done, &scan.lock);
+  g_mutex_unlock (&scan.lock);
+
+  g_thread_pool_free (scan.pool, FALSE, TRUE);
+  g_mutex_clear (&scan.lock);
+  g_cond_clear (&scan.done);
+}
+
+/*!
+ * \brief Add the library menus of a scanned tree.
+ *
+ * \return the number of footprints added.
+ */
+static int
+add_menus (LibDirType *dir, const char *toppath)
+{
+  LibraryMenuType *menu;
+  LibraryEntryType *entry;
+  const char *name;
+  int n_footprints = 0;
+  size_t len;
+  guint i;
+
+  if (dir->changed)
+    index_dirty = true;
+  dir->changed = false;
+
+  if (dir->error)
+    {
+      errno = dir->error;
+      OpendirErrorMessage (dir->path);
+      return 0;
+    }
+
+  menu = GetLibraryMenuMemory (&Library);
+  menu->Name = strdup (dir->path);
+  menu->directory = strdup (toppath);
+
+  for (i = 0; i < dir->footprints->len; i++)
+    {
+      name = g_ptr_array_index (dir->footprints, i);
+      n_footprints++;
+      entry = GetLibraryEntryMemory (menu);
+
+      /*
+       * entry->AllocatedMemory points to abs path to the footprint.
+       * entry->ListEntry points to fp name itself.
+       */
+      len = strlen (dir->path) + strlen (PCB_DIR_SEPARATOR_S)
+        + strlen (name) + 1;
+      entry->AllocatedMemory = (char *) calloc (1, len);
+      strcat (entry->AllocatedMemory, dir->path);
+      strcat (entry->AllocatedMemory, PCB_DIR_SEPARATOR_S);
+      entry->ListEntry = entry->AllocatedMemory
+        + strlen (entry->AllocatedMemory);
+      strcat (entry->AllocatedMemory, name);
+
+      /* mark as directory tree (newlib) library */
+      entry->Template = (char *) -1;
+    }
+
+  for (i = 0; i < dir->subdirs->len; i++)
+    n_footprints += add_menus (g_ptr_array_index (dir->subdirs, i), toppath);
+  return n_footprints;
+}
+
+/*!
+ * \brief Name of the index file, NULL if it is not used.
+ */
+static char *
+index_filename (void)
+{
+  if (!Settings.LibraryIndex || homedir == NULL)
+    return NULL;
+  return g_build_filename (homedir, ".pcb", LIBTREE_INDEX_NAME, NULL);
+}
+
+/*!
+ * \brief Read the "D" block of a directory starting at lines[*i].
+ */
+static LibDirType *
+read_dir (char **lines, int *i, LibDirType *parent)
+{
+  LibDirType *dir, *child;
+  char *line = lines[*i], *end;
+  gint64 mtime;
+
+  if (line == NULL || strncmp (line, "D ", 2) != 0)
+    return NULL;
+  mtime = g_ascii_strtoll (line + 2, &end, 10);
+  if (*end != ' ' || end[1] == '\0')
+    return NULL;
+  dir = new_dir (end + 1, parent);
+  dir->mtime = mtime;
+  (*i)++;
+
+  while ((line = lines[*i]) != NULL)
+    {
+      if (strncmp (line, "F ", 2) == 0)
+        {
+          g_ptr_array_add (dir->footprints, g_strdup (line + 2));
+          (*i)++;
+        }
+      else if (line[0] == 'D')
+        {
+          if ((child = read_dir (lines, i, dir)) == NULL)
+            break;
+          g_ptr_array_add (dir->subdirs, child);
+        }
+      else if (strcmp (line, "E") == 0)
+        {
+          (*i)++;
+          return dir;
+        }
+      else
+        break;
+    }
+
+  free_dir (dir);
+  return NULL;
+}
+
+/*!
+ * \brief Read the index written by SaveNewlibIndex().
+ *
+ * A damaged index is ignored as a whole, the trees are scanned then.
+ */
+static void
+load_index (void)
+{
+  char *filename, *contents, **lines, *end;
+  LibTopType *top;
+  int i;
+
+  tops = g_ptr_array_new_with_free_func (free_top);
+  index_dirty = false;
+
+  if ((filename = index_filename ()) == NULL)
+    return;
+  if (!g_file_get_contents (filename, &contents, NULL, NULL))
+    {
+      g_free (filename);
+      index_dirty = true;
+      return;
+    }
+  g_free (filename);
+
+  lines = g_strsplit (contents, "\n", -1);
+  g_free (contents);
+
+  i = 0;
+  if (lines[0] == NULL || strcmp (lines[i++], LIBTREE_INDEX_HEADER) != 0)
+    goto damaged;
+  while (lines[i] && lines[i][0] != '\0')
+    {
+      if (strncmp (lines[i], "T ", 2) != 0)
+        goto damaged;
+      top = g_new0 (LibTopType, 1);
+      top->recursive = g_ascii_strtoll (lines[i] + 2, &end, 10) != 0;
+      top->toppath = g_strdup (*end == ' ' ? end + 1 : "");
+      g_ptr_array_add (tops, top);
+      i++;
+      if ((top->root = read_dir (lines, &i, NULL)) == NULL)
+        goto damaged;
+    }
+  g_strfreev (lines);
+  return;
+
+damaged:
+  g_strfreev (lines);
+  g_ptr_array_set_size (tops, 0);
+  index_dirty = true;
+}
+
+/*!
+ * \brief Load the footprints of the newlib tree at toppath.
+ *
+ * toppath is the resolved absolute path of the top directory.  Unless
+ * recursive is set only the top directory itself is read.
+ *
+ * \return the number of footprints found.
+ */
+int
+LoadNewlibTree (const char *toppath, bool recursive)
+{
+  LibTopType *top = NULL;
+  guint i;
+
+  if (tops == NULL)
+    load_index ();
+
+  for (i = 0; i < tops->len && top == NULL; i++)
+    {
+      top = g_ptr_array_index (tops, i);
+      if (strcmp (top->toppath, toppath) != 0 || top->recursive != recursive)
+        top = NULL;
+    }
+  if (top == NULL)
+    {
+      top = g_new0 (LibTopType, 1);
+      top->toppath = g_strdup (toppath);
+      top->recursive = recursive;
+      top->root = new_dir (toppath, NULL);
+      g_ptr_array_add (tops, top);
+    }
+
+  scan_tree (top->root, recursive);
+  return add_menus (top->root, toppath);
+}
+
+/*!
+ * \brief Write one directory, false if a name can't be represented.
+ */
+static bool
+write_dir (FILE *fp, LibDirType *dir)
+{
+  guint i;
+  bool ok = true;
+
+  if (strchr (dir->path, '\n'))
+    return false;
+  fprintf (fp, "D %" G_GINT64_FORMAT " %s\n",
+           dir->error ? (gint64) -1 : dir->mtime, dir->path);
+  for (i = 0; i < dir->footprints->len; i++)
+    {
+      const char *name = g_ptr_array_index (dir->footprints, i);
+
+      if (strchr (name, '\n'))
+        return false;
+      fprintf (fp, "F %s\n", name);
+    }
+  for (i = 0; ok && i < dir->subdirs->len; i++)
+    ok = write_dir (fp, g_ptr_array_index (dir->subdirs, i));
+  fputs ("E\n", fp);
+  return ok;
+}
+
+/*!
+ * \brief Save the index if any tree changed, and release the trees.
+ */
+void
+SaveNewlibIndex (void)
+{
+  char *filename, *dirname, *tmp;
+  LibTopType *top;
+  bool ok = true;
+  FILE *fp;
+  guint i;
+
+  if (tops == NULL)
+    return;
+
+  filename = index_filename ();
+  if (filename && index_dirty)
+    {
+      dirname = g_path_get_dirname (filename);
+      g_mkdir_with_parents (dirname, 0755);
+      g_free (dirname);
+
+      tmp = g_strconcat (filename, ".new", NULL);
+      if ((fp = fopen (tmp, "w")) != NULL)
+        {
+          fprintf (fp, "%s\n", LIBTREE_INDEX_HEADER);
+          for (i = 0; ok && i < tops->len; i++)
+            {
+              top = g_ptr_array_index (tops, i);
+              if (strchr (top->toppath, '\n'))
+                ok = false;
+              else
+                {
+                  fprintf (fp, "T %d %s\n", top->recursive, top->toppath);
+                  ok = write_dir (fp, top->root);
+                }
+            }
+          if (fclose (fp) != 0)
+            ok = false;
+          if (!ok || rename (tmp, filename) != 0)
+            remove (tmp);
+        }
+      g_free (tmp);
+    }
+  g_free (filename);
+
+  g_ptr_array_free (tops, TRUE);
+  tops = NULL;
+}
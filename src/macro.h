@@ -158,6 +158,48 @@
  */
 #define END_LOOP  }} while (0)
 
+/* ---------------------------------------------------------------------------
+ * the typed iterators the object loops are made of
+ *
+ * OBJECT_LOOP walks an object list, declaring 'var' as the object of
+ * the current link and 'n' as its position.  The next link is taken
+ * before the body runs, so the body may remove the current object.
+ * The object of the next link is prefetched while the body works on
+ * the current one, as the objects and the links are each allocated on
+ * their own.
+ *
+ * LAYERS_OBJECT_LOOP runs OBJECT_LOOP over a list of 'count' layers
+ * from layer 'from' on, declaring 'layer' and its index 'l' from 0, and
+ * prefetches the first link of the next layer as it starts on a layer.
+ * Both end with ENDALL_LOOP.
+ */
+#ifdef __GNUC__
+#define PREFETCH(addr) __builtin_prefetch (addr)
+#else
+#define PREFETCH(addr) ((void) 0)
+#endif
+
+#define PREFETCH_LINK(link) \
+  ((link) != NULL ? PREFETCH (((GList *) (link))->data) : (void) 0)
+
+#define OBJECT_LOOP(list, type, var) do {                            \
+  GList *__iter, *__next;                                           \
+  Cardinal n = 0;                                                   \
+  for (__iter = (list), __next = g_list_next (__iter),              \
+       PREFETCH_LINK (__next);                                      \
+       __iter != NULL;                                              \
+       __iter = __next, __next = g_list_next (__iter),              \
+       PREFETCH_LINK (__next), n++) {                               \
+    type *var = (type *) __iter->data;
+
+#define LAYERS_OBJECT_LOOP(top, from, count, list, type, var) do {   \
+  Cardinal l;                                                       \
+  LayerType *layer = (top)->Layer + (from);                         \
+  for (l = 0; l < (count); l++, layer++) {                          \
+    if (l + 1 < (count))                                            \
+      PREFETCH (layer[1].list);                                     \
+    OBJECT_LOOP (layer->list, type, var)
+
 #define STYLE_LOOP(top)  do {                                       \
         Cardinal n;                                                 \
         RouteStyleType *style;                                      \
@@ -165,13 +207,7 @@
         {                                                           \
                 style = &(top)->RouteStyle[n]
 
-#define VIA_LOOP(top) do {                                          \
-  GList *__iter, *__next;                                           \
-  Cardinal n = 0;                                                   \
-  for (__iter = (top)->Via, __next = g_list_next (__iter);          \
-       __iter != NULL;                                              \
-       __iter = __next, __next = g_list_next (__iter), n++) {       \
-    PinType *via = __iter->data;
+#define VIA_LOOP(top) OBJECT_LOOP ((top)->Via, PinType, via)
 
 #define DRILL_LOOP(top) do             {               \
         Cardinal        n;                                      \
@@ -201,21 +237,9 @@
         {                                                       \
                 connection = & (net)->Connection[n]
 
-#define ELEMENT_LOOP(top) do {                                      \
-  GList *__iter, *__next;                                           \
-  Cardinal n = 0;                                                   \
-  for (__iter = (top)->Element, __next = g_list_next (__iter);      \
-       __iter != NULL;                                              \
-       __iter = __next, __next = g_list_next (__iter), n++) {       \
-    ElementType *element = __iter->data;
+#define ELEMENT_LOOP(top) OBJECT_LOOP ((top)->Element, ElementType, element)
 
-#define RAT_LOOP(top) do {                                          \
-  GList *__iter, *__next;                                           \
-  Cardinal n = 0;                                                   \
-  for (__iter = (top)->Rat, __next = g_list_next (__iter);          \
-       __iter != NULL;                                              \
-       __iter = __next, __next = g_list_next (__iter), n++) {       \
-    RatType *line = __iter->data;
+#define RAT_LOOP(top) OBJECT_LOOP ((top)->Rat, RatType, line)
 
 #define	ELEMENTTEXT_LOOP(element) do { 	\
 	Cardinal	n;				\
@@ -232,69 +256,21 @@
 	{							\
 		textstring = (element)->Name[n].TextString
 
-#define PIN_LOOP(element) do {                                      \
-  GList *__iter, *__next;                                           \
-  Cardinal n = 0;                                                   \
-  for (__iter = (element)->Pin, __next = g_list_next (__iter);      \
-       __iter != NULL;                                              \
-       __iter = __next, __next = g_list_next (__iter), n++) {       \
-    PinType *pin = __iter->data;
+#define PIN_LOOP(element) OBJECT_LOOP ((element)->Pin, PinType, pin)
 
-#define PAD_LOOP(element) do {                                      \
-  GList *__iter, *__next;                                           \
-  Cardinal n = 0;                                                   \
-  for (__iter = (element)->Pad, __next = g_list_next (__iter);      \
-       __iter != NULL;                                              \
-       __iter = __next, __next = g_list_next (__iter), n++) {       \
-    PadType *pad = __iter->data;
+#define PAD_LOOP(element) OBJECT_LOOP ((element)->Pad, PadType, pad)
 
-#define ARC_LOOP(element) do {                                      \
-  GList *__iter, *__next;                                           \
-  Cardinal n = 0;                                                   \
-  for (__iter = (element)->Arc, __next = g_list_next (__iter);      \
-       __iter != NULL;                                              \
-       __iter = __next, __next = g_list_next (__iter), n++) {       \
-    ArcType *arc = __iter->data;
+#define ARC_LOOP(element) OBJECT_LOOP ((element)->Arc, ArcType, arc)
 
-#define ELEMENTLINE_LOOP(element) do {                              \
-  GList *__iter, *__next;                                           \
-  Cardinal n = 0;                                                   \
-  for (__iter = (element)->Line, __next = g_list_next (__iter);     \
-       __iter != NULL;                                              \
-       __iter = __next, __next = g_list_next (__iter), n++) {       \
-    LineType *line = __iter->data;
+#define ELEMENTLINE_LOOP(element) OBJECT_LOOP ((element)->Line, LineType, line)
 
-#define ELEMENTARC_LOOP(element) do {                               \
-  GList *__iter, *__next;                                           \
-  Cardinal n = 0;                                                   \
-  for (__iter = (element)->Arc, __next = g_list_next (__iter);      \
-       __iter != NULL;                                              \
-       __iter = __next, __next = g_list_next (__iter), n++) {       \
-    ArcType *arc = __iter->data;
+#define ELEMENTARC_LOOP(element) OBJECT_LOOP ((element)->Arc, ArcType, arc)
 
-#define LINE_LOOP(layer) do {                                       \
-  GList *__iter, *__next;                                           \
-  Cardinal n = 0;                                                   \
-  for (__iter = (layer)->Line, __next = g_list_next (__iter);       \
-       __iter != NULL;                                              \
-       __iter = __next, __next = g_list_next (__iter), n++) {       \
-    LineType *line = __iter->data;
+#define LINE_LOOP(layer) OBJECT_LOOP ((layer)->Line, LineType, line)
 
-#define TEXT_LOOP(layer) do {                                       \
-  GList *__iter, *__next;                                           \
-  Cardinal n = 0;                                                   \
-  for (__iter = (layer)->Text, __next = g_list_next (__iter);       \
-       __iter != NULL;                                              \
-       __iter = __next, __next = g_list_next (__iter), n++) {       \
-    TextType *text = __iter->data;
+#define TEXT_LOOP(layer) OBJECT_LOOP ((layer)->Text, TextType, text)
 
-#define POLYGON_LOOP(layer) do {                                    \
-  GList *__iter, *__next;                                           \
-  Cardinal n = 0;                                                   \
-  for (__iter = (layer)->Polygon, __next = g_list_next (__iter);    \
-       __iter != NULL;                                              \
-       __iter = __next, __next = g_list_next (__iter), n++) {       \
-    PolygonType *polygon = __iter->data;
+#define POLYGON_LOOP(layer) OBJECT_LOOP ((layer)->Polygon, PolygonType, polygon)
 
 #define	POLYGONPOINT_LOOP(polygon) do	{	\
 	Cardinal			n;		\
@@ -313,78 +289,35 @@
 	ELEMENT_LOOP(top); \
 	  PAD_LOOP(element)
 
-#define	ALLLINE_LOOP(top) do	{		\
-	Cardinal		l;			\
-	LayerType *layer = (top)->Layer;		\
-	for (l = 0; l < max_copper_layer + SILK_LAYER; l++, layer++)	\
-	{ \
-		LINE_LOOP(layer)
+#define ALLLINE_LOOP(top) \
+  LAYERS_OBJECT_LOOP (top, 0, max_copper_layer + SILK_LAYER, Line, LineType, line)
 
-#define ALLARC_LOOP(top) do {		\
-	Cardinal		l;			\
-	LayerType *layer = (top)->Layer;		\
-	for (l =0; l < max_copper_layer + SILK_LAYER; l++, layer++)		\
-	{ \
-		ARC_LOOP(layer)
+#define ALLARC_LOOP(top) \
+  LAYERS_OBJECT_LOOP (top, 0, max_copper_layer + SILK_LAYER, Arc, ArcType, arc)
 
-#define	ALLPOLYGON_LOOP(top)	do {		\
-	Cardinal		l;			\
-	LayerType *layer = (top)->Layer;		\
-	for (l = 0; l < max_copper_layer + SILK_LAYER; l++, layer++)	\
-	{ \
-		POLYGON_LOOP(layer)
+#define ALLPOLYGON_LOOP(top) \
+  LAYERS_OBJECT_LOOP (top, 0, max_copper_layer + SILK_LAYER, Polygon, PolygonType, polygon)
 
-#define	COPPERLINE_LOOP(top) do	{		\
-	Cardinal		l;			\
-	LayerType *layer = (top)->Layer;		\
-	for (l = 0; l < max_copper_layer; l++, layer++)	\
-	{ \
-		LINE_LOOP(layer)
+#define COPPERLINE_LOOP(top) \
+  LAYERS_OBJECT_LOOP (top, 0, max_copper_layer, Line, LineType, line)
 
-#define COPPERARC_LOOP(top) do	{		\
-	Cardinal		l;			\
-	LayerType *layer = (top)->Layer;		\
-	for (l =0; l < max_copper_layer; l++, layer++)		\
-	{ \
-		ARC_LOOP(layer)
+#define COPPERARC_LOOP(top) \
+  LAYERS_OBJECT_LOOP (top, 0, max_copper_layer, Arc, ArcType, arc)
 
-#define	COPPERPOLYGON_LOOP(top) do	{		\
-	Cardinal		l;			\
-	LayerType *layer = (top)->Layer;		\
-	for (l = 0; l < max_copper_layer; l++, layer++)	\
-	{ \
-		POLYGON_LOOP(layer)
+#define COPPERPOLYGON_LOOP(top) \
+  LAYERS_OBJECT_LOOP (top, 0, max_copper_layer, Polygon, PolygonType, polygon)
 
-#define	SILKLINE_LOOP(top) do	{		\
-	Cardinal		l;			\
-	LayerType *layer = (top)->Layer;		\
-	layer += max_copper_layer + BOTTOM_SILK_LAYER;			\
-	for (l = 0; l < 2; l++, layer++)		\
-	{ \
-		LINE_LOOP(layer)
+#define SILKLINE_LOOP(top) \
+  LAYERS_OBJECT_LOOP (top, max_copper_layer + BOTTOM_SILK_LAYER, 2, Line, LineType, line)
 
-#define SILKARC_LOOP(top) do	{		\
-	Cardinal		l;			\
-	LayerType *layer = (top)->Layer;		\
-	layer += max_copper_layer + BOTTOM_SILK_LAYER;			\
-	for (l = 0; l < 2; l++, layer++)		\
-	{ \
-		ARC_LOOP(layer)
+#define SILKARC_LOOP(top) \
+  LAYERS_OBJECT_LOOP (top, max_copper_layer + BOTTOM_SILK_LAYER, 2, Arc, ArcType, arc)
 
-#define	SILKPOLYGON_LOOP(top) do	{		\
-	Cardinal		l;			\
-	LayerType *layer = (top)->Layer;		\
-	layer += max_copper_layer + BOTTOM_SILK_LAYER;			\
-	for (l = 0; l < 2; l++, layer++)		\
-	{ \
-		POLYGON_LOOP(layer)
+#define SILKPOLYGON_LOOP(top) \
+  LAYERS_OBJECT_LOOP (top, max_copper_layer + BOTTOM_SILK_LAYER, 2, Polygon, PolygonType, polygon)
 
-#define	ALLTEXT_LOOP(top)	do {		\
-	Cardinal		l;			\
-	LayerType *layer = (top)->Layer;		\
-	for (l = 0; l < max_copper_layer + SILK_LAYER; l++, layer++)	\
-	{ \
-		TEXT_LOOP(layer)
+#define ALLTEXT_LOOP(top) \
+  LAYERS_OBJECT_LOOP (top, 0, max_copper_layer + SILK_LAYER, Text, TextType, text)
 
 #define	VISIBLELINE_LOOP(top) do	{		\
 	Cardinal		l;			\
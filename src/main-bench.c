@@ -0,0 +1,533 @@
+/*!
+ * \file src/main-bench.c
+ *
+ * \brief Micro-benchmarks of the core geometry and index code.
+ *
+ * Times the R-tree, the heap, the polygon booleans and pcb_fprintf()
+ * on synthetic data, and writes the results as JSON on stdout, so that
+ * runs of different commits can be compared.  Each measurement is the
+ * best of a number of runs.  It is not built by "make check", build it
+ * with "make -C src benchmark" and see "src/benchmark -h".
+ *
+ * "make -C src benchmark-arena" builds the same program with the R-tree
+ * nodes in the block storage of rtree.c (NODE_ARENA), for comparing the
+ * two layouts; the "rtree_layout" of the output tells which one ran.
+ * Likewise "make -C src benchmark-sweep" builds it with sweep_contours()
+ * finding the crossings of big contours (SWEEP_INTERSECT in polygon1.c),
+ * as told by "polygon_intersect".
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "heap.h"
+#include "pcb-printf.h"
+#include "polyarea.h"
+#include "profile.h"
+#include "rtree.h"
+
+/*!
+ * \brief Queries timed on each tree.
+ */
+#define BENCH_QUERIES 10000
+
+/*!
+ * \brief Lines written in each pcb_fprintf() measurement.
+ */
+#define BENCH_LINES 100000
+
+/*
+ * The R-tree and the polygon code are profiled in pcb, which this does
+ * not link.  With the profiler never started these are not called.
+ */
+bool profile_active = false;
+
+gint64
+profile_enter (ProfileSection s)
+{
+  return 0;
+}
+
+void
+profile_leave (ProfileSection s, gint64 start)
+{
+}
+
+static int runs = 5;
+static int results;
+static unsigned long seed = 1;
+
+static long
+bench_random (long n)
+{
+  unsigned long hi, lo;
+
+  seed = (seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+  hi = seed >> 16;
+  seed = (seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+  lo = seed >> 16;
+  return ((hi << 16) | lo) % n;
+}
+
+/*!
+ * \brief Write one result: the fastest of the runs of ops operations.
+ */
+static void
+bench_result (const char *suite, const char *name, long size, long ops,
+              gint64 best_usec)
+{
+  printf ("%s\n    {\"suite\": \"%s\", \"name\": \"%s\", \"size\": %ld, "
+          "\"ops\": %ld, \"usec\": %" G_GINT64_FORMAT ", "
+          "\"ns_per_op\": %.1f}",
+          results++ ? "," : "", suite, name, size, ops, best_usec,
+          ops > 0 ? best_usec * 1000.0 / ops : 0.0);
+}
+
+static void
+bench_best (gint64 *best, gint64 start)
+{
+  gint64 usec = g_get_monotonic_time () - start;
+
+  if (*best < 0 || usec < *best)
+    *best = usec;
+}
+
+static int
+bench_count_box (const BoxType *box, void *cl)
+{
+  (*(long *) cl)++;
+  return 1;
+}
+
+/*!
+ * \brief Boxes r_search() should find for the queries, by looking at
+ * all of them.
+ */
+static long
+bench_count_scan (const BoxType *boxes, long n, const BoxType *queries)
+{
+  long found = 0, i, q;
+
+  for (q = 0; q < BENCH_QUERIES; q++)
+    for (i = 0; i < n; i++)
+      if (boxes[i].X1 < queries[q].X2 && boxes[i].X2 > queries[q].X1 &&
+          boxes[i].Y1 < queries[q].Y2 && boxes[i].Y2 > queries[q].Y1)
+        found++;
+  return found;
+}
+
+/*!
+ * \brief Random boxes the size of tracks and pads on a square board.
+ */
+static BoxType *
+bench_boxes (long n, Coord side)
+{
+  BoxType *boxes = malloc (n * sizeof (BoxType));
+  long i;
+
+  for (i = 0; i < n; i++)
+    {
+      Coord w = MIL_TO_COORD (10) + bench_random (MIL_TO_COORD (500));
+      Coord h = MIL_TO_COORD (10) + bench_random (MIL_TO_COORD (50));
+
+      if (i & 1)
+        {
+          Coord t = w;
+
+          w = h;
+          h = t;
+        }
+      boxes[i].X1 = bench_random (side - w);
+      boxes[i].Y1 = bench_random (side - h);
+      boxes[i].X2 = boxes[i].X1 + w;
+      boxes[i].Y2 = boxes[i].Y1 + h;
+    }
+  return boxes;
+}
+
+static void
+bench_rtree (void)
+{
+  static const long sizes[] = {1000, 10000, 100000, 1000000};
+  int s, r;
+
+  for (s = 0; s < sizeof (sizes) / sizeof (sizes[0]); s++)
+    {
+      long n = sizes[s];
+      /* keep the density of the boxes about the same */
+      Coord side = MIL_TO_COORD (100) * sqrt ((double) n);
+      BoxType *boxes = bench_boxes (n, side);
+      BoxType *queries = bench_boxes (BENCH_QUERIES, side);
+      const BoxType **list = malloc (n * sizeof (BoxType *));
+      gint64 insert = -1, search = -1, delete = -1, bulk = -1, bulk_search = -1;
+      gint64 start;
+      long want = -1, found, i;
+
+      /* a faster search that misses boxes is no result */
+      if (n <= 10000)
+        want = bench_count_scan (boxes, n, queries);
+      for (i = 0; i < n; i++)
+        list[i] = &boxes[i];
+
+      for (r = 0; r < runs; r++)
+        {
+          rtree_t *tree = r_create_tree (NULL, 0, 0);
+
+          start = g_get_monotonic_time ();
+          for (i = 0; i < n; i++)
+            r_insert_entry (tree, &boxes[i], 0);
+          bench_best (&insert, start);
+
+          found = 0;
+          start = g_get_monotonic_time ();
+          for (i = 0; i < BENCH_QUERIES; i++)
+            r_search (tree, &queries[i], NULL, bench_count_box, &found);
+          bench_best (&search, start);
+          if (want < 0)
+            want = found;
+          else if (found != want)
+            {
+              fprintf (stderr, "r_search found %ld boxes of %ld\n", found, want);
+              exit (1);
+            }
+
+          start = g_get_monotonic_time ();
+          for (i = 0; i < n; i++)
+            r_delete_entry (tree, &boxes[i]);
+          bench_best (&delete, start);
+
+          r_destroy_tree (&tree);
+
+          start = g_get_monotonic_time ();
+          tree = r_create_tree (list, n, 0);
+          bench_best (&bulk, start);
+
+          found = 0;
+          start = g_get_monotonic_time ();
+          for (i = 0; i < BENCH_QUERIES; i++)
+            r_search (tree, &queries[i], NULL, bench_count_box, &found);
+          bench_best (&bulk_search, start);
+          if (found != want)
+            {
+              fprintf (stderr, "r_search found %ld boxes of %ld after "
+                       "r_create_tree\n", found, want);
+              exit (1);
+            }
+
+          r_destroy_tree (&tree);
+        }
+
+      bench_result ("rtree", "r_insert_entry", n, n, insert);
+      bench_result ("rtree", "r_search", n, BENCH_QUERIES, search);
+      bench_result ("rtree", "r_delete_entry", n, n, delete);
+      bench_result ("rtree", "r_create_tree", n, n, bulk);
+      bench_result ("rtree", "r_search bulk loaded", n, BENCH_QUERIES,
+                    bulk_search);
+      free (list);
+      free (boxes);
+      free (queries);
+    }
+}
+
+static void
+bench_heap (void)
+{
+  static const long sizes[] = {1000, 100000, 1000000};
+  int s, r;
+
+  for (s = 0; s < sizeof (sizes) / sizeof (sizes[0]); s++)
+    {
+      long n = sizes[s], i;
+      cost_t *costs = malloc (n * sizeof (cost_t));
+      gint64 insert = -1, remove = -1, start;
+
+      for (i = 0; i < n; i++)
+        costs[i] = bench_random (1000000);
+
+      for (r = 0; r < runs; r++)
+        {
+          heap_t *heap = heap_create ();
+
+          start = g_get_monotonic_time ();
+          for (i = 0; i < n; i++)
+            heap_insert (heap, costs[i], &costs[i]);
+          bench_best (&insert, start);
+
+          start = g_get_monotonic_time ();
+          while (!heap_is_empty (heap))
+            heap_remove_smallest (heap);
+          bench_best (&remove, start);
+
+          heap_destroy (&heap);
+        }
+
+      bench_result ("heap", "heap_insert", n, n, insert);
+      bench_result ("heap", "heap_remove_smallest", n, n, remove);
+      free (costs);
+    }
+}
+
+/*!
+ * \brief A closed outline around x, y of radius r with n vertices and a
+ * sinusoidal ripple; with n = 4 and no ripple it is a square.
+ */
+static POLYAREA *
+bench_poly (Coord x, Coord y, Coord r, int n, Coord ripple, int waves)
+{
+  PLINE *contour = NULL;
+  POLYAREA *pa;
+  Vector v;
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      double a = 2 * M_PI * i / n + M_PI / 4;
+      double rr = r + ripple * sin (waves * a);
+
+      v[0] = x + rr * cos (a);
+      v[1] = y + rr * sin (a);
+      if (contour == NULL)
+        contour = poly_NewContour (v);
+      else
+        poly_InclVertex (contour->head.prev, poly_CreateNode (v));
+    }
+  poly_PreContour (contour, TRUE);
+  if (contour->Flags.orient != PLF_DIR)
+    poly_InvContour (contour);
+  pa = poly_Create ();
+  poly_InclContour (pa, contour);
+  return pa;
+}
+
+static void
+bench_polygon (void)
+{
+  static const struct
+  {
+    const char *name;
+    int op;
+  } ops[] = {
+    {"poly_Boolean unite", PBO_UNITE},
+    {"poly_Boolean subtract", PBO_SUB},
+    {"poly_Boolean intersect", PBO_ISECT},
+  };
+  const Coord r = MM_TO_COORD (10);
+  struct
+  {
+    const char *name;
+    POLYAREA *a, *b;
+    long size, ops;
+  } shapes[4];
+  int i, k, m, n;
+
+  /* a square pour and a round via clearance, two overlapping octagon
+   * pads, and two pairs of large pours with rippled edges; the last pair
+   * is the size sweep_contours() was measured on, see polygon1.c
+   */
+  shapes[0].name = "square-circle";
+  shapes[0].a = bench_poly (0, 0, r, 4, 0, 0);
+  shapes[0].b = bench_poly (r, r / 3, r / 2, 40, 0, 0);
+  shapes[0].size = 44;
+  shapes[0].ops = 1000;
+  shapes[1].name = "octagon-octagon";
+  shapes[1].a = bench_poly (0, 0, r, 8, 0, 0);
+  shapes[1].b = bench_poly (r / 2, r / 5, r, 8, 0, 0);
+  shapes[1].size = 16;
+  shapes[1].ops = 1000;
+  shapes[2].name = "pour-pour";
+  shapes[2].a = bench_poly (0, 0, 5 * r, 20000, r / 50, 400);
+  shapes[2].b = bench_poly (r / 100, 0, 5 * r, 20000, r / 50, 401);
+  shapes[2].size = 40000;
+  shapes[2].ops = 3;
+  shapes[3].name = "big-pour-pour";
+  shapes[3].a = bench_poly (0, 0, 50 * r, 200000, r / 50, 4000);
+  shapes[3].b = bench_poly (r / 100, 0, 50 * r, 200000, r / 50, 4001);
+  shapes[3].size = 400000;
+  shapes[3].ops = 1;
+
+  for (k = 0; k < sizeof (shapes) / sizeof (shapes[0]); k++)
+    for (i = 0; i < sizeof (ops) / sizeof (ops[0]); i++)
+      {
+        gint64 best = -1, start;
+        char name[64];
+        int failed = 0;
+
+        for (m = 0; m < runs; m++)
+          {
+            start = g_get_monotonic_time ();
+            for (n = 0; n < shapes[k].ops; n++)
+              {
+                POLYAREA *res = NULL;
+
+                if (poly_Boolean (shapes[k].a, shapes[k].b, &res, ops[i].op)
+                    != err_ok)
+                  failed = 1;
+                poly_Free (&res);
+              }
+            bench_best (&best, start);
+          }
+        if (failed)
+          fprintf (stderr, "%s of %s failed\n", ops[i].name, shapes[k].name);
+        snprintf (name, sizeof (name), "%s %s", ops[i].name, shapes[k].name);
+        bench_result ("polygon", name, shapes[k].size, shapes[k].ops, best);
+      }
+
+  for (k = 0; k < sizeof (shapes) / sizeof (shapes[0]); k++)
+    {
+      poly_Free (&shapes[k].a);
+      poly_Free (&shapes[k].b);
+    }
+}
+
+static void
+bench_printf (void)
+{
+  static const struct
+  {
+    const char *name;
+    const char *format;
+  } formats[] = {
+    /* what saving a board writes */
+    {"pcb_fprintf %mr", "Line[%mr %mr %mr %mr %mr %mr \"clearline\"]\n"},
+    /* what the status line and the reports show */
+    {"pcb_fprintf %$mS", "%$mS, %$mS\n"},
+    {"pcb_fprintf %mm", "%.4mm %.4mm\n"},
+  };
+  FILE *out = fopen ("/dev/null", "w");
+  static Coord c[BENCH_LINES];
+  int i, k, n;
+
+  if (out == NULL)
+    out = tmpfile ();
+  if (out == NULL)
+    {
+      perror ("benchmark");
+      return;
+    }
+  for (i = 0; i < BENCH_LINES; i++)
+    c[i] = bench_random (MIL_TO_COORD (10000));
+
+  for (k = 0; k < sizeof (formats) / sizeof (formats[0]); k++)
+    {
+      gint64 best = -1, start;
+
+      for (n = 0; n < runs; n++)
+        {
+          start = g_get_monotonic_time ();
+          for (i = 0; i < BENCH_LINES; i++)
+            pcb_fprintf (out, formats[k].format, c[i], c[BENCH_LINES - 1 - i],
+                         c[(i + 1) % BENCH_LINES], c[(i + 2) % BENCH_LINES],
+                         c[(i + 3) % BENCH_LINES], c[(i + 4) % BENCH_LINES]);
+          bench_best (&best, start);
+        }
+      bench_result ("printf", formats[k].name, BENCH_LINES, BENCH_LINES,
+                    best);
+    }
+  fclose (out);
+}
+
+static const struct
+{
+  const char *name;
+  void (*run) (void);
+} suites[] = {
+  {"rtree", bench_rtree},
+  {"heap", bench_heap},
+  {"polygon", bench_polygon},
+  {"printf", bench_printf},
+};
+
+#define N_SUITES (sizeof (suites) / sizeof (suites[0]))
+
+static void
+usage (void)
+{
+  int i;
+
+  fprintf (stderr, "usage: benchmark [-r runs] [suite ...]\n\n"
+           "Times the suites given, or all of them, and writes the best of\n"
+           "the runs (5) of each measurement as JSON.  The suites are");
+  for (i = 0; i < N_SUITES; i++)
+    fprintf (stderr, " %s", suites[i].name);
+  fprintf (stderr, ".\n");
+  exit (1);
+}
+
+int
+main (int argc, char *argv[])
+{
+  bool selected[N_SUITES];
+  bool any = false;
+  int i, k;
+
+  memset (selected, 0, sizeof (selected));
+  for (i = 1; i < argc; i++)
+    {
+      if (strcmp (argv[i], "-r") == 0 && i + 1 < argc)
+        {
+          runs = atoi (argv[++i]);
+          if (runs < 1)
+            usage ();
+          continue;
+        }
+      for (k = 0; k < N_SUITES; k++)
+        if (strcmp (argv[i], suites[k].name) == 0)
+          break;
+      if (k == N_SUITES)
+        usage ();
+      selected[k] = any = true;
+    }
+
+  initialize_units ();
+
+  printf ("{\n  \"runs\": %d,\n  \"rtree_layout\": \"%s\",\n"
+          "  \"polygon_intersect\": \"%s\",\n  \"results\": [", runs,
+#ifdef NODE_ARENA
+          "arena",
+#else
+          "malloc",
+#endif
+#ifdef SWEEP_INTERSECT
+          "sweep"
+#else
+          "rtree"
+#endif
+          );
+  for (k = 0; k < N_SUITES; k++)
+    if (!any || selected[k])
+      {
+        suites[k].run ();
+        fflush (stdout);
+      }
+  printf ("\n  ]\n}\n");
+  return 0;
+}
@@ -37,6 +37,25 @@
 #include "global.h"
 #include "pcb-printf.h"
 #include "object_list.h"
+#include "profile.h"
+#include "rtree.h"
+
+/*
+ * The R-tree is profiled in pcb, which this does not link.  With the
+ * profiler never started these are not called.
+ */
+bool profile_active = false;
+
+gint64
+profile_enter (ProfileSection s)
+{
+  return 0;
+}
+
+void
+profile_leave (ProfileSection s, gint64 start)
+{
+}
 
 int
 main (int argc, char *argv[])
@@ -44,6 +63,7 @@ main (int argc, char *argv[])
   initialize_units ();
   pcb_printf_register_tests ();
   object_list_register_tests ();
+  rtree_register_tests ();
 
   g_test_init (&argc, &argv, NULL);
   g_test_run ();
@@ -60,7 +60,12 @@
 #include "set.h"
 #include "action.h"
 #include "misc.h"
+#include "job.h"
 #include "lrealpath.h"
+#include "memstats.h"
+#include "copperstats.h"
+#include "profile.h"
+#include "timing.h"
 #include "free_atexit.h"
 #include "polygon.h"
 #include "gettext.h"
@@ -290,7 +295,7 @@ usage (void)
   for (i = 0; hl[i]; i++)
     if (hl[i]->printer)
       fprintf (stderr, "\t%-8s %s\n", hl[i]->name, hl[i]->description);
-  u ("%s -x hid [export options] <pcb file>\tto export", Progname);
+  u ("%s -x hid[,hid...] [export options] <pcb file>\tto export", Progname);
   u ("Available export hid%s:", n_exporter == 1 ? "" : "s");
   for (i = 0; hl[i]; i++)
     if (hl[i]->exporter)
@@ -1106,6 +1111,199 @@ The default value is @code{60}.
   ISET (BackupInterval, 60, "backup-interval",
   "Time between automatic backups in seconds. Set to 0 to disable"),
 
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --undo-budget <int>
+Memory, in kB, that the undo list may take, counting the objects it
+keeps for removed objects.  When it takes more, the oldest operations
+are forgotten, so that they can no longer be undone.  The default value
+is @code{0}, which keeps all of them.
+@end ftable
+%end-doc
+*/
+  ISET (UndoBudget, 0, "undo-budget",
+  "Memory the undo list may take in kB. Set to 0 for no limit"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --drc-jobs <int>
+Number of worker processes checking the connections of a design for
+the DRC.  Each one checks the pins, pads and vias of a strip of the
+board.  The default value is @code{1}, which does the check in pcb
+itself.
+@end ftable
+%end-doc
+*/
+  ISET (DrcJobs, 1, "drc-jobs",
+  "Number of worker processes for the DRC connection check"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --drc-single-pass
+If set, the DRC finds all the nets too close to a net with one bloated
+connection lookup, instead of starting the lookup over after each one.
+The violations are the same, but they may be reported between other
+objects of the nets.
+@end ftable
+%end-doc
+*/
+  BSET (DrcSinglePass, 0, "drc-single-pass",
+       "If set, the DRC looks up each net once for clearance violations"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --rat-jobs <int>
+Number of worker processes finding the shortest rat lines of the nets
+when the rats nest is added.  Each one does a run of nets, and the rats
+are added in netlist order.  The default value is @code{1}, which finds
+them in pcb itself.
+@end ftable
+%end-doc
+*/
+  ISET (RatJobs, 1, "rat-jobs",
+  "Number of worker processes for the rats nest"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --route-jobs <int>
+Number of worker processes routing nets at once in the autorouter.
+Each one routes a net that lies apart from those of the others, and a
+route that comes too near one of another net of the batch is done again
+in pcb.  The default value is @code{1}, which routes the nets one by
+one in pcb itself.
+@end ftable
+%end-doc
+*/
+  ISET (RouteJobs, 1, "route-jobs",
+  "Number of worker processes for the autorouter"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --autoroute-stats
+If set, the autorouter reports each of its passes: the nets routed and
+left unfinished, the subnets routed, in conflict and failed, the nets
+ripped up, the edges pushed on and popped off the search heaps, the
+expansion areas made, and the time taken in all and by the slowest net.
+@end ftable
+%end-doc
+*/
+  BSET (AutorouteStats, 0, "autoroute-stats",
+       "If set, the autorouter reports statistics of its passes"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --autoroute-trace <string>
+If set, the autorouter writes a line to this file for every net it
+routes, with its pass, its first terminal, whether it was finished, its
+cost, the search work and the time it took, and the report of every
+pass as with @code{--autoroute-stats}.
+@end ftable
+%end-doc
+*/
+  SSET (AutorouteTrace, "", "autoroute-trace",
+	"File the autorouter writes a trace of its nets to"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --autoroute-budget <int>
+Number of seconds the autorouter may take.  When they are up it stops
+where it is, takes out the routes of the nets that are still in
+conflict and keeps the rest, as if the last pass had been the final
+one.  The default value is @code{0}, which lets it run to the end.
+@end ftable
+%end-doc
+*/
+  ISET (AutorouteBudget, 0, "autoroute-budget",
+  "Seconds the autorouter may take, 0 for no limit"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --place-jobs <int>
+Number of worker processes annealing the placement at once in the
+autoplacer.  Each one anneals from the same start with random numbers
+of its own, and the placement of the one that ends up cheapest is kept.
+The default value is @code{1}, which anneals once in pcb itself.
+@end ftable
+%end-doc
+*/
+  ISET (PlaceJobs, 1, "place-jobs",
+  "Number of worker processes for the autoplacer"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --export-jobs <int>
+Number of exporters of a @code{-x} list that run at once, each in a
+worker process of its own with a copy of the loaded board.  The default
+value is @code{1}, which runs them one after the other in pcb itself.
+@end ftable
+%end-doc
+*/
+  ISET (ExportJobs, 1, "export-jobs",
+  "Number of exporters of a -x list run at once"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --mem-stats
+If set, pcb reports the memory the board takes when it exits, as the
+@code{MemoryReport()} action does.
+@end ftable
+%end-doc
+*/
+  BSET (MemStats, 0, "mem-stats",
+       "If set, pcb reports its memory use at exit"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --timing
+If set, pcb reports the time and memory taken by each phase of its
+startup, including the load of the board given, as the @code{Timing()}
+action does.  The report is made before an export run exports, and
+before the GUI starts.
+@end ftable
+%end-doc
+*/
+  BSET (Timing, 0, "timing",
+       "If set, pcb reports the time and memory its startup takes"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --copper-stats <string>
+If set, an export run writes to this file the copper area of each
+layer group and of each net on it, and the density of the copper in
+cells of 5 mm, as the @code{CopperStats()} action does.
+@end ftable
+%end-doc
+*/
+  SSET (CopperStatsFile, "", "copper-stats",
+	"File an export run reports the copper area and density to"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --compact-polygons
+If set, the clipped contours of polygons are kept without the index of
+their edges while no operation works on them.  The index is built again
+when a clip or a search needs it, so large pours take less memory at
+the cost of some speed when they are edited.
+@end ftable
+%end-doc
+*/
+  BSET (CompactPolygons, 0, "compact-polygons",
+       "If set, idle polygon contours are kept without their edge index"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --autoroute-checkpoint <string>
+If set, the autorouter writes its state to this file at the end of
+every pass: the routes it has made so far, the nets that are in
+conflict and the order it will route the nets in on the next pass.
+@code{AutoRoute(AllRats,Resume)} picks the routing up again from there,
+on the same board.
+@end ftable
+%end-doc
+*/
+  SSET (AutorouteCheckpoint, "", "autoroute-checkpoint",
+	"File the autorouter checkpoints its passes to"),
+
 /* %start-doc options "4 Layer Names"
 @ftable @code
 @item --layer-name-1 <string>
@@ -1284,6 +1482,19 @@ Top level directory for the newlib style library.
   SSET (LibraryTree, PCBTREEPATH, "lib-newlib",
 	"Top level directory for the newlib style library"),
 
+/* %start-doc options "5 Paths"
+@ftable @code
+@item --lib-index
+If set, the newlib footprints found are kept in
+@file{~/.pcb/newlib.index} with the modification time of each library
+directory, and only directories changed since are read again on the
+next start.  Default is set.
+@end ftable
+%end-doc
+*/
+  BSET (LibraryIndex, 1, "lib-index",
+	"If set, keep an index of the newlib library"),
+
 /* %start-doc options "6 Commands"
 @ftable @code
 @item --save-command <string>
@@ -1545,6 +1756,43 @@ If set, save pcb files using only mm unit suffix rather than 'smart' mil/mm.
   BSET (SaveMetricOnly, 0, "save-metric-only",
         "If set, save pcb files using only mm unit suffix rather than 'smart' mil/mm."),
 
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --fast-parser
+If set, files which are read without a @code{--file-command},
+@code{--font-command} or @code{--lib-command} filter are mapped into
+memory and scanned in place.  @code{--no-fast-parser} reads them with
+the flex scanner instead.  Both give the same result.
+@end ftable
+%end-doc
+*/
+  BSET (FastParser, 1, "fast-parser",
+        "If set, scan plain input files in memory"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --board-cache
+If set, the clipped polygons of a loaded board are saved in
+@file{<file>.cache} next to the board file, and the next load of the
+unchanged board uses them instead of clipping the polygons again.
+@end ftable
+%end-doc
+*/
+  BSET (BoardCache, 0, "board-cache",
+        "If set, cache the clipped polygons of loaded boards"),
+
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --edif-stream
+If set, EDIF netlists are imported by a reader which picks out only the
+nets, keeping its memory bounded on large files.  @code{--no-edif-stream}
+reads them with the full EDIF grammar instead.
+@end ftable
+%end-doc
+*/
+  BSET (EdifStream, 1, "edif-stream",
+        "If set, read EDIF netlists with the streaming reader"),
+
 /* %start-doc options "2 General GUI Options"
 @ftable @code
 @item --all-direction-lines
@@ -1574,6 +1822,18 @@ If set, all found connections are reset before a new component is scanned.
   BSET (ResetAfterElement, 1, "reset-after-element",
        "If set, all found connections are reset before a new component is scanned"),
 
+/* %start-doc options "1 General Options"
+@ftable @code
+@item --live-rats
+If set, the rats nest is brought up to date after every change to the
+board.  Only the rats of the nets the change touches are removed and
+added again, as with @code{AddRats(Changed)}.
+@end ftable
+%end-doc
+*/
+  BSET (LiveRats, 0, "live-rats",
+       "If set, the rats of edited nets are kept up to date"),
+
 /* %start-doc options "1 General Options"
 @ftable @code
 @item --auto-buried-vias
@@ -1673,6 +1933,8 @@ REGISTER_ATTRIBUTES (main_attribute_list)
   copy_nonzero_increments (get_increments_struct (IMPERIAL), &increment_mil);
 
   Settings.increments = get_increments_struct (Settings.grid_unit->family);
+
+  poly_SetCompact (Settings.CompactPolygons);
 }
 
 /*!
@@ -1901,7 +2163,171 @@ InitPaths (char *argv0)
     }
 }
 
-/* ---------------------------------------------------------------------- 
+/* ----------------------------------------------------------------------
+ * exporting with several HIDs in one run
+ */
+
+/*!
+ * \brief An exporter of a "-x" list.
+ */
+typedef struct
+{
+  HID *hid;
+  HID_Attribute *attributes; /*!< The export options of the HID. */
+  HID_Attr_Val *defaults; /*!< Their values before the command line. */
+  int n;
+} ExportJobType;
+
+static ExportJobType *export_jobs = NULL;
+static int n_export_jobs = 0;
+
+/*!
+ * \brief Find the exporters of a comma separated list of names.
+ *
+ * \return the first of them, or NULL if a name is not an exporter.
+ */
+static HID *
+find_export_list (const char *names)
+{
+  char *list = strdup (names), *name;
+  HID *h;
+
+  for (name = strtok (list, ","); name; name = strtok (NULL, ","))
+    {
+      if ((h = hid_find_exporter (name)) == NULL)
+	{
+	  free (list);
+	  return NULL;
+	}
+      export_jobs = (ExportJobType *) realloc (export_jobs,
+					       (n_export_jobs + 1) *
+					       sizeof (ExportJobType));
+      export_jobs[n_export_jobs++].hid = h;
+    }
+  free (list);
+  return n_export_jobs ? export_jobs[0].hid : NULL;
+}
+
+/*!
+ * \brief Register the options of all exporters of the list, so that the
+ * command line can give options of any of them.
+ *
+ * The first exporter registers its own options in parse_arguments(), so
+ * that an option the exporters have in common is parsed into its own.
+ */
+static void
+register_export_list (void)
+{
+  ExportJobType *job;
+  int i, j;
+
+  for (i = n_export_jobs - 1; i >= 0; i--)
+    {
+      job = &export_jobs[i];
+      exporter = job->hid;
+      job->attributes = exporter->get_export_options (&job->n);
+      if (i > 0)
+	hid_register_attributes (job->attributes, job->n);
+      job->defaults = (HID_Attr_Val *) malloc ((job->n + 1) *
+					       sizeof (HID_Attr_Val));
+      for (j = 0; j < job->n; j++)
+	job->defaults[j] = job->attributes[j].default_val;
+    }
+  exporter = export_jobs[0].hid;
+}
+
+static bool
+export_option_set (ExportJobType *job, int i)
+{
+  HID_Attr_Val *a = &job->attributes[i].default_val, *d = &job->defaults[i];
+
+  return (a->int_value != d->int_value || a->str_value != d->str_value
+	  || a->real_value != d->real_value
+	  || a->coord_value != d->coord_value);
+}
+
+/*!
+ * \brief Give an option set on the command line to every exporter of the
+ * list that has one of that name and type, not only the one it was
+ * parsed into.
+ */
+static void
+share_export_options (void)
+{
+  ExportJobType *from, *to;
+  HID_Attribute *a, *b;
+  int i, j, k, l;
+
+  for (i = 0; i < n_export_jobs; i++)
+    for (from = &export_jobs[i], j = 0; j < from->n; j++)
+      {
+	if (!export_option_set (from, j))
+	  continue;
+	a = &from->attributes[j];
+	for (k = 0; k < n_export_jobs; k++)
+	  for (to = &export_jobs[k], l = 0; k != i && l < to->n; l++)
+	    {
+	      b = &to->attributes[l];
+	      if (b->type == a->type && strcmp (b->name, a->name) == 0
+		  && !export_option_set (to, l))
+		b->default_val = a->default_val;
+	    }
+      }
+}
+
+static void
+run_export_job (ExportJobType *job)
+{
+  exporter = gui = job->hid;
+  PROFILE_BEGIN (PROFILE_EXPORT);
+  gui->do_export (0);
+  PROFILE_END (PROFILE_EXPORT);
+}
+
+static int
+export_job_worker (int part, FILE *fp, void *data)
+{
+  run_export_job (&export_jobs[part]);
+  fprintf (fp, "%d\n", export_failures);
+  fflush (NULL);
+  return 0;
+}
+
+/*!
+ * \brief Take in the export_failures of a worker, or run its exporter
+ * here if fp is NULL.
+ */
+static bool
+export_job_here (int part, FILE *fp, void *data)
+{
+  int failures;
+
+  if (fp == NULL)
+    run_export_job (&export_jobs[part]);
+  else if (fscanf (fp, "%d", &failures) == 1)
+    export_failures += failures;
+  else
+    return false;
+  return true;
+}
+
+/*!
+ * \brief Run the exporters of the list on the loaded board.
+ *
+ * With --export-jobs above 1, that many at a time run in worker
+ * processes, which have a copy of the board each.  An exporter that
+ * cannot be given to a worker, or whose worker fails, runs in pcb
+ * itself.  Each worker hands back the export_failures of its exporter.
+ */
+static void
+run_export_list (void)
+{
+  pcb_fork_workers (n_export_jobs,
+		    Settings.ExportJobs > 1 ? Settings.ExportJobs : 0, -1,
+		    true, export_job_worker, export_job_here, NULL);
+}
+
+/* ----------------------------------------------------------------------
  * main program
  */
 
@@ -2008,9 +2434,11 @@ main (int argc, char *argv[])
 
   initialize_units();
   polygon_init ();
+  TIMING_BEGIN (TIMING_HID);
   hid_init ();
 
   hid_load_settings ();
+  TIMING_END (TIMING_HID);
 
   program_name = argv[0];
   program_basename = strrchr (program_name, PCB_DIR_SEPARATOR_C);
@@ -2044,7 +2472,7 @@ main (int argc, char *argv[])
     }
   else if (argc > 2 && strcmp (argv[1], "-x") == 0)
     {
-      exporter = gui = hid_find_exporter (argv[2]);
+      exporter = gui = find_export_list (argv[2]);
       argc -= 2;
       argv += 2;
     }
@@ -2066,7 +2494,12 @@ main (int argc, char *argv[])
       Settings.LayerSelectedColor[i] = "#00ffff";
     }
 
+  TIMING_BEGIN (TIMING_OPTIONS);
+  if (n_export_jobs > 1)
+    register_export_list ();
   gui->parse_arguments (&argc, &argv);
+  if (n_export_jobs > 1)
+    share_export_options ();
 
   if (show_help || (argc > 1 && argv[1][0] == '-'))
     usage ();
@@ -2078,6 +2511,7 @@ main (int argc, char *argv[])
     copyright ();
 
   settings_post_process ();
+  TIMING_END (TIMING_OPTIONS);
 
 
   if (show_actions)
@@ -2145,10 +2579,11 @@ main (int argc, char *argv[])
    */
   atexit (EmergencySave);
 
-  /* read the library file and display it if it's not empty
+  /* read the library file and display it if it's not empty.  Export
+   * runs only read it if a script or action looks up a footprint.
    */
-  if (!ReadLibraryContents () && Library.MenuN)
-    hid_action ("LibraryChanged");
+  if (!gui->printer && !gui->exporter)
+    LoadLibraryOnDemand ();
 
 #ifdef HAVE_LIBSTROKE
   stroke_init ();
@@ -2166,10 +2601,28 @@ main (int argc, char *argv[])
       hid_parse_actions (Settings.ActionString);
     }
 
+  if (Settings.Timing)
+    TimingReport ();
+
+  if (n_export_jobs > 1)
+    {
+      run_export_list ();
+      if (Settings.CopperStatsFile && *Settings.CopperStatsFile)
+	CopperStats (Settings.CopperStatsFile, COPPER_STATS_CELL);
+      if (Settings.MemStats)
+	MemoryReport ();
+      exit (export_failures ? 1 : 0);
+    }
   if (gui->printer || gui->exporter)
     {
+      PROFILE_BEGIN (PROFILE_EXPORT);
       gui->do_export (0);
-      exit (0);
+      PROFILE_END (PROFILE_EXPORT);
+      if (Settings.CopperStatsFile && *Settings.CopperStatsFile)
+	CopperStats (Settings.CopperStatsFile, COPPER_STATS_CELL);
+      if (Settings.MemStats)
+	MemoryReport ();
+      exit (export_failures ? 1 : 0);
     }
 
 #if HAVE_DBUS
@@ -2200,6 +2653,9 @@ main (int argc, char *argv[])
   pcb_dbus_finish();
 #endif
 
+  if (Settings.MemStats)
+    MemoryReport ();
+
   pcb_main_uninit ();
 
   return (0);
@@ -0,0 +1,309 @@
+/*!
+ * \file src/memstats.c
+ *
+ * \brief Accounting of the memory the board and its caches take, for
+ * MemoryReport() and --mem-stats.
+ *
+ * The report is made by walking the structures when it is asked for, so
+ * keeping it costs nothing in between.  The bytes are those of the
+ * structures and their arrays; names, attributes and the overhead of
+ * the allocator are not counted.  The heap in use is reported next to
+ * the total, when the C library can tell it, to show how much that
+ * leaves unaccounted.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#include "global.h"
+#include "data.h"
+#include "error.h"
+#include "macro.h"
+#include "memstats.h"
+#include "rtree.h"
+#include "undo.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+enum
+{
+  MEM_OBJECTS,
+  MEM_RTREES,
+  MEM_CONTOURS,
+  MEM_UNDO,
+  MEM_RATS,
+  MEM_LIBRARY,
+  MEM_ROWS
+};
+
+static const char *row_names[MEM_ROWS] = {
+  "objects", "rtrees", "contours", "undo", "rats", "library"
+};
+
+static const char *row_units[MEM_ROWS] = {
+  "objects", "entries", "contours", "entries", "rats", "entries"
+};
+
+typedef struct
+{
+  long count;
+  size_t bytes;
+} MemRow;
+
+/* the largest of each row, and of the total, over the reports so far */
+static MemRow peak[MEM_ROWS];
+static size_t peak_total;
+
+static size_t
+tree_bytes (rtree_t * tree, long *entries)
+{
+  if (tree == NULL)
+    return 0;
+  *entries += tree->size;
+  return r_memory (tree);
+}
+
+static void
+count_trees (DataType * data, MemRow * row)
+{
+  int i;
+
+  row->bytes += tree_bytes (data->via_tree, &row->count);
+  row->bytes += tree_bytes (data->element_tree, &row->count);
+  row->bytes += tree_bytes (data->pin_tree, &row->count);
+  row->bytes += tree_bytes (data->pad_tree, &row->count);
+  row->bytes += tree_bytes (data->rat_tree, &row->count);
+  for (i = 0; i < 3; i++)
+    row->bytes += tree_bytes (data->name_tree[i], &row->count);
+  for (i = 0; i < max_copper_layer + SILK_LAYER; i++)
+    {
+      LayerType *layer = &data->Layer[i];
+
+      row->bytes += tree_bytes (layer->line_tree, &row->count);
+      row->bytes += tree_bytes (layer->arc_tree, &row->count);
+      row->bytes += tree_bytes (layer->text_tree, &row->count);
+      row->bytes += tree_bytes (layer->polygon_tree, &row->count);
+    }
+}
+
+/*!
+ * \brief Count the objects of data, each with the link of its list.
+ *
+ * The clipped contours of the polygons go to their own row.
+ */
+static void
+count_objects (DataType * data, MemRow * row, MemRow * contours)
+{
+  size_t link = sizeof (GList);
+
+  row->count += data->ViaN;
+  row->bytes += data->ViaN * (sizeof (PinType) + link);
+  ELEMENT_LOOP (data);
+  {
+    row->count += 1 + element->PinN + element->PadN + element->LineN
+      + element->ArcN;
+    row->bytes += sizeof (ElementType) + link
+      + element->PinN * (sizeof (PinType) + link)
+      + element->PadN * (sizeof (PadType) + link)
+      + element->LineN * (sizeof (LineType) + link)
+      + element->ArcN * (sizeof (ArcType) + link);
+  }
+  END_LOOP;
+  ALLLINE_LOOP (data);
+  {
+    row->count++;
+    row->bytes += sizeof (LineType) + link;
+  }
+  ENDALL_LOOP;
+  ALLARC_LOOP (data);
+  {
+    row->count++;
+    row->bytes += sizeof (ArcType) + link;
+  }
+  ENDALL_LOOP;
+  ALLTEXT_LOOP (data);
+  {
+    row->count++;
+    row->bytes += sizeof (TextType) + link;
+  }
+  ENDALL_LOOP;
+  ALLPOLYGON_LOOP (data);
+  {
+    row->count++;
+    row->bytes += sizeof (PolygonType) + link
+      + polygon->PointMax * sizeof (PointType)
+      + polygon->HoleIndexMax * sizeof (Cardinal);
+    contours->bytes += poly_Memory (polygon->Clipped, &contours->count);
+    contours->bytes += poly_ContourMemory (polygon->NoHoles,
+					   &contours->count);
+  }
+  ENDALL_LOOP;
+}
+
+static void
+count_library (LibraryType * lib, MemRow * row)
+{
+  Cardinal i, j;
+
+  row->bytes += lib->MenuMax * sizeof (LibraryMenuType);
+  for (i = 0; i < lib->MenuN; i++)
+    {
+      LibraryMenuType *menu = &lib->Menu[i];
+
+      row->count += menu->EntryN;
+      row->bytes += menu->EntryMax * sizeof (LibraryEntryType);
+      for (j = 0; j < menu->EntryN; j++)
+	if (menu->Entry[j].AllocatedMemory)
+	  row->bytes += strlen (menu->Entry[j].AllocatedMemory) + 1;
+    }
+}
+
+/*!
+ * \brief Bytes of heap in use, or 0 if the C library can't tell.
+ */
+size_t
+MemoryHeapInUse (void)
+{
+#ifdef HAVE_MALLINFO2
+  struct mallinfo2 mi = mallinfo2 ();
+
+  return mi.uordblks + mi.hblkhd;
+#else
+  return 0;
+#endif
+}
+
+/*!
+ * \brief Peak resident size of the process in kB, or 0 if unknown.
+ */
+long
+MemoryPeakResident (void)
+{
+#ifdef HAVE_GETRUSAGE
+  struct rusage ru;
+
+  if (getrusage (RUSAGE_SELF, &ru) == 0)
+    return ru.ru_maxrss;
+#endif
+  return 0;
+}
+
+#define MB(bytes) ((bytes) / (1024.0 * 1024.0))
+
+/*!
+ * \brief Write the memory report of the board to the log.
+ */
+void
+MemoryReport (void)
+{
+  MemRow rows[MEM_ROWS];
+  size_t undo_entries, total = 0, heap;
+  Cardinal removed;
+  long rss;
+  int i;
+
+  memset (rows, 0, sizeof (rows));
+  count_objects (PCB->Data, &rows[MEM_OBJECTS], &rows[MEM_CONTOURS]);
+  count_trees (PCB->Data, &rows[MEM_RTREES]);
+  rows[MEM_UNDO].bytes = UndoMemory (&undo_entries, &removed);
+  rows[MEM_UNDO].count = undo_entries;
+  rows[MEM_RATS].count = PCB->Data->RatN;
+  rows[MEM_RATS].bytes = PCB->Data->RatN * (sizeof (RatType) + sizeof (GList));
+  count_library (&Library, &rows[MEM_LIBRARY]);
+  count_library (&PCB->NetlistLib, &rows[MEM_LIBRARY]);
+
+  Message (_("Memory use:\n"));
+  for (i = 0; i < MEM_ROWS; i++)
+    {
+      total += rows[i].bytes;
+      MAKEMAX (peak[i].count, rows[i].count);
+      MAKEMAX (peak[i].bytes, rows[i].bytes);
+      Message (_("  %-8s %10ld %-8s %10.1f MB, peak %10.1f MB\n"),
+	       row_names[i], rows[i].count, row_units[i], MB (rows[i].bytes),
+	       MB (peak[i].bytes));
+    }
+  MAKEMAX (peak_total, total);
+  Message (_("  %u objects kept for undo\n"), removed);
+  Message (_("  total %.1f MB, peak %.1f MB\n"), MB (total),
+	   MB (peak_total));
+  heap = MemoryHeapInUse ();
+  if (heap)
+    Message (_("  heap in use %.1f MB\n"), MB (heap));
+  rss = MemoryPeakResident ();
+  if (rss)
+    Message (_("  peak resident size %.1f MB\n"), rss / 1024.0);
+}
+
+static const char memoryreport_syntax[] = "MemoryReport()";
+
+static const char memoryreport_help[] =
+  "Report the memory the board takes.";
+
+/* %start-doc actions MemoryReport
+
+Writes to the log the number and the bytes of the objects of the board,
+the r-trees indexing them, the clipped contours of the polygons, the
+undo list, the rat lines and the library and netlist entries, and the
+largest each has been over the reports made so far.  The heap in use
+and the peak resident size of pcb follow, where the system can tell
+them.
+
+The bytes are those of the structures and their arrays: names,
+attributes and the overhead of the allocator aren't counted, which the
+heap in use shows.
+
+@code{--mem-stats} makes the same report when pcb exits.
+
+%end-doc */
+
+static int
+ActionMemoryReport (int argc, char **argv, Coord x, Coord y)
+{
+  if (argc > 0)
+    AFAIL (memoryreport);
+  MemoryReport ();
+  return 0;
+}
+
+HID_Action memstats_action_list[] = {
+  {"MemoryReport", 0, ActionMemoryReport,
+   memoryreport_help, memoryreport_syntax}
+};
+
+REGISTER_ACTIONS (memstats_action_list)
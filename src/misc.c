@@ -74,6 +74,7 @@
 #include "rotate.h"
 #include "rubberband.h"
 #include "search.h"
+#include "segtable.h"
 #include "set.h"
 #include "undo.h"
 #include "action.h"
@@ -396,7 +397,7 @@ SetElementBoundingBox (DataType *Data, ElementType *Element,
       r_delete_entry (Data->name_tree[n], (BoxType *) text);
     SetTextBoundingBox (Font, text);
     if (Data && !Data->name_tree[n])
-      Data->name_tree[n] = r_create_tree (NULL, 0, 0);
+      Data->name_tree[n] = r_create_data_tree ();
     if (Data)
       r_insert_entry (Data->name_tree[n], (BoxType *) text, 0);
   }
@@ -440,7 +441,7 @@ SetElementBoundingBox (DataType *Data, ElementType *Element,
     if (Data)
       {
         if (!Data->pin_tree)
-          Data->pin_tree = r_create_tree (NULL, 0, 0);
+          Data->pin_tree = r_create_data_tree ();
         r_insert_entry (Data->pin_tree, (BoxType *) pin, 0);
       }
     MAKEMIN (box->X1, pin->BoundingBox.X1);
@@ -461,7 +462,7 @@ SetElementBoundingBox (DataType *Data, ElementType *Element,
     if (Data)
       {
         if (!Data->pad_tree)
-          Data->pad_tree = r_create_tree (NULL, 0, 0);
+          Data->pad_tree = r_create_data_tree ();
         r_insert_entry (Data->pad_tree, (BoxType *) pad, 0);
       }
     MAKEMIN (box->X1, pad->BoundingBox.X1);
@@ -522,7 +523,7 @@ SetElementBoundingBox (DataType *Data, ElementType *Element,
   close_box(box);
   close_box(vbox);
   if (Data && !Data->element_tree)
-    Data->element_tree = r_create_tree (NULL, 0, 0);
+    Data->element_tree = r_create_data_tree ();
   if (Data)
     r_insert_entry (Data->element_tree, box, 0);
 }
@@ -790,16 +791,44 @@ CountHolesEx (int *plated, int *unplated, const BoxType *within_area, Cardinal g
   if (unplated != NULL) *unplated = hcs.nunplated;
 }
 
+/*!
+ * \brief Extend a box by the bounding boxes in a tree, if the tree holds
+ * all n of the objects.
+ *
+ * \return false if it does not, and the objects have to be looked at.
+ */
+static bool
+TreeBounds (rtree_t *tree, Cardinal n, BoxType *box)
+{
+  if (n == 0)
+    return true;
+  if (tree == NULL || tree->size != n)
+    return false;
+  r_extend_bounds (tree, box);
+  return true;
+}
+
 /*!
  * \brief Gets minimum and maximum coordinates.
  *
+ * The elements, arcs, texts and polygons are measured by the bounding
+ * boxes of their search trees.  The result for the board is kept until
+ * the next change to a search tree, so exporters and zooms asking again
+ * get it for free.
+ *
  * \return NULL if layout is empty.
  */
 BoxType *
 GetDataBoundingBox (DataType *Data)
 {
   static BoxType box;
-  /* FIX ME: use r_search to do this much faster */
+  static DataType *cached_data = NULL;
+  static unsigned long cached_generation;
+  static bool cached_empty;
+  Cardinal l;
+
+  if (Data == cached_data && r_generation () == cached_generation)
+    return (cached_empty ? NULL : &box);
 
   /* preset identifiers with highest and lowest possible values */
   box.X1 = box.Y1 = MAX_COORD;
@@ -814,58 +843,85 @@ GetDataBoundingBox (DataType *Data)
     box.Y2 = MAX (box.Y2, via->Y + via->Thickness / 2);
   }
   END_LOOP;
-  ELEMENT_LOOP (Data);
-  {
-    box.X1 = MIN (box.X1, element->BoundingBox.X1);
-    box.Y1 = MIN (box.Y1, element->BoundingBox.Y1);
-    box.X2 = MAX (box.X2, element->BoundingBox.X2);
-    box.Y2 = MAX (box.Y2, element->BoundingBox.Y2);
-    {
-      TextType *text = &NAMEONPCB_TEXT (element);
-      box.X1 = MIN (box.X1, text->BoundingBox.X1);
-      box.Y1 = MIN (box.Y1, text->BoundingBox.Y1);
-      box.X2 = MAX (box.X2, text->BoundingBox.X2);
-      box.Y2 = MAX (box.Y2, text->BoundingBox.Y2);
-    };
-  }
-  END_LOOP;
-  ALLLINE_LOOP (Data);
-  {
-    box.X1 = MIN (box.X1, line->Point1.X - line->Thickness / 2);
-    box.Y1 = MIN (box.Y1, line->Point1.Y - line->Thickness / 2);
-    box.X1 = MIN (box.X1, line->Point2.X - line->Thickness / 2);
-    box.Y1 = MIN (box.Y1, line->Point2.Y - line->Thickness / 2);
-    box.X2 = MAX (box.X2, line->Point1.X + line->Thickness / 2);
-    box.Y2 = MAX (box.Y2, line->Point1.Y + line->Thickness / 2);
-    box.X2 = MAX (box.X2, line->Point2.X + line->Thickness / 2);
-    box.Y2 = MAX (box.Y2, line->Point2.Y + line->Thickness / 2);
-  }
-  ENDALL_LOOP;
-  ALLARC_LOOP (Data);
-  {
-    box.X1 = MIN (box.X1, arc->BoundingBox.X1);
-    box.Y1 = MIN (box.Y1, arc->BoundingBox.Y1);
-    box.X2 = MAX (box.X2, arc->BoundingBox.X2);
-    box.Y2 = MAX (box.Y2, arc->BoundingBox.Y2);
-  }
-  ENDALL_LOOP;
-  ALLTEXT_LOOP (Data);
-  {
-    box.X1 = MIN (box.X1, text->BoundingBox.X1);
-    box.Y1 = MIN (box.Y1, text->BoundingBox.Y1);
-    box.X2 = MAX (box.X2, text->BoundingBox.X2);
-    box.Y2 = MAX (box.Y2, text->BoundingBox.Y2);
-  }
-  ENDALL_LOOP;
-  ALLPOLYGON_LOOP (Data);
-  {
-    box.X1 = MIN (box.X1, polygon->BoundingBox.X1);
-    box.Y1 = MIN (box.Y1, polygon->BoundingBox.Y1);
-    box.X2 = MAX (box.X2, polygon->BoundingBox.X2);
-    box.Y2 = MAX (box.Y2, polygon->BoundingBox.Y2);
-  }
-  ENDALL_LOOP;
-  return (IsDataEmpty (Data) ? NULL : &box);
+  if (!TreeBounds (Data->element_tree, Data->ElementN, &box)
+      || !TreeBounds (Data->name_tree[NAMEONPCB_INDEX], Data->ElementN, &box))
+    ELEMENT_LOOP (Data);
+    {
+      box.X1 = MIN (box.X1, element->BoundingBox.X1);
+      box.Y1 = MIN (box.Y1, element->BoundingBox.Y1);
+      box.X2 = MAX (box.X2, element->BoundingBox.X2);
+      box.Y2 = MAX (box.Y2, element->BoundingBox.Y2);
+      {
+	TextType *text = &NAMEONPCB_TEXT (element);
+	box.X1 = MIN (box.X1, text->BoundingBox.X1);
+	box.Y1 = MIN (box.Y1, text->BoundingBox.Y1);
+	box.X2 = MAX (box.X2, text->BoundingBox.X2);
+	box.Y2 = MAX (box.Y2, text->BoundingBox.Y2);
+      };
+    }
+    END_LOOP;
+  if (Data == PCB->Data)
+    {
+      for (l = 0; l < max_copper_layer + SILK_LAYER; l++)
+	SegmentTableBounds (GetSegmentTable (l), &box);
+    }
+  else
+    {
+      ALLLINE_LOOP (Data);
+      {
+	box.X1 = MIN (box.X1, line->Point1.X - line->Thickness / 2);
+	box.Y1 = MIN (box.Y1, line->Point1.Y - line->Thickness / 2);
+	box.X1 = MIN (box.X1, line->Point2.X - line->Thickness / 2);
+	box.Y1 = MIN (box.Y1, line->Point2.Y - line->Thickness / 2);
+	box.X2 = MAX (box.X2, line->Point1.X + line->Thickness / 2);
+	box.Y2 = MAX (box.Y2, line->Point1.Y + line->Thickness / 2);
+	box.X2 = MAX (box.X2, line->Point2.X + line->Thickness / 2);
+	box.Y2 = MAX (box.Y2, line->Point2.Y + line->Thickness / 2);
+      }
+      ENDALL_LOOP;
+    }
+  for (l = 0; l < max_copper_layer + SILK_LAYER; l++)
+    {
+      LayerType *layer = &Data->Layer[l];
+
+      if (!TreeBounds (layer->arc_tree, layer->ArcN, &box))
+	ARC_LOOP (layer);
+	{
+	  box.X1 = MIN (box.X1, arc->BoundingBox.X1);
+	  box.Y1 = MIN (box.Y1, arc->BoundingBox.Y1);
+	  box.X2 = MAX (box.X2, arc->BoundingBox.X2);
+	  box.Y2 = MAX (box.Y2, arc->BoundingBox.Y2);
+	}
+	END_LOOP;
+      if (!TreeBounds (layer->text_tree, layer->TextN, &box))
+	TEXT_LOOP (layer);
+	{
+	  box.X1 = MIN (box.X1, text->BoundingBox.X1);
+	  box.Y1 = MIN (box.Y1, text->BoundingBox.Y1);
+	  box.X2 = MAX (box.X2, text->BoundingBox.X2);
+	  box.Y2 = MAX (box.Y2, text->BoundingBox.Y2);
+	}
+	END_LOOP;
+      if (!TreeBounds (layer->polygon_tree, layer->PolygonN, &box))
+	POLYGON_LOOP (layer);
+	{
+	  box.X1 = MIN (box.X1, polygon->BoundingBox.X1);
+	  box.Y1 = MIN (box.Y1, polygon->BoundingBox.Y1);
+	  box.X2 = MAX (box.X2, polygon->BoundingBox.X2);
+	  box.Y2 = MAX (box.Y2, polygon->BoundingBox.Y2);
+	}
+	END_LOOP;
+    }
+
+  cached_empty = IsDataEmpty (Data);
+  if (Data == PCB->Data)
+    {
+      cached_data = Data;
+      cached_generation = r_generation ();
+    }
+  else
+    cached_data = NULL;
+  return (cached_empty ? NULL : &box);
 }
 
 /*!
@@ -903,6 +959,7 @@ CenterDisplay (Coord X, Coord Y, bool warp_pointer)
 void
 SetFontInfo (FontType *Ptr)
 {
+  static unsigned int generation = 0;
   Cardinal i, j;
   SymbolType *symbol;
   LineType *line;
@@ -959,6 +1016,9 @@ SetFontInfo (FontType *Ptr)
           MOVE_LINE_LOWLEVEL (line, 0, -totalminy);
       }
 
+  /* what was drawn with the font before is out of date */
+  Ptr->Generation = ++generation;
+
   /* setup the box for the default symbol */
   Ptr->DefaultSymbol.X1 = Ptr->DefaultSymbol.Y1 = 0;
   Ptr->DefaultSymbol.X2 = Ptr->DefaultSymbol.X1 + Ptr->MaxWidth;
@@ -1103,6 +1163,7 @@ ParseGroupString (char *group_string, LayerGroupType *LayerGroup, int *LayerN)
     s_set = false;              /* provide a default setting for old formats */
   int groupnum[MAX_ALL_LAYER];
 
+  LayerStackChanged ();
   *LayerN = 0;
 
   /* Deterimine the maximum layer number */
@@ -1614,11 +1675,40 @@ GetLayerGroupNumberByPointer (LayerType *Layer)
   return (GetLayerGroupNumberByNumber (GetLayerNumber (PCB->Data, Layer)));
 }
 
+#if MAX_GROUP > 32
+#error "the layer group masks of the vias need more than 32 bits"
+#endif
+
 /*!
- * \brief Returns the layergroup number for the passed layer number.
+ * \brief The layer stack as the lookups below see it.
+ *
+ * group_of[] has the group of each layer and span_mask[from][to] a bit
+ * for each group a via from layer from to layer to goes through.  They
+ * are rebuilt on the first lookup after LayerStackChanged(), or after
+ * another board or layer count comes in.
  */
-int
-GetLayerGroupNumberByNumber (Cardinal Layer)
+static struct
+{
+  unsigned long generation;
+  PCBType *pcb;
+  int groups;
+  int group_of[MAX_ALL_LAYER];
+  unsigned int span_mask[MAX_ALL_LAYER][MAX_ALL_LAYER];
+} layer_stack;
+
+static unsigned long layer_stack_generation = 1;
+
+/*!
+ * \brief Tell the layer group lookups that PCB->LayerGroups changed.
+ */
+void
+LayerStackChanged (void)
+{
+  layer_stack_generation++;
+}
+
+static int
+lookup_layer_group (Cardinal Layer)
 {
   int group, entry;
 
@@ -1633,6 +1723,45 @@ GetLayerGroupNumberByNumber (Cardinal Layer)
   return (group);
 }
 
+static void
+update_layer_stack (void)
+{
+  int from, to;
+
+  if (layer_stack.generation == layer_stack_generation
+      && layer_stack.pcb == PCB && layer_stack.groups == max_group)
+    return;
+
+  for (from = 0; from < MAX_ALL_LAYER; from++)
+    layer_stack.group_of[from] = lookup_layer_group (from);
+  for (from = 0; from < MAX_ALL_LAYER; from++)
+    {
+      unsigned int mask = 0;
+
+      for (to = 0; to < MAX_ALL_LAYER; to++)
+        {
+          if (to >= from && layer_stack.group_of[to] < MAX_GROUP)
+            mask |= 1u << layer_stack.group_of[to];
+          layer_stack.span_mask[from][to] = to >= from ? mask : 0;
+        }
+    }
+  layer_stack.generation = layer_stack_generation;
+  layer_stack.pcb = PCB;
+  layer_stack.groups = max_group;
+}
+
+/*!
+ * \brief Returns the layergroup number for the passed layer number.
+ */
+int
+GetLayerGroupNumberByNumber (Cardinal Layer)
+{
+  if (Layer >= MAX_ALL_LAYER)
+    return lookup_layer_group (Layer);
+  update_layer_stack ();
+  return layer_stack.group_of[Layer];
+}
+
 /*!
  * \brief Returns the layergroup number for the passed side (TOP_SIDE or
  * BOTTOM_SIDE).
@@ -2137,6 +2266,7 @@ MoveLayerToGroup (int layer, int group)
   /* Add layer to new group.  */
   i = PCB->LayerGroups.Number[group]++;
   PCB->LayerGroups.Entries[group][i] = layer;
+  LayerStackChanged ();
 
   return group;
 }
@@ -2407,6 +2537,22 @@ ChangeBuriedViasAfterLayerDelete (int index)
   RemoveDegradedVias ();
 }
 
+/*!
+ * \brief The layer groups a via goes through, a bit for each group.
+ *
+ * All bits are set for a through via.
+ */
+unsigned int
+ViaLayerGroupMask (PinType *via)
+{
+  if (!VIA_IS_BURIED (via))
+    return ~0u;
+  if (via->BuriedFrom >= MAX_ALL_LAYER || via->BuriedTo >= MAX_ALL_LAYER)
+    return 0;
+  update_layer_stack ();
+  return layer_stack.span_mask[via->BuriedFrom][via->BuriedTo];
+}
+
 /*!
  * \brief Check if via penetrates layer group
  *
@@ -2414,18 +2560,11 @@ ChangeBuriedViasAfterLayerDelete (int index)
 bool
 ViaIsOnLayerGroup (PinType *via, int group)
 {
-  Cardinal layer;
-
   if (!VIA_IS_BURIED (via))
     return true;
 
-  for (layer = via->BuriedFrom; layer <= via->BuriedTo; layer++)
-    {
-       if (GetLayerGroupNumberByNumber (layer) == group)
-         return true;
-    }
-
-  return false;
+  return group >= 0 && group < MAX_GROUP
+         && (ViaLayerGroupMask (via) & (1u << group));
 }
 
 /*!
@@ -2525,8 +2664,8 @@ AttributePutToList (AttributeListType *list, const char *name, const char *value
       for (i=0; i<list->Number; i++)
 	if (strcmp (name, list->List[i].name) == 0)
 	  {
-	    free (list->List[i].value);
-	    list->List[i].value = STRDUP (value);
+	    ReleaseString (list->List[i].value);
+	    list->List[i].value = ShareString (value);
 	    return 1;
 	  }
     }
@@ -2542,8 +2681,8 @@ AttributePutToList (AttributeListType *list, const char *name, const char *value
 
   /* Now add the new attribute.  */
   i = list->Number;
-  list->List[i].name = STRDUP (name);
-  list->List[i].value = STRDUP (value);
+  list->List[i].name = ShareString (name);
+  list->List[i].value = ShareString (value);
   list->Number ++;
   return 0;
 }
@@ -2558,8 +2697,8 @@ AttributeRemoveFromList(AttributeListType *list, char *name)
   for (i=0; i<list->Number; i++)
     if (strcmp (name, list->List[i].name) == 0)
       {
-	free (list->List[i].name);
-	free (list->List[i].value);
+	ReleaseString (list->List[i].name);
+	ReleaseString (list->List[i].value);
 	for (j=i; j<list->Number-1; j++)
 	  list->List[j] = list->List[j+1];
 	list->Number --;
@@ -80,6 +80,7 @@ void SaveOutputWindow (void);
 int GetLayerNumber (DataType *, LayerType *);
 int GetLayerGroupNumberByPointer (LayerType *);
 int GetLayerGroupNumberByNumber (Cardinal);
+void LayerStackChanged (void);
 int GetLayerGroupNumberBySide (int);
 int ChangeGroupVisibility (int, bool, bool);
 void LayerStringToLayerStack (char *);
@@ -92,6 +93,15 @@ void RestoreStackAndVisibility (void);
 char *GetWorkingDirectory (char *);
 void CreateQuotedString (DynamicStringType *, char *);
 BoxType * GetArcEnds (ArcType *);
+
+/*!
+ * \brief The start and the end point of an arc, from the end points
+ * SetArcBoundingBox() keeps: Point1 is the end at the lower of the
+ * normalised angles.
+ */
+#define ARC_START_POINT(a) ((a)->Delta < 0 ? &(a)->Point2 : &(a)->Point1)
+#define ARC_END_POINT(a)   ((a)->Delta < 0 ? &(a)->Point1 : &(a)->Point2)
+
 void ChangeArcAngles (LayerType *, ArcType *, Angle, Angle);
 char *UniqueElementName (DataType *, char *);
 void AttachForCopy (Coord, Coord);
@@ -132,6 +142,7 @@ bool IsLayerMoveSafe (int, int);
 void ChangeBuriedViasAfterLayerMove (int, int);
 void ChangeBuriedViasAfterLayerCreate (int);
 void ChangeBuriedViasAfterLayerDelete (int);
+unsigned int ViaLayerGroupMask (PinType *);
 bool ViaIsOnLayerGroup (PinType *, int);
 bool ViaIsOnAnyVisibleLayer (PinType *);
 void SanitizeBuriedVia (PinType *);
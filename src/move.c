@@ -436,13 +436,14 @@ MoveLineToLayerLowLevel (LayerType *Source, LineType *line,
 {
   r_delete_entry (Source->line_tree, (BoxType *)line);
 
-  Source->Line = g_list_remove (Source->Line, line);
+  Source->Line = RemoveFromObjectList (Source->Line, &Source->LineTail, line);
   Source->LineN --;
-  Destination->Line = g_list_append (Destination->Line, line);
+  Destination->Line = AppendToObjectList (Destination->Line,
+                                          &Destination->LineTail, line);
   Destination->LineN ++;
 
   if (!Destination->line_tree)
-    Destination->line_tree = r_create_tree (NULL, 0, 0);
+    Destination->line_tree = r_create_data_tree ();
   r_insert_entry (Destination->line_tree, (BoxType *)line, 0);
   return line;
 }
@@ -456,13 +457,14 @@ MoveArcToLayerLowLevel (LayerType *Source, ArcType *arc,
 {
   r_delete_entry (Source->arc_tree, (BoxType *)arc);
 
-  Source->Arc = g_list_remove (Source->Arc, arc);
+  Source->Arc = RemoveFromObjectList (Source->Arc, &Source->ArcTail, arc);
   Source->ArcN --;
-  Destination->Arc = g_list_append (Destination->Arc, arc);
+  Destination->Arc = AppendToObjectList (Destination->Arc,
+                                         &Destination->ArcTail, arc);
   Destination->ArcN ++;
 
   if (!Destination->arc_tree)
-    Destination->arc_tree = r_create_tree (NULL, 0, 0);
+    Destination->arc_tree = r_create_data_tree ();
   r_insert_entry (Destination->arc_tree, (BoxType *)arc, 0);
   return arc;
 }
@@ -650,9 +652,10 @@ MoveTextToLayerLowLevel (LayerType *Source, TextType *text,
   RestoreToPolygon (PCB->Data, TEXT_TYPE, Source, text);
   r_delete_entry (Source->text_tree, (BoxType *)text);
 
-  Source->Text = g_list_remove (Source->Text, text);
+  Source->Text = RemoveFromObjectList (Source->Text, &Source->TextTail, text);
   Source->TextN --;
-  Destination->Text = g_list_append (Destination->Text, text);
+  Destination->Text = AppendToObjectList (Destination->Text,
+                                          &Destination->TextTail, text);
   Destination->TextN ++;
 
   if (GetLayerGroupNumberBySide (BOTTOM_SIDE) ==
@@ -664,7 +667,7 @@ MoveTextToLayerLowLevel (LayerType *Source, TextType *text,
   /* re-calculate the bounding box (it could be mirrored now) */
   SetTextBoundingBox (&PCB->Font, text);
   if (!Destination->text_tree)
-    Destination->text_tree = r_create_tree (NULL, 0, 0);
+    Destination->text_tree = r_create_data_tree ();
   r_insert_entry (Destination->text_tree, (BoxType *)text, 0);
   ClearFromPolygon (PCB->Data, TEXT_TYPE, Destination, text);
 
@@ -705,13 +708,15 @@ MovePolygonToLayerLowLevel (LayerType *Source, PolygonType *polygon,
 {
   r_delete_entry (Source->polygon_tree, (BoxType *)polygon);
 
-  Source->Polygon = g_list_remove (Source->Polygon, polygon);
+  Source->Polygon = RemoveFromObjectList (Source->Polygon,
+                                          &Source->PolygonTail, polygon);
   Source->PolygonN --;
-  Destination->Polygon = g_list_append (Destination->Polygon, polygon);
+  Destination->Polygon = AppendToObjectList (Destination->Polygon,
+                                             &Destination->PolygonTail, polygon);
   Destination->PolygonN ++;
 
   if (!Destination->polygon_tree)
-    Destination->polygon_tree = r_create_tree (NULL, 0, 0);
+    Destination->polygon_tree = r_create_data_tree ();
   r_insert_entry (Destination->polygon_tree, (BoxType *)polygon, 0);
 
   return polygon;
@@ -810,6 +815,11 @@ MoveObjectAndRubberband (int Type, void *Ptr1, void *Ptr2, void *Ptr3,
   DeltaX = DX;
   DeltaY = DY;
 
+  /* the lines and the object are redrawn, and the polygons they touch
+     clipped, once they have all moved */
+  DeferDraw ();
+  DeferPolygonClipping ();
+
   /* move all the lines... and reset the counter */
   ptr = Crosshair.AttachedObject.Rubberband;
   while (Crosshair.AttachedObject.RubberbandN)
@@ -829,11 +839,17 @@ MoveObjectAndRubberband (int Type, void *Ptr1, void *Ptr2, void *Ptr3,
     }
 
   if (DX == 0 && DY == 0)
-    return (NULL);
+    ptr2 = NULL;
+  else
+    {
+      AddObjectToMoveUndoList (Type, Ptr1, Ptr2, Ptr3, DX, DY);
+      ptr2 = ObjectOperation (&MoveFunctions, Type, Ptr1, Ptr2, Ptr3);
+    }
 
-  AddObjectToMoveUndoList (Type, Ptr1, Ptr2, Ptr3, DX, DY);
-  ptr2 = ObjectOperation (&MoveFunctions, Type, Ptr1, Ptr2, Ptr3);
-  IncrementUndoSerialNumber ();
+  ResumePolygonClipping ();
+  ResumeDraw ();
+  if (DX != 0 || DY != 0)
+    IncrementUndoSerialNumber ();
   return (ptr2);
 }
 
@@ -850,6 +866,8 @@ MoveObjectToLayer (int Type, void *Ptr1, void *Ptr2, void *Ptr3,
   /* setup global identifiers */
   Dest = Target;
   MoreToCome = enmasse;
+  /* a silk object brings its flags onto the copper */
+  NOTE_FLAGS (TRACKED_FLAGS);
   result = ObjectOperation (&MoveToLayerFunctions, Type, Ptr1, Ptr2, Ptr3);
   IncrementUndoSerialNumber ();
   return (result);
@@ -867,6 +885,7 @@ MoveSelectedObjectsToLayer (LayerType *Target)
   /* setup global identifiers */
   Dest = Target;
   MoreToCome = true;
+  NOTE_FLAGS (TRACKED_FLAGS);
   changed = SelectedOperation (&MoveToLayerFunctions, true, ALL_TYPES);
   /* passing true to above operation causes Undoserial to auto-increment */
   return (changed);
@@ -947,6 +966,7 @@ MoveLayer (int old_index, int new_index)
   int saved_group;
 
   AddLayerChangeToUndoList (old_index, new_index);
+  IDIndexInvalidate ();
 
   if (old_index < -1 || old_index >= max_copper_layer)
     {
@@ -1098,6 +1118,7 @@ MoveLayer (int old_index, int new_index)
 		 &PCB->LayerGroups.Entries[g],
 		 (MAX_GROUP - g) * sizeof (PCB->LayerGroups.Entries[g]));
       }
+  LayerStackChanged ();
 
   hid_action ("LayersChanged");
   gui->invalidate_all ();
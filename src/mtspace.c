@@ -53,6 +53,7 @@
 #include <setjmp.h>
 
 #include "box.h"
+#include "data.h"
 #include "heap.h"
 #include "rtree.h"
 #include "mtspace.h"
@@ -73,16 +74,63 @@ typedef struct mtspacebox
 }
 mtspacebox_t;
 
+/*!
+ * \brief The boxes of a tile of an mtsgrid_t.
+ *
+ * The coordinates are kept in arrays of their own, and the arrays are
+ * filled up to a whole number of runs with boxes that touch nothing.
+ */
+typedef struct mtsbucket
+{
+  int n, max;
+  Coord *X1, *Y1, *X2, *Y2, *keepaway;
+  mtspacebox_t **box;
+}
+mtsbucket_t;
+
+/*!
+ * \brief A flat keep-away index of the boxes of one of the r-trees.
+ */
+typedef struct mtsgrid
+{
+  Coord X0, Y0, tile;
+  int cols, rows;
+  mtsbucket_t *bucket;
+  mtsbucket_t big;		/*!< boxes over too many tiles */
+}
+mtsgrid_t;
+
+/*!
+ * \brief The regions of a query box that are clear of the fixed
+ * space fillers.
+ *
+ * The box is the query box bloated by radius and keepaway, and the
+ * leaves are in the order qloop() found them.
+ */
+typedef struct mtscache_entry
+{
+  BoxType box;
+  Coord radius, keepaway;
+  int n;
+  BoxType leaf[1];
+}
+mtscache_entry_t;
+
 /*!
  * \brief This is an mtspace_t.
  *
  * \c rtrees keeping track of regions expanded by their required
  * clearance.
  * One for fixed, even, and odd.
+ * Each has a flat index of the same boxes for dense regions.
+ * The regions of query boxes clear of the fixed tree are kept in
+ * fcache, since the fixed boxes stay put while the router runs.
  */
 struct mtspace
 {
   rtree_t *ftree, *etree, *otree;
+  mtsgrid_t *fgrid, *egrid, *ogrid;
+  GHashTable *fcache;
 };
 
 typedef union
@@ -120,6 +168,281 @@ mtspace_create_box (const BoxType * box, Coord keepaway)
   return mtsb;
 }
 
+/* ---------------------------------------------------------------------------
+ * Flat keep-away index.
+ *
+ * Next to each r-tree the space fillers are kept in a grid of tiles over
+ * the board.  Each tile holds the boxes that reach into it, as plain
+ * arrays of their coordinates.  Where the r-tree would hand query_one()
+ * a lot of boxes in a small region to throw out one by one, qloop()
+ * scans the tiles instead.  The boxes are tested a run at a time with
+ * no branches, which the compiler can do with vector instructions.
+ */
+#define MTS_GRID_TILES 64	/* tiles along the longer side of the board */
+#define MTS_GRID_COVER 128	/* most tiles a box is kept in */
+#define MTS_GRID_SPAN 16	/* most tiles a query looks in */
+#define MTS_GRID_DENSE 32	/* fewest boxes to look at for the grid */
+#define MTS_GRID_RUN 8		/* boxes tested at once */
+
+static mtsgrid_t *
+grid_create (void)
+{
+  mtsgrid_t *grid = (mtsgrid_t *) calloc (1, sizeof (*grid));
+  Coord width = MAX (PCB->MaxWidth, 1), height = MAX (PCB->MaxHeight, 1);
+
+  grid->X0 = 0;
+  grid->Y0 = 0;
+  grid->tile = MAX (MAX (width, height) / MTS_GRID_TILES, 1);
+  grid->cols = width / grid->tile + 1;
+  grid->rows = height / grid->tile + 1;
+  grid->bucket =
+    (mtsbucket_t *) calloc (grid->cols * grid->rows, sizeof (mtsbucket_t));
+  return grid;
+}
+
+static void
+bucket_free (mtsbucket_t * b)
+{
+  free (b->X1);
+  free (b->Y1);
+  free (b->X2);
+  free (b->Y2);
+  free (b->keepaway);
+  free (b->box);
+}
+
+static void
+grid_destroy (mtsgrid_t ** gridp)
+{
+  mtsgrid_t *grid = *gridp;
+  int i;
+
+  for (i = 0; i < grid->cols * grid->rows; i++)
+    bucket_free (&grid->bucket[i]);
+  bucket_free (&grid->big);
+  free (grid->bucket);
+  free (grid);
+  *gridp = NULL;
+}
+
+/*!
+ * \brief Find the tiles a box reaches into.
+ *
+ * \return the number of them.
+ */
+static int
+grid_range (mtsgrid_t * grid, const BoxType * box,
+	    int *c1, int *r1, int *c2, int *r2)
+{
+  *c1 = MAX (0, MIN (grid->cols - 1, (box->X1 - grid->X0) / grid->tile));
+  *c2 = MAX (0, MIN (grid->cols - 1, (box->X2 - grid->X0) / grid->tile));
+  *r1 = MAX (0, MIN (grid->rows - 1, (box->Y1 - grid->Y0) / grid->tile));
+  *r2 = MAX (0, MIN (grid->rows - 1, (box->Y2 - grid->Y0) / grid->tile));
+  return (*c2 - *c1 + 1) * (*r2 - *r1 + 1);
+}
+
+static void
+bucket_pad (mtsbucket_t * b, int i)
+{
+  b->X1[i] = b->Y1[i] = MAX_COORD;
+  b->X2[i] = b->Y2[i] = -MAX_COORD;
+  b->keepaway[i] = 0;
+  b->box[i] = NULL;
+}
+
+static void
+bucket_add (mtsbucket_t * b, mtspacebox_t * mtsb)
+{
+  int i;
+
+  if (b->n == b->max)
+    {
+      b->max = b->max ? 2 * b->max : MTS_GRID_RUN;
+      b->X1 = (Coord *) realloc (b->X1, b->max * sizeof (Coord));
+      b->Y1 = (Coord *) realloc (b->Y1, b->max * sizeof (Coord));
+      b->X2 = (Coord *) realloc (b->X2, b->max * sizeof (Coord));
+      b->Y2 = (Coord *) realloc (b->Y2, b->max * sizeof (Coord));
+      b->keepaway = (Coord *) realloc (b->keepaway, b->max * sizeof (Coord));
+      b->box = (mtspacebox_t **) realloc (b->box,
+					  b->max * sizeof (mtspacebox_t *));
+      for (i = b->n; i < b->max; i++)
+	bucket_pad (b, i);
+    }
+  i = b->n++;
+  b->X1[i] = mtsb->box.X1;
+  b->Y1[i] = mtsb->box.Y1;
+  b->X2[i] = mtsb->box.X2;
+  b->Y2[i] = mtsb->box.Y2;
+  b->keepaway[i] = mtsb->keepaway;
+  b->box[i] = mtsb;
+}
+
+static void
+bucket_remove (mtsbucket_t * b, mtspacebox_t * mtsb)
+{
+  int i, last = b->n - 1;
+
+  for (i = 0; i < b->n; i++)
+    if (b->box[i] == mtsb)
+      {
+	b->X1[i] = b->X1[last];
+	b->Y1[i] = b->Y1[last];
+	b->X2[i] = b->X2[last];
+	b->Y2[i] = b->Y2[last];
+	b->keepaway[i] = b->keepaway[last];
+	b->box[i] = b->box[last];
+	bucket_pad (b, last);
+	b->n--;
+	return;
+      }
+  assert (0);			/* not in the tile?? */
+}
+
+static void
+grid_add (mtsgrid_t * grid, mtspacebox_t * mtsb)
+{
+  int c, r, c1, r1, c2, r2;
+
+  if (grid_range (grid, &mtsb->box, &c1, &r1, &c2, &r2) > MTS_GRID_COVER)
+    {
+      bucket_add (&grid->big, mtsb);
+      return;
+    }
+  for (r = r1; r <= r2; r++)
+    for (c = c1; c <= c2; c++)
+      bucket_add (&grid->bucket[r * grid->cols + c], mtsb);
+}
+
+static void
+grid_remove (mtsgrid_t * grid, mtspacebox_t * mtsb)
+{
+  int c, r, c1, r1, c2, r2;
+
+  if (grid_range (grid, &mtsb->box, &c1, &r1, &c2, &r2) > MTS_GRID_COVER)
+    {
+      bucket_remove (&grid->big, mtsb);
+      return;
+    }
+  for (r = r1; r <= r2; r++)
+    for (c = c1; c <= c2; c++)
+      bucket_remove (&grid->bucket[r * grid->cols + c], mtsb);
+}
+
+/*!
+ * \brief Find a box of a tile that a query box touches, with the test
+ * of query_one().
+ */
+static mtspacebox_t *
+bucket_touching (const mtsbucket_t * b, const BoxType * cbox, Coord keepaway)
+{
+  int i, j;
+  unsigned hits;
+  Coord shrink;
+
+  for (i = 0; i < b->n; i += MTS_GRID_RUN)
+    {
+      hits = 0;
+      for (j = 0; j < MTS_GRID_RUN; j++)
+	{
+	  shrink = MIN (keepaway, b->keepaway[i + j]);
+	  hits |= (unsigned) ((cbox->X1 + shrink < b->X2[i + j])
+			      & (cbox->X2 - shrink > b->X1[i + j])
+			      & (cbox->Y1 + shrink < b->Y2[i + j])
+			      & (cbox->Y2 - shrink > b->Y1[i + j])) << j;
+	}
+      if (hits)
+	for (j = 0; j < MTS_GRID_RUN; j++)
+	  if (hits & (1u << j))
+	    return b->box[i + j];
+    }
+  return NULL;
+}
+
+/*!
+ * \brief Decide whether a query box is to go by the grid.
+ *
+ * That is when it looks in a few tiles holding many boxes.
+ */
+static bool
+grid_is_dense (mtsgrid_t * grid, const BoxType * cbox)
+{
+  int c, r, c1, r1, c2, r2, n = grid->big.n;
+
+  if (grid_range (grid, cbox, &c1, &r1, &c2, &r2) > MTS_GRID_SPAN)
+    return false;
+  for (r = r1; r <= r2; r++)
+    for (c = c1; c <= c2; c++)
+      n += grid->bucket[r * grid->cols + c].n;
+  return n >= MTS_GRID_DENSE;
+}
+
+static mtspacebox_t *
+grid_touching (mtsgrid_t * grid, const BoxType * cbox, Coord keepaway)
+{
+  int c, r, c1, r1, c2, r2;
+  mtspacebox_t *mtsb;
+
+  grid_range (grid, cbox, &c1, &r1, &c2, &r2);
+  for (r = r1; r <= r2; r++)
+    for (c = c1; c <= c2; c++)
+      if ((mtsb = bucket_touching (&grid->bucket[r * grid->cols + c],
+				   cbox, keepaway)) != NULL)
+	return mtsb;
+  return bucket_touching (&grid->big, cbox, keepaway);
+}
+
+/* ---------------------------------------------------------------------------
+ * Fixed space cache.
+ *
+ * The autorouter asks for via sites in the same expansion areas over
+ * and over, in every pass and for every net that reaches them.  Whatever
+ * the routed boxes do, the part of such an area clear of the fixed
+ * boxes is always the same, so it is worked out once and kept.  Adding
+ * or removing a fixed box drops what was kept for the areas it touches.
+ */
+#define MTS_CACHE_LEAVES 256	/* most regions kept for a query box */
+
+static guint
+cache_hash (gconstpointer key)
+{
+  const mtscache_entry_t *e = (const mtscache_entry_t *) key;
+  guint h = (guint) e->box.X1;
+
+  h = h * 31 + (guint) e->box.Y1;
+  h = h * 31 + (guint) e->box.X2;
+  h = h * 31 + (guint) e->box.Y2;
+  h = h * 31 + (guint) e->radius;
+  return h * 31 + (guint) e->keepaway;
+}
+
+static gboolean
+cache_equal (gconstpointer a, gconstpointer b)
+{
+  const mtscache_entry_t *ea = (const mtscache_entry_t *) a;
+  const mtscache_entry_t *eb = (const mtscache_entry_t *) b;
+
+  return ea->box.X1 == eb->box.X1 && ea->box.Y1 == eb->box.Y1 &&
+    ea->box.X2 == eb->box.X2 && ea->box.Y2 == eb->box.Y2 &&
+    ea->radius == eb->radius && ea->keepaway == eb->keepaway;
+}
+
+static gboolean
+cache_touches (gpointer key, gpointer value, gpointer box)
+{
+  return box_intersect (&((mtscache_entry_t *) key)->box, (BoxType *) box);
+}
+
+/*!
+ * \brief Forget the regions of the query boxes a fixed box reaches.
+ */
+static void
+cache_invalidate (mtspace_t * mtspace, const BoxType * box)
+{
+  if (g_hash_table_size (mtspace->fcache) > 0)
+    g_hash_table_foreach_remove (mtspace->fcache, cache_touches,
+				 (gpointer) box);
+}
+
 /*!
  * \brief Create an "empty space" representation with a shrunken
  * boundary.
@@ -134,6 +457,11 @@ mtspace_create (void)
   mtspace->ftree = r_create_tree (NULL, 0, 0);
   mtspace->etree = r_create_tree (NULL, 0, 0);
   mtspace->otree = r_create_tree (NULL, 0, 0);
+  mtspace->fgrid = grid_create ();
+  mtspace->egrid = grid_create ();
+  mtspace->ogrid = grid_create ();
+  mtspace->fcache = g_hash_table_new_full (cache_hash, cache_equal,
+					   NULL, free);
   /* done! */
   return mtspace;
 }
@@ -148,6 +476,10 @@ mtspace_destroy (mtspace_t ** mtspacep)
   r_destroy_tree (&(*mtspacep)->ftree);
   r_destroy_tree (&(*mtspacep)->etree);
   r_destroy_tree (&(*mtspacep)->otree);
+  grid_destroy (&(*mtspacep)->fgrid);
+  grid_destroy (&(*mtspacep)->egrid);
+  grid_destroy (&(*mtspacep)->ogrid);
+  g_hash_table_destroy ((*mtspacep)->fcache);
   free (*mtspacep);
   *mtspacep = NULL;
 }
@@ -157,6 +489,7 @@ struct mts_info
   Coord keepaway;
   BoxType box;
   rtree_t *tree;
+  mtsgrid_t *grid;
   jmp_buf env;
 };
 
@@ -172,6 +505,7 @@ mts_remove_one (const BoxType * b, void *cl)
       b->Y1 == info->box.Y1 && b->Y2 == info->box.Y2 &&
       box->keepaway == info->keepaway)
     {
+      grid_remove (info->grid, box);
       r_delete_entry (info->tree, b);
       longjmp (info->env, 1);
     }
@@ -192,6 +526,20 @@ which_tree (mtspace_t * mtspace, mtspace_type_t which)
     }
 }
 
+static mtsgrid_t *
+which_grid (mtspace_t * mtspace, mtspace_type_t which)
+{
+  switch (which)
+    {
+    case FIXED:
+      return mtspace->fgrid;
+    case EVEN:
+      return mtspace->egrid;
+    default:
+      return mtspace->ogrid;
+    }
+}
+
 /*!
  * \brief Add a space-filler to the empty space representation.
  *
@@ -203,7 +551,10 @@ mtspace_add (mtspace_t * mtspace, const BoxType * box, mtspace_type_t which,
 	     Coord keepaway)
 {
   mtspacebox_t *filler = mtspace_create_box (box, keepaway);
+  if (which == FIXED)
+    cache_invalidate (mtspace, box);
   r_insert_entry (which_tree (mtspace, which), (const BoxType *) filler, 1);
+  grid_add (which_grid (mtspace, which), filler);
 }
 
 /*!
@@ -223,12 +574,15 @@ mtspace_remove (mtspace_t * mtspace,
   cl.keepaway = keepaway;
   cl.box = *box;
   cl.tree = which_tree (mtspace, which);
+  cl.grid = which_grid (mtspace, which);
   small_search = box_center(box);
   if (setjmp (cl.env) == 0)
     {
       r_search (cl.tree, &small_search, NULL, mts_remove_one, &cl);
       assert (0);		/* didn't find it?? */
     }
+  if (which == FIXED)
+    cache_invalidate (mtspace, box);
 }
 
 struct query_closure
@@ -261,31 +615,15 @@ append (struct query_closure * qc, BoxType *newone)
 }
 
 /*!
- * \brief We found some space filler that may intersect this query.
- *
- * First check if it does intersect, then break it into overlaping
- * regions that don't intersect this box.
+ * \brief Break the query box into overlapping regions that don't touch
+ * the space filler it touches.
  */
-static int
-query_one (const BoxType * box, void *cl)
+static void
+split_one (struct query_closure *qc, mtspacebox_t * mtsb)
 {
-  struct query_closure *qc = (struct query_closure *) cl;
-  mtspacebox_t *mtsb = (mtspacebox_t *) box;
-  Coord shrink;
-  assert (box_intersect (qc->cbox, &mtsb->box));
-  /* we need to satisfy the larger of the two keepaways */
-  if (qc->keepaway > mtsb->keepaway)
-    shrink = mtsb->keepaway;
-  else
-    shrink = qc->keepaway;
-  /* if we shrink qc->box by this amount and it doesn't intersect
-   * then we didn't actually touch this box */
-  if (qc->cbox->X1 + shrink >= mtsb->box.X2 ||
-      qc->cbox->X2 - shrink <= mtsb->box.X1 ||
-      qc->cbox->Y1 + shrink >= mtsb->box.Y2 ||
-      qc->cbox->Y2 - shrink <= mtsb->box.Y1)
-    return 0;
-  /* ok, we do touch this box, now create up to 4 boxes that don't */
+  Coord shrink = MIN (qc->keepaway, mtsb->keepaway);
+
+  /* create up to 4 boxes that don't touch it */
   if (mtsb->box.Y1 > qc->cbox->Y1 + shrink)	/* top region exists */
     {
       Coord Y1 = qc->cbox->Y1;
@@ -356,6 +694,35 @@ query_one (const BoxType * box, void *cl)
     }
   else
     free (qc->cbox);		/* done with this one */
+}
+
+/*!
+ * \brief We found some space filler that may intersect this query.
+ *
+ * First check if it does intersect, then break it into overlaping
+ * regions that don't intersect this box.
+ */
+static int
+query_one (const BoxType * box, void *cl)
+{
+  struct query_closure *qc = (struct query_closure *) cl;
+  mtspacebox_t *mtsb = (mtspacebox_t *) box;
+  Coord shrink;
+  assert (box_intersect (qc->cbox, &mtsb->box));
+  /* we need to satisfy the larger of the two keepaways */
+  if (qc->keepaway > mtsb->keepaway)
+    shrink = mtsb->keepaway;
+  else
+    shrink = qc->keepaway;
+  /* if we shrink qc->box by this amount and it doesn't intersect
+   * then we didn't actually touch this box */
+  if (qc->cbox->X1 + shrink >= mtsb->box.X2 ||
+      qc->cbox->X2 - shrink <= mtsb->box.X1 ||
+      qc->cbox->Y1 + shrink >= mtsb->box.Y2 ||
+      qc->cbox->Y2 - shrink <= mtsb->box.Y1)
+    return 0;
+  /* ok, we do touch this box */
+  split_one (qc, mtsb);
   longjmp (qc->env, 1);
   return 1;			/* never reached */
 }
@@ -368,42 +735,139 @@ query_one (const BoxType * box, void *cl)
  * don't intersect that thing (if possible) which are put back into the
  * vector/heap of regions to check.
  *
+ * Where the region is dense with space fillers they are looked up in
+ * the flat index of the tree rather than searched for in the tree.
+ *
  * \return qloop returns false when it finds the first empty region.
  * It returns true if it has exhausted the region vector/heap and never
  * found an empty area.
  */
 static void
-qloop (struct query_closure *qc, rtree_t * tree, heap_or_vector res, bool is_vec)
+qloop (struct query_closure *qc, rtree_t * tree, mtsgrid_t * grid,
+       heap_or_vector res, bool is_vec)
 {
   BoxType *cbox;
+  mtspacebox_t *mtsb;
 #ifndef NDEBUG
   int n;
 #endif
   while (!(qc->desired ? heap_is_empty (qc->checking.h) : vector_is_empty (qc->checking.v)))
     {
       cbox = qc->desired ? (BoxType *)heap_remove_smallest (qc->checking.h) : (BoxType *)vector_remove_last (qc->checking.v);
-      if (setjmp (qc->env) == 0)
+      assert (box_is_good (cbox));
+      qc->cbox = cbox;
+      if (grid_is_dense (grid, cbox))
+	{
+	  if ((mtsb = grid_touching (grid, cbox, qc->keepaway)) != NULL)
+	    {
+	      split_one (qc, mtsb);
+	      continue;
+	    }
+	}
+      else if (setjmp (qc->env) == 0)
 	{
-	  assert (box_is_good (cbox));
-	  qc->cbox = cbox;
 #ifndef NDEBUG
 	  n =
 #endif
 	    r_search (tree, cbox, NULL, query_one, qc);
 	  assert (n == 0);
-	  /* nothing intersected with this tree, put it in the result vector */
-          if (is_vec)
+	}
+      else
+	continue;
+      /* nothing intersected with this tree, put it in the result vector */
+      if (is_vec)
+	vector_append (res.v, cbox);
+      else
+	{
+	  if (qc->desired)
+	    heap_append (res.h, qc->desired, cbox);
+	  else
 	    vector_append (res.v, cbox);
-          else
-            {
-              if (qc->desired)
-                heap_append (res.h, qc->desired, cbox);
-              else
-	        vector_append (res.v, cbox);
-            }
-	  return;		/* found one - perhaps one answer is good enough */
 	}
+      return;		/* found one - perhaps one answer is good enough */
+    }
+}
+
+static void
+add_no_fix (vetting_t * work, BoxType * box)
+{
+  if (work->desired.X != -SPECIAL || work->desired.Y != -SPECIAL)
+    heap_append (work->no_fix.h, &work->desired, box);
+  else
+    vector_append (work->no_fix.v, box);
+}
+
+static void
+add_untested (vetting_t * work, BoxType * box)
+{
+  if (work->desired.X != -SPECIAL || work->desired.Y != -SPECIAL)
+    heap_append (work->untested.h, &work->desired, box);
+  else
+    vector_append (work->untested.v, box);
+}
+
+/*!
+ * \brief Search a new query box against the fixed tree.
+ *
+ * The regions clear of the fixed boxes go to no_fix, taken from the
+ * cache when the same box was searched before.  Otherwise the search is
+ * run to the end and kept, unless it breaks the box into so many regions
+ * that it is left off and the rest handed back in untested.
+ */
+static void
+query_fixed (mtspace_t * mtspace, vetting_t * work, BoxType * cbox)
+{
+  mtscache_entry_t key, *e;
+  struct query_closure qc;
+  heap_or_vector found;
+  BoxType *leaf;
+  int i, n;
+
+  key.box = *cbox;
+  key.radius = work->radius;
+  key.keepaway = work->keepaway;
+  e = (mtscache_entry_t *) g_hash_table_lookup (mtspace->fcache, &key);
+  if (e)
+    {
+      free (cbox);
+      /* backwards, so that a vector hands them out in the order found */
+      for (i = e->n - 1; i >= 0; i--)
+	{
+	  leaf = (BoxType *) malloc (sizeof (BoxType));
+	  *leaf = e->leaf[i];
+	  add_no_fix (work, leaf);
+	}
+      return;
+    }
+
+  qc.keepaway = work->keepaway;
+  qc.radius = work->radius;
+  qc.desired = NULL;
+  qc.checking.v = vector_create ();
+  qc.touching.v = NULL;
+  found.v = vector_create ();
+  vector_append (qc.checking.v, cbox);
+  while (!vector_is_empty (qc.checking.v)
+	 && vector_size (found.v) <= MTS_CACHE_LEAVES)
+    qloop (&qc, mtspace->ftree, mtspace->fgrid, found, true);
+
+  n = vector_size (found.v);
+  if (vector_is_empty (qc.checking.v))
+    {
+      e = (mtscache_entry_t *) malloc (sizeof (*e) +
+				       MAX (n - 1, 0) * sizeof (BoxType));
+      *e = key;
+      e->n = n;
+      for (i = 0; i < n; i++)
+	e->leaf[i] = *(BoxType *) vector_element (found.v, i);
+      g_hash_table_insert (mtspace->fcache, e, e);
     }
+  while (!vector_is_empty (found.v))
+    add_no_fix (work, (BoxType *) vector_remove_last (found.v));
+  while (!vector_is_empty (qc.checking.v))
+    add_untested (work, (BoxType *) vector_remove_last (qc.checking.v));
+  vector_destroy (&found.v);
+  vector_destroy (&qc.checking.v);
 }
 
 /*!
@@ -502,7 +966,6 @@ mtspace_query_rect (mtspace_t * mtspace, const BoxType * region,
           work->no_hi.h =heap_create ();
           assert (work->untested.h && work->no_fix.h &&
                   work->no_hi.h && work->hi_candidate.h);
-          heap_insert (work->untested.h, 0, cbox);
           work->desired = *desired;
         }
       else
@@ -513,9 +976,9 @@ mtspace_query_rect (mtspace_t * mtspace, const BoxType * region,
           work->no_hi.v = vector_create ();
           assert (work->untested.v && work->no_fix.v &&
                   work->no_hi.v && work->hi_candidate.v);
-          vector_append (work->untested.v, cbox);
           work->desired.X = work->desired.Y = -SPECIAL;
         }
+      query_fixed (mtspace, work, cbox);
       return work;
     }
   qc.keepaway = work->keepaway;
@@ -533,7 +996,7 @@ mtspace_query_rect (mtspace_t * mtspace, const BoxType * region,
        */
       qc.checking = work->untested;
       qc.touching.v = NULL;
-      qloop (&qc, mtspace->ftree, work->no_fix, false);
+      qloop (&qc, mtspace->ftree, mtspace->fgrid, work->no_fix, false);
       /* search the hi-conflict tree placing intersectors in the
        * hi_candidate vector (if conflicts are allowed) and
        * placing empty regions in the no_hi vector.
@@ -541,7 +1004,8 @@ mtspace_query_rect (mtspace_t * mtspace, const BoxType * region,
       qc.checking.v = work->no_fix.v;
       qc.touching.v = with_conflicts ? work->hi_candidate.v : NULL;
       qc.touch_is_vec = false;
-      qloop (&qc, is_odd ? mtspace->otree : mtspace->etree, work->no_hi, false);
+      qloop (&qc, is_odd ? mtspace->otree : mtspace->etree,
+	     is_odd ? mtspace->ogrid : mtspace->egrid, work->no_hi, false);
       /* search the lo-conflict tree placing intersectors in the
        * lo-conflict answer vector (if conflicts allowed) and
        * placing emptry regions in the free-space answer vector.
@@ -550,7 +1014,8 @@ mtspace_query_rect (mtspace_t * mtspace, const BoxType * region,
 /* XXX lo_conflict_space_vec will be treated like a heap! */
       qc.touching.v = (with_conflicts ? lo_conflict_space_vec : NULL);
       qc.touch_is_vec = true;
-      qloop (&qc, is_odd ? mtspace->etree : mtspace->otree, temporary, true);
+      qloop (&qc, is_odd ? mtspace->etree : mtspace->otree,
+	     is_odd ? mtspace->egrid : mtspace->ogrid, temporary, true);
 
       /* qloop (&qc, is_odd ? mtspace->etree : mtspace->otree, (heap_or_vector)free_space_vec, true); */
       if (!vector_is_empty (free_space_vec))
@@ -577,7 +1042,7 @@ mtspace_query_rect (mtspace_t * mtspace, const BoxType * region,
 	  qc.checking = work->hi_candidate;
 	  qc.touching.v = NULL;
 	  qloop (&qc, is_odd ? mtspace->etree : mtspace->otree,
-		 temporary, true);
+		 is_odd ? mtspace->egrid : mtspace->ogrid, temporary, true);
 
 	  /* qloop (&qc, is_odd ? mtspace->etree : mtspace->otree, */
 	  /* 	 (heap_or_vector)hi_conflict_space_vec, true); */
@@ -44,6 +44,8 @@
 #include "error.h"
 #include "mymem.h"
 #include "misc.h"
+#include "search.h"
+#include "polygon.h"
 #include "rats.h"
 #include "rtree.h"
 
@@ -67,6 +69,292 @@ g_list_free_full (GList *list, GDestroyNotify free_func)
 }
 #endif
 
+/*!
+ * \brief Objects handed out per block, at least.
+ */
+#define POOL_BLOCK_OBJECTS 256
+
+/*!
+ * \brief Bytes per pool block, at least.
+ */
+#define POOL_BLOCK_SIZE (64 * 1024)
+
+/*!
+ * \brief Objects of one size, carved from large blocks.
+ *
+ * Lines, arcs, pins and the other PCB objects each used to be a separate
+ * small allocation, interleaved on the heap with everything else that
+ * was allocated while a board loaded.  A pool carves the objects of one
+ * type from large blocks in the order they are created, so the objects a
+ * *_LOOP macro walks are mostly next to each other in memory.
+ *
+ * Freed objects are kept on a free list for reuse.  All but one block
+ * are given back once the last object of the pool is freed, which
+ * happens when a board is closed.
+ */
+typedef struct
+{
+  gsize size;           /*!< Object size, 0 for an unused pool. */
+  gsize per_block;      /*!< Objects per block. */
+  void *free_list;      /*!< Freed objects, linked through their start. */
+  char *next;           /*!< Next never used object of the newest block. */
+  char *end;            /*!< End of the newest block. */
+  GSList *blocks;       /*!< All blocks of the pool. */
+  gsize live;           /*!< Objects handed out and not yet freed. */
+} ObjectPool;
+
+/*!
+ * \brief Number of different object sizes pooled.
+ */
+#define POOL_N 16
+
+static ObjectPool pools[POOL_N];
+G_LOCK_DEFINE_STATIC (pools);
+
+static ObjectPool *
+find_pool (gsize size)
+{
+  int i;
+
+  for (i = 0; i < POOL_N && pools[i].size != 0; i++)
+    if (pools[i].size == size)
+      return &pools[i];
+  if (i == POOL_N)
+    return NULL;
+
+  pools[i].size = size;
+  pools[i].per_block = MAX (POOL_BLOCK_OBJECTS, POOL_BLOCK_SIZE / size);
+  return &pools[i];
+}
+
+/*!
+ * \brief Allocate a zeroed object of the given size from its pool.
+ *
+ * Use the POOL_NEW0() and POOL_FREE() macros rather than calling this
+ * directly.  Under dmalloc or ElectricFence every object is a separate
+ * allocation, so those still see each of them.
+ */
+void *
+PoolAlloc (gsize size)
+{
+  ObjectPool *pool;
+  void *obj;
+
+  /* Objects on the free list store the link in their first bytes */
+  size = MAX (size, sizeof (void *));
+  size = (size + sizeof (void *) - 1) & ~(sizeof (void *) - 1);
+
+#if defined (HAVE_LIBDMALLOC) || defined (HAVE_LIBEFENCE)
+  obj = calloc (1, size);
+#else
+  G_LOCK (pools);
+  pool = find_pool (size);
+  if (pool == NULL)
+    {
+      /* More object sizes than expected, don't pool this one */
+      G_UNLOCK (pools);
+      return calloc (1, size);
+    }
+
+  if (pool->free_list != NULL)
+    {
+      obj = pool->free_list;
+      pool->free_list = *(void **) obj;
+    }
+  else
+    {
+      if (pool->next == pool->end)
+        {
+          char *block = (char *) g_malloc (pool->per_block * size);
+
+          pool->blocks = g_slist_prepend (pool->blocks, block);
+          pool->next = block;
+          pool->end = block + pool->per_block * size;
+        }
+      obj = pool->next;
+      pool->next += size;
+    }
+  pool->live++;
+  G_UNLOCK (pools);
+
+  memset (obj, 0, size);
+#endif
+  return obj;
+}
+
+/*!
+ * \brief Give an object from PoolAlloc() back to its pool.
+ */
+void
+PoolFree (gsize size, void *obj)
+{
+  ObjectPool *pool;
+
+  if (obj == NULL)
+    return;
+
+  size = MAX (size, sizeof (void *));
+  size = (size + sizeof (void *) - 1) & ~(sizeof (void *) - 1);
+
+#if defined (HAVE_LIBDMALLOC) || defined (HAVE_LIBEFENCE)
+  free (obj);
+#else
+  G_LOCK (pools);
+  pool = find_pool (size);
+  if (pool == NULL)
+    {
+      G_UNLOCK (pools);
+      free (obj);
+      return;
+    }
+
+  *(void **) obj = pool->free_list;
+  pool->free_list = obj;
+  if (--pool->live == 0)
+    {
+      GSList *l;
+
+      /* Keep the newest block, so a pool whose only object comes and
+       * goes doesn't allocate a block each time. */
+      for (l = pool->blocks->next; l != NULL; l = l->next)
+        g_free (l->data);
+      g_slist_free (pool->blocks->next);
+      pool->blocks->next = NULL;
+      pool->free_list = NULL;
+      pool->next = (char *) pool->blocks->data;
+      pool->end = pool->next + pool->per_block * size;
+    }
+  G_UNLOCK (pools);
+#endif
+}
+
+/*!
+ * \brief Strings shared by their users, with the count of users of each.
+ *
+ * Most elements of a board use one of a few footprints, so the pins and
+ * pads of thousands of them have the same few names and numbers.
+ */
+static GHashTable *shared_strings = NULL;
+G_LOCK_DEFINE_STATIC (shared_strings);
+
+/*!
+ * \brief Get a shared copy of a string.
+ *
+ * The copy must be given back with ReleaseString(), and not changed in
+ * place.
+ */
+char *
+ShareString (const char *s)
+{
+  gpointer key, count;
+
+  if (s == NULL)
+    return NULL;
+
+  G_LOCK (shared_strings);
+  if (shared_strings == NULL)
+    shared_strings = g_hash_table_new (g_str_hash, g_str_equal);
+  if (g_hash_table_lookup_extended (shared_strings, s, &key, &count))
+    g_hash_table_insert (shared_strings, key,
+			 GUINT_TO_POINTER (GPOINTER_TO_UINT (count) + 1));
+  else
+    {
+      key = strdup (s);
+      g_hash_table_insert (shared_strings, key, GUINT_TO_POINTER (1));
+    }
+  G_UNLOCK (shared_strings);
+  return (char *) key;
+}
+
+/*!
+ * \brief Give back a string from ShareString(), or free() any other.
+ *
+ * The pin and pad names pass through the undo list, along with names
+ * that were never shared, so both are let go of the same way.
+ */
+void
+ReleaseString (char *s)
+{
+  gpointer key, count;
+
+  if (s == NULL)
+    return;
+
+  G_LOCK (shared_strings);
+  if (shared_strings != NULL
+      && g_hash_table_lookup_extended (shared_strings, s, &key, &count)
+      && key == s)
+    {
+      if (GPOINTER_TO_UINT (count) > 1)
+	g_hash_table_insert (shared_strings, key,
+			     GUINT_TO_POINTER (GPOINTER_TO_UINT (count) - 1));
+      else
+	{
+	  g_hash_table_remove (shared_strings, key);
+	  free (s);
+	}
+    }
+  else
+    free (s);
+  G_UNLOCK (shared_strings);
+}
+
+/*!
+ * \brief Append data to an object list in constant time.
+ *
+ * g_list_append() walks the whole list, which made loading a board
+ * quadratic in the number of objects on a layer.  tail caches the last
+ * link of the list instead; it is found again if it isn't set, so a tail
+ * may be reset to NULL whenever the list is changed by other means.
+ *
+ * \return the new start of the list.
+ */
+GList *
+AppendToObjectList (GList *list, GList **tail, gpointer data)
+{
+  GList *link = g_list_alloc ();
+
+  IDIndexInvalidate ();
+  link->data = data;
+  if (list == NULL)
+    {
+      *tail = link;
+      return link;
+    }
+  if (*tail == NULL)
+    *tail = g_list_last (list);
+  link->prev = *tail;
+  (*tail)->next = link;
+  *tail = link;
+  return list;
+}
+
+/*!
+ * \brief Remove data from an object list, keeping its tail up to date.
+ *
+ * The list is searched from the end, where recently added objects (the
+ * ones undo and the buffer operations remove most) are.
+ *
+ * \return the new start of the list.
+ */
+GList *
+RemoveFromObjectList (GList *list, GList **tail, gconstpointer data)
+{
+  GList *link;
+
+  IDIndexInvalidate ();
+  if (*tail == NULL)
+    *tail = g_list_last (list);
+  for (link = *tail; link != NULL; link = link->prev)
+    if (link->data == data)
+      break;
+  if (link == NULL)
+    return list;
+  if (link == *tail)
+    *tail = link->prev;
+  return g_list_delete_link (list, link);
+}
+
 /*!
  * \brief Get the next slot for a rubberband connection.
  *
@@ -77,16 +365,20 @@ GetRubberbandMemory (void)
 {
   RubberbandType *ptr = Crosshair.AttachedObject.Rubberband;
 
-  /* realloc new memory if necessary and clear it */
+  /* realloc new memory if necessary and clear it; the list doubles, as
+   * an element with many pins can have thousands of lines attached */
   if (Crosshair.AttachedObject.RubberbandN >=
       Crosshair.AttachedObject.RubberbandMax)
     {
-      Crosshair.AttachedObject.RubberbandMax += STEP_RUBBERBAND;
+      Cardinal step = MAX (STEP_RUBBERBAND,
+			   Crosshair.AttachedObject.RubberbandMax);
+
+      Crosshair.AttachedObject.RubberbandMax += step;
       ptr = (RubberbandType *)realloc (ptr, Crosshair.AttachedObject.RubberbandMax *
                           sizeof (RubberbandType));
       Crosshair.AttachedObject.Rubberband = ptr;
       memset (ptr + Crosshair.AttachedObject.RubberbandN, 0,
-	      STEP_RUBBERBAND * sizeof (RubberbandType));
+	      step * sizeof (RubberbandType));
     }
   return (ptr + Crosshair.AttachedObject.RubberbandN++);
 }
@@ -214,8 +506,8 @@ GetPinMemory (ElementType *element)
 {
   PinType *new_obj;
 
-  new_obj = g_slice_new0 (PinType);
-  element->Pin = g_list_append (element->Pin, new_obj);
+  new_obj = POOL_NEW0 (PinType);
+  element->Pin = AppendToObjectList (element->Pin, &element->PinTail, new_obj);
   element->PinN ++;
 
   return new_obj;
@@ -224,7 +516,7 @@ GetPinMemory (ElementType *element)
 static void
 FreePin (PinType *data)
 {
-  g_slice_free (PinType, data);
+  POOL_FREE (PinType, data);
 }
 
 /*!
@@ -237,8 +529,8 @@ GetPadMemory (ElementType *element)
 {
   PadType *new_obj;
 
-  new_obj = g_slice_new0 (PadType);
-  element->Pad = g_list_append (element->Pad, new_obj);
+  new_obj = POOL_NEW0 (PadType);
+  element->Pad = AppendToObjectList (element->Pad, &element->PadTail, new_obj);
   element->PadN ++;
 
   return new_obj;
@@ -247,7 +539,7 @@ GetPadMemory (ElementType *element)
 static void
 FreePad (PadType *data)
 {
-  g_slice_free (PadType, data);
+  POOL_FREE (PadType, data);
 }
 
 /*!
@@ -260,8 +552,8 @@ GetViaMemory (DataType *data)
 {
   PinType *new_obj;
 
-  new_obj = g_slice_new0 (PinType);
-  data->Via = g_list_append (data->Via, new_obj);
+  new_obj = POOL_NEW0 (PinType);
+  data->Via = AppendToObjectList (data->Via, &data->ViaTail, new_obj);
   data->ViaN ++;
 
   return new_obj;
@@ -270,7 +562,7 @@ GetViaMemory (DataType *data)
 static void
 FreeVia (PinType *data)
 {
-  g_slice_free (PinType, data);
+  POOL_FREE (PinType, data);
 }
 
 /*!
@@ -283,8 +575,8 @@ GetRatMemory (DataType *data)
 {
   RatType *new_obj;
 
-  new_obj = g_slice_new0 (RatType);
-  data->Rat = g_list_append (data->Rat, new_obj);
+  new_obj = POOL_NEW0 (RatType);
+  data->Rat = AppendToObjectList (data->Rat, &data->RatTail, new_obj);
   data->RatN ++;
 
   return new_obj;
@@ -293,7 +585,7 @@ GetRatMemory (DataType *data)
 static void
 FreeRat (RatType *data)
 {
-  g_slice_free (RatType, data);
+  POOL_FREE (RatType, data);
 }
 
 /*!
@@ -306,8 +598,8 @@ GetLineMemory (LayerType *layer)
 {
   LineType *new_obj;
 
-  new_obj = g_slice_new0 (LineType);
-  layer->Line = g_list_append (layer->Line, new_obj);
+  new_obj = POOL_NEW0 (LineType);
+  layer->Line = AppendToObjectList (layer->Line, &layer->LineTail, new_obj);
   layer->LineN ++;
 
   return new_obj;
@@ -316,7 +608,7 @@ GetLineMemory (LayerType *layer)
 static void
 FreeLine (LineType *data)
 {
-  g_slice_free (LineType, data);
+  POOL_FREE (LineType, data);
 }
 
 /*!
@@ -329,8 +621,8 @@ GetArcMemory (LayerType *layer)
 {
   ArcType *new_obj;
 
-  new_obj = g_slice_new0 (ArcType);
-  layer->Arc = g_list_append (layer->Arc, new_obj);
+  new_obj = POOL_NEW0 (ArcType);
+  layer->Arc = AppendToObjectList (layer->Arc, &layer->ArcTail, new_obj);
   layer->ArcN ++;
 
   return new_obj;
@@ -339,7 +631,7 @@ GetArcMemory (LayerType *layer)
 static void
 FreeArc (ArcType *data)
 {
-  g_slice_free (ArcType, data);
+  POOL_FREE (ArcType, data);
 }
 
 /*!
@@ -352,8 +644,8 @@ GetTextMemory (LayerType *layer)
 {
   TextType *new_obj;
 
-  new_obj = g_slice_new0 (TextType);
-  layer->Text = g_list_append (layer->Text, new_obj);
+  new_obj = POOL_NEW0 (TextType);
+  layer->Text = AppendToObjectList (layer->Text, &layer->TextTail, new_obj);
   layer->TextN ++;
 
   return new_obj;
@@ -362,7 +654,7 @@ GetTextMemory (LayerType *layer)
 static void
 FreeText (TextType *data)
 {
-  g_slice_free (TextType, data);
+  POOL_FREE (TextType, data);
 }
 
 /*!
@@ -375,8 +667,9 @@ GetPolygonMemory (LayerType *layer)
 {
   PolygonType *new_obj;
 
-  new_obj = g_slice_new0 (PolygonType);
-  layer->Polygon = g_list_append (layer->Polygon, new_obj);
+  new_obj = POOL_NEW0 (PolygonType);
+  layer->Polygon = AppendToObjectList (layer->Polygon,
+                                       &layer->PolygonTail, new_obj);
   layer->PolygonN ++;
 
   return new_obj;
@@ -385,7 +678,7 @@ GetPolygonMemory (LayerType *layer)
 static void
 FreePolygon (PolygonType *data)
 {
-  g_slice_free (PolygonType, data);
+  POOL_FREE (PolygonType, data);
 }
 
 /*!
@@ -398,6 +691,7 @@ GetPointMemoryInPolygon (PolygonType *Polygon)
 {
   PointType *points = Polygon->Points;
 
+  IDIndexInvalidate ();
   /* realloc new memory if necessary and clear it */
   if (Polygon->PointN >= Polygon->PointMax)
     {
@@ -410,6 +704,25 @@ GetPointMemoryInPolygon (PolygonType *Polygon)
   return (points + Polygon->PointN++);
 }
 
+/*!
+ * \brief Makes room for n more points in a polygon struct.
+ *
+ * Copying a contour of thousands of points otherwise grows the points
+ * STEP_POLYGONPOINT at a time.
+ */
+void
+ReservePointsInPolygon (PolygonType *Polygon, Cardinal n)
+{
+  if (Polygon->PointN + n <= Polygon->PointMax)
+    return;
+  Polygon->Points = (PointType *)realloc (Polygon->Points,
+					  (Polygon->PointN + n)
+					  * sizeof (PointType));
+  memset (Polygon->Points + Polygon->PointMax, 0,
+	  (Polygon->PointN + n - Polygon->PointMax) * sizeof (PointType));
+  Polygon->PointMax = Polygon->PointN + n;
+}
+
 /*!
  * \brief Gets the next slot for a point in a polygon struct.
  *
@@ -442,11 +755,12 @@ GetElementMemory (DataType *data)
 {
   ElementType *new_obj;
 
-  new_obj = g_slice_new0 (ElementType);
+  new_obj = POOL_NEW0 (ElementType);
 
   if (data != NULL)
     {
-      data->Element = g_list_append (data->Element, new_obj);
+      data->Element = AppendToObjectList (data->Element,
+                                          &data->ElementTail, new_obj);
       data->ElementN ++;
     }
 
@@ -456,7 +770,7 @@ GetElementMemory (DataType *data)
 static void
 FreeElement (ElementType *data)
 {
-  g_slice_free (ElementType, data);
+  POOL_FREE (ElementType, data);
 }
 
 /*!
@@ -586,6 +900,7 @@ FreePolygonMemory (PolygonType *polygon)
 
   if (polygon->Clipped)
     poly_Free (&polygon->Clipped);
+  FreePolygonTiles (polygon);
   poly_FreeContours (&polygon->NoHoles);
 
   memset (polygon, 0, sizeof (PolygonType));
@@ -662,8 +977,8 @@ FreeAttributeListMemory (AttributeListType *list)
 
   for (i = 0; i < list->Number; i++)
     {
-      free (list->List[i].name);
-      free (list->List[i].value);
+      ReleaseString (list->List[i].name);
+      ReleaseString (list->List[i].value);
     }
   free (list->List);
   list->List = NULL;
@@ -681,19 +996,19 @@ FreeElementMemory (ElementType *element)
 
   ELEMENTNAME_LOOP (element);
   {
-    free (textstring);
+    ReleaseString (textstring);
   }
   END_LOOP;
   PIN_LOOP (element);
   {
-    free (pin->Name);
-    free (pin->Number);
+    ReleaseString (pin->Name);
+    ReleaseString (pin->Number);
   }
   END_LOOP;
   PAD_LOOP (element);
   {
-    free (pad->Name);
-    free (pad->Number);
+    ReleaseString (pad->Name);
+    ReleaseString (pad->Number);
   }
   END_LOOP;
 
@@ -806,6 +1121,7 @@ FreeDataMemory (DataType *data)
     r_destroy_tree (&data->pad_tree);
   if (data->rat_tree)
     r_destroy_tree (&data->rat_tree);
+  IDIndexFree (data);
   /* clear struct */
   memset (data, 0, sizeof (DataType));
 }
@@ -69,6 +69,22 @@ typedef struct
   char *Data;
 } DynamicStringType;
 
+/*!
+ * \brief Allocate a zeroed PCB object from the pool of its type.
+ */
+#define POOL_NEW0(type) ((type *) PoolAlloc (sizeof (type)))
+
+/*!
+ * \brief Free a PCB object allocated with POOL_NEW0().
+ */
+#define POOL_FREE(type, mem) PoolFree (sizeof (type), (mem))
+
+void *PoolAlloc (gsize);
+void PoolFree (gsize, void *);
+char *ShareString (const char *);
+void ReleaseString (char *);
+GList *AppendToObjectList (GList *, GList **, gpointer);
+GList *RemoveFromObjectList (GList *, GList **, gconstpointer);
 RubberbandType * GetRubberbandMemory (void);
 PinType * GetPinMemory (ElementType *);
 PadType * GetPadMemory (ElementType *);
@@ -79,6 +95,7 @@ RatType * GetRatMemory (DataType *);
 TextType * GetTextMemory (LayerType *);
 PolygonType * GetPolygonMemory (LayerType *);
 PointType * GetPointMemoryInPolygon (PolygonType *);
+void ReservePointsInPolygon (PolygonType *, Cardinal);
 Cardinal *GetHoleIndexMemoryInPolygon (PolygonType *);
 ElementType * GetElementMemory (DataType *);
 BoxType * GetBoxMemory (BoxListType *);
@@ -44,6 +44,7 @@ __FILE__, __LINE__, __func__, ##args)
 #include "object_list.h"
 
 static void * object_list_position_pointer(object_list * list, int n);
+static void object_list_update_items(object_list * list, int from);
 
 /*!
  * \brief Create a new object list with n items of size item_size.
@@ -55,6 +56,7 @@ object_list_new (int n, unsigned item_size)
   list->item_size = item_size;
   list->size = n;
   list->count = 0;
+  list->refs = 0;
   /* can I find a way to do this with expand? */
   list->items = malloc(n*sizeof(void*));
   memset(list->items, 0, list->size*sizeof(void*)); 
@@ -70,23 +72,41 @@ object_list *
 object_list_duplicate (object_list * list)
 {
   object_list * new_list;
-  int i;
 
   /* can't duplicate a null pointer*/
   if (!list) return 0;
 
   new_list = object_list_new(list->size, list->item_size);
-  for (i=0; i< list->count; i++) 
-    object_list_append(new_list, object_list_get_item(list, i));
+  object_list_append_many(new_list, list->data, list->count);
   return new_list;
 }
 
+/*!
+ * \brief Take another reference to a list, instead of copying it.
+ *
+ * The list is only freed by the last of the object_list_delete() calls,
+ * one for the list and one for each reference taken.  A shared list
+ * must not be changed.
+ */
+object_list *
+object_list_ref (object_list * list)
+{
+  if (list) list->refs++;
+  return list;
+}
+
 /*!
  * \brief Delete an object list.
  */
 void 
 object_list_delete (object_list * list)
 {
+  if (list->refs > 0)
+  {
+    /* someone else still has the list */
+    list->refs--;
+    return;
+  }
   object_list_clear(list);
   free(list->items);
   free(list->data);
@@ -125,21 +145,42 @@ object_list_expand (object_list * list, int n)
 {
   void * new_data = realloc(list->data, (list->size + n)*list->item_size);
   void ** new_items = realloc(list->items, (list->size + n)*sizeof(void*));
-  int i=0;
   DBG_MSG("Expanding list by %d\n", n);
   if (new_data) list->data = new_data;
-  else printf("[object list] Could not reallocate data memory!\n");
+  else
+  {
+    printf("[object list] Could not reallocate data memory!\n");
+    if (new_items) list->items = new_items;
+    return -1;
+  }
   if (new_items) list->items = new_items;
-  else printf("[object list] Could not reallocate item vector memory!\n");
-  list->size += n;
-  for (i=0; i < list->size; i++)
+  else
   {
-    if (i < list->count) list->items[i] = object_list_position_pointer(list, i);
-    else list->items[i] = 0;
+    printf("[object list] Could not reallocate item vector memory!\n");
+    return -1;
   }
+  list->size += n;
+  object_list_update_items(list, 0);
   return 0; /* success */
 }
 
+/*!
+ * \brief Make room for at least n items.
+ *
+ * The list at least doubles when it grows, so that a list filled one
+ * item at a time is only reallocated a few times.
+ */
+int
+object_list_reserve (object_list * list, int n)
+{
+  int grow;
+
+  if (n <= list->size) return 0;
+  grow = list->size > 0 ? list->size : 1;
+  if (list->size + grow < n) grow = n - list->size;
+  return object_list_expand(list, grow);
+}
+
 /*!
  * \brief Print the list information.
  */
@@ -151,95 +192,175 @@ object_list_describe (object_list * list)
 }
 
 /*!
- * \brief Insert an object into the list at position n.
+ * \brief Make room for count items at position n, moving the items after
+ * it up.
+ *
+ * \return a pointer to the first of the free positions, or 0.
  */
-int 
-object_list_insert (object_list * list, int n, void * item)
+static void *
+object_list_open_gap (object_list * list, int n, int count)
 {
-  void * nptr, * tmp;
-  int nItemsToMove, result;
-  if(n > list->count) return -1; // must be contiguous
-  
-  DBG_MSG("Inserting object at position %d\n", n);
-  /* make sure we have enough room in the list for the new item */
-  if (list->count == list->size){
-    result = object_list_expand(list, 1);
-    if (result < 0)
-    {
-      printf("Failed to expand list!\n");
-      return -1;
-    }
+  void * nptr;
+  int nItemsToMove;
+
+  if(n < 0 || n > list->count || count < 0) return 0; // must be contiguous
+
+  /* make sure we have enough room in the list for the new items */
+  if (object_list_reserve(list, list->count + count) < 0)
+  {
+    printf("Failed to expand list!\n");
+    return 0;
   }
-  
-  /* move the items to make room for the new one */
+
+  /* move the items to make room for the new ones */
   nItemsToMove = list->count - n;
   nptr = object_list_position_pointer(list, n);
-  if (nItemsToMove > 0)
+  if (nItemsToMove > 0 && count > 0)
   {
-    /* copying forward, must use a temp */
     DBG_MSG("Need to move %d objects\n", nItemsToMove);
-    tmp = malloc(list->item_size*nItemsToMove);
-    memcpy(tmp, nptr, list->item_size*nItemsToMove);
-    memcpy(nptr+list->item_size, tmp, list->item_size*nItemsToMove);
-    free(tmp);
+    memmove((char *) nptr + list->item_size*count, nptr,
+            list->item_size*nItemsToMove);
   }
-  
+
+  /* Update the pointer list */
+  list->count += count;
+  object_list_update_items(list, list->count - count);
+  return nptr;
+}
+
+/*!
+ * \brief Insert count items, stored one after the other at items, into
+ * the list at position n.
+ */
+int
+object_list_insert_many (object_list * list, int n, void * items, int count)
+{
+  char * nptr;
+  int i;
+
+  if (count == 0) return n > list->count ? -1 : 0;
+  DBG_MSG("Inserting %d objects at position %d\n", count, n);
+  nptr = object_list_open_gap(list, n, count);
+  if (nptr == 0) return -1;
+
   /* copy the data into the list */
   if (list->ops && list->ops->copy_object){
     DBG_MSG("Copying with copy operation object\n");
-    list->ops->copy_object(nptr, item);
+    for (i = 0; i < count; i++)
+      list->ops->copy_object(nptr + i*list->item_size,
+                             (char *) items + i*list->item_size);
   } else {
     DBG_MSG("Copying with memcpy\n");
-    memcpy(nptr, item, list->item_size);
+    memcpy(nptr, items, list->item_size*count);
   }
+  return 0; /* success */
+}
 
-  /* Update the pointer list */  
-  list->items[list->count] = object_list_position_pointer(list, list->count);
+/*!
+ * \brief Insert an object into the list at position n.
+ */
+int 
+object_list_insert (object_list * list, int n, void * item)
+{
+  return object_list_insert_many(list, n, item, 1);
+}
 
-  /* increment the list count */
-  list->count++;
+/*!
+ * \brief Move an object into the list at position n.
+ *
+ * The list takes the object as it is, without copy_object, so whatever
+ * memory the object owns now belongs to the list.  The caller must not
+ * clear the original, only free it if it was allocated.
+ */
+int
+object_list_insert_move (object_list * list, int n, void * item)
+{
+  void * nptr = object_list_open_gap(list, n, 1);
+
+  if (nptr == 0) return -1;
+  memcpy(nptr, item, list->item_size);
   return 0; /* success */
 }
 
+/*!
+ * \brief Close the gap of count items at position n, moving the items
+ * after it down.
+ */
+static void
+object_list_close_gap (object_list * list, int n, int count)
+{
+  int nItemsToMove = list->count - n - count;
+  char * nptr = object_list_position_pointer(list, n);
+
+  if (nItemsToMove > 0)
+    memmove(nptr, nptr + list->item_size*count, list->item_size*nItemsToMove);
+  list->count -= count;
+
+  /* Update the pointer list */
+  memset(list->items + list->count, 0, count*sizeof(void*));
+}
+
 /*!
  * \brief Remove the object at position n from the list.
  */
 int 
 object_list_remove(object_list * list, int n)
 {
-  int nItemsToMove;
-  void * nptr, *temp;
-  if(n >= list->count) return -1; // object not in list
+  void * nptr;
+  if(n < 0 || n >= list->count) return -1; // object not in list
   
-  /* move all items after the specified position up one position */
-  nItemsToMove = list->count - n - 1;
   nptr = object_list_get_item(list, n);
   if (list->ops && list->ops->clear_object){
     DBG_MSG("Clearing with clear operation object\n");
     list->ops->clear_object(nptr);
   } 
   /* no point in a memcpy condition since we're about to overwrite it anyway */
-  
-  /* Copying to an intermediate location appears to be necessary for 32-bit
-   * platforms.
-   *
-   * TODO: Some profiling should be done to see if it's faster to do the
-   *       malloc/free move, or to execute a for loop an move one item at a
-   *       time, which would not require a memory allocation.
-   */
-  temp = malloc(list->item_size*nItemsToMove);
-  memcpy(temp, nptr+list->item_size, list->item_size*nItemsToMove);
-  memcpy(nptr, temp, list->item_size*nItemsToMove);
-  free(temp);
-  
-  /* decrement the list count */
-  list->count--;
 
-  /* Update the pointer list */
+  /* move all items after the specified position down one position */
+  object_list_close_gap(list, n, 1);
+  return 0; /* success */
+}
+
+/*!
+ * \brief Remove the object at position n from the list, putting the last
+ * object in its place.
+ *
+ * This does not keep the order of the list, but it does not move any
+ * more than the one object either.
+ */
+int
+object_list_swap_remove (object_list * list, int n)
+{
+  void * nptr;
+  if(n < 0 || n >= list->count) return -1; // object not in list
+
+  nptr = object_list_get_item(list, n);
+  if (list->ops && list->ops->clear_object)
+    list->ops->clear_object(nptr);
+  list->count--;
+  if (n != list->count)
+    memcpy(nptr, object_list_position_pointer(list, list->count),
+           list->item_size);
   list->items[list->count] = 0;
   return 0; /* success */
 }
 
+/*!
+ * \brief Move the object at position n out of the list into dest.
+ *
+ * The object is not cleared: whatever memory it owns now belongs to the
+ * caller.
+ */
+int
+object_list_take (object_list * list, int n, void * dest)
+{
+  if(n < 0 || n >= list->count) return -1; // object not in list
+
+  memcpy(dest, object_list_position_pointer(list, n), list->item_size);
+  object_list_close_gap(list, n, 1);
+  return 0; /* success */
+}
+
 /*!
  * \brief Add an objet to the end of the list.
  */
@@ -250,6 +371,26 @@ object_list_append (object_list * list, void * item)
   return object_list_insert (list, list->count, item);
 }
 
+/*!
+ * \brief Add count objects, stored one after the other at items, to the
+ * end of the list.
+ */
+int
+object_list_append_many (object_list * list, void * items, int count)
+{
+  return object_list_insert_many (list, list->count, items, count);
+}
+
+/*!
+ * \brief Move an object to the end of the list, see
+ * object_list_insert_move().
+ */
+int
+object_list_append_move (object_list * list, void * item)
+{
+  return object_list_insert_move (list, list->count, item);
+}
+
 /*!
  * \brief Get a pointer to the object at position n in the list.
  */
@@ -257,7 +398,7 @@ object_list_append (object_list * list, void * item)
 void * 
 object_list_get_item (object_list * list, int n)
 {
-  if (n >= list->count) return 0; /* not a valid item */
+  if (n < 0 || n >= list->count) return 0; /* not a valid item */
   return object_list_position_pointer (list, n);
 }
 
@@ -265,7 +406,22 @@ static void *
 object_list_position_pointer (object_list * list, int n)
 {
   if (n >= list->size) return 0; /* position not in list */
-  return list->data + list->item_size*n;
+  return (char *) list->data + list->item_size*n;
+}
+
+/*!
+ * \brief Point the pointer list at the objects from position from on.
+ */
+static void
+object_list_update_items (object_list * list, int from)
+{
+  int i;
+
+  for (i = from; i < list->size; i++)
+  {
+    if (i < list->count) list->items[i] = object_list_position_pointer(list, i);
+    else list->items[i] = 0;
+  }
 }
 
 /*!
@@ -304,6 +460,7 @@ void
 object_list_register_tests(void)
 {
   g_test_add_func("/object-list/test", object_list_test);
+  g_test_add_func("/object-list/test-bulk", object_list_test_bulk);
 }
 
 typedef struct somestruct {
@@ -447,7 +604,7 @@ void object_list_test(void)
   check_item(list, a, 0);
   check_item(list, c, 1);
   check_item(list, d, 2);
-  g_assert_cmpint(list->size, ==, 3);
+  g_assert_cmpint(list->size, ==, 4); /* doubled */
   g_assert_cmpint(list->count, ==, 3);
 
   /* Inserting object 'b' at position 1 (middle position) */
@@ -478,7 +635,7 @@ void object_list_test(void)
   check_item(list, c, 2);
   check_item(list, d, 3);
   check_item(list, e, 4);
-  g_assert_cmpint(list->size, ==, 5);
+  g_assert_cmpint(list->size, ==, 8);
   g_assert_cmpint(list->count, ==, 5);
 
   /*
@@ -499,7 +656,7 @@ void object_list_test(void)
   check_item(dup_list, c, 2);
   check_item(dup_list, d, 3);
   check_item(dup_list, e, 4);
-  g_assert_cmpint(dup_list->size, ==, 5);
+  g_assert_cmpint(dup_list->size, ==, 8);
   g_assert_cmpint(dup_list->count, ==, 5);
 
   /*
@@ -519,7 +676,7 @@ void object_list_test(void)
   check_item(list, c, 1);
   check_item(list, d, 2);
   check_item(list, e, 3);
-  g_assert_cmpint(list->size, ==, 5);
+  g_assert_cmpint(list->size, ==, 8);
   g_assert_cmpint(list->count, ==, 4);
 
   /* Removing object at position 1 (middle position) */
@@ -528,7 +685,7 @@ void object_list_test(void)
   check_item(list, b, 0);
   check_item(list, d, 1);
   check_item(list, e, 2);
-  g_assert_cmpint(list->size, ==, 5);
+  g_assert_cmpint(list->size, ==, 8);
   g_assert_cmpint(list->count, ==, 3);
 
   /* Removing object at position 2 (final position) */
@@ -536,7 +693,7 @@ void object_list_test(void)
   /* 0: b, 1: d, 2: (null), 3: (null), 4: (null) */
   check_item(list, b, 0);
   check_item(list, d, 1);
-  g_assert_cmpint(list->size, ==, 5);
+  g_assert_cmpint(list->size, ==, 8);
   g_assert_cmpint(list->count, ==, 2);
 
   /* Removing object at position 2 (no item) */
@@ -544,13 +701,13 @@ void object_list_test(void)
   /* 0: b, 1: d, 2: (null), 3: (null), 4: (null) */
   check_item(list, b, 0);
   check_item(list, d, 1);
-  g_assert_cmpint(list->size, ==, 5);
+  g_assert_cmpint(list->size, ==, 8);
   g_assert_cmpint(list->count, ==, 2);
 
   /* Clearing list */
   object_list_clear(list);
   /* 0: (null), 1: (null), 2: (null), 3: (null), 4: (null) */
-  g_assert_cmpint(list->size, ==, 5);
+  g_assert_cmpint(list->size, ==, 8);
   g_assert_cmpint(list->count, ==, 0);
 
   /*
@@ -566,7 +723,7 @@ void object_list_test(void)
   check_item(list, a, 0);
   check_item(list, b, 1);
   check_item(list, c, 2);
-  g_assert_cmpint(list->size, ==, 5);
+  g_assert_cmpint(list->size, ==, 8);
   g_assert_cmpint(list->count, ==, 3);
   
   /* test use of clear_object */
@@ -578,7 +735,7 @@ void object_list_test(void)
   /* 0: a, 1: c, 2: (null), 3: (null), 4: (null) */
   check_item(list, a, 0);
   check_item(list, c, 1);
-  g_assert_cmpint(list->size, ==, 5);
+  g_assert_cmpint(list->size, ==, 8);
   g_assert_cmpint(list->count, ==, 2);
 
   /*
@@ -617,7 +774,7 @@ void object_list_test(void)
   /* See earlier comment. The same applies here. */
   object_list_clear(list);
   /* 0: (null), 1: (null), 2: (null), 3: (null), 4: (null) */
-  g_assert_cmpint(list->size, ==, 5);
+  g_assert_cmpint(list->size, ==, 8);
   g_assert_cmpint(list->count, ==, 0);
 
   /* Deleting list */
@@ -625,4 +782,87 @@ void object_list_test(void)
   object_list_delete(list);
 }
 
+/*
+ * The bulk, move and swap-remove functions, and sharing a list.
+ */
+void object_list_test_bulk(void)
+{
+  somestruct a={"A", 1}, b={"B", 2}, c={"C", 3},
+			 d={"D", 4}, e={"E", 5}, f={"F", 6};
+  somestruct some[3] = {{"A", 1}, {"B", 2}, {"C", 3}};
+  somestruct out;
+  object_list *list, *shared;
+  int i;
+
+  list = object_list_new(0, sizeof(somestruct));
+  list->ops = &somestruct_opts;
+
+  /* Appending many */
+  object_list_append_many(list, some, 3);
+  /* 0: a, 1: b, 2: c */
+  check_item(list, a, 0);
+  check_item(list, b, 1);
+  check_item(list, c, 2);
+  g_assert_cmpint(list->count, ==, 3);
+
+  /* Inserting many in the middle, and past the list (fails) */
+  some[0] = d;
+  some[1] = e;
+  object_list_insert_many(list, 1, some, 2);
+  g_assert_cmpint(object_list_insert_many(list, 9, some, 2), ==, -1);
+  /* 0: a, 1: d, 2: e, 3: b, 4: c */
+  check_item(list, a, 0);
+  check_item(list, d, 1);
+  check_item(list, e, 2);
+  check_item(list, b, 3);
+  check_item(list, c, 4);
+  g_assert_cmpint(list->count, ==, 5);
+
+  /* Swap-removing puts the last item in the gap */
+  object_list_swap_remove(list, 1);
+  /* 0: a, 1: c, 2: e, 3: b */
+  check_item(list, a, 0);
+  check_item(list, c, 1);
+  check_item(list, e, 2);
+  check_item(list, b, 3);
+  g_assert_cmpint(list->count, ==, 4);
+  g_assert_cmpint((gint64) list->items[4], ==, 0);
+
+  /* Swap-removing the last item */
+  object_list_swap_remove(list, 3);
+  /* 0: a, 1: c, 2: e */
+  check_item(list, e, 2);
+  g_assert_cmpint(list->count, ==, 3);
+  g_assert_cmpint(object_list_swap_remove(list, 3), ==, -1);
+
+  /* Taking an item out, and moving one in */
+  object_list_take(list, 0, &out);
+  g_assert_cmpint(compare_somestructs(&out, &a), ==, 0);
+  /* 0: c, 1: e */
+  object_list_append_move(list, &f);
+  object_list_insert_move(list, 0, &out);
+  /* 0: a, 1: c, 2: e, 3: f */
+  check_item(list, a, 0);
+  check_item(list, c, 1);
+  check_item(list, e, 2);
+  check_item(list, f, 3);
+  g_assert_cmpint(list->count, ==, 4);
+
+  /* Growing one item at a time doubles the list */
+  for (i = 0; i < 100; i++)
+    object_list_append(list, &b);
+  g_assert_cmpint(list->count, ==, 104);
+  g_assert_cmpint(list->size, ==, 192);
+  check_item(list, f, 3);
+  check_item(list, b, 103);
+
+  /* A shared list lives until the last reference goes */
+  shared = object_list_ref(list);
+  g_assert_cmpint((gint64) shared, ==, (gint64) list);
+  object_list_delete(list);
+  check_item(shared, a, 0);
+  g_assert_cmpint(shared->count, ==, 104);
+  object_list_delete(shared);
+}
+
 #endif /* PCB_UNIT_TEST */
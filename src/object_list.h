@@ -34,9 +34,12 @@
  *
  * When an object is added to the list, the list makes its own copy of the data.
  * The list does not take ownership of the original data, so, the caller is
- * still responsible for the original object. Providing an option where the list
- * takes ownership of the original object is perhaps an improvement for the
- * future.
+ * still responsible for the original object. The _move functions instead take
+ * the object as it is, along with whatever memory it owns, and
+ * object_list_take() hands an object back out the same way.
+ *
+ * The list at least doubles in size when it has to grow, so filling it one
+ * object at a time costs few reallocations.
  *
  * For complex objects, objects that don't contain all of their data in one
  * place, but have pointers to other areas of memory, it is necessary to create
@@ -111,6 +114,7 @@ typedef struct object_list
   void ** items; /*!< array of pointers to objects. */
   void * data; /*!< pointer to the memory where the objects are stored. */
   object_operations * ops; /*!< pointer to the function table of object ops. */
+  int refs; /*!< number of references taken by object_list_ref(). */
 } object_list;
 
 /*
@@ -120,6 +124,8 @@ typedef struct object_list
 object_list * object_list_new(int n, unsigned item_size);
 /* Copy constructor, copies data too. */
 object_list * object_list_duplicate(object_list * list);
+/* Share a list instead of copying it; it must not be changed while shared */
+object_list * object_list_ref(object_list * list);
 /* Delete an object list */
 void object_list_delete(object_list * list);
 
@@ -131,6 +137,8 @@ void object_list_delete(object_list * list);
 int object_list_clear(object_list * list);
 /* Make the object list bigger by n items */
 int object_list_expand(object_list * list, int n);
+/* Make room for at least n items, growing geometrically */
+int object_list_reserve(object_list * list, int n);
 /* Print the list information */
 void object_list_describe(object_list * list);
 
@@ -139,10 +147,22 @@ void object_list_describe(object_list * list);
  */
 /* Insert an object into the list at position n */
 int object_list_insert(object_list * list, int n, void * item);
+/* Insert count objects stored one after the other at position n */
+int object_list_insert_many(object_list * list, int n, void * items, int count);
+/* Move an object into the list at position n, without copying what it owns */
+int object_list_insert_move(object_list * list, int n, void * item);
 /* Remove the object at position n from the list */
 int object_list_remove(object_list * list, int n);
+/* Remove the object at position n, moving the last object into its place */
+int object_list_swap_remove(object_list * list, int n);
+/* Move the object at position n out of the list into dest */
+int object_list_take(object_list * list, int n, void * dest);
 /*  Add an objet to the end of the list */
 int object_list_append(object_list * list, void * item);
+/* Add count objects stored one after the other to the end of the list */
+int object_list_append_many(object_list * list, void * items, int count);
+/* Move an object to the end of the list, without copying what it owns */
+int object_list_append_move(object_list * list, void * item);
 /* Get a pointer to the object at position n in the list */
 void * object_list_get_item(object_list * list, int n);
 /* Search the list for something equal to item
@@ -157,6 +177,7 @@ void * object_list_find_item(object_list * list, void * item);
 #ifdef PCB_UNIT_TEST
 void object_list_register_tests(void);
 void object_list_test(void);
+void object_list_test_bulk(void);
 #endif /* PCB_UNIT_TEST */
 
 #endif /* object_list_h */
@@ -0,0 +1,412 @@
+/*!
+ * \file src/parse_fast.c
+ *
+ * \brief Hand-written scanner for plain .pcb, footprint and font files.
+ *
+ * The flex scanner of parse_l.l reads its input through stdio and
+ * copies every token into yytext before acting on it.  For files that
+ * are read directly (no FileCommand or FontCommand filter) this scanner
+ * maps the file into memory and tokenizes it in place instead.
+ *
+ * It returns exactly the tokens and semantic values the flex rules do,
+ * including flex's longest-match choice between the keywords, so the
+ * grammar in parse_y.y can't tell the two apart:
+ * - keywords and unit suffixes are the longest keyword that is a prefix
+ *   of the run of letters, a letter which starts no keyword is returned
+ *   as itself;
+ * - numbers are converted by the same library calls as in parse_l.l;
+ * - strings are returned in a calloc()ed copy with backslash escapes
+ *   removed, NULL for "", as the grammar free()s or keeps them;
+ * - a quote without a closing quote on the same line is returned as a
+ *   single character.
+ *
+ * The --no-fast-parser option keeps the flex scanner for everything,
+ * the test suite uses it to check both give the same boards.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "parse_fast.h"
+#include "parse_y.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+extern int yylineno;
+int yyerror (const char *);
+
+/*!
+ * \brief Longest number token converted from a stack buffer.
+ */
+#define FAST_NUMBER_MAX 64
+
+typedef struct
+{
+  const char *name;
+  int len;
+  int token;
+} fast_keyword;
+
+/*!
+ * \brief The keywords of parse_l.l.
+ */
+static const fast_keyword keywords[] = {
+  {"FileVersion", 11, T_FILEVERSION},
+  {"PCB", 3, T_PCB},
+  {"Grid", 4, T_GRID},
+  {"Cursor", 6, T_CURSOR},
+  {"Thermal", 7, T_THERMAL},
+  {"PolyArea", 8, T_AREA},
+  {"DRC", 3, T_DRC},
+  {"Flags", 5, T_FLAGS},
+  {"Layer", 5, T_LAYER},
+  {"Pin", 3, T_PIN},
+  {"Pad", 3, T_PAD},
+  {"Via", 3, T_VIA},
+  {"Line", 4, T_LINE},
+  {"Rat", 3, T_RAT},
+  {"Rectangle", 9, T_RECTANGLE},
+  {"Text", 4, T_TEXT},
+  {"ElementLine", 11, T_ELEMENTLINE},
+  {"ElementArc", 10, T_ELEMENTARC},
+  {"Element", 7, T_ELEMENT},
+  {"SymbolLine", 10, T_SYMBOLLINE},
+  {"Symbol", 6, T_SYMBOL},
+  {"Mark", 4, T_MARK},
+  {"Groups", 6, T_GROUPS},
+  {"Styles", 6, T_STYLES},
+  {"Polygon", 7, T_POLYGON},
+  {"Hole", 4, T_POLYGON_HOLE},
+  {"Arc", 3, T_ARC},
+  {"NetList", 7, T_NETLIST},
+  {"Net", 3, T_NET},
+  {"Connect", 7, T_CONN},
+  {"Attribute", 9, T_ATTRIBUTE},
+  {"nm", 2, T_NM},
+  {"um", 2, T_UM},
+  {"mm", 2, T_MM},
+  {"m", 1, T_M},
+  {"km", 2, T_KM},
+  {"umil", 4, T_UMIL},
+  {"cmil", 4, T_CMIL},
+  {"mil", 3, T_MIL},
+  {"in", 2, T_IN},
+  {"px", 2, T_PX},
+};
+
+static GMappedFile *fast_file = NULL;
+static const char *fast_pos, *fast_end;
+/* a NUL byte ended the scan */
+static bool fast_nul;
+
+/*!
+ * \brief Map a file for FastLex().
+ *
+ * \return false, without a message, if the file can't be mapped.  The
+ * caller then opens it the usual way and reports the error.
+ */
+bool
+FastLexOpen (const char *filename)
+{
+  fast_file = g_mapped_file_new (filename, FALSE, NULL);
+  if (fast_file == NULL)
+    return false;
+
+  fast_pos = g_mapped_file_get_contents (fast_file);
+  fast_end = fast_pos + g_mapped_file_get_length (fast_file);
+  if (fast_pos == NULL)
+    fast_pos = fast_end = "";
+  fast_nul = false;
+  return true;
+}
+
+/*!
+ * \brief Unmap the file of FastLex().
+ *
+ * \return non-zero if the scan ended at a NUL byte, the board is not to
+ * be used then, whatever the grammar made of the part before it.
+ */
+int
+FastLexClose (void)
+{
+  if (fast_file)
+    g_mapped_file_unref (fast_file);
+  fast_file = NULL;
+  fast_pos = fast_end = NULL;
+  return fast_nul;
+}
+
+static bool
+is_letter (char c)
+{
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static bool
+is_digit (char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+static bool
+is_hex_digit (char c)
+{
+  return is_digit (c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/*!
+ * \brief Scan a keyword, or a single letter, at fast_pos.
+ */
+static int
+fast_keyword_token (void)
+{
+  const char *p = fast_pos;
+  int run = 0, best = -1, i;
+
+  while (p + run < fast_end && is_letter (p[run]))
+    run++;
+
+  for (i = 0; i < sizeof (keywords) / sizeof (keywords[0]); i++)
+    if (keywords[i].name[0] == *p && keywords[i].len <= run
+        && (best < 0 || keywords[i].len > keywords[best].len)
+        && memcmp (keywords[i].name, p, keywords[i].len) == 0)
+      best = i;
+
+  if (best < 0)
+    {
+      fast_pos++;
+      return *p;
+    }
+  fast_pos += keywords[best].len;
+  return keywords[best].token;
+}
+
+/*!
+ * \brief Length of the INTEGER pattern [+-]?([1-9][0-9]*|0) at p, or 0.
+ */
+static int
+integer_length (const char *p)
+{
+  const char *q = p;
+
+  if (q < fast_end && (*q == '+' || *q == '-'))
+    q++;
+  if (q >= fast_end || !is_digit (*q))
+    return 0;
+  if (*q++ != '0')
+    while (q < fast_end && is_digit (*q))
+      q++;
+  return q - p;
+}
+
+/*!
+ * \brief Scan an INTEGER, FLOATING or hex number at fast_pos.
+ *
+ * \return 0 if no number starts there.
+ */
+static int
+fast_number_token (void)
+{
+  const char *p = fast_pos;
+  char tmp[FAST_NUMBER_MAX], *text;
+  int len, token;
+  bool hex = false;
+
+  if (fast_end - p > 2 && p[0] == '0' && p[1] == 'x' && is_hex_digit (p[2]))
+    {
+      len = 3;
+      while (p + len < fast_end && is_hex_digit (p[len]))
+        len++;
+      token = INTEGER;
+      hex = true;
+    }
+  else
+    {
+      len = integer_length (p);
+      token = INTEGER;
+      if (p + len < fast_end && p[len] == '.')
+        {
+          len++;
+          while (p + len < fast_end && is_digit (p[len]))
+            len++;
+          token = FLOATING;
+        }
+      else if (len == 0)
+        return 0;
+    }
+
+  if (token == INTEGER && !hex && len < 10)
+    {
+      /* Short enough to be exact in an int, as strtod () would be */
+      int i = (*p == '+' || *p == '-') ? 1 : 0, n = 0;
+
+      for (; i < len; i++)
+        n = n * 10 + (p[i] - '0');
+      yylval.integer = *p == '-' ? -n : n;
+      fast_pos += len;
+      return INTEGER;
+    }
+
+  text = len < FAST_NUMBER_MAX ? tmp : malloc (len + 1);
+  memcpy (text, p, len);
+  text[len] = '\0';
+  fast_pos += len;
+
+  if (hex)
+    {
+      unsigned n;
+
+      sscanf (text, "%x", &n);
+      yylval.integer = n;
+    }
+  else if (token == INTEGER)
+    yylval.integer = round (g_ascii_strtod (text, NULL));
+  else
+    yylval.number = g_ascii_strtod (text, NULL);
+
+  if (text != tmp)
+    free (text);
+  return token;
+}
+
+/*!
+ * \brief Scan a string at fast_pos.
+ *
+ * \return 0 if the quote isn't closed on the same line.
+ */
+static int
+fast_string_token (void)
+{
+  const char *p = fast_pos + 1;
+  const char *q;
+  char *s;
+  int len = 0;
+
+  for (q = p; q < fast_end && *q != '"'; q++, len++)
+    {
+      if (*q == '\n' || *q == '\r')
+        return 0;
+      if (*q == '\\')
+        {
+          q++;
+          if (q >= fast_end || *q == '\n')
+            return 0;
+        }
+    }
+  if (q >= fast_end)
+    return 0;
+
+  fast_pos = q + 1;
+  if (q == p)
+    {
+      yylval.string = NULL;
+      return STRING;
+    }
+
+  yylval.string = s = (char *) calloc (len + 1, sizeof (char));
+  for (; p < q; p++)
+    {
+      if (*p == '\\')
+        p++;
+      *s++ = *p;
+    }
+  return STRING;
+}
+
+/*!
+ * \brief The next token of the mapped file, like the flex yylex().
+ */
+int
+FastLex (void)
+{
+  const char *p;
+  int token;
+
+  while (fast_pos < fast_end)
+    {
+      p = fast_pos;
+      switch (*p)
+        {
+        case '\n':
+          yylineno++;
+          /* Fall through. */
+        case ' ':
+        case '\t':
+        case '\r':
+          fast_pos++;
+          continue;
+
+        case '\0':
+          yyerror ("NUL byte in the file");
+          fast_nul = true;
+          fast_pos = fast_end;
+          return 0;
+
+        case '#':
+          p = memchr (p, '\n', fast_end - p);
+          fast_pos = p ? p : fast_end;
+          continue;
+
+        case '"':
+          if ((token = fast_string_token ()) != 0)
+            return token;
+          break;
+
+        case '\'':
+          if (fast_end - p >= 3 && p[1] != '\n' && p[2] == '\'')
+            {
+              yylval.integer = (unsigned) p[1];
+              fast_pos += 3;
+              return CHAR_CONST;
+            }
+          break;
+
+        case '+': case '-': case '.':
+        case '0': case '1': case '2': case '3': case '4':
+        case '5': case '6': case '7': case '8': case '9':
+          if ((token = fast_number_token ()) != 0)
+            return token;
+          break;
+
+        default:
+          if (is_letter (*p))
+            return fast_keyword_token ();
+          break;
+        }
+
+      fast_pos++;
+      return *p;
+    }
+  return 0;
+}
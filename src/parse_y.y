@@ -42,6 +42,7 @@
 #endif
 
 #include "global.h"
+#include "boardcache.h"
 #include "create.h"
 #include "data.h"
 #include "error.h"
@@ -56,6 +57,7 @@
 #include "rtree.h"
 #include "strflags.h"
 #include "thermal.h"
+#include "timing.h"
 #include "move.h"
 
 #ifdef HAVE_LIBDMALLOC
@@ -220,11 +222,12 @@ parsepcb
 			 * we didn't know the layer grouping before.
 			 */
 			PCB = yyPCB;
-			ALLPOLYGON_LOOP (yyData);
-			{
-			  InitClip (yyData, layer, polygon);
-			}
-			ENDALL_LOOP;
+			/* bulk load the r-trees, see Parse() */
+			r_flush_inserts ();
+			TIMING_BEGIN (TIMING_CLIP);
+			if (!BoardCacheRestore (yyData))
+			  InitClipAll (yyData);
+			TIMING_END (TIMING_CLIP);
 			PCB = pcb_save;
 			}		   
 			;
@@ -1346,7 +1349,7 @@ polygon_format
 				  {
 				    SetPolygonBoundingBox (Polygon);
 				    if (!Layer->polygon_tree)
-				      Layer->polygon_tree = r_create_tree (NULL, 0, 0);
+				      Layer->polygon_tree = r_create_data_tree ();
 				    r_insert_entry (Layer->polygon_tree, (BoxType *) Polygon, 0);
 				  }
 			}
@@ -314,6 +314,96 @@ static int min_sig_figs(double d)
   return rv;
 }
 
+/*!
+ * \brief Output of the formatter.
+ *
+ * The output goes into a buffer given by the caller, usually on its
+ * stack, and only moves to the heap if it outgrows it.  It is always
+ * null terminated.
+ */
+typedef struct
+{
+  char *str;
+  size_t len;
+  size_t size;
+  bool heap;
+} OutBuffer;
+
+static void out_init (OutBuffer *out, char *buf, size_t size)
+{
+  out->str = buf;
+  out->len = 0;
+  out->size = size;
+  out->heap = false;
+  out->str[0] = '\0';
+}
+
+static void out_reserve (OutBuffer *out, size_t n)
+{
+  size_t size;
+  char *str;
+
+  if (out->len + n < out->size)
+    return;
+  size = MAX (2 * out->size, out->len + n + 1);
+  if (out->heap)
+    str = g_realloc (out->str, size);
+  else
+    {
+      str = g_malloc (size);
+      memcpy (str, out->str, out->len + 1);
+    }
+  out->str = str;
+  out->size = size;
+  out->heap = true;
+}
+
+static void out_append (OutBuffer *out, const char *s, size_t n)
+{
+  out_reserve (out, n);
+  memcpy (out->str + out->len, s, n);
+  out->len += n;
+  out->str[out->len] = '\0';
+}
+
+static void out_append_c (OutBuffer *out, char c)
+{
+  out_append (out, &c, 1);
+}
+
+static void out_free (OutBuffer *out)
+{
+  if (out->heap)
+    g_free (out->str);
+}
+
+/*!
+ * \brief Append a printf conversion to the output.
+ *
+ * The output stops at a null byte in the conversion, as it did when
+ * each conversion was a string of its own.
+ */
+static void out_printf (OutBuffer *out, const char *fmt, ...)
+{
+  va_list args, again;
+  int n;
+
+  va_start (args, fmt);
+  va_copy (again, args);
+  n = vsnprintf (out->str + out->len, out->size - out->len, fmt, args);
+  if (n >= 0 && (size_t) n >= out->size - out->len)
+    {
+      out_reserve (out, n);
+      n = vsnprintf (out->str + out->len, out->size - out->len, fmt, again);
+    }
+  va_end (again);
+  va_end (args);
+
+  if (n >= 0)
+    out->len += strlen (out->str + out->len);
+  out->str[out->len] = '\0';
+}
+
 /*!
  * \brief Internal coord-to-string converter for pcb-printf.
  *
@@ -322,31 +412,27 @@ static int min_sig_figs(double d)
  * given, the list is enclosed in parens to make the scope of
  * the unit suffix clear.
  *
+ * \param [in] out          Output to append the string to.
  * \param [in] coord        Array of coords to convert.
- * \param [in] n_coords     Number of coords in array.
+ * \param [in] n_coords     Number of coords in array, at most
+ *                          MAX_COORDS.
  * \param [in] printf_spec  printf sub-specifier to use with %f.
  * \param [in] e_allow      Bitmap of units the function may use.
  * \param [in] suffix_type  Whether to add a suffix.
- *
- * \return A string containing the formatted coords. Must be freed with
- * g_free.
  */
-static gchar *CoordsToString(Coord coord[], int n_coords, const char *printf_spec, enum e_allow allow, enum e_suffix suffix_type)
+#define MAX_COORDS 10
+
+static void CoordsToBuffer(OutBuffer *out, Coord coord[], int n_coords, const char *printf_spec, enum e_allow allow, enum e_suffix suffix_type)
 {
-  GString *buff;
-  gchar *printf_buff;
+  gchar spec_buff[64];
+  gchar *printf_buff = spec_buff;
   gchar filemode_buff[G_ASCII_DTOSTR_BUF_SIZE];
   enum e_family family;
-  double *value;
+  double value[MAX_COORDS];
   const char *suffix;
   int i, n;
 
-  value = malloc (n_coords * sizeof *value);
-  buff  = g_string_new ("");
-
   /* Sanity checks */
-  if (buff == NULL || value == NULL)
-    return NULL;
   if (allow == 0)
     allow = ALLOW_ALL;
   if (printf_spec == NULL)
@@ -418,34 +504,31 @@ static gchar *CoordsToString(Coord coord[], int n_coords, const char *printf_spe
          printf_spec[i] == '-' || printf_spec[i] == '+' ||
          printf_spec[i] == '#')
     ++i;
+  if (strlen (printf_spec) + 16 > sizeof spec_buff)
+    printf_buff = g_malloc (strlen (printf_spec) + 16);
   if (printf_spec[i] == '.')
-    printf_buff = g_strdup_printf (", %sf", printf_spec);
+    sprintf (printf_buff, ", %sf", printf_spec);
   else
-    printf_buff = g_strdup_printf (", %s.%df", printf_spec, Units[n].default_prec);
+    sprintf (printf_buff, ", %s.%df", printf_spec, Units[n].default_prec);
 
   /* Actually sprintf the values in place
    *  (+ 2 skips the ", " for first value) */
   if (n_coords > 1)
-    g_string_append_c (buff, '(');
-  if (suffix_type == FILE_MODE || suffix_type == FILE_MODE_NO_SUFFIX)
-    {
-      g_ascii_formatd (filemode_buff, sizeof filemode_buff, printf_buff + 2, value[0]);
-      g_string_append_printf (buff, "%s", filemode_buff);
-    }
-  else
-    g_string_append_printf (buff, printf_buff + 2, value[0]);
-  for (i = 1; i < n_coords; ++i)
+    out_append_c (out, '(');
+  for (i = 0; i < n_coords; ++i)
     {
+      const char *f = i == 0 ? printf_buff + 2 : printf_buff;
+
       if (suffix_type == FILE_MODE || suffix_type == FILE_MODE_NO_SUFFIX)
         {
-          g_ascii_formatd (filemode_buff, sizeof filemode_buff, printf_buff, value[i]);
-          g_string_append_printf (buff, "%s", filemode_buff);
+          g_ascii_formatd (filemode_buff, sizeof filemode_buff, f, value[i]);
+          out_append (out, filemode_buff, strlen (filemode_buff));
         }
       else
-        g_string_append_printf (buff, printf_buff, value[i]);
+        out_printf (out, f, value[i]);
     }
   if (n_coords > 1)
-    g_string_append_c (buff, ')');
+    out_append_c (out, ')');
   /* Append suffix */
   if (value[0] != 0 || n_coords > 1)
     {
@@ -455,225 +538,523 @@ static gchar *CoordsToString(Coord coord[], int n_coords, const char *printf_spe
         case FILE_MODE_NO_SUFFIX:
           break;
         case SUFFIX:
-          g_string_append_printf (buff, " %s", suffix);
+          out_append_c (out, ' ');
+          out_append (out, suffix, strlen (suffix));
           break;
         case FILE_MODE:
-          g_string_append_printf (buff, "%s", suffix);
+          out_append (out, suffix, strlen (suffix));
           break;
         }
     }
 
-  g_free (printf_buff);
-  free (value);
-  /* Return just the gchar* part of our string */
-  return g_string_free (buff, FALSE);
+  if (printf_buff != spec_buff)
+    g_free (printf_buff);
 }
 
 /*!
- * \brief Main pcb-printf function.
+ * \brief %g length of a mantissa, for FileCoordToString().
+ *
+ * Does what min_sig_figs() does, with the same arithmetic, but counts
+ * the digits sprintf ("%g") would give instead of calling it.
+ *
+ * \return the length, or -1 if the value is too close to a rounding
+ * boundary to be sure.
+ */
+static int fast_sig_figs (double d)
+{
+  double t, f;
+  int r, len;
+
+  if (d == 0)
+    return 0;
+
+  if (d < 0)     d *= -1;
+  while (d >= 10) d /= 10;
+  while (d < 1)   d *= 10;
+
+  /* %g keeps 6 significant digits */
+  t = d * 100000;
+  f = t - floor (t);
+  if (fabs (f - 0.5) < 1e-6)
+    return -1;
+  r = (int) floor (t) + (f > 0.5);
+  if (r >= 1000000)
+    return 2;   /* "10" */
+  for (len = 6; r % 10 == 0; r /= 10)
+    --len;
+  return len > 1 ? len + 1 : 1;
+}
+
+/*!
+ * \brief Format |v| * 10^-prec, i.e. "%.<prec>f", into buf.
+ *
+ * \return the length, or -1 if v is too large or too close to a
+ * rounding boundary to be sure.
+ */
+static int fast_fixed (char *buf, double v, int prec)
+{
+  char digits[24];
+  double scale = 1, t, f;
+  long long q;
+  int n = 0, len = 0, i;
+
+  for (i = 0; i < prec; ++i)
+    scale *= 10;
+  t = fabs (v) * scale;
+  if (t >= 1e9)
+    return -1;
+  f = t - floor (t);
+  if (fabs (f - 0.5) < 1e-6)
+    return -1;
+  q = (long long) floor (t) + (f > 0.5);
+
+  do
+    {
+      digits[n++] = '0' + q % 10;
+      q /= 10;
+    }
+  while (q > 0 || n <= prec);
+
+  if (v < 0)
+    buf[len++] = '-';
+  while (n > 0)
+    {
+      if (n == prec)
+        buf[len++] = '.';
+      buf[len++] = digits[--n];
+    }
+  buf[len] = '\0';
+  return len;
+}
+
+/*!
+ * \brief Fast path for the %mr coords of .pcb files.
+ *
+ * Gives the same string CoordsToBuffer() gives for a single coord in
+ * FILE_MODE, when the only units allowed are mm and mil, as they are
+ * for saving.  The arithmetic is the same, but the digits are formatted
+ * here instead of through several sprintf () calls and allocations.
+ *
+ * \return the length of the string in buf, or -1 if the caller has to
+ * use CoordsToBuffer().
+ */
+static int FileCoordToString (char *buf, Coord coord, enum e_allow allow)
+{
+  enum e_allow metric = allow & ALLOW_METRIC;
+  enum e_allow imperial = allow & ALLOW_IMPERIAL;
+  enum e_family family;
+  int len, mil_figs, mm_figs;
+
+  if ((metric != 0 && metric != ALLOW_MM)
+      || (imperial != 0 && imperial != ALLOW_MIL)
+      || (metric == 0 && imperial == 0))
+    return -1;
+
+  if (imperial == 0)
+    family = METRIC;
+  else if (metric == 0)
+    family = IMPERIAL;
+  else
+    {
+      mil_figs = fast_sig_figs (COORD_TO_MIL (coord));
+      mm_figs = fast_sig_figs (COORD_TO_MM (coord));
+      if (mil_figs < 0 || mm_figs < 0)
+        return -1;
+      family = mil_figs < mm_figs ? IMPERIAL : METRIC;
+    }
+
+  if (family == METRIC)
+    len = fast_fixed (buf, COORD_TO_MM (coord), 4);
+  else
+    len = fast_fixed (buf, COORD_TO_MIL (coord), 2);
+  if (len < 0)
+    return -1;
+
+  if (coord != 0)
+    {
+      strcpy (buf + len, family == METRIC ? "mm" : "mil");
+      len += family == METRIC ? 2 : 3;
+    }
+  return len;
+}
+
+/*!
+ * \brief A conversion, or a run of plain text, of a compiled format.
+ */
+typedef struct
+{
+  const char *text;	/*!< The text, or the printf sub-specifier. */
+  int len;		/*!< Length of the text. */
+  char conv;		/*!< Conversion character, '\0' for text. */
+  char unit;		/*!< The character after 'm' for our specs. */
+  char suffix;		/*!< enum e_suffix for our specs and %e/%f/%g. */
+  char cmil;		/*!< A '#' was given, restricting the units to cmil. */
+  char stars;		/*!< Number of '*' in the sub-specifier. */
+  char longs;		/*!< Number of 'l' in the sub-specifier. */
+  short unit_n;		/*!< Index in Units[] of the unit code, or -1. */
+} FormatPiece;
+
+/*!
+ * \brief A format parsed once, for the formats used over and over.
+ */
+typedef struct
+{
+  int n_pieces;
+  FormatPiece *pieces;
+  char *strings;	/*!< Storage of the texts of the pieces. */
+} CompiledFormat;
+
+/*! Most formats kept compiled; the rest are compiled for each call. */
+#define MAX_COMPILED_FORMATS 1024
+
+G_LOCK_DEFINE_STATIC (formats);
+static GHashTable *formats = NULL;
+
+/*!
+ * \brief Parse a format into pieces.
+ *
+ * This does the parsing pcb_vprintf() used to do for each call, so the
+ * output is the same: text runs are copied as they are, the printf
+ * sub-specifier of a conversion is kept with its '*' widths to be
+ * filled in from the arguments, and our own sub-specifiers are noted.
+ */
+static CompiledFormat *CompileFormat (const char *fmt)
+{
+  CompiledFormat *cf = g_new0 (CompiledFormat, 1);
+  FormatPiece *piece;
+  const char *p;
+  char *s;
+  int n = 0;
+
+  /* Every piece starts at a '%' or after one; the spec of a
+     conversion is at most its own text plus a conversion character */
+  for (p = fmt; *p; ++p)
+    if (*p == '%')
+      ++n;
+  cf->pieces = g_new0 (FormatPiece, 2 * n + 1);
+  cf->strings = s = g_malloc (2 * strlen (fmt) + 2 * n + 2);
+
+  while (*fmt)
+    {
+      piece = &cf->pieces[cf->n_pieces++];
+      piece->unit_n = -1;
+
+      if (*fmt != '%')
+        {
+          for (p = fmt; *p && *p != '%'; ++p)
+            ;
+          piece->text = s;
+          piece->len = p - fmt;
+          memcpy (s, fmt, piece->len);
+          s += piece->len;
+          *s++ = '\0';
+          fmt = p;
+          continue;
+        }
+
+      piece->text = s;
+      *s++ = '%';
+      for (++fmt; *fmt; ++fmt)
+        {
+          if (*fmt == '#')
+            piece->cmil = 1;
+          else if (*fmt == '$')
+            piece->suffix = (piece->suffix == NO_SUFFIX) ? SUFFIX : FILE_MODE;
+          else if (*fmt == '`')
+            piece->suffix = (piece->suffix == SUFFIX) ? FILE_MODE : FILE_MODE_NO_SUFFIX;
+          else if (*fmt == '*')
+            {
+              *s++ = '*';
+              piece->stars++;
+            }
+          else if (strchr (". lLh+-0123456789", *fmt))
+            {
+              *s++ = *fmt;
+              if (*fmt == 'l')
+                piece->longs++;
+            }
+          else
+            break;
+        }
+
+      /* a '%' at the very end converts nothing */
+      piece->conv = *fmt ? *fmt : '!';
+      if (*fmt != 'm')
+        *s++ = *fmt;
+      else if (*++fmt)
+        {
+          int i;
+
+          piece->unit = *fmt;
+          for (i = 0; i < N_UNITS; ++i)
+            if (*fmt == Units[i].printf_code)
+              piece->unit_n = i;
+          if (*fmt == 'a')
+            {
+              strcpy (s, piece->suffix == SUFFIX ? "f deg" : "f");
+              s += strlen (s);
+            }
+        }
+      *s++ = '\0';
+      piece->len = s - piece->text - 1;
+      if (*fmt)
+        ++fmt;
+    }
+
+  return cf;
+}
+
+static void FreeCompiledFormat (CompiledFormat *cf)
+{
+  g_free (cf->pieces);
+  g_free (cf->strings);
+  g_free (cf);
+}
+
+/*!
+ * \brief Find the compiled form of a format, compiling it the first
+ * time.
+ *
+ * \param [out] temporary  Set if the format was not kept, and has to be
+ *                          freed by the caller.
+ */
+static CompiledFormat *LookupFormat (const char *fmt, bool *temporary)
+{
+  CompiledFormat *cf;
+
+  *temporary = false;
+  G_LOCK (formats);
+  if (formats == NULL)
+    formats = g_hash_table_new (g_str_hash, g_str_equal);
+  cf = g_hash_table_lookup (formats, fmt);
+  if (cf == NULL)
+    {
+      cf = CompileFormat (fmt);
+      if (g_hash_table_size (formats) < MAX_COMPILED_FORMATS)
+        g_hash_table_insert (formats, g_strdup (fmt), cf);
+      else
+        *temporary = true;
+    }
+  G_UNLOCK (formats);
+  return cf;
+}
+
+/*!
+ * \brief Fill in the '*' widths and precisions of a sub-specifier.
+ *
+ * \return the sub-specifier, in buf if it fits and on the heap if not.
+ */
+static const char *ExpandSpec (const FormatPiece *piece, int *widths,
+                               char *buf, size_t size)
+{
+  const char *p;
+  char *s;
+  int w = 0;
+
+  if (piece->stars == 0)
+    return piece->text;
+  if (piece->len + 12 * piece->stars + 1 > size)
+    buf = g_malloc (piece->len + 12 * piece->stars + 1);
+  for (p = piece->text, s = buf; *p; ++p)
+    if (*p == '*')
+      s += sprintf (s, "%d", widths[w++]);
+    else
+      *s++ = *p;
+  *s = '\0';
+  return buf;
+}
+
+/*!
+ * \brief The formatter behind all the pcb-printf functions.
  *
  * This is a printf wrapper that accepts new format specifiers to
  * output pcb coords as various units. See the comment at the top
  * of pcb-printf.h for full details.
  *
+ * The format is compiled on first use, and the output goes straight
+ * into out, so most calls allocate nothing at all.
+ *
+ * \param [in] out    Output to append to.
  * \param [in] fmt    Format specifier.
  * \param [in] args   Arguments to specifier.
- *
- * \return A formatted string. Must be freed with g_free.
  */
-gchar *pcb_vprintf(const char *fmt, va_list args)
+static void pcb_vformat (OutBuffer *out, const char *fmt, va_list args)
 {
-  GString *string = g_string_new ("");
-  GString *spec   = g_string_new ("");
-
   enum e_allow mask = ALLOW_ALL;
+  CompiledFormat *cf;
+  bool temporary;
+  int p;
 
-  if (string == NULL || spec == NULL)
-    return NULL;
+  cf = LookupFormat (fmt, &temporary);
 
-  while(*fmt)
+  for (p = 0; p < cf->n_pieces; ++p)
     {
-      enum e_suffix suffix = NO_SUFFIX;
+      const FormatPiece *piece = &cf->pieces[p];
+      enum e_suffix suffix = piece->suffix;
+      const char *ext_unit = "";
+      const char *spec;
+      char spec_buff[64];
+      char file_buff[64];
+      Coord value[MAX_COORDS];
+      int widths[16];
+      int count, i, unit_n;
+
+      if (piece->conv == '\0')
+        {
+          out_append (out, piece->text, piece->len);
+          continue;
+        }
 
-      if(*fmt == '%')
+      if (piece->cmil)
+        mask = ALLOW_CMIL;  /* This must be pcb's base unit */
+      for (i = 0; i < piece->stars; ++i)
         {
-          gchar *unit_str = NULL;
-          const char *ext_unit = "";
-          Coord value[10];
-          int count, i, done;
+          int w = va_arg (args, int);
 
-          g_string_assign (spec, "%");
+          if (i < sizeof widths / sizeof widths[0])
+            widths[i] = w;
+        }
+      spec = ExpandSpec (piece, widths, spec_buff, sizeof spec_buff);
 
-          done = 0;
-          while ( ! done && fmt++ && *fmt)
+      switch (piece->conv)
+        {
+        /* Printf specs */
+        case 'o': case 'i': case 'd':
+        case 'u': case 'x': case 'X':
+          if (piece->longs > 1)
+            out_printf (out, spec, va_arg (args, long long));
+          else if (piece->longs == 1)
+            out_printf (out, spec, va_arg (args, long));
+          else
+            out_printf (out, spec, va_arg (args, int));
+          break;
+        case 'e': case 'E':
+        case 'f': case 'F':
+        case 'g': case 'G':
+          if (suffix == FILE_MODE || suffix == FILE_MODE_NO_SUFFIX)
             {
-              switch (*fmt)
-                {
-                /* Our sub-specifiers */
-                case '#':
-                  mask = ALLOW_CMIL;  /* This must be pcb's base unit */
-                  break;
-                case '$':
-                  suffix = (suffix == NO_SUFFIX) ? SUFFIX : FILE_MODE;
-                  break;
-                case '`':
-                  suffix = (suffix == SUFFIX) ? FILE_MODE : FILE_MODE_NO_SUFFIX;
-                  break;
-                /* Printf sub-specifiers */
-                case '*':
-                  g_string_append_printf (spec, "%d", va_arg (args, int));
-                  break;
-                case '.':
-                case ' ':
-                //case '#': (duplicate)
-                case 'l':
-                case 'L':
-                case 'h':
-                case '+':
-                case '-':
-                case '0':
-                case '1':
-                case '2':
-                case '3':
-                case '4':
-                case '5':
-                case '6':
-                case '7':
-                case '8':
-                case '9':
-                  g_string_append_c (spec, *fmt);
-                  break;
-                default:
-                  done = 1;
-                }
-            }
+              gchar buffer[128];
 
-          /* Tack full specifier onto specifier */
-          if (*fmt != 'm')
-            g_string_append_c (spec, *fmt);
-          switch(*fmt)
+              buffer[0] = '\0';
+              g_ascii_formatd (buffer, 128, spec, va_arg (args, double));
+              out_append (out, buffer, strlen (buffer));
+            }
+          else
+            out_printf (out, spec, va_arg (args, double));
+          break;
+        case 'c':
+          if (piece->longs && sizeof(int) <= sizeof(wchar_t))
+            out_printf (out, spec, va_arg (args, wchar_t));
+          else
+            out_printf (out, spec, va_arg (args, int));
+          break;
+        case 's':
+          if (piece->longs)
+            out_printf (out, spec, va_arg (args, wchar_t *));
+          else
+            out_printf (out, spec, va_arg (args, char *));
+          break;
+        case 'n':
+          /* Depending on gcc settings, this will probably break with
+           *  some silly "can't put %n in writeable data space" message */
+          out_printf (out, spec, va_arg (args, int *));
+          break;
+        case 'p':
+          out_printf (out, spec, va_arg (args, void *));
+          break;
+        case '%':
+          out_append_c (out, '%');
+          break;
+        /* Our specs */
+        case 'm':
+          if (piece->unit == '*')
+            ext_unit = va_arg (args, const char *);
+          if (piece->unit != '+' && piece->unit != 'a')
+            value[0] = va_arg (args, Coord);
+          count = 1;
+          switch (piece->unit)
             {
-            /* Printf specs */
-            case 'o': case 'i': case 'd':
-            case 'u': case 'x': case 'X':
-              if(strchr (spec->str, 'l'))
-                {
-                  if(strchr (spec->str, 'l') != strrchr (spec->str, 'l'))
-                    unit_str = g_strdup_printf (spec->str, va_arg(args, long long));
-                  else
-                    unit_str = g_strdup_printf (spec->str, va_arg(args, long));
-                }
-              else
-                {
-                  unit_str = g_strdup_printf (spec->str, va_arg(args, int));
-                }
-              break;
-            case 'e': case 'E':
-            case 'f': case 'F':
-            case 'g': case 'G':
-              if(suffix == FILE_MODE || suffix == FILE_MODE_NO_SUFFIX)
-                {
-                  gchar buffer[128];
-                  g_ascii_formatd (buffer, 128, spec->str, va_arg(args, double));
-                  unit_str = g_strdup_printf ("%s", buffer);
-                }
+            case 's': CoordsToBuffer (out, value, 1, spec, ALLOW_MM | ALLOW_MIL, suffix); break;
+            case 'S': CoordsToBuffer (out, value, 1, spec, mask & ALLOW_ALL, suffix); break;
+            case 'M': CoordsToBuffer (out, value, 1, spec, mask & ALLOW_METRIC, suffix); break;
+            case 'L': CoordsToBuffer (out, value, 1, spec, mask & ALLOW_IMPERIAL, suffix); break;
+            case 'r':
+              if (piece->len == 1
+                  && (i = FileCoordToString (file_buff, value[0],
+                                             set_allow_readable(0))) >= 0)
+                out_append (out, file_buff, i);
               else
-                unit_str = g_strdup_printf (spec->str, va_arg(args, double));
+                CoordsToBuffer (out, value, 1, spec, set_allow_readable(0), FILE_MODE);
               break;
-            case 'c':
-              if(strchr (spec->str, 'l') && sizeof(int) <= sizeof(wchar_t))
-                unit_str = g_strdup_printf (spec->str, va_arg(args, wchar_t));
-              else
-                unit_str = g_strdup_printf (spec->str, va_arg(args, int));
+            /* All these fallthroughs are deliberate */
+            case '9': value[count++] = va_arg(args, Coord);
+            case '8': value[count++] = va_arg(args, Coord);
+            case '7': value[count++] = va_arg(args, Coord);
+            case '6': value[count++] = va_arg(args, Coord);
+            case '5': value[count++] = va_arg(args, Coord);
+            case '4': value[count++] = va_arg(args, Coord);
+            case '3': value[count++] = va_arg(args, Coord);
+            case '2':
+            case 'D':
+              value[count++] = va_arg(args, Coord);
+              CoordsToBuffer (out, value, count, spec, mask & ALLOW_ALL, suffix);
               break;
-            case 's':
-              if(strchr (spec->str, 'l'))
-                unit_str = g_strdup_printf (spec->str, va_arg(args, wchar_t *));
-              else
-                unit_str = g_strdup_printf (spec->str, va_arg(args, char *));
+            case 'd':
+              value[1] = va_arg(args, Coord);
+              CoordsToBuffer (out, value, 2, spec, ALLOW_MM | ALLOW_MIL, suffix);
               break;
-            case 'n':
-              /* Depending on gcc settings, this will probably break with
-               *  some silly "can't put %n in writeable data space" message */
-              unit_str = g_strdup_printf (spec->str, va_arg(args, int *));
+            case '*':
+              unit_n = -1;
+              for (i = 0; i < N_UNITS; ++i)
+                if (strcmp (ext_unit, Units[i].suffix) == 0)
+                  unit_n = i;
+              CoordsToBuffer (out, value, 1, spec,
+                              unit_n >= 0 ? Units[unit_n].allow : mask & ALLOW_ALL,
+                              suffix);
               break;
-            case 'p':
-              unit_str = g_strdup_printf (spec->str, va_arg(args, void *));
+            case 'a':
+              out_printf (out, spec, (double) va_arg(args, Angle));
               break;
-            case '%':
-              g_string_append_c (string, '%');
+            case '+':
+              mask = va_arg(args, enum e_allow);
               break;
-            /* Our specs */
-            case 'm':
-              ++fmt;
-              if (*fmt == '*')
-                ext_unit = va_arg(args, const char *);
-              if (*fmt != '+' && *fmt != 'a')
-                value[0] = va_arg(args, Coord);
-              count = 1;
-              switch(*fmt)
-                {
-                case 's': unit_str = CoordsToString(value, 1, spec->str, ALLOW_MM | ALLOW_MIL, suffix); break;
-                case 'S': unit_str = CoordsToString(value, 1, spec->str, mask & ALLOW_ALL, suffix); break;
-                case 'M': unit_str = CoordsToString(value, 1, spec->str, mask & ALLOW_METRIC, suffix); break;
-                case 'L': unit_str = CoordsToString(value, 1, spec->str, mask & ALLOW_IMPERIAL, suffix); break;
-                case 'r': unit_str = CoordsToString(value, 1, spec->str, set_allow_readable(0), FILE_MODE); break;
-                /* All these fallthroughs are deliberate */
-                case '9': value[count++] = va_arg(args, Coord);
-                case '8': value[count++] = va_arg(args, Coord);
-                case '7': value[count++] = va_arg(args, Coord);
-                case '6': value[count++] = va_arg(args, Coord);
-                case '5': value[count++] = va_arg(args, Coord);
-                case '4': value[count++] = va_arg(args, Coord);
-                case '3': value[count++] = va_arg(args, Coord);
-                case '2':
-                case 'D':
-                  value[count++] = va_arg(args, Coord);
-                  unit_str = CoordsToString(value, count, spec->str, mask & ALLOW_ALL, suffix);
-                  break;
-                case 'd':
-                  value[1] = va_arg(args, Coord);
-                  unit_str = CoordsToString(value, 2, spec->str, ALLOW_MM | ALLOW_MIL, suffix);
-                  break;
-                case '*':
-                  for (i = 0; i < N_UNITS; ++i)
-                    if (strcmp (ext_unit, Units[i].suffix) == 0)
-                      unit_str = CoordsToString(value, 1, spec->str, Units[i].allow, suffix);
-                  if (unit_str == NULL)
-                    unit_str = CoordsToString(value, 1, spec->str, mask & ALLOW_ALL, suffix);
-                  break;
-                case 'a':
-                  g_string_append (spec, "f");
-                  if (suffix == SUFFIX)
-                    g_string_append (spec, " deg");
-                  unit_str = g_strdup_printf (spec->str, (double) va_arg(args, Angle));
-                  break;
-                case '+':
-                  mask = va_arg(args, enum e_allow);
-                  break;
-                default:
-                  for (i = 0; i < N_UNITS; ++i)
-                    if (*fmt == Units[i].printf_code)
-                      unit_str = CoordsToString(value, 1, spec->str, Units[i].allow, suffix);
-                  if (unit_str == NULL)
-                    unit_str = CoordsToString(value, 1, spec->str, ALLOW_ALL, suffix);
-                  break;
-                }
+            default:
+              CoordsToBuffer (out, value, 1, spec,
+                              piece->unit_n >= 0 ? Units[piece->unit_n].allow : ALLOW_ALL,
+                              suffix);
               break;
             }
-          if (unit_str != NULL)
-            {
-              g_string_append (string, unit_str);
-              g_free (unit_str);
-            }
+          break;
         }
-      else
-        g_string_append_c (string, *fmt);
-      ++fmt;
+
+      if (spec != piece->text && spec != spec_buff)
+        g_free ((char *) spec);
     }
-  g_string_free (spec, TRUE);
-  /* Return just the gchar* part of our string */
-  return g_string_free (string, FALSE);
+
+  if (temporary)
+    FreeCompiledFormat (cf);
+}
+
+/*!
+ * \brief Main pcb-printf function.
+ *
+ * Formats into a newly allocated string; see pcb_vformat().
+ *
+ * \param [in] fmt    Format specifier.
+ * \param [in] args   Arguments to specifier.
+ *
+ * \return A formatted string. Must be freed with g_free.
+ */
+gchar *pcb_vprintf(const char *fmt, va_list args)
+{
+  OutBuffer out;
+  char buf[256];
+
+  out_init (&out, buf, sizeof buf);
+  pcb_vformat (&out, fmt, args);
+  if (out.heap)
+    return out.str;
+  return g_strndup (out.str, out.len);
 }
 
 
@@ -692,21 +1073,26 @@ gchar *pcb_vprintf(const char *fmt, va_list args)
  *         have been written if enough space had been available.
  *
  * The returned string is guaranteed to be null terminated, even if truncated.
+ * The output goes straight into string unless it does not fit.
  */
 int pcb_snprintf(char *string, size_t size, const char *fmt, ...)
 {
-  gchar *tmp;
+  OutBuffer out;
   gsize length;
 
   va_list args;
   va_start(args, fmt);
 
-  tmp = pcb_vprintf (fmt, args);
-  length = strlen (tmp);
-  strncpy (string, tmp, size);
-  string[size - 1] = '\0';
+  out_init (&out, string, size);
+  pcb_vformat (&out, fmt, args);
+  length = out.len;
+  if (out.heap)
+    {
+      strncpy (string, out.str, size);
+      string[size - 1] = '\0';
+      out_free (&out);
+    }
 
-  g_free (tmp);
   va_end(args);
 
   return length;
@@ -723,7 +1109,8 @@ int pcb_snprintf(char *string, size_t size, const char *fmt, ...)
 int pcb_fprintf(FILE *fh, const char *fmt, ...)
 {
   int rv;
-  gchar *tmp;
+  OutBuffer out;
+  char buf[512];
 
   va_list args;
   va_start(args, fmt);
@@ -732,9 +1119,10 @@ int pcb_fprintf(FILE *fh, const char *fmt, ...)
     rv = -1;
   else
     {
-      tmp = pcb_vprintf (fmt, args);
-      rv = fprintf (fh, "%s", tmp);
-      g_free (tmp);
+      out_init (&out, buf, sizeof buf);
+      pcb_vformat (&out, fmt, args);
+      rv = fwrite (out.str, 1, out.len, fh) != out.len ? -1 : (int) out.len;
+      out_free (&out);
     }
   
   va_end(args);
@@ -751,14 +1139,16 @@ int pcb_fprintf(FILE *fh, const char *fmt, ...)
 int pcb_printf(const char *fmt, ...)
 {
   int rv;
-  gchar *tmp;
+  OutBuffer out;
+  char buf[512];
 
   va_list args;
   va_start(args, fmt);
 
-  tmp = pcb_vprintf (fmt, args);
-  rv = printf ("%s", tmp);
-  g_free (tmp);
+  out_init (&out, buf, sizeof buf);
+  pcb_vformat (&out, fmt, args);
+  rv = fwrite (out.str, 1, out.len, stdout) != out.len ? -1 : (int) out.len;
+  out_free (&out);
   
   va_end(args);
   return rv;
@@ -789,6 +1179,8 @@ pcb_printf_register_tests ()
 {
   g_test_add_func ("/pcb-printf/test-unit", pcb_printf_test_unit);
   g_test_add_func ("/pcb-printf/test-printf", pcb_printf_test_printf);
+  g_test_add_func ("/pcb-printf/test-file-coords",
+                   pcb_printf_test_file_coords);
 }
 
 void
@@ -868,4 +1260,39 @@ pcb_printf_test_printf ()
   g_assert_cmpstr (pcb_g_strdup_printf ("%#S", e), ==, "");
 }
 
+/*!
+ * \brief The fast %mr path gives what CoordsToBuffer() gives.
+ */
+void
+pcb_printf_test_file_coords ()
+{
+  enum e_allow masks[] = { ALLOW_READABLE, ALLOW_MM, ALLOW_MIL };
+  Coord c;
+  gchar *fast, slow_buff[64];
+  OutBuffer slow;
+  int i, m;
+
+  for (m = 0; m < sizeof masks / sizeof masks[0]; ++m)
+    {
+      set_allow_readable (masks[m]);
+      for (i = -200000; i <= 200000; ++i)
+        {
+          /* Every small coord, and a spread of large ones */
+          c = (i >= -20000 && i <= 20000) ? i : (Coord) i * 1237;
+          fast = pcb_g_strdup_printf ("%mr", c);
+          out_init (&slow, slow_buff, sizeof slow_buff);
+          CoordsToBuffer (&slow, &c, 1, "%", masks[m], FILE_MODE);
+          g_assert_cmpstr (fast, ==, slow.str);
+          g_free (fast);
+          out_free (&slow);
+        }
+    }
+  set_allow_readable (ALLOW_READABLE);
+
+  g_assert_cmpstr (pcb_g_strdup_printf ("%mr", (Coord) 254000), ==, "10.00mil");
+  g_assert_cmpstr (pcb_g_strdup_printf ("%mr", (Coord) 1000000), ==, "1.0000mm");
+  g_assert_cmpstr (pcb_g_strdup_printf ("%mr", (Coord) -10), ==, "-0.0000mm");
+  g_assert_cmpstr (pcb_g_strdup_printf ("%mr", (Coord) 0), ==, "0.0000");
+}
+
 #endif
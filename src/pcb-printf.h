@@ -178,6 +178,7 @@ gchar *pcb_vprintf(const char *fmt, va_list args);
 void pcb_printf_register_tests ();
 void pcb_printf_test_unit ();
 void pcb_printf_test_printf ();
+void pcb_printf_test_file_coords ();
 #endif
 
 #endif
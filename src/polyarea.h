@@ -169,6 +169,7 @@ BOOLp poly_ExclContour(POLYAREA * p, PLINE * c);
 BOOLp poly_ChkContour(PLINE * a);
 
 BOOLp poly_CheckInside(POLYAREA * c, Vector v0);
+BOOLp poly_M_SegmentTouches(POLYAREA * p, Vector a, Vector b, double r);
 BOOLp Touching(POLYAREA *p1, POLYAREA *p2);
 
 /* tools for clipping */
@@ -184,6 +185,8 @@ POLYAREA *poly_Create(void);
 void poly_Free(POLYAREA **p);
 void poly_Init(POLYAREA  *p);
 void poly_FreeContours(PLINE **pl);
+size_t poly_ContourMemory (const PLINE *pl, long *contours);
+size_t poly_Memory (const POLYAREA *p, long *contours);
 BOOLp poly_Valid(POLYAREA *p);
 
 enum PolygonBooleanOperation {
@@ -200,6 +203,7 @@ double vect_len2 (Vector v1);
 int vect_inters2 (Vector A, Vector B, Vector C, Vector D, Vector S1,
                   Vector S2);
 
+void poly_SetCompact (BOOLp compact);
 int poly_Boolean(const POLYAREA * a, const POLYAREA * b, POLYAREA ** res, int action);
 int poly_Boolean_free(POLYAREA * a, POLYAREA * b, POLYAREA ** res, int action);
 int poly_AndSubtract_free(POLYAREA * a, POLYAREA * b, POLYAREA ** aandb, POLYAREA ** aminusb);
@@ -0,0 +1,376 @@
+/*!
+ * \file src/polybench.c
+ *
+ * \brief Micro-benchmarks of the polygon boolean engine.
+ *
+ * The PolyBench() action times the clipping of the polygons of the
+ * loaded board and a few synthetic workloads (a field of via clearances
+ * cut from a pour, booleans between two large pours and dicing the
+ * result for hole-less rendering).  Each operation is timed on its own
+ * and reported in operations per second, with the heap the result holds
+ * on to and the peak resident size of the process.
+ *
+ * "make -C tests bench" runs it over some of the test boards.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_MALLOC_H
+#include <malloc.h>
+#endif
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#include "global.h"
+#include "data.h"
+#include "error.h"
+#include "polygon.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+/*!
+ * \brief Vias along each side of the synthetic via field.
+ */
+#define BENCH_VIA_SIDE 32
+
+/*!
+ * \brief Vertices of each synthetic large pour outline.
+ */
+#define BENCH_POUR_VERTICES 20000
+
+/*!
+ * \brief Start of one timed operation, see bench_begin().
+ */
+typedef struct
+{
+  gint64 start;
+  long heap;
+} bench_mark;
+
+/*!
+ * \brief Bytes of heap in use, or 0 if the C library can't tell.
+ */
+static long
+bench_heap (void)
+{
+#ifdef HAVE_MALLINFO2
+  struct mallinfo2 mi = mallinfo2 ();
+
+  return (long) (mi.uordblks + mi.hblkhd);
+#else
+  return 0;
+#endif
+}
+
+/*!
+ * \brief Peak resident size of the process in kB, or 0 if unknown.
+ */
+static long
+bench_peak_kb (void)
+{
+#ifdef HAVE_GETRUSAGE
+  struct rusage ru;
+
+  if (getrusage (RUSAGE_SELF, &ru) == 0)
+    return ru.ru_maxrss;
+#endif
+  return 0;
+}
+
+static void
+bench_begin (bench_mark *mark)
+{
+  mark->heap = bench_heap ();
+  mark->start = g_get_monotonic_time ();
+}
+
+/*!
+ * \brief Report an operation done ops times since mark.
+ *
+ * Call it before freeing the results, the heap reported is what they
+ * still hold.
+ */
+static void
+bench_end (bench_mark *mark, const char *name, long ops)
+{
+  gint64 usec = g_get_monotonic_time () - mark->start;
+  long heap = bench_heap () - mark->heap;
+
+  printf ("  %-22s %8ld ops %10.3f ms %12.1f ops/s %10ld kB heap\n",
+          name, ops, usec / 1000.0,
+          usec > 0 ? ops * 1.0e6 / usec : 0.0, heap / 1024);
+}
+
+/*!
+ * \brief A circle of radius r with a sinusoidal ripple, n vertices.
+ */
+static POLYAREA *
+bench_wavy_poly (Coord x, Coord y, Coord r, int n, Coord ripple, int waves)
+{
+  PLINE *contour = NULL;
+  POLYAREA *pa;
+  Vector v;
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      double a = 2 * M_PI * i / n;
+      double rr = r + ripple * sin (waves * a);
+
+      v[0] = x + rr * cos (a);
+      v[1] = y + rr * sin (a);
+      if (contour == NULL)
+        contour = poly_NewContour (v);
+      else
+        poly_InclVertex (contour->head.prev, poly_CreateNode (v));
+    }
+  poly_PreContour (contour, TRUE);
+  if (contour->Flags.orient != PLF_DIR)
+    poly_InvContour (contour);
+  pa = poly_Create ();
+  poly_InclContour (pa, contour);
+  return pa;
+}
+
+/*!
+ * \brief The via clearances of the synthetic via field.
+ */
+static void
+bench_vias (POLYAREA **vias, Coord pitch)
+{
+  int i, j;
+
+  for (i = 0; i < BENCH_VIA_SIDE; i++)
+    for (j = 0; j < BENCH_VIA_SIDE; j++)
+      vias[i * BENCH_VIA_SIDE + j] =
+        CirclePoly ((i + 1) * pitch, (j + 1) * pitch + (i % 3) * pitch / 8,
+                    pitch / 4);
+}
+
+static void
+bench_count_piece (PLINE *pline, void *user_data)
+{
+  (*(long *) user_data)++;
+  poly_DelContour (&pline);
+}
+
+/*!
+ * \brief Re-clip the polygons of the loaded board.
+ */
+static void
+bench_board (int iterations)
+{
+  bench_mark mark;
+  long polygons = 0;
+  int i;
+
+  ALLPOLYGON_LOOP (PCB->Data);
+  {
+    polygons++;
+  }
+  ENDALL_LOOP;
+  if (polygons == 0)
+    {
+      printf ("  board has no polygons\n");
+      return;
+    }
+
+  bench_begin (&mark);
+  for (i = 0; i < iterations; i++)
+    {
+      ALLPOLYGON_LOOP (PCB->Data);
+      {
+        InitClip (PCB->Data, layer, polygon);
+      }
+      ENDALL_LOOP;
+    }
+  bench_end (&mark, "InitClip", polygons * iterations);
+
+  bench_begin (&mark);
+  for (i = 0; i < iterations; i++)
+    InitClipAll (PCB->Data);
+  bench_end (&mark, "InitClipAll", polygons * iterations);
+}
+
+/*!
+ * \brief Cut a field of via clearances from a pour, one at a time and
+ * as one united shape, and dice the result.
+ */
+static void
+bench_via_field (int iterations)
+{
+  const int n = BENCH_VIA_SIDE * BENCH_VIA_SIDE;
+  const Coord pitch = MM_TO_COORD (1.27);
+  const Coord side = (BENCH_VIA_SIDE + 1) * pitch;
+  POLYAREA *vias[BENCH_VIA_SIDE * BENCH_VIA_SIDE];
+  POLYAREA *pour, *merged;
+  PolygonType poly;
+  bench_mark mark;
+  long pieces = 0;
+  int i, k, m;
+
+  pour = NULL;
+  bench_begin (&mark);
+  for (k = 0; k < iterations; k++)
+    {
+      poly_Free (&pour);
+      pour = RectPoly (0, side, 0, side);
+      bench_vias (vias, pitch);
+      for (i = 0; i < n; i++)
+        {
+          poly_Boolean_free (pour, vias[i], &merged, PBO_SUB);
+          pour = merged;
+        }
+    }
+  bench_end (&mark, "subtract vias", (long) n * iterations);
+
+  bench_begin (&mark);
+  for (k = 0; k < iterations; k++)
+    {
+      POLYAREA *plane = RectPoly (0, side, 0, side);
+
+      /* Unite the clearances pairwise, as clearPoly() does */
+      bench_vias (vias, pitch);
+      for (m = n; m > 1; m = (m + 1) / 2)
+        {
+          for (i = 0; i + 1 < m; i += 2)
+            {
+              poly_Boolean_free (vias[i], vias[i + 1], &merged, PBO_UNITE);
+              vias[i / 2] = merged;
+            }
+          if (m & 1)
+            vias[m / 2] = vias[m - 1];
+        }
+      poly_Boolean_free (plane, vias[0], &merged, PBO_SUB);
+      poly_Free (&merged);
+    }
+  bench_end (&mark, "unite and subtract", (long) n * iterations);
+
+  memset (&poly, 0, sizeof (poly));
+  poly.Clipped = pour;
+  bench_begin (&mark);
+  for (k = 0; k < iterations; k++)
+    NoHolesPolygonDicer (&poly, NULL, bench_count_piece, &pieces);
+  bench_end (&mark, "dice", iterations);
+
+  poly_Free (&pour);
+}
+
+/*!
+ * \brief Booleans between two large overlapping pours.
+ */
+static void
+bench_large_pours (int iterations)
+{
+  static const struct
+  {
+    const char *name;
+    int op;
+  } ops[] = {
+    {"pour unite", PBO_UNITE},
+    {"pour subtract", PBO_SUB},
+    {"pour intersect", PBO_ISECT},
+  };
+  const Coord r = MM_TO_COORD (50);
+  POLYAREA *a, *b, *res;
+  bench_mark mark;
+  int i, k;
+
+  a = bench_wavy_poly (0, 0, r, BENCH_POUR_VERTICES, r / 250, 400);
+  b = bench_wavy_poly (r / 1000, 0, r, BENCH_POUR_VERTICES, r / 250, 401);
+
+  for (i = 0; i < sizeof (ops) / sizeof (ops[0]); i++)
+    {
+      bench_begin (&mark);
+      for (k = 0; k < iterations; k++)
+        {
+          res = NULL;
+          if (poly_Boolean (a, b, &res, ops[i].op) != err_ok)
+            Message (_("PolyBench: %s failed\n"), ops[i].name);
+          if (k + 1 < iterations)
+            poly_Free (&res);
+        }
+      bench_end (&mark, ops[i].name, iterations);
+      poly_Free (&res);
+    }
+
+  poly_Free (&a);
+  poly_Free (&b);
+}
+
+static const char polybench_syntax[] = N_("PolyBench([iterations])");
+
+static const char polybench_help[] =
+  N_("Time the polygon boolean engine.");
+
+/* %start-doc actions PolyBench
+
+Times the clipping of the board's polygons and some synthetic polygon
+workloads, and prints the operations per second of each on stdout.
+The optional argument is the number of times to repeat each
+operation, 3 by default.  Re-clipping leaves the board unchanged.
+
+@code{make -C tests bench} runs this action over some of the test
+boards.
+
+%end-doc */
+
+static int
+ActionPolyBench (int argc, char **argv, Coord x, Coord y)
+{
+  int iterations = 3;
+
+  if (argc > 1)
+    AFAIL (polybench);
+  if (argc == 1)
+    iterations = atoi (argv[0]);
+  if (iterations < 1)
+    AFAIL (polybench);
+
+  printf ("Polygon benchmark, %d iterations:\n", iterations);
+  bench_board (iterations);
+  bench_via_field (iterations);
+  bench_large_pours (iterations);
+  printf ("  peak resident size %ld kB\n", bench_peak_kb ());
+
+  return 0;
+}
+
+HID_Action polybench_action_list[] = {
+  {"PolyBench", 0, ActionPolyBench,
+   polybench_help, polybench_syntax}
+};
+
+REGISTER_ACTIONS (polybench_action_list)
@@ -93,6 +93,7 @@
 #include "draw.h"
 #include "error.h"
 #include "find.h"
+#include "job.h"
 #include "misc.h"
 #include "move.h"
 #include "pcb-printf.h"
@@ -111,8 +112,6 @@
 #define ROUND(x) ((long)(((x) >= 0 ? (x) + 0.5  : (x) - 0.5)))
 
 #define UNSUBTRACT_BLOAT 10
-#define SUBTRACT_PIN_VIA_BATCH_SIZE 100
-#define SUBTRACT_LINE_BATCH_SIZE 20
 
 static double rotate_circle_seg[4];
 
@@ -209,15 +208,44 @@ add_noholes_polyarea (PLINE *pline, void *user_data)
   poly->NoHoles = pline;
 }
 
+static bool want_tiles (PolygonType *poly);
+static void compute_tiled_noholes (PolygonType *poly);
+static void invalidate_tiles (PolygonType *poly, POLYAREA *pa);
+
+/*!
+ * \brief Note that the Clipped area of a polygon changes within pa.
+ *
+ * This outdates the NoHoles pieces, which are only computed again the
+ * next time the polygon is drawn by a HID that needs them.
+ */
+static void
+clipped_changed (PolygonType *poly, POLYAREA *pa)
+{
+  poly->ClippedGen++;
+  invalidate_tiles (poly, pa);
+}
+
+/*!
+ * \brief Bring the NoHoles pieces of a polygon up to date with its
+ * Clipped area.
+ */
 void
 ComputeNoHoles (PolygonType *poly)
 {
+  if (NOHOLES_VALID (poly))
+    return;
+  poly->NoHolesGen = poly->ClippedGen;
+  if (poly->Clipped && want_tiles (poly))
+    {
+      compute_tiled_noholes (poly);
+      return;
+    }
+  FreePolygonTiles (poly);
   poly_FreeContours (&poly->NoHoles);
   if (poly->Clipped)
     NoHolesPolygonDicer (poly, NULL, add_noholes_polyarea, poly);
   else
     printf ("Compute_noholes caught poly->Clipped = NULL\n");
-  poly->NoHolesValid = 1;
 }
 
 static POLYAREA *
@@ -417,6 +445,75 @@ OctagonPoly (Coord x, Coord y, Coord radius)
   return ContourToPoly (contour);
 }
 
+/*!
+ * \brief The vertex offsets frac_circle() adds for one start vector.
+ *
+ * They only depend on the start vector relative to the centre and on the
+ * fraction of the circle, and the same few pin, via and line sizes come
+ * up over and over again on a board.
+ */
+typedef struct
+{
+  Coord dx, dy;			/*!< Start vector, relative to the centre. */
+  int fraction;			/*!< 0 for an unused slot. */
+  int n;			/*!< Number of offsets. */
+  Coord offset[POLY_CIRC_SEGS][2];
+} CircleOffsetsType;
+
+#define CIRCLE_CACHE_SIZE 256
+
+static void
+free_circle_cache (gpointer data)
+{
+  free (data);
+}
+
+/*!
+ * \brief A direct mapped cache of circle offsets for every thread that
+ * clips polygons.
+ */
+static GPrivate circle_cache = G_PRIVATE_INIT (free_circle_cache);
+
+static CircleOffsetsType *
+circle_offsets (Coord dx, Coord dy, int fraction)
+{
+  CircleOffsetsType *cache = (CircleOffsetsType *) g_private_get (&circle_cache);
+  CircleOffsetsType *t;
+  double e1, e2, t1;
+  int i;
+
+  if (cache == NULL)
+    {
+      cache = (CircleOffsetsType *) calloc (CIRCLE_CACHE_SIZE,
+                                            sizeof (CircleOffsetsType));
+      g_private_set (&circle_cache, cache);
+    }
+
+  t = &cache[((unsigned) dx * 31 + (unsigned) dy * 7 + fraction)
+             % CIRCLE_CACHE_SIZE];
+  if (t->fraction == fraction && t->dx == dx && t->dy == dy)
+    return t;
+
+  t->dx = dx;
+  t->dy = dy;
+  t->fraction = fraction;
+  e1 = dx * POLY_CIRC_RADIUS_ADJ;
+  e2 = dy * POLY_CIRC_RADIUS_ADJ;
+
+  /* NB: the caller adds the last vertex, hence the -1 */
+  t->n = POLY_CIRC_SEGS / fraction - 1;
+  for (i = 0; i < t->n; i++)
+    {
+      /* rotate the vector */
+      t1 = rotate_circle_seg[0] * e1 + rotate_circle_seg[1] * e2;
+      e2 = rotate_circle_seg[2] * e1 + rotate_circle_seg[3] * e2;
+      e1 = t1;
+      t->offset[i][0] = ROUND (e1);
+      t->offset[i][1] = ROUND (e2);
+    }
+  return t;
+}
+
 /*!
  * \brief Add vertices in a fractional-circle starting from v 
  * centered at X, Y and going counter-clockwise.
@@ -425,28 +522,22 @@ OctagonPoly (Coord x, Coord y, Coord radius)
  * last argument is 1 for a full circle.
  * 2 for a half circle.
  * or 4 for a quarter circle.
+ *
+ * The vertices are translated copies of cached offsets, so repeated
+ * shapes cost no floating point work.
  */
 void
 frac_circle (PLINE * c, Coord X, Coord Y, Vector v, int fraction)
 {
-  double e1, e2, t1;
-  int i, range;
+  CircleOffsetsType *t;
+  int i;
 
   poly_InclVertex (c->head.prev, poly_CreateNode (v));
-  /* move vector to origin */
-  e1 = (v[0] - X) * POLY_CIRC_RADIUS_ADJ;
-  e2 = (v[1] - Y) * POLY_CIRC_RADIUS_ADJ;
-
-  /* NB: the caller adds the last vertex, hence the -1 */
-  range = POLY_CIRC_SEGS / fraction - 1;
-  for (i = 0; i < range; i++)
+  t = circle_offsets (v[0] - X, v[1] - Y, fraction);
+  for (i = 0; i < t->n; i++)
     {
-      /* rotate the vector */
-      t1 = rotate_circle_seg[0] * e1 + rotate_circle_seg[1] * e2;
-      e2 = rotate_circle_seg[2] * e1 + rotate_circle_seg[3] * e2;
-      e1 = t1;
-      v[0] = X + ROUND (e1);
-      v[1] = Y + ROUND (e2);
+      v[0] = X + t->offset[i][0];
+      v[1] = Y + t->offset[i][1];
       poly_InclVertex (c->head.prev, poly_CreateNode (v));
     }
 }
@@ -765,9 +856,13 @@ Subtract (POLYAREA * np1, PolygonType * p, bool fnp)
     return 1;
   }
 
+  ConnectionIndexInvalidate ();
+
   assert (poly_Valid (p->Clipped));
   assert (poly_Valid (np));
 
+  clipped_changed (p, np);
+
   /* subtract the polyarea, using a boolean subtraction operation */
   if (fnp)
     x = poly_Boolean_free (p->Clipped, np, &merged, PBO_SUB);
@@ -783,10 +878,14 @@ Subtract (POLYAREA * np1, PolygonType * p, bool fnp)
       fprintf (stderr, "Error while clipping PBO_SUB: %d\n", x);
       poly_Free (&merged);
       p->Clipped = NULL;
+      FreePolygonTiles (p);
       if (p->NoHoles) printf ("Just leaked in Subtract\n");
       p->NoHoles = NULL;
       return -1;
     }
+  /* Keeping only the biggest piece can change the polygon far away from np */
+  if (merged && merged->f != merged)
+    invalidate_tiles (p, NULL);
   p->Clipped = biggest (merged);
   assert (!p->Clipped || poly_Valid (p->Clipped));
   if (!p->Clipped)
@@ -879,42 +978,60 @@ SubtractArc (ArcType * arc, PolygonType * p)
   return Subtract (np, p, true);
 }
 
+/*!
+ * \brief Create a polygon of the text clearance.
+ */
+static POLYAREA *
+TextClearPoly (TextType * text)
+{
+  const BoxType *b = &text->BoundingBox;
+
+  return RoundRect (b->X1 + PCB->Bloat, b->X2 - PCB->Bloat,
+                    b->Y1 + PCB->Bloat, b->Y2 - PCB->Bloat, PCB->Bloat);
+}
+
 static int
 SubtractText (TextType * text, PolygonType * p)
 {
   POLYAREA *np;
-  const BoxType *b = &text->BoundingBox;
 
   if (!TEST_FLAG (CLEARLINEFLAG, text))
     return 0;
-  if (!(np = RoundRect (b->X1 + PCB->Bloat, b->X2 - PCB->Bloat,
-                        b->Y1 + PCB->Bloat, b->Y2 - PCB->Bloat, PCB->Bloat)))
+  if (!(np = TextClearPoly (text)))
     return -1;
   return Subtract (np, p, true);
 }
 
+/*!
+ * \brief Create a polygon of the pad clearance.
+ */
+static POLYAREA *
+PadClearPoly (PadType * pad)
+{
+  if (TEST_FLAG (SQUAREFLAG, pad))
+    return SquarePadPoly (pad, pad->Thickness + pad->Clearance);
+  return LinePoly ((LineType *) pad, pad->Thickness + pad->Clearance);
+}
+
 static int
 SubtractPad (PadType * pad, PolygonType * p)
 {
-  POLYAREA *np = NULL;
+  POLYAREA *np;
 
   if (pad->Clearance == 0)
     return 0;
-  if (TEST_FLAG (SQUAREFLAG, pad))
-    {
-      if (!
-          (np = SquarePadPoly (pad, pad->Thickness + pad->Clearance)))
-        return -1;
-    }
-  else
-    {
-      if (!
-          (np = LinePoly ((LineType *) pad, pad->Thickness + pad->Clearance)))
-        return -1;
-    }
+  if (!(np = PadClearPoly (pad)))
+    return -1;
   return Subtract (np, p, true);
 }
 
+/*!
+ * \brief State of clearPoly().
+ *
+ * The callbacks only gather the clearance shapes of the objects they
+ * find, which are then subtracted from the polygon all at once by
+ * subtract_accumulated().
+ */
 struct cpInfo
 {
   const BoxType *other;
@@ -922,19 +1039,110 @@ struct cpInfo
   LayerType *layer;
   PolygonType *polygon;
   bool bottom;
-  POLYAREA *accumulate;
-  int batch_size;
+  POLYAREA **shapes;            /*!< Clearance shapes gathered so far. */
+  int shape_n, shape_max;
+  /*! Regions searched already, whose objects are gathered. */
+  const BoxType *searched;
+  int searched_n;
+  /*! Subtract each shape as it is made, when uniting them failed. */
+  bool direct;
   jmp_buf env;
 };
 
+/*!
+ * \brief Whether an object was found by the search of an earlier region.
+ */
+static bool
+gathered_before (struct cpInfo *info, const BoxType *b)
+{
+  int i;
+
+  for (i = 0; i < info->searched_n; i++)
+    if (box_intersect (b, &info->searched[i]))
+      return true;
+  return false;
+}
+
 static void
+accumulate_shape (struct cpInfo *info, POLYAREA *np)
+{
+  if (info->direct)
+    {
+      Subtract (np, info->polygon, true);
+      return;
+    }
+  if (info->shape_n == info->shape_max)
+    {
+      info->shape_max = info->shape_max ? 2 * info->shape_max : 64;
+      info->shapes = (POLYAREA **)realloc (info->shapes, info->shape_max
+                                           * sizeof (POLYAREA *));
+    }
+  info->shapes[info->shape_n++] = np;
+}
+
+/*!
+ * \brief Unite shapes, freeing them.
+ *
+ * The shapes are united pairwise, level by level, so each of them takes
+ * part in O(log n) unions of similar sized operands instead of being
+ * added to an ever growing accumulator one at a time.
+ *
+ * \return the error of a failed union, all the shapes are freed then
+ * and \p *res is NULL.
+ */
+static int
+unite_shapes (POLYAREA **shapes, int n, POLYAREA **res)
+{
+  int i, j, x;
+
+  *res = NULL;
+  if (n == 0)
+    return err_ok;
+  while (n > 1)
+    {
+      for (i = 0; i + 1 < n; i += 2)
+        {
+          POLYAREA *merged = NULL;
+
+          x = poly_Boolean_free (shapes[i], shapes[i + 1], &merged,
+                                 PBO_UNITE);
+          if (x != err_ok)
+            {
+              /* the unions made on this level, and the shapes not
+               * united yet */
+              for (j = 0; j < i / 2; j++)
+                poly_Free (&shapes[j]);
+              for (j = i + 2; j < n; j++)
+                poly_Free (&shapes[j]);
+              return x;
+            }
+          shapes[i / 2] = merged;
+        }
+      if (n & 1)
+        shapes[n / 2] = shapes[n - 1];
+      n = (n + 1) / 2;
+    }
+  *res = shapes[0];
+  return err_ok;
+}
+
+/*!
+ * \brief Subtract the gathered clearance shapes from the polygon.
+ *
+ * Neighbours in the list came from nearby rtree entries, so the pairs
+ * unite_shapes() unites tend to be close.  The union is then subtracted
+ * from the polygon with a single boolean operation.
+ */
+static int
 subtract_accumulated (struct cpInfo *info, PolygonType *polygon)
 {
-  if (info->accumulate == NULL)
-    return;
-  Subtract (info->accumulate, polygon, true);
-  info->accumulate = NULL;
-  info->batch_size = 0;
+  POLYAREA *np;
+  int x = unite_shapes (info->shapes, info->shape_n, &np);
+
+  info->shape_n = 0;
+  if (np)
+    Subtract (np, polygon, true);
+  return x;
 }
 
 static int
@@ -942,15 +1150,14 @@ pin_sub_callback (const BoxType * b, void *cl)
 {
   PinType *pin = (PinType *) b;
   struct cpInfo *info = (struct cpInfo *) cl;
-  PolygonType *polygon;
   POLYAREA *np;
-  POLYAREA *merged;
   Cardinal i;
 
   /* don't subtract the object that was put back! */
   if (b == info->other)
     return 0;
-  polygon = info->polygon;
+  if (info->searched_n && gathered_before (info, b))
+    return 0;
 
   i = GetLayerNumber (info->data, info->layer);
 
@@ -972,14 +1179,7 @@ pin_sub_callback (const BoxType * b, void *cl)
         longjmp (info->env, 1);
     }
 
-  poly_Boolean_free (info->accumulate, np, &merged, PBO_UNITE);
-  info->accumulate = merged;
-
-  info->batch_size ++;
-
-  if (info->batch_size == SUBTRACT_PIN_VIA_BATCH_SIZE)
-    subtract_accumulated (info, polygon);
-
+  accumulate_shape (info, np);
   return 1;
 }
 
@@ -988,16 +1188,18 @@ arc_sub_callback (const BoxType * b, void *cl)
 {
   ArcType *arc = (ArcType *) b;
   struct cpInfo *info = (struct cpInfo *) cl;
-  PolygonType *polygon;
+  POLYAREA *np;
 
   /* don't subtract the object that was put back! */
   if (b == info->other)
     return 0;
+  if (info->searched_n && gathered_before (info, b))
+    return 0;
   if (!TEST_FLAG (CLEARLINEFLAG, arc))
     return 0;
-  polygon = info->polygon;
-  if (SubtractArc (arc, polygon) < 0)
+  if (!(np = ArcPoly (arc, arc->Thickness + arc->Clearance)))
     longjmp (info->env, 1);
+  accumulate_shape (info, np);
   return 1;
 }
 
@@ -1006,18 +1208,20 @@ pad_sub_callback (const BoxType * b, void *cl)
 {
   PadType *pad = (PadType *) b;
   struct cpInfo *info = (struct cpInfo *) cl;
-  PolygonType *polygon;
+  POLYAREA *np;
 
   /* don't subtract the object that was put back! */
   if (b == info->other)
     return 0;
+  if (info->searched_n && gathered_before (info, b))
+    return 0;
   if (pad->Clearance == 0)
     return 0;
-  polygon = info->polygon;
   if (XOR (TEST_FLAG (ONSOLDERFLAG, pad), !info->bottom))
     {
-      if (SubtractPad (pad, polygon) < 0)
+      if (!(np = PadClearPoly (pad)))
         longjmp (info->env, 1);
+      accumulate_shape (info, np);
       return 1;
     }
   return 0;
@@ -1028,27 +1232,18 @@ line_sub_callback (const BoxType * b, void *cl)
 {
   LineType *line = (LineType *) b;
   struct cpInfo *info = (struct cpInfo *) cl;
-  PolygonType *polygon;
   POLYAREA *np;
-  POLYAREA *merged;
 
   /* don't subtract the object that was put back! */
   if (b == info->other)
     return 0;
+  if (info->searched_n && gathered_before (info, b))
+    return 0;
   if (!TEST_FLAG (CLEARLINEFLAG, line))
     return 0;
-  polygon = info->polygon;
-
   if (!(np = LinePoly (line, line->Thickness + line->Clearance)))
     longjmp (info->env, 1);
-
-  poly_Boolean_free (info->accumulate, np, &merged, PBO_UNITE);
-  info->accumulate = merged;
-  info->batch_size ++;
-
-  if (info->batch_size == SUBTRACT_LINE_BATCH_SIZE)
-    subtract_accumulated (info, polygon);
-
+  accumulate_shape (info, np);
   return 1;
 }
 
@@ -1057,16 +1252,18 @@ text_sub_callback (const BoxType * b, void *cl)
 {
   TextType *text = (TextType *) b;
   struct cpInfo *info = (struct cpInfo *) cl;
-  PolygonType *polygon;
+  POLYAREA *np;
 
   /* don't subtract the object that was put back! */
   if (b == info->other)
     return 0;
+  if (info->searched_n && gathered_before (info, b))
+    return 0;
   if (!TEST_FLAG (CLEARLINEFLAG, text))
     return 0;
-  polygon = info->polygon;
-  if (SubtractText (text, polygon) < 0)
+  if (!(np = TextClearPoly (text)))
     longjmp (info->env, 1);
+  accumulate_shape (info, np);
   return 1;
 }
 
@@ -1081,12 +1278,47 @@ Group (DataType *Data, Cardinal layer)
   return i;
 }
 
+/*!
+ * \brief Gather the clearance shapes of the objects in a region.
+ */
 static int
-clearPoly (DataType *Data, LayerType *Layer, PolygonType * polygon,
-           const BoxType * here, Coord expand)
+gather_region (struct cpInfo *info, const BoxType *region, Cardinal group)
 {
+  DataType *Data = info->data;
   int r = 0;
-  BoxType region;
+
+  if (info->bottom || group == Group (Data, top_silk_layer))
+    r += r_search (Data->pad_tree, region, NULL, pad_sub_callback, info);
+  GROUP_LOOP (Data, group);
+  {
+    r += r_search (layer->line_tree, region, NULL, line_sub_callback, info);
+    r += r_search (layer->arc_tree, region, NULL, arc_sub_callback, info);
+    r += r_search (layer->text_tree, region, NULL, text_sub_callback, info);
+  }
+  END_LOOP;
+  r += r_search (Data->via_tree, region, NULL, pin_sub_callback, info);
+  r += r_search (Data->pin_tree, region, NULL, pin_sub_callback, info);
+  return r;
+}
+
+/*!
+ * \brief Clear a polygon of the objects in some regions of it.
+ *
+ * The regions are the \p n boxes of \p here, or the whole polygon if
+ * \p here is NULL.  The shapes of all the objects found are gathered
+ * first, an object found in more than one region only once, and they
+ * are subtracted from the polygon together.  With a single region, that
+ * region is also the object that was put back, which is not cleared.
+ *
+ * Should uniting the shapes fail, they are gathered again and subtracted
+ * one at a time, as a failed union would leave copper in the clearances.
+ */
+static int
+clearPolyRegions (DataType *Data, LayerType *Layer, PolygonType * polygon,
+                  const BoxType * here, int n, Coord expand)
+{
+  int r = 0, i;
+  BoxType *region;
   struct cpInfo info;
   Cardinal group;
 
@@ -1096,42 +1328,56 @@ clearPoly (DataType *Data, LayerType *Layer, PolygonType * polygon,
   group = Group (Data, GetLayerNumber (Data, Layer));
   info.bottom = (group == Group (Data, bottom_silk_layer));
   info.data = Data;
-  info.other = here;
+  info.other = n == 1 ? here : NULL;
   info.layer = Layer;
   info.polygon = polygon;
-  if (here)
-    region = clip_box (here, &polygon->BoundingBox);
-  else
-    region = polygon->BoundingBox;
-  region = bloat_box (&region, expand);
+  if (here == NULL)
+    n = 1;
+  region = (BoxType *) malloc (n * sizeof (BoxType));
+  for (i = 0; i < n; i++)
+    {
+      if (here)
+        region[i] = clip_box (&here[i], &polygon->BoundingBox);
+      else
+        region[i] = polygon->BoundingBox;
+      region[i] = bloat_box (&region[i], expand);
+    }
 
-  if (setjmp (info.env) == 0)
+  info.shapes = NULL;
+  info.shape_n = info.shape_max = 0;
+  info.searched = region;
+  for (info.direct = false;; info.direct = true)
     {
-      r = 0;
-      info.accumulate = NULL;
-      info.batch_size = 0;
-      if (info.bottom || group == Group (Data, top_silk_layer))
-	r += r_search (Data->pad_tree, &region, NULL, pad_sub_callback, &info);
-      GROUP_LOOP (Data, group);
-      {
-        r +=
-          r_search (layer->line_tree, &region, NULL, line_sub_callback,
-                    &info);
-        subtract_accumulated (&info, polygon);
-        r +=
-          r_search (layer->arc_tree, &region, NULL, arc_sub_callback, &info);
-	r +=
-          r_search (layer->text_tree, &region, NULL, text_sub_callback, &info);
-      }
-      END_LOOP;
-      r += r_search (Data->via_tree, &region, NULL, pin_sub_callback, &info);
-      r += r_search (Data->pin_tree, &region, NULL, pin_sub_callback, &info);
-      subtract_accumulated (&info, polygon);
+      info.searched_n = 0;
+      if (setjmp (info.env) == 0)
+        {
+          r = 0;
+          for (i = 0; i < n; i++)
+            {
+              r += gather_region (&info, &region[i], group);
+              info.searched_n = i + 1;
+            }
+        }
+      /* after a shape could not be made, still clear the ones gathered */
+      if (subtract_accumulated (&info, polygon) == err_ok || info.direct)
+        break;
+      Message (_("Could not unite the clearances of the polygon at %$mD, "
+                 "subtracting them one at a time\n"),
+               (polygon->BoundingBox.X1 + polygon->BoundingBox.X2) / 2,
+               (polygon->BoundingBox.Y1 + polygon->BoundingBox.Y2) / 2);
     }
-  polygon->NoHolesValid = 0;
+  free (info.shapes);
+  free (region);
   return r;
 }
 
+static int
+clearPoly (DataType *Data, LayerType *Layer, PolygonType * polygon,
+           const BoxType * here, Coord expand)
+{
+  return clearPolyRegions (Data, Layer, polygon, here, 1, expand);
+}
+
 static int
 Unsubtract (POLYAREA * np1, PolygonType * p)
 {
@@ -1141,6 +1387,8 @@ Unsubtract (POLYAREA * np1, PolygonType * p)
   assert (np);
   assert (p && p->Clipped);
 
+  ConnectionIndexInvalidate ();
+  clipped_changed (p, np);
   orig_poly = original_poly (p);
 
   x = poly_Boolean_free (np, orig_poly, &clipped_np, PBO_ISECT);
@@ -1158,12 +1406,15 @@ Unsubtract (POLYAREA * np1, PolygonType * p)
       poly_Free (&merged);
       goto fail;
     }
+  if (merged && merged->f != merged)
+    invalidate_tiles (p, NULL);
   p->Clipped = biggest (merged);
   assert (!p->Clipped || poly_Valid (p->Clipped));
   return 1;
 
 fail:
   p->Clipped = NULL;
+  FreePolygonTiles (p);
   if (p->NoHoles) printf ("Just leaked in Unsubtract\n");
   p->NoHoles = NULL;
   return 0;
@@ -1269,15 +1520,19 @@ InitClip (DataType *Data, LayerType *layer, PolygonType * p)
   if (inhibit)
     return 0;
 
+  ConnectionIndexInvalidate ();
+
   /* Clear any existing data. */
   if (p->Clipped)
     poly_Free (&p->Clipped);
 
   /* Compute the perimeter of the polygon */
   p->Clipped = original_poly (p);
+  clipped_changed (p, NULL);
 
   /* NoHoles is a version of the polygon broken into pieces so that it is
    * hole free. If we have one, we need to clear it. */
+  FreePolygonTiles (p);
   poly_FreeContours (&p->NoHoles);
   if (!p->Clipped)
     return 0;
@@ -1286,11 +1541,188 @@ InitClip (DataType *Data, LayerType *layer, PolygonType * p)
   /* If the polygon is clearing, we need to add all of the object cutouts. */
   if (TEST_FLAG (CLEARPOLYFLAG, p))
     clearPoly (Data, layer, p, NULL, 0);
-  else
-    p->NoHolesValid = 0;
   return 1;
 }
 
+/*!
+ * \brief Give a polygon a clipped shape InitClip() computed earlier.
+ *
+ * The board cache uses this to skip the clipping of a board it has
+ * seen before.  The polygon takes ownership of clipped.
+ */
+void
+SetClip (PolygonType *p, POLYAREA *clipped)
+{
+  ConnectionIndexInvalidate ();
+
+  if (p->Clipped)
+    poly_Free (&p->Clipped);
+  p->Clipped = clipped;
+  clipped_changed (p, NULL);
+
+  FreePolygonTiles (p);
+  poly_FreeContours (&p->NoHoles);
+}
+
+/*!
+ * \brief The polygons of one InitClipAll() call still being clipped.
+ */
+typedef struct
+{
+  GMutex lock;
+  GCond done;
+  int pending;
+} ClipWaveType;
+
+/*!
+ * \brief One polygon for a worker to clip or dice.
+ */
+typedef struct
+{
+  ClipWaveType *wave;
+  void (*work) (DataType *, LayerType *, PolygonType *);
+  DataType *data;
+  LayerType *layer;
+  PolygonType *polygon;
+  GQueue log;			/*!< Its messages, see pcb_job_collect_log(). */
+} ClipJobType;
+
+static GThreadPool *clip_pool = NULL;
+
+static void
+ClipWorker (gpointer data, gpointer user_data)
+{
+  ClipJobType *job = (ClipJobType *) data;
+  ClipWaveType *wave = job->wave;
+
+  pcb_job_collect_log (&job->log);
+  job->work (job->data, job->layer, job->polygon);
+  pcb_job_collect_log (NULL);
+
+  g_mutex_lock (&wave->lock);
+  if (--wave->pending == 0)
+    g_cond_signal (&wave->done);
+  g_mutex_unlock (&wave->lock);
+}
+
+/*!
+ * \brief Order clip jobs by decreasing number of polygon points.
+ */
+static int
+clip_job_cmp (const void *a, const void *b)
+{
+  const ClipJobType *ja = (const ClipJobType *) a;
+  const ClipJobType *jb = (const ClipJobType *) b;
+
+  if (ja->polygon->PointN != jb->polygon->PointN)
+    return ja->polygon->PointN > jb->polygon->PointN ? -1 : 1;
+  return 0;
+}
+
+/*!
+ * \brief Run the jobs on the worker threads and wait for all of them.
+ *
+ * The jobs only read the board, so its rtrees are opened for shared
+ * reading while they run.  Their messages are logged from here once
+ * they are done, in the order of the jobs.
+ */
+static void
+run_clip_jobs (ClipJobType *jobs, int n)
+{
+  ClipWaveType wave;
+  int i;
+
+  wave.pending = n;
+  g_mutex_init (&wave.lock);
+  g_cond_init (&wave.done);
+
+  if (clip_pool == NULL)
+    clip_pool = g_thread_pool_new (ClipWorker, NULL,
+                                   g_get_num_processors (), TRUE, NULL);
+
+  r_begin_shared_read ();
+  for (i = 0; i < n; i++)
+    {
+      jobs[i].wave = &wave;
+      g_queue_init (&jobs[i].log);
+      g_thread_pool_push (clip_pool, &jobs[i], NULL);
+    }
+
+  g_mutex_lock (&wave.lock);
+  while (wave.pending > 0)
+    g_cond_wait (&wave.done, &wave.lock);
+  g_mutex_unlock (&wave.lock);
+  r_end_shared_read ();
+
+  for (i = 0; i < n; i++)
+    pcb_job_replay_log (&jobs[i].log);
+
+  g_mutex_clear (&wave.lock);
+  g_cond_clear (&wave.done);
+}
+
+static void
+clip_job (DataType *Data, LayerType *layer, PolygonType *polygon)
+{
+  InitClip (Data, layer, polygon);
+}
+
+static void
+dice_job (DataType *Data, LayerType *layer, PolygonType *polygon)
+{
+  ComputeNoHoles (polygon);
+}
+
+/*!
+ * \brief Initialize the clipping of all polygons of Data.
+ *
+ * A polygon is only ever cleared by pins, vias, pads, lines, arcs and
+ * text, never by another polygon, so every polygon can be clipped on its
+ * own.  InitClip() only writes the clipping of its polygon and reads the
+ * board, so with several processors the polygons are clipped on worker
+ * threads, the biggest ones first.
+ */
+void
+InitClipAll (DataType *Data)
+{
+  ClipJobType *jobs;
+  int n_jobs = 0;		/* not n, which ALLPOLYGON_LOOP declares */
+
+  if (inhibit)
+    return;
+
+  ALLPOLYGON_LOOP (Data);
+  {
+    n_jobs++;
+  }
+  ENDALL_LOOP;
+
+  if (n_jobs < 2 || g_get_num_processors () < 2)
+    {
+      ALLPOLYGON_LOOP (Data);
+      {
+        InitClip (Data, layer, polygon);
+      }
+      ENDALL_LOOP;
+      return;
+    }
+
+  jobs = (ClipJobType *) malloc (n_jobs * sizeof (ClipJobType));
+  n_jobs = 0;
+  ALLPOLYGON_LOOP (Data);
+  {
+    jobs[n_jobs].work = clip_job;
+    jobs[n_jobs].data = Data;
+    jobs[n_jobs].layer = layer;
+    jobs[n_jobs].polygon = polygon;
+    n_jobs++;
+  }
+  ENDALL_LOOP;
+  qsort (jobs, n_jobs, sizeof (ClipJobType), clip_job_cmp);
+  run_clip_jobs (jobs, n_jobs);
+  free (jobs);
+}
+
 /*!
  * \brief Remove redundant polygon points.
  *
@@ -1469,13 +1901,14 @@ CopyAttachedPolygonToLayer (void)
   saveID = polygon->ID;
   *polygon = Crosshair.AttachedPolygon;
   polygon->ID = saveID;
+  IDIndexInvalidate ();
   SET_FLAG (CLEARPOLYFLAG, polygon);
   if (TEST_FLAG (NEWFULLPOLYFLAG, PCB))
     SET_FLAG (FULLPOLYFLAG, polygon);
   memset (&Crosshair.AttachedPolygon, 0, sizeof (PolygonType));
   SetPolygonBoundingBox (polygon);
   if (!CURRENT->polygon_tree)
-    CURRENT->polygon_tree = r_create_tree (NULL, 0, 0);
+    CURRENT->polygon_tree = r_create_data_tree ();
   r_insert_entry (CURRENT->polygon_tree, (BoxType *) polygon, 0);
   InitClip (PCB->Data, CURRENT, polygon);
   DrawPolygon (CURRENT, polygon);
@@ -1546,32 +1979,26 @@ subtract_plow (DataType *Data, LayerType *Layer, PolygonType *Polygon,
     {
     case PIN_TYPE:
       SubtractPin (Data, (PinType *) ptr2, Layer, Polygon);
-      Polygon->NoHolesValid = 0;
       return 1;
     case VIA_TYPE:
       via = (PinType *) ptr2;
       if (!VIA_IS_BURIED (via) || VIA_ON_LAYER (via, layer_n))
         {
           SubtractPin (Data, via, Layer, Polygon);
-          Polygon->NoHolesValid = 0;
           return 1;
 	}
       break;
     case LINE_TYPE:
       SubtractLine ((LineType *) ptr2, Polygon);
-      Polygon->NoHolesValid = 0;
       return 1;
     case ARC_TYPE:
       SubtractArc ((ArcType *) ptr2, Polygon);
-      Polygon->NoHolesValid = 0;
       return 1;
     case PAD_TYPE:
       SubtractPad ((PadType *) ptr2, Polygon);
-      Polygon->NoHolesValid = 0;
       return 1;
     case TEXT_TYPE:
       SubtractText ((TextType *) ptr2, Polygon);
-      Polygon->NoHolesValid = 0;
       return 1;
     }
   return 0;
@@ -1717,6 +2144,183 @@ PlowsPolygon (DataType * Data, int type, void *ptr1, void *ptr2,
   return r;
 }
 
+/*!
+ * \brief Nesting depth of DeferPolygonClipping() calls.
+ */
+static int defer_depth = 0;
+
+/*!
+ * \brief The regions of the board polygons whose clipping is out of date,
+ * as a GArray of BoxType for each polygon.
+ */
+static GHashTable *dirty_polygons = NULL;
+
+/*!
+ * \brief Above this many dirty regions a polygon is clipped from scratch.
+ */
+#define DIRTY_REGIONS_MAX 256
+
+static void
+free_dirty_regions (gpointer data)
+{
+  g_array_free ((GArray *) data, TRUE);
+}
+
+static int
+dirty_plow (DataType *Data, LayerType *Layer, PolygonType *Polygon,
+            int type, void *ptr1, void *ptr2, void *userdata)
+{
+  GArray *regions;
+  PinType *via;
+
+  switch (type)
+    {
+    case VIA_TYPE:
+      via = (PinType *) ptr2;
+      if (VIA_IS_BURIED (via)
+          && !VIA_ON_LAYER (via, GetLayerNumber (Data, Layer)))
+        return 0;
+      break;
+    case LINE_TYPE:
+    case ARC_TYPE:
+    case TEXT_TYPE:
+      if (!TEST_FLAG (CLEARLINEFLAG, (AnyObjectType *) ptr2))
+        return 0;
+      break;
+    }
+
+  if (dirty_polygons == NULL)
+    dirty_polygons = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            NULL, free_dirty_regions);
+  regions = (GArray *) g_hash_table_lookup (dirty_polygons, Polygon);
+  if (regions == NULL)
+    {
+      regions = g_array_new (FALSE, FALSE, sizeof (BoxType));
+      g_hash_table_insert (dirty_polygons, Polygon, regions);
+    }
+  g_array_append_val (regions, ((AnyObjectType *) ptr2)->BoundingBox);
+  return 1;
+}
+
+/*!
+ * \brief Bring the clipping of one polygon up to date in its dirty
+ * regions.
+ *
+ * Overlapping regions are merged first.  The regions then get the
+ * original polygon restored and everything in them cleared again, which
+ * is what the Unsubtract functions do for a single object.  That is done
+ * for all the regions at once, so a batch of changes, such as new
+ * thermals on many pins, costs one restore and one subtraction on the
+ * polygon instead of two boolean operations per change.
+ */
+static void
+update_dirty_polygon (LayerType *layer, PolygonType *polygon,
+                      GArray *regions)
+{
+  BoxType *box = (BoxType *) regions->data;
+  int n = regions->len, i, j;
+  bool merged;
+  POLYAREA **shapes, *np;
+
+  if (!polygon->Clipped || n > DIRTY_REGIONS_MAX)
+    {
+      InitClip (PCB->Data, layer, polygon);
+      return;
+    }
+
+  do
+    {
+      merged = false;
+      for (i = 0; i < n; i++)
+        for (j = i + 1; j < n; j++)
+          if (box_intersect (&box[i], &box[j]))
+            {
+              MAKEMIN (box[i].X1, box[j].X1);
+              MAKEMIN (box[i].Y1, box[j].Y1);
+              MAKEMAX (box[i].X2, box[j].X2);
+              MAKEMAX (box[i].Y2, box[j].Y2);
+              box[j--] = box[--n];
+              merged = true;
+            }
+    }
+  while (merged);
+
+  shapes = (POLYAREA **) malloc (n * sizeof (POLYAREA *));
+  for (i = 0; i < n; i++)
+    if ((shapes[i] = BoxPolyBloated (&box[i], UNSUBTRACT_BLOAT)) == NULL)
+      break;
+  if (i < n)
+    {
+      while (i > 0)
+        poly_Free (&shapes[--i]);
+      free (shapes);
+      InitClip (PCB->Data, layer, polygon);
+      return;
+    }
+  unite_shapes (shapes, n, &np);
+  free (shapes);
+
+  if (!np || !Unsubtract (np, polygon))
+    {
+      InitClip (PCB->Data, layer, polygon);
+      return;
+    }
+  clearPolyRegions (PCB->Data, layer, polygon, box, n, 2 * UNSUBTRACT_BLOAT);
+}
+
+/*!
+ * \brief Start collecting the changes to the board polygon clipping
+ * instead of doing them right away.
+ *
+ * Until the matching ResumePolygonClipping(), RestoreToPolygon() and
+ * ClearFromPolygon() only record the area of the objects they are given
+ * in the polygons they touch.  Calls nest.
+ */
+void
+DeferPolygonClipping (void)
+{
+  defer_depth++;
+}
+
+/*!
+ * \brief End a DeferPolygonClipping() section, updating the polygon
+ * clipping once the outermost section ends.
+ */
+void
+ResumePolygonClipping (void)
+{
+  assert (defer_depth > 0);
+  if (--defer_depth == 0)
+    UpdatePolygonClipping ();
+}
+
+/*!
+ * \brief Update the clipping of the board polygons in the regions
+ * collected by deferred RestoreToPolygon() and ClearFromPolygon() calls.
+ *
+ * Called before the polygons are drawn, exported or checked, so the
+ * clipping is always current when it is used.  Only polygons still on
+ * the board are looked at, so the ones removed in the meantime are just
+ * dropped.
+ */
+void
+UpdatePolygonClipping (void)
+{
+  GArray *regions;
+
+  if (dirty_polygons == NULL || g_hash_table_size (dirty_polygons) == 0)
+    return;
+
+  ALLPOLYGON_LOOP (PCB->Data);
+  {
+    regions = (GArray *) g_hash_table_lookup (dirty_polygons, polygon);
+    if (regions != NULL)
+      update_dirty_polygon (layer, polygon, regions);
+  }
+  ENDALL_LOOP;
+  g_hash_table_remove_all (dirty_polygons);
+}
+
 void
 RestoreToPolygon (DataType * Data, int type, void *ptr1, void *ptr2)
 {
@@ -1724,7 +2328,13 @@ RestoreToPolygon (DataType * Data, int type, void *ptr1, void *ptr2)
     return;
 
   if (type == POLYGON_TYPE)
-    InitClip (PCB->Data, (LayerType *) ptr1, (PolygonType *) ptr2);
+    {
+      if (dirty_polygons != NULL)
+        g_hash_table_remove (dirty_polygons, ptr2);
+      InitClip (PCB->Data, (LayerType *) ptr1, (PolygonType *) ptr2);
+    }
+  else if (defer_depth > 0 && Data == PCB->Data)
+    PlowsPolygon (Data, type, ptr1, ptr2, dirty_plow, NULL);
   else
     PlowsPolygon (Data, type, ptr1, ptr2, add_plow, NULL);
 }
@@ -1736,7 +2346,13 @@ ClearFromPolygon (DataType * Data, int type, void *ptr1, void *ptr2)
     return;
 
   if (type == POLYGON_TYPE)
-    InitClip (PCB->Data, (LayerType *) ptr1, (PolygonType *) ptr2);
+    {
+      if (dirty_polygons != NULL)
+        g_hash_table_remove (dirty_polygons, ptr2);
+      InitClip (PCB->Data, (LayerType *) ptr1, (PolygonType *) ptr2);
+    }
+  else if (defer_depth > 0 && Data == PCB->Data)
+    PlowsPolygon (Data, type, ptr1, ptr2, dirty_plow, NULL);
   else
     PlowsPolygon (Data, type, ptr1, ptr2, subtract_plow, NULL);
 }
@@ -1766,7 +2382,6 @@ isects (POLYAREA * a, PolygonType *p, bool fr)
 bool
 IsPointInPolygon (Coord X, Coord Y, Coord r, PolygonType *p)
 {
-  POLYAREA *c;
   Vector v;
   v[0] = X;
   v[1] = Y;
@@ -1779,12 +2394,12 @@ IsPointInPolygon (Coord X, Coord Y, Coord r, PolygonType *p)
    * */
   if (r < 1)
     return false;
-  
-  /* Create a circular POLYAREA of radius r, and see if it intersects. */
-  if (!(c = CirclePoly (X, Y, r)))
-    return false; /* failed to create POLYAREA */
 
-  return isects (c, p, true);
+  /* The circle touches if an edge of the polygon is within r of the
+   * centre.  The segment trees of the contours find the edges near it,
+   * without making a circle and touching it to the polygon.
+   */
+  return poly_M_SegmentTouches (p->Clipped, v, v, r);
 }
 
 
@@ -1896,6 +2511,294 @@ NoHolesPolygonDicer (PolygonType *p, const BoxType * clip,
   while ((cur = next) != main_contour);
 }
 
+/*!
+ * \brief Smallest number of holes for which a polygon's NoHoles cache
+ * is kept in tiles.
+ */
+#define POLY_TILES_MIN_HOLES 256
+
+/*!
+ * \brief Rough number of holes in one tile.
+ */
+#define POLY_TILES_HOLES 64
+
+/*!
+ * \brief Maximum number of tiles along one side of the grid.
+ */
+#define POLY_TILES_MAX 32
+
+/*!
+ * \brief One cell of a tiled NoHoles cache.
+ */
+struct polygon_tile
+{
+  PLINE *head;  /*!< Hole free pieces of Clipped inside this tile. */
+  PLINE *tail;  /*!< Last piece of the list starting at head. */
+  bool valid;   /*!< The pieces match the current Clipped. */
+};
+
+/*!
+ * \brief The NoHoles cache of a large pour, split on a grid.
+ *
+ * Full board ground planes have thousands of holes and dicing them takes
+ * a long time, so rendering them only after an edit near a via used to
+ * re-dice the whole plane.  The grid keeps the pieces of each tile apart,
+ * so only the tiles overlapping a changed region are diced again.
+ *
+ * The tile lists are chained into poly->NoHoles, which therefore belongs
+ * to the grid.  The grid only caches rendering data, poly->Clipped stays
+ * the one merged shape everything else (DRC, exporters) works on.
+ */
+struct polygon_tiles
+{
+  BoxType extent;               /*!< The polygon bounding box gridded. */
+  int nx, ny;                   /*!< Tiles along X and Y. */
+  Coord x[POLY_TILES_MAX + 1];  /*!< Tile column edges. */
+  Coord y[POLY_TILES_MAX + 1];  /*!< Tile row edges. */
+  struct polygon_tile tile[POLY_TILES_MAX * POLY_TILES_MAX];
+};
+
+/*!
+ * \brief Number of tiles along a side for the holes of the polygon, or
+ * 0 if it is not worth tiling.
+ */
+static int
+tiles_per_side (PolygonType *poly)
+{
+  PLINE *pl;
+  int holes = 0;
+  int side;
+
+  for (pl = poly->Clipped->contours->next; pl != NULL; pl = pl->next)
+    holes++;
+  if (holes < POLY_TILES_MIN_HOLES)
+    return 0;
+
+  side = (int) ceil (sqrt ((double) holes / POLY_TILES_HOLES));
+  return MIN (side, POLY_TILES_MAX);
+}
+
+static bool
+want_tiles (PolygonType *poly)
+{
+  if (poly->Tiles != NULL &&
+      memcmp (&poly->Tiles->extent, &poly->BoundingBox, sizeof (BoxType)) == 0)
+    return true;
+  return tiles_per_side (poly) > 0;
+}
+
+/*!
+ * \brief Free the tiled NoHoles cache of a polygon, if it has one.
+ */
+void
+FreePolygonTiles (PolygonType *poly)
+{
+  if (poly->Tiles == NULL)
+    return;
+  /* The tile lists are all chained into NoHoles */
+  poly_FreeContours (&poly->NoHoles);
+  free (poly->Tiles);
+  poly->Tiles = NULL;
+}
+
+static struct polygon_tiles *
+create_tiles (PolygonType *poly)
+{
+  struct polygon_tiles *t;
+  BoxType *b = &poly->BoundingBox;
+  int side = tiles_per_side (poly);
+  int i;
+
+  t = (struct polygon_tiles *)calloc (1, sizeof (*t));
+  t->extent = *b;
+  /* Keep the tiles at least one unit wide */
+  t->nx = MIN (side, b->X2 - b->X1);
+  t->ny = MIN (side, b->Y2 - b->Y1);
+  if (t->nx < 1 || t->ny < 1)
+    t->nx = t->ny = 1;
+
+  for (i = 0; i <= t->nx; i++)
+    t->x[i] = b->X1 + (Coord) ((double) (b->X2 - b->X1) * i / t->nx);
+  for (i = 0; i <= t->ny; i++)
+    t->y[i] = b->Y1 + (Coord) ((double) (b->Y2 - b->Y1) * i / t->ny);
+  return t;
+}
+
+/*!
+ * \brief Mark the tiles overlapping pa as out of date, or all of them
+ * if pa is NULL.
+ */
+static void
+invalidate_tiles (PolygonType *poly, POLYAREA *pa)
+{
+  struct polygon_tiles *t = poly->Tiles;
+  POLYAREA *cur;
+  BoxType box;
+  int i, j;
+
+  if (t == NULL)
+    return;
+
+  if (pa == NULL)
+    {
+      for (i = 0; i < t->nx * t->ny; i++)
+        t->tile[i].valid = false;
+      return;
+    }
+
+  cur = pa;
+  box.X1 = box.Y1 = MAX_COORD;
+  box.X2 = box.Y2 = -MAX_COORD;
+  do
+    {
+      MAKEMIN (box.X1, cur->contours->xmin);
+      MAKEMIN (box.Y1, cur->contours->ymin);
+      MAKEMAX (box.X2, cur->contours->xmax);
+      MAKEMAX (box.Y2, cur->contours->ymax);
+    }
+  while ((cur = cur->f) != pa);
+
+  for (j = 0; j < t->ny; j++)
+    {
+      if (t->y[j] > box.Y2 || t->y[j + 1] < box.Y1)
+        continue;
+      for (i = 0; i < t->nx; i++)
+        if (t->x[i] <= box.X2 && t->x[i + 1] >= box.X1)
+          t->tile[j * t->nx + i].valid = false;
+    }
+}
+
+static void
+add_tile_piece (PLINE *pline, void *user_data)
+{
+  struct polygon_tile *tile = (struct polygon_tile *)user_data;
+
+  pline->next = tile->head;
+  tile->head = pline;
+  if (tile->tail == NULL)
+    tile->tail = pline;
+}
+
+/*!
+ * \brief Dice the out of date tiles [i1, i2) x [j1, j2) from pa, the
+ * part of Clipped inside them.
+ *
+ * The range is halved with one cut per level, like r_NoHolesPolygonDicer
+ * does with the holes, so dicing every tile costs about as much as
+ * dicing the whole polygon at once. Ranges without out of date tiles are
+ * dropped as soon as they are cut off.
+ *
+ * \note This function will free the passed POLYAREA.
+ */
+static void
+dice_tiles (struct polygon_tiles *t, POLYAREA *pa,
+            int i1, int i2, int j1, int j2)
+{
+  POLYAREA *cut, *in, *out, *cur, *next;
+  bool dirty = false;
+  int i, j;
+
+  if (pa == NULL)
+    return;
+
+  for (j = j1; j < j2 && !dirty; j++)
+    for (i = i1; i < i2 && !dirty; i++)
+      dirty = !t->tile[j * t->nx + i].valid;
+  if (!dirty)
+    {
+      poly_Free (&pa);
+      return;
+    }
+
+  if (i2 - i1 == 1 && j2 - j1 == 1)
+    {
+      struct polygon_tile *tile = &t->tile[j1 * t->nx + i1];
+
+      cur = pa;
+      do
+        {
+          next = cur->f;
+          cur->f = cur->b = cur; /* Detach this polygon piece */
+          r_NoHolesPolygonDicer (cur, add_tile_piece, tile);
+          /* NB: The POLYAREA was freed by its use in the recursive dicer */
+        }
+      while ((cur = next) != pa);
+      return;
+    }
+
+  /* Cut off the lower half of the longer side of the range */
+  if (t->x[i2] - t->x[i1] >= t->y[j2] - t->y[j1] && i2 - i1 > 1)
+    {
+      int mid = (i1 + i2) / 2;
+
+      cut = RectPoly (t->x[i1], t->x[mid], t->y[j1], t->y[j2]);
+      poly_AndSubtract_free (pa, cut, &in, &out);
+      dice_tiles (t, in, i1, mid, j1, j2);
+      dice_tiles (t, out, mid, i2, j1, j2);
+    }
+  else
+    {
+      int mid = (j1 + j2) / 2;
+
+      cut = RectPoly (t->x[i1], t->x[i2], t->y[j1], t->y[mid]);
+      poly_AndSubtract_free (pa, cut, &in, &out);
+      dice_tiles (t, in, i1, i2, j1, mid);
+      dice_tiles (t, out, i1, i2, mid, j2);
+    }
+}
+
+/*!
+ * \brief Bring the tiled NoHoles cache of a polygon up to date.
+ */
+static void
+compute_tiled_noholes (PolygonType *poly)
+{
+  struct polygon_tiles *t;
+  POLYAREA *main_contour;
+  int i;
+
+  if (poly->Tiles != NULL &&
+      memcmp (&poly->Tiles->extent, &poly->BoundingBox, sizeof (BoxType)) != 0)
+    FreePolygonTiles (poly);
+  if (poly->Tiles == NULL)
+    {
+      poly_FreeContours (&poly->NoHoles);
+      poly->Tiles = create_tiles (poly);
+    }
+  t = poly->Tiles;
+
+  /* Take the tile lists apart again, dropping the out of date ones */
+  for (i = 0; i < t->nx * t->ny; i++)
+    {
+      struct polygon_tile *tile = &t->tile[i];
+
+      if (tile->tail != NULL)
+        tile->tail->next = NULL;
+      if (!tile->valid)
+        {
+          poly_FreeContours (&tile->head);
+          tile->tail = NULL;
+        }
+    }
+  poly->NoHoles = NULL;
+
+  main_contour = poly_Create ();
+  /* copy the main poly only */
+  poly_Copy1 (main_contour, poly->Clipped);
+  dice_tiles (t, main_contour, 0, t->nx, 0, t->ny);
+
+  for (i = t->nx * t->ny - 1; i >= 0; i--)
+    {
+      struct polygon_tile *tile = &t->tile[i];
+
+      tile->valid = true;
+      if (tile->head == NULL)
+        continue;
+      tile->tail->next = poly->NoHoles;
+      poly->NoHoles = tile->head;
+    }
+}
+
 /*!
  * \brief Make a polygon split into multiple parts into multiple
  * polygons.
@@ -1904,15 +2807,28 @@ bool
 MorphPolygon (LayerType *layer, PolygonType *poly)
 {
   POLYAREA *p, *start;
+  PolygonType **pieces;
+  ClipJobType *jobs;
   bool many = false;
+  bool diced;
   FlagType flags;
+  int n = 0, i;
 
   if (!poly->Clipped || TEST_FLAG (LOCKFLAG, poly))
     return false;
   if (poly->Clipped->f == poly->Clipped)
     return false;
   ErasePolygon (poly);
+  /* A HID that renders the NoHoles pieces will need them for every new
+   * polygon as soon as it is drawn. */
+  diced = NOHOLES_VALID (poly) && poly->NoHoles != NULL;
   start = p = poly->Clipped;
+  do
+    {
+      n++;
+    }
+  while ((p = p->f) != start);
+  pieces = (PolygonType **) malloc (n * sizeof (PolygonType *));
   /* This is ugly. The creation of the new polygons can cause
    * all of the polygon pointers (including the one we're called
    * with to change if there is a realloc in GetPolygonMemory().
@@ -1922,11 +2838,13 @@ MorphPolygon (LayerType *layer, PolygonType *poly)
    * we do this dirty work.
    */
   poly->Clipped = NULL;
-  if (poly->NoHoles) printf ("Just leaked in MorpyPolygon\n");
-  poly->NoHoles = NULL;
+  clipped_changed (poly, NULL);
+  FreePolygonTiles (poly);
+  poly_FreeContours (&poly->NoHoles);
   flags = poly->Flags;
   RemovePolygon (layer, poly);
   inhibit = true;
+  n = 0;
   do
     {
       VNODE *v;
@@ -1936,8 +2854,10 @@ MorphPolygon (LayerType *layer, PolygonType *poly)
         {
           newone = CreateNewPolygon (layer, flags);
           if (!newone)
-            return false;
+            break;
           many = true;
+          /* The piece is already clipped, only its outline is copied */
+          ReservePointsInPolygon (newone, p->contours->Count);
           v = &p->contours->head;
           CreateNewPointInPolygon (newone, v->point[0], v->point[1]);
           for (v = v->next; v != &p->contours->head; v = v->next)
@@ -1948,10 +2868,11 @@ MorphPolygon (LayerType *layer, PolygonType *poly)
           newone->BoundingBox.Y2 = p->contours->ymax + 1;
           AddObjectToCreateUndoList (POLYGON_TYPE, layer, newone, newone);
           newone->Clipped = p;
+          newone->ClippedGen++;
           p = p->f;             /* go to next pline */
           newone->Clipped->b = newone->Clipped->f = newone->Clipped;     /* unlink from others */
           r_insert_entry (layer->polygon_tree, (BoxType *) newone, 0);
-          DrawPolygon (layer, newone);
+          pieces[n++] = newone;
         }
       else
         {
@@ -1964,6 +2885,26 @@ MorphPolygon (LayerType *layer, PolygonType *poly)
     }
   while (p != start);
   inhibit = false;
+
+  /* The pieces are independent islands, so with several processors they
+   * are diced on the clipping workers before they are drawn. */
+  if (diced && n > 1 && g_get_num_processors () > 1)
+    {
+      jobs = (ClipJobType *) malloc (n * sizeof (ClipJobType));
+      for (i = 0; i < n; i++)
+        {
+          jobs[i].work = dice_job;
+          jobs[i].data = PCB->Data;
+          jobs[i].layer = layer;
+          jobs[i].polygon = pieces[i];
+        }
+      qsort (jobs, n, sizeof (ClipJobType), clip_job_cmp);
+      run_clip_jobs (jobs, n);
+      free (jobs);
+    }
+  for (i = 0; i < n; i++)
+    DrawPolygon (layer, pieces[i]);
+  free (pieces);
   IncrementUndoSerialNumber ();
   return many;
 }
@@ -2064,7 +3005,7 @@ PolyToPolygonsOnLayer (DataType *Destination, LayerType *Layer,
       InitClip (Destination, Layer, Polygon);
       SetPolygonBoundingBox (Polygon);
       if (!Layer->polygon_tree)
-        Layer->polygon_tree = r_create_tree (NULL, 0, 0);
+        Layer->polygon_tree = r_create_data_tree ();
       r_insert_entry (Layer->polygon_tree, (BoxType *) Polygon, 0);
 
       DrawPolygon (Layer, Polygon);
@@ -56,6 +56,11 @@
  */
 #define POLY_ARC_MAX_DEVIATION 0.02
 
+/*!
+ * \brief Are the NoHoles pieces of a polygon up to date?
+ */
+#define NOHOLES_VALID(p) ((p)->NoHolesGen == (p)->ClippedGen)
+
 /* Prototypes */
 
 void polygon_init (void);
@@ -76,6 +81,7 @@ int PlowsPolygon (DataType *, int, void *, void *,
                   int (*callback) (DataType *, LayerType *, PolygonType *, int, void *, void *, void *),
                   void *userdata);
 void ComputeNoHoles (PolygonType *poly);
+void FreePolygonTiles (PolygonType *poly);
 POLYAREA * original_poly(PolygonType *);
 POLYAREA * ContourToPoly (PLINE *);
 POLYAREA * PolygonToPoly (PolygonType *);
@@ -88,8 +94,13 @@ POLYAREA * PinPoly(PinType *l, Coord thick, Coord clear);
 POLYAREA * BoxPolyBloated (BoxType *box, Coord radius);
 void frac_circle (PLINE *, Coord, Coord, Vector, int);
 int InitClip(DataType *d, LayerType *l, PolygonType *p);
+void InitClipAll (DataType *d);
+void SetClip (PolygonType *p, POLYAREA *clipped);
 void RestoreToPolygon(DataType *, int, void *, void *);
 void ClearFromPolygon(DataType *, int, void *, void *);
+void DeferPolygonClipping (void);
+void ResumePolygonClipping (void);
+void UpdatePolygonClipping (void);
 
 bool IsPointInPolygon (Coord, Coord, Coord, PolygonType *);
 bool IsPointInPolygonIgnoreHoles (Coord, Coord, PolygonType *);
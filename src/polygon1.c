@@ -83,6 +83,7 @@
 #include "pcb-printf.h"
 #include "rtree.h"
 #include "heap.h"
+#include "profile.h"
 
 #define ROUND(a) (long)((a) > 0 ? ((a) + 0.5) : ((a) - 0.5))
 
@@ -127,6 +128,79 @@ int vect_inters2 (Vector A, Vector B, Vector C, Vector D, Vector S1,
   if (UNLIKELY (((ptr) = (type *)malloc(sizeof(type))) == NULL))	\
     error(err_no_memory);
 
+/*!
+ * \brief Allocation unit of a poly_arena.
+ */
+typedef union
+{
+  double d;
+  void *p;
+  long l;
+} arena_unit;
+
+#define ARENA_BLOCK_UNITS (16384 / sizeof (arena_unit))
+
+typedef struct arena_block
+{
+  struct arena_block *next;
+  size_t used, size;
+  arena_unit data[1];
+} arena_block;
+
+/*!
+ * \brief Memory for the short lived structures of one boolean
+ * operation.
+ *
+ * The cross vertex descriptors and the deferred node insertions only live
+ * until the operation that makes them is done, so they are carved from
+ * big blocks that are all released together at the end.
+ */
+typedef struct
+{
+  arena_block *blocks;
+} poly_arena;
+
+static void *
+arena_alloc (poly_arena * arena, size_t size)
+{
+  arena_block *b = arena->blocks;
+  size_t units = (size + sizeof (arena_unit) - 1) / sizeof (arena_unit);
+
+  if (b == NULL || b->used + units > b->size)
+    {
+      size_t n = MAX (units, ARENA_BLOCK_UNITS);
+
+      b = (arena_block *) malloc (sizeof (arena_block)
+				  + (n - 1) * sizeof (arena_unit));
+      if (b == NULL)
+	return NULL;
+      b->next = arena->blocks;
+      b->used = 0;
+      b->size = n;
+      arena->blocks = b;
+    }
+  b->used += units;
+  return &b->data[b->used - units];
+}
+
+static void
+arena_free (poly_arena * arena)
+{
+  arena_block *b;
+
+  while ((b = arena->blocks) != NULL)
+    {
+      arena->blocks = b->next;
+      free (b);
+    }
+}
+
+/* SWEEP_INTERSECT finds the crossings of two big contours with
+ * sweep_contours() instead of the edge rtrees.  It is off unless built
+ * with -DSWEEP_INTERSECT, as src/benchmark-sweep is, as it measured
+ * slower, see sweep_contours() and bench_polygon() in main-bench.c.
+ */
+
 #undef DEBUG_LABEL
 #undef DEBUG_ALL_LABELS
 #undef DEBUG_JUMP
@@ -238,9 +312,9 @@ node_add_single (VNODE * dest, Vector po)
  * (C) 2006 harry eaton.
  */
 static CVCList *
-new_descriptor (VNODE * a, char poly, char side)
+new_descriptor (poly_arena * arena, VNODE * a, char poly, char side)
 {
-  CVCList *l = (CVCList *) malloc (sizeof (CVCList));
+  CVCList *l = (CVCList *) arena_alloc (arena, sizeof (CVCList));
   Vector v;
   register double ang, dx, dy;
 
@@ -301,6 +375,7 @@ new_descriptor (VNODE * a, char poly, char side)
  *
  * (C) 2006 harry eaton.
  *
+ * \param arena holds the descriptors of the current operation.
  * \param a is a cross-vertex node.
  * \param poly is the polygon it comes from ('A' or 'B').
  * \param side is the side this descriptor goes on ('P' for
@@ -308,11 +383,12 @@ new_descriptor (VNODE * a, char poly, char side)
  * \param start is the head of the list of cvclists.
  */
 static CVCList *
-insert_descriptor (VNODE * a, char poly, char side, CVCList * start)
+insert_descriptor (poly_arena * arena, VNODE * a, char poly, char side,
+		   CVCList * start)
 {
   CVCList *l, *newone, *big, *small;
 
-  if (!(newone = new_descriptor (a, poly, side)))
+  if (!(newone = new_descriptor (arena, a, poly, side)))
     return NULL;
   /* search for the CVCList for this point */
   if (!start)
@@ -500,7 +576,7 @@ node_label (VNODE * pn)
  * (C) 2006 harry eaton.
  */
 static CVCList *
-add_descriptors (PLINE * pl, char poly, CVCList * list)
+add_descriptors (poly_arena * arena, PLINE * pl, char poly, CVCList * list)
 {
   VNODE *node = &pl->head;
 
@@ -510,10 +586,10 @@ add_descriptors (PLINE * pl, char poly, CVCList * list)
 	{
 	  assert (node->cvc_prev == (CVCList *) - 1
 		  && node->cvc_next == (CVCList *) - 1);
-	  list = node->cvc_prev = insert_descriptor (node, poly, 'P', list);
+	  list = node->cvc_prev = insert_descriptor (arena, node, poly, 'P', list);
 	  if (!node->cvc_prev)
 	    return NULL;
-	  list = node->cvc_next = insert_descriptor (node, poly, 'N', list);
+	  list = node->cvc_next = insert_descriptor (arena, node, poly, 'N', list);
 	  if (!node->cvc_next)
 	    return NULL;
 	}
@@ -559,6 +635,7 @@ typedef struct info
   jmp_buf *env, sego, *touch;
   int need_restart;
   insert_node_task *node_insert_list;
+  poly_arena *arena;
 } info;
 
 typedef struct contour_info
@@ -568,6 +645,7 @@ typedef struct contour_info
   jmp_buf *getout;
   int need_restart;
   insert_node_task *node_insert_list;
+  poly_arena *arena;
 } contour_info;
 
 
@@ -649,9 +727,11 @@ seg_in_region (const BoxType * b, void *cl)
  * \brief Prepend a deferred node-insersion task to a list.
  */
 static insert_node_task *
-prepend_insert_node_task (insert_node_task *list, seg *seg, VNODE *new_node)
+prepend_insert_node_task (poly_arena *arena, insert_node_task *list, seg *seg,
+                          VNODE *new_node)
 {
-  insert_node_task *task = (insert_node_task *)malloc (sizeof (*task));
+  insert_node_task *task =
+    (insert_node_task *)arena_alloc (arena, sizeof (*task));
   task->node_seg = seg;
   task->new_node = new_node;
   task->next = list;
@@ -727,7 +807,8 @@ seg_in_seg (const BoxType * b, void *cl)
        * add. 
        * */
 	  i->node_insert_list =
-	    prepend_insert_node_task (i->node_insert_list, i->s, new_node);
+	    prepend_insert_node_task (i->arena, i->node_insert_list, i->s,
+	                              new_node);
 	  i->s->intersected = 1;
 	  done_insert_on_i = true;
 	}
@@ -741,7 +822,7 @@ seg_in_seg (const BoxType * b, void *cl)
 	          cnt > 1 ? s2[0] : s1[0], cnt > 1 ? s2[1] : s1[1]);
 #endif
 	  i->node_insert_list =
-	    prepend_insert_node_task (i->node_insert_list, s, new_node);
+	    prepend_insert_node_task (i->arena, i->node_insert_list, s, new_node);
 	  s->intersected = 1;
 	  return 0; /* Keep looking for intersections with segment "i" */
 	}
@@ -806,6 +887,50 @@ make_edge_tree (PLINE * pb)
   return (void *) ans;
 }
 
+/* In compact mode contours keep no edge tree between operations: the
+ * tree is built when a boolean operation or a query first needs it and
+ * dropped again when the operation is done.
+ */
+static BOOLp compact_contours = FALSE;
+
+/*!
+ * \brief Keep polygon contours without their edge trees when idle.
+ *
+ * A pour of n vertices otherwise holds n segment records in its tree,
+ * each bigger than the VNODE it describes, for as long as it exists.
+ */
+void
+poly_SetCompact (BOOLp compact)
+{
+  compact_contours = compact;
+}
+
+/*!
+ * \brief The edge tree of a contour, built first if it has none.
+ */
+static rtree_t *
+contour_tree (PLINE * c)
+{
+  if (c->tree == NULL)
+    c->tree = (rtree_t *) make_edge_tree (c);
+  return c->tree;
+}
+
+static void
+drop_contour_trees (POLYAREA * p)
+{
+  POLYAREA *n = p;
+  PLINE *c;
+
+  if (!compact_contours || p == NULL)
+    return;
+  do
+    for (c = n->contours; c; c = c->next)
+      if (c->tree)
+	r_destroy_tree (&c->tree);
+  while ((n = n->f) != p);
+}
+
 static int
 get_seg (const BoxType * b, void *cl)
 {
@@ -841,6 +966,193 @@ get_seg (const BoxType * b, void *cl)
  * would probably work as well.
  */
 
+#ifdef SWEEP_INTERSECT
+#ifndef SWEEP_MIN_VERTICES
+/*!
+ * \brief Use sweep_contours() when both contours have at least this many
+ * vertices.
+ */
+#define SWEEP_MIN_VERTICES 2048
+#endif
+
+/*!
+ * \brief A segment for sweep_contours() to visit, with its sort key.
+ */
+typedef struct
+{
+  Coord x;
+  struct seg *s;
+} sweep_event;
+
+static int
+collect_seg (const BoxType * b, void *cl)
+{
+  sweep_event **next = (sweep_event **) cl;
+
+  (*next)->x = b->X1;
+  (*next)->s = (struct seg *) b;
+  (*next)++;
+  return 1;
+}
+
+static int
+sweep_event_cmp (const void *a, const void *b)
+{
+  const sweep_event *ea = (const sweep_event *) a;
+  const sweep_event *eb = (const sweep_event *) b;
+
+  if (ea->x != eb->x)
+    return ea->x < eb->x ? -1 : 1;
+  return 0;
+}
+
+/*!
+ * \brief A segment the sweep line of sweep_contours() is still in.
+ */
+typedef struct sweep_entry
+{
+  struct seg *s;
+  struct sweep_entry *next;
+} sweep_entry;
+
+/*!
+ * \brief The segments of one contour the sweep line is in, bucketed by y.
+ */
+typedef struct
+{
+  sweep_entry **bucket;
+  Coord y0, height;
+  int n;
+} sweep_status;
+
+static inline int
+sweep_bucket (sweep_status * st, Coord y)
+{
+  int b = (y - st->y0) / st->height;
+
+  return b < 0 ? 0 : (b >= st->n ? st->n - 1 : b);
+}
+
+/*!
+ * \brief Find the crossings of two big contours with a sweep over x.
+ *
+ * The segments of both contours are visited in order of their left
+ * edge.  Each contour keeps the segments the sweep line is still in, in
+ * buckets of a few segment heights in y, so a segment only meets the
+ * ones of the other contour near it, and a pair is tested only in the
+ * bucket where the higher of their lower edges falls.  Segments the
+ * sweep has passed are dropped as they are met.
+ *
+ * Compared to the rtree searches this sorts once instead of doing two
+ * searches for every vertex of the smaller contour.  Even so, uniting
+ * two wavy pours of 200k to 1M vertices each took 1.3 to 1.8 times as
+ * long with the sweep, mostly spent sorting again on every restart pass,
+ * so it is only compiled in with SWEEP_INTERSECT.
+ */
+static void
+sweep_contours (struct info *info, PLINE * pa, PLINE * pb)
+{
+  sweep_event *segs, *next;
+  sweep_status status[2];
+  volatile int i;
+  int n, k;
+  double height = 0;
+  jmp_buf restart, *env = info->env;
+
+  n = contour_tree (pa)->size + contour_tree (pb)->size;
+  segs = (sweep_event *) arena_alloc (info->arena, n * sizeof (sweep_event));
+  if (!segs)
+    {
+      assert (0); /* XXX: Memory allocation failure */
+      return;
+    }
+
+  next = segs;
+  r_search (pa->tree, NULL, NULL, collect_seg, &next);
+  r_search (pb->tree, NULL, NULL, collect_seg, &next);
+  n = next - segs;
+  qsort (segs, n, sizeof (sweep_event), sweep_event_cmp);
+
+  for (i = 0; i < n; i++)
+    height += segs[i].s->box.Y2 - segs[i].s->box.Y1;
+  for (k = 0; k < 2; k++)
+    {
+      status[k].y0 = min (pa->ymin, pb->ymin);
+      status[k].height = MAX (1, 4 * height / n);
+      status[k].n = MIN (n, (max (pa->ymax, pb->ymax) - status[k].y0)
+			     / status[k].height + 1);
+      status[k].bucket = (sweep_entry **)
+	arena_alloc (info->arena, status[k].n * sizeof (sweep_entry *));
+      if (!status[k].bucket)
+	{
+	  assert (0); /* XXX: Memory allocation failure */
+	  return;
+	}
+      memset (status[k].bucket, 0, status[k].n * sizeof (sweep_entry *));
+    }
+
+  info->env = &restart;
+  for (i = 0; i < n; i++)
+    {
+      struct seg *s = segs[i].s;
+      int own = (s->p == pb);
+      sweep_status *other = &status[!own];
+      int b, first, last;
+
+      /* seg_in_seg() jumps back here once s got a new vertex */
+      if (setjmp (restart))
+	continue;
+
+      /* If we're going to have another pass anyway, skip this */
+      if (s->intersected && info->node_insert_list != NULL)
+	continue;
+
+      info->s = s;
+      info->v = s->v;
+      first = sweep_bucket (other, s->box.Y1);
+      last = sweep_bucket (other, s->box.Y2 - 1);
+      for (b = first; b <= last; b++)
+	{
+	  sweep_entry **e = &other->bucket[b];
+
+	  while (*e)
+	    {
+	      struct seg *t = (*e)->s;
+
+	      if (t->box.X2 <= s->box.X1)
+		{
+		  /* the sweep has passed t */
+		  *e = (*e)->next;
+		  continue;
+		}
+	      e = &(*e)->next;
+	      if (t->box.Y1 < s->box.Y2 && s->box.Y1 < t->box.Y2
+		  && sweep_bucket (other, max (s->box.Y1, t->box.Y1)) == b)
+		seg_in_seg ((const BoxType *) t, info);
+	    }
+	}
+
+      first = sweep_bucket (&status[own], s->box.Y1);
+      last = sweep_bucket (&status[own], s->box.Y2 - 1);
+      for (b = first; b <= last; b++)
+	{
+	  sweep_entry *e = (sweep_entry *)
+	    arena_alloc (info->arena, sizeof (sweep_entry));
+
+	  if (!e)
+	    {
+	      assert (0); /* XXX: Memory allocation failure */
+	      return;
+	    }
+	  e->s = s;
+	  e->next = status[own].bucket[b];
+	  status[own].bucket[b] = e;
+	}
+    }
+  info->env = env;
+}
+#endif /* SWEEP_INTERSECT */
+
 static int
 contour_bounds_touch (const BoxType * b, void *cl)
 {
@@ -863,6 +1175,15 @@ contour_bounds_touch (const BoxType * b, void *cl)
   info.touch = c_info->getout;
   info.need_restart = 0;
   info.node_insert_list = c_info->node_insert_list;
+  info.arena = c_info->arena;
+
+#ifdef SWEEP_INTERSECT
+  if (MIN (pa->Count, pb->Count) >= SWEEP_MIN_VERTICES)
+  {
+    sweep_contours (&info, pa, pb);
+    goto done;
+  }
+#endif
 
   /* Pick which contour has the fewer points, and do the loop
    * over that. The r_tree makes hit-testing against a contour
@@ -908,7 +1229,7 @@ contour_bounds_touch (const BoxType * b, void *cl)
          * for this VNODE. Once we find it, it gets stored in info.s and 
          * we longjmp back here and continue.
          * */
-	    r_search (looping_over->tree, &box, NULL, get_seg, &info);
+	    r_search (contour_tree (looping_over), &box, NULL, get_seg, &info);
 	    assert (0);
 	  }
 
@@ -918,13 +1239,15 @@ contour_bounds_touch (const BoxType * b, void *cl)
     if (setjmp (restart))  continue;
 
     /* NB: If this actually hits anything, we are teleported back to the beginning */
-    info.tree = rtree_over->tree;
-    if (info.tree)
-      if (UNLIKELY (r_search (info.tree, &info.s->box,
-                              seg_in_region, seg_in_seg, &info)))
-        assert (0); /* XXX: Memory allocation failure */
+    info.tree = contour_tree (rtree_over);
+    if (UNLIKELY (r_search (info.tree, &info.s->box,
+                            seg_in_region, seg_in_seg, &info)))
+      assert (0); /* XXX: Memory allocation failure */
   } while ((av = av->next) != &looping_over->head);
 
+#ifdef SWEEP_INTERSECT
+done:
+#endif
   c_info->node_insert_list = info.node_insert_list;
   if (info.need_restart)
     c_info->need_restart = 1;
@@ -935,7 +1258,8 @@ contour_bounds_touch (const BoxType * b, void *cl)
  * \brief Determine if two polyareas touch each other
  * */
 static int
-intersect_impl (jmp_buf * jb, POLYAREA * b, POLYAREA * a, int add)
+intersect_impl (jmp_buf * jb, poly_arena * arena, POLYAREA * b, POLYAREA * a,
+		int add)
 {
   POLYAREA *t;
   PLINE *pa;
@@ -944,6 +1268,7 @@ intersect_impl (jmp_buf * jb, POLYAREA * b, POLYAREA * a, int add)
   insert_node_task *task;
   c_info.need_restart = 0;
   c_info.node_insert_list = NULL;
+  c_info.arena = arena;
 
   /* Search the r-tree of the object with most contours
    * We loop over the contours of "a". Swap if necessary.
@@ -1009,7 +1334,6 @@ intersect_impl (jmp_buf * jb, POLYAREA * b, POLYAREA * a, int add)
 
     need_restart = 1; /* Any new nodes could intersect */
 
-    free (task);
     task = next;
   }
 
@@ -1017,16 +1341,18 @@ intersect_impl (jmp_buf * jb, POLYAREA * b, POLYAREA * a, int add)
 }
 
 static int
-intersect (jmp_buf * jb, POLYAREA * b, POLYAREA * a, int add)
+intersect (jmp_buf * jb, poly_arena * arena, POLYAREA * b, POLYAREA * a,
+	   int add)
 {
   int call_count = 1;
-  while (intersect_impl (jb, b, a, add))
+  while (intersect_impl (jb, arena, b, a, add))
     call_count++;
   return 0;
 }
 
 static void
-M_POLYAREA_intersect (jmp_buf * e, POLYAREA * afst, POLYAREA * bfst, int add)
+M_POLYAREA_intersect (jmp_buf * e, poly_arena * arena, POLYAREA * afst,
+		      POLYAREA * bfst, int add)
 {
   POLYAREA *a = afst, *b = bfst;
   PLINE *curcA, *curcB;
@@ -1045,14 +1371,14 @@ M_POLYAREA_intersect (jmp_buf * e, POLYAREA * afst, POLYAREA * bfst, int add)
 	      a->contours->ymin <= b->contours->ymax)
 	  {
         /* BBs intersect */
-        if (UNLIKELY (intersect (e, a, b, add)))  error (err_no_memory);
+        if (UNLIKELY (intersect (e, arena, a, b, add)))  error (err_no_memory);
 	  }
     } while (add && (a = a->f) != afst);
 
     for (curcB = b->contours; curcB != NULL; curcB = curcB->next)
 	    if (curcB->Flags.status == ISECTED)
       {
-	      the_list = add_descriptors (curcB, 'B', the_list);
+	      the_list = add_descriptors (arena, curcB, 'B', the_list);
 	      if (UNLIKELY (the_list == NULL))  error (err_no_memory);
 	    }
   } while (add && (b = b->f) != bfst);
@@ -1061,7 +1387,7 @@ M_POLYAREA_intersect (jmp_buf * e, POLYAREA * afst, POLYAREA * bfst, int add)
     for (curcA = a->contours; curcA != NULL; curcA = curcA->next)
 	    if (curcA->Flags.status == ISECTED)
 	    {
-	      the_list = add_descriptors (curcA, 'A', the_list);
+	      the_list = add_descriptors (arena, curcA, 'A', the_list);
 	      if (UNLIKELY (the_list == NULL))  error (err_no_memory);
 	    }
   } while (add && (a = a->f) != afst);
@@ -2390,8 +2716,10 @@ M_POLYAREA_Collect (jmp_buf * e, POLYAREA * afst, POLYAREA ** contours,
 BOOLp
 Touching (POLYAREA * a, POLYAREA * b)
 {
+  poly_arena arena = {NULL};
   jmp_buf e;
   int code;
+  BOOLp touching = FALSE;
 
   if ((code = setjmp (e)) == 0)
     {
@@ -2401,16 +2729,14 @@ Touching (POLYAREA * a, POLYAREA * b)
       if (!poly_Valid (b))
 	return -1;
 #endif
-      M_POLYAREA_intersect (&e, a, b, false);
+      M_POLYAREA_intersect (&e, &arena, a, b, false);
 
-      if (M_POLYAREA_label (a, b, TRUE))
-	return TRUE;
-      if (M_POLYAREA_label (b, a, TRUE))
-	return TRUE;
+      touching = M_POLYAREA_label (a, b, TRUE) || M_POLYAREA_label (b, a, TRUE);
     }
   else if (code == TOUCHES)
-    return TRUE;
-  return FALSE;
+    touching = TRUE;
+  arena_free (&arena);
+  return touching;
 }
 
 /*!
@@ -2428,15 +2754,13 @@ poly_Boolean (const POLYAREA * a_org, const POLYAREA * b_org,
   return poly_Boolean_free (a, b, res, action);
 }				/* poly_Boolean */
 
-/*!
- * \brief Just like poly_Boolean but frees the input polys.
- */
-int
-poly_Boolean_free (POLYAREA * ai, POLYAREA * bi, POLYAREA ** res, int action)
+static int
+boolean_free (POLYAREA * ai, POLYAREA * bi, POLYAREA ** res, int action)
 {
   POLYAREA *a = ai, *b = bi;
   PLINE *a_isected = NULL;
   PLINE *p, *holes = NULL;
+  poly_arena arena = {NULL};
   jmp_buf e;
   int code;
 
@@ -2485,7 +2809,7 @@ poly_Boolean_free (POLYAREA * ai, POLYAREA * bi, POLYAREA ** res, int action)
 #endif
 
       /* intersect needs to make a list of the contours in a and b which are intersected */
-      M_POLYAREA_intersect (&e, a, b, TRUE);
+      M_POLYAREA_intersect (&e, &arena, a, b, TRUE);
 
       /* We could speed things up a lot here if we only processed the relevant contours */
       /* NB: Relevant parts of a are labeled below */
@@ -2519,11 +2843,28 @@ poly_Boolean_free (POLYAREA * ai, POLYAREA * bi, POLYAREA ** res, int action)
   if (code)
     {
       poly_Free (res);
+      arena_free (&arena);
       return code;
     }
+  arena_free (&arena);
+  drop_contour_trees (*res);
   assert (!*res || poly_Valid (*res));
   return code;
-}				/* poly_Boolean_free */
+}				/* boolean_free */
+
+/*!
+ * \brief Just like poly_Boolean but frees the input polys.
+ */
+int
+poly_Boolean_free (POLYAREA * ai, POLYAREA * bi, POLYAREA ** res, int action)
+{
+  int code;
+
+  PROFILE_BEGIN (PROFILE_POLYGON);
+  code = boolean_free (ai, bi, res, action);
+  PROFILE_END (PROFILE_POLYGON);
+  return code;
+}
 
 static void
 clear_marks (POLYAREA * p)
@@ -2547,18 +2888,13 @@ clear_marks (POLYAREA * p)
   while ((n = n->f) != p);
 }
 
-/*!
- * \brief Compute the intersection and subtraction (divides "a" into two
- * pieces) and frees the input polys.
- *
- * This assumes that bi is a single simple polygon.
- */
-int
-poly_AndSubtract_free (POLYAREA * ai, POLYAREA * bi,
-		       POLYAREA ** aandb, POLYAREA ** aminusb)
+static int
+and_subtract_free (POLYAREA * ai, POLYAREA * bi,
+		   POLYAREA ** aandb, POLYAREA ** aminusb)
 {
   POLYAREA *a = ai, *b = bi;
   PLINE *p, *holes = NULL;
+  poly_arena arena = {NULL};
   jmp_buf e;
   int code;
 
@@ -2574,7 +2910,7 @@ poly_AndSubtract_free (POLYAREA * ai, POLYAREA * bi,
       if (!poly_Valid (b))
 	return -1;
 #endif
-      M_POLYAREA_intersect (&e, a, b, TRUE);
+      M_POLYAREA_intersect (&e, &arena, a, b, TRUE);
 
       M_POLYAREA_label (a, b, FALSE);
       M_POLYAREA_label (b, a, FALSE);
@@ -2605,16 +2941,37 @@ poly_AndSubtract_free (POLYAREA * ai, POLYAREA * bi,
     }
 
 
+  arena_free (&arena);
   if (code)
     {
       poly_Free (aandb);
       poly_Free (aminusb);
       return code;
     }
+  drop_contour_trees (*aandb);
+  drop_contour_trees (*aminusb);
   assert (!*aandb || poly_Valid (*aandb));
   assert (!*aminusb || poly_Valid (*aminusb));
   return code;
-}				/* poly_AndSubtract_free */
+}				/* and_subtract_free */
+
+/*!
+ * \brief Compute the intersection and subtraction (divides "a" into two
+ * pieces) and frees the input polys.
+ *
+ * This assumes that bi is a single simple polygon.
+ */
+int
+poly_AndSubtract_free (POLYAREA * ai, POLYAREA * bi,
+		       POLYAREA ** aandb, POLYAREA ** aminusb)
+{
+  int code;
+
+  PROFILE_BEGIN (PROFILE_POLYGON);
+  code = and_subtract_free (ai, bi, aandb, aminusb);
+  PROFILE_END (PROFILE_POLYGON);
+  return code;
+}
 
 static inline int
 cntrbox_pointin (PLINE * c, Vector p)
@@ -2730,18 +3087,9 @@ poly_DelContour (PLINE ** c)
   for (cur = (*c)->head.prev; cur != &(*c)->head; cur = prev)
     {
       prev = cur->prev;
-      if (cur->cvc_next != NULL)
-	{
-	  free (cur->cvc_next);
-	  free (cur->cvc_prev);
-	}
+      /* cross vertex descriptors belong to the arena of their operation */
       free (cur);
     }
-  if ((*c)->head.cvc_next != NULL)
-    {
-      free ((*c)->head.cvc_next);
-      free ((*c)->head.cvc_prev);
-    }
   /*! \todo FIXME -- strict aliasing violation. */
   if ((*c)->tree)
     {
@@ -2824,8 +3172,10 @@ poly_PreContour (PLINE * C, BOOLp optimize)
   if (C->Count > 2)
     C->Flags.orient = ((area < 0) ? PLF_INV : PLF_DIR);
 
-  /* Generate an rtree for the contour. */
-  C->tree = (rtree_t *)make_edge_tree (C);
+  /* Generate an rtree for the contour, unless it is left to the first
+   * operation that needs it. */
+  if (!compact_contours)
+    C->tree = (rtree_t *)make_edge_tree (C);
 }				/* poly_PreContour */
 
 static int
@@ -2884,11 +3234,6 @@ void
 poly_ExclVertex (VNODE * node)
 {
   assert (node != NULL);
-  if (node->cvc_next)
-    {
-      free (node->cvc_next);
-      free (node->cvc_prev);
-    }
   node->prev->next = node->next;
   node->next->prev = node->prev;
 }
@@ -2943,7 +3288,8 @@ poly_CopyContour (PLINE ** dst, PLINE * src)
       // newnode->Flags = cur->Flags;
       poly_InclVertex ((*dst)->head.prev, newnode);
     }
-  (*dst)->tree = (rtree_t *)make_edge_tree (*dst);
+  if (!compact_contours)
+    (*dst)->tree = (rtree_t *)make_edge_tree (*dst);
   return TRUE;
 }
 
@@ -3176,7 +3522,7 @@ poly_InsideContour (PLINE * c, Vector p)
    * the bounding box
    * */
   if (setjmp (info.env) == 0)
-    r_search (c->tree, &ray, NULL, crossing, &info);
+    r_search (contour_tree (c), &ray, NULL, crossing, &info);
 
   /* if info.f != 0, the specified point is inside the polygon */
   return info.f;
@@ -3233,6 +3579,111 @@ poly_M_CheckInside (POLYAREA * p, Vector v0)
   return FALSE;
 }
 
+/*!
+ * \brief Squared distance from point p to the segment a-b.
+ */
+static double
+seg_point_dist2 (Vector a, Vector b, Vector p)
+{
+  double dx = (double) b[0] - a[0], dy = (double) b[1] - a[1];
+  double px = (double) p[0] - a[0], py = (double) p[1] - a[1];
+  double len2 = dx * dx + dy * dy, t;
+
+  t = len2 > 0 ? (px * dx + py * dy) / len2 : 0;
+  if (t < 0)
+    t = 0;
+  else if (t > 1)
+    t = 1;
+  px -= t * dx;
+  py -= t * dy;
+  return px * px + py * py;
+}
+
+struct seg_touch_info
+{
+  Vector a, b;
+  double r2;
+  BOOLp touches;
+};
+
+static int
+seg_touch_region (const BoxType * b, void *cl)
+{
+  return !((struct seg_touch_info *) cl)->touches;
+}
+
+static int
+seg_touch_found (const BoxType * b, void *cl)
+{
+  struct seg_touch_info *info = (struct seg_touch_info *) cl;
+  struct seg *s = (struct seg *) b;
+  Vector s1, s2;
+  double d;
+
+  if (info->touches)
+    return 0;
+  if (vect_inters2 (info->a, info->b, s->v->point, s->v->next->point,
+		    s1, s2))
+    d = 0;
+  else
+    d = MIN (MIN (seg_point_dist2 (s->v->point, s->v->next->point, info->a),
+		  seg_point_dist2 (s->v->point, s->v->next->point, info->b)),
+	     MIN (seg_point_dist2 (info->a, info->b, s->v->point),
+		  seg_point_dist2 (info->a, info->b, s->v->next->point)));
+  if (d <= info->r2)
+    info->touches = TRUE;
+  return info->touches;
+}
+
+/*!
+ * \brief Check if the points within r of the segment a-b touch this
+ * polyarea or any that it's linked to.
+ *
+ * This is the round ended line of width 2 * r, as LinePoly() makes it,
+ * without building it and without a boolean operation: the line touches
+ * if one end is inside, or if a contour edge is within r of its centre
+ * line.  The edges are found with the segment trees of the contours.
+ */
+BOOLp
+poly_M_SegmentTouches (POLYAREA * p, Vector a, Vector b, double r)
+{
+  struct seg_touch_info info;
+  POLYAREA *cur;
+  PLINE *c;
+  BoxType box;
+
+  if (p == NULL)
+    return FALSE;
+
+  info.a[0] = a[0];
+  info.a[1] = a[1];
+  info.b[0] = b[0];
+  info.b[1] = b[1];
+  info.r2 = r * r;
+  info.touches = FALSE;
+  box.X1 = MIN (a[0], b[0]) - (Coord) ceil (r) - 1;
+  box.Y1 = MIN (a[1], b[1]) - (Coord) ceil (r) - 1;
+  box.X2 = MAX (a[0], b[0]) + (Coord) ceil (r) + 1;
+  box.Y2 = MAX (a[1], b[1]) + (Coord) ceil (r) + 1;
+
+  cur = p;
+  do
+    {
+      if (poly_CheckInside (cur, a))
+	return TRUE;
+      for (c = cur->contours; c != NULL && !info.touches; c = c->next)
+	if (box.X1 <= c->xmax && box.X2 >= c->xmin
+	    && box.Y1 <= c->ymax && box.Y2 >= c->ymin)
+	  r_search (contour_tree (c), &box, seg_touch_region, seg_touch_found,
+		    &info);
+      if (info.touches)
+	return TRUE;
+    }
+  while ((cur = cur->f) != p);
+
+  return FALSE;
+}
+
 static double
 dot (Vector A, Vector B)
 {
@@ -3458,6 +3909,49 @@ poly_Free (POLYAREA ** p)
   free (*p), *p = NULL;
 }
 
+/*!
+ * \brief Bytes taken by a list of contours, with their vertices and
+ * segment trees.
+ *
+ * Adds the number of contours to *contours.
+ */
+size_t
+poly_ContourMemory (const PLINE * pl, long *contours)
+{
+  size_t size = 0;
+
+  for (; pl; pl = pl->next)
+    {
+      size += sizeof (PLINE) + pl->Count * sizeof (VNODE);
+      if (pl->tree)
+	size += r_memory (pl->tree) + pl->tree->size * sizeof (seg);
+      (*contours)++;
+    }
+  return size;
+}
+
+/*!
+ * \brief Bytes taken by a list of polygon areas, with their contours.
+ *
+ * Adds the number of contours to *contours.
+ */
+size_t
+poly_Memory (const POLYAREA * p, long *contours)
+{
+  const POLYAREA *cur = p;
+  size_t size = 0;
+
+  if (p == NULL)
+    return 0;
+  do
+    {
+      size += sizeof (POLYAREA) + poly_ContourMemory (cur->contours, contours);
+      size += r_memory (cur->contour_tree);
+    }
+  while ((cur = cur->f) != p);
+  return size;
+}
+
 static BOOLp
 inside_sector (VNODE * pn, Vector p2)
 {
@@ -3681,21 +4175,84 @@ vect_det2 (Vector v1, Vector v2)
   return (((double) v1[0] * v2[1]) - ((double) v2[0] * v1[1]));
 }
 
-static double
-vect_m_dist (Vector v1, Vector v2)
+/*!
+ * \brief Relative rounding error bound of orient_det().
+ *
+ * The coordinate differences are exact in doubles, so the computed
+ * determinant is off by at most this times the sum of the magnitudes of
+ * its two products (Shewchuk's ccwerrboundA).
+ */
+#define ORIENT_ERRBOUND 3.3306690738754716e-16
+
+/*!
+ * \brief Base the operands of exact_det_sign() are split in.
+ */
+#define EXACT_SPLIT (1LL << 20)
+
+/*!
+ * \brief Sign of a * b - c * d, computed exactly.
+ *
+ * All operands must be less than 2^40 in magnitude.  They are split in
+ * two digits of base EXACT_SPLIT, so every partial product fits easily
+ * in 64 bits.
+ */
+static int
+exact_det_sign (long long a, long long b, long long c, long long d)
 {
-  double dx = v1[0] - v2[0];
-  double dy = v1[1] - v2[1];
-  double dd = (dx * dx + dy * dy);	/* sqrt */
+  long long ah = a / EXACT_SPLIT, al = a % EXACT_SPLIT;
+  long long bh = b / EXACT_SPLIT, bl = b % EXACT_SPLIT;
+  long long ch = c / EXACT_SPLIT, cl = c % EXACT_SPLIT;
+  long long dh = d / EXACT_SPLIT, dl = d % EXACT_SPLIT;
+  long long hi = ah * bh - ch * dh;
+  long long mid = ah * bl + al * bh - ch * dl - cl * dh;
+  long long lo = al * bl - cl * dl;
+
+  /* Carry so that |mid|, |lo| < EXACT_SPLIT; then the highest non zero
+   * digit has the sign of the whole value. */
+  mid += lo / EXACT_SPLIT;
+  lo %= EXACT_SPLIT;
+  hi += mid / EXACT_SPLIT;
+  mid %= EXACT_SPLIT;
+
+  if (hi)
+    return hi > 0 ? 1 : -1;
+  if (mid)
+    return mid > 0 ? 1 : -1;
+  return lo > 0 ? 1 : (lo < 0 ? -1 : 0);
+}
 
-  if (dx > 0)
-    return +dd;
-  if (dx < 0)
-    return -dd;
-  if (dy > 0)
-    return +dd;
-  return -dd;
-}				/* vect_m_dist */
+/*!
+ * \brief Approximate value of the cross product (b - a) x (c - a).
+ */
+static inline double
+orient_det (Vector a, Vector b, Vector c)
+{
+  return ((double) b[0] - a[0]) * ((double) c[1] - a[1])
+    - ((double) b[1] - a[1]) * ((double) c[0] - a[0]);
+}
+
+/*!
+ * \brief Which side of the line a-b the point c lies.
+ *
+ * \return The sign of (b - a) x (c - a): 1 if c is to the left, -1 if it
+ * is to the right and 0 if the three points are collinear.
+ *
+ * The determinant is computed in doubles first.  Only when it is too
+ * close to zero for the sign to be trusted is it recomputed exactly, so
+ * the result is always right and usually cheap.
+ */
+static int
+orientation (Vector a, Vector b, Vector c)
+{
+  double l = ((double) b[0] - a[0]) * ((double) c[1] - a[1]);
+  double r = ((double) b[1] - a[1]) * ((double) c[0] - a[0]);
+  double det = l - r;
+
+  if (fabs (det) > ORIENT_ERRBOUND * (fabs (l) + fabs (r)))
+    return det > 0 ? 1 : -1;
+  return exact_det_sign ((long long) b[0] - a[0], (long long) c[1] - a[1],
+			 (long long) b[1] - a[1], (long long) c[0] - a[0]);
+}
 
 /*!
  * \brief vect_inters2.
@@ -3708,13 +4265,17 @@ vect_m_dist (Vector v1, Vector v2)
  *   0 - no intersection
  *   1 - segments cross, or are parallel and end to end
  *   2 - segments are parallel and overlap each other
+ *
+ * Whether and how the segments meet is decided with exact orientation
+ * tests, so the answer is right for all coordinates.  Only the position
+ * of a crossing that is not at an end point is computed, and rounded to
+ * the grid, in floating point.
  */
 int
 vect_inters2 (Vector p1, Vector p2, Vector q1, Vector q2,
 	      Vector S1, Vector S2)
 {
-  double s, t, deel;
-  double rpx, rpy, rqx, rqy;
+  int o1, o2, o3, o4;
 
   if (max (p1[0], p2[0]) < min (q1[0], q2[0]) ||
       max (q1[0], q2[0]) < min (p1[0], p2[0]) ||
@@ -3722,37 +4283,31 @@ vect_inters2 (Vector p1, Vector p2, Vector q1, Vector q2,
       max (q1[1], q2[1]) < min (p1[1], p2[1]))
     return 0;
 
-  /* vec(rpx, rpy) points from p1 to p2, and vec(rqx, rqy) points 
-   * from q1 to q2
-   * */
-  rpx = p2[0] - p1[0];
-  rpy = p2[1] - p1[1];
-  rqx = q2[0] - q1[0];
-  rqy = q2[1] - q1[1];
-
-  deel = rpy * rqx - rpx * rqy;	/* -vect_det(rp,rq); */
-
-  /* coordinates are 30-bit integers so deel will be exactly zero
-   * if the lines are parallel
-   */
+  /* Which side of p1-p2 the end points of q1-q2 are on */
+  o1 = orientation (p1, p2, q1);
+  o2 = orientation (p1, p2, q2);
 
-  if (deel == 0)		/* parallel */
+  if (o1 == 0 && o2 == 0)	/* parallel */
     {
       double dc1, dc2, d1, d2, h;	/* Check to see whether p1-p2 and q1-q2 are on the same line */
-      Vector hp1, hq1, hp2, hq2, q1p1, q1q2;
-
-      Vsub2 (q1p1, q1, p1);
-      Vsub2 (q1q2, q1, q2);
-
-      /* If this product is not zero then p1-p2 and q1-q2 are not on same line! */
-      if (vect_det2 (q1p1, q1q2) != 0)  return 0;
-
-      dc1 = 0;			/* m_len(p1 - p1) */
+      Vector hp1, hq1, hp2, hq2;
+      int axis;
 
+      /* p1-p2 may be a single point, which is only on the line of q1-q2
+       * if it is collinear with it.
+       */
+      if (orientation (q1, q2, p1) != 0)  return 0;
 
-      dc2 = vect_m_dist (p1, p2); /* signed dist^2 */
-      d1 = vect_m_dist (p1, q1);
-      d2 = vect_m_dist (p1, q2);
+      /* All points are on one line, so their order along it is the order
+       * of their x coordinates, or of their y coordinates if the line is
+       * vertical.  Measured from p1 towards smaller coordinates, as the
+       * signed distances used to be.
+       */
+      axis = (p1[0] == p2[0] && q1[0] == q2[0] && p1[0] == q1[0]);
+      dc1 = 0;
+      dc2 = (double) p1[axis] - p2[axis];
+      d1 = (double) p1[axis] - q1[axis];
+      d2 = (double) p1[axis] - q2[axis];
 
 /* Sorting the independent points from small to large */
       Vcpy2 (hp1, p1);
@@ -3804,51 +4359,54 @@ vect_inters2 (Vector p1, Vector p2, Vector q1, Vector q2,
 	}
       return (Vequ2 (S1, S2) ? 1 : 2);
     }
+
+  /* Both end points of q1-q2 on the same side of p1-p2 */
+  if (o1 == o2)
+    return 0;
+  /* Both end points of p1-p2 on the same side of q1-q2 */
+  o3 = orientation (q1, q2, p1);
+  o4 = orientation (q1, q2, p2);
+  if (o3 == o4)
+    return 0;
+
+  /* The segments cross.  Where they meet at an end point, that point is
+   * the exact answer.
+   */
+  if (Vequ2 (q1, p1) || Vequ2 (q1, p2) || o1 == 0)
+    {
+      Vcpy2 (S1, q1);
+    }
+  else if (Vequ2 (q2, p1) || Vequ2 (q2, p2) || o2 == 0)
+    {
+      Vcpy2 (S1, q2);
+    }
+  else if (o3 == 0)
+    {
+      Vcpy2 (S1, p1);
+    }
+  else if (o4 == 0)
+    {
+      Vcpy2 (S1, p2);
+    }
   else
-    {				/* not parallel */
+    {
       /*
-       * We have the lines:
-       * l1: p1 + s(p2 - p1)
-       * l2: q1 + t(q2 - q1)
-       * And we want to know the intersection point.
-       * Calculate t:
-       * p1 + s(p2-p1) = q1 + t(q2-q1)
-       * which is similar to the two equations:
-       * p1x + s * rpx = q1x + t * rqx
-       * p1y + s * rpy = q1y + t * rqy
-       * Multiplying these by rpy resp. rpx gives:
-       * rpy * p1x + s * rpx * rpy = rpy * q1x + t * rpy * rqx
-       * rpx * p1y + s * rpx * rpy = rpx * q1y + t * rpx * rqy
-       * Subtracting these gives:
-       * rpy * p1x - rpx * p1y = rpy * q1x - rpx * q1y + t * ( rpy * rqx - rpx * rqy )
-       * So t can be isolated:
-       * t = (rpy * ( p1x - q1x ) + rpx * ( - p1y + q1y )) / ( rpy * rqx - rpx * rqy )
-       * and s can be found similarly
-       * s = (rqy * (q1x - p1x) + rqx * (p1y - q1y))/( rqy * rpx - rqx * rpy)
+       * The cross product with p2 - p1 is linear along q1-q2 and zero at
+       * the crossing, so the crossing is at
+       *   q1 + t (q2 - q1),  t = det (q1) / (det (q1) - det (q2))
        */
-
-      if (Vequ2 (q1, p1) || Vequ2 (q1, p2))
-	{
-	  S1[0] = q1[0];
-	  S1[1] = q1[1];
-	}
-      else if (Vequ2 (q2, p1) || Vequ2 (q2, p2))
-	{
-	  S1[0] = q2[0];
-	  S1[1] = q2[1];
-	}
-      else
-	{
-	  s = (rqy * (p1[0] - q1[0]) + rqx * (q1[1] - p1[1])) / deel;
-	  if (s < 0 || s > 1.)
-	    return 0;
-	  t = (rpy * (p1[0] - q1[0]) + rpx * (q1[1] - p1[1])) / deel;
-	  if (t < 0 || t > 1.)
-	    return 0;
-
-	  S1[0] = q1[0] + ROUND (t * rqx);
-	  S1[1] = q1[1] + ROUND (t * rqy);
-	}
-      return 1;
+      double d1 = orient_det (p1, p2, q1);
+      double d2 = orient_det (p1, p2, q2);
+      double t = d1 / (d1 - d2);
+
+      /* The signs are known to differ; the computed values only give
+       * the position. */
+      if (!(t > 0))
+	t = 0;
+      else if (t > 1)
+	t = 1;
+      S1[0] = q1[0] + ROUND (t * ((double) q2[0] - q1[0]));
+      S1[1] = q1[1] + ROUND (t * ((double) q2[1] - q1[1]));
     }
+  return 1;
 }				/* vect_inters2 */
@@ -0,0 +1,264 @@
+/*!
+ * \file src/profile.c
+ *
+ * \brief Time and call counts of the main subsystems, for Profile().
+ *
+ * Each subsystem is a section, entered and left at the entry point of
+ * the subsystem: r_search() for the r-trees, the boolean operations of
+ * the polygons, DoIt() for the connection lookups of find.c, drawing by
+ * hid_expose_callback(), and the do_export() of an exporter, which is
+ * where its output is written.
+ *
+ * Calls are counted on every thread, time only on the thread that
+ * started the profiler.  The time of a section is the time of its
+ * outermost calls, so one that calls itself is not counted twice, but
+ * it does include the time of the other sections it calls: drawing
+ * includes the r-tree searches made to draw.
+ *
+ * While the profiler is stopped a section costs a test of a flag.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "error.h"
+#include "macro.h"
+#include "misc.h"
+#include "profile.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+bool profile_active = false;
+
+static const char *section_names[PROFILE_SECTIONS] = {
+  "rtree", "polygon", "find", "draw", "export"
+};
+
+static struct
+{
+  gint calls;
+  /* outermost calls still running on the profiled thread */
+  int depth;
+  gint64 usec;
+} sections[PROFILE_SECTIONS];
+
+static GThread *profile_thread = NULL;
+static gint64 profile_started, profile_usec;
+/* where Profile(Start, file) wants the report written at exit */
+static char *profile_exit_file = NULL;
+
+/*!
+ * \brief Count a call of a section.
+ *
+ * \return the time the call started, or 0 if it isn't timed.
+ */
+gint64
+profile_enter (ProfileSection s)
+{
+  g_atomic_int_inc (&sections[s].calls);
+  if (g_thread_self () != profile_thread || sections[s].depth++ > 0)
+    return 0;
+  return g_get_monotonic_time ();
+}
+
+void
+profile_leave (ProfileSection s, gint64 start)
+{
+  sections[s].depth--;
+  sections[s].usec += g_get_monotonic_time () - start;
+}
+
+static void
+profile_stop (void)
+{
+  if (!profile_active)
+    return;
+  profile_active = false;
+  profile_usec += g_get_monotonic_time () - profile_started;
+}
+
+static void
+profile_report_log (void)
+{
+  int i;
+
+  Message (_("Profile: %.3f s\n"), profile_usec / 1e6);
+  for (i = 0; i < PROFILE_SECTIONS; i++)
+    Message (_("  %-8s %10d calls %10.3f s %5.1f%%\n"),
+	     section_names[i], sections[i].calls, sections[i].usec / 1e6,
+	     profile_usec ? 100.0 * sections[i].usec / profile_usec : 0.0);
+}
+
+static int
+profile_report_json (const char *filename)
+{
+  FILE *fp;
+  int i;
+
+  fp = filename ? fopen (filename, "w") : NULL;
+  if (filename && fp == NULL)
+    {
+      OpenErrorMessage ((char *) filename);
+      return 1;
+    }
+
+  if (fp)
+    fprintf (fp, "{\n  \"seconds\": %.6f,\n  \"sections\": {\n",
+	     profile_usec / 1e6);
+  else
+    Message ("{ \"seconds\": %.6f, \"sections\": {\n", profile_usec / 1e6);
+  for (i = 0; i < PROFILE_SECTIONS; i++)
+    {
+      const char *sep = i + 1 < PROFILE_SECTIONS ? "," : "";
+
+      if (fp)
+	fprintf (fp, "    \"%s\": { \"calls\": %d, \"seconds\": %.6f }%s\n",
+		 section_names[i], sections[i].calls, sections[i].usec / 1e6,
+		 sep);
+      else
+	Message ("  \"%s\": { \"calls\": %d, \"seconds\": %.6f }%s\n",
+		 section_names[i], sections[i].calls, sections[i].usec / 1e6,
+		 sep);
+    }
+  if (fp)
+    {
+      fprintf (fp, "  }\n}\n");
+      fclose (fp);
+    }
+  else
+    Message ("} }\n");
+  return 0;
+}
+
+static void
+profile_at_exit (void)
+{
+  profile_stop ();
+  if (profile_exit_file)
+    profile_report_json (profile_exit_file);
+}
+
+static const char profile_syntax[] =
+  "Profile(Start[, file]|Stop|Report[, JSON[, file]])";
+
+static const char profile_help[] =
+  "Time the main subsystems of pcb.";
+
+/* %start-doc actions Profile
+
+Counts the calls of, and times, the main subsystems of pcb: searches
+of the r-trees, boolean operations of polygons, connection lookups,
+drawing, and exporting.  The report is worth attaching to a report of
+something that is too slow.
+
+@table @code
+
+@item Start
+Clears the counts and starts counting.  Given a file, a @code{JSON}
+report is written to it when pcb exits, which profiles an export:
+
+@example
+pcb -x gerber --action-string "Profile(Start, profile.json)" board.pcb
+@end example
+
+@item Stop
+Stops counting, the counts are kept for a report.
+
+@item Report
+Writes the counts so far to the log, or with @code{JSON} as a
+@code{JSON} object, to the log or to the file given.
+
+@end table
+
+The time of a subsystem includes that of the others it uses: drawing
+includes the searches of the r-trees made while drawing.  Only the
+time spent by the thread that started the profiler is counted, the
+calls of all threads are.
+
+%end-doc */
+
+static int
+ActionProfile (int argc, char **argv, Coord x, Coord y)
+{
+  const char *function = ARG (0);
+
+  if (function == NULL)
+    AFAIL (profile);
+
+  if (strcasecmp (function, "Start") == 0)
+    {
+      memset (sections, 0, sizeof (sections));
+      profile_thread = g_thread_self ();
+      profile_usec = 0;
+      profile_started = g_get_monotonic_time ();
+      profile_active = true;
+      if (argc > 1)
+	{
+	  if (profile_exit_file == NULL)
+	    atexit (profile_at_exit);
+	  free (profile_exit_file);
+	  profile_exit_file = strdup (argv[1]);
+	}
+      return 0;
+    }
+  if (strcasecmp (function, "Stop") == 0)
+    {
+      profile_stop ();
+      return 0;
+    }
+  if (strcasecmp (function, "Report") == 0)
+    {
+      /* a report while the profiler runs counts up to now */
+      if (profile_active)
+	{
+	  gint64 now = g_get_monotonic_time ();
+
+	  profile_usec += now - profile_started;
+	  profile_started = now;
+	}
+      if (argc > 1 && strcasecmp (argv[1], "JSON") == 0)
+	return profile_report_json (argc > 2 ? argv[2] : NULL);
+      if (argc > 1)
+	AFAIL (profile);
+      profile_report_log ();
+      return 0;
+    }
+  AFAIL (profile);
+}
+
+HID_Action profile_action_list[] = {
+  {"Profile", 0, ActionProfile,
+   profile_help, profile_syntax}
+};
+
+REGISTER_ACTIONS (profile_action_list)
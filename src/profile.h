@@ -0,0 +1,61 @@
+/*!
+ * \file src/profile.h
+ *
+ * \brief Time and call counts of the main subsystems, for Profile().
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef	PCB_PROFILE_H
+#define	PCB_PROFILE_H
+
+#include "global.h"
+
+typedef enum
+{
+  PROFILE_RTREE,		/* r_search() */
+  PROFILE_POLYGON,		/* poly_Boolean() and poly_Boolean_free() */
+  PROFILE_FIND,			/* DoIt() */
+  PROFILE_DRAW,			/* hid_expose_callback() */
+  PROFILE_EXPORT,		/* the do_export() of an exporter */
+  PROFILE_SECTIONS
+} ProfileSection;
+
+/* true between Profile(Start) and Profile(Stop) */
+extern bool profile_active;
+
+gint64 profile_enter (ProfileSection);
+void profile_leave (ProfileSection, gint64);
+
+/*!
+ * \brief Time the code between PROFILE_BEGIN and PROFILE_END, in a block
+ * of its own, as a section.
+ *
+ * With the profiler stopped this costs a test of profile_active.
+ */
+#define PROFILE_BEGIN(section) \
+  { gint64 profile_start_ = profile_active ? profile_enter (section) : 0
+#define PROFILE_END(section) \
+  if (profile_start_) profile_leave (section, profile_start_); }
+
+#endif
@@ -102,36 +102,13 @@ within (Coord x1, Coord y1, Coord x2, Coord y2, Coord r)
   return Distance (x1, y1, x2, y2) <= r / 2;
 }
 
+/* Is (x, y) at the start of the arc, or at its end if at_end is set.  */
 static int
-arc_endpoint_is (ArcType *a, int angle, Coord x, Coord y)
+arc_endpoint_is (ArcType *a, int at_end, Coord x, Coord y)
 {
-  Coord ax = a->X, ay = a->Y;
+  PointType *p = at_end ? ARC_END_POINT (a) : ARC_START_POINT (a);
+  Coord ax = p->X, ay = p->Y;
 
-  if (angle % 90 == 0)
-    {
-      int ai = (int) (angle / 90) & 3;
-      switch (ai)
-	{
-	case 0:
-	  ax -= a->Width;
-	  break;
-	case 1:
-	  ay += a->Height;
-	  break;
-	case 2:
-	  ax += a->Width;
-	  break;
-	case 3:
-	  ay -= a->Height;
-	  break;
-	}
-    }
-  else
-    {
-      double rad = angle * M_PI / 180;
-      ax -= a->Width * cos (rad);
-      ay += a->Width * sin (rad);
-    }
 #if TRACE1
   pcb_printf (" - arc endpoint %#mD\n", ax, ay);
 #endif
@@ -366,8 +343,8 @@ arc_callback (const BoxType * b, void *cl)
   pcb_printf ("arc a %#mD r %#mS sa %ld d %ld\n", a->X, a->Y, a->Width,
 	  a->StartAngle, a->Delta);
 #endif
-  if (!arc_endpoint_is (a, a->StartAngle, x, y)
-      && !arc_endpoint_is (a, a->StartAngle + a->Delta, x, y))
+  if (!arc_endpoint_is (a, 0, x, y)
+      && !arc_endpoint_is (a, 1, x, y))
     return 1;
   if (arc_dist < 2)
     {
@@ -481,13 +458,12 @@ Puller (int argc, char **argv, Coord Ux, Coord Uy)
 
   cx = the_arc->X;
   cy = the_arc->Y;
-  if (arc_endpoint_is (the_arc, the_arc->StartAngle, x, y))
+  if (arc_endpoint_is (the_arc, 0, x, y))
     {
       ChangeArcAngles (CURRENT, the_arc, the_arc->StartAngle + the_arc->Delta,
 		       -the_arc->Delta);
     }
-  else if (!arc_endpoint_is (the_arc, the_arc->StartAngle + the_arc->Delta,
-			     x, y))
+  else if (!arc_endpoint_is (the_arc, 1, x, y))
     {
 #if TRACE1
       printf ("arc not endpoints\n");
@@ -631,6 +607,11 @@ typedef struct End {
   Coord x, y; /* arc endpoint */
   /* If not NULL, points to End with pending==1 we're blocked on. */
   struct End *waiting_for;
+  /* If non-zero, this end was blocked when the pull was last tried,
+     with pull_changes[checked-1] the first change since, and the
+     pull looked at the area in checked_box.  */
+  int checked;
+  BoxType checked_box;
 } End;
 
 typedef struct Extra {
@@ -649,6 +630,13 @@ static Extra multi_next;
 static GHashTable *lines;
 static GHashTable *arcs;
 static int did_something;
+
+/* The areas where the pulls so far have moved, made or deleted
+   something, or let go of an end.  A blocked pull gives the same
+   answer until one of these touches the area it looked at, so it is
+   only tried again then.  */
+static BoxType *pull_changes;
+static int n_pull_changes, max_pull_changes;
 static int current_is_top, current_is_bottom;
 
 /* If set, these are the pins/pads/vias that this path ends on.  */
@@ -1847,6 +1835,50 @@ gp_pad_cb (const BoxType *b, void *cb)
   return 0;
 }
 
+static void
+note_change (const BoxType *b)
+{
+  if (n_pull_changes == max_pull_changes)
+    {
+      max_pull_changes = max_pull_changes ? max_pull_changes * 2 : 256;
+      pull_changes = (BoxType *) realloc (pull_changes,
+					  max_pull_changes * sizeof (BoxType));
+    }
+  pull_changes[n_pull_changes++] = *b;
+}
+
+/*!
+ * \brief Note the area of the path being pulled, before and after the
+ * pull changes it.
+ */
+static void
+note_path_change (void)
+{
+  if (start_arc)
+    note_change (&start_arc->BoundingBox);
+  note_change (&start_line->BoundingBox);
+  note_change (&end_line->BoundingBox);
+  if (end_arc)
+    note_change (&end_arc->BoundingBox);
+}
+
+/*!
+ * \brief Whether anything changed near a blocked end since its pull
+ * was last tried.
+ */
+static int
+changed_since_checked (End *end)
+{
+  BoxType *b = &end->checked_box;
+  int i;
+
+  for (i = end->checked - 1; i < n_pull_changes; i++)
+    if (pull_changes[i].X1 <= b->X2 && b->X1 <= pull_changes[i].X2
+	&& pull_changes[i].Y1 <= b->Y2 && b->Y1 <= pull_changes[i].Y2)
+      return 1;
+  return 0;
+}
+
 static LineType *
 create_line (LineType *sample, Coord x1, Coord y1, Coord x2, Coord y2)
 {
@@ -2039,6 +2071,8 @@ maybe_pull_1 (LineType *line)
   end_line = EXTRA2LINE (end_extra);
   if (end_extra->deleted)
     {
+      if (start_extra->end.pending)
+	note_change (&start_line->BoundingBox);
       start_extra->end.pending = 0;
       return;
     }
@@ -2104,6 +2138,9 @@ maybe_pull_1 (LineType *line)
   
   if (start_line->Thickness != end_line->Thickness)
     return;
+  if (start_extra->end.checked
+      && !changed_since_checked (&start_extra->end))
+    return;
   thickness = (start_line->Thickness + 1)/2 + PCB->Bloat;
 
   /* At this point, our expectations are all met.  */
@@ -2233,9 +2270,13 @@ maybe_pull_1 (LineType *line)
   if (fp)
     {
       start_extra->end.waiting_for = fp_end;
+      start_extra->end.checked = n_pull_changes + 1;
+      start_extra->end.checked_box = box;
       return;
     }
   start_extra->end.pending = 0;
+  start_extra->end.checked = 0;
+  note_path_change ();
 
   /* Step 0: check for merged arcs (special case).  */
 
@@ -2271,6 +2312,7 @@ maybe_pull_1 (LineType *line)
       mark_line_for_deletion (end_line);
       ChangeArcAngles (CURRENT, start_arc, start_arc->StartAngle, new_delta);
       fix_arc_extra (start_arc, sarc_extra);
+      note_path_change ();
       did_something ++;
       return;
     }
@@ -2402,6 +2444,7 @@ maybe_pull_1 (LineType *line)
 	}
       mark_line_for_deletion (end_line);
       start_extra->end.pending = 1;
+      note_path_change ();
 
 #if TRACE1
       printf("\033[35mdid_something: no obstacles\033[0m\n");
@@ -2471,6 +2514,10 @@ maybe_pull_1 (LineType *line)
   new_lextra->end.next = end_extra;
   end_extra->start.next = new_lextra;
 
+  note_path_change ();
+  note_change (&new_arc->BoundingBox);
+  note_change (&new_line->BoundingBox);
+
   /* Step 5: Recurse.  */
 
   did_something ++;
@@ -2506,6 +2553,8 @@ maybe_pull (LineType *line, Extra *e)
     }
   else
     {
+      if (e->end.pending || e->start.pending)
+	note_change (&line->BoundingBox);
       e->end.pending = 0;
       if (e->start.next && EXTRA_IS_LINE (e->start.next))
 	{
@@ -2695,6 +2744,9 @@ GlobalPuller(int argc, char **argv, Coord x, Coord y)
 
   g_hash_table_unref (lines);
   g_hash_table_unref (arcs);
+  free (pull_changes);
+  pull_changes = NULL;
+  n_pull_changes = max_pull_changes = 0;
 
   IncrementUndoSerialNumber();
   return 0;
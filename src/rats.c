@@ -46,6 +46,7 @@
 
 #include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include "global.h"
 
@@ -56,12 +57,14 @@
 #include "file.h"
 #include "find.h"
 #include "flags.h"
+#include "job.h"
 #include "misc.h"
 #include "mymem.h"
 #include "polygon.h"
 #include "rats.h"
 #include "search.h"
 #include "set.h"
+#include "remove.h"
 #include "undo.h"
 
 #ifdef HAVE_LIBDMALLOC
@@ -76,9 +79,8 @@
  */
 static bool FindPad (char *, char *, ConnectionType *, bool);
 static bool ParseConnection (char *, char *, char *);
-static bool DrawShortestRats (NetListType *, void (*)(register ConnectionType *, register ConnectionType *, register RouteStyleType *));
-static bool GatherSubnets (NetListType *, bool, bool);
-static bool CheckShorts (LibraryMenuType *);
+static void DrawShortestRats (NetListType *, void (*)(register ConnectionType *, register ConnectionType *, register RouteStyleType *), GArray *);
+static bool GatherSubnets (NetListType *, bool);
 static void TransferNet (NetListType *, NetType *, NetType *);
 
 /* ---------------------------------------------------------------------------
@@ -122,6 +124,185 @@ ParseConnection (char *InString, char *ElementName, char *PinNum)
     }
 }
 
+/*!
+ * \brief Fill in a connection to a pad.
+ */
+static void
+PadConnection (ElementType *element, PadType *pad, ConnectionType *conn)
+{
+  conn->type = PAD_TYPE;
+  conn->ptr1 = element;
+  conn->ptr2 = pad;
+  conn->group = TEST_FLAG (ONSOLDERFLAG, pad) ? bottom_group : top_group;
+
+  if (TEST_FLAG (EDGE2FLAG, pad))
+    {
+      conn->X = pad->Point2.X;
+      conn->Y = pad->Point2.Y;
+    }
+  else
+    {
+      conn->X = pad->Point1.X;
+      conn->Y = pad->Point1.Y;
+    }
+}
+
+/*!
+ * \brief Fill in a connection to a pin.
+ */
+static void
+PinConnection (ElementType *element, PinType *pin, ConnectionType *conn)
+{
+  conn->type = PIN_TYPE;
+  conn->ptr1 = element;
+  conn->ptr2 = pin;
+  conn->group = bottom_group;        /* any layer will do */
+  conn->X = pin->X;
+  conn->Y = pin->Y;
+}
+
+/*!
+ * \brief A pad or pin of the terminal index.
+ */
+typedef struct
+{
+  const char *name; /*!< Name on PCB of the element. */
+  const char *number; /*!< Pad or pin number. */
+  int type; /*!< PAD_TYPE or PIN_TYPE. */
+  ElementType *element;
+  void *ptr; /*!< The pad or pin. */
+} TerminalType;
+
+/*!
+ * \brief Pads and pins by element name and number, see
+ * BuildTerminalIndex().
+ */
+static GHashTable *terminal_index = NULL;
+
+static guint
+terminal_hash (gconstpointer key)
+{
+  const TerminalType *t = key;
+
+  return g_str_hash (t->name) * 31 + g_str_hash (t->number);
+}
+
+static gboolean
+terminal_equal (gconstpointer a, gconstpointer b)
+{
+  const TerminalType *ta = a, *tb = b;
+
+  return strcmp (ta->name, tb->name) == 0
+    && strcmp (ta->number, tb->number) == 0;
+}
+
+static void
+AddTerminal (ElementType *element, int type, void *ptr, const char *number)
+{
+  TerminalType *t = g_new (TerminalType, 1);
+  GPtrArray *list;
+
+  t->name = element->Name[1].TextString;
+  t->number = number;
+  t->type = type;
+  t->element = element;
+  t->ptr = ptr;
+
+  if ((list = g_hash_table_lookup (terminal_index, t)) == NULL)
+    {
+      list = g_ptr_array_new_with_free_func (g_free);
+      g_hash_table_insert (terminal_index, t, list);
+    }
+  g_ptr_array_add (list, t);
+}
+
+/*!
+ * \brief Index the pads and pins of the board for FindPad().
+ *
+ * Without it every netlist node looks up its element by name and then
+ * walks the pads and pins of the element, which makes processing a
+ * large netlist quadratic.
+ *
+ * The index holds what the linear search finds: only the first element
+ * of a name, its pads before its pins, and no holes.  It has to be freed
+ * with FreeTerminalIndex() before the board changes.
+ */
+static void
+BuildTerminalIndex (void)
+{
+  GHashTable *names = g_hash_table_new (g_str_hash, g_str_equal);
+  GList *i;
+
+  terminal_index = g_hash_table_new_full (terminal_hash, terminal_equal,
+                                          NULL,
+                                          (GDestroyNotify) g_ptr_array_unref);
+
+  ELEMENT_LOOP (PCB->Data);
+  {
+    char *name = element->Name[1].TextString;
+
+    if (name == NULL || g_hash_table_lookup (names, name) != NULL)
+      continue;
+    g_hash_table_insert (names, name, element);
+
+    for (i = element->Pad; i != NULL; i = g_list_next (i))
+      {
+        PadType *pad = i->data;
+
+        if (pad->Number)
+          AddTerminal (element, PAD_TYPE, pad, pad->Number);
+      }
+    for (i = element->Pin; i != NULL; i = g_list_next (i))
+      {
+        PinType *pin = i->data;
+
+        if (!TEST_FLAG (HOLEFLAG, pin) && pin->Number)
+          AddTerminal (element, PIN_TYPE, pin, pin->Number);
+      }
+  }
+  END_LOOP;
+
+  g_hash_table_destroy (names);
+}
+
+static void
+FreeTerminalIndex (void)
+{
+  if (terminal_index)
+    g_hash_table_destroy (terminal_index);
+  terminal_index = NULL;
+}
+
+/*!
+ * \brief Find a pad through the terminal index.
+ */
+static bool
+FindIndexedPad (char *ElementName, char *PinNum, ConnectionType * conn,
+                bool Same)
+{
+  TerminalType key, *t;
+  GPtrArray *list;
+  guint i;
+
+  key.name = ElementName;
+  key.number = PinNum;
+  if ((list = g_hash_table_lookup (terminal_index, &key)) == NULL)
+    return false;
+
+  for (i = 0; i < list->len; i++)
+    {
+      t = g_ptr_array_index (list, i);
+      if (Same && TEST_FLAG (DRCFLAG, (AnyObjectType *) t->ptr))
+        continue;
+      if (t->type == PAD_TYPE)
+        PadConnection (t->element, t->ptr, conn);
+      else
+        PinConnection (t->element, t->ptr, conn);
+      return true;
+    }
+  return false;
+}
+
 /*!
  * \brief Find a particular pad from an element name and pin number.
  */
@@ -131,6 +312,9 @@ FindPad (char *ElementName, char *PinNum, ConnectionType * conn, bool Same)
   ElementType *element;
   GList *i;
 
+  if (terminal_index)
+    return FindIndexedPad (ElementName, PinNum, conn, Same);
+
   if ((element = SearchElementByName (PCB->Data, ElementName)) == NULL)
     return false;
 
@@ -141,21 +325,7 @@ FindPad (char *ElementName, char *PinNum, ConnectionType * conn, bool Same)
       if (NSTRCMP (PinNum, pad->Number) == 0 &&
           (!Same || !TEST_FLAG (DRCFLAG, pad)))
         {
-          conn->type = PAD_TYPE;
-          conn->ptr1 = element;
-          conn->ptr2 = pad;
-          conn->group = TEST_FLAG (ONSOLDERFLAG, pad) ? bottom_group : top_group;
-
-          if (TEST_FLAG (EDGE2FLAG, pad))
-            {
-              conn->X = pad->Point2.X;
-              conn->Y = pad->Point2.Y;
-            }
-          else
-            {
-              conn->X = pad->Point1.X;
-              conn->Y = pad->Point1.Y;
-            }
+          PadConnection (element, pad, conn);
           return true;
         }
     }
@@ -168,12 +338,7 @@ FindPad (char *ElementName, char *PinNum, ConnectionType * conn, bool Same)
           pin->Number && NSTRCMP (PinNum, pin->Number) == 0 &&
           (!Same || !TEST_FLAG (DRCFLAG, pin)))
         {
-          conn->type = PIN_TYPE;
-          conn->ptr1 = element;
-          conn->ptr2 = pin;
-          conn->group = bottom_group;        /* any layer will do */
-          conn->X = pin->X;
-          conn->Y = pin->Y;
+          PinConnection (element, pin, conn);
           return true;
         }
     }
@@ -256,6 +421,7 @@ ProcNetlist (LibraryType *net_menu)
 	CLEAR_FLAG (DRCFLAG, pad);
       }
       ENDALL_LOOP;
+      BuildTerminalIndex ();
       MENU_LOOP (net_menu);
       {
 	if (menu->Name[0] == '*' || menu->flag == 0)
@@ -323,6 +489,7 @@ ProcNetlist (LibraryType *net_menu)
 	END_LOOP;
       }
       END_LOOP;
+      FreeTerminalIndex ();
     }
   /* clear all visit marks */
   ALLPIN_LOOP (PCB->Data);
@@ -363,89 +530,261 @@ TransferNet (NetListType *Netl, NetType *SourceNet, NetType *DestNet)
   memset (&Netl->Net[Netl->NetN], 0, sizeof (NetType));
 }
 
+/* ---------------------------------------------------------------------------
+ * connected components for GatherSubnets
+ */
+
+/*!
+ * \brief An object of a connected component.
+ */
+typedef struct
+{
+  int type;
+  void *ptr1, *ptr2;
+} SubnetObjectType;
+
+typedef struct
+{
+  GArray *points; /*!< Lines, polygons and vias, in that order. */
+  GArray *terminals; /*!< Pins, then pads. */
+  void *net; /*!< Netlist net of the first terminal that has one. */
+  bool mixed; /*!< Terminals of another net than net. */
+  bool unnetted; /*!< Terminals in no net. */
+} SubnetComponentType;
+
+/*!
+ * \brief A component is shorted if it joins terminals of several nets,
+ * or terminals of a net with ones that are in no net.
+ */
+#define SUBNET_SHORTED(c) ((c)->mixed || ((c)->net && (c)->unnetted))
+
+/*!
+ * \brief Component label + 1 of every copper object, by pointer, see
+ * BuildSubnetLabels().
+ */
+static GHashTable *subnet_labels = NULL;
+/*!< SubnetComponentType by label, NULL for labels with nothing in them. */
+static GPtrArray *subnet_components = NULL;
+
+static void
+AddSubnetLabel (int type, void *ptr1, void *ptr2, int label, void *user_data)
+{
+  g_hash_table_insert (subnet_labels, ptr2, GINT_TO_POINTER (label + 1));
+}
+
+static int
+SubnetLabel (void *ptr2)
+{
+  return GPOINTER_TO_INT (g_hash_table_lookup (subnet_labels, ptr2)) - 1;
+}
+
+static SubnetComponentType *
+SubnetComponent (int label)
+{
+  if (label < 0 || label >= (int) subnet_components->len)
+    return NULL;
+  return (SubnetComponentType *) g_ptr_array_index (subnet_components, label);
+}
+
+static void
+AddComponentObject (bool terminal, int type, void *ptr1, void *ptr2)
+{
+  int label = SubnetLabel (ptr2);
+  SubnetComponentType *c;
+  SubnetObjectType obj;
+  void *spare;
+
+  if (label < 0)
+    return;
+  if (label >= (int) subnet_components->len)
+    g_ptr_array_set_size (subnet_components, label + 1);
+  c = SubnetComponent (label);
+  if (c == NULL)
+    {
+      c = g_new (SubnetComponentType, 1);
+      c->points = g_array_new (FALSE, FALSE, sizeof (SubnetObjectType));
+      c->terminals = g_array_new (FALSE, FALSE, sizeof (SubnetObjectType));
+      c->net = NULL;
+      c->mixed = c->unnetted = false;
+      g_ptr_array_index (subnet_components, label) = c;
+    }
+  obj.type = type;
+  obj.ptr1 = ptr1;
+  obj.ptr2 = ptr2;
+  g_array_append_val (terminal ? c->terminals : c->points, obj);
+  if (!terminal)
+    return;
+
+  /* ProcNetlist() has set the net of every terminal in the netlist */
+  spare = type == PIN_TYPE ? ((PinType *) ptr2)->Spare
+			   : ((PadType *) ptr2)->Spare;
+  if (spare == NULL)
+    c->unnetted = true;
+  else if (c->net == NULL)
+    c->net = spare;
+  else if (spare != c->net)
+    c->mixed = true;
+}
+
+/*!
+ * \brief Label the connected components of the board for
+ * GatherSubnets().
+ *
+ * One LabelAllConnections() pass replaces a flag reset and a lookup per
+ * subnet.  The objects of every component are then listed in board
+ * order, so a subnet gets its attachment points, and its shorts are
+ * found, without walking the board again.
+ *
+ * Rat lines added after this are not followed.
+ */
+static void
+BuildSubnetLabels (bool AndRats)
+{
+  subnet_labels = g_hash_table_new (g_direct_hash, g_direct_equal);
+  subnet_components = g_ptr_array_new ();
+  LabelAllConnections (AndRats, AddSubnetLabel, NULL);
+
+  ALLLINE_LOOP (PCB->Data);
+  {
+    AddComponentObject (false, LINE_TYPE, layer, line);
+  }
+  ENDALL_LOOP;
+  ALLPOLYGON_LOOP (PCB->Data);
+  {
+    AddComponentObject (false, POLYGON_TYPE, layer, polygon);
+  }
+  ENDALL_LOOP;
+  VIA_LOOP (PCB->Data);
+  {
+    AddComponentObject (false, VIA_TYPE, via, via);
+  }
+  END_LOOP;
+  ALLPIN_LOOP (PCB->Data);
+  {
+    AddComponentObject (true, PIN_TYPE, element, pin);
+  }
+  ENDALL_LOOP;
+  ALLPAD_LOOP (PCB->Data);
+  {
+    AddComponentObject (true, PAD_TYPE, element, pad);
+  }
+  ENDALL_LOOP;
+}
+
+static void
+FreeSubnetLabels (void)
+{
+  SubnetComponentType *c;
+  guint i;
+
+  for (i = 0; i < subnet_components->len; i++)
+    if ((c = g_ptr_array_index (subnet_components, i)) != NULL)
+      {
+	g_array_free (c->points, TRUE);
+	g_array_free (c->terminals, TRUE);
+	g_free (c);
+      }
+  g_ptr_array_free (subnet_components, TRUE);
+  g_hash_table_destroy (subnet_labels);
+  subnet_components = NULL;
+  subnet_labels = NULL;
+}
+
+/*!
+ * \brief Warn about the pins and pads of a subnet's component that are
+ * not in the subnet's net.
+ *
+ * The nets of the terminals of every component are compared while the
+ * components are built, so a component without a short costs nothing
+ * here.
+ *
+ * \param net the subnet, holding all the pins and pads of its net in the
+ * component.
+ */
 static bool
-CheckShorts (LibraryMenuType *theNet)
+CheckShorts (LibraryMenuType *theNet, NetType *net,
+	     SubnetComponentType *component)
 {
   bool newone, warn = false;
-  PointerListType *generic = (PointerListType *)calloc (1, sizeof (PointerListType));
+  PointerListType *generic;
+  GHashTable *own;
+  SubnetObjectType *obj;
+  ElementType *element;
+  AnyObjectType *terminal;
+  void *spare;
+  char *number;
+  guint i;
+  void **menu;
+
+  if (!SUBNET_SHORTED (component))
+    return false;
+
+  generic = (PointerListType *)calloc (1, sizeof (PointerListType));
+  own = g_hash_table_new (g_direct_hash, g_direct_equal);
   /* the first connection was starting point so
    * the menu is always non-null
    */
-  void **menu = GetPointerMemory (generic);
-
+  menu = GetPointerMemory (generic);
   *menu = theNet;
-  ALLPIN_LOOP (PCB->Data);
+  CONNECTION_LOOP (net);
   {
-    if (TEST_FLAG (DRCFLAG, pin))
-      {
-	warn = true;
-	if (!pin->Spare)
-	  {
-	    Message (_("Warning! Net \"%s\" is shorted to %s pin %s\n"),
-		     &theNet->Name[2],
-		     UNKNOWN (NAMEONPCB_NAME (element)),
-		     UNKNOWN (pin->Number));
-	    SET_FLAG (WARNFLAG, pin);
-	    continue;
-	  }
-	newone = true;
-	POINTER_LOOP (generic);
+    g_hash_table_add (own, connection->ptr2);
+  }
+  END_LOOP;
+
+  for (i = 0; i < component->terminals->len; i++)
+    {
+      obj = &g_array_index (component->terminals, SubnetObjectType, i);
+      if (g_hash_table_contains (own, obj->ptr2))
+	continue;
+      element = (ElementType *) obj->ptr1;
+      terminal = (AnyObjectType *) obj->ptr2;
+      if (obj->type == PIN_TYPE)
 	{
-	  if (*ptr == pin->Spare)
-	    {
-	      newone = false;
-	      break;
-	    }
+	  spare = ((PinType *) terminal)->Spare;
+	  number = ((PinType *) terminal)->Number;
 	}
-	END_LOOP;
-	if (newone)
-	  {
-	    menu = GetPointerMemory (generic);
-	    *menu = pin->Spare;
-	    Message (_("Warning! Net \"%s\" is shorted to net \"%s\"\n"),
+      else
+	{
+	  spare = ((PadType *) terminal)->Spare;
+	  number = ((PadType *) terminal)->Number;
+	}
+
+      warn = true;
+      if (!spare)
+	{
+	  if (obj->type == PIN_TYPE)
+	    Message (_("Warning! Net \"%s\" is shorted to %s pin %s\n"),
 		     &theNet->Name[2],
-		     &((LibraryMenuType *) (pin->Spare))->Name[2]);
-	    SET_FLAG (WARNFLAG, pin);
-	  }
-      }
-  }
-  ENDALL_LOOP;
-  ALLPAD_LOOP (PCB->Data);
-  {
-    if (TEST_FLAG (DRCFLAG, pad))
-      {
-	warn = true;
-	if (!pad->Spare)
-	  {
+		     UNKNOWN (NAMEONPCB_NAME (element)), UNKNOWN (number));
+	  else
 	    Message (_("Warning! Net \"%s\" is shorted  to %s pad %s\n"),
 		     &theNet->Name[2],
-		     UNKNOWN (NAMEONPCB_NAME (element)),
-		     UNKNOWN (pad->Number));
-	    SET_FLAG (WARNFLAG, pad);
-	    continue;
-	  }
-	newone = true;
-	POINTER_LOOP (generic);
-	{
-	  if (*ptr == pad->Spare)
-	    {
-	      newone = false;
-	      break;
-	    }
+		     UNKNOWN (NAMEONPCB_NAME (element)), UNKNOWN (number));
+	  SET_FLAG (WARNFLAG, terminal);
+	  continue;
 	}
-	END_LOOP;
-	if (newone)
+      newone = true;
+      POINTER_LOOP (generic);
+      {
+	if (*ptr == spare)
 	  {
-	    menu = GetPointerMemory (generic);
-	    *menu = pad->Spare;
-	    Message (_("Warning! Net \"%s\" is shorted to net \"%s\"\n"),
-		     &theNet->Name[2],
-		     &((LibraryMenuType *) (pad->Spare))->Name[2]);
-	    SET_FLAG (WARNFLAG, pad);
+	    newone = false;
+	    break;
 	  }
       }
-  }
-  ENDALL_LOOP;
+      END_LOOP;
+      if (newone)
+	{
+	  menu = GetPointerMemory (generic);
+	  *menu = spare;
+	  Message (_("Warning! Net \"%s\" is shorted to net \"%s\"\n"),
+		   &theNet->Name[2],
+		   &((LibraryMenuType *) spare)->Name[2]);
+	  SET_FLAG (WARNFLAG, terminal);
+	}
+    }
+  g_hash_table_destroy (own);
   FreePointerListMemory (generic);
   free (generic);
   return (warn);
@@ -459,110 +798,271 @@ CheckShorts (LibraryMenuType *theNet)
  * Initially the netlist has each connection in its own individual net
  * afterwards there can be many fewer nets with multiple connections
  * each.
+ *
+ * The connections are compared by the labels of BuildSubnetLabels(),
+ * which must have been called.
  */
 static bool
-GatherSubnets (NetListType *Netl, bool NoWarn, bool AndRats)
+GatherSubnets (NetListType *Netl, bool NoWarn)
 {
   NetType *a, *b;
   ConnectionType *conn;
+  SubnetComponentType *component;
+  SubnetObjectType *obj;
+  LayerType *layer;
+  LineType *line;
+  PolygonType *polygon;
+  PinType *via;
   Cardinal m, n;
+  guint i;
+  int label;
   bool Warned = false;
 
   for (m = 0; Netl->NetN > 0 && m < Netl->NetN; m++)
     {
       a = &Netl->Net[m];
-      ClearFlagOnAllObjects (DRCFLAG, false);
-      RatFindHook (a->Connection[0].type, a->Connection[0].ptr1,
-                   a->Connection[0].ptr2, a->Connection[0].ptr2,
-                   false, DRCFLAG, AndRats);
-      /* now anybody connected to the first point has DRCFLAG set */
-      /* so move those to this subnet */
-      CLEAR_FLAG (DRCFLAG, (PinType *) a->Connection[0].ptr2);
-      for (n = m + 1; n < Netl->NetN; n++)
+      label = SubnetLabel (a->Connection[0].ptr2);
+      /* move anybody connected to the first point to this subnet */
+      for (n = m + 1; label >= 0 && n < Netl->NetN; n++)
 	{
 	  b = &Netl->Net[n];
 	  /* There can be only one connection in net b */
-	  if (TEST_FLAG (DRCFLAG, (PinType *) b->Connection[0].ptr2))
+	  if (SubnetLabel (b->Connection[0].ptr2) == label)
 	    {
-	      CLEAR_FLAG (DRCFLAG, (PinType *) b->Connection[0].ptr2);
 	      TransferNet (Netl, b, a);
 	      /* back up since new subnet is now at old index */
 	      n--;
 	    }
 	}
+      component = SubnetComponent (label);
+      if (component == NULL)
+	continue;
       /* now add other possible attachment points to the subnet */
       /* e.g. line end-points and vias */
       /* don't add non-manhattan lines, the auto-router can't route to them */
-      ALLLINE_LOOP (PCB->Data);
-      {
-	if (TEST_FLAG (DRCFLAG, line))
-	  {
-	    conn = GetConnectionMemory (a);
-	    conn->X = line->Point1.X;
-	    conn->Y = line->Point1.Y;
-	    conn->type = LINE_TYPE;
-	    conn->ptr1 = layer;
-	    conn->ptr2 = line;
-	    conn->group = GetLayerGroupNumberByPointer (layer);
-	    conn->menu = NULL;	/* agnostic view of where it belongs */
-	    conn = GetConnectionMemory (a);
-	    conn->X = line->Point2.X;
-	    conn->Y = line->Point2.Y;
-	    conn->type = LINE_TYPE;
-	    conn->ptr1 = layer;
-	    conn->ptr2 = line;
-	    conn->group = GetLayerGroupNumberByPointer (layer);
-	    conn->menu = NULL;
-	  }
-      }
-      ENDALL_LOOP;
-      /* add polygons so the auto-router can see them as targets */
-      ALLPOLYGON_LOOP (PCB->Data);
-      {
-	if (TEST_FLAG (DRCFLAG, polygon))
-	  {
-	    conn = GetConnectionMemory (a);
-	    /* make point on a vertex */
-	    conn->X = polygon->Clipped->contours->head.point[0];
-	    conn->Y = polygon->Clipped->contours->head.point[1];
-	    conn->type = POLYGON_TYPE;
-	    conn->ptr1 = layer;
-	    conn->ptr2 = polygon;
-	    conn->group = GetLayerGroupNumberByPointer (layer);
-	    conn->menu = NULL;	/* agnostic view of where it belongs */
-	  }
-      }
-      ENDALL_LOOP;
-      VIA_LOOP (PCB->Data);
-      {
-	if (TEST_FLAG (DRCFLAG, via))
-	  {
-	    conn = GetConnectionMemory (a);
-	    conn->X = via->X;
-	    conn->Y = via->Y;
-	    conn->type = VIA_TYPE;
-	    conn->ptr1 = via;
-	    conn->ptr2 = via;
-	    conn->group = bottom_group;
-	  }
-      }
-      END_LOOP;
+      for (i = 0; i < component->points->len; i++)
+	{
+	  obj = &g_array_index (component->points, SubnetObjectType, i);
+	  switch (obj->type)
+	    {
+	    case LINE_TYPE:
+	      layer = (LayerType *) obj->ptr1;
+	      line = (LineType *) obj->ptr2;
+	      conn = GetConnectionMemory (a);
+	      conn->X = line->Point1.X;
+	      conn->Y = line->Point1.Y;
+	      conn->type = LINE_TYPE;
+	      conn->ptr1 = layer;
+	      conn->ptr2 = line;
+	      conn->group = GetLayerGroupNumberByPointer (layer);
+	      conn->menu = NULL;	/* agnostic view of where it belongs */
+	      conn = GetConnectionMemory (a);
+	      conn->X = line->Point2.X;
+	      conn->Y = line->Point2.Y;
+	      conn->type = LINE_TYPE;
+	      conn->ptr1 = layer;
+	      conn->ptr2 = line;
+	      conn->group = GetLayerGroupNumberByPointer (layer);
+	      conn->menu = NULL;
+	      break;
+
+	    case POLYGON_TYPE:
+	      /* add polygons so the auto-router can see them as targets */
+	      layer = (LayerType *) obj->ptr1;
+	      polygon = (PolygonType *) obj->ptr2;
+	      conn = GetConnectionMemory (a);
+	      /* make point on a vertex */
+	      conn->X = polygon->Clipped->contours->head.point[0];
+	      conn->Y = polygon->Clipped->contours->head.point[1];
+	      conn->type = POLYGON_TYPE;
+	      conn->ptr1 = layer;
+	      conn->ptr2 = polygon;
+	      conn->group = GetLayerGroupNumberByPointer (layer);
+	      conn->menu = NULL;	/* agnostic view of where it belongs */
+	      break;
+
+	    case VIA_TYPE:
+	      via = (PinType *) obj->ptr2;
+	      conn = GetConnectionMemory (a);
+	      conn->X = via->X;
+	      conn->Y = via->Y;
+	      conn->type = VIA_TYPE;
+	      conn->ptr1 = via;
+	      conn->ptr2 = via;
+	      conn->group = bottom_group;
+	      break;
+	    }
+	}
       if (!NoWarn)
-	Warned |= CheckShorts (a->Connection[0].menu);
+	Warned |= CheckShorts (a->Connection[0].menu, a, component);
     }
-  ClearFlagOnAllObjects (DRCFLAG, false);
   return (Warned);
 }
 
+/* ---------------------------------------------------------------------------
+ * State of the rats nest kept up to date by AddChangedRats().
+ */
+
+/*!< IDs of the objects changed since the last AddChangedRats(). */
+static GHashTable *rats_changed_ids = NULL;
+/*!< The next AddChangedRats() does all nets. */
+static bool rats_changed_all = true;
+/*!< Set while AddChangedRats() runs, its rats aren't edits. */
+static bool rats_updating = false;
+/*!< Board of the last AddChangedRats(). */
+static PCBType *rats_pcb = NULL;
+/*!< Net name of each copper object and rat, by ID, as it was at the
+ * last AddChangedRats().  The names are interned. */
+static GHashTable *rats_object_nets = NULL;
+/*!< IDs of the elements with pins in a net at that time. */
+static GHashTable *rats_elements = NULL;
+
 /*!
- * \brief Draw a rat net (tree) having the shortest lines.
+ * \brief Note that the object with this ID changed.
  *
- * This also frees the subnet memory as they are consumed.
+ * Called by the undo system for every operation it records, undoes or
+ * redoes.  Rat lines, flags and names don't change what is connected.
+ */
+void
+RatsNoteChange (long int ID, int Kind, int Type)
+{
+  if (rats_updating || rats_changed_all || Kind == RATLINE_TYPE
+      || Type == UNDO_FLAG || Type == UNDO_CHANGENAME)
+    return;
+  if (rats_changed_ids == NULL)
+    rats_changed_ids = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_hash_table_add (rats_changed_ids, GINT_TO_POINTER (ID));
+}
+
+/*!
+ * \brief Note a change that the next AddChangedRats() can't limit to
+ * some nets, such as a new netlist.
+ */
+void
+RatsNoteChangeAll (void)
+{
+  if (!rats_updating)
+    rats_changed_all = true;
+}
+
+/*!
+ * \brief A rat line found by DrawShortestRats(), not created yet.
+ */
+typedef struct
+{
+  Coord X1, Y1, X2, Y2;
+  Cardinal group1, group2;
+  bool via;			/*!< The rat ends over a polygon. */
+  guint net;			/*!< Index of its net in the nets done. */
+} PendingRatType;
+
+/*!
+ * \brief The closest pair of points found between the Net[0] blob and
+ * one other blob.
  *
- * \note The \c Netl we are passed is NOT the main netlist - it's the
- * connectivity for ONE net.
- * It represents the CURRENT connectivity state for the net, with each
- * Netl->Net[N] representing one copper-connected subset of the net.
+ * The points are kept as indexes, because the connections of Net[0]
+ * move when it grows.
+ */
+typedef struct
+{
+  float distance;
+  Cardinal blob;	/*!< Index of the point in Net[0]. */
+  Cardinal other;	/*!< Index of the point in the other blob. */
+  bool swapped;		/*!< The first point of the rat is the other one. */
+  bool found;
+} RatPairType;
+
+/*!
+ * \brief Compare the pair of conn1 in Net[0] and conn2 in another blob
+ * with the best pair found for that blob.
+ *
+ * Connections over polygons go to the polygons at distance 0 (ie assume
+ * the user wants a via to a plane, not a daisy chain).  Among those an
+ * existing via in the net is further preferred.
+ */
+static void
+ConsiderRatPair (RatPairType *best, NetType *subnet, Cardinal n,
+		 NetType *next, Cardinal m)
+{
+  ConnectionType *conn1 = &subnet->Connection[n];
+  ConnectionType *conn2 = &next->Connection[m];
+  ConnectionType *first, *best_first;
+  RatPairType pair;
+
+  pair.blob = n;
+  pair.other = m;
+  pair.found = true;
+  if (conn1->type == POLYGON_TYPE &&
+      IsPointInPolygonIgnoreHoles (conn2->X, conn2->Y,
+				   (PolygonType *)conn1->ptr2))
+    {
+      pair.distance = 0;
+      pair.swapped = true;
+    }
+  else if (conn2->type == POLYGON_TYPE &&
+	   IsPointInPolygonIgnoreHoles (conn1->X, conn1->Y,
+					(PolygonType *)conn2->ptr2))
+    {
+      pair.distance = 0;
+      pair.swapped = false;
+    }
+  else
+    {
+      pair.distance = SQUARE (conn1->X - conn2->X) +
+		      SQUARE (conn1->Y - conn2->Y);
+      pair.swapped = false;
+    }
+
+  if (best->found)
+    {
+      if (pair.distance > best->distance)
+	return;
+      if (pair.distance == best->distance)
+	{
+	  /* ties keep the pair found first, unless a via takes over */
+	  first = pair.swapped ? conn2 : conn1;
+	  best_first = best->swapped ? &next->Connection[best->other]
+				     : &subnet->Connection[best->blob];
+	  if (pair.distance != 0 || first->type != VIA_TYPE ||
+	      best_first->type == VIA_TYPE)
+	    return;
+	}
+    }
+  *best = pair;
+}
+
+/*!
+ * \brief Compare the points of Net[0] from index first on with those of
+ * every other blob, updating the best pair of each blob.
+ */
+static void
+UpdateRatPairs (NetListType *Netl, RatPairType *best, Cardinal first)
+{
+  NetType *subnet = &Netl->Net[0], *next;
+  Cardinal n, m, j;
+
+  for (j = 1; j < Netl->NetN; j++)
+    {
+      next = &Netl->Net[j];
+      for (n = first; n < subnet->ConnectionN; n++)
+	for (m = 0; m < next->ConnectionN; m++)
+	  ConsiderRatPair (&best[j], subnet, n, next, m);
+    }
+}
+
+/*!
+ * \brief Draw a rat net (tree) having the shortest lines.
+ *
+ * This also frees the subnet memory as they are consumed.
+ *
+ * The rats are passed to funcp if there is one, else they are appended
+ * to rats for CreatePendingRats().  Without funcp nothing but Netl is
+ * changed, so the nets can be done in any process.
+ *
+ * \note The \c Netl we are passed is NOT the main netlist - it's the
+ * connectivity for ONE net.
+ * It represents the CURRENT connectivity state for the net, with each
+ * Netl->Net[N] representing one copper-connected subset of the net.
  *
  * Everything inside the NetList Netl should be connected together.
  *
@@ -575,6 +1075,12 @@ GatherSubnets (NetListType *Netl, bool NoWarn, bool AndRats)
  * This loop finds the closest vertex pairs between each blob and draws
  * rats that merge the blobs until there's just one big blob.
  *
+ * The blobs are merged into Net[0] one at a time (Prim's algorithm).
+ * The closest pair between Net[0] and every other blob is remembered,
+ * so when a blob is merged only its own points are compared with the
+ * rest of the net.  The whole net then costs one pass over all pairs of
+ * points instead of one pass per rat.
+ *
  * Just to clarify, with some examples:
  *
  * Each \c Netl is one full net from a netlist, like from gnetlist.
@@ -588,179 +1094,386 @@ GatherSubnets (NetListType *Netl, bool NoWarn, bool AndRats)
  * A fully routed design would have one Net[N] with all the pins
  * (for that net) in it.
  */
-static bool
-DrawShortestRats (NetListType *Netl, void (*funcp) (register ConnectionType *, register ConnectionType *, register RouteStyleType *))
+static void
+DrawShortestRats (NetListType *Netl, void (*funcp) (register ConnectionType *, register ConnectionType *, register RouteStyleType *), GArray *rats)
 {
-  RatType *line;
-  register float distance, temp;
-  register ConnectionType *conn1, *conn2, *firstpoint, *secondpoint;
-  PolygonType *polygon;
-  bool changed = false;
-  bool havepoints;
-  Cardinal n, m, j;
-  NetType *next, *subnet, *theSubnet = NULL;
+  ConnectionType *firstpoint, *secondpoint;
+  PendingRatType rat;
+  RatPairType *best;
+  Cardinal j, theSubnet, merged;
+  NetType *next, *subnet;
 
   /* This is just a sanity check, to make sure we're passed
    * *something*.
    */
   if (!Netl || Netl->NetN < 1)
-    return false;
+    return;
+
+  best = (RatPairType *)calloc (Netl->NetN, sizeof (RatPairType));
+  UpdateRatPairs (Netl, best, 0);
 
   /*
-   * We keep doing this do/while loop until everything's connected.
+   * We keep doing this loop until everything's connected.
    * I.e. once per rat we add.
    */
-  distance = 0.0;
-  havepoints = true; /* so we run the loop at least once */
-  while (Netl->NetN > 1 && havepoints)
+  subnet = &Netl->Net[0];
+  while (Netl->NetN > 1)
     {
-      /* This is the top of the "find one rat" logic.  */
-      havepoints = false;
-      firstpoint = secondpoint = NULL;
-
-      /* Test Net[0] vs Net[N] for N=1..max.  Find the shortest
-	 distance between any two points in different blobs.  */
-      subnet = &Netl->Net[0];
+      /* Find the blob with the shortest distance to Net[0] */
+      theSubnet = 0;
       for (j = 1; j < Netl->NetN; j++)
+	if (best[j].found &&
+	    (!theSubnet || best[j].distance < best[theSubnet].distance))
+	  theSubnet = j;
+
+      /* the blobs left have no points */
+      if (!theSubnet)
+	break;
+
+      next = &Netl->Net[theSubnet];
+      firstpoint = &subnet->Connection[best[theSubnet].blob];
+      secondpoint = &next->Connection[best[theSubnet].other];
+      if (best[theSubnet].swapped)
 	{
-	  /*
-	   * Scan between Net[0] blob (subnet) and Net[N] blob (next).
-	   * Note the shortest distance we find.
-	   */
-	  next = &Netl->Net[j];
-	  for (n = subnet->ConnectionN - 1; n != -1; n--)
-	    {
-	      conn1 = &subnet->Connection[n];
-	      for (m = next->ConnectionN - 1; m != -1; m--)
-		{
-		  conn2 = &next->Connection[m];
-		  /*
-		   * At this point, conn1 and conn2 are two pins in
-		   * different blobs of the same net.  See how far
-		   * apart they are, and if they're "closer" than what
-		   * we already have.
-		   */
-
-		  /*
-		   * Prefer to connect Connections over polygons to the
-		   * polygons (ie assume the user wants a via to a plane,
-		   * not a daisy chain).  Further prefer to pick an existing
-		   * via in the Net to make that connection.
-		   */
-		  if (conn1->type == POLYGON_TYPE &&
-		      (polygon = (PolygonType *)conn1->ptr2) &&
-		      !(distance == 0 &&
-		        firstpoint && firstpoint->type == VIA_TYPE) &&
-		      IsPointInPolygonIgnoreHoles (conn2->X, conn2->Y, polygon))
-		    {
-		      distance = 0;
-		      firstpoint = conn2;
-		      secondpoint = conn1;
-		      theSubnet = next;
-		      havepoints = true;
-		    }
-		  else if (conn2->type == POLYGON_TYPE &&
-		      (polygon = (PolygonType *)conn2->ptr2) &&
-		      !(distance == 0 &&
-		        firstpoint && firstpoint->type == VIA_TYPE) &&
-		      IsPointInPolygonIgnoreHoles (conn1->X, conn1->Y, polygon))
-		    {
-		      distance = 0;
-		      firstpoint = conn1;
-		      secondpoint = conn2;
-		      theSubnet = next;
-		      havepoints = true;
-		    }
-		  else if ((temp = SQUARE (conn1->X - conn2->X) +
-		       SQUARE (conn1->Y - conn2->Y)) < distance || !firstpoint)
-		    {
-		      distance = temp;
-		      firstpoint = conn1;
-		      secondpoint = conn2;
-		      theSubnet = next;
-		      havepoints = true;
-		    }
-		}
-	    }
+	  firstpoint = secondpoint;
+	  secondpoint = &subnet->Connection[best[theSubnet].blob];
 	}
 
-      /*
-       * If HAVEPOINTS is true, we've found a pair of points in two
-       * separate blobs of the net, and need to connect them together.
-       */
-      if (havepoints)
+      if (funcp)
 	{
-	  if (funcp)
-	    {
-	      (*funcp) (firstpoint, secondpoint, subnet->Style);
-	    }
-	  else
-	    {
-	      /* found the shortest distance subnet, draw the rat */
-	      if ((line = CreateNewRat (PCB->Data,
-					firstpoint->X, firstpoint->Y,
-					secondpoint->X, secondpoint->Y,
-					firstpoint->group, secondpoint->group,
-					Settings.RatThickness,
-					NoFlags ())) != NULL)
-		{
-		  if (distance == 0)
-		    SET_FLAG (VIAFLAG, line);
-		  AddObjectToCreateUndoList (RATLINE_TYPE, line, line, line);
-		  DrawRat (line);
-		  changed = true;
-		}
-	    }
-
-	  /* copy theSubnet into the current subnet */
-	  TransferNet (Netl, theSubnet, subnet);
+	  (*funcp) (firstpoint, secondpoint, subnet->Style);
+	}
+      else
+	{
+	  /* found the shortest distance subnet, keep the rat */
+	  rat.X1 = firstpoint->X;
+	  rat.Y1 = firstpoint->Y;
+	  rat.X2 = secondpoint->X;
+	  rat.Y2 = secondpoint->Y;
+	  rat.group1 = firstpoint->group;
+	  rat.group2 = secondpoint->group;
+	  rat.via = best[theSubnet].distance == 0;
+	  g_array_append_val (rats, rat);
 	}
+
+      /* copy theSubnet into the current subnet, the last blob
+       * takes its place
+       */
+      merged = subnet->ConnectionN;
+      TransferNet (Netl, next, subnet);
+      best[theSubnet] = best[Netl->NetN];
+      UpdateRatPairs (Netl, best, merged);
     }
+  free (best);
 
   /* presently nothing to do with the new subnet */
   /* so we throw it away and free the space */
   FreeNetMemory (&Netl->Net[--(Netl->NetN)]);
-  /* Sadly adding a rat line messes up the sorted arrays in connection finder */
-  /* hace: perhaps not necessarily now that they aren't stored in normal layers */
-  if (changed)
+}
+
+/*!
+ * \brief Create the rat lines found by DrawShortestRats(), in order.
+ *
+ * \param names the interned name of each net done.
+ *
+ * \return true if any rat was added.
+ */
+static bool
+CreatePendingRats (GArray *rats, GPtrArray *names)
+{
+  PendingRatType *rat;
+  RatType *line;
+  bool changed = false;
+  guint i;
+
+  for (i = 0; i < rats->len; i++)
+    {
+      rat = &g_array_index (rats, PendingRatType, i);
+      if ((line = CreateNewRat (PCB->Data, rat->X1, rat->Y1, rat->X2, rat->Y2,
+				rat->group1, rat->group2,
+				Settings.RatThickness, NoFlags ())) != NULL)
+	{
+	  if (rat->via)
+	    SET_FLAG (VIAFLAG, line);
+	  if (rats_updating)
+	    g_hash_table_insert (rats_object_nets, GINT_TO_POINTER (line->ID),
+				 g_ptr_array_index (names, rat->net));
+	  AddObjectToCreateUndoList (RATLINE_TYPE, line, line, line);
+	  DrawRat (line);
+	  changed = true;
+	}
+    }
+  return changed;
+}
+
+/*!
+ * \brief Find the rats of nets first .. last - 1, consuming them.
+ */
+static void
+ShortestRatsOfNets (GPtrArray *nets, guint first, guint last, GArray *rats)
+{
+  guint i, n;
+
+  for (i = first; i < last; i++)
     {
-      FreeConnectionLookupMemory ();
-      InitConnectionLookup ();
+      n = rats->len;
+      DrawShortestRats ((NetListType *)g_ptr_array_index (nets, i), NULL,
+			rats);
+      for (; n < rats->len; n++)
+	g_array_index (rats, PendingRatType, n).net = i;
     }
-  return (changed);
 }
 
+/*!
+ * \brief The nets of the rats workers, cut into runs, and the rats found.
+ */
+typedef struct
+{
+  GPtrArray *nets;
+  guint *bounds;		/*!< Run i has nets bounds[i] .. bounds[i + 1] - 1. */
+  GArray *rats;
+} RatsRunsType;
 
 /*!
- * \brief AddAllRats puts the rats nest into the layout from the loaded
- * netlist.
+ * \brief Body of a rats worker process.
  *
- * If SelectedOnly is true, it will only draw rats to selected pins and
- * pads.
+ * Finds the rats of the nets of run \p part and writes their number and
+ * the rats to fp.
  */
-bool
-AddAllRats (bool SelectedOnly, void (*funcp) (register ConnectionType *, register ConnectionType *, register RouteStyleType *))
+static int
+RatsWorker (int part, FILE *fp, void *data)
 {
-  NetListType *Nets, *Wantlist;
-  NetType *lonesome;
-  ConnectionType *onepin;
-  bool changed, Warned = false;
+  RatsRunsType *runs = (RatsRunsType *) data;
+  GArray *rats = g_array_new (FALSE, FALSE, sizeof (PendingRatType));
+  bool ok;
 
-  /* the netlist library has the text form
-   * ProcNetlist fills in the Netlist
-   * structure the way the final routing
-   * is supposed to look
-   */
-  Wantlist = ProcNetlist (&PCB->NetlistLib);
-  if (!Wantlist)
+  ShortestRatsOfNets (runs->nets, runs->bounds[part], runs->bounds[part + 1],
+		      rats);
+  ok = fwrite (&rats->len, sizeof (rats->len), 1, fp) == 1
+       && fwrite (rats->data, sizeof (PendingRatType), rats->len, fp)
+          == rats->len;
+  return ok ? 0 : 1;
+}
+
+/*!
+ * \brief Append the rats written by a worker to the rats, or find those
+ * of its run here.
+ *
+ * \return false, leaving the rats as they were, if they can't all be
+ * read.
+ */
+static bool
+ReadRatsWorker (int part, FILE *fp, void *data)
+{
+  RatsRunsType *runs = (RatsRunsType *) data;
+  GArray *rats = runs->rats;
+  guint count, old = rats->len;
+
+  if (fp == NULL)
     {
-      Message (_("Can't add rat lines because no netlist is loaded.\n"));
-      return (false);
+      ShortestRatsOfNets (runs->nets, runs->bounds[part],
+			  runs->bounds[part + 1], rats);
+      return true;
+    }
+  if (fread (&count, sizeof (count), 1, fp) != 1)
+    return false;
+  g_array_set_size (rats, old + count);
+  if (fread (&g_array_index (rats, PendingRatType, old),
+	     sizeof (PendingRatType), count, fp) != count)
+    {
+      g_array_set_size (rats, old);
+      return false;
+    }
+  return true;
+}
+
+/*!
+ * \brief Cost of the rats of a net, which goes with the square of its
+ * points.
+ */
+static double
+ShortestRatsCost (NetListType *Netl)
+{
+  double points = 0;
+  Cardinal n;
+
+  for (n = 0; n < Netl->NetN; n++)
+    points += Netl->Net[n].ConnectionN;
+  return points * points;
+}
+
+/*!
+ * \brief Find the rats of the nets in jobs worker processes.
+ *
+ * The nets are cut into runs of about the same cost, one per worker,
+ * and the rats of the runs are appended in netlist order, so the rats
+ * are the same as those found in one process.  A run whose worker fails
+ * is done here.
+ */
+static void
+ShortestRatsParallel (GPtrArray *nets, int jobs, GArray *rats)
+{
+  RatsRunsType runs;
+  double total = 0, cost = 0;
+  int i;
+  guint n;
+
+  runs.nets = nets;
+  runs.bounds = g_new (guint, jobs + 1);
+  runs.rats = rats;
+  for (n = 0; n < nets->len; n++)
+    total += ShortestRatsCost ((NetListType *)g_ptr_array_index (nets, n));
+  runs.bounds[0] = 0;
+  for (i = 1, n = 0; i < jobs; i++)
+    {
+      while (n < nets->len && cost < total * i / jobs)
+	cost += ShortestRatsCost ((NetListType *)g_ptr_array_index (nets, n++));
+      runs.bounds[i] = n;
+    }
+  runs.bounds[jobs] = nets->len;
+
+  pcb_fork_workers (jobs, jobs, -1, true, RatsWorker, ReadRatsWorker, &runs);
+  g_free (runs.bounds);
+}
+
+/*!
+ * \brief Find the rats of the nets and free them.
+ *
+ * With --rat-jobs above 1 the nets are shared out to worker processes.
+ */
+static GArray *
+ShortestRats (GPtrArray *nets)
+{
+  GArray *rats = g_array_new (FALSE, FALSE, sizeof (PendingRatType));
+  NetListType *Netl;
+  guint n;
+  int jobs = MIN (Settings.RatJobs, (int) nets->len);
+
+  if (jobs > 1)
+    ShortestRatsParallel (nets, jobs, rats);
+  else
+    ShortestRatsOfNets (nets, 0, nets->len, rats);
+
+  for (n = 0; n < nets->len; n++)
+    {
+      Netl = (NetListType *)g_ptr_array_index (nets, n);
+      FreeNetListMemory (Netl);
+      free (Netl);
     }
-  changed = false;
+  return rats;
+}
+
+
+/*!
+ * \brief Map the labels of subnet_labels to the names of the nets of
+ * their pins and pads.
+ *
+ * ProcNetlist() must have set the nets of the terminals.  A component
+ * with terminals of several nets, a short, gets the first one.
+ */
+static GHashTable *
+LabelNetNames (void)
+{
+  GHashTable *names = g_hash_table_new (g_direct_hash, g_direct_equal);
+  LibraryMenuType *menu;
+  gpointer label;
+
+  ALLPIN_LOOP (PCB->Data);
+  {
+    menu = (LibraryMenuType *) pin->Spare;
+    label = g_hash_table_lookup (subnet_labels, pin);
+    if (menu && label && !g_hash_table_contains (names, label))
+      g_hash_table_insert (names, label,
+			   (gpointer) g_intern_string (menu->Name + 2));
+  }
+  ENDALL_LOOP;
+  ALLPAD_LOOP (PCB->Data);
+  {
+    menu = (LibraryMenuType *) pad->Spare;
+    label = g_hash_table_lookup (subnet_labels, pad);
+    if (menu && label && !g_hash_table_contains (names, label))
+      g_hash_table_insert (names, label,
+			   (gpointer) g_intern_string (menu->Name + 2));
+  }
+  ENDALL_LOOP;
+  return names;
+}
+
+/*!
+ * \brief Remember the net of every copper object and rat for the next
+ * AddChangedRats().
+ */
+static void
+RecordRatsNets (void)
+{
+  GHashTable *names = LabelNetNames ();
+  GHashTableIter iter;
+  gpointer key, value, name;
+
+  g_hash_table_remove_all (rats_object_nets);
+  g_hash_table_remove_all (rats_elements);
+
+  g_hash_table_iter_init (&iter, subnet_labels);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    if ((name = g_hash_table_lookup (names, value)) != NULL)
+      g_hash_table_insert (rats_object_nets,
+			   GINT_TO_POINTER (((AnyObjectType *) key)->ID), name);
+
+  ALLPIN_LOOP (PCB->Data);
+  {
+    if (pin->Spare)
+      g_hash_table_add (rats_elements, GINT_TO_POINTER (element->ID));
+  }
+  ENDALL_LOOP;
+  ALLPAD_LOOP (PCB->Data);
+  {
+    if (pad->Spare)
+      g_hash_table_add (rats_elements, GINT_TO_POINTER (element->ID));
+  }
+  ENDALL_LOOP;
+  g_hash_table_destroy (names);
+}
+
+/*!
+ * \brief Interned name of a net of the netlist.
+ */
+static const char *
+RatsNetName (NetType *net)
+{
+  if (net->ConnectionN == 0 || net->Connection[0].menu == NULL)
+    return NULL;
+  return g_intern_string (net->Connection[0].menu->Name + 2);
+}
+
+/*!
+ * \brief Add the rats of the nets of Wantlist.
+ *
+ * \param only interned names of the nets to do, NULL for all.
+ *
+ * \param Warned set if a short or a missing pin was found.
+ *
+ * \return true if any rat was added.
+ */
+static bool
+AddRatsOfNets (NetListType *Wantlist, bool SelectedOnly, GHashTable *only,
+	       void (*funcp) (register ConnectionType *, register ConnectionType *, register RouteStyleType *),
+	       bool *Warned)
+{
+  NetListType *Nets;
+  NetType *lonesome;
+  ConnectionType *onepin;
+  GPtrArray *pending, *names;
+  GArray *rats;
+  bool changed;
+
+  BuildSubnetLabels (true);
+  if (rats_updating)
+    RecordRatsNets ();
   /* initialize finding engine */
   InitConnectionLookup ();
   Nets = (NetListType *)calloc (1, sizeof (NetListType));
+  pending = g_ptr_array_new ();
+  names = g_ptr_array_new ();
   /* now we build another netlist (Nets) for each
    * net in Wantlist that shows how it actually looks now,
    * then fill in any missing connections with rat lines.
@@ -771,10 +1484,14 @@ AddAllRats (bool SelectedOnly, void (*funcp) (register ConnectionType *, registe
    * will have only one net entry.
    * Note that DrawShortestRats consumes all nets
    * from Nets, so *Nets is empty after the
-   * DrawShortestRats call
+   * DrawShortestRats call.  Without funcp the
+   * nets are kept until all of them are gathered,
+   * and their rats are found at once
    */
   NET_LOOP (Wantlist);
   {
+    if (only && !g_hash_table_contains (only, RatsNetName (net)))
+      continue;
     CONNECTION_LOOP (net);
     {
       if (!SelectedOnly
@@ -787,14 +1504,54 @@ AddAllRats (bool SelectedOnly, void (*funcp) (register ConnectionType *, registe
 	}
     }
     END_LOOP;
-    Warned |= GatherSubnets (Nets, SelectedOnly, true);
-    if (Nets->NetN > 0)
-      changed |= DrawShortestRats (Nets, funcp);
+    *Warned |= GatherSubnets (Nets, SelectedOnly);
+    if (Nets->NetN > 0 && funcp)
+      DrawShortestRats (Nets, funcp, NULL);
+    else if (Nets->NetN > 0)
+      {
+	g_ptr_array_add (pending, Nets);
+	g_ptr_array_add (names, (gpointer) RatsNetName (net));
+	Nets = (NetListType *)calloc (1, sizeof (NetListType));
+      }
   }
   END_LOOP;
   FreeNetListMemory (Nets);
   free (Nets);
+  rats = ShortestRats (pending);
+  changed = CreatePendingRats (rats, names);
+  g_array_free (rats, TRUE);
+  g_ptr_array_free (pending, TRUE);
+  g_ptr_array_free (names, TRUE);
   FreeConnectionLookupMemory ();
+  FreeSubnetLabels ();
+  return changed;
+}
+
+/*!
+ * \brief AddAllRats puts the rats nest into the layout from the loaded
+ * netlist.
+ *
+ * If SelectedOnly is true, it will only draw rats to selected pins and
+ * pads.
+ */
+bool
+AddAllRats (bool SelectedOnly, void (*funcp) (register ConnectionType *, register ConnectionType *, register RouteStyleType *))
+{
+  NetListType *Wantlist;
+  bool changed, Warned = false;
+
+  /* the netlist library has the text form
+   * ProcNetlist fills in the Netlist
+   * structure the way the final routing
+   * is supposed to look
+   */
+  Wantlist = ProcNetlist (&PCB->NetlistLib);
+  if (!Wantlist)
+    {
+      Message (_("Can't add rat lines because no netlist is loaded.\n"));
+      return (false);
+    }
+  changed = AddRatsOfNets (Wantlist, SelectedOnly, NULL, funcp, &Warned);
   if (funcp)
     return (true);
 
@@ -827,6 +1584,216 @@ AddAllRats (bool SelectedOnly, void (*funcp) (register ConnectionType *, registe
   return (false);
 }
 
+/*!
+ * \brief Add the nets of a changed object, before and after the change,
+ * to nets.
+ *
+ * \param changed the object changed with its element.
+ */
+static void
+NoteChangedRatsObject (GHashTable *nets, GHashTable *found,
+		       GHashTable *names, bool changed, long int ID, void *ptr)
+{
+  gpointer name;
+
+  if (!changed && !g_hash_table_contains (rats_changed_ids,
+					  GINT_TO_POINTER (ID)))
+    return;
+  g_hash_table_add (found, GINT_TO_POINTER (ID));
+  if ((name = g_hash_table_lookup (rats_object_nets,
+				   GINT_TO_POINTER (ID))) != NULL)
+    g_hash_table_add (nets, name);
+  if ((name = g_hash_table_lookup (names,
+				   g_hash_table_lookup (subnet_labels, ptr)))
+      != NULL)
+    g_hash_table_add (nets, name);
+}
+
+/*!
+ * \brief Find the nets touched by the changes since the last
+ * AddChangedRats().
+ *
+ * A changed object is in the net it was in at the last update, and in
+ * the net its copper connects it to now.  A removed object is only
+ * in the first.
+ *
+ * \return interned net names, NULL if all nets must be done because an
+ * element with nets was removed.
+ */
+static GHashTable *
+ChangedRatsNets (void)
+{
+  GHashTable *nets = g_hash_table_new (g_direct_hash, g_direct_equal);
+  GHashTable *found = g_hash_table_new (g_direct_hash, g_direct_equal);
+  GHashTable *names;
+  GHashTableIter iter;
+  gpointer key, name;
+  bool moved;
+
+  if (rats_changed_ids == NULL)
+    rats_changed_ids = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  BuildSubnetLabels (false);
+  names = LabelNetNames ();
+
+  ALLLINE_LOOP (PCB->Data);
+  {
+    NoteChangedRatsObject (nets, found, names, false, line->ID, line);
+  }
+  ENDALL_LOOP;
+  ALLARC_LOOP (PCB->Data);
+  {
+    NoteChangedRatsObject (nets, found, names, false, arc->ID, arc);
+  }
+  ENDALL_LOOP;
+  ALLPOLYGON_LOOP (PCB->Data);
+  {
+    NoteChangedRatsObject (nets, found, names, false, polygon->ID, polygon);
+  }
+  ENDALL_LOOP;
+  VIA_LOOP (PCB->Data);
+  {
+    NoteChangedRatsObject (nets, found, names, false, via->ID, via);
+  }
+  END_LOOP;
+  ELEMENT_LOOP (PCB->Data);
+  {
+    moved = g_hash_table_contains (rats_changed_ids,
+				   GINT_TO_POINTER (element->ID));
+    if (moved)
+      g_hash_table_add (found, GINT_TO_POINTER (element->ID));
+    PIN_LOOP (element);
+    {
+      NoteChangedRatsObject (nets, found, names, moved, pin->ID, pin);
+    }
+    END_LOOP;
+    PAD_LOOP (element);
+    {
+      NoteChangedRatsObject (nets, found, names, moved, pad->ID, pad);
+    }
+    END_LOOP;
+  }
+  END_LOOP;
+
+  /* The objects gone from the board */
+  g_hash_table_iter_init (&iter, rats_changed_ids);
+  while (nets && g_hash_table_iter_next (&iter, &key, NULL))
+    {
+      if (g_hash_table_contains (found, key))
+	continue;
+      if (g_hash_table_contains (rats_elements, key))
+	{
+	  g_hash_table_destroy (nets);
+	  nets = NULL;
+	}
+      else if ((name = g_hash_table_lookup (rats_object_nets, key)) != NULL)
+	g_hash_table_add (nets, name);
+    }
+
+  g_hash_table_destroy (names);
+  g_hash_table_destroy (found);
+  FreeSubnetLabels ();
+  return nets;
+}
+
+/*!
+ * \brief Remove the rat lines of some nets.
+ *
+ * A rat that wasn't there at the last AddChangedRats() belongs to the
+ * net it connects to.
+ *
+ * \param nets interned net names, NULL for all.
+ */
+static bool
+RemoveRatsOfNets (GHashTable *nets)
+{
+  GPtrArray *doomed = g_ptr_array_new ();
+  GHashTable *names;
+  gpointer name;
+  guint i;
+
+  BuildSubnetLabels (true);
+  names = LabelNetNames ();
+  RAT_LOOP (PCB->Data);
+  {
+    name = g_hash_table_lookup (rats_object_nets, GINT_TO_POINTER (line->ID));
+    if (name == NULL)
+      name = g_hash_table_lookup (names,
+				  g_hash_table_lookup (subnet_labels, line));
+    if (nets == NULL || (name && g_hash_table_contains (nets, name)))
+      g_ptr_array_add (doomed, line);
+  }
+  END_LOOP;
+  g_hash_table_destroy (names);
+  FreeSubnetLabels ();
+
+  for (i = 0; i < doomed->len; i++)
+    RemoveObject (RATLINE_TYPE, doomed->pdata[i], doomed->pdata[i],
+		  doomed->pdata[i]);
+  g_ptr_array_free (doomed, TRUE);
+  return i > 0;
+}
+
+/*!
+ * \brief Bring the rats nest up to date with the changes since the last
+ * call.
+ *
+ * Only the nets touched by the changes recorded by the undo system are
+ * done again: their rats are removed and the shortest rats of the nets
+ * are added.  The first call on a board, and one after a change that
+ * can't be traced to some nets, does all nets.
+ *
+ * Flag changes are not followed, so a new thermal is only picked up
+ * with the next change to its net.
+ *
+ * \return true if any rat was removed or added.
+ */
+bool
+AddChangedRats (void)
+{
+  NetListType *Wantlist;
+  GHashTable *nets = NULL;
+  bool changed = false, Warned = false;
+
+  if (rats_updating)
+    return false;
+  if (rats_pcb == PCB && !rats_changed_all
+      && (rats_changed_ids == NULL || g_hash_table_size (rats_changed_ids) == 0))
+    return false;
+  Wantlist = ProcNetlist (&PCB->NetlistLib);
+  if (!Wantlist)
+    return false;
+
+  rats_updating = true;
+  if (rats_object_nets == NULL)
+    {
+      rats_object_nets = g_hash_table_new (g_direct_hash, g_direct_equal);
+      rats_elements = g_hash_table_new (g_direct_hash, g_direct_equal);
+    }
+  else if (rats_pcb == PCB && !rats_changed_all)
+    nets = ChangedRatsNets ();
+
+  if (nets == NULL || g_hash_table_size (nets) > 0)
+    {
+      changed = RemoveRatsOfNets (nets);
+      changed |= AddRatsOfNets (Wantlist, false, nets, NULL, &Warned);
+    }
+
+  if (nets)
+    g_hash_table_destroy (nets);
+  if (rats_changed_ids)
+    g_hash_table_remove_all (rats_changed_ids);
+  rats_changed_all = false;
+  rats_pcb = PCB;
+  rats_updating = false;
+
+  if (Warned || changed)
+    Draw ();
+  if (Warned)
+    Settings.RatWarn = true;
+  return changed;
+}
+
 /*!
  * \todo This is copied in large part from AddAllRats above; for
  * maintainability, AddAllRats probably wants to be tweaked to use this
@@ -851,6 +1818,8 @@ CollectSubnets (bool SelectedOnly)
       Message (_("Can't add rat lines because no netlist is loaded.\n"));
       return result;
     }
+  /* Note that AndRats is *FALSE* here! */
+  BuildSubnetLabels (false);
   /* initialize finding engine */
   InitConnectionLookup ();
   /* now we build another netlist (Nets) for each
@@ -880,11 +1849,11 @@ CollectSubnets (bool SelectedOnly)
 	}
     }
     END_LOOP;
-    /* Note that AndRats is *FALSE* here! */
-    GatherSubnets (Nets, SelectedOnly, false);
+    GatherSubnets (Nets, SelectedOnly);
   }
   END_LOOP;
   FreeConnectionLookupMemory ();
+  FreeSubnetLabels ();
   return result;
 }
 
@@ -47,6 +47,9 @@ RatType * AddNet (void);
 char *ConnectionName (int, void *, void *);
 
 bool AddAllRats (bool, void (*)(register ConnectionType *, register ConnectionType *, register RouteStyleType *));
+bool AddChangedRats (void);
+void RatsNoteChange (long int, int, int);
+void RatsNoteChangeAll (void);
 bool SeekPad (LibraryEntryType *, ConnectionType *, bool);
 
 NetListType * ProcNetlist (LibraryType *);
@@ -129,13 +129,18 @@ RemovePCB (PCBType *Ptr)
 static void *
 DestroyVia (PinType *Via)
 {
+  unsigned long held = IDIndexHold ();
+
+  IDIndexRemove (DestroyTarget, held, VIA_TYPE, Via);
   r_delete_entry (DestroyTarget->via_tree, (BoxType *) Via);
   free (Via->Name);
 
-  DestroyTarget->Via = g_list_remove (DestroyTarget->Via, Via);
+  DestroyTarget->Via = RemoveFromObjectList (DestroyTarget->Via,
+                                             &DestroyTarget->ViaTail, Via);
   DestroyTarget->ViaN --;
 
-  g_slice_free (PinType, Via);
+  POOL_FREE (PinType, Via);
+  IDIndexRelease (held, DestroyTarget, NULL);
 
   return NULL;
 }
@@ -146,13 +151,17 @@ DestroyVia (PinType *Via)
 static void *
 DestroyLine (LayerType *Layer, LineType *Line)
 {
+  unsigned long held = IDIndexHold ();
+
+  IDIndexRemove (DestroyTarget, held, LINE_TYPE, Line);
   r_delete_entry (Layer->line_tree, (BoxType *) Line);
   free (Line->Number);
 
-  Layer->Line = g_list_remove (Layer->Line, Line);
+  Layer->Line = RemoveFromObjectList (Layer->Line, &Layer->LineTail, Line);
   Layer->LineN --;
 
-  g_slice_free (LineType, Line);
+  POOL_FREE (LineType, Line);
+  IDIndexRelease (held, DestroyTarget, NULL);
 
   return NULL;
 }
@@ -163,12 +172,16 @@ DestroyLine (LayerType *Layer, LineType *Line)
 static void *
 DestroyArc (LayerType *Layer, ArcType *Arc)
 {
+  unsigned long held = IDIndexHold ();
+
+  IDIndexRemove (DestroyTarget, held, ARC_TYPE, Arc);
   r_delete_entry (Layer->arc_tree, (BoxType *) Arc);
 
-  Layer->Arc = g_list_remove (Layer->Arc, Arc);
+  Layer->Arc = RemoveFromObjectList (Layer->Arc, &Layer->ArcTail, Arc);
   Layer->ArcN --;
 
-  g_slice_free (ArcType, Arc);
+  POOL_FREE (ArcType, Arc);
+  IDIndexRelease (held, DestroyTarget, NULL);
 
   return NULL;
 }
@@ -179,13 +192,18 @@ DestroyArc (LayerType *Layer, ArcType *Arc)
 static void *
 DestroyPolygon (LayerType *Layer, PolygonType *Polygon)
 {
+  unsigned long held = IDIndexHold ();
+
+  IDIndexRemove (DestroyTarget, held, POLYGON_TYPE, Polygon);
   r_delete_entry (Layer->polygon_tree, (BoxType *) Polygon);
   FreePolygonMemory (Polygon);
 
-  Layer->Polygon = g_list_remove (Layer->Polygon, Polygon);
+  Layer->Polygon = RemoveFromObjectList (Layer->Polygon,
+                                         &Layer->PolygonTail, Polygon);
   Layer->PolygonN --;
 
-  g_slice_free (PolygonType, Polygon);
+  POOL_FREE (PolygonType, Polygon);
+  IDIndexRelease (held, DestroyTarget, NULL);
 
   return NULL;
 }
@@ -218,6 +236,7 @@ DestroyPolygonPoint (LayerType *Layer,
   for (i = point_idx; i < Polygon->PointN - 1; i++)
     Polygon->Points[i] = Polygon->Points[i + 1];
   Polygon->PointN--;
+  IDIndexInvalidate ();
 
   /* Shift down indices of any holes */
   for (i = 0; i < Polygon->HoleIndexN; i++)
@@ -236,13 +255,17 @@ DestroyPolygonPoint (LayerType *Layer,
 static void *
 DestroyText (LayerType *Layer, TextType *Text)
 {
+  unsigned long held = IDIndexHold ();
+
+  IDIndexRemove (DestroyTarget, held, TEXT_TYPE, Text);
   free (Text->TextString);
   r_delete_entry (Layer->text_tree, (BoxType *) Text);
 
-  Layer->Text = g_list_remove (Layer->Text, Text);
+  Layer->Text = RemoveFromObjectList (Layer->Text, &Layer->TextTail, Text);
   Layer->TextN --;
 
-  g_slice_free (TextType, Text);
+  POOL_FREE (TextType, Text);
+  IDIndexRelease (held, DestroyTarget, NULL);
 
   return NULL;
 }
@@ -253,6 +276,9 @@ DestroyText (LayerType *Layer, TextType *Text)
 static void *
 DestroyElement (ElementType *Element)
 {
+  unsigned long held = IDIndexHold ();
+
+  IDIndexRemove (DestroyTarget, held, ELEMENT_TYPE, Element);
   if (DestroyTarget->element_tree)
     r_delete_entry (DestroyTarget->element_tree, (BoxType *) Element);
   if (DestroyTarget->pin_tree)
@@ -279,10 +305,12 @@ DestroyElement (ElementType *Element)
   END_LOOP;
   FreeElementMemory (Element);
 
-  DestroyTarget->Element = g_list_remove (DestroyTarget->Element, Element);
+  DestroyTarget->Element = RemoveFromObjectList (DestroyTarget->Element,
+                                                 &DestroyTarget->ElementTail, Element);
   DestroyTarget->ElementN --;
 
-  g_slice_free (ElementType, Element);
+  POOL_FREE (ElementType, Element);
+  IDIndexRelease (held, DestroyTarget, NULL);
 
   return NULL;
 }
@@ -293,13 +321,18 @@ DestroyElement (ElementType *Element)
 static void *
 DestroyRat (RatType *Rat)
 {
+  unsigned long held = IDIndexHold ();
+
+  IDIndexRemove (DestroyTarget, held, RATLINE_TYPE, Rat);
   if (DestroyTarget->rat_tree)
     r_delete_entry (DestroyTarget->rat_tree, &Rat->BoundingBox);
 
-  DestroyTarget->Rat = g_list_remove (DestroyTarget->Rat, Rat);
+  DestroyTarget->Rat = RemoveFromObjectList (DestroyTarget->Rat,
+                                             &DestroyTarget->RatTail, Rat);
   DestroyTarget->RatN --;
 
-  g_slice_free (RatType, Rat);
+  POOL_FREE (RatType, Rat);
+  IDIndexRelease (held, DestroyTarget, NULL);
 
   return NULL;
 }
@@ -500,6 +533,7 @@ RemovePolygonContour (LayerType *Layer,
   for (i = contour_start; i < Polygon->PointN - contour_points; i++)
     Polygon->Points[i] = Polygon->Points[i + contour_points];
   Polygon->PointN -= contour_points;
+  IDIndexInvalidate ();
 
   /* remove hole from list and shift down remaining indices */
   for (i = contour; i < Polygon->HoleIndexN; i++)
@@ -550,6 +584,7 @@ RemovePolygonPoint (LayerType *Layer,
   for (i = point_idx; i < Polygon->PointN - 1; i++)
     Polygon->Points[i] = Polygon->Points[i + 1];
   Polygon->PointN--;
+  IDIndexInvalidate ();
 
   /* Shift down indices of any holes */
   for (i = 0; i < Polygon->HoleIndexN; i++)
@@ -580,239 +580,169 @@ ReportFoundPins (int argc, char **argv, Coord x, Coord y)
 }
 
 /*!
- * \brief Assumes that we start with a blank connection state,
- * e.g. ClearFlagOnAllObjects() has been run.
- *
- * Does not add its own changes to the undo system
+ * \brief Return the net label of the copper object at x, y, as
+ * LookupConnection() would start from it, or -1.
  */
-static double
-XYtoNetLength (Coord x, Coord y, int *found)
+static int
+NetLabelAt (Coord x, Coord y)
 {
-  double length;
+  void *ptr1, *ptr2, *ptr3;
+  int type;
 
-  length = 0;
-  *found = 0;
+  type = SearchObjectByLocation (LOOKUP_FIRST, &ptr1, &ptr2, &ptr3, x, y,
+                                 PCB->Grid);
+  if (type == NO_TYPE)
+    type = SearchObjectByLocation (LOOKUP_MORE, &ptr1, &ptr2, &ptr3, x, y,
+                                   PCB->Grid);
+  if (type == NO_TYPE)
+    return -1;
 
-  /* NB: The third argument here, 'false' ensures LookupConnection
-   *     does not add its changes to the undo system.
-   */
-  LookupConnection (x, y, false, PCB->Grid, FOUNDFLAG, true);
+  /* highlight the net in the netlist window, if it is open */
+  if (type & (PIN_TYPE | PAD_TYPE))
+    hid_actionl ("NetlistShow", ConnectionName (type, ptr1, ptr2), NULL);
 
-  ALLLINE_LOOP (PCB->Data);
-  {
-    if (TEST_FLAG (FOUNDFLAG, line))
-      {
-	int dx, dy;
-	dx = line->Point1.X - line->Point2.X;
-	dy = line->Point1.Y - line->Point2.Y;
-	length += hypot (dx, dy);
-	*found = 1;
-      }
-  }
-  ENDALL_LOOP;
+  return ConnectionIndexNetLabel (ptr2);
+}
 
-  ALLARC_LOOP (PCB->Data);
+/*!
+ * \brief Return the name of the netlist net of a net label, or NULL.
+ *
+ * That is the net of the first pin or pad of the net in the netlist.
+ */
+static char *
+NetLabelName (int label)
+{
+  GHashTable *nodes = g_hash_table_new (g_str_hash, g_str_equal);
+  char *netname = NULL;
+  int ni, nei;
+
+  for (ni = PCB->NetlistLib.MenuN - 1; ni >= 0; ni--)
+    for (nei = PCB->NetlistLib.Menu[ni].EntryN - 1; nei >= 0; nei--)
+      g_hash_table_insert (nodes,
+                           PCB->NetlistLib.Menu[ni].Entry[nei].ListEntry,
+                           PCB->NetlistLib.Menu[ni].Name + 2);
+
+  ELEMENT_LOOP (PCB->Data);
   {
-    if (TEST_FLAG (FOUNDFLAG, arc))
-      {
-	double l;
-	/* FIXME: we assume width==height here */
-	l = M_PI * 2*arc->Width * abs(arc->Delta)/360.0;
-	length += l;
-	*found = 1;
-      }
+    PIN_LOOP (element);
+    {
+      if (ConnectionIndexNetLabel (pin) == label && pin->Number
+          && (netname = g_hash_table_lookup
+                (nodes, ConnectionName (PIN_TYPE, element, pin))) != NULL)
+        goto got_net_name;
+    }
+    END_LOOP;
+    PAD_LOOP (element);
+    {
+      if (ConnectionIndexNetLabel (pad) == label && pad->Number
+          && (netname = g_hash_table_lookup
+                (nodes, ConnectionName (PAD_TYPE, element, pad))) != NULL)
+        goto got_net_name;
+    }
+    END_LOOP;
   }
-  ENDALL_LOOP;
+  END_LOOP;
+
+got_net_name:
+  g_hash_table_destroy (nodes);
+  return netname;
+}
 
-  return length;
+static void
+LogNetStats (const char *netname, const char *units_name,
+             const ConnectionNetStats *stats)
+{
+  char buf[50];
+
+  pcb_snprintf (buf, sizeof (buf), _("%$m*"), units_name,
+                (Coord) stats->length);
+  if (netname)
+    gui->log (ngettext ("Net \"%s\" length: %s, %d via\n",
+                        "Net \"%s\" length: %s, %d vias\n", stats->vias),
+              netname, buf, stats->vias);
+  else
+    gui->log (ngettext ("Net length: %s, %d via\n",
+                        "Net length: %s, %d vias\n", stats->vias),
+              buf, stats->vias);
 }
 
+/*!
+ * \brief Report the length of every net of the netlist.
+ *
+ * The nets come from one labelling of the board, the persistent net
+ * index, so this takes a pass over the board rather than one for each
+ * net.
+ */
 static int
 ReportAllNetLengths (int argc, char **argv, Coord x, Coord y)
 {
+  GHashTable *terminals;
+  const char *units_name = argc < 1 ? Settings.grid_unit->suffix : argv[0];
+  void *terminal;
   int ni;
-  int found;
-
-  /* Reset all connection flags and save an undo-state to get back
-   * to the state the board was in when we started this function.
-   *
-   * After this, we don't add any changes to the undo system, but
-   * ensure we get back to a point where we can Undo() our changes
-   * by resetting the connections with ClearFlagOnAllObjects() before
-   * calling Undo() at the end of the procedure.
-   */
-  ClearFlagOnAllObjects (FOUNDFLAG, true);
-  IncrementUndoSerialNumber ();
+
+  /* the pin or pad of each node, the last pad of the name there is */
+  terminals = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  ELEMENT_LOOP (PCB->Data);
+  {
+    char *es = element->Name[NAMEONPCB_INDEX].TextString;
+
+    if (es == NULL)
+      continue;
+    PIN_LOOP (element);
+    {
+      if (pin->Number)
+        g_hash_table_replace (terminals,
+                              g_strdup_printf ("%s-%s", es, pin->Number),
+                              pin);
+    }
+    END_LOOP;
+    PAD_LOOP (element);
+    {
+      if (pad->Number)
+        g_hash_table_replace (terminals,
+                              g_strdup_printf ("%s-%s", es, pad->Number),
+                              pad);
+    }
+    END_LOOP;
+  }
+  END_LOOP;
 
   for (ni = 0; ni < PCB->NetlistLib.MenuN; ni++)
     {
       char *netname = PCB->NetlistLib.Menu[ni].Name + 2;
       char *ename = PCB->NetlistLib.Menu[ni].Entry[0].ListEntry;
-      char *pname;
-      bool got_one = 0;
-
-      ename = strdup (ename);
-      pname = strchr (ename, '-');
-      if (! pname)
-	{
-	  free (ename);
-	  continue;
-	}
-      *pname++ = 0;
-
-      ELEMENT_LOOP (PCB->Data);
-      {
-	char *es = element->Name[NAMEONPCB_INDEX].TextString;
-	if (es && strcmp (es, ename) == 0)
-	  {
-	    PIN_LOOP (element);
-	    {
-	      if (strcmp (pin->Number, pname) == 0)
-		{
-		  x = pin->X;
-		  y = pin->Y;
-		  got_one = 1;
-                  break;
-		}
-	    }
-	    END_LOOP;
-	    PAD_LOOP (element);
-	    {
-	      if (strcmp (pad->Number, pname) == 0)
-		{
-		  x = (pad->Point1.X + pad->Point2.X) / 2;
-		  y = (pad->Point1.Y + pad->Point2.Y) / 2;
-		  got_one = 1;
-                  break;
-		}
-	    }
-	    END_LOOP;
-	  }
-      }
-      END_LOOP;
-
-      if (got_one)
-        {
-          char buf[50];
-          const char *units_name = argv[0];
-          Coord length;
-
-          if (argc < 1)
-            units_name = Settings.grid_unit->suffix;
-
-          length = XYtoNetLength (x, y, &found);
-
-          /* Reset connectors for the next lookup */
-          ClearFlagOnAllObjects (FOUNDFLAG, false);
-
-          pcb_snprintf(buf, sizeof (buf), _("%$m*"), units_name, length);
-          gui->log(_("Net \"%s\" length: %s\n"), netname, buf);
-        }
+      const ConnectionNetStats *stats;
+
+      terminal = g_hash_table_lookup (terminals, ename);
+      if (terminal == NULL)
+        continue;
+      stats = ConnectionIndexNetStats (ConnectionIndexNetLabel (terminal));
+      if (stats != NULL)
+        LogNetStats (netname, units_name, stats);
     }
 
-  ClearFlagOnAllObjects (FOUNDFLAG, false);
-  Undo (true);
+  g_hash_table_destroy (terminals);
   return 0;
 }
 
 static int
 ReportNetLength (int argc, char **argv, Coord x, Coord y)
 {
-  Coord length = 0;
-  char *netname = 0;
-  int found = 0;
+  const ConnectionNetStats *stats;
+  int label;
 
   gui->get_coords (_("Click on a connection"), &x, &y);
 
-  /* Reset all connection flags and save an undo-state to get back
-   * to the state the board was in when we started this function.
-   *
-   * After this, we don't add any changes to the undo system, but
-   * ensure we get back to a point where we can Undo() our changes
-   * by resetting the connections with ClearFlagOnAllObjects() before
-   * calling Undo() at the end of the procedure.
-   */
-  ClearFlagOnAllObjects (FOUNDFLAG, true);
-  IncrementUndoSerialNumber ();
-
-  length = XYtoNetLength (x, y, &found);
-
-  if (!found)
+  label = NetLabelAt (x, y);
+  stats = ConnectionIndexNetStats (label);
+  if (stats == NULL || stats->segments == 0)
     {
-      ClearFlagOnAllObjects (FOUNDFLAG, false);
-      Undo (true);
       gui->log (_("No net under cursor.\n"));
       return 1;
     }
 
-  ELEMENT_LOOP (PCB->Data);
-  {
-    PIN_LOOP (element);
-    {
-      if (TEST_FLAG (FOUNDFLAG, pin))
-	{
-	  int ni, nei;
-	  char *ename = element->Name[NAMEONPCB_INDEX].TextString;
-	  char *pname = pin->Number;
-	  char *n;
-
-	  if (ename && pname)
-	    {
-	      n = Concat (ename, _("-"), pname, NULL);
-	      for (ni = 0; ni < PCB->NetlistLib.MenuN; ni++)
-		for (nei = 0; nei < PCB->NetlistLib.Menu[ni].EntryN; nei++)
-		  {
-		    if (strcmp (PCB->NetlistLib.Menu[ni].Entry[nei].ListEntry, n) == 0)
-		      {
-			netname = PCB->NetlistLib.Menu[ni].Name + 2;
-			goto got_net_name; /* four for loops deep */
-		      }
-		  }
-	    }
-	}
-    }
-    END_LOOP;
-    PAD_LOOP (element);
-    {
-      if (TEST_FLAG (FOUNDFLAG, pad))
-	{
-	  int ni, nei;
-	  char *ename = element->Name[NAMEONPCB_INDEX].TextString;
-	  char *pname = pad->Number;
-	  char *n;
-
-	  if (ename && pname)
-	    {
-	      n = Concat (ename, _("-"), pname, NULL);
-	      for (ni = 0; ni < PCB->NetlistLib.MenuN; ni++)
-		for (nei = 0; nei < PCB->NetlistLib.Menu[ni].EntryN; nei++)
-		  {
-		    if (strcmp (PCB->NetlistLib.Menu[ni].Entry[nei].ListEntry, n) == 0)
-		      {
-			netname = PCB->NetlistLib.Menu[ni].Name + 2;
-			goto got_net_name; /* four for loops deep */
-		      }
-		  }
-	    }
-	}
-    }
-    END_LOOP;
-  }
-  END_LOOP;
-
-got_net_name:
-  ClearFlagOnAllObjects (FOUNDFLAG, false);
-  Undo (true);
-
-  {
-    char buf[50];
-    pcb_snprintf(buf, sizeof (buf), _("%$m*"), Settings.grid_unit->suffix, length);
-    if (netname)
-      gui->log (_("Net \"%s\" length: %s\n"), netname, buf);
-    else
-      gui->log (_("Net length: %s\n"), buf);
-  }
-
+  LogNetStats (NetLabelName (label), Settings.grid_unit->suffix, stats);
   return 0;
 }
 
@@ -820,9 +750,7 @@ static int
 ReportNetLengthByName (char *tofind, int x, int y)
 {
   int result;
-  char *netname = 0;
-  Coord length = 0;
-  int found = 0;
+  const ConnectionNetStats *stats;
   int i;
   LibraryMenuType *net;
   ConnectionType conn;
@@ -899,23 +827,11 @@ ReportNetLengthByName (char *tofind, int x, int y)
 	  if (strcasecmp (net->Name + 2, tofind))
 	    continue;
 
-        if (SeekPad (net->Entry, &conn, false))
+        if (SeekPad (net->Entry, &conn, false)
+            && (conn.type == PIN_TYPE || conn.type == PAD_TYPE))
         {
-          switch (conn.type)
-          {
-            case PIN_TYPE:
-              x = ((PinType *) (conn.ptr2))->X;
-              y = ((PinType *) (conn.ptr2))->Y;
-              net_found=1;
-	      break;
-            case PAD_TYPE:
-              x = ((PadType *) (conn.ptr2))->Point1.X;
-              y = ((PadType *) (conn.ptr2))->Point1.Y;
-              net_found=1;
-	      break;
-          }
-	  if (net_found)
-	    break;
+          net_found = 1;
+          break;
         }
     }
 
@@ -930,42 +846,14 @@ ReportNetLengthByName (char *tofind, int x, int y)
     regfree (&elt_pattern);
 #endif
 
-  /* Reset all connection flags and save an undo-state to get back
-   * to the state the board was in when we started.
-   *
-   * After this, we don't add any changes to the undo system, but
-   * ensure we get back to a point where we can Undo() our changes
-   * by resetting the connections with ClearFlagOnAllObjects() before
-   * calling Undo() when we are finished.
-   */
-  ClearFlagOnAllObjects (FOUNDFLAG, true);
-  IncrementUndoSerialNumber ();
-
-  length = XYtoNetLength (x, y, &found);
-  netname = net->Name + 2;
-
-  ClearFlagOnAllObjects (FOUNDFLAG, false);
-  Undo (true);
-
-  if (!found)
+  stats = ConnectionIndexNetStats (ConnectionIndexNetLabel (conn.ptr2));
+  if (stats == NULL || stats->segments == 0)
     {
-      if (net_found)
-        gui->log (_("Net found, but no lines or arcs were flagged.\n"));
-      else
-        gui->log (_("Net not found.\n"));
-
+      gui->log (_("Net found, but no lines or arcs were flagged.\n"));
       return 1;
     }
 
-  {
-    char buf[50];
-    pcb_snprintf(buf, 50, _("%$m*"), Settings.grid_unit->suffix, length);
-    if (netname)
-      gui->log (_("Net \"%s\" length: %s\n"), netname, buf);
-    else
-      gui->log (_("Net length: %s\n"), buf);
-  }
-
+  LogNetStats (net->Name + 2, Settings.grid_unit->suffix, stats);
   return 0;
 }
 
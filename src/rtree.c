@@ -49,9 +49,14 @@
 
 #include <assert.h>
 #include <inttypes.h>
+#include <math.h>
 #include <setjmp.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "heap.h"
 #include "mymem.h"
+#include "profile.h"
 
 #include "rtree.h"
 
@@ -78,6 +83,13 @@
 
 #define DELETE_BY_POINTER
 
+/* NODE_ARENA allocates the nodes of a tree from blocks it owns instead
+ * of one at a time, see alloc_node(), and keeps the boxes of the children
+ * of each node in arrays by coordinate, see fill_kid_boxes().  It is off
+ * unless built with -DNODE_ARENA, as src/benchmark-arena is, which times
+ * it against the plain layout, see bench_rtree() in main-bench.c.
+ */
+
 typedef struct
 {
   const BoxType *bptr;          /* pointer to the box */
@@ -99,7 +111,219 @@ struct rtree_node
     struct rtree_node *kids[M_SIZE + 1];        /* when not leaf */
     Rentry rects[M_SIZE + 1];   /* when leaf */
   } u;
+#ifdef NODE_ARENA
+  struct
+  {
+    Coord X1[M_SIZE + 1], X2[M_SIZE + 1], Y1[M_SIZE + 1], Y2[M_SIZE + 1];
+  } kid_box;                    /* boxes of the kids or rects, see above */
+#endif
+};
+
+#ifdef NODE_ARENA
+/* the first block of a tree holds this many nodes, later ones twice as
+ * many as the one before, up to ARENA_MAX
+ */
+#define ARENA_MIN 4
+#define ARENA_MAX 1024
+
+/*!
+ * \brief A block of nodes owned by one tree.
+ *
+ * The nodes of a tree are handed out from its newest block, so nodes
+ * made together (as by a bulk load or a run of inserts) sit next to
+ * each other in memory.  Released nodes go on a free list, threaded
+ * through their parent pointers, and are all freed with the tree.
+ */
+struct rtree_arena
+{
+  struct rtree_arena *next;     /* the block allocated before this one */
+  struct rtree_node *free;      /* released nodes of the tree */
+  int size, used;               /* nodes in this block, handed out */
+  struct rtree_node nodes[1];
 };
+#endif
+
+/*!
+ * \brief Count of structural changes to the trees of objects, see
+ * r_generation().
+ *
+ * Threads may change private trees inside a shared read section, so it
+ * is only changed atomically.
+ */
+static gint r_generation_counter;
+
+#define NOTE_CHANGE(rtree) \
+  do { if ((rtree)->tracked) g_atomic_int_inc (&r_generation_counter); \
+  } while (0)
+
+/*!
+ * \brief Return a number that changes whenever a tree made by
+ * r_create_data_tree() is created, destroyed or has an entry inserted or
+ * deleted.
+ *
+ * Those are the trees of the objects of a DataType: the board and the
+ * paste buffers.  The scratch trees of the polygon clipper, the
+ * autorouter, the snap index and the like don't count, so building or
+ * searching them doesn't make caches look stale.
+ *
+ * Caches derived from the board geometry can compare it to the value
+ * they were built at to tell whether they may be stale.
+ */
+unsigned long
+r_generation (void)
+{
+  return (guint) g_atomic_int_get (&r_generation_counter);
+}
+
+static int r_defer_section;
+
+static void flush_pending (rtree_t * rtree);
+static void drop_pending (rtree_t * rtree);
+static bool inserts_deferred (void);
+
+/*!
+ * \brief Number of open shared read sections, see r_begin_shared_read().
+ */
+static gint r_shared_readers;
+
+/*!
+ * \brief Count of shared read sections opened while there was none, so
+ * trees made inside the current one can be told apart.
+ */
+static gint r_shared_section;
+
+/*!
+ * \brief Start a section in which rtrees may be searched from several
+ * threads.
+ *
+ * The search functions (r_search(), r_search_pt(), r_search_batch(),
+ * r_search_nearest() and r_region_is_empty()) keep all their state to
+ * themselves and only read the trees, so any number of threads may
+ * search the same or different trees at once, as long as no tree changes
+ * meanwhile.  A callback may still longjmp out of a search run by its
+ * own thread.
+ *
+ * Code handing searches to other threads brackets them with
+ * r_begin_shared_read() and r_end_shared_read().  While a section is
+ * open, destroying, inserting into or deleting from a tree that existed
+ * before it fails an assertion, so a writer racing the readers is caught
+ * in debug builds instead of corrupting a search.  Trees created inside
+ * the section, such as the contour trees of polygons built by a worker,
+ * are private to their thread and may be changed freely.  Sections may
+ * nest.
+ */
+void
+r_begin_shared_read (void)
+{
+  /* a search would put the deferred inserts into their tree */
+  r_flush_inserts ();
+  if (g_atomic_int_add (&r_shared_readers, 1) == 0)
+    g_atomic_int_inc (&r_shared_section);
+}
+
+/*!
+ * \brief End a section started by r_begin_shared_read().
+ */
+void
+r_end_shared_read (void)
+{
+  assert (g_atomic_int_get (&r_shared_readers) > 0);
+  g_atomic_int_add (&r_shared_readers, -1);
+}
+
+#define ASSERT_NOT_SHARED(rtree) \
+  assert (g_atomic_int_get (&r_shared_readers) == 0 \
+          || (rtree)->shared_section == g_atomic_int_get (&r_shared_section))
+
+/*!
+ * \brief Get a zeroed node for rtree.
+ */
+static struct rtree_node *
+alloc_node (rtree_t * rtree)
+{
+#ifdef NODE_ARENA
+  struct rtree_arena *a = rtree->arena;
+  struct rtree_node *node;
+
+  if (a && a->free)
+    {
+      node = a->free;
+      a->free = node->parent;
+      memset (node, 0, sizeof (*node));
+      return node;
+    }
+  if (!a || a->used == a->size)
+    {
+      int size = a ? MIN (2 * a->size, ARENA_MAX) : ARENA_MIN;
+
+      a = (struct rtree_arena *)malloc (sizeof (*a) + (size - 1) *
+                                        sizeof (struct rtree_node));
+      a->next = rtree->arena;
+      a->free = NULL;
+      a->size = size;
+      a->used = 0;
+      rtree->arena = a;
+    }
+  node = &a->nodes[a->used++];
+  memset (node, 0, sizeof (*node));
+  return node;
+#else
+  return (struct rtree_node *)calloc (1, sizeof (struct rtree_node));
+#endif
+}
+
+/*!
+ * \brief Release a node of rtree.
+ */
+static void
+free_node (rtree_t * rtree, struct rtree_node *node)
+{
+#ifdef NODE_ARENA
+  node->parent = rtree->arena->free;
+  rtree->arena->free = node;
+#else
+  free (node);
+#endif
+}
+
+#ifdef NODE_ARENA
+/*!
+ * \brief Copy the boxes of the children or entries of a node into its
+ * kid_box arrays, which __r_search() scans.
+ *
+ * Called wherever the children of a node or their boxes settle after a
+ * change: by adjust_bounds() and sort_node(), and up the path of a leaf
+ * put in by __r_insert_leaf().
+ */
+static void
+fill_kid_boxes (struct rtree_node *node)
+{
+  const BoxType *b;
+  int i;
+
+  for (i = 0; i < M_SIZE + 1; i++)
+    {
+      if (node->flags.is_leaf)
+        {
+          if (!node->u.rects[i].bptr)
+            break;
+          b = &node->u.rects[i].bounds;
+        }
+      else
+        {
+          if (!node->u.kids[i])
+            break;
+          b = &node->u.kids[i]->box;
+        }
+      node->kid_box.X1[i] = b->X1;
+      node->kid_box.X2[i] = b->X2;
+      node->kid_box.Y1[i] = b->Y1;
+      node->kid_box.Y2[i] = b->Y2;
+    }
+}
+#else
+#define fill_kid_boxes(node)
+#endif
 
 #ifndef NDEBUG
 #ifdef SLOW_ASSERTS
@@ -129,6 +353,13 @@ __r_node_is_good (struct rtree_node *node)
             assert (0);
           if (node->box.Y1 > node->box.Y2)
             assert (0);
+#ifdef NODE_ARENA
+          if (node->kid_box.X1[i] != node->u.rects[i].bounds.X1
+              || node->kid_box.X2[i] != node->u.rects[i].bounds.X2
+              || node->kid_box.Y1[i] != node->u.rects[i].bounds.Y1
+              || node->kid_box.Y2[i] != node->u.rects[i].bounds.Y2)
+            assert (0);
+#endif
           /* check that bounds is the same as the pointer */
           if (node->u.rects[i].bounds.X1 != node->u.rects[i].bptr->X1)
             assert (0);
@@ -163,6 +394,13 @@ __r_node_is_good (struct rtree_node *node)
           /* check that once one entry is empty, all the rest are too */
           if (node->u.kids[i] && last)
             assert (0);
+#ifdef NODE_ARENA
+          if (node->kid_box.X1[i] != node->u.kids[i]->box.X1
+              || node->kid_box.X2[i] != node->u.kids[i]->box.X2
+              || node->kid_box.Y1[i] != node->u.kids[i]->box.Y1
+              || node->kid_box.Y2[i] != node->u.kids[i]->box.Y2)
+            assert (0);
+#endif
           /* check that entries are within node bounds */
           if (node->u.kids[i]->box.X1 < node->box.X1)
             assert (0);
@@ -365,9 +603,10 @@ sort_node (struct rtree_node *node)
         }
     }
 #endif
+  fill_kid_boxes (node);
 }
 #else
-#define sort_node(x)
+#define sort_node(x) fill_kid_boxes (x)
 #endif
 
 /*!
@@ -387,7 +626,7 @@ adjust_bounds (struct rtree_node *node)
       for (i = 1; i < M_SIZE + 1; i++)
         {
           if (!node->u.rects[i].bptr)
-            return;
+            break;
           MAKEMIN (node->box.X1, node->u.rects[i].bounds.X1);
           MAKEMAX (node->box.X2, node->u.rects[i].bounds.X2);
           MAKEMIN (node->box.Y1, node->u.rects[i].bounds.Y1);
@@ -400,13 +639,126 @@ adjust_bounds (struct rtree_node *node)
       for (i = 1; i < M_SIZE + 1; i++)
         {
           if (!node->u.kids[i])
-            return;
+            break;
           MAKEMIN (node->box.X1, node->u.kids[i]->box.X1);
           MAKEMAX (node->box.X2, node->u.kids[i]->box.X2);
           MAKEMIN (node->box.Y1, node->u.kids[i]->box.Y1);
           MAKEMAX (node->box.Y2, node->u.kids[i]->box.Y2);
         }
     }
+  fill_kid_boxes (node);
+}
+
+/*!
+ * \brief Compare two box pointers by the X coordinate of the box centers.
+ */
+static int
+cmp_center_x (const void *a, const void *b)
+{
+  const BoxType *ba = *(const BoxType **) a, *bb = *(const BoxType **) b;
+  int64_t ca = (int64_t) ba->X1 + ba->X2, cb = (int64_t) bb->X1 + bb->X2;
+
+  return (ca > cb) - (ca < cb);
+}
+
+/*!
+ * \brief Compare two box pointers by the Y coordinate of the box centers.
+ */
+static int
+cmp_center_y (const void *a, const void *b)
+{
+  const BoxType *ba = *(const BoxType **) a, *bb = *(const BoxType **) b;
+  int64_t ca = (int64_t) ba->Y1 + ba->Y2, cb = (int64_t) bb->Y1 + bb->Y2;
+
+  return (ca > cb) - (ca < cb);
+}
+
+/*!
+ * \brief Put boxes in Sort-Tile-Recursive order.
+ *
+ * The boxes are sorted by X into about sqrt (n / M_SIZE) vertical slices
+ * of whole nodes, and each slice is sorted by Y.  Cutting the result
+ * into runs of M_SIZE then gives nodes that tile the plane with little
+ * overlap.
+ */
+static void
+str_order (const BoxType **boxes, int n)
+{
+  int nodes = (n + M_SIZE - 1) / M_SIZE;
+  int slices = 1, per_slice, i;
+
+  while (slices * slices < nodes)
+    slices++;
+  per_slice = ((nodes + slices - 1) / slices) * M_SIZE;
+
+  qsort (boxes, n, sizeof (*boxes), cmp_center_x);
+  for (i = 0; i < n; i += per_slice)
+    qsort (boxes + i, MIN (per_slice, n - i), sizeof (*boxes), cmp_center_y);
+}
+
+/*!
+ * \brief Pack n > 0 boxes, or nodes of one level, into full nodes.
+ *
+ * The entries are put in STR order and cut into runs of M_SIZE.  The new
+ * nodes take the place of the entries in the array, which works because
+ * a node is a box as far as the ordering is concerned.
+ *
+ * \return the number of nodes.
+ */
+static int
+pack_level (rtree_t * rtree, const BoxType ** level, int n, bool leaf,
+            int manage)
+{
+  struct rtree_node *node;
+  int count = 0, i, j;
+
+  str_order (level, n);
+  for (i = 0; i < n; i += M_SIZE)
+    {
+      node = alloc_node (rtree);
+      node->flags.is_leaf = leaf;
+      for (j = 0; j < M_SIZE && i + j < n; j++)
+        if (leaf)
+          {
+            node->u.rects[j].bptr = level[i + j];
+            node->u.rects[j].bounds = *level[i + j];
+          }
+        else
+          {
+            node->u.kids[j] = (struct rtree_node *) level[i + j];
+            node->u.kids[j]->parent = node;
+          }
+      if (leaf && manage)
+        node->flags.manage = (1 << j) - 1;
+      adjust_bounds (node);
+      /* i >= count * M_SIZE, so this slot has been read already */
+      level[count++] = (const BoxType *) node;
+    }
+  return count;
+}
+
+/*!
+ * \brief Build the nodes of a tree holding N > 0 boxes bottom up.
+ *
+ * Each level is packed into full nodes, which then make up the entries
+ * of the level above, until a single node is left.
+ *
+ * \return the root node.
+ */
+static struct rtree_node *
+bulk_load (rtree_t * rtree, const BoxType * boxlist[], int N, int manage)
+{
+  const BoxType **level = (const BoxType **)malloc (N * sizeof (*level));
+  struct rtree_node *node;
+  int n;
+
+  memcpy (level, boxlist, N * sizeof (*level));
+  n = pack_level (rtree, level, N, true, manage);
+  while (n > 1)
+    n = pack_level (rtree, level, n, false, 0);
+  node = (struct rtree_node *) level[0];
+  free (level);
+  return node;
 }
 
 /*!
@@ -420,6 +772,9 @@ adjust_bounds (struct rtree_node *node)
  * until you've called r_destroy_tree.
  *
  * If you set 'manage' to true, r_destroy_tree will free your boxlist.
+ *
+ * The tree is bulk loaded (see bulk_load()), which is much faster than
+ * inserting the boxes one by one and gives nodes with less overlap.
  */
 rtree_t *
 r_create_tree (const BoxType * boxlist[], int N, int manage)
@@ -430,28 +785,52 @@ r_create_tree (const BoxType * boxlist[], int N, int manage)
 
   assert (N >= 0);
   rtree = (rtree_t *)calloc (1, sizeof (*rtree));
-  /* start with a single empty leaf node */
-  node = (struct rtree_node *)calloc (1, sizeof (*node));
-  node->flags.is_leaf = 1;
-  node->parent = NULL;
-  rtree->root = node;
-  /* simple, just insert all of the boxes! */
+  if (g_atomic_int_get (&r_shared_readers) > 0)
+    rtree->shared_section = g_atomic_int_get (&r_shared_section);
+  if (inserts_deferred ())
+    rtree->defer_section = r_defer_section;
   for (i = 0; i < N; i++)
     {
       assert (boxlist[i]);
-      r_insert_entry (rtree, boxlist[i], manage);
+      assert (boxlist[i]->X1 <= boxlist[i]->X2);
+      assert (boxlist[i]->Y1 <= boxlist[i]->Y2);
     }
+  if (N > 0)
+    node = bulk_load (rtree, boxlist, N, manage);
+  else
+    {
+      /* start with a single empty leaf node */
+      node = alloc_node (rtree);
+      node->flags.is_leaf = 1;
+    }
+  node->parent = NULL;
+  rtree->root = node;
+  rtree->size = N;
 #ifdef SLOW_ASSERTS
   assert (__r_tree_is_good (rtree->root));
 #endif
   return rtree;
 }
 
+/*!
+ * \brief Create an empty rtree for the objects of a DataType, whose
+ * changes count in r_generation().
+ */
+rtree_t *
+r_create_data_tree (void)
+{
+  rtree_t *rtree = r_create_tree (NULL, 0, 0);
+
+  rtree->tracked = true;
+  NOTE_CHANGE (rtree);
+  return rtree;
+}
+
 /*!
  * \brief Destroy an rtree.
  */
 static void
-__r_destroy_tree (struct rtree_node *node)
+__r_destroy_tree (rtree_t * rtree, struct rtree_node *node)
 {
   int i, flag = 1;
 
@@ -469,9 +848,11 @@ __r_destroy_tree (struct rtree_node *node)
       {
         if (!node->u.kids[i])
           break;
-        __r_destroy_tree (node->u.kids[i]);
+        __r_destroy_tree (rtree, node->u.kids[i]);
       }
-  free (node);
+#ifndef NODE_ARENA
+  free_node (rtree, node);
+#endif
 }
 
 /*!
@@ -480,12 +861,64 @@ __r_destroy_tree (struct rtree_node *node)
 void
 r_destroy_tree (rtree_t ** rtree)
 {
+  ASSERT_NOT_SHARED (*rtree);
+  drop_pending (*rtree);
+  NOTE_CHANGE (*rtree);
+  __r_destroy_tree (*rtree, (*rtree)->root);
+#ifdef NODE_ARENA
+  while ((*rtree)->arena)
+    {
+      struct rtree_arena *a = (*rtree)->arena;
 
-  __r_destroy_tree ((*rtree)->root);
+      (*rtree)->arena = a->next;
+      free (a);
+    }
+#endif
   free (*rtree);
   *rtree = NULL;
 }
 
+#ifndef NODE_ARENA
+static size_t
+__r_node_memory (struct rtree_node *node)
+{
+  size_t size = sizeof (*node);
+  int i;
+
+  if (!node->flags.is_leaf)
+    for (i = 0; i < M_SIZE && node->u.kids[i]; i++)
+      size += __r_node_memory (node->u.kids[i]);
+  return size;
+}
+#endif
+
+/*!
+ * \brief Bytes taken by an rtree and its nodes, not counting the boxes
+ * it holds.
+ */
+size_t
+r_memory (rtree_t * rtree)
+{
+  size_t size;
+
+  if (rtree == NULL)
+    return 0;
+  flush_pending (rtree);
+  size = sizeof (*rtree);
+#ifdef NODE_ARENA
+  {
+    struct rtree_arena *a;
+
+    for (a = rtree->arena; a; a = a->next)
+      size += sizeof (*a) + (a->size - 1) * sizeof (struct rtree_node);
+  }
+#else
+  if (rtree->root)
+    size += __r_node_memory (rtree->root);
+#endif
+  return size;
+}
+
 typedef struct
 {
   int (*check_it) (const BoxType * region, void *cl);
@@ -516,6 +949,35 @@ __r_search (struct rtree_node *node, const BoxType * query, r_arg * arg)
    * of building/destroying the stack frame for each bounds that fails
    * to intersect, which is the most common condition.
    */
+#ifdef NODE_ARENA
+  /* the boxes of the kids or rects are scanned from the kid_box arrays,
+   * so the kids themselves are only read when they touch the query */
+  {
+    int seen = 0, i;
+
+    if (node->flags.is_leaf)
+      {
+        for (i = 0; node->u.rects[i].bptr; i++)
+          if (node->kid_box.X1[i] < query->X2
+              && node->kid_box.X2[i] > query->X1
+              && node->kid_box.Y1[i] < query->Y2
+              && node->kid_box.Y2[i] > query->Y1
+              && (!arg->found_it
+                  || arg->found_it (node->u.rects[i].bptr, arg->closure)))
+            seen++;
+        return seen;
+      }
+    for (i = 0; node->u.kids[i]; i++)
+      if (node->kid_box.X1[i] < query->X2
+          && node->kid_box.X2[i] > query->X1
+          && node->kid_box.Y1[i] < query->Y2
+          && node->kid_box.Y2[i] > query->Y1
+          && (!arg->check_it
+              || arg->check_it (&node->u.kids[i]->box, arg->closure)))
+        seen += __r_search (node->u.kids[i], query, arg);
+    return seen;
+  }
+#else
   if (node->flags.is_leaf)
     {
       register int i;
@@ -578,6 +1040,7 @@ __r_search (struct rtree_node *node, const BoxType * query, r_arg * arg)
         }
       return seen;
     }
+#endif
 }
 
 /*!
@@ -608,15 +1071,17 @@ __r_search (struct rtree_node *node, const BoxType * query, r_arg * arg)
  *
  * \return the number of rectangles found.
  */
-int
-r_search (rtree_t * rtree, const BoxType * query,
-          int (*check_region) (const BoxType * region, void *cl),
-          int (*found_rectangle) (const BoxType * box, void *cl), void *cl)
+static int
+r_search_tree (rtree_t * rtree, const BoxType * query,
+               int (*check_region) (const BoxType * region, void *cl),
+               int (*found_rectangle) (const BoxType * box, void *cl),
+               void *cl)
 {
   r_arg arg;
 
   if (!rtree || rtree->size < 1)
     return 0;
+  flush_pending (rtree);
   if (query)
     {
 #ifdef SLOW_ASSERTS
@@ -646,64 +1111,335 @@ r_search (rtree_t * rtree, const BoxType * query,
     }
 }
 
-/*!
- * \brief r_region_is_empty.
- */
-static int
-__r_region_is_empty_rect_in_reg (const BoxType * box, void *cl)
+int
+r_search (rtree_t * rtree, const BoxType * query,
+          int (*check_region) (const BoxType * region, void *cl),
+          int (*found_rectangle) (const BoxType * box, void *cl), void *cl)
 {
-  jmp_buf *envp = (jmp_buf *) cl;
-  longjmp (*envp, 1);           /* found one! */
+  int n;
+
+  PROFILE_BEGIN (PROFILE_RTREE);
+  n = r_search_tree (rtree, query, check_region, found_rectangle, cl);
+  PROFILE_END (PROFILE_RTREE);
+  return n;
 }
 
-/*!
- * \brief Special-purpose searches build upon r_search.
- *
- * \return 0 if there are any rectangles in the given region.
- */
-int
-r_region_is_empty (rtree_t * rtree, const BoxType * region)
+typedef struct
 {
-  jmp_buf env;
-#ifndef NDEBUG
-  int r;
-#endif
+  const BoxType *queries;
+  int n;                        /* number of queries */
+  int (*found_it) (const BoxType * box, int query, void *cl);
+  void *closure;
+} r_batch_arg;
 
-  if (setjmp (env))
-    return 0;
-#ifndef NDEBUG
-  r =
-#endif
-    r_search (rtree, region, NULL, __r_region_is_empty_rect_in_reg, &env);
-#ifndef NDEBUG
-  assert (r == 0);              /* otherwise longjmp would have been called */
-#endif
-  return 1;                     /* no rectangles found */
-}
+typedef struct
+{
+  Coord X1;
+  int query;
+} r_batch_key;
 
-struct centroid
+static int
+cmp_batch_key (const void *a, const void *b)
 {
-  float x, y, area;
-};
+  const r_batch_key *ka = (const r_batch_key *) a;
+  const r_batch_key *kb = (const r_batch_key *) b;
+
+  if (ka->X1 != kb->X1)
+    return ka->X1 < kb->X1 ? -1 : 1;
+  return ka->query - kb->query;
+}
 
 /*!
- * \brief Split the node into two nodes putting clusters in each use the
- * k-means clustering algorithm.
+ * \brief Search node for the queries in active.
+ *
+ * active lists the n_active queries touching the node, by increasing
+ * X1, so the scan of a box can stop at the first query starting right
+ * of it.  work has room for the lists of all the levels below.
  */
-struct rtree_node *
-find_clusters (struct rtree_node *node)
+static int
+__r_search_batch (struct rtree_node *node, const int *active, int n_active,
+                  int *work, r_batch_arg * arg)
 {
-  float total_a, total_b;
-  float a_X, a_Y, b_X, b_Y;
-  bool belong[M_SIZE + 1];
-  struct centroid center[M_SIZE + 1];
-  int clust_a, clust_b, tries;
-  int a_manage = 0, b_manage = 0;
-  int i, old_ax, old_ay, old_bx, old_by;
-  struct rtree_node *new_node;
-  BoxType *b;
+  int seen = 0, i, j;
 
-  for (i = 0; i < M_SIZE + 1; i++)
+  if (node->flags.is_leaf)
+    {
+      for (i = 0; node->u.rects[i].bptr; i++)
+        {
+          const BoxType *b = &node->u.rects[i].bounds;
+
+          for (j = 0; j < n_active; j++)
+            {
+              const BoxType *q = &arg->queries[active[j]];
+
+              if (q->X1 >= b->X2)
+                break;
+              if (b->X1 < q->X2 && b->Y1 < q->Y2 && b->Y2 > q->Y1 &&
+                  arg->found_it (node->u.rects[i].bptr, active[j],
+                                 arg->closure))
+                seen++;
+            }
+        }
+      return seen;
+    }
+
+  /* not a leaf, recurse on lower nodes with the queries touching them */
+  for (i = 0; node->u.kids[i]; i++)
+    {
+      const BoxType *b = &node->u.kids[i]->box;
+      int m = 0;
+
+      for (j = 0; j < n_active; j++)
+        {
+          const BoxType *q = &arg->queries[active[j]];
+
+          if (q->X1 >= b->X2)
+            break;
+          if (b->X1 < q->X2 && b->Y1 < q->Y2 && b->Y2 > q->Y1)
+            work[m++] = active[j];
+        }
+      if (m)
+        seen += __r_search_batch (node->u.kids[i], work, m, work + arg->n,
+                                  arg);
+    }
+  return seen;
+}
+
+/*!
+ * \brief Search the rtree for many query boxes in one pass.
+ *
+ * Like r_search() without a region check, for each of the n boxes in
+ * queries.  The tree is walked once, carrying down each subtree the
+ * queries that touch it, instead of once per query.  found_rectangle
+ * gets the index of the query it was found for.  The order of the calls
+ * differs from n separate searches, and found_rectangle must not
+ * longjmp out of the search.
+ *
+ * \return the number of rectangles found, summed over all queries.
+ */
+int
+r_search_batch (rtree_t * rtree, const BoxType * queries, int n,
+                int (*found_rectangle) (const BoxType * box, int query,
+                                        void *cl), void *cl)
+{
+  r_batch_arg arg;
+  r_batch_key *keys;
+  struct rtree_node *node;
+  int *work, height = 1, m = 0, seen, i;
+  const BoxType *root;
+
+  if (!rtree || rtree->size < 1 || n < 1)
+    return 0;
+  flush_pending (rtree);
+#ifdef SLOW_ASSERTS
+  assert (__r_tree_is_good (rtree->root));
+#endif
+
+  for (node = rtree->root; !node->flags.is_leaf; node = node->u.kids[0])
+    height++;
+
+  /* sort the queries touching the root by X1 */
+  root = &rtree->root->box;
+  keys = (r_batch_key *)malloc (n * sizeof (*keys));
+  for (i = 0; i < n; i++)
+    {
+      const BoxType *q = &queries[i];
+
+      assert (q->X1 < q->X2 && q->Y1 < q->Y2);
+      if (root->X1 >= q->X2 || root->X2 <= q->X1 ||
+          root->Y1 >= q->Y2 || root->Y2 <= q->Y1)
+        continue;
+      keys[m].X1 = q->X1;
+      keys[m].query = i;
+      m++;
+    }
+  qsort (keys, m, sizeof (*keys), cmp_batch_key);
+  work = (int *)malloc ((height + 1) * n * sizeof (*work));
+  for (i = 0; i < m; i++)
+    work[i] = keys[i].query;
+  free (keys);
+
+  arg.queries = queries;
+  arg.n = n;
+  arg.found_it = found_rectangle;
+  arg.closure = cl;
+  seen = m ? __r_search_batch (rtree->root, work, m, work + n, &arg) : 0;
+  free (work);
+  return seen;
+}
+
+/* Heap items of r_search_nearest() are tree nodes or, tagged in their
+ * low bits, leaf entries.  Boxes are word aligned, so the bits are
+ * free.
+ */
+#define NEAREST_ENTRY 1         /* cost is the distance to the box */
+#define NEAREST_EXACT 3         /* cost is the distance to the object */
+#define NEAREST_TAG(p) ((uintptr_t) (p) & 3)
+#define NEAREST_PTR(p) ((const void *) ((uintptr_t) (p) & ~(uintptr_t) 3))
+
+/*!
+ * \brief Distance from pt to the closest point of box, 0 inside.
+ */
+static double
+box_distance (const BoxType * box, const PointType * pt)
+{
+  double dx = 0, dy = 0;
+
+  if (pt->X < box->X1)
+    dx = box->X1 - pt->X;
+  else if (pt->X > box->X2)
+    dx = pt->X - box->X2;
+  if (pt->Y < box->Y1)
+    dy = box->Y1 - pt->Y;
+  else if (pt->Y > box->Y2)
+    dy = pt->Y - box->Y2;
+  return hypot (dx, dy);
+}
+
+/*!
+ * \brief Find the k boxes of rtree nearest to a point.
+ *
+ * Best-first search: the nodes and entries still to look at are kept in
+ * a heap by their distance to pt, and popping the nearest one until k
+ * results are found only opens the nodes that can hold one of them.
+ *
+ * If distance is not NULL, it gives the distance from pt to the object
+ * of a box, which must not be less than the distance to the box, or a
+ * negative value to skip the object.  Otherwise the distance to the box
+ * is used.  Objects further away than max_distance are not returned.
+ *
+ * The boxes are stored into found, and their distances into distances
+ * unless that is NULL, nearest first.
+ *
+ * \return the number of boxes found, at most k.
+ */
+int
+r_search_nearest (rtree_t * rtree, const PointType * pt, int k,
+                  double max_distance,
+                  double (*distance) (const BoxType * box,
+                                      const PointType * pt, void *cl),
+                  void *cl, const BoxType ** found, double *distances)
+{
+  heap_t *heap;
+  int n = 0, i;
+
+  if (!rtree || rtree->size < 1 || k < 1)
+    return 0;
+  flush_pending (rtree);
+
+  PROFILE_BEGIN (PROFILE_RTREE);
+  heap = heap_create ();
+  if (box_distance (&rtree->root->box, pt) <= max_distance)
+    heap_insert (heap, box_distance (&rtree->root->box, pt), rtree->root);
+  /* only items within max_distance are ever put on the heap */
+  while (n < k && !heap_is_empty (heap))
+    {
+      cost_t cost = heap_min_cost (heap);
+      void *item = heap_remove_smallest (heap);
+
+      if (NEAREST_TAG (item) == NEAREST_EXACT)
+        {
+          if (distances)
+            distances[n] = cost;
+          found[n++] = (const BoxType *) NEAREST_PTR (item);
+        }
+      else if (NEAREST_TAG (item) == NEAREST_ENTRY)
+        {
+          const BoxType *box = (const BoxType *) NEAREST_PTR (item);
+
+          cost = distance (box, pt, cl);
+          if (cost >= 0 && cost <= max_distance)
+            heap_insert (heap, cost,
+                         (void *) ((uintptr_t) box | NEAREST_EXACT));
+        }
+      else
+        {
+          struct rtree_node *node = (struct rtree_node *) item;
+
+          if (node->flags.is_leaf)
+            for (i = 0; node->u.rects[i].bptr; i++)
+              {
+                const BoxType *box = node->u.rects[i].bptr;
+
+                cost = box_distance (&node->u.rects[i].bounds, pt);
+                if (cost <= max_distance)
+                  heap_insert (heap, cost,
+                               (void *) ((uintptr_t) box |
+                                         (distance ? NEAREST_ENTRY
+                                                   : NEAREST_EXACT)));
+              }
+          else
+            for (i = 0; node->u.kids[i]; i++)
+              {
+                cost = box_distance (&node->u.kids[i]->box, pt);
+                if (cost <= max_distance)
+                  heap_insert (heap, cost, node->u.kids[i]);
+              }
+        }
+    }
+  heap_destroy (&heap);
+  PROFILE_END (PROFILE_RTREE);
+  return n;
+}
+
+/*!
+ * \brief r_region_is_empty.
+ */
+static int
+__r_region_is_empty_rect_in_reg (const BoxType * box, void *cl)
+{
+  jmp_buf *envp = (jmp_buf *) cl;
+  longjmp (*envp, 1);           /* found one! */
+}
+
+/*!
+ * \brief Special-purpose searches build upon r_search.
+ *
+ * \return 0 if there are any rectangles in the given region.
+ */
+int
+r_region_is_empty (rtree_t * rtree, const BoxType * region)
+{
+  jmp_buf env;
+#ifndef NDEBUG
+  int r;
+#endif
+
+  if (setjmp (env))
+    return 0;
+#ifndef NDEBUG
+  r =
+#endif
+    r_search (rtree, region, NULL, __r_region_is_empty_rect_in_reg, &env);
+#ifndef NDEBUG
+  assert (r == 0);              /* otherwise longjmp would have been called */
+#endif
+  return 1;                     /* no rectangles found */
+}
+
+struct centroid
+{
+  float x, y, area;
+};
+
+/*!
+ * \brief Split the node into two nodes putting clusters in each use the
+ * k-means clustering algorithm.
+ */
+static struct rtree_node *
+find_clusters (rtree_t * rtree, struct rtree_node *node)
+{
+  float total_a, total_b;
+  float a_X, a_Y, b_X, b_Y;
+  bool belong[M_SIZE + 1];
+  struct centroid center[M_SIZE + 1];
+  int clust_a, clust_b, tries;
+  int a_manage = 0, b_manage = 0;
+  int i, old_ax, old_ay, old_bx, old_by;
+  struct rtree_node *new_node;
+  BoxType *b;
+
+  for (i = 0; i < M_SIZE + 1; i++)
     {
       if (node->flags.is_leaf)
         b = &(node->u.rects[i].bounds);
@@ -782,7 +1518,7 @@ find_clusters (struct rtree_node *node)
         break;
     }
   /* Now 'belong' has the partition map */
-  new_node = (struct rtree_node *)calloc (1, sizeof (*new_node));
+  new_node = alloc_node (rtree);
   new_node->parent = node->parent;
   new_node->flags.is_leaf = node->flags.is_leaf;
   clust_a = clust_b = 0;
@@ -843,7 +1579,7 @@ find_clusters (struct rtree_node *node)
  * \brief Split a node according to clusters.
  */
 static void
-split_node (struct rtree_node *node)
+split_node (rtree_t * rtree, struct rtree_node *node)
 {
   int i;
   struct rtree_node *new_node;
@@ -851,12 +1587,12 @@ split_node (struct rtree_node *node)
   assert (node);
   assert (node->flags.is_leaf ? (void *) node->u.rects[M_SIZE].
           bptr : (void *) node->u.kids[M_SIZE]);
-  new_node = find_clusters (node);
+  new_node = find_clusters (rtree, node);
   if (node->parent == NULL)     /* split root node */
     {
       struct rtree_node *second;
 
-      second = (struct rtree_node *)calloc (1, sizeof (*second));
+      second = alloc_node (rtree);
       *second = *node;
       if (!second->flags.is_leaf)
         for (i = 0; i < M_SIZE; i++)
@@ -886,13 +1622,13 @@ split_node (struct rtree_node *node)
 #endif
   if (i < M_SIZE)
     {
+      sort_node (node->parent);
 #ifdef SLOW_ASSERTS
       assert (__r_node_is_good (node->parent));
 #endif
-      sort_node (node->parent);
       return;
     }
-  split_node (node->parent);
+  split_node (rtree, node->parent);
 }
 
 static inline int
@@ -924,8 +1660,8 @@ penalty (struct rtree_node *node, const BoxType * query)
 }
 
 static void
-__r_insert_node (struct rtree_node *node, const BoxType * query,
-                 int manage, bool force)
+__r_insert_node (rtree_t * rtree, struct rtree_node *node,
+                 const BoxType * query, int manage, bool force)
 {
 
 #ifdef SLOW_ASSERTS
@@ -977,7 +1713,7 @@ __r_insert_node (struct rtree_node *node, const BoxType * query,
           return;
         }
       /* we must split the node */
-      split_node (node);
+      split_node (rtree, node);
       return;
     }
   else
@@ -1004,7 +1740,7 @@ __r_insert_node (struct rtree_node *node, const BoxType * query,
             break;
           if (contained (node->u.kids[i], query))
             {
-              __r_insert_node (node->u.kids[i], query, manage, false);
+              __r_insert_node (rtree, node->u.kids[i], query, manage, false);
               sort_node (node);
               return;
             }
@@ -1014,7 +1750,7 @@ __r_insert_node (struct rtree_node *node, const BoxType * query,
       if (node->u.kids[0]->flags.is_leaf && i < M_SIZE)
         {
           struct rtree_node *new_node;
-          new_node = (struct rtree_node *)calloc (1, sizeof (*new_node));
+          new_node = alloc_node (rtree);
           new_node->parent = node;
           new_node->flags.is_leaf = true;
           node->u.kids[i] = new_node;
@@ -1023,6 +1759,7 @@ __r_insert_node (struct rtree_node *node, const BoxType * query,
           new_node->box = *query;
           if (UNLIKELY (manage))
             new_node->flags.manage = 1;
+          fill_kid_boxes (new_node);
           sort_node (node);
           return;
         }
@@ -1041,30 +1778,364 @@ __r_insert_node (struct rtree_node *node, const BoxType * query,
               best_node = node->u.kids[i];
             }
         }
-      __r_insert_node (best_node, query, manage, true);
+      __r_insert_node (rtree, best_node, query, manage, true);
       sort_node (node);
       return;
     }
 }
 
-void
-r_insert_entry (rtree_t * rtree, const BoxType * which, int man)
+static void
+insert_one (rtree_t * rtree, const BoxType * which, int man)
 {
-  assert (which);
-  assert (which->X1 <= which->X2);
-  assert (which->Y1 <= which->Y2);
   /* recursively search the tree for the best leaf node */
   assert (rtree->root);
-  __r_insert_node (rtree->root, which, man,
+  __r_insert_node (rtree, rtree->root, which, man,
                    rtree->root->box.X1 > which->X1
                    || rtree->root->box.X2 < which->X2
                    || rtree->root->box.Y1 > which->Y1
                    || rtree->root->box.Y2 < which->Y2);
+}
+
+/*!
+ * \brief Put a leaf node made by pack_level() into a tree whose root is
+ * not a leaf.
+ *
+ * The leaf goes to the node above the leaves that grows least by taking
+ * it, and that node is split if it overflows, as for a single box.
+ */
+static void
+__r_insert_leaf (rtree_t * rtree, struct rtree_node *leaf)
+{
+  struct rtree_node *node = rtree->root, *best;
+  double score, best_score;
+  int i;
+
+  for (;;)
+    {
+      MAKEMIN (node->box.X1, leaf->box.X1);
+      MAKEMAX (node->box.X2, leaf->box.X2);
+      MAKEMIN (node->box.Y1, leaf->box.Y1);
+      MAKEMAX (node->box.Y2, leaf->box.Y2);
+      assert (node->u.kids[0]);
+      if (node->u.kids[0]->flags.is_leaf)
+        break;
+      best = node->u.kids[0];
+      best_score = penalty (best, &leaf->box);
+      for (i = 1; i < M_SIZE && node->u.kids[i]; i++)
+        {
+          score = penalty (node->u.kids[i], &leaf->box);
+          if (score < best_score)
+            {
+              best_score = score;
+              best = node->u.kids[i];
+            }
+        }
+      node = best;
+    }
+  for (i = 0; i < M_SIZE; i++)
+    if (!node->u.kids[i])
+      break;
+  leaf->parent = node;
+  /* the node always has an extra space available */
+  node->u.kids[i] = leaf;
+  if (i < M_SIZE)
+    sort_node (node);
+  else
+    split_node (rtree, node);
+#ifdef NODE_ARENA
+  /* the nodes above grew on the way down */
+  for (node = leaf->parent->parent; node; node = node->parent)
+    fill_kid_boxes (node);
+#endif
+}
+
+/*!
+ * \brief Add N boxes to a tree in one go, leaving its size alone.
+ *
+ * The boxes are packed into full leaves as by a bulk load, and the
+ * leaves are then put into the tree, which costs one descent for every
+ * M_SIZE boxes and gives leaves with less overlap than inserting the
+ * boxes one by one.  A tree whose root is still a leaf is rebuilt around
+ * the bulk loaded boxes instead.
+ */
+static void
+__r_insert_entries (rtree_t * rtree, const BoxType * boxlist[], int N,
+                    int manage)
+{
+  struct rtree_node *old = rtree->root;
+  const BoxType **level;
+  int i, n;
+
+  if (N < M_SIZE)
+    {
+      for (i = 0; i < N; i++)
+        insert_one (rtree, boxlist[i], manage);
+      return;
+    }
+  if (old->flags.is_leaf)
+    {
+      rtree->root = bulk_load (rtree, boxlist, N, manage);
+      rtree->root->parent = NULL;
+      for (i = 0; i < M_SIZE && old->u.rects[i].bptr; i++)
+        insert_one (rtree, old->u.rects[i].bptr,
+                    old->flags.manage & (1 << i));
+      free_node (rtree, old);
+    }
+  else
+    {
+      level = (const BoxType **)malloc (N * sizeof (*level));
+      memcpy (level, boxlist, N * sizeof (*level));
+      n = pack_level (rtree, level, N, true, manage);
+      for (i = 0; i < n; i++)
+        __r_insert_leaf (rtree, (struct rtree_node *) level[i]);
+      free (level);
+    }
+#ifdef SLOW_ASSERTS
+  assert (__r_tree_is_good (rtree->root));
+#endif
+}
+
+/*-----------------------------------------------------------------
+ * Deferred inserts.
+ *
+ * Between r_defer_inserts() and r_resume_inserts() the boxes inserted
+ * into a tree by the thread that deferred them are only noted, and go
+ * into the tree with one __r_insert_entries() when the section ends, or
+ * before the tree is searched or measured.  A box deleted again in the
+ * meantime, or whose tree is destroyed, is just dropped from the notes.
+ * Pasting a large buffer thus costs a bulk insert per tree instead of a
+ * descent of the tree for every object.
+ *
+ * Scratch trees made inside the section, like those of the polygon code,
+ * are searched as they are built and get their boxes right away.  The
+ * trees of objects made inside it, like those of a board being read, are
+ * deferred too, so that they are bulk loaded.
+ */
+
+/*!
+ * \brief Extend a box to take in all the boxes of a tree.
+ *
+ * Those are the bounds of the root node, so this costs next to nothing.
+ */
+void
+r_extend_bounds (rtree_t * rtree, BoxType * box)
+{
+  if (!rtree || rtree->size < 1)
+    return;
+  flush_pending (rtree);
+  MAKEMIN (box->X1, rtree->root->box.X1);
+  MAKEMIN (box->Y1, rtree->root->box.Y1);
+  MAKEMAX (box->X2, rtree->root->box.X2);
+  MAKEMAX (box->Y2, rtree->root->box.Y2);
+}
+
+typedef struct
+{
+  const BoxType *bptr;          /* the box, NULL once deleted again */
+  int manage;
+} pending_entry;
+
+struct rtree_pending
+{
+  struct rtree_pending *next;   /* the next tree with deferred inserts */
+  rtree_t *rtree;
+  GArray *entries;              /* of pending_entry, in insertion order */
+  GHashTable *index;            /* entry number + 1 by box */
+};
+
+/* nesting depth of r_defer_inserts() sections, and their thread; the
+ * sections are numbered from 1 */
+static int r_defer_depth = 0;
+static gpointer r_defer_thread = NULL;
+static int r_defer_section = 0;
+/* the trees with deferred inserts */
+static struct rtree_pending *r_pending_trees = NULL;
+
+static bool
+inserts_deferred (void)
+{
+  return g_atomic_pointer_get (&r_defer_thread) == (gpointer) g_thread_self ();
+}
+
+static void
+defer_insert (rtree_t * rtree, const BoxType * which, int man)
+{
+  struct rtree_pending *p = rtree->pending;
+  pending_entry e;
+
+  if (p == NULL)
+    {
+      p = (struct rtree_pending *)malloc (sizeof (*p));
+      p->rtree = rtree;
+      p->entries = g_array_new (FALSE, FALSE, sizeof (pending_entry));
+      p->index = g_hash_table_new (g_direct_hash, g_direct_equal);
+      p->next = r_pending_trees;
+      r_pending_trees = p;
+      rtree->pending = p;
+    }
+  e.bptr = which;
+  e.manage = man;
+  g_array_append_val (p->entries, e);
+  g_hash_table_insert (p->index, (gpointer) which,
+                       GINT_TO_POINTER (p->entries->len));
+}
+
+static void
+unlink_pending (struct rtree_pending *p)
+{
+  struct rtree_pending **pp;
+
+  for (pp = &r_pending_trees; *pp != p; pp = &(*pp)->next)
+    ;
+  *pp = p->next;
+  p->rtree->pending = NULL;
+}
+
+/*!
+ * \brief Forget the deferred inserts of a tree going away.
+ *
+ * Their boxes may have been freed already, as poly_Free() frees the
+ * contours of a polygon before their tree, so only the managed ones,
+ * which are the tree's, are looked at.
+ */
+static void
+drop_pending (rtree_t * rtree)
+{
+  struct rtree_pending *p = rtree->pending;
+  pending_entry *e;
+  int i;
+
+  if (p == NULL)
+    return;
+  unlink_pending (p);
+  e = (pending_entry *) p->entries->data;
+  for (i = 0; i < p->entries->len; i++)
+    if (e[i].bptr && e[i].manage)
+      free ((void *) e[i].bptr);
+  g_array_free (p->entries, TRUE);
+  g_hash_table_destroy (p->index);
+  free (p);
+}
+
+/*!
+ * \brief Put the deferred inserts of a tree into it.
+ */
+static void
+flush_pending (rtree_t * rtree)
+{
+  struct rtree_pending *p = rtree->pending;
+  pending_entry *e;
+  const BoxType **boxes;
+  int man, i, n;
+
+  if (p == NULL)
+    return;
+  unlink_pending (p);
+
+  e = (pending_entry *) p->entries->data;
+  boxes = (const BoxType **)malloc (p->entries->len * sizeof (*boxes));
+  for (man = 0; man <= 1; man++)
+    {
+      n = 0;
+      for (i = 0; i < p->entries->len; i++)
+        if (e[i].bptr && (e[i].manage != 0) == man)
+          boxes[n++] = e[i].bptr;
+      if (n > 0)
+        __r_insert_entries (rtree, boxes, n, man);
+    }
+  free (boxes);
+  g_array_free (p->entries, TRUE);
+  g_hash_table_destroy (p->index);
+  free (p);
+}
+
+/*!
+ * \brief Insert a number of boxes into a tree at once.
+ *
+ * This is much faster than inserting them one by one when there are more
+ * than a few, see __r_insert_entries().
+ */
+void
+r_insert_entries (rtree_t * rtree, const BoxType * boxlist[], int N,
+                  int manage)
+{
+  int i;
+
+  assert (N >= 0);
+  for (i = 0; i < N; i++)
+    {
+      assert (boxlist[i]);
+      assert (boxlist[i]->X1 <= boxlist[i]->X2);
+      assert (boxlist[i]->Y1 <= boxlist[i]->Y2);
+    }
+  ASSERT_NOT_SHARED (rtree);
+  NOTE_CHANGE (rtree);
+  flush_pending (rtree);
+  __r_insert_entries (rtree, boxlist, N, manage);
+  rtree->size += N;
+}
+
+/*!
+ * \brief Start noting the boxes inserted by this thread instead of
+ * putting them into their trees right away.
+ *
+ * Calls nest, and only one thread may have a section open at a time.
+ */
+void
+r_defer_inserts (void)
+{
+  assert (r_defer_depth == 0 || inserts_deferred ());
+  if (r_defer_depth++ > 0)
+    return;
+  r_defer_section++;
+  g_atomic_pointer_set (&r_defer_thread, (gpointer) g_thread_self ());
+}
+
+/*!
+ * \brief End a r_defer_inserts() section, putting the noted boxes into
+ * their trees once the outermost section ends.
+ */
+void
+r_resume_inserts (void)
+{
+  assert (r_defer_depth > 0 && inserts_deferred ());
+  if (--r_defer_depth > 0)
+    return;
+  g_atomic_pointer_set (&r_defer_thread, NULL);
+  while (r_pending_trees)
+    flush_pending (r_pending_trees->rtree);
+}
+
+/*!
+ * \brief Put the boxes noted so far by this thread's r_defer_inserts()
+ * section into their trees, without ending the section.
+ */
+void
+r_flush_inserts (void)
+{
+  if (inserts_deferred ())
+    while (r_pending_trees)
+      flush_pending (r_pending_trees->rtree);
+}
+
+void
+r_insert_entry (rtree_t * rtree, const BoxType * which, int man)
+{
+  assert (which);
+  assert (which->X1 <= which->X2);
+  assert (which->Y1 <= which->Y2);
+  ASSERT_NOT_SHARED (rtree);
+  NOTE_CHANGE (rtree);
+  if (inserts_deferred ()
+      && (rtree->tracked || rtree->defer_section != r_defer_section))
+    defer_insert (rtree, which, man);
+  else
+    insert_one (rtree, which, man);
   rtree->size++;
 }
 
-bool
-__r_delete (struct rtree_node *node, const BoxType * query)
+static bool
+__r_delete (rtree_t * rtree, struct rtree_node *node, const BoxType * query)
 {
   int i, flag, mask, a;
 
@@ -1079,7 +2150,7 @@ __r_delete (struct rtree_node *node, const BoxType * query)
           /* if this is us being removed, free and copy over */
           if (node->u.kids[i] == (struct rtree_node *) query)
             {
-              free ((void *) query);
+              free_node (rtree, (struct rtree_node *) query);
               for (; i < M_SIZE; i++)
                 {
                   node->u.kids[i] = node->u.kids[i + 1];
@@ -1098,7 +2169,7 @@ __r_delete (struct rtree_node *node, const BoxType * query)
                         node->u.rects[i].bptr = NULL;
                       return true;
                     }
-                  return (__r_delete (node->parent, &node->box));
+                  return (__r_delete (rtree, node->parent, &node->box));
                 }
               else
                 /* propegate boundary adjust upward */
@@ -1111,7 +2182,7 @@ __r_delete (struct rtree_node *node, const BoxType * query)
             }
           if (node->u.kids[i])
             {
-              if (__r_delete (node->u.kids[i], query))
+              if (__r_delete (rtree, node->u.kids[i], query))
                 return true;
             }
           else
@@ -1157,7 +2228,7 @@ __r_delete (struct rtree_node *node, const BoxType * query)
   if (!node->u.rects[0].bptr)
     {
       if (node->parent)
-        __r_delete (node->parent, &node->box);
+        __r_delete (rtree, node->parent, &node->box);
       return true;
     }
   else
@@ -1177,11 +2248,302 @@ r_delete_entry (rtree_t * rtree, const BoxType * box)
 
   assert (box);
   assert (rtree);
-  r = __r_delete (rtree->root, box);
+  ASSERT_NOT_SHARED (rtree);
+  if (rtree->pending)
+    {
+      gpointer n = g_hash_table_lookup (rtree->pending->index, box);
+
+      if (n)
+        {
+          pending_entry *e = &g_array_index (rtree->pending->entries,
+                                             pending_entry,
+                                             GPOINTER_TO_INT (n) - 1);
+
+          if (e->manage)
+            free ((void *) e->bptr);
+          e->bptr = NULL;
+          g_hash_table_remove (rtree->pending->index, box);
+          rtree->size--;
+          NOTE_CHANGE (rtree);
+          return true;
+        }
+    }
+  r = __r_delete (rtree, rtree->root, box);
   if (r)
-    rtree->size--;
+    {
+      rtree->size--;
+      NOTE_CHANGE (rtree);
+    }
 #ifdef SLOW_ASSERTS
   assert (__r_tree_is_good (rtree->root));
 #endif
   return r;
 }
+
+/*
+ ******************************************************************************
+                                    Tests
+ ******************************************************************************
+ */
+#ifdef PCB_UNIT_TEST
+
+#define TEST_BOXES 2000
+
+typedef struct
+{
+  BoxType *boxes;
+  char *found; /* by box: 1 if found in the first tree, 2 in the second */
+  char tree;
+} test_search_arg;
+
+static int
+test_found (const BoxType * box, void *cl)
+{
+  test_search_arg *arg = (test_search_arg *) cl;
+
+  arg->found[box - arg->boxes] |= arg->tree;
+  return 1;
+}
+
+/*!
+ * \brief Check that a tree filled the way the parser fills the trees of
+ * a board, in a r_defer_inserts() section and so bulk loaded, finds the
+ * same boxes as one filled by inserting them one by one.
+ */
+static void
+rtree_test_deferred (void)
+{
+  GRand *rand = g_rand_new_with_seed (1);
+  test_search_arg arg;
+  rtree_t *single, *bulk;
+  BoxType query;
+  int i, j, n;
+
+  arg.boxes = g_new (BoxType, TEST_BOXES);
+  arg.found = g_new (char, TEST_BOXES);
+  for (i = 0; i < TEST_BOXES; i++)
+    {
+      arg.boxes[i].X1 = g_rand_int_range (rand, 0, 1000000);
+      arg.boxes[i].Y1 = g_rand_int_range (rand, 0, 1000000);
+      arg.boxes[i].X2 = arg.boxes[i].X1 + g_rand_int_range (rand, 0, 20000);
+      arg.boxes[i].Y2 = arg.boxes[i].Y1 + g_rand_int_range (rand, 0, 20000);
+    }
+
+  single = r_create_data_tree ();
+  for (i = 0; i < TEST_BOXES; i++)
+    r_insert_entry (single, &arg.boxes[i], 0);
+
+  r_defer_inserts ();
+  bulk = r_create_data_tree ();
+  for (i = 0; i < TEST_BOXES; i++)
+    r_insert_entry (bulk, &arg.boxes[i], 0);
+  /* deleting a box still waiting to go in drops it */
+  r_delete_entry (single, &arg.boxes[0]);
+  r_delete_entry (bulk, &arg.boxes[0]);
+  r_resume_inserts ();
+  g_assert_cmpint (single->size, ==, bulk->size);
+
+  for (j = 0; j < 200; j++)
+    {
+      query.X1 = g_rand_int_range (rand, 0, 1000000);
+      query.Y1 = g_rand_int_range (rand, 0, 1000000);
+      query.X2 = query.X1 + g_rand_int_range (rand, 1, 100000);
+      query.Y2 = query.Y1 + g_rand_int_range (rand, 1, 100000);
+
+      memset (arg.found, 0, TEST_BOXES);
+      arg.tree = 1;
+      n = r_search (single, &query, NULL, test_found, &arg);
+      arg.tree = 2;
+      g_assert_cmpint (r_search (bulk, &query, NULL, test_found, &arg), ==, n);
+      for (i = 0; i < TEST_BOXES; i++)
+        g_assert (arg.found[i] == 0 || arg.found[i] == 3);
+      g_assert (arg.found[0] == 0);
+    }
+
+  r_destroy_tree (&single);
+  r_destroy_tree (&bulk);
+  g_free (arg.boxes);
+  g_free (arg.found);
+  g_rand_free (rand);
+}
+
+/*!
+ * \brief Check that searches find what a scan of all boxes does while
+ * boxes are deleted and put back, one by one and in bulk.
+ */
+static void
+rtree_test_churn (void)
+{
+  GRand *rand = g_rand_new_with_seed (3);
+  test_search_arg arg;
+  const BoxType **batch = g_new (const BoxType *, TEST_BOXES);
+  char *in_tree = g_new (char, TEST_BOXES);
+  rtree_t *rtree;
+  BoxType query;
+  int i, j, k, n, want;
+
+  arg.boxes = g_new (BoxType, TEST_BOXES);
+  arg.found = g_new (char, TEST_BOXES);
+  arg.tree = 1;
+  for (i = 0; i < TEST_BOXES; i++)
+    {
+      arg.boxes[i].X1 = g_rand_int_range (rand, 0, 1000000);
+      arg.boxes[i].Y1 = g_rand_int_range (rand, 0, 1000000);
+      arg.boxes[i].X2 = arg.boxes[i].X1 + g_rand_int_range (rand, 0, 20000);
+      arg.boxes[i].Y2 = arg.boxes[i].Y1 + g_rand_int_range (rand, 0, 20000);
+      batch[i] = &arg.boxes[i];
+      in_tree[i] = 1;
+    }
+  rtree = r_create_tree (batch, TEST_BOXES, 0);
+
+  for (k = 0; k < 20; k++)
+    {
+      /* take out about half of the boxes, then put most of them back,
+       * in bulk every other round */
+      for (i = 0; i < TEST_BOXES; i++)
+        if (in_tree[i] && g_rand_int_range (rand, 0, 2))
+          {
+            g_assert (r_delete_entry (rtree, &arg.boxes[i]));
+            in_tree[i] = 0;
+          }
+      n = 0;
+      for (i = 0; i < TEST_BOXES; i++)
+        if (!in_tree[i] && g_rand_int_range (rand, 0, 4))
+          {
+            batch[n++] = &arg.boxes[i];
+            in_tree[i] = 1;
+          }
+      if (k % 2)
+        r_insert_entries (rtree, batch, n, 0);
+      else
+        for (i = 0; i < n; i++)
+          r_insert_entry (rtree, batch[i], 0);
+
+      for (j = 0; j < 20; j++)
+        {
+          query.X1 = g_rand_int_range (rand, 0, 1000000);
+          query.Y1 = g_rand_int_range (rand, 0, 1000000);
+          query.X2 = query.X1 + g_rand_int_range (rand, 1, 200000);
+          query.Y2 = query.Y1 + g_rand_int_range (rand, 1, 200000);
+
+          memset (arg.found, 0, TEST_BOXES);
+          n = r_search (rtree, &query, NULL, test_found, &arg);
+          want = 0;
+          for (i = 0; i < TEST_BOXES; i++)
+            {
+              bool touches = in_tree[i]
+                && arg.boxes[i].X1 < query.X2 && arg.boxes[i].X2 > query.X1
+                && arg.boxes[i].Y1 < query.Y2 && arg.boxes[i].Y2 > query.Y1;
+
+              g_assert (arg.found[i] == touches);
+              want += touches;
+            }
+          g_assert_cmpint (n, ==, want);
+        }
+    }
+
+  r_destroy_tree (&rtree);
+  g_free (arg.boxes);
+  g_free (arg.found);
+  g_free (batch);
+  g_free (in_tree);
+  g_rand_free (rand);
+}
+
+/*!
+ * \brief Test distance of r_search_nearest(): the distance to the far
+ * corner of the box, skipping every third box.
+ */
+static double
+test_far_corner (const BoxType * box, const PointType * pt, void *cl)
+{
+  BoxType *boxes = (BoxType *) cl;
+
+  if ((box - boxes) % 3 == 0)
+    return -1;
+  return hypot (MAX (ABS (box->X1 - pt->X), ABS (box->X2 - pt->X)),
+                MAX (ABS (box->Y1 - pt->Y), ABS (box->Y2 - pt->Y)));
+}
+
+static int
+cmp_double (const void *a, const void *b)
+{
+  double da = *(const double *) a, db = *(const double *) b;
+
+  return da < db ? -1 : da > db;
+}
+
+/*!
+ * \brief Check the distances r_search_nearest() finds against those of
+ * all boxes, sorted.
+ */
+static void
+rtree_test_nearest (void)
+{
+  GRand *rand = g_rand_new_with_seed (2);
+  BoxType *boxes = g_new (BoxType, TEST_BOXES);
+  double *all = g_new (double, TEST_BOXES);
+  double distances[20], max_distance;
+  const BoxType *found[20];
+  rtree_t *rtree;
+  PointType pt;
+  int i, j, k, n, want;
+
+  rtree = r_create_data_tree ();
+  for (i = 0; i < TEST_BOXES; i++)
+    {
+      boxes[i].X1 = g_rand_int_range (rand, 0, 1000000);
+      boxes[i].Y1 = g_rand_int_range (rand, 0, 1000000);
+      boxes[i].X2 = boxes[i].X1 + g_rand_int_range (rand, 0, 20000);
+      boxes[i].Y2 = boxes[i].Y1 + g_rand_int_range (rand, 0, 20000);
+      r_insert_entry (rtree, &boxes[i], 0);
+    }
+
+  for (j = 0; j < 400; j++)
+    {
+      bool exact = j % 2;
+
+      pt.X = g_rand_int_range (rand, -100000, 1100000);
+      pt.Y = g_rand_int_range (rand, -100000, 1100000);
+      k = g_rand_int_range (rand, 1, 21);
+      max_distance = j % 4 < 2 ? 1e30 : g_rand_int_range (rand, 0, 100000);
+
+      want = 0;
+      for (i = 0; i < TEST_BOXES; i++)
+        {
+          double d = exact ? test_far_corner (&boxes[i], &pt, boxes)
+                           : box_distance (&boxes[i], &pt);
+
+          if (d >= 0 && d <= max_distance)
+            all[want++] = d;
+        }
+      qsort (all, want, sizeof (double), cmp_double);
+
+      n = r_search_nearest (rtree, &pt, k, max_distance,
+                            exact ? test_far_corner : NULL, boxes,
+                            found, distances);
+      g_assert_cmpint (n, ==, MIN (k, want));
+      for (i = 0; i < n; i++)
+        {
+          g_assert_cmpfloat (distances[i], ==, all[i]);
+          g_assert_cmpfloat (distances[i], ==,
+                             exact ? test_far_corner (found[i], &pt, boxes)
+                                   : box_distance (found[i], &pt));
+        }
+    }
+
+  r_destroy_tree (&rtree);
+  g_free (boxes);
+  g_free (all);
+  g_rand_free (rand);
+}
+
+void
+rtree_register_tests (void)
+{
+  g_test_add_func ("/rtree/deferred", rtree_test_deferred);
+  g_test_add_func ("/rtree/churn", rtree_test_churn);
+  g_test_add_func ("/rtree/nearest", rtree_test_nearest);
+}
+
+#endif /* PCB_UNIT_TEST */
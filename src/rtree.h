@@ -45,10 +45,21 @@
 
 
 rtree_t *r_create_tree (const BoxType * boxlist[], int N, int manage);
+rtree_t *r_create_data_tree (void);
 void r_destroy_tree (rtree_t ** rtree);
+size_t r_memory (rtree_t * rtree);
+void r_extend_bounds (rtree_t * rtree, BoxType * box);
 
 bool r_delete_entry (rtree_t * rtree, const BoxType * which);
 void r_insert_entry (rtree_t * rtree, const BoxType * which, int manage);
+void r_insert_entries (rtree_t * rtree, const BoxType * boxlist[], int N,
+		       int manage);
+void r_defer_inserts (void);
+void r_resume_inserts (void);
+void r_flush_inserts (void);
+unsigned long r_generation (void);
+void r_begin_shared_read (void);
+void r_end_shared_read (void);
 int r_search (rtree_t * rtree, const BoxType * starting_region,
 	      int (*region_in_search) (const BoxType * region, void *cl),
 	      int (*rectangle_in_region) (const BoxType * box, void *cl),
@@ -68,7 +79,20 @@ static inline int r_search_pt (rtree_t * rtree, const PointType * pt,
 
   return r_search(rtree, &box, region_in_search, rectangle_in_region, closure);
 }
+int r_search_batch (rtree_t * rtree, const BoxType * queries, int n,
+	      int (*rectangle_in_region) (const BoxType * box, int query,
+					  void *cl),
+	      void *closure);
+int r_search_nearest (rtree_t * rtree, const PointType * pt, int k,
+	      double max_distance,
+	      double (*distance) (const BoxType * box, const PointType * pt,
+				  void *cl),
+	      void *cl, const BoxType ** found, double *distances);
 int r_region_is_empty (rtree_t * rtree, const BoxType * region);
 void __r_dump_tree (struct rtree_node *, int);
 
+#ifdef PCB_UNIT_TEST
+void rtree_register_tests (void);
+#endif
+
 #endif
@@ -80,6 +80,26 @@ static void CheckPolygonForRubberbandConnection (LayerType *,
 static void CheckLinePointForRat (LayerType *, PointType *);
 static int rubber_callback (const BoxType * b, void *cl);
 
+/*!
+ * \brief The lines already in 'Crosshair.AttachedObject.Rubberband',
+ * during a LookupRubberbandLines().
+ *
+ * An element is checked pin by pin, and each pin finds the lines near
+ * it, so looking for those in the list instead made starting to move an
+ * element with many pins quadratic in the number of attached lines.
+ */
+static GHashTable *rubber_lines = NULL;
+
+/*!
+ * \brief Adds a line end to the rubberband list and remembers the line.
+ */
+static void
+AddRubberbandLine (LayerType *Layer, LineType *Line, PointType *MovedPoint)
+{
+  CreateNewRubberbandEntry (Layer, Line, MovedPoint);
+  g_hash_table_add (rubber_lines, Line);
+}
+
 struct rubber_info
 {
   Coord radius;
@@ -96,15 +116,14 @@ rubber_callback (const BoxType * b, void *cl)
   struct rubber_info *i = (struct rubber_info *) cl;
   double x, y, rad, dist1, dist2;
   Coord t;
-  int touches = 0, n = 0 ;
+  int touches = 0;
 
   t = line->Thickness / 2;
 
   /* Check to see if the line is already in the rubberband list */
-  for (n = 0; n < Crosshair.AttachedObject.RubberbandN; n++)
-    if (Crosshair.AttachedObject.Rubberband[n].Line == line)
-      return 0;
-    
+  if (g_hash_table_contains (rubber_lines, line))
+    return 0;
+
   if (TEST_FLAG (LOCKFLAG, line))
     return 0;
   if (line == i->line)
@@ -156,7 +175,7 @@ rubber_callback (const BoxType * b, void *cl)
 	    }
 	  if (touches)
 	    {
-	      CreateNewRubberbandEntry (i->layer, line, &line->Point1);
+	      AddRubberbandLine (i->layer, line, &line->Point1);
 	      found++;
 	    }
 	}
@@ -186,7 +205,7 @@ rubber_callback (const BoxType * b, void *cl)
 	    }
 	  if (touches)
 	    {
-	      CreateNewRubberbandEntry (i->layer, line, &line->Point2);
+	      AddRubberbandLine (i->layer, line, &line->Point2);
 	      found++;
 	    }
 	}
@@ -215,14 +234,14 @@ rubber_callback (const BoxType * b, void *cl)
 
 #ifdef CLOSEST_ONLY	/* keep this to remind me */
   if (dist1 < dist2)
-    CreateNewRubberbandEntry (i->layer, line, &line->Point1);
+    AddRubberbandLine (i->layer, line, &line->Point1);
   else
-    CreateNewRubberbandEntry (i->layer, line, &line->Point2);
+    AddRubberbandLine (i->layer, line, &line->Point2);
 #else
   if (dist1 <= 0)
-    CreateNewRubberbandEntry (i->layer, line, &line->Point1);
+    AddRubberbandLine (i->layer, line, &line->Point1);
   if (dist2 <= 0)
-    CreateNewRubberbandEntry (i->layer, line, &line->Point2);
+    AddRubberbandLine (i->layer, line, &line->Point2);
 #endif
   return 1;
 }
@@ -515,10 +534,10 @@ CheckPolygonForRubberbandConnection (LayerType *Layer,
 	  thick = (line->Thickness + 1) / 2;
 	  if (IsPointInPolygon (line->Point1.X, line->Point1.Y,
 				thick, Polygon))
-	    CreateNewRubberbandEntry (layer, line, &line->Point1);
+	    AddRubberbandLine (layer, line, &line->Point1);
 	  if (IsPointInPolygon (line->Point2.X, line->Point2.Y,
 				thick, Polygon))
-	    CreateNewRubberbandEntry (layer, line, &line->Point2);
+	    AddRubberbandLine (layer, line, &line->Point2);
 	}
 	END_LOOP;
       }
@@ -535,6 +554,13 @@ CheckPolygonForRubberbandConnection (LayerType *Layer,
 void
 LookupRubberbandLines (int Type, void *Ptr1, void *Ptr2, void *Ptr3)
 {
+  Cardinal n;
+
+  if (rubber_lines == NULL)
+    rubber_lines = g_hash_table_new (NULL, NULL);
+  for (n = 0; n < Crosshair.AttachedObject.RubberbandN; n++)
+    g_hash_table_add (rubber_lines,
+		      Crosshair.AttachedObject.Rubberband[n].Line);
 
   /* the function is only supported for some types
    * check all visible lines;
@@ -609,6 +635,8 @@ LookupRubberbandLines (int Type, void *Ptr1, void *Ptr2, void *Ptr3)
 					     (PolygonType *) Ptr2);
       break;
     }
+
+  g_hash_table_remove_all (rubber_lines);
 }
 
 void
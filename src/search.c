@@ -994,22 +994,34 @@ IsArcInRectangle (Coord X1, Coord Y1, Coord X2, Coord Y2, ArcType *Arc)
 bool
 IsPointInPad (Coord X, Coord Y, Coord Radius, PadType *Pad)
 {
-  double r, Sin, Cos;
-  Coord x; 
-  Coord t2 = (Pad->Thickness + 1) / 2, range;
-  PadType pad = *Pad;
+  bool hit;
 
-  /* series of transforms saving range */
-  /* move Point1 to the origin */
-  X -= pad.Point1.X;
-  Y -= pad.Point1.Y;
+  PointsInPad (&X, &Y, &Radius, &hit, 1, Pad);
+  return hit;
+}
 
-  pad.Point2.X -= pad.Point1.X;
-  pad.Point2.Y -= pad.Point1.Y;
-  /* so, pad.Point1.X = pad.Point1.Y = 0; */
+/*!
+ * \brief Check for each of N circles if it intersects a Pad.
+ *
+ * The circles are given by the arrays X, Y and Radius, the results are
+ * stored in Hit.  The transformation of the pad onto the x axis is only
+ * computed once, so testing many points against the same pad or line is
+ * a lot cheaper than calling IsPointInPad() for each of them.
+ */
+void
+PointsInPad (const Coord *PX, const Coord *PY, const Coord *PRadius,
+             bool *Hit, Cardinal N, PadType *Pad)
+{
+  double r, Sin, Cos;
+  Coord t2 = (Pad->Thickness + 1) / 2;
+  Coord dx = Pad->Point2.X - Pad->Point1.X;
+  Coord dy = Pad->Point2.Y - Pad->Point1.Y;
+  bool square = TEST_FLAG (SQUAREFLAG, Pad);
+  Cardinal k;
 
-  /* rotate round (0, 0) so that Point2 coordinates be (r, 0) */
-  r = Distance (0, 0, pad.Point2.X, pad.Point2.Y);
+  /* series of transforms saving range */
+  /* rotate round Point1 so that Point2 coordinates be (r, 0) */
+  r = Distance (0, 0, dx, dy);
   if (r < .1)
     {
       Cos = 1;
@@ -1017,52 +1029,72 @@ IsPointInPad (Coord X, Coord Y, Coord Radius, PadType *Pad)
     }
   else
     {
-      Sin = pad.Point2.Y / r;
-      Cos = pad.Point2.X / r;
+      Sin = dy / r;
+      Cos = dx / r;
     }
-  x = X;
-  X = X * Cos + Y * Sin;
-  Y = Y * Cos - x * Sin;
-  /* now pad.Point2.X = r; pad.Point2.Y = 0; */
-
   /* take into account the ends */
-  if (TEST_FLAG (SQUAREFLAG, Pad))
-    {
-      r += Pad->Thickness;
-      X += t2;
-    }
-  if (Y < 0)
-    Y = -Y;	/* range value is evident now*/
+  if (square)
+    r += Pad->Thickness;
 
-  if (TEST_FLAG (SQUAREFLAG, Pad))
+  for (k = 0; k < N; k++)
     {
-      if (X <= 0)
-	{
-	  if (Y <= t2)
-            range = -X;
+      /* move Point1 to the origin */
+      Coord X = PX[k] - Pad->Point1.X;
+      Coord Y = PY[k] - Pad->Point1.Y;
+      Coord Radius = PRadius[k];
+      Coord x = X, range;
+
+      X = X * Cos + Y * Sin;
+      Y = Y * Cos - x * Sin;
+      /* now pad.Point2.X = r; pad.Point2.Y = 0; */
+
+      if (square)
+        X += t2;
+      if (Y < 0)
+        Y = -Y;	/* range value is evident now*/
+
+      if (square)
+        {
+          if (X <= 0)
+            {
+              if (Y <= t2)
+                range = -X;
+              else
+                {
+                  Hit[k] = Radius > Distance (0, t2, X, Y);
+                  continue;
+                }
+            }
+          else if (X >= r)
+            {
+              if (Y <= t2)
+                range = X - r;
+              else
+                {
+                  Hit[k] = Radius > Distance (r, t2, X, Y);
+                  continue;
+                }
+            }
           else
-	    return Radius > Distance (0, t2, X, Y);
-	}
-      else if (X >= r)
-	{
-	  if (Y <= t2)
-            range = X - r;
-          else 
-	    return Radius > Distance (r, t2, X, Y);
-	}
-      else
-	range = Y - t2;
-    }
-  else/*Rounded pad: even more simple*/
-    {
-      if (X <= 0)
-	return (Radius + t2) > Distance (0, 0, X, Y);
-      else if (X >= r) 
-	return (Radius + t2) > Distance (r, 0, X, Y);
-      else
-	range = Y - t2;
+            range = Y - t2;
+        }
+      else/*Rounded pad: even more simple*/
+        {
+          if (X <= 0)
+            {
+              Hit[k] = (Radius + t2) > Distance (0, 0, X, Y);
+              continue;
+            }
+          else if (X >= r)
+            {
+              Hit[k] = (Radius + t2) > Distance (r, 0, X, Y);
+              continue;
+            }
+          else
+            range = Y - t2;
+        }
+      Hit[k] = range < Radius;
     }
-  return range < Radius;
 }
 
 /*!
@@ -1164,6 +1196,13 @@ IsPointOnArc (Coord X, Coord Y, Coord Radius, ArcType *Arc)
     {
       Coord ArcX, ArcY;
 
+      /* the ends of a circular arc are kept by SetArcBoundingBox() */
+      if (Arc->Width == Arc->Height)
+        return (Distance (X, Y, Arc->Point1.X, Arc->Point1.Y)
+                < Radius + Arc->Thickness / 2
+                || Distance (X, Y, Arc->Point2.X, Arc->Point2.Y)
+                < Radius + Arc->Thickness / 2);
+
       ArcX = Arc->X + Arc->Width *
               cos ((Arc->StartAngle + 180) / RAD_TO_DEG);
       ArcY = Arc->Y - Arc->Width *
@@ -1450,212 +1489,371 @@ SearchObjectByLocation (unsigned Type,
   return (NO_TYPE);
 }
 
-/*!
- * \brief Searches for a object by it's unique ID.
- *
- * It doesn't matter if the object is visible or not.
- *
- * The search is performed on a PCB, a buffer or on the remove list.
+/* ---------------------------------------------------------------------------
+ * ID index
  *
- * The calling routine passes two pointers to allocated memory for
- * storing the results.
+ * Each DataType keeps a hash from the IDs of its objects to what
+ * SearchObjectByID() returns for them, built on the first search and
+ * kept until the objects change.  Any change to the object lists, to
+ * the points of a polygon or to the IDs of objects makes every index
+ * stale, through the object list functions of mymem.c or by calling
+ * IDIndexInvalidate().  The buffer moves and the destruction of objects
+ * that undo and redo are made of update the indices of their source and
+ * destination instead, between IDIndexHold() and IDIndexRelease(), so a
+ * long undo doesn't relabel the board for each object.
+ */
+typedef struct
+{
+  int mask;			/* the search types that find the object */
+  int type;
+  void *ptr1, *ptr2, *ptr3;
+} IDIndexEntry;
+
+static unsigned long IDIndexGeneration = 1;
+
+/*!
+ * \brief Mark the ID indices of all data as stale.
+ */
+void
+IDIndexInvalidate (void)
+{
+  IDIndexGeneration++;
+}
+
+static void
+IDIndexPut (GHashTable *index, long ID, int mask, int type,
+	    void *ptr1, void *ptr2, void *ptr3)
+{
+  IDIndexEntry *entry;
+
+  /* IDs are unique; if not, the first object found keeps the ID, as
+     it did when the objects were searched one by one */
+  if (g_hash_table_lookup (index, GINT_TO_POINTER (ID)))
+    return;
+  entry = g_slice_new (IDIndexEntry);
+  entry->mask = mask;
+  entry->type = type;
+  entry->ptr1 = ptr1;
+  entry->ptr2 = ptr2;
+  entry->ptr3 = ptr3;
+  g_hash_table_insert (index, GINT_TO_POINTER (ID), entry);
+}
+
+static void
+IDIndexFreeEntry (gpointer data)
+{
+  g_slice_free (IDIndexEntry, data);
+}
+
+/*!
+ * \brief Enter an object, and the objects it is made of, in an index.
  *
- * \return A type value is returned too which is NO_TYPE if no objects
- * has been found.
+ * \c Ptr1 is the layer or element the object is on, as SearchObjectByID()
+ * returns it.
  */
-int
-SearchObjectByID (DataType *Base,
-		  void **Result1, void **Result2, void **Result3, int ID,
-		  int type)
+static void
+IDIndexObject (GHashTable *index, int type, void *Ptr1, void *Ptr2)
 {
-  if (type & (LINE_TYPE | LINEPOINT_TYPE))
+  switch (type)
     {
-      ALLLINE_LOOP (Base);
+    case LINE_TYPE:
       {
-	if (line->ID == ID)
-	  {
-	    *Result1 = (void *) layer;
-	    *Result2 = *Result3 = (void *) line;
-	    return (LINE_TYPE);
-	  }
-	if (line->Point1.ID == ID)
-	  {
-	    *Result1 = (void *) layer;
-	    *Result2 = (void *) line;
-	    *Result3 = (void *) &line->Point1;
-	    return (LINEPOINT_TYPE);
-	  }
-	if (line->Point2.ID == ID)
-	  {
-	    *Result1 = (void *) layer;
-	    *Result2 = (void *) line;
-	    *Result3 = (void *) &line->Point2;
-	    return (LINEPOINT_TYPE);
-	  }
+	LineType *line = (LineType *) Ptr2;
+
+	IDIndexPut (index, line->ID, LINE_TYPE | LINEPOINT_TYPE, LINE_TYPE,
+		    Ptr1, line, line);
+	IDIndexPut (index, line->Point1.ID, LINE_TYPE | LINEPOINT_TYPE,
+		    LINEPOINT_TYPE, Ptr1, line, &line->Point1);
+	IDIndexPut (index, line->Point2.ID, LINE_TYPE | LINEPOINT_TYPE,
+		    LINEPOINT_TYPE, Ptr1, line, &line->Point2);
+	break;
       }
-      ENDALL_LOOP;
-    }
-  if (type & ARC_TYPE)
-    {
-      ALLARC_LOOP (Base);
+    case POLYGON_TYPE:
       {
-	if (arc->ID == ID)
-	  {
-	    *Result1 = (void *) layer;
-	    *Result2 = *Result3 = (void *) arc;
-	    return (ARC_TYPE);
-	  }
-      }
-      ENDALL_LOOP;
-    }
+	PolygonType *polygon = (PolygonType *) Ptr2;
 
-  if (type & TEXT_TYPE)
-    {
-      ALLTEXT_LOOP (Base);
+	IDIndexPut (index, polygon->ID, POLYGON_TYPE | POLYGONPOINT_TYPE,
+		    POLYGON_TYPE, Ptr1, polygon, polygon);
+	POLYGONPOINT_LOOP (polygon);
+	{
+	  IDIndexPut (index, point->ID, POLYGONPOINT_TYPE, POLYGONPOINT_TYPE,
+		      Ptr1, polygon, point);
+	}
+	END_LOOP;
+	break;
+      }
+    case RATLINE_TYPE:
       {
-	if (text->ID == ID)
-	  {
-	    *Result1 = (void *) layer;
-	    *Result2 = *Result3 = (void *) text;
-	    return (TEXT_TYPE);
-	  }
+	RatType *rat = (RatType *) Ptr2;
+
+	IDIndexPut (index, rat->ID, RATLINE_TYPE | LINEPOINT_TYPE,
+		    RATLINE_TYPE, rat, rat, rat);
+	IDIndexPut (index, rat->Point1.ID, RATLINE_TYPE | LINEPOINT_TYPE,
+		    LINEPOINT_TYPE, NULL, rat, &rat->Point1);
+	IDIndexPut (index, rat->Point2.ID, RATLINE_TYPE | LINEPOINT_TYPE,
+		    LINEPOINT_TYPE, NULL, rat, &rat->Point2);
+	break;
       }
-      ENDALL_LOOP;
-    }
-
-  if (type & (POLYGON_TYPE | POLYGONPOINT_TYPE))
-    {
-      ALLPOLYGON_LOOP (Base);
+    case ELEMENT_TYPE:
       {
-	if (polygon->ID == ID)
-	  {
-	    *Result1 = (void *) layer;
-	    *Result2 = *Result3 = (void *) polygon;
-	    return (POLYGON_TYPE);
-	  }
-	if (type & POLYGONPOINT_TYPE)
-	  POLYGONPOINT_LOOP (polygon);
+	ElementType *element = (ElementType *) Ptr2;
+
+	IDIndexPut (index, element->ID, ELEMENT_TYPE | PAD_TYPE | PIN_TYPE
+		    | ELEMENTLINE_TYPE | ELEMENTNAME_TYPE | ELEMENTARC_TYPE,
+		    ELEMENT_TYPE, element, element, element);
+	ELEMENTLINE_LOOP (element);
+	{
+	  IDIndexPut (index, line->ID, ELEMENTLINE_TYPE, ELEMENTLINE_TYPE,
+		      element, line, line);
+	}
+	END_LOOP;
+	ARC_LOOP (element);
+	{
+	  IDIndexPut (index, arc->ID, ELEMENTARC_TYPE, ELEMENTARC_TYPE,
+		      element, arc, arc);
+	}
+	END_LOOP;
+	ELEMENTTEXT_LOOP (element);
+	{
+	  IDIndexPut (index, text->ID, ELEMENTNAME_TYPE, ELEMENTNAME_TYPE,
+		      element, text, text);
+	}
+	END_LOOP;
+	PIN_LOOP (element);
+	{
+	  IDIndexPut (index, pin->ID, PIN_TYPE, PIN_TYPE, element, pin, pin);
+	}
+	END_LOOP;
+	PAD_LOOP (element);
 	{
-	  if (point->ID == ID)
-	    {
-	      *Result1 = (void *) layer;
-	      *Result2 = (void *) polygon;
-	      *Result3 = (void *) point;
-	      return (POLYGONPOINT_TYPE);
-	    }
+	  IDIndexPut (index, pad->ID, PAD_TYPE, PAD_TYPE, element, pad, pad);
 	}
 	END_LOOP;
+	break;
       }
-      ENDALL_LOOP;
+    case VIA_TYPE:
+      IDIndexPut (index, ((AnyObjectType *) Ptr2)->ID, type, type,
+		  Ptr2, Ptr2, Ptr2);
+      break;
+    default:
+      IDIndexPut (index, ((AnyObjectType *) Ptr2)->ID, type, type,
+		  Ptr1, Ptr2, Ptr2);
+      break;
     }
-  if (type & VIA_TYPE)
+}
+
+/*!
+ * \brief Take an object, and the objects it is made of, out of an index.
+ */
+static void
+IDIndexForget (GHashTable *index, int type, void *Ptr2)
+{
+  switch (type)
     {
-      VIA_LOOP (Base);
+    case LINE_TYPE:
       {
-	if (via->ID == ID)
-	  {
-	    *Result1 = *Result2 = *Result3 = (void *) via;
-	    return (VIA_TYPE);
-	  }
+	LineType *line = (LineType *) Ptr2;
+
+	g_hash_table_remove (index, GINT_TO_POINTER (line->Point1.ID));
+	g_hash_table_remove (index, GINT_TO_POINTER (line->Point2.ID));
+	break;
       }
-      END_LOOP;
-    }
+    case RATLINE_TYPE:
+      {
+	RatType *rat = (RatType *) Ptr2;
 
-  if (type & (RATLINE_TYPE | LINEPOINT_TYPE))
-    {
-      RAT_LOOP (Base);
+	g_hash_table_remove (index, GINT_TO_POINTER (rat->Point1.ID));
+	g_hash_table_remove (index, GINT_TO_POINTER (rat->Point2.ID));
+	break;
+      }
+    case POLYGON_TYPE:
+      POLYGONPOINT_LOOP ((PolygonType *) Ptr2);
       {
-	if (line->ID == ID)
-	  {
-	    *Result1 = *Result2 = *Result3 = (void *) line;
-	    return (RATLINE_TYPE);
-	  }
-	if (line->Point1.ID == ID)
-	  {
-	    *Result1 = (void *) NULL;
-	    *Result2 = (void *) line;
-	    *Result3 = (void *) &line->Point1;
-	    return (LINEPOINT_TYPE);
-	  }
-	if (line->Point2.ID == ID)
-	  {
-	    *Result1 = (void *) NULL;
-	    *Result2 = (void *) line;
-	    *Result3 = (void *) &line->Point2;
-	    return (LINEPOINT_TYPE);
-	  }
+	g_hash_table_remove (index, GINT_TO_POINTER (point->ID));
       }
       END_LOOP;
-    }
-
-  if (type & (ELEMENT_TYPE | PAD_TYPE | PIN_TYPE
-      | ELEMENTLINE_TYPE | ELEMENTNAME_TYPE
-      | ELEMENTARC_TYPE))
-    /* check pins and elementnames too */
-    ELEMENT_LOOP (Base);
-  {
-    if (element->ID == ID)
+      break;
+    case ELEMENT_TYPE:
       {
-	*Result1 = *Result2 = *Result3 = (void *) element;
-	return (ELEMENT_TYPE);
-      }
-    if (type & ELEMENTLINE_TYPE)
-      ELEMENTLINE_LOOP (element);
-    {
-      if (line->ID == ID)
+	ElementType *element = (ElementType *) Ptr2;
+
+	ELEMENTLINE_LOOP (element);
 	{
-	  *Result1 = (void *) element;
-	  *Result2 = *Result3 = (void *) line;
-	  return (ELEMENTLINE_TYPE);
+	  g_hash_table_remove (index, GINT_TO_POINTER (line->ID));
 	}
-    }
-    END_LOOP;
-    if (type & ELEMENTARC_TYPE)
-      ARC_LOOP (element);
-    {
-      if (arc->ID == ID)
+	END_LOOP;
+	ARC_LOOP (element);
 	{
-	  *Result1 = (void *) element;
-	  *Result2 = *Result3 = (void *) arc;
-	  return (ELEMENTARC_TYPE);
+	  g_hash_table_remove (index, GINT_TO_POINTER (arc->ID));
 	}
-    }
-    END_LOOP;
-    if (type & ELEMENTNAME_TYPE)
-      ELEMENTTEXT_LOOP (element);
-    {
-      if (text->ID == ID)
+	END_LOOP;
+	ELEMENTTEXT_LOOP (element);
 	{
-	  *Result1 = (void *) element;
-	  *Result2 = *Result3 = (void *) text;
-	  return (ELEMENTNAME_TYPE);
+	  g_hash_table_remove (index, GINT_TO_POINTER (text->ID));
 	}
-    }
-    END_LOOP;
-    if (type & PIN_TYPE)
-      PIN_LOOP (element);
-    {
-      if (pin->ID == ID)
+	END_LOOP;
+	PIN_LOOP (element);
 	{
-	  *Result1 = (void *) element;
-	  *Result2 = *Result3 = (void *) pin;
-	  return (PIN_TYPE);
+	  g_hash_table_remove (index, GINT_TO_POINTER (pin->ID));
 	}
-    }
-    END_LOOP;
-    if (type & PAD_TYPE)
-      PAD_LOOP (element);
-    {
-      if (pad->ID == ID)
+	END_LOOP;
+	PAD_LOOP (element);
 	{
-	  *Result1 = (void *) element;
-	  *Result2 = *Result3 = (void *) pad;
-	  return (PAD_TYPE);
+	  g_hash_table_remove (index, GINT_TO_POINTER (pad->ID));
 	}
+	END_LOOP;
+	break;
+      }
     }
-    END_LOOP;
+  g_hash_table_remove (index, GINT_TO_POINTER (((AnyObjectType *) Ptr2)->ID));
+}
+
+/*!
+ * \brief Make sure the ID index of Data describes its objects.
+ */
+static void
+IDIndexUpdate (DataType *Data)
+{
+  if (Data->IDIndex && Data->IDIndexGeneration == IDIndexGeneration)
+    return;
+
+  if (Data->IDIndex)
+    g_hash_table_remove_all (Data->IDIndex);
+  else
+    Data->IDIndex = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+					   NULL, IDIndexFreeEntry);
+
+  ALLLINE_LOOP (Data);
+  {
+    IDIndexObject (Data->IDIndex, LINE_TYPE, layer, line);
+  }
+  ENDALL_LOOP;
+  ALLARC_LOOP (Data);
+  {
+    IDIndexObject (Data->IDIndex, ARC_TYPE, layer, arc);
+  }
+  ENDALL_LOOP;
+  ALLTEXT_LOOP (Data);
+  {
+    IDIndexObject (Data->IDIndex, TEXT_TYPE, layer, text);
+  }
+  ENDALL_LOOP;
+  ALLPOLYGON_LOOP (Data);
+  {
+    IDIndexObject (Data->IDIndex, POLYGON_TYPE, layer, polygon);
+  }
+  ENDALL_LOOP;
+  VIA_LOOP (Data);
+  {
+    IDIndexObject (Data->IDIndex, VIA_TYPE, via, via);
+  }
+  END_LOOP;
+  RAT_LOOP (Data);
+  {
+    IDIndexObject (Data->IDIndex, RATLINE_TYPE, line, line);
   }
   END_LOOP;
+  ELEMENT_LOOP (Data);
+  {
+    IDIndexObject (Data->IDIndex, ELEMENT_TYPE, element, element);
+  }
+  END_LOOP;
+
+  Data->IDIndexGeneration = IDIndexGeneration;
+}
+
+/*!
+ * \brief Free the ID index of Data, when Data goes.
+ */
+void
+IDIndexFree (DataType *Data)
+{
+  if (Data->IDIndex)
+    g_hash_table_destroy (Data->IDIndex);
+  Data->IDIndex = NULL;
+}
+
+/*!
+ * \brief Start a change to objects that keeps the ID indices up to date.
+ *
+ * \return the generation the indices have to be of to be kept.
+ */
+unsigned long
+IDIndexHold (void)
+{
+  return IDIndexGeneration;
+}
+
+/*!
+ * \brief Note that an object of Data is going.
+ *
+ * Must be called while the object is still whole.
+ */
+void
+IDIndexRemove (DataType *Data, unsigned long Held, int Type, void *Ptr2)
+{
+  if (Data && Data->IDIndex && Data->IDIndexGeneration == Held)
+    IDIndexForget (Data->IDIndex, Type, Ptr2);
+}
+
+/*!
+ * \brief Note that an object is now part of Data, on layer or element
+ * Ptr1.
+ */
+void
+IDIndexAdd (DataType *Data, unsigned long Held, int Type, void *Ptr1,
+	    void *Ptr2)
+{
+  if (Data && Data->IDIndex && Data->IDIndexGeneration == Held)
+    IDIndexObject (Data->IDIndex, Type, Ptr1, Ptr2);
+}
+
+/*!
+ * \brief End a change started by IDIndexHold().
+ *
+ * The indices of Data1 and Data2 that were up to date when the change
+ * started, and have been told of it, are taken as up to date again.
+ */
+void
+IDIndexRelease (unsigned long Held, DataType *Data1, DataType *Data2)
+{
+  if (Data1 && Data1->IDIndex && Data1->IDIndexGeneration == Held)
+    Data1->IDIndexGeneration = IDIndexGeneration;
+  if (Data2 && Data2->IDIndex && Data2->IDIndexGeneration == Held)
+    Data2->IDIndexGeneration = IDIndexGeneration;
+}
+
+/*!
+ * \brief Searches for a object by it's unique ID.
+ *
+ * It doesn't matter if the object is visible or not.
+ *
+ * The search is performed on a PCB, a buffer or on the remove list,
+ * through the ID index of the data.
+ *
+ * The calling routine passes two pointers to allocated memory for
+ * storing the results.
+ *
+ * \return A type value is returned too which is NO_TYPE if no objects
+ * has been found.
+ */
+int
+SearchObjectByID (DataType *Base,
+		  void **Result1, void **Result2, void **Result3, int ID,
+		  int type)
+{
+  IDIndexEntry *entry;
+
+  IDIndexUpdate (Base);
+  entry = (IDIndexEntry *) g_hash_table_lookup (Base->IDIndex,
+						GINT_TO_POINTER (ID));
+  if (entry && (entry->mask & type))
+    {
+      *Result1 = entry->ptr1;
+      *Result2 = entry->ptr2;
+      *Result3 = entry->ptr3;
+      return (entry->type);
+    }
 
 #ifdef DEBUG
   Message ("hace: Internal error, search for ID %d failed\n", ID);
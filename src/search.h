@@ -83,10 +83,18 @@ bool IsLineInRectangle (Coord, Coord, Coord, Coord, LineType *);
 bool IsLineInQuadrangle (PointType p[4], LineType * Line);
 bool IsArcInRectangle (Coord, Coord, Coord, Coord, ArcType *);
 bool IsPointInPad (Coord, Coord, Coord, PadType *);
+void PointsInPad (const Coord *, const Coord *, const Coord *, bool *, Cardinal,
+                  PadType *);
 bool IsPointInBox (Coord, Coord, BoxType *, Coord);
 int SearchObjectByLocation (unsigned, void **, void **, void **, Coord, Coord, Coord);
 int SearchScreen (Coord, Coord, int, void **, void **, void **);
 int SearchObjectByID (DataType *, void **, void **, void **, int, int);
+void IDIndexInvalidate (void);
+void IDIndexFree (DataType *);
+unsigned long IDIndexHold (void);
+void IDIndexRemove (DataType *, unsigned long, int, void *);
+void IDIndexAdd (DataType *, unsigned long, int, void *, void *);
+void IDIndexRelease (unsigned long, DataType *, DataType *);
 ElementType * SearchElementByName (DataType *, char *);
 int SearchLayerByName (DataType *Base, char *Name);
 #endif
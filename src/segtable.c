@@ -0,0 +1,156 @@
+/*!
+ * \file src/segtable.c
+ *
+ * \brief Dense tables of the line segments of the layers.
+ *
+ * A LineType keeps its flags, attributes, list links and bounding box
+ * next to its coordinates, so a loop over the lines of a layer that only
+ * wants the geometry reads a line of memory per object, wherever the
+ * allocator put it.  The tables hold the coordinates, thickness and
+ * clearance of the lines of each layer of the board in arrays of their
+ * own, in the order of the layer's list, for loops that go over all of
+ * them.
+ *
+ * The tables are made for the board when asked for and kept while it is
+ * unchanged: until the r-trees change, as they do when a line is added,
+ * removed, moved or resized, or SetChangedFlag() marks a change.
+ * They are only to be used from the main thread.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+
+#include "global.h"
+#include "data.h"
+#include "macro.h"
+#include "rtree.h"
+#include "segtable.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+static struct
+{
+  SegmentTableType layer[MAX_ALL_LAYER];
+  PCBType *pcb; /*!< Board the tables are for, NULL if stale. */
+  unsigned long generation; /*!< r_generation() they were made at. */
+} Segments;
+
+/*!
+ * \brief Mark the segment tables as stale.
+ *
+ * Called by SetChangedFlag(), which may run on several threads at once.
+ */
+void
+SegmentTableInvalidate (void)
+{
+  g_atomic_pointer_set (&Segments.pcb, NULL);
+}
+
+static void
+grow_table (SegmentTableType *t, Cardinal n)
+{
+  if (n <= t->max)
+    return;
+  t->max = MAX (n, 2 * t->max);
+  t->x1 = (Coord *) realloc (t->x1, t->max * sizeof (Coord));
+  t->y1 = (Coord *) realloc (t->y1, t->max * sizeof (Coord));
+  t->x2 = (Coord *) realloc (t->x2, t->max * sizeof (Coord));
+  t->y2 = (Coord *) realloc (t->y2, t->max * sizeof (Coord));
+  t->thickness = (Coord *) realloc (t->thickness, t->max * sizeof (Coord));
+  t->clearance = (Coord *) realloc (t->clearance, t->max * sizeof (Coord));
+  t->line = (LineType **) realloc (t->line, t->max * sizeof (LineType *));
+}
+
+static void
+fill_table (SegmentTableType *t, LayerType *layer)
+{
+  Cardinal i = 0;
+
+  grow_table (t, layer->LineN);
+  LINE_LOOP (layer);
+  {
+    t->x1[i] = line->Point1.X;
+    t->y1[i] = line->Point1.Y;
+    t->x2[i] = line->Point2.X;
+    t->y2[i] = line->Point2.Y;
+    t->thickness[i] = line->Thickness;
+    t->clearance[i] = line->Clearance;
+    t->line[i] = line;
+    i++;
+  }
+  END_LOOP;
+  t->n = i;
+}
+
+/*!
+ * \brief Return the segment table of a layer of the board, made anew if
+ * the board changed since it was made.
+ */
+SegmentTableType *
+GetSegmentTable (Cardinal layer)
+{
+  int l;
+
+  if (Segments.pcb != PCB || Segments.generation != r_generation ())
+    {
+      for (l = 0; l < max_copper_layer + SILK_LAYER; l++)
+	fill_table (&Segments.layer[l], &PCB->Data->Layer[l]);
+      for (; l < MAX_ALL_LAYER; l++)
+	Segments.layer[l].n = 0;
+      Segments.generation = r_generation ();
+      Segments.pcb = PCB;
+    }
+  return &Segments.layer[layer];
+}
+
+/*!
+ * \brief Extend a box to take in the segments of a table, with their
+ * thickness.
+ */
+void
+SegmentTableBounds (const SegmentTableType *t, BoxType *box)
+{
+  Coord x1 = box->X1, y1 = box->Y1, x2 = box->X2, y2 = box->Y2;
+  Cardinal i;
+
+  for (i = 0; i < t->n; i++)
+    {
+      Coord half = t->thickness[i] / 2;
+
+      x1 = MIN (x1, MIN (t->x1[i], t->x2[i]) - half);
+      y1 = MIN (y1, MIN (t->y1[i], t->y2[i]) - half);
+      x2 = MAX (x2, MAX (t->x1[i], t->x2[i]) + half);
+      y2 = MAX (y2, MAX (t->y1[i], t->y2[i]) + half);
+    }
+  box->X1 = x1;
+  box->Y1 = y1;
+  box->X2 = x2;
+  box->Y2 = y2;
+}
@@ -49,6 +49,8 @@
 #include "rats.h"
 #include "misc.h"
 #include "find.h"
+#include "polygon.h"
+#include "rtree.h"
 
 #include <sys/types.h>
 #ifdef HAVE_REGEX_H
@@ -533,6 +535,9 @@ SelectedOperation (ObjectFunctionType *F, bool Reset, int type)
 {
   bool changed = false;
 
+  DeferDraw ();
+  DeferPolygonClipping ();
+
   /* check lines */
   if (type & LINE_TYPE && F->Line)
     VISIBLELINE_LOOP (PCB->Data);
@@ -708,6 +713,8 @@ SelectedOperation (ObjectFunctionType *F, bool Reset, int type)
       }
   }
   END_LOOP;
+  ResumePolygonClipping ();
+  ResumeDraw ();
   if (Reset && changed)
     IncrementUndoSerialNumber ();
   return (changed);
@@ -818,13 +825,54 @@ SelectByFlag (int flag, bool select)
   return (changed);
 }
 
-#if defined(HAVE_REGCOMP) || defined(HAVE_RE_COMP)
-/*!
- * \brief Selects objects as defined by Type by name; it's a case
- * insensitive match.
+/* ---------------------------------------------------------------------------
+ * selection by name
  *
- * \return true if any object has been selected.
+ * A pattern is a regular expression that has to match all of a name,
+ * ignoring case.  Most patterns a script passes are plain names though,
+ * a reference designator or a net name, and those are looked up in an
+ * index of the names on the board instead of being matched against
+ * every object.  The index is built on the first lookup and kept until
+ * the board changes: renames and most edits go through SetChangedFlag(),
+ * which calls SelectNameIndexInvalidate(), and anything that goes in or
+ * out of the r-trees of the objects changes r_generation().  Compiled regular expressions
+ * are kept too, so a pattern used again isn't compiled again.
+ */
+
+enum
+{
+  NAME_TEXT, NAME_ELEMENT, NAME_PIN, NAME_PAD, NAME_VIA, NAME_NET,
+  NAME_KINDS
+};
+
+#if defined(HAVE_REGCOMP)
+static struct
+{
+  /* by kind: a name to an array of pairs of the parents and objects */
+  GHashTable *table[NAME_KINDS];
+  PCBType *pcb;
+  unsigned long generation;
+  int name_index; /*!< NAME_INDEX() the element names are from. */
+  LibraryMenuType *nets; /*!< PCB->NetlistLib.Menu when built. */
+  Cardinal netN;
+} name_index;
+
+static GHashTable *regex_cache = NULL;
+#define REGEX_CACHE_MAX 256
+#endif
+
+/*!
+ * \brief Mark the index of the names on the board as stale.
  */
+void
+SelectNameIndexInvalidate (void)
+{
+#if defined(HAVE_REGCOMP)
+  name_index.pcb = NULL;
+#endif
+}
+
+#if defined(HAVE_REGCOMP) || defined(HAVE_RE_COMP)
 #if defined (HAVE_REGCOMP)
 static int
 regexec_match_all (const  regex_t  *preg,  const  char  *string)
@@ -839,163 +887,452 @@ regexec_match_all (const  regex_t  *preg,  const  char  *string)
     return 0;
   return 1;
 }
-#endif
 
-bool
-SelectObjectByName (int Type, char *Pattern, bool select)
+/* the names are matched ignoring case, as REG_ICASE does */
+static guint
+name_hash (gconstpointer key)
 {
-  bool changed = false;
+  const char *p;
+  guint h = 5381;
 
-#if defined(HAVE_REGCOMP)
-#define	REGEXEC(arg)	(regexec_match_all(&compiled, (arg)))
+  for (p = (const char *) key; *p; p++)
+    h = h * 33 + g_ascii_tolower (*p);
+  return h;
+}
+
+static gboolean
+name_equal (gconstpointer a, gconstpointer b)
+{
+  return g_ascii_strcasecmp ((const char *) a, (const char *) b) == 0;
+}
+
+static void
+free_name_entries (gpointer data)
+{
+  g_ptr_array_free ((GPtrArray *) data, TRUE);
+}
+
+static void
+add_name (int kind, char *name, void *ptr1, void *ptr2)
+{
+  GPtrArray *entries;
+
+  if (name == NULL || *name == '\0')
+    return;
+  entries = (GPtrArray *) g_hash_table_lookup (name_index.table[kind], name);
+  if (entries == NULL)
+    {
+      entries = g_ptr_array_new ();
+      g_hash_table_insert (name_index.table[kind], name, entries);
+    }
+  g_ptr_array_add (entries, ptr1);
+  g_ptr_array_add (entries, ptr2);
+}
 
+/*!
+ * \brief Make sure the index of the names describes the board.
+ */
+static void
+NameIndexUpdate (void)
+{
+  int kind;
+
+  if (name_index.table[0] && name_index.pcb == PCB
+      && name_index.generation == r_generation ()
+      && name_index.name_index == NAME_INDEX (PCB)
+      && name_index.nets == PCB->NetlistLib.Menu
+      && name_index.netN == PCB->NetlistLib.MenuN)
+    return;
+
+  for (kind = 0; kind < NAME_KINDS; kind++)
+    if (name_index.table[kind])
+      g_hash_table_remove_all (name_index.table[kind]);
+    else
+      name_index.table[kind] =
+	g_hash_table_new_full (name_hash, name_equal, NULL, free_name_entries);
+
+  ALLTEXT_LOOP (PCB->Data);
+  {
+    add_name (NAME_TEXT, text->TextString, layer, text);
+  }
+  ENDALL_LOOP;
+  ELEMENT_LOOP (PCB->Data);
+  {
+    add_name (NAME_ELEMENT, ELEMENT_NAME (PCB, element), element, element);
+    PIN_LOOP (element);
+    {
+      add_name (NAME_PIN, pin->Name, element, pin);
+    }
+    END_LOOP;
+    PAD_LOOP (element);
+    {
+      add_name (NAME_PAD, pad->Name, element, pad);
+    }
+    END_LOOP;
+  }
+  END_LOOP;
+  VIA_LOOP (PCB->Data);
+  {
+    add_name (NAME_VIA, via->Name, via, via);
+  }
+  END_LOOP;
+  /* Name[0] and Name[1] are special purpose, not the actual name*/
+  MENU_LOOP (&PCB->NetlistLib);
+  {
+    if (menu->Name && menu->Name[0] != '\0' && menu->Name[1] != '\0')
+      add_name (NAME_NET, menu->Name + 2, menu, menu);
+  }
+  END_LOOP;
+
+  name_index.pcb = PCB;
+  name_index.generation = r_generation ();
+  name_index.name_index = NAME_INDEX (PCB);
+  name_index.nets = PCB->NetlistLib.Menu;
+  name_index.netN = PCB->NetlistLib.MenuN;
+}
+
+static void
+free_regex (gpointer data)
+{
+#if !defined(sgi)
+  regfree ((regex_t *) data);
+#endif
+  free (data);
+}
+
+/*!
+ * \brief Get a pattern compiled.
+ *
+ * \return NULL if it isn't a valid regular expression.
+ */
+static regex_t *
+CompilePattern (const char *Pattern)
+{
+  regex_t *compiled;
   int result;
-  regex_t compiled;
 
-  /* compile the regular expression */
-  result = regcomp (&compiled, Pattern, REG_EXTENDED | REG_ICASE);
+  if (regex_cache == NULL)
+    regex_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+					 free, free_regex);
+  compiled = (regex_t *) g_hash_table_lookup (regex_cache, Pattern);
+  if (compiled)
+    return compiled;
+
+  compiled = (regex_t *) malloc (sizeof (*compiled));
+  result = regcomp (compiled, Pattern, REG_EXTENDED | REG_ICASE);
   if (result)
     {
       char errorstring[128];
 
-      regerror (result, &compiled, errorstring, 128);
+      regerror (result, compiled, errorstring, 128);
       Message (_("regexp error: %s\n"), errorstring);
-      regfree (&compiled);
-      return (false);
+      free_regex (compiled);
+      return NULL;
     }
+  if (g_hash_table_size (regex_cache) >= REGEX_CACHE_MAX)
+    g_hash_table_remove_all (regex_cache);
+  g_hash_table_insert (regex_cache, strdup (Pattern), compiled);
+  return compiled;
+}
+
+/*!
+ * \brief Whether a pattern can only match the name it spells.
+ */
+static bool
+IsPlainName (const char *Pattern)
+{
+  return *Pattern != '\0' && strpbrk (Pattern, ".[]()*+?{}|^$\\") == NULL;
+}
+#endif
+
+/*!
+ * \brief The patterns of one selection.
+ *
+ * Plain names are kept apart from the regular expressions, to be looked
+ * up rather than matched.
+ */
+typedef struct
+{
+#if defined(HAVE_REGCOMP)
+  GHashTable *names;
+  GPtrArray *regexes;
 #else
-#define	REGEXEC(arg)	(re_exec((arg)) == 1)
+  int unused;
+#endif
+} NameMatchType;
+
+static bool
+NameMatches (NameMatchType *match, const char *name)
+{
+#if defined(HAVE_REGCOMP)
+  guint i;
+
+  if (name == NULL)
+    return false;
+  if (g_hash_table_contains (match->names, name))
+    return true;
+  for (i = 0; i < match->regexes->len; i++)
+    if (regexec_match_all ((regex_t *) g_ptr_array_index (match->regexes, i),
+			   name))
+      return true;
+  return false;
+#else
+  return name != NULL && re_exec (name) == 1;
+#endif
+}
+
+static bool
+SelectTextByName (LayerType *layer, TextType *text, bool select)
+{
+  if (TEST_FLAG (LOCKFLAG, text)
+      || !TEXT_IS_VISIBLE (PCB, layer, text)
+      || TEST_FLAG (SELECTEDFLAG, text) == select)
+    return false;
+  AddObjectToFlagUndoList (TEXT_TYPE, layer, text, text);
+  ASSIGN_FLAG (SELECTEDFLAG, select, text);
+  DrawText (layer, text);
+  return true;
+}
+
+static bool
+SelectElementByName (ElementType *element, bool select)
+{
+  if (TEST_FLAG (LOCKFLAG, element)
+      || ((TEST_FLAG (ONSOLDERFLAG, element) != 0) != SWAP_IDENT
+	  && !PCB->InvisibleObjectsOn)
+      || TEST_FLAG (SELECTEDFLAG, element) == select)
+    return false;
+  AddObjectToFlagUndoList (ELEMENT_TYPE, element, element, element);
+  ASSIGN_FLAG (SELECTEDFLAG, select, element);
+  PIN_LOOP (element);
+  {
+    AddObjectToFlagUndoList (PIN_TYPE, element, pin, pin);
+    ASSIGN_FLAG (SELECTEDFLAG, select, pin);
+  }
+  END_LOOP;
+  PAD_LOOP (element);
+  {
+    AddObjectToFlagUndoList (PAD_TYPE, element, pad, pad);
+    ASSIGN_FLAG (SELECTEDFLAG, select, pad);
+  }
+  END_LOOP;
+  ELEMENTTEXT_LOOP (element);
+  {
+    AddObjectToFlagUndoList (ELEMENTNAME_TYPE, element, text, text);
+    ASSIGN_FLAG (SELECTEDFLAG, select, text);
+  }
+  END_LOOP;
+  DrawElementName (element);
+  DrawElement (element);
+  return true;
+}
+
+static bool
+SelectPinByName (ElementType *element, PinType *pin, bool select)
+{
+  if (TEST_FLAG (LOCKFLAG, element)
+      || TEST_FLAG (SELECTEDFLAG, pin) == select)
+    return false;
+  AddObjectToFlagUndoList (PIN_TYPE, element, pin, pin);
+  ASSIGN_FLAG (SELECTEDFLAG, select, pin);
+  DrawPin (pin);
+  return true;
+}
+
+static bool
+SelectPadByName (ElementType *element, PadType *pad, bool select)
+{
+  if (TEST_FLAG (LOCKFLAG, element)
+      || ((TEST_FLAG (ONSOLDERFLAG, pad) != 0) != SWAP_IDENT
+	  && !PCB->InvisibleObjectsOn)
+      || TEST_FLAG (SELECTEDFLAG, pad) == select)
+    return false;
+  AddObjectToFlagUndoList (PAD_TYPE, element, pad, pad);
+  ASSIGN_FLAG (SELECTEDFLAG, select, pad);
+  DrawPad (pad);
+  return true;
+}
+
+static bool
+SelectViaByName (PinType *via, bool select)
+{
+  if (TEST_FLAG (LOCKFLAG, via)
+      || TEST_FLAG (SELECTEDFLAG, via) == select)
+    return false;
+  AddObjectToFlagUndoList (VIA_TYPE, via, via, via);
+  ASSIGN_FLAG (SELECTEDFLAG, select, via);
+  DrawVia (via);
+  return true;
+}
+
+/*!
+ * \brief Mark what a net connects to as found.
+ */
+static void
+FindNetByName (LibraryMenuType *menu)
+{
+  Cardinal i;
+  LibraryEntryType *entry;
+  ConnectionType conn;
+
+  for (i = menu->EntryN, entry = menu->Entry; i; i--, entry++)
+    if (SeekPad (entry, &conn, false))
+      RatFindHook (conn.type, conn.ptr1, conn.ptr2, conn.ptr2,
+		   true, FOUNDFLAG, true);
+}
 
-  char *compiled;
+#if defined(HAVE_REGCOMP)
+/*!
+ * \brief Select the objects of kind that have one of the plain names.
+ */
+static bool
+SelectIndexedNames (int kind, NameMatchType *match, bool select)
+{
+  GHashTableIter iter;
+  gpointer name;
+  bool changed = false;
+  guint i;
 
-  /* compile the regular expression */
-  if ((compiled = re_comp (Pattern)) != NULL)
+  g_hash_table_iter_init (&iter, match->names);
+  while (g_hash_table_iter_next (&iter, &name, NULL))
     {
-      Message (_("re_comp error: %s\n"), compiled);
-      return (false);
+      GPtrArray *entries =
+	(GPtrArray *) g_hash_table_lookup (name_index.table[kind], name);
+
+      for (i = 0; entries && i < entries->len; i += 2)
+	{
+	  void *ptr1 = g_ptr_array_index (entries, i);
+	  void *ptr2 = g_ptr_array_index (entries, i + 1);
+
+	  switch (kind)
+	    {
+	    case NAME_TEXT:
+	      changed = SelectTextByName ((LayerType *) ptr1,
+					  (TextType *) ptr2, select) || changed;
+	      break;
+	    case NAME_ELEMENT:
+	      changed = SelectElementByName ((ElementType *) ptr1, select)
+		|| changed;
+	      break;
+	    case NAME_PIN:
+	      changed = SelectPinByName ((ElementType *) ptr1,
+					 (PinType *) ptr2, select) || changed;
+	      break;
+	    case NAME_PAD:
+	      changed = SelectPadByName ((ElementType *) ptr1,
+					 (PadType *) ptr2, select) || changed;
+	      break;
+	    case NAME_VIA:
+	      changed = SelectViaByName ((PinType *) ptr1, select) || changed;
+	      break;
+	    case NAME_NET:
+	      FindNetByName ((LibraryMenuType *) ptr1);
+	      break;
+	    }
+	}
     }
+  return changed;
+}
+#endif
+
+/*!
+ * \brief Select or unselect the objects of the types whose name match.
+ *
+ * With only plain names the index is used, else every object with a
+ * name is matched.
+ */
+static bool
+SelectMatchingNames (int Type, NameMatchType *match, bool select)
+{
+  bool changed = false;
+#if defined(HAVE_REGCOMP)
+  bool indexed = match->regexes->len == 0;
+
+  if (indexed)
+    NameIndexUpdate ();
+#define SELECT_INDEXED(kind) \
+  (changed = SelectIndexedNames ((kind), match, select) || changed)
+#else
+  bool indexed = false;
+#define SELECT_INDEXED(kind) (void) 0
 #endif
 
   /* loop over all visible objects with names */
   if (Type & TEXT_TYPE)
-    ALLTEXT_LOOP (PCB->Data);
-  {
-    if (!TEST_FLAG (LOCKFLAG, text)
-	&& TEXT_IS_VISIBLE (PCB, layer, text)
-	&& text->TextString
-	&& REGEXEC (text->TextString)
-	&& TEST_FLAG (SELECTEDFLAG, text) != select)
+    {
+      if (indexed)
+	SELECT_INDEXED (NAME_TEXT);
+      else
+	ALLTEXT_LOOP (PCB->Data);
       {
-	AddObjectToFlagUndoList (TEXT_TYPE, layer, text, text);
-	ASSIGN_FLAG (SELECTEDFLAG, select, text);
-	DrawText (layer, text);
-	changed = true;
+	if (NameMatches (match, text->TextString))
+	  changed = SelectTextByName (layer, text, select) || changed;
       }
-  }
-  ENDALL_LOOP;
+      ENDALL_LOOP;
+    }
 
   if (PCB->ElementOn && (Type & ELEMENT_TYPE))
-    ELEMENT_LOOP (PCB->Data);
-  {
-    if (!TEST_FLAG (LOCKFLAG, element)
-	&& ((TEST_FLAG (ONSOLDERFLAG, element) != 0) == SWAP_IDENT
-	    || PCB->InvisibleObjectsOn)
-	&& TEST_FLAG (SELECTEDFLAG, element) != select)
+    {
+      if (indexed)
+	SELECT_INDEXED (NAME_ELEMENT);
+      else
+	ELEMENT_LOOP (PCB->Data);
       {
-	String name = ELEMENT_NAME (PCB, element);
-	if (name && REGEXEC (name))
-	  {
-	    AddObjectToFlagUndoList (ELEMENT_TYPE, element, element, element);
-	    ASSIGN_FLAG (SELECTEDFLAG, select, element);
-	    PIN_LOOP (element);
-	    {
-	      AddObjectToFlagUndoList (PIN_TYPE, element, pin, pin);
-	      ASSIGN_FLAG (SELECTEDFLAG, select, pin);
-	    }
-	    END_LOOP;
-	    PAD_LOOP (element);
-	    {
-	      AddObjectToFlagUndoList (PAD_TYPE, element, pad, pad);
-	      ASSIGN_FLAG (SELECTEDFLAG, select, pad);
-	    }
-	    END_LOOP;
-	    ELEMENTTEXT_LOOP (element);
-	    {
-	      AddObjectToFlagUndoList (ELEMENTNAME_TYPE, element, text, text);
-	      ASSIGN_FLAG (SELECTEDFLAG, select, text);
-	    }
-	    END_LOOP;
-	    DrawElementName (element);
-	    DrawElement (element);
-	    changed = true;
-	  }
+	if (NameMatches (match, ELEMENT_NAME (PCB, element)))
+	  changed = SelectElementByName (element, select) || changed;
       }
-  }
-  END_LOOP;
+      END_LOOP;
+    }
   if (PCB->PinOn && (Type & PIN_TYPE))
-    ALLPIN_LOOP (PCB->Data);
-  {
-    if (!TEST_FLAG (LOCKFLAG, element)
-	&& pin->Name && REGEXEC (pin->Name)
-	&& TEST_FLAG (SELECTEDFLAG, pin) != select)
+    {
+      if (indexed)
+	SELECT_INDEXED (NAME_PIN);
+      else
+	ALLPIN_LOOP (PCB->Data);
       {
-	AddObjectToFlagUndoList (PIN_TYPE, element, pin, pin);
-	ASSIGN_FLAG (SELECTEDFLAG, select, pin);
-	DrawPin (pin);
-	changed = true;
+	if (NameMatches (match, pin->Name))
+	  changed = SelectPinByName (element, pin, select) || changed;
       }
-  }
-  ENDALL_LOOP;
+      ENDALL_LOOP;
+    }
   if (PCB->PinOn && (Type & PAD_TYPE))
-    ALLPAD_LOOP (PCB->Data);
-  {
-    if (!TEST_FLAG (LOCKFLAG, element)
-	&& ((TEST_FLAG (ONSOLDERFLAG, pad) != 0) == SWAP_IDENT
-	    || PCB->InvisibleObjectsOn)
-	&& TEST_FLAG (SELECTEDFLAG, pad) != select)
-      if (pad->Name && REGEXEC (pad->Name))
-	{
-	  AddObjectToFlagUndoList (PAD_TYPE, element, pad, pad);
-	  ASSIGN_FLAG (SELECTEDFLAG, select, pad);
-	  DrawPad (pad);
-	  changed = true;
-	}
-  }
-  ENDALL_LOOP;
+    {
+      if (indexed)
+	SELECT_INDEXED (NAME_PAD);
+      else
+	ALLPAD_LOOP (PCB->Data);
+      {
+	if (NameMatches (match, pad->Name))
+	  changed = SelectPadByName (element, pad, select) || changed;
+      }
+      ENDALL_LOOP;
+    }
   if (PCB->ViaOn && (Type & VIA_TYPE))
-    VIA_LOOP (PCB->Data);
-  {
-    if (!TEST_FLAG (LOCKFLAG, via)
-	&& via->Name
-	&& REGEXEC (via->Name) && TEST_FLAG (SELECTEDFLAG, via) != select)
+    {
+      if (indexed)
+	SELECT_INDEXED (NAME_VIA);
+      else
+	VIA_LOOP (PCB->Data);
       {
-	AddObjectToFlagUndoList (VIA_TYPE, via, via, via);
-	ASSIGN_FLAG (SELECTEDFLAG, select, via);
-	DrawVia (via);
-	changed = true;
+	if (NameMatches (match, via->Name))
+	  changed = SelectViaByName (via, select) || changed;
       }
-  }
-  END_LOOP;
+      END_LOOP;
+    }
   if (Type & NET_TYPE)
     {
       InitConnectionLookup ();
       changed = ClearFlagOnAllObjects (FOUNDFLAG, true) || changed;
 
-      MENU_LOOP (&PCB->NetlistLib);
+      if (indexed)
+	SELECT_INDEXED (NAME_NET);
+      else
+	MENU_LOOP (&PCB->NetlistLib);
       {
-        Cardinal i;
-        LibraryEntryType *entry;
-        ConnectionType conn;
-
         /* Name[0] and Name[1] are special purpose, not the actual name*/
         if (menu->Name && menu->Name[0] != '\0' && menu->Name[1] != '\0' &&
-            REGEXEC (menu->Name + 2))
-          {
-            for (i = menu->EntryN, entry = menu->Entry; i; i--, entry++)
-              if (SeekPad (entry, &conn, false))
-                RatFindHook (conn.type, conn.ptr1, conn.ptr2, conn.ptr2,
-                             true, FOUNDFLAG, true);
-          }
+            NameMatches (match, menu->Name + 2))
+	  FindNetByName (menu);
       }
       END_LOOP;
 
@@ -1003,11 +1340,56 @@ SelectObjectByName (int Type, char *Pattern, bool select)
       changed = ClearFlagOnAllObjects (FOUNDFLAG, false) || changed;
       FreeConnectionLookupMemory ();
     }
+#undef SELECT_INDEXED
+  return changed;
+}
+
+/*!
+ * \brief Selects objects as defined by Type by name; it's a case
+ * insensitive match.
+ *
+ * All of the patterns are matched in one pass over the board, and make
+ * one undoable operation.  A pattern that isn't a valid regular
+ * expression is reported and left out.
+ *
+ * \return true if any object has been selected.
+ */
+bool
+SelectObjectsByName (int Type, char **Patterns, int n, bool select)
+{
+  bool changed = false;
+  NameMatchType match;
+  int i;
 
 #if defined(HAVE_REGCOMP)
-#if !defined(sgi)
-  regfree (&compiled);
-#endif
+  match.names = g_hash_table_new (name_hash, name_equal);
+  match.regexes = g_ptr_array_new ();
+  for (i = 0; i < n; i++)
+    {
+      regex_t *compiled;
+
+      if (IsPlainName (Patterns[i]))
+	g_hash_table_add (match.names, Patterns[i]);
+      else if ((compiled = CompilePattern (Patterns[i])) != NULL)
+	g_ptr_array_add (match.regexes, compiled);
+    }
+  if (g_hash_table_size (match.names) || match.regexes->len)
+    changed = SelectMatchingNames (Type, &match, select);
+  g_hash_table_destroy (match.names);
+  g_ptr_array_free (match.regexes, TRUE);
+#else
+  /* re_comp() only holds one pattern at a time */
+  for (i = 0; i < n; i++)
+    {
+      char *error;
+
+      if ((error = re_comp (Patterns[i])) != NULL)
+	{
+	  Message (_("re_comp error: %s\n"), error);
+	  continue;
+	}
+      changed = SelectMatchingNames (Type, &match, select) || changed;
+    }
 #endif
 
   if (changed)
@@ -1017,6 +1399,18 @@ SelectObjectByName (int Type, char *Pattern, bool select)
     }
   return (changed);
 }
+
+/*!
+ * \brief Selects objects as defined by Type by name; it's a case
+ * insensitive match.
+ *
+ * \return true if any object has been selected.
+ */
+bool
+SelectObjectByName (int Type, char *Pattern, bool select)
+{
+  return SelectObjectsByName (Type, &Pattern, 1, select);
+}
 #endif /* defined(HAVE_REGCOMP) || defined(HAVE_RE_COMP) */
 
 /*!
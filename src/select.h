@@ -47,9 +47,11 @@ bool SelectedOperation (ObjectFunctionType *, bool, int);
 void *ObjectOperation (ObjectFunctionType *, int, void *, void *, void *);
 bool SelectByFlag (int flag, bool select);
 bool SelectBuriedVias (bool select);
+void SelectNameIndexInvalidate (void);
 
 #if defined(HAVE_REGCOMP) || defined(HAVE_RE_COMP)
 bool SelectObjectByName (int, char *, bool);
+bool SelectObjectsByName (int, char **, int, bool);
 #endif
 
 #endif
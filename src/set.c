@@ -58,9 +58,12 @@
 #include "flags.h"
 #include "misc.h"
 #include "move.h"
+#include "segtable.h"
+#include "select.h"
 #include "set.h"
 #include "undo.h"
 #include "pcb-printf.h"
+#include "hid/common/placement.h"
 
 #ifdef HAVE_LIBDMALLOC
 #include <dmalloc.h>
@@ -181,6 +184,14 @@ SetTextScale (int Scale)
 void
 SetChangedFlag (bool New)
 {
+  if (New)
+    {
+      ConnectionIndexEdited ();
+      ElementPlacementInvalidate ();
+      SelectNameIndexInvalidate ();
+      SegmentTableInvalidate ();
+    }
+
   if (PCB->Changed != New)
     {
       PCB->Changed = New;
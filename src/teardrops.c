@@ -35,6 +35,7 @@
 #include "hid.h"
 #include "misc.h"
 #include "create.h"
+#include "polygon.h"
 #include "rtree.h"
 #include "undo.h"
 
@@ -48,6 +49,35 @@ static LayerType * silk;
 
 static int new_arcs = 0;
 
+/*!
+ * \brief An arc of a teardrop, worked out before any is made.
+ */
+typedef struct
+{
+  int layer;
+  Coord x, y, radius;
+  Angle sa, delta;
+  LineType *line;
+} TeardropArc;
+
+/* the arcs the teardrops need, in the order they are made */
+static GArray *planned = NULL;
+
+static void
+plan_arc (LineType *l, Coord x, Coord y, Coord radius, Angle sa, Angle delta)
+{
+  TeardropArc a;
+
+  a.layer = layer;
+  a.x = x;
+  a.y = y;
+  a.radius = radius;
+  a.sa = sa;
+  a.delta = delta;
+  a.line = l;
+  g_array_append_val (planned, a);
+}
+
 int
 distance_between_points(int x1,int y1, int x2, int y2)
 {
@@ -63,7 +93,6 @@ distance_between_points(int x1,int y1, int x2, int y2)
 static int
 check_line_callback (const BoxType * box, void *cl)
 {
-  LayerType * lay = & PCB->Data->Layer[layer];
   LineType * l = (LineType *) box;
   int x1, x2, y1, y2;
   double a, b, c, x, r, t;
@@ -72,7 +101,6 @@ check_line_callback (const BoxType * box, void *cl)
   double ldist, adist, radius;
   double vx, vy, vr, vl;
   int delta, aoffset, count;
-  ArcType * arc;
 
   /* if our line is to short ignore it */
   if (distance_between_points(l->Point1.X,l->Point1.Y,l->Point2.X,l->Point2.Y) < MIN_LINE_LENGTH )
@@ -164,20 +192,14 @@ check_line_callback (const BoxType * box, void *cl)
     ax = lx - dy * adist;
     ay = ly + dx * adist;
 
-    arc = CreateNewArcOnLayer (lay, (int)ax, (int)ay, (int)radius, (int)radius,
-			       (int)theta+90+aoffset, delta-aoffset,
-			       l->Thickness, l->Clearance, l->Flags);
-    if (arc)
-      AddObjectToCreateUndoList (ARC_TYPE, lay, arc, arc);
+    plan_arc (l, (int)ax, (int)ay, (int)radius,
+	      (int)theta+90+aoffset, delta-aoffset);
 
     ax = lx + dy * (x+t);
     ay = ly - dx * (x+t);
 
-    arc = CreateNewArcOnLayer (lay, (int)ax, (int)ay, (int)radius, (int)radius,
-			       (int)theta-90-aoffset, -delta+aoffset,
-			       l->Thickness, l->Clearance, l->Flags);
-    if (arc)
-      AddObjectToCreateUndoList (ARC_TYPE, lay, arc, arc);
+    plan_arc (l, (int)ax, (int)ay, (int)radius,
+	      (int)theta-90-aoffset, -delta+aoffset);
 
     radius += t*1.9;
     aoffset = acos ((double)adist / radius) * 180.0 / M_PI;
@@ -188,26 +210,55 @@ check_line_callback (const BoxType * box, void *cl)
   return 1;
 }
 
-static void
-check_pin (PinType * _pin)
-{
-  BoxType spot;
-
-  pin = _pin;
+static PinType **pins;
 
+static int
+check_pin_line_callback (const BoxType * box, int query, void *cl)
+{
+  pin = pins[query];
   px = pin->X;
   py = pin->Y;
+  return check_line_callback (box, cl);
+}
 
-  spot.X1 = px - 10;
-  spot.Y1 = py - 10;
-  spot.X2 = px + 10;
-  spot.Y2 = py + 10;
+/*!
+ * \brief Make the planned arcs.
+ *
+ * The polygons are cleared of the new arcs in one pass at the end, and
+ * all of them go in one undo step.  Arcs that would land on an existing
+ * one are left out, as CreateNewArcOnLayer() does.
+ */
+static void
+make_planned_arcs (void)
+{
+  guint i;
 
-  for (layer = 0; layer < max_copper_layer; layer ++)
+  DeferPolygonClipping ();
+  for (i = 0; i < planned->len; i++)
     {
-      LayerType * l = &(PCB->Data->Layer[layer]);
-      r_search (l->line_tree, &spot, NULL, check_line_callback, l);
+      TeardropArc *a = &g_array_index (planned, TeardropArc, i);
+      LayerType *lay = &PCB->Data->Layer[a->layer];
+      ArcType *arc;
+
+      arc = CreateNewArcOnLayer (lay, a->x, a->y, a->radius, a->radius,
+				 a->sa, a->delta, a->line->Thickness,
+				 a->line->Clearance, a->line->Flags);
+      if (arc)
+	{
+	  AddObjectToCreateUndoList (ARC_TYPE, lay, arc, arc);
+	  ClearFromPolygon (PCB->Data, ARC_TYPE, lay, arc);
+	}
     }
+  ResumePolygonClipping ();
+}
+
+static void
+pin_spot (PinType * _pin, BoxType * spot)
+{
+  spot->X1 = _pin->X - 10;
+  spot->Y1 = _pin->Y - 10;
+  spot->X2 = _pin->X + 10;
+  spot->Y2 = _pin->Y + 10;
 }
 
 /* %start-doc actions Teardrops
@@ -255,22 +306,52 @@ Refdes silk is no longer visible.
 static int
 teardrops (int argc, char **argv, Coord x, Coord y)
 {
+  BoxType *spots;
+  int n_spots = PCB->Data->ViaN;
+
   silk = & PCB->Data->SILKLAYER;
 
   new_arcs = 0;
 
+  ELEMENT_LOOP (PCB->Data);
+  {
+    n_spots += element->PinN;
+  }
+  END_LOOP;
+  pins = (PinType **)malloc (n_spots * sizeof (PinType *));
+  spots = (BoxType *)malloc (n_spots * sizeof (BoxType));
+  n_spots = 0;
+
   VIA_LOOP (PCB->Data);
   {
-    check_pin (via);
+    pins[n_spots] = via;
+    pin_spot (via, &spots[n_spots++]);
   }
   END_LOOP;
 
   ALLPIN_LOOP (PCB->Data);
   {
-    check_pin (pin);
+    pins[n_spots] = pin;
+    pin_spot (pin, &spots[n_spots++]);
   }
   ENDALL_LOOP;
 
+  /* look up the line ends at all pins and vias in one pass per layer,
+     and work out all the teardrops before making any */
+  planned = g_array_new (FALSE, FALSE, sizeof (TeardropArc));
+  for (layer = 0; layer < max_copper_layer; layer ++)
+    {
+      LayerType * l = &(PCB->Data->Layer[layer]);
+      r_search_batch (l->line_tree, spots, n_spots, check_pin_line_callback, l);
+    }
+
+  free (pins);
+  free (spots);
+
+  make_planned_arcs ();
+  g_array_free (planned, TRUE);
+  planned = NULL;
+
   gui->invalidate_all ();
 
   if (new_arcs)
@@ -85,8 +85,6 @@
 #include <dmalloc.h>
 #endif
 
-static PCBType *pcb;
-
 struct cent
 {
   Coord x, y;
@@ -134,7 +132,7 @@ diag_line (Coord X, Coord Y, Coord l, Coord w, bool rt)
 }
 
 static POLYAREA *
-square_therm (PinType *pin, Cardinal style)
+square_therm (PCBType *pcb, PinType *pin, Cardinal style)
 {
   POLYAREA *p, *p2;
   PLINE *c;
@@ -407,7 +405,7 @@ square_therm (PinType *pin, Cardinal style)
 }
 
 static POLYAREA *
-oct_therm (PinType *pin, Cardinal style)
+oct_therm (PCBType *pcb, PinType *pin, Cardinal style)
 {
   POLYAREA *p, *p2, *m;
   Coord t = 0.5 * pcb->ThermScale * pin->Clearance;
@@ -438,7 +436,7 @@ oct_therm (PinType *pin, Cardinal style)
         Coord t = pin->Thickness / 2;
         POLYAREA *q;
         /* cheat by using the square therm's rounded parts */
-        p = square_therm (pin, style);
+        p = square_therm (pcb, pin, style);
         q = RectPoly (pin->X - t, pin->X + t, pin->Y - t, pin->Y + t);
         poly_Boolean_free (p, q, &p2, PBO_UNITE);
         poly_Boolean_free (m, p2, &p, PBO_ISECT);
@@ -455,7 +453,7 @@ oct_therm (PinType *pin, Cardinal style)
  * Usually this is 4 disjoint regions.
  */
 POLYAREA *
-ThermPoly (PCBType *p, PinType *pin, Cardinal laynum)
+ThermPoly (PCBType *pcb, PinType *pin, Cardinal laynum)
 {
   ArcType a;
   POLYAREA *pa, *arc;
@@ -463,11 +461,10 @@ ThermPoly (PCBType *p, PinType *pin, Cardinal laynum)
 
   if (style == 3)
     return NULL;                /* solid connection no clearance */
-  pcb = p;
   if (TEST_FLAG (SQUAREFLAG, pin))
-    return square_therm (pin, style);
+    return square_therm (pcb, pin, style);
   if (TEST_FLAG (OCTAGONFLAG, pin))
-    return oct_therm (pin, style);
+    return oct_therm (pcb, pin, style);
   /* must be circular */
   switch (style)
     {
@@ -0,0 +1,235 @@
+/*!
+ * \file src/timing.c
+ *
+ * \brief Time and memory taken by the phases of startup and of loading
+ * a board, for Timing() and --timing.
+ *
+ * At each change of phase the clock, the heap in use and the peak
+ * resident size are read, and what they moved by since the last change
+ * is charged to the phase that was running.  So every moment since
+ * startup is charged to exactly one phase, an inner phase to itself
+ * only, and the phases add up to the total.  Time outside all the
+ * phases goes to "other".
+ *
+ * The objects of a board go into their r-trees in bulk once the parser
+ * has read them, before the clipping, so building the r-trees is part of
+ * the parse phase.  How much of
+ * it is searching the r-trees shows with Profile().
+ *
+ * Phases are only entered from the main thread, a few times per load,
+ * so they are always counted.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "error.h"
+#include "macro.h"
+#include "memstats.h"
+#include "misc.h"
+#include "timing.h"
+
+#ifdef HAVE_LIBDMALLOC
+#include <dmalloc.h>
+#endif
+
+static const char *phase_names[TIMING_PHASES] = {
+  "hid", "options", "parse", "clip", "setup", "library", "other"
+};
+
+static struct
+{
+  int times;
+  gint64 usec;
+  /* growth of the heap in use, in bytes, and of the peak resident
+   * size, in kB */
+  gint64 heap;
+  long resident;
+} phases[TIMING_PHASES];
+
+static TimingPhase current = TIMING_OTHER;
+/* when the counts started, and the readings at the last change of phase */
+static gint64 timing_started = 0, last_usec;
+static size_t last_heap;
+static long last_resident;
+
+/*!
+ * \brief Charge the running phase with what has changed since the last
+ * change of phase.
+ */
+static void
+timing_charge (void)
+{
+  gint64 now = g_get_monotonic_time ();
+  size_t heap = MemoryHeapInUse ();
+  long resident = MemoryPeakResident ();
+
+  if (timing_started == 0)
+    timing_started = now;
+  else
+    {
+      phases[current].usec += now - last_usec;
+      phases[current].heap += (gint64) heap - (gint64) last_heap;
+      phases[current].resident += resident - last_resident;
+    }
+  last_usec = now;
+  last_heap = heap;
+  last_resident = resident;
+}
+
+/*!
+ * \brief Start charging a phase.
+ *
+ * \return the phase that ran before, for timing_leave().
+ */
+TimingPhase
+timing_enter (TimingPhase phase)
+{
+  TimingPhase outer = current;
+
+  timing_charge ();
+  phases[phase].times++;
+  current = phase;
+  return outer;
+}
+
+void
+timing_leave (TimingPhase outer)
+{
+  timing_charge ();
+  current = outer;
+}
+
+#define MB(bytes) ((bytes) / (1024.0 * 1024.0))
+
+/*!
+ * \brief Write the phases so far to the log.
+ */
+void
+TimingReport (void)
+{
+  gint64 usec;
+  int i;
+
+  timing_charge ();
+  usec = last_usec - timing_started;
+
+  Message (_("Timing: %.3f s, heap %.1f MB, peak resident %.1f MB\n"),
+	   usec / 1e6, MB ((double) last_heap), MB (last_resident * 1024.0));
+  for (i = 0; i < TIMING_PHASES; i++)
+    Message (_("  %-8s %6d times %10.3f s %5.1f%%"
+	       "  heap %+9.1f MB  resident %+9.1f MB\n"),
+	     phase_names[i], phases[i].times, phases[i].usec / 1e6,
+	     usec ? 100.0 * phases[i].usec / usec : 0.0,
+	     MB ((double) phases[i].heap), MB (phases[i].resident * 1024.0));
+}
+
+static const char timing_syntax[] = "Timing([Reset])";
+
+static const char timing_help[] =
+  "Report the time and memory taken by startup and loading boards.";
+
+/* %start-doc actions Timing
+
+Writes to the log how much time, heap and resident memory each phase
+of startup and of loading boards has taken so far:
+
+@table @code
+
+@item hid
+Setting up the HIDs and reading their settings.
+
+@item options
+Reading the command line and the settings that follow from it.
+
+@item parse
+Reading the board file, which includes building its r-trees.
+
+@item clip
+Clipping the polygons of the board, or reading them from the board
+cache.
+
+@item setup
+The rest of a load: the layer stack, the netlist, and telling the GUI
+about the new board.
+
+@item library
+Reading the footprint library.
+
+@item other
+Everything else.
+
+@end table
+
+Each moment is charged to one phase only, so clipping is not counted
+in parsing, and the phases add up to the total.  The heap is only
+known where the C library can tell, the resident size is the growth of
+the peak.
+
+With @code{Reset}, the counts are cleared instead, so that:
+
+@example
+Timing(Reset)
+LoadFrom(Layout, board.pcb)
+Timing()
+@end example
+
+reports the load of one board.  The @code{--timing} option reports the
+phases of startup, including the board given on the command line.
+
+%end-doc */
+
+static int
+ActionTiming (int argc, char **argv, Coord x, Coord y)
+{
+  const char *function = ARG (0);
+
+  if (function == NULL)
+    {
+      TimingReport ();
+      return 0;
+    }
+  if (strcasecmp (function, "Reset") == 0)
+    {
+      timing_charge ();
+      memset (phases, 0, sizeof (phases));
+      timing_started = last_usec;
+      return 0;
+    }
+  AFAIL (timing);
+}
+
+HID_Action timing_action_list[] = {
+  {"Timing", 0, ActionTiming,
+   timing_help, timing_syntax}
+};
+
+REGISTER_ACTIONS (timing_action_list)
@@ -0,0 +1,63 @@
+/*!
+ * \file src/timing.h
+ *
+ * \brief Time and memory taken by the phases of startup and of loading
+ * a board, for Timing() and --timing.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * Copyright (C) 2026 PCB Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef	PCB_TIMING_H
+#define	PCB_TIMING_H
+
+#include "global.h"
+
+typedef enum
+{
+  TIMING_HID,			/* hid_init() and hid_load_settings() */
+  TIMING_OPTIONS,		/* the command line and settings_post_process() */
+  TIMING_PARSE,			/* the parser of real_load_pcb() */
+  TIMING_CLIP,			/* InitClipAll() or BoardCacheRestore() */
+  TIMING_SETUP,			/* the rest of real_load_pcb(), netlist and GUI */
+  TIMING_LIBRARY,		/* ReadLibraryContents() */
+  TIMING_OTHER,			/* whatever runs outside the phases above */
+  TIMING_PHASES
+} TimingPhase;
+
+TimingPhase timing_enter (TimingPhase);
+void timing_leave (TimingPhase);
+void TimingReport (void);
+
+/*!
+ * \brief Charge the code between TIMING_BEGIN and TIMING_END, in a block
+ * of its own, to a phase.
+ *
+ * Phases nest: the time of an inner phase is not charged to the phase
+ * around it.
+ */
+#define TIMING_BEGIN(phase) \
+  { TimingPhase timing_outer_ = timing_enter (phase)
+#define TIMING_END(phase) \
+  timing_leave (timing_outer_); }
+
+#endif
@@ -63,6 +63,7 @@
 
 #include "flags.h"
 #include "toporouter.h"
+#include "job.h"
 #include "pcb-printf.h"
 
 #define BOARD_EDGE_RESOLUTION MIL_TO_COORD (100.)
@@ -85,7 +86,7 @@ toporouter_edge_class(void)
 {
   static toporouter_edge_class_t *klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo constraint_info = {
       "toporouter_edge_t",
       sizeof (toporouter_edge_t),
@@ -95,7 +96,7 @@ toporouter_edge_class(void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = (toporouter_edge_class_t *)gts_object_class_new (GTS_OBJECT_CLASS (gts_edge_class ()), &constraint_info);
+    g_once_init_leave (&klass, (toporouter_edge_class_t *)gts_object_class_new (GTS_OBJECT_CLASS (gts_edge_class ()), &constraint_info));
   }
 
   return klass;
@@ -118,7 +119,7 @@ toporouter_bbox_class(void)
 {
   static toporouter_bbox_class_t *klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo constraint_info = {
       "toporouter_bbox_t",
       sizeof (toporouter_bbox_t),
@@ -128,7 +129,7 @@ toporouter_bbox_class(void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = (toporouter_bbox_class_t *)gts_object_class_new (GTS_OBJECT_CLASS (gts_bbox_class ()), &constraint_info);
+    g_once_init_leave (&klass, (toporouter_bbox_class_t *)gts_object_class_new (GTS_OBJECT_CLASS (gts_bbox_class ()), &constraint_info));
   }
 
   return klass;
@@ -168,7 +169,7 @@ toporouter_vertex_class(void)
 {
   static toporouter_vertex_class_t *klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo constraint_info = {
       "toporouter_vertex_t",
       sizeof (toporouter_vertex_t),
@@ -178,7 +179,7 @@ toporouter_vertex_class(void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = (toporouter_vertex_class_t *)gts_object_class_new (GTS_OBJECT_CLASS (gts_vertex_class ()), &constraint_info);
+    g_once_init_leave (&klass, (toporouter_vertex_class_t *)gts_object_class_new (GTS_OBJECT_CLASS (gts_vertex_class ()), &constraint_info));
   }
 
   return klass;
@@ -208,7 +209,7 @@ toporouter_constraint_class(void)
 {
   static toporouter_constraint_class_t *klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo constraint_info = {
       "toporouter_constraint_t",
       sizeof (toporouter_constraint_t),
@@ -218,7 +219,7 @@ toporouter_constraint_class(void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = (toporouter_constraint_class_t *)gts_object_class_new (GTS_OBJECT_CLASS (gts_constraint_class ()), &constraint_info);
+    g_once_init_leave (&klass, (toporouter_constraint_class_t *)gts_object_class_new (GTS_OBJECT_CLASS (gts_constraint_class ()), &constraint_info));
   }
 
   return klass;
@@ -249,7 +250,7 @@ toporouter_arc_class(void)
 {
   static toporouter_arc_class_t *klass = NULL;
 
-  if (klass == NULL) {
+  if (g_once_init_enter (&klass)) {
     GtsObjectClassInfo constraint_info = {
       "toporouter_arc_t",
       sizeof (toporouter_arc_t),
@@ -259,7 +260,7 @@ toporouter_arc_class(void)
       (GtsArgSetFunc) NULL,
       (GtsArgGetFunc) NULL
     };
-    klass = (toporouter_arc_class_t *)gts_object_class_new (GTS_OBJECT_CLASS (gts_constraint_class ()), &constraint_info);
+    g_once_init_leave (&klass, (toporouter_arc_class_t *)gts_object_class_new (GTS_OBJECT_CLASS (gts_constraint_class ()), &constraint_info));
   }
 
   return klass;
@@ -821,10 +822,19 @@ coord_move_towards_coord_values (double ax, double ay,
                                  double d,
                                  double *x, double *y)
 {
-  double theta = atan2 (py - ay, px - ax);
+  double dx = px - ax, dy = py - ay, len = sqrt (dx * dx + dy * dy);
 
-  *x = ax + d * cos (theta);
-  *y = ay + d * sin (theta);
+  /* from on top of p, go along x as atan2 (0, 0) would */
+  if (len > 0.)
+    {
+      *x = ax + d * dx / len;
+      *y = ay + d * dy / len;
+    }
+  else
+    {
+      *x = ax + d;
+      *y = ay;
+    }
 }
 
 /*!
@@ -836,11 +846,9 @@ vertex_move_towards_vertex_values (GtsVertex *v,
                                    double d,
                                    double *x, double *y)
 {
-  double theta = atan2 (GTS_POINT(p)->y - GTS_POINT(v)->y,
-                        GTS_POINT(p)->x - GTS_POINT(v)->x);
-
-  *x = GTS_POINT(v)->x + d * cos (theta);
-  *y = GTS_POINT(v)->y + d * sin (theta);
+  coord_move_towards_coord_values (GTS_POINT(v)->x, GTS_POINT(v)->y,
+                                   GTS_POINT(p)->x, GTS_POINT(p)->y,
+                                   d, x, y);
 }
 
 #define tv_on_layer(v,l) (l == TOPOROUTER_BBOX(TOPOROUTER_VERTEX(v)->boxes->data)->layer)
@@ -1154,6 +1162,7 @@ toporouter_layer_free(toporouter_layer_t *l)
 {
   g_list_free(l->vertices);
   g_list_free(l->constraints);
+  if(l->bboxtree) gts_bb_tree_destroy(l->bboxtree, FALSE);
 
 }
 
@@ -1186,6 +1195,7 @@ toporouter_free(toporouter_t *r)
                (endtime.tv_usec - r->starttime.tv_usec) / 1000000.;
 
   Message(_("Elapsed time: %.2f seconds\n"), time_delta);
+  if(r->bboxtree) gts_bb_tree_destroy(r->bboxtree, FALSE);
   free(r->layers);  
   free(r);
 
@@ -2591,11 +2601,75 @@ cluster_create(toporouter_t *r, toporouter_netlist_t *netlist)
   return c;
 }
 
+/*!
+ * \brief Return the boxes of a bbox tree that contain x, y.
+ *
+ * Unlike gts_bb_tree_stabbed(), which returns every box the ray from x, y
+ * towards -x meets, only the branches around the point are searched.
+ */
+static GSList *
+bbox_tree_containing(GNode *tree, gdouble x, gdouble y, GSList *list)
+{
+  GtsBBox *bb;
+  GNode *i;
+
+  if(!tree) return list;
+  bb = GTS_BBOX(tree->data);
+  if(x < bb->x1 || x > bb->x2 || y < bb->y1 || y > bb->y2) return list;
+  if(!tree->children) return g_slist_prepend(list, bb);
+  for(i = tree->children; i; i = i->next)
+    list = bbox_tree_containing(i, x, y, list);
+  return list;
+}
+
+/*!
+ * \brief Build the bbox trees of the first \p n layers.
+ *
+ * The bboxes of a layer have its index for z, which is what the searches
+ * of the tree of all bboxes tell the layers apart by.  The layers past
+ * the first \p n, of the groups with nothing in them, get no tree.
+ */
+static void
+layer_bbox_trees(toporouter_t *r, guint n)
+{
+  GSList **boxes = g_new0(GSList *, n), *i;
+  guint l;
+
+  for(i = r->bboxes; i; i = i->next) {
+    GtsBBox *b = GTS_BBOX(i->data);
+
+    if(b->z1 == b->z2 && b->z1 >= 0 && b->z1 < n && (guint)b->z1 == b->z1)
+      boxes[(guint)b->z1] = g_slist_prepend(boxes[(guint)b->z1], b);
+  }
+  for(l=0;l<groupcount();l++) {
+    r->layers[l].bboxtree = l < n && boxes[l] ? gts_bb_tree_new(boxes[l]) : NULL;
+    if(l < n) g_slist_free(boxes[l]);
+  }
+  g_free(boxes);
+}
+
 toporouter_bbox_t *
 toporouter_bbox_locate(toporouter_t *r, toporouter_term_t type, void *data, gdouble x, gdouble y, guint layergroup)
 {
-  GtsPoint *p = gts_point_new(gts_point_class(), x, y, layergroup);
-  GSList *boxes = gts_bb_tree_stabbed(r->bboxtree, p), *i = boxes;
+  GtsPoint *p;
+  GSList *boxes, *i;
+
+  /* the box nearly always contains the point, so look around it first */
+  if(layergroup < groupcount()) {
+    boxes = bbox_tree_containing(r->layers[layergroup].bboxtree, x, y, NULL);
+    for(i = boxes; i; i = i->next) {
+      toporouter_bbox_t *box = TOPOROUTER_BBOX(i->data);
+
+      if(box->type == type && box->data == data) {
+        g_slist_free(boxes);
+        return box;
+      }
+    }
+    g_slist_free(boxes);
+  }
+
+  p = gts_point_new(gts_point_class(), x, y, layergroup);
+  boxes = gts_bb_tree_stabbed(r->bboxtree, p), i = boxes;
   
   gts_object_destroy(GTS_OBJECT(p));
   
@@ -2719,6 +2793,39 @@ import_clusters(toporouter_t *r)
   FreeNetListListMemory(&nets);
 }
 
+static void
+cdt_worker(gpointer data, gpointer user_data)
+{
+  build_cdt((toporouter_t *)user_data, (toporouter_layer_t *)data);
+}
+
+/*!
+ * \brief Build the CDTs of the first \p n layers.
+ *
+ * Nothing is shared between the layers until routing starts, so with
+ * several processors each one is triangulated on a thread of its own.
+ * GTS keeps its floating object flags and its free objects for each
+ * thread, and makes each class once whichever thread asks first.
+ */
+void
+build_cdts(toporouter_t *r, guint n)
+{
+  GThreadPool *pool;
+  guint i;
+
+  if(n < 2 || g_get_num_processors() < 2) {
+    for(i=0;i<n;i++)
+      build_cdt(r, &r->layers[i]);
+    return;
+  }
+
+  pool = g_thread_pool_new(cdt_worker, r, MIN(n, (guint)g_get_num_processors()), FALSE, NULL);
+  for(i=0;i<n;i++)
+    g_thread_pool_push(pool, &r->layers[i], NULL);
+  /* wait for all of them */
+  g_thread_pool_free(pool, FALSE, TRUE);
+}
+
 void
 import_geometry(toporouter_t *r) 
 {
@@ -2738,7 +2845,7 @@ import_geometry(toporouter_t *r)
   /* Allocate space for per layer struct */
   cur_layer = r->layers = (toporouter_layer_t *)malloc(groupcount() * sizeof(toporouter_layer_t));
 
-  /* Foreach layer, read in pad vertices and constraints, and build CDT */
+  /* Foreach layer, read in pad vertices and constraints */
   for (group = 0; group < max_group; group++) {
 #ifdef DEBUG_IMPORT    
     printf("*** LAYER GROUP %d ***\n", group);
@@ -2746,6 +2853,7 @@ import_geometry(toporouter_t *r)
     if(PCB->LayerGroups.Number[group] > 0){ 
       cur_layer->vertices    = NULL;
       cur_layer->constraints = NULL;
+      cur_layer->bboxtree    = NULL;
 
 #ifdef DEBUG_IMPORT    
       printf("reading board constraints from layer %d into group %d\n", PCB->LayerGroups.Entries[group][0], group);
@@ -2774,10 +2882,17 @@ import_geometry(toporouter_t *r)
 
 
 
+      cur_layer++;
+    }
+  }
+
+  /* and build the CDTs */
 #ifdef DEBUG_IMPORT    
-      printf("building CDT\n");
+  printf("building CDTs\n");
 #endif
-      build_cdt(r, cur_layer);
+  r->stats.build_cdt = g_get_monotonic_time();
+  build_cdts(r, cur_layer - r->layers);
+  r->stats.build_cdt = g_get_monotonic_time() - r->stats.build_cdt;
   printf("finished\n");
 /*      {
     int i;
@@ -2788,13 +2903,11 @@ import_geometry(toporouter_t *r)
     }
   }*/
 #ifdef DEBUG_IMPORT    
-      printf("finished building CDT\n");
+  printf("finished building CDTs\n");
 #endif
-      cur_layer++;
-    }
-  }
   
   r->bboxtree = gts_bb_tree_new(r->bboxes);
+  layer_bbox_trees(r, cur_layer - r->layers);
  
   import_clusters(r);
 
@@ -2827,17 +2940,11 @@ compare_segments(gconstpointer a, gconstpointer b)
   return 1;
 }
 #define DEBUG_CLUSTER_FIND 1
-toporouter_cluster_t *
-cluster_find(toporouter_t *r, gdouble x, gdouble y, gdouble z)
+static toporouter_cluster_t *
+cluster_find_hits(GSList *hits, GtsPoint *p, gdouble x, gdouble y, gdouble z)
 {
-  GtsPoint *p = gts_point_new(gts_point_class(), x, y, z);
-  GSList *hits = gts_bb_tree_stabbed(r->bboxtree, p);
   toporouter_cluster_t *rval = NULL;
 
-#ifdef DEBUG_CLUSTER_FIND
-  printf("FINDING %f,%f,%f\n\n", x, y, z);
-#endif
-
   while(hits) {
     toporouter_bbox_t *box = TOPOROUTER_BBOX(hits->data);
     
@@ -2878,6 +2985,32 @@ cluster_find(toporouter_t *r, gdouble x, gdouble y, gdouble z)
     }
     hits = hits->next;
   }
+
+  return rval;
+}
+
+toporouter_cluster_t *
+cluster_find(toporouter_t *r, gdouble x, gdouble y, gdouble z)
+{
+  GtsPoint *p = gts_point_new(gts_point_class(), x, y, z);
+  GSList *hits = NULL;
+  toporouter_cluster_t *rval = NULL;
+
+#ifdef DEBUG_CLUSTER_FIND
+  printf("FINDING %f,%f,%f\n\n", x, y, z);
+#endif
+
+  /* the boxes of the layer around the point first, then all that the ray
+   * from it meets, as a line may still be found through its winding */
+  if(z >= 0 && (guint)z < groupcount())
+    hits = bbox_tree_containing(r->layers[(guint)z].bboxtree, x, y, NULL);
+  rval = cluster_find_hits(hits, p, x, y, z);
+  g_slist_free(hits);
+  if(!rval) {
+    hits = gts_bb_tree_stabbed(r->bboxtree, p);
+    rval = cluster_find_hits(hits, p, x, y, z);
+    g_slist_free(hits);
+  }
   
   gts_object_destroy(GTS_OBJECT(p));
  
@@ -2905,20 +3038,16 @@ route_heap_cmp(gpointer item, gpointer data)
   return FCOST(TOPOROUTER_VERTEX(item));  
 }
 
-#define closelist_insert(p) closelist = g_list_prepend(closelist, p)
+/* the number of the route() search going on, which marks the vertices
+ * it has on its open and closed lists */
+static guint route_search = 0;
 
-typedef struct {
-  toporouter_vertex_t *key;
-  toporouter_vertex_t *result;
-}toporouter_heap_search_data_t;
+#define closelist_insert(p) (p)->closed = route_search
+#define openlist_insert(p) ((p)->opened = route_search, \
+    (p)->openpair = gts_eheap_insert(openlist, p))
+#define in_closelist(p) ((p)->closed == route_search)
+#define in_openlist(p) ((p)->opened == route_search && !in_closelist(p))
 
-void 
-toporouter_heap_search(gpointer data, gpointer user_data)
-{
-  toporouter_vertex_t *v = TOPOROUTER_VERTEX(data);
-  toporouter_heap_search_data_t *heap_search_data = (toporouter_heap_search_data_t *)user_data;
-  if(v == heap_search_data->key) heap_search_data->result = v;
-}
 /*
 void 
 toporouter_heap_color(gpointer data, gpointer user_data)
@@ -3010,6 +3139,7 @@ split_path(GList *path)
 {
   toporouter_vertex_t *pv = NULL;
   GList *curpath = NULL, *i, *paths = NULL;
+  guint curlength = 0;
 #ifdef DEBUG_ROUTE
   printf("PATH:\n");
 #endif
@@ -3030,21 +3160,27 @@ split_path(GList *path)
     
     if(pv)
     if(GTS_POINT(v)->x == GTS_POINT(pv)->x && GTS_POINT(v)->y == GTS_POINT(pv)->y) {
-      if(g_list_length(curpath) > 1) paths = g_list_prepend(paths, curpath);
+      if(curlength > 1) paths = g_list_prepend(paths, g_list_reverse(curpath));
+      else g_list_free(curpath);
       curpath = NULL;
+      curlength = 0;
 
       pv->child = NULL;
       v->parent = NULL;
     }
     
-    curpath = g_list_append(curpath, v);
+    /* built backwards, and turned round when it's done */
+    curpath = g_list_prepend(curpath, v);
+    curlength++;
 
     pv = v;
     i = i->next;
   }
   
-  if(g_list_length(curpath) > 1)
-    paths = g_list_prepend(paths, curpath);
+  if(curlength > 1)
+    paths = g_list_prepend(paths, g_list_reverse(curpath));
+  else
+    g_list_free(curpath);
   
   return paths;
 }
@@ -4261,6 +4397,7 @@ compute_candidate_points(toporouter_t *tr, toporouter_layer_t *l, toporouter_ver
       GtsTriangle *t = GTS_TRIANGLE(i->data);
       GList *temppoints;
 
+      tr->stats.triangles++;
       if(tr->flags & TOPOROUTER_FLAG_LEASTINVALID) temppoints = triangle_all_candidate_points_from_vertex(t, curpoint, data);
       else temppoints = triangle_candidate_points_from_vertex(t, curpoint, *closestdest, data);
 
@@ -4284,6 +4421,7 @@ compute_candidate_points(toporouter_t *tr, toporouter_layer_t *l, toporouter_ver
       if(prevwind != vertex_wind(GTS_SEGMENT(edge)->v1, GTS_SEGMENT(edge)->v2, oppv)) {
         GList *temppoints;
         
+        tr->stats.triangles++;
         if(tr->flags & TOPOROUTER_FLAG_LEASTINVALID) temppoints = triangle_all_candidate_points_from_edge(tr, GTS_TRIANGLE(i->data), edge,
             data, closestdest, curpoint);
         else temppoints = triangle_candidate_points_from_edge(tr, GTS_TRIANGLE(i->data), edge, curpoint, closestdest, data);
@@ -4387,63 +4525,64 @@ print_vertices(GList *vertices)
   }
 }
 
+/*!
+ * \brief Push the routes crossing an edge apart until they are spaced.
+ *
+ * The vertices on the edge are copied into arrays with the ends of the
+ * edge on either side, and the spacing wanted between each neighbouring
+ * pair is looked up once, since it doesn't change as they move.  Each
+ * round works out the overlap of every gap and then moves every vertex a
+ * tenth of the way its two gaps push it, towards or away from the second
+ * end, so the loops go straight over the arrays.
+ */
 gint       
 space_edge(gpointer item, gpointer data)
 {
   toporouter_edge_t *e = TOPOROUTER_EDGE(item);
   GList *i;
-  gdouble *forces;
+  gdouble *x, *y, *z, *ms, *gap;
+  guint n, j, k;
 
   if(TOPOROUTER_IS_CONSTRAINT(e)) return 0;
 
-  if(!edge_routing(e) || !g_list_length(edge_routing(e))) return 0;
+  n = g_list_length(edge_routing(e));
+  if(!n) return 0;
+
+  /* x, y and z hold the edge ends at 0 and n + 1, gap k lies between
+   * k and k + 1 */
+  x = (gdouble *)malloc(sizeof(gdouble) * (5 * n + 8));
+  y = x + n + 2;
+  z = y + n + 2;
+  ms = z + n + 2;
+  gap = ms + n + 1;
+
+  x[0] = vx(edge_v1(e)); y[0] = vy(edge_v1(e)); z[0] = vz(edge_v1(e));
+  x[n+1] = vx(edge_v2(e)); y[n+1] = vy(edge_v2(e)); z[n+1] = vz(edge_v2(e));
+  k = 1;
+  for(i = edge_routing(e); i; i = i->next, k++) {
+    toporouter_vertex_t *v = TOPOROUTER_VERTEX(i->data);
+    x[k] = vx(v); y[k] = vy(v); z[k] = vz(v);
+    ms[k-1] = min_spacing(i->prev ? TOPOROUTER_VERTEX(i->prev->data) : tedge_v1(e), v);
+  }
+  ms[n] = min_spacing(TOPOROUTER_VERTEX(g_list_last(edge_routing(e))->data), tedge_v2(e));
 
-  forces = (gdouble *)malloc(sizeof(double) * g_list_length(edge_routing(e)));
-  
-  for(guint j=0;j<100;j++) {
-    guint k=0;
+  for(j=0;j<100;j++) {
     guint equilibrium = 1;
 
-    i = edge_routing(e);
-    while(i) {
-      toporouter_vertex_t *v = TOPOROUTER_VERTEX(i->data); 
-      gdouble ms, d;
-
-      if(i->prev) {
-//        ms = min_net_net_spacing(TOPOROUTER_VERTEX(i->prev->data), v);
-        ms = min_spacing(TOPOROUTER_VERTEX(i->prev->data), v);
-        d = gts_point_distance(GTS_POINT(i->prev->data), GTS_POINT(v));
-      }else{
-//        ms = min_vertex_net_spacing(v, tedge_v1(e));
-        ms = min_spacing(v, tedge_v1(e));
-        d = gts_point_distance(GTS_POINT(edge_v1(e)), GTS_POINT(v));
-      }
-
-      if(d < ms) forces[k] = ms - d;
-      else forces[k] = 0.;
-
-      if(i->next) {
-//        ms = min_net_net_spacing(TOPOROUTER_VERTEX(i->next->data), v);
-        ms = min_spacing(TOPOROUTER_VERTEX(i->next->data), v);
-        d = gts_point_distance(GTS_POINT(i->next->data), GTS_POINT(v));
-      }else{
-//        ms = min_vertex_net_spacing(v, tedge_v2(e));
-        ms = min_spacing(v, tedge_v2(e));
-        d = gts_point_distance(GTS_POINT(edge_v2(e)), GTS_POINT(v));
-      }
+    for(k=0;k<=n;k++) {
+      gdouble dx = x[k+1] - x[k], dy = y[k+1] - y[k], dz = z[k+1] - z[k];
+      gap[k] = MAX(ms[k] - sqrt(dx * dx + dy * dy + dz * dz), 0.);
+    }
 
-      if(d < ms) forces[k] += d - ms;
+    for(k=1;k<=n;k++) {
+      gdouble force = gap[k-1] - gap[k];
+      gdouble dx = x[n+1] - x[k], dy = y[n+1] - y[k];
+      gdouble d = sqrt(dx * dx + dy * dy);
 
-      k++; i = i->next;
-    }
-    
-    k = 0;
-    i = edge_routing(e);
-    while(i) {
-      toporouter_vertex_t *v = TOPOROUTER_VERTEX(i->data); 
-      if(forces[k] > EPSILON || forces[k] < -EPSILON) equilibrium = 0;
-      vertex_move_towards_vertex_values(GTS_VERTEX(v), edge_v2(e), forces[k] * 0.1, &(GTS_POINT(v)->x), &(GTS_POINT(v)->y));
-      k++; i = i->next;
+      if(force > EPSILON || force < -EPSILON) equilibrium = 0;
+      /* on top of the end there is no direction, so go along x */
+      x[k] += force * 0.1 * (d > 0. ? dx / d : 1.);
+      y[k] += force * 0.1 * (d > 0. ? dy / d : 0.);
     }
 
     if(equilibrium) {
@@ -4453,7 +4592,13 @@ space_edge(gpointer item, gpointer data)
 
   }
 
-  free(forces);
+  k = 1;
+  for(i = edge_routing(e); i; i = i->next, k++) {
+    GTS_POINT(i->data)->x = x[k];
+    GTS_POINT(i->data)->y = y[k];
+  }
+
+  free(x);
   return 0;  
 }
 
@@ -4672,7 +4817,6 @@ GList *
 route(toporouter_t *r, toporouter_route_t *data, guint debug)
 {
   GtsEHeap *openlist = gts_eheap_new(route_heap_cmp, NULL);
-  GList *closelist = NULL;
   GList *i, *rval = NULL;
   toporouter_netlist_t *pair = NULL;
   gint count = 0;
@@ -4681,6 +4825,8 @@ route(toporouter_t *r, toporouter_route_t *data, guint debug)
   toporouter_layer_t *cur_layer; //, *dest_layer;
 
   g_assert(data->src->c != data->dest->c);
+  route_search++;
+  r->stats.searches++;
   
   if(data->destvertices) g_list_free(data->destvertices);
   if(data->srcvertices) g_list_free(data->srcvertices);
@@ -4718,7 +4864,7 @@ route(toporouter_t *r, toporouter_route_t *data, guint debug)
     }
   }
 
-  gts_eheap_insert(openlist, curpoint);
+  openlist_insert(curpoint);
   
   while(gts_eheap_size(openlist) > 0) {
     GList *candidatepoints;
@@ -4726,6 +4872,7 @@ route(toporouter_t *r, toporouter_route_t *data, guint debug)
     //draw_route_status(r, closelist, openlist, curpoint, data, count++);
 
     curpoint = TOPOROUTER_VERTEX( gts_eheap_remove_top(openlist, NULL) );
+    r->stats.expansions++;
     if(curpoint->parent && !(curpoint->flags & VERTEX_FLAG_TEMP)) {
       if(vz(curpoint) != vz(destv)) {
         toporouter_vertex_t *tempv;
@@ -4821,16 +4968,11 @@ route(toporouter_t *r, toporouter_route_t *data, guint debug)
     i = candidatepoints;
     while(i) {
       toporouter_vertex_t *temppoint = TOPOROUTER_VERTEX(i->data);
-      if(!g_list_find(closelist, temppoint) && candidate_is_available(curpoint, temppoint)) { //&& temppoint != curpoint) {
-        toporouter_heap_search_data_t heap_search_data = { temppoint, NULL };
-
+      if(!in_closelist(temppoint) && candidate_is_available(curpoint, temppoint)) { //&& temppoint != curpoint) {
         guint temp_gn;
         gdouble temp_g_cost = gcost(r, data, srcv, temppoint, curpoint, &temp_gn, pair);
       
-
-        gts_eheap_foreach(openlist,toporouter_heap_search, &heap_search_data);
-
-        if(heap_search_data.result) {
+        if(in_openlist(temppoint)) {
           if(temp_g_cost < temppoint->gcost) {
             
             temppoint->gcost = temp_g_cost;
@@ -4839,7 +4981,7 @@ route(toporouter_t *r, toporouter_route_t *data, guint debug)
             temppoint->parent = curpoint;
             curpoint->child = temppoint;
             
-            gts_eheap_update(openlist);
+            gts_eheap_decrease_key(openlist, temppoint->openpair, FCOST(temppoint));
           }
         }else{
           temppoint->parent = curpoint;
@@ -4850,7 +4992,7 @@ route(toporouter_t *r, toporouter_route_t *data, guint debug)
 
           temppoint->hcost = simple_h_cost(r, temppoint, destv);
 //          if(cur_layer != dest_layer) temppoint->hcost += r->viacost;
-          gts_eheap_insert(openlist, temppoint);
+          openlist_insert(temppoint);
         }
       
       }
@@ -5027,7 +5169,6 @@ routing_return:
   data->destvertices = NULL;
   data->srcvertices = NULL;
   gts_eheap_destroy(openlist);     
-  g_list_free(closelist);
 
   data->alltemppoints = NULL;
 
@@ -6601,6 +6742,7 @@ toporouter_export(toporouter_t *r)
 {
   GList *i = r->routednets;
   GList *oproutes = NULL;
+  gint64 start = g_get_monotonic_time();
 
   while(i) {
     toporouter_route_t *routedata = TOPOROUTER_ROUTE(i->data);
@@ -6608,6 +6750,8 @@ toporouter_export(toporouter_t *r)
     oproutes = g_list_prepend(oproutes, oproute);
     i = i->next;
   }
+  r->stats.relaxation = g_get_monotonic_time() - start;
+  start = g_get_monotonic_time();
 
   i = oproutes;
   while(i) {
@@ -6626,6 +6770,7 @@ toporouter_export(toporouter_t *r)
   printf (_("Wiring cost: %f inches\n"), COORD_TO_INCH (r->wiring_score));
 
   g_list_free(oproutes);
+  r->stats.export = g_get_monotonic_time() - start;
 
 }
 
@@ -7353,6 +7498,7 @@ roar_route(toporouter_t *r, toporouter_route_t *routedata, gint threshold)
     while(j) {
       toporouter_route_t *conflict = TOPOROUTER_ROUTE(j->data);
       g_assert(conflict->src->c != conflict->dest->c);
+      r->stats.reroutes++;
       if(route(r, conflict, 0)) { 
         cluster_merge(conflict);
         
@@ -7448,6 +7594,7 @@ roar_detour_route(toporouter_t *r, toporouter_route_t *data)
   gdouble pscore = data->score, nscore = 0.; 
   GList *netlists = NULL;
 
+  r->stats.detours++;
   route_checkpoint(data, NULL);
 
   REMOVE_ROUTING(data);
@@ -7633,7 +7780,16 @@ parse_arguments(toporouter_t *r, int argc, char **argv)
 {
   int i, tempint;
   for(i=0;i<argc;i++) {
-    if(sscanf(argv[i], "viacost=%d", &tempint)) {
+    if(!strcmp(argv[i], "bench")) {
+      r->bench = stdout;
+    }else if(!strncmp(argv[i], "bench=", 6)) {
+      /* appended to, so that runs of several builds can be compared */
+      if(!(r->bench = fopen(argv[i] + 6, "a"))) {
+        OpenErrorMessage(argv[i] + 6);
+      }
+    }else if(sscanf(argv[i], "seed=%d", &tempint) == 1) {
+      r->seed = tempint;
+    }else if(sscanf(argv[i], "viacost=%d", &tempint)) {
       /* XXX: We should be using PCB's generic value with unit parsing here */
       r->viacost = (double)tempint;
     }else if(sscanf(argv[i], "l%d", &tempint)) {
@@ -7685,6 +7841,9 @@ toporouter_new(void)
   r->routednets = NULL;
   r->failednets = NULL;
 
+  r->bench = NULL;
+  r->seed = 0;
+
   ltime=time(NULL); 
 
   gts_predicates_init();
@@ -7729,19 +7888,67 @@ toporouter_set_pair(toporouter_t *r, toporouter_netlist_t *n1, toporouter_netlis
   return 1;
 }
 
+/*!
+ * \brief Write the benchmark line of a run.
+ *
+ * It is one line of key=value pairs, times in seconds, so that the lines
+ * of runs of different builds can be told apart and compared by scripts.
+ */
+static void
+toporouter_bench_report(toporouter_t *r)
+{
+  toporouter_stats_t *s = &r->stats;
+
+  fprintf(r->bench, "toporouter seed=%u nets=%u routed=%u failed=%u"
+          " import_geometry=%.6f build_cdt=%.6f twonets=%.6f routing=%.6f"
+          " relaxation=%.6f export=%.6f searches=%u expansions=%u"
+          " triangles=%u reroutes=%u detours=%u wiring_score=%.6f\n",
+          r->seed, r->routes->len, g_list_length(r->routednets),
+          g_list_length(r->failednets),
+          s->import_geometry / 1e6, s->build_cdt / 1e6, s->twonets / 1e6,
+          s->routing / 1e6, s->relaxation / 1e6, s->export / 1e6,
+          s->searches, s->expansions, s->triangles, s->reroutes, s->detours,
+          COORD_TO_INCH(r->wiring_score));
+  if(r->bench == stdout) fflush(r->bench);
+  else fclose(r->bench);
+}
+
+typedef struct {
+  int argc;
+  char **argv;
+} toporouter_args_t;
+
+/* Route the board, as a job of the toporouter action */
 static int 
-toporouter (int argc, char **argv, Coord x, Coord y)
+toporouter_job (void *data)
 {
+  toporouter_args_t *args = (toporouter_args_t *) data;
   toporouter_t *r = toporouter_new();
-  parse_arguments(r, argc, argv);
+  gint64 start;
+
+  parse_arguments(r, args->argc, args->argv);
+  /* a benchmark run is seeded, so that runs of different builds route
+   * alike; randomized heaps are the only users */
+  if(r->bench && !r->seed) r->seed = 1;
+  if(r->seed) {
+    srand(r->seed);
+    srandom(r->seed);
+  }
+
+  start = g_get_monotonic_time();
   import_geometry(r);
+  r->stats.import_geometry = g_get_monotonic_time() - start - r->stats.build_cdt;
+  start = g_get_monotonic_time();
   acquire_twonets(r);
+  r->stats.twonets = g_get_monotonic_time() - start;
 
 //if(!toporouter_set_pair(r, find_netlist_by_name(r, "  DRAM_DQS_N"), find_netlist_by_name(r, "  DRAM_DQS"))) {
 //  printf("Couldn't associate pair\n");
 //}
 
+  start = g_get_monotonic_time();
   hybrid_router(r);
+  r->stats.routing = g_get_monotonic_time() - start;
 /*
   for(gint i=0;i<groupcount();i++) {
    gts_surface_foreach_edge(r->layers[i].surface, space_edge, NULL);
@@ -7756,6 +7963,7 @@ toporouter (int argc, char **argv, Coord x, Coord y)
   }
 */
   toporouter_export(r);
+  if(r->bench) toporouter_bench_report(r);
   toporouter_free(r);
   
   SaveUndoSerialNumber ();
@@ -7769,6 +7977,16 @@ toporouter (int argc, char **argv, Coord x, Coord y)
   return 0;
 }
 
+static int 
+toporouter (int argc, char **argv, Coord x, Coord y)
+{
+  toporouter_args_t args;
+
+  args.argc = argc;
+  args.argv = argv;
+  return pcb_job_run (_("Topological routing"), toporouter_job, &args);
+}
+
 static int 
 escape (int argc, char **argv, Coord x, Coord y)
 {
@@ -7867,7 +8085,8 @@ static HID_Action toporouter_action_list[] = {
   {"Escape", N_("Select a set of pads"), escape,
     N_("Pad escape"), N_("Escape()")},
   {"Toporouter", N_("Select net(s)"), toporouter,
-    N_("Topological autorouter"), N_("Toporouter()")}
+    N_("Topological autorouter"),
+    N_("Toporouter([viacost=n][,ln...][,seed=n][,bench|bench=file])")}
 };
 
 REGISTER_ACTIONS (toporouter_action_list)
@@ -208,6 +208,11 @@ struct _toporouter_vertex_t {
   gdouble gcost, hcost;
   guint gn;
 
+  /* the route() searches that last opened and closed the vertex, and
+   * its place on the open list of the one that opened it */
+  guint opened, closed;
+  GtsEHeapPair *openpair;
+
   struct _toporouter_arc_t *arc;
 
   struct _toporouter_oproute_t *oproute;
@@ -254,6 +259,8 @@ typedef struct {
   GList *constraints; 
   GList *edges;
 
+  GNode *bboxtree;  /* of the bboxes of the layer, see layer_bbox_trees() */
+
 } toporouter_layer_t;
 
 #define TOPOROUTER_VERTEX_REGION(x) ((toporouter_vertex_region_t *)x)
@@ -407,6 +414,14 @@ typedef struct {
 
 #define TOPOROUTER_NETSCORE(x) ((toporouter_netscore_t *)x)
 
+/* time spent in each phase, in microseconds, and the work done by the
+ * router, reported by the bench argument */
+typedef struct {
+  gint64 import_geometry, build_cdt, twonets, routing, relaxation, export;
+
+  guint searches, expansions, triangles, reroutes, detours;
+} toporouter_stats_t;
+
 struct _toporouter_t {
   GSList *bboxes;
   GNode *bboxtree;
@@ -436,6 +451,11 @@ struct _toporouter_t {
   struct timeval starttime;  
 
   FILE *debug;
+
+  /* bench: where the benchmark line goes, NULL if not wanted */
+  FILE *bench;
+  guint seed;
+  toporouter_stats_t stats;
 };
 
 typedef gint (*oproute_adjseg_func)
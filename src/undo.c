@@ -64,7 +64,9 @@
 #include "create.h"
 #include "data.h"
 #include "draw.h"
+#include "drc/drc.h"
 #include "error.h"
+#include "find.h"
 #include "flags.h"
 #include "insert.h"
 #include "misc.h"
@@ -72,6 +74,7 @@
 #include "move.h"
 #include "mymem.h"
 #include "polygon.h"
+#include "rats.h"
 #include "remove.h"
 #include "rotate.h"
 #include "rtree.h"
@@ -116,8 +119,8 @@ typedef struct
   Coord X; /*!< Data. */
   Coord Y; /*!< Data. */
   int ID;
-  Cardinal Index; /*!< Index in a polygons array of points. */
-  bool last_in_contour; /*!< Whether the point was the last in its contour. */
+  unsigned Index:31; /*!< Index in a polygons array of points. */
+  unsigned last_in_contour:1; /*!< Whether the point was the last in its contour. */
 } RemovedPointType;
 
 /*!
@@ -176,6 +179,9 @@ typedef struct
 
 /*!
  * \brief Holds information about an operation.
+ *
+ * Operations only record what changed, the largest of them being a
+ * removed point, so that the entries stay small.
  */
 typedef struct
 {
@@ -206,12 +212,16 @@ typedef struct
  * some local variables
  */
 static DataType *RemoveList = NULL; /*!< List of removed objects. */
-static UndoListType *UndoList = NULL; /*!< List of operations. */
+static UndoListType **UndoChunks = NULL; /*!< Chunks of STEP_UNDOLIST operations. */
+static size_t UndoChunksN; /*!< Number of chunks. */
+static size_t UndoChunksMax; /*!< Room for chunks. */
+static size_t UndoBase; /*!< Position of the first entry of the first chunk. */
+static size_t UndoFirst; /*!< Position of the oldest entry. */
+static size_t UndoHeld; /*!< Estimated bytes of the names and objects kept. */
 static int Serial = 1; /*!< Serial number. */
 static int SavedSerial;
 static size_t UndoN; /*!< Number of entries. */
 static size_t RedoN; /*!< Number of entries. */
-static size_t UndoMax; /*!< Number of entries. */
 static bool Locked = false; /*!< Do not add entries if. */
 static bool andDraw = true;
 										/* flag is set; prevents from */
@@ -243,6 +253,219 @@ static bool UndoClearPoly (UndoListType *);
 static bool UndoSetViaLayers (UndoListType *);
 static int PerformUndo (UndoListType *);
 
+/*!
+ * \brief Tells the DRC and the rats nest which object an operation
+ * changes.
+ */
+static void
+NoteChange (UndoListType *Entry)
+{
+  switch (Entry->Type)
+    {
+    case UNDO_LAYERCHANGE:
+      DRCNoteChangeAll ();
+      RatsNoteChangeAll ();
+      break;
+    case UNDO_NETLISTCHANGE:
+      RatsNoteChangeAll ();
+      break;
+    default:
+      DRCNoteChange (Entry->ID);
+      RatsNoteChange (Entry->ID, Entry->Kind, Entry->Type);
+      break;
+    }
+}
+
+/*!
+ * \brief Returns the n-th entry of the undo list, counted from the
+ * oldest one.
+ */
+static UndoListType *
+UndoEntry (size_t n)
+{
+  size_t pos = UndoFirst + n - UndoBase;
+
+  return &UndoChunks[pos / STEP_UNDOLIST][pos % STEP_UNDOLIST];
+}
+
+/*!
+ * \brief Returns an estimate of the memory an object kept by the undo
+ * list takes.
+ */
+static size_t
+HeldObjectSize (int Type, void *Ptr2)
+{
+  switch (Type)
+    {
+    case VIA_TYPE:
+      return sizeof (PinType);
+    case LINE_TYPE:
+      return sizeof (LineType);
+    case ARC_TYPE:
+      return sizeof (ArcType);
+    case RATLINE_TYPE:
+      return sizeof (RatType);
+    case TEXT_TYPE:
+      {
+	TextType *text = (TextType *) Ptr2;
+
+	return sizeof (TextType)
+	  + (text->TextString ? strlen (text->TextString) + 1 : 0);
+      }
+    case POLYGON_TYPE:
+      {
+	PolygonType *polygon = (PolygonType *) Ptr2;
+
+	return sizeof (PolygonType) + polygon->PointN * sizeof (PointType);
+      }
+    case ELEMENT_TYPE:
+      {
+	ElementType *element = (ElementType *) Ptr2;
+
+	return sizeof (ElementType) + element->PinN * sizeof (PinType)
+	  + element->PadN * sizeof (PadType)
+	  + element->LineN * sizeof (LineType)
+	  + element->ArcN * sizeof (ArcType);
+      }
+    default:
+      return 0;
+    }
+}
+
+/*!
+ * \brief Counts memory the undo list keeps, or no longer keeps.
+ */
+static void
+NoteHeld (size_t size, bool held)
+{
+  if (held)
+    UndoHeld += size;
+  else
+    UndoHeld -= MIN (size, UndoHeld);
+}
+
+/*!
+ * \brief Returns an estimate of the memory the undo list takes.
+ */
+static size_t
+UndoListSize (void)
+{
+  return UndoChunksN * STEP_UNDOLIST * sizeof (UndoListType) + UndoHeld;
+}
+
+/*!
+ * \brief Returns an estimate of the memory the undo list takes, with the
+ * objects kept for it in the RemoveList.
+ *
+ * Sets *entries to the number of entries that can be undone or redone,
+ * and *removed to the number of objects in the RemoveList.
+ */
+size_t
+UndoMemory (size_t *entries, Cardinal *removed)
+{
+  int i;
+
+  *entries = UndoN + RedoN;
+  *removed = 0;
+  if (RemoveList)
+    {
+      *removed = RemoveList->ViaN + RemoveList->ElementN + RemoveList->RatN;
+      for (i = 0; i < max_copper_layer + SILK_LAYER; i++)
+	*removed += RemoveList->Layer[i].LineN + RemoveList->Layer[i].ArcN
+	  + RemoveList->Layer[i].TextN + RemoveList->Layer[i].PolygonN;
+    }
+  return UndoListSize ();
+}
+
+/*!
+ * \brief Frees what an entry keeps once it can no longer be undone or
+ * redone.
+ *
+ * Removed objects, created objects that were undone and the copies of
+ * polygons with changed contours are kept in the RemoveList, and are
+ * found again through its ID index.  An undone creation reads
+ * UNDO_REMOVE; an entry that reads UNDO_CREATE belongs to an object on
+ * the board, which is not ours to free.
+ */
+static void
+ForgetUndoEntry (UndoListType *ptr)
+{
+  void *ptr1, *ptr2, *ptr3;
+  int type;
+
+  switch (ptr->Type)
+    {
+    case UNDO_CHANGENAME:
+      if (ptr->Data.ChangeName.Name)
+	NoteHeld (strlen (ptr->Data.ChangeName.Name) + 1, false);
+      ReleaseString (ptr->Data.ChangeName.Name);
+      break;
+    case UNDO_REMOVE:
+    case UNDO_REMOVE_CONTOUR:
+    case UNDO_INSERT_CONTOUR:
+      if (!RemoveList)
+	break;
+      type =
+	SearchObjectByID (RemoveList, &ptr1, &ptr2, &ptr3,
+			  ptr->Type == UNDO_REMOVE ? ptr->ID : ptr->Data.CopyID,
+			  ptr->Kind);
+      if (type != NO_TYPE)
+	{
+	  NoteHeld (HeldObjectSize (type, ptr2), false);
+	  DestroyObject (RemoveList, type, ptr1, ptr2, ptr3);
+	}
+      break;
+    default:
+      break;
+    }
+}
+
+/*!
+ * \brief Frees the chunks that only hold forgotten entries.
+ */
+static void
+FreeForgottenChunks (void)
+{
+  size_t n = (UndoFirst - UndoBase) / STEP_UNDOLIST;
+  size_t i;
+
+  if (n == 0)
+    return;
+  for (i = 0; i < n; i++)
+    free (UndoChunks[i]);
+  UndoChunksN -= n;
+  memmove (UndoChunks, UndoChunks + n, UndoChunksN * sizeof (*UndoChunks));
+  UndoBase += n * STEP_UNDOLIST;
+}
+
+/*!
+ * \brief Forgets the oldest operations while the undo list takes more
+ * memory than Settings.UndoBudget allows.
+ *
+ * Only whole operations are forgotten, and never the one being
+ * recorded.
+ */
+static void
+EnforceUndoBudget (void)
+{
+  size_t budget = (size_t) Settings.UndoBudget << 10;
+  int current = between_increment_and_restore ? MIN (Serial, SavedSerial)
+					       : Serial;
+  int oldest;
+
+  while (UndoN && UndoListSize () > budget
+	 && (oldest = UndoEntry (0)->Serial) < current)
+    {
+      while (UndoN && UndoEntry (0)->Serial == oldest)
+	{
+	  ForgetUndoEntry (UndoEntry (0));
+	  UndoFirst++;
+	  UndoN--;
+	}
+      FreeForgottenChunks ();
+    }
+}
+
 /*!
  * \brief Adds a command plus some data to the undo list.
  */
@@ -250,28 +473,40 @@ static UndoListType *
 GetUndoSlot (int CommandType, int ID, int Kind)
 {
   UndoListType *ptr;
-  void *ptr1, *ptr2, *ptr3;
-  int type;
   static size_t limit = UNDO_WARNING_SIZE;
 
 #ifdef DEBUG_ID
+  void *ptr1, *ptr2, *ptr3;
+
   if (SearchObjectByID (PCB->Data, &ptr1, &ptr2, &ptr3, ID, Kind) == NO_TYPE)
     Message ("hace: ID (%d) and Type (%x) mismatch in AddObject...\n", ID,
 	     Kind);
 #endif
 
-  /* allocate memory */
-  if (UndoN >= UndoMax)
+  /* free structures from the pruned redo list */
+  for (; RedoN; RedoN--)
+    ForgetUndoEntry (UndoEntry (UndoN + RedoN - 1));
+
+  if (Settings.UndoBudget > 0)
+    EnforceUndoBudget ();
+
+  /* allocate memory, a chunk at a time so that entries never move */
+  if (UndoFirst + UndoN - UndoBase >= UndoChunksN * STEP_UNDOLIST)
     {
       size_t size;
 
-      UndoMax += STEP_UNDOLIST;
-      size = UndoMax * sizeof (UndoListType);
-      UndoList = (UndoListType *) realloc (UndoList, size);
-      memset (&UndoList[UndoN], 0, STEP_REMOVELIST * sizeof (UndoListType));
+      if (UndoChunksN >= UndoChunksMax)
+	{
+	  UndoChunksMax += STEP_UNDOLIST / 10;
+	  UndoChunks = (UndoListType **)
+	    realloc (UndoChunks, UndoChunksMax * sizeof (*UndoChunks));
+	}
+      UndoChunks[UndoChunksN++] =
+	(UndoListType *) calloc (STEP_UNDOLIST, sizeof (UndoListType));
 
       /* ask user to flush the table because of it's size */
-      if (size > limit)
+      size = UndoListSize ();
+      if (Settings.UndoBudget <= 0 && size > limit)
 	{
 	  limit = (size / UNDO_WARNING_SIZE + 1) * UNDO_WARNING_SIZE;
 	  Message (_("Size of 'undo-list' exceeds %li kb\n"),
@@ -279,36 +514,16 @@ GetUndoSlot (int CommandType, int ID, int Kind)
 	}
     }
 
-  /* free structures from the pruned redo list */
-
-  for (ptr = &UndoList[UndoN]; RedoN; ptr++, RedoN--)
-    switch (ptr->Type)
-      {
-      case UNDO_CHANGENAME:
-	free (ptr->Data.ChangeName.Name);
-	break;
-      case UNDO_REMOVE:
-	type =
-	  SearchObjectByID (RemoveList, &ptr1, &ptr2, &ptr3, ptr->ID,
-			    ptr->Kind);
-	if (type != NO_TYPE)
-	  {
-	    DestroyObject (RemoveList, type, ptr1, ptr2, ptr3);
-	  }
-	break;
-      default:
-	break;
-      }
-
   if (between_increment_and_restore)
     added_undo_between_increment_and_restore = true;
 
   /* copy typefield and serial number to the list */
-  ptr = &UndoList[UndoN++];
+  ptr = UndoEntry (UndoN++);
   ptr->Type = CommandType;
   ptr->Kind = Kind;
   ptr->ID = ID;
   ptr->Serial = Serial;
+  NoteChange (ptr);
   return (ptr);
 }
 
@@ -403,6 +618,55 @@ UndoChangeName (UndoListType *Entry)
   return (false);
 }
 
+/*!
+ * \brief The search tree of a copper object whose bounding box follows
+ * its size, clearance and mask, NULL for other objects.
+ */
+static rtree_t *
+SizedObjectTree (int type, void *ptr1)
+{
+  switch (type)
+    {
+    case PIN_TYPE:
+      return PCB->Data->pin_tree;
+    case VIA_TYPE:
+      return PCB->Data->via_tree;
+    case PAD_TYPE:
+      return PCB->Data->pad_tree;
+    case LINE_TYPE:
+      return ((LayerType *) ptr1)->line_tree;
+    case ARC_TYPE:
+      return ((LayerType *) ptr1)->arc_tree;
+    }
+  return NULL;
+}
+
+/*!
+ * \brief Puts an object taken out of its tree by SizedObjectTree() back,
+ * with its bounding box for its new size.
+ */
+static void
+ReinsertSizedObject (rtree_t *tree, int type, void *ptr2)
+{
+  switch (type)
+    {
+    case PIN_TYPE:
+    case VIA_TYPE:
+      SetPinBoundingBox ((PinType *) ptr2);
+      break;
+    case PAD_TYPE:
+      SetPadBoundingBox ((PadType *) ptr2);
+      break;
+    case LINE_TYPE:
+      SetLineBoundingBox ((LineType *) ptr2);
+      break;
+    case ARC_TYPE:
+      SetArcBoundingBox ((ArcType *) ptr2);
+      break;
+    }
+  r_insert_entry (tree, (BoxType *) ptr2, 0);
+}
+
 /*!
  * \brief Recovers an object from a 2ndSize change operation.
  */
@@ -472,17 +736,23 @@ UndoChangeClearSize (UndoListType *Entry)
   void *ptr1, *ptr2, *ptr3;
   int type;
   Coord swap;
+  rtree_t *tree;
 
   /* lookup entry by ID */
   type =
     SearchObjectByID (PCB->Data, &ptr1, &ptr2, &ptr3, Entry->ID, Entry->Kind);
   if (type != NO_TYPE)
     {
+      tree = SizedObjectTree (type, ptr1);
       swap = ((PinType *) ptr2)->Clearance;
       RestoreToPolygon (PCB->Data, type, ptr1, ptr2);
       if (andDraw)
 	EraseObject (type, ptr1, ptr2);
+      if (tree)
+	r_delete_entry (tree, (BoxType *) ptr2);
       ((PinType *) ptr2)->Clearance = Entry->Data.Size;
+      if (tree)
+	ReinsertSizedObject (tree, type, ptr2);
       ClearFromPolygon (PCB->Data, type, ptr1, ptr2);
       Entry->Data.Size = swap;
       if (andDraw)
@@ -501,6 +771,7 @@ UndoChangeMaskSize (UndoListType *Entry)
   void *ptr1, *ptr2, *ptr3;
   int type;
   Coord swap;
+  rtree_t *tree;
 
   /* lookup entry by ID */
   type =
@@ -510,12 +781,15 @@ UndoChangeMaskSize (UndoListType *Entry)
       swap =
 	(type ==
 	 PAD_TYPE ? ((PadType *) ptr2)->Mask : ((PinType *) ptr2)->Mask);
+      tree = SizedObjectTree (type, ptr1);
       if (andDraw)
 	EraseObject (type, ptr1, ptr2);
+      r_delete_entry (tree, (BoxType *) ptr2);
       if (type == PAD_TYPE)
 	((PadType *) ptr2)->Mask = Entry->Data.Size;
       else
 	((PinType *) ptr2)->Mask = Entry->Data.Size;
+      ReinsertSizedObject (tree, type, ptr2);
       Entry->Data.Size = swap;
       if (andDraw)
 	DrawObject (type, ptr1, ptr2);
@@ -534,6 +808,7 @@ UndoChangeSize (UndoListType *Entry)
   void *ptr1, *ptr2, *ptr3;
   int type, iswap = 0;
   Coord swap = 0;
+  rtree_t *tree;
 
   /* lookup entry by ID */
   type =
@@ -565,9 +840,12 @@ UndoChangeSize (UndoListType *Entry)
 	  break;
 	}
 
+      tree = SizedObjectTree (type, ptr1);
       RestoreToPolygon (PCB->Data, type, ptr1, ptr2);
       if (andDraw)
 	EraseObject (type, ptr1, ptr2);
+      if (tree)
+	r_delete_entry (tree, (BoxType *) ptr2);
 
       switch (type)
 	{
@@ -596,6 +874,8 @@ UndoChangeSize (UndoListType *Entry)
 	  Entry->Data.Size = swap;
 	  break;
 	}
+      if (tree)
+	ReinsertSizedObject (tree, type, ptr2);
 
       ClearFromPolygon (PCB->Data, type, ptr1, ptr2);
       if (andDraw)
@@ -637,6 +917,7 @@ UndoFlag (UndoListType *Entry)
 	EraseObject (type, ptr1, ptr2);
 
       pin->Flags = Entry->Data.Flags;
+      NOTE_FLAGS (pin->Flags.f);
 
       Entry->Data.Flags = swap;
 
@@ -700,6 +981,7 @@ UndoCopyOrCreate (UndoListType *Entry)
       if (andDraw)
 	EraseObject (type, ptr1, ptr2);
       /* in order to make this re-doable we move it to the RemoveList */
+      NoteHeld (HeldObjectSize (type, ptr2), true);
       MoveObjectToBuffer (RemoveList, PCB->Data, type, ptr1, ptr2, ptr3);
       Entry->Type = UNDO_REMOVE;
       return (true);
@@ -751,6 +1033,7 @@ UndoRemove (UndoListType *Entry)
     {
       if (andDraw)
 	DrawRecoveredObject (type, ptr1, ptr2, ptr3);
+      NoteHeld (HeldObjectSize (type, ptr2), false);
       MoveObjectToBuffer (PCB->Data, RemoveList, type, ptr1, ptr2, ptr3);
       Entry->Type = UNDO_CREATE;
       return (true);
@@ -806,16 +1089,17 @@ UndoRemovePoint (UndoListType *Entry)
     {
     case POLYGON_TYPE:		/* restore the removed point */
       {
+	Cardinal index = Entry->Data.RemovedPoint.Index;
+
 	/* recover the point */
 	if (andDraw && layer->On)
 	  ErasePolygon (polygon);
-	InsertPointIntoObject (POLYGON_TYPE, layer, polygon,
-			       &Entry->Data.RemovedPoint.Index,
+	InsertPointIntoObject (POLYGON_TYPE, layer, polygon, &index,
 			       Entry->Data.RemovedPoint.X,
 			       Entry->Data.RemovedPoint.Y, true,
 			       Entry->Data.RemovedPoint.last_in_contour);
 
-	polygon->Points[Entry->Data.RemovedPoint.Index].ID =
+	polygon->Points[index].ID =
 	  Entry->Data.RemovedPoint.ID;
 	if (andDraw && layer->On)
 	  DrawPolygon (layer, polygon);
@@ -916,6 +1200,7 @@ UndoSwapCopiedObject (UndoListType *Entry)
   swap_id = obj->ID;
   obj->ID = obj2->ID;
   obj2->ID = swap_id;
+  IDIndexInvalidate ();
 
   MoveObjectToBuffer (RemoveList, PCB->Data, type, ptr1b, ptr2b, ptr3b);
 
@@ -1098,7 +1383,7 @@ Undo (bool draw)
 
   Serial --;
 
-  ptr = &UndoList[UndoN - 1];
+  ptr = UndoEntry (UndoN - 1);
 
   if (ptr->Serial > Serial)
     {
@@ -1118,9 +1403,13 @@ Undo (bool draw)
     }
 
   LockUndo (); /* lock undo module to prevent from loops */
+  DeferDraw ();
+  DeferPolygonClipping ();
+  r_defer_inserts ();
 
   /* Loop over all entries with the correct serial number */
-  for (; UndoN && ptr->Serial == Serial; ptr--, UndoN--, RedoN++)
+  for (; UndoN && (ptr = UndoEntry (UndoN - 1))->Serial == Serial;
+       UndoN--, RedoN++)
     {
       int undid = PerformUndo (ptr);
       if (undid == 0)
@@ -1128,6 +1417,9 @@ Undo (bool draw)
       Types |= undid;
     }
 
+  r_resume_inserts ();
+  ResumePolygonClipping ();
+  ResumeDraw ();
   UnlockUndo ();
 
   if (error_undoing)
@@ -1146,6 +1438,8 @@ Undo (bool draw)
 static int
 PerformUndo (UndoListType *ptr)
 {
+  NoteChange (ptr);
+
   switch (ptr->Type)
     {
     case UNDO_CHANGENAME:
@@ -1276,7 +1570,7 @@ Redo (bool draw)
       return 0;
     }
 
-  ptr = &UndoList[UndoN];
+  ptr = UndoEntry (UndoN);
 
   if (ptr->Serial < Serial)
     {
@@ -1296,15 +1590,22 @@ Redo (bool draw)
     }
 
   LockUndo (); /* lock undo module to prevent from loops */
+  DeferDraw ();
+  DeferPolygonClipping ();
+  r_defer_inserts ();
 
   /* and loop over all entries with the correct serial number */
-  for (; RedoN && ptr->Serial == Serial; ptr++, UndoN++, RedoN--)
+  for (; RedoN && (ptr = UndoEntry (UndoN))->Serial == Serial;
+       UndoN++, RedoN--)
     {
       int undid = PerformUndo (ptr);
       if (undid == 0)
         error_undoing = true;
       Types |= undid;
     }
+  r_resume_inserts ();
+  ResumePolygonClipping ();
+  ResumeDraw ();
 
   /* Make next serial number current */
   Serial++;
@@ -1365,8 +1666,13 @@ IncrementUndoSerialNumber (void)
   if (!Locked)
     {
       /* Set the changed flag if anything was added prior to this bump */
-      if (UndoN > 0 && UndoList[UndoN - 1].Serial == Serial)
-        SetChangedFlag (true);
+      if (UndoN > 0 && UndoEntry (UndoN - 1)->Serial == Serial)
+        {
+          /* The rats of the change are undone with it */
+          if (Settings.LiveRats)
+            AddChangedRats ();
+          SetChangedFlag (true);
+        }
       Serial++;
       Bumped = true;
       between_increment_and_restore = true;
@@ -1397,10 +1703,11 @@ MergeUndoSerialRange(int min, int max)
   int dsn = max - min; /* delta serial number */
   for(n = 0; n < UndoN; n++)
   {
-    if (UndoList[n].Serial < min) continue;
-    else if (UndoList[n].Serial <= max) UndoList[n].Serial = min;
+    UndoListType *ptr = UndoEntry (n);
+    if (ptr->Serial < min) continue;
+    else if (ptr->Serial <= max) ptr->Serial = min;
     /* greater than max */
-    else UndoList[n].Serial -= dsn;
+    else ptr->Serial -= dsn;
   }
   Serial -= dsn;
   return Serial;
@@ -1413,18 +1720,24 @@ void
 ClearUndoList (bool Force)
 {
   UndoListType *undo;
+  size_t n;
 
   if (UndoN
       && (Force || gui->confirm_dialog ("OK to clear 'undo' buffer?", 0)))
     {
       /* release memory allocated by objects in undo list */
-      for (undo = UndoList; UndoN; undo++, UndoN--)
+      for (n = 0; n < UndoN + RedoN; n++)
 	{
+	  undo = UndoEntry (n);
 	  if (undo->Type == UNDO_CHANGENAME)
-	    free (undo->Data.ChangeName.Name);
+	    ReleaseString (undo->Data.ChangeName.Name);
 	}
-      free (UndoList);
-      UndoList = NULL;
+      for (n = 0; n < UndoChunksN; n++)
+	free (UndoChunks[n]);
+      free (UndoChunks);
+      UndoChunks = NULL;
+      UndoChunksN = UndoChunksMax = 0;
+      UndoBase = UndoFirst = UndoHeld = 0;
       if (RemoveList)
 	{
           FreeDataMemory (RemoveList);
@@ -1433,11 +1746,15 @@ ClearUndoList (bool Force)
         }
 
       /* reset some counters */
-      UndoN = UndoMax = RedoN = 0;
+      UndoN = RedoN = 0;
     }
 
   /* reset counter in any case */
   Serial = 1;
+
+  /* This is also how a board is freed, the next DRC checks all of it */
+  DRCNoteChangeAll ();
+  RatsNoteChangeAll ();
 }
 
 /*!
@@ -1506,6 +1823,7 @@ MoveObjectToRemoveUndoList (int Type, void *Ptr1, void *Ptr2, void *Ptr3)
     RemoveList = CreateNewBuffer ();
 
   GetUndoSlot (UNDO_REMOVE, OBJECT_ID (Ptr3), Type);
+  NoteHeld (HeldObjectSize (Type, Ptr2), true);
   MoveObjectToBuffer (RemoveList, PCB->Data, Type, Ptr1, Ptr2, Ptr3);
 }
 
@@ -1579,6 +1897,7 @@ CopyObjectToUndoList (int undo_type, int Type, void *Ptr1, void *Ptr2, void *Ptr
   undo = GetUndoSlot (undo_type, OBJECT_ID (Ptr2), Type);
   copy = (AnyObjectType *)CopyObjectToBuffer (RemoveList, PCB->Data, Type, Ptr1, Ptr2, Ptr3);
   undo->Data.CopyID = copy->ID;
+  NoteHeld (HeldObjectSize (Type, copy), true);
 }
 
 /*!
@@ -1635,6 +1954,8 @@ AddObjectToChangeNameUndoList (int Type, void *Ptr1, void *Ptr2, void *Ptr3,
     {
       undo = GetUndoSlot (UNDO_CHANGENAME, OBJECT_ID (Ptr3), Type);
       undo->Data.ChangeName.Name = OldName;
+      if (OldName)
+	NoteHeld (strlen (OldName) + 1, true);
     }
 }
 
@@ -1675,6 +1996,8 @@ AddObjectToFlagUndoList (int Type, void *Ptr1, void *Ptr2, void *Ptr3)
 
   if (!Locked)
     {
+      /* the flags may change how the object connects */
+      ConnectionIndexInvalidate ();
       undo = GetUndoSlot (UNDO_FLAG, OBJECT_ID (Ptr2), Type);
       undo->Data.Flags = ((PinType *) Ptr2)->Flags;
     }
@@ -76,5 +76,6 @@ void AddNetlistLibToUndoList (LibraryType *);
 void LockUndo (void);
 void UnlockUndo (void);
 bool Undoing (void);
+size_t UndoMemory (size_t *, Cardinal *);
 
 #endif
@@ -198,6 +198,25 @@ vector_insert (vector_t * vector, int N, vector_element_t data)
   vector_insert_many (vector, N, &data, 1);
 }
 
+/*!
+ * \brief Make room for at least count elements.
+ *
+ * The vector at least doubles when it grows, so that appending one
+ * element at a time only reallocates a few times.
+ */
+void
+vector_reserve (vector_t * vector, int count)
+{
+  assert (__vector_is_good (vector));
+  if (count > vector->max)
+    {
+      vector->max = MAX (32, MAX (count, vector->max * 2));
+      vector->element = (void **)realloc (vector->element,
+				 vector->max * sizeof (*vector->element));
+      assert (vector->element);
+    }
+}
+
 /*!
  * \brief Add data at specified position of vector.
  */
@@ -210,12 +229,7 @@ vector_insert_many (vector_t * vector, int N,
   if (count == 0)
     return;
   assert (data && count > 0);
-  if (vector->size + count > vector->max)
-    {
-      vector->max = MAX (32, MAX (vector->size + count, vector->max * 2));
-      vector->element = (void **)realloc (vector->element,
-				 vector->max * sizeof (*vector->element));
-    }
+  vector_reserve (vector, vector->size + count);
   memmove (vector->element + N + count, vector->element + N,
 	   (vector->size - N) * sizeof (*vector->element));
   memmove (vector->element + N, data, count * sizeof (*data));
@@ -225,21 +239,67 @@ vector_insert_many (vector_t * vector, int N,
 
 /*!
  * \brief Copy a vector.
+ *
+ * The copy has room for a few more elements, not for as many as the
+ * original happened to have.
  */
 vector_t *
 vector_duplicate (vector_t * orig)
 {
   vector_t * newone = vector_create();
-  if (!orig)
+  if (!orig || orig->size == 0)
     return newone;
-  newone->element = (void **)malloc (orig->max * sizeof (*orig->element));
-  newone->max = orig->max;
+  newone->max = orig->size + MIN (orig->size, 32);
+  newone->element = (void **)malloc (newone->max * sizeof (*orig->element));
+  assert (newone->element);
   newone->size = orig->size;
   memcpy (newone->element, orig->element, orig->size * sizeof (vector_element_t));
   assert (__vector_is_good (newone));
   return newone;
 }
 
+/*!
+ * \brief Move all the elements of other_vector to the end of vector,
+ * leaving other_vector empty.
+ *
+ * If vector is empty it takes the storage of other_vector over instead
+ * of copying the elements.
+ */
+void
+vector_append_move (vector_t * vector, vector_t * other_vector)
+{
+  vector_element_t *element;
+  int max;
+
+  assert (__vector_is_good (vector));
+  assert (__vector_is_good (other_vector));
+  if (vector->size == 0 && other_vector->max >= vector->max)
+    {
+      element = vector->element;
+      max = vector->max;
+      vector->element = other_vector->element;
+      vector->max = other_vector->max;
+      vector->size = other_vector->size;
+      other_vector->element = element;
+      other_vector->max = max;
+    }
+  else
+    vector_append_vector (vector, other_vector);
+  other_vector->size = 0;
+  assert (__vector_is_good (vector));
+  assert (__vector_is_good (other_vector));
+}
+
+/*!
+ * \brief Delete all the elements of the vector, keeping its storage.
+ */
+void
+vector_clear (vector_t * vector)
+{
+  assert (__vector_is_good (vector));
+  vector->size = 0;
+}
+
 /*!
  * \brief Return and delete the *last* element of vector.
  */
@@ -267,6 +327,25 @@ vector_remove (vector_t * vector, int N)
   return old;
 }
 
+/*!
+ * \brief Return and delete data at specified position of vector,
+ * putting the last element in its place.
+ *
+ * This does not keep the order of the vector, but it does not move the
+ * elements after N either.
+ */
+vector_element_t
+vector_remove_fast (vector_t * vector, int N)
+{
+  vector_element_t old;
+  assert (__vector_is_good (vector));
+  assert (N < vector->size);
+  old = vector->element[N];
+  vector->element[N] = vector->element[--vector->size];
+  assert (__vector_is_good (vector));
+  return old;
+}
+
 /*!
  * \brief Replace the data at the specified position with the given
  * data.
@@ -69,8 +69,12 @@ void vector_append_vector (vector_t * vector, vector_t * other_vector);
 void vector_insert (vector_t * vector, int N, vector_element_t data);
 void vector_insert_many (vector_t * vector, int N,
 			 vector_element_t data[], int count);
+void vector_reserve (vector_t * vector, int count);
+void vector_append_move (vector_t * vector, vector_t * other_vector);
+void vector_clear (vector_t * vector);
 vector_element_t vector_remove_last (vector_t * vector);
 vector_element_t vector_remove (vector_t * vector, int N);
+vector_element_t vector_remove_fast (vector_t * vector, int N);
 vector_element_t vector_replace (vector_t * vector,
 				 vector_element_t data, int N);
 
@@ -0,0 +1,14 @@
+(Created by G-code exporter)
+(Wed Oct 14 19:16:53 2026)
+(Units: mm)
+(Board size: 22.00 x 17.78 mm)
+(Drill file: 1 drills)
+(Drill diameter: 0.889000 mm)
+#100=2.000000  (safe Z)
+#104=-2.000000  (drill depth)
+(---------------------------------)
+G17 G21 G90 G64 P0.003 M3 S3000 M7 F50.000000
+G0 Z#100
+G81 X2.996400 Y4.780000 Z#104 R#100
+M5 M9 M2
+(end, total distance 0.00mm = 0.00in)
@@ -0,0 +1,291 @@
+(Created by G-code exporter)
+(Wed Oct 14 19:16:53 2026)
+(Units: mm)
+(Board size: 22.00 x 17.78 mm)
+(Accuracy 600 dpi)
+(Tool diameter: 0.200000 mm)
+#100=2.000000  (safe Z)
+#101=-0.050000  (cutting depth)
+#102=25.000000  (plunge feedrate)
+#103=50.000000  (feedrate)
+(with predrilling)
+(---------------------------------)
+G17 G21 G90 G64 P0.003 M3 S3000 M7
+G0 Z#100
+(polygon 1)
+G0 X2.497667 Y4.021667    (start point)
+G1 Z#101 F#102
+F#103
+G1 X2.624667 Y3.894667
+G1 X3.005667 Y3.852333
+G1 X3.386667 Y3.894667
+G1 X3.471333 Y3.979333
+G1 X3.429000 Y4.021667
+G1 X3.132667 Y3.894667
+G1 X2.836333 Y3.894667
+G1 X2.540000 Y4.021667
+G1 X2.497667 Y4.021667
+G0 Z#100
+(polygon end, distance 2.11)
+(polygon 2)
+G0 X2.159000 Y5.249333    (start point)
+G1 Z#101 F#102
+F#103
+G1 X2.032000 Y4.995333
+G1 X1.989667 Y4.741333
+G1 X2.074333 Y4.402667
+G1 X2.159000 Y4.318000
+G1 X2.243667 Y4.318000
+G1 X2.116667 Y4.741333
+G1 X2.201333 Y5.122333
+G1 X2.243667 Y5.249333
+G1 X2.159000 Y5.249333
+G0 Z#100
+(polygon end, distance 2.15)
+(polygon 3)
+G0 X3.725333 Y5.249333    (start point)
+G1 Z#101 F#102
+F#103
+G1 X3.725333 Y5.207000
+G1 X3.852333 Y4.910667
+G1 X3.852333 Y4.614333
+G1 X3.725333 Y4.318000
+G1 X3.852333 Y4.318000
+G1 X3.979333 Y4.614333
+G1 X3.979333 Y4.868333
+G1 X3.810000 Y5.249333
+G1 X3.725333 Y5.249333
+G0 Z#100
+(polygon end, distance 2.19)
+(polygon 4)
+G0 X2.878667 Y5.715000    (start point)
+G1 Z#101 F#102
+F#103
+G1 X2.497667 Y5.588000
+G1 X2.540000 Y5.503333
+G1 X2.921000 Y5.630333
+G1 X3.344333 Y5.545667
+G1 X3.471333 Y5.503333
+G1 X3.471333 Y5.588000
+G1 X3.259667 Y5.672667
+G1 X2.878667 Y5.715000
+G0 Z#100
+(polygon end, distance 2.16)
+(polygon 5)
+G0 X2.413000 Y7.916333    (start point)
+G1 Z#101 F#102
+F#103
+G1 X2.413000 Y7.620000
+G1 X2.497667 Y7.704667
+G1 X2.497667 Y7.874000
+G1 X2.413000 Y7.916333
+G0 Z#100
+(polygon end, distance 0.68)
+(polygon 6)
+G0 X1.524000 Y7.916333    (start point)
+G1 Z#101 F#102
+F#103
+G1 X1.481667 Y7.747000
+G1 X1.566333 Y7.620000
+G1 X1.566333 Y7.916333
+G1 X1.524000 Y7.916333
+G0 Z#100
+(polygon end, distance 0.67)
+(polygon 7)
+G0 X1.820333 Y8.212667    (start point)
+G1 Z#101 F#102
+F#103
+G1 X1.905000 Y8.170333
+G1 X1.947333 Y8.212667
+G1 X1.820333 Y8.212667
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 8)
+G0 X4.699000 Y9.694333    (start point)
+G1 Z#101 F#102
+F#103
+G1 X4.656667 Y9.567333
+G1 X4.741333 Y9.398000
+G1 X4.741333 Y9.694333
+G1 X4.699000 Y9.694333
+G0 Z#100
+(polygon end, distance 0.66)
+(polygon 9)
+G0 X4.995333 Y9.990667    (start point)
+G1 Z#101 F#102
+F#103
+G1 X5.080000 Y9.948333
+G1 X5.122333 Y9.990667
+G1 X4.995333 Y9.990667
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 10)
+G0 X5.207000 Y9.990667    (start point)
+G1 Z#101 F#102
+F#103
+G1 X5.291667 Y9.948333
+G1 X5.334000 Y9.990667
+G1 X5.207000 Y9.990667
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 11)
+G0 X5.588000 Y9.694333    (start point)
+G1 Z#101 F#102
+F#103
+G1 X5.588000 Y9.398000
+G1 X5.672667 Y9.567333
+G1 X5.588000 Y9.694333
+G0 Z#100
+(polygon end, distance 0.64)
+(polygon 12)
+G0 X12.530667 Y12.911667    (start point)
+G1 Z#101 F#102
+F#103
+G1 X12.488333 Y12.784667
+G1 X12.530667 Y12.657667
+G1 X12.573000 Y12.784667
+G1 X12.530667 Y12.911667
+G0 Z#100
+(polygon end, distance 0.54)
+(polygon 13)
+G0 X13.038667 Y13.208000    (start point)
+G1 Z#101 F#102
+F#103
+G1 X13.123333 Y13.165667
+G1 X13.165667 Y13.208000
+G1 X13.038667 Y13.208000
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 14)
+G0 X13.419667 Y12.911667    (start point)
+G1 Z#101 F#102
+F#103
+G1 X13.419667 Y12.657667
+G1 X13.504333 Y12.742333
+G1 X13.419667 Y12.911667
+G0 Z#100
+(polygon end, distance 0.56)
+(polygon 15)
+G0 X17.229667 Y11.176000    (start point)
+G1 Z#101 F#102
+F#103
+G1 X17.229667 Y11.049000
+G1 X17.272000 Y11.133667
+G1 X17.229667 Y11.176000
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 16)
+G0 X17.229667 Y10.964333    (start point)
+G1 Z#101 F#102
+F#103
+G1 X17.229667 Y10.837333
+G1 X17.272000 Y10.922000
+G1 X17.229667 Y10.964333
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 17)
+G0 X17.229667 Y6.688667    (start point)
+G1 Z#101 F#102
+F#103
+G1 X17.229667 Y6.561667
+G1 X17.272000 Y6.646333
+G1 X17.229667 Y6.688667
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 18)
+G0 X17.229667 Y6.434667    (start point)
+G1 Z#101 F#102
+F#103
+G1 X17.229667 Y6.307667
+G1 X17.272000 Y6.392333
+G1 X17.229667 Y6.434667
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 19)
+G0 X16.213667 Y3.132667    (start point)
+G1 Z#101 F#102
+F#103
+G1 X16.213667 Y3.005667
+G1 X16.256000 Y3.090333
+G1 X16.213667 Y3.132667
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 20)
+G0 X18.711333 Y6.434667    (start point)
+G1 Z#101 F#102
+F#103
+G1 X18.711333 Y6.307667
+G1 X18.753667 Y6.392333
+G1 X18.711333 Y6.434667
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 21)
+G0 X18.711333 Y6.688667    (start point)
+G1 Z#101 F#102
+F#103
+G1 X18.711333 Y6.561667
+G1 X18.753667 Y6.646333
+G1 X18.711333 Y6.688667
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 22)
+G0 X18.711333 Y10.964333    (start point)
+G1 Z#101 F#102
+F#103
+G1 X18.711333 Y10.837333
+G1 X18.753667 Y10.922000
+G1 X18.711333 Y10.964333
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 23)
+G0 X20.701000 Y16.552333    (start point)
+G1 Z#101 F#102
+F#103
+G1 X20.701000 Y0.931333
+G1 X20.785667 Y0.931333
+G1 X20.785667 Y16.552333
+G1 X20.701000 Y16.552333
+G0 Z#100
+(polygon end, distance 31.41)
+(polygon 24)
+G0 X16.213667 Y14.520333    (start point)
+G1 Z#101 F#102
+F#103
+G1 X16.213667 Y14.393333
+G1 X16.256000 Y14.478000
+G1 X16.213667 Y14.520333
+G0 Z#100
+(polygon end, distance 0.28)
+(polygon 25)
+G0 X1.185333 Y16.552333    (start point)
+G1 Z#101 F#102
+F#103
+G1 X1.185333 Y0.931333
+G1 X1.270000 Y0.931333
+G1 X1.270000 Y16.552333
+G1 X1.185333 Y16.552333
+G0 Z#100
+(polygon end, distance 31.41)
+(polygon 26)
+G0 X0.889000 Y16.933333    (start point)
+G1 Z#101 F#102
+F#103
+G1 X0.804333 Y16.848667
+G1 X0.804333 Y0.677333
+G1 X0.973667 Y0.550333
+G1 X20.955000 Y0.550333
+G1 X21.166667 Y0.635000
+G1 X21.166667 Y16.848667
+G1 X21.082000 Y16.933333
+G1 X0.889000 Y16.933333
+G0 Z#100
+(polygon end, distance 73.24)
+(predrilling)
+F#102
+G81 X2.996400 Y4.780000 Z#101 R#100
+G81 X1.996400 Y7.780020 Z#101 R#100
+G81 X5.168400 Y9.555988 Z#101 R#100
+G81 X12.996418 Y12.780010 Z#101 R#100
+(4 predrills)
+(milling distance 152.07mm = 5.99in)
+M5 M9 M2
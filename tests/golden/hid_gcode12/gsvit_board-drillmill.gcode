@@ -0,0 +1,63 @@
+(Created by G-code exporter)
+(Wed Oct 14 19:16:53 2026)
+(Units: mm)
+(Board size: 22.00 x 17.78 mm)
+(Drillmill file)
+(Tool diameter: 1.000000 mm)
+#100=2.000000  (safe Z)
+#105=-1.000000  (mill depth)
+#106=25.000000  (mill plunge feedrate)
+#107=50.000000  (mill feedrate)
+(---------------------------------)
+G17 G21 G90 G64 P0.003 M3 S3000 M7
+G0 X17.996408 Y3.080258
+G1 Z#105 F#106
+F#107
+G1 X18.046445 Y3.080258
+G1 X17.996408 Y3.130295
+G1 X17.946371 Y3.080258
+G1 X17.996408 Y3.030221
+G1 X18.046445 Y3.080258
+G0 X17.996408 Y3.080258
+G0 Z#100
+G0 X17.996408 Y6.530086
+G1 Z#105 F#106
+F#107
+G1 X18.046445 Y6.530086
+G1 X17.996408 Y6.580123
+G1 X17.946371 Y6.530086
+G1 X17.996408 Y6.480049
+G1 X18.046445 Y6.530086
+G0 X17.996408 Y6.530086
+G0 Z#100
+G0 X17.996408 Y11.029950
+G1 Z#105 F#106
+F#107
+G1 X18.746342 Y11.029950
+G1 X18.570891 Y11.511998
+G1 X18.126633 Y11.768491
+G1 X17.621441 Y11.679412
+G1 X17.291701 Y11.286443
+G1 X17.291701 Y10.773457
+G1 X17.621441 Y10.380488
+G1 X18.126633 Y10.291409
+G1 X18.570891 Y10.547902
+G1 X18.746342 Y11.029950
+G0 X17.996408 Y11.029950
+G0 Z#100
+G0 X17.996408 Y14.479778
+G1 Z#105 F#106
+F#107
+G1 X18.746342 Y14.479778
+G1 X18.570891 Y14.961826
+G1 X18.126633 Y15.218319
+G1 X17.621441 Y15.129240
+G1 X17.291701 Y14.736271
+G1 X17.291701 Y14.223285
+G1 X17.621441 Y13.830316
+G1 X18.126633 Y13.741237
+G1 X18.570891 Y13.997730
+G1 X18.746342 Y14.479778
+G0 X17.996408 Y14.479778
+G0 Z#100
+M5 M9 M2
@@ -0,0 +1,360 @@
+#!/bin/sh
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of version 2 of the GNU General Public License as
+#  published by the Free Software Foundation
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+#  MA 02110-1301 USA.
+
+usage() {
+cat <<EOF
+
+$0 -- Run pcb export throughput benchmarks
+
+$0 -h|--help
+$0 [-u|--update] [-s|--sizes "n1 n2 ..."] [-x|--exporters "hid1 hid2 ..."]
+   [-t|--tolerance percent] [-b|--baseline file] [board1 [board2[ ...]]]
+
+OVERVIEW
+
+The $0 script times the export HIDs on large boards.  Each board of
+the testsuite inputs given (by default ${BOARDS}) is tiled into a grid
+of copies of itself until it has at least as many objects as each of the
+sizes, and is then exported with each of the export HIDs in turn.  The
+board "genboard" is written by pcb-genboard for each size instead, with
+BGA fan-outs, via fields and pours; it is among the default boards when
+\$GENBOARD (${GENBOARD}) has been built.
+
+For each export the wall time, the peak resident set size and the total
+size of the files written are recorded in ${OUTDIR}/results.txt, and
+compared with the baseline file.  An export that takes longer, or uses
+more memory, or writes more or less than the tolerance allows is
+reported and makes the script fail.
+
+The baseline depends on the machine, so it is not distributed.  Run
+with --update on a quiet machine to record one, and again whenever a
+change is meant to make an export slower.
+
+OPTIONS
+
+-b | --baseline <file> :  The baseline to compare with or update.  The
+                          default is ${BASELINE}.
+
+-s | --sizes <sizes>   :  The object counts of the boards.  The default
+                          is "${SIZES}".
+
+-t | --tolerance <pct> :  How much worse than the baseline, in percent,
+                          an export may be.  The default is ${TOLERANCE}.
+
+-u | --update          :  Write the results to the baseline instead of
+                          comparing them with it.
+
+-x | --exporters <hids> : The export HIDs to time.  The default is
+                          "${EXPORTERS}".
+
+The peak resident set size is only measured when GNU time is installed;
+set TIME to its path if it is not /usr/bin/time.
+
+EOF
+}
+
+# Source directory
+srcdir=${srcdir:-.}
+top_builddir=${top_builddir:-..}
+
+INDIR=${INDIR:-${srcdir}/inputs}
+OUTDIR=outputs/bench
+BASELINE=${srcdir}/bench.baseline
+BOARDS="ipcd356_board.pcb bom_general.pcb clearance.pcb"
+SIZES="10000 100000 1000000"
+EXPORTERS="bom bom_md gerber gcode IPC-D-356 nelma gsvit png ps kicad"
+TOLERANCE=25
+TIME=${TIME:-/usr/bin/time}
+GENBOARD=${GENBOARD:-./pcb-genboard}
+if test -x "${GENBOARD}" ; then
+    BOARDS="${BOARDS} genboard"
+fi
+
+update=no
+while test -n "$1"
+  do
+  case "$1"
+      in
+
+      -b|--baseline)
+	  BASELINE="$2"
+	  shift 2
+	  ;;
+
+      -h|--help)
+	  usage
+	  exit 0
+	  ;;
+
+      -s|--sizes)
+	  SIZES="$2"
+	  shift 2
+	  ;;
+
+      -t|--tolerance)
+	  TOLERANCE="$2"
+	  shift 2
+	  ;;
+
+      -u|--update)
+	  update=yes
+	  shift
+	  ;;
+
+      -x|--exporters)
+	  EXPORTERS="$2"
+	  shift 2
+	  ;;
+
+      -*)
+	  echo "unknown option: $1"
+	  exit 1
+	  ;;
+
+      *)
+	  break
+	  ;;
+
+  esac
+done
+
+if test $# -gt 0 ; then
+    BOARDS="$*"
+fi
+
+# The pcb wrapper script, with an absolute path as the exports run in
+# directories of their own.
+here=`pwd`
+case "${top_builddir}" in
+    /*) PCB=${PCB:-${top_builddir}/src/pcbtest.sh} ;;
+    *)  PCB=${PCB:-${here}/${top_builddir}/src/pcbtest.sh} ;;
+esac
+
+if ${TIME} -f "%e %M" -o /dev/null true > /dev/null 2>&1 ; then
+    have_gnu_time=yes
+else
+    have_gnu_time=no
+    echo "GNU time not found, the peak memory use will not be measured."
+fi
+
+mkdir -p ${OUTDIR}
+results=${OUTDIR}/results.txt
+rm -f ${results}
+
+##########################################################################
+#
+# synthetic boards
+#
+
+# Write the width and height of a board, in mil.
+board_size() {
+    awk '/^PCB\[/ {
+	n = split ($0, f, " ");
+	for (i = n - 1; i <= n; i++) {
+	    v = f[i];
+	    sub (/\].*$/, "", v);
+	    if (v ~ /mil$/)      { sub (/mil$/, "", v); v = v + 0; }
+	    else if (v ~ /mm$/)  { sub (/mm$/, "", v); v = v * 1e6 / 25400; }
+	    else if (v ~ /um$/)  { sub (/um$/, "", v); v = v * 1e3 / 25400; }
+	    else if (v ~ /nm$/)  { sub (/nm$/, "", v); v = v / 25400; }
+	    else                 v = v / 100;
+	    printf ("%s%.2f", i == n ? " " : "", v);
+	}
+	print "";
+	exit;
+    }' "$1"
+}
+
+# Count the objects of a board.
+board_objects() {
+    grep -cE '^[[:space:]]*(Pin|Pad|Line|Arc|Via|Polygon|Text|Element)[[(]' "$1"
+}
+
+# Tile a board into a grid of copies of itself with at least $3 objects,
+# through an action script: a row of copies is pasted first, and then
+# the row is pasted for each further row.
+make_board() {
+    src="$1"
+    dst="$2"
+    target="$3"
+
+    objects=`board_objects "$src"`
+    set -- `board_size "$src"`
+    width=$1
+    height=$2
+    set -- `awk -v n=$target -v k=$objects 'BEGIN {
+	tiles = int ((n + k - 1) / k);
+	cols = int (sqrt (tiles));
+	if (cols * cols < tiles)
+	    cols++;
+	rows = int ((tiles + cols - 1) / cols);
+	print cols, rows;
+    }'`
+    cols=$1
+    rows=$2
+
+    # the board itself has to be big enough before the copies go in
+    awk -v w=$width -v h=$height -v c=$cols -v r=$rows '
+	/^PCB\[/ && !done {
+	    sub (/ [^ ]+ [^ ]+\]/, sprintf (" %.2fmil %.2fmil]", w * c, h * r));
+	    done = 1;
+	}
+	{ print }' "$src" > "${dst}.in"
+
+    awk -v w=$width -v h=$height -v c=$cols -v r=$rows -v out="$dst" '
+	BEGIN {
+	    print "Select(All)";
+	    print "PasteBuffer(Clear)";
+	    print "PasteBuffer(AddSelected)";
+	    print "Unselect(All)";
+	    for (i = 1; i < c; i++)
+		printf ("PasteBuffer(ToLayout, %.2fmil, 0mil)\n", i * w);
+	    if (r > 1) {
+		print "Select(All)";
+		print "PasteBuffer(Clear)";
+		print "PasteBuffer(AddSelected)";
+		print "Unselect(All)";
+	    }
+	    for (j = 1; j < r; j++)
+		printf ("PasteBuffer(ToLayout, 0mil, %.2fmil)\n", j * h);
+	    printf ("SaveTo(LayoutAs, %s)\n", out);
+	    print "Quit()";
+	}' > "${dst}.script"
+
+    ${PCB} -x bom --action-script "${dst}.script" "${dst}.in" > "${dst}.log" 2>&1
+    rm -f "${dst}.in"
+    if test ! -f "$dst" ; then
+	echo "Could not make $dst, see ${dst}.log"
+	return 1
+    fi
+    echo "`basename $dst`: ${cols}x${rows} copies of `basename $src`, `board_objects $dst` objects"
+}
+
+##########################################################################
+#
+# the exports
+#
+
+# Run one export and append its wall time, peak RSS (kB) and output
+# size (bytes) to the results.
+run_export() {
+    board="$1"
+    hid="$2"
+    name=`basename $board .pcb`
+    rundir=${OUTDIR}/${name}-${hid}
+
+    rm -rf ${rundir}
+    mkdir -p ${rundir}
+    cp "$board" ${rundir}/${name}.pcb
+    if test $have_gnu_time = yes ; then
+	(cd ${rundir} && ${TIME} -f "%e %M" -o ../time.out \
+	    ${PCB} -x ${hid} ${name}.pcb > ../run.log 2>&1)
+	status=$?
+	set -- `tail -n 1 ${OUTDIR}/time.out`
+	secs=$1
+	rss=$2
+    else
+	start=`date +%s.%N`
+	(cd ${rundir} && ${PCB} -x ${hid} ${name}.pcb > ../run.log 2>&1)
+	status=$?
+	end=`date +%s.%N`
+	secs=`echo "$start $end" | awk '{ printf ("%.2f", $2 - $1) }'`
+	rss=-
+    fi
+    rm -f ${rundir}/${name}.pcb
+    if test $status -ne 0 ; then
+	echo "${name} ${hid}: export failed, see ${rundir}.log"
+	mv ${OUTDIR}/run.log ${rundir}.log
+	return 1
+    fi
+    bytes=`cat ${rundir}/* 2> /dev/null | wc -c | tr -d ' '`
+    rm -rf ${rundir}
+    echo "${name} ${hid} ${secs} ${rss} ${bytes}" | tee -a ${results}
+}
+
+failed=0
+for b in ${BOARDS} ; do
+    for n in ${SIZES} ; do
+	board=${OUTDIR}/`basename $b .pcb`-${n}.pcb
+	if test ! -f $board ; then
+	    if test $b = genboard ; then
+		${GENBOARD} -n $n $board || { failed=1 ; continue ; }
+		echo "`basename $board`: `board_objects $board` objects"
+	    else
+		make_board ${INDIR}/$b $board $n || { failed=1 ; continue ; }
+	    fi
+	fi
+	for hid in ${EXPORTERS} ; do
+	    run_export $board $hid || failed=1
+	done
+    done
+done
+
+##########################################################################
+#
+# compare with the baseline
+#
+
+if test $update = yes ; then
+    {
+	echo "# board exporter seconds peak-rss-kB output-bytes"
+	cat ${results}
+    } > ${BASELINE}
+    echo "Wrote ${BASELINE}"
+    exit $failed
+fi
+
+if test ! -f ${BASELINE} ; then
+    echo "No baseline ${BASELINE}, run $0 --update to record one."
+    exit $failed
+fi
+
+awk -v tol=${TOLERANCE} '
+    function worse(now, then, what) {
+	if (now == "-" || then == "-" || then == 0)
+	    return 0;
+	if (now > then * (1 + tol / 100)) {
+	    printf ("%s %s: %s %s, baseline %s\n", $1, $2, what, now, then);
+	    return 1;
+	}
+	return 0;
+    }
+    /^#/ { next }
+    FILENAME != ARGV[ARGC - 1] { base[$1 " " $2] = $3 " " $4 " " $5; next }
+    {
+	key = $1 " " $2;
+	if (!(key in base)) {
+	    printf ("%s: not in the baseline\n", key);
+	    next;
+	}
+	split (base[key], b, " ");
+	bad += worse($3, b[1], "seconds");
+	bad += worse($4, b[2], "peak kB");
+	bad += worse($5, b[3], "bytes");
+	if (b[3] > 0 && $5 < b[3] * (1 - tol / 100)) {
+	    printf ("%s: bytes %s, baseline %s\n", key, $5, b[3]);
+	    bad++;
+	}
+    }
+    END {
+	if (bad)
+	    printf ("%d regressions against the baseline\n", bad);
+	else
+	    print "No regressions against the baseline";
+	exit (bad != 0);
+    }' ${BASELINE} ${results} || failed=1
+
+exit $failed
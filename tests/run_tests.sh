@@ -796,6 +796,7 @@ for t in $all_tests ; do
     hid=`echo ${TSTR} | $AWK 'BEGIN{FS="|"} {gsub(/[ \t]*/, ""); print $3}'`
     args=`echo ${TSTR} | $AWK 'BEGIN{FS="|"} {print $4}'`
     mismatch=`echo ${TSTR} | $AWK 'BEGIN{FS="|"} {if($5 == "mismatch"){print "yes"}else{print "no"}}'`
+    golden=`echo ${TSTR} | $AWK 'BEGIN{FS="|"} {gsub(/[ \t]*/, "", $5); if($5 ~ /^golden=/){print substr($5, 8)}}'`
     out_files=`echo ${TSTR} | $AWK 'BEGIN{FS="|"} {print $6}'`
 
     # strip whitespace from single file names
@@ -811,6 +812,17 @@ for t in $all_tests ; do
 	skip=`expr $skip + 1`
 	continue
     fi
+
+    # a test sharing the golden files of another one is checked, not
+    # regenerated, those files belong to the other test
+    if test "X${golden}" != "X" ; then
+	if test "X$regen" = "Xyes" ; then
+	    echo "Skipping, the golden files are those of ${golden}"
+	    skip=`expr $skip + 1`
+	    continue
+	fi
+	refdir="${REFDIR}/${golden}"
+    fi
     
     if test "X${args}" != "X" ; then
 	pcb_flags="${args}"
@@ -886,6 +898,9 @@ for t in $all_tests ; do
         *.attrs)
           continue
           ;;
+        *.kicad_pcb|*.edf)
+          continue
+          ;;
         *)
           echo "\"$f\" is not a supported input file"
           exit 1
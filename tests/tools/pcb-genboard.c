@@ -0,0 +1,741 @@
+/*!
+ * \file tests/tools/pcb-genboard.c
+ *
+ * \brief Write large synthetic boards for the benchmarks.
+ *
+ * The boards are made of a grid of resistors, SOIC and DIP packages
+ * and BGAs, with nets between their pins, tracks along the nets on all
+ * copper layers, dog bone fan-outs under the BGAs, a field of stitching
+ * vias in the channels between the parts and polygon pours.  The same
+ * options and seed always give the same board.
+ *
+ * The tracks of a net are laid out without any regard for the other
+ * nets, so the boards are not DRC clean: they are meant to load the
+ * code, not to be made.
+ *
+ * <hr>
+ *
+ * <h1><b>Copyright.</b></h1>\n
+ *
+ * PCB, interactive printed circuit board design
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* All sizes are in mil. */
+#define MARGIN		200.0
+#define CELL		500.0	/*!< The grid of the small parts. */
+#define CELL_BODY	190.0	/*!< Half the size of the largest small part. */
+#define BGA_PITCH	40.0
+#define BGA_EDGE	100.0	/*!< Room between a BGA and its cell. */
+#define TRACK_WIDTH	10.0
+#define FANOUT_WIDTH	6.0
+#define VIA_OFFSET	45.0	/*!< From an SMD pad to its fan-out via. */
+#define POUR_GAP	20.0
+#define MAX_SIZE	84000.0	/*!< Coordinates are 32 bit nanometres. */
+#define MAX_COPPER	16
+
+enum
+{
+  EL_RES,
+  EL_SOIC,
+  EL_DIP,
+  EL_BGA
+};
+
+#define NET_NONE	-1
+#define NET_GND		-2
+#define NET_VCC		-3
+
+/*!
+ * \brief A pin or pad, and where a track to it starts.
+ */
+typedef struct
+{
+  int element;
+  char number[16];
+  double x, y;			/*!< Absolute position. */
+  int layer;			/*!< Copper layer of an SMD pad, or -1 for a pin. */
+  int top_only;			/*!< Tracks to it stay on its layer. */
+  double ex, ey;		/*!< Where tracks on any layer start ... */
+  int escaped;			/*!< ... once it has a fan-out via. */
+  int net;
+} Terminal;
+
+typedef struct
+{
+  int type;
+  char name[16];
+  double x, y;
+  int onsolder;
+  int balls;			/*!< Balls per side of a BGA. */
+  int first, count;		/*!< Its terminals. */
+} Element;
+
+typedef struct
+{
+  double x1, y1, x2, y2;
+  double thickness;
+} Track;
+
+typedef struct
+{
+  Track *track;
+  int n, max;
+} TrackList;
+
+typedef struct
+{
+  double x, y;
+  double thickness, drill;
+} Via;
+
+static Element *elements;
+static int n_elements;
+static Terminal *terminals;
+static int n_terminals, max_terminals;
+static Via *vias;
+static int n_vias, max_vias;
+static TrackList layers[MAX_COPPER];
+static int copper = 4;
+static long n_tracks;
+
+static unsigned long seed = 1;
+
+/*!
+ * \brief A small generator of our own, so that the boards do not depend
+ * on the C library.
+ */
+static unsigned long
+random_number (unsigned long n)
+{
+  unsigned long hi, lo;
+
+  seed = (seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+  hi = seed >> 16;
+  seed = (seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+  lo = seed >> 16;
+  return n ? ((hi << 16) | lo) % n : 0;
+}
+
+static void *
+grow (void *array, int *max, size_t size)
+{
+  *max = *max ? 2 * *max : 256;
+  array = realloc (array, *max * size);
+  if (array == NULL)
+    {
+      fprintf (stderr, "pcb-genboard: out of memory\n");
+      exit (1);
+    }
+  return array;
+}
+
+static Terminal *
+add_terminal (int el, double x, double y, const char *number)
+{
+  Element *e = &elements[el];
+  Terminal *t;
+
+  if (n_terminals == max_terminals)
+    terminals = grow (terminals, &max_terminals, sizeof (Terminal));
+  t = &terminals[n_terminals++];
+  memset (t, 0, sizeof (Terminal));
+  t->element = el;
+  snprintf (t->number, sizeof (t->number), "%s", number);
+  t->x = e->x + x;
+  t->y = e->y + y;
+  t->ex = t->x;
+  t->ey = t->y;
+  t->layer = e->type == EL_DIP ? -1 : e->onsolder ? copper - 1 : 0;
+  t->escaped = t->layer < 0;
+  t->net = NET_NONE;
+  e->count++;
+  return t;
+}
+
+static void
+add_via (double x, double y, double thickness, double drill)
+{
+  if (n_vias == max_vias)
+    vias = grow (vias, &max_vias, sizeof (Via));
+  vias[n_vias].x = x;
+  vias[n_vias].y = y;
+  vias[n_vias].thickness = thickness;
+  vias[n_vias].drill = drill;
+  n_vias++;
+}
+
+static void
+add_track (int layer, double x1, double y1, double x2, double y2,
+	   double thickness)
+{
+  TrackList *l = &layers[layer];
+
+  if (l->n == l->max)
+    l->track = grow (l->track, &l->max, sizeof (Track));
+  l->track[l->n].x1 = x1;
+  l->track[l->n].y1 = y1;
+  l->track[l->n].x2 = x2;
+  l->track[l->n].y2 = y2;
+  l->track[l->n].thickness = thickness;
+  l->n++;
+  n_tracks++;
+}
+
+/*!
+ * \brief The name of ball \p row, \p col of a BGA: A1, B1, ... AA1,
+ * leaving out the letters JEDEC leaves out.
+ */
+static void
+ball_name (char *name, int row, int col)
+{
+  static const char letters[] = "ABCDEFGHJKLMNPRTUVWY";
+  int n = sizeof (letters) - 1;
+
+  if (row < n)
+    sprintf (name, "%c%d", letters[row], col + 1);
+  else
+    sprintf (name, "%c%c%d", letters[row / n - 1], letters[row % n],
+	     col + 1);
+}
+
+static void
+make_element (int el)
+{
+  Element *e = &elements[el];
+  Terminal *t;
+  char number[16];
+  int i, j;
+
+  e->first = n_terminals;
+  switch (e->type)
+    {
+    case EL_RES:
+      add_terminal (el, -30, 0, "1");
+      add_terminal (el, 30, 0, "2");
+      break;
+
+    case EL_SOIC:
+      for (i = 0; i < 8; i++)
+	{
+	  sprintf (number, "%d", i + 1);
+	  add_terminal (el, i < 4 ? -107.5 : 107.5,
+			i < 4 ? -75 + 50 * i : 75 - 50 * (i - 4), number);
+	}
+      break;
+
+    case EL_DIP:
+      for (i = 0; i < 8; i++)
+	{
+	  sprintf (number, "%d", i + 1);
+	  add_terminal (el, i < 4 ? -150 : 150,
+			i < 4 ? -150 + 100 * i : 150 - 100 * (i - 4), number);
+	}
+      break;
+
+    case EL_BGA:
+      for (i = 0; i < e->balls; i++)
+	for (j = 0; j < e->balls; j++)
+	  {
+	    double half = (e->balls - 1) / 2.0;
+	    int ring = i;
+
+	    ring = j < ring ? j : ring;
+	    ring = e->balls - 1 - i < ring ? e->balls - 1 - i : ring;
+	    ring = e->balls - 1 - j < ring ? e->balls - 1 - j : ring;
+
+	    ball_name (number, i, j);
+	    t = add_terminal (el, (j - half) * BGA_PITCH,
+			      (i - half) * BGA_PITCH, number);
+
+	    /* the two outer rings escape on the top layer, the others
+	     * through a via between the balls, away from the centre
+	     */
+	    if (ring < 2)
+	      t->top_only = 1;
+	    else
+	      {
+		t->ex = t->x + (j < e->balls / 2 ? -0.5 : 0.5) * BGA_PITCH;
+		t->ey = t->y + (i < e->balls / 2 ? -0.5 : 0.5) * BGA_PITCH;
+		t->escaped = 1;
+		add_track (0, t->x, t->y, t->ex, t->ey, FANOUT_WIDTH);
+		add_via (t->ex, t->ey, 20, 10);
+	      }
+	  }
+      break;
+    }
+}
+
+/*!
+ * \brief Where a track on \p layer to \p t starts, adding a fan-out via
+ * to an SMD pad on another layer the first time.
+ */
+static void
+track_end (Terminal *t, int layer, double *x, double *y)
+{
+  if (!t->escaped && layer != t->layer)
+    {
+      Element *e = &elements[t->element];
+
+      t->ex = t->x + (t->x < e->x ? -VIA_OFFSET : VIA_OFFSET);
+      t->ey = t->y;
+      t->escaped = 1;
+      add_track (t->layer, t->x, t->y, t->ex, t->ey, TRACK_WIDTH);
+      add_via (t->ex, t->ey, 30, 15);
+    }
+  if (t->escaped && layer != t->layer)
+    {
+      *x = t->ex;
+      *y = t->ey;
+    }
+  else
+    {
+      *x = t->x;
+      *y = t->y;
+    }
+}
+
+/*!
+ * \brief Route \p a to \p b with one or two segments on a random layer,
+ * horizontal first on the even layers and vertical first on the odd.
+ */
+static void
+route (Terminal *a, Terminal *b)
+{
+  int layer = random_number (copper);
+  double x1, y1, x2, y2;
+
+  if (a->top_only)
+    layer = a->layer;
+  else if (b->top_only)
+    layer = b->layer;
+  track_end (a, layer, &x1, &y1);
+  track_end (b, layer, &x2, &y2);
+
+  if (x1 == x2 || y1 == y2)
+    add_track (layer, x1, y1, x2, y2, TRACK_WIDTH);
+  else if (layer % 2 == 0)
+    {
+      add_track (layer, x1, y1, x2, y1, TRACK_WIDTH);
+      add_track (layer, x2, y1, x2, y2, TRACK_WIDTH);
+    }
+  else
+    {
+      add_track (layer, x1, y1, x1, y2, TRACK_WIDTH);
+      add_track (layer, x1, y2, x2, y2, TRACK_WIDTH);
+    }
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr,
+	   "usage: pcb-genboard [options] [output.pcb]\n"
+	   "\n"
+	   "Write a synthetic board for the benchmarks, to the standard output\n"
+	   "when no file is given.\n"
+	   "\n"
+	   "  -n objects   scale all of the below to about this many objects\n"
+	   "  -l layers    copper layers, 2 to %d (4)\n"
+	   "  -e elements  resistors, SOIC and DIP packages (100)\n"
+	   "  -t tracks    track segments along the nets (1000)\n"
+	   "  -p pours     polygon pours, spread over the layers (4)\n"
+	   "  -v vias      stitching vias between the parts (100)\n"
+	   "  -b balls     balls per side of the BGAs (0, no BGAs)\n"
+	   "  -g bgas      number of BGAs (1)\n"
+	   "  -s seed      seed of the random numbers (1)\n", MAX_COPPER);
+  exit (1);
+}
+
+static long
+number_arg (const char *arg, long min)
+{
+  char *end;
+  long n = strtol (arg, &end, 10);
+
+  if (*arg == '\0' || *end != '\0' || n < min)
+    usage ();
+  return n;
+}
+
+int
+main (int argc, char **argv)
+{
+  long objects = 0, tracks = 1000;
+  int n_small = 100, pours = 4, stitches = 100, balls = 0, bgas = 1;
+  int cols, rows, bga_cols, bga_rows, per_layer[MAX_COPPER];
+  double bga_cell, band, width, height, pitch;
+  int *order, n_signal, net, n_nets, *net_start;
+  FILE *out = stdout;
+  int c, i, j, k, l;
+  long done;
+
+  while ((c = getopt (argc, argv, "n:l:e:t:p:v:b:g:s:h")) != -1)
+    switch (c)
+      {
+      case 'n':
+	objects = number_arg (optarg, 1);
+	break;
+      case 'l':
+	copper = number_arg (optarg, 2);
+	if (copper > MAX_COPPER)
+	  usage ();
+	break;
+      case 'e':
+	n_small = number_arg (optarg, 0);
+	break;
+      case 't':
+	tracks = number_arg (optarg, 0);
+	break;
+      case 'p':
+	pours = number_arg (optarg, 0);
+	break;
+      case 'v':
+	stitches = number_arg (optarg, 0);
+	break;
+      case 'b':
+	balls = number_arg (optarg, 0);
+	break;
+      case 'g':
+	bgas = number_arg (optarg, 0);
+	break;
+      case 's':
+	seed = number_arg (optarg, 0);
+	break;
+      default:
+	usage ();
+      }
+  if (optind < argc - 1)
+    usage ();
+
+  /* about a fifth of the objects are the parts, half the tracks and a
+   * tenth the stitching vias, the rest is fan-out
+   */
+  if (objects)
+    {
+      n_small = objects / 40 + 1;
+      tracks = objects / 2;
+      stitches = objects / 10;
+      pours = copper + objects / 50000;
+      balls = objects >= 10000 ? 32 : 0;
+      bgas = objects / 100000 + 1;
+    }
+  if (balls == 0)
+    bgas = 0;
+
+  /* the BGAs in a band across the top, the small parts in a grid below */
+  bga_cell = balls * BGA_PITCH + 2 * BGA_EDGE;
+  cols = ceil (sqrt (n_small + bgas * (bga_cell / CELL) * (bga_cell / CELL)));
+  cols = cols < 1 ? 1 : cols;
+  rows = (n_small + cols - 1) / cols;
+  bga_cols = (int) (cols * CELL / bga_cell);
+  bga_cols = bga_cols < 1 ? 1 : bga_cols;
+  bga_rows = bgas ? (bgas + bga_cols - 1) / bga_cols : 0;
+  band = bga_rows * bga_cell;
+  width = 2 * MARGIN + fmax (cols * CELL, bgas ? bga_cell : 0);
+  height = 2 * MARGIN + band + rows * CELL;
+  if (width > MAX_SIZE || height > MAX_SIZE)
+    {
+      fprintf (stderr, "pcb-genboard: a board of %.0f x %.0f mil is too big,"
+	       " use fewer elements\n", width, height);
+      return 1;
+    }
+
+  elements = calloc (n_small + bgas, sizeof (Element));
+  for (i = 0, k = 0; i < bgas; i++)
+    {
+      Element *e = &elements[n_elements++];
+
+      e->type = EL_BGA;
+      e->balls = balls;
+      e->x = MARGIN + (i % bga_cols + 0.5) * bga_cell;
+      e->y = MARGIN + (i / bga_cols + 0.5) * bga_cell;
+      sprintf (e->name, "U%d", ++k);
+      make_element (n_elements - 1);
+    }
+  for (i = 0, j = 0; i < n_small; i++)
+    {
+      Element *e = &elements[n_elements++];
+      int kind = random_number (10);
+
+      e->type = kind < 6 ? EL_RES : kind < 9 ? EL_SOIC : EL_DIP;
+      e->onsolder = e->type == EL_RES && random_number (3) == 0;
+      e->x = MARGIN + (i % cols + 0.5) * CELL;
+      e->y = MARGIN + band + (i / cols + 0.5) * CELL;
+      if (e->type == EL_RES)
+	sprintf (e->name, "R%d", ++j);
+      else
+	sprintf (e->name, "U%d", ++k);
+      make_element (n_elements - 1);
+    }
+
+  /* a share of the pins goes to the supplies, the others are shuffled
+   * into nets of two to five pins
+   */
+  order = malloc ((n_terminals + 1) * sizeof (int));
+  net_start = malloc ((n_terminals + 1) * sizeof (int));
+  for (i = 0, n_signal = 0; i < n_terminals; i++)
+    {
+      int r = random_number (16);
+
+      if (r < 2 || (r < 4 && elements[terminals[i].element].type == EL_BGA))
+	terminals[i].net = NET_GND;
+      else if (r < 3)
+	terminals[i].net = NET_VCC;
+      else
+	order[n_signal++] = i;
+    }
+  for (i = n_signal - 1; i > 0; i--)
+    {
+      j = random_number (i + 1);
+      k = order[i];
+      order[i] = order[j];
+      order[j] = k;
+    }
+  for (i = 0, n_nets = 0; n_signal - i >= 2; n_nets++)
+    {
+      int size = 2 + random_number (4);
+
+      if (n_signal - i - size < 2)
+	size = n_signal - i;
+      net_start[n_nets] = i;
+      for (j = i; j < i + size; j++)
+	terminals[order[j]].net = n_nets;
+      i += size;
+    }
+  net_start[n_nets] = i;
+
+  /* the tracks, going round the nets as often as it takes */
+  for (done = 0, net = 0; n_nets && done < tracks; net = (net + 1) % n_nets)
+    for (i = net_start[net]; i + 1 < net_start[net + 1] && done < tracks;
+	 i++)
+      {
+	long before = n_tracks;
+
+	route (&terminals[order[i]], &terminals[order[i + 1]]);
+	done += n_tracks - before;
+      }
+
+  /* the stitching vias on a lattice, leaving out the parts, closer
+   * together until there are enough of them
+   */
+  for (pitch = sqrt ((width * height) * 0.4 / (stitches ? stitches : 1));
+       stitches > 0; pitch *= 0.9)
+    {
+      int first = n_vias;
+      double x, y;
+
+      for (y = MARGIN + pitch / 2;
+	   y < height - MARGIN && n_vias - first < stitches; y += pitch)
+	for (x = MARGIN + pitch / 2;
+	     x < width - MARGIN && n_vias - first < stitches; x += pitch)
+	  {
+	    double dx, dy, body;
+
+	    if (y < MARGIN + band)
+	      {
+		dx = fmod (x - MARGIN, bga_cell) - bga_cell / 2;
+		dy = fmod (y - MARGIN, bga_cell) - bga_cell / 2;
+		body = bga_cell / 2 - BGA_EDGE / 2;
+	      }
+	    else
+	      {
+		dx = fmod (x - MARGIN, CELL) - CELL / 2;
+		dy = fmod (y - MARGIN - band, CELL) - CELL / 2;
+		body = CELL_BODY + 20;
+	      }
+	    if (fabs (dx) > body || fabs (dy) > body)
+	      add_via (x, y, 24, 12);
+	  }
+      if (n_vias - first >= stitches || pitch < 30)
+	break;
+      n_vias = first;
+    }
+
+  for (l = 0; l < copper; l++)
+    per_layer[l] = 0;
+  for (i = 0; i < pours; i++)
+    per_layer[i % copper]++;
+
+  if (optind < argc && (out = fopen (argv[optind], "w")) == NULL)
+    {
+      perror (argv[optind]);
+      return 1;
+    }
+
+  fprintf (out, "# release: pcb-genboard\n\n"
+	   "FileVersion[20091103]\n\n"
+	   "PCB[\"genboard\" %.2fmil %.2fmil]\n\n"
+	   "Grid[10.00mil 0.0000 0.0000 1]\n"
+	   "PolyArea[200000000.000000]\n"
+	   "Thermal[0.500000]\n"
+	   "DRC[10.00mil 10.00mil 10.00mil 10.00mil 15.00mil 10.00mil]\n"
+	   "Flags(\"nameonpcb,uniquename,clearnew,snappin\")\n"
+	   "Groups(\"1,c", width, height);
+  for (l = 2; l < copper; l++)
+    fprintf (out, ":%d", l);
+  fprintf (out, ":%d,s\")\n", copper);
+  fprintf (out, "Styles[\"Signal,10.00mil,36.00mil,20.00mil,10.00mil:"
+	   "Power,25.00mil,60.00mil,35.00mil,10.00mil:"
+	   "Fat,40.00mil,60.00mil,35.00mil,10.00mil:"
+	   "Skinny,6.00mil,24.02mil,11.81mil,6.00mil\"]\n\n");
+
+  for (i = 0; i < n_vias; i++)
+    fprintf (out, "Via[%.2fmil %.2fmil %.2fmil 20.00mil 0.0000 %.2fmil"
+	     " \"\" \"\"]\n", vias[i].x, vias[i].y, vias[i].thickness,
+	     vias[i].drill);
+
+  for (i = 0; i < n_elements; i++)
+    {
+      Element *e = &elements[i];
+      const char *side = e->onsolder ? "onsolder" : "";
+      double bx, by;
+
+      switch (e->type)
+	{
+	case EL_RES:
+	  bx = 55;
+	  by = 25;
+	  fprintf (out, "\nElement[\"%s\" \"SMT resistor\" \"%s\" \"0603\""
+		   " %.2fmil %.2fmil -40.00mil -60.00mil 0 100 \"%s\"]\n(\n",
+		   side, e->name, e->x, e->y, side);
+	  break;
+	case EL_SOIC:
+	  bx = 130;
+	  by = 100;
+	  fprintf (out, "\nElement[\"\" \"Small outline package\" \"%s\""
+		   " \"SO8\" %.2fmil %.2fmil -60.00mil -135.00mil 0 100 \"\"]"
+		   "\n(\n", e->name, e->x, e->y);
+	  break;
+	case EL_DIP:
+	  bx = 185;
+	  by = 185;
+	  fprintf (out, "\nElement[\"\" \"Dual in-line package\" \"%s\""
+		   " \"DIP8\" %.2fmil %.2fmil -60.00mil -215.00mil 0 100 \"\"]"
+		   "\n(\n", e->name, e->x, e->y);
+	  break;
+	default:
+	  bx = by = e->balls * BGA_PITCH / 2 + 20;
+	  fprintf (out, "\nElement[\"\" \"Ball grid array\" \"%s\""
+		   " \"BGA%d\" %.2fmil %.2fmil 0.0000 %.2fmil 0 100 \"\"]\n(\n",
+		   e->name, e->balls * e->balls, e->x, e->y, -by - 60);
+	  break;
+	}
+
+      for (j = e->first; j < e->first + e->count; j++)
+	{
+	  Terminal *t = &terminals[j];
+	  double x = t->x - e->x, y = t->y - e->y;
+
+	  switch (e->type)
+	    {
+	    case EL_RES:
+	      fprintf (out, "\tPad[%.2fmil %.2fmil %.2fmil %.2fmil 35.00mil"
+		       " 20.00mil 41.00mil \"\" \"%s\" \"%s%ssquare\"]\n",
+		       x, y, x, y, t->number, side, *side ? "," : "");
+	      break;
+	    case EL_SOIC:
+	      fprintf (out, "\tPad[%.2fmil %.2fmil %.2fmil %.2fmil 24.00mil"
+		       " 20.00mil 30.00mil \"\" \"%s\" \"square\"]\n",
+		       x - 12.5, y, x + 12.5, y, t->number);
+	      break;
+	    case EL_DIP:
+	      fprintf (out, "\tPin[%.2fmil %.2fmil 60.00mil 20.00mil 66.00mil"
+		       " 28.00mil \"\" \"%s\" \"%s\"]\n", x, y, t->number,
+		       j == e->first ? "square" : "");
+	      break;
+	    default:
+	      fprintf (out, "\tPad[%.2fmil %.2fmil %.2fmil %.2fmil 20.00mil"
+		       " 8.00mil 24.00mil \"\" \"%s\" \"\"]\n",
+		       x, y, x, y, t->number);
+	      break;
+	    }
+	}
+      fprintf (out, "\tElementLine [%.2fmil %.2fmil %.2fmil %.2fmil 8.00mil]\n"
+	       "\tElementLine [%.2fmil %.2fmil %.2fmil %.2fmil 8.00mil]\n"
+	       "\tElementLine [%.2fmil %.2fmil %.2fmil %.2fmil 8.00mil]\n"
+	       "\tElementLine [%.2fmil %.2fmil %.2fmil %.2fmil 8.00mil]\n)\n",
+	       -bx, -by, bx, -by, bx, -by, bx, by,
+	       bx, by, -bx, by, -bx, by, -bx, -by);
+    }
+
+  for (l = 0; l < copper; l++)
+    {
+      double strip = (width - 2 * MARGIN) / (per_layer[l] ? per_layer[l] : 1);
+
+      fprintf (out, "Layer(%d \"%s", l + 1,
+	       l == 0 ? "top" : l == copper - 1 ? "bottom" : "inner");
+      if (l > 0 && l < copper - 1)
+	fprintf (out, "%d", l + 1);
+      fprintf (out, "\" \"copper\")\n(\n");
+      for (i = 0; i < layers[l].n; i++)
+	{
+	  Track *t = &layers[l].track[i];
+
+	  fprintf (out, "\tLine[%.2fmil %.2fmil %.2fmil %.2fmil %.2fmil"
+		   " 20.00mil \"clearline\"]\n", t->x1, t->y1, t->x2, t->y2,
+		   t->thickness);
+	}
+      for (i = 0; i < per_layer[l]; i++)
+	{
+	  double x1 = MARGIN + i * strip + POUR_GAP / 2;
+	  double x2 = MARGIN + (i + 1) * strip - POUR_GAP / 2;
+
+	  fprintf (out, "\tPolygon(\"clearpoly\")\n\t(\n"
+		   "\t\t[%.2fmil %.2fmil] [%.2fmil %.2fmil]"
+		   " [%.2fmil %.2fmil] [%.2fmil %.2fmil] \n\t)\n",
+		   x1, MARGIN, x2, MARGIN, x2, height - MARGIN,
+		   x1, height - MARGIN);
+	}
+      fprintf (out, ")\n");
+    }
+  fprintf (out, "Layer(%d \"bottom silk\" \"silk\")\n(\n)\n", copper + 1);
+  fprintf (out, "Layer(%d \"top silk\" \"silk\")\n(\n)\n", copper + 2);
+
+  fprintf (out, "NetList()\n(\n");
+  for (k = 0; k < 2; k++)
+    {
+      fprintf (out, "\tNet(\"%s\" \"(unknown)\")\n\t(\n", k ? "VCC" : "GND");
+      for (i = 0; i < n_terminals; i++)
+	if (terminals[i].net == (k ? NET_VCC : NET_GND))
+	  fprintf (out, "\t\tConnect(\"%s-%s\")\n",
+		   elements[terminals[i].element].name, terminals[i].number);
+      fprintf (out, "\t)\n");
+    }
+  for (net = 0; net < n_nets; net++)
+    {
+      fprintf (out, "\tNet(\"N%d\" \"(unknown)\")\n\t(\n", net + 1);
+      for (i = net_start[net]; i < net_start[net + 1]; i++)
+	fprintf (out, "\t\tConnect(\"%s-%s\")\n",
+		 elements[terminals[order[i]].element].name,
+		 terminals[order[i]].number);
+      fprintf (out, "\t)\n");
+    }
+  fprintf (out, ")\n");
+
+  if (out != stdout && fclose (out) != 0)
+    {
+      perror (argv[optind]);
+      return 1;
+    }
+  return 0;
+}